@@ -36,9 +36,10 @@
  */
 #include <stdio.h>
 
-#include <GLFW/glfw3.h>
 #include <GLES3/gl3.h>
 
+#include "common/demo_context.h"
+
 const char* vertex_src = R"(#version 310 es
 precision highp float;
 
@@ -65,39 +66,20 @@ void main() {
 }
 )";
 
-static void ErrorCallbackGLFW(int error, const char* description) {
-    printf("Glfw Error %d: %s\n", error, description);
-}
-
 int main(int argc, char **argv) {
-    // 0. Add a method to report any GLFW errors.
-    glfwSetErrorCallback(ErrorCallbackGLFW);
-
-    // 1. Initialize the GLFW library.
-    if (!glfwInit()) {
-        return -1;
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    /* See the "01_gles_glfw" example for the GLFW steps. This also handles the
+     * "--headless" and "--frames N" command line options. */
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
     }
 
-    // 2. Add hints to use during context creation when a GLFW window is created.
-    // Here: require a GL ES 3.0 context.
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
-    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
-
-    // 3. Create window with graphics context
-    GLFWwindow* window = glfwCreateWindow(1024, 600, "GLDEMO", NULL, NULL);
-    if (window == NULL) {
-        return -2;
-    }
-
-    // 4. Activate the window (display it).
-    glfwMakeContextCurrent(window);
-
     // 5. Set the view port to match the window size.
     {
         int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
         glViewport(0, 0, display_w, display_h);
     }
 
@@ -172,10 +154,10 @@ int main(int argc, char **argv) {
     }
 
     // X. Create a render loop.
-    while (!glfwWindowShouldClose(window))
+    while (!demoShouldClose(&demo))
     {
         // X. Poll and handle events (inputs, window resize, etc.)
-        glfwPollEvents();
+        demoPollEvents(&demo);
 
         // X. Clear the color image.
         glClearColor(0.0, 0.3, 0.3, 1.0f);
@@ -188,13 +170,11 @@ int main(int argc, char **argv) {
         glDrawArrays(GL_TRIANGLES, 0, 3);
 
         // X. Swap the fron-back buffers to display the rendered image in the window.
-        glfwSwapBuffers(window);
+        demoSwapBuffers(&demo);
     }
 
-    // XX. Destroy the window.
-    glfwDestroyWindow(window);
-    // XX. Destroy the GLFW.
-    glfwTerminate();
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
 
     return 0;
 }
@@ -7,6 +7,55 @@
  * Run:
  * $ ./gles_triangle
  *
+ * Streaming capture of N frames (the triangle moves from frame to frame):
+ * $ ./gles_triangle --capture 120
+ * This writes the "out_0000.ppm" ... "out_0119.ppm" images. The frames are read
+ * back asynchronously via a ring of pixel pack buffers (PBOs) and fences,
+ * the files are written on worker threads (see common/image_writer.h).
+ * "--capture-format ppm|png|qoi|raw" selects the file format and "--capture-threads N"
+ * the number of writer threads:
+ * $ ./gles_triangle --capture 1000 --capture-format qoi --capture-threads 4
+ * "--convert-threads N" converts each mapped PBO straight into the writer's frame
+ * (flipped top row first, alpha stripped, see common/readback_convert.h) in row bands
+ * on N threads, the writers only encode and write the RGB frames:
+ * $ ./gles_triangle --capture 1000 --capture-format raw --convert-threads 4
+ *
+ * Draw the triangle over video frames imported without a copy from dma-bufs
+ * (see common/dmabuf_image.h). A ring of 3 frames in the FORMAT (xrgb8888, abgr8888,
+ * nv12, yuv420, yuyv) layout is allocated through /dev/udmabuf, each is imported once
+ * and the CPU writes the next frame into them as a camera would:
+ * $ ./gles_triangle --dmabuf-import nv12 --capture 120
+ *
+ * Hand the rendered frames to another process without a CPU copy: "--dmabuf-export PATH"
+ * renders "--frames N" (default: 120) frames into a ring of 3 exported dma-buf render targets
+ * and announces every frame with a fence fd on the unix socket PATH. "--dmabuf-consume PATH"
+ * imports the targets, samples every announced frame after the GPU wait for its fence, returns
+ * it with its own fence and writes the last frame into "out.ppm":
+ * $ ./gles_triangle --dmabuf-export /tmp/frames.sock --frames 600 &
+ * $ ./gles_triangle --dmabuf-consume /tmp/frames.sock
+ *
+ * Record "--frames N" frames into a video instead of image files (see common/video_sink.h):
+ * the frames are converted to NV12 on the GPU and encoded by the V4L2 memory-to-memory
+ * H.264 encoder "--encoder DEVICE" ("--bitrate" bits/s, "--fps"), or written as raw NV12
+ * without a device:
+ * $ ./gles_triangle --encode out.h264 --encoder /dev/video11 --frames 600 --bitrate 4000000
+ * $ ./gles_triangle --encode out.nv12 --frames 120
+ *
+ * Distribute "--device-jobs N" offscreen jobs (render + read back and Mandelbrot compute, alternating)
+ * over every EGL device (GPU) with one surfaceless context per device, see common/device_pool.h.
+ * "--device-limit K" uses the first K devices only, "--device-workers M" starts M contexts per device
+ * and "--device N" renders the single image on the device N instead of the default display:
+ * $ ./gles_triangle --device-jobs 1000
+ * $ ./gles_triangle --device-jobs 1000 --device-limit 1
+ * $ ./gles_triangle --device 1
+ *
+ * Keep running as a render service (see common/render_service.h): the jobs come as lines
+ * "<id> <W>x<H> <triangle|grid> [<x> <y> <zoom>]" from stdin ("--service", the images go to stdout,
+ * the messages to stderr) or from the clients of a unix socket ("--service-socket PATH"). The jobs of
+ * a size are drawn into one atlas pass, "--service-batch N" jobs at most, "quit" stops the service:
+ * $ printf 'a 128x128 triangle\nb 128x128 grid 0.2 0 2\n' | ./gles_triangle --service > images.bin
+ * $ ./gles_triangle --service-socket /tmp/render.sock --capture-format png
+ *
  * Dependencies:
  *  * C++11
  *  * Open GL ES 3.1+
@@ -35,15 +84,33 @@
  */
 #include <stdio.h>
 
-#include <fstream>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 #include <GLES3/gl32.h>
 #include <GLES3/gl3ext.h>
+#include <GLES2/gl2ext.h>
 #include <GLFW/glfw3.h>
 
+#include "common/device_pool.h"
+#include "common/dmabuf_image.h"
+#include "common/gl_debug.h"
+#include "common/image_writer.h"
+#include "common/job_system.h"
+#include "common/readback_convert.h"
+#include "common/render_service.h"
+#include "common/video_sink.h"
+
 // From the EGL_KHR_create_context extension:
 #ifndef EGL_OPENGL_ES3_BIT_KHR
 #define EGL_OPENGL_ES3_BIT_KHR 0x0040
@@ -52,7 +119,7 @@
 const char* vertex_src = R"(#version 310 es
 precision highp float;
 
-out vec3 fragColor;
+uniform float offset;
 
 vec2 positions[3] = vec2[](
     vec2(-0.5, 0.5),
@@ -61,7 +128,7 @@ vec2 positions[3] = vec2[](
 );
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexID], 0.0, 1.0);
+    gl_Position = vec4(positions[gl_VertexID] + vec2(offset, 0.0), 0.0, 1.0);
 }
 )";
 
@@ -75,19 +142,393 @@ void main() {
 }
 )";
 
-static void on_gl_error(GLenum source, GLenum type, GLuint id, GLenum severity,
-                          GLsizei length, const GLchar* message, const void *userParam) {
+// The imported video frame as the background (see the "--dmabuf-import" option).
+/* The external sampler converts the YUV formats to RGB. */
+const char* video_vertex_src = R"(#version 310 es
+precision highp float;
+
+out vec2 fTex;
+
+void main() {
+    vec2 position = vec2(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0);
+    fTex = vec2(position.x * 0.5 + 0.5, 0.5 - position.y * 0.5);
+    gl_Position = vec4(position, 0.0, 1.0);
+}
+)";
+
+const char* video_fragment_src = R"(#version 310 es
+#extension GL_OES_EGL_image_external_essl3 : require
+precision highp float;
+
+uniform samplerExternalOES frame;
+
+in vec2 fTex;
+out vec4 outColor;
+
+void main() {
+    outColor = texture(frame, fTex);
+}
+)";
+
+// The Mandelbrot set of the compute jobs (see the "--device-jobs" option): the iteration count per pixel.
+const char* mandelbrot_compute_src = R"(#version 310 es
+precision highp float;
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(std430, binding = 0) writeonly buffer Counts {
+    uint counts[];
+};
+
+uniform vec2 center;
+uniform float scale;
+
+void main() {
+    uvec2 size = gl_NumWorkGroups.xy * gl_WorkGroupSize.xy;
+    vec2 c = center + (vec2(gl_GlobalInvocationID.xy) / vec2(size) - 0.5) * scale;
+    vec2 z = vec2(0.0);
+    uint count = 0u;
+    while (count < 256u && dot(z, z) < 4.0) {
+        z = vec2(z.x * z.x - z.y * z.y, 2.0 * z.x * z.y) + c;
+        count++;
+    }
+    counts[gl_GlobalInvocationID.y * size.x + gl_GlobalInvocationID.x] = count;
+}
+)";
+
+// The scenes of the render service (see the "--service" option): "triangle" or a "grid" of 8x8 triangles,
+// seen from the camera (xy: position, z: zoom).
+const char* service_vertex_src = R"(#version 310 es
+precision highp float;
+
+uniform vec3 camera;
+uniform int grid;
+
+out vec3 fColor;
+
+vec2 positions[3] = vec2[](
+    vec2(-0.5, 0.5),
+    vec2(0.5, 0.5),
+    vec2(0.0, -0.5)
+);
+
+void main() {
+    vec2 cell = vec2(gl_InstanceID % grid, gl_InstanceID / grid);
+    vec2 position = (positions[gl_VertexID] + (cell - 0.5 * float(grid - 1)) * 1.25) / float(grid);
+    gl_Position = vec4((position - camera.xy) * camera.z, 0.0, 1.0);
+    fColor = vec3(1.0f, 0.5f, 0.1f) * (1.0 - 0.5 * cell.y / float(grid));
+}
+)";
+
+const char* service_fragment_src = R"(#version 310 es
+precision highp float;
+
+in vec3 fColor;
+out vec4 outColor;
 
-    printf("-> %s\n", message);
+void main() {
+    outColor = vec4(fColor, 1.0);
+}
+)";
+
+// Compile and link the shaders (one source per stage, 0: unused), 0 on error.
+static unsigned int createProgram(const char* vertexSrc, const char* fragmentSrc, const char* computeSrc,
+                                  const char* name) {
+    const char* sources[3] = { vertexSrc, fragmentSrc, computeSrc };
+    const GLenum stages[3] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_COMPUTE_SHADER };
+    unsigned int program = glCreateProgram();
+    for (int idx = 0; idx < 3; idx++) {
+        if (sources[idx] == NULL) {
+            continue;
+        }
+        unsigned int shader = glCreateShader(stages[idx]);
+        glShaderSource(shader, 1, &sources[idx], NULL);
+        glCompileShader(shader);
+        glAttachShader(program, shader);
+        glDeleteShader(shader);
+    }
+    glLinkProgram(program);
+
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char info[512];
+        glGetProgramInfoLog(program, 512, NULL, info);
+        printf("%s program error:\n%s\n", name, info);
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+// The program drawing an external texture over the whole viewport (0 on error).
+static unsigned int createVideoProgram() {
+    return createProgram(video_vertex_src, video_fragment_src, NULL, "Video");
+}
+
+// R. The warm program of the render service.
+struct ServiceScene {
+    unsigned int program;
+    int cameraLocation;
+    int gridLocation;
+};
+
+// Draw a job of the render service into its tile (see common/render_service.h).
+static bool drawServiceJob(const RenderJob& job, void* data) {
+    const ServiceScene* scene = (const ServiceScene*)data;
+    int grid = job.scene == "triangle" ? 1 : job.scene == "grid" ? 8 : 0;
+
+    glClearColor(0.0, 0.5, 0.5, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    if (grid == 0) {
+        return false;
+    }
+    glUseProgram(scene->program);
+    glUniform3fv(scene->cameraLocation, 1, job.camera);
+    glUniform1i(scene->gridLocation, grid);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 3, grid * grid);
+    return true;
+}
+
+// M. Offscreen jobs distributed over the GPUs (see common/device_pool.h).
+/* The contexts of the devices share nothing: every worker has its own programs and targets. */
+struct DeviceJobState {
+    unsigned int program;
+    int offsetLocation;
+    unsigned int fbo;
+    unsigned int renderbuffer;
+    unsigned int computeProgram;
+    unsigned int countBuffer;
+};
+
+struct OffscreenJob {
+    int index;
+    int count;   // jobs of the run, the triangle of a render job moves with its index
+    bool compute;
+    int size;    // width and height of the image
+    std::vector<uint8_t> pixels; // render jobs: the RGBA8 image
+    uint64_t result;             // render jobs: the sum of the pixels, compute jobs: of the iterations
+};
+
+static void createDeviceJobState(DeviceWorker* worker, void* userData) {
+    int size = *(const int*)userData;
+    DeviceJobState* state = new DeviceJobState();
+
+    state->program = createProgram(vertex_src, fragment_src, NULL, "Triangle");
+    state->offsetLocation = glGetUniformLocation(state->program, "offset");
+    state->computeProgram = createProgram(NULL, NULL, mandelbrot_compute_src, "Mandelbrot");
+
+    glGenRenderbuffers(1, &state->renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, state->renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size, size);
+    glGenFramebuffers(1, &state->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, state->fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, state->renderbuffer);
+
+    glGenBuffers(1, &state->countBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, state->countBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (size_t)size * size * sizeof(uint32_t), NULL, GL_DYNAMIC_READ);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, state->countBuffer);
+
+    worker->state = state;
+}
+
+static void destroyDeviceJobState(DeviceWorker* worker, void*) {
+    DeviceJobState* state = (DeviceJobState*)worker->state;
+    glDeleteProgram(state->program);
+    glDeleteProgram(state->computeProgram);
+    glDeleteFramebuffers(1, &state->fbo);
+    glDeleteRenderbuffers(1, &state->renderbuffer);
+    glDeleteBuffers(1, &state->countBuffer);
+    delete state;
+}
+
+static void runOffscreenJob(DeviceWorker* worker, void* data) {
+    DeviceJobState* state = (DeviceJobState*)worker->state;
+    OffscreenJob* job = (OffscreenJob*)data;
+    job->result = 0;
+
+    if (job->compute) {
+        // M.1. Compute: a tile of the Mandelbrot set zooming in with the job index, read back the counts.
+        glUseProgram(state->computeProgram);
+        glUniform2f(glGetUniformLocation(state->computeProgram, "center"), -0.743643f, 0.131825f);
+        glUniform1f(glGetUniformLocation(state->computeProgram, "scale"), 3.0f / (1.0f + job->index * 0.25f));
+        glDispatchCompute(job->size / 8, job->size / 8, 1);
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        size_t bytes = (size_t)job->size * job->size * sizeof(uint32_t);
+        const uint32_t* counts = (const uint32_t*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+        for (size_t idx = 0; counts != NULL && idx < bytes / sizeof(uint32_t); idx++) {
+            job->result += counts[idx];
+        }
+        glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+    } else {
+        // M.2. Render: the triangle of the frame into the offscreen target, read back the image.
+        glBindFramebuffer(GL_FRAMEBUFFER, state->fbo);
+        glViewport(0, 0, job->size, job->size);
+        glClearColor(0.0, 0.5, 0.5, 1.0);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glUseProgram(state->program);
+        glUniform1f(state->offsetLocation, -0.5f + (float)job->index / job->count);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        job->pixels.resize((size_t)job->size * job->size * 4);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, job->size, job->size, GL_RGBA, GL_UNSIGNED_BYTE, job->pixels.data());
+        for (uint8_t value : job->pixels) {
+            job->result += value;
+        }
+    }
 }
 
 int main(int argc, char **argv) {
-    const char* outputFileName = "out.ppm";
+    const char* outputFileName = "out";
     int renderImageWidth = 256;
     int renderImageHeight = 256;
 
-    // 1. Access the display
+    // Number of frames to capture with the streaming readback (0: single frame into "out.ppm").
+    int captureFrames = 0;
+    ImageFileFormat captureFormat = IMAGE_FILE_PPM;
+    int captureThreads = std::min(std::max((int)std::thread::hardware_concurrency() / 2, 1), 4);
+    // Threads converting the read backs before the writers ("--convert-threads N", 0: the writers convert).
+    int convertThreads = 0;
+    // The format of the imported video frames ("--dmabuf-import FORMAT").
+    const char* dmaBufFormatName = NULL;
+    // The socket of the frame sharing with an other process ("--dmabuf-export/--dmabuf-consume PATH").
+    const char* exportPath = NULL;
+    const char* consumePath = NULL;
+    // Frames of the export and video output modes ("--frames N").
+    int streamFrames = 120;
+    // The video output ("--encode PATH", "--encoder DEVICE", "--bitrate", "--fps").
+    const char* encodePath = NULL;
+    const char* encoderDevice = NULL;
+    int encodeBitrate = 4000000;
+    int encodeFps = 60;
+    // The EGL device of the display and the multi device jobs ("--device", "--device-jobs N", ...).
+    int deviceIndex = -1;
+    int deviceJobs = 0;
+    int deviceLimit = 0;
+    int deviceWorkers = 1;
+    // The render service: the jobs from stdin ("--service") or a unix socket ("--service-socket PATH").
+    bool service = false;
+    const char* serviceSocket = NULL;
+    int serviceBatch = 64;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--capture") == 0 && idx + 1 < argc) {
+            captureFrames = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--capture-format") == 0 && idx + 1 < argc) {
+            if (!parseImageFileFormat(argv[++idx], &captureFormat)) {
+                return -1;
+            }
+        } else if (strcmp(argv[idx], "--capture-threads") == 0 && idx + 1 < argc) {
+            captureThreads = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--convert-threads") == 0 && idx + 1 < argc) {
+            convertThreads = atoi(argv[++idx]);
+            if (convertThreads < 0) {
+                printf("Invalid --convert-threads value: %d\n", convertThreads);
+                return -1;
+            }
+        } else if (strcmp(argv[idx], "--dmabuf-import") == 0 && idx + 1 < argc) {
+            dmaBufFormatName = argv[++idx];
+        } else if (strcmp(argv[idx], "--dmabuf-export") == 0 && idx + 1 < argc) {
+            exportPath = argv[++idx];
+        } else if (strcmp(argv[idx], "--dmabuf-consume") == 0 && idx + 1 < argc) {
+            consumePath = argv[++idx];
+        } else if (strcmp(argv[idx], "--frames") == 0 && idx + 1 < argc) {
+            streamFrames = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--encode") == 0 && idx + 1 < argc) {
+            encodePath = argv[++idx];
+        } else if (strcmp(argv[idx], "--encoder") == 0 && idx + 1 < argc) {
+            encoderDevice = argv[++idx];
+        } else if (strcmp(argv[idx], "--bitrate") == 0 && idx + 1 < argc) {
+            encodeBitrate = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--fps") == 0 && idx + 1 < argc) {
+            encodeFps = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--device") == 0 && idx + 1 < argc) {
+            deviceIndex = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--device-jobs") == 0 && idx + 1 < argc) {
+            deviceJobs = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--device-limit") == 0 && idx + 1 < argc) {
+            deviceLimit = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--device-workers") == 0 && idx + 1 < argc) {
+            deviceWorkers = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--service") == 0) {
+            service = true;
+        } else if (strcmp(argv[idx], "--service-socket") == 0 && idx + 1 < argc) {
+            service = true;
+            serviceSocket = argv[++idx];
+        } else if (strcmp(argv[idx], "--service-batch") == 0 && idx + 1 < argc) {
+            serviceBatch = atoi(argv[++idx]);
+        }
+    }
+
+    if (service && (captureFrames > 0 || dmaBufFormatName != NULL || exportPath != NULL || consumePath != NULL
+                    || encodePath != NULL || deviceJobs > 0)) {
+        printf("The render service can't be combined with the capture, dma-buf, video or device job modes\n");
+        return -1;
+    }
+
+    // R.1. Service on stdin: stdout carries the images, the messages of the demo go to stderr instead.
+    int serviceOutput = STDOUT_FILENO;
+    if (service && serviceSocket == NULL) {
+        fflush(stdout);
+        serviceOutput = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+
+    // M.3. "--device-jobs N": render and compute jobs (alternating) on every device, without the display below.
+    if (deviceJobs > 0) {
+        DevicePool pool;
+        if (initDevicePool(&pool, deviceLimit, deviceWorkers, createDeviceJobState, destroyDeviceJobState,
+                           &renderImageWidth) == 0) {
+            printf("Error: no device with a GL ES 3 context\n");
+            destroyDevicePool(&pool);
+            return -1;
+        }
+
+        std::vector<OffscreenJob> jobs(deviceJobs);
+        std::vector<DeviceJob> poolJobs(deviceJobs);
+        auto startTime = std::chrono::steady_clock::now();
+        for (int idx = 0; idx < deviceJobs; idx++) {
+            jobs[idx].index = idx;
+            jobs[idx].count = deviceJobs;
+            jobs[idx].compute = idx % 2 == 1;
+            jobs[idx].size = renderImageWidth;
+            devicePoolSubmit(&pool, &poolJobs[idx], runOffscreenJob, &jobs[idx]);
+        }
+        devicePoolWaitAll(&pool);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        printDevicePoolStats(&pool, seconds);
+
+        // M.4. The last render job is the output image, the results show that every device computed the same.
+        int last = deviceJobs - 1 - (deviceJobs > 1 && jobs[deviceJobs - 1].compute ? 1 : 0);
+        for (int idx = 0; idx < deviceJobs && idx < 4; idx++) {
+            printf("  job %d (%s) on worker %d: %llu\n", idx, jobs[idx].compute ? "compute" : "render",
+                   poolJobs[idx].worker, (unsigned long long)jobs[idx].result);
+        }
+        if (!jobs[last].compute) {
+            std::string fileName = std::string(outputFileName) + "." + imageFileFormatNames[captureFormat];
+            std::vector<uint8_t> rgb;
+            writeImageFile(fileName.c_str(), captureFormat, jobs[last].pixels.data(), renderImageWidth,
+                           renderImageHeight, &rgb);
+        }
+
+        destroyDevicePool(&pool);
+        return 0;
+    }
+
+    // 1. Access the display (of the "--device N" EGL device, see common/device_pool.h).
     EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (deviceIndex >= 0) {
+        std::vector<EGLDeviceInfo> devices;
+        listEGLDevices(&devices);
+        if (deviceIndex >= (int)devices.size()) {
+            printf("Invalid device %d (%d devices)\n", deviceIndex, (int)devices.size());
+            return -1;
+        }
+        printf("EGL device %d: %s\n", deviceIndex, devices[deviceIndex].name.c_str());
+        display = openEGLDeviceDisplay(devices[deviceIndex]);
+    }
 
     // 2. Initialize EGL and get the version information.
     int major = 0;
@@ -107,7 +548,7 @@ int main(int argc, char **argv) {
             EGL_GREEN_SIZE, 8,
             EGL_BLUE_SIZE, 8,
             EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT_KHR,
-            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT | EGL_WINDOW_BIT,
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
             EGL_NONE
         };
         EGLint numConfigs;
@@ -163,8 +604,7 @@ int main(int argc, char **argv) {
     }
 
     // X. Extra: add a debug callback to have info on GL/ES errors.
-    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-    glDebugMessageCallback(on_gl_error, NULL);
+    enableGLDebugOutput(true);
 
     // 8. Specifly our viewport.
     {
@@ -241,19 +681,389 @@ int main(int argc, char **argv) {
         glDeleteShader(fragment_shader);
     }
 
+    // R.2. The render service: answer the jobs until "quit" or the end of the input, the program and the
+    // atlas stay warm between the jobs (see common/render_service.h).
+    if (service) {
+        ServiceScene scene;
+        scene.program = createProgram(service_vertex_src, service_fragment_src, NULL, "Service");
+        scene.cameraLocation = glGetUniformLocation(scene.program, "camera");
+        scene.gridLocation = glGetUniformLocation(scene.program, "grid");
+
+        if (scene.program != 0) {
+            RenderService renderService;
+            bool listening = initRenderService(&renderService, serviceSocket, STDIN_FILENO, serviceOutput,
+                                               captureFormat, serviceBatch);
+            while (listening && renderServiceStep(&renderService, drawServiceJob, &scene)) {
+            }
+            destroyRenderService(&renderService);
+            glDeleteProgram(scene.program);
+        }
+    }
+
+    // D. Video frames imported from dma-bufs: allocate the ring of frames and import each of them once.
+    static const int videoRingSize = 3;
+    DmaBufAllocation videoFrames[videoRingSize];
+    DmaBufTexture videoTextures[videoRingSize];
+    GLsync videoFences[videoRingSize] = { 0 };
+    unsigned int videoProgram = 0;
+    if (dmaBufFormatName != NULL) {
+        // D.1. The format must be importable by the display and sampled by the context.
+        DmaBufFormat format;
+        if (!parseDmaBufFormat(dmaBufFormatName, &format) || !dmaBufImportSupported(display, format)) {
+            return -1;
+        }
+
+        // D.2. The frames of the producer and their textures (no copy: the texture is the dma-buf memory).
+        for (int idx = 0; idx < videoRingSize; idx++) {
+            if (!allocateDmaBufFrame(&videoFrames[idx], renderImageWidth, renderImageHeight, format)) {
+                return -1;
+            }
+            writeDmaBufTestFrame(&videoFrames[idx], idx);
+            if (!importDmaBufTexture(display, videoFrames[idx].frame, &videoTextures[idx])) {
+                return -1;
+            }
+        }
+
+        // D.3. The program of the background.
+        videoProgram = createVideoProgram();
+        if (videoProgram == 0) {
+            return -3;
+        }
+        printf("Importing %dx%d %s frames from dma-bufs\n", renderImageWidth, renderImageHeight,
+               dmaBufFormatNames[format]);
+    }
+
+    // D.4. Draw the video frame "frame" as the background.
+    /* The producer may only write a frame after the GPU finished sampling it: the fence of its previous draw. */
+    auto drawVideoFrame = [&](int frame) {
+        if (videoProgram == 0) {
+            return;
+        }
+        int slot = frame % videoRingSize;
+        if (videoFences[slot]) {
+            glClientWaitSync(videoFences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(videoFences[slot]);
+        }
+        writeDmaBufTestFrame(&videoFrames[slot], frame);
+        refreshDmaBufTexture(&videoTextures[slot]);
+
+        glUseProgram(videoProgram);
+        glBindTexture(videoTextures[slot].target, videoTextures[slot].texture);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindTexture(videoTextures[slot].target, 0);
+        glUseProgram(shader_program);
+        videoFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    };
+
+    // S. Streaming capture: render and read back many frames without waiting for each of them.
+    if (captureFrames > 0) {
+        // S.1. Create a ring of pixel pack buffers, each can hold one frame.
+        /* While the GPU copies a frame into one of the buffers, the previous
+         * frames are already mapped and handed over to the writer thread. */
+        static const int readbackRingSize = 3;
+        const int frameSize = renderImageWidth * renderImageHeight * 4;
+
+        unsigned int pbos[readbackRingSize];
+        GLsync fences[readbackRingSize] = { 0 };
+        int pboFrame[readbackRingSize];
+
+        glGenBuffers(readbackRingSize, pbos);
+        for (int idx = 0; idx < readbackRingSize; idx++) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[idx]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, frameSize, NULL, GL_STREAM_READ);
+        }
+
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glUseProgram(shader_program);
+        int offsetLocation = glGetUniformLocation(shader_program, "offset");
+
+        ImageWriter writer(renderImageWidth, renderImageHeight, captureFormat, captureThreads, "out_%04d",
+                           convertThreads > 0 ? IMAGE_INPUT_RGB : IMAGE_INPUT_READBACK);
+
+        /* With "--convert-threads" the mapped frames are converted to top row first RGB in row bands. */
+        JobSystem convertJobs;
+        if (convertThreads > 0) {
+            initJobSystem(&convertJobs, convertThreads);
+        }
+        ReadbackConversion conversion = { renderImageWidth, renderImageHeight, READBACK_SOURCE_RGBA8, READBACK_RGB8,
+                                          READBACK_ALPHA_KEEP, true, 0, 0 };
+        double convertSeconds = 0.0;
+
+        // S.2. Wait for the readback of a ring slot, copy (or convert) the pixels and queue them for writing.
+        auto collectSlot = [&](int slot) {
+            glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(fences[slot]);
+            fences[slot] = 0;
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[slot]);
+            const uint8_t* mapped = (const uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameSize, GL_MAP_READ_BIT);
+            uint8_t* pixels = writer.acquire();
+            auto convertStart = std::chrono::steady_clock::now();
+            if (convertThreads > 0) {
+                convertReadback(&conversion, pixels, mapped, &convertJobs);
+            } else {
+                memcpy(pixels, mapped, frameSize);
+            }
+            convertSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - convertStart).count();
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+            writer.push(pboFrame[slot], pixels);
+        };
+
+        auto startTime = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < captureFrames; frame++) {
+            int slot = frame % readbackRingSize;
+
+            // S.3. The slot is reused: the frame rendered "readbackRingSize" frames ago must be collected first.
+            if (fences[slot]) {
+                collectSlot(slot);
+            }
+
+            // S.4. Draw the frame, the triangle moves from left to right.
+            glClearColor(0.0, 0.5, 0.5, 1.0);
+            glClear(GL_COLOR_BUFFER_BIT);
+            drawVideoFrame(frame);
+            glUniform1f(offsetLocation, -0.5f + (float)frame / captureFrames);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+
+            // S.5. Start the readback into the PBO (returns without waiting) and insert a fence after it.
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[slot]);
+            glReadPixels(0, 0, renderImageWidth, renderImageHeight, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+            fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            pboFrame[slot] = frame;
+        }
+
+        // S.6. Collect the frames still in flight (in order).
+        for (int frame = captureFrames - readbackRingSize; frame < captureFrames; frame++) {
+            if (frame >= 0 && fences[frame % readbackRingSize]) {
+                collectSlot(frame % readbackRingSize);
+            }
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        // S.7. Wait for the writer thread.
+        writer.finish();
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        printf("Captured %d frames in %.3f s: %.2f fps\n", captureFrames, seconds, captureFrames / seconds);
+        printf("Writers: %d %s threads (conversion: %s), %.3f ms/frame\n", captureThreads,
+               imageFileFormatNames[captureFormat], readbackConvertImplementation(),
+               writer.busySeconds() * 1000.0 / captureFrames);
+        printf("Readback %s: %.3f ms/frame\n", convertThreads > 0 ? "conversion" : "copy",
+               convertSeconds * 1000.0 / captureFrames);
+        if (convertThreads > 0) {
+            destroyJobSystem(&convertJobs);
+        }
+
+        glDeleteBuffers(readbackRingSize, pbos);
+    }
+
+    // E. Export: render into the shared targets and announce each frame with its fence.
+    if (exportPath != NULL) {
+        // E.1. The ring of exported render targets.
+        static const int exportRingSize = 3;
+        DmaBufRenderTarget targets[exportRingSize];
+        DmaBufFrame targetFrames[exportRingSize];
+        if (!dmaBufExportSupported(display)) {
+            return -1;
+        }
+        for (int idx = 0; idx < exportRingSize; idx++) {
+            if (!createDmaBufRenderTarget(display, renderImageWidth, renderImageHeight, &targets[idx])) {
+                return -1;
+            }
+            targetFrames[idx] = targets[idx].frame;
+        }
+        printf("Exporting %dx%d %s frames\n", renderImageWidth, renderImageHeight,
+               dmaBufFormatNames[targetFrames[0].format]);
+
+        // E.2. Wait for the consumer and send it the targets once.
+        int connection = acceptDmaBufConsumer(exportPath);
+        if (connection < 0 || !sendDmaBufFrames(connection, targetFrames, exportRingSize)) {
+            return -1;
+        }
+
+        glUseProgram(shader_program);
+        int offsetLocation = glGetUniformLocation(shader_program, "offset");
+
+        bool released[exportRingSize] = { true, true, true };
+        auto startTime = std::chrono::steady_clock::now();
+        int frame = 0;
+        for (; frame < streamFrames; frame++) {
+            int slot = frame % exportRingSize;
+
+            // E.3. A target still used by the consumer: wait for its return (the GPU waits for its fence).
+            bool connected = true;
+            while (!released[slot] && connected) {
+                int index;
+                int fence;
+                connected = receiveDmaBufFence(connection, &index, &fence);
+                if (connected && index >= 0 && index < exportRingSize) {
+                    waitDmaBufFence(display, fence);
+                    released[index] = true;
+                }
+            }
+            if (!connected) {
+                printf("The consumer disconnected after %d frames\n", frame);
+                break;
+            }
+
+            // E.4. Draw the frame into the target and announce it.
+            glBindFramebuffer(GL_FRAMEBUFFER, targets[slot].fbo);
+            glClearColor(0.0, 0.5, 0.5, 1.0);
+            glClear(GL_COLOR_BUFFER_BIT);
+            drawVideoFrame(frame);
+            glUniform1f(offsetLocation, -0.5f + (float)frame / streamFrames);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            released[slot] = false;
+            if (!sendDmaBufFence(connection, slot, createDmaBufFence(display))) {
+                break;
+            }
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        printf("Exported %d frames in %.3f s: %.2f fps\n", frame, seconds, frame / seconds);
+
+        // E.5. Closing the socket ends the consumer, the targets can go once it returned them.
+        shutdown(connection, SHUT_WR);
+        for (int idx = 0; idx < exportRingSize; idx++) {
+            int index;
+            int fence;
+            while (!released[idx] && receiveDmaBufFence(connection, &index, &fence)) {
+                waitDmaBufFence(display, fence);
+                if (index >= 0 && index < exportRingSize) {
+                    released[index] = true;
+                }
+            }
+        }
+        close(connection);
+        glFinish();
+        for (int idx = 0; idx < exportRingSize; idx++) {
+            destroyDmaBufRenderTarget(&targets[idx]);
+        }
+    }
+
+    // C. Consume: sample the frames of an exporting process and return each with a fence.
+    if (consumePath != NULL) {
+        // C.1. Receive and import the targets of the producer once.
+        static const int maxSharedFrames = 8;
+        DmaBufFrame sharedFrames[maxSharedFrames];
+        DmaBufTexture sharedTextures[maxSharedFrames];
+        int sharedCount = 0;
+        int connection = connectDmaBufProducer(consumePath);
+        if (connection < 0 || !receiveDmaBufFrames(connection, sharedFrames, maxSharedFrames, &sharedCount)) {
+            return -1;
+        }
+        for (int idx = 0; idx < sharedCount; idx++) {
+            if (!importDmaBufTexture(display, sharedFrames[idx], &sharedTextures[idx])) {
+                return -1;
+            }
+        }
+        unsigned int sharedProgram = createVideoProgram();
+        if (sharedProgram == 0) {
+            return -3;
+        }
+
+        // C.2. Every announced frame: GPU wait for the rendering, sample it, return it with the fence of the sampling.
+        /* An encoder would read the dma-buf here, drawing it into the pbuffer stands in for it. */
+        glUseProgram(sharedProgram);
+        int index;
+        int fence;
+        int consumed = 0;
+        int lastIndex = -1;
+        auto startTime = std::chrono::steady_clock::now();
+        while (receiveDmaBufFence(connection, &index, &fence)) {
+            if (index < 0 || index >= sharedCount) {
+                break;
+            }
+            waitDmaBufFence(display, fence);
+            refreshDmaBufTexture(&sharedTextures[index]);
+            glBindTexture(GL_TEXTURE_EXTERNAL_OES, sharedTextures[index].texture);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindTexture(GL_TEXTURE_EXTERNAL_OES, 0);
+
+            consumed++;
+            lastIndex = index;
+            if (!sendDmaBufFence(connection, index, createDmaBufFence(display))) {
+                break;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        printf("Consumed %d frames in %.3f s: %.2f fps\n", consumed, seconds, consumed / seconds);
+        close(connection);
+
+        // C.3. The last frame stays in the pbuffer for the read back of step 14.
+        if (lastIndex < 0) {
+            glClear(GL_COLOR_BUFFER_BIT);
+        }
+        glFinish();
+        glUseProgram(0);
+        glDeleteProgram(sharedProgram);
+        for (int idx = 0; idx < sharedCount; idx++) {
+            destroyDmaBufTexture(&sharedTextures[idx]);
+            closeDmaBufFrame(&sharedFrames[idx]);
+        }
+    }
+
+    // V. Video output: render every frame into a texture and hand it to the sink (GPU NV12 conversion + encoder).
+    if (encodePath != NULL) {
+        VideoSink* sink = createVideoSink(display, encodePath, encoderDevice, renderImageWidth, renderImageHeight,
+                                          encodeFps, encodeBitrate);
+        if (sink == NULL) {
+            return -1;
+        }
+
+        // V.1. The frame texture: the sink samples it.
+        unsigned int frameTexture;
+        unsigned int frameFbo;
+        glGenTextures(1, &frameTexture);
+        glBindTexture(GL_TEXTURE_2D, frameTexture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, renderImageWidth, renderImageHeight);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glGenFramebuffers(1, &frameFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, frameFbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, frameTexture, 0);
+
+        auto startTime = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < streamFrames; frame++) {
+            // V.2. Draw the frame (the sink changes the framebuffer, the viewport and the program).
+            glBindFramebuffer(GL_FRAMEBUFFER, frameFbo);
+            glViewport(0, 0, renderImageWidth, renderImageHeight);
+            glClearColor(0.0, 0.5, 0.5, 1.0);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glUseProgram(shader_program);
+            drawVideoFrame(frame);
+            glUniform1f(glGetUniformLocation(shader_program, "offset"), -0.5f + (float)frame / streamFrames);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+
+            // V.3. Queue it for the encoder.
+            videoSinkSubmit(sink, frameTexture);
+        }
+        destroyVideoSink(sink);
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        printf("Recorded %d frames in %.3f s: %.2f fps\n", streamFrames, seconds, streamFrames / seconds);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &frameFbo);
+        glDeleteTextures(1, &frameTexture);
+    }
+
     // 13. Do the draw
-    {
+    if (captureFrames == 0 && exportPath == NULL && consumePath == NULL && encodePath == NULL && !service) {
         glClearColor(0.0, 0.5, 0.5, 1.0);
         glClear(GL_COLOR_BUFFER_BIT);
 
         glUseProgram(shader_program);
+        drawVideoFrame(0);
 
         glDrawArrays(GL_TRIANGLES, 0, 3);
     }
 
     // 14. Read back rendered image.
     /* glReadPixels will wait for the draw to finish. */
-    {
+    if (captureFrames == 0 && exportPath == NULL && encodePath == NULL && !service) {
         // 14.1. Create a vector to store the pixel data.
         /* width * height * component count * pixel size */
         std::vector<uint8_t> pixels;
@@ -265,30 +1075,28 @@ int main(int argc, char **argv) {
         // 14.3. Read back the pixels (4 bytes per pixel) into the vector.
         glReadPixels(0, 0, renderImageWidth, renderImageHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
 
-        // 14.4. Write out the image to a ppm file.
-        {
-            std::ofstream file(outputFileName, std::ios::out | std::ios::binary);
-            // ppm header
-            file << "P6\n" << renderImageWidth << "\n" << renderImageHeight << "\n" << 255 << "\n";
-
-            // ppm binary pixel data
-            // As the image format is R8G8B8A8 one "pixel" size is 4 bytes (uint32_t)
-            uint32_t *row = (uint32_t*)pixels.data();
-
-            for (uint32_t y = 0; y < renderImageHeight; y++) {
-                for (uint32_t x = 0; x < renderImageWidth; x++) {
-                    // Only copy the RGB values (3)
-                    file.write((const char*)row, 3);
-                    row++;
-                }
-            }
-            file.close();
-        }
+        // 14.4. Write out the image ("out.ppm" or the "--capture-format" file).
+        std::string fileName = std::string(outputFileName) + "." + imageFileFormatNames[captureFormat];
+        std::vector<uint8_t> rgb;
+        writeImageFile(fileName.c_str(), captureFormat, pixels.data(), renderImageWidth, renderImageHeight, &rgb);
     }
 
     // XX. Destroy the shader program.
     glDeleteProgram(shader_program);
 
+    // XX. Release the imported video frames (the fences first: the GPU may still sample them).
+    if (videoProgram != 0) {
+        for (int idx = 0; idx < videoRingSize; idx++) {
+            if (videoFences[idx]) {
+                glClientWaitSync(videoFences[idx], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+                glDeleteSync(videoFences[idx]);
+            }
+            destroyDmaBufTexture(&videoTextures[idx]);
+            releaseDmaBufFrame(&videoFrames[idx]);
+        }
+        glDeleteProgram(videoProgram);
+    }
+
     // XX. Terminate EGL resources.
     eglTerminate(display);
 
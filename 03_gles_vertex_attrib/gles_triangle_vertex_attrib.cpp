@@ -7,6 +7,12 @@
  * Run:
  * $ ./gles_triangle_vertex_attrib
  *
+ * Options:
+ *  --vbo              Upload the vertices once into a static vertex buffer object
+ *                     instead of using a client side vertex array.
+ *  --vertex-bench N   Every frame draw N extra vertices from a client side array and
+ *                     from a static VBO, print the CPU time of both draws every second.
+ *
  * Dependencies:
  *  * C++11
  *  * GLFW 3.0+
@@ -35,10 +41,15 @@
  * OFTWARE.
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
 
-#include <GLFW/glfw3.h>
 #include <GLES3/gl3.h>
 
+#include "common/demo_context.h"
+
 const char* vertex_src = R"(#version 310 es
 precision highp float;
 
@@ -60,39 +71,20 @@ void main() {
 }
 )";
 
-static void ErrorCallbackGLFW(int error, const char* description) {
-    printf("Glfw Error %d: %s\n", error, description);
-}
-
 int main(int argc, char **argv) {
-    // 0. Add a method to report any GLFW errors.
-    glfwSetErrorCallback(ErrorCallbackGLFW);
-
-    // 1. Initialize the GLFW library.
-    if (!glfwInit()) {
-        return -1;
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    /* See the "01_gles_glfw" example for the GLFW steps. This also handles the
+     * "--headless" and "--frames N" command line options. */
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
     }
 
-    // 2. Add hints to use during context creation when a GLFW window is created.
-    // Here: require a GL ES 3.0 context.
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
-    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
-
-    // 3. Create window with graphics context
-    GLFWwindow* window = glfwCreateWindow(1024, 600, "GLDEMO", NULL, NULL);
-    if (window == NULL) {
-        return -2;
-    }
-
-    // 4. Activate the window (display it).
-    glfwMakeContextCurrent(window);
-
     // 5. Set the view port to match the window size.
     {
         int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
         glViewport(0, 0, display_w, display_h);
     }
 
@@ -172,22 +164,71 @@ int main(int argc, char **argv) {
         0.5, 0.5,
         0.0, -0.5
     };
-    {
-        // 10.1. Query the "aPos" vertex input attribute's position.
-        int aPosLoc = glGetAttribLocation(shader_program, "aPos");
+    bool useVbo = false;
+    int benchVertexCount = 0;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--vbo") == 0) {
+            useVbo = true;
+        } else if (strcmp(argv[idx], "--vertex-bench") == 0 && idx + 1 < argc) {
+            benchVertexCount = atoi(argv[++idx]) / 3 * 3;
+        }
+    }
+
+    // 10.1. Query the "aPos" vertex input attribute's position.
+    int aPosLoc = glGetAttribLocation(shader_program, "aPos");
 
-        // 10.2. Specify the vertex data for the "aPos": vec2.
-        glVertexAttribPointer(aPosLoc, 2, GL_FLOAT, GL_TRUE, 2 * sizeof(float), vertices);
+    unsigned int vbo = 0;
+    {
+        if (useVbo) {
+            // 10.2. Upload the vertices once into a static buffer object.
+            /* A client side array is copied by the driver on every draw call,
+             * the buffer object is uploaded only here. */
+            glGenBuffers(1, &vbo);
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+            // 10.3. Specify the vertex data for the "aPos": vec2 at the start of the buffer.
+            glVertexAttribPointer(aPosLoc, 2, GL_FLOAT, GL_TRUE, 2 * sizeof(float), (void*)0);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        } else {
+            // 10.2. Specify the vertex data for the "aPos": vec2.
+            glVertexAttribPointer(aPosLoc, 2, GL_FLOAT, GL_TRUE, 2 * sizeof(float), vertices);
+        }
 
-        // 10.3. Enable the usage of the vertex input array.
+        // 10.4. Enable the usage of the vertex input array.
         glEnableVertexAttribArray(aPosLoc);
     }
 
+    // B.1. Create the vertices of the benchmark ("--vertex-bench N").
+    /* Tiny triangles scattered over the screen: the cost is the vertex submission, not the fill. */
+    std::vector<float> benchVertices((size_t)benchVertexCount * 2);
+    unsigned int benchVbo = 0;
+    if (benchVertexCount > 0) {
+        for (int tri = 0; tri < benchVertexCount / 3; tri++) {
+            float x = (float)rand() / RAND_MAX * 1.8f - 0.9f;
+            float y = (float)rand() / RAND_MAX * 1.8f - 0.9f;
+            float* out = &benchVertices[tri * 6];
+            out[0] = x;          out[1] = y;
+            out[2] = x + 0.004f; out[3] = y;
+            out[4] = x;          out[5] = y + 0.004f;
+        }
+
+        // B.2. The same vertices in a static buffer object.
+        glGenBuffers(1, &benchVbo);
+        glBindBuffer(GL_ARRAY_BUFFER, benchVbo);
+        glBufferData(GL_ARRAY_BUFFER, benchVertices.size() * sizeof(float), benchVertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    double benchClientSeconds = 0.0;
+    double benchVboSeconds = 0.0;
+    int benchDraws = 0;
+    double benchPrintTime = demoGetTime(&demo);
+
     // X. Create a render loop.
-    while (!glfwWindowShouldClose(window))
+    while (!demoShouldClose(&demo))
     {
         // X. Poll and handle events (inputs, window resize, etc.)
-        glfwPollEvents();
+        demoPollEvents(&demo);
 
         // X. Clear the color image.
         glClearColor(0.0, 0.3, 0.3, 1.0f);
@@ -199,14 +240,50 @@ int main(int argc, char **argv) {
         // X. Draw the triangles.
         glDrawArrays(GL_TRIANGLES, 0, 3);
 
+        // B.3. Draw the benchmark vertices from the client side array, then from the VBO.
+        /* Only the CPU side of the draw call is measured (the driver copies the client array
+         * during the call), the GPU work of both draws is the same. */
+        if (benchVertexCount > 0) {
+            double start = demoGetTime(&demo);
+            glVertexAttribPointer(aPosLoc, 2, GL_FLOAT, GL_TRUE, 2 * sizeof(float), benchVertices.data());
+            glDrawArrays(GL_TRIANGLES, 0, benchVertexCount);
+            double clientEnd = demoGetTime(&demo);
+
+            glBindBuffer(GL_ARRAY_BUFFER, benchVbo);
+            glVertexAttribPointer(aPosLoc, 2, GL_FLOAT, GL_TRUE, 2 * sizeof(float), (void*)0);
+            glDrawArrays(GL_TRIANGLES, 0, benchVertexCount);
+            double vboEnd = demoGetTime(&demo);
+
+            benchClientSeconds += clientEnd - start;
+            benchVboSeconds += vboEnd - clientEnd;
+            benchDraws++;
+
+            // B.4. Restore the vertex array of the triangle.
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glVertexAttribPointer(aPosLoc, 2, GL_FLOAT, GL_TRUE, 2 * sizeof(float), useVbo ? (void*)0 : vertices);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+            if (vboEnd - benchPrintTime >= 1.0) {
+                printf("Vertex bench (%d vertices): client array %.3f ms/draw | VBO %.3f ms/draw\n",
+                       benchVertexCount, benchClientSeconds * 1000.0 / benchDraws,
+                       benchVboSeconds * 1000.0 / benchDraws);
+                benchClientSeconds = 0.0;
+                benchVboSeconds = 0.0;
+                benchDraws = 0;
+                benchPrintTime = vboEnd;
+            }
+        }
+
         // X. Swap the fron-back buffers to display the rendered image in the window.
-        glfwSwapBuffers(window);
+        demoSwapBuffers(&demo);
     }
 
-    // XX. Destroy the window.
-    glfwDestroyWindow(window);
-    // XX. Destroy the GLFW.
-    glfwTerminate();
+    // XX. Delete the vertex buffers.
+    glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &benchVbo);
+
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
 
     return 0;
 }
@@ -7,6 +7,48 @@
  * Run:
  * $ ./gles_texture
  *
+ * Use the ETC2 compressed image (converted at build time by "tools/ktx_etc2")
+ * instead of the JPEG, to compare the texture memory and frame times:
+ * $ ./gles_texture --ktx --gpu-timer
+ *
+ * Upload the positions and texture coordinates once into a static vertex buffer
+ * object instead of using client side vertex arrays:
+ * $ ./gles_texture --vbo
+ *
+ * Take the ETC2 image from the memory mapped asset bundle (see common/asset_bundle.h),
+ * it is uploaded straight from the mapped file before the first frame:
+ * $ ./gles_texture --bundle demo_assets.bundle
+ *
+ * Draw one small triangle per material (the 81 images of the atlas built by "tools/texture_atlas",
+ * "--materials N" selects the count) from the layers of one array texture with a single instanced
+ * draw, the layer and the rectangle of the material are per instance attributes (see
+ * common/texture_atlas.h). "--separate-textures" binds one texture per material and draws them
+ * one by one to compare:
+ * $ ./gles_texture --atlas demo_textures.atlas --materials 1000 --gpu-timer
+ * $ ./gles_texture --atlas demo_textures.atlas --materials 1000 --separate-textures --gpu-timer
+ *
+ * Stream the mip levels of "--residency N" textures (a 4x4 page of them on the screen, it moves and
+ * the triangles pulse) in and out within "--texture-budget KiB", uploading at most "--upload-budget KiB"
+ * per frame (see common/texture_residency.h):
+ * $ ./gles_texture --residency 64 --texture-budget 3000 --upload-budget 512
+ *
+ * The filtering is the state of a sampler object from the shared sampler cache (see
+ * common/sampler_cache.h), not of the textures: "--filter", "--anisotropy", "--lod-bias"
+ * and "--min-lod" select it for every texture of the demo:
+ * $ ./gles_texture --filter point-mip --lod-bias 1.5
+ *
+ * Stream a generated "--video WxH" frame (in the "--video-format rgb|rgba|bgra" layout) into the texture
+ * every frame. Before the first frame every upload path (glTexImage2D or glTexStorage2D + glTexSubImage2D,
+ * client memory or PBO ring, transfer format, unpack alignment) is measured and the fastest one is used
+ * (see common/texture_upload.h); "--upload-path NAME" forces one and "--upload-benchmark" prints the table:
+ * $ ./gles_texture --video 1280x720 --video-format rgb --upload-benchmark
+ *
+ * Rebuild the mip levels of every video frame with glGenerateMipmap ("driver"), the compute generator
+ * which writes 4 levels per dispatch ("compute", see common/compute_resample.h) or the faster of the two
+ * measured at the start ("auto"). The compute generator needs an immutable RGBA8 texture: with the "auto"
+ * upload path the fastest "storage-*-rgba-*" path is used:
+ * $ ./gles_texture --video 1280x720 --video-format rgba --video-mips auto --gpu-timer
+ *
  * Dependencies:
  *  * C++11
  *  * GLFW 3.0+
@@ -35,13 +77,31 @@
  * OFTWARE.
  */
 #include <libgen.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
 
-#include <GLFW/glfw3.h>
 #include <GLES3/gl3.h>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include "common/asset_bundle.h"
+#include "common/compute_resample.h"
+#include "common/demo_context.h"
+#include "common/gpu_memory.h"
+#include "common/gpu_timer.h"
+#include "common/program_cache.h"
+#include "common/sampler_cache.h"
+#include "common/startup_profile.h"
+#include "common/texture_atlas.h"
+#include "common/texture_loader.h"
+#include "common/texture_residency.h"
+#include "common/texture_upload.h"
+
+// Materials on the screen in the "--residency" mode (a 4x4 grid).
+#define RESIDENCY_PAGE 16
 
 const char* vertex_src = R"(#version 310 es
 precision highp float;
@@ -65,48 +125,70 @@ out vec4 outColor;
 
 uniform vec3 uColor;
 uniform sampler2D image;
+uniform float lodBias;
 
 void main() {
-    outColor = vec4(uColor, 1.0f) * texture(image, fTex /** vec2(2.0, 2.0)*/);
+    outColor = vec4(uColor, 1.0f) * texture(image, fTex /** vec2(2.0, 2.0)*/, lodBias);
 }
 )";
 
-static void ErrorCallbackGLFW(int error, const char* description) {
-    printf("Glfw Error %d: %s\n", error, description);
+// Atlas mode: one triangle per material. The instance is placed in a grid cell (xy: offset, z: scale, w: layer),
+// the texture coords are mapped into the rectangle of the material (xy: offset, zw: scale).
+const char* atlas_vertex_src = R"(#version 310 es
+precision highp float;
+
+layout(location = 0) in vec2 aPos;
+layout(location = 1) in vec2 aTex;
+layout(location = 2) in vec4 aInstance;
+layout(location = 3) in vec4 aRect;
+out vec3 fTex;
+
+void main() {
+    gl_Position = vec4(aPos * aInstance.z + aInstance.xy, 0.0, 1.0);
+    fTex = vec3(aRect.xy + aTex * aRect.zw, aInstance.w);
 }
+)";
 
-int main(int argc, char **argv) {
-    // 0. Add a method to report any GLFW errors.
-    glfwSetErrorCallback(ErrorCallbackGLFW);
+// "SEPARATE_TEXTURES": one 2D texture per material instead of the layers of the array texture.
+const char* atlas_fragment_src = R"(#version 310 es
+precision highp float;
 
-    // 1. Initialize the GLFW library.
-    if (!glfwInit()) {
-        return -1;
-    }
+in vec3 fTex;
+out vec4 outColor;
 
-    // 2. Add hints to use during context creation when a GLFW window is created.
-    // Here: require a GL ES 3.0 context.
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
-    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
-
-    // 3. Create window with graphics context
-    GLFWwindow* window = glfwCreateWindow(1024, 600, "GLDEMO", NULL, NULL);
-    if (window == NULL) {
-        return -2;
-    }
+#ifdef SEPARATE_TEXTURES
+uniform highp sampler2D image;
+#else
+uniform highp sampler2DArray image;
+#endif
+
+void main() {
+#ifdef SEPARATE_TEXTURES
+    outColor = texture(image, fTex.xy);
+#else
+    outColor = texture(image, fTex);
+#endif
+}
+)";
 
-    // 4. Activate the window (display it).
-    glfwMakeContextCurrent(window);
+int main(int argc, char **argv) {
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    /* See the "01_gles_glfw" example for the GLFW steps. This also handles the
+     * "--headless" and "--frames N" command line options. */
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
 
     // 5. Set the view port to match the window size.
     {
         int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
         glViewport(0, 0, display_w, display_h);
     }
 
+    startupPhase("shaders");
     // 6. Create the vertex shader.
     unsigned int vertex_shader;
     {
@@ -177,20 +259,37 @@ int main(int argc, char **argv) {
         glDeleteShader(fragment_shader);
     }
 
+    startupPhase("vertex buffers");
     // 10. Specify the vertices.
     const float vertices[] = {
         0.0, 0.5,
         0.5, -0.5,
         -0.5, -0.5,
     };
+    bool useVbo = false;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--vbo") == 0) {
+            useVbo = true;
+        }
+    }
+
+    // 10.1. Create the static vertex buffer ("--vbo"): the positions followed by the texture coordinates.
+    /* The texture coordinates are added in step 13.2. A client side array would be copied on every draw call. */
+    unsigned int vbo = 0;
+    if (useVbo) {
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, 2 * sizeof(vertices), NULL, GL_STATIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+    }
     {
-        // 10.1. Query the "aPos" vertex input attribute's position.
+        // 10.2. Query the "aPos" vertex input attribute's position.
         int aPosLoc = glGetAttribLocation(shader_program, "aPos");
 
-        // 10.2. Specify the vertex data for the "aPos": vec2.
-        glVertexAttribPointer(aPosLoc, 2, GL_FLOAT, GL_TRUE, 2 * sizeof(float), vertices);
+        // 10.3. Specify the vertex data for the "aPos": vec2 (from the start of the VBO if bound).
+        glVertexAttribPointer(aPosLoc, 2, GL_FLOAT, GL_TRUE, 2 * sizeof(float), useVbo ? (void*)0 : vertices);
 
-        // 10.3. Enable the usage of the vertex input array.
+        // 10.4. Enable the usage of the vertex input array.
         glEnableVertexAttribArray(aPosLoc);
     }
 
@@ -200,27 +299,42 @@ int main(int argc, char **argv) {
         uniformColorLoc = glGetUniformLocation(shader_program, "uColor");
     }
 
+    startupPhase("textures");
     // 12. Create texture
+    /* The image is decoded and uploaded in the background (see common/texture_loader.h),
+     * until it is ready a 1x1 white placeholder texture is used. */
+    TextureLoader* textureLoader;
+    int textureRequest;
     unsigned int texture;
+    std::string assetDir;
     {
         char path[1024];
         char *dir = dirname(argv[0]);
+        assetDir = dir;
         strcpy(path, dir);
         strcat(path, "/kitten_10.jpg");
 
-        int width, height, nrChannels;
-        // To use OpenGL UV coord system:
-        stbi_set_flip_vertically_on_load(true);
-        unsigned char *data = stbi_load(path, &width, &height, &nrChannels, 0);
-        printf("Image %s WxH: %dx%d\n", path, width, height);
+        const char* bundlePath = NULL;
+        for (int idx = 1; idx < argc; idx++) {
+            if (strcmp(argv[idx], "--ktx") == 0) {
+                strcpy(path + strlen(path) - 4, ".ktx");
+            } else if (strcmp(argv[idx], "--bundle") == 0 && idx + 1 < argc) {
+                bundlePath = argv[++idx];
+            }
+        }
+
+        // 12.1. Start loading the image on the worker threads (not needed with a bundle).
+        textureLoader = createTextureLoader(2);
+        textureRequest = bundlePath == NULL ? textureLoaderRequest(textureLoader, path) : -1;
+
+        // 12.2. Create the placeholder texture.
+        const unsigned char white[] = { 255, 255, 255, 255 };
         glGenTextures(1, &texture);
 
         glBindTexture(GL_TEXTURE_2D, texture);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+        /* The sampler of step 14.2 has a mip filter: the only level must be the last one to be complete. */
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
 /*
         float pixels[] = {
             0.0f, 0.0f, 0.0f,   1.0f, 1.0f, 1.0f,
@@ -228,11 +342,21 @@ int main(int argc, char **argv) {
         };
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 2, 2, 0, GL_RGB, GL_FLOAT, pixels);
 */
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        stbi_image_free(data);
-
         glBindTexture(GL_TEXTURE_2D, 0);
+
+        // 12.3. "--bundle FILE": upload the compressed image from the mapped bundle (no decode, no copy).
+        AssetBundle bundle;
+        double bundleStart = demoGetTime(&demo);
+        unsigned int bundleTexture;
+        if (bundlePath != NULL && openAssetBundle(&bundle, bundlePath)) {
+            if (uploadBundleTexture(&bundle, "kitten", &bundleTexture)) {
+                glDeleteTextures(1, &texture);
+                gpuMemoryReleaseTextures(1, &texture);
+                texture = bundleTexture;
+                printf("Bundle: image uploaded in %.3f ms\n", (demoGetTime(&demo) - bundleStart) * 1000.0);
+            }
+            closeAssetBundle(&bundle);
+        }
     }
 
     // 13. Texture coordinates.
@@ -251,8 +375,15 @@ int main(int argc, char **argv) {
         // 13.1.
         int aTexLoc = glGetAttribLocation(shader_program, "aTex");
 
-        // 13.2.
-        glVertexAttribPointer(aTexLoc, 2, GL_FLOAT, GL_TRUE, 2 * sizeof(float), textureCoord);
+        // 13.2. With a VBO the coordinates are stored after the positions.
+        if (useVbo) {
+            static_assert(sizeof(textureCoord) == sizeof(vertices), "the VBO has room for one vec2 per vertex");
+            glBufferSubData(GL_ARRAY_BUFFER, sizeof(vertices), sizeof(textureCoord), textureCoord);
+            glVertexAttribPointer(aTexLoc, 2, GL_FLOAT, GL_TRUE, 2 * sizeof(float), (void*)sizeof(vertices));
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        } else {
+            glVertexAttribPointer(aTexLoc, 2, GL_FLOAT, GL_TRUE, 2 * sizeof(float), textureCoord);
+        }
 
         // 10.3. Enable the usage of the vertex input array.
         glEnableVertexAttribArray(aTexLoc);
@@ -268,6 +399,22 @@ int main(int argc, char **argv) {
         /* After this the GL_TEXTURE0 texture unit is bound to the "texture" object. */
         glBindTexture(GL_TEXTURE_2D, texture);
 
+        // 14.2. Bind the sampler object of the filter options to the texture unit 1.
+        /* Its filter and wrap state override the parameters of every texture bound to the unit,
+         * the atlas draws clamp to the edge of the layers. */
+        SamplerDesc samplerDesc;
+        samplerFilterDesc("trilinear", &samplerDesc);
+        float lodBias = 0.0f;
+        if (!parseSamplerOptions(argc, argv, &samplerDesc, &lodBias)) {
+            return -1;
+        }
+        for (int idx = 1; idx < argc; idx++) {
+            if (strcmp(argv[idx], "--atlas") == 0) {
+                samplerDesc.wrap = GL_CLAMP_TO_EDGE;
+            }
+        }
+        glBindSampler(1, getCachedSampler(samplerDesc));
+
         // 14.3. No need to keep the active texture unit.
         glActiveTexture(0);
 
@@ -279,16 +426,385 @@ int main(int argc, char **argv) {
 
         // 14.x. Set the sampler's "value" to the texture unit 1.
         glUniform1i(imageSamplerLoc, 0 + 1);
+        glUniform1f(glGetUniformLocation(shader_program, "lodBias"), lodBias);
 
         // Disable the program for now.
         glUseProgram(0);
     }
 
+    startupPhase("atlas");
+    // A.1. "--atlas FILE": the materials are the entries of the atlas (see common/texture_atlas.h).
+    const char* atlasPath = NULL;
+    int materialCount = 0;
+    bool separateTextures = false;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--atlas") == 0 && idx + 1 < argc) {
+            atlasPath = argv[++idx];
+        } else if (strcmp(argv[idx], "--materials") == 0 && idx + 1 < argc) {
+            materialCount = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--separate-textures") == 0) {
+            separateTextures = true;
+        }
+    }
+
+    TextureAtlas atlas;
+    unsigned int atlasProgram = 0;
+    unsigned int atlasVao = 0;
+    unsigned int atlasBuffers[2] = { 0, 0 };
+    unsigned int atlasTexture = 0;
+    std::vector<unsigned int> entryTextures;
+    if (atlasPath != NULL) {
+        if (!loadTextureAtlas(&atlas, atlasPath)) {
+            return -1;
+        }
+        if (materialCount == 0) {
+            materialCount = (int)atlas.entries.size();
+        }
+        if (materialCount < 1 || materialCount > 1024 * 1024) {
+            printf("Invalid material count (valid range: 1-1048576)\n");
+            return -1;
+        }
+
+        // A.2. The program variant of the texture type.
+        std::string fragmentSrc = atlas_fragment_src;
+        if (separateTextures) {
+            fragmentSrc.insert(fragmentSrc.find('\n') + 1, "#define SEPARATE_TEXTURES\n");
+        }
+        atlasProgram = createCachedProgram(atlas_vertex_src, fragmentSrc.c_str());
+        if (atlasProgram == 0) {
+            return -1;
+        }
+        glUseProgram(atlasProgram);
+        glUniform1i(glGetUniformLocation(atlasProgram, "image"), 0 + 1);
+        glUseProgram(0);
+
+        // A.3. One array texture with every layer, or one texture per entry to compare.
+        if (separateTextures) {
+            for (const AtlasEntry& entry : atlas.entries) {
+                entryTextures.push_back(uploadAtlasEntryTexture(&atlas, entry));
+            }
+        } else {
+            atlasTexture = uploadTextureAtlas(&atlas);
+        }
+
+        // A.4. The instances in a grid, material "idx" is the entry "idx % entryCount".
+        /* The separate textures cover their entry, their rectangle is the whole texture. */
+        int columns = 1;
+        while (columns * columns < materialCount) {
+            columns++;
+        }
+        std::vector<float> instances(materialCount * 8);
+        for (int idx = 0; idx < materialCount; idx++) {
+            float* instance = &instances[idx * 8];
+            const AtlasEntry& entry = atlas.entries[idx % atlas.entries.size()];
+            instance[0] = -1.0f + (idx % columns + 0.5f) * 2.0f / columns;
+            instance[1] = 1.0f - (idx / columns + 0.5f) * 2.0f / columns;
+            instance[2] = 2.0f / columns;
+            instance[3] = (float)entry.layer;
+            if (separateTextures) {
+                instance[4] = instance[5] = 0.0f;
+                instance[6] = instance[7] = 1.0f;
+            } else {
+                atlasEntryRect(&atlas, entry, &instance[4]);
+            }
+        }
+
+        // A.5. VAO with the triangle (VBO) and the per instance attributes.
+        glGenVertexArrays(1, &atlasVao);
+        glGenBuffers(2, atlasBuffers);
+        glBindVertexArray(atlasVao);
+
+        glBindBuffer(GL_ARRAY_BUFFER, atlasBuffers[0]);
+        glBufferData(GL_ARRAY_BUFFER, 2 * sizeof(vertices), NULL, GL_STATIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(vertices), sizeof(textureCoord), textureCoord);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)sizeof(vertices));
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+
+        glBindBuffer(GL_ARRAY_BUFFER, atlasBuffers[1]);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(float), instances.data(), GL_STATIC_DRAW);
+        for (int attrib = 2; attrib < 4; attrib++) {
+            glVertexAttribPointer(attrib, 4, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)((attrib - 2) * 4 * sizeof(float)));
+            glVertexAttribDivisor(attrib, 1);
+            glEnableVertexAttribArray(attrib);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        printf("Atlas: %d materials from %d entries in %u layers, %s\n", materialCount, (int)atlas.entries.size(),
+               atlas.header.layerCount, separateTextures ? "one texture per material" : "one array texture");
+    }
+    double atlasSubmitSeconds = 0.0;
+
+    startupPhase("residency");
+    // R.1. "--residency N": N materials which stream their mip levels within "--texture-budget KiB",
+    // uploading at most "--upload-budget KiB" per frame (see common/texture_residency.h).
+    int residencyCount = 0;
+    size_t textureBudget = 16 * 1024 * 1024;
+    size_t residencyUploadBudget = 2 * 1024 * 1024;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--residency") == 0 && idx + 1 < argc) {
+            residencyCount = atoi(argv[++idx]);
+            if (residencyCount < 1 || residencyCount > 4096) {
+                printf("Invalid residency texture count (valid range: 1-4096)\n");
+                return -1;
+            }
+        } else if (strcmp(argv[idx], "--texture-budget") == 0 && idx + 1 < argc) {
+            textureBudget = (size_t)atoi(argv[++idx]) * 1024;
+        } else if (strcmp(argv[idx], "--upload-budget") == 0 && idx + 1 < argc) {
+            residencyUploadBudget = (size_t)atoi(argv[++idx]) * 1024;
+        }
+    }
+    if (residencyCount > 0 && atlasPath != NULL) {
+        printf("The texture residency can't be combined with the atlas\n");
+        return -1;
+    }
+
+    TextureResidency residency;
+    std::vector<int> residentTextures;
+    unsigned int residencyProgram = 0;
+    unsigned int residencyVao = 0;
+    unsigned int residencyBuffers[2] = { 0, 0 };
+    if (residencyCount > 0) {
+        // R.2. The separate texture variant of the atlas program.
+        std::string fragmentSrc = atlas_fragment_src;
+        fragmentSrc.insert(fragmentSrc.find('\n') + 1, "#define SEPARATE_TEXTURES\n");
+        residencyProgram = createCachedProgram(atlas_vertex_src, fragmentSrc.c_str());
+        if (residencyProgram == 0) {
+            return -1;
+        }
+        glUseProgram(residencyProgram);
+        glUniform1i(glGetUniformLocation(residencyProgram, "image"), 0 + 1);
+        glUseProgram(0);
+
+        // R.3. The materials cycle over the images of the demo: small and large JPEG, ETC2.
+        static const char* images[] = { "/kitten_25.jpg", "/kitten_10.jpg", "/kitten_10.ktx" };
+        initTextureResidency(&residency, textureLoader, textureBudget, residencyUploadBudget);
+        for (int idx = 0; idx < residencyCount; idx++) {
+            residentTextures.push_back(textureResidencyAdd(&residency, (assetDir + images[idx % 3]).c_str()));
+        }
+
+        // R.4. VAO with the triangle and one instance, the instance buffer is rewritten for every draw.
+        glGenVertexArrays(1, &residencyVao);
+        glGenBuffers(2, residencyBuffers);
+        glBindVertexArray(residencyVao);
+
+        glBindBuffer(GL_ARRAY_BUFFER, residencyBuffers[0]);
+        glBufferData(GL_ARRAY_BUFFER, 2 * sizeof(vertices), NULL, GL_STATIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(vertices), sizeof(textureCoord), textureCoord);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)sizeof(vertices));
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+
+        glBindBuffer(GL_ARRAY_BUFFER, residencyBuffers[1]);
+        glBufferData(GL_ARRAY_BUFFER, RESIDENCY_PAGE * 8 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+        for (int attrib = 2; attrib < 4; attrib++) {
+            glVertexAttribPointer(attrib, 4, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)((attrib - 2) * 4 * sizeof(float)));
+            glVertexAttribDivisor(attrib, 1);
+            glEnableVertexAttribArray(attrib);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        printf("Residency: %d textures, budget: %zu KiB, uploads: %zu KiB/frame\n", residencyCount,
+               textureBudget / 1024, residencyUploadBudget / 1024);
+    }
+    double residencyReport = 0.0;
+
+    startupPhase("video stream");
+    // V.1. "--video WxH": the frame format, the size and the upload path options.
+    int videoWidth = 0;
+    int videoHeight = 0;
+    TextureUploadFormat videoFormat = TEXTURE_UPLOAD_RGB;
+    const char* uploadPathName = "auto";
+    bool uploadBenchmark = false;
+    const char* videoMipsName = NULL;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--video") == 0 && idx + 1 < argc) {
+            if (sscanf(argv[++idx], "%dx%d", &videoWidth, &videoHeight) != 2 || videoWidth <= 0 || videoHeight <= 0) {
+                printf("Invalid video size '%s' (WxH)\n", argv[idx]);
+                return -1;
+            }
+        } else if (strcmp(argv[idx], "--video-format") == 0 && idx + 1 < argc) {
+            idx++;
+            int format = 0;
+            while (format < TEXTURE_UPLOAD_FORMAT_COUNT && strcmp(argv[idx], textureUploadFormatNames[format]) != 0) {
+                format++;
+            }
+            if (format == TEXTURE_UPLOAD_FORMAT_COUNT) {
+                printf("Invalid video format '%s' (rgb, rgba, bgra)\n", argv[idx]);
+                return -1;
+            }
+            videoFormat = (TextureUploadFormat)format;
+        } else if (strcmp(argv[idx], "--upload-path") == 0 && idx + 1 < argc) {
+            uploadPathName = argv[++idx];
+        } else if (strcmp(argv[idx], "--upload-benchmark") == 0) {
+            uploadBenchmark = true;
+        } else if (strcmp(argv[idx], "--video-mips") == 0 && idx + 1 < argc) {
+            videoMipsName = argv[++idx];
+        }
+    }
+
+    // V.2. Select the mipmap generator (measure both with "auto"), the upload path (measure every candidate
+    // with "auto") and create the stream texture.
+    StreamTexture videoStream;
+    std::vector<uint8_t> videoPixels;
+    videoStream.texture = 0;
+    ComputeMipGenerator videoMips;
+    ResamplePath videoMipsPath = RESAMPLE_DRIVER;
+    int videoLevels = 1;
+    if (videoWidth > 0) {
+        if (videoMipsName != NULL) {
+            bool automatic = strcmp(videoMipsName, "auto") == 0;
+            if (!automatic && strcmp(videoMipsName, "compute") != 0 && strcmp(videoMipsName, "driver") != 0) {
+                printf("Invalid video mipmap generator '%s' (driver, compute or auto)\n", videoMipsName);
+                return -1;
+            }
+            if (strcmp(videoMipsName, "driver") != 0) {
+                bool compute = initComputeMipGenerator(&videoMips);
+                if (!compute && !automatic) {
+                    return -3;
+                }
+                videoMipsPath = compute ? RESAMPLE_COMPUTE : RESAMPLE_DRIVER;
+                if (compute && automatic) {
+                    ResampleBenchmark benchmark;
+                    videoMipsPath = selectMipmapPath(&videoMips, videoWidth, videoHeight, &benchmark);
+                    printf("Mipmap benchmark: glGenerateMipmap %.3f ms, compute %.3f ms -> %s\n", benchmark.driverMs,
+                           benchmark.computeMs, resamplePathNames[videoMipsPath]);
+                }
+                if (compute && videoMipsPath != RESAMPLE_COMPUTE) {
+                    destroyComputeMipGenerator(&videoMips);
+                }
+            }
+            videoLevels = mipLevelCount(videoWidth, videoHeight);
+        }
+
+        TextureUploadPath uploadPath;
+        std::vector<TextureUploadResult> uploadResults;
+        if (strcmp(uploadPathName, "auto") == 0 || uploadBenchmark) {
+            uploadPath = selectTextureUploadPath(videoWidth, videoHeight, videoFormat, &uploadResults);
+        }
+        if (strcmp(uploadPathName, "auto") != 0 && !parseTextureUploadPath(uploadPathName, &uploadPath)) {
+            return -1;
+        }
+
+        // V.2.1. The compute mipmaps write the levels as images: immutable RGBA8 storage.
+        if (videoMipsPath == RESAMPLE_COMPUTE && (!uploadPath.texStorage || uploadPath.format != TEXTURE_UPLOAD_RGBA)) {
+            if (strcmp(uploadPathName, "auto") != 0) {
+                printf("The compute mipmaps need a storage-*-rgba-* upload path\n");
+                return -1;
+            }
+            double bestMs = 0.0;
+            for (const TextureUploadResult& result : uploadResults) {
+                if (result.path.texStorage && result.path.format == TEXTURE_UPLOAD_RGBA
+                    && (bestMs == 0.0 || result.msPerFrame < bestMs)) {
+                    uploadPath = result.path;
+                    bestMs = result.msPerFrame;
+                }
+            }
+        }
+
+        if (uploadBenchmark) {
+            printf("Upload of %dx%d %s frames:\n", videoWidth, videoHeight, textureUploadFormatNames[videoFormat]);
+            for (const TextureUploadResult& result : uploadResults) {
+                printf("  %-24s %8.3f ms/frame %7.2f GB/s\n", textureUploadPathName(result.path).c_str(),
+                       result.msPerFrame, result.gigabytesPerSecond);
+            }
+        }
+
+        if (!initStreamTexture(&videoStream, videoWidth, videoHeight, videoFormat, uploadPath, videoLevels)) {
+            return -1;
+        }
+        printf("Video: %dx%d %s frames, upload path: %s\n", videoWidth, videoHeight,
+               textureUploadFormatNames[videoFormat], textureUploadPathName(uploadPath).c_str());
+        if (videoLevels > 1) {
+            printf("Video mipmaps: %d levels (%s)\n", videoLevels,
+                   videoMipsPath == RESAMPLE_COMPUTE ? "compute" : "glGenerateMipmap");
+        }
+
+        // V.3. One diagonal gradient frame of double height: every frame starts one row further.
+        int bytes = videoFormat == TEXTURE_UPLOAD_RGB ? 3 : 4;
+        videoPixels.resize((size_t)videoWidth * videoHeight * 2 * bytes);
+        for (int y = 0; y < videoHeight * 2; y++) {
+            for (int x = 0; x < videoWidth; x++) {
+                uint8_t* pixel = &videoPixels[((size_t)y * videoWidth + x) * bytes];
+                pixel[0] = (uint8_t)(x * 255 / videoWidth);
+                pixel[1] = (uint8_t)((x + y) * 2);
+                pixel[2] = (uint8_t)(y * 255 / (videoHeight * 2));
+                if (bytes == 4) {
+                    pixel[3] = 255;
+                }
+            }
+        }
+    }
+
+    // T.1. Create the GPU timer for the per-pass timing ("--gpu-timer" options).
+    GpuTimer gpuTimer;
+    initGpuTimer(&gpuTimer, argc, argv);
+
     // X. Create a render loop.
-    while (!glfwWindowShouldClose(window))
+    while (!demoShouldClose(&demo))
     {
         // X. Poll and handle events (inputs, window resize, etc.)
-        glfwPollEvents();
+        demoPollEvents(&demo);
+
+        // T.2. Collect the GPU times of the previous frames.
+        gpuTimerBeginFrame(&gpuTimer);
+
+        // X. Switch to the loaded texture as soon as its upload is finished (does not block).
+        if (textureRequest >= 0) {
+            unsigned int loadedTexture;
+            TextureLoadStatus status = textureLoaderPoll(textureLoader, textureRequest, &loadedTexture);
+            if (status == TEXTURE_READY) {
+                printf("Image ready after %d frames, texture memory: %zu bytes\n",
+                       demo.frameCount, textureLoaderMemorySize(textureLoader, textureRequest));
+
+                if (videoStream.texture == 0) {
+                    glActiveTexture(GL_TEXTURE0 + 1);
+                    glBindTexture(GL_TEXTURE_2D, loadedTexture);
+                    glActiveTexture(GL_TEXTURE0);
+                }
+
+                glDeleteTextures(1, &texture);
+                gpuMemoryReleaseTextures(1, &texture);
+                texture = loadedTexture;
+            }
+            if (status != TEXTURE_PENDING) {
+                textureRequest = -1;
+            }
+        }
+
+        // V.4. Upload the next video frame and sample it instead of the image.
+        if (videoStream.texture != 0) {
+            gpuTimerBegin(&gpuTimer, "upload");
+            int row = demo.frameCount % videoHeight;
+            int bytes = videoFormat == TEXTURE_UPLOAD_RGB ? 3 : 4;
+            streamTextureUpload(&videoStream, &videoPixels[(size_t)row * videoWidth * bytes]);
+            gpuTimerEnd(&gpuTimer);
+
+            // V.5. The mip levels of the new frame.
+            if (videoLevels > 1) {
+                gpuTimerBegin(&gpuTimer, "mipmaps");
+                if (videoMipsPath == RESAMPLE_COMPUTE) {
+                    computeGenerateMipmap(&videoMips, videoStream.texture, videoWidth, videoHeight, videoLevels);
+                } else {
+                    glBindTexture(GL_TEXTURE_2D, videoStream.texture);
+                    glGenerateMipmap(GL_TEXTURE_2D);
+                    glBindTexture(GL_TEXTURE_2D, 0);
+                }
+                gpuTimerEnd(&gpuTimer);
+            }
+
+            glActiveTexture(GL_TEXTURE0 + 1);
+            glBindTexture(GL_TEXTURE_2D, videoStream.texture);
+            glActiveTexture(GL_TEXTURE0);
+        }
+
+        gpuTimerBegin(&gpuTimer, "draw");
 
         // X. Clear the color image.
         glClearColor(0.0, 0.3, 0.3, 1.0f);
@@ -301,16 +817,141 @@ int main(int argc, char **argv) {
         glUniform3f(uniformColorLoc, 1.0, 1.0, 1.0);
 
         // X. Draw the triangles.
-        glDrawArrays(GL_TRIANGLES, 0, 3);
+        if (residencyCount > 0) {
+            // R.5. A 4x4 page of the materials is on the screen, it moves half a page every 2 seconds
+            // (the other half stays: recently used) and the triangles pulse (the needed levels change).
+            double time = demoAnimationTime(&demo);
+            int first = (int)(time / 2.0) * RESIDENCY_PAGE / 2;
+            std::vector<float> instances(RESIDENCY_PAGE * 8);
+            for (int slot = 0; slot < RESIDENCY_PAGE; slot++) {
+                float* instance = &instances[slot * 8];
+                float pulse = 0.5f + 0.5f * (float)sin(time * 1.3 + slot);
+                instance[0] = -1.0f + (slot % 4 + 0.5f) * 0.5f;
+                instance[1] = 1.0f - (slot / 4 + 0.5f) * 0.5f;
+                instance[2] = 0.5f * (0.2f + 0.8f * pulse);
+                instance[3] = 0.0f;
+                instance[4] = instance[5] = 0.0f;
+                instance[6] = instance[7] = 1.0f;
+            }
+
+            glUseProgram(residencyProgram);
+            glBindVertexArray(residencyVao);
+            glBindBuffer(GL_ARRAY_BUFFER, residencyBuffers[1]);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(float), instances.data());
+            glActiveTexture(GL_TEXTURE0 + 1);
+            for (int slot = 0; slot < RESIDENCY_PAGE; slot++) {
+                /* The triangle is one unit of the clip space times the instance scale. */
+                float screenSize = instances[slot * 8 + 2] * 0.5f * (demo.width > demo.height ? demo.width : demo.height);
+                int material = (first + slot) % residencyCount;
+                glBindTexture(GL_TEXTURE_2D, textureResidencyUse(&residency, residentTextures[material], screenSize));
+                for (int attrib = 2; attrib < 4; attrib++) {
+                    glVertexAttribPointer(attrib, 4, GL_FLOAT, GL_FALSE, 8 * sizeof(float),
+                                          (void*)((slot * 8 + (attrib - 2) * 4) * sizeof(float)));
+                }
+                glDrawArraysInstanced(GL_TRIANGLES, 0, 3, 1);
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glActiveTexture(GL_TEXTURE0);
+            glBindVertexArray(0);
+
+            // R.6. Stream in and evict for the uses of the frame, show the state once per second.
+            textureResidencyUpdate(&residency);
+            if (time - residencyReport >= 1.0) {
+                residencyReport = time;
+                printf("Residency: %d textures with detail, %.1f of %.1f MiB, %d decodes in flight, "
+                       "%d levels uploaded, %d evicted\n", textureResidencyDetailedCount(&residency),
+                       residency.residentBytes / (1024.0 * 1024.0), residency.budget / (1024.0 * 1024.0),
+                       residency.decodesInFlight, residency.uploadedLevels, residency.evictedLevels);
+            }
+        } else if (atlasPath == NULL) {
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        } else {
+            // A.6. Every material with one draw, or a texture bind and a draw per material.
+            /* GL ES has no base instance for the instanced draws: the separate draws move the offset
+             * of the instance attributes to their material instead. */
+            double submitStart = demoGetTime(&demo);
+            glUseProgram(atlasProgram);
+            glBindVertexArray(atlasVao);
+            glActiveTexture(GL_TEXTURE0 + 1);
+            if (separateTextures) {
+                glBindBuffer(GL_ARRAY_BUFFER, atlasBuffers[1]);
+                for (int idx = 0; idx < materialCount; idx++) {
+                    glBindTexture(GL_TEXTURE_2D, entryTextures[idx % entryTextures.size()]);
+                    for (int attrib = 2; attrib < 4; attrib++) {
+                        glVertexAttribPointer(attrib, 4, GL_FLOAT, GL_FALSE, 8 * sizeof(float),
+                                              (void*)((idx * 8 + (attrib - 2) * 4) * sizeof(float)));
+                    }
+                    glDrawArraysInstanced(GL_TRIANGLES, 0, 3, 1);
+                }
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+                glBindTexture(GL_TEXTURE_2D, texture);
+            } else {
+                glBindTexture(GL_TEXTURE_2D_ARRAY, atlasTexture);
+                glDrawArraysInstanced(GL_TRIANGLES, 0, 3, materialCount);
+            }
+            glActiveTexture(GL_TEXTURE0);
+            glBindVertexArray(0);
+            atlasSubmitSeconds += demoGetTime(&demo) - submitStart;
+        }
+        gpuTimerEnd(&gpuTimer);
+
+        // T.3. Show the pass times (if requested).
+        gpuTimerDrawOverlay(&gpuTimer, 10, 10);
+        gpuTimerEndFrame(&gpuTimer);
 
         // X. Swap the fron-back buffers to display the rendered image in the window.
-        glfwSwapBuffers(window);
+        demoSwapBuffers(&demo);
     }
 
-    // XX. Destroy the window.
-    glfwDestroyWindow(window);
-    // XX. Destroy the GLFW.
-    glfwTerminate();
+    // XX. Destroy the GPU timer queries.
+    destroyGpuTimer(&gpuTimer);
+
+    // XX. Report the submit cost of the materials and destroy the atlas objects.
+    if (atlasPath != NULL) {
+        int frames = demo.frameCount > 0 ? demo.frameCount : 1;
+        printf("Atlas: %d draws and %d texture binds per frame, CPU submit: %.3f ms/frame\n",
+               separateTextures ? materialCount : 1, separateTextures ? materialCount : 1,
+               atlasSubmitSeconds * 1000.0 / frames);
+
+        glDeleteTextures(1, &atlasTexture);
+        gpuMemoryReleaseTextures(1, &atlasTexture);
+        if (!entryTextures.empty()) {
+            glDeleteTextures((int)entryTextures.size(), entryTextures.data());
+            gpuMemoryReleaseTextures((int)entryTextures.size(), entryTextures.data());
+        }
+        glDeleteBuffers(2, atlasBuffers);
+        glDeleteVertexArrays(1, &atlasVao);
+        glDeleteProgram(atlasProgram);
+    }
+
+    // XX. Delete the resident textures (prints the streaming statistics).
+    if (residencyCount > 0) {
+        destroyTextureResidency(&residency);
+        glDeleteBuffers(2, residencyBuffers);
+        glDeleteVertexArrays(1, &residencyVao);
+        glDeleteProgram(residencyProgram);
+    }
+
+    // XX. Delete the video stream texture and buffers.
+    if (videoStream.texture != 0) {
+        destroyStreamTexture(&videoStream);
+    }
+    if (videoMipsPath == RESAMPLE_COMPUTE) {
+        destroyComputeMipGenerator(&videoMips);
+    }
+
+    // XX. Stop the texture loader threads and delete the texture and the sampler.
+    destroyTextureLoader(textureLoader);
+    glDeleteTextures(1, &texture);
+    gpuMemoryReleaseTextures(1, &texture);
+    destroySamplerCache();
+
+    // XX. Delete the vertex buffer.
+    glDeleteBuffers(1, &vbo);
+
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
 
     return 0;
 }
@@ -7,6 +7,11 @@
  * Run:
  * $ ./gles_triangle_vertex_attrib
  *
+ * Shader hot reload (see common/shader_reload.h): the shaders are loaded from
+ * "shaders/uniform.vert" and "shaders/uniform.frag" (created from the built-in
+ * sources), every save rebuilds the program in the background:
+ * $ ./gles_triangle_uniform --shader-reload shaders
+ *
  * Dependencies:
  *  * C++11
  *  * GLFW 3.0+
@@ -35,10 +40,16 @@
  * OFTWARE.
  */
 #include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <string>
 
-#include <GLFW/glfw3.h>
 #include <GLES3/gl3.h>
 
+#include "common/demo_context.h"
+#include "common/shader_reload.h"
+
 const char* vertex_src = R"(#version 310 es
 precision highp float;
 
@@ -62,39 +73,31 @@ void main() {
 }
 )";
 
-static void ErrorCallbackGLFW(int error, const char* description) {
-    printf("Glfw Error %d: %s\n", error, description);
-}
-
 int main(int argc, char **argv) {
-    // 0. Add a method to report any GLFW errors.
-    glfwSetErrorCallback(ErrorCallbackGLFW);
-
-    // 1. Initialize the GLFW library.
-    if (!glfwInit()) {
-        return -1;
+    // Shader hot reload: directory of the shader files (NULL: the built-in sources only).
+    const char* shaderReloadDir = NULL;
+    bool shaderReloadWorker = true;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--shader-reload") == 0 && idx + 1 < argc) {
+            shaderReloadDir = argv[++idx];
+        } else if (strcmp(argv[idx], "--no-reload-worker") == 0) {
+            shaderReloadWorker = false;
+        }
     }
 
-    // 2. Add hints to use during context creation when a GLFW window is created.
-    // Here: require a GL ES 3.0 context.
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
-    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
-
-    // 3. Create window with graphics context
-    GLFWwindow* window = glfwCreateWindow(1024, 600, "GLDEMO", NULL, NULL);
-    if (window == NULL) {
-        return -2;
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    /* See the "01_gles_glfw" example for the GLFW steps. This also handles the
+     * "--headless" and "--frames N" command line options. */
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
     }
 
-    // 4. Activate the window (display it).
-    glfwMakeContextCurrent(window);
-
     // 5. Set the view port to match the window size.
     {
         int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
         glViewport(0, 0, display_w, display_h);
     }
 
@@ -168,6 +171,26 @@ int main(int argc, char **argv) {
         glDeleteShader(fragment_shader);
     }
 
+    // R.1. "--shader-reload DIR": the program is built from the files of the directory and rebuilt when they change.
+    ShaderReload shaderReload;
+    ReloadableProgram* reloadable = NULL;
+    int programVersion = 0;
+    if (shaderReloadDir) {
+        mkdir(shaderReloadDir, 0755);
+        std::string vertexPath = std::string(shaderReloadDir) + "/uniform.vert";
+        std::string fragmentPath = std::string(shaderReloadDir) + "/uniform.frag";
+
+        initShaderReload(&shaderReload, shaderReloadWorker);
+        reloadable = shaderReloadAdd(&shaderReload, vertexPath.c_str(), fragmentPath.c_str(), vertex_src, fragment_src);
+        if (!reloadable) {
+            return -3;
+        }
+
+        glDeleteProgram(shader_program);
+        shader_program = reloadable->program;
+        programVersion = reloadable->version;
+    }
+
     // 10. Specify the vertices.
     const float vertices[] = {
         -0.5, 0.5,
@@ -193,10 +216,24 @@ int main(int argc, char **argv) {
 
     static float color = 0;
     // X. Create a render loop.
-    while (!glfwWindowShouldClose(window))
+    while (!demoShouldClose(&demo))
     {
         // X. Poll and handle events (inputs, window resize, etc.)
-        glfwPollEvents();
+        demoPollEvents(&demo);
+
+        // R.2. Swap in the rebuilt program, its locations can differ from the previous one.
+        if (reloadable) {
+            shaderReloadPoll(&shaderReload);
+            if (reloadable->version != programVersion) {
+                programVersion = reloadable->version;
+                shader_program = reloadable->program;
+
+                int aPosLoc = glGetAttribLocation(shader_program, "aPos");
+                glVertexAttribPointer(aPosLoc, 2, GL_FLOAT, GL_TRUE, 2 * sizeof(float), vertices);
+                glEnableVertexAttribArray(aPosLoc);
+                uniformColorLoc = glGetUniformLocation(shader_program, "uColor");
+            }
+        }
 
         // X. Clear the color image.
         glClearColor(0.0, 0.3, 0.3, 1.0f);
@@ -210,17 +247,25 @@ int main(int argc, char **argv) {
         glUniform3f(uniformColorLoc, color, 0.1, 0.1);
         if (color > 1.0) { color = 0.0; }
 
+        // XX. The color ramp is the only animation: in the idle mode ("--idle") 30 steps per second are enough.
+        /* Without it only the events (input, resize) would redraw the frame. */
+        demoRequestRedraw(&demo, 1.0 / 30.0);
+
         // X. Draw the triangles.
         glDrawArrays(GL_TRIANGLES, 0, 3);
 
         // X. Swap the fron-back buffers to display the rendered image in the window.
-        glfwSwapBuffers(window);
+        demoSwapBuffers(&demo);
+    }
+
+    // R.3. Stop the file watcher and the build worker.
+    if (reloadable) {
+        printf("Shader reload: %d reloads, %d failed builds\n", shaderReload.reloads, shaderReload.failures);
+        destroyShaderReload(&shaderReload);
     }
 
-    // XX. Destroy the window.
-    glfwDestroyWindow(window);
-    // XX. Destroy the GLFW.
-    glfwTerminate();
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
 
     return 0;
 }
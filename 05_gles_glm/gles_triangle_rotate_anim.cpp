@@ -7,6 +7,20 @@
  * Run:
  * $ ./gles_triangle_rotate
  *
+ * Animate 100000 triangles, their model matrices are updated by 4 threads (see common/job_system.h)
+ * directly into the mapped instance buffer:
+ * $ ./gles_triangle_rotate_anim --objects 100000 --threads 4
+ *
+ * Measure the update time with 1, 2, ... N threads (N: "--threads" or the CPU core count):
+ * $ ./gles_triangle_rotate_anim --objects 100000 --thread-scaling
+ *
+ * Assert that the frames after the first 10 make no heap allocation (see common/frame_arena.h):
+ * $ ./gles_triangle_rotate_anim --objects 100000 --alloc-check
+ *
+ * Simulate on the main thread and draw on a render thread (see common/render_thread.h): the update
+ * of frame N + 1 overlaps the GL submission and the swap of frame N:
+ * $ ./gles_triangle_rotate_anim --objects 100000 --threads 4 --render-thread
+ *
  * Dependencies:
  *  * C++11
  *  * GLFW 3.0+
@@ -35,24 +49,39 @@
  * OFTWARE.
  */
 #include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
 
-#include <GLFW/glfw3.h>
 #include <GLES3/gl3.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "common/demo_context.h"
+#include "common/frame_arena.h"
+#include "common/job_system.h"
+#include "common/program_cache.h"
+#include "common/render_thread.h"
+#include "common/stream_buffer.h"
+#include "common/uniform_ring.h"
+
 const char* vertex_src = R"(#version 310 es
 precision highp float;
 
 in vec2 aPos;
 out vec3 fragColor;
 
-uniform mat4 transform;
+layout(std140) uniform ObjectConstants {
+    mat4 model;
+    vec4 color;
+};
 
 void main() {
-    gl_Position = transform * vec4(aPos, 0.0, 1.0);
+    gl_Position = model * vec4(aPos, 0.0, 1.0);
 }
 )";
 
@@ -61,46 +90,184 @@ precision highp float;
 
 out vec4 outColor;
 
-uniform vec3 uColor;
+layout(std140) uniform ObjectConstants {
+    mat4 model;
+    vec4 color;
+};
 
 void main() {
-    outColor = vec4(uColor, 1.0f);
+    outColor = vec4(color.rgb, 1.0f);
 }
 )";
 
-static void ErrorCallbackGLFW(int error, const char* description) {
-    printf("Glfw Error %d: %s\n", error, description);
+// Many objects mode: the model matrix of every triangle is a per-instance attribute.
+const char* instanced_vertex_src = R"(#version 310 es
+precision highp float;
+
+layout(location = 0) in vec2 aPos;
+layout(location = 1) in mat4 aModel;
+
+void main() {
+    gl_Position = aModel * vec4(aPos, 0.0, 1.0);
 }
+)";
 
-int main(int argc, char **argv) {
-    // 0. Add a method to report any GLFW errors.
-    glfwSetErrorCallback(ErrorCallbackGLFW);
+// Animation parameters of an object in the many objects mode.
+struct ObjectAnimation {
+    float x;
+    float y;
+    float scale;
+    float speed;
+    float phase;
+};
+
+struct TransformUpdate {
+    const ObjectAnimation* objects;
+    float* matrices; // the mapped instance buffer, 16 floats per object
+    float time;
+};
+
+// Job: compute the model matrices of the objects [begin, end).
+static void updateTransforms(void* data, int begin, int end) {
+    const TransformUpdate* update = (const TransformUpdate*)data;
+    for (int idx = begin; idx < end; idx++) {
+        const ObjectAnimation& object = update->objects[idx];
+
+        glm::mat4 transform = glm::mat4(1.0f);
+        transform = glm::translate(transform, glm::vec3(object.x, object.y, 0.0f));
+        transform = glm::rotate(transform, update->time * object.speed + object.phase, glm::vec3(0.0f, 0.0f, 1.0f));
+        transform = glm::scale(transform, glm::vec3(object.scale, object.scale, 1.0f));
+        memcpy(&update->matrices[idx * 16], glm::value_ptr(transform), 16 * sizeof(float));
+    }
+}
 
-    // 1. Initialize the GLFW library.
-    if (!glfwInit()) {
-        return -1;
+// Render thread mode: the results of the simulation for one frame, followed by the model matrices of the objects.
+struct FramePacket {
+    ObjectConstants object;
+};
+
+// Render thread mode: the GL objects of the scene (used by the render thread only).
+struct RenderScene {
+    unsigned int shaderProgram;
+    unsigned int instancedProgram;
+    unsigned int instanceVao;
+    StreamBuffer* instanceStream;
+    UniformRing* uniformRing;
+    int objectCount;
+};
+
+// Update the rotation and the color ramp of the single triangle.
+static void updateObjectConstants(ObjectConstants* object, float time, float* color) {
+    glm::mat4 transform = glm::mat4(1.0f);
+    transform = glm::rotate(transform, time / 10.f, glm::vec3(0.0f, 0.0f, 1.0f));
+    memcpy(object->model, glm::value_ptr(transform), sizeof(object->model));
+
+    *color += 0.01;
+    object->color[0] = *color;
+    object->color[1] = 0.1f;
+    object->color[2] = 0.1f;
+    object->color[3] = 1.0f;
+    if (*color > 1.0) { *color = 0.0; }
+}
+
+// Render thread: draw the frame of the packet (the copy of the matrices is the only per-object work here).
+static void renderPacket(DemoContext* demo, const void* data, int frame, void* user) {
+    const FramePacket* packet = (const FramePacket*)data;
+    RenderScene* scene = (RenderScene*)user;
+
+    glClearColor(0.0, 0.3, 0.3, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glUseProgram(scene->shaderProgram);
+
+    if (scene->objectCount > 1) {
+        streamBufferBeginFrame(scene->instanceStream);
+        int instanceOffset;
+        size_t size = scene->objectCount * 16 * sizeof(float);
+        void* matrices = streamBufferAllocate(scene->instanceStream, size, 16, &instanceOffset);
+        if (matrices != NULL) {
+            memcpy(matrices, packet + 1, size);
+        }
+        streamBufferEndFrame(scene->instanceStream);
+
+        glBindVertexArray(scene->instanceVao);
+        glBindBuffer(GL_ARRAY_BUFFER, scene->instanceStream->buffer);
+        for (int column = 0; column < 4; column++) {
+            glVertexAttribPointer(1 + column, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float),
+                                  (void*)(intptr_t)(instanceOffset + column * 4 * sizeof(float)));
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
-    // 2. Add hints to use during context creation when a GLFW window is created.
-    // Here: require a GL ES 3.0 context.
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
-    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+    uniformRingBeginFrame(scene->uniformRing);
+    int objectOffset = uniformRingWrite(scene->uniformRing, &packet->object, sizeof(packet->object));
+    uniformRingEndFrame(scene->uniformRing);
+    uniformRingBind(scene->uniformRing, OBJECT_CONSTANTS_BINDING, objectOffset, sizeof(packet->object));
+
+    if (scene->objectCount > 1) {
+        glUseProgram(scene->instancedProgram);
+        glBindVertexArray(scene->instanceVao);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 3, scene->objectCount);
+        glBindVertexArray(0);
+    } else {
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+}
+
+static float randomRange(float min, float max) {
+    return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
 
-    // 3. Create window with graphics context
-    GLFWwindow* window = glfwCreateWindow(1024, 600, "GLDEMO", NULL, NULL);
-    if (window == NULL) {
-        return -2;
+int main(int argc, char **argv) {
+    // Animated objects: "--objects N" (default: the single triangle), updated by "--threads T" threads.
+    int objectCount = 1;
+    int threadCount = 0;
+    bool threadScaling = false;
+    bool allocCheck = false;
+    bool renderThreadMode = false;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--objects") == 0 && idx + 1 < argc) {
+            objectCount = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--threads") == 0 && idx + 1 < argc) {
+            threadCount = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--thread-scaling") == 0) {
+            threadScaling = true;
+        } else if (strcmp(argv[idx], "--alloc-check") == 0) {
+            allocCheck = true;
+        } else if (strcmp(argv[idx], "--render-thread") == 0) {
+            renderThreadMode = true;
+        }
     }
 
-    // 4. Activate the window (display it).
-    glfwMakeContextCurrent(window);
+    if (objectCount < 1 || threadCount < 0) {
+        printf("Invalid object or thread count\n");
+        return -1;
+    }
+    if (threadScaling && allocCheck) {
+        printf("--alloc-check can't be used with --thread-scaling (the job system is recreated)\n");
+        return -1;
+    }
+    if (renderThreadMode && (threadScaling || allocCheck)) {
+        printf("--render-thread can't be used with --thread-scaling or --alloc-check\n");
+        return -1;
+    }
+    if (threadScaling && objectCount == 1) {
+        objectCount = 100000;
+    }
+
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    /* See the "01_gles_glfw" example for the GLFW steps. This also handles the
+     * "--headless" and "--frames N" command line options. */
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
 
     // 5. Set the view port to match the window size.
     {
         int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
         glViewport(0, 0, display_w, display_h);
     }
 
@@ -191,22 +358,124 @@ int main(int argc, char **argv) {
         glEnableVertexAttribArray(aPosLoc);
     }
 
-    // 11. Query the uniform location
-    int uniformColorLoc;
+    // 11. Connect the uniform block of the program and create the uniform buffer ring.
+    /* See common/uniform_ring.h: the constants are written into one mapped buffer range per frame. */
+    UniformRing uniformRing;
     {
-        uniformColorLoc = glGetUniformLocation(shader_program, "uColor");
+        bindConstantBlocks(shader_program);
+        initUniformRing(&uniformRing, 16 * 1024);
     }
 
-    int transformLoc = glGetUniformLocation(shader_program, "transform");
-    {
+    // J.1. Many objects mode: a program with the per-instance model matrix and the instance buffer.
+    /* The matrices are streamed (see common/stream_buffer.h): every frame the job system writes
+     * them into the next mapped region of the buffer, without waiting for the previous draws. */
+    unsigned int instanced_program = 0;
+    unsigned int instance_vao = 0;
+    unsigned int vertex_vbo = 0;
+    StreamBuffer instanceStream;
+    std::vector<ObjectAnimation> objects;
+    if (objectCount > 1) {
+        instanced_program = createCachedProgram(instanced_vertex_src, fragment_src);
+        bindConstantBlocks(instanced_program);
+
+        srand(42);
+        objects.resize(objectCount);
+        for (int idx = 0; idx < objectCount; idx++) {
+            objects[idx].x = randomRange(-0.95f, 0.95f);
+            objects[idx].y = randomRange(-0.95f, 0.95f);
+            objects[idx].scale = 0.05f;
+            objects[idx].speed = randomRange(-2.0f, 2.0f);
+            objects[idx].phase = randomRange(0.0f, 6.28f);
+        }
+
+        glGenBuffers(1, &vertex_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vertex_vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+        initStreamBuffer(&instanceStream, GL_ARRAY_BUFFER, objectCount * 16 * sizeof(float));
+
+        glGenVertexArrays(1, &instance_vao);
+        glBindVertexArray(instance_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vertex_vbo);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), NULL);
+        glEnableVertexAttribArray(0);
+
+        // J.1.1. The mat4 attribute uses the locations 1-4, one column each (the offset is set every frame).
+        for (int column = 0; column < 4; column++) {
+            glVertexAttribDivisor(1 + column, 1);
+            glEnableVertexAttribArray(1 + column);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
+    // J.2. Create the job system (the render thread is one of the threads).
+    JobSystem jobs;
+    initJobSystem(&jobs, threadCount);
+    if (objectCount > 1) {
+        printf("%d objects, %d threads\n", objectCount, jobs.threadCount);
+    }
+
+    // J.3. "--thread-scaling": every thread count is measured for scalingFrames frames.
+    const int scalingWarmupFrames = 10;
+    const int scalingFrames = 60;
+    int scalingMaxThreads = jobs.threadCount;
+    int scalingFrame = 0;
+    std::vector<double> scalingMs;
+    if (threadScaling) {
+        destroyJobSystem(&jobs);
+        initJobSystem(&jobs, 1);
+
+        /* The benchmark stops after the last thread count. */
+        demo.frameLimit = 0;
+    }
+
+    // J.4. The per-frame CPU data (the job parameters read by the workers) comes from a frame arena.
+    FrameArena frameArena;
+    initFrameArena(&frameArena, 4 * 1024);
+
+    // J.5. "--alloc-check": the steady state frames must not touch the heap.
+    AllocationCheck allocationCheck;
+    initAllocationCheck(&allocationCheck, 10);
+
+    double updateSeconds = 0.0;
+    int updateFrames = 0;
+    double statsStartTime = demoGetTime(&demo);
+
     static float color = 0;
+
+    // T.1. "--render-thread": the main thread polls the events and simulates into the frame packets.
+    if (renderThreadMode) {
+        RenderScene scene = { shader_program, instanced_program, instance_vao, &instanceStream, &uniformRing, objectCount };
+        size_t packetSize = sizeof(FramePacket) + (objectCount > 1 ? objectCount * 16 * sizeof(float) : 0);
+        RenderThread* renderThread = createRenderThread(&demo, packetSize, renderPacket, &scene);
+        if (renderThread == NULL) {
+            return -1;
+        }
+
+        while (!renderThreadShouldClose(renderThread)) {
+            demoPollEvents(&demo);
+
+            // T.2. Fill the packet of the next frame while the render thread draws the previous one.
+            FramePacket* packet = (FramePacket*)renderThreadBeginFrame(renderThread);
+            float time = (float)renderThreadAnimationTime(renderThread);
+            if (objectCount > 1) {
+                TransformUpdate update = { objects.data(), (float*)(packet + 1), time };
+                jobSystemParallelFor(&jobs, objectCount, 1024, updateTransforms, &update);
+            }
+            updateObjectConstants(&packet->object, time, &color);
+            renderThreadSubmit(renderThread);
+        }
+
+        // T.3. The render thread draws the submitted frames and gives the context back.
+        destroyRenderThread(renderThread);
+    }
+
     // X. Create a render loop.
-    while (!glfwWindowShouldClose(window))
+    while (!renderThreadMode && !demoShouldClose(&demo))
     {
         // X. Poll and handle events (inputs, window resize, etc.)
-        glfwPollEvents();
+        demoPollEvents(&demo);
 
         // X. Clear the color image.
         glClearColor(0.0, 0.3, 0.3, 1.0f);
@@ -215,30 +484,124 @@ int main(int argc, char **argv) {
         // X. Use the shader program to draw.
         glUseProgram(shader_program);
 
-        // XX. Update the transformation matrix.
-        {
-            glm::mat4 transform = glm::mat4(1.0f);
-            transform = glm::rotate(transform, (float)glfwGetTime() / 10.f, glm::vec3(0.0f, 0.0f, 1.0f));
-            //transform = glm::scale(transform, glm::vec3(0.5, 0.5, 0.5));
-            glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(transform));
+        frameArenaBeginFrame(&frameArena);
+
+        // J.6. Many objects mode: update every model matrix in the mapped instance buffer.
+        if (objectCount > 1) {
+            // J.6.1. Benchmark: the next thread count after every scalingFrames frames.
+            if (threadScaling) {
+                int step = scalingFrame / scalingFrames;
+                int stepFrame = scalingFrame % scalingFrames;
+                if (stepFrame == 0 && step > 0) {
+                    scalingMs.push_back(updateSeconds * 1000.0 / updateFrames);
+                    if (step >= scalingMaxThreads) {
+                        break;
+                    }
+                    destroyJobSystem(&jobs);
+                    initJobSystem(&jobs, step + 1);
+                }
+                if (stepFrame == 0 || stepFrame == scalingWarmupFrames) {
+                    updateSeconds = 0.0;
+                    updateFrames = 0;
+                }
+                scalingFrame++;
+            }
+
+            double updateStart = demoGetTime(&demo);
+
+            streamBufferBeginFrame(&instanceStream);
+            int instanceOffset;
+            TransformUpdate* update = frameArenaAllocArray<TransformUpdate>(&frameArena, 1);
+            update->objects = objects.data();
+            update->matrices = (float*)streamBufferAllocate(&instanceStream, objectCount * 16 * sizeof(float), 16, &instanceOffset);
+            update->time = (float)demoAnimationTime(&demo);
+            if (update->matrices != NULL) {
+                jobSystemParallelFor(&jobs, objectCount, 1024, updateTransforms, update);
+            }
+            streamBufferEndFrame(&instanceStream);
+
+            // J.6.2. Point the instance attributes to this frame's matrices.
+            glBindVertexArray(instance_vao);
+            glBindBuffer(GL_ARRAY_BUFFER, instanceStream.buffer);
+            for (int column = 0; column < 4; column++) {
+                glVertexAttribPointer(1 + column, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float),
+                                      (void*)(intptr_t)(instanceOffset + column * 4 * sizeof(float)));
+            }
+            glBindVertexArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+            updateSeconds += demoGetTime(&demo) - updateStart;
+            updateFrames++;
+
+            if (!threadScaling && demoGetTime(&demo) - statsStartTime >= 1.0) {
+                printf("%d objects, %d threads: update %.3f ms/frame (%d jobs stolen, %d stream buffer stalls)\n", objectCount,
+                       jobs.threadCount, updateSeconds * 1000.0 / updateFrames, jobs.stolenJobs.load(), instanceStream.stalls);
+                jobs.stolenJobs = 0;
+                updateSeconds = 0.0;
+                updateFrames = 0;
+                statsStartTime = demoGetTime(&demo);
+            }
         }
 
-        // XX. Update the uniform.
-        color += 0.01;
-        glUniform3f(uniformColorLoc, color, 0.1, 0.1);
-        if (color > 1.0) { color = 0.0; }
+        // XX. Update the transformation matrix and the color in the uniform ring.
+        {
+            ObjectConstants object;
+            updateObjectConstants(&object, (float)demoAnimationTime(&demo), &color);
+
+            uniformRingBeginFrame(&uniformRing);
+            int objectOffset = uniformRingWrite(&uniformRing, &object, sizeof(object));
+            uniformRingEndFrame(&uniformRing);
+
+            uniformRingBind(&uniformRing, OBJECT_CONSTANTS_BINDING, objectOffset, sizeof(object));
+        }
 
         // X. Draw the triangles.
-        glDrawArrays(GL_TRIANGLES, 0, 3);
+        if (objectCount > 1) {
+            glUseProgram(instanced_program);
+            glBindVertexArray(instance_vao);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 3, objectCount);
+            glBindVertexArray(0);
+        } else {
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
 
         // X. Swap the fron-back buffers to display the rendered image in the window.
-        glfwSwapBuffers(window);
+        demoSwapBuffers(&demo);
+
+        if (allocCheck) {
+            allocationCheckEndFrame(&allocationCheck);
+        }
     }
 
-    // XX. Destroy the window.
-    glfwDestroyWindow(window);
-    // XX. Destroy the GLFW.
-    glfwTerminate();
+    if (allocCheck) {
+        printf("Allocation check: %d frames, %d heap allocations after the warm-up, %d frame arena overflows\n",
+               allocationCheck.frame, (int)allocationCheck.steadyAllocations, frameArena.overflows);
+    }
+
+    // XX. Print the thread scaling results: the update time and the speedup compared to one thread.
+    if (threadScaling) {
+        printf("%8s %14s %8s\n", "threads", "ms/update", "speedup");
+        for (size_t idx = 0; idx < scalingMs.size(); idx++) {
+            printf("%8d %14.3f %8.2f\n", (int)idx + 1, scalingMs[idx], scalingMs[idx] > 0.0 ? scalingMs[0] / scalingMs[idx] : 0.0);
+        }
+    }
+
+    // XX. Stop the job system threads.
+    destroyJobSystem(&jobs);
+    destroyFrameArena(&frameArena);
+
+    // XX. Destroy the instance buffers.
+    if (objectCount > 1) {
+        glDeleteVertexArrays(1, &instance_vao);
+        glDeleteBuffers(1, &vertex_vbo);
+        destroyStreamBuffer(&instanceStream);
+    }
+
+    // XX. Destroy the uniform buffer ring.
+    destroyUniformRing(&uniformRing);
+
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
 
     return 0;
 }
@@ -7,6 +7,14 @@
  * Run:
  * $ ./gles_triangle_vao
  *
+ * The colour-only fragment shader is built in highp and mediump (see common/shader_precision.h),
+ * "--precision auto" (the default) uses mediump where the device has a reduced mediump and
+ * the mediump image matches the highp one, "highp"/"mediump" force a variant:
+ * $ ./gles_triangle_vao --precision mediump --headless --frames 1000
+ *
+ * The buffer and the vertex array are owned by move-only handles (see common/gl_handle.h):
+ * their deletion is queued until the GPU has finished the frames which used them.
+ *
  * Dependencies:
  *  * C++11
  *  * GLFW 3.0+
@@ -35,18 +43,23 @@
  * OFTWARE.
  */
 #include <stdio.h>
+#include <string.h>
 
-#include <GLFW/glfw3.h>
 #include <GLES3/gl3.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "common/program_cache.h"
+#include "common/demo_context.h"
+#include "common/gl_handle.h"
+#include "common/shader_precision.h"
+
 const char* vertex_src = R"(#version 310 es
 precision highp float;
 
-in vec2 aPos;
+layout(location = 0) in vec2 aPos;
 out vec3 fragColor;
 
 uniform mat4 transform;
@@ -68,110 +81,50 @@ void main() {
 }
 )";
 
-static void ErrorCallbackGLFW(int error, const char* description) {
-    printf("Glfw Error %d: %s\n", error, description);
+// The image check of the precision variants: the triangle without rotation.
+static void drawPrecisionCheck(unsigned int program, void* user) {
+    const glm::mat4 transform = glm::mat4(1.0f);
+    glUniformMatrix4fv(glGetUniformLocation(program, "transform"), 1, GL_FALSE, glm::value_ptr(transform));
+    glUniform3f(glGetUniformLocation(program, "uColor"), 0.7f, 0.1f, 0.1f);
+
+    glBindVertexArray(*(unsigned int*)user);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
 }
 
 int main(int argc, char **argv) {
-    // 0. Add a method to report any GLFW errors.
-    glfwSetErrorCallback(ErrorCallbackGLFW);
-
-    // 1. Initialize the GLFW library.
-    if (!glfwInit()) {
-        return -1;
+    ShaderPrecision precision = SHADER_PRECISION_AUTO;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--precision") == 0 && idx + 1 < argc) {
+            if (!parseShaderPrecision(argv[++idx], &precision)) {
+                return -1;
+            }
+        }
     }
 
-    // 2. Add hints to use during context creation when a GLFW window is created.
-    // Here: require a GL ES 3.0 context.
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
-    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
-
-    // 3. Create window with graphics context
-    GLFWwindow* window = glfwCreateWindow(1024, 600, "GLDEMO", NULL, NULL);
-    if (window == NULL) {
-        return -2;
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    /* See the "01_gles_glfw" example for the GLFW steps. This also handles the
+     * "--headless" and "--frames N" command line options. */
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
     }
 
-    // 4. Activate the window (display it).
-    glfwMakeContextCurrent(window);
-
     // 5. Set the view port to match the window size.
     {
         int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
         glViewport(0, 0, display_w, display_h);
     }
 
-    // 6. Create the vertex shader.
-    unsigned int vertex_shader;
-    {
-        // 6.1. Create a vertex shader object.
-        vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-
-        // 6.2. Specify the shader source.
-        glShaderSource(vertex_shader, 1, &vertex_src, NULL);
-
-        // 6.3. Compile the shader.
-        glCompileShader(vertex_shader);
-
-        // 6.4. Check if there is any error during compilation.
-        int success;
-        glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            char info[512];
-            glGetShaderInfoLog(vertex_shader, 512, NULL, info);
-            printf("Vertex shader error:\n%s\n", info);
-            return -3;
-        }
-    }
-
-    // 7. Create the fragment shader.
-    unsigned int fragment_shader;
-    {
-        // 7.1. Create a fragment shader object.
-        fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-
-        // 7.2. Specify the shader source.
-        glShaderSource(fragment_shader, 1, &fragment_src, NULL);
-
-        // 7.3. Compile the shader.
-        glCompileShader(fragment_shader);
-
-        // 7.4. Check if there is any error during compilation.
-        int success;
-        glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            char info[512];
-            glGetShaderInfoLog(fragment_shader, 512, NULL, info);
-            printf("Fragment shader error:\n%s\n", info);
-            return -3;
-        }
-    }
-
-    // 8. Create a shader program and attach the vertex/fragment shaders.
-    unsigned int shader_program;
-    {
-        shader_program = glCreateProgram();
-        glAttachShader(shader_program, vertex_shader);
-        glAttachShader(shader_program, fragment_shader);
-        glLinkProgram(shader_program);
-
-        int success;
-        glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
-        if(!success) {
-            char info[512];
-            glGetProgramInfoLog(shader_program, 512, NULL, info);
-            printf("Program error:\n%s\n", info);
-            return -3;
-        }
-    }
-
-    // 9. The vertex and fragment shaders can be removed after linking.
-    {
-        glDeleteShader(vertex_shader);
-        glDeleteShader(fragment_shader);
+    // 6. Create the shader program: the highp and the mediump variant of the fragment shader.
+    /* The program binary is loaded from the program cache if it was already
+     * compiled in a previous run, otherwise the sources are compiled and linked.
+     * The variant is selected after the VAO is created (6.1). */
+    PrecisionVariants variants;
+    if (!initPrecisionVariants(&variants, vertex_src, fragment_src)) {
+        return -3;
     }
 
     // V.1. Create a Vertex Buffer object for vertices data
@@ -181,13 +134,13 @@ int main(int argc, char **argv) {
         0.0, -0.5
     };
 
-    unsigned int vertices_vbo;
+    GlBuffer vertices_vbo;
     {
         // V.1.1. Generate the buffer object.
-        glGenBuffers(1, &vertices_vbo);
+        vertices_vbo = createGlBuffer();
 
         // V.1.2. Bind the VBO to the "GL_ARRAY_BUFFER".
-        glBindBuffer(GL_ARRAY_BUFFER, vertices_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vertices_vbo.get());
 
         // V.1.3. "Upload" the data for the active "GL_ARRAY_BUFFER".
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
@@ -197,16 +150,17 @@ int main(int argc, char **argv) {
     }
 
     // V.1.2. Specify the Vertex Array Object.
-    /* VAO is used to describe how the VBOs are accessed (layout/format). */
-    unsigned int vao;
+    /* VAO is used to describe how the VBOs are accessed (layout/format).
+     * The location of "aPos" is fixed in the shader: the same in both variants. */
+    GlVertexArray vao;
     {
-        int aPosLoc = glGetAttribLocation(shader_program, "aPos");
+        int aPosLoc = 0;
 
-        glGenVertexArrays(1, &vao);
+        vao = createGlVertexArray();
 
-        glBindVertexArray(vao);
+        glBindVertexArray(vao.get());
 
-        glBindBuffer(GL_ARRAY_BUFFER, vertices_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vertices_vbo.get());
 
         glVertexAttribPointer(aPosLoc, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), NULL);
 
@@ -216,6 +170,17 @@ int main(int argc, char **argv) {
         glBindVertexArray(0);
     }
 
+    // 6.1. Select the variant of "--precision", the mediump image is compared with the highp one.
+    unsigned int shader_program;
+    {
+        int display_w, display_h;
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
+        unsigned int vaoName = vao.get();
+        shader_program = selectPrecisionVariant(&variants, precision, display_w, display_h, drawPrecisionCheck,
+                                                &vaoName);
+        printPrecisionVariants(&variants);
+    }
+
     // 11. Query the uniform location
     int uniformColorLoc;
     {
@@ -226,10 +191,10 @@ int main(int argc, char **argv) {
 
     static float color = 0;
     // X. Create a render loop.
-    while (!glfwWindowShouldClose(window))
+    while (!demoShouldClose(&demo))
     {
         // X. Poll and handle events (inputs, window resize, etc.)
-        glfwPollEvents();
+        demoPollEvents(&demo);
 
         // X. Clear the color image.
         glClearColor(0.0, 0.3, 0.3, 1.0f);
@@ -239,12 +204,12 @@ int main(int argc, char **argv) {
         glUseProgram(shader_program);
 
         // V.3. Use the VAO
-        glBindVertexArray(vao);
+        glBindVertexArray(vao.get());
 
         // XX. Update the transformation matrix.
         {
             glm::mat4 transform = glm::mat4(1.0f);
-            transform = glm::rotate(transform, (float)glfwGetTime() / 10.f, glm::vec3(0.0f, 0.0f, 1.0f));
+            transform = glm::rotate(transform, (float)demoAnimationTime(&demo) / 10.f, glm::vec3(0.0f, 0.0f, 1.0f));
             //transform = glm::scale(transform, glm::vec3(0.5, 0.5, 0.5));
             glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(transform));
         }
@@ -258,13 +223,16 @@ int main(int argc, char **argv) {
         glDrawArrays(GL_TRIANGLES, 0, 3);
 
         // X. Swap the fron-back buffers to display the rendered image in the window.
-        glfwSwapBuffers(window);
+        demoSwapBuffers(&demo);
     }
 
-    // XX. Destroy the window.
-    glfwDestroyWindow(window);
-    // XX. Destroy the GLFW.
-    glfwTerminate();
+    // XX. Queue the deletion of the vertex array and the buffer (see common/gl_handle.h), destroy the programs.
+    vao.reset();
+    vertices_vbo.reset();
+    destroyPrecisionVariants(&variants);
+
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
 
     return 0;
 }
@@ -7,6 +7,36 @@
  * Run:
  * $ ./gles_cube
  *
+ * Cube field: draw 20000 cubes with one instanced draw call:
+ * $ ./gles_cube --cubes 20000
+ * Same field with one draw call per cube (driver overhead baseline):
+ * $ ./gles_cube --cubes 20000 --naive
+ * Same field through the render queue (common/render_queue.h): one item per
+ * cube (every 8th cube as a wireframe), sorted by state and depth and merged
+ * back into instanced draws every frame:
+ * $ ./gles_cube --cubes 100000 --render-queue
+ *
+ * Scene hierarchy of 20000 cubes (every cube orbits its parent), the model-view-projection
+ * matrices are computed on the CPU with SIMD (see common/transform_hierarchy.h), the
+ * vertex shader only does one matrix multiply ("--scalar-transforms": the scalar version):
+ * $ ./gles_cube --hierarchy 20000
+ *
+ * Draw the state combinations of a frame once before the first frame (see common/pipeline_warmup.h)
+ * and compare the first frame with the next 30 (every frame waits for the GPU):
+ * $ ./gles_cube --pipeline-warmup --first-frame-time
+ *
+ * Assert that the frames after the first 10 make no heap allocation (see common/frame_arena.h):
+ * $ ./gles_cube --cubes 100000 --render-queue --alloc-check
+ *
+ * Use the packed (half float) cube vertices:
+ * $ ./gles_cube --packed-vertices
+ *
+ * Stereo: render both eyes into a two layer texture array (see common/stereo.h) with one
+ * draw (GL_OVR_multiview2) or one pass per eye, shown side by side. "compare" switches
+ * between the two every second and prints the frame time of each at exit:
+ * $ ./gles_cube --cubes 20000 --stereo multiview
+ * $ ./gles_cube --cubes 20000 --naive --stereo compare
+ *
  * Dependencies:
  *  * C++11
  *  * GLFW 3.0+
@@ -35,19 +65,42 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  * OFTWARE.
  */
+#include <math.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
 
-#include <GLFW/glfw3.h>
 #include <GLES3/gl3.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "common/camera.h"
+#include "common/demo_context.h"
+#include "common/frame_arena.h"
+#include "common/hud.h"
+#include "common/pipeline_warmup.h"
+#include "common/program_cache.h"
+#include "common/render_queue.h"
+#include "common/startup_profile.h"
+#include "common/stereo.h"
+#include "common/stream_buffer.h"
+#include "common/transform_hierarchy.h"
+#include "common/mesh.h"
+
 const char* vertex_src = R"(#version 310 es
 precision highp float;
 
 in vec3 aPos;
+// Per cube data: position (xyz) and rotation around the Y axis (w).
+/* Instanced attribute in the cube field mode, a constant (0, 0, 0, 0) otherwise. */
+in vec4 aInstance;
 out vec2 checkerCoord;
 
 uniform mat4 projection;
@@ -55,7 +108,14 @@ uniform mat4 model;
 uniform mat4 view;
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    float s = sin(aInstance.w);
+    float c = cos(aInstance.w);
+    mat4 instance = mat4(c, 0.0, -s, 0.0,
+                         0.0, 1.0, 0.0, 0.0,
+                         s, 0.0, c, 0.0,
+                         aInstance.xyz, 1.0);
+
+    gl_Position = projection * view * instance * model * vec4(aPos, 1.0);
 
     // Move the position coordinate into the [0, 1] range.
     checkerCoord = (vec4(aPos, 1.0).xy + vec2(1.0f)) / vec2(2.0);
@@ -88,42 +148,155 @@ void main() {
 }
 )";
 
-static void ErrorCallbackGLFW(int error, const char* description) {
-    printf("Glfw Error %d: %s\n", error, description);
+// Stereo mode: the eye matrices come from the "StereoEyes" block (common/stereo.h), the
+// stereoShaderHeader lines are inserted after the "#version" line.
+/* Fixed attribute locations: the programs of the stereo modes share the cube VAO. */
+const char* stereo_vertex_src = R"(#version 310 es
+precision highp float;
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec4 aInstance;
+out vec2 checkerCoord;
+
+uniform mat4 model;
+
+void main() {
+    float s = sin(aInstance.w);
+    float c = cos(aInstance.w);
+    mat4 instance = mat4(c, 0.0, -s, 0.0,
+                         0.0, 1.0, 0.0, 0.0,
+                         s, 0.0, c, 0.0,
+                         aInstance.xyz, 1.0);
+
+    gl_Position = stereoProjection[STEREO_EYE] * stereoView[STEREO_EYE] * instance * model * vec4(aPos, 1.0);
+
+    // Move the position coordinate into the [0, 1] range.
+    checkerCoord = (vec4(aPos, 1.0).xy + vec2(1.0f)) / vec2(2.0);
+}
+)";
+
+// The eye target, the program and the frame times of a stereo mode.
+struct StereoPipeline {
+    StereoTarget target;
+    unsigned int program;
+    int modelLoc;
+    int colorLoc;
+
+    int frames;
+    double seconds;
+    double submitSeconds;
+    int drawCalls; // of the last measured frame
+};
+
+// Hierarchy mode: the MVP matrix of every cube comes from the CPU, no per-vertex "projection * view * model".
+const char* hierarchy_vertex_src = R"(#version 310 es
+precision highp float;
+
+in vec3 aPos;
+// Per cube model-view-projection matrix (instanced, locations 4-7).
+layout(location = 4) in mat4 aMVP;
+out vec2 checkerCoord;
+
+void main() {
+    gl_Position = aMVP * vec4(aPos, 1.0);
+
+    // Move the position coordinate into the [0, 1] range.
+    checkerCoord = (vec4(aPos, 1.0).xy + vec2(1.0f)) / vec2(2.0);
+}
+)";
+
+// Build the hierarchy: node N orbits its parent (N - 1) / 4, every node has four children.
+/* Every node spins around the Y axis with its own speed ("speeds"), a level is 0.55 times smaller. */
+static void createCubeHierarchy(TransformHierarchy* scene, int nodeCount, std::vector<float>* speeds) {
+    static const float directions[4][3] = { { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f } };
+    const float rotation[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+    for (int idx = 0; idx < nodeCount; idx++) {
+        int parent = idx == 0 ? -1 : (idx - 1) / 4;
+        int node = addTransformNode(scene, parent);
+
+        if (parent < 0) {
+            const float translation[3] = { 0.0f, 0.0f, 0.0f };
+            const float scale[3] = { 2.0f, 2.0f, 2.0f };
+            setTransformNode(scene, node, translation, rotation, scale);
+        } else {
+            const float* direction = directions[(idx - 1) % 4];
+            const float translation[3] = { direction[0] * 3.0f, 0.5f, direction[2] * 3.0f };
+            const float scale[3] = { 0.55f, 0.55f, 0.55f };
+            setTransformNode(scene, node, translation, rotation, scale);
+        }
+        speeds->push_back(0.2f + 0.15f * (float)(idx % 7));
+    }
 }
 
 int main(int argc, char **argv) {
-    // 0. Add a method to report any GLFW errors.
-    glfwSetErrorCallback(ErrorCallbackGLFW);
+    // Cube field mode: number of cubes (0: the single cube) and draw each cube separately or instanced.
+    int cubeCount = 0;
+    bool naiveDraws = false;
+    bool useRenderQueue = false;
+    bool packedVertices = false;
+    bool allocCheck = false;
+    int hierarchyNodes = 0;
+    bool scalarTransforms = false;
+    bool pipelineWarmup = false;
+    bool firstFrameTime = false;
+    const char* stereoArg = NULL;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--cubes") == 0 && idx + 1 < argc) {
+            cubeCount = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--naive") == 0) {
+            naiveDraws = true;
+        } else if (strcmp(argv[idx], "--render-queue") == 0) {
+            useRenderQueue = true;
+        } else if (strcmp(argv[idx], "--packed-vertices") == 0) {
+            packedVertices = true;
+        } else if (strcmp(argv[idx], "--alloc-check") == 0) {
+            allocCheck = true;
+        } else if (strcmp(argv[idx], "--hierarchy") == 0 && idx + 1 < argc) {
+            hierarchyNodes = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--scalar-transforms") == 0) {
+            scalarTransforms = true;
+        } else if (strcmp(argv[idx], "--pipeline-warmup") == 0) {
+            pipelineWarmup = true;
+        } else if (strcmp(argv[idx], "--first-frame-time") == 0) {
+            firstFrameTime = true;
+        } else if (strcmp(argv[idx], "--stereo") == 0 && idx + 1 < argc) {
+            stereoArg = argv[++idx];
+        }
+    }
 
-    // 1. Initialize the GLFW library.
-    if (!glfwInit()) {
+    if (hierarchyNodes < 0 || (hierarchyNodes > 0 && cubeCount > 0)) {
+        printf("Invalid hierarchy node count (or used together with --cubes)\n");
         return -1;
     }
-
-    // 2. Add hints to use during context creation when a GLFW window is created.
-    // Here: require a GL ES 3.0 context.
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
-    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
-
-    // 3. Create window with graphics context
-    GLFWwindow* window = glfwCreateWindow(1024, 600, "GLDEMO", NULL, NULL);
-    if (window == NULL) {
-        return -2;
+    bool stereoCompare = stereoArg != NULL && strcmp(stereoArg, "compare") == 0;
+    if (stereoArg != NULL && !stereoCompare && findStereoMode(stereoArg) == STEREO_MODE_COUNT) {
+        printf("Unknown stereo mode: %s (two-pass, multiview or compare)\n", stereoArg);
+        return -1;
+    }
+    if (stereoArg != NULL && (hierarchyNodes > 0 || useRenderQueue)) {
+        /* The hierarchy has one MVP per cube, the render queue streams its instances once per frame. */
+        printf("Stereo is not supported with --hierarchy or --render-queue\n");
+        return -1;
     }
 
-    // 4. Activate the window (display it).
-    glfwMakeContextCurrent(window);
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    /* See the "01_gles_glfw" example for the GLFW steps. This also handles the
+     * "--headless" and "--frames N" command line options. */
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
 
     // 5. Set the view port to match the window size.
     {
         int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
         glViewport(0, 0, display_w, display_h);
     }
 
+    startupPhase("shaders");
     // 6. Create the vertex shader.
     unsigned int vertex_shader;
     {
@@ -194,87 +367,136 @@ int main(int argc, char **argv) {
         glDeleteShader(fragment_shader);
     }
 
-    // V.1. Create a Vertex Buffer object for vertices data
-    const float vertices[] = {
-        // Cube coordinates. texture coords are not used for now.
-        // stride will be: (3 + 2) * sizeof(float)
-        // positions          // texture coords
-        -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
-         0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
-         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
-
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-         0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-         0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f, 1.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-
-        -0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-        -0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-        -0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-
-         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-         0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-         0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-         0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-         0.5f, -0.5f, -0.5f,  1.0f, 1.0f,
-         0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-         0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-
-        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
-         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f, 0.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f
-    };
-
-    unsigned int vertices_vbo;
-    {
-        // V.1.1. Generate the buffer object.
-        glGenBuffers(1, &vertices_vbo);
+    // S.1. "--stereo": the eye targets and the programs of the modes (compare: both, if multiview is supported).
+    /* The eyes are half of the framebuffer each. The first pipeline's program replaces the mono program. */
+    StereoPipeline stereoPipelines[STEREO_MODE_COUNT];
+    int stereoPipelineCount = 0;
+    int stereoActive = 0;
+    if (stereoArg != NULL) {
+        StereoMode modes[STEREO_MODE_COUNT] = { STEREO_TWO_PASS, STEREO_MULTIVIEW };
+        int modeCount = 2;
+        if (!stereoCompare) {
+            modes[0] = findStereoMode(stereoArg);
+            modeCount = 1;
+        } else if (!stereoMultiviewSupported()) {
+            printf("Stereo compare: GL_OVR_multiview2 is not supported, only the two pass mode is measured\n");
+            modeCount = 1;
+        }
 
-        // V.1.2. Bind the VBO to the "GL_ARRAY_BUFFER".
-        glBindBuffer(GL_ARRAY_BUFFER, vertices_vbo);
+        int display_w, display_h;
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
+        for (int idx = 0; idx < modeCount; idx++) {
+            StereoPipeline* pipeline = &stereoPipelines[stereoPipelineCount];
+            memset(pipeline, 0, sizeof(*pipeline));
+            if (!initStereoTarget(&pipeline->target, modes[idx], display_w / 2, display_h)) {
+                return -3;
+            }
+
+            std::string source = stereo_vertex_src;
+            source.insert(source.find('\n') + 1, stereoShaderHeader(modes[idx]));
+            pipeline->program = createCachedProgram(source.c_str(), fragment_src);
+            if (pipeline->program == 0) {
+                return -3;
+            }
+            stereoSetupProgram(pipeline->program);
+            pipeline->modelLoc = glGetUniformLocation(pipeline->program, "model");
+            pipeline->colorLoc = glGetUniformLocation(pipeline->program, "uColor");
+            stereoPipelineCount++;
+        }
 
-        // V.1.3. "Upload" the data for the active "GL_ARRAY_BUFFER".
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+        glDeleteProgram(shader_program);
+        shader_program = stereoPipelines[0].program;
+        printf("Stereo: %s, %dx%d per eye\n", stereoModeName(stereoPipelines[0].target.mode), display_w / 2, display_h);
+    }
 
-        // V.1.4. Unbind the "GL_ARRAY_BUFFER".
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    startupPhase("meshes");
+    // V.1. Create the indexed cube mesh: VAO with the vertex (VBO) and index (IBO) buffers.
+    /* See common/mesh.h: the duplicated vertices are merged and the triangles are
+     * reordered for the vertex cache. "--packed-vertices" selects half float
+     * positions (12 byte vertices instead of 20). */
+    /* The hierarchy program has its own attribute locations: the mesh is set up for that program. */
+    unsigned int hierarchy_program = 0;
+    if (hierarchyNodes > 0) {
+        hierarchy_program = createCachedProgram(hierarchy_vertex_src, fragment_src);
     }
 
-    // V.1.2. Specify the Vertex Array Object.
-    /* VAO is used to describe how the VBOs are accessed (layout/format). */
-    unsigned int vao;
+    MeshBuffers cube;
     {
-        int aPosLoc = glGetAttribLocation(shader_program, "aPos");
+        MeshData cubeMesh = createCubeMesh();
+        unsigned int meshProgram = hierarchy_program ? hierarchy_program : shader_program;
+        cube = uploadMesh(cubeMesh, packedVertices, glGetAttribLocation(meshProgram, "aPos"), -1);
+    }
 
-        glGenVertexArrays(1, &vao);
+    startupPhase("scene");
+    // H.1. Hierarchy mode: the scene graph and the stream buffer of the per cube MVP matrices.
+    TransformHierarchy hierarchy;
+    std::vector<float> hierarchySpeeds;
+    StreamBuffer mvpStream;
+    int hierarchyColorLoc = -1;
+    if (hierarchyNodes > 0) {
+        hierarchyColorLoc = glGetUniformLocation(hierarchy_program, "uColor");
+        createCubeHierarchy(&hierarchy, hierarchyNodes, &hierarchySpeeds);
+        initStreamBuffer(&mvpStream, GL_ARRAY_BUFFER, hierarchyNodes * 16 * sizeof(float));
+
+        // H.1.1. The mat4 attribute uses the locations 4-7, one column each (the offset is set every frame).
+        glBindVertexArray(cube.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, mvpStream.buffer);
+        for (int column = 0; column < 4; column++) {
+            glVertexAttribPointer(4 + column, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float), (void*)(intptr_t)(column * 4 * sizeof(float)));
+            glVertexAttribDivisor(4 + column, 1);
+            glEnableVertexAttribArray(4 + column);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        printf("%d cube hierarchy, %s transforms\n", hierarchyNodes, scalarTransforms ? "scalar" : transformHierarchyImplementation());
+    }
 
-        glBindVertexArray(vao);
+    // I.1. Create the per cube data for the cube field.
+    /* The cubes are placed on a grid (side * side * side), filled up to "cubeCount". */
+    std::vector<float> instances;
+    int fieldSide = (int)ceil(cbrt((double)cubeCount));
+    const float cubeSpacing = 2.0f;
+    for (int idx = 0; idx < cubeCount; idx++) {
+        int x = idx % fieldSide;
+        int y = (idx / fieldSide) % fieldSide;
+        int z = idx / (fieldSide * fieldSide);
+        float center = (fieldSide - 1) * 0.5f;
+
+        instances.push_back((x - center) * cubeSpacing);
+        instances.push_back((y - center) * cubeSpacing);
+        instances.push_back(-z * cubeSpacing);
+        instances.push_back((float)idx * 0.37f);
+    }
 
-        glBindBuffer(GL_ARRAY_BUFFER, vertices_vbo);
+    // I.2. Upload the per cube data and use it as an instanced attribute (one element per cube).
+    int aInstanceLoc = glGetAttribLocation(shader_program, "aInstance");
+    unsigned int instances_vbo = 0;
+    if (cubeCount > 0 && !naiveDraws && !useRenderQueue) {
+        glGenBuffers(1, &instances_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, instances_vbo);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(float), instances.data(), GL_STATIC_DRAW);
+
+        glBindVertexArray(cube.vao);
+        glVertexAttribPointer(aInstanceLoc, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), NULL);
+        glVertexAttribDivisor(aInstanceLoc, 1);
+        glEnableVertexAttribArray(aInstanceLoc);
+        glBindVertexArray(0);
 
-        glVertexAttribPointer(aPosLoc, 3, GL_FLOAT, GL_FALSE, (3 + 2) * sizeof(float), NULL);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    } else {
+        /* Disabled attribute: the current (constant) value is used, the naive mode sets it per cube. */
+        glVertexAttrib4f(aInstanceLoc, 0.0f, 0.0f, 0.0f, 0.0f);
+    }
 
-        // 10.3. Enable the usage of the vertex input array.
-        glEnableVertexAttribArray(aPosLoc);
+    // Q.1. The render queue streams the instance values of the sorted items.
+    RenderQueue renderQueue;
+    if (useRenderQueue) {
+        initRenderQueue(&renderQueue, aInstanceLoc, cubeCount * 4 * sizeof(float));
+    }
 
-        glBindVertexArray(0);
+    if (cubeCount > 0 || hierarchyNodes > 0 || stereoPipelineCount > 0) {
+        // Measure the rendering speed, not the vsync.
+        demoSwapInterval(&demo, 0);
     }
 
     // 11. Query the uniform location
@@ -283,31 +505,81 @@ int main(int argc, char **argv) {
         uniformColorLoc = glGetUniformLocation(shader_program, "uColor");
     }
 
+    // 12. The camera and the cube transform: the matrices and their uniforms only change with the inputs.
+    /* See common/camera.h: the projection follows the window size, the view is static. */
     int projectionLoc = glGetUniformLocation(shader_program, "projection");
+    int modelLoc = glGetUniformLocation(shader_program, "model");
+    int viewLoc  = glGetUniformLocation(shader_program, "view");
+
+    Camera camera;
+    TransformComponent cubeTransform;
+    uint32_t uniformCameraVersion = 0;
     {
-        int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
+        // The cube field can be further away than the default far plane.
+        float farPlane = fieldSide * cubeSpacing * 3.0f > 100.0f ? fieldSide * cubeSpacing * 3.0f : 100.0f;
+        initCamera(&camera, glm::radians(45.0f), 0.1f, farPlane);
+
+        // Move back the camera to see the front of the cube field.
+        TransformComponent viewTransform;
+        initTransform(&viewTransform);
+        transformSetTranslation(&viewTransform, 0.0f, 0.0f, -3.0f - fieldSide * cubeSpacing);
+        updateTransform(&viewTransform);
+        cameraSetView(&camera, viewTransform.matrix);
+
+        initTransform(&cubeTransform);
+    }
 
-        glm::mat4 projection = glm::mat4(1.0f);
-        projection = glm::perspective(glm::radians(45.0f), (float)display_w / (float)display_h, 0.1f, 100.0f);
-        glUseProgram(shader_program);
+    glEnable(GL_DEPTH_TEST);
+    static float color = 0;
 
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, &projection[0][0]);
+    // X. Frame statistics of the cube field mode.
+    double statsStartTime = demoGetTime(&demo);
+    double statsSubmitTime = 0.0;
+    double statsSortTime = 0.0;
+    int statsQueueRebuilds = 0;
+    uint32_t renderQueueVersion = 0;
+    int statsFrames = 0;
+    int stereoIntervals = 0;
+    int drawCalls = 0;
+    double statsTransformTime = 0.0;
+
+    startupPhase("pipeline warmup");
+    // W.1. "--pipeline-warmup": draw the state combinations of the frames once, before the first frame.
+    /* The cube is drawn with depth test into the default framebuffer: solid and (single cube or
+     * render queue) wireframe, the hierarchy mode uses its own program. */
+    if (pipelineWarmup) {
+        PipelineWarmup warmup;
+        PipelineState state = defaultPipelineState(hierarchy_program ? hierarchy_program : shader_program, cube.vao);
+        state.indexType = cube.indexType;
+        state.depthTest = true;
+        state.framebuffer = demoDefaultFramebuffer(&demo);
+        pipelineWarmupAdd(&warmup, state);
+        if (hierarchyNodes == 0 && (cubeCount == 0 || useRenderQueue)) {
+            state.mode = GL_LINES;
+            pipelineWarmupAdd(&warmup, state);
+        }
 
-        glUseProgram(0);
+        runPipelineWarmup(&warmup);
+        printf("Pipeline warmup: %d states in %.3f ms\n", warmup.draws, warmup.ms);
+        destroyPipelineWarmup(&warmup);
     }
 
+    // W.2. "--first-frame-time": the first frame and the average of the next 30, every frame waits for the GPU.
+    const int firstFrameCompare = 30;
+    double firstFrameMs = 0.0;
+    double nextFramesMs = 0.0;
+    int timedFrames = 0;
 
-    int modelLoc = glGetUniformLocation(shader_program, "model");
-    int viewLoc  = glGetUniformLocation(shader_program, "view");
+    // X. "--alloc-check": the steady state frames must not touch the heap (the render queue keeps its buffers).
+    AllocationCheck allocationCheck;
+    initAllocationCheck(&allocationCheck, 10);
 
-    glEnable(GL_DEPTH_TEST);
-    static float color = 0;
     // X. Create a render loop.
-    while (!glfwWindowShouldClose(window))
+    while (!demoShouldClose(&demo))
     {
         // X. Poll and handle events (inputs, window resize, etc.)
-        glfwPollEvents();
+        demoPollEvents(&demo);
+        double frameStart = demoGetTime(&demo);
 
         // X. Clear the color image.
         glClearColor(0.0, 0.3, 0.3, 1.0f);
@@ -317,38 +589,262 @@ int main(int argc, char **argv) {
         glUseProgram(shader_program);
 
         // V.3. Use the VAO
-        glBindVertexArray(vao);
+        glBindVertexArray(cube.vao);
 
-        // XX. Update the transformation matrix.
+        // XX. Update the transformation matrices, set the uniforms only if they changed.
         {
-            glm::mat4 model         = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
-            glm::mat4 view          = glm::mat4(1.0f);
-
-            //model = glm::rotate(model, glm::radians(-55.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-            model = glm::rotate(model, (float)glfwGetTime() * glm::radians(50.0f), glm::vec3(0.5f, 1.0f, 0.0f));
-            view  = glm::translate(view, glm::vec3(.0f, 0.0f, -3.0f));
-            // retrieve the matrix uniform locations
-            // pass them to the shaders (3 different ways)
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-            glUniformMatrix4fv(viewLoc, 1, GL_FALSE, &view[0][0]);
+            int display_w, display_h;
+            demoGetFramebufferSize(&demo, &display_w, &display_h);
+            cameraSetViewport(&camera, display_w, display_h);
+            updateCamera(&camera);
+            if (camera.version != uniformCameraVersion) {
+                glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, camera.projection);
+                glUniformMatrix4fv(viewLoc, 1, GL_FALSE, camera.view);
+                uniformCameraVersion = camera.version;
+            }
+
+            transformSetRotation(&cubeTransform, 0.5f, 1.0f, 0.0f, (float)demoAnimationTime(&demo) * glm::radians(50.0f));
+            if (updateTransform(&cubeTransform)) {
+                glUniformMatrix4fv(modelLoc, 1, GL_FALSE, cubeTransform.matrix);
+            }
+
+            // S.2. The eyes are 0.064 units apart, the projection has the aspect ratio of an eye.
+            if (stereoPipelineCount > 0) {
+                StereoTarget* target = &stereoPipelines[stereoActive].target;
+                const float eyeOffset = 0.032f;
+                float farPlane = camera.farPlane;
+                glm::mat4 view;
+                memcpy(glm::value_ptr(view), camera.view, sizeof(camera.view));
+                glm::mat4 views[2] = {
+                    glm::translate(glm::mat4(1.0f), glm::vec3(eyeOffset, 0.0f, 0.0f)) * view,
+                    glm::translate(glm::mat4(1.0f), glm::vec3(-eyeOffset, 0.0f, 0.0f)) * view,
+                };
+                glm::mat4 eyeProjection =
+                    glm::perspective(glm::radians(45.0f), (float)target->width / (float)target->height, 0.1f, farPlane);
+                glm::mat4 projections[2] = { eyeProjection, eyeProjection };
+                stereoSetEyes(target, &views[0][0][0], &projections[0][0][0]);
+            }
+        }
+
+        // X. Draw the triangles (stereo: into the eye layers, once per pass).
+        StereoPipeline* stereo = stereoPipelineCount > 0 ? &stereoPipelines[stereoActive] : NULL;
+        int passCount = stereo ? stereoPassCount(&stereo->target) : 1;
+        drawCalls = 0;
+        for (int pass = 0; pass < passCount; pass++) {
+            if (stereo) {
+                stereoBeginEye(&stereo->target, shader_program, pass);
+            }
+            glUniform3f(uniformColorLoc, 0.1, 0.8, 0.9);
+            if (hierarchyNodes > 0) {
+                // H.2. Animate the local rotations in place: a spin around the Y axis (quaternion y and w).
+                float time = (float)demoAnimationTime(&demo);
+                for (int idx = 0; idx < hierarchy.count; idx++) {
+                    float angle = time * hierarchySpeeds[idx];
+                    hierarchy.rotationY[idx] = sinf(angle * 0.5f);
+                    hierarchy.rotationW[idx] = cosf(angle * 0.5f);
+                }
+
+                // H.3. World and MVP matrices of every node, written straight into the mapped instance buffer.
+                int display_w, display_h;
+                demoGetFramebufferSize(&demo, &display_w, &display_h);
+                glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)display_w / (float)display_h, 0.1f, 100.0f);
+                glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 10.0f, 16.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+                glm::mat4 viewProjection = projection * view;
+
+                auto transformStart = std::chrono::steady_clock::now();
+                streamBufferBeginFrame(&mvpStream);
+                int mvpOffset;
+                float* mvp = (float*)streamBufferAllocate(&mvpStream, hierarchy.count * 16 * sizeof(float), 16, &mvpOffset);
+                if (mvp != NULL) {
+                    if (scalarTransforms) {
+                        updateTransformHierarchyScalar(&hierarchy, glm::value_ptr(viewProjection), mvp);
+                    } else {
+                        updateTransformHierarchy(&hierarchy, glm::value_ptr(viewProjection), mvp);
+                    }
+                }
+                streamBufferEndFrame(&mvpStream);
+                statsTransformTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - transformStart).count();
+
+                // H.4. Point the instance attributes to this frame's matrices and draw every cube at once.
+                glUseProgram(hierarchy_program);
+                glBindBuffer(GL_ARRAY_BUFFER, mvpStream.buffer);
+                for (int column = 0; column < 4; column++) {
+                    glVertexAttribPointer(4 + column, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float),
+                                          (void*)(intptr_t)(mvpOffset + column * 4 * sizeof(float)));
+                }
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+                glUniform3f(hierarchyColorLoc, 0.9, 0.6, 0.2);
+                glDrawElementsInstanced(GL_TRIANGLES, cube.indexCount, cube.indexType, NULL, hierarchy.count);
+                drawCalls += 1;
+            } else if (cubeCount == 0) {
+                glDrawElements(GL_TRIANGLES, cube.indexCount, cube.indexType, NULL);
+
+                // Draw a bit of wireframe. It will be incomplete but it's ok for now.
+                glUniform3f(uniformColorLoc, 0.0, 0.0, 0.0);
+                glDrawElements(GL_LINES, cube.indexCount, cube.indexType, NULL);
+                drawCalls += 2;
+            } else {
+                // I.3. Draw the cube field: one instanced draw or one draw per cube.
+                /* The submit time is the CPU time spent in the GL calls (driver overhead). */
+                auto submitStart = std::chrono::steady_clock::now();
+                if (useRenderQueue && (!renderQueue.retained || renderQueueVersion != camera.version)) {
+                    // Q.2. One item per cube in grid order, the wireframe cubes are interleaved with the solid ones.
+                    /* Depth: the distance along the view axis (the view only moves back the camera).
+                     * The field is static: the items only depend on the camera, they are rebuilt when it changes. */
+                    float cameraDistance = -camera.view[14];
+                    float farPlane = camera.farPlane;
+                    renderQueueClear(&renderQueue);
+                    for (int idx = 0; idx < cubeCount; idx++) {
+                        const float* instance = &instances[idx * 4];
+                        bool wireframe = idx % 8 == 7;
+                        float depth = (cameraDistance - instance[2]) / farPlane;
+
+                        RenderQueueItem item = {
+                            renderQueueKey(0, 1, 1, 0, wireframe ? 1 : 0, depth), shader_program, cube.vao, 0,
+                            (unsigned int)(wireframe ? GL_LINES : GL_TRIANGLES), 0, cube.indexCount, cube.indexType,
+                            { instance[0], instance[1], instance[2], instance[3] },
+                        };
+                        renderQueueAdd(&renderQueue, item);
+                    }
+                    renderQueueVersion = camera.version;
+                    statsQueueRebuilds++;
+                }
+                if (useRenderQueue) {
+                    // Q.3. Sort (if rebuilt), merge and draw, keep the items for the next frames.
+                    renderQueueSubmit(&renderQueue, true);
+                    drawCalls += renderQueue.drawCalls;
+                    statsSortTime += renderQueue.sortMs / 1000.0;
+                } else if (naiveDraws) {
+                    for (int idx = 0; idx < cubeCount; idx++) {
+                        glVertexAttrib4fv(aInstanceLoc, &instances[idx * 4]);
+                        glDrawElements(GL_TRIANGLES, cube.indexCount, cube.indexType, NULL);
+                    }
+                    drawCalls += cubeCount;
+                } else {
+                    glDrawElementsInstanced(GL_TRIANGLES, cube.indexCount, cube.indexType, NULL, cubeCount);
+                    drawCalls += 1;
+                }
+                statsSubmitTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - submitStart).count();
+            }
         }
 
-        // X. Draw the triangles.
-        glUniform3f(uniformColorLoc, 0.1, 0.8, 0.9);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        // S.3. Show the eyes side by side.
+        if (stereo) {
+            int display_w, display_h;
+            demoGetFramebufferSize(&demo, &display_w, &display_h);
+            stereoComposite(&stereo->target, demoDefaultFramebuffer(&demo), display_w, display_h);
+        }
 
-        // Draw a bit of wireframe. It will be incomplete but it's ok for now.
-        glUniform3f(uniformColorLoc, 0.0, 0.0, 0.0);
-        glDrawArrays(GL_LINES, 0, 36);
+        hudCounter("draw calls", drawCalls);
+        if (useRenderQueue && cubeCount > 0) {
+            hudCounter("state changes", renderQueue.stateChanges);
+        }
 
         // X. Swap the fron-back buffers to display the rendered image in the window.
-        glfwSwapBuffers(window);
+        demoSwapBuffers(&demo);
+
+        if (allocCheck) {
+            allocationCheckEndFrame(&allocationCheck);
+        }
+
+        // W.3. Time the first frames including the GPU work.
+        if (firstFrameTime && timedFrames <= firstFrameCompare) {
+            glFinish();
+            double frameMs = (demoGetTime(&demo) - frameStart) * 1000.0;
+            if (timedFrames == 0) {
+                firstFrameMs = frameMs;
+            } else {
+                nextFramesMs += frameMs;
+            }
+            timedFrames++;
+            if (timedFrames == firstFrameCompare + 1) {
+                printf("First frame: %.3f ms, the next %d frames: %.3f ms/frame\n", firstFrameMs, firstFrameCompare,
+                       nextFramesMs / firstFrameCompare);
+            }
+        }
+
+        // X. Report the frame time once every second.
+        statsFrames++;
+        double statsElapsed = demoGetTime(&demo) - statsStartTime;
+        if ((cubeCount > 0 || hierarchyNodes > 0 || stereoPipelineCount > 0) && statsElapsed >= 1.0) {
+            if (hierarchyNodes > 0) {
+                printf("%d hierarchy nodes: %.3f ms/frame, %.3f ms/frame transform update\n",
+                       hierarchyNodes, statsElapsed * 1000.0 / statsFrames, statsTransformTime * 1000.0 / statsFrames);
+            } else {
+                printf("%d cubes, %d draw calls/frame: %.3f ms/frame, %.3f ms/frame submit\n",
+                       cubeCount, drawCalls, statsElapsed * 1000.0 / statsFrames, statsSubmitTime * 1000.0 / statsFrames);
+            }
+            if (useRenderQueue) {
+                printf("  render queue: %.3f ms/frame sort, %.3f ms/frame merge and draw, %d state changes, %d/%d frames rebuilt\n",
+                       statsSortTime * 1000.0 / statsFrames, renderQueue.submitMs, renderQueue.stateChanges,
+                       statsQueueRebuilds, statsFrames);
+            }
+
+            // S.4. The frame times of the stereo modes (the first second is the warm-up), compare: switch the mode.
+            if (stereoPipelineCount > 0) {
+                StereoPipeline* pipeline = &stereoPipelines[stereoActive];
+                printf("  stereo %s: %d passes/frame\n", stereoModeName(pipeline->target.mode), stereoPassCount(&pipeline->target));
+                if (stereoIntervals++ > 0) {
+                    pipeline->frames += statsFrames;
+                    pipeline->seconds += statsElapsed;
+                    pipeline->submitSeconds += statsSubmitTime;
+                    pipeline->drawCalls = drawCalls;
+                }
+
+                stereoActive = (stereoActive + 1) % stereoPipelineCount;
+                shader_program = stereoPipelines[stereoActive].program;
+                modelLoc = stereoPipelines[stereoActive].modelLoc;
+                uniformColorLoc = stereoPipelines[stereoActive].colorLoc;
+            }
+            statsStartTime = demoGetTime(&demo);
+            statsSubmitTime = 0.0;
+            statsTransformTime = 0.0;
+            statsSortTime = 0.0;
+            statsQueueRebuilds = 0;
+            statsFrames = 0;
+        }
     }
 
-    // XX. Destroy the window.
-    glfwDestroyWindow(window);
-    // XX. Destroy the GLFW.
-    glfwTerminate();
+    if (allocCheck) {
+        printf("Allocation check: %d frames, %d heap allocations after the warm-up\n",
+               allocationCheck.frame, (int)allocationCheck.steadyAllocations);
+    }
+
+    // S.5. The last (partial) interval and the frame time of every stereo mode.
+    if (stereoPipelineCount > 0 && stereoIntervals > 0 && statsFrames > 0) {
+        StereoPipeline* pipeline = &stereoPipelines[stereoActive];
+        pipeline->frames += statsFrames;
+        pipeline->seconds += demoGetTime(&demo) - statsStartTime;
+        pipeline->submitSeconds += statsSubmitTime;
+        pipeline->drawCalls = drawCalls;
+    }
+    for (int idx = 0; idx < stereoPipelineCount; idx++) {
+        StereoPipeline* pipeline = &stereoPipelines[idx];
+        if (pipeline->frames > 0) {
+            printf("Stereo %s: %.3f ms/frame, %.3f ms/frame submit (%d frames, %d draw calls/frame)\n",
+                   stereoModeName(pipeline->target.mode), pipeline->seconds * 1000.0 / pipeline->frames,
+                   pipeline->submitSeconds * 1000.0 / pipeline->frames, pipeline->frames, pipeline->drawCalls);
+        }
+        destroyStereoTarget(&pipeline->target);
+        glDeleteProgram(pipeline->program);
+    }
+
+    if (instances_vbo) {
+        glDeleteBuffers(1, &instances_vbo);
+    }
+    if (useRenderQueue) {
+        destroyRenderQueue(&renderQueue);
+    }
+    if (hierarchyNodes > 0) {
+        destroyStreamBuffer(&mvpStream);
+        glDeleteProgram(hierarchy_program);
+    }
+
+    // XX. Destroy the cube buffers.
+    destroyMeshBuffers(&cube);
+
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
 
     return 0;
 }
@@ -7,12 +7,51 @@
  * Run:
  * $ ./gles_floor
  *
+ * Draw a large textured floor seen at an oblique angle instead of the screen
+ * space checker: the classic case of the texture filtering (the far texels are
+ * minified much more along the view direction than across it). The sampler
+ * object comes from the shared sampler cache (see common/sampler_cache.h):
+ * $ ./gles_floor --textured --filter trilinear --anisotropy 8 --lod-bias -0.5
+ *
+ * Measure the sampling cost of every filter mode (and anisotropy level): the
+ * floor is drawn "--overdraw N" times with each and the GPU and wall time of
+ * one draw is printed every second:
+ * $ ./gles_floor --sampler-benchmark --overdraw 8
+ *
+ * Anti-alias the procedural checker analytically instead of with MSAA: the
+ * pattern is box filtered over the pixel footprint with the screen space
+ * derivatives (see common/checker_pattern.h), "filtered-mediump" computes it
+ * in a mediump shader. "--msaa N" draws the point sampled checker into an
+ * N-sample renderbuffer resolved with a blit, "--checker-repeats N" sets the
+ * cells per floor side (default: 10):
+ * $ ./gles_floor --checker filtered --checker-repeats 200
+ * $ ./gles_floor --msaa 4 --checker-repeats 200
+ *
+ * Measure the checker modes against each other and against the 4x MSAA path
+ * (the floor is drawn "--overdraw N" times with each, as in the sampler benchmark):
+ * $ ./gles_floor --checker-benchmark --overdraw 8 --checker-repeats 200
+ *
+ * Replace the floor with a GPU tessellated terrain (see common/terrain.h): a grid of
+ * "--terrain-patches N" patches per side (default: 32) subdivided until the edges are
+ * "--terrain-edge-pixels N" pixels long on the screen (default: 12). The camera circles
+ * around the terrain and the generated triangles per frame are printed every second:
+ * $ ./gles_floor --terrain --terrain-edge-pixels 8
+ *
+ * Split the floor into "--tiles N" x N tiles of one vertex buffer, each with its own color
+ * (the per draw data, indexed by the draw of the tile), and submit them in one multi-draw
+ * call (see common/multi_draw.h) instead of a draw and a uniform per tile. "--multi-draw"
+ * selects loop (the baseline), ext (GL_EXT_multi_draw_arrays), angle (GL_ANGLE_multi_draw)
+ * or auto (the default); the GL calls per frame are printed every second:
+ * $ ./gles_floor --tiles 16 --multi-draw loop
+ * $ ./gles_floor --tiles 16 --sampler-benchmark --multi-draw auto
+ *
  * Dependencies:
  *  * C++11
  *  * GLFW 3.0+
  *  * GLM
- *  * Open GL ES 3.0+
+ *  * Open GL ES 3.0+ (the terrain: 3.2 or 3.1 + GL_EXT_tessellation_shader)
  *  * EGL
+ *  * GL_EXT_multi_draw_arrays or GL_ANGLE_multi_draw (optional, "--tiles N")
  *
  * MIT License
  * Copyright (c) 2020 elecro
@@ -35,30 +74,67 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  * OFTWARE.
  */
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
 
-#include <GLFW/glfw3.h>
 #include <GLES3/gl3.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "common/camera.h"
+#include "common/checker_pattern.h"
+#include "common/demo_context.h"
+#include "common/gpu_timer.h"
+#include "common/multi_draw.h"
+#include "common/program_cache.h"
+#include "common/render_target_pool.h"
+#include "common/sampler_cache.h"
+#include "common/terrain.h"
+#include "common/uniform_ring.h"
+
 const char* vertex_src = R"(#version 310 es
 precision highp float;
 
-in vec2 aPos;
+layout(location = 0) in vec2 aPos;
 out vec2 checkerCoord;
-
-uniform mat4 projection;
-uniform mat4 model;
-uniform mat4 view;
+out vec2 texCoord;
+
+layout(std140) uniform FrameConstants {
+    mat4 projection;
+    mat4 view;
+};
+
+layout(std140) uniform ObjectConstants {
+    mat4 model;
+    vec4 color;
+};
+
+#ifdef TILED
+// The per draw data of the tiles: DRAW_INDEX is the draw of the tile in the batch (see common/multi_draw.h).
+layout(std140) uniform TileColors {
+    vec4 tileColors[256];
+};
+flat out vec4 tileColor;
+#endif
 
 void main() {
     gl_Position = projection * view * model * vec4(aPos, 0.0, 1.0);
+#ifdef TILED
+    tileColor = tileColors[DRAW_INDEX];
+#endif
 
     // Move the position coordinate into the [0, 1] range.
     checkerCoord = (gl_Position.xy + vec2(1.0f)) / vec2(2.0);
+
+    // The texture repeats 64 times over the floor.
+    texCoord = (aPos + vec2(0.5)) * 64.0;
 }
 )";
 
@@ -66,60 +142,226 @@ const char* fragment_src = R"(#version 310 es
 precision highp float;
 
 in vec2 checkerCoord;
+in vec2 texCoord;
 
 out vec4 outColor;
 
-uniform vec3 uColor;
+#ifdef TEXTURED
+uniform sampler2D floorTexture;
+// The ES samplers have no LOD bias state: it is a parameter of the texture call.
+uniform float lodBias;
+#else
+uniform float checkerRepeats;
+#endif
 
-float checker(vec2 uv, float repeats)
-{
-  float cx = floor(repeats * uv.x);
-  float cy = floor(repeats * uv.y);
-  float result = mod(cx + cy, 2.0);
-  return sign(result);
-}
+layout(std140) uniform ObjectConstants {
+    mat4 model;
+    vec4 color;
+};
+
+#ifdef TILED
+flat in vec4 tileColor;
+#define OBJECT_COLOR tileColor
+#else
+#define OBJECT_COLOR color
+#endif
+
+// The checker functions are inserted after the precision statement (see common/checker_pattern.h).
 
 void main() {
+#ifdef TEXTURED
+    outColor = texture(floorTexture, texCoord, lodBias) * mix(OBJECT_COLOR, vec4(1.0), 0.5);
+#else
     vec2 uv = checkerCoord.xy;
-    float checkerColor = mix(1.0f, 0.0f, checker(uv, 10.0f));
-
-    outColor = vec4(vec3(checkerColor) * uColor, 1.0f) ;
+#ifdef CHECKER_FILTERED
+    float pattern = checkerFiltered(uv, checkerRepeats);
+#else
+    float pattern = checker(uv, checkerRepeats);
+#endif
+    float checkerColor = mix(1.0f, 0.0f, pattern);
+
+    outColor = vec4(vec3(checkerColor) * OBJECT_COLOR.rgb, 1.0f) ;
+#endif
 }
 )";
 
-static void ErrorCallbackGLFW(int error, const char* description) {
-    printf("Glfw Error %d: %s\n", error, description);
+// Binding point of the "TileColors" block next to the constant blocks (see common/uniform_ring.h).
+#define TILE_COLORS_BINDING 2
+// Tiles per floor side: the "TileColors" array has a color for each tile.
+#define MAX_FLOOR_TILES 16
+
+// Tiled floor: 2 triangles per tile, "aPos" and the index of the tile ("aDrawIndex" of the ext mode).
+static std::vector<float> createTileVertices(int tiles) {
+    std::vector<float> vertices;
+    const float corners[6][2] = { { 0, 1 }, { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 }, { 1, 0 } };
+    for (int y = 0; y < tiles; y++) {
+        for (int x = 0; x < tiles; x++) {
+            for (int corner = 0; corner < 6; corner++) {
+                vertices.push_back((x + corners[corner][0]) / tiles - 0.5f);
+                vertices.push_back((y + corners[corner][1]) / tiles - 0.5f);
+                vertices.push_back((float)(y * tiles + x));
+            }
+        }
+    }
+    return vertices;
+}
+
+// High contrast pattern for the filter comparison: 16 texel checker with 1 texel lines, every mip level.
+static unsigned int createFloorTexture() {
+    const int size = 512;
+    std::vector<unsigned char> pixels(size * size * 4);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            unsigned char value = (((x >> 4) ^ (y >> 4)) & 1) ? 230 : 40;
+            if (x % 64 == 0 || y % 64 == 0) {
+                value = 255 - value;
+            }
+            unsigned char* texel = &pixels[(y * size + x) * 4];
+            texel[0] = value;
+            texel[1] = value;
+            texel[2] = value;
+            texel[3] = 255;
+        }
+    }
+
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 10, GL_RGBA8, size, size);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+// Bind an N-sample color renderbuffer of the pool as the framebuffer (the floor has no depth).
+static RenderTarget* acquireMsaaTarget(RenderTargetPool* pool, int width, int height, int samples) {
+    RenderTargetKey key = { RENDER_TARGET_RENDERBUFFER, GL_RGBA8, width, height, samples };
+    RenderTarget* target = acquireRenderTarget(pool, key);
+    if (target != NULL) {
+        glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+    }
+    return target;
+}
+
+// Resolve the samples into "framebuffer" and bind it, the samples are discarded after the blit.
+static void resolveMsaaTarget(const RenderTarget* target, unsigned int framebuffer, int width, int height) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target->fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    const GLenum attachment = GL_COLOR_ATTACHMENT0;
+    glInvalidateFramebuffer(GL_READ_FRAMEBUFFER, 1, &attachment);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
 }
 
 int main(int argc, char **argv) {
-    // 0. Add a method to report any GLFW errors.
-    glfwSetErrorCallback(ErrorCallbackGLFW);
+    // "--textured": the textured floor with the sampler of the "--filter", "--anisotropy", "--lod-bias"
+    // and "--min-lod" options (see common/sampler_cache.h). "--sampler-benchmark" draws it "--overdraw N"
+    // times with every filter mode. "--checker-benchmark" does the same with every checker mode and MSAA.
+    bool textured = false;
+    bool benchmark = false;
+    bool checkerBenchmark = false;
+    int overdraw = 8;
+    CheckerMode checkerMode = CHECKER_POINT;
+    float checkerRepeats = 10.0f;
+    int msaaSamples = 1;
+    bool terrainMode = false;
+    int terrainPatches = 32;
+    float terrainEdgePixels = 12.0f;
+    int tiles = 0;
+    const char* multiDrawName = "auto";
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--textured") == 0) {
+            textured = true;
+        } else if (strcmp(argv[idx], "--sampler-benchmark") == 0) {
+            textured = true;
+            benchmark = true;
+        } else if (strcmp(argv[idx], "--overdraw") == 0 && idx + 1 < argc) {
+            overdraw = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--checker") == 0 && idx + 1 < argc) {
+            if (!parseCheckerMode(argv[++idx], &checkerMode)) {
+                return -1;
+            }
+        } else if (strcmp(argv[idx], "--checker-repeats") == 0 && idx + 1 < argc) {
+            checkerRepeats = (float)atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--msaa") == 0 && idx + 1 < argc) {
+            msaaSamples = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--checker-benchmark") == 0) {
+            benchmark = true;
+            checkerBenchmark = true;
+        } else if (strcmp(argv[idx], "--terrain") == 0) {
+            terrainMode = true;
+        } else if (strcmp(argv[idx], "--terrain-patches") == 0 && idx + 1 < argc) {
+            terrainPatches = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--terrain-edge-pixels") == 0 && idx + 1 < argc) {
+            terrainEdgePixels = (float)atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--tiles") == 0 && idx + 1 < argc) {
+            tiles = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--multi-draw") == 0 && idx + 1 < argc) {
+            multiDrawName = argv[++idx];
+        }
+    }
 
-    // 1. Initialize the GLFW library.
-    if (!glfwInit()) {
+    if (checkerRepeats <= 0.0f || msaaSamples < 1) {
+        printf("Invalid checker repeats or MSAA sample count\n");
+        return -1;
+    }
+    if (checkerBenchmark) {
+        textured = false;
+    }
+    if (terrainMode && (textured || benchmark || msaaSamples > 1)) {
+        printf("--terrain can't be combined with the textured floor, the benchmarks or --msaa\n");
+        return -1;
+    }
+    if (terrainPatches < 1 || terrainEdgePixels <= 0.0f) {
+        printf("Invalid terrain patch count or edge length\n");
+        return -1;
+    }
+    if (tiles < 0 || tiles > MAX_FLOOR_TILES || (terrainMode && tiles > 0)) {
+        printf("Invalid tile count: %d (valid range: 1-%d, not with --terrain)\n", tiles, MAX_FLOOR_TILES);
         return -1;
     }
 
-    // 2. Add hints to use during context creation when a GLFW window is created.
-    // Here: require a GL ES 3.0 context.
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
-    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+    SamplerDesc samplerDesc;
+    samplerFilterDesc("trilinear", &samplerDesc);
+    float lodBias = 0.0f;
+    if (!parseSamplerOptions(argc, argv, &samplerDesc, &lodBias) || overdraw < 1) {
+        return -1;
+    }
 
-    // 3. Create window with graphics context
-    GLFWwindow* window = glfwCreateWindow(1024, 600, "GLDEMO", NULL, NULL);
-    if (window == NULL) {
-        return -2;
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    /* See the "01_gles_glfw" example for the GLFW steps. This also handles the
+     * "--headless" and "--frames N" command line options. */
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
     }
 
-    // 4. Activate the window (display it).
-    glfwMakeContextCurrent(window);
+    // M.1. Tiled floor: the multi-draw mode decides how the vertex shader reads the index of the tile.
+    MultiDrawMode multiDrawMode = MULTI_DRAW_LOOP;
+    if (tiles > 0 && !parseMultiDrawMode(multiDrawName, &multiDrawMode)) {
+        destroyDemoContext(&demo);
+        return -1;
+    }
+    if (!multiDrawSupported(multiDrawMode)) {
+        printf("Multi-draw: the %s mode is not supported\n", multiDrawModeNames[multiDrawMode]);
+        destroyDemoContext(&demo);
+        return -3;
+    }
+    std::string tiledVertexSrc = multiDrawShaderSource(vertex_src, multiDrawMode, 1);
+    tiledVertexSrc.insert(tiledVertexSrc.find('\n') + 1, "#define TILED\n");
+    const char* vertexSource = tiles > 0 ? tiledVertexSrc.c_str() : vertex_src;
+    std::string fragmentSource = fragment_src;
+    if (tiles > 0) {
+        fragmentSource.insert(fragmentSource.find('\n') + 1, "#define TILED\n");
+    }
 
     // 5. Set the view port to match the window size.
     {
         int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
         glViewport(0, 0, display_w, display_h);
     }
 
@@ -130,7 +372,7 @@ int main(int argc, char **argv) {
         vertex_shader = glCreateShader(GL_VERTEX_SHADER);
 
         // 6.2. Specify the shader source.
-        glShaderSource(vertex_shader, 1, &vertex_src, NULL);
+        glShaderSource(vertex_shader, 1, &vertexSource, NULL);
 
         // 6.3. Compile the shader.
         glCompileShader(vertex_shader);
@@ -152,8 +394,12 @@ int main(int argc, char **argv) {
         // 7.1. Create a fragment shader object.
         fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
 
-        // 7.2. Specify the shader source.
-        glShaderSource(fragment_shader, 1, &fragment_src, NULL);
+        // 7.2. Specify the shader source (the textured floor and the checker modes are variants of the same shader).
+        std::string texturedSrc = fragmentSource;
+        texturedSrc.insert(texturedSrc.find('\n') + 1, "#define TEXTURED\n");
+        std::string checkerSrc = checkerShaderSource(fragmentSource.c_str(), checkerMode);
+        const char* source = textured ? texturedSrc.c_str() : checkerSrc.c_str();
+        glShaderSource(fragment_shader, 1, &source, NULL);
 
         // 7.3. Compile the shader.
         glCompileShader(fragment_shader);
@@ -239,36 +485,242 @@ int main(int argc, char **argv) {
         glBindVertexArray(0);
     }
 
-    // 11. Query the uniform location
-    int uniformColorLoc;
+    // M.2. Tiled floor: the tiles in one buffer and a color per tile in the "TileColors" block.
+    /* The ranges of the tiles are the same every frame: the batch is filled once. */
+    unsigned int tilesVbo = 0;
+    unsigned int tilesVao = 0;
+    unsigned int tileColorsUbo = 0;
+    MultiDrawBatch tileBatch;
+    if (tiles > 0) {
+        if (!initMultiDrawBatch(&tileBatch, multiDrawMode, shader_program)) {
+            destroyDemoContext(&demo);
+            return -3;
+        }
+
+        std::vector<float> tileVertices = createTileVertices(tiles);
+        glGenBuffers(1, &tilesVbo);
+        glBindBuffer(GL_ARRAY_BUFFER, tilesVbo);
+        glBufferData(GL_ARRAY_BUFFER, tileVertices.size() * sizeof(float), tileVertices.data(), GL_STATIC_DRAW);
+
+        glGenVertexArrays(1, &tilesVao);
+        glBindVertexArray(tilesVao);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 3 * sizeof(float), NULL);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)(2 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // Green and blue tiles as the two triangles of the floor, brighter towards the far side.
+        std::vector<float> tileColors(MAX_FLOOR_TILES * MAX_FLOOR_TILES * 4, 0.0f);
+        for (int tile = 0; tile < tiles * tiles; tile++) {
+            float shade = 0.5f + 0.5f * (float)(tile / tiles + 1) / tiles;
+            bool green = (tile / tiles + tile % tiles) % 2 == 0;
+            tileColors[tile * 4 + 1] = green ? shade : 0.0f;
+            tileColors[tile * 4 + 2] = green ? 0.0f : shade;
+            tileColors[tile * 4 + 3] = 1.0f;
+
+            multiDrawAddArrays(&tileBatch, tile * 6, 6);
+        }
+        glGenBuffers(1, &tileColorsUbo);
+        glBindBuffer(GL_UNIFORM_BUFFER, tileColorsUbo);
+        glBufferData(GL_UNIFORM_BUFFER, tileColors.size() * sizeof(float), tileColors.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, TILE_COLORS_BINDING, tileColorsUbo);
+        glUniformBlockBinding(shader_program, glGetUniformBlockIndex(shader_program, "TileColors"),
+                              TILE_COLORS_BINDING);
+
+        printf("Multi-draw: %s, %dx%d tiles\n", multiDrawModeNames[multiDrawMode], tiles, tiles);
+    }
+    double multiDrawPrintTime = demoGetTime(&demo);
+    int multiDrawFrames = 0;
+
+    // 11. Connect the uniform blocks of the program and create the constant buffers.
+    /* See common/uniform_ring.h: the floor is static, the constants are uploaded only when the
+     * camera (window resize) or the floor transform changes. */
+    ConstantCache frameCache;
+    ConstantCache objectCaches[2];
     {
-        uniformColorLoc = glGetUniformLocation(shader_program, "uColor");
+        bindConstantBlocks(shader_program);
+        initConstantCache(&frameCache, sizeof(FrameConstants));
+        for (int idx = 0; idx < 2; idx++) {
+            initConstantCache(&objectCaches[idx], sizeof(ObjectConstants));
+        }
     }
 
-    int projectionLoc = glGetUniformLocation(shader_program, "projection");
+    // 12. The camera and the floor transform (see common/camera.h), the projection follows the window size.
+    Camera camera;
+    TransformComponent floorTransform;
     {
-        int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
+        initCamera(&camera, glm::radians(45.0f), 0.1f, 100.0f);
+
+        TransformComponent viewTransform;
+        initTransform(&viewTransform);
+        initTransform(&floorTransform);
+        if (textured) {
+            // Large floor, the eye is just above it: the far texels are seen at a grazing angle.
+            transformSetRotation(&floorTransform, 1.0f, 0.0f, 0.0f, glm::radians(-90.0f));
+            transformSetScale(&floorTransform, 20.0f, 20.0f, 20.0f);
+            transformSetTranslation(&viewTransform, 0.0f, -0.3f, 0.0f);
+        } else {
+            transformSetRotation(&floorTransform, 1.0f, 0.0f, 0.0f, glm::radians(-55.0f));
+            transformSetTranslation(&viewTransform, 0.0f, 0.0f, -3.0f);
+        }
+        updateTransform(&viewTransform);
+        cameraSetView(&camera, viewTransform.matrix);
+    }
 
-        glm::mat4 projection = glm::mat4(1.0f);
-        projection = glm::perspective(glm::radians(45.0f), (float)display_w / (float)display_h, 0.1f, 100.0f);
-        glUseProgram(shader_program);
+    // S.1. Textured floor: the mipmapped texture on the unit 0 and the sampler object of the options.
+    /* The texture has no filter parameters: the sampler bound to the unit overrides them. */
+    unsigned int floorTexture = 0;
+    int lodBiasLoc = -1;
+    if (textured) {
+        floorTexture = createFloorTexture();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, floorTexture);
+        glBindSampler(0, getCachedSampler(samplerDesc));
+        lodBiasLoc = glGetUniformLocation(shader_program, "lodBias");
+
+        printf("Sampler: %s, anisotropy %.0f (driver limit %.0f), LOD bias %.2f\n", samplerFilterName(samplerDesc),
+               samplerDesc.anisotropy, maxSamplerAnisotropy(), lodBias);
+    }
+
+    // S.2. Benchmark: every filter mode, then the trilinear filter with every anisotropy level of the driver.
+    std::vector<SamplerDesc> benchmarkSamplers;
+    std::vector<std::string> benchmarkNames;
+    for (int idx = 0; benchmark && textured && idx < SAMPLER_FILTER_COUNT; idx++) {
+        SamplerDesc desc;
+        samplerFilterDesc(samplerFilterNames[idx], &desc);
+        benchmarkSamplers.push_back(desc);
+        benchmarkNames.push_back(samplerFilterNames[idx]);
+    }
+    for (int level = 2; benchmark && textured && level <= 16 && level <= maxSamplerAnisotropy(); level *= 2) {
+        SamplerDesc desc;
+        samplerFilterDesc("trilinear", &desc);
+        desc.anisotropy = (float)level;
+        benchmarkSamplers.push_back(desc);
+        benchmarkNames.push_back("aniso" + std::to_string(level));
+    }
+    if (benchmark && textured && maxSamplerAnisotropy() <= 1.0f) {
+        printf("Benchmark: GL_EXT_texture_filter_anisotropic is not supported, no anisotropic modes\n");
+    }
 
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, &projection[0][0]);
+    // C.1. The cells of the checker (the uniform is not used by the textured floor).
+    glUseProgram(shader_program);
+    glUniform1f(glGetUniformLocation(shader_program, "checkerRepeats"), checkerRepeats);
 
-        glUseProgram(0);
+    // C.2. MSAA: the floor is drawn into a multisampled renderbuffer of the pool and resolved with a blit.
+    int maxSamples = 0;
+    glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+    if (msaaSamples > maxSamples) {
+        printf("Invalid sample count: %d (valid range: 1-%d)\n", msaaSamples, maxSamples);
+        destroyDemoContext(&demo);
+        return -1;
     }
+    RenderTargetPool targetPool;
+    initRenderTargetPool(&targetPool);
+
+    // C.3. Checker benchmark: a program per checker mode, then the point sampled checker with 4x MSAA.
+    std::vector<unsigned int> checkerPrograms;
+    std::vector<int> checkerSamples;
+    for (int idx = 0; checkerBenchmark && idx < CHECKER_MODE_COUNT; idx++) {
+        std::string source = checkerShaderSource(fragmentSource.c_str(), (CheckerMode)idx);
+        unsigned int program = createCachedProgram(vertexSource, source.c_str());
+        bindConstantBlocks(program);
+        if (tiles > 0) {
+            glUniformBlockBinding(program, glGetUniformBlockIndex(program, "TileColors"), TILE_COLORS_BINDING);
+        }
+        glUseProgram(program);
+        glUniform1f(glGetUniformLocation(program, "checkerRepeats"), checkerRepeats);
 
+        checkerPrograms.push_back(program);
+        checkerSamples.push_back(1);
+        benchmarkNames.push_back(checkerModeNames[idx]);
+    }
+    if (checkerBenchmark && maxSamples >= 4) {
+        checkerPrograms.push_back(checkerPrograms[CHECKER_POINT]);
+        checkerSamples.push_back(4);
+        benchmarkNames.push_back("msaa4");
+    }
+    if (!textured && !benchmark && !terrainMode) {
+        printf("Checker: %s, %.0f cells per side, %dx MSAA\n", checkerModeNames[checkerMode], checkerRepeats,
+               msaaSamples);
+    }
 
-    int modelLoc = glGetUniformLocation(shader_program, "model");
-    int viewLoc  = glGetUniformLocation(shader_program, "view");
+    // T.1. The benchmark prints the GPU time of every mode (if the timer queries are supported).
+    GpuTimer gpuTimer;
+    initGpuTimer(&gpuTimer, argc, argv);
+    if (benchmark) {
+        if (!gpuTimerEnableQueries(&gpuTimer)) {
+            printf("Benchmark: GL_EXT_disjoint_timer_query is not supported\n");
+        }
+        gpuTimer.printStats = true;
+        demoSwapInterval(&demo, 0);
+    }
+    std::vector<double> benchmarkMs(benchmarkNames.size(), 0.0);
+    int benchmarkFrames = 0;
+    double benchmarkStartTime = demoGetTime(&demo);
+
+    // L.1. Terrain: 64 x 64 units, 6 units high, the patches are tessellated on the GPU.
+    TessTerrain terrain;
+    if (terrainMode) {
+        if (!initTessTerrain(&terrain, terrainPatches, 64.0f, 6.0f, terrainEdgePixels)) {
+            destroyDemoContext(&demo);
+            return -3;
+        }
+        printf("Terrain: %dx%d patches, %.1f pixel edges, max tessellation level %d\n", terrainPatches,
+               terrainPatches, terrainEdgePixels, terrain.maxLevel);
+    }
+    double terrainPrintTime = demoGetTime(&demo);
 
     static float color = 0;
     // X. Create a render loop.
-    while (!glfwWindowShouldClose(window))
+    while (!demoShouldClose(&demo))
     {
         // X. Poll and handle events (inputs, window resize, etc.)
-        glfwPollEvents();
+        demoPollEvents(&demo);
+        gpuTimerBeginFrame(&gpuTimer);
+
+        int display_w, display_h;
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
+
+        // L.2. Terrain: the camera circles around the center, the terrain replaces the floor.
+        if (terrainMode) {
+            glViewport(0, 0, display_w, display_h);
+            glClearColor(0.0, 0.3, 0.3, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glEnable(GL_DEPTH_TEST);
+
+            float angle = (float)demoAnimationTime(&demo) * 0.15f;
+            glm::mat4 projection = glm::perspective(glm::radians(60.0f), (float)display_w / (float)display_h,
+                                                    0.1f, 200.0f);
+            glm::mat4 view = glm::lookAt(glm::vec3(cosf(angle) * 24.0f, 9.0f, sinf(angle) * 24.0f),
+                                         glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            {
+                GpuTimerScope timerScope(&gpuTimer, "terrain");
+                drawTessTerrain(&terrain, glm::value_ptr(projection), glm::value_ptr(view), display_h);
+            }
+            glDisable(GL_DEPTH_TEST);
+
+            // L.3. Print the triangles generated by the tessellator every second.
+            if (demoGetTime(&demo) - terrainPrintTime >= 1.0) {
+                double triangles = terrainTakeTriangleCount(&terrain);
+                if (triangles >= 0.0) {
+                    printf("Terrain: %.0f triangles/frame\n", triangles);
+                }
+                terrainPrintTime = demoGetTime(&demo);
+            }
+
+            gpuTimerEndFrame(&gpuTimer);
+            demoSwapBuffers(&demo);
+            continue;
+        }
+
+        // C.4. MSAA: render into the multisampled target instead of the window.
+        RenderTarget* msaaTarget = NULL;
+        if (msaaSamples > 1 && !benchmark) {
+            msaaTarget = acquireMsaaTarget(&targetPool, display_w, display_h, msaaSamples);
+        }
 
         // X. Clear the color image.
         glClearColor(0.0, 0.3, 0.3, 1.0f);
@@ -278,36 +730,165 @@ int main(int argc, char **argv) {
         glUseProgram(shader_program);
 
         // V.3. Use the VAO
-        glBindVertexArray(vao);
+        glBindVertexArray(tiles > 0 ? tilesVao : vao);
 
-        // XX. Update the transformation matrix.
+        // XX. Update the transformation matrices and colors: upload only the ones which changed.
         {
-            glm::mat4 model         = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
-            glm::mat4 view          = glm::mat4(1.0f);
-
-            model = glm::rotate(model, glm::radians(-55.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-            view  = glm::translate(view, glm::vec3(.0f, 0.0f, -3.0f));
-            // retrieve the matrix uniform locations
-            // pass them to the shaders (3 different ways)
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-            glUniformMatrix4fv(viewLoc, 1, GL_FALSE, &view[0][0]);
+            cameraSetViewport(&camera, display_w, display_h);
+            updateCamera(&camera);
+            updateTransform(&floorTransform);
+
+            if (constantCacheStale(&frameCache, camera.version)) {
+                FrameConstants frameConstants;
+                memcpy(frameConstants.projection, camera.projection, sizeof(frameConstants.projection));
+                memcpy(frameConstants.view, camera.view, sizeof(frameConstants.view));
+                constantCacheUpload(&frameCache, camera.version, &frameConstants);
+            }
+
+            // One object block for each triangle: same model matrix, different color.
+            ObjectConstants objects[2] = {
+                { {}, { 0.0f, 1.0f, 0.0f, 1.0f } },
+                { {}, { 0.0f, 0.0f, 1.0f, 1.0f } },
+            };
+            for (int idx = 0; idx < 2; idx++) {
+                if (constantCacheStale(&objectCaches[idx], floorTransform.version)) {
+                    memcpy(objects[idx].model, floorTransform.matrix, sizeof(objects[idx].model));
+                    constantCacheUpload(&objectCaches[idx], floorTransform.version, &objects[idx]);
+                }
+            }
         }
 
         // X. Draw the triangles.
-        glUniform3f(uniformColorLoc, 0.0, 1.0, 0.0);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
+        constantCacheBind(&frameCache, FRAME_CONSTANTS_BINDING);
+        if (lodBiasLoc >= 0) {
+            glUniform1f(lodBiasLoc, lodBias);
+        }
 
-        glUniform3f(uniformColorLoc, 0.0, 0.0, 1.0);
-        glDrawArrays(GL_TRIANGLES, 3, 3);
+        auto drawFloor = [&]() {
+            // M.3. Tiled floor: every tile in one multi-draw submission (or the loop of the baseline).
+            if (tiles > 0) {
+                constantCacheBind(&objectCaches[0], OBJECT_CONSTANTS_BINDING);
+                submitMultiDrawArrays(&tileBatch, GL_TRIANGLES);
+                return;
+            }
+
+            constantCacheBind(&objectCaches[0], OBJECT_CONSTANTS_BINDING);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+
+            constantCacheBind(&objectCaches[1], OBJECT_CONSTANTS_BINDING);
+            glDrawArrays(GL_TRIANGLES, 3, 3);
+        };
+
+        if (!benchmark) {
+            drawFloor();
+        }
+
+        // C.5. Resolve the samples into the window.
+        if (msaaTarget != NULL) {
+            resolveMsaaTarget(msaaTarget, demoDefaultFramebuffer(&demo), display_w, display_h);
+            releaseRenderTarget(&targetPool, msaaTarget);
+        }
+
+        // B.1. Benchmark: the floor with the sampler of each mode, only the bound sampler changes.
+        /* The same pixels are shaded again and again: the difference of the pass times is the
+         * sampling cost of the modes. Besides the GPU timer passes each batch is bracketed with
+         * glFinish, so the wall time is also valid on drivers which defer the rasterization. */
+        for (size_t idx = 0; idx < benchmarkSamplers.size(); idx++) {
+            glBindSampler(0, getCachedSampler(benchmarkSamplers[idx]));
+
+            glFinish();
+            double startTime = demoGetTime(&demo);
+            {
+                GpuTimerScope timerScope(&gpuTimer, benchmarkNames[idx].c_str());
+                for (int draw = 0; draw < overdraw; draw++) {
+                    drawFloor();
+                }
+            }
+            glFinish();
+            benchmarkMs[idx] += (demoGetTime(&demo) - startTime) * 1000.0;
+        }
+
+        // C.6. Checker benchmark: the same with each checker program, the MSAA batch includes its clear and resolve.
+        for (size_t idx = 0; idx < checkerPrograms.size(); idx++) {
+            if (tiles > 0) {
+                multiDrawUseProgram(&tileBatch, checkerPrograms[idx]);
+            } else {
+                glUseProgram(checkerPrograms[idx]);
+            }
+
+            glFinish();
+            double startTime = demoGetTime(&demo);
+            {
+                GpuTimerScope timerScope(&gpuTimer, benchmarkNames[idx].c_str());
+                RenderTarget* target = NULL;
+                if (checkerSamples[idx] > 1) {
+                    target = acquireMsaaTarget(&targetPool, display_w, display_h, checkerSamples[idx]);
+                    glClear(GL_COLOR_BUFFER_BIT);
+                }
+                for (int draw = 0; draw < overdraw; draw++) {
+                    drawFloor();
+                }
+                if (target != NULL) {
+                    resolveMsaaTarget(target, demoDefaultFramebuffer(&demo), display_w, display_h);
+                    releaseRenderTarget(&targetPool, target);
+                }
+            }
+            glFinish();
+            benchmarkMs[idx] += (demoGetTime(&demo) - startTime) * 1000.0;
+        }
+
+        // B.2. Report the average wall time of one floor draw per mode every second.
+        if (benchmark) {
+            benchmarkFrames++;
+            if (demoGetTime(&demo) - benchmarkStartTime >= 1.0) {
+                printf("Benchmark (ms/draw):");
+                for (size_t idx = 0; idx < benchmarkNames.size(); idx++) {
+                    printf(" %s %.3f%s", benchmarkNames[idx].c_str(), benchmarkMs[idx] / (benchmarkFrames * overdraw),
+                           idx + 1 < benchmarkNames.size() ? " |" : "\n");
+                    benchmarkMs[idx] = 0.0;
+                }
+                benchmarkFrames = 0;
+                benchmarkStartTime = demoGetTime(&demo);
+            }
+        }
+        // M.4. Report the GL calls of the tile submissions per frame every second.
+        if (tiles > 0) {
+            multiDrawFrames++;
+            if (demoGetTime(&demo) - multiDrawPrintTime >= 1.0) {
+                printf("Multi-draw: %d GL calls/frame for %d tiles\n",
+                       multiDrawTakeDriverCalls(&tileBatch) / multiDrawFrames, tiles * tiles);
+                multiDrawFrames = 0;
+                multiDrawPrintTime = demoGetTime(&demo);
+            }
+        }
+        gpuTimerEndFrame(&gpuTimer);
+        renderTargetPoolEndFrame(&targetPool);
 
         // X. Swap the fron-back buffers to display the rendered image in the window.
-        glfwSwapBuffers(window);
+        demoSwapBuffers(&demo);
+    }
+
+    // XX. Destroy the uniform buffer ring, the floor texture, the samplers and the benchmark programs.
+    for (int idx = 0; idx < CHECKER_MODE_COUNT && idx < (int)checkerPrograms.size(); idx++) {
+        glDeleteProgram(checkerPrograms[idx]);
+    }
+    if (terrainMode) {
+        destroyTessTerrain(&terrain);
+    }
+    glDeleteBuffers(1, &tileColorsUbo);
+    glDeleteBuffers(1, &tilesVbo);
+    glDeleteVertexArrays(1, &tilesVao);
+    destroyRenderTargetPool(&targetPool);
+    for (int idx = 0; idx < 2; idx++) {
+        destroyConstantCache(&objectCaches[idx]);
     }
+    destroyConstantCache(&frameCache);
+    destroyGpuTimer(&gpuTimer);
+    glDeleteTextures(1, &floorTexture);
+    destroySamplerCache();
 
-    // XX. Destroy the window.
-    glfwDestroyWindow(window);
-    // XX. Destroy the GLFW.
-    glfwTerminate();
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
 
     return 0;
 }
@@ -0,0 +1,601 @@
+/**
+ * Vertex pulling: a field of different meshes drawn from one shared mesh pool.
+ *
+ * The field has "--objects N" objects (default: 10000), each one is a cube, a wavy grid,
+ * a sphere or a torus (common/mesh.h and common/static_mesh.h shapes, quantized with
+ * common/mesh_quantize.h).
+ * The per object placement is in a storage buffer in every mode, only the vertex fetch
+ * changes with "--fetch":
+ *  vao          One VAO per mesh (the quantized vertex attributes): the objects are grouped
+ *               by mesh, one instanced indexed draw and one VAO switch per mesh.
+ *  pull         The meshes share the storage buffers of the pool (common/mesh_pool.h), the
+ *               vertex shader decodes the vertices: one instanced draw per mesh, no VAO or
+ *               buffer switch between the draws.
+ *  pull-single  One instanced draw for the whole field, every instance reads its own mesh.
+ *               The draw has the vertex count of the largest mesh: the extra vertices of
+ *               the smaller meshes are discarded (the cost of the single draw).
+ *  heap         The vertices and the indices are allocations of a buffer heap (common/buffer_heap.h):
+ *               one VAO per heap block instead of one per mesh, the draws select the mesh with
+ *               the base vertex and the index offset. The loading leaves holes in the heap
+ *               (transient allocations), its fragmentation is printed before and after the
+ *               defragmentation. "--heap-block-kb N" sets the block size (default: 64).
+ * The GPU objects are a resource group of common/context_recovery.h: with "--robust" they are
+ * rebuilt from the kept quantized meshes and placements after a context loss.
+ * The CPU time of the draws, the draw count and the vertex shader invocations are
+ * printed every second ("--gpu-timer": the GPU time of the field).
+ *
+ * Run:
+ * $ ./gles_mesh_pool --fetch pull --objects 20000
+ * $ ./gles_mesh_pool --surfaceless --frames 300 --fetch pull-single --gpu-timer
+ * $ ./gles_mesh_pool --fetch heap --heap-block-kb 16
+ * $ ./gles_mesh_pool --surfaceless --frames 100 --simulate-context-loss 50
+ *
+ * Dependencies:
+ *  * C++11
+ *  * GLFW 3.0+
+ *  * GLM
+ *  * Open GL ES 3.1+ (vertex shader storage blocks)
+ *  * Open GL ES 3.2 or GL_EXT_draw_elements_base_vertex (the heap mode)
+ *  * EGL
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES3/gl31.h>
+#include <GLES2/gl2ext.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "common/buffer_heap.h"
+#include "common/context_recovery.h"
+#include "common/demo_context.h"
+#include "common/gpu_memory.h"
+#include "common/gpu_timer.h"
+#include "common/mesh.h"
+#include "common/mesh_pool.h"
+#include "common/mesh_quantize.h"
+#include "common/program_cache.h"
+#include "common/static_mesh.h"
+
+const char* vertex_src = R"(#version 310 es
+precision highp float;
+
+#ifndef VERTEX_PULLING
+layout(location = 0) in vec3 aPos; // [0, 1] in the bounds of the mesh
+layout(location = 1) in vec2 aNormal;
+#endif
+
+struct ObjectPlacement {
+    vec4 positionScale;
+    uvec4 info; // mesh, seed
+};
+
+layout(std430, binding = 3) readonly buffer Objects { ObjectPlacement objects[]; };
+
+// The table of the pool (the bounds of every mesh) is used by the attribute path as well.
+#ifndef VERTEX_PULLING
+struct PoolMesh {
+    uvec4 range;
+    vec4 boundsMin;
+    vec4 boundsSize;
+};
+layout(std430, binding = 2) readonly buffer PoolMeshes { PoolMesh poolMeshes[]; };
+#endif
+
+uniform mat4 viewProjection;
+uniform float time;
+uniform int firstObject;
+
+out vec3 normal;
+flat out uint meshId;
+
+mat3 rotation(float angle, vec3 axis) {
+    float c = cos(angle);
+    float s = sin(angle);
+    vec3 t = (1.0 - c) * axis;
+    return mat3(t.x * axis + vec3(c, s * axis.z, -s * axis.y),
+                t.y * axis + vec3(-s * axis.z, c, s * axis.x),
+                t.z * axis + vec3(s * axis.y, -s * axis.x, c));
+}
+
+void main() {
+    ObjectPlacement object = objects[firstObject + gl_InstanceID];
+    meshId = object.info.x;
+
+#ifdef VERTEX_PULLING
+    // The single draw covers the largest mesh: the vertices past the end of this one are outside of the clip volume.
+    if (uint(gl_VertexID) >= pooledIndexCount(meshId)) {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        normal = vec3(0.0);
+        return;
+    }
+    PooledVertex vertex = fetchPooledVertex(meshId, uint(gl_VertexID));
+    vec3 position = vertex.position;
+    vec3 objectNormal = vertex.normal;
+#else
+    vec3 position = poolMeshes[meshId].boundsMin.xyz + aPos * poolMeshes[meshId].boundsSize.xyz;
+    vec3 objectNormal = octahedralDecode(aNormal);
+#endif
+
+    float seed = float(object.info.y & 0xffffu) / 65535.0;
+    mat3 rotate = rotation(time * (0.5 + seed), normalize(vec3(seed, 1.0, 1.0 - seed)));
+    normal = rotate * objectNormal;
+    gl_Position = viewProjection * vec4(rotate * position * object.positionScale.w + object.positionScale.xyz, 1.0);
+}
+)";
+
+const char* fragment_src = R"(#version 310 es
+precision highp float;
+
+in vec3 normal;
+flat in uint meshId;
+
+out vec4 outColor;
+
+void main() {
+    const vec3 colors[4] = vec3[](vec3(0.9, 0.4, 0.3), vec3(0.3, 0.8, 0.4), vec3(0.3, 0.5, 0.9), vec3(0.9, 0.8, 0.3));
+    float light = max(dot(normalize(normal), normalize(vec3(0.3, 0.8, 0.5))), 0.0) * 0.8 + 0.2;
+    outColor = vec4(colors[meshId % 4u] * light, 1.0);
+}
+)";
+
+enum FetchMode {
+    FETCH_VAO,
+    FETCH_PULL,
+    FETCH_PULL_SINGLE,
+    FETCH_HEAP,
+    FETCH_MODE_COUNT,
+};
+
+static const char* fetchModeNames[FETCH_MODE_COUNT] = { "vao", "pull", "pull-single", "heap" };
+
+// Heap mode: one allocation per mesh, the indices after the vertices (the VAO of a block has both).
+struct HeapMesh {
+    BufferHandle allocation;
+    size_t indexOffset; // in the allocation
+    int indexCount;
+    unsigned int indexType;
+};
+
+static PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXEXTPROC drawElementsInstancedBaseVertex;
+
+static bool hasGLExtension(const char* name) {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int idx = 0; idx < count; idx++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, idx), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The base vertex draw of Open GL ES 3.2, GL_EXT_draw_elements_base_vertex or GL_OES_draw_elements_base_vertex.
+static bool loadBaseVertexDraw() {
+    int major = 0;
+    int minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    const char* name = (major > 3 || (major == 3 && minor >= 2)) ? "glDrawElementsInstancedBaseVertex"
+                     : hasGLExtension("GL_EXT_draw_elements_base_vertex") ? "glDrawElementsInstancedBaseVertexEXT"
+                     : hasGLExtension("GL_OES_draw_elements_base_vertex") ? "glDrawElementsInstancedBaseVertexOES"
+                     : NULL;
+    if (name != NULL) {
+        drawElementsInstancedBaseVertex = (PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXEXTPROC)eglGetProcAddress(name);
+    }
+    return drawElementsInstancedBaseVertex != NULL;
+}
+
+// Heap mode: one VAO per block of the heap, the quantized attributes at the start of the block buffer.
+static std::vector<unsigned int> createHeapVaos(const BufferHeap& heap) {
+    std::vector<unsigned int> vaos(heap.blocks.size());
+    glGenVertexArrays((int)vaos.size(), vaos.data());
+    for (size_t idx = 0; idx < vaos.size(); idx++) {
+        glBindVertexArray(vaos[idx]);
+        glBindBuffer(GL_ARRAY_BUFFER, heap.blocks[idx].buffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, heap.blocks[idx].buffer);
+        int stride = sizeof(QuantizedVertex);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(QuantizedVertex, position));
+        glVertexAttribPointer(1, 2, GL_BYTE, GL_TRUE, stride, (void*)offsetof(QuantizedVertex, normal));
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return vaos;
+}
+
+struct ObjectPlacement {
+    float positionScale[4];
+    uint32_t info[4];
+};
+
+// Wavy quad grid: the grid of common/mesh.h with a sine bump (the normals need a curved surface).
+static MeshData createWavyGridMesh(int cells) {
+    MeshData mesh = createGridMesh(cells, cells);
+    for (size_t idx = 0; idx < mesh.positions.size(); idx += 3) {
+        float x = mesh.positions[idx];
+        float y = mesh.positions[idx + 1];
+        mesh.positions[idx + 2] = 0.08f * sinf(x * 12.0f) * cosf(y * 12.0f);
+    }
+    return mesh;
+}
+
+// Runtime copy of a compile time mesh (common/static_mesh.h), optimized as the cube.
+template <typename Mesh>
+static MeshData createOptimizedMesh(const Mesh& staticMesh) {
+    MeshData mesh = staticMeshData(staticMesh);
+    optimizeMesh(&mesh);
+    return mesh;
+}
+
+// The GPU objects of the field and the CPU data to create them again after a context loss.
+struct FieldObjects {
+    FetchMode fetchMode;
+    size_t heapBlockSize;
+    std::vector<QuantizedMesh> quantized;
+    std::vector<ObjectPlacement> sorted; // by mesh
+    std::string vertexSrc;
+    int argc;
+    char** argv;
+
+    MeshPool pool;
+    std::vector<MeshBuffers> meshBuffers;
+    BufferHeap heap;
+    std::vector<HeapMesh> heapMeshes;
+    std::vector<unsigned int> heapVaos;
+    unsigned int program;
+    int viewProjectionLoc;
+    int timeLoc;
+    int firstObjectLoc;
+    unsigned int objectBuffer;
+    GpuTimer gpuTimer;
+};
+
+static void createFieldObjects(FieldObjects* field) {
+    // C.1. The meshes: uploaded into the pool and (for the "vao" mode) into their own VAOs.
+    initMeshPool(&field->pool);
+    initBufferHeap(&field->heap, field->heapBlockSize, GPU_MEMORY_VERTEX, "meshes");
+    std::vector<BufferHandle> transients;
+    for (const QuantizedMesh& quantized : field->quantized) {
+        addPoolMesh(&field->pool, quantized);
+        if (field->fetchMode == FETCH_VAO) {
+            field->meshBuffers.push_back(uploadQuantizedMesh(quantized, 0, 1, -1));
+        }
+
+        // C.1.1. Heap mode: the mesh at a multiple of the stride (the base vertex), 16 bit indices if possible.
+        /* Each mesh is preceded by a transient allocation of the loading (the size of its float vertices),
+         * freed once every mesh is loaded: the holes of a heap which loads and unloads assets. */
+        if (field->fetchMode == FETCH_HEAP) {
+            size_t vertexBytes = quantized.vertices.size() * sizeof(QuantizedVertex);
+            transients.push_back(bufferHeapAlloc(&field->heap, quantized.vertices.size() * 8 * sizeof(float), 4));
+
+            /* The vertex bytes are a multiple of 4: the indices after them are aligned. */
+            HeapMesh mesh;
+            mesh.indexOffset = vertexBytes;
+            mesh.indexCount = (int)quantized.indices.size();
+            std::vector<uint16_t> shortIndices;
+            size_t indexBytes = quantized.indices.size() * sizeof(uint32_t);
+            const void* indexData = quantized.indices.data();
+            mesh.indexType = GL_UNSIGNED_INT;
+            if (quantized.vertices.size() <= 65536) {
+                shortIndices.assign(quantized.indices.begin(), quantized.indices.end());
+                indexBytes = shortIndices.size() * sizeof(uint16_t);
+                indexData = shortIndices.data();
+                mesh.indexType = GL_UNSIGNED_SHORT;
+            }
+            mesh.allocation = bufferHeapAlloc(&field->heap, vertexBytes + indexBytes, sizeof(QuantizedVertex));
+            bufferHeapUpload(&field->heap, mesh.allocation, 0, quantized.vertices.data(), vertexBytes);
+            bufferHeapUpload(&field->heap, mesh.allocation, mesh.indexOffset, indexData, indexBytes);
+            field->heapMeshes.push_back(mesh);
+        }
+    }
+
+    // C.1.2. Heap mode: free the transient allocations and pack the meshes, a VAO per block of the packed heap.
+    if (field->fetchMode == FETCH_HEAP) {
+        for (BufferHandle handle : transients) {
+            bufferHeapFree(&field->heap, handle);
+        }
+        printBufferHeapStats(&field->heap);
+        size_t copied = defragmentBufferHeap(&field->heap);
+        printf("Defragmentation: %.1f KB copied with glCopyBufferSubData\n", copied / 1024.0);
+        printBufferHeapStats(&field->heap);
+        field->heapVaos = createHeapVaos(field->heap);
+    }
+    uploadMeshPool(&field->pool);
+
+    // C.2. The program (from the binary program cache after the first run) and the placements.
+    field->program = createCachedProgram(field->vertexSrc.c_str(), fragment_src);
+    field->viewProjectionLoc = glGetUniformLocation(field->program, "viewProjection");
+    field->timeLoc = glGetUniformLocation(field->program, "time");
+    field->firstObjectLoc = glGetUniformLocation(field->program, "firstObject");
+
+    glGenBuffers(1, &field->objectBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, field->objectBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, field->sorted.size() * sizeof(ObjectPlacement), field->sorted.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    initGpuTimer(&field->gpuTimer, field->argc, field->argv);
+}
+
+static void destroyFieldObjects(FieldObjects* field) {
+    glDeleteBuffers(1, &field->objectBuffer);
+    for (MeshBuffers& buffers : field->meshBuffers) {
+        destroyMeshBuffers(&buffers);
+    }
+    field->meshBuffers.clear();
+    glDeleteVertexArrays((int)field->heapVaos.size(), field->heapVaos.data());
+    field->heapVaos.clear();
+    field->heapMeshes.clear();
+    destroyBufferHeap(&field->heap);
+    destroyMeshPool(&field->pool);
+    glDeleteProgram(field->program);
+    destroyGpuTimer(&field->gpuTimer);
+}
+
+static void releaseFieldObjects(void* user) {
+    destroyFieldObjects((FieldObjects*)user);
+}
+
+static void rebuildFieldObjects(void* user) {
+    createFieldObjects((FieldObjects*)user);
+}
+
+int main(int argc, char **argv) {
+    // 0. Options: the fetch mode and the object count.
+    FetchMode fetchMode = FETCH_PULL;
+    int objectCount = 10000;
+    int heapBlockKb = 64;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--fetch") == 0 && idx + 1 < argc) {
+            const char* name = argv[++idx];
+            int mode = 0;
+            while (mode < FETCH_MODE_COUNT && strcmp(fetchModeNames[mode], name) != 0) {
+                mode++;
+            }
+            if (mode == FETCH_MODE_COUNT) {
+                printf("Unknown fetch mode '%s' (vao, pull, pull-single, heap)\n", name);
+                return -1;
+            }
+            fetchMode = (FetchMode)mode;
+        } else if (strcmp(argv[idx], "--objects") == 0 && idx + 1 < argc) {
+            objectCount = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--heap-block-kb") == 0 && idx + 1 < argc) {
+            heapBlockKb = atoi(argv[++idx]);
+        }
+    }
+    if (objectCount < 1 || heapBlockKb < 1) {
+        printf("Invalid object count or heap block size\n");
+        return -1;
+    }
+
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
+
+    // 1. The placements and the pool need 4 storage blocks in the vertex shader.
+    if (!meshPoolSupported(1)) {
+        printf("The vertex shader has less than 4 shader storage blocks (GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS)\n");
+        destroyDemoContext(&demo);
+        return -3;
+    }
+    if (fetchMode == FETCH_HEAP && !loadBaseVertexDraw()) {
+        printf("The heap mode needs Open GL ES 3.2 or GL_EXT_draw_elements_base_vertex\n");
+        destroyDemoContext(&demo);
+        return -3;
+    }
+
+    // 2. The meshes: quantized once, the quantized copies are kept for the rebuild after a context loss.
+    static constexpr auto sphereMesh = staticSphere<StaticVertex, 32, 16>();
+    static constexpr auto torusMesh = staticTorus<StaticVertex, 48, 24>();
+    MeshData meshes[4] = {
+        createCubeMesh(),
+        createWavyGridMesh(24),
+        createOptimizedMesh(sphereMesh),
+        createOptimizedMesh(torusMesh),
+    };
+    const int meshCount = 4;
+
+    FieldObjects field;
+    field.fetchMode = fetchMode;
+    field.heapBlockSize = (size_t)heapBlockKb * 1024;
+    field.argc = argc;
+    field.argv = argv;
+    for (int idx = 0; idx < meshCount; idx++) {
+        field.quantized.push_back(quantizeMesh(meshes[idx], computeMeshNormals(meshes[idx])));
+    }
+
+    // 3. The vertex shader of the mode.
+    if (fetchMode == FETCH_VAO || fetchMode == FETCH_HEAP) {
+        field.vertexSrc = vertex_src;
+        size_t lineEnd = field.vertexSrc.find('\n', field.vertexSrc.find("precision"));
+        field.vertexSrc.insert(lineEnd + 1, octahedralDecodeSrc);
+    } else {
+        field.vertexSrc = meshPoolShaderSource(vertex_src);
+        field.vertexSrc.insert(field.vertexSrc.find('\n') + 1, "#define VERTEX_PULLING\n");
+    }
+
+    // 4. The objects on a square grid, a random mesh each; sorted by mesh for the per mesh draws.
+    std::vector<ObjectPlacement> objects(objectCount);
+    int side = (int)ceilf(sqrtf((float)objectCount));
+    srand(1);
+    for (int idx = 0; idx < objectCount; idx++) {
+        ObjectPlacement& object = objects[idx];
+        object.positionScale[0] = ((idx % side) - side * 0.5f) * 1.2f;
+        object.positionScale[1] = 0.0f;
+        object.positionScale[2] = -((idx / side) - side * 0.5f) * 1.2f;
+        object.positionScale[3] = 0.6f + 0.4f * (float)rand() / RAND_MAX;
+        object.info[0] = (uint32_t)(rand() % meshCount);
+        object.info[1] = (uint32_t)(rand() & 0xffff);
+        object.info[2] = 0;
+        object.info[3] = 0;
+    }
+    std::vector<int> meshFirstObject(meshCount + 1, 0);
+    for (int mesh = 0; mesh < meshCount; mesh++) {
+        meshFirstObject[mesh] = (int)field.sorted.size();
+        for (const ObjectPlacement& object : objects) {
+            if ((int)object.info[0] == mesh) {
+                field.sorted.push_back(object);
+            }
+        }
+    }
+    meshFirstObject[meshCount] = objectCount;
+
+    // 4.1. The GPU objects, registered for the rebuild after a context loss ("--robust").
+    createFieldObjects(&field);
+    int fieldResources = registerGpuResources("mesh field", releaseFieldObjects, rebuildFieldObjects, &field);
+    const MeshPool& pool = field.pool;
+    printf("Mesh pool: %d meshes, %d vertices, index counts:", meshCount, pool.vertexCount);
+    for (int idx = 0; idx < meshCount; idx++) {
+        printf(" %u", pool.meshes[idx].indexCount);
+    }
+    printf("\n");
+
+    // 5. Vertex shader invocations per frame: the indexed draws reuse the cached vertices, the pulled ones don't.
+    double invocations = 0.0;
+    for (int mesh = 0; mesh < meshCount; mesh++) {
+        int count = meshFirstObject[mesh + 1] - meshFirstObject[mesh];
+        double perObject = (fetchMode == FETCH_PULL_SINGLE) ? pool.maxIndexCount
+                         : (fetchMode == FETCH_PULL) ? pool.meshes[mesh].indexCount
+                         : pool.meshes[mesh].indexCount * meshACMR(meshes[mesh], 32) / 3.0;
+        invocations += perObject * count;
+    }
+
+    demoSwapInterval(&demo, 0);
+
+    double drawSeconds = 0.0;
+    int drawCalls = 0;
+    int statFrames = 0;
+    double printTime = demoGetTime(&demo);
+
+    // X. Create a render loop.
+    while (!demoShouldClose(&demo))
+    {
+        // X. Poll and handle events (inputs, window resize, etc.)
+        demoPollEvents(&demo);
+        gpuTimerBeginFrame(&field.gpuTimer);
+
+        int display_w, display_h;
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
+        glViewport(0, 0, display_w, display_h);
+
+        // X. Clear the color and depth images.
+        glClearColor(0.0, 0.3, 0.3, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+
+        // XX. The camera looks down onto the field.
+        float extent = side * 0.6f;
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)display_w / (float)display_h,
+                                                0.1f, extent * 6.0f);
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, extent * 1.2f, extent * 1.6f), glm::vec3(0.0f),
+                                     glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 viewProjection = projection * view;
+
+        double drawStart = demoGetTime(&demo);
+        int boundVao = -1;
+        {
+            GpuTimerScope timerScope(&field.gpuTimer, "objects");
+            glUseProgram(field.program);
+            glUniformMatrix4fv(field.viewProjectionLoc, 1, GL_FALSE, glm::value_ptr(viewProjection));
+            glUniform1f(field.timeLoc, (float)demoAnimationTime(&demo));
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, field.objectBuffer);
+            bindMeshPool(&pool);
+
+            // D.1. Draw the field in the selected mode.
+            if (fetchMode == FETCH_PULL_SINGLE) {
+                glUniform1i(field.firstObjectLoc, 0);
+                glDrawArraysInstanced(GL_TRIANGLES, 0, pool.maxIndexCount, objectCount);
+                drawCalls++;
+            }
+            for (int mesh = 0; fetchMode != FETCH_PULL_SINGLE && mesh < meshCount; mesh++) {
+                int count = meshFirstObject[mesh + 1] - meshFirstObject[mesh];
+                if (count == 0) {
+                    continue;
+                }
+                glUniform1i(field.firstObjectLoc, meshFirstObject[mesh]);
+                if (fetchMode == FETCH_VAO) {
+                    const MeshBuffers& buffers = field.meshBuffers[mesh];
+                    glBindVertexArray(buffers.vao);
+                    glDrawElementsInstanced(GL_TRIANGLES, buffers.indexCount, buffers.indexType, NULL, count);
+                } else if (fetchMode == FETCH_HEAP) {
+                    // D.1.1. Heap mode: the VAO only changes with the block, the offsets select the mesh.
+                    const HeapMesh& heapMesh = field.heapMeshes[mesh];
+                    int block = field.heap.allocations[heapMesh.allocation].block;
+                    size_t offset = bufferHeapOffset(&field.heap, heapMesh.allocation);
+                    if (block != boundVao) {
+                        glBindVertexArray(field.heapVaos[block]);
+                        boundVao = block;
+                    }
+                    drawElementsInstancedBaseVertex(GL_TRIANGLES, heapMesh.indexCount, heapMesh.indexType,
+                                                    (void*)(offset + heapMesh.indexOffset), count,
+                                                    (int)(offset / sizeof(QuantizedVertex)));
+                } else {
+                    glDrawArraysInstanced(GL_TRIANGLES, 0, pool.meshes[mesh].indexCount, count);
+                }
+                drawCalls++;
+            }
+            glBindVertexArray(0);
+        }
+        drawSeconds += demoGetTime(&demo) - drawStart;
+        glDisable(GL_DEPTH_TEST);
+        statFrames++;
+
+        // D.2. Print the draw statistics every second.
+        if (demoGetTime(&demo) - printTime >= 1.0) {
+            printf("Fetch %s: %d objects, %.0f draws/frame, CPU %.3f ms/frame, %.2fM vertex invocations/frame\n",
+                   fetchModeNames[fetchMode], objectCount, (double)drawCalls / statFrames,
+                   drawSeconds * 1000.0 / statFrames, invocations / 1000000.0);
+            drawSeconds = 0.0;
+            drawCalls = 0;
+            statFrames = 0;
+            printTime = demoGetTime(&demo);
+        }
+        gpuTimerEndFrame(&field.gpuTimer);
+
+        // X. Swap the front-back buffers to display the rendered image in the window.
+        demoSwapBuffers(&demo);
+    }
+
+    // XX. Destroy the objects, the meshes and the program.
+    unregisterGpuResources(fieldResources);
+    destroyFieldObjects(&field);
+
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
+
+    return 0;
+}
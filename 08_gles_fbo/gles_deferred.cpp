@@ -0,0 +1,536 @@
+/**
+ * Deferred shading example: a field of cubes lit by point lights through a G-buffer.
+ *
+ * Compile with shaderc:
+ * $ g++ gles_deferred.cpp -o gles_deferred -lglfw -lGLESv2
+ *
+ * Run:
+ * $ ./gles_deferred
+ *
+ * The geometry pass writes the albedo (RGBA8), the octahedral encoded normal
+ * (RG16UI) and the depth of the visible surfaces, a full screen lighting pass
+ * shades every pixel once with every light (see common/gbuffer.h). By default
+ * the mode with the least memory traffic is used: the pixel local storage
+ * (EXT_shader_pixel_local_storage), then the framebuffer fetch
+ * (EXT_shader_framebuffer_fetch), both keep the G-buffer in the tile memory.
+ * Select the mode ("forward", "mrt", "fetch" or "pls"):
+ * $ ./gles_deferred --gbuffer mrt --gpu-timer
+ *
+ * Forward shading as the reference (every fragment of the overdraw is lit):
+ * $ ./gles_deferred --gbuffer forward --gpu-timer
+ *
+ * Render 60 frames with every supported mode and print the estimated memory
+ * traffic and the frame time of each:
+ * $ ./gles_deferred --headless --compare
+ *
+ * Light count ("--lights N", at most 64) and cube count ("--cubes N"):
+ * $ ./gles_deferred --lights 64 --cubes 2500
+ *
+ * Dependencies:
+ *  * C++11
+ *  * GLFW 3.0+
+ *  * GLM
+ *  * Open GL ES 3.0+
+ *  * EGL
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <GLES3/gl3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "common/program_cache.h"
+#include "common/demo_context.h"
+#include "common/gbuffer.h"
+#include "common/gpu_timer.h"
+#include "common/mesh.h"
+#include "common/uniform_ring.h"
+
+// Size of the light uniform arrays.
+#define MAX_LIGHTS 64
+
+// Every object is an instance of the unit cube: center and half extent per instance.
+const char* scene_vertex_src = R"(#version 300 es
+precision highp float;
+
+layout(location = 0) in vec3 aPos;
+layout(location = 4) in vec3 aCenter;
+layout(location = 5) in vec3 aExtent;
+
+out vec3 vViewPos;
+out vec3 vColor;
+
+layout(std140) uniform FrameConstants {
+    mat4 projection;
+    mat4 view;
+};
+
+void main() {
+    vec4 viewPos = view * vec4(aPos * 2.0 * aExtent + aCenter, 1.0);
+    gl_Position = projection * viewPos;
+
+    vViewPos = viewPos.xyz;
+    vColor = aExtent.x > 4.0 ? vec3(0.8) : 0.5 + 0.4 * fract(sin(aCenter.xzx * vec3(12.9898, 78.233, 37.719)) * 43758.5453);
+}
+)";
+
+// The lights in view space, used by the forward and by the lighting pass.
+const char* lights_src = R"(
+#define MAX_LIGHTS 64
+
+uniform vec4 lightPositions[MAX_LIGHTS]; // view space position, radius
+uniform vec4 lightColors[MAX_LIGHTS];
+uniform int lightCount;
+
+vec3 shadeLights(vec3 viewPos, vec3 normal, vec3 albedo) {
+    vec3 result = albedo * 0.03;
+    for (int idx = 0; idx < lightCount; idx++) {
+        vec3 toLight = lightPositions[idx].xyz - viewPos;
+        float distance2 = dot(toLight, toLight);
+        float radius2 = lightPositions[idx].w * lightPositions[idx].w;
+        if (distance2 < radius2) {
+            // Smooth falloff to zero at the radius.
+            float falloff = 1.0 - distance2 / radius2;
+            float lambert = max(dot(normal, toLight * inversesqrt(distance2)), 0.0);
+            result += albedo * lightColors[idx].rgb * lambert * falloff * falloff;
+        }
+    }
+    return result;
+}
+)";
+
+// Geometry pass: shades directly in the forward mode, otherwise fills the G-buffer.
+const char* scene_fragment_src = R"(#version 300 es
+precision highp float;
+
+in vec3 vViewPos;
+in vec3 vColor;
+
+#ifdef GBUFFER_FORWARD
+out vec4 outColor;
+#endif
+)";
+
+const char* scene_fragment_main_src = R"(
+void main() {
+    // Flat shading: the face normal from the derivatives of the position (towards the viewer).
+    vec3 normal = normalize(cross(dFdx(vViewPos), dFdy(vViewPos)));
+
+#ifdef GBUFFER_FORWARD
+    outColor = vec4(shadeLights(vViewPos, normal, vColor), 1.0);
+#else
+    gbufferStore(vColor, normal, -vViewPos.z);
+#endif
+}
+)";
+
+// Lighting pass: a full-screen triangle without vertex attributes.
+const char* lighting_vertex_src = R"(#version 300 es
+precision highp float;
+
+void main() {
+    vec2 position = vec2(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1));
+    gl_Position = vec4(position, 0.0, 1.0);
+}
+)";
+
+const char* lighting_fragment_src = R"(#version 300 es
+precision highp float;
+
+layout(location = 0) out vec4 outColor;
+
+uniform vec4 backgroundColor;
+)";
+
+const char* lighting_fragment_main_src = R"(
+void main() {
+    vec3 albedo;
+    vec3 normal;
+    float viewDepth;
+    if (!gbufferLoad(albedo, normal, viewDepth)) {
+        outColor = backgroundColor;
+        return;
+    }
+    outColor = vec4(shadeLights(gbufferViewPosition(viewDepth), normal, albedo), 1.0);
+}
+)";
+
+// Scene instances: xyz center, xyz half extent.
+#define INSTANCE_FLOATS 6
+
+// Small deterministic random numbers in [0, 1) for the scene.
+static float randomFloat(unsigned int* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return (*state >> 8) / 16777216.0f;
+}
+
+// Insert the mode lines of common/gbuffer.h after the "#version" line.
+static std::string withGBufferHeader(GBufferMode mode, const std::string& src) {
+    std::string result = src;
+    result.insert(result.find('\n') + 1, gbufferShaderHeader(mode));
+    return result;
+}
+
+// The geometry and the lighting program of a mode (forward: only the geometry program).
+struct ModePrograms {
+    unsigned int geometry;
+    unsigned int lighting;
+};
+
+static bool createModePrograms(ModePrograms* programs, GBufferMode mode) {
+    std::string geometrySrc = std::string(scene_fragment_src) + gbufferGeometrySrc + lights_src + scene_fragment_main_src;
+    programs->geometry = createCachedProgram(scene_vertex_src, withGBufferHeader(mode, geometrySrc).c_str());
+    programs->lighting = 0;
+    if (programs->geometry == 0) {
+        return false;
+    }
+    bindConstantBlocks(programs->geometry);
+
+    if (mode != GBUFFER_FORWARD) {
+        std::string lightingSrc = std::string(lighting_fragment_src) + gbufferLightingSrc + lights_src + lighting_fragment_main_src;
+        programs->lighting = createCachedProgram(lighting_vertex_src, withGBufferHeader(mode, lightingSrc).c_str());
+        if (programs->lighting == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Set the view space lights of the frame (the program must be in use).
+static void setLightUniforms(unsigned int program, const std::vector<float>& positions, const std::vector<float>& colors,
+                             int lightCount) {
+    glUniform4fv(glGetUniformLocation(program, "lightPositions"), lightCount, positions.data());
+    glUniform4fv(glGetUniformLocation(program, "lightColors"), lightCount, colors.data());
+    glUniform1i(glGetUniformLocation(program, "lightCount"), lightCount);
+}
+
+int main(int argc, char **argv) {
+    const char* modeName = NULL;
+    int lightCount = 48;
+    int cubeCount = 400;
+    bool compare = false;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--gbuffer") == 0 && idx + 1 < argc) {
+            modeName = argv[++idx];
+        } else if (strcmp(argv[idx], "--lights") == 0 && idx + 1 < argc) {
+            lightCount = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--cubes") == 0 && idx + 1 < argc) {
+            cubeCount = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--compare") == 0) {
+            compare = true;
+        }
+    }
+
+    if (lightCount < 1 || lightCount > MAX_LIGHTS || cubeCount < 1) {
+        printf("Invalid --lights (1 - %d) or --cubes value\n", MAX_LIGHTS);
+        return -1;
+    }
+    if (modeName != NULL && findGBufferMode(modeName) == GBUFFER_MODE_COUNT) {
+        printf("Unknown G-buffer mode '%s' (forward, mrt, fetch or pls)\n", modeName);
+        return -1;
+    }
+
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    /* See the "01_gles_glfw" example for the GLFW steps. This also handles the
+     * "--headless" and "--frames N" command line options. */
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
+
+    // G.1. The mode (or every supported mode for the comparison).
+    std::vector<GBufferMode> modes;
+    if (compare) {
+        for (int idx = 0; idx < GBUFFER_MODE_COUNT; idx++) {
+            if (gbufferModeSupported((GBufferMode)idx)) {
+                modes.push_back((GBufferMode)idx);
+            }
+        }
+
+        /* The comparison stops after the last mode. */
+        demo.frameLimit = 0;
+    } else {
+        GBufferMode mode = modeName != NULL ? findGBufferMode(modeName) : gbufferBestMode();
+        if (!gbufferModeSupported(mode)) {
+            printf("The '%s' G-buffer mode is not supported by the driver\n", gbufferModeName(mode));
+            destroyDemoContext(&demo);
+            return -1;
+        }
+        modes.push_back(mode);
+    }
+
+    // 5-9. Build the geometry and the lighting programs of the modes.
+    /* See common/program_cache.h: the binaries are cached between the runs. */
+    ModePrograms programs[GBUFFER_MODE_COUNT];
+    memset(programs, 0, sizeof(programs));
+    for (size_t idx = 0; idx < modes.size(); idx++) {
+        if (!createModePrograms(&programs[modes[idx]], modes[idx])) {
+            return -3;
+        }
+    }
+
+    // V.1. The unit cube and the instances: the floor and a grid of cubes of different heights on it.
+    MeshBuffers cube = uploadMesh(createCubeMesh(), false, 0, -1);
+    std::vector<float> instances;
+    float floorSize;
+    {
+        int side = (int)ceilf(sqrtf((float)cubeCount));
+        float spacing = 3.0f;
+        floorSize = side * spacing * 0.5f + 10.0f;
+
+        float floorInstance[INSTANCE_FLOATS] = { 0.0f, -0.5f, 0.0f, floorSize, 0.5f, floorSize };
+        instances.insert(instances.end(), floorInstance, floorInstance + INSTANCE_FLOATS);
+
+        for (int idx = 0; idx < cubeCount; idx++) {
+            float x = (idx % side - (side - 1) * 0.5f) * spacing;
+            float z = (idx / side - (side - 1) * 0.5f) * spacing;
+            float halfHeight = 0.5f + (float)((idx * 7919) % 13) * 0.15f;
+
+            float cubeInstance[INSTANCE_FLOATS] = { x, halfHeight, z, 0.6f, halfHeight, 0.6f };
+            instances.insert(instances.end(), cubeInstance, cubeInstance + INSTANCE_FLOATS);
+        }
+    }
+    int instanceCount = (int)instances.size() / INSTANCE_FLOATS;
+
+    unsigned int instanceBuffer;
+    {
+        glGenBuffers(1, &instanceBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(float), instances.data(), GL_STATIC_DRAW);
+
+        glBindVertexArray(cube.vao);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, INSTANCE_FLOATS * sizeof(float), NULL);
+        glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, INSTANCE_FLOATS * sizeof(float), (const void*)(3 * sizeof(float)));
+        glVertexAttribDivisor(4, 1);
+        glVertexAttribDivisor(5, 1);
+        glEnableVertexAttribArray(4);
+        glEnableVertexAttribArray(5);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // L.1. The lights: random positions above the floor, each one circles around its position.
+    std::vector<float> lightPositions(lightCount * 4); // world space position, radius
+    std::vector<float> lightColors(lightCount * 4);
+    std::vector<float> lightOrbits(lightCount * 3);    // radius, speed, phase
+    {
+        unsigned int seed = 4321;
+        float spread = floorSize * 0.6f;
+        for (int idx = 0; idx < lightCount; idx++) {
+            lightPositions[idx * 4 + 0] = (randomFloat(&seed) * 2.0f - 1.0f) * spread;
+            lightPositions[idx * 4 + 1] = 0.5f + randomFloat(&seed) * 3.0f;
+            lightPositions[idx * 4 + 2] = (randomFloat(&seed) * 2.0f - 1.0f) * spread;
+            lightPositions[idx * 4 + 3] = 6.0f + randomFloat(&seed) * 4.0f;
+
+            // Saturated colors: one channel is dropped.
+            int drop = idx % 3;
+            for (int channel = 0; channel < 3; channel++) {
+                lightColors[idx * 4 + channel] = channel == drop ? 0.1f : 0.4f + randomFloat(&seed) * 0.6f;
+            }
+            lightColors[idx * 4 + 3] = 1.0f;
+
+            lightOrbits[idx * 3 + 0] = 1.0f + randomFloat(&seed) * 3.0f;
+            lightOrbits[idx * 3 + 1] = 0.2f + randomFloat(&seed);
+            lightOrbits[idx * 3 + 2] = randomFloat(&seed) * 6.2831853f;
+        }
+    }
+    std::vector<float> viewLights(lightCount * 4);
+
+    // G.2. The G-buffer of the first mode for the size of the framebuffer.
+    int display_w, display_h;
+    demoGetFramebufferSize(&demo, &display_w, &display_h);
+
+    const float nearPlane = 0.5f;
+    const float farPlane = 150.0f;
+    const float backgroundColor[4] = { 0.02f, 0.02f, 0.04f, 1.0f };
+
+    size_t modeIdx = 0;
+    GBuffer gbuffer;
+    if (modes.empty() || !initGBuffer(&gbuffer, modes[0], display_w, display_h)) {
+        destroyDemoContext(&demo);
+        return -1;
+    }
+    memcpy(gbuffer.clearColor, backgroundColor, sizeof(backgroundColor));
+    if (!compare) {
+        printf("G-buffer: %s, %d bytes/pixel, estimated traffic %.2f MiB/frame (forward: %.2f MiB/frame)\n",
+               gbufferModeName(gbuffer.mode), gbufferBytesPerPixel(gbuffer.mode),
+               gbufferFrameBytes(gbuffer.mode, display_w, display_h) / (1024.0 * 1024.0),
+               gbufferFrameBytes(GBUFFER_FORWARD, display_w, display_h) / (1024.0 * 1024.0));
+    }
+
+    // G.3. The measured time of every mode in the "--compare" run.
+    std::vector<double> modeMs(modes.size(), 0.0);
+    const int compareWarmupFrames = 10;
+    const int compareFrames = 60;
+    int compareFrame = 0;
+    double compareStartTime = 0.0;
+
+    // 11. Create the uniform buffer ring (the blocks of the programs were connected in 5-9).
+    /* See common/uniform_ring.h: the frame constants are written into one mapped buffer range per frame. */
+    UniformRing uniformRing;
+    initUniformRing(&uniformRing, 4 * 1024);
+
+    GpuTimer gpuTimer;
+    initGpuTimer(&gpuTimer, argc, argv);
+
+
+    // X. Create a render loop.
+    while (!demoShouldClose(&demo))
+    {
+        // X. Poll and handle events (inputs, window resize, etc.)
+        demoPollEvents(&demo);
+
+        // G.4. Comparison: the next mode after every compareFrames frames (the GPU is drained in between).
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
+        GBufferMode nextMode = gbuffer.mode;
+        if (compare) {
+            int entryFrame = compareFrame % compareFrames;
+            modeIdx = compareFrame / compareFrames;
+            if (entryFrame == 0 && modeIdx > 0) {
+                glFinish();
+                modeMs[modeIdx - 1] = (demoGetTime(&demo) - compareStartTime) * 1000.0 / (compareFrames - compareWarmupFrames);
+            }
+            if (modeIdx >= modes.size()) {
+                break;
+            }
+            if (entryFrame == compareWarmupFrames) {
+                glFinish();
+                compareStartTime = demoGetTime(&demo);
+            }
+            nextMode = modes[modeIdx];
+            compareFrame++;
+        }
+
+        // XX. Follow the size of the window and the mode of the comparison.
+        if (nextMode != gbuffer.mode || display_w != gbuffer.width || display_h != gbuffer.height) {
+            destroyGBuffer(&gbuffer);
+            if (!initGBuffer(&gbuffer, nextMode, display_w, display_h)) {
+                break;
+            }
+            memcpy(gbuffer.clearColor, backgroundColor, sizeof(backgroundColor));
+        }
+        gpuTimerBeginFrame(&gpuTimer);
+
+        // XX. The camera circles the scene, the lights circle around their positions.
+        float time = (float)demoAnimationTime(&demo);
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)display_w / (float)display_h,
+                                                nearPlane, farPlane);
+        glm::vec3 eye = glm::vec3(cosf(time * 0.1f) * 30.0f, 10.0f, sinf(time * 0.1f) * 30.0f);
+        glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+        for (int idx = 0; idx < lightCount; idx++) {
+            float angle = time * lightOrbits[idx * 3 + 1] + lightOrbits[idx * 3 + 2];
+            glm::vec4 position = glm::vec4(lightPositions[idx * 4 + 0] + cosf(angle) * lightOrbits[idx * 3 + 0],
+                                           lightPositions[idx * 4 + 1],
+                                           lightPositions[idx * 4 + 2] + sinf(angle) * lightOrbits[idx * 3 + 0], 1.0f);
+            glm::vec4 viewPosition = view * position;
+            viewLights[idx * 4 + 0] = viewPosition.x;
+            viewLights[idx * 4 + 1] = viewPosition.y;
+            viewLights[idx * 4 + 2] = viewPosition.z;
+            viewLights[idx * 4 + 3] = lightPositions[idx * 4 + 3];
+        }
+
+        int frameOffset;
+        {
+            FrameConstants frameConstants;
+            memcpy(frameConstants.projection, glm::value_ptr(projection), sizeof(frameConstants.projection));
+            memcpy(frameConstants.view, glm::value_ptr(view), sizeof(frameConstants.view));
+
+            uniformRingBeginFrame(&uniformRing);
+            frameOffset = uniformRingWrite(&uniformRing, &frameConstants, sizeof(frameConstants));
+            uniformRingEndFrame(&uniformRing);
+        }
+        uniformRingBind(&uniformRing, FRAME_CONSTANTS_BINDING, frameOffset, sizeof(FrameConstants));
+
+        const ModePrograms& modePrograms = programs[gbuffer.mode];
+
+        // P.1. Geometry pass: the G-buffer (or the lit image in the forward mode).
+        {
+            GpuTimerScope timerScope(&gpuTimer, "geometry");
+            gbufferBeginGeometry(&gbuffer);
+
+            glUseProgram(modePrograms.geometry);
+            if (gbuffer.mode == GBUFFER_FORWARD) {
+                setLightUniforms(modePrograms.geometry, viewLights, lightColors, lightCount);
+            }
+            glBindVertexArray(cube.vao);
+            glDrawElementsInstanced(GL_TRIANGLES, cube.indexCount, cube.indexType, NULL, instanceCount);
+            glBindVertexArray(0);
+        }
+
+        // P.2. Lighting pass: one full-screen triangle reads the G-buffer of every pixel.
+        if (gbuffer.mode != GBUFFER_FORWARD) {
+            GpuTimerScope timerScope(&gpuTimer, "lighting");
+            gbufferBeginLighting(&gbuffer, modePrograms.lighting, glm::value_ptr(projection), nearPlane, farPlane);
+            setLightUniforms(modePrograms.lighting, viewLights, lightColors, lightCount);
+            glUniform4fv(glGetUniformLocation(modePrograms.lighting, "backgroundColor"), 1, gbuffer.clearColor);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        gbufferEnd(&gbuffer);
+
+        // P.3. Copy the lit image into the window.
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, gbufferOutputFramebuffer(&gbuffer));
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, demoDefaultFramebuffer(&demo));
+        glBlitFramebuffer(0, 0, display_w, display_h, 0, 0, display_w, display_h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, demoDefaultFramebuffer(&demo));
+        gpuTimerEndFrame(&gpuTimer);
+
+        // X. Swap the fron-back buffers to display the rendered image in the window.
+        demoSwapBuffers(&demo);
+    }
+
+    // XX. Print the comparison: the G-buffer size, the estimated memory traffic and the frame time of the modes.
+    if (compare) {
+        printf("%-10s %14s %12s %10s\n", "mode", "G-buffer B/px", "MiB/frame", "ms/frame");
+        for (size_t idx = 0; idx < modes.size(); idx++) {
+            printf("%-10s %14d %12.2f %10.3f\n", gbufferModeName(modes[idx]), gbufferBytesPerPixel(modes[idx]),
+                   gbufferFrameBytes(modes[idx], display_w, display_h) / (1024.0 * 1024.0), modeMs[idx]);
+        }
+    }
+
+    // XX. Destroy the G-buffer, the programs and the buffers.
+    destroyGBuffer(&gbuffer);
+    for (int idx = 0; idx < GBUFFER_MODE_COUNT; idx++) {
+        glDeleteProgram(programs[idx].geometry);
+        glDeleteProgram(programs[idx].lighting);
+    }
+    glDeleteBuffers(1, &instanceBuffer);
+    destroyMeshBuffers(&cube);
+    destroyUniformRing(&uniformRing);
+    destroyGpuTimer(&gpuTimer);
+
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
+
+    return 0;
+}
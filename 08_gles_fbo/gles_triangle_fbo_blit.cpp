@@ -7,6 +7,40 @@
  * Run:
  * $ ./gles_texture
  *
+ * Keep every attachment in the memory (no glInvalidateFramebuffer calls):
+ * $ ./gles_triangle_fbo_blit --no-invalidate
+ *
+ * Anti-aliasing with a 4x multisampled renderbuffer resolved into the texture with a blit:
+ * $ ./gles_triangle_fbo_blit --msaa 4
+ *
+ * Same with EXT_multisampled_render_to_texture: the samples only live in the tile memory
+ * of tile based GPUs and are resolved on chip when the tile is written to the texture:
+ * $ ./gles_triangle_fbo_blit --msaa 4 --msaa-rtt
+ *
+ * Dynamic resolution: scale the FBO resolution (between 0.5 and 1.0) to keep the GPU frame
+ * time under 8 ms, the blit upscales the image to the window:
+ * $ ./gles_triangle_fbo_blit --dynamic-res --frame-budget 8 --min-scale 0.5
+ *
+ * Foveated rendering (see common/foveation.h): QCOM texture/framebuffer foveation if supported,
+ * otherwise the periphery at half resolution and the fovea (40% of the width and height around
+ * the focus) at full resolution, combined by the blit. "--fragment-cost N" adds N iterations of
+ * shading work to every fragment of the triangle:
+ * $ ./gles_triangle_fbo_blit --foveation best --fragment-cost 200
+ * $ ./gles_triangle_fbo_blit --foveation multi-res --foveation-focus 0.3,0.5 --fovea-size 0.3 --periphery-scale 0.25
+ *
+ * Temporal upscaling (see common/temporal_upscale.h): render at a fixed or the dynamic resolution with
+ * a sub-pixel jitter, write the motion vectors and accumulate the frames into an output resolution
+ * history. "--spin" rotates the triangle, "--render-scale S" renders at a fixed scale (without
+ * "--temporal": the plain blit upscale of the same resolution):
+ * $ ./gles_triangle_fbo_blit --temporal --render-scale 0.5 --spin
+ * $ ./gles_triangle_fbo_blit --temporal --dynamic-res --frame-budget 8 --min-scale 0.5
+ *
+ * Compute scaler (see common/compute_resample.h): "--scaler bilinear|bicubic|lanczos" upscales the FBO
+ * texture into the window with a separable compute filter instead of the GL_LINEAR blit, "--scaler auto"
+ * measures the blit and the bilinear compute scaler at the start and keeps the faster one:
+ * $ ./gles_triangle_fbo_blit --render-scale 0.5 --scaler lanczos
+ * $ ./gles_triangle_fbo_blit --dynamic-res --scaler auto
+ *
  * Dependencies:
  *  * C++11
  *  * GLFW 3.0+
@@ -35,10 +69,23 @@
  * OFTWARE.
  */
 #include <libgen.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-#include <GLFW/glfw3.h>
+#include <EGL/egl.h>
 #include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#include "common/compute_resample.h"
+#include "common/demo_context.h"
+#include "common/dynamic_resolution.h"
+#include "common/foveation.h"
+#include "common/gpu_timer.h"
+#include "common/render_pass.h"
+#include "common/render_target_pool.h"
+#include "common/temporal_upscale.h"
 
 const char* vertex_src = R"(#version 310 es
 precision highp float;
@@ -48,9 +95,17 @@ in vec2 aTex;
 
 out vec3 fragColor;
 out vec2 fTex;
+out vec2 currentPos;
+out vec2 previousPos;
+
+uniform mat2 uRotation;     // "--spin"
+uniform mat2 uPrevRotation; // the rotation of the previous frame (motion vectors)
+uniform vec2 uJitter;       // temporal upscaling: the sub-pixel offset of the frame (NDC)
 
 void main() {
-    gl_Position = vec4(aPos, 0.0, 1.0);
+    currentPos = uRotation * aPos;
+    previousPos = uPrevRotation * aPos;
+    gl_Position = vec4(currentPos + uJitter, 0.0, 1.0);
     fTex = aTex;
 }
 )";
@@ -59,54 +114,100 @@ const char* fragment_src = R"(#version 310 es
 precision highp float;
 
 in vec2 fTex;
-out vec4 outColor;
+in vec2 currentPos;
+in vec2 previousPos;
+layout(location = 0) out vec4 outColor;
+// Temporal upscaling: the screen space motion in UV units (no attachment otherwise: discarded).
+layout(location = 1) out vec2 outMotion;
 
 uniform int useTexture;
 uniform vec3 uColor;
 uniform sampler2D image;
+uniform int uCost;
 
 void main() {
     if (useTexture == 1) {
         outColor = texture(image, fTex);
     } else {
-        outColor = vec4(uColor, 1.0f);
+        // Synthetic shading work: "--fragment-cost N" iterations per fragment.
+        vec3 color = uColor;
+        for (int i = 0; i < uCost; i++) {
+            color = fract(color * 1.31 + 0.17 * sin(gl_FragCoord.yxy * 0.013 + float(i)));
+        }
+        outColor = vec4(mix(uColor, color, uCost > 0 ? 0.15 : 0.0), 1.0f);
     }
+    outMotion = (currentPos - previousPos) * 0.5;
 }
 )";
 
-static void ErrorCallbackGLFW(int error, const char* description) {
-    printf("Glfw Error %d: %s\n", error, description);
-}
-
 int main(int argc, char **argv) {
-    // 0. Add a method to report any GLFW errors.
-    glfwSetErrorCallback(ErrorCallbackGLFW);
-
-    // 1. Initialize the GLFW library.
-    if (!glfwInit()) {
-        return -1;
+    bool invalidate = true;
+    int samples = 1;
+    bool renderToTexture = false;
+    bool dynamicResolution = false;
+    double frameBudgetMs = 16.6;
+    float minScale = 0.5f;
+    const char* foveationArg = NULL;
+    float focusX = 0.5f;
+    float focusY = 0.5f;
+    float foveaSize = 0.4f;
+    float peripheryScale = 0.5f;
+    int fragmentCost = 0;
+    bool temporal = false;
+    float renderScale = 1.0f;
+    bool spin = false;
+    const char* scalerArg = "driver";
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--no-invalidate") == 0) {
+            invalidate = false;
+        } else if (strcmp(argv[idx], "--msaa") == 0 && idx + 1 < argc) {
+            samples = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--msaa-rtt") == 0) {
+            renderToTexture = true;
+        } else if (strcmp(argv[idx], "--dynamic-res") == 0) {
+            dynamicResolution = true;
+        } else if (strcmp(argv[idx], "--frame-budget") == 0 && idx + 1 < argc) {
+            dynamicResolution = true;
+            frameBudgetMs = atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--min-scale") == 0 && idx + 1 < argc) {
+            minScale = (float)atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--foveation") == 0 && idx + 1 < argc) {
+            foveationArg = argv[++idx];
+        } else if (strcmp(argv[idx], "--foveation-focus") == 0 && idx + 1 < argc) {
+            if (sscanf(argv[++idx], "%f,%f", &focusX, &focusY) != 2) {
+                printf("Invalid focus: %s (expected X,Y in [0, 1])\n", argv[idx]);
+                return -1;
+            }
+        } else if (strcmp(argv[idx], "--fovea-size") == 0 && idx + 1 < argc) {
+            foveaSize = (float)atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--periphery-scale") == 0 && idx + 1 < argc) {
+            peripheryScale = (float)atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--fragment-cost") == 0 && idx + 1 < argc) {
+            fragmentCost = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--temporal") == 0) {
+            temporal = true;
+        } else if (strcmp(argv[idx], "--render-scale") == 0 && idx + 1 < argc) {
+            renderScale = (float)atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--spin") == 0) {
+            spin = true;
+        } else if (strcmp(argv[idx], "--scaler") == 0 && idx + 1 < argc) {
+            scalerArg = argv[++idx];
+        }
     }
 
-    // 2. Add hints to use during context creation when a GLFW window is created.
-    // Here: require a GL ES 3.0 context.
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
-    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
-
-    // 3. Create window with graphics context
-    GLFWwindow* window = glfwCreateWindow(1024, 600, "GLDEMO", NULL, NULL);
-    if (window == NULL) {
-        return -2;
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    /* See the "01_gles_glfw" example for the GLFW steps. This also handles the
+     * "--headless" and "--frames N" command line options. */
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
     }
 
-    // 4. Activate the window (display it).
-    glfwMakeContextCurrent(window);
-
     // 5. Set the view port to match the window size.
     int display_w, display_h;
     {
-        glfwGetFramebufferSize(window, &display_w, &display_h);
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
         glViewport(0, 0, display_w, display_h);
     }
 
@@ -180,20 +281,11 @@ int main(int argc, char **argv) {
         glDeleteShader(fragment_shader);
     }
 
-    // FBO.1. Create texture for FBO
-    unsigned int target_texture;
-    {
-        glGenTextures(1, &target_texture);
-        glBindTexture(GL_TEXTURE_2D, target_texture);
-
-        // Allocate texture memory without providing input data
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, display_w, display_h, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    }
+    // FBO.1. Create the pool of the FBO render targets.
+    /* See common/render_target_pool.h: the FBO texture is acquired every frame with the
+     * current window size, so it is reallocated (only) after a resize. */
+    RenderTargetPool targetPool;
+    initRenderTargetPool(&targetPool);
 
     // 10. Specify the vertices.
     const float vertices[] = {
@@ -218,6 +310,13 @@ int main(int argc, char **argv) {
     {
         uniformColorLoc = glGetUniformLocation(shader_program, "uColor");
         uniformUseTexture = glGetUniformLocation(shader_program, "useTexture");
+
+        glUseProgram(shader_program);
+        glUniform1i(glGetUniformLocation(shader_program, "uCost"), fragmentCost);
+        const float identity[4] = { 1.0f, 0.0f, 0.0f, 1.0f };
+        glUniformMatrix2fv(glGetUniformLocation(shader_program, "uRotation"), 1, GL_FALSE, identity);
+        glUniformMatrix2fv(glGetUniformLocation(shader_program, "uPrevRotation"), 1, GL_FALSE, identity);
+        glUseProgram(0);
     }
 
     // 13. Texture coordinates.
@@ -246,48 +345,277 @@ int main(int argc, char **argv) {
     // FBO.X.4. Query the "image" sampler's location.
     int imageSamplerLoc = glGetUniformLocation(shader_program, "image");
 
-    // FBO.X. Connect the "texture" to a texture unit.
+    // MS.1. Check the requested sample count and the render to texture extension.
+    PFNGLFRAMEBUFFERTEXTURE2DMULTISAMPLEEXTPROC framebufferTexture2DMultisample = NULL;
+    unsigned int rttFbo = 0;
     {
-        // FBO.X.1. Activate the texture unit 1.
-        /* Using the texture unit 1 by desgin here for example purposes. */
-        glActiveTexture(GL_TEXTURE0 + 1);
+        int maxSamples = 0;
+        glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+        if (samples < 1 || samples > maxSamples) {
+            printf("Invalid sample count: %d (valid range: 1-%d)\n", samples, maxSamples);
+            return -1;
+        }
 
-        // FBO.X.2. Bind the "texture" to the active texture unit.
-        /* After this the GL_TEXTURE0 texture unit is bound to the "texture" object. */
-        glBindTexture(GL_TEXTURE_2D, target_texture);
+        if (samples > 1 && renderToTexture) {
+            const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+            if (extensions != NULL && strstr(extensions, "GL_EXT_multisampled_render_to_texture") != NULL) {
+                framebufferTexture2DMultisample = (PFNGLFRAMEBUFFERTEXTURE2DMULTISAMPLEEXTPROC)
+                    eglGetProcAddress("glFramebufferTexture2DMultisampleEXT");
+            }
+
+            if (framebufferTexture2DMultisample == NULL) {
+                printf("EXT_multisampled_render_to_texture is not supported, using the resolve blit\n");
+                renderToTexture = false;
+            } else {
+                /* The texture is attached in the render loop (it changes after a resize). */
+                glGenFramebuffers(1, &rttFbo);
+            }
+        }
+    }
+    bool resolveBlit = samples > 1 && !renderToTexture;
+
+    // FV.1. "--foveation MODE": the QCOM extensions or the multi-res fallback ("best": the first supported).
+    Foveation foveation;
+    {
+        FoveationMode mode = FOVEATION_OFF;
+        if (foveationArg != NULL) {
+            mode = strcmp(foveationArg, "best") == 0 ? foveationBestMode() : findFoveationMode(foveationArg);
+        }
+        if (mode == FOVEATION_MODE_COUNT || !foveationModeSupported(mode)) {
+            printf("Unsupported foveation mode: %s (best, off, qcom-texture, qcom-framebuffer or multi-res)\n", foveationArg);
+            return -1;
+        }
+        if (mode != FOVEATION_OFF && (samples > 1 || dynamicResolution)) {
+            /* The multisampled targets and the scaled viewport would need their own fovea mapping. */
+            printf("Foveation is not supported with --msaa or --dynamic-res\n");
+            return -1;
+        }
+        initFoveation(&foveation, mode, focusX, focusY, foveaSize, peripheryScale);
+        if (mode != FOVEATION_OFF) {
+            printf("Foveation: %s, focus: %.2f,%.2f, fovea: %.2f, periphery scale: %.2f\n", foveationModeName(mode),
+                   foveation.focusX, foveation.focusY, foveation.foveaSize, foveation.peripheryScale);
+        }
+    }
+    bool multiRes = foveation.mode == FOVEATION_MULTI_RES;
+
+    // TU.1. "--temporal": the jittered scene and the history of the upscaler replace the FBO texture.
+    TemporalUpscale upscale;
+    if (temporal) {
+        if (samples > 1 || foveation.mode != FOVEATION_OFF) {
+            printf("Temporal upscaling is not supported with --msaa or --foveation\n");
+            return -1;
+        }
+        if (!initTemporalUpscale(&upscale, display_w, display_h)) {
+            return -3;
+        }
+    }
+    renderScale = renderScale < 0.1f ? 0.1f : renderScale > 1.0f ? 1.0f : renderScale;
+
+    // SC.1. "--scaler": the GL_LINEAR blit ("driver"), a compute filter or the faster of the blit and the bilinear filter.
+    /* "auto" measures the first frame's sizes: the render size into the blit rectangle of the window. */
+    ComputeScaler scaler;
+    ResamplePath scalerPath = RESAMPLE_DRIVER;
+    ResampleFilter scalerFilter = RESAMPLE_BILINEAR;
+    if (strcmp(scalerArg, "driver") != 0) {
+        if (temporal || multiRes) {
+            printf("The compute scaler is not supported with --temporal or --foveation multi-res\n");
+            return -1;
+        }
+        if (strcmp(scalerArg, "auto") == 0) {
+            ResampleBenchmark benchmark;
+            scalerPath = selectScalePath((int)(display_w * renderScale + 0.5f), (int)(display_h * renderScale + 0.5f),
+                                         display_w - 400, display_h - 400, &benchmark);
+            printf("Scaler benchmark: blit %.3f ms, compute %.3f ms -> %s\n", benchmark.driverMs, benchmark.computeMs,
+                   resamplePathNames[scalerPath]);
+        } else {
+            scalerFilter = findResampleFilter(scalerArg);
+            if (scalerFilter == RESAMPLE_FILTER_COUNT) {
+                printf("Invalid scaler: %s (driver, bilinear, bicubic, lanczos or auto)\n", scalerArg);
+                return -1;
+            }
+            scalerPath = RESAMPLE_COMPUTE;
+        }
+        if (scalerPath == RESAMPLE_COMPUTE && !initComputeScaler(&scaler, scalerFilter)) {
+            return -3;
+        }
+    }
+    int rotationLoc = glGetUniformLocation(shader_program, "uRotation");
+    int prevRotationLoc = glGetUniformLocation(shader_program, "uPrevRotation");
+    int jitterLoc = glGetUniformLocation(shader_program, "uJitter");
+    float prevRotation[4] = { 1.0f, 0.0f, 0.0f, 1.0f };
+
+    // R.1. Describe the render passes of a frame (see common/render_pass.h).
+    /* The FBO is cleared and stored (it is blitted). The window is cleared and only its
+     * color is presented: the depth buffer is never loaded or stored. With the multisampled
+     * renderbuffer the samples are discarded after the resolve blit. */
+    RenderPass fboPass = createRenderPass("fbo", 0, display_w, display_h);
+    {
+        fboPass.color = { RENDER_PASS_CLEAR, RENDER_PASS_STORE, 3 }; // GL_RGB
+        if (resolveBlit) {
+            fboPass.color = { RENDER_PASS_CLEAR, RENDER_PASS_DISCARD, 3 * samples };
+        }
+        if (temporal) {
+            // The upscaler's scene: RGBA8 color and RG16F motion (read by the resolve), depth.
+            fboPass.color = { RENDER_PASS_CLEAR, RENDER_PASS_STORE, 8 };
+            fboPass.depth = { RENDER_PASS_CLEAR, RENDER_PASS_DISCARD, 4 };
+        }
+        fboPass.clearColor[0] = 0.0f;
+        fboPass.clearColor[1] = 0.3f;
+        fboPass.clearColor[2] = 0.3f;
+        fboPass.invalidate = invalidate;
+    }
 
-        // FBO.X.3. No need to keep the active texture unit.
-        glActiveTexture(0);
+    // FV.2. Multi-res: the periphery is a separate pass into a smaller target (cleared and stored as well).
+    RenderPass peripheryPass = createRenderPass("periphery", 0, display_w, display_h);
+    peripheryPass.color = fboPass.color;
+    memcpy(peripheryPass.clearColor, fboPass.clearColor, sizeof(fboPass.clearColor));
+    peripheryPass.invalidate = invalidate;
 
+    RenderPass windowPass = createRenderPass("window", demoDefaultFramebuffer(&demo), display_w, display_h);
+    {
+        windowPass.color = { RENDER_PASS_CLEAR, RENDER_PASS_STORE, 4 };
+        windowPass.depth = { RENDER_PASS_DONT_CARE, RENDER_PASS_DISCARD, 4 };
+        windowPass.invalidate = invalidate;
     }
 
-    unsigned int fbo;
     {
-        glGenFramebuffers(1, &fbo);
-        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        const RenderPass* passes[] = { &fboPass, &windowPass, &peripheryPass };
+        printRenderPassReport(passes, multiRes ? 3 : 2);
+    }
 
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target_texture, 0);
+    const char* modeName = samples == 1 ? "no MSAA" : renderToTexture ? "render to texture" : "resolve blit";
+    printf("%dx MSAA (%s)\n", samples, modeName);
 
-        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-            printf("ERROR::FRAMEBUFFER:: Framebuffer is not complete!\n");
-            return -1;
-        }
+    // DR.1. Measure the GPU frame time for the dynamic resolution (the CPU frame time without the timer queries).
+    GpuTimer gpuTimer;
+    initGpuTimer(&gpuTimer, argc, argv);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    DynamicResolution dynres;
+    initDynamicResolution(&dynres, frameBudgetMs, minScale < 0.1f ? 0.1f : minScale, 1.0f);
+    if (foveation.mode != FOVEATION_OFF) {
+        gpuTimerEnableQueries(&gpuTimer);
+    }
+    if (dynamicResolution) {
+        bool gpuTime = gpuTimerEnableQueries(&gpuTimer);
+        printf("Dynamic resolution: %.2f ms budget (%s frame time), scale: %.2f-%.2f\n",
+               frameBudgetMs, gpuTime ? "GPU" : "CPU", dynres.minScale, dynres.maxScale);
     }
+    double lastFrameTime = demoGetTime(&demo);
+
+    unsigned int attachedTexture = 0;
+    int lastDisplayW = 0;
+    int lastDisplayH = 0;
+    double statsStartTime = demoGetTime(&demo);
+    int statsFrames = 0;
 
     // X. Create a render loop.
-    while (!glfwWindowShouldClose(window))
+    while (!demoShouldClose(&demo))
     {
         // X. Poll and handle events (inputs, window resize, etc.)
-        glfwPollEvents();
+        demoPollEvents(&demo);
+
+        // FBO.2. Acquire the FBO texture with the current window size.
+        /* Temporal upscaling: the upscaler has its own targets (recreated after a resize). */
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
+        RenderTarget* target = NULL;
+        if (temporal) {
+            if (upscale.width != display_w || upscale.height != display_h) {
+                destroyTemporalUpscale(&upscale);
+                if (!initTemporalUpscale(&upscale, display_w, display_h)) {
+                    break;
+                }
+            }
+            fboPass.fbo = upscale.sceneFbo;
+        } else {
+            target = acquireRenderTarget(&targetPool, GL_RGB8, display_w, display_h);
+            if (target == NULL) {
+                break;
+            }
+            fboPass.fbo = target->fbo;
+        }
+
+        // MS.2. Multisampled rendering: into a renderbuffer of the pool or into the texture via the extension.
+        RenderTarget* msaaTarget = NULL;
+        if (resolveBlit) {
+            RenderTargetKey msaaKey = { RENDER_TARGET_RENDERBUFFER, GL_RGB8, display_w, display_h, samples };
+            msaaTarget = acquireRenderTarget(&targetPool, msaaKey);
+            if (msaaTarget == NULL) {
+                break;
+            }
+            fboPass.fbo = msaaTarget->fbo;
+        } else if (renderToTexture) {
+            if (attachedTexture != target->texture) {
+                glBindFramebuffer(GL_FRAMEBUFFER, rttFbo);
+                framebufferTexture2DMultisample(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                                                target->texture, 0, samples);
+                attachedTexture = target->texture;
+            }
+            fboPass.fbo = rttFbo;
+        }
+        // DR.2. The targets have the window size, only the scaled region is rendered and upscaled.
+        /* "--render-scale S": a fixed scale. */
+        int render_w = dynamicResolution ? dynamicResolutionSize(&dynres, display_w) : (int)(display_w * renderScale + 0.5f);
+        int render_h = dynamicResolution ? dynamicResolutionSize(&dynres, display_h) : (int)(display_h * renderScale + 0.5f);
+        fboPass.width = render_w;
+        fboPass.height = render_h;
+        windowPass.width = display_w;
+        windowPass.height = display_h;
+
+        // FV.3. Multi-res: the periphery target, QCOM: the focus of the texture or FBO (enabled at the first use).
+        RenderTarget* peripheryTarget = NULL;
+        int inset_x = 0, inset_y = 0, inset_w = render_w, inset_h = render_h;
+        if (multiRes) {
+            peripheryPass.width = foveationPeripherySize(&foveation, display_w);
+            peripheryPass.height = foveationPeripherySize(&foveation, display_h);
+            peripheryTarget = acquireRenderTarget(&targetPool, GL_RGB8, peripheryPass.width, peripheryPass.height);
+            if (peripheryTarget == NULL) {
+                break;
+            }
+            peripheryPass.fbo = peripheryTarget->fbo;
+            foveationInsetRect(&foveation, render_w, render_h, &inset_x, &inset_y, &inset_w, &inset_h);
+        } else if (foveation.mode != FOVEATION_OFF) {
+            foveationApply(&foveation, target->texture, target->fbo);
+        }
+
+        gpuTimerBeginFrame(&gpuTimer);
+        gpuTimerBegin(&gpuTimer, "frame");
+
+        // TU.2. The rotation ("--spin"), the previous one for the motion vectors and the jitter of the frame.
+        {
+            float jitter[2] = { 0.0f, 0.0f };
+            if (temporal) {
+                temporalUpscaleBeginFrame(&upscale, render_w, render_h, jitter);
+            }
+            float angle = spin ? (float)demoAnimationTime(&demo) * 0.5f : 0.0f;
+            float rotation[4] = { cosf(angle), sinf(angle), -sinf(angle), cosf(angle) };
+
+            glUseProgram(shader_program);
+            glUniformMatrix2fv(rotationLoc, 1, GL_FALSE, rotation);
+            glUniformMatrix2fv(prevRotationLoc, 1, GL_FALSE, prevRotation);
+            glUniform2fv(jitterLoc, 1, jitter);
+            glUseProgram(0);
+            memcpy(prevRotation, rotation, sizeof(rotation));
+        }
+
+        // FV.4. Multi-res: the whole frame at the periphery resolution.
+        if (multiRes) {
+            beginRenderPass(&peripheryPass);
+            glUseProgram(shader_program);
+            glUniform1f(uniformUseTexture, 0);
+            glUniform3f(uniformColorLoc, 1.0, 0.5, 1.0);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glUseProgram(0);
+            endRenderPass(&peripheryPass);
+        }
 
         // FBO.X Draw on FBO texture
+        /* Multi-res: only the fovea rectangle is shaded (scissor). */
         {
-            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-            // X. Clear the color image.
-            glClearColor(0.0, 0.3, 0.3, 1.0f);
-            glClear(GL_COLOR_BUFFER_BIT);
+            // X. Bind the FBO and clear the color image.
+            beginRenderPass(&fboPass);
+            if (temporal) {
+                temporalUpscaleClearMotion(&upscale);
+            }
 
             // X. Use the shader program to draw.
             glUseProgram(shader_program);
@@ -297,23 +625,148 @@ int main(int argc, char **argv) {
             glUniform3f(uniformColorLoc, 1.0, 0.5, 1.0);
 
             // X. Draw the triangles.
+            if (multiRes) {
+                glEnable(GL_SCISSOR_TEST);
+                glScissor(inset_x, inset_y, inset_w, inset_h);
+            }
             glDrawArrays(GL_TRIANGLES, 0, 3);
+            glDisable(GL_SCISSOR_TEST);
 
             glUseProgram(0);
+
+            // MS.3. Resolve the samples into the texture (the rectangles must have the same size).
+            if (resolveBlit) {
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, msaaTarget->fbo);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target->fbo);
+                glBlitFramebuffer(0, 0, render_w, render_h, 0, 0, render_w, render_h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            }
+
+            endRenderPass(&fboPass);
+
+            // TU.3. Accumulate the frame into the output resolution history.
+            if (temporal) {
+                temporalUpscaleResolve(&upscale);
+            }
+        }
+
+        // SC.2. The compute scaler writes the window rectangle's image before the window pass (1:1 blit).
+        unsigned int scaledFbo = 0;
+        if (scalerPath == RESAMPLE_COMPUTE) {
+            gpuTimerBegin(&gpuTimer, "compute scale");
+            scaledFbo = computeScale(&scaler, target->texture, render_w, render_h, display_w - 400, display_h - 400);
+            gpuTimerEnd(&gpuTimer);
         }
 
         // FBO.X. Blit (copy) the FBO 1 contents to FBO 0.
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-        glBlitFramebuffer(0, 0, display_w, display_h, 200, 200, display_w - 200, display_h - 200, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        /* The blit doesn't cover the whole window: the window pass clears it first. */
+        /* Multi-res: the upscaled periphery, then the fovea rectangle at its place. */
+        beginRenderPass(&windowPass);
+        if (multiRes) {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, peripheryTarget->fbo);
+            glBlitFramebuffer(0, 0, peripheryPass.width, peripheryPass.height, 200, 200, display_w - 200, display_h - 200,
+                              GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+            double scale_x = (display_w - 400) / (double)render_w;
+            double scale_y = (display_h - 400) / (double)render_h;
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, target->fbo);
+            glBlitFramebuffer(inset_x, inset_y, inset_x + inset_w, inset_y + inset_h,
+                              200 + (int)(inset_x * scale_x), 200 + (int)(inset_y * scale_y),
+                              200 + (int)((inset_x + inset_w) * scale_x), 200 + (int)((inset_y + inset_h) * scale_y),
+                              GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        } else if (temporal) {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, temporalUpscaleOutputFramebuffer(&upscale));
+            glBlitFramebuffer(0, 0, display_w, display_h, 200, 200, display_w - 200, display_h - 200, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        } else if (scaledFbo != 0) {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, scaledFbo);
+            glBlitFramebuffer(0, 0, display_w - 400, display_h - 400, 200, 200, display_w - 200, display_h - 200,
+                              GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        } else {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, target->fbo);
+            glBlitFramebuffer(0, 0, render_w, render_h, 200, 200, display_w - 200, display_h - 200, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        }
+        renderPassCovered(&windowPass, GL_COLOR_BUFFER_BIT, 200, 200, display_w - 400, display_h - 400);
+        endRenderPass(&windowPass);
+
+        gpuTimerEnd(&gpuTimer);
+        gpuTimerEndFrame(&gpuTimer);
+
+        // FBO.3. The texture can be reused by the next frame (or freed after a resize).
+        releaseRenderTarget(&targetPool, target);
+        releaseRenderTarget(&targetPool, msaaTarget);
+        releaseRenderTarget(&targetPool, peripheryTarget);
+        renderTargetPoolEndFrame(&targetPool);
+
+        // FBO.4. Only the blit region can change while the window size stays: report it as the swap damage.
+        /* See demoAddSwapDamage: a presentation hint (EGL_KHR_swap_buffers_with_damage), the first
+         * frame and the frames after a resize damage the whole window. */
+        if (display_w == lastDisplayW && display_h == lastDisplayH) {
+            demoAddSwapDamage(&demo, 200, 200, display_w - 400, display_h - 400);
+        }
+        lastDisplayW = display_w;
+        lastDisplayH = display_h;
 
         // X. Swap the fron-back buffers to display the rendered image in the window.
-        glfwSwapBuffers(window);
+        demoSwapBuffers(&demo);
+
+        // DR.3. Adjust the resolution of the next frame.
+        /* The GPU times arrive a few frames late, the controller smooths them anyway. */
+        double now = demoGetTime(&demo);
+        if (dynamicResolution) {
+            double frameMs = gpuTimer.supported ? gpuTimerLastMs(&gpuTimer, "frame") : (now - lastFrameTime) * 1000.0;
+            dynamicResolutionUpdate(&dynres, frameMs);
+        }
+        lastFrameTime = now;
+
+        // X. Report the frame time once every second.
+        statsFrames++;
+        double statsElapsed = demoGetTime(&demo) - statsStartTime;
+        if (statsElapsed >= 1.0) {
+            printf("%dx MSAA (%s): %.3f ms/frame", samples, modeName, statsElapsed * 1000.0 / statsFrames);
+            if (dynamicResolution) {
+                printf(", resolution: %dx%d (scale: %.2f, frame time: %.3f ms)", render_w, render_h, dynres.scale, dynres.averageMs);
+            }
+            if (temporal || (!dynamicResolution && renderScale < 1.0f)) {
+                printf(", %s: %dx%d -> %dx%d", temporal ? "temporal upscaling" : "upscaling", render_w, render_h,
+                       display_w, display_h);
+            }
+            if (scalerPath == RESAMPLE_COMPUTE) {
+                printf(", compute scaler (%s)", resampleFilterNames[scalerFilter]);
+            }
+            if (foveation.mode != FOVEATION_OFF) {
+                printf(", foveation %s: %.0f%% of the fragments shaded", foveationModeName(foveation.mode),
+                       foveationShadedFraction(&foveation) * 100.0);
+                if (gpuTimer.supported) {
+                    printf(", GPU: %.3f ms", gpuTimerLastMs(&gpuTimer, "frame"));
+                }
+            }
+            printf("\n");
+            statsStartTime = demoGetTime(&demo);
+            statsFrames = 0;
+        }
+    }
+
+    destroyGpuTimer(&gpuTimer);
+    if (temporal) {
+        destroyTemporalUpscale(&upscale);
+    }
+    if (scalerPath == RESAMPLE_COMPUTE) {
+        destroyComputeScaler(&scaler);
+    }
+
+    if (rttFbo != 0) {
+        glDeleteFramebuffers(1, &rttFbo);
+    }
+
+    // XX. Destroy the render targets.
+    printRenderTargetPoolStats(&targetPool);
+    destroyRenderTargetPool(&targetPool);
+    {
+        const RenderPass* passes[] = { &fboPass, &windowPass, &peripheryPass };
+        printRenderPassClearReport(passes, multiRes ? 3 : 2);
     }
 
-    // XX. Destroy the window.
-    glfwDestroyWindow(window);
-    // XX. Destroy the GLFW.
-    glfwTerminate();
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
 
     return 0;
 }
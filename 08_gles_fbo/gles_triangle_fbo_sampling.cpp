@@ -7,11 +7,32 @@
  * Run:
  * $ ./gles_triangle_fbo_sampling
  *
+ * The texture is sampled right after it was rendered: the GL orders the commands of a
+ * context, no glFinish is required between the two passes. Options:
+ *  --finish     Drain the GPU with glFinish after the FBO pass (the old behaviour, to
+ *               compare the frame times).
+ *  --readback   Read the center pixel of the texture back to the CPU through a PBO:
+ *               the only place where a fence is needed.
+ *  --post       Display the texture through the bloom post-processing chain
+ *               (see common/post_process.h) instead of sampling it directly.
+ *  --post-full-res  Same as --post with every intermediate target at full resolution.
+ *  --filter NAME    Filter mode of the sampler object used to sample the texture (default:
+ *               bilinear, see common/sampler_cache.h, the target has no mip levels).
+ *  --grade MODE Display the scene with a colour grading and a vignette:
+ *               fetch: the scene is drawn into the window and a full-screen pass grades
+ *                      the pixels in place with EXT_shader_framebuffer_fetch (on tile based
+ *                      GPUs the pixel is read from the tile memory: no FBO texture is
+ *                      written and sampled back),
+ *               sample: the scene is drawn into the FBO texture and the full-screen pass
+ *                      samples it (the fallback),
+ *               auto: fetch if the extension is supported, sample otherwise.
+ *
  * Dependencies:
  *  * C++11
  *  * GLFW 3.0+
  *  * Open GL ES 3.0+
  *  * EGL
+ *  * EXT_shader_framebuffer_fetch (optional)
  *
  * MIT License
  * Copyright (c) 2020 elecro
@@ -35,12 +56,18 @@
  * OFTWARE.
  */
 #include <stdio.h>
+#include <string.h>
 
-#include <GLFW/glfw3.h>
 #include <GLES3/gl3.h>
 
 #include <unistd.h>
 
+#include "common/demo_context.h"
+#include "common/post_process.h"
+#include "common/program_cache.h"
+#include "common/render_target_pool.h"
+#include "common/sampler_cache.h"
+
 const char* vertex_src = R"(#version 310 es
 precision highp float;
 
@@ -75,39 +102,148 @@ void main() {
 }
 )";
 
-static void ErrorCallbackGLFW(int error, const char* description) {
-    printf("Glfw Error %d: %s\n", error, description);
+// The colour grading and the vignette of the "--grade" modes (shared by the fetch and the sampling shaders).
+/* Exposure and gamma, then less saturation and a warm tint, then darken towards the corners. */
+#define GRADE_FUNCTIONS                                                               \
+    "uniform vec2 uViewSize;\n"                                                       \
+    "vec4 grade(vec4 color) {\n"                                                      \
+    "    vec3 graded = pow(max(color.rgb * 1.1 + 0.02, vec3(0.0)), vec3(0.9));\n"     \
+    "    float luma = dot(graded, vec3(0.2126, 0.7152, 0.0722));\n"                   \
+    "    graded = mix(vec3(luma), graded, 0.8) * vec3(1.05, 1.0, 0.92);\n"            \
+    "    vec2 centered = gl_FragCoord.xy / uViewSize - 0.5;\n"                        \
+    "    float vignette = smoothstep(0.8, 0.25, length(centered));\n"                 \
+    "    return vec4(graded * vignette, color.a);\n"                                  \
+    "}\n"
+
+// Full-screen triangle without vertex attributes.
+const char* grade_vertex_src = R"(#version 310 es
+precision highp float;
+
+void main() {
+    vec2 position = vec2(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1));
+    gl_Position = vec4(position, 0.0, 1.0);
+}
+)";
+
+// The pixel is read and written in place: the draw needs no texture (and no blending).
+const char* grade_fetch_src = "#version 310 es\n"
+    "#extension GL_EXT_shader_framebuffer_fetch : require\n"
+    "precision highp float;\n"
+    GRADE_FUNCTIONS R"(
+layout(location = 0) inout vec4 outColor;
+
+void main() {
+    outColor = grade(outColor);
+}
+)";
+
+const char* grade_sample_src = "#version 310 es\n"
+    "precision highp float;\n"
+    GRADE_FUNCTIONS R"(
+uniform sampler2D image;
+out vec4 outColor;
+
+void main() {
+    outColor = grade(texelFetch(image, ivec2(gl_FragCoord.xy), 0));
 }
+)";
+
+enum GradeMode {
+    GRADE_OFF,
+    GRADE_AUTO,
+    GRADE_FETCH,
+    GRADE_SAMPLE,
+};
 
 int main(int argc, char **argv) {
-    // 0. Add a method to report any GLFW errors.
-    glfwSetErrorCallback(ErrorCallbackGLFW);
+    bool forceFinish = false;
+    bool readback = false;
+    bool post = false;
+    bool postFullResolution = false;
+    GradeMode grade = GRADE_OFF;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--finish") == 0) {
+            forceFinish = true;
+        } else if (strcmp(argv[idx], "--readback") == 0) {
+            readback = true;
+        } else if (strcmp(argv[idx], "--post") == 0) {
+            post = true;
+        } else if (strcmp(argv[idx], "--post-full-res") == 0) {
+            post = true;
+            postFullResolution = true;
+        } else if (strcmp(argv[idx], "--grade") == 0 && idx + 1 < argc) {
+            const char* name = argv[++idx];
+            if (strcmp(name, "auto") == 0) {
+                grade = GRADE_AUTO;
+            } else if (strcmp(name, "fetch") == 0) {
+                grade = GRADE_FETCH;
+            } else if (strcmp(name, "sample") == 0) {
+                grade = GRADE_SAMPLE;
+            } else {
+                printf("Unknown grade mode: %s (auto, fetch or sample)\n", name);
+                return -1;
+            }
+        }
+    }
+    if (grade != GRADE_OFF && post) {
+        printf("--grade and --post both display the texture, select only one of them\n");
+        return -1;
+    }
 
-    // 1. Initialize the GLFW library.
-    if (!glfwInit()) {
+    // The render target textures are immutable with one level: complete with any filter of the sampler.
+    SamplerDesc samplerDesc;
+    samplerFilterDesc("bilinear", &samplerDesc);
+    samplerDesc.wrap = GL_CLAMP_TO_EDGE;
+    if (!parseSamplerOptions(argc, argv, &samplerDesc, NULL)) {
         return -1;
     }
 
-    // 2. Add hints to use during context creation when a GLFW window is created.
-    // Here: require a GL ES 3.0 context.
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
-    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
-
-    // 3. Create window with graphics context
-    GLFWwindow* window = glfwCreateWindow(1024, 600, "GLDEMO", NULL, NULL);
-    if (window == NULL) {
-        return -2;
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    /* See the "01_gles_glfw" example for the GLFW steps. This also handles the
+     * "--headless" and "--frames N" command line options. */
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
     }
 
-    // 4. Activate the window (display it).
-    glfwMakeContextCurrent(window);
+    // GR.1. Select the grade mode: the fetch path needs EXT_shader_framebuffer_fetch.
+    unsigned int gradeProgram = 0;
+    unsigned int gradeVao = 0;
+    int gradeViewSizeLoc = -1;
+    if (grade != GRADE_OFF) {
+        const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+        bool fetchSupported = extensions != NULL && strstr(extensions, "GL_EXT_shader_framebuffer_fetch") != NULL;
+        if (grade == GRADE_AUTO) {
+            grade = fetchSupported ? GRADE_FETCH : GRADE_SAMPLE;
+        } else if (grade == GRADE_FETCH && !fetchSupported) {
+            printf("EXT_shader_framebuffer_fetch is not supported, use '--grade sample'\n");
+            destroyDemoContext(&demo);
+            return -1;
+        }
+        if (grade == GRADE_FETCH && readback) {
+            printf("--readback reads the FBO texture, the fetch grade mode has none\n");
+            destroyDemoContext(&demo);
+            return -1;
+        }
+
+        gradeProgram = createCachedProgram(grade_vertex_src, grade == GRADE_FETCH ? grade_fetch_src : grade_sample_src);
+        if (gradeProgram == 0) {
+            destroyDemoContext(&demo);
+            return -3;
+        }
+        gradeViewSizeLoc = glGetUniformLocation(gradeProgram, "uViewSize");
+        glUseProgram(gradeProgram);
+        glUniform1i(glGetUniformLocation(gradeProgram, "image"), 0);
+        glUseProgram(0);
+        glGenVertexArrays(1, &gradeVao);
+        printf("Grade: %s\n", grade == GRADE_FETCH ? "fetch (in place, no FBO texture)" : "sample (FBO texture)");
+    }
 
     // 5. Set the view port to match the window size.
     int display_w, display_h;
     {
-        glfwGetFramebufferSize(window, &display_w, &display_h);
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
         glViewport(0, 0, display_w, display_h);
     }
 
@@ -181,20 +317,11 @@ int main(int argc, char **argv) {
         glDeleteShader(fragment_shader);
     }
 
-    // FBO.1. Create texture for FBO
-    unsigned int target_texture;
-    {
-        glGenTextures(1, &target_texture);
-        glBindTexture(GL_TEXTURE_2D, target_texture);
-
-        // Allocate texture memory without providing input data
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, display_w, display_h, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    }
+    // FBO.1. Create the pool of the render targets (the FBO texture and the post-processing targets).
+    /* See common/render_target_pool.h: the FBO texture is acquired every frame with the
+     * current window size, so it is reallocated (only) after a resize. */
+    RenderTargetPool targetPool;
+    initRenderTargetPool(&targetPool);
 
     // 10. Specify the vertices.
     const float vertices[] = {
@@ -245,44 +372,47 @@ int main(int argc, char **argv) {
     // FBO.X.4. Query the "image" sampler's location.
     int imageSamplerLoc = glGetUniformLocation(shader_program, "image");
 
-    // FBO.X. Connect the "texture" to a texture unit.
-    {
-        // FBO.X.1. Activate the texture unit 1.
-        /* Using the texture unit 1 by desgin here for example purposes. */
-        glActiveTexture(GL_TEXTURE0 + 1);
-
-        // FBO.X.2. Bind the "texture" to the active texture unit.
-        /* After this the GL_TEXTURE0 texture unit is bound to the "texture" object. */
-        glBindTexture(GL_TEXTURE_2D, target_texture);
-
-        // FBO.X.3. No need to keep the active texture unit.
-        glActiveTexture(0);
+    // RB.1. Create the pixel pack buffer for the "--readback" mode.
+    unsigned int readbackPBO = 0;
+    GLsync readbackFence = NULL;
+    if (readback) {
+        glGenBuffers(1, &readbackPBO);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackPBO);
+        glBufferData(GL_PIXEL_PACK_BUFFER, 4, NULL, GL_STREAM_READ);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
     }
 
-    unsigned int fbo;
-    {
-        glGenFramebuffers(1, &fbo);
-        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target_texture, 0);
-
-        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-            printf("ERROR::FRAMEBUFFER:: Framebuffer is not complete!\n");
-            return -1;
-        }
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // PP.1. Create the post-processing chain, its intermediate targets come from the same pool.
+    PostChain postChain;
+    if (post) {
+        initPostChain(&postChain, &targetPool);
+        postChain.fullResolution = postFullResolution;
+        addBloomPasses(&postChain);
     }
 
+    double statsStartTime = demoGetTime(&demo);
+    int statsFrames = 0;
+
     // X. Create a render loop.
-    while (!glfwWindowShouldClose(window))
+    while (!demoShouldClose(&demo))
     {
         // X. Poll and handle events (inputs, window resize, etc.)
-        glfwPollEvents();
+        demoPollEvents(&demo);
+
+        // FBO.2. Acquire the FBO texture with the current window size (not used by the fetch grade mode).
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
+        RenderTarget* target = NULL;
+        if (grade != GRADE_FETCH) {
+            target = acquireRenderTarget(&targetPool, GL_RGB8, display_w, display_h);
+            if (target == NULL) {
+                break;
+            }
+        }
 
-        // FBO.X Draw on FBO texture
+        // FBO.X Draw on FBO texture (directly into the window with the fetch grade mode).
         {
-            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, target != NULL ? target->fbo : demoDefaultFramebuffer(&demo));
+            glViewport(0, 0, display_w, display_h);
             // X. Clear the color image.
             glClearColor(1.0, 0.0, 0.0, 1.0f);
             glClear(GL_COLOR_BUFFER_BIT);
@@ -298,38 +428,144 @@ int main(int argc, char **argv) {
             glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
             glUseProgram(0);
-            glFinish();
-        }
-
-        // FBO.Sampling.X. Switch to FBO 0.
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        {
-            // X. Clear the color image.
-            glClearColor(0.0, 1.0, 0.0, 1.0f);
-            glClear(GL_COLOR_BUFFER_BIT);
 
-            // X. Use the shader program to draw.
-            glUseProgram(shader_program);
-
-            glUniform1i(uniformUseTexture, 1);
-            // x. Set the sampler's "value" to the texture unit 1.
-            glUniform1i(imageSamplerLoc, 0 + 1);
-            glUniform3f(uniformColorLoc, 0.0, 0.0, 0.0);
+            /* Not needed for the sampling below: the draw into the texture is ordered before
+             * the draw which samples it. glFinish only stalls the CPU until the GPU is idle. */
+            if (forceFinish) {
+                glFinish();
+            }
+        }
 
-            // X. Draw the triangles.
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        // RB.2. Copy the center pixel into the PBO once the previous copy was consumed.
+        /* The CPU needs to know when the copy is done: this is where a fence is required.
+         * It is polled without waiting, so the readback result is a few frames late. */
+        if (readback) {
+            if (readbackFence != NULL && glClientWaitSync(readbackFence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+                glDeleteSync(readbackFence);
+                readbackFence = NULL;
+
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackPBO);
+                const unsigned char* pixel = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, 4, GL_MAP_READ_BIT);
+                if (pixel != NULL && statsFrames == 0) {
+                    printf("Texture center pixel: %d %d %d %d\n", pixel[0], pixel[1], pixel[2], pixel[3]);
+                }
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            }
+
+            if (readbackFence == NULL) {
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, target->fbo);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackPBO);
+                glReadPixels(display_w / 2, display_h / 2, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+                readbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            }
+        }
 
+        // PP.2. Run the post-processing passes, the last one renders into the window.
+        if (post) {
+            runPostChain(&postChain, target->texture, display_w, display_h, demoDefaultFramebuffer(&demo));
+            if (demo.frameCount == 0) {
+                printPostChainReport(&postChain, display_w, display_h);
+            }
+        } else if (grade != GRADE_OFF) {
+            // GR.2. Grade the pixels of the window in place, or grade the FBO texture into the window.
+            /* The fetch pass reads the pixel written by the scene draw of the same render pass: on a tile
+             * based GPU the scene is never stored to memory and sampled back. */
+            glBindFramebuffer(GL_FRAMEBUFFER, demoDefaultFramebuffer(&demo));
+            glViewport(0, 0, display_w, display_h);
+            if (target != NULL) {
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, target->texture);
+            }
+            glUseProgram(gradeProgram);
+            glUniform2f(gradeViewSizeLoc, (float)display_w, (float)display_h);
+            glBindVertexArray(gradeVao);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindVertexArray(0);
             glUseProgram(0);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        } else {
+            // FBO.Sampling.X. Switch to FBO 0.
+            glBindFramebuffer(GL_FRAMEBUFFER, demoDefaultFramebuffer(&demo));
+            glViewport(0, 0, display_w, display_h);
+            {
+                // FBO.X. Connect the "texture" to the texture unit 1.
+                /* Using the texture unit 1 by desgin here for example purposes. */
+                /* The sampler object replaces the filter of the texture while it is bound to the unit. */
+                glActiveTexture(GL_TEXTURE0 + 1);
+                glBindTexture(GL_TEXTURE_2D, target->texture);
+                glBindSampler(1, getCachedSampler(samplerDesc));
+                glActiveTexture(GL_TEXTURE0);
+
+                // X. Clear the color image.
+                glClearColor(0.0, 1.0, 0.0, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT);
+
+                // X. Use the shader program to draw.
+                glUseProgram(shader_program);
+
+                glUniform1i(uniformUseTexture, 1);
+                // x. Set the sampler's "value" to the texture unit 1.
+                glUniform1i(imageSamplerLoc, 0 + 1);
+                glUniform3f(uniformColorLoc, 0.0, 0.0, 0.0);
+
+                // X. Draw the triangles.
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+                // The post-processing passes sample with the filter of their targets.
+                glBindSampler(1, 0);
+                glUseProgram(0);
+            }
+        }
+
+        // FBO.3. The texture can be reused by the next frame (or freed after a resize).
+        if (target != NULL) {
+            releaseRenderTarget(&targetPool, target);
         }
+        renderTargetPoolEndFrame(&targetPool);
 
         // X. Swap the fron-back buffers to display the rendered image in the window.
-        glfwSwapBuffers(window);
+        demoSwapBuffers(&demo);
+
+        // X. Report the frame time once every second.
+        statsFrames++;
+        double statsElapsed = demoGetTime(&demo) - statsStartTime;
+        if (statsElapsed >= 1.0) {
+            const char* mode = forceFinish ? "glFinish" : "implicit ordering";
+            if (grade != GRADE_OFF) {
+                mode = grade == GRADE_FETCH ? "grade fetch" : "grade sample";
+            }
+            printf("%s: %.3f ms/frame\n", mode, statsElapsed * 1000.0 / statsFrames);
+            statsStartTime = demoGetTime(&demo);
+            statsFrames = 0;
+        }
+    }
+
+    // XX. Destroy the grade pass.
+    if (grade != GRADE_OFF) {
+        glDeleteVertexArrays(1, &gradeVao);
+        glDeleteProgram(gradeProgram);
+    }
+
+    // XX. Destroy the post-processing chain and the render targets.
+    if (post) {
+        destroyPostChain(&postChain);
+    }
+    printRenderTargetPoolStats(&targetPool);
+    destroyRenderTargetPool(&targetPool);
+    destroySamplerCache();
+
+    // XX. Destroy the readback objects.
+    if (readback) {
+        if (readbackFence != NULL) {
+            glDeleteSync(readbackFence);
+        }
+        glDeleteBuffers(1, &readbackPBO);
     }
 
-    // XX. Destroy the window.
-    glfwDestroyWindow(window);
-    // XX. Destroy the GLFW.
-    glfwTerminate();
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
 
     return 0;
 }
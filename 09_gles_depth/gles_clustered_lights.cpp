@@ -0,0 +1,466 @@
+/**
+ * Clustered forward lighting example: a field of cubes lit by a thousand point lights.
+ *
+ * Compile with shaderc:
+ * $ g++ gles_clustered_lights.cpp -o gles_clustered_lights -lglfw -lGLESv2
+ *
+ * Run:
+ * $ ./gles_clustered_lights
+ *
+ * Every frame:
+ *  1. Depth prepass into the depth texture of an FBO (empty fragment shader).
+ *  2. A compute pass bins the lights into 32x32 pixel tiles and 24 depth
+ *     slices, only the slices which have geometry in the depth texture get
+ *     lights (see common/clustered_lights.h).
+ *  3. The color pass (GL_EQUAL depth test) shades each fragment with the
+ *     lights of its cluster only, then the image is blitted to the window.
+ *
+ * Light count and radius ("--lights N", "--light-radius R"):
+ * $ ./gles_clustered_lights --lights 4096 --light-radius 3 --gpu-timer
+ *
+ * Reference without the binning: every fragment loops over every light (the
+ * cost grows with the total light count instead of the local light density):
+ * $ ./gles_clustered_lights --lights 4096 --no-clusters --gpu-timer
+ *
+ * Show the light count of the clusters as a heatmap (blue: none, red: 32+):
+ * $ ./gles_clustered_lights --show-clusters
+ *
+ * Dependencies:
+ *  * C++11
+ *  * GLFW 3.0+
+ *  * GLM
+ *  * Open GL ES 3.1+
+ *  * EGL
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <GLES3/gl31.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "common/program_cache.h"
+#include "common/clustered_lights.h"
+#include "common/demo_context.h"
+#include "common/gpu_timer.h"
+#include "common/mesh.h"
+#include "common/uniform_ring.h"
+
+// Every object is an instance of the unit cube: center and half extent per instance.
+const char* scene_vertex_src = R"(#version 310 es
+precision highp float;
+
+layout(location = 0) in vec3 aPos;
+layout(location = 4) in vec3 aCenter;
+layout(location = 5) in vec3 aExtent;
+
+out vec3 vWorldPos;
+out float vViewDepth;
+out vec3 vColor;
+
+// The depth prepass and the color pass must produce exactly the same depth values.
+invariant gl_Position;
+
+layout(std140) uniform FrameConstants {
+    mat4 projection;
+    mat4 view;
+};
+
+void main() {
+    vec4 worldPos = vec4(aPos * 2.0 * aExtent + aCenter, 1.0);
+    vec4 viewPos = view * worldPos;
+    gl_Position = projection * viewPos;
+
+    vWorldPos = worldPos.xyz;
+    vViewDepth = -viewPos.z;
+    vColor = aExtent.x > 4.0 ? vec3(0.8) : 0.5 + 0.4 * fract(sin(aCenter.xzx * vec3(12.9898, 78.233, 37.719)) * 43758.5453);
+}
+)";
+
+const char* scene_fragment_src = R"(#version 310 es
+precision highp float;
+
+in vec3 vWorldPos;
+in float vViewDepth;
+in vec3 vColor;
+
+out vec4 outColor;
+)";
+
+const char* scene_fragment_main_src = R"(
+void main() {
+    // Flat shading: the face normal from the derivatives of the position (towards the viewer).
+    vec3 normal = normalize(cross(dFdx(vWorldPos), dFdy(vWorldPos)));
+
+#ifdef SHOW_CLUSTERS
+    float heat = min(float(clusterLightCount(vViewDepth)) / 32.0, 1.0);
+    outColor = vec4(clamp(vec3(heat * 2.0 - 1.0, 1.0 - abs(heat * 2.0 - 1.0), 1.0 - heat * 2.0), 0.0, 1.0), 1.0);
+#else
+    vec3 color = vColor * 0.03 + clusteredLighting(vWorldPos, normal, vColor, vViewDepth);
+    outColor = vec4(color, 1.0);
+#endif
+}
+)";
+
+// Depth prepass: only the depth is written, there is nothing to shade.
+const char* depth_fragment_src = R"(#version 310 es
+precision mediump float;
+
+void main() {
+}
+)";
+
+// Scene instances: xyz center, xyz half extent.
+#define INSTANCE_FLOATS 6
+
+// Small deterministic random numbers in [0, 1) for the scene.
+static float randomFloat(unsigned int* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return (*state >> 8) / 16777216.0f;
+}
+
+// The depth texture (for the binning) and the color image of the render passes.
+struct SceneTarget {
+    unsigned int fbo;
+    unsigned int depthTexture;
+    unsigned int colorRB;
+    int width;
+    int height;
+};
+
+static bool createSceneTarget(SceneTarget* target, int width, int height) {
+    target->width = width;
+    target->height = height;
+
+    // The depth texture is read with texelFetch by the binning kernel.
+    glGenTextures(1, &target->depthTexture);
+    glBindTexture(GL_TEXTURE_2D, target->depthTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &target->colorRB);
+    glBindRenderbuffer(GL_RENDERBUFFER, target->colorRB);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &target->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, target->depthTexture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target->colorRB);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("Scene FBO is incomplete (0x%x)\n", status);
+        return false;
+    }
+    return true;
+}
+
+static void destroySceneTarget(SceneTarget* target) {
+    glDeleteFramebuffers(1, &target->fbo);
+    glDeleteTextures(1, &target->depthTexture);
+    glDeleteRenderbuffers(1, &target->colorRB);
+}
+
+int main(int argc, char **argv) {
+    int lightCount = 1024;
+    float lightRadius = 4.0f;
+    bool noClusters = false;
+    bool showClusters = false;
+    int cubeCount = 400;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--lights") == 0 && idx + 1 < argc) {
+            lightCount = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--light-radius") == 0 && idx + 1 < argc) {
+            lightRadius = (float)atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--no-clusters") == 0) {
+            noClusters = true;
+        } else if (strcmp(argv[idx], "--show-clusters") == 0) {
+            showClusters = true;
+        } else if (strcmp(argv[idx], "--cubes") == 0 && idx + 1 < argc) {
+            cubeCount = atoi(argv[++idx]);
+        }
+    }
+
+    if (lightCount < 1 || lightCount > 65536 || lightRadius <= 0.0f || cubeCount < 1) {
+        printf("Invalid --lights (1 - 65536), --light-radius or --cubes value\n");
+        return -1;
+    }
+    if (noClusters && showClusters) {
+        printf("--show-clusters needs the binning, it can't be used with --no-clusters\n");
+        return -1;
+    }
+
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    /* See the "01_gles_glfw" example for the GLFW steps. This also handles the
+     * "--headless" and "--frames N" command line options. */
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
+
+    // 5-9. Build the scene and the depth prepass programs (the lighting functions are part of the scene shader).
+    /* See common/program_cache.h: the binaries are cached between the runs. */
+    unsigned int scene_program;
+    unsigned int depth_program;
+    {
+        std::string fragmentSrc = std::string(scene_fragment_src) + clusteredLightingSrc + scene_fragment_main_src;
+        if (noClusters) {
+            fragmentSrc.insert(fragmentSrc.find('\n') + 1, "#define CLUSTERED_LIGHTS_ALL\n");
+        }
+        if (showClusters) {
+            fragmentSrc.insert(fragmentSrc.find('\n') + 1, "#define SHOW_CLUSTERS\n");
+        }
+        scene_program = createCachedProgram(scene_vertex_src, fragmentSrc.c_str());
+        depth_program = createCachedProgram(scene_vertex_src, depth_fragment_src);
+        if (scene_program == 0 || depth_program == 0) {
+            return -3;
+        }
+    }
+
+    // V.1. The unit cube and the instances: the floor and a grid of cubes of different heights on it.
+    MeshBuffers cube = uploadMesh(createCubeMesh(), false, 0, -1);
+    std::vector<float> instances;
+    float floorSize;
+    {
+        int side = (int)ceilf(sqrtf((float)cubeCount));
+        float spacing = 3.0f;
+        floorSize = side * spacing * 0.5f + 10.0f;
+
+        float floorInstance[INSTANCE_FLOATS] = { 0.0f, -0.5f, 0.0f, floorSize, 0.5f, floorSize };
+        instances.insert(instances.end(), floorInstance, floorInstance + INSTANCE_FLOATS);
+
+        for (int idx = 0; idx < cubeCount; idx++) {
+            float x = (idx % side - (side - 1) * 0.5f) * spacing;
+            float z = (idx / side - (side - 1) * 0.5f) * spacing;
+            float halfHeight = 0.5f + (float)((idx * 7919) % 13) * 0.15f;
+
+            float cubeInstance[INSTANCE_FLOATS] = { x, halfHeight, z, 0.6f, halfHeight, 0.6f };
+            instances.insert(instances.end(), cubeInstance, cubeInstance + INSTANCE_FLOATS);
+        }
+    }
+    int instanceCount = (int)instances.size() / INSTANCE_FLOATS;
+
+    unsigned int instanceBuffer;
+    {
+        glGenBuffers(1, &instanceBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(float), instances.data(), GL_STATIC_DRAW);
+
+        glBindVertexArray(cube.vao);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, INSTANCE_FLOATS * sizeof(float), NULL);
+        glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, INSTANCE_FLOATS * sizeof(float), (const void*)(3 * sizeof(float)));
+        glVertexAttribDivisor(4, 1);
+        glVertexAttribDivisor(5, 1);
+        glEnableVertexAttribArray(4);
+        glEnableVertexAttribArray(5);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // L.1. The lights: random positions above the floor, each one circles around its position.
+    std::vector<PointLight> lights(lightCount);
+    std::vector<float> lightOrbits(lightCount * 3); // radius, speed, phase
+    {
+        unsigned int seed = 1234;
+        for (int idx = 0; idx < lightCount; idx++) {
+            PointLight& light = lights[idx];
+            light.position[0] = (randomFloat(&seed) * 2.0f - 1.0f) * floorSize;
+            light.position[1] = 0.3f + randomFloat(&seed) * 2.5f;
+            light.position[2] = (randomFloat(&seed) * 2.0f - 1.0f) * floorSize;
+            light.radius = lightRadius * (0.75f + randomFloat(&seed) * 0.5f);
+
+            // Saturated colors: one channel is dropped.
+            int drop = idx % 3;
+            for (int channel = 0; channel < 3; channel++) {
+                light.color[channel] = channel == drop ? 0.1f : 0.3f + randomFloat(&seed) * 0.7f;
+            }
+            light.color[3] = 1.0f;
+
+            lightOrbits[idx * 3 + 0] = 0.5f + randomFloat(&seed) * 2.0f;
+            lightOrbits[idx * 3 + 1] = 0.2f + randomFloat(&seed);
+            lightOrbits[idx * 3 + 2] = randomFloat(&seed) * 6.2831853f;
+        }
+    }
+    std::vector<PointLight> frameLights = lights;
+
+    // L.2. The cluster lists and the binning kernel for the size of the framebuffer.
+    int display_w, display_h;
+    demoGetFramebufferSize(&demo, &display_w, &display_h);
+
+    ClusteredLights clusters;
+    SceneTarget target;
+    if (!initClusteredLights(&clusters, display_w, display_h, lightCount) || !createSceneTarget(&target, display_w, display_h)) {
+        destroyDemoContext(&demo);
+        return -1;
+    }
+    printf("Clustered lights: %d lights, %dx%d tiles x %d slices%s\n", lightCount, clusters.tilesX, clusters.tilesY,
+           CLUSTER_SLICES, noClusters ? " (not used: every light is shaded)" : "");
+
+    // 11. Connect the uniform blocks of the programs and create the uniform buffer ring.
+    /* See common/uniform_ring.h: the frame constants are written into one mapped buffer range per frame. */
+    UniformRing uniformRing;
+    {
+        bindConstantBlocks(scene_program);
+        bindConstantBlocks(depth_program);
+        initUniformRing(&uniformRing, 4 * 1024);
+    }
+
+    GpuTimer gpuTimer;
+    initGpuTimer(&gpuTimer, argc, argv);
+
+    const float nearPlane = 0.5f;
+    const float farPlane = 150.0f;
+    double statsStartTime = demoGetTime(&demo);
+
+    // X. Create a render loop.
+    while (!demoShouldClose(&demo))
+    {
+        // X. Poll and handle events (inputs, window resize, etc.)
+        demoPollEvents(&demo);
+        gpuTimerBeginFrame(&gpuTimer);
+
+        // XX. Follow the size of the window: the scene target and the cluster grid.
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
+        if (display_w != target.width || display_h != target.height) {
+            destroySceneTarget(&target);
+            createSceneTarget(&target, display_w, display_h);
+            clusteredLightsResize(&clusters, display_w, display_h);
+        }
+
+        // XX. The camera circles the scene, the lights circle around their positions.
+        float time = (float)demoAnimationTime(&demo);
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)display_w / (float)display_h,
+                                                nearPlane, farPlane);
+        glm::vec3 eye = glm::vec3(cosf(time * 0.1f) * 30.0f, 10.0f, sinf(time * 0.1f) * 30.0f);
+        glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+        for (int idx = 0; idx < lightCount; idx++) {
+            float angle = time * lightOrbits[idx * 3 + 1] + lightOrbits[idx * 3 + 2];
+            frameLights[idx].position[0] = lights[idx].position[0] + cosf(angle) * lightOrbits[idx * 3 + 0];
+            frameLights[idx].position[2] = lights[idx].position[2] + sinf(angle) * lightOrbits[idx * 3 + 0];
+        }
+        clusteredLightsUpload(&clusters, frameLights.data(), lightCount);
+
+        int frameOffset;
+        {
+            FrameConstants frameConstants;
+            memcpy(frameConstants.projection, glm::value_ptr(projection), sizeof(frameConstants.projection));
+            memcpy(frameConstants.view, glm::value_ptr(view), sizeof(frameConstants.view));
+
+            uniformRingBeginFrame(&uniformRing);
+            frameOffset = uniformRingWrite(&uniformRing, &frameConstants, sizeof(frameConstants));
+            uniformRingEndFrame(&uniformRing);
+        }
+        uniformRingBind(&uniformRing, FRAME_CONSTANTS_BINDING, frameOffset, sizeof(FrameConstants));
+
+        glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+        glViewport(0, 0, display_w, display_h);
+        glEnable(GL_DEPTH_TEST);
+        glBindVertexArray(cube.vao);
+
+        // P.1. Depth prepass.
+        {
+            GpuTimerScope timerScope(&gpuTimer, "prepass");
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            glDepthMask(GL_TRUE);
+            glDepthFunc(GL_LESS);
+            glClear(GL_DEPTH_BUFFER_BIT);
+
+            glUseProgram(depth_program);
+            glDrawElementsInstanced(GL_TRIANGLES, cube.indexCount, cube.indexType, NULL, instanceCount);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        }
+
+        // L.3. Bin the lights into the clusters which have geometry in the depth texture.
+        if (!noClusters) {
+            GpuTimerScope timerScope(&gpuTimer, "binning");
+            clusteredLightsBin(&clusters, target.depthTexture, glm::value_ptr(view), glm::value_ptr(projection),
+                               nearPlane, farPlane);
+        }
+
+        // P.2. Color pass: only the visible fragments are shaded, each with the lights of its cluster.
+        {
+            GpuTimerScope timerScope(&gpuTimer, "shading");
+            glClearColor(0.02f, 0.02f, 0.04f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glDepthMask(GL_FALSE);
+            glDepthFunc(GL_EQUAL);
+
+            glUseProgram(scene_program);
+            clusteredLightsBind(&clusters, scene_program);
+            glDrawElementsInstanced(GL_TRIANGLES, cube.indexCount, cube.indexType, NULL, instanceCount);
+
+            glDepthMask(GL_TRUE);
+            glDepthFunc(GL_LESS);
+        }
+        glBindVertexArray(0);
+
+        // P.3. Copy the image into the window.
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, target.fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, demoDefaultFramebuffer(&demo));
+        glBlitFramebuffer(0, 0, display_w, display_h, 0, 0, display_w, display_h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, demoDefaultFramebuffer(&demo));
+        gpuTimerEndFrame(&gpuTimer);
+
+        // L.4. Report the light density of the clusters every second (the read back waits for the GPU).
+        if (!noClusters && demoGetTime(&demo) - statsStartTime >= 1.0) {
+            int nonEmpty, maximum, overflow;
+            float average;
+            clusteredLightsStats(&clusters, &nonEmpty, &average, &maximum, &overflow);
+            printf("Clusters: %d with lights, %.1f lights on average, at most %d (%d over the limit of %d)\n",
+                   nonEmpty, average, maximum, overflow, CLUSTER_MAX_LIGHTS);
+            statsStartTime = demoGetTime(&demo);
+        }
+
+        // X. Swap the fron-back buffers to display the rendered image in the window.
+        demoSwapBuffers(&demo);
+    }
+
+    // XX. Destroy the clusters, the scene target and the buffers.
+    destroyClusteredLights(&clusters);
+    destroySceneTarget(&target);
+    glDeleteBuffers(1, &instanceBuffer);
+    destroyMeshBuffers(&cube);
+    destroyUniformRing(&uniformRing);
+    destroyGpuTimer(&gpuTimer);
+    glDeleteProgram(scene_program);
+    glDeleteProgram(depth_program);
+
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
+
+    return 0;
+}
@@ -7,11 +7,110 @@
  * Run:
  * $ ./gles_depth_cube
  *
+ * Use the packed (half float) cube vertices:
+ * $ ./gles_depth_cube --packed-vertices
+ *
+ * Overdraw test: draw 32 cubes behind each other (back to front) with a depth prepass:
+ * $ ./gles_depth_cube --overdraw 32 --depth-prepass --gpu-timer
+ *
+ * Draw the cubes through a render queue (see common/render_queue.h) sorted by their quantized
+ * view depth ("submission", "front-to-back" or "back-to-front") with the early depth test, and count
+ * the shaded fragments. "--sort-benchmark" draws every order in turn and compares them at exit:
+ * $ ./gles_depth_cube --overdraw 32 --sort front-to-back --count-fragments
+ * $ ./gles_depth_cube --overdraw 32 --sort-benchmark
+ *
+ * Draw the wireframe of the cubes too (a second pass of the same geometry with GL_LINES):
+ * $ ./gles_depth_cube --wireframe
+ *
+ * Keep every attachment in the memory (no glInvalidateFramebuffer calls):
+ * $ ./gles_depth_cube --no-invalidate
+ *
+ * Issue every clear, also the ones which are overwritten before use (see common/render_pass.h):
+ * $ ./gles_depth_cube --keep-clears
+ *
+ * Only redraw and present the changed parts of the window: the screen bounds of the rotating
+ * cube (this and the previous frame), the depth image and the GPU timer overlay
+ * (see common/swap_damage.h, needs EGL_EXT_buffer_age or EGL_KHR_partial_update):
+ * $ ./gles_depth_cube --partial-redraw
+ *
+ * Select the sized formats of the color renderbuffer and the depth texture
+ * (see common/render_formats.h, "--list-formats" prints the supported ones). The default color
+ * format is RGB565, or the faster one of the calibration with "--device-profile":
+ * $ ./gles_depth_cube --color-format RGBA8 --depth-format DEPTH_COMPONENT16
+ *
+ * Render a few frames with every supported color/depth format pair and print the frame
+ * times and estimated attachment bandwidth:
+ * $ ./gles_depth_cube --format-matrix
+ *
+ * Draw a field of 4096 small cubes behind the rotating cube, occlusion culled on the GPU
+ * against a hierarchical depth buffer built from the rotating cube (see common/hiz_culling.h,
+ * "--no-cull" draws every cube of the field):
+ * $ ./gles_depth_cube --cube-field 4096 --gpu-timer
+ *
+ * Frustum cull the cube field on the CPU instead, four bounding boxes at a time with SSE2/NEON
+ * (see common/frustum_culling.h, "--cpu-cull-scalar" tests one box at a time):
+ * $ ./gles_depth_cube --cube-field 100000 --cpu-cull
+ *
+ * The field and the camera are static (see common/camera.h): the CPU culling, the level selection
+ * and the upload only run again when the camera version changes (ex.: on a window resize).
+ *
+ * Draw the field with spheres of 8 levels of detail, each visible sphere selects its level from
+ * its projected size after the CPU culling (see common/mesh_lod.h, "--lod-error PX" is the allowed
+ * error on the screen, default: 1 pixel). The levels are taken from the asset bundle if given:
+ * $ ./gles_depth_cube --cube-field 100000 --cpu-cull --field-lod --bundle demo_assets.bundle
+ *
+ * Build the shader programs in parallel on 4 worker threads with shared EGL contexts
+ * (see common/gl_workers.h, an empty GLES_PROGRAM_CACHE_DIR forces the compilation):
+ * $ GLES_PROGRAM_CACHE_DIR= ./gles_depth_cube --gl-workers 4
+ * Without workers the programs are built as one batch (every compile and link is submitted
+ * before the first status query, see createCachedPrograms in common/program_cache.h).
+ *
+ * Select the vertex stream layout of the cube (see common/mesh.h, interleaved, planar or
+ * position-stream), the depth prepass only fetches the positions:
+ * $ ./gles_depth_cube --depth-prepass --vertex-layout position-stream
+ *
+ * Take the baked cube mesh (interleaved, "--packed-vertices" selects the packed one) from the
+ * memory mapped asset bundle (see common/asset_bundle.h):
+ * $ ./gles_depth_cube --bundle demo_assets.bundle
+ *
+ * Vertex fetch benchmark: draw a grid of 512x512 quads depth-only and with its texture coords
+ * in every vertex layout, each draw is a GPU timer pass:
+ * $ ./gles_depth_cube --layout-bench 512 --gpu-timer
+ *
+ * Convert the depth texture to view space distances with a compute stage (and downsample it
+ * 4x4, each value is the closest distance of its block), read it back asynchronously and print
+ * the distance at the center of the view (see common/depth_readback.h):
+ * $ ./gles_depth_cube --depth-readback 4
+ *
+ * Select the checker pattern of the cube faces (see common/checker_pattern.h, "point", "filtered"
+ * or "filtered-mediump"), the filtered one is anti-aliased without multisampling:
+ * $ ./gles_depth_cube --checker filtered
+ *
+ * GPU picking: the draws also write the ID of their object into an R32UI attachment of the
+ * FBO, the region under the cursor is read back asynchronously (see common/pick_buffer.h).
+ * The object under the cursor (headless: a moving point) is printed once per second, a click
+ * prints the answer when it arrives (one or two frames later, the GPU is not waited for):
+ * $ ./gles_depth_cube --cube-field 4096 --pick
+ *
+ * Screen-space ambient occlusion from the depth texture of the cube pass (the depth prepass output
+ * with "--depth-prepass", no extra geometry pass): a half resolution compute pass with shared
+ * memory depth tiles and a bilateral upsample, added to a render graph every frame (see
+ * common/ssao.h). The blitted color is multiplied with the occlusion ("--ssao-view" shows the
+ * occlusion itself). The sample count ("--ssao-samples N", default: 16, the maximum) adapts to
+ * the GPU time budget of the AO pass ("--ssao-budget MS", default: 1 ms, 0: fixed count):
+ * $ ./gles_depth_cube --cube-field 4096 --ssao --gpu-timer
+ *
+ * The default path writes gl_FragDepth in the fragment shader which disables the
+ * early depth test on most GPUs: every layer of the overdraw is shaded. The depth
+ * prepass mode first renders only the depth (color writes masked, empty fragment
+ * shader) then shades the cubes with the GL_EQUAL depth test and without the
+ * gl_FragDepth write, so only the visible fragments are shaded.
+ *
  * Dependencies:
  *  * C++11
  *  * GLFW 3.0+
  *  * GLM
- *  * Open GL ES 3.0+
+ *  * Open GL ES 3.0+ (3.1+ for "--cube-field")
  *  * EGL
  *
  * MIT License
@@ -35,7 +134,14 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  * OFTWARE.
  */
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
 
 #include <GLFW/glfw3.h>
 #include <GLES3/gl32.h>
@@ -44,21 +150,73 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "common/program_cache.h"
+#include "common/asset_bundle.h"
+#include "common/camera.h"
+#include "common/checker_pattern.h"
+#include "common/demo_context.h"
+#include "common/depth_readback.h"
+#include "common/device_profile.h"
+#include "common/gl_debug.h"
+#include "common/frustum_culling.h"
+#include "common/gl_workers.h"
+#include "common/gpu_timer.h"
+#include "common/hiz_culling.h"
+#include "common/input_queue.h"
+#include "common/mesh.h"
+#include "common/mesh_lod.h"
+#include "common/pick_buffer.h"
+#include "common/render_formats.h"
+#include "common/render_graph.h"
+#include "common/render_pass.h"
+#include "common/render_queue.h"
+#include "common/render_target_pool.h"
+#include "common/ssao.h"
+#include "common/static_mesh.h"
+#include "common/startup_profile.h"
+#include "common/trace.h"
+#include "common/uniform_ring.h"
+
 const char* cube_vertex_src = R"(#version 310 es
 precision highp float;
 
-in vec3 aPos;
+layout(location = 0) in vec3 aPos;
 out vec2 checkerCoord;
+#ifdef PICK_BUFFER
+// Object ID of the pick buffer ("--pick"), the rotating cubes are 1 (0: background).
+flat out uint vPickId;
+#endif
+
+// The depth prepass and the color pass must produce exactly the same depth values.
+invariant gl_Position;
+
+layout(std140) uniform FrameConstants {
+    mat4 projection;
+    mat4 view;
+};
+
+layout(std140) uniform ObjectConstants {
+    mat4 model;
+    vec4 color;
+};
 
-uniform mat4 projection;
-uniform mat4 model;
-uniform mat4 view;
+#ifdef SORTED_CUBES
+// "--sort": the render queue draws the cubes instanced, xyz: translation, w: scale (the model is the rotation).
+layout(location = 4) in vec4 aInstance;
+#endif
 
 void main() {
+#ifdef SORTED_CUBES
+    gl_Position = projection * view * vec4((model * vec4(aPos, 1.0)).xyz * aInstance.w + aInstance.xyz, 1.0);
+#else
     gl_Position = projection * view * model * vec4(aPos, 1.0);
+#endif
 
     // Move the position coordinate into the [0, 1] range.
     checkerCoord = (vec4(aPos, 1.0).xy + vec2(1.0f)) / vec2(2.0);
+#ifdef PICK_BUFFER
+    vPickId = 1u;
+#endif
 }
 )";
 
@@ -67,25 +225,121 @@ precision highp float;
 
 in vec2 checkerCoord;
 
-out vec4 outColor;
-
-uniform vec3 uColor;
-
-float checker(vec2 uv, float repeats)
-{
-  float cx = floor(repeats * uv.x);
-  float cy = floor(repeats * uv.y);
-  float result = mod(cx + cy, 2.0);
-  return sign(result);
-}
+layout(location = 0) out vec4 outColor;
+#ifdef PICK_BUFFER
+precision highp int;
+flat in uint vPickId;
+layout(location = 1) out uint outId;
+#endif
+#ifdef COUNT_FRAGMENTS
+// "--count-fragments": the depth test runs before the shader, only the shaded fragments are counted.
+layout(early_fragment_tests) in;
+layout(std430, binding = 0) buffer FragmentCount {
+    uint shadedFragments;
+};
+#endif
+
+layout(std140) uniform ObjectConstants {
+    mat4 model;
+    vec4 color;
+};
+
+// The checker functions are inserted after the precision statement (see common/checker_pattern.h).
 
 void main() {
     vec2 uv = checkerCoord.xy;
+#ifdef CHECKER_FILTERED
+    float checkerColor = mix(0.8f, 0.6f, checkerFiltered(uv, 10.0f));
+#else
     float checkerColor = mix(0.8f, 0.6f, checker(uv, 10.0f));
+#endif
 
-    outColor = vec4(uColor, 1.0f);
+    outColor = vec4(color.rgb, 1.0f);
     outColor.rgb *= checkerColor;
+#ifdef PICK_BUFFER
+    outId = vPickId;
+#endif
+#ifdef COUNT_FRAGMENTS
+    atomicAdd(shadedFragments, 1u);
+#endif
+#ifndef DEPTH_PREPASS
     gl_FragDepth = gl_FragCoord.z;
+#endif
+}
+)";
+
+// Cube field: one instance per visible cube (xyz: center, w: size), drawn with the fragment shader of the cube.
+const char* field_vertex_src = R"(#version 310 es
+precision highp float;
+
+layout(location = 0) in vec3 aPos;
+layout(location = 4) in vec4 aInstance;
+out vec2 checkerCoord;
+#ifdef PICK_BUFFER
+// The field is a grid of PICK_FIELD_SIDE^3 cubes (see H.1): the ID is found from the center of the
+// instance, the culling which compacts the instances doesn't change it. 2: the first cube of the field.
+flat out uint vPickId;
+#endif
+
+layout(std140) uniform FrameConstants {
+    mat4 projection;
+    mat4 view;
+};
+
+void main() {
+    gl_Position = projection * view * vec4(aPos * aInstance.w + aInstance.xyz, 1.0);
+
+    checkerCoord = (vec4(aPos, 1.0).xy + vec2(1.0f)) / vec2(2.0);
+#ifdef PICK_BUFFER
+    float side = float(PICK_FIELD_SIDE);
+    uvec3 cell = uvec3(round(vec3(aInstance.xy * side / 8.0 + (side - 1.0) * 0.5, (-3.0 - aInstance.z) * side / 16.0)));
+    vPickId = cell.x + (cell.y + cell.z * PICK_FIELD_SIDE) * PICK_FIELD_SIDE + 2u;
+#endif
+}
+)";
+
+// Layout benchmark grid: moved into the top right corner, the small triangles make the draws vertex bound.
+const char* layout_vertex_src = R"(#version 310 es
+precision highp float;
+
+layout(location = 0) in vec3 aPos;
+#ifndef DEPTH_ONLY
+layout(location = 1) in vec2 aTex;
+out vec2 vTex;
+#endif
+
+void main() {
+    gl_Position = vec4(aPos.xy * 0.5 + vec2(0.7), aPos.z, 1.0);
+#ifndef DEPTH_ONLY
+    vTex = aTex;
+#endif
+}
+)";
+
+const char* layout_fragment_src = R"(#version 310 es
+precision mediump float;
+
+in vec2 vTex;
+
+out vec4 outColor;
+
+void main() {
+    outColor = vec4(vTex, 0.5f, 1.0f);
+}
+)";
+
+// GPU timer pass names of the layout benchmark: depth-only and color draw of each MeshLayout.
+static const char* layoutBenchPasses[][2] = {
+    { "depth interleaved", "color interleaved" },
+    { "depth planar", "color planar" },
+    { "depth position-stream", "color position-stream" },
+};
+
+// Depth prepass: only the depth is written, there is nothing to shade.
+const char* cube_depth_fragment_src = R"(#version 310 es
+precision mediump float;
+
+void main() {
 }
 )";
 
@@ -117,210 +371,492 @@ void main() {
     outColor = vec4(texture(inputImage, vTex).rrr, 1.0f);
 })";
 
-static void on_gl_error(GLenum source, GLenum type, GLuint id, GLenum severity,
-                          GLsizei length, const GLchar* message, const void *userParam) {
-
-    printf("-> %s\n", message);
-}
-
-static void ErrorCallbackGLFW(int error, const char* description) {
-    printf("Glfw Error %d: %s\n", error, description);
+// A program built by a GL worker (or on the render thread without workers).
+struct ProgramBuild {
+    const char* vertexSrc;
+    std::string fragmentSrc;
+    unsigned int* program;
+    GLTask task;
+};
+
+static void buildProgram(void* data) {
+    ProgramBuild* build = (ProgramBuild*)data;
+    *build->program = createCachedProgram(build->vertexSrc, build->fragmentSrc.c_str());
 }
 
-static unsigned int createShaderProgram(const char* vertex_src, const char* fragment_src) {
-    // X.1. Create the vertex shader.
-    unsigned int vertex_shader;
-    {
-        // X.1.1. Create a vertex shader object.
-        vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+// Draw order of the cubes with "--sort" (render queue keys), the submission order is the one without a queue.
+enum CubeOrder {
+    CUBE_ORDER_SUBMISSION,
+    CUBE_ORDER_FRONT_TO_BACK,
+    CUBE_ORDER_BACK_TO_FRONT,
+    CUBE_ORDER_COUNT,
+};
 
-        // X.1.2. Specify the shader source.
-        glShaderSource(vertex_shader, 1, &vertex_src, NULL);
+static const char* cubeOrderNames[CUBE_ORDER_COUNT] = { "submission", "front-to-back", "back-to-front" };
 
-        // X.1.3. Compile the shader.
-        glCompileShader(vertex_shader);
+// Frames drawn in each order by "--sort-benchmark" before it switches to the next one.
+#define SORT_BENCHMARK_FRAMES 16
 
-        // X.1.4. Check if there is any error during compilation.
-        int success;
-        glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            char info[512];
-            glGetShaderInfoLog(vertex_shader, 512, NULL, info);
-            printf("Vertex shader error:\n%s\n", info);
-            exit(-3);
-        }
-    }
-
-    // X.2. Create the fragment shader.
-    unsigned int fragment_shader;
-    {
-        // X.2.1. Create a fragment shader object.
-        fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-
-        // X.2.2. Specify the shader source.
-        glShaderSource(fragment_shader, 1, &fragment_src, NULL);
-
-        // X.2.3. Compile the shader.
-        glCompileShader(fragment_shader);
-
-        // X.2.4. Check if there is any error during compilation.
-        int success;
-        glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            char info[512];
-            glGetShaderInfoLog(fragment_shader, 512, NULL, info);
-            printf("Fragment shader error:\n%s\n", info);
-            exit(-3);
-        }
+// Draw every cube of the scene with its constants in the uniform ring.
+static void drawCubes(const MeshBuffers& cube, UniformRing* ring, const std::vector<int>& objectOffsets, GLenum mode) {
+    for (size_t idx = 0; idx < objectOffsets.size(); idx++) {
+        uniformRingBind(ring, OBJECT_CONSTANTS_BINDING, objectOffsets[idx], sizeof(ObjectConstants));
+        glDrawElements(mode, cube.indexCount, cube.indexType, NULL);
     }
+}
 
-    // X.3. Create a shader program and attach the vertex/fragment shaders.
-    unsigned int shader_program;
-    {
-        shader_program = glCreateProgram();
-        glAttachShader(shader_program, vertex_shader);
-        glAttachShader(shader_program, fragment_shader);
-        glLinkProgram(shader_program);
-
-        int success;
-        glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
-        if(!success) {
-            char info[512];
-            glGetProgramInfoLog(shader_program, 512, NULL, info);
-            printf("Program error:\n%s\n", info);
-            exit(-3);
+// Extend the window space bounds (x0, y0, x1, y1) with the projected corners of the cube (see createCubeMesh).
+/* Returns false if a corner is behind the camera: the bounds can't be used. */
+static bool addCubeScreenBounds(const glm::mat4& modelViewProjection, int width, int height, int bounds[4]) {
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec4 pos = modelViewProjection * glm::vec4((corner & 1) ? 0.5f : -0.5f, (corner & 2) ? 0.5f : -0.5f,
+                                                        (corner & 4) ? 0.5f : -0.5f, 1.0f);
+        if (pos.w <= 0.0f) {
+            return false;
         }
-    }
 
-    // X.4. The vertex and fragment shaders can be removed after linking.
-    {
-        glDeleteShader(vertex_shader);
-        glDeleteShader(fragment_shader);
+        int x = (int)((pos.x / pos.w * 0.5f + 0.5f) * width);
+        int y = (int)((pos.y / pos.w * 0.5f + 0.5f) * height);
+        bounds[0] = std::min(bounds[0], x);
+        bounds[1] = std::min(bounds[1], y);
+        bounds[2] = std::max(bounds[2], x);
+        bounds[3] = std::max(bounds[3], y);
     }
-
-    return shader_program;
+    return true;
 }
 
 int main(int argc, char **argv) {
-    // 0. Add a method to report any GLFW errors.
-    glfwSetErrorCallback(ErrorCallbackGLFW);
+    bool packedVertices = false;
+    bool depthPrepass = false;
+    bool invalidate = true;
+    bool skipRedundantClears = true;
+    bool partialRedraw = false;
+    int overdraw = 1;
+    const char* colorFormatName = NULL; // NULL: the device profile or RGB565
+    const char* depthFormatName = "DEPTH_COMPONENT32F";
+    bool listFormats = false;
+    bool formatMatrix = false;
+    int cubeField = 0;
+    bool cull = true;
+    bool cpuCull = false;
+    bool cpuCullScalar = false;
+    bool fieldLod = false;
+    float lodErrorPixels = 1.0f;
+    int glWorkerCount = 0;
+    MeshLayout vertexLayout = MESH_LAYOUT_INTERLEAVED;
+    int layoutBench = 0;
+    const char* bundlePath = NULL;
+    int depthReadbackFactor = 0;
+    CheckerMode checkerMode = CHECKER_POINT;
+    int pickRegion = 0;
+    bool ssao = false;
+    bool ssaoView = false;
+    int ssaoSamples = 16;
+    double ssaoBudgetMs = 1.0;
+    bool drawWireframe = false;
+    bool sortCubes = false;
+    CubeOrder cubeOrder = CUBE_ORDER_SUBMISSION;
+    bool countFragments = false;
+    bool sortBenchmark = false;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--packed-vertices") == 0) {
+            packedVertices = true;
+        } else if (strcmp(argv[idx], "--no-invalidate") == 0) {
+            invalidate = false;
+        } else if (strcmp(argv[idx], "--keep-clears") == 0) {
+            skipRedundantClears = false;
+        } else if (strcmp(argv[idx], "--partial-redraw") == 0) {
+            partialRedraw = true;
+        } else if (strcmp(argv[idx], "--depth-prepass") == 0) {
+            depthPrepass = true;
+        } else if (strcmp(argv[idx], "--wireframe") == 0) {
+            drawWireframe = true;
+        } else if (strcmp(argv[idx], "--sort") == 0 && idx + 1 < argc) {
+            const char* name = argv[++idx];
+            int order = 0;
+            while (order < CUBE_ORDER_COUNT && strcmp(name, cubeOrderNames[order]) != 0) {
+                order++;
+            }
+            if (order == CUBE_ORDER_COUNT) {
+                printf("Invalid draw order '%s' (valid: submission, front-to-back, back-to-front)\n", name);
+                return -1;
+            }
+            sortCubes = true;
+            cubeOrder = (CubeOrder)order;
+        } else if (strcmp(argv[idx], "--count-fragments") == 0) {
+            countFragments = true;
+        } else if (strcmp(argv[idx], "--sort-benchmark") == 0) {
+            sortCubes = true;
+            countFragments = true;
+            sortBenchmark = true;
+        } else if (strcmp(argv[idx], "--overdraw") == 0 && idx + 1 < argc) {
+            overdraw = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--color-format") == 0 && idx + 1 < argc) {
+            colorFormatName = argv[++idx];
+        } else if (strcmp(argv[idx], "--depth-format") == 0 && idx + 1 < argc) {
+            depthFormatName = argv[++idx];
+        } else if (strcmp(argv[idx], "--list-formats") == 0) {
+            listFormats = true;
+        } else if (strcmp(argv[idx], "--format-matrix") == 0) {
+            formatMatrix = true;
+        } else if (strcmp(argv[idx], "--cube-field") == 0 && idx + 1 < argc) {
+            cubeField = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--no-cull") == 0) {
+            cull = false;
+        } else if (strcmp(argv[idx], "--cpu-cull") == 0) {
+            cull = false;
+            cpuCull = true;
+        } else if (strcmp(argv[idx], "--gl-workers") == 0 && idx + 1 < argc) {
+            glWorkerCount = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--vertex-layout") == 0 && idx + 1 < argc) {
+            if (!parseMeshLayout(argv[++idx], &vertexLayout)) {
+                printf("Unknown vertex layout: %s (interleaved, planar, position-stream)\n", argv[idx]);
+                return -1;
+            }
+        } else if (strcmp(argv[idx], "--bundle") == 0 && idx + 1 < argc) {
+            bundlePath = argv[++idx];
+        } else if (strcmp(argv[idx], "--layout-bench") == 0 && idx + 1 < argc) {
+            layoutBench = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--cpu-cull-scalar") == 0) {
+            cull = false;
+            cpuCull = true;
+            cpuCullScalar = true;
+        } else if (strcmp(argv[idx], "--field-lod") == 0) {
+            fieldLod = true;
+        } else if (strcmp(argv[idx], "--lod-error") == 0 && idx + 1 < argc) {
+            lodErrorPixels = atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--depth-readback") == 0 && idx + 1 < argc) {
+            depthReadbackFactor = atoi(argv[++idx]);
+            if (depthReadbackFactor < 1 || depthReadbackFactor > 16) {
+                printf("Invalid depth read back downsample factor (valid range: 1-16)\n");
+                return -1;
+            }
+        } else if (strcmp(argv[idx], "--checker") == 0 && idx + 1 < argc) {
+            if (!parseCheckerMode(argv[++idx], &checkerMode)) {
+                return -1;
+            }
+        } else if (strcmp(argv[idx], "--pick") == 0) {
+            pickRegion = pickRegion > 0 ? pickRegion : 9;
+        } else if (strcmp(argv[idx], "--ssao") == 0) {
+            ssao = true;
+        } else if (strcmp(argv[idx], "--ssao-view") == 0) {
+            ssao = true;
+            ssaoView = true;
+        } else if (strcmp(argv[idx], "--ssao-samples") == 0 && idx + 1 < argc) {
+            ssaoSamples = atoi(argv[++idx]);
+            if (ssaoSamples < SSAO_MIN_SAMPLES || ssaoSamples > SSAO_MAX_SAMPLES) {
+                printf("Invalid SSAO sample count (valid range: %d-%d)\n", SSAO_MIN_SAMPLES, SSAO_MAX_SAMPLES);
+                return -1;
+            }
+        } else if (strcmp(argv[idx], "--ssao-budget") == 0 && idx + 1 < argc) {
+            ssaoBudgetMs = atof(argv[++idx]);
+            if (ssaoBudgetMs < 0.0) {
+                printf("Invalid SSAO budget (must not be negative)\n");
+                return -1;
+            }
+        } else if (strcmp(argv[idx], "--pick-region") == 0 && idx + 1 < argc) {
+            pickRegion = atoi(argv[++idx]);
+            if (pickRegion < 1 || pickRegion > PICK_BUFFER_MAX_REGION) {
+                printf("Invalid pick region (valid range: 1-%d pixels)\n", PICK_BUFFER_MAX_REGION);
+                return -1;
+            }
+        }
+    }
 
-    // 1. Initialize the GLFW library.
-    if (!glfwInit()) {
+    if (overdraw < 1 || overdraw > 256) {
+        printf("Invalid overdraw count (valid range: 1-256)\n");
         return -1;
     }
 
-    // 2. Add hints to use during context creation when a GLFW window is created.
-    // Here: require a GL ES 3.0 context.
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
-    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+    if (cubeField < 0 || cubeField > 1024 * 1024) {
+        printf("Invalid cube field size (valid range: 1-1048576)\n");
+        return -1;
+    }
+    if (layoutBench < 0 || layoutBench > 2048) {
+        printf("Invalid layout benchmark grid size (valid range: 1-2048)\n");
+        return -1;
+    }
 
-    // 3. Create window with graphics context
-    GLFWwindow* window = glfwCreateWindow(1024, 600, "GLDEMO", NULL, NULL);
-    if (window == NULL) {
-        return -2;
+    if (cubeField > 0 && depthPrepass) {
+        printf("The cube field can't be combined with the depth prepass\n");
+        return -1;
+    }
+    /* With the prepass only the visible fragments are shaded in any order. */
+    if (sortCubes && depthPrepass) {
+        printf("The sorted draws can't be combined with the depth prepass\n");
+        return -1;
+    }
+    if (countFragments && !sortCubes) {
+        printf("The fragment count needs the sorted draws (--sort ORDER or --sort-benchmark)\n");
+        return -1;
+    }
+    if (fieldLod && (cubeField == 0 || !cpuCull)) {
+        printf("The field LOD needs the cube field and the CPU culling (--cube-field N --cpu-cull)\n");
+        return -1;
+    }
+    if (lodErrorPixels <= 0.0f) {
+        printf("Invalid LOD error (must be positive)\n");
+        return -1;
+    }
+    /* The benchmark draws don't write the object IDs. */
+    if (pickRegion > 0 && (layoutBench > 0 || formatMatrix)) {
+        printf("The picking can't be combined with the layout or the format benchmark\n");
+        return -1;
+    }
+    if (partialRedraw && (cubeField > 0 || layoutBench > 0 || formatMatrix)) {
+        printf("The partial redraw can't be combined with the cube field, the layout or the format benchmark\n");
+        return -1;
     }
 
-    // 4. Activate the window (display it).
-    glfwMakeContextCurrent(window);
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    /* See the "01_gles_glfw" example for the GLFW steps. This also handles the
+     * "--headless" and "--frames N" command line options. */
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
 
-    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-    glDebugMessageCallback(on_gl_error, NULL);
+    enableGLDebugOutput(true);
 
     // 5. Set the view port to match the window size.
     int display_w, display_h;
     {
-        glfwGetFramebufferSize(window, &display_w, &display_h);
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
         glViewport(0, 0, display_w, display_h);
     }
 
-    // 6. Create the shader program for the Cube rendering.
-    unsigned int cube_program = createShaderProgram(cube_vertex_src, cube_fragment_src);
-    unsigned int texture_program = createShaderProgram(texture_display_vertex_src, texture_display_fragment_src);
-
-    // V.1. Create a Vertex Buffer object for vertices data
-    const float vertices[] = {
-        // Cube coordinates. texture coords are not used for now.
-        // stride will be: (3 + 2) * sizeof(float)
-        // positions          // texture coords
-        -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
-         0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
-         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
-
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-         0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-         0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f, 1.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-
-        -0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-        -0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-        -0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-
-         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-         0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-         0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-         0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-         0.5f, -0.5f, -0.5f,  1.0f, 1.0f,
-         0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-         0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-
-        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
-         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f, 0.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f
-    };
+    startupPhase("shaders");
+    // 6. Create the shader programs, in parallel with "--gl-workers N".
+    /* See common/gl_workers.h: the programs are built on worker threads with shared contexts
+     * (or in one batch without workers, see createCachedPrograms). They are loaded from the
+     * program cache if they were built in a previous run. */
+    GLWorkers glWorkers;
+    int startedWorkers = initGLWorkers(&glWorkers, glWorkerCount);
+    if (startedWorkers < glWorkerCount) {
+        printf("GL workers: only %d of %d shared contexts could be created\n", startedWorkers, glWorkerCount);
+    }
+
+    unsigned int cube_program = 0;
+    unsigned int cube_depth_program = 0;
+    unsigned int cube_color_program = 0;
+    unsigned int cube_sorted_program = 0;
+    unsigned int field_program = 0;
+    unsigned int texture_program = 0;
+    unsigned int layout_depth_program = 0;
+    unsigned int layout_color_program = 0;
+
+    /* Outlives the builds: the workers read the vertex source. */
+    std::string layoutDepthSrc;
+    std::string cubeVertexSrc = cube_vertex_src;
+    std::string sortedVertexSrc;
+    std::string fieldVertexSrc = field_vertex_src;
+
+    // The side of the cube field grid (see H.1), the picking finds the cube of the field from it.
+    int fieldSide = 1;
+    while (fieldSide * fieldSide * fieldSide < cubeField) {
+        fieldSide++;
+    }
 
-    unsigned int cube_vbo;
+    double programStartTime = demoGetTime(&demo);
+    std::vector<ProgramBuild> programBuilds;
     {
-        // V.1.1. Generate the buffer object.
-        glGenBuffers(1, &cube_vbo);
+        /* The workers reference the builds: no reallocation after the submit. */
+        programBuilds.reserve(8);
+
+        // 6.1. The color program without gl_FragDepth (depth prepass and cube field).
+        std::string cubeSrc = checkerShaderSource(cube_fragment_src, checkerMode);
+        if (pickRegion > 0) {
+            // 6.1.1. "--pick": the color programs also write the object IDs.
+            std::string pickDefines = "#define PICK_BUFFER\n#define PICK_FIELD_SIDE " + std::to_string(fieldSide) + "u\n";
+            cubeSrc.insert(cubeSrc.find('\n') + 1, pickDefines);
+            cubeVertexSrc.insert(cubeVertexSrc.find('\n') + 1, pickDefines);
+            fieldVertexSrc.insert(fieldVertexSrc.find('\n') + 1, pickDefines);
+        }
+        std::string colorSrc = cubeSrc;
+        colorSrc.insert(colorSrc.find('\n') + 1, "#define DEPTH_PREPASS\n");
 
-        // V.1.2. Bind the VBO to the "GL_ARRAY_BUFFER".
-        glBindBuffer(GL_ARRAY_BUFFER, cube_vbo);
+        programBuilds.push_back({ cubeVertexSrc.c_str(), cubeSrc, &cube_program });
+        programBuilds.push_back({ texture_display_vertex_src, texture_display_fragment_src, &texture_program });
 
-        // V.1.3. "Upload" the data for the active "GL_ARRAY_BUFFER".
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+        // 6.2. The programs of the depth prepass mode: depth only and color without gl_FragDepth.
+        if (depthPrepass) {
+            programBuilds.push_back({ cubeVertexSrc.c_str(), cube_depth_fragment_src, &cube_depth_program });
+            programBuilds.push_back({ cubeVertexSrc.c_str(), colorSrc, &cube_color_program });
+        }
 
-        // V.1.4. Unbind the "GL_ARRAY_BUFFER".
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        // 6.2.1. "--sort": instanced cubes without gl_FragDepth (the early depth test rejects the hidden ones).
+        if (sortCubes) {
+            sortedVertexSrc = cubeVertexSrc;
+            sortedVertexSrc.insert(sortedVertexSrc.find('\n') + 1, "#define SORTED_CUBES\n");
+            std::string sortedSrc = colorSrc;
+            if (countFragments) {
+                sortedSrc.insert(sortedSrc.find('\n') + 1, "#define COUNT_FRAGMENTS\n");
+            }
+            programBuilds.push_back({ sortedVertexSrc.c_str(), sortedSrc, &cube_sorted_program });
+        }
+
+        // 6.3. The cube field program: instanced, without gl_FragDepth (the field is not the occluder).
+        if (cubeField > 0) {
+            programBuilds.push_back({ fieldVertexSrc.c_str(), colorSrc, &field_program });
+        }
+
+        // 6.4. The layout benchmark programs, the depth-only one doesn't read the texture coords.
+        if (layoutBench > 0) {
+            std::string depthOnlySrc = layout_vertex_src;
+            depthOnlySrc.insert(depthOnlySrc.find('\n') + 1, "#define DEPTH_ONLY\n");
+            layoutDepthSrc = depthOnlySrc;
+
+            programBuilds.push_back({ layoutDepthSrc.c_str(), cube_depth_fragment_src, &layout_depth_program });
+            programBuilds.push_back({ layout_vertex_src, layout_fragment_src, &layout_color_program });
+        }
+
+        // 6.5. GL workers: one program per task. Otherwise one batch on the render thread: every compile
+        //      and link is submitted before the first status query (the driver can build them concurrently).
+        if (startedWorkers > 0) {
+            for (size_t idx = 0; idx < programBuilds.size(); idx++) {
+                glWorkersSubmit(&glWorkers, &programBuilds[idx].task, buildProgram, &programBuilds[idx]);
+            }
+            for (size_t idx = 0; idx < programBuilds.size(); idx++) {
+                glTaskWait(&glWorkers, &programBuilds[idx].task);
+            }
+        } else {
+            std::vector<CachedProgramDesc> descs;
+            for (size_t idx = 0; idx < programBuilds.size(); idx++) {
+                descs.push_back({ programBuilds[idx].vertexSrc, programBuilds[idx].fragmentSrc.c_str(), NULL, programBuilds[idx].program });
+            }
+            createCachedPrograms(descs.data(), (int)descs.size());
+        }
+    }
+    if (startedWorkers > 0) {
+        printf("Programs: %d built in %.3f ms (%d GL workers)\n", (int)programBuilds.size(),
+               (demoGetTime(&demo) - programStartTime) * 1000.0, startedWorkers);
+    } else {
+        printf("Programs: %d built in %.3f ms (one batch, %s)\n", (int)programBuilds.size(),
+               (demoGetTime(&demo) - programStartTime) * 1000.0,
+               programCacheParallelCompile() ? "KHR_parallel_shader_compile" : "no parallel compile extension");
     }
 
-    // V.1.2. Specify the Vertex Array Object for the Cube
-    /* VAO is used to describe how the VBOs are accessed (layout/format). */
-    unsigned int cube_vao;
+    startupPhase("meshes");
+    // V.1. Create the indexed cube mesh: VAO with the vertex (VBO) and index (IBO) buffers.
+    /* See common/mesh.h: the duplicated vertices are merged and the triangles are
+     * reordered for the vertex cache. "--packed-vertices" selects half float
+     * positions (12 byte vertices instead of 20), "--vertex-layout" the stream layout. */
+    MeshBuffers cube;
     {
-        int aPosLoc = glGetAttribLocation(cube_program, "aPos");
+        int positionLoc = glGetAttribLocation(cube_program, "aPos");
+
+        // V.1.1. "--bundle FILE": the mesh is already baked, the buffers are filled from the mapped file.
+        bool fromBundle = false;
+        AssetBundle bundle;
+        if (bundlePath != NULL && openAssetBundle(&bundle, bundlePath)) {
+            fromBundle = uploadBundleMesh(&bundle, packedVertices ? "cube_packed" : "cube", positionLoc, -1, &cube);
+            closeAssetBundle(&bundle);
+        }
+
+        if (!fromBundle) {
+            MeshData cubeMesh = createCubeMesh();
+            cube = uploadMeshLayout(cubeMesh, packedVertices, vertexLayout, positionLoc, -1);
+        }
+    }
+
+    // L.1. Layout benchmark: the same grid mesh uploaded in every vertex layout.
+    MeshBuffers layoutMeshes[3];
+    if (layoutBench > 0) {
+        MeshData grid = createGridMesh(layoutBench, layoutBench);
+        printf("Layout bench: %d vertices, %d triangles, ACMR: %.3f\n", (int)grid.positions.size() / 3,
+               (int)grid.indices.size() / 3, meshACMR(grid, 32));
+
+        for (int idx = 0; idx < 3; idx++) {
+            layoutMeshes[idx] = uploadMeshLayout(grid, packedVertices, (MeshLayout)idx, 0, 1);
+            printf("  %-16s %8.2f MiB\n", meshLayoutName((MeshLayout)idx),
+                   layoutMeshes[idx].vertexBufferSize / (1024.0 * 1024.0));
+        }
+    }
 
-        glGenVertexArrays(1, &cube_vao);
+    startupPhase("cube field");
+    // H.1. Create the cube field: a grid of small cubes behind the rotating cube.
+    /* See common/hiz_culling.h: the instances are culled on the GPU into a compacted buffer
+     * which is connected to the cube VAO as a per-instance attribute (location 4). */
+    HiZCuller culler;
+    CullingBounds fieldBounds;
+    std::vector<float> fieldInstances;
+    std::vector<int> fieldVisible;
+    unsigned int cpuVisibleBuffer = 0;
+    MeshBuffers* fieldMesh = &cube;
+    MeshBuffers lodSphere;
+    MeshLodChain fieldLods;
+    std::vector<uint8_t> fieldLevels;
+    if (fieldLod) {
+        // H.1.0. "--field-lod": the sphere and its levels from the bundle or simplified here (as the asset_bundle tool does).
+        int positionLoc = glGetAttribLocation(field_program, "aPos");
+        double lodStart = demoGetTime(&demo);
+        bool fromBundle = false;
+        AssetBundle bundle;
+        if (bundlePath != NULL && openAssetBundle(&bundle, bundlePath)) {
+            fromBundle = bundleMeshLods(&bundle, "sphere_lod", &fieldLods)
+                      && uploadBundleMesh(&bundle, "sphere_lod", positionLoc, -1, &lodSphere);
+            closeAssetBundle(&bundle);
+        }
 
-        glBindVertexArray(cube_vao);
+        if (!fromBundle) {
+            MeshData sphere = weldMeshPositions(staticMeshData(staticSphere<StaticVertex, 64, 32>()));
+            fieldLods = buildMeshLods(&sphere, MESH_LOD_MAX_LEVELS, 0.5f);
+            lodSphere = uploadMesh(sphere, false, positionLoc, -1);
+        }
+        fieldMesh = &lodSphere;
+        fieldLevels.resize(cubeField);
 
-        glBindBuffer(GL_ARRAY_BUFFER, cube_vbo);
+        printf("Field LOD: %u levels (%s, %.3f ms):", fieldLods.levelCount, fromBundle ? "bundle" : "simplified",
+               (demoGetTime(&demo) - lodStart) * 1000.0);
+        for (uint32_t idx = 0; idx < fieldLods.levelCount; idx++) {
+            printf(" %u", fieldLods.levels[idx].indexCount / 3);
+        }
+        printf(" triangles\n");
+    }
+    if (cubeField > 0) {
+        int side = fieldSide;
+        std::vector<float> instances(cubeField * 4);
+        for (int idx = 0; idx < cubeField; idx++) {
+            int x = idx % side;
+            int y = (idx / side) % side;
+            int z = idx / (side * side);
+
+            instances[idx * 4 + 0] = (x - (side - 1) * 0.5f) * 8.0f / side;
+            instances[idx * 4 + 1] = (y - (side - 1) * 0.5f) * 8.0f / side;
+            instances[idx * 4 + 2] = -3.0f - z * 16.0f / side;
+            instances[idx * 4 + 3] = 4.0f / side;
+        }
 
-        glVertexAttribPointer(aPosLoc, 3, GL_FLOAT, GL_FALSE, (3 + 2) * sizeof(float), NULL);
+        initHiZCuller(&culler, instances.data(), cubeField, fieldMesh->indexCount);
 
-        // 10.3. Enable the usage of the vertex input array.
-        glEnableVertexAttribArray(aPosLoc);
+        // H.1.1. CPU culling: the bounds of the cubes and the buffer of the visible instances (written every frame).
+        unsigned int instanceBuffer = cull ? culler.visibleBuffer : culler.instanceBuffer;
+        if (cpuCull) {
+            for (int idx = 0; idx < cubeField; idx++) {
+                float halfSize = instances[idx * 4 + 3] * 0.5f;
+                float halfExtent[3] = { halfSize, halfSize, halfSize };
+                addCullingBounds(&fieldBounds, &instances[idx * 4], halfExtent);
+            }
+            fieldInstances = instances;
+            fieldVisible.resize(cubeField);
+
+            glGenBuffers(1, &cpuVisibleBuffer);
+            glBindBuffer(GL_ARRAY_BUFFER, cpuVisibleBuffer);
+            glBufferData(GL_ARRAY_BUFFER, cubeField * 4 * sizeof(float), NULL, GL_STREAM_DRAW);
+            instanceBuffer = cpuVisibleBuffer;
+        }
 
+        glBindVertexArray(fieldMesh->vao);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), NULL);
+        glVertexAttribDivisor(4, 1);
+        glEnableVertexAttribArray(4);
         glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        printf("Cube field: %d cubes, occlusion culling: %s, CPU frustum culling: %s\n", cubeField, cull ? "on" : "off",
+               cpuCull ? (cpuCullScalar ? "scalar" : frustumCullImplementation()) : "off");
     }
 
 
@@ -359,164 +895,782 @@ int main(int argc, char **argv) {
         glBindVertexArray(0);
     }
 
-    // D.1. Create a depth only texture for FBO.
-    unsigned int fboDepthTexture;
-    {
-        // D.1.1. Generate a texture.
-        glGenTextures(1, &fboDepthTexture);
-
-        // D.1.2. Bind the texture as a 2D image.
-        glBindTexture(GL_TEXTURE_2D, fboDepthTexture);
+    startupPhase("render targets");
+    // D.1. Create the pool of the FBO attachments.
+    /* See common/render_target_pool.h: the depth texture and the color renderbuffer are acquired
+     * every frame with the current window size and attached to the FBO when they change. */
+    RenderTargetPool targetPool;
+    initRenderTargetPool(&targetPool);
 
-        // D.1.3. Initialize the bound 2D image as a DEPTH image.
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, display_w, display_h, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-
-        // D.1.4. Configure the bound 2D image's sampler information.
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // D.2. The depth texture (sampled by the depth quad) and the color RenderBuffer (this could be a texture also).
+    if (colorFormatName == NULL) {
+        colorFormatName = deviceProfile() != NULL ? deviceProfile()->colorFormat.c_str() : "RGB565";
+    }
+    const RenderFormat* colorFormat = findRenderFormat(colorFormatName);
+    const RenderFormat* depthFormat = findRenderFormat(depthFormatName);
+    {
+        if (listFormats) {
+            printRenderFormats();
+        }
 
-        // D.1.5. Unbind the 2D image.
-        glBindTexture(GL_TEXTURE_2D, 0);
+        if (colorFormat == NULL || colorFormat->depth || !renderFormatSupported(colorFormat, RENDER_TARGET_RENDERBUFFER)) {
+            printf("Color format '%s' is not supported as a renderbuffer (see --list-formats)\n", colorFormatName);
+            return -1;
+        }
+        if (depthFormat == NULL || !depthFormat->depth || !renderFormatSupported(depthFormat, RENDER_TARGET_TEXTURE)) {
+            printf("Depth format '%s' is not supported as a texture (see --list-formats)\n", depthFormatName);
+            return -1;
+        }
     }
+    RenderTargetKey depthKey = { RENDER_TARGET_TEXTURE, depthFormat->format, display_w, display_h, 0 };
+    RenderTargetKey colorKey = { RENDER_TARGET_RENDERBUFFER, colorFormat->format, display_w, display_h, 0 };
+
+    // D.2.1. The format pairs of the "--format-matrix" benchmark.
+    struct FormatMatrixEntry {
+        const RenderFormat* color;
+        const RenderFormat* depth;
+        double ms;
+    };
+    std::vector<FormatMatrixEntry> matrix;
+    const int matrixWarmupFrames = 10;
+    const int matrixFrames = 60;
+    int matrixFrame = 0;
+    double matrixStartTime = 0.0;
+    if (formatMatrix) {
+        int count;
+        const RenderFormat* formats = renderFormats(&count);
+        for (int colorIdx = 0; colorIdx < count; colorIdx++) {
+            for (int depthIdx = 0; depthIdx < count; depthIdx++) {
+                if (formats[colorIdx].depth || !formats[depthIdx].depth
+                    || !renderFormatSupported(&formats[colorIdx], RENDER_TARGET_RENDERBUFFER)
+                    || !renderFormatSupported(&formats[depthIdx], RENDER_TARGET_TEXTURE)) {
+                    continue;
+                }
+                FormatMatrixEntry entry = { &formats[colorIdx], &formats[depthIdx], 0.0 };
+                matrix.push_back(entry);
+            }
+        }
 
-    // D.2. Create a RenderBuffer for the color image (this could be a texture also).
-    unsigned int colorRB;
-    {
-        glGenRenderbuffers(1, &colorRB);
-        glBindRenderbuffer(GL_RENDERBUFFER, colorRB);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGB565, display_w, display_h);
-        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        /* The benchmark stops after the last format pair. */
+        demo.frameLimit = 0;
     }
 
-    // D.3. Create a depth only FBO using the depth texture.
+    // D.3. Create the FBO for the depth texture and the color image.
+    /* The attachments are connected in the render loop (D.4). */
     unsigned int fboDepth;
     {
         // D.3.1. Generate an FBO.
         glGenFramebuffers(1, &fboDepth);
 
-        // D.3.2. Bind this newly generated FBO.
-        glBindFramebuffer(GL_FRAMEBUFFER, fboDepth);
-
-        // D.3.4. Bind the depth texture for the current FBO.
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, fboDepthTexture, 0);
-
-        // D.3.5. Attach the render buffer as a color attachment. (See next comment)
-        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRB);
-
         /* If the color output is not needed just disable the color attachments:
         // D.3.x. Disable all color attachments:
         GLenum disableColor = GL_NONE;
         glDrawBuffers(1, &disableColor);
         glReadBuffer(disableColor);
         */
-
-        // D.3.x. Check the FBO status.
-        GLenum fboResult = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-        if (fboResult != GL_FRAMEBUFFER_COMPLETE) {
-            printf("ERROR::FRAMEBUFFER:: Framebuffer is not complete! (0x%x)\n", fboResult);
-            return -1;
+    }
+    const RenderTarget* attachedDepth = NULL;
+    const RenderTarget* attachedColor = NULL;
+
+    startupPhase("uniforms and passes");
+    // 11. Connect the uniform blocks of the Cube programs and create the uniform buffer ring.
+    /* See common/uniform_ring.h: the constants are written into one mapped buffer range per frame.
+     * Each cube has a fill and a wireframe constant block, with at most 256 bytes of alignment each. */
+    UniformRing uniformRing;
+    {
+        bindConstantBlocks(cube_program);
+        if (depthPrepass) {
+            bindConstantBlocks(cube_depth_program);
+            bindConstantBlocks(cube_color_program);
         }
-
-        // D.3.6. Unbind the framebuffer.
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (sortCubes) {
+            bindConstantBlocks(cube_sorted_program);
+        }
+        if (cubeField > 0) {
+            bindConstantBlocks(field_program);
+        }
+        initUniformRing(&uniformRing, 64 * 1024 + overdraw * 2 * 256);
     }
 
-    // 11. Query the uniform location for the Cube
-    int uniformColorLoc = glGetUniformLocation(cube_program, "uColor");
-    int modelLoc = glGetUniformLocation(cube_program, "model");
-    int viewLoc  = glGetUniformLocation(cube_program, "view");
-
-    int projectionLoc = glGetUniformLocation(cube_program, "projection");
+    // The camera: the projection follows the window size, the view is static (see common/camera.h).
+    /* "projection" and "viewProjection" are its matrices for the glm code, copied when it changes. */
+    FrameConstants frameConstants;
+    Camera camera;
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::mat4 viewProjection = glm::mat4(1.0f);
     {
-        glm::mat4 projection = glm::mat4(1.0f);
-        projection = glm::perspective(glm::radians(45.0f), (float)display_w / (float)display_h, 0.1f, 100.0f);
-        glUseProgram(cube_program);
-
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, &projection[0][0]);
+        initCamera(&camera, glm::radians(45.0f), 0.1f, 100.0f);
 
-        glUseProgram(0);
+        TransformComponent viewTransform;
+        initTransform(&viewTransform);
+        transformSetTranslation(&viewTransform, 0.0f, 0.0f, -1.5f);
+        updateTransform(&viewTransform);
+        cameraSetView(&camera, viewTransform.matrix);
     }
 
     // D.X. Query uniforms for the texture rendering and configure them.
     {
-        // D.X.1. Activate the 5th texture unit.
-        glActiveTexture(GL_TEXTURE0 + 5);
-        // D.X.2. Connect the fboDepthTexture to the currently active texture unit.
-        glBindTexture(GL_TEXTURE_2D, fboDepthTexture);
-        // D.X.3. Switch off rom the current active texture unit.
-        glActiveTexture(0);
-
         // D.X.4. Switch to the texture quad drawer program.
         glUseProgram(texture_program);
 
         int uniformTextureSampler = glGetUniformLocation(texture_program, "inputImage");
-        // D.X.5. Configure the "inputImage" sampler to use the 5th texture unit.
+        // D.X.5. Configure the "inputImage" sampler to use the 5th texture unit (see D.4.3).
         glUniform1i(uniformTextureSampler, 5);
 
         // D.X.6. Disable the current program.
         glUseProgram(0);
     }
 
+    // R.1. Describe the render passes of a frame.
+    /* See common/render_pass.h. The cube pass clears both attachments and stores them: the color
+     * image is blitted and the depth texture is displayed. The output pass overwrites the whole
+     * window with the blit and doesn't need its depth buffer after the depth quad. The passes
+     * track their clears: the color clear of the depth quad region is overwritten by the quad. */
+    RenderPass cubePass = createRenderPass("cube", fboDepth, display_w, display_h);
+    {
+        cubePass.color = { RENDER_PASS_CLEAR, RENDER_PASS_STORE, colorFormat->bytesPerPixel };
+        cubePass.depth = { RENDER_PASS_CLEAR, RENDER_PASS_STORE, depthFormat->bytesPerPixel };
+        cubePass.clearColor[0] = 0.0f;
+        cubePass.clearColor[1] = 0.3f;
+        cubePass.clearColor[2] = 0.3f;
+        cubePass.invalidate = invalidate;
+        cubePass.skipRedundantClears = skipRedundantClears;
+    }
+
+    RenderPass outputPass = createRenderPass("output", demoDefaultFramebuffer(&demo), display_w, display_h);
+    {
+        /* The partial redraw keeps the rest of the window from the previous frames. */
+        outputPass.color = { partialRedraw ? RENDER_PASS_LOAD : RENDER_PASS_DONT_CARE, RENDER_PASS_STORE, 4 };
+        outputPass.depth = { RENDER_PASS_DONT_CARE, RENDER_PASS_DISCARD, 4 };
+        outputPass.invalidate = invalidate;
+        outputPass.skipRedundantClears = skipRedundantClears;
+    }
+
+    {
+        const RenderPass* passes[] = { &cubePass, &outputPass };
+        printRenderPassReport(passes, 2);
+    }
+
     glEnable(GL_DEPTH_TEST);
     // D.X.3. Enable scissor to draw only onto the specific region.
     glEnable(GL_SCISSOR_TEST);
 
+    // T.1. Create the GPU timer for the per-pass timing ("--gpu-timer" options).
+    GpuTimer gpuTimer;
+    initGpuTimer(&gpuTimer, argc, argv);
+
+    if (overdraw > 1) {
+        printf("Overdraw: %d cubes, depth prepass: %s\n", overdraw, depthPrepass ? "on" : "off");
+    }
+
+    // O.1. "--sort": the render queue orders the cubes by their view depth (quantized in the sort key).
+    /* The instance attribute (location 4) is the translation and scale of a cube, see SORTED_CUBES. */
+    RenderQueue cubeQueue;
+    std::vector<float> cubeInstances;
+    std::vector<float> cubeDepths;
+    int sortedOffset = 0;
+    if (sortCubes) {
+        initRenderQueue(&cubeQueue, 4, overdraw * 16);
+        cubeInstances.resize(overdraw * 4);
+        cubeDepths.resize(overdraw);
+        printf("Cube draw order: %s\n", sortBenchmark ? "benchmark" : cubeOrderNames[cubeOrder]);
+    }
+
+    // O.2. "--count-fragments": an atomic counter of the shaded fragments, read back after the cubes.
+    unsigned int fragmentCountBuffer = 0;
+    double countedFragments[CUBE_ORDER_COUNT] = {};
+    int countedFrames[CUBE_ORDER_COUNT] = {};
+    double lastCountPrint = demoGetTime(&demo);
+    if (countFragments) {
+        int fragmentBlocks = 0;
+        glGetIntegerv(GL_MAX_FRAGMENT_SHADER_STORAGE_BLOCKS, &fragmentBlocks);
+        if (fragmentBlocks < 1) {
+            printf("The fragment count needs a storage buffer in the fragment shader (none supported)\n");
+            return -1;
+        }
+        glGenBuffers(1, &fragmentCountBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, fragmentCountBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(uint32_t), NULL, GL_DYNAMIC_READ);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+    int sortFrame = 0;
+
+    std::vector<int> fillOffsets(overdraw);
+    std::vector<int> wireframeOffsets(overdraw);
+    int fieldOffset = 0;
+    int fieldVisibleCount = cubeField;
+    double cpuCullSeconds = 0.0;
+    int cpuCullFrames = 0;
+    int cpuCullSkips = 0;
+    uint32_t cullCameraVersion = 0;
+    int cullHeight = 0;
+    int lodCounts[MESH_LOD_MAX_LEVELS] = {};
+    double lastFieldPrint = demoGetTime(&demo);
+
+    // L.1. Depth linearization stage ("--depth-readback N").
+    DepthReadback depthReadback;
+    double lastDepthPrint = demoGetTime(&demo);
+    if (depthReadbackFactor > 0) {
+        initDepthReadback(&depthReadback, depthReadbackFactor);
+    }
+
+    // K.1. GPU picking ("--pick"): the ID buffer is attached with the other targets (D.4.2).
+    /* No cursor in headless mode: a moving point is picked instead. */
+    PickBuffer pick;
+    bool pickCursor = false;
+    double cursorX = 0.0;
+    double cursorY = 0.0;
+    int clickFrame = -1; // the click which waits for its answer
+    double lastPickPrint = demoGetTime(&demo);
+    if (pickRegion > 0) {
+        initPickBuffer(&pick, pickRegion);
+    }
+
+    // S.1. SSAO ("--ssao"): its passes are rebuilt in the graph every frame, the textures come from the target pool.
+    SsaoStage ssaoStage;
+    RenderGraph graph;
+    bool graphPrinted = false;
+    if (ssao) {
+        initSsaoStage(&ssaoStage, &gpuTimer, ssaoSamples, ssaoBudgetMs);
+        initRenderGraph(&graph, &targetPool);
+    }
+
+    // Window space bounds (x0, y0, x1, y1) of the rotating cubes for the partial redraw.
+    int cubeBounds[4];
+    int lastCubeBounds[4] = { 0, 0, display_w, display_h };
+    bool cubeBoundsValid = false;
+
     static float color = 0;
     // X. Create a render loop.
-    while (!glfwWindowShouldClose(window))
+    while (!demoShouldClose(&demo))
     {
         // X. Poll and handle events (inputs, window resize, etc.)
-        glfwPollEvents();
+        demoPollEvents(&demo);
+
+        // K.2. Follow the cursor, a click waits for the answer of its frame.
+        if (pickRegion > 0) {
+            const InputEvent* events;
+            int eventCount = demoInputEvents(&demo, &events);
+            for (int idx = 0; idx < eventCount; idx++) {
+                if (events[idx].type == INPUT_CURSOR) {
+                    pickCursor = true;
+                    cursorX = events[idx].x;
+                    cursorY = events[idx].y;
+                } else if (events[idx].type == INPUT_MOUSE_BUTTON && events[idx].action == GLFW_PRESS) {
+                    clickFrame = demo.frameCount;
+                }
+            }
+        }
 
-        // X. Draw the cube onto the fboDepth.
+        // D.4. Acquire the attachments for the current window size.
         {
-            glBindFramebuffer(GL_FRAMEBUFFER, fboDepth);
-            // X. Configure the render/draw region for the cube.
-            glViewport(0, 0, display_w, display_h);
-            glScissor(0, 0, display_w, display_h);
+            // D.4.0. Benchmark: a new format pair after every matrixFrames frames (the GPU is drained in between).
+            if (formatMatrix) {
+                int entry = matrixFrame / matrixFrames;
+                int entryFrame = matrixFrame % matrixFrames;
+                if (entryFrame == 0 && entry > 0) {
+                    glFinish();
+                    matrix[entry - 1].ms = (demoGetTime(&demo) - matrixStartTime) * 1000.0 / (matrixFrames - matrixWarmupFrames);
+                }
+                if (entry >= (int)matrix.size()) {
+                    break;
+                }
+                if (entryFrame == matrixWarmupFrames) {
+                    glFinish();
+                    matrixStartTime = demoGetTime(&demo);
+                }
+
+                colorKey.format = matrix[entry].color->format;
+                depthKey.format = matrix[entry].depth->format;
+                cubePass.color.bytesPerPixel = matrix[entry].color->bytesPerPixel;
+                cubePass.depth.bytesPerPixel = matrix[entry].depth->bytesPerPixel;
+                matrixFrame++;
+            }
+
+            demoGetFramebufferSize(&demo, &display_w, &display_h);
+            depthKey.width = colorKey.width = display_w;
+            depthKey.height = colorKey.height = display_h;
+
+            RenderTarget* depthTarget = acquireRenderTarget(&targetPool, depthKey);
+            RenderTarget* colorTarget = acquireRenderTarget(&targetPool, colorKey);
+            if (depthTarget == NULL || colorTarget == NULL) {
+                break;
+            }
+
+            // D.4.1. The pool returns the same targets every frame until the window is resized.
+            if (depthTarget != attachedDepth || colorTarget != attachedColor) {
+                // D.4.2. Attach the depth texture and the render buffer to the FBO.
+                glBindFramebuffer(GL_FRAMEBUFFER, fboDepth);
+                attachRenderTarget(depthTarget);
+                attachRenderTarget(colorTarget);
+                if (pickRegion > 0) {
+                    pickBufferAttach(&pick, display_w, display_h);
+                }
+
+                GLenum fboResult = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+                if (fboResult != GL_FRAMEBUFFER_COMPLETE) {
+                    printf("ERROR::FRAMEBUFFER:: Framebuffer is not complete! (0x%x)\n", fboResult);
+                    break;
+                }
+
+                // D.4.3. Connect the depth texture to the 5th texture unit.
+                glActiveTexture(GL_TEXTURE0 + 5);
+                glBindTexture(GL_TEXTURE_2D, depthTarget->texture);
+                glActiveTexture(GL_TEXTURE0);
+
+                // D.4.4. The projection follows the aspect ratio (recomputed by the matrix update).
+                cameraSetViewport(&camera, display_w, display_h);
+
+                attachedDepth = depthTarget;
+                attachedColor = colorTarget;
+            }
 
-            // X. Clear the color image.
-            glClearColor(0.0, 0.3, 0.3, 1.0f);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            cubePass.width = outputPass.width = display_w;
+            cubePass.height = outputPass.height = display_h;
+
+            /* Released right away: nothing else acquires from this pool, so the same
+             * targets are returned next frame (they stay attached to the FBO). */
+            releaseRenderTarget(&targetPool, depthTarget);
+            releaseRenderTarget(&targetPool, colorTarget);
+            renderTargetPoolEndFrame(&targetPool);
+        }
 
-            // X. Use the shader program to draw.
-            glUseProgram(cube_program);
+        // T.2. Collect the GPU times of the previous frames.
+        gpuTimerBeginFrame(&gpuTimer);
+
+        // X. Draw the cubes onto the fboDepth.
+        {
+            // R.2. Bind the fboDepth, configure the render/draw region and clear the images.
+            beginRenderPass(&cubePass);
+
+            // K.3. Draw the object IDs too (the ID buffer is cleared to the background).
+            if (pickRegion > 0) {
+                pickBufferBegin(&pick);
+            }
 
             // V.3. Use the VAO
-            glBindVertexArray(cube_vao);
+            glBindVertexArray(cube.vao);
 
-            // XX. Update the transformation matrix.
+            // XX. Update the transformation matrices and colors: write them all into the uniform ring.
+            /* With "--overdraw N" the cubes are placed behind each other, scaled to cover the same
+             * screen area, and drawn back to front: the worst case for the depth test. */
+            int frameOffset;
             {
-                glm::mat4 model         = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
-                glm::mat4 view          = glm::mat4(1.0f);
+                TraceZone traceZone("matrix update");
+                if (updateCamera(&camera)) {
+                    memcpy(glm::value_ptr(projection), camera.projection, sizeof(camera.projection));
+                    memcpy(glm::value_ptr(viewProjection), camera.viewProjection, sizeof(camera.viewProjection));
+                    memcpy(frameConstants.projection, camera.projection, sizeof(frameConstants.projection));
+                    memcpy(frameConstants.view, camera.view, sizeof(frameConstants.view));
+                }
+
+                uniformRingBeginFrame(&uniformRing);
+                frameOffset = uniformRingWrite(&uniformRing, &frameConstants, sizeof(frameConstants));
+
+                cubeBounds[0] = cubeBounds[1] = display_w + display_h;
+                cubeBounds[2] = cubeBounds[3] = -1;
+                cubeBoundsValid = true;
+
+                for (int idx = 0; idx < overdraw; idx++) {
+                    float distance = (overdraw - 1 - idx) * 0.5f;
+
+                    glm::mat4 model         = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
+                    model = glm::translate(model, glm::vec3(0.0f, 0.0f, -distance));
+                    model = glm::scale(model, glm::vec3((1.5f + distance) / 1.5f));
+                    //model = glm::rotate(model, glm::radians(-55.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+                    model = glm::rotate(model, (float)demoAnimationTime(&demo) * glm::radians(50.0f), glm::vec3(0.5f, 1.0f, 0.0f));
+
+                    if (partialRedraw) {
+                        cubeBoundsValid &= addCubeScreenBounds(viewProjection * model, display_w, display_h, cubeBounds);
+                    }
+
+                    // The filled cube and its wireframe only differ in the color.
+                    ObjectConstants fill = { {}, { 0.1f, 0.8f, 0.9f, 1.0f } };
+                    ObjectConstants wireframe = { {}, { 0.0f, 0.0f, 0.0f, 1.0f } };
+                    memcpy(fill.model, glm::value_ptr(model), sizeof(fill.model));
+                    memcpy(wireframe.model, glm::value_ptr(model), sizeof(wireframe.model));
+
+                    fillOffsets[idx] = uniformRingWrite(&uniformRing, &fill, sizeof(fill));
+                    wireframeOffsets[idx] = uniformRingWrite(&uniformRing, &wireframe, sizeof(wireframe));
+
+                    // O.3. The instance of the sorted draw and its view depth (the distance along -z).
+                    if (sortCubes) {
+                        float* instance = &cubeInstances[idx * 4];
+                        instance[0] = 0.0f;
+                        instance[1] = 0.0f;
+                        instance[2] = -distance;
+                        instance[3] = (1.5f + distance) / 1.5f;
+                        cubeDepths[idx] = -(camera.view[2] * instance[0] + camera.view[6] * instance[1] +
+                                            camera.view[10] * instance[2] + camera.view[14]);
+                    }
+                }
+
+                // O.4. The sorted cubes share one constant block: the rotation and the fill color.
+                if (sortCubes) {
+                    ObjectConstants rotation = { {}, { 0.1f, 0.8f, 0.9f, 1.0f } };
+                    glm::mat4 model = glm::rotate(glm::mat4(1.0f), (float)demoAnimationTime(&demo) * glm::radians(50.0f),
+                                                  glm::vec3(0.5f, 1.0f, 0.0f));
+                    memcpy(rotation.model, glm::value_ptr(model), sizeof(rotation.model));
+                    sortedOffset = uniformRingWrite(&uniformRing, &rotation, sizeof(rotation));
+                }
+
+                if (cubeField > 0) {
+                    ObjectConstants field = { {}, { 0.9f, 0.5f, 0.1f, 1.0f } };
+                    fieldOffset = uniformRingWrite(&uniformRing, &field, sizeof(field));
+                }
+                uniformRingEndFrame(&uniformRing);
+            }
+            uniformRingBind(&uniformRing, FRAME_CONSTANTS_BINDING, frameOffset, sizeof(FrameConstants));
+
+            if (!depthPrepass) {
+                GpuTimerScope timerScope(&gpuTimer, "cube");
+
+                if (sortCubes) {
+                    // O.5. "--sort-benchmark": every order for a few frames, again and again.
+                    if (sortBenchmark) {
+                        cubeOrder = (CubeOrder)(sortFrame / SORT_BENCHMARK_FRAMES % CUBE_ORDER_COUNT);
+                    }
+                    sortFrame++;
+
+                    if (countFragments) {
+                        const uint32_t zero = 0;
+                        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, fragmentCountBuffer);
+                        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), &zero);
+                    }
+
+                    // O.6. One item per cube: near cubes first for the early depth test, farther first
+                    //      for the worst case, or a constant depth which keeps the submission order (stable sort).
+                    for (int idx = 0; idx < overdraw; idx++) {
+                        float depth = (cubeDepths[idx] - camera.nearPlane) / (camera.farPlane - camera.nearPlane);
+                        if (cubeOrder == CUBE_ORDER_BACK_TO_FRONT) {
+                            depth = 1.0f - depth;
+                        } else if (cubeOrder == CUBE_ORDER_SUBMISSION) {
+                            depth = 0.0f;
+                        }
+                        const float* instance = &cubeInstances[idx * 4];
+                        RenderQueueItem item = {
+                            renderQueueKey(0, 1, 1, 0, 0, depth), cube_sorted_program, cube.vao, 0,
+                            (unsigned int)GL_TRIANGLES, 0, cube.indexCount, cube.indexType,
+                            { instance[0], instance[1], instance[2], instance[3] },
+                        };
+                        renderQueueAdd(&cubeQueue, item);
+                    }
+                    uniformRingBind(&uniformRing, OBJECT_CONSTANTS_BINDING, sortedOffset, sizeof(ObjectConstants));
+                    renderQueueSubmit(&cubeQueue);
+
+                    // O.7. Read back the count (waits for the cubes, only done while counting).
+                    if (countFragments) {
+                        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+                        glBindBuffer(GL_SHADER_STORAGE_BUFFER, fragmentCountBuffer);
+                        const uint32_t* count = (const uint32_t*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, sizeof(uint32_t),
+                                                                                   GL_MAP_READ_BIT);
+                        if (count != NULL) {
+                            countedFragments[cubeOrder] += *count;
+                            countedFrames[cubeOrder]++;
+                            glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+                        }
+                        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+                    }
+                } else {
+                    // X. Use the shader program to draw.
+                    glUseProgram(cube_program);
+
+                    // X. Draw the triangles.
+                    drawCubes(cube, &uniformRing, fillOffsets, GL_TRIANGLES);
+                }
+
+                // "--wireframe": draw a bit of wireframe. It will be incomplete but it's ok for now.
+                if (drawWireframe) {
+                    glUseProgram(cube_program);
+                    drawCubes(cube, &uniformRing, wireframeOffsets, GL_LINES);
+                }
+            } else {
+                // P.1. Depth prepass: fill the depth buffer, without any color output.
+                {
+                    GpuTimerScope timerScope(&gpuTimer, "depth prepass");
+
+                    /* Only the positions are fetched (see common/mesh.h). */
+                    glBindVertexArray(cube.positionVao);
+                    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                    glUseProgram(cube_depth_program);
+                    drawCubes(cube, &uniformRing, fillOffsets, GL_TRIANGLES);
+                    glBindVertexArray(cube.vao);
+                }
+
+                // P.2. Color pass: only the fragments with the final depth pass the test (early-Z).
+                {
+                    GpuTimerScope timerScope(&gpuTimer, "color");
+
+                    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                    glDepthMask(GL_FALSE);
+                    glDepthFunc(GL_EQUAL);
+                    glUseProgram(cube_color_program);
+                    drawCubes(cube, &uniformRing, fillOffsets, GL_TRIANGLES);
+
+                    // The lines don't have the depth of the triangles, test them as usual.
+                    if (drawWireframe) {
+                        glDepthFunc(GL_LEQUAL);
+                        drawCubes(cube, &uniformRing, wireframeOffsets, GL_LINES);
+                    }
+
+                    // P.3. Restore the default depth state (the depth quad clears the depth).
+                    glDepthFunc(GL_LESS);
+                    glDepthMask(GL_TRUE);
+                }
+            }
 
-                //model = glm::rotate(model, glm::radians(-55.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-                model = glm::rotate(model, (float)glfwGetTime() * glm::radians(50.0f), glm::vec3(0.5f, 1.0f, 0.0f));
-                view  = glm::translate(view, glm::vec3(.0f, 0.0f, -1.5f));
-                // retrieve the matrix uniform locations
-                // pass them to the shaders (3 different ways)
-                glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-                glUniformMatrix4fv(viewLoc, 1, GL_FALSE, &view[0][0]);
+            // L.2. Layout benchmark: draw the grid depth-only (position VAO) then with the color (every attribute).
+            /* The depth test always passes: every draw shades the same fragments. */
+            if (layoutBench > 0) {
+                glDepthFunc(GL_ALWAYS);
+                for (int idx = 0; idx < 3; idx++) {
+                    {
+                        GpuTimerScope timerScope(&gpuTimer, layoutBenchPasses[idx][0]);
+
+                        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                        glUseProgram(layout_depth_program);
+                        glBindVertexArray(layoutMeshes[idx].positionVao);
+                        glDrawElements(GL_TRIANGLES, layoutMeshes[idx].indexCount, layoutMeshes[idx].indexType, NULL);
+                        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                    }
+                    {
+                        GpuTimerScope timerScope(&gpuTimer, layoutBenchPasses[idx][1]);
+
+                        glUseProgram(layout_color_program);
+                        glBindVertexArray(layoutMeshes[idx].vao);
+                        glDrawElements(GL_TRIANGLES, layoutMeshes[idx].indexCount, layoutMeshes[idx].indexType, NULL);
+                    }
+                }
+                glDepthFunc(GL_LESS);
+                glBindVertexArray(cube.vao);
             }
 
-            // X. Draw the triangles.
-            glUniform3f(uniformColorLoc, 0.1, 0.8, 0.9);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            // H.2. The rotating cube is the occluder: build the Hi-Z pyramid from its depth and cull the field.
+            if (cubeField > 0 && cull) {
+                {
+                    GpuTimerScope timerScope(&gpuTimer, "hi-z");
+                    hizBuild(&culler, attachedDepth->texture, display_w, display_h);
+                }
+                {
+                    GpuTimerScope timerScope(&gpuTimer, "cull");
+                    hizCull(&culler, glm::value_ptr(viewProjection));
+                }
+            }
+
+            // H.2.1. CPU culling: test the bounds against the frustum and upload the visible instances.
+            /* The field is static: the visible instances in the buffer stay valid until the camera changes
+             * (the level selection also depends on the height of the window). */
+            if (cubeField > 0 && cpuCull && (cullCameraVersion != camera.version || cullHeight != display_h)) {
+                TraceZone traceZone("cpu cull");
+                double cullStart = demoGetTime(&demo);
+                if (cpuCullScalar) {
+                    fieldVisibleCount = frustumCullScalar(&fieldBounds, glm::value_ptr(viewProjection), fieldVisible.data());
+                } else {
+                    fieldVisibleCount = frustumCull(&fieldBounds, glm::value_ptr(viewProjection), fieldVisible.data());
+                }
+
+                // H.2.2. "--field-lod": the level of every visible sphere from its projected size (view depth: clip w).
+                /* The instances are grouped by level in the buffer: one instanced draw per level. */
+                int lodStarts[MESH_LOD_MAX_LEVELS] = {};
+                if (fieldLod) {
+                    float projectionScale = meshLodProjectionScale(glm::value_ptr(projection), display_h);
+                    memset(lodCounts, 0, sizeof(lodCounts));
+                    for (int idx = 0; idx < fieldVisibleCount; idx++) {
+                        const float* instance = &fieldInstances[fieldVisible[idx] * 4];
+                        float depth = viewProjection[0][3] * instance[0] + viewProjection[1][3] * instance[1]
+                                    + viewProjection[2][3] * instance[2] + viewProjection[3][3];
+                        int level = selectMeshLod(fieldLods, instance[3], depth, projectionScale, lodErrorPixels);
+                        fieldLevels[idx] = (uint8_t)level;
+                        lodCounts[level]++;
+                    }
+                    for (uint32_t level = 1; level < fieldLods.levelCount; level++) {
+                        lodStarts[level] = lodStarts[level - 1] + lodCounts[level - 1];
+                    }
+                }
+
+                /* The whole buffer is invalidated: the driver doesn't have to wait for the previous draw. */
+                glBindBuffer(GL_ARRAY_BUFFER, cpuVisibleBuffer);
+                float* dst = (float*)glMapBufferRange(GL_ARRAY_BUFFER, 0, cubeField * 4 * sizeof(float),
+                                                      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+                if (dst != NULL) {
+                    for (int idx = 0; idx < fieldVisibleCount; idx++) {
+                        int slot = fieldLod ? lodStarts[fieldLevels[idx]]++ : idx;
+                        memcpy(&dst[slot * 4], &fieldInstances[fieldVisible[idx] * 4], 4 * sizeof(float));
+                    }
+                    glUnmapBuffer(GL_ARRAY_BUFFER);
+                }
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+                cpuCullSeconds += demoGetTime(&demo) - cullStart;
+                cpuCullFrames++;
+                cullCameraVersion = camera.version;
+                cullHeight = display_h;
+            } else if (cubeField > 0 && cpuCull) {
+                cpuCullSkips++;
+            }
+
+            // H.3. Draw the visible cubes of the field, the instance count is written by the GPU.
+            if (cubeField > 0) {
+                GpuTimerScope timerScope(&gpuTimer, "field");
+
+                glUseProgram(field_program);
+                glBindVertexArray(fieldMesh->vao);
+                uniformRingBind(&uniformRing, OBJECT_CONSTANTS_BINDING, fieldOffset, sizeof(ObjectConstants));
+                if (cull) {
+                    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culler.commandBuffer);
+                    glDrawElementsIndirect(GL_TRIANGLES, cube.indexType, NULL);
+                    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+                } else if (fieldLod) {
+                    // H.3.1. One draw per level: the instance attribute starts at the group of the level, the indices at its range.
+                    /* GL ES has no base instance for the instanced draws, the attribute offset is moved instead. */
+                    size_t indexSize = fieldMesh->indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+                    int firstInstance = 0;
+                    glBindBuffer(GL_ARRAY_BUFFER, cpuVisibleBuffer);
+                    for (uint32_t level = 0; level < fieldLods.levelCount; level++) {
+                        if (lodCounts[level] > 0) {
+                            const MeshLod& lod = fieldLods.levels[level];
+                            glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float),
+                                                  (const void*)(firstInstance * 4 * sizeof(float)));
+                            glDrawElementsInstanced(GL_TRIANGLES, lod.indexCount, fieldMesh->indexType,
+                                                    (const void*)(lod.firstIndex * indexSize), lodCounts[level]);
+                        }
+                        firstInstance += lodCounts[level];
+                    }
+                    glBindBuffer(GL_ARRAY_BUFFER, 0);
+                } else {
+                    glDrawElementsInstanced(GL_TRIANGLES, cube.indexCount, cube.indexType, NULL, fieldVisibleCount);
+                }
+            }
+
+            // K.4. Start the read back of the IDs around the cursor (the cursor is in the top left origin).
+            /* The window coordinates are taken as pixels: the framebuffer scale of HiDPI screens is ignored. */
+            if (pickRegion > 0) {
+                int pickX = (int)cursorX;
+                int pickY = display_h - 1 - (int)cursorY;
+                if (!pickCursor) {
+                    double time = demoAnimationTime(&demo);
+                    pickX = (int)(display_w * (0.5 + 0.4 * sin(time * 0.7)));
+                    pickY = (int)(display_h * (0.5 + 0.35 * sin(time * 1.1)));
+                }
+                pickBufferSubmit(&pick, pickX, pickY, demo.frameCount);
+            }
 
-            // Draw a bit of wireframe. It will be incomplete but it's ok for now.
-            glUniform3f(uniformColorLoc, 0.0, 0.0, 0.0);
-            glDrawArrays(GL_LINES, 0, 36);
+            endRenderPass(&cubePass);
+        }
+
+        // K.5. Collect the finished read backs: the answer of a click arrives a few frames later.
+        if (pickRegion > 0) {
+            pickBufferPoll(&pick, demo.frameCount);
+
+            bool clickAnswer = clickFrame >= 0 && pick.resultFrame >= clickFrame;
+            if (pick.resultFrame >= 0 && (clickAnswer || demoGetTime(&demo) - lastPickPrint >= 1.0)) {
+                char object[64];
+                if (pick.resultId == 0) {
+                    snprintf(object, sizeof(object), "background");
+                } else if (pick.resultId == 1) {
+                    snprintf(object, sizeof(object), "rotating cube");
+                } else {
+                    int cell = (int)pick.resultId - 2;
+                    snprintf(object, sizeof(object), "field cube %d (%d, %d, %d)", cell, cell % fieldSide,
+                             (cell / fieldSide) % fieldSide, cell / (fieldSide * fieldSide));
+                }
+                printf("%s: %s%s, frame %d (%d frames old)\n", clickAnswer ? "Picked" : "Pick", object,
+                       pick.resultExact || pick.resultId == 0 ? "" : " (closest in the region)", pick.resultFrame,
+                       demo.frameCount - pick.resultFrame);
+                if (clickAnswer) {
+                    clickFrame = -1;
+                } else {
+                    lastPickPrint = demoGetTime(&demo);
+                }
+            }
+        }
+
+        // L.2. Linearize the depth of the frame and start its read back, collect the older results.
+        /* The near/far planes come from the projection: they follow its changes. */
+        if (depthReadbackFactor > 0) {
+            TraceZone traceZone("depth readback");
+            float nearPlane, farPlane;
+            projectionDepthPlanes(glm::value_ptr(projection), &nearPlane, &farPlane);
+            depthReadbackSubmit(&depthReadback, attachedDepth->texture, display_w, display_h, nearPlane, farPlane,
+                                demo.frameCount);
+            depthReadbackPoll(&depthReadback, demo.frameCount);
+
+            if (depthReadback.resultFrame >= 0 && demoGetTime(&demo) - lastDepthPrint >= 1.0) {
+                printf("Depth readback: %dx%d distances of frame %d (%d frames old), center: %.3f\n",
+                       depthReadback.resultWidth, depthReadback.resultHeight, depthReadback.resultFrame,
+                       demo.frameCount - depthReadback.resultFrame, depthReadbackAt(&depthReadback, 0.5f, 0.5f));
+                lastDepthPrint = demoGetTime(&demo);
+            }
+        }
+
+        // S.2. The occlusion of the frame from the depth texture, the result stays acquired for the output pass.
+        int ssaoResource = -1;
+        if (ssao) {
+            TraceZone traceZone("ssao");
+            renderGraphReset(&graph);
+            int depthResource = renderGraphImportTexture(&graph, "depth", attachedDepth->texture);
+            ssaoResource = ssaoAddToGraph(&ssaoStage, &graph, depthResource, display_w, display_h,
+                                          glm::value_ptr(projection));
+            renderGraphExport(&graph, ssaoResource);
+            renderGraphCompile(&graph);
+            if (!graphPrinted) {
+                printRenderGraph(&graph);
+                graphPrinted = true;
+            }
+            if (!renderGraphExecute(&graph)) {
+                break;
+            }
         }
 
         // D.X. Draw the final image.
         {
-            // D.X.0. Switch to the output/window framebuffer to draw onto.
-            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            // D.X.P. Partial redraw: report the changed parts of the window and get the region to redraw.
+            /* The old image of the cube must be erased too: the bounds of the previous frame are added.
+             * A couple of pixels of padding covers the rounding and the wireframe lines. */
+            int redraw[4] = { 0, 0, display_w, display_h };
+            if (partialRedraw) {
+                if (cubeBoundsValid) {
+                    int x0 = std::min(cubeBounds[0], lastCubeBounds[0]) - 2;
+                    int y0 = std::min(cubeBounds[1], lastCubeBounds[1]) - 2;
+                    int x1 = std::max(cubeBounds[2], lastCubeBounds[2]) + 2;
+                    int y1 = std::max(cubeBounds[3], lastCubeBounds[3]) + 2;
+                    demoAddSwapDamage(&demo, x0, y0, x1 - x0, y1 - y0);
+                    memcpy(lastCubeBounds, cubeBounds, sizeof(cubeBounds));
+                } else {
+                    demoAddSwapDamage(&demo, 0, 0, display_w, display_h);
+                    lastCubeBounds[0] = lastCubeBounds[1] = 0;
+                    lastCubeBounds[2] = display_w;
+                    lastCubeBounds[3] = display_h;
+                }
+
+                demoAddSwapDamage(&demo, 10, 10, 300, 300);
+                if (gpuTimer.supported && gpuTimer.overlay) {
+                    demoAddSwapDamage(&demo, 10, 320, display_w - 10, (int)gpuTimer.passes.size() * 12);
+                }
+
+                demoBeginPartialRedraw(&demo, &redraw[0], &redraw[1], &redraw[2], &redraw[3]);
+            }
+
+            // D.X.0. Switch to the output/window framebuffer to draw onto, read from the fboDepth.
+            beginRenderPass(&outputPass);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, fboDepth);
+
+            // D.X.1. Copy the color image onto the output (only the redraw region, the blit is scissored too).
+            gpuTimerBegin(&gpuTimer, "blit");
+            glScissor(redraw[0], redraw[1], redraw[2], redraw[3]);
+            glBlitFramebuffer(redraw[0], redraw[1], redraw[0] + redraw[2], redraw[1] + redraw[3],
+                              redraw[0], redraw[1], redraw[0] + redraw[2], redraw[1] + redraw[3],
+                              GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            renderPassCovered(&outputPass, GL_COLOR_BUFFER_BIT, redraw[0], redraw[1], redraw[2], redraw[3]);
+            gpuTimerEnd(&gpuTimer);
+
+            // D.X.1.1. Multiply the blitted color with the occlusion (the same redraw region).
+            if (ssao) {
+                GpuTimerScope timerScope(&gpuTimer, "ssao composite");
+                ssaoComposite(&ssaoStage, renderGraphTexture(&graph, ssaoResource), ssaoView);
+            }
 
-            // D.X.1. Copy the whole color image onto the output.
-            glBlitFramebuffer(0, 0, display_w, display_h, 0, 0, display_w, display_h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            gpuTimerBegin(&gpuTimer, "depth quad");
 
             // D.X.2. Configure the draw output to be a smaller "window"/region.
             glViewport(10, 10, 300, 300);
@@ -524,8 +1678,10 @@ int main(int argc, char **argv) {
             glScissor(10, 10, 300, 300);
 
             // D.X.5. Clear the draw region.
+            /* The color clear is redundant (the quad covers the region): the render pass skips it
+             * after the first frame, the depth clear is needed by the depth test of the quad. */
             glClearColor(0.0, 0.0, 0.0, 1.0f);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            renderPassClear(&outputPass, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, 10, 10, 300, 300);
 
             // D.X.6. Use the texture quad drawer program.
             glUseProgram(texture_program);
@@ -535,16 +1691,149 @@ int main(int argc, char **argv) {
 
             // D.X.8. Draw the quad (and render the depth texture).
             glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            renderPassCovered(&outputPass, GL_COLOR_BUFFER_BIT, 10, 10, 300, 300);
+            gpuTimerEnd(&gpuTimer);
+        }
+
+        // T.3. Show the pass times above the depth image (if requested).
+        gpuTimerDrawOverlay(&gpuTimer, 10, 320);
+
+        // R.3. The depth buffer of the window is not needed anymore.
+        endRenderPass(&outputPass);
+        gpuTimerEndFrame(&gpuTimer);
+
+        // S.3. Follow the GPU time budget with the sample count of the next frames.
+        if (ssao) {
+            ssaoAdaptSamples(&ssaoStage);
+        }
+
+        // O.8. Report the shaded fragments of the cubes once per second.
+        if (countFragments && !sortBenchmark && demoGetTime(&demo) - lastCountPrint >= 1.0) {
+            if (countedFrames[cubeOrder] > 0) {
+                double perFrame = countedFragments[cubeOrder] / countedFrames[cubeOrder];
+                printf("Shaded fragments (%s order): %.0f/frame, %.2f per pixel\n", cubeOrderNames[cubeOrder], perFrame,
+                       perFrame / ((double)display_w * display_h));
+            }
+            countedFragments[cubeOrder] = 0.0;
+            countedFrames[cubeOrder] = 0;
+            lastCountPrint = demoGetTime(&demo);
+        }
+
+        // H.4. Report the number of visible cubes once per second (the read back waits for the GPU).
+        if (cubeField > 0 && demoGetTime(&demo) - lastFieldPrint >= 1.0) {
+            if (cpuCull) {
+                printf("Cube field: %d cubes, %d visible, CPU cull + upload: %.3f ms/culled frame, %d culled, %d reused\n",
+                       cubeField, fieldVisibleCount, cpuCullFrames ? cpuCullSeconds * 1000.0 / cpuCullFrames : 0.0,
+                       cpuCullFrames, cpuCullSkips);
+                cpuCullSeconds = 0.0;
+                cpuCullFrames = 0;
+                cpuCullSkips = 0;
+                if (fieldLod) {
+                    long triangleCount = 0;
+                    printf("Field LOD: instances per level:");
+                    for (uint32_t level = 0; level < fieldLods.levelCount; level++) {
+                        printf(" %d", lodCounts[level]);
+                        triangleCount += (long)lodCounts[level] * fieldLods.levels[level].indexCount / 3;
+                    }
+                    printf(", %ld triangles/frame\n", triangleCount);
+                }
+            } else {
+                printf("Cube field: %d cubes, %d visible\n", cubeField, cull ? hizVisibleCount(&culler) : cubeField);
+            }
+            lastFieldPrint = demoGetTime(&demo);
         }
 
         // X. Swap the fron-back buffers to display the rendered image in the window.
-        glfwSwapBuffers(window);
+        demoSwapBuffers(&demo);
+    }
+
+    // XX. Print the format benchmark results.
+    /* Bandwidth estimate: both attachments are stored and the color image is read by the blit. */
+    if (formatMatrix) {
+        printf("%-20s %-20s %12s %10s\n", "color", "depth", "MiB/frame", "ms/frame");
+        for (size_t idx = 0; idx < matrix.size(); idx++) {
+            double bytes = (double)display_w * display_h * (2 * matrix[idx].color->bytesPerPixel + matrix[idx].depth->bytesPerPixel);
+            printf("%-20s %-20s %12.2f %10.3f\n", matrix[idx].color->name, matrix[idx].depth->name,
+                   bytes / (1024.0 * 1024.0), matrix[idx].ms);
+        }
+    }
+
+    // XX. Print the shaded fragments of every draw order, relative to the submission order.
+    if (sortBenchmark) {
+        double submission = countedFrames[CUBE_ORDER_SUBMISSION] > 0
+                          ? countedFragments[CUBE_ORDER_SUBMISSION] / countedFrames[CUBE_ORDER_SUBMISSION] : 0.0;
+        printf("%-16s %8s %16s %10s %12s\n", "order", "frames", "fragments/frame", "per pixel", "vs submission");
+        for (int order = 0; order < CUBE_ORDER_COUNT; order++) {
+            if (countedFrames[order] == 0) {
+                continue;
+            }
+            double perFrame = countedFragments[order] / countedFrames[order];
+            printf("%-16s %8d %16.0f %10.2f %11.1f%%\n", cubeOrderNames[order], countedFrames[order], perFrame,
+                   perFrame / ((double)display_w * display_h), submission > 0.0 ? perFrame * 100.0 / submission : 0.0);
+        }
+    }
+
+    // XX. Destroy the sorted draws and the fragment counter.
+    if (sortCubes) {
+        destroyRenderQueue(&cubeQueue);
+    }
+    if (fragmentCountBuffer != 0) {
+        glDeleteBuffers(1, &fragmentCountBuffer);
+    }
+
+    // XX. Destroy the SSAO stage and its graph (the graph gives its textures back to the pool).
+    if (ssao) {
+        destroyRenderGraph(&graph);
+        destroySsaoStage(&ssaoStage);
+    }
+
+    // XX. Destroy the GPU timer queries.
+    destroyGpuTimer(&gpuTimer);
+
+    // XX. Destroy the pick buffer.
+    if (pickRegion > 0) {
+        destroyPickBuffer(&pick);
+    }
+
+    // XX. Stop the GL worker threads.
+    destroyGLWorkers(&glWorkers);
+
+    // XX. Destroy the uniform buffer ring.
+    destroyUniformRing(&uniformRing);
+
+    // XX. Destroy the FBO and its attachments.
+    glDeleteFramebuffers(1, &fboDepth);
+    printRenderTargetPoolStats(&targetPool);
+    {
+        const RenderPass* passes[] = { &cubePass, &outputPass };
+        printRenderPassClearReport(passes, 2);
+    }
+    destroyRenderTargetPool(&targetPool);
+
+    // XX. Destroy the cube field.
+    if (cubeField > 0) {
+        destroyHiZCuller(&culler);
+        if (cpuVisibleBuffer != 0) {
+            glDeleteBuffers(1, &cpuVisibleBuffer);
+        }
+    }
+    if (fieldLod) {
+        destroyMeshBuffers(&lodSphere);
+    }
+    if (depthReadbackFactor > 0) {
+        destroyDepthReadback(&depthReadback);
+    }
+
+    // XX. Destroy the cube buffers.
+    destroyMeshBuffers(&cube);
+    if (layoutBench > 0) {
+        for (int idx = 0; idx < 3; idx++) {
+            destroyMeshBuffers(&layoutMeshes[idx]);
+        }
     }
 
-    // XX. Destroy the window.
-    glfwDestroyWindow(window);
-    // XX. Destroy the GLFW.
-    glfwTerminate();
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
 
     return 0;
 }
@@ -0,0 +1,640 @@
+/**
+ * Shadow mapping example: a directional light over a field of cubes.
+ *
+ * Compile with shaderc:
+ * $ g++ gles_shadow_map.cpp -o gles_shadow_map -lglfw -lGLESv2
+ *
+ * Run:
+ * $ ./gles_shadow_map
+ *
+ * The light space depth-only passes render into the layers of a
+ * GL_DEPTH_COMPONENT16 array texture with the color outputs disabled (the
+ * FBO setup documented in gles_depth_cube.cpp), the scene samples them with a
+ * sampler2DArrayShadow: the texture unit does the depth comparison and the 2x2
+ * PCF filter (see common/shadow_map.h).
+ *
+ * Shadow map resolution ("--shadow-size N", a power of two) and cascade count
+ * ("--cascades N", 1-4, each one covers a slice of the view up to
+ * "--shadow-distance D", "--split-lambda X" selects between the uniform (0) and
+ * the logarithmic (1) split):
+ * $ ./gles_shadow_map --shadow-size 2048 --cascades 4 --shadow-distance 80
+ *
+ * Every cascade is culled with its light view-projection (see
+ * common/frustum_culling.h): only the cubes inside its box are drawn into it.
+ * Color the scene by the cascade it samples:
+ * $ ./gles_shadow_map --cubes 2500 --show-cascades
+ *
+ * Frame budget: the GPU time of the shadow passes is measured and the
+ * resolution, then the cascade count is reduced until they fit into the
+ * budget (and restored when there is room again):
+ * $ ./gles_shadow_map --cubes 10000 --shadow-budget 2.0 --gpu-timer
+ *
+ * Quality governor (see common/quality_governor.h): hold a 16.6 ms frame time over a long
+ * session. The MSAA level, the shadow resolution, the shader precision and the internal
+ * resolution are stepped down (in this order) when the frame time or the thermal zone of the
+ * GPU ("--thermal-zone FILE" selects the millidegree file, "--thermal-limit C" the throttle
+ * point) goes over the limits and restored when there is room again, every decision is logged:
+ * $ ./gles_shadow_map --cubes 10000 --governor 16.6
+ *
+ * Dependencies:
+ *  * C++11
+ *  * GLFW 3.0+
+ *  * GLM
+ *  * Open GL ES 3.0+
+ *  * EGL
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <GLES3/gl3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "common/program_cache.h"
+#include "common/demo_context.h"
+#include "common/frustum_culling.h"
+#include "common/gpu_timer.h"
+#include "common/mesh.h"
+#include "common/quality_governor.h"
+#include "common/render_target_pool.h"
+#include "common/shader_precision.h"
+#include "common/shadow_map.h"
+#include "common/uniform_ring.h"
+
+// Texture unit of the shadow maps.
+#define SHADOW_UNIT 6
+
+// Every object is an instance of the unit cube: center and half extent per instance.
+/* The light passes use the same vertex shader: the cascade view-projection is the
+ * "projection" of their frame constants and the "view" is the identity. */
+const char* scene_vertex_src = R"(#version 310 es
+precision highp float;
+
+layout(location = 0) in vec3 aPos;
+layout(location = 4) in vec3 aCenter;
+layout(location = 5) in vec3 aExtent;
+
+out vec3 vWorldPos;
+out float vViewDepth;
+out vec3 vColor;
+
+layout(std140) uniform FrameConstants {
+    mat4 projection;
+    mat4 view;
+};
+
+void main() {
+    vec4 worldPos = vec4(aPos * 2.0 * aExtent + aCenter, 1.0);
+    vec4 viewPos = view * worldPos;
+    gl_Position = projection * viewPos;
+
+    vWorldPos = worldPos.xyz;
+    vViewDepth = -viewPos.z;
+
+    // The floor is grey, the cubes get a color from their position.
+    vColor = aExtent.x > 4.0 ? vec3(0.7) : 0.4 + 0.5 * fract(sin(aCenter.xzx * vec3(12.9898, 78.233, 37.719)) * 43758.5453);
+}
+)";
+
+const char* scene_fragment_src = R"(#version 310 es
+precision highp float;
+
+// The positions stay highp in the mediump variant of the governor (the shadow map coordinates).
+in highp vec3 vWorldPos;
+in highp float vViewDepth;
+in vec3 vColor;
+
+out vec4 outColor;
+
+uniform vec3 lightDirection;
+)";
+
+const char* scene_fragment_main_src = R"(
+void main() {
+    // Flat shading: the face normal from the derivatives of the position (towards the viewer).
+    vec3 normal = normalize(cross(dFdx(vWorldPos), dFdy(vWorldPos)));
+    float lambert = max(dot(normal, -lightDirection), 0.0);
+    float shadow = lambert > 0.0 ? shadowFactor(vWorldPos, vViewDepth) : 0.0;
+
+    vec3 color = vColor;
+#ifdef SHOW_CASCADES
+    const vec3 cascadeColors[4] = vec3[4](vec3(1.0, 0.4, 0.4), vec3(0.4, 1.0, 0.4), vec3(0.4, 0.4, 1.0), vec3(1.0, 1.0, 0.4));
+    int cascade = shadowCascade(vViewDepth);
+    if (cascade >= 0) {
+        color *= cascadeColors[cascade];
+    }
+#endif
+
+    outColor = vec4(color * (0.25 + 0.75 * lambert * shadow), 1.0);
+}
+)";
+
+// Light passes: only the depth is written, there is nothing to shade.
+const char* depth_fragment_src = R"(#version 310 es
+precision mediump float;
+
+void main() {
+}
+)";
+
+// Scene instances: xyz center, xyz half extent.
+#define INSTANCE_FLOATS 6
+
+// Connect the instance range (starting at "first") of the instance buffer to the cube VAO.
+static void bindInstanceRange(unsigned int vao, unsigned int buffer, int first) {
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    size_t offset = (size_t)first * INSTANCE_FLOATS * sizeof(float);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, INSTANCE_FLOATS * sizeof(float), (const void*)offset);
+    glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, INSTANCE_FLOATS * sizeof(float),
+                          (const void*)(offset + 3 * sizeof(float)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+int main(int argc, char **argv) {
+    int shadowSize = 1024;
+    int cascadeCount = 3;
+    float shadowDistance = 60.0f;
+    float splitLambda = 0.75f;
+    double shadowBudget = 0.0;
+    int cubeCount = 400;
+    bool showCascades = false;
+    double governorTargetMs = 0.0;
+    const char* thermalZone = NULL;
+    double thermalLimit = 0.0;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--shadow-size") == 0 && idx + 1 < argc) {
+            shadowSize = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--cascades") == 0 && idx + 1 < argc) {
+            cascadeCount = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--shadow-distance") == 0 && idx + 1 < argc) {
+            shadowDistance = (float)atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--split-lambda") == 0 && idx + 1 < argc) {
+            splitLambda = (float)atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--shadow-budget") == 0 && idx + 1 < argc) {
+            shadowBudget = atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--cubes") == 0 && idx + 1 < argc) {
+            cubeCount = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--show-cascades") == 0) {
+            showCascades = true;
+        } else if (strcmp(argv[idx], "--governor") == 0 && idx + 1 < argc) {
+            governorTargetMs = atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--thermal-zone") == 0 && idx + 1 < argc) {
+            thermalZone = argv[++idx];
+        } else if (strcmp(argv[idx], "--thermal-limit") == 0 && idx + 1 < argc) {
+            thermalLimit = atof(argv[++idx]);
+        }
+    }
+
+    const float nearPlane = 0.5f;
+    const float farPlane = 150.0f;
+    if (shadowSize < SHADOW_MIN_SIZE || shadowSize > 8192 || (shadowSize & (shadowSize - 1)) != 0) {
+        printf("The shadow map size must be a power of two in [%d, 8192]\n", SHADOW_MIN_SIZE);
+        return -1;
+    }
+    if (cascadeCount < 1 || cascadeCount > SHADOW_MAX_CASCADES) {
+        printf("The cascade count must be in [1, %d]\n", SHADOW_MAX_CASCADES);
+        return -1;
+    }
+    if (shadowDistance <= nearPlane || shadowDistance > farPlane || splitLambda < 0.0f || splitLambda > 1.0f
+        || shadowBudget < 0.0 || cubeCount < 1) {
+        printf("Invalid --shadow-distance (%.1f - %.1f), --split-lambda (0 - 1), --shadow-budget or --cubes value\n",
+               nearPlane, farPlane);
+        return -1;
+    }
+    if (governorTargetMs < 0.0 || (governorTargetMs > 0.0 && shadowBudget > 0.0)) {
+        printf("Invalid --governor frame time (the governor can't be combined with --shadow-budget)\n");
+        return -1;
+    }
+    bool governed = governorTargetMs > 0.0;
+
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    /* See the "01_gles_glfw" example for the GLFW steps. This also handles the
+     * "--headless" and "--frames N" command line options. */
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
+
+    int maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    if (shadowSize > maxTextureSize) {
+        printf("The shadow map size is limited to %d by the driver\n", maxTextureSize);
+        destroyDemoContext(&demo);
+        return -1;
+    }
+
+    // 5-9. Build the scene and the light pass programs (the shadow sampling functions are part of the scene shader).
+    /* See common/program_cache.h: the binaries are cached between the runs. */
+    /* The governor switches between the highp and the mediump variant of the scene program. */
+    unsigned int scene_program = 0;
+    unsigned int depth_program;
+    PrecisionVariants sceneVariants;
+    {
+        std::string fragmentSrc = std::string(scene_fragment_src) + shadowSamplingSrc + scene_fragment_main_src;
+        if (showCascades) {
+            fragmentSrc.insert(fragmentSrc.find('\n') + 1, "#define SHOW_CASCADES\n");
+        }
+        if (governed) {
+            if (initPrecisionVariants(&sceneVariants, scene_vertex_src, fragmentSrc.c_str())) {
+                scene_program = sceneVariants.programs[SHADER_PRECISION_HIGHP];
+            }
+        } else {
+            scene_program = createCachedProgram(scene_vertex_src, fragmentSrc.c_str());
+        }
+        depth_program = createCachedProgram(scene_vertex_src, depth_fragment_src);
+        if (scene_program == 0 || depth_program == 0) {
+            return -3;
+        }
+    }
+
+    // V.1. The unit cube: only the positions are used, the instances are connected in V.3.
+    MeshBuffers cube = uploadMesh(createCubeMesh(), false, 0, -1);
+
+    // V.2. The scene: the floor and a grid of cubes of different heights on it.
+    std::vector<float> instances;
+    {
+        int side = (int)ceilf(sqrtf((float)cubeCount));
+        float spacing = 3.0f;
+        float floorSize = side * spacing * 0.5f + 20.0f;
+
+        float floorInstance[INSTANCE_FLOATS] = { 0.0f, -0.5f, 0.0f, floorSize, 0.5f, floorSize };
+        instances.insert(instances.end(), floorInstance, floorInstance + INSTANCE_FLOATS);
+
+        for (int idx = 0; idx < cubeCount; idx++) {
+            float x = (idx % side - (side - 1) * 0.5f) * spacing;
+            float z = (idx / side - (side - 1) * 0.5f) * spacing;
+            float halfHeight = 0.5f + (float)((idx * 7919) % 13) * 0.15f;
+
+            float cubeInstance[INSTANCE_FLOATS] = { x, halfHeight, z, 0.6f, halfHeight, 0.6f };
+            instances.insert(instances.end(), cubeInstance, cubeInstance + INSTANCE_FLOATS);
+        }
+    }
+    int instanceCount = (int)instances.size() / INSTANCE_FLOATS;
+
+    // V.3. Culling bounds of the instances and the buffer of the visible ones: one range per cascade and the camera.
+    CullingBounds bounds;
+    for (int idx = 0; idx < instanceCount; idx++) {
+        addCullingBounds(&bounds, &instances[idx * INSTANCE_FLOATS], &instances[idx * INSTANCE_FLOATS + 3]);
+    }
+    std::vector<int> visible(instanceCount);
+    std::vector<float> visibleInstances((SHADOW_MAX_CASCADES + 1) * instanceCount * INSTANCE_FLOATS);
+
+    unsigned int instanceBuffer;
+    {
+        glGenBuffers(1, &instanceBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, visibleInstances.size() * sizeof(float), NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        glBindVertexArray(cube.vao);
+        glVertexAttribDivisor(4, 1);
+        glVertexAttribDivisor(5, 1);
+        glEnableVertexAttribArray(4);
+        glEnableVertexAttribArray(5);
+        glBindVertexArray(0);
+    }
+
+    // S.1. Create the shadow maps: the depth array texture and the depth-only FBO of every cascade.
+    ShadowMaps shadows;
+    if (!initShadowMaps(&shadows, shadowSize, cascadeCount)) {
+        return -1;
+    }
+    shadows.splitLambda = splitLambda;
+
+    // 11. Connect the uniform blocks of the programs and create the uniform buffer ring.
+    /* See common/uniform_ring.h: the frame constants of the camera and of every cascade are written each frame. */
+    UniformRing uniformRing;
+    {
+        bindConstantBlocks(scene_program);
+        bindConstantBlocks(depth_program);
+        if (governed) {
+            bindConstantBlocks(sceneVariants.programs[SHADER_PRECISION_MEDIUMP]);
+        }
+        initUniformRing(&uniformRing, 16 * 1024);
+    }
+
+    // T.1. The GPU time of the shadow passes drives the budget controller (if the timer queries are supported).
+    GpuTimer gpuTimer;
+    initGpuTimer(&gpuTimer, argc, argv);
+    if (shadowBudget > 0.0) {
+        if (gpuTimerEnableQueries(&gpuTimer)) {
+            shadowMapsSetBudget(&shadows, shadowBudget);
+        } else {
+            printf("Shadow budget: GL_EXT_disjoint_timer_query is not supported, the budget is ignored\n");
+        }
+    }
+
+    // Q.1. Quality governor ("--governor MS"): the knobs in their step down order, the GPU time of the frame.
+    /* Without the timer queries the CPU frame time is used. The MSAA levels are limited by the driver. */
+    QualityGovernor governor;
+    int msaaKnob = -1;
+    int shadowKnob = -1;
+    int precisionKnob = -1;
+    int scaleKnob = -1;
+    bool governorGpuTime = false;
+    RenderTargetPool targetPool;
+    unsigned int sceneFbo = 0;
+    unsigned int attachedColor = 0; // renderbuffers attached to the sceneFbo
+    unsigned int attachedDepth = 0;
+    if (governed) {
+        initQualityGovernor(&governor, governorTargetMs);
+        qualityGovernorOpenThermal(&governor, thermalZone, thermalLimit);
+
+        int maxSamples = 0;
+        glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+        static const int msaaLevels[] = { 4, 2, 0 };
+        static const char* msaaLabels[] = { "4x", "2x", "off" };
+        int firstMsaa = maxSamples >= 4 ? 0 : maxSamples >= 2 ? 1 : 2;
+        msaaKnob = qualityGovernorAddKnob(&governor, "MSAA", &msaaLevels[firstMsaa], 3 - firstMsaa, &msaaLabels[firstMsaa]);
+
+        int shadowLevels[QUALITY_MAX_LEVELS];
+        int shadowLevelCount = 0;
+        for (int size = shadowSize; size >= SHADOW_MIN_SIZE && shadowLevelCount < 4; size /= 2) {
+            shadowLevels[shadowLevelCount++] = size;
+        }
+        shadowKnob = qualityGovernorAddKnob(&governor, "shadow resolution", shadowLevels, shadowLevelCount, NULL);
+
+        static const int precisionLevels[] = { SHADER_PRECISION_HIGHP, SHADER_PRECISION_MEDIUMP };
+        precisionKnob = qualityGovernorAddKnob(&governor, "precision", precisionLevels, 2, shaderPrecisionNames);
+
+        static const int scaleLevels[] = { 100, 85, 70, 50 };
+        static const char* scaleLabels[] = { "100%", "85%", "70%", "50%" };
+        scaleKnob = qualityGovernorAddKnob(&governor, "resolution", scaleLevels, 4, scaleLabels);
+
+        governorGpuTime = gpuTimerEnableQueries(&gpuTimer);
+        char levels[256];
+        formatQualityLevels(&governor, levels, sizeof(levels));
+        printf("Quality governor: %.2f ms target (%s frame time), %s\n", governorTargetMs,
+               governorGpuTime ? "GPU" : "CPU", levels);
+
+        initRenderTargetPool(&targetPool);
+        glGenFramebuffers(1, &sceneFbo);
+    }
+    double lastFrameTime = demoGetTime(&demo);
+
+    // The light comes from above, slightly from the side.
+    glm::vec3 lightDirection = glm::normalize(glm::vec3(-0.4f, -1.0f, -0.3f));
+
+    int casterCounts[SHADOW_MAX_CASCADES] = { 0, 0, 0, 0 };
+    int cameraVisibleCount = 0;
+    double statsStartTime = demoGetTime(&demo);
+
+    // X. Create a render loop.
+    while (!demoShouldClose(&demo))
+    {
+        // X. Poll and handle events (inputs, window resize, etc.)
+        demoPollEvents(&demo);
+        gpuTimerBeginFrame(&gpuTimer);
+
+        int display_w, display_h;
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
+
+        // XX. The camera circles the scene.
+        float time = (float)demoAnimationTime(&demo);
+        float aspect = (float)display_w / (float)display_h;
+        float fovY = glm::radians(45.0f);
+        glm::mat4 projection = glm::perspective(fovY, aspect, nearPlane, farPlane);
+        glm::vec3 eye = glm::vec3(cosf(time * 0.2f) * 30.0f, 12.0f, sinf(time * 0.2f) * 30.0f);
+        glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 viewProjection = projection * view;
+
+        // S.2. Split the view frustum and fit the light projection of every cascade.
+        updateShadowCascades(&shadows, glm::value_ptr(view), fovY, aspect, nearPlane, shadowDistance,
+                             glm::value_ptr(lightDirection));
+
+        // S.3. Cull the instances for every cascade and for the camera, upload the visible ones.
+        /* Range "idx" of the buffer holds the instances of cascade "idx", the last range is the camera's. */
+        {
+            auto cullRange = [&](const float* matrix, int range) {
+                int count = frustumCull(&bounds, matrix, visible.data());
+                float* output = &visibleInstances[range * instanceCount * INSTANCE_FLOATS];
+                for (int idx = 0; idx < count; idx++) {
+                    memcpy(&output[idx * INSTANCE_FLOATS], &instances[visible[idx] * INSTANCE_FLOATS],
+                           INSTANCE_FLOATS * sizeof(float));
+                }
+                return count;
+            };
+
+            for (int idx = 0; idx < shadows.cascadeCount; idx++) {
+                casterCounts[idx] = cullRange(shadows.cascades[idx].viewProjection, idx);
+            }
+            cameraVisibleCount = cullRange(glm::value_ptr(viewProjection), SHADOW_MAX_CASCADES);
+
+            /* Orphan the buffer: the draws of the previous frame may still read it. */
+            glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+            glBufferData(GL_ARRAY_BUFFER, visibleInstances.size() * sizeof(float), NULL, GL_STREAM_DRAW);
+            for (int range = 0; range <= SHADOW_MAX_CASCADES; range++) {
+                int count = range < SHADOW_MAX_CASCADES ? casterCounts[range] : cameraVisibleCount;
+                if (range < SHADOW_MAX_CASCADES && range >= shadows.cascadeCount) {
+                    continue;
+                }
+                size_t offset = (size_t)range * instanceCount * INSTANCE_FLOATS * sizeof(float);
+                glBufferSubData(GL_ARRAY_BUFFER, offset, count * INSTANCE_FLOATS * sizeof(float),
+                                &visibleInstances[range * instanceCount * INSTANCE_FLOATS]);
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
+        // XX. The frame constants of the cascades (light view-projection, identity view) and of the camera.
+        int cascadeOffsets[SHADOW_MAX_CASCADES];
+        int cameraOffset;
+        {
+            FrameConstants constants;
+            glm::mat4 identity = glm::mat4(1.0f);
+
+            uniformRingBeginFrame(&uniformRing);
+            for (int idx = 0; idx < shadows.cascadeCount; idx++) {
+                memcpy(constants.projection, shadows.cascades[idx].viewProjection, sizeof(constants.projection));
+                memcpy(constants.view, glm::value_ptr(identity), sizeof(constants.view));
+                cascadeOffsets[idx] = uniformRingWrite(&uniformRing, &constants, sizeof(constants));
+            }
+            memcpy(constants.projection, glm::value_ptr(projection), sizeof(constants.projection));
+            memcpy(constants.view, glm::value_ptr(view), sizeof(constants.view));
+            cameraOffset = uniformRingWrite(&uniformRing, &constants, sizeof(constants));
+            uniformRingEndFrame(&uniformRing);
+        }
+
+        glEnable(GL_DEPTH_TEST);
+
+        // S.4. Light passes: the culled instances of each cascade into its layer, depth only.
+        {
+            GpuTimerScope timerScope(&gpuTimer, "shadow");
+            glUseProgram(depth_program);
+            for (int idx = 0; idx < shadows.cascadeCount; idx++) {
+                shadowMapsBeginCascade(&shadows, idx);
+                uniformRingBind(&uniformRing, FRAME_CONSTANTS_BINDING, cascadeOffsets[idx], sizeof(FrameConstants));
+                bindInstanceRange(cube.vao, instanceBuffer, idx * instanceCount);
+                glDrawElementsInstanced(GL_TRIANGLES, cube.indexCount, cube.indexType, NULL, casterCounts[idx]);
+            }
+            shadowMapsEnd(&shadows);
+        }
+
+        // Q.2. The governor's MSAA and internal resolution: the scene is drawn into the renderbuffers of the pool.
+        /* At the full resolution without MSAA it is drawn into the window directly. */
+        int samples = governed ? qualityKnobValue(&governor, msaaKnob) : 0;
+        float renderScale = governed ? qualityKnobValue(&governor, scaleKnob) / 100.0f : 1.0f;
+        int render_w = std::max(1, (int)(display_w * renderScale + 0.5f));
+        int render_h = std::max(1, (int)(display_h * renderScale + 0.5f));
+        bool offscreen = samples > 0 || render_w != display_w || render_h != display_h;
+        RenderTarget* colorTarget = NULL;
+        RenderTarget* depthTarget = NULL;
+        if (offscreen) {
+            RenderTargetKey colorKey = { RENDER_TARGET_RENDERBUFFER, GL_RGBA8, render_w, render_h, samples };
+            RenderTargetKey depthKey = { RENDER_TARGET_RENDERBUFFER, GL_DEPTH_COMPONENT24, render_w, render_h, samples };
+            colorTarget = acquireRenderTarget(&targetPool, colorKey);
+            depthTarget = acquireRenderTarget(&targetPool, depthKey);
+            if (colorTarget == NULL || depthTarget == NULL) {
+                break;
+            }
+
+            glBindFramebuffer(GL_FRAMEBUFFER, sceneFbo);
+            if (colorTarget->renderbuffer != attachedColor || depthTarget->renderbuffer != attachedDepth) {
+                attachRenderTarget(colorTarget);
+                attachRenderTarget(depthTarget);
+                attachedColor = colorTarget->renderbuffer;
+                attachedDepth = depthTarget->renderbuffer;
+            }
+        }
+
+        // X. Draw the scene into the window with the shadow maps.
+        {
+            GpuTimerScope timerScope(&gpuTimer, "scene");
+            glBindFramebuffer(GL_FRAMEBUFFER, offscreen ? sceneFbo : demoDefaultFramebuffer(&demo));
+            glViewport(0, 0, render_w, render_h);
+            glClearColor(0.5f, 0.65f, 0.8f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            glUseProgram(scene_program);
+            shadowMapsBind(&shadows, scene_program, SHADOW_UNIT);
+            glUniform3fv(glGetUniformLocation(scene_program, "lightDirection"), 1, glm::value_ptr(lightDirection));
+            uniformRingBind(&uniformRing, FRAME_CONSTANTS_BINDING, cameraOffset, sizeof(FrameConstants));
+            bindInstanceRange(cube.vao, instanceBuffer, SHADOW_MAX_CASCADES * instanceCount);
+            glDrawElementsInstanced(GL_TRIANGLES, cube.indexCount, cube.indexType, NULL, cameraVisibleCount);
+            glBindVertexArray(0);
+
+            // Q.3. Resolve the samples (into a single sampled RGBA8 target: the window format can differ) and upscale.
+            if (offscreen) {
+                RenderTarget* resolveTarget = NULL;
+                unsigned int source = sceneFbo;
+                if (samples > 0) {
+                    resolveTarget = acquireRenderTarget(&targetPool, GL_RGBA8, render_w, render_h);
+                    if (resolveTarget != NULL) {
+                        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveTarget->fbo);
+                        glBlitFramebuffer(0, 0, render_w, render_h, 0, 0, render_w, render_h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+                        source = resolveTarget->fbo;
+                    }
+                }
+
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, source);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, demoDefaultFramebuffer(&demo));
+                glBlitFramebuffer(0, 0, render_w, render_h, 0, 0, display_w, display_h, GL_COLOR_BUFFER_BIT,
+                                  render_w == display_w && render_h == display_h ? GL_NEAREST : GL_LINEAR);
+
+                // The samples and the depth are not needed after the resolve.
+                static const GLenum sceneAttachments[] = { GL_COLOR_ATTACHMENT0, GL_DEPTH_ATTACHMENT };
+                glBindFramebuffer(GL_FRAMEBUFFER, sceneFbo);
+                glInvalidateFramebuffer(GL_FRAMEBUFFER, 2, sceneAttachments);
+                glBindFramebuffer(GL_FRAMEBUFFER, demoDefaultFramebuffer(&demo));
+
+                releaseRenderTarget(&targetPool, resolveTarget);
+                releaseRenderTarget(&targetPool, colorTarget);
+                releaseRenderTarget(&targetPool, depthTarget);
+            }
+        }
+        gpuTimerEndFrame(&gpuTimer);
+        if (governed) {
+            renderTargetPoolEndFrame(&targetPool);
+        }
+
+        // S.5. Report the cascades and the culled casters every second.
+        if (demoGetTime(&demo) - statsStartTime >= 1.0) {
+            printf("Shadows: %dx%d, %d cascades, split/casters:", shadows.size, shadows.size, shadows.cascadeCount);
+            for (int idx = 0; idx < shadows.cascadeCount; idx++) {
+                printf(" %.1f/%d", shadows.cascades[idx].splitFar, casterCounts[idx]);
+            }
+            printf(" | camera: %d of %d instances", cameraVisibleCount, instanceCount);
+            if (governed) {
+                char levels[256];
+                formatQualityLevels(&governor, levels, sizeof(levels));
+                printf(" | %s, frame time: %.2f ms", levels, governor.fastMs);
+            }
+            printf("\n");
+            statsStartTime = demoGetTime(&demo);
+        }
+
+        // S.6. Budget: trade the resolution and the cascades for the measured GPU time of the light passes.
+        shadowMapsBudgetUpdate(&shadows, gpuTimerLastMs(&gpuTimer, "shadow"));
+
+        // X. Swap the fron-back buffers to display the rendered image in the window.
+        demoSwapBuffers(&demo);
+
+        // Q.4. Feed the governor, apply the changed knob to the next frame (MSAA and resolution: Q.2).
+        /* The GPU times arrive a few frames late, the governor averages them anyway. */
+        double now = demoGetTime(&demo);
+        if (governed) {
+            double frameMs = governorGpuTime ? gpuTimerLastMs(&gpuTimer, "shadow") + gpuTimerLastMs(&gpuTimer, "scene")
+                                             : (now - lastFrameTime) * 1000.0;
+            if (qualityGovernorUpdate(&governor, now, frameMs)) {
+                int size = qualityKnobValue(&governor, shadowKnob);
+                if (size != shadows.size) {
+                    resizeShadowMaps(&shadows, size, shadows.cascadeCount);
+                }
+                scene_program = sceneVariants.programs[qualityKnobValue(&governor, precisionKnob)];
+            }
+        }
+        lastFrameTime = now;
+    }
+
+    // XX. Destroy the shadow maps, the instance buffer and the uniform buffer ring.
+    destroyShadowMaps(&shadows);
+    glDeleteBuffers(1, &instanceBuffer);
+    destroyMeshBuffers(&cube);
+    destroyUniformRing(&uniformRing);
+    destroyGpuTimer(&gpuTimer);
+    if (governed) {
+        printQualityGovernorStats(&governor);
+        destroyPrecisionVariants(&sceneVariants);
+        glDeleteFramebuffers(1, &sceneFbo);
+        printRenderTargetPoolStats(&targetPool);
+        destroyRenderTargetPool(&targetPool);
+    } else {
+        glDeleteProgram(scene_program);
+    }
+    glDeleteProgram(depth_program);
+
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
+
+    return 0;
+}
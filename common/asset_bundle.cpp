@@ -0,0 +1,220 @@
+/**
+ * Memory mapped asset bundles, see asset_bundle.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/asset_bundle.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <GLES3/gl3.h>
+
+#include "common/gpu_memory.h"
+#include "common/texture_loader.h"
+
+bool openAssetBundle(AssetBundle* bundle, const char* path) {
+    bundle->data = NULL;
+    bundle->size = 0;
+    bundle->entries = NULL;
+    bundle->entryCount = 0;
+
+    // 1. Map the whole file, the mapping stays valid after the close of the descriptor.
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("Asset bundle: unable to open '%s'\n", path);
+        return false;
+    }
+
+    struct stat info;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("Asset bundle: unable to map '%s'\n", path);
+        return false;
+    }
+
+    // 2. Read the whole file ahead: one I/O request instead of a page fault per touched page.
+    madvise(data, info.st_size, MADV_WILLNEED);
+
+    bundle->data = (const uint8_t*)data;
+    bundle->size = info.st_size;
+
+    // 3. Check the header and that every entry is inside the file.
+    const AssetBundleHeader* header = (const AssetBundleHeader*)bundle->data;
+    bool valid = bundle->size >= sizeof(AssetBundleHeader)
+              && memcmp(header->magic, ASSET_BUNDLE_MAGIC, sizeof(header->magic)) == 0
+              && header->version == ASSET_BUNDLE_VERSION
+              && sizeof(AssetBundleHeader) + (size_t)header->entryCount * sizeof(AssetEntry) <= bundle->size;
+
+    if (valid) {
+        bundle->entries = (const AssetEntry*)(bundle->data + sizeof(AssetBundleHeader));
+        bundle->entryCount = header->entryCount;
+
+        for (int idx = 0; idx < bundle->entryCount && valid; idx++) {
+            const AssetEntry& entry = bundle->entries[idx];
+            valid = entry.offset % ASSET_BUNDLE_ALIGNMENT == 0 && entry.offset <= bundle->size
+                 && entry.size <= bundle->size - entry.offset
+                 && memchr(entry.name, '\0', sizeof(entry.name)) != NULL;
+        }
+    }
+
+    if (!valid) {
+        printf("Asset bundle: '%s' is not a valid (version %d) bundle\n", path, ASSET_BUNDLE_VERSION);
+        closeAssetBundle(bundle);
+        return false;
+    }
+
+    return true;
+}
+
+void closeAssetBundle(AssetBundle* bundle) {
+    if (bundle->data != NULL) {
+        munmap((void*)bundle->data, bundle->size);
+    }
+    bundle->data = NULL;
+    bundle->size = 0;
+    bundle->entries = NULL;
+    bundle->entryCount = 0;
+}
+
+const AssetEntry* findAsset(const AssetBundle* bundle, const char* name, AssetType type) {
+    for (int idx = 0; idx < bundle->entryCount; idx++) {
+        const AssetEntry& entry = bundle->entries[idx];
+        if (entry.type == (uint32_t)type && strcmp(entry.name, name) == 0) {
+            return &entry;
+        }
+    }
+    return NULL;
+}
+
+const char* bundleShaderSource(const AssetBundle* bundle, const char* name) {
+    const AssetEntry* entry = findAsset(bundle, name, ASSET_SHADER);
+    if (entry == NULL || entry->size == 0 || bundle->data[entry->offset + entry->size - 1] != '\0') {
+        return NULL;
+    }
+    return (const char*)(bundle->data + entry->offset);
+}
+
+// Round up to the alignment of the blobs, the streams of a mesh asset are aligned the same way.
+static size_t alignBundleOffset(size_t offset) {
+    return (offset + ASSET_BUNDLE_ALIGNMENT - 1) & ~(size_t)(ASSET_BUNDLE_ALIGNMENT - 1);
+}
+
+bool uploadBundleMesh(const AssetBundle* bundle, const char* name, int positionLoc, int texCoordLoc, MeshBuffers* buffers) {
+    const AssetEntry* entry = findAsset(bundle, name, ASSET_MESH);
+    if (entry == NULL || entry->size < sizeof(MeshStreams)) {
+        printf("Asset bundle: no mesh '%s'\n", name);
+        return false;
+    }
+
+    const uint8_t* blob = bundle->data + entry->offset;
+    MeshStreams streams;
+    memcpy(&streams, blob, sizeof(streams));
+
+    size_t vertexOffset = alignBundleOffset(sizeof(MeshStreams));
+    size_t indexOffset = alignBundleOffset(vertexOffset + streams.vertexBufferSize);
+    if (indexOffset + streams.indexBufferSize > entry->size) {
+        printf("Asset bundle: mesh '%s' is truncated\n", name);
+        return false;
+    }
+
+    *buffers = uploadPackedMesh(streams, blob + vertexOffset, blob + indexOffset, positionLoc, texCoordLoc);
+    return true;
+}
+
+bool bundleMeshLods(const AssetBundle* bundle, const char* name, MeshLodChain* chain) {
+    const AssetEntry* entry = findAsset(bundle, name, ASSET_MESH_LODS);
+    if (entry == NULL || entry->size != sizeof(MeshLodChain)) {
+        return false;
+    }
+
+    memcpy(chain, bundle->data + entry->offset, sizeof(MeshLodChain));
+    return chain->levelCount >= 1 && chain->levelCount <= MESH_LOD_MAX_LEVELS;
+}
+
+bool bundleMeshlets(const AssetBundle* bundle, const char* name, MeshletData* meshlets) {
+    const AssetEntry* entry = findAsset(bundle, name, ASSET_MESHLETS);
+    if (entry == NULL || entry->size < sizeof(MeshletHeader)) {
+        return false;
+    }
+
+    // The parts are aligned as the streams of the mesh assets: header, meshlets, indices.
+    const uint8_t* blob = bundle->data + entry->offset;
+    MeshletHeader header;
+    memcpy(&header, blob, sizeof(header));
+    size_t meshletOffset = alignBundleOffset(sizeof(MeshletHeader));
+    size_t indexOffset = alignBundleOffset(meshletOffset + (size_t)header.meshletCount * sizeof(Meshlet));
+    if (indexOffset + (size_t)header.indexCount * sizeof(uint32_t) > entry->size) {
+        printf("Asset bundle: the meshlets of '%s' are truncated\n", name);
+        return false;
+    }
+
+    const Meshlet* first = (const Meshlet*)(blob + meshletOffset);
+    const uint32_t* indices = (const uint32_t*)(blob + indexOffset);
+    meshlets->meshlets.assign(first, first + header.meshletCount);
+    meshlets->indices.assign(indices, indices + header.indexCount);
+    return true;
+}
+
+bool uploadBundleTexture(const AssetBundle* bundle, const char* name, unsigned int* texture) {
+    const AssetEntry* entry = findAsset(bundle, name, ASSET_TEXTURE);
+    if (entry == NULL) {
+        printf("Asset bundle: no texture '%s'\n", name);
+        return false;
+    }
+
+    const uint8_t* blob = bundle->data + entry->offset;
+    unsigned int internalFormat;
+    std::vector<KTXLevel> levels;
+    if (!parseKTX(blob, entry->size, name, &internalFormat, &levels)) {
+        return false;
+    }
+
+    glGenTextures(1, texture);
+    glBindTexture(GL_TEXTURE_2D, *texture);
+    glTexStorage2D(GL_TEXTURE_2D, (int)levels.size(), internalFormat, levels[0].width, levels[0].height);
+    gpuMemoryTrackTexture(*texture, internalFormat, levels[0].width, levels[0].height, 1, (int)levels.size(),
+                          GPU_MEMORY_TEXTURE, "bundle texture");
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    for (size_t idx = 0; idx < levels.size(); idx++) {
+        const KTXLevel& level = levels[idx];
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, (int)idx, 0, 0, level.width, level.height,
+                                  internalFormat, (int)level.size, blob + level.offset);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return true;
+}
@@ -0,0 +1,130 @@
+/**
+ * Memory mapped asset bundles: one file with the shader sources, the baked
+ * meshes and the compressed textures of a demo.
+ *
+ * The file starts with a table of contents (name, type, offset and size of
+ * every asset) followed by the asset blobs, each aligned to 64 bytes. The
+ * bundle is mapped into the memory in one piece and the whole file is read
+ * ahead with one request (MADV_WILLNEED). The GL uploads read straight from
+ * the mapped pages: there is no intermediate copy or parsing step.
+ *
+ * Asset types:
+ *  * shader:  NUL terminated source text.
+ *  * mesh:    MeshStreams header (see common/mesh.h, padded to 64 bytes), the
+ *             vertex streams and the indices, in the format of packMesh.
+ *  * texture: a KTX 1.1 file with a compressed 2D texture (ex.: ETC2 from the
+ *             "tools/ktx_etc2" converter).
+ *  * mesh LOD: MeshLodChain (see common/mesh_lod.h): the index ranges of the
+ *             levels of the mesh asset with the same name.
+ *  * meshlets: MeshletHeader (see common/meshlet.h, padded to 64 bytes), the
+ *             meshlets and their uint32 indices (aligned): the clusters of the
+ *             mesh asset with the same name, its indices are in meshlet order.
+ *
+ * The bundles are written by the "tools/asset_bundle" packer at build time.
+ *
+ * Usage:
+ *
+ *   AssetBundle bundle;
+ *   if (openAssetBundle(&bundle, "demo_assets.bundle")) {
+ *       MeshBuffers cube;
+ *       uploadBundleMesh(&bundle, "cube", positionLoc, -1, &cube);
+ *       closeAssetBundle(&bundle); // the GL objects stay valid
+ *   }
+ *
+ * Dependencies:
+ *  * C++11
+ *  * POSIX (mmap)
+ *  * Open GL ES 3.0+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_ASSET_BUNDLE_H
+#define GLES_COMMON_ASSET_BUNDLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/mesh.h"
+#include "common/mesh_lod.h"
+#include "common/meshlet.h"
+
+#define ASSET_BUNDLE_MAGIC "GLESPAK"
+#define ASSET_BUNDLE_VERSION 1
+#define ASSET_BUNDLE_ALIGNMENT 64
+#define ASSET_NAME_SIZE 48
+
+enum AssetType {
+    ASSET_SHADER = 1,
+    ASSET_MESH = 2,
+    ASSET_TEXTURE = 3,
+    ASSET_MESH_LODS = 4,
+    ASSET_MESHLETS = 5,
+};
+
+// File layout: header, "entryCount" entries, then the blobs.
+struct AssetBundleHeader {
+    char magic[8]; // ASSET_BUNDLE_MAGIC with the terminating NUL
+    uint32_t version;
+    uint32_t entryCount;
+};
+
+struct AssetEntry {
+    char name[ASSET_NAME_SIZE]; // NUL terminated
+    uint32_t type;              // AssetType
+    uint32_t reserved;
+    uint64_t offset;            // from the start of the file, ASSET_BUNDLE_ALIGNMENT aligned
+    uint64_t size;
+};
+
+struct AssetBundle {
+    const uint8_t* data;
+    size_t size;
+    const AssetEntry* entries;
+    int entryCount;
+};
+
+// Map the bundle file and check its table of contents. Returns false (and prints the reason) on failure.
+bool openAssetBundle(AssetBundle* bundle, const char* path);
+
+// Unmap the file. The GL objects created from the bundle are not affected.
+void closeAssetBundle(AssetBundle* bundle);
+
+// Find an asset by name and type, NULL if the bundle doesn't contain it.
+const AssetEntry* findAsset(const AssetBundle* bundle, const char* name, AssetType type);
+
+// Source text of a shader asset (points into the mapped file), NULL if not found.
+const char* bundleShaderSource(const AssetBundle* bundle, const char* name);
+
+// Create the VAOs and buffers of a mesh asset from the mapped data (see uploadPackedMesh).
+bool uploadBundleMesh(const AssetBundle* bundle, const char* name, int positionLoc, int texCoordLoc, MeshBuffers* buffers);
+
+// Copy the level of detail chain of a mesh asset, false if the mesh has no levels in the bundle.
+bool bundleMeshLods(const AssetBundle* bundle, const char* name, MeshLodChain* chain);
+
+// Copy the meshlets of a mesh asset, false if the mesh has no meshlets in the bundle.
+bool bundleMeshlets(const AssetBundle* bundle, const char* name, MeshletData* meshlets);
+
+// Create an immutable compressed texture with every mip level of a texture asset.
+/* The levels are uploaded from the mapped data on the calling thread, with trilinear filtering. */
+bool uploadBundleTexture(const AssetBundle* bundle, const char* name, unsigned int* texture);
+
+#endif // GLES_COMMON_ASSET_BUNDLE_H
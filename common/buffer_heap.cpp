@@ -0,0 +1,275 @@
+/**
+ * GPU buffer heap, see buffer_heap.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/buffer_heap.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+
+#include <GLES3/gl3.h>
+
+#include "common/gpu_memory.h"
+
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static void addFreeRange(BufferHeap* heap, int block, size_t offset, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    heap->blocks[block].freeRanges[offset] = size;
+    heap->freeBySize.insert(std::make_pair(size, std::make_pair(block, offset)));
+}
+
+static void removeFreeRange(BufferHeap* heap, int block, size_t offset) {
+    std::map<size_t, size_t>& ranges = heap->blocks[block].freeRanges;
+    std::map<size_t, size_t>::iterator range = ranges.find(offset);
+    auto sized = heap->freeBySize.equal_range(range->second);
+    for (auto it = sized.first; it != sized.second; ++it) {
+        if (it->second.first == block && it->second.second == offset) {
+            heap->freeBySize.erase(it);
+            break;
+        }
+    }
+    ranges.erase(range);
+}
+
+static int createHeapBlock(BufferHeap* heap, size_t size) {
+    BufferHeapBlock block;
+    block.size = size;
+    glGenBuffers(1, &block.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, block.buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    gpuMemoryTrackBuffer(block.buffer, size, (GpuMemoryCategory)heap->category, heap->label);
+
+    heap->blocks.push_back(block);
+    return (int)heap->blocks.size() - 1;
+}
+
+void initBufferHeap(BufferHeap* heap, size_t blockSize, int category, const char* label) {
+    heap->blockSize = blockSize;
+    heap->category = category;
+    heap->label = label;
+    heap->blocks.clear();
+    heap->allocations.clear();
+    heap->freeHandles.clear();
+    heap->freeBySize.clear();
+    heap->generation = 0;
+    heap->bytesMoved = 0;
+}
+
+BufferHandle bufferHeapAlloc(BufferHeap* heap, size_t size, size_t alignment) {
+    alignment = std::max(alignment, (size_t)1);
+    size = std::max(size, (size_t)1);
+
+    // H.1. The smallest free range with room for the aligned allocation.
+    /* The ranges of the same size are walked in block and offset order: only the alignment can reject one. */
+    int block = -1;
+    size_t rangeOffset = 0;
+    for (auto it = heap->freeBySize.lower_bound(size); it != heap->freeBySize.end(); ++it) {
+        size_t start = alignUp(it->second.second, alignment);
+        if (start + size <= it->second.second + it->first) {
+            block = it->second.first;
+            rangeOffset = it->second.second;
+            break;
+        }
+    }
+
+    // H.2. No room: a new block (larger than the block size for a large allocation).
+    if (block < 0) {
+        block = createHeapBlock(heap, std::max(heap->blockSize, alignUp(size, 4096)));
+        rangeOffset = 0;
+        addFreeRange(heap, block, 0, heap->blocks[block].size);
+    }
+
+    // H.3. Split the range: the alignment padding before and the rest after stay free.
+    size_t rangeSize = heap->blocks[block].freeRanges[rangeOffset];
+    size_t offset = alignUp(rangeOffset, alignment);
+    removeFreeRange(heap, block, rangeOffset);
+    addFreeRange(heap, block, rangeOffset, offset - rangeOffset);
+    addFreeRange(heap, block, offset + size, rangeOffset + rangeSize - offset - size);
+
+    BufferHandle handle;
+    if (!heap->freeHandles.empty()) {
+        handle = heap->freeHandles.back();
+        heap->freeHandles.pop_back();
+    } else {
+        handle = (BufferHandle)heap->allocations.size();
+        heap->allocations.push_back(BufferHeapAllocation());
+    }
+    BufferHeapAllocation& allocation = heap->allocations[handle];
+    allocation.block = block;
+    allocation.offset = offset;
+    allocation.size = size;
+    allocation.alignment = alignment;
+    return handle;
+}
+
+void bufferHeapFree(BufferHeap* heap, BufferHandle handle) {
+    if (handle < 0 || heap->allocations[handle].block < 0) {
+        return;
+    }
+    BufferHeapAllocation& allocation = heap->allocations[handle];
+    int block = allocation.block;
+    size_t offset = allocation.offset;
+    size_t size = allocation.size;
+    allocation.block = -1;
+    heap->freeHandles.push_back(handle);
+
+    // F.1. Merge the range with the free neighbours.
+    std::map<size_t, size_t>& ranges = heap->blocks[block].freeRanges;
+    std::map<size_t, size_t>::iterator next = ranges.lower_bound(offset);
+    if (next != ranges.end() && next->first == offset + size) {
+        size += next->second;
+        removeFreeRange(heap, block, next->first);
+    }
+    std::map<size_t, size_t>::iterator prev = ranges.lower_bound(offset);
+    if (prev != ranges.begin()) {
+        --prev;
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            removeFreeRange(heap, block, offset);
+        }
+    }
+    addFreeRange(heap, block, offset, size);
+}
+
+void bufferHeapUpload(BufferHeap* heap, BufferHandle handle, size_t offset, const void* data, size_t size) {
+    const BufferHeapAllocation& allocation = heap->allocations[handle];
+    glBindBuffer(GL_COPY_WRITE_BUFFER, heap->blocks[allocation.block].buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.offset + offset, size, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+unsigned int bufferHeapBuffer(const BufferHeap* heap, BufferHandle handle) {
+    return heap->blocks[heap->allocations[handle].block].buffer;
+}
+
+size_t bufferHeapOffset(const BufferHeap* heap, BufferHandle handle) {
+    return heap->allocations[handle].offset;
+}
+
+void bufferHeapGetStats(const BufferHeap* heap, BufferHeapStats* stats) {
+    stats->blocks = (int)heap->blocks.size();
+    stats->allocations = (int)(heap->allocations.size() - heap->freeHandles.size());
+    stats->capacity = 0;
+    stats->usedBytes = 0;
+    stats->freeBytes = 0;
+    stats->largestFree = 0;
+    stats->freeRanges = (int)heap->freeBySize.size();
+    for (const BufferHeapBlock& block : heap->blocks) {
+        stats->capacity += block.size;
+        for (const auto& range : block.freeRanges) {
+            stats->freeBytes += range.second;
+        }
+    }
+    for (const BufferHeapAllocation& allocation : heap->allocations) {
+        stats->usedBytes += allocation.block >= 0 ? allocation.size : 0;
+    }
+    if (!heap->freeBySize.empty()) {
+        stats->largestFree = heap->freeBySize.rbegin()->first;
+    }
+    stats->fragmentation = stats->freeBytes > 0 ? 1.0f - (float)stats->largestFree / stats->freeBytes : 0.0f;
+}
+
+void printBufferHeapStats(const BufferHeap* heap) {
+    BufferHeapStats stats;
+    bufferHeapGetStats(heap, &stats);
+    printf("Buffer heap %s: %d blocks %.1f KB, %d allocations %.1f KB, %d free ranges %.1f KB "
+           "(largest %.1f KB), fragmentation %.0f%%\n", heap->label, stats.blocks, stats.capacity / 1024.0,
+           stats.allocations, stats.usedBytes / 1024.0, stats.freeRanges, stats.freeBytes / 1024.0,
+           stats.largestFree / 1024.0, stats.fragmentation * 100.0f);
+}
+
+size_t defragmentBufferHeap(BufferHeap* heap) {
+    // D.1. The live allocations in block and offset order: the packing keeps the meshes of a block together.
+    std::vector<BufferHandle> live;
+    for (size_t idx = 0; idx < heap->allocations.size(); idx++) {
+        if (heap->allocations[idx].block >= 0) {
+            live.push_back((BufferHandle)idx);
+        }
+    }
+    std::sort(live.begin(), live.end(), [heap](BufferHandle a, BufferHandle b) {
+        const BufferHeapAllocation& first = heap->allocations[a];
+        const BufferHeapAllocation& second = heap->allocations[b];
+        return first.block != second.block ? first.block < second.block : first.offset < second.offset;
+    });
+
+    // D.2. Create the new blocks after the old ones, copy each allocation to the end of the last new block.
+    std::vector<BufferHeapBlock> oldBlocks;
+    oldBlocks.swap(heap->blocks);
+    heap->freeBySize.clear();
+    std::vector<size_t> ends;
+    size_t copied = 0;
+    for (BufferHandle handle : live) {
+        BufferHeapAllocation& allocation = heap->allocations[handle];
+        int block = (int)heap->blocks.size() - 1;
+        size_t offset = block >= 0 ? alignUp(ends[block], allocation.alignment) : 0;
+        if (block < 0 || offset + allocation.size > heap->blocks[block].size) {
+            block = createHeapBlock(heap, std::max(heap->blockSize, alignUp(allocation.size, 4096)));
+            ends.push_back(0);
+            offset = 0;
+        }
+        addFreeRange(heap, block, ends[block], offset - ends[block]);
+
+        glBindBuffer(GL_COPY_READ_BUFFER, oldBlocks[allocation.block].buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, heap->blocks[block].buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.offset, offset, allocation.size);
+        copied += allocation.size;
+
+        allocation.block = block;
+        allocation.offset = offset;
+        ends[block] = offset + allocation.size;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    // D.3. The tails of the new blocks are free, the old blocks are deleted (the GPU finishes the copies first).
+    for (size_t block = 0; block < heap->blocks.size(); block++) {
+        addFreeRange(heap, (int)block, ends[block], heap->blocks[block].size - ends[block]);
+    }
+    for (const BufferHeapBlock& block : oldBlocks) {
+        gpuMemoryReleaseBuffers(1, &block.buffer);
+        glDeleteBuffers(1, &block.buffer);
+    }
+
+    heap->generation++;
+    heap->bytesMoved += copied;
+    return copied;
+}
+
+void destroyBufferHeap(BufferHeap* heap) {
+    for (const BufferHeapBlock& block : heap->blocks) {
+        gpuMemoryReleaseBuffers(1, &block.buffer);
+        glDeleteBuffers(1, &block.buffer);
+    }
+    heap->blocks.clear();
+    heap->allocations.clear();
+    heap->freeHandles.clear();
+    heap->freeBySize.clear();
+}
@@ -0,0 +1,134 @@
+/**
+ * GPU buffer heap: many small buffer allocations (meshes, uniform data) in a few large buffers.
+ *
+ * One buffer object per vertex array fragments the driver memory, and every draw of a
+ * different mesh needs its own VAO or buffer binding. The heap suballocates fixed size
+ * blocks (one buffer object each, "blockSize" bytes, larger allocations get a block of
+ * their own): the allocations are handles with the buffer and the byte offset, the meshes
+ * of a block share one VAO (draws with a base vertex and an index offset).
+ *
+ * The free ranges of the blocks are ordered by offset (merged with their freed neighbours)
+ * and by size: an allocation takes the smallest range which fits with its alignment.
+ * Freeing leaves holes; defragmentBufferHeap packs the live allocations into new blocks with
+ * glCopyBufferSubData (the GPU copies, no readback) and deletes the old buffers. The buffers
+ * and offsets of the handles change: "generation" is incremented, the users must refresh
+ * the offsets and rebuild the VAOs of the blocks.
+ *
+ * Usage:
+ *
+ *   BufferHeap heap;
+ *   initBufferHeap(&heap, 1 << 20, GPU_MEMORY_VERTEX, "meshes");
+ *   BufferHandle vertices = bufferHeapAlloc(&heap, vertexBytes, sizeof(Vertex));
+ *   bufferHeapUpload(&heap, vertices, 0, data, vertexBytes);
+ *   // draw: bufferHeapBuffer(&heap, vertices), base vertex: bufferHeapOffset(&heap, vertices) / sizeof(Vertex)
+ *   BufferHeapStats stats;
+ *   bufferHeapGetStats(&heap, &stats);
+ *   if (stats.fragmentation > 0.5f) {
+ *       defragmentBufferHeap(&heap); // then refresh the offsets and the VAOs
+ *   }
+ *   destroyBufferHeap(&heap);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_BUFFER_HEAP_H
+#define GLES_COMMON_BUFFER_HEAP_H
+
+#include <stddef.h>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+// Index into BufferHeap::allocations, -1: no allocation.
+typedef int BufferHandle;
+
+struct BufferHeapBlock {
+    unsigned int buffer;
+    size_t size;
+    std::map<size_t, size_t> freeRanges; // offset -> size
+};
+
+struct BufferHeapAllocation {
+    int block; // -1: free handle
+    size_t offset;
+    size_t size;
+    size_t alignment;
+};
+
+struct BufferHeap {
+    size_t blockSize;
+    int category; // GpuMemoryCategory of the blocks
+    const char* label;
+
+    std::vector<BufferHeapBlock> blocks;
+    std::vector<BufferHeapAllocation> allocations;
+    std::vector<BufferHandle> freeHandles;
+    std::multimap<size_t, std::pair<int, size_t>> freeBySize; // size -> block, offset
+
+    int generation;    // incremented when defragmentBufferHeap moves the allocations
+    size_t bytesMoved; // copied by the defragmentations so far
+};
+
+struct BufferHeapStats {
+    int blocks;
+    int allocations;
+    size_t capacity;     // bytes of the blocks
+    size_t usedBytes;    // bytes of the allocations
+    size_t freeBytes;    // bytes of the free ranges, the alignment padding included
+    size_t largestFree;  // largest free range
+    int freeRanges;
+    float fragmentation; // 1 - largestFree / freeBytes: 0 for one contiguous free range
+};
+
+// Empty heap: the first allocation creates the first block.
+/* "category" is the GpuMemoryCategory of the blocks, "label" their name in the GPU memory report. */
+void initBufferHeap(BufferHeap* heap, size_t blockSize, int category, const char* label);
+
+// Allocate "size" bytes at an offset which is a multiple of "alignment" (any value, not only powers of two).
+/* Ex.: the vertex stride (for the base vertex), the index size or GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT. */
+BufferHandle bufferHeapAlloc(BufferHeap* heap, size_t size, size_t alignment);
+
+void bufferHeapFree(BufferHeap* heap, BufferHandle handle);
+
+// Write into the allocation at "offset" bytes (bound to GL_COPY_WRITE_BUFFER).
+void bufferHeapUpload(BufferHeap* heap, BufferHandle handle, size_t offset, const void* data, size_t size);
+
+// The buffer object and the byte offset of the allocation (valid until the next defragmentation).
+unsigned int bufferHeapBuffer(const BufferHeap* heap, BufferHandle handle);
+size_t bufferHeapOffset(const BufferHeap* heap, BufferHandle handle);
+
+void bufferHeapGetStats(const BufferHeap* heap, BufferHeapStats* stats);
+
+// Print the stats in one line, prefixed with the label of the heap.
+void printBufferHeapStats(const BufferHeap* heap);
+
+// Pack the live allocations into new blocks in their current order and delete the old blocks.
+/* The copies need the old and the new blocks at the same time. Returns the bytes copied. */
+size_t defragmentBufferHeap(BufferHeap* heap);
+
+void destroyBufferHeap(BufferHeap* heap);
+
+#endif // GLES_COMMON_BUFFER_HEAP_H
@@ -0,0 +1,202 @@
+/**
+ * Camera and transform components, see camera.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/camera.h"
+
+#include <math.h>
+#include <string.h>
+
+static const float identityMatrix[16] = {
+    1.0f, 0.0f, 0.0f, 0.0f,
+    0.0f, 1.0f, 0.0f, 0.0f,
+    0.0f, 0.0f, 1.0f, 0.0f,
+    0.0f, 0.0f, 0.0f, 1.0f,
+};
+
+void multiplyMatrix(const float* a, const float* b, float* out) {
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+            out[col * 4 + row] = a[0 * 4 + row] * b[col * 4 + 0] + a[1 * 4 + row] * b[col * 4 + 1] +
+                                 a[2 * 4 + row] * b[col * 4 + 2] + a[3 * 4 + row] * b[col * 4 + 3];
+        }
+    }
+}
+
+// Assign "value" to "target" if they differ, returns true in that case.
+static bool setIfChanged(float* target, const float* value, int count) {
+    if (memcmp(target, value, count * sizeof(float)) == 0) {
+        return false;
+    }
+    memcpy(target, value, count * sizeof(float));
+    return true;
+}
+
+void initCamera(Camera* camera, float fovY, float nearPlane, float farPlane) {
+    camera->fovY = fovY;
+    camera->aspect = 1.0f;
+    camera->nearPlane = nearPlane;
+    camera->farPlane = farPlane;
+    memcpy(camera->view, identityMatrix, sizeof(camera->view));
+    memcpy(camera->projection, identityMatrix, sizeof(camera->projection));
+    memcpy(camera->viewProjection, identityMatrix, sizeof(camera->viewProjection));
+    camera->projectionDirty = true;
+    camera->viewDirty = true;
+    camera->version = 0;
+    camera->updates = 0;
+    camera->skips = 0;
+}
+
+bool cameraSetPerspective(Camera* camera, float fovY, float nearPlane, float farPlane) {
+    if (camera->fovY == fovY && camera->nearPlane == nearPlane && camera->farPlane == farPlane) {
+        return false;
+    }
+    camera->fovY = fovY;
+    camera->nearPlane = nearPlane;
+    camera->farPlane = farPlane;
+    camera->projectionDirty = true;
+    return true;
+}
+
+bool cameraSetViewport(Camera* camera, int width, int height) {
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
+    float aspect = (float)width / (float)height;
+    if (camera->aspect == aspect) {
+        return false;
+    }
+    camera->aspect = aspect;
+    camera->projectionDirty = true;
+    return true;
+}
+
+bool cameraSetView(Camera* camera, const float view[16]) {
+    if (!setIfChanged(camera->view, view, 16)) {
+        return false;
+    }
+    camera->viewDirty = true;
+    return true;
+}
+
+bool updateCamera(Camera* camera) {
+    if (!camera->projectionDirty && !camera->viewDirty) {
+        camera->skips++;
+        return false;
+    }
+
+    // 1. The projection of glm::perspective (right handed, -1..1 depth).
+    if (camera->projectionDirty) {
+        float f = 1.0f / tanf(camera->fovY * 0.5f);
+        float range = camera->farPlane - camera->nearPlane;
+        float* m = camera->projection;
+        memset(m, 0, sizeof(camera->projection));
+        m[0] = f / camera->aspect;
+        m[5] = f;
+        m[10] = -(camera->farPlane + camera->nearPlane) / range;
+        m[11] = -1.0f;
+        m[14] = -2.0f * camera->farPlane * camera->nearPlane / range;
+    }
+
+    // 2. Any change invalidates the product.
+    multiplyMatrix(camera->projection, camera->view, camera->viewProjection);
+
+    camera->projectionDirty = false;
+    camera->viewDirty = false;
+    camera->version++;
+    camera->updates++;
+    return true;
+}
+
+void initTransform(TransformComponent* transform) {
+    const float translation[3] = { 0.0f, 0.0f, 0.0f };
+    const float rotation[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    const float scale[3] = { 1.0f, 1.0f, 1.0f };
+    memcpy(transform->translation, translation, sizeof(translation));
+    memcpy(transform->rotation, rotation, sizeof(rotation));
+    memcpy(transform->scale, scale, sizeof(scale));
+    memcpy(transform->matrix, identityMatrix, sizeof(transform->matrix));
+    transform->dirty = true;
+    transform->version = 0;
+}
+
+bool transformSetTranslation(TransformComponent* transform, float x, float y, float z) {
+    const float translation[3] = { x, y, z };
+    bool changed = setIfChanged(transform->translation, translation, 3);
+    transform->dirty |= changed;
+    return changed;
+}
+
+bool transformSetRotation(TransformComponent* transform, float axisX, float axisY, float axisZ, float radians) {
+    float length = sqrtf(axisX * axisX + axisY * axisY + axisZ * axisZ);
+    float s = length > 0.0f ? sinf(radians * 0.5f) / length : 0.0f;
+    const float rotation[4] = { axisX * s, axisY * s, axisZ * s, cosf(radians * 0.5f) };
+    bool changed = setIfChanged(transform->rotation, rotation, 4);
+    transform->dirty |= changed;
+    return changed;
+}
+
+bool transformSetScale(TransformComponent* transform, float x, float y, float z) {
+    const float scale[3] = { x, y, z };
+    bool changed = setIfChanged(transform->scale, scale, 3);
+    transform->dirty |= changed;
+    return changed;
+}
+
+bool updateTransform(TransformComponent* transform) {
+    if (!transform->dirty) {
+        return false;
+    }
+
+    // translate * rotate * scale: the rotation columns scaled, the translation in the last column.
+    float x = transform->rotation[0];
+    float y = transform->rotation[1];
+    float z = transform->rotation[2];
+    float w = transform->rotation[3];
+    const float* scale = transform->scale;
+    float* m = transform->matrix;
+
+    m[0] = (1.0f - 2.0f * (y * y + z * z)) * scale[0];
+    m[1] = (2.0f * (x * y + w * z)) * scale[0];
+    m[2] = (2.0f * (x * z - w * y)) * scale[0];
+    m[3] = 0.0f;
+
+    m[4] = (2.0f * (x * y - w * z)) * scale[1];
+    m[5] = (1.0f - 2.0f * (x * x + z * z)) * scale[1];
+    m[6] = (2.0f * (y * z + w * x)) * scale[1];
+    m[7] = 0.0f;
+
+    m[8] = (2.0f * (x * z + w * y)) * scale[2];
+    m[9] = (2.0f * (y * z - w * x)) * scale[2];
+    m[10] = (1.0f - 2.0f * (x * x + y * y)) * scale[2];
+    m[11] = 0.0f;
+
+    m[12] = transform->translation[0];
+    m[13] = transform->translation[1];
+    m[14] = transform->translation[2];
+    m[15] = 1.0f;
+
+    transform->dirty = false;
+    transform->version++;
+    return true;
+}
@@ -0,0 +1,122 @@
+/**
+ * Camera and transform components: cached matrices with dirty flags and version counters.
+ *
+ * The inputs (perspective parameters, viewport size, view matrix; the
+ * translation, rotation and scale of an object) are set through setters
+ * which compare the new value with the old one and only mark the component
+ * dirty on a real change. The update recomputes the dirty matrices and
+ * increments the version. Everything derived from the matrices (uniform
+ * uploads, culling results, sorted draw lists) remembers the version it was
+ * computed for and is only redone when the version differs: a static frame
+ * costs a few compares.
+ *
+ * The matrices are column major (like glm and the GL uniforms), the
+ * projection is the one of glm::perspective (right handed, -1..1 depth).
+ *
+ * Usage:
+ *
+ *   Camera camera;
+ *   initCamera(&camera, 45.0f * M_PI / 180.0f, 0.1f, 100.0f);
+ *   TransformComponent model;
+ *   initTransform(&model);
+ *   while (...) {
+ *       cameraSetViewport(&camera, width, height);     // no change: stays clean
+ *       transformSetRotation(&model, 0.0f, 1.0f, 0.0f, angle);
+ *       updateCamera(&camera);
+ *       updateTransform(&model);
+ *       if (camera.version != uploadedVersion) {       // upload, cull, sort ... only on changes
+ *           ...
+ *           uploadedVersion = camera.version;
+ *       }
+ *   }
+ *
+ * Dependencies:
+ *  * C++11
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_CAMERA_H
+#define GLES_COMMON_CAMERA_H
+
+#include <stdint.h>
+
+struct Camera {
+    // Inputs.
+    float fovY;  // radians
+    float aspect;
+    float nearPlane;
+    float farPlane;
+    float view[16];
+
+    // Cached results, valid after updateCamera.
+    float projection[16];
+    float viewProjection[16];
+
+    bool projectionDirty;
+    bool viewDirty;
+    uint32_t version; // incremented by every updateCamera which recomputed something
+
+    // Statistics: the updates which recomputed the matrices and the ones which had nothing to do.
+    int updates;
+    int skips;
+};
+
+// Aspect ratio 1 and identity view, the first updateCamera computes the matrices (version 1).
+void initCamera(Camera* camera, float fovY, float nearPlane, float farPlane);
+
+// The setters only mark the camera dirty if a value changed, return true in that case.
+bool cameraSetPerspective(Camera* camera, float fovY, float nearPlane, float farPlane);
+bool cameraSetViewport(Camera* camera, int width, int height);
+bool cameraSetView(Camera* camera, const float view[16]);
+
+// Recompute the dirty matrices, returns true (and increments the version) if anything changed.
+bool updateCamera(Camera* camera);
+
+struct TransformComponent {
+    // Inputs.
+    float translation[3];
+    float rotation[4]; // unit quaternion (x, y, z, w)
+    float scale[3];
+
+    // translate * rotate * scale, valid after updateTransform.
+    float matrix[16];
+
+    bool dirty;
+    uint32_t version;
+};
+
+// Identity transform, the first updateTransform computes the matrix (version 1).
+void initTransform(TransformComponent* transform);
+
+// The setters only mark the transform dirty if a value changed, return true in that case.
+bool transformSetTranslation(TransformComponent* transform, float x, float y, float z);
+// Rotation around the axis (normalized here) by "radians", like glm::rotate.
+bool transformSetRotation(TransformComponent* transform, float axisX, float axisY, float axisZ, float radians);
+bool transformSetScale(TransformComponent* transform, float x, float y, float z);
+
+// Recompute the matrix if dirty, returns true (and increments the version) in that case.
+bool updateTransform(TransformComponent* transform);
+
+// out = a * b (column major 4x4 matrices, "out" can't be one of the inputs).
+void multiplyMatrix(const float* a, const float* b, float* out);
+
+#endif // GLES_COMMON_CAMERA_H
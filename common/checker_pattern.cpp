@@ -0,0 +1,84 @@
+/**
+ * Procedural checker pattern. See checker_pattern.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/checker_pattern.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common/shader_precision.h"
+
+const char* checkerModeNames[CHECKER_MODE_COUNT] = {
+    "point", "filtered", "filtered-mediump",
+};
+
+const char* checkerPatternSrc = R"(
+float checker(vec2 uv, float repeats) {
+    // The odd cells are in the 2nd half of a two cell period on exactly one axis.
+    vec2 odd = step(0.5, fract(uv * (repeats * 0.5)));
+    return abs(odd.x - odd.y);
+}
+
+float checkerFiltered(vec2 uv, float repeats) {
+    vec2 p = uv * repeats;
+    vec2 width = max(fwidth(p), vec2(0.001));
+
+    // The integral of the +1/-1 square wave is a triangle wave: its difference over the filter width.
+    vec2 p0 = p - 0.5 * width;
+    vec2 p1 = p + 0.5 * width;
+    vec2 wave = 2.0 * (abs(fract(p0 * 0.5) - 0.5) - abs(fract(p1 * 0.5) - 0.5)) / width;
+    return 0.5 - 0.5 * wave.x * wave.y;
+}
+)";
+
+bool parseCheckerMode(const char* name, CheckerMode* mode) {
+    for (int idx = 0; idx < CHECKER_MODE_COUNT; idx++) {
+        if (strcmp(name, checkerModeNames[idx]) == 0) {
+            *mode = (CheckerMode)idx;
+            return true;
+        }
+    }
+
+    printf("Unknown checker mode '%s' (point, filtered, filtered-mediump)\n", name);
+    return false;
+}
+
+std::string checkerShaderSource(const char* source, CheckerMode mode) {
+    std::string result = source;
+
+    // 1. The functions after the precision statement (the line of the first "precision").
+    size_t precision = result.find("precision");
+    size_t lineEnd = precision != std::string::npos ? result.find('\n', precision) : result.find('\n');
+    result.insert(lineEnd + 1, checkerPatternSrc);
+
+    // 2. The mediump variant only changes the default float precision.
+    if (mode == CHECKER_FILTERED_MEDIUMP) {
+        result = precisionShaderSource(result.c_str(), SHADER_PRECISION_MEDIUMP);
+    }
+
+    if (mode != CHECKER_POINT) {
+        result.insert(result.find('\n') + 1, "#define CHECKER_FILTERED\n");
+    }
+    return result;
+}
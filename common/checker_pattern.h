@@ -0,0 +1,82 @@
+/**
+ * Procedural checker pattern for the fragment shaders, point sampled or
+ * box filtered over the pixel footprint.
+ *
+ * The point sampled checker tests which half of a two cell period the
+ * coordinate is in (one fract per axis instead of floor, mod and sign). It
+ * aliases wherever a pixel covers a cell edge or several cells: the far end
+ * of a tilted floor shimmers and the edges are stair-stepped without MSAA.
+ *
+ * The filtered checker integrates the pattern over the pixel footprint
+ * given by the screen space derivatives (fwidth): the box filtered square
+ * wave of each axis has a closed form (the difference of two triangle waves
+ * divided by the filter width), the checker is their product. The edges get
+ * the covered fraction of the pixel and the cells smaller than a pixel fade
+ * to the average (0.5) instead of aliasing, at the cost of a few ALU
+ * operations and no extra samples. The derivatives are only defined in
+ * uniform control flow: call it outside of non-uniform branches.
+ *
+ * The functions use the default float precision of the shader, the
+ * "filtered-mediump" mode is the filtered checker in a mediump fragment
+ * shader (fp16 on most mobile GPUs). The coordinates are fine in mediump as
+ * long as uv * repeats stays small (a few hundred cells).
+ *
+ * Usage:
+ *
+ *   // GLSL: "#ifdef CHECKER_FILTERED" selects checkerFiltered instead of checker
+ *   std::string source = checkerShaderSource(fragment_src, CHECKER_FILTERED);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_CHECKER_PATTERN_H
+#define GLES_COMMON_CHECKER_PATTERN_H
+
+#include <string>
+
+enum CheckerMode {
+    CHECKER_POINT,            // one sample per pixel
+    CHECKER_FILTERED,         // box filtered with the derivatives
+    CHECKER_FILTERED_MEDIUMP, // box filtered, the fragment shader in mediump
+    CHECKER_MODE_COUNT,
+};
+
+// "point", "filtered", "filtered-mediump".
+extern const char* checkerModeNames[CHECKER_MODE_COUNT];
+
+// The mode of a name. Returns false (and prints the valid names) for an unknown name.
+bool parseCheckerMode(const char* name, CheckerMode* mode);
+
+// GLSL functions for the fragment shaders: append it after the precision statements.
+/*   float checker(vec2 uv, float repeats);          1.0 in the odd cells of repeats x repeats cells per uv unit
+ *   float checkerFiltered(vec2 uv, float repeats);  the same averaged over the pixel */
+extern const char* checkerPatternSrc;
+
+// The fragment shader with checkerPatternSrc after its first precision statement.
+/* The filtered modes insert "#define CHECKER_FILTERED" after the #version line, the mediump mode
+ * changes the "precision highp float;" statement to mediump. */
+std::string checkerShaderSource(const char* source, CheckerMode mode);
+
+#endif // GLES_COMMON_CHECKER_PATTERN_H
@@ -0,0 +1,357 @@
+/**
+ * Clustered forward lighting: point lights binned into screen tiles and depth slices by a compute pass.
+ * See clustered_lights.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/clustered_lights.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <vector>
+
+#include <GLES3/gl31.h>
+
+#include "common/gl_state.h"
+
+// Texture unit of the depth texture during the binning.
+#define CLUSTER_DEPTH_UNIT 7
+
+// Invocations of a tile: each one reads 2x2 depth texels.
+#define CLUSTER_GROUP_SIZE (CLUSTER_TILE_SIZE / 2)
+
+#define CLUSTER_STRING_VALUE(value) #value
+#define CLUSTER_STRING(value) CLUSTER_STRING_VALUE(value)
+
+const char* cluster_binning_src = R"(#version 310 es
+precision highp float;
+
+uniform highp sampler2D depthImage;
+uniform mat4 uView;
+uniform vec4 uProjection; // projection[0], projection[5], width, height
+uniform vec4 uDepth;      // near, far, slices / log(far / near)
+
+struct PointLight {
+    vec4 positionRadius;
+    vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer Lights {
+    PointLight lights[];
+};
+
+layout(std430, binding = 1) writeonly buffer Counts {
+    uint counts[];
+};
+
+layout(std430, binding = 2) writeonly buffer Indices {
+    uint indices[];
+};
+
+shared uint sliceMask;
+shared uint sliceCounts[CLUSTER_SLICES];
+
+int depthSlice(float viewDistance) {
+    return clamp(int(log(viewDistance / uDepth.x) * uDepth.z), 0, CLUSTER_SLICES - 1);
+}
+
+void main() {
+    // uParams: light count, tiles x, tiles y
+    uint local = gl_LocalInvocationIndex;
+    uint tileX = gl_WorkGroupID.x;
+    uint tileY = gl_WorkGroupID.y;
+    uint tilesX = uint(uParams.y);
+    uint tilesY = uint(uParams.z);
+    if (local == 0u) {
+        sliceMask = 0u;
+    }
+    if (local < uint(CLUSTER_SLICES)) {
+        sliceCounts[local] = 0u;
+    }
+    barrier();
+
+    // 1. The slices with geometry: window depth -> view space distance -> slice bit.
+    ivec2 size = textureSize(depthImage, 0);
+    ivec2 base = ivec2(gl_WorkGroupID.xy) * CLUSTER_TILE_SIZE + ivec2(gl_LocalInvocationID.xy) * 2;
+    uint mask = 0u;
+    for (int y = 0; y < 2; y++) {
+        for (int x = 0; x < 2; x++) {
+            ivec2 pos = base + ivec2(x, y);
+            if (any(greaterThanEqual(pos, size))) {
+                continue;
+            }
+            float depth = texelFetch(depthImage, pos, 0).r;
+            if (depth < 1.0) {
+                float ndc = depth * 2.0 - 1.0;
+                float viewDistance = 2.0 * uDepth.x * uDepth.y / (uDepth.y + uDepth.x - ndc * (uDepth.y - uDepth.x));
+                mask |= 1u << uint(depthSlice(viewDistance));
+            }
+        }
+    }
+    atomicOr(sliceMask, mask);
+    barrier();
+
+    // 2. Side planes of the tile frustum: x = slope * distance, with the normalization of the plane distance.
+    vec2 ndcMin = vec2(gl_WorkGroupID.xy * uint(CLUSTER_TILE_SIZE)) / uProjection.zw * 2.0 - 1.0;
+    vec2 ndcMax = vec2((gl_WorkGroupID.xy + 1u) * uint(CLUSTER_TILE_SIZE)) / uProjection.zw * 2.0 - 1.0;
+    vec2 slopeMin = ndcMin / uProjection.xy;
+    vec2 slopeMax = ndcMax / uProjection.xy;
+    vec2 scaleMin = inversesqrt(1.0 + slopeMin * slopeMin);
+    vec2 scaleMax = inversesqrt(1.0 + slopeMax * slopeMax);
+
+    uint occupied = sliceMask;
+    int stride = int(gl_WorkGroupSize.x * gl_WorkGroupSize.y);
+    for (int idx = int(local); occupied != 0u && idx < uParams.x; idx += stride) {
+        vec4 light = lights[idx].positionRadius;
+        vec3 pos = (uView * vec4(light.xyz, 1.0)).xyz;
+        float lightDistance = -pos.z;
+        float radius = light.w;
+        if (lightDistance + radius < uDepth.x || lightDistance - radius > uDepth.y) {
+            continue;
+        }
+        bool outside = (pos.x - slopeMin.x * lightDistance) * scaleMin.x < -radius
+                    || (slopeMax.x * lightDistance - pos.x) * scaleMax.x < -radius
+                    || (pos.y - slopeMin.y * lightDistance) * scaleMin.y < -radius
+                    || (slopeMax.y * lightDistance - pos.y) * scaleMax.y < -radius;
+        if (outside) {
+            continue;
+        }
+
+        // 2.1. Every slice of the depth range of the light which has geometry.
+        int first = depthSlice(max(lightDistance - radius, uDepth.x));
+        int last = depthSlice(lightDistance + radius);
+        for (int slice = first; slice <= last; slice++) {
+            if ((occupied & (1u << uint(slice))) == 0u) {
+                continue;
+            }
+            uint at = atomicAdd(sliceCounts[slice], 1u);
+            if (at < uint(CLUSTER_MAX_LIGHTS)) {
+                uint cluster = (uint(slice) * tilesY + tileY) * tilesX + tileX;
+                indices[cluster * uint(CLUSTER_MAX_LIGHTS) + at] = uint(idx);
+            }
+        }
+    }
+    barrier();
+
+    // 3. The counts (not clamped: the overflow is visible in the statistics).
+    if (local < uint(CLUSTER_SLICES)) {
+        counts[(local * tilesY + tileY) * tilesX + tileX] = sliceCounts[local];
+    }
+}
+)";
+
+const char* clusteredLightingSrc =
+    "\n#define CLUSTER_TILE_SIZE " CLUSTER_STRING(CLUSTER_TILE_SIZE)
+    "\n#define CLUSTER_SLICES " CLUSTER_STRING(CLUSTER_SLICES)
+    "\n#define CLUSTER_MAX_LIGHTS " CLUSTER_STRING(CLUSTER_MAX_LIGHTS) R"(
+
+// The list offsets don't fit into the default (mediump) integers of the fragment shaders.
+precision highp int;
+
+struct PointLight {
+    vec4 positionRadius;
+    vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer ClusterLights {
+    PointLight clusterLights[];
+};
+
+layout(std430, binding = 1) readonly buffer ClusterLightCounts {
+    uint clusterLightCounts[];
+};
+
+layout(std430, binding = 2) readonly buffer ClusterLightIndices {
+    uint clusterLightIndices[];
+};
+
+uniform ivec4 clusterGrid;  // tiles x, tiles y, light count
+uniform highp vec4 clusterDepth; // near, far, slices / log(far / near)
+
+int clusterIndex(float viewDepth) {
+    ivec2 tile = ivec2(gl_FragCoord.xy) / CLUSTER_TILE_SIZE;
+    int slice = clamp(int(log(viewDepth / clusterDepth.x) * clusterDepth.z), 0, CLUSTER_SLICES - 1);
+    return (slice * clusterGrid.y + tile.y) * clusterGrid.x + tile.x;
+}
+
+uint clusterLightCount(float viewDepth) {
+    return min(clusterLightCounts[clusterIndex(viewDepth)], uint(CLUSTER_MAX_LIGHTS));
+}
+
+vec3 shadePointLight(int idx, vec3 worldPos, vec3 normal, vec3 albedo) {
+    vec4 light = clusterLights[idx].positionRadius;
+    vec3 toLight = light.xyz - worldPos;
+    float distance2 = dot(toLight, toLight);
+    float radius2 = light.w * light.w;
+    if (distance2 >= radius2) {
+        return vec3(0.0);
+    }
+
+    // Smooth falloff to zero at the radius.
+    float falloff = 1.0 - distance2 / radius2;
+    float lambert = max(dot(normal, toLight * inversesqrt(distance2)), 0.0);
+    return albedo * clusterLights[idx].color.rgb * lambert * falloff * falloff;
+}
+
+vec3 clusteredLighting(vec3 worldPos, vec3 normal, vec3 albedo, float viewDepth) {
+    vec3 result = vec3(0.0);
+#ifdef CLUSTERED_LIGHTS_ALL
+    for (int idx = 0; idx < clusterGrid.z; idx++) {
+        result += shadePointLight(idx, worldPos, normal, albedo);
+    }
+#else
+    int cluster = clusterIndex(viewDepth);
+    uint count = min(clusterLightCounts[cluster], uint(CLUSTER_MAX_LIGHTS));
+    uint base = uint(cluster) * uint(CLUSTER_MAX_LIGHTS);
+    for (uint idx = 0u; idx < count; idx++) {
+        result += shadePointLight(int(clusterLightIndices[base + idx]), worldPos, normal, albedo);
+    }
+#endif
+    return result;
+}
+)";
+
+bool initClusteredLights(ClusteredLights* clusters, int width, int height, int maxLights) {
+    int fragmentBlocks = 0;
+    glGetIntegerv(GL_MAX_FRAGMENT_SHADER_STORAGE_BLOCKS, &fragmentBlocks);
+    if (fragmentBlocks < 3) {
+        printf("Clustered lights: the fragment shaders can read %d storage buffers (3 needed)\n", fragmentBlocks);
+        return false;
+    }
+
+    ComputeDefines defines;
+    computeDefine(&defines, "CLUSTER_TILE_SIZE", CLUSTER_TILE_SIZE);
+    computeDefine(&defines, "CLUSTER_SLICES", CLUSTER_SLICES);
+    computeDefine(&defines, "CLUSTER_MAX_LIGHTS", CLUSTER_MAX_LIGHTS);
+    if (!createComputeKernelSized(&clusters->kernel, cluster_binning_src, CLUSTER_GROUP_SIZE, CLUSTER_GROUP_SIZE, 1,
+                                  &defines)) {
+        return false;
+    }
+    clusters->viewLoc = glGetUniformLocation(clusters->kernel.program, "uView");
+    clusters->projectionLoc = glGetUniformLocation(clusters->kernel.program, "uProjection");
+    clusters->depthLoc = glGetUniformLocation(clusters->kernel.program, "uDepth");
+
+    glUseProgram(clusters->kernel.program);
+    glUniform1i(glGetUniformLocation(clusters->kernel.program, "depthImage"), CLUSTER_DEPTH_UNIT);
+    glUseProgram(0);
+
+    clusters->lights = createStorageBuffer<PointLight>(maxLights);
+    clusters->lightCount = 0;
+    clusters->counts.buffer = 0;
+    clusters->indices.buffer = 0;
+    clusters->nearPlane = 0.1f;
+    clusters->farPlane = 100.0f;
+    clusteredLightsResize(clusters, width, height);
+    return true;
+}
+
+void destroyClusteredLights(ClusteredLights* clusters) {
+    destroyStorageBuffer(&clusters->lights);
+    destroyStorageBuffer(&clusters->counts);
+    destroyStorageBuffer(&clusters->indices);
+    destroyComputeKernel(&clusters->kernel);
+}
+
+void clusteredLightsResize(ClusteredLights* clusters, int width, int height) {
+    if (clusters->counts.buffer != 0) {
+        destroyStorageBuffer(&clusters->counts);
+        destroyStorageBuffer(&clusters->indices);
+    }
+
+    clusters->width = width;
+    clusters->height = height;
+    clusters->tilesX = (width + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE;
+    clusters->tilesY = (height + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE;
+
+    /* The counts start at zero: a cluster list is valid to read even before the first binning. */
+    int clusterCount = clusters->tilesX * clusters->tilesY * CLUSTER_SLICES;
+    std::vector<unsigned int> zeros(clusterCount, 0);
+    clusters->counts = createStorageBuffer<unsigned int>(clusterCount, zeros.data());
+    clusters->indices = createStorageBuffer<unsigned int>(clusterCount * CLUSTER_MAX_LIGHTS);
+}
+
+void clusteredLightsUpload(ClusteredLights* clusters, const PointLight* lights, int count) {
+    clusters->lightCount = count < clusters->lights.count ? count : clusters->lights.count;
+    writeStorageBuffer(clusters->lights, 0, clusters->lightCount, lights);
+}
+
+void clusteredLightsBin(ClusteredLights* clusters, unsigned int depthTexture, const float* view,
+                        const float* projection, float nearPlane, float farPlane) {
+    clusters->nearPlane = nearPlane;
+    clusters->farPlane = farPlane;
+
+    // 1. One work group per tile.
+    glUseProgram(clusters->kernel.program);
+    glUniformMatrix4fv(clusters->viewLoc, 1, GL_FALSE, view);
+    glUniform4f(clusters->projectionLoc, projection[0], projection[5], (float)clusters->width, (float)clusters->height);
+    glUniform4f(clusters->depthLoc, nearPlane, farPlane, CLUSTER_SLICES / logf(farPlane / nearPlane), 0.0f);
+    glUniform4i(clusters->kernel.paramsLoc, clusters->lightCount, clusters->tilesX, clusters->tilesY, 0);
+
+    glActiveTexture(GL_TEXTURE0 + CLUSTER_DEPTH_UNIT);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glActiveTexture(GL_TEXTURE0);
+    stateCacheBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, clusters->lights.buffer);
+    stateCacheBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, clusters->counts.buffer);
+    stateCacheBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, clusters->indices.buffer);
+    computeDispatch(&clusters->kernel, clusters->tilesX * CLUSTER_GROUP_SIZE, clusters->tilesY * CLUSTER_GROUP_SIZE, 1);
+
+    // 2. The cluster lists are read by the fragment shaders of the next draws.
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    glActiveTexture(GL_TEXTURE0 + CLUSTER_DEPTH_UNIT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void clusteredLightsBind(const ClusteredLights* clusters, unsigned int program) {
+    stateCacheBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, clusters->lights.buffer);
+    stateCacheBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, clusters->counts.buffer);
+    stateCacheBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, clusters->indices.buffer);
+
+    glUniform4i(glGetUniformLocation(program, "clusterGrid"), clusters->tilesX, clusters->tilesY,
+                clusters->lightCount, 0);
+    glUniform4f(glGetUniformLocation(program, "clusterDepth"), clusters->nearPlane, clusters->farPlane,
+                CLUSTER_SLICES / logf(clusters->farPlane / clusters->nearPlane), 0.0f);
+}
+
+void clusteredLightsStats(const ClusteredLights* clusters, int* nonEmpty, float* average, int* maximum, int* overflow) {
+    std::vector<unsigned int> counts(clusters->counts.count);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    readStorageBuffer(clusters->counts, 0, clusters->counts.count, counts.data());
+
+    long sum = 0;
+    *nonEmpty = 0;
+    *maximum = 0;
+    *overflow = 0;
+    for (size_t idx = 0; idx < counts.size(); idx++) {
+        int count = (int)counts[idx];
+        if (count == 0) {
+            continue;
+        }
+        (*nonEmpty)++;
+        sum += count;
+        *maximum = count > *maximum ? count : *maximum;
+        *overflow += count > CLUSTER_MAX_LIGHTS ? 1 : 0;
+    }
+    *average = *nonEmpty ? (float)sum / *nonEmpty : 0.0f;
+}
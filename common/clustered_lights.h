@@ -0,0 +1,130 @@
+/**
+ * Clustered forward lighting: point lights binned into screen tiles and depth
+ * slices by a compute pass.
+ *
+ * The view is divided into clusters: CLUSTER_TILE_SIZE x CLUSTER_TILE_SIZE
+ * pixel tiles and CLUSTER_SLICES depth slices (logarithmic between the near
+ * and far planes, so the clusters are roughly cubic). After the depth prepass
+ * the binning kernel runs one work group per tile:
+ *  1. Every invocation reads 2x2 texels of the depth texture, converts them to
+ *     view space distances and marks their slices in a 32 bit mask of the tile
+ *     (shared memory). The slices without any geometry get no lights at all.
+ *  2. The invocations test the lights in parallel against the four side planes
+ *     of the tile frustum, a light which touches it is added to every marked
+ *     slice of its depth range (atomic counters in shared memory).
+ *  3. The counts are written out: at most CLUSTER_MAX_LIGHTS per cluster (the
+ *     overflow is dropped, see clusteredLightsStats).
+ *
+ * The fragment shader finds its cluster from gl_FragCoord and its view depth
+ * and loops only over the lights of the cluster (clusteredLightingSrc): the
+ * shading cost follows the local light density instead of the total light
+ * count. The light list and the cluster lists are storage buffers read by the
+ * fragment shader (GL_MAX_FRAGMENT_SHADER_STORAGE_BLOCKS >= 3 is needed).
+ *
+ * Usage:
+ *
+ *   ClusteredLights clusters;
+ *   initClusteredLights(&clusters, width, height, 1024);
+ *   while (...) {
+ *       clusteredLightsUpload(&clusters, lights, lightCount);       // world space positions
+ *       ... depth prepass into a depth texture ...
+ *       clusteredLightsBin(&clusters, depthTexture, view, projection, nearPlane, farPlane);
+ *       clusteredLightsBind(&clusters, program);                     // the program must be in use
+ *       ... draw, the fragment shader calls clusteredLighting(...) ...
+ *   }
+ *   destroyClusteredLights(&clusters);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.1+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_CLUSTERED_LIGHTS_H
+#define GLES_COMMON_CLUSTERED_LIGHTS_H
+
+#include "common/compute.h"
+
+#define CLUSTER_TILE_SIZE 32
+#define CLUSTER_SLICES 24
+#define CLUSTER_MAX_LIGHTS 128
+
+// std430 layout of a light in the light buffer.
+struct PointLight {
+    float position[3]; // world space
+    float radius;      // no contribution beyond it
+    float color[4];    // rgb: intensity, a: unused
+};
+
+struct ClusteredLights {
+    ComputeKernel kernel;
+    int viewLoc;
+    int projectionLoc;
+    int depthLoc;
+
+    StorageBuffer<PointLight> lights;
+    StorageBuffer<unsigned int> counts;  // lights of every cluster
+    StorageBuffer<unsigned int> indices; // CLUSTER_MAX_LIGHTS entries per cluster
+    int lightCount;
+
+    int width; // of the binned depth texture
+    int height;
+    int tilesX;
+    int tilesY;
+    float nearPlane; // of the last binning
+    float farPlane;
+};
+
+// GLSL functions for the fragment shaders: append it after the precision statements.
+/* Sets the default int precision to highp, declares the storage buffers, the uniforms set by
+ * clusteredLightsBind and:
+ *   uint clusterLightCount(float viewDepth);   lights in the cluster of gl_FragCoord at the view space distance
+ *   vec3 clusteredLighting(vec3 worldPos, vec3 normal, vec3 albedo, float viewDepth);
+ * With "#define CLUSTERED_LIGHTS_ALL" every light is shaded: the reference without the binning. */
+extern const char* clusteredLightingSrc;
+
+// Build the binning kernel and the buffers for a width x height view and up to "maxLights" lights.
+/* Returns false (with a message) if the fragment shaders can't read the storage buffers. */
+bool initClusteredLights(ClusteredLights* clusters, int width, int height, int maxLights);
+
+void destroyClusteredLights(ClusteredLights* clusters);
+
+// Reallocate the cluster lists for a different view size.
+void clusteredLightsResize(ClusteredLights* clusters, int width, int height);
+
+// Replace the lights (at most the "maxLights" of the init).
+void clusteredLightsUpload(ClusteredLights* clusters, const PointLight* lights, int count);
+
+// Bin the lights into the clusters of the depth texture (view and projection: column major matrices).
+/* The texture must be complete for texelFetch (GL_NEAREST, no compare mode), its depth writes are visible
+ * to the kernel without a barrier. The barrier for the fragment shader reads is issued here. */
+void clusteredLightsBin(ClusteredLights* clusters, unsigned int depthTexture, const float* view,
+                        const float* projection, float nearPlane, float farPlane);
+
+// Bind the storage buffers and set the uniforms of clusteredLightingSrc (the program must be in use).
+void clusteredLightsBind(const ClusteredLights* clusters, unsigned int program);
+
+// Read the cluster counts back (waits for the GPU): non-empty clusters, average and maximum of their lights.
+/* "overflow" is the number of clusters which had more than CLUSTER_MAX_LIGHTS lights. For statistics only. */
+void clusteredLightsStats(const ClusteredLights* clusters, int* nonEmpty, float* average, int* maximum, int* overflow);
+
+#endif // GLES_COMMON_CLUSTERED_LIGHTS_H
@@ -0,0 +1,587 @@
+/**
+ * Small compute runtime, see compute.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/compute.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include <GLES3/gl31.h>
+
+#include "common/device_profile.h"
+#include "common/gl_state.h"
+#include "common/gpu_memory.h"
+#include "common/program_cache.h"
+
+void queryComputeLimits(ComputeLimits* limits) {
+    for (int axis = 0; axis < 3; axis++) {
+        glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_SIZE, axis, &limits->maxGroupSize[axis]);
+        glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, axis, &limits->maxGroupCount[axis]);
+    }
+    glGetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &limits->maxGroupInvocations);
+    glGetIntegerv(GL_MAX_COMPUTE_SHARED_MEMORY_SIZE, &limits->maxSharedMemorySize);
+}
+
+void computeDefine(ComputeDefines* defines, const char* name, int value) {
+    char line[256];
+    snprintf(line, sizeof(line), "#define %s %d\n", name, value);
+    defines->text += line;
+}
+
+static std::string floatLiteral(float value) {
+    // 9 significant digits: the value is parsed back to the same float.
+    char number[32];
+    snprintf(number, sizeof(number), "%.9g", value);
+
+    // A whole number would be an int literal in GLSL.
+    std::string literal = number;
+    if (strpbrk(number, ".e") == NULL) {
+        literal += ".0";
+    }
+    return literal;
+}
+
+void computeDefineFloat(ComputeDefines* defines, const char* name, float value) {
+    defines->text += std::string("#define ") + name + " " + floatLiteral(value) + "\n";
+}
+
+void computeDefineFlag(ComputeDefines* defines, const char* name) {
+    defines->text += std::string("#define ") + name + "\n";
+}
+
+const char* computePackingName(ComputePacking packing) {
+    switch (packing) {
+    case COMPUTE_PACK_HALF16: return "half";
+    case COMPUTE_PACK_UNORM16: return "unorm16";
+    default: return "float";
+    }
+}
+
+bool parseComputePacking(const char* name, ComputePacking* packing) {
+    const ComputePacking packings[] = { COMPUTE_PACK_FLOAT32, COMPUTE_PACK_HALF16, COMPUTE_PACK_UNORM16 };
+    for (ComputePacking candidate : packings) {
+        if (strcmp(name, computePackingName(candidate)) == 0) {
+            *packing = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t computePackingSize(ComputePacking packing) {
+    return packing == COMPUTE_PACK_FLOAT32 ? 4 * sizeof(float) : 4 * sizeof(uint16_t);
+}
+
+void computeDefinePacking(ComputeDefines* defines, ComputePacking packing, const float range[4]) {
+    switch (packing) {
+    case COMPUTE_PACK_FLOAT32:
+        defines->text += "#define PACKED_VEC4 vec4\n"
+                         "#define PACK_VEC4(v) (v)\n"
+                         "#define UNPACK_VEC4(p) (p)\n"
+                         "#define UNPACK_ATTRIB(a) (a)\n";
+        break;
+    case COMPUTE_PACK_HALF16:
+        defines->text += "#define PACKED_VEC4 uvec2\n"
+                         "#define PACK_VEC4(v) uvec2(packHalf2x16((v).xy), packHalf2x16((v).zw))\n"
+                         "#define UNPACK_VEC4(p) vec4(unpackHalf2x16((p).x), unpackHalf2x16((p).y))\n"
+                         "#define UNPACK_ATTRIB(a) (a)\n";
+        break;
+    case COMPUTE_PACK_UNORM16:
+        // [-range, range] <-> [0, 1], the attribute is normalized to [0, 1] by the vertex fetch.
+        defines->text += "#define PACK_RANGE vec4(" + floatLiteral(range[0]) + ", " + floatLiteral(range[1]) + ", " +
+                         floatLiteral(range[2]) + ", " + floatLiteral(range[3]) + ")\n";
+        defines->text += "#define PACKED_VEC4 uvec2\n"
+                         "#define PACK_VEC4(v) uvec2(packUnorm2x16((v).xy / PACK_RANGE.xy * 0.5 + 0.5), "
+                         "packUnorm2x16((v).zw / PACK_RANGE.zw * 0.5 + 0.5))\n"
+                         "#define UNPACK_VEC4(p) "
+                         "((vec4(unpackUnorm2x16((p).x), unpackUnorm2x16((p).y)) * 2.0 - 1.0) * PACK_RANGE)\n"
+                         "#define UNPACK_ATTRIB(a) (((a) * 2.0 - 1.0) * PACK_RANGE)\n";
+        break;
+    }
+}
+
+// IEEE half float with round to nearest even (like packHalf2x16), too large values become infinity.
+static uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int floatExponent = (int)((bits >> 23) & 0xff);
+    int exponent = floatExponent - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (floatExponent == 0xff) {
+        return (uint16_t)(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+    }
+    if (exponent >= 31) {
+        return (uint16_t)(sign | 0x7c00);
+    }
+
+    // Denormal halves: the implicit bit is shifted into the 10 bit mantissa.
+    uint32_t shift = 13;
+    uint32_t half = ((uint32_t)exponent << 10);
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return (uint16_t)sign;
+        }
+        mantissa |= 0x800000;
+        shift = 14 - exponent;
+        half = 0;
+    }
+
+    half |= mantissa >> shift;
+    uint32_t rest = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half & 1))) {
+        half++; // a carry into the exponent is the next representable value
+    }
+    return (uint16_t)(sign | half);
+}
+
+static float halfToFloat(uint16_t half) {
+    int exponent = (half >> 10) & 0x1f;
+    int mantissa = half & 0x3ff;
+    float value;
+    if (exponent == 0) {
+        value = ldexpf((float)mantissa, -24);
+    } else if (exponent == 31) {
+        value = mantissa != 0 ? NAN : INFINITY;
+    } else {
+        value = ldexpf((float)(mantissa | 0x400), exponent - 25);
+    }
+    return (half & 0x8000) ? -value : value;
+}
+
+void computePackVec4(ComputePacking packing, const float range[4], const float* values, int count, void* packed) {
+    if (packing == COMPUTE_PACK_FLOAT32) {
+        memcpy(packed, values, (size_t)count * 4 * sizeof(float));
+        return;
+    }
+
+    uint16_t* output = (uint16_t*)packed;
+    for (int idx = 0; idx < count * 4; idx++) {
+        if (packing == COMPUTE_PACK_HALF16) {
+            output[idx] = floatToHalf(values[idx]);
+        } else {
+            float unorm = values[idx] / range[idx % 4] * 0.5f + 0.5f;
+            unorm = unorm < 0.0f ? 0.0f : (unorm > 1.0f ? 1.0f : unorm);
+            output[idx] = (uint16_t)roundf(unorm * 65535.0f);
+        }
+    }
+}
+
+void computeUnpackVec4(ComputePacking packing, const float range[4], const void* packed, int count, float* values) {
+    if (packing == COMPUTE_PACK_FLOAT32) {
+        memcpy(values, packed, (size_t)count * 4 * sizeof(float));
+        return;
+    }
+
+    const uint16_t* input = (const uint16_t*)packed;
+    for (int idx = 0; idx < count * 4; idx++) {
+        if (packing == COMPUTE_PACK_HALF16) {
+            values[idx] = halfToFloat(input[idx]);
+        } else {
+            values[idx] = (input[idx] / 65535.0f * 2.0f - 1.0f) * range[idx % 4];
+        }
+    }
+}
+
+void computePackingAttribFormat(ComputePacking packing, unsigned int* type, bool* normalized) {
+    switch (packing) {
+    case COMPUTE_PACK_HALF16:
+        *type = GL_HALF_FLOAT;
+        *normalized = false;
+        break;
+    case COMPUTE_PACK_UNORM16:
+        *type = GL_UNSIGNED_SHORT;
+        *normalized = true;
+        break;
+    default:
+        *type = GL_FLOAT;
+        *normalized = false;
+        break;
+    }
+}
+
+std::string computeSpecializeSource(const char* source, const ComputeDefines* defines) {
+    std::string result = source;
+    if (defines != NULL) {
+        result.insert(result.find('\n') + 1, defines->text);
+    }
+    return result;
+}
+
+// Z-order decode of the swizzled 2D groups: the group index is a block of 8x8 groups and a Morton index in it.
+static const char* swizzle_prelude_src = R"(
+ivec2 swizzledGroupId() {
+    int group = GROUP_INDEX;
+    int blocksX = (uGridSize.x + LOCAL_SIZE_X * 8 - 1) / (LOCAL_SIZE_X * 8);
+    int block = group >> 6;
+    int morton = group & 63;
+    ivec2 inBlock = ivec2((morton & 1) | ((morton >> 1) & 2) | ((morton >> 2) & 4),
+                          ((morton >> 1) & 1) | ((morton >> 2) & 2) | ((morton >> 3) & 4));
+    return ivec2(block % blocksX, block / blocksX) * 8 + inBlock;
+}
+#define GLOBAL_ID_2D (swizzledGroupId() * ivec2(LOCAL_SIZE_X, LOCAL_SIZE_Y) + ivec2(gl_LocalInvocationID.xy))
+)";
+
+// Insert the local size, the uniforms, the helper macros and the defines after the #version line.
+static void buildKernel(ComputeKernel* kernel, const char* source, const ComputeDefines* defines,
+                        int dimensions, int x, int y, int z, bool swizzle = false) {
+    char prelude[1024];
+    snprintf(prelude, sizeof(prelude),
+             "layout(local_size_x = %d, local_size_y = %d, local_size_z = %d) in;\n"
+             "#define LOCAL_SIZE_X %d\n"
+             "#define LOCAL_SIZE_Y %d\n"
+             "#define LOCAL_SIZE_Z %d\n"
+             "uniform ivec3 uGridSize;\n"
+             "uniform ivec4 uParams;\n"
+             "#define GLOBAL_INDEX int(gl_GlobalInvocationID.y * (gl_NumWorkGroups.x * %du) + gl_GlobalInvocationID.x)\n"
+             "#define GROUP_INDEX int(gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x)\n",
+             x, y, z, x, y, z, x);
+
+    std::string helpers = swizzle ? swizzle_prelude_src : "#define GLOBAL_ID_2D ivec2(gl_GlobalInvocationID.xy)\n";
+    std::string kernelSrc = source;
+    kernelSrc.insert(kernelSrc.find('\n') + 1, std::string(prelude) + helpers + (defines != NULL ? defines->text : ""));
+
+    kernel->program = createCachedComputeProgram(kernelSrc.c_str());
+    kernel->localSize[0] = x;
+    kernel->localSize[1] = y;
+    kernel->localSize[2] = z;
+    kernel->dimensions = dimensions;
+    kernel->swizzle = swizzle;
+    kernel->gridSizeLoc = glGetUniformLocation(kernel->program, "uGridSize");
+    kernel->paramsLoc = glGetUniformLocation(kernel->program, "uParams");
+}
+
+// The local size of a 1D, 2D or 3D kernel without a fixed size.
+static void preferredLocalSize(int dimensions, int size[3]) {
+    ComputeLimits limits;
+    queryComputeLimits(&limits);
+
+    // 1. The preferred sizes: enough invocations to hide the latency, a multiple of the SIMD width of the GPUs.
+    /* The 1D size and the 2D tile are the calibrated ones of the device profile if it's loaded. */
+    const DeviceProfile* profile = deviceProfile();
+    size[0] = (profile != NULL && profile->computeGroupSize > 0) ? profile->computeGroupSize : 256;
+    size[1] = 1;
+    size[2] = 1;
+    if (dimensions == 2) {
+        bool tuned = profile != NULL && profile->computeTile[0] > 0;
+        size[0] = tuned ? profile->computeTile[0] : 16;
+        size[1] = tuned ? profile->computeTile[1] : 16;
+    } else if (dimensions == 3) {
+        size[0] = 8;
+        size[1] = 8;
+        size[2] = 4;
+    }
+
+    // 2. Clamp each axis, then halve the largest axis until the invocation limit is met.
+    for (int axis = 0; axis < 3; axis++) {
+        while (size[axis] > limits.maxGroupSize[axis] && size[axis] > 1) {
+            size[axis] /= 2;
+        }
+    }
+    while (size[0] * size[1] * size[2] > limits.maxGroupInvocations) {
+        int largest = 0;
+        for (int axis = 1; axis < 3; axis++) {
+            if (size[axis] > size[largest]) {
+                largest = axis;
+            }
+        }
+        size[largest] /= 2;
+    }
+}
+
+void createComputeKernel(ComputeKernel* kernel, const char* source, int dimensions, const ComputeDefines* defines) {
+    int size[3];
+    preferredLocalSize(dimensions, size);
+    buildKernel(kernel, source, defines, dimensions, size[0], size[1], size[2]);
+}
+
+bool createComputeKernelSized(ComputeKernel* kernel, const char* source, int x, int y, int z,
+                              const ComputeDefines* defines) {
+    ComputeLimits limits;
+    queryComputeLimits(&limits);
+
+    if (x > limits.maxGroupSize[0] || y > limits.maxGroupSize[1] || z > limits.maxGroupSize[2]
+        || x * y * z > limits.maxGroupInvocations) {
+        printf("Compute: local size %dx%dx%d exceeds the limits (%dx%dx%d, %d invocations)\n", x, y, z,
+               limits.maxGroupSize[0], limits.maxGroupSize[1], limits.maxGroupSize[2], limits.maxGroupInvocations);
+        return false;
+    }
+
+    buildKernel(kernel, source, defines, z > 1 ? 3 : (y > 1 ? 2 : 1), x, y, z);
+    return true;
+}
+
+bool createComputeKernel2D(ComputeKernel* kernel, const char* source, int tileX, int tileY, ComputeSwizzle swizzle,
+                           const ComputeDefines* defines) {
+    const DeviceProfile* profile = deviceProfile();
+    bool swizzled = swizzle == COMPUTE_SWIZZLE_MORTON
+                 || (swizzle == COMPUTE_SWIZZLE_AUTO && profile != NULL && profile->computeTileSwizzle);
+
+    // The default tile: the size of createComputeKernel (calibrated or 16x16, clamped to the limits).
+    if (tileX <= 0 || tileY <= 0) {
+        int size[3];
+        preferredLocalSize(2, size);
+        buildKernel(kernel, source, defines, 2, size[0], size[1], 1, swizzled);
+        return true;
+    }
+
+    ComputeLimits limits;
+    queryComputeLimits(&limits);
+    if (tileX > limits.maxGroupSize[0] || tileY > limits.maxGroupSize[1] || tileX * tileY > limits.maxGroupInvocations) {
+        printf("Compute: tile %dx%d exceeds the limits (%dx%d, %d invocations)\n", tileX, tileY,
+               limits.maxGroupSize[0], limits.maxGroupSize[1], limits.maxGroupInvocations);
+        return false;
+    }
+
+    buildKernel(kernel, source, defines, 2, tileX, tileY, 1, swizzled);
+    return true;
+}
+
+void destroyComputeKernel(ComputeKernel* kernel) {
+    glDeleteProgram(kernel->program);
+    kernel->program = 0;
+}
+
+void initComputeKernelVariants(ComputeKernelVariants* variants, const char* source, int dimensions) {
+    variants->source = source;
+    variants->dimensions = dimensions;
+    variants->kernels.clear();
+}
+
+const ComputeKernel* computeKernelVariant(ComputeKernelVariants* variants, const ComputeDefines* defines,
+                                          int x, int y, int z) {
+    char size[64];
+    snprintf(size, sizeof(size), "%dx%dx%d\n", x, y, z);
+    std::string key = std::string(size) + (defines != NULL ? defines->text : "");
+
+    std::map<std::string, ComputeKernel>::iterator found = variants->kernels.find(key);
+    if (found != variants->kernels.end()) {
+        return &found->second;
+    }
+
+    ComputeKernel kernel;
+    if (x <= 0) {
+        createComputeKernel(&kernel, variants->source, variants->dimensions, defines);
+    } else if (!createComputeKernelSized(&kernel, variants->source, x, y, z, defines)) {
+        return NULL;
+    }
+
+    return &(variants->kernels[key] = kernel);
+}
+
+void destroyComputeKernelVariants(ComputeKernelVariants* variants) {
+    for (std::map<std::string, ComputeKernel>::iterator it = variants->kernels.begin();
+         it != variants->kernels.end(); ++it) {
+        destroyComputeKernel(&it->second);
+    }
+    variants->kernels.clear();
+}
+
+void computeGroupCount(const ComputeKernel* kernel, int x, int y, int z, int groups[3]) {
+    const int grid[3] = { x, y, z };
+    for (int axis = 0; axis < 3; axis++) {
+        groups[axis] = (grid[axis] + kernel->localSize[axis] - 1) / kernel->localSize[axis];
+    }
+
+    // Fold the long 1D grids into the Y axis (see GLOBAL_INDEX).
+    /* The limit is queried once: it's at least 65535 and the same for every context of the process. */
+    static int maxGroupCountX = 0;
+    if (maxGroupCountX == 0) {
+        glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &maxGroupCountX);
+    }
+    // The swizzled 2D grid: whole 8x8 blocks of groups as a 1D list (folded the same way).
+    if (kernel->swizzle) {
+        groups[0] = ((groups[0] + 7) / 8) * ((groups[1] + 7) / 8) * 64;
+        groups[1] = 1;
+    }
+    if ((kernel->dimensions == 1 || kernel->swizzle) && groups[0] > maxGroupCountX) {
+        groups[1] = (groups[0] + maxGroupCountX - 1) / maxGroupCountX;
+        groups[0] = (groups[0] + groups[1] - 1) / groups[1];
+    }
+}
+
+static void dispatchGrid(const ComputeKernel* kernel, const int grid[3], const int* params) {
+    if (kernel->gridSizeLoc >= 0) {
+        glUniform3i(kernel->gridSizeLoc, grid[0], grid[1], grid[2]);
+    }
+    if (kernel->paramsLoc >= 0 && params != NULL) {
+        glUniform4i(kernel->paramsLoc, params[0], params[1], params[2], params[3]);
+    }
+
+    int groups[3];
+    computeGroupCount(kernel, grid[0], grid[1], grid[2], groups);
+    glDispatchCompute(groups[0], groups[1], groups[2]);
+}
+
+void computeDispatch(const ComputeKernel* kernel, int x, int y, int z) {
+    const int grid[3] = { x, y, z };
+    stateCacheUseProgram(kernel->program);
+    dispatchGrid(kernel, grid, NULL);
+}
+
+unsigned int createStorageBufferObject(size_t size, const void* data) {
+    unsigned int buffer;
+    glGenBuffers(1, &buffer);
+    stateCacheBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_DYNAMIC_COPY);
+    gpuMemoryTrackBuffer(buffer, size, GPU_MEMORY_STORAGE, "storage buffer");
+    return buffer;
+}
+
+void writeStorageBufferObject(unsigned int buffer, size_t offset, size_t size, const void* data) {
+    stateCacheBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, size, data);
+}
+
+void readStorageBufferObject(unsigned int buffer, size_t offset, size_t size, void* data) {
+    stateCacheBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    const void* mapped = glMapBufferRange(GL_SHADER_STORAGE_BUFFER, offset, size, GL_MAP_READ_BIT);
+    if (mapped != NULL) {
+        memcpy(data, mapped, size);
+        glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+    }
+}
+
+void destroyStorageBufferObject(unsigned int buffer) {
+    glDeleteBuffers(1, &buffer);
+    gpuMemoryReleaseBuffers(1, &buffer);
+    /* The deleted buffer may be bound and its name can be reused. */
+    stateCacheInvalidate();
+}
+
+void initComputeQueue(ComputeQueue* queue) {
+    queue->dispatches.clear();
+    queue->pendingBarrier = 0;
+    queue->programChanges = 0;
+    queue->bufferBindings = 0;
+    queue->imageBindings = 0;
+    queue->barriers = 0;
+}
+
+void computeQueueAdd(ComputeQueue* queue, const ComputeKernel* kernel, int x, int y, int z) {
+    ComputeDispatch dispatch;
+    memset(&dispatch, 0, sizeof(dispatch));
+    dispatch.kernel = kernel;
+    dispatch.grid[0] = x;
+    dispatch.grid[1] = y;
+    dispatch.grid[2] = z;
+    dispatch.barrier = queue->pendingBarrier;
+    queue->pendingBarrier = 0;
+
+    queue->dispatches.push_back(dispatch);
+}
+
+void computeQueueBind(ComputeQueue* queue, int binding, unsigned int buffer) {
+    if (queue->dispatches.empty() || binding < 0 || binding >= COMPUTE_MAX_BINDINGS) {
+        printf("Compute: invalid binding %d (or no dispatch recorded)\n", binding);
+        return;
+    }
+    queue->dispatches.back().buffers[binding] = buffer;
+}
+
+void computeQueueBindImage(ComputeQueue* queue, int unit, unsigned int texture, unsigned int access, unsigned int format) {
+    if (queue->dispatches.empty() || unit < 0 || unit >= COMPUTE_MAX_IMAGES) {
+        printf("Compute: invalid image unit %d (or no dispatch recorded)\n", unit);
+        return;
+    }
+    ComputeImage& image = queue->dispatches.back().images[unit];
+    image.texture = texture;
+    image.access = access;
+    image.format = format;
+}
+
+void computeQueueParams(ComputeQueue* queue, int p0, int p1, int p2, int p3) {
+    if (queue->dispatches.empty()) {
+        return;
+    }
+    int* params = queue->dispatches.back().params;
+    params[0] = p0;
+    params[1] = p1;
+    params[2] = p2;
+    params[3] = p3;
+}
+
+void computeQueueBarrier(ComputeQueue* queue, unsigned int barrierBits) {
+    queue->pendingBarrier |= barrierBits;
+}
+
+void computeQueueSubmit(ComputeQueue* queue) {
+    queue->programChanges = 0;
+    queue->bufferBindings = 0;
+    queue->imageBindings = 0;
+    queue->barriers = 0;
+
+    /* The queue only tracks the bindings of this submit, the state cache skips the ones still bound from before. */
+    unsigned int program = 0;
+    unsigned int bound[COMPUTE_MAX_BINDINGS] = {};
+    ComputeImage boundImages[COMPUTE_MAX_IMAGES] = {};
+
+    for (size_t idx = 0; idx < queue->dispatches.size(); idx++) {
+        const ComputeDispatch& dispatch = queue->dispatches[idx];
+
+        if (dispatch.barrier != 0) {
+            glMemoryBarrier(dispatch.barrier);
+            queue->barriers++;
+        }
+
+        if (dispatch.kernel->program != program) {
+            program = dispatch.kernel->program;
+            queue->programChanges += stateCacheUseProgram(program) ? 1 : 0;
+        }
+
+        for (int binding = 0; binding < COMPUTE_MAX_BINDINGS; binding++) {
+            if (dispatch.buffers[binding] != 0 && dispatch.buffers[binding] != bound[binding]) {
+                bound[binding] = dispatch.buffers[binding];
+                queue->bufferBindings += stateCacheBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, bound[binding]) ? 1 : 0;
+            }
+        }
+
+        for (int unit = 0; unit < COMPUTE_MAX_IMAGES; unit++) {
+            const ComputeImage& image = dispatch.images[unit];
+            ComputeImage& boundImage = boundImages[unit];
+            if (image.texture != 0 && (image.texture != boundImage.texture || image.access != boundImage.access
+                                       || image.format != boundImage.format)) {
+                boundImage = image;
+                queue->imageBindings += stateCacheBindImageTexture(unit, image.texture, 0, false, 0, image.access,
+                                                                   image.format) ? 1 : 0;
+            }
+        }
+
+        dispatchGrid(dispatch.kernel, dispatch.grid, dispatch.params);
+    }
+
+    if (queue->pendingBarrier != 0) {
+        glMemoryBarrier(queue->pendingBarrier);
+        queue->barriers++;
+    }
+
+    queue->dispatches.clear();
+    queue->pendingBarrier = 0;
+}
@@ -0,0 +1,305 @@
+/**
+ * Small compute runtime: kernels with automatic work group sizes, typed
+ * shader storage buffers and batched dispatch queues.
+ *
+ * Kernels: the source starts with the #version line and doesn't declare the
+ * local size. The runtime selects it from the GL_MAX_COMPUTE_WORK_GROUP_*
+ * limits (256 invocations for 1D or the calibrated size of the device profile,
+ * see device_profile.h, 16x16 for 2D, 8x8x4 for 3D grids) and
+ * inserts after the #version line:
+ *
+ *   layout(local_size_x = X, local_size_y = Y, local_size_z = Z) in;
+ *   #define LOCAL_SIZE_X X (and _Y, _Z)
+ *   uniform ivec3 uGridSize;  // the grid of the dispatch, in invocations
+ *   uniform ivec4 uParams;    // per dispatch parameters
+ *   #define GLOBAL_INDEX ...  // linear index of the invocation in 1D grids
+ *   #define GROUP_INDEX ...   // linear index of the work group in 1D grids
+ *   #define GLOBAL_ID_2D ...  // ivec2 position of the invocation in 2D grids
+ *
+ * Specialization: the kernels can be built with ComputeDefines, "#define"
+ * lines (element counts, feature toggles, ...) inserted after the prelude,
+ * so the constants are folded and the disabled branches are removed by the
+ * compiler instead of being tested at run time. Every variant is a separate
+ * program (and program cache entry), ComputeKernelVariants builds each
+ * combination of defines and local size once and returns it afterwards.
+ *
+ * The work groups only cover whole groups, so the invocations outside of
+ * uGridSize must return. 1D grids above the work group count limit of the X
+ * axis are folded into the Y axis, GLOBAL_INDEX and GROUP_INDEX hide this.
+ *
+ * 2D tiles: createComputeKernel2D selects the tile (the local size, ex.: 8x8,
+ * 16x16 or the calibrated tile of the device profile) and optionally
+ * swizzles the work groups: the groups of 8x8 group blocks run in Z-order
+ * (Morton order) instead of row by row, so the groups running at the same
+ * time touch neighbouring texels and share the texture cache. The swizzled
+ * grid is dispatched as a 1D list of groups, the kernel must take its
+ * position from GLOBAL_ID_2D (not gl_GlobalInvocationID / gl_WorkGroupID)
+ * and return outside uGridSize: the partial blocks at the right and the
+ * bottom edge are padded with whole groups.
+ *
+ * Buffers: StorageBuffer<T> is an array of T in a shader storage buffer. The
+ * kernels declare them as std430 blocks: arrays of scalars, vec2 and vec4
+ * (and structs of these) are tightly packed like the C++ arrays, without the
+ * 16 byte element padding of std140 (vec3 is still aligned to 16 bytes).
+ *
+ * Packed vec4 arrays: the bandwidth bound kernels can store a vec4 in 8
+ * bytes instead of 16, as a uvec2 of packHalf2x16 (half floats: 11 bits of
+ * precision relative to the value) or of packUnorm2x16 (16 bit fixed point
+ * over a [-range, range] interval per component, uniform steps). The kernels
+ * declare "PACKED_VEC4 values[]" and convert with UNPACK_VEC4/PACK_VEC4, the
+ * macros of computeDefinePacking; computePackVec4 converts the CPU data and
+ * computePackingAttribFormat gives the vertex attribute format of the same
+ * buffer (UNPACK_ATTRIB remaps the normalized attribute in the vertex shader).
+ *
+ * Queues: the dispatches are recorded with their buffer and image bindings
+ * and barriers and are issued together by computeQueueSubmit, which skips
+ * the redundant program changes and bindings (across the submits too if the
+ * state cache of gl_state.h is enabled).
+ *
+ * Usage:
+ *
+ *   ComputeKernel kernel;
+ *   createComputeKernel(&kernel, source, 1);
+ *   StorageBuffer<float> values = createStorageBuffer<float>(count, data);
+ *
+ *   ComputeQueue queue;
+ *   initComputeQueue(&queue);
+ *   computeQueueAdd(&queue, &kernel, count, 1, 1);
+ *   computeQueueBind(&queue, 0, values.buffer);
+ *   computeQueueBarrier(&queue, GL_SHADER_STORAGE_BARRIER_BIT); // before the next dispatch
+ *   ...
+ *   computeQueueSubmit(&queue);
+ *
+ *   readStorageBuffer(values, 0, count, result); // waits for the GPU
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.1+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_COMPUTE_H
+#define GLES_COMMON_COMPUTE_H
+
+#include <stddef.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Maximum number of storage buffer bindings of a queued dispatch.
+#define COMPUTE_MAX_BINDINGS 8
+
+// Maximum number of image units of a queued dispatch (the ES 3.1 minimum of GL_MAX_COMPUTE_IMAGE_UNIFORMS).
+#define COMPUTE_MAX_IMAGES 4
+
+struct ComputeLimits {
+    int maxGroupSize[3];
+    int maxGroupInvocations;
+    int maxGroupCount[3];
+    int maxSharedMemorySize; // in bytes
+};
+
+struct ComputeKernel {
+    unsigned int program;
+    int localSize[3];
+    int dimensions;
+    bool swizzle;    // 2D: the work groups run in Z-order blocks (see GLOBAL_ID_2D)
+    int gridSizeLoc; // -1 if the kernel doesn't use uGridSize
+    int paramsLoc;   // -1 if the kernel doesn't use uParams
+};
+
+// Compile time constants of a kernel variant.
+struct ComputeDefines {
+    std::string text; // "#define NAME VALUE" lines
+};
+
+void computeDefine(ComputeDefines* defines, const char* name, int value);
+void computeDefineFloat(ComputeDefines* defines, const char* name, float value);
+// Feature toggle, for "#ifdef NAME" blocks.
+void computeDefineFlag(ComputeDefines* defines, const char* name);
+
+// Storage format of a packed vec4 array (see the header comment).
+enum ComputePacking {
+    COMPUTE_PACK_FLOAT32, // vec4, 16 bytes
+    COMPUTE_PACK_HALF16,  // uvec2 of packHalf2x16, 8 bytes
+    COMPUTE_PACK_UNORM16, // uvec2 of packUnorm2x16 over [-range, range], 8 bytes
+};
+
+const char* computePackingName(ComputePacking packing);
+// Parse "float", "half" or "unorm16", returns false for an unknown name.
+bool parseComputePacking(const char* name, ComputePacking* packing);
+// Bytes of a packed vec4.
+size_t computePackingSize(ComputePacking packing);
+
+// Define PACKED_VEC4, PACK_VEC4(v), UNPACK_VEC4(p) and UNPACK_ATTRIB(a) (range: per component, only used by UNORM16).
+/* The shader sources go through computeSpecializeSource (kernels and vertex shaders alike). */
+void computeDefinePacking(ComputeDefines* defines, ComputePacking packing, const float range[4]);
+
+// CPU side conversions of "count" vec4 values, the same rounding as the GLSL pack functions (out of range: clamped).
+void computePackVec4(ComputePacking packing, const float range[4], const float* values, int count, void* packed);
+void computeUnpackVec4(ComputePacking packing, const float range[4], const void* packed, int count, float* values);
+
+// glVertexAttribPointer type and normalization of a packed vec4 attribute.
+void computePackingAttribFormat(ComputePacking packing, unsigned int* type, bool* normalized);
+
+// Insert the defines after the #version line of a shader source (NULL: no defines).
+std::string computeSpecializeSource(const char* source, const ComputeDefines* defines);
+
+// Query the compute limits of the current context (ES 3.1+).
+void queryComputeLimits(ComputeLimits* limits);
+
+// Build a kernel for a 1D, 2D or 3D grid with the local size selected from the limits.
+/* Uses the program cache; on compile/link error the info log is printed and the process exits. */
+void createComputeKernel(ComputeKernel* kernel, const char* source, int dimensions,
+                         const ComputeDefines* defines = NULL);
+
+// Build a kernel with a fixed local size (ex.: the size of its shared memory arrays).
+/* Returns false if the size exceeds the limits of the context. */
+bool createComputeKernelSized(ComputeKernel* kernel, const char* source, int x, int y, int z,
+                              const ComputeDefines* defines = NULL);
+
+enum ComputeSwizzle {
+    COMPUTE_SWIZZLE_OFF,
+    COMPUTE_SWIZZLE_MORTON, // Z-order of the work groups in blocks of 8x8 groups
+    COMPUTE_SWIZZLE_AUTO,   // the calibrated choice of the device profile (off without a loaded profile)
+};
+
+// Build a kernel for a 2D grid with a tile of tileX * tileY invocations (0: the tile of the device profile or 16x16).
+/* Returns false if the tile exceeds the limits of the context. */
+bool createComputeKernel2D(ComputeKernel* kernel, const char* source, int tileX, int tileY, ComputeSwizzle swizzle,
+                           const ComputeDefines* defines = NULL);
+
+void destroyComputeKernel(ComputeKernel* kernel);
+
+// The specialized variants of a kernel source, built on first use.
+/* The returned kernels stay valid until destroyComputeKernelVariants (they can be recorded into queues). */
+struct ComputeKernelVariants {
+    const char* source;
+    int dimensions;
+    std::map<std::string, ComputeKernel> kernels; // by local size + defines
+};
+
+void initComputeKernelVariants(ComputeKernelVariants* variants, const char* source, int dimensions);
+
+// The kernel of the defines with the local size x * y * z (0: selected from the limits).
+/* Returns NULL if the local size exceeds the limits of the context. */
+const ComputeKernel* computeKernelVariant(ComputeKernelVariants* variants, const ComputeDefines* defines,
+                                          int x = 0, int y = 1, int z = 1);
+
+void destroyComputeKernelVariants(ComputeKernelVariants* variants);
+
+// Work groups needed for a grid of x * y * z invocations.
+void computeGroupCount(const ComputeKernel* kernel, int x, int y, int z, int groups[3]);
+
+// Dispatch a grid right away (the buffers must be bound by the caller).
+void computeDispatch(const ComputeKernel* kernel, int x, int y, int z);
+
+// Untyped storage buffer helpers (the buffers are GL_DYNAMIC_COPY: written and read by the GPU).
+unsigned int createStorageBufferObject(size_t size, const void* data);
+void writeStorageBufferObject(unsigned int buffer, size_t offset, size_t size, const void* data);
+void readStorageBufferObject(unsigned int buffer, size_t offset, size_t size, void* data);
+
+template <typename T>
+struct StorageBuffer {
+    unsigned int buffer;
+    int count;
+};
+
+// Create a buffer of "count" elements, initialized from "data" if it is not NULL.
+template <typename T>
+StorageBuffer<T> createStorageBuffer(int count, const T* data = NULL) {
+    static_assert(sizeof(T) % 4 == 0, "std430 array elements are a multiple of 4 bytes");
+    StorageBuffer<T> result = { createStorageBufferObject((size_t)count * sizeof(T), data), count };
+    return result;
+}
+
+template <typename T>
+void writeStorageBuffer(const StorageBuffer<T>& buffer, int first, int count, const T* data) {
+    writeStorageBufferObject(buffer.buffer, (size_t)first * sizeof(T), (size_t)count * sizeof(T), data);
+}
+
+// Copy elements back to the CPU, waits for the GPU (the writes must be made visible with GL_BUFFER_UPDATE_BARRIER_BIT).
+template <typename T>
+void readStorageBuffer(const StorageBuffer<T>& buffer, int first, int count, T* data) {
+    readStorageBufferObject(buffer.buffer, (size_t)first * sizeof(T), (size_t)count * sizeof(T), data);
+}
+
+void destroyStorageBufferObject(unsigned int buffer);
+
+template <typename T>
+void destroyStorageBuffer(StorageBuffer<T>* buffer) {
+    destroyStorageBufferObject(buffer->buffer);
+    buffer->buffer = 0;
+    buffer->count = 0;
+}
+
+// Level 0 of a texture bound to an image unit (glBindImageTexture).
+struct ComputeImage {
+    unsigned int texture; // 0: not bound by the dispatch
+    unsigned int access;  // GL_READ_ONLY, GL_WRITE_ONLY or GL_READ_WRITE
+    unsigned int format;  // ex.: GL_RGBA8, must match the format qualifier of the kernel
+};
+
+struct ComputeDispatch {
+    const ComputeKernel* kernel;
+    int grid[3];
+    int params[4];
+    unsigned int buffers[COMPUTE_MAX_BINDINGS]; // 0: not bound by the dispatch
+    ComputeImage images[COMPUTE_MAX_IMAGES];
+    unsigned int barrier;                       // glMemoryBarrier bits issued before the dispatch
+};
+
+struct ComputeQueue {
+    std::vector<ComputeDispatch> dispatches;
+    unsigned int pendingBarrier;
+
+    // Statistics of the last submit.
+    int programChanges;
+    int bufferBindings;
+    int imageBindings;
+    int barriers;
+};
+
+void initComputeQueue(ComputeQueue* queue);
+
+// Record a dispatch of a grid (in invocations), the bindings and params below apply to it.
+void computeQueueAdd(ComputeQueue* queue, const ComputeKernel* kernel, int x, int y, int z);
+
+// Bind a storage buffer to the binding point of the last recorded dispatch.
+void computeQueueBind(ComputeQueue* queue, int binding, unsigned int buffer);
+
+// Bind level 0 of an immutable texture (glTexStorage2D) to an image unit of the last recorded dispatch.
+void computeQueueBindImage(ComputeQueue* queue, int unit, unsigned int texture, unsigned int access, unsigned int format);
+
+// Set the uParams value of the last recorded dispatch.
+void computeQueueParams(ComputeQueue* queue, int p0, int p1 = 0, int p2 = 0, int p3 = 0);
+
+// Insert a memory barrier before the next recorded dispatch (the bits are merged).
+void computeQueueBarrier(ComputeQueue* queue, unsigned int barrierBits);
+
+// Issue every recorded dispatch and clear the queue.
+/* A barrier at the end of the queue is issued after the last dispatch. The binds go through the state
+ * cache (gl_state.h) and the last program stays bound. */
+void computeQueueSubmit(ComputeQueue* queue);
+
+#endif // GLES_COMMON_COMPUTE_H
@@ -0,0 +1,615 @@
+/**
+ * Compute primitives (reduce, scan, compact, radix sort), see compute_primitives.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/compute_primitives.h"
+
+#include <stdio.h>
+
+#include <string>
+
+#include <GLES3/gl31.h>
+
+// Inserted after the #version line of every kernel (after the runtime's prelude).
+static const char* primitives_common_src = R"(
+#define TILE (LOCAL_SIZE_X * ITEMS)
+#define SHARED_BARRIER() memoryBarrierShared(); barrier()
+
+shared uint sScan[LOCAL_SIZE_X];
+
+// Exclusive scan of one value per invocation across the work group (Hillis-Steele in shared memory).
+uint workgroupExclusiveScan(uint value, out uint total) {
+    uint lid = gl_LocalInvocationID.x;
+    sScan[lid] = value;
+    SHARED_BARRIER();
+    for (uint offset = 1u; offset < uint(LOCAL_SIZE_X); offset <<= 1u) {
+        uint other = lid >= offset ? sScan[lid - offset] : 0u;
+        SHARED_BARRIER();
+        sScan[lid] += other;
+        SHARED_BARRIER();
+    }
+    total = sScan[LOCAL_SIZE_X - 1];
+    uint result = sScan[lid] - value;
+    SHARED_BARRIER();
+    return result;
+}
+)";
+
+// uParams: x = element count, y = tile count.
+static const char* reduce_src = R"(#version 310 es
+layout(std430, binding = 0) readonly buffer Input { uint values[]; } src;
+layout(std430, binding = 1) writeonly buffer Output { uint values[]; } dst;
+
+shared uint sReduce[LOCAL_SIZE_X];
+
+void main() {
+    int tile = GROUP_INDEX;
+    if (tile >= uParams.y) {
+        return;
+    }
+
+    uint lid = gl_LocalInvocationID.x;
+    int first = tile * TILE + int(lid);
+
+    // 1. Every invocation reduces ITEMS elements (strided for coalesced loads).
+    uint value = IDENTITY;
+    for (int item = 0; item < ITEMS; item++) {
+        int idx = first + item * LOCAL_SIZE_X;
+        if (idx < uParams.x) {
+            value = OP(value, src.values[idx]);
+        }
+    }
+
+    // 2. Tree reduction in shared memory.
+    sReduce[lid] = value;
+    SHARED_BARRIER();
+    for (uint stride = uint(LOCAL_SIZE_X) / 2u; stride > 0u; stride >>= 1u) {
+        if (lid < stride) {
+            sReduce[lid] = OP(sReduce[lid], sReduce[lid + stride]);
+        }
+        SHARED_BARRIER();
+    }
+
+    if (lid == 0u) {
+        dst.values[tile] = sReduce[0];
+    }
+}
+)";
+
+// uParams: x = element count, y = tile count, z = write a zero after the last tile total.
+/* The input can be the output: every element is read and written by the same invocation. */
+static const char* scan_tiles_src = R"(#version 310 es
+layout(std430, binding = 0) buffer Input { uint values[]; } src;
+layout(std430, binding = 1) buffer Output { uint values[]; } dst;
+layout(std430, binding = 2) buffer Sums { uint values[]; } sums;
+
+void main() {
+    int tile = GROUP_INDEX;
+    if (tile >= uParams.y) {
+        return;
+    }
+
+    // 1. Every invocation sums ITEMS consecutive elements.
+    int first = tile * TILE + int(gl_LocalInvocationID.x) * ITEMS;
+    uint items[ITEMS];
+    uint total = 0u;
+    for (int item = 0; item < ITEMS; item++) {
+        int idx = first + item;
+        uint value = idx < uParams.x ? src.values[idx] : 0u;
+#ifdef LOAD_FLAGS
+        value = value != 0u ? 1u : 0u;
+#endif
+        items[item] = value;
+        total += value;
+    }
+
+    // 2. Scan the sums of the invocations, then the elements of the invocation.
+    uint tileTotal;
+    uint prefix = workgroupExclusiveScan(total, tileTotal);
+    for (int item = 0; item < ITEMS; item++) {
+        int idx = first + item;
+        if (idx < uParams.x) {
+#ifdef LOAD_FLAGS
+            // The flag is kept in the top bit for the scatter (the offsets in a tile are below 2^31).
+            dst.values[idx] = prefix | (items[item] << 31);
+#else
+            dst.values[idx] = prefix;
+#endif
+        }
+        prefix += items[item];
+    }
+
+    if (gl_LocalInvocationID.x == 0u) {
+        sums.values[tile] = tileTotal;
+        if (uParams.z != 0 && tile == uParams.y - 1) {
+            sums.values[tile + 1] = 0u;
+        }
+    }
+}
+)";
+
+// The grid is the element count.
+static const char* add_offsets_src = R"(#version 310 es
+layout(std430, binding = 1) buffer Output { uint values[]; } dst;
+layout(std430, binding = 2) readonly buffer Sums { uint values[]; } sums;
+
+void main() {
+    int idx = GLOBAL_INDEX;
+    if (idx >= uGridSize.x) {
+        return;
+    }
+    dst.values[idx] += sums.values[idx / TILE];
+}
+)";
+
+// The grid is the element count. The offsets are the tile scans of the flags, the tile offsets are scanned.
+static const char* compact_scatter_src = R"(#version 310 es
+layout(std430, binding = 0) readonly buffer Values { uint values[]; } src;
+layout(std430, binding = 1) readonly buffer Offsets { uint values[]; } offsets;
+layout(std430, binding = 2) readonly buffer TileOffsets { uint values[]; } tileOffsets;
+layout(std430, binding = 3) writeonly buffer Output { uint values[]; } dst;
+
+void main() {
+    int idx = GLOBAL_INDEX;
+    if (idx >= uGridSize.x) {
+        return;
+    }
+
+    uint offset = offsets.values[idx];
+    if ((offset & 0x80000000u) != 0u) {
+        dst.values[(offset & 0x7fffffffu) + tileOffsets.values[idx / TILE]] = src.values[idx];
+    }
+}
+)";
+
+// dst[uParams.y] = src[uParams.x] (grid of one invocation).
+static const char* copy_element_src = R"(#version 310 es
+layout(std430, binding = 0) readonly buffer Input { uint values[]; } src;
+layout(std430, binding = 1) writeonly buffer Output { uint values[]; } dst;
+
+void main() {
+    if (GLOBAL_INDEX == 0) {
+        dst.values[uParams.y] = src.values[uParams.x];
+    }
+}
+)";
+
+// The grid is the element count: interleave the keys and the values (or split them with UNPACK).
+static const char* sort_pack_src = R"(#version 310 es
+layout(std430, binding = 0) buffer Keys { uint values[]; } keys;
+layout(std430, binding = 1) buffer Values { uint values[]; } values;
+layout(std430, binding = 2) buffer Pairs { uvec2 values[]; } pairs;
+
+void main() {
+    int idx = GLOBAL_INDEX;
+    if (idx >= uGridSize.x) {
+        return;
+    }
+#ifdef UNPACK
+    uvec2 pair = pairs.values[idx];
+    keys.values[idx] = pair.x;
+    values.values[idx] = pair.y;
+#else
+    pairs.values[idx] = uvec2(keys.values[idx], values.values[idx]);
+#endif
+}
+)";
+
+// uParams: x = element count, y = tile count, z = digit shift.
+/* The counts are stored digit major (hist[digit * tileCount + tile]), so their scan gives the global offsets. */
+static const char* sort_histogram_src = R"(#version 310 es
+layout(std430, binding = 0) readonly buffer Input { ELEMENT values[]; } src;
+layout(std430, binding = 1) writeonly buffer Histogram { uint values[]; } hist;
+
+shared uint sBins[16];
+
+void main() {
+    int tile = GROUP_INDEX;
+    if (tile >= uParams.y) {
+        return;
+    }
+
+    uint lid = gl_LocalInvocationID.x;
+    if (lid < 16u) {
+        sBins[lid] = 0u;
+    }
+    SHARED_BARRIER();
+
+    int first = tile * TILE + int(lid);
+    for (int item = 0; item < ITEMS; item++) {
+        int idx = first + item * LOCAL_SIZE_X;
+        if (idx < uParams.x) {
+            atomicAdd(sBins[(KEY(src.values[idx]) >> uint(uParams.z)) & 15u], 1u);
+        }
+    }
+    SHARED_BARRIER();
+
+    if (lid < 16u) {
+        hist.values[int(lid) * uParams.y + tile] = sBins[lid];
+    }
+}
+)";
+
+// uParams: x = element count, y = tile count, z = digit shift. The histogram is scanned.
+static const char* sort_scatter_src = R"(#version 310 es
+layout(std430, binding = 0) readonly buffer Input { ELEMENT values[]; } src;
+layout(std430, binding = 1) writeonly buffer Output { ELEMENT values[]; } dst;
+layout(std430, binding = 2) readonly buffer Histogram { uint values[]; } hist;
+
+shared ELEMENT sElements[TILE];
+shared uint sDigitStart[16];
+
+uint digitOf(ELEMENT element) {
+    return (KEY(element) >> uint(uParams.z)) & 15u;
+}
+
+void main() {
+    int tile = GROUP_INDEX;
+    if (tile >= uParams.y) {
+        return;
+    }
+
+    int lid = int(gl_LocalInvocationID.x);
+    int base = tile * TILE;
+
+    // 1. Load ITEMS consecutive elements, the padding after the last element sorts to the end of the tile.
+    ELEMENT items[ITEMS];
+    for (int item = 0; item < ITEMS; item++) {
+        int idx = base + lid * ITEMS + item;
+        items[item] = idx < uParams.x ? src.values[idx] : ELEMENT(0xffffffffu);
+    }
+
+    // 2. Stable sort of the tile by the digit: one split (zero bits first) per digit bit.
+    for (uint bit = 0u; bit < 4u; bit++) {
+        uint zeros = 0u;
+        for (int item = 0; item < ITEMS; item++) {
+            zeros += 1u - ((digitOf(items[item]) >> bit) & 1u);
+        }
+
+        uint totalZeros;
+        uint zerosBefore = workgroupExclusiveScan(zeros, totalZeros);
+        for (int item = 0; item < ITEMS; item++) {
+            uint localIdx = uint(lid * ITEMS + item);
+            uint isZero = 1u - ((digitOf(items[item]) >> bit) & 1u);
+            uint pos = isZero != 0u ? zerosBefore : totalZeros + localIdx - zerosBefore;
+            zerosBefore += isZero;
+            sElements[pos] = items[item];
+        }
+        SHARED_BARRIER();
+
+        for (int item = 0; item < ITEMS; item++) {
+            items[item] = sElements[lid * ITEMS + item];
+        }
+        SHARED_BARRIER();
+    }
+
+    // 3. The first element of every digit run marks the start of the digit in the tile.
+    for (int item = 0; item < ITEMS; item++) {
+        int localIdx = lid * ITEMS + item;
+        uint digit = digitOf(items[item]);
+        if (localIdx == 0 || digitOf(sElements[localIdx - 1]) != digit) {
+            sDigitStart[digit] = uint(localIdx);
+        }
+    }
+    SHARED_BARRIER();
+
+    // 4. Scatter: global digit offset of the tile + rank in the digit run (strided for coalesced stores).
+    int elementCount = min(TILE, uParams.x - base);
+    for (int item = 0; item < ITEMS; item++) {
+        int localIdx = item * LOCAL_SIZE_X + lid;
+        if (localIdx < elementCount) {
+            ELEMENT element = sElements[localIdx];
+            uint digit = digitOf(element);
+            uint offset = hist.values[int(digit) * uParams.y + tile] + uint(localIdx) - sDigitStart[digit];
+            dst.values[offset] = element;
+        }
+    }
+}
+)";
+
+static const char* reduce_defines[COMPUTE_REDUCE_OP_COUNT] = {
+    "#define OP(a, b) ((a) + (b))\n#define IDENTITY 0u\n",
+    "#define OP(a, b) min(a, b)\n#define IDENTITY 0xffffffffu\n",
+    "#define OP(a, b) max(a, b)\n#define IDENTITY 0u\n",
+};
+
+static const char* sort_keys_defines = "#define ELEMENT uint\n#define KEY(element) (element)\n";
+static const char* sort_pairs_defines = "#define ELEMENT uvec2\n#define KEY(element) (element).x\n";
+
+static void buildKernel(ComputeKernel* kernel, const char* source, const char* defines, int localSize) {
+    char items[32];
+    snprintf(items, sizeof(items), "#define ITEMS %d\n", COMPUTE_PRIMITIVES_ITEMS);
+
+    std::string kernelSrc = source;
+    kernelSrc.insert(kernelSrc.find('\n') + 1, std::string(items) + defines + primitives_common_src);
+
+    createComputeKernelSized(kernel, kernelSrc.c_str(), localSize, 1, 1);
+}
+
+void initComputePrimitives(ComputePrimitives* prims) {
+    // 1. 256 invocations per work group if possible (the ES 3.1 minimum is 128).
+    ComputeLimits limits;
+    queryComputeLimits(&limits);
+    int localSize = (limits.maxGroupInvocations >= 256 && limits.maxGroupSize[0] >= 256) ? 256 : 128;
+    prims->tileSize = localSize * COMPUTE_PRIMITIVES_ITEMS;
+
+    // 2. Build the kernels.
+    for (int op = 0; op < COMPUTE_REDUCE_OP_COUNT; op++) {
+        buildKernel(&prims->reduce[op], reduce_src, reduce_defines[op], localSize);
+    }
+    buildKernel(&prims->scanTiles, scan_tiles_src, "", localSize);
+    buildKernel(&prims->scanFlags, scan_tiles_src, "#define LOAD_FLAGS\n", localSize);
+    buildKernel(&prims->addOffsets, add_offsets_src, "", localSize);
+    buildKernel(&prims->compactScatter, compact_scatter_src, "", localSize);
+    buildKernel(&prims->copyElement, copy_element_src, "", localSize);
+    buildKernel(&prims->sortPack, sort_pack_src, "", localSize);
+    buildKernel(&prims->sortUnpack, sort_pack_src, "#define UNPACK\n", localSize);
+    buildKernel(&prims->sortHistogram, sort_histogram_src, sort_keys_defines, localSize);
+    buildKernel(&prims->sortHistogramPairs, sort_histogram_src, sort_pairs_defines, localSize);
+    buildKernel(&prims->sortScatter, sort_scatter_src, sort_keys_defines, localSize);
+    buildKernel(&prims->sortScatterPairs, sort_scatter_src, sort_pairs_defines, localSize);
+
+    // 3. The scratch buffers are allocated by computePrimitivesReserve.
+    prims->capacity = 0;
+    for (int level = 0; level < COMPUTE_SCAN_LEVELS; level++) {
+        prims->scanSums[level].buffer = 0;
+        prims->scanSums[level].count = 0;
+    }
+    prims->offsets.buffer = 0;
+    prims->histogram.buffer = 0;
+    prims->sortScratch[0].buffer = 0;
+    prims->sortScratch[1].buffer = 0;
+}
+
+static void destroyScratchBuffers(ComputePrimitives* prims) {
+    for (int level = 0; level < COMPUTE_SCAN_LEVELS; level++) {
+        if (prims->scanSums[level].buffer != 0) {
+            destroyStorageBuffer(&prims->scanSums[level]);
+        }
+    }
+    if (prims->capacity > 0) {
+        destroyStorageBuffer(&prims->offsets);
+        destroyStorageBuffer(&prims->histogram);
+        destroyStorageBuffer(&prims->sortScratch[0]);
+        destroyStorageBuffer(&prims->sortScratch[1]);
+    }
+    prims->capacity = 0;
+}
+
+void destroyComputePrimitives(ComputePrimitives* prims) {
+    destroyScratchBuffers(prims);
+
+    for (int op = 0; op < COMPUTE_REDUCE_OP_COUNT; op++) {
+        destroyComputeKernel(&prims->reduce[op]);
+    }
+    destroyComputeKernel(&prims->scanTiles);
+    destroyComputeKernel(&prims->scanFlags);
+    destroyComputeKernel(&prims->addOffsets);
+    destroyComputeKernel(&prims->compactScatter);
+    destroyComputeKernel(&prims->copyElement);
+    destroyComputeKernel(&prims->sortPack);
+    destroyComputeKernel(&prims->sortUnpack);
+    destroyComputeKernel(&prims->sortHistogram);
+    destroyComputeKernel(&prims->sortHistogramPairs);
+    destroyComputeKernel(&prims->sortScatter);
+    destroyComputeKernel(&prims->sortScatterPairs);
+}
+
+static int tileCount(const ComputePrimitives* prims, int count) {
+    return (count + prims->tileSize - 1) / prims->tileSize;
+}
+
+void computePrimitivesReserve(ComputePrimitives* prims, int maxCount) {
+    if (maxCount <= prims->capacity) {
+        return;
+    }
+    destroyScratchBuffers(prims);
+
+    // 1. The largest scanned array is either the input or the sort histogram (16 counts per tile).
+    int tiles = tileCount(prims, maxCount);
+    int scanned = maxCount > tiles * 16 ? maxCount : tiles * 16;
+
+    // 2. Every scan level holds the tile totals of the level below (+1 for the total of a compaction).
+    for (int level = 0; level < COMPUTE_SCAN_LEVELS; level++) {
+        scanned = tileCount(prims, scanned) + 1;
+        prims->scanSums[level] = createStorageBuffer<unsigned int>(scanned);
+    }
+
+    prims->offsets = createStorageBuffer<unsigned int>(maxCount);
+    prims->histogram = createStorageBuffer<unsigned int>(tiles * 16);
+    // Key-value pairs (or only keys).
+    prims->sortScratch[0] = createStorageBuffer<unsigned int>(maxCount * 2);
+    prims->sortScratch[1] = createStorageBuffer<unsigned int>(maxCount * 2);
+    prims->capacity = maxCount;
+}
+
+static bool checkCapacity(const ComputePrimitives* prims, int count, const char* name) {
+    if (count <= 0) {
+        return false;
+    }
+    if (count > prims->capacity) {
+        printf("Compute primitives: %s of %d elements exceeds the reserved %d elements\n", name, count, prims->capacity);
+        return false;
+    }
+    return true;
+}
+
+// Record a dispatch of one work group per tile.
+static void addTiles(ComputeQueue* queue, const ComputeKernel* kernel, int tiles) {
+    computeQueueAdd(queue, kernel, tiles * kernel->localSize[0], 1, 1);
+}
+
+static void recordScan(ComputePrimitives* prims, ComputeQueue* queue, const ComputeKernel* kernel,
+                       unsigned int input, unsigned int output, int count, int level) {
+    if (level >= COMPUTE_SCAN_LEVELS) {
+        printf("Compute primitives: scan of %d elements needs more than %d levels\n", count, COMPUTE_SCAN_LEVELS);
+        return;
+    }
+
+    // 1. Scan the tiles and write the tile totals.
+    int tiles = tileCount(prims, count);
+    unsigned int sums = prims->scanSums[level].buffer;
+    addTiles(queue, kernel, tiles);
+    computeQueueBind(queue, 0, input);
+    computeQueueBind(queue, 1, output);
+    computeQueueBind(queue, 2, sums);
+    computeQueueParams(queue, count, tiles);
+    computeQueueBarrier(queue, GL_SHADER_STORAGE_BARRIER_BIT);
+
+    if (tiles == 1) {
+        return;
+    }
+
+    // 2. Scan the tile totals and add them to the tiles.
+    recordScan(prims, queue, &prims->scanTiles, sums, sums, tiles, level + 1);
+    computeQueueAdd(queue, &prims->addOffsets, count, 1, 1);
+    computeQueueBind(queue, 1, output);
+    computeQueueBind(queue, 2, sums);
+    computeQueueBarrier(queue, GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void computeReduce(ComputePrimitives* prims, ComputeQueue* queue, ComputeReduceOp op,
+                   const StorageBuffer<unsigned int>& input, int count, const StorageBuffer<unsigned int>& result) {
+    if (!checkCapacity(prims, count, "reduce")) {
+        return;
+    }
+
+    /* Every pass reduces the tiles of the previous one into the next scan level, the last one into the result. */
+    unsigned int src = input.buffer;
+    for (int level = 0; level < COMPUTE_SCAN_LEVELS; level++) {
+        int tiles = tileCount(prims, count);
+        unsigned int dst = tiles == 1 ? result.buffer : prims->scanSums[level].buffer;
+
+        addTiles(queue, &prims->reduce[op], tiles);
+        computeQueueBind(queue, 0, src);
+        computeQueueBind(queue, 1, dst);
+        computeQueueParams(queue, count, tiles);
+        computeQueueBarrier(queue, GL_SHADER_STORAGE_BARRIER_BIT);
+
+        if (tiles == 1) {
+            break;
+        }
+        src = dst;
+        count = tiles;
+    }
+}
+
+void computeExclusiveScan(ComputePrimitives* prims, ComputeQueue* queue,
+                          const StorageBuffer<unsigned int>& input, const StorageBuffer<unsigned int>& output, int count) {
+    if (!checkCapacity(prims, count, "scan")) {
+        return;
+    }
+    recordScan(prims, queue, &prims->scanTiles, input.buffer, output.buffer, count, 0);
+}
+
+void computeCompact(ComputePrimitives* prims, ComputeQueue* queue,
+                    const StorageBuffer<unsigned int>& values, const StorageBuffer<unsigned int>& flags, int count,
+                    const StorageBuffer<unsigned int>& output, const StorageBuffer<unsigned int>& keptCount) {
+    if (!checkCapacity(prims, count, "compact")) {
+        return;
+    }
+
+    // 1. Scan the flags per tile, the tile totals are followed by a zero.
+    int tiles = tileCount(prims, count);
+    unsigned int tileOffsets = prims->scanSums[0].buffer;
+    addTiles(queue, &prims->scanFlags, tiles);
+    computeQueueBind(queue, 0, flags.buffer);
+    computeQueueBind(queue, 1, prims->offsets.buffer);
+    computeQueueBind(queue, 2, tileOffsets);
+    computeQueueParams(queue, count, tiles, 1);
+    computeQueueBarrier(queue, GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // 2. Scan the tile totals: the element after the last tile becomes the number of kept values.
+    recordScan(prims, queue, &prims->scanTiles, tileOffsets, tileOffsets, tiles + 1, 1);
+
+    // 3. Write the kept values and copy their count.
+    computeQueueAdd(queue, &prims->compactScatter, count, 1, 1);
+    computeQueueBind(queue, 0, values.buffer);
+    computeQueueBind(queue, 1, prims->offsets.buffer);
+    computeQueueBind(queue, 2, tileOffsets);
+    computeQueueBind(queue, 3, output.buffer);
+    computeQueueBarrier(queue, GL_SHADER_STORAGE_BARRIER_BIT);
+
+    computeQueueAdd(queue, &prims->copyElement, 1, 1, 1);
+    computeQueueBind(queue, 0, tileOffsets);
+    computeQueueBind(queue, 1, keptCount.buffer);
+    computeQueueParams(queue, tiles, 0);
+    computeQueueBarrier(queue, GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void computeRadixSort(ComputePrimitives* prims, ComputeQueue* queue,
+                      const StorageBuffer<unsigned int>& keys, const StorageBuffer<unsigned int>& values, int count) {
+    if (!checkCapacity(prims, count, "sort")) {
+        return;
+    }
+
+    int tiles = tileCount(prims, count);
+    bool pairs = values.buffer != 0;
+    const ComputeKernel* histogramKernel = pairs ? &prims->sortHistogramPairs : &prims->sortHistogram;
+    const ComputeKernel* scatterKernel = pairs ? &prims->sortScatterPairs : &prims->sortScatter;
+
+    // 1. Key-value pairs are interleaved, so a scatter moves both with one store (and 3 bindings).
+    unsigned int src = keys.buffer;
+    unsigned int dst = prims->sortScratch[0].buffer;
+    if (pairs) {
+        computeQueueAdd(queue, &prims->sortPack, count, 1, 1);
+        computeQueueBind(queue, 0, keys.buffer);
+        computeQueueBind(queue, 1, values.buffer);
+        computeQueueBind(queue, 2, prims->sortScratch[0].buffer);
+        computeQueueBarrier(queue, GL_SHADER_STORAGE_BARRIER_BIT);
+
+        src = prims->sortScratch[0].buffer;
+        dst = prims->sortScratch[1].buffer;
+    }
+
+    // 2. One pass per 4 bit digit: count, scan the counts, scatter. After the 8 passes the result is in "src".
+    for (int shift = 0; shift < 32; shift += 4) {
+        addTiles(queue, histogramKernel, tiles);
+        computeQueueBind(queue, 0, src);
+        computeQueueBind(queue, 1, prims->histogram.buffer);
+        computeQueueParams(queue, count, tiles, shift);
+        computeQueueBarrier(queue, GL_SHADER_STORAGE_BARRIER_BIT);
+
+        recordScan(prims, queue, &prims->scanTiles, prims->histogram.buffer, prims->histogram.buffer, tiles * 16, 0);
+
+        addTiles(queue, scatterKernel, tiles);
+        computeQueueBind(queue, 0, src);
+        computeQueueBind(queue, 1, dst);
+        computeQueueBind(queue, 2, prims->histogram.buffer);
+        computeQueueParams(queue, count, tiles, shift);
+        computeQueueBarrier(queue, GL_SHADER_STORAGE_BARRIER_BIT);
+
+        unsigned int swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    // 3. Split the sorted pairs.
+    if (pairs) {
+        computeQueueAdd(queue, &prims->sortUnpack, count, 1, 1);
+        computeQueueBind(queue, 0, keys.buffer);
+        computeQueueBind(queue, 1, values.buffer);
+        computeQueueBind(queue, 2, src);
+        computeQueueBarrier(queue, GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+}
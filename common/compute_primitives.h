@@ -0,0 +1,131 @@
+/**
+ * Data parallel compute primitives over uint storage buffers: reduction
+ * (sum/min/max), exclusive prefix scan, stream compaction and radix sort.
+ *
+ * The kernels work on tiles of COMPUTE_PRIMITIVES_ITEMS elements per
+ * invocation (1024 elements with 256 invocations per work group) and use
+ * the work group shared memory:
+ *  * reduce:  every tile is reduced to one value, repeated until one value is left.
+ *  * scan:    every tile is scanned and writes its total, the totals are scanned
+ *             recursively and added back to the tiles.
+ *  * compact: the flags are scanned into the output offsets of the kept values.
+ *  * sort:    LSD radix sort with 4 bit digits (8 passes). Every pass counts the
+ *             digits per tile, scans the counts and scatters the tiles after a
+ *             stable local sort of the tile in shared memory. Key-value pairs
+ *             are interleaved during the sort.
+ *
+ * A kernel binds at most 4 storage buffers (the ES 3.1 minimum of
+ * GL_MAX_COMPUTE_SHADER_STORAGE_BLOCKS).
+ *
+ * The primitives are recorded into a compute queue (with a storage barrier
+ * after every dispatch), the caller submits the queue. The scratch buffers are
+ * allocated by computePrimitivesReserve for the largest element count.
+ * Empty inputs (count <= 0) record nothing.
+ *
+ * Usage:
+ *
+ *   ComputePrimitives prims;
+ *   initComputePrimitives(&prims);
+ *   computePrimitivesReserve(&prims, count);
+ *
+ *   computeReduce(&prims, &queue, COMPUTE_REDUCE_SUM, values, count, result);
+ *   computeExclusiveScan(&prims, &queue, values, offsets, count);
+ *   computeCompact(&prims, &queue, values, flags, count, kept, keptCount);
+ *   computeRadixSort(&prims, &queue, keys, payload, count);
+ *   computeQueueSubmit(&queue);
+ *
+ *   destroyComputePrimitives(&prims);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.1+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_COMPUTE_PRIMITIVES_H
+#define GLES_COMMON_COMPUTE_PRIMITIVES_H
+
+#include "common/compute.h"
+
+// Elements processed by one invocation of the tile kernels.
+#define COMPUTE_PRIMITIVES_ITEMS 4
+
+// Maximum number of recursive scan levels (tiles of tiles of ...).
+#define COMPUTE_SCAN_LEVELS 6
+
+enum ComputeReduceOp {
+    COMPUTE_REDUCE_SUM, // wraps around at 2^32
+    COMPUTE_REDUCE_MIN,
+    COMPUTE_REDUCE_MAX,
+    COMPUTE_REDUCE_OP_COUNT,
+};
+
+struct ComputePrimitives {
+    ComputeKernel reduce[COMPUTE_REDUCE_OP_COUNT];
+    ComputeKernel scanTiles;
+    ComputeKernel scanFlags;
+    ComputeKernel addOffsets;
+    ComputeKernel compactScatter;
+    ComputeKernel copyElement;
+    ComputeKernel sortPack;
+    ComputeKernel sortUnpack;
+    ComputeKernel sortHistogram;
+    ComputeKernel sortHistogramPairs;
+    ComputeKernel sortScatter;
+    ComputeKernel sortScatterPairs;
+
+    int tileSize; // elements per work group
+
+    // Scratch buffers, sized for "capacity" elements.
+    int capacity;
+    StorageBuffer<unsigned int> scanSums[COMPUTE_SCAN_LEVELS];
+    StorageBuffer<unsigned int> offsets;
+    StorageBuffer<unsigned int> histogram;
+    StorageBuffer<unsigned int> sortScratch[2]; // ping-pong keys or interleaved key-value pairs
+};
+
+// Build the kernels (256 invocations per work group, 128 if the context has a lower limit).
+void initComputePrimitives(ComputePrimitives* prims);
+void destroyComputePrimitives(ComputePrimitives* prims);
+
+// Allocate the scratch buffers for up to "maxCount" elements (no-op if they are already large enough).
+/* Must not be called while recorded primitives are waiting for the submit. */
+void computePrimitivesReserve(ComputePrimitives* prims, int maxCount);
+
+// result[0] = op(input[0], ..., input[count - 1]).
+void computeReduce(ComputePrimitives* prims, ComputeQueue* queue, ComputeReduceOp op,
+                   const StorageBuffer<unsigned int>& input, int count, const StorageBuffer<unsigned int>& result);
+
+// output[i] = input[0] + ... + input[i - 1] (output[0] = 0). The output can be the input buffer.
+void computeExclusiveScan(ComputePrimitives* prims, ComputeQueue* queue,
+                          const StorageBuffer<unsigned int>& input, const StorageBuffer<unsigned int>& output, int count);
+
+// Copy the values with a non-zero flag to the start of "output" (in order), keptCount[0] = number of kept values.
+void computeCompact(ComputePrimitives* prims, ComputeQueue* queue,
+                    const StorageBuffer<unsigned int>& values, const StorageBuffer<unsigned int>& flags, int count,
+                    const StorageBuffer<unsigned int>& output, const StorageBuffer<unsigned int>& keptCount);
+
+// Sort the keys in place (stable), the values (if "values.buffer" is not 0) are moved with their keys.
+void computeRadixSort(ComputePrimitives* prims, ComputeQueue* queue,
+                      const StorageBuffer<unsigned int>& keys, const StorageBuffer<unsigned int>& values, int count);
+
+#endif // GLES_COMMON_COMPUTE_PRIMITIVES_H
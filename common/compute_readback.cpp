@@ -0,0 +1,218 @@
+/**
+ * Asynchronous buffer read back, see compute_readback.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/compute_readback.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <EGL/egl.h>
+#include <GLES3/gl31.h>
+#include <GLES2/gl2ext.h>
+
+#include "common/gpu_memory.h"
+
+static PFNGLBUFFERSTORAGEEXTPROC bufferStorage;
+
+static bool hasGLExtension(const char* name) {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int idx = 0; idx < count; idx++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, idx), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void initComputeReadbacks(ComputeReadbacks* readbacks) {
+    memset(readbacks->slots, 0, sizeof(readbacks->slots));
+    readbacks->stalls = 0;
+
+    readbacks->persistent = false;
+    if (hasGLExtension("GL_EXT_buffer_storage")) {
+        bufferStorage = (PFNGLBUFFERSTORAGEEXTPROC)eglGetProcAddress("glBufferStorageEXT");
+        readbacks->persistent = bufferStorage != NULL;
+    }
+}
+
+static void releaseStaging(ComputeReadbackSlot* slot) {
+    if (slot->fence) {
+        glDeleteSync((GLsync)slot->fence);
+        slot->fence = NULL;
+    }
+    if (slot->buffer != 0) {
+        /* Deleting a buffer unmaps it. */
+        glDeleteBuffers(1, &slot->buffer);
+        gpuMemoryReleaseBuffers(1, &slot->buffer);
+        slot->buffer = 0;
+    }
+    slot->mapped = NULL;
+    slot->capacity = 0;
+}
+
+void destroyComputeReadbacks(ComputeReadbacks* readbacks) {
+    for (int idx = 0; idx < COMPUTE_READBACK_SLOTS; idx++) {
+        releaseStaging(&readbacks->slots[idx]);
+        readbacks->slots[idx].state = COMPUTE_READBACK_FREE;
+    }
+}
+
+// (Re)create the staging buffer of a slot for at least "size" bytes.
+static void reserveStaging(ComputeReadbacks* readbacks, ComputeReadbackSlot* slot, size_t size) {
+    if (slot->buffer != 0 && slot->capacity >= size) {
+        return;
+    }
+    releaseStaging(slot);
+
+    glGenBuffers(1, &slot->buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, slot->buffer);
+    if (readbacks->persistent) {
+        // Immutable storage, mapped for the lifetime of the buffer.
+        GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT_EXT | GL_MAP_COHERENT_BIT_EXT;
+        bufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+        slot->mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+    } else {
+        glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    gpuMemoryTrackBuffer(slot->buffer, size, GPU_MEMORY_TRANSFER, "compute readback staging");
+    slot->capacity = size;
+}
+
+int computeReadbackRequest(ComputeReadbacks* readbacks, unsigned int buffer, size_t offset, size_t size) {
+    int request = -1;
+    for (int idx = 0; idx < COMPUTE_READBACK_SLOTS; idx++) {
+        if (readbacks->slots[idx].state == COMPUTE_READBACK_FREE) {
+            request = idx;
+            break;
+        }
+    }
+    if (request < 0) {
+        printf("Compute readback: all %d slots are in flight\n", COMPUTE_READBACK_SLOTS);
+        return -1;
+    }
+
+    ComputeReadbackSlot* slot = &readbacks->slots[request];
+    reserveStaging(readbacks, slot, size);
+
+    // 1. Make the shader writes visible to the copy, then snapshot the range.
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, slot->buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, 0, size);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    // 2. The fence signals when the copy is done. The flush submits it, so polling makes progress.
+    slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    slot->size = size;
+    slot->state = COMPUTE_READBACK_PENDING;
+    return request;
+}
+
+// The fence of the slot has signaled: map the data (if it isn't persistently mapped).
+static const void* makeReady(ComputeReadbacks* readbacks, ComputeReadbackSlot* slot) {
+    glDeleteSync((GLsync)slot->fence);
+    slot->fence = NULL;
+
+    if (!readbacks->persistent) {
+        /* The copy is done: the map doesn't have to wait for the GPU. */
+        glBindBuffer(GL_COPY_WRITE_BUFFER, slot->buffer);
+        slot->mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, slot->size, GL_MAP_READ_BIT);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    slot->state = COMPUTE_READBACK_READY;
+    return slot->mapped;
+}
+
+static ComputeReadbackSlot* findRequest(ComputeReadbacks* readbacks, int request) {
+    if (request < 0 || request >= COMPUTE_READBACK_SLOTS || readbacks->slots[request].state == COMPUTE_READBACK_FREE) {
+        printf("Compute readback: invalid request %d\n", request);
+        return NULL;
+    }
+    return &readbacks->slots[request];
+}
+
+const void* computeReadbackPoll(ComputeReadbacks* readbacks, int request) {
+    ComputeReadbackSlot* slot = findRequest(readbacks, request);
+    if (slot == NULL) {
+        return NULL;
+    }
+    if (slot->state == COMPUTE_READBACK_READY) {
+        return slot->mapped;
+    }
+
+    if (glClientWaitSync((GLsync)slot->fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        return NULL;
+    }
+    return makeReady(readbacks, slot);
+}
+
+const void* computeReadbackWait(ComputeReadbacks* readbacks, int request) {
+    ComputeReadbackSlot* slot = findRequest(readbacks, request);
+    if (slot == NULL) {
+        return NULL;
+    }
+    if (slot->state == COMPUTE_READBACK_READY) {
+        return slot->mapped;
+    }
+
+    if (glClientWaitSync((GLsync)slot->fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        readbacks->stalls++;
+        glClientWaitSync((GLsync)slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    }
+    return makeReady(readbacks, slot);
+}
+
+void computeReadbackRelease(ComputeReadbacks* readbacks, int request) {
+    ComputeReadbackSlot* slot = findRequest(readbacks, request);
+    if (slot == NULL) {
+        return;
+    }
+
+    if (slot->state == COMPUTE_READBACK_PENDING) {
+        /* Released before it was read: the copy may still run, the staging buffer is only reused after the fence. */
+        glClientWaitSync((GLsync)slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync((GLsync)slot->fence);
+        slot->fence = NULL;
+    } else if (!readbacks->persistent) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, slot->buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        slot->mapped = NULL;
+    }
+    slot->state = COMPUTE_READBACK_FREE;
+}
+
+int computeReadbacksInFlight(const ComputeReadbacks* readbacks) {
+    int count = 0;
+    for (int idx = 0; idx < COMPUTE_READBACK_SLOTS; idx++) {
+        count += readbacks->slots[idx].state != COMPUTE_READBACK_FREE;
+    }
+    return count;
+}
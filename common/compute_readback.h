@@ -0,0 +1,113 @@
+/**
+ * Asynchronous read back of compute results (or any buffer data) to the CPU.
+ *
+ * A request copies a range of a buffer into a free staging buffer on the
+ * GPU timeline (after a GL_BUFFER_UPDATE_BARRIER_BIT barrier) and inserts a
+ * fence. The caller continues with other work, then polls (never blocks) or
+ * waits for the fence to get a mapped view of the copied data. The source
+ * buffer can be reused by the next dispatches right away: the copy is a
+ * snapshot. Up to COMPUTE_READBACK_SLOTS requests can be in flight.
+ *
+ * With GL_EXT_buffer_storage the staging buffers are mapped once,
+ * persistently and coherently: a ready result is read in place without any
+ * map call. Otherwise the staging buffer is mapped when its fence signals,
+ * which doesn't stall either as the copy is already done.
+ *
+ * Usage:
+ *
+ *   ComputeReadbacks readbacks;
+ *   initComputeReadbacks(&readbacks);
+ *
+ *   computeQueueSubmit(&queue);
+ *   int request = computeReadbackRequest(&readbacks, values, 0, count);
+ *   ... other work ...
+ *   const float* result = (const float*)computeReadbackPoll(&readbacks, request); // NULL: not ready yet
+ *   ... or computeReadbackWait ...
+ *   computeReadbackRelease(&readbacks, request);
+ *
+ *   destroyComputeReadbacks(&readbacks);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *  * EGL (for the GL_EXT_buffer_storage entry point)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_COMPUTE_READBACK_H
+#define GLES_COMMON_COMPUTE_READBACK_H
+
+#include <stddef.h>
+
+#include "common/compute.h"
+
+// Number of staging buffers (read backs in flight).
+#define COMPUTE_READBACK_SLOTS 8
+
+enum ComputeReadbackState {
+    COMPUTE_READBACK_FREE,
+    COMPUTE_READBACK_PENDING, // copy and fence issued
+    COMPUTE_READBACK_READY,   // fence signaled, the data is mapped
+};
+
+struct ComputeReadbackSlot {
+    unsigned int buffer;
+    size_t capacity;
+    size_t size;
+    ComputeReadbackState state;
+    void* fence;  // GLsync of the copy
+    void* mapped; // persistent mapping, or the mapping of a ready slot
+};
+
+struct ComputeReadbacks {
+    ComputeReadbackSlot slots[COMPUTE_READBACK_SLOTS];
+    bool persistent; // GL_EXT_buffer_storage persistent mappings
+
+    // Statistics: computeReadbackWait calls which had to block.
+    int stalls;
+};
+
+void initComputeReadbacks(ComputeReadbacks* readbacks);
+void destroyComputeReadbacks(ComputeReadbacks* readbacks);
+
+// Copy "size" bytes of "buffer" at "offset" to a free staging buffer and fence it.
+/* Returns the request (slot index), -1 if every slot is in flight (the copy isn't issued). */
+int computeReadbackRequest(ComputeReadbacks* readbacks, unsigned int buffer, size_t offset, size_t size);
+
+template <typename T>
+int computeReadbackRequest(ComputeReadbacks* readbacks, const StorageBuffer<T>& buffer, int first, int count) {
+    return computeReadbackRequest(readbacks, buffer.buffer, (size_t)first * sizeof(T), (size_t)count * sizeof(T));
+}
+
+// Mapped view of the result if the copy is done, NULL otherwise. Never blocks.
+const void* computeReadbackPoll(ComputeReadbacks* readbacks, int request);
+
+// Mapped view of the result, waits for the copy if needed.
+const void* computeReadbackWait(ComputeReadbacks* readbacks, int request);
+
+// The view isn't used anymore: the slot can take a new request.
+void computeReadbackRelease(ComputeReadbacks* readbacks, int request);
+
+// Number of requests which are not released yet.
+int computeReadbacksInFlight(const ComputeReadbacks* readbacks);
+
+#endif // GLES_COMMON_COMPUTE_READBACK_H
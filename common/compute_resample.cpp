@@ -0,0 +1,436 @@
+/**
+ * Compute scaler and mip generator, see compute_resample.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/compute_resample.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+
+#include <GLES3/gl31.h>
+
+#include "common/gpu_memory.h"
+
+const char* resampleFilterNames[RESAMPLE_FILTER_COUNT] = { "bilinear", "bicubic", "lanczos" };
+const char* resamplePathNames[2] = { "driver", "compute" };
+
+// uGridSize.xy = target size, uParams.x = source size along the axis. VERTICAL, FILTER_* and RADIUS are inserted.
+static const char* scale_src = R"(#version 310 es
+precision highp float;
+precision highp image2D;
+
+layout(binding = 0) uniform highp sampler2D uSource;
+#ifdef VERTICAL
+layout(rgba8, binding = 0) writeonly uniform image2D uTarget;
+#define AXIS(v) (v).yx
+#else
+layout(rgba16f, binding = 0) writeonly uniform image2D uTarget;
+#define AXIS(v) (v).xy
+#endif
+
+float filterWeight(float x) {
+    x = abs(x);
+#if defined(FILTER_BILINEAR)
+    return max(1.0 - x, 0.0);
+#elif defined(FILTER_BICUBIC)
+    // Catmull-Rom: B = 0, C = 0.5.
+    return x < 1.0 ? (1.5 * x - 2.5) * x * x + 1.0 : (x < 2.0 ? ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0 : 0.0);
+#else
+    // Lanczos 3: sinc(x) * sinc(x / 3).
+    if (x < 1e-5) {
+        return 1.0;
+    }
+    float px = 3.14159265 * x;
+    return x < 3.0 ? 3.0 * sin(px) * sin(px / 3.0) / (px * px) : 0.0;
+#endif
+}
+
+void main() {
+    ivec2 pixel = GLOBAL_ID_2D;
+    if (any(greaterThanEqual(pixel, uGridSize.xy))) {
+        return;
+    }
+
+    // 1. The footprint of the target texel along the axis, widened by the scale when downscaling.
+    ivec2 pos = AXIS(pixel);
+    int sourceSize = uParams.x;
+    float scale = float(sourceSize) / float(AXIS(uGridSize.xy).x);
+    float support = clamp(scale, 1.0, float(MAX_SUPPORT));
+    float center = (float(pos.x) + 0.5) * scale - 0.5;
+    int first = int(floor(center - RADIUS * support)) + 1;
+    int last = int(floor(center + RADIUS * support));
+
+    // 2. Normalized weighted sum of the taps (clamped to the edge of the region).
+    vec4 sum = vec4(0.0);
+    float weightSum = 0.0;
+    for (int tap = first; tap <= last; tap++) {
+        float weight = filterWeight((float(tap) - center) / support);
+        sum += weight * texelFetch(uSource, AXIS(ivec2(clamp(tap, 0, sourceSize - 1), pos.y)), 0);
+        weightSum += weight;
+    }
+    imageStore(uTarget, pixel, sum / weightSum);
+}
+)";
+
+// 8x8 work groups, uGridSize.xy = size of the first written level, uParams.x = source level, uParams.y = levels.
+static const char* mipmap_src = R"(#version 310 es
+precision highp float;
+precision highp image2D;
+
+layout(binding = 0) uniform highp sampler2D uSource;
+layout(rgba8, binding = 0) writeonly uniform image2D uLevel1;
+layout(rgba8, binding = 1) writeonly uniform image2D uLevel2;
+layout(rgba8, binding = 2) writeonly uniform image2D uLevel3;
+layout(rgba8, binding = 3) writeonly uniform image2D uLevel4;
+
+shared vec4 sTile[LOCAL_SIZE_X * LOCAL_SIZE_Y];
+
+// The images can't be indexed dynamically.
+void storeLevel(int level, ivec2 texel, vec4 color) {
+    if (level == 1) {
+        imageStore(uLevel1, texel, color);
+    } else if (level == 2) {
+        imageStore(uLevel2, texel, color);
+    } else if (level == 3) {
+        imageStore(uLevel3, texel, color);
+    } else {
+        imageStore(uLevel4, texel, color);
+    }
+}
+
+void main() {
+    ivec2 local = ivec2(gl_LocalInvocationID.xy);
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    int index = local.y * LOCAL_SIZE_X + local.x;
+
+    // 1. The first level: a 2x2 box of the source, the last texel of an odd sized level covers 3 texels.
+    /* Every invocation of the group stays until the last barrier, the ones outside of the level don't store. */
+    ivec2 sourceSize = textureSize(uSource, uParams.x);
+    ivec2 size = uGridSize.xy;
+    ivec2 count = ivec2(2) + ivec2(equal(pixel, size - 1)) * (sourceSize & 1);
+    vec4 color = vec4(0.0);
+    for (int y = 0; y < count.y; y++) {
+        for (int x = 0; x < count.x; x++) {
+            color += texelFetch(uSource, min(pixel * 2 + ivec2(x, y), sourceSize - 1), uParams.x);
+        }
+    }
+    color /= float(count.x * count.y);
+    if (all(lessThan(pixel, size))) {
+        storeLevel(1, pixel, color);
+    }
+    sTile[index] = color;
+
+    // 2. The next levels from the shared memory: the invocations at every "step" texel reduce their 2x2 block.
+    /* The reduced texel replaces the first texel of the block, only its own invocation reads that one. */
+    for (int level = 2; level <= uParams.y; level++) {
+        int step = 1 << (level - 1);
+        int halfStep = step >> 1;
+        size = max(size / 2, ivec2(1));
+
+        memoryBarrierShared();
+        barrier();
+        if (((local.x | local.y) & (step - 1)) == 0) {
+            color = 0.25 * (sTile[index] + sTile[index + halfStep] + sTile[index + halfStep * LOCAL_SIZE_X]
+                            + sTile[index + halfStep * LOCAL_SIZE_X + halfStep]);
+            sTile[index] = color;
+
+            ivec2 texel = pixel >> (level - 1);
+            if (all(lessThan(texel, size))) {
+                storeLevel(level, texel, color);
+            }
+        }
+    }
+}
+)";
+
+ResampleFilter findResampleFilter(const char* name) {
+    int filter = 0;
+    while (filter < RESAMPLE_FILTER_COUNT && strcmp(name, resampleFilterNames[filter]) != 0) {
+        filter++;
+    }
+    return (ResampleFilter)filter;
+}
+
+bool computeResampleSupported() {
+    int major = 0;
+    int minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    return major > 3 || (major == 3 && minor >= 1);
+}
+
+bool initComputeScaler(ComputeScaler* scaler, ResampleFilter filter) {
+    static const char* filterDefines[RESAMPLE_FILTER_COUNT] = { "FILTER_BILINEAR", "FILTER_BICUBIC", "FILTER_LANCZOS" };
+    static const float filterRadius[RESAMPLE_FILTER_COUNT] = { 1.0f, 2.0f, 3.0f };
+
+    memset(scaler, 0, sizeof(*scaler));
+    scaler->filter = filter;
+    if (!computeResampleSupported()) {
+        printf("Compute scaler: compute shaders need Open GL ES 3.1\n");
+        return false;
+    }
+
+    // 1. The same kernel along the two axes.
+    ComputeDefines defines;
+    computeDefineFlag(&defines, filterDefines[filter]);
+    computeDefineFloat(&defines, "RADIUS", filterRadius[filter]);
+    computeDefine(&defines, "MAX_SUPPORT", COMPUTE_SCALER_MAX_SUPPORT);
+    createComputeKernel2D(&scaler->horizontal, scale_src, 0, 0, COMPUTE_SWIZZLE_AUTO, &defines);
+    computeDefineFlag(&defines, "VERTICAL");
+    createComputeKernel2D(&scaler->vertical, scale_src, 0, 0, COMPUTE_SWIZZLE_AUTO, &defines);
+    return true;
+}
+
+void destroyComputeScaler(ComputeScaler* scaler) {
+    if (scaler->horizontal.program == 0) {
+        return;
+    }
+    destroyComputeKernel(&scaler->horizontal);
+    destroyComputeKernel(&scaler->vertical);
+    glDeleteFramebuffers(1, &scaler->outputFbo);
+    const unsigned int textures[] = { scaler->intermediate, scaler->output };
+    glDeleteTextures(2, textures);
+    gpuMemoryReleaseTextures(2, textures);
+    scaler->intermediate = 0;
+    scaler->output = 0;
+    scaler->outputFbo = 0;
+}
+
+static unsigned int createImage(unsigned int format, int width, int height, const char* label) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    gpuMemoryTrackTexture(texture, format, width, height, 1, 1, GPU_MEMORY_RENDER_TARGET, label);
+    return texture;
+}
+
+unsigned int computeScale(ComputeScaler* scaler, unsigned int source, int srcWidth, int srcHeight, int dstWidth,
+                          int dstHeight) {
+    // 1. (Re)create the images for the sizes.
+    if (scaler->intermediate == 0 || scaler->intermediateWidth != dstWidth || scaler->intermediateHeight != srcHeight) {
+        glDeleteTextures(1, &scaler->intermediate);
+        gpuMemoryReleaseTextures(1, &scaler->intermediate);
+        scaler->intermediate = createImage(GL_RGBA16F, dstWidth, srcHeight, "compute scaler rows");
+        scaler->intermediateWidth = dstWidth;
+        scaler->intermediateHeight = srcHeight;
+    }
+    if (scaler->output == 0 || scaler->outputWidth != dstWidth || scaler->outputHeight != dstHeight) {
+        glDeleteTextures(1, &scaler->output);
+        gpuMemoryReleaseTextures(1, &scaler->output);
+        scaler->output = createImage(GL_RGBA8, dstWidth, dstHeight, "compute scaler output");
+        scaler->outputWidth = dstWidth;
+        scaler->outputHeight = dstHeight;
+
+        /* The current framebuffer binding is kept. */
+        GLint previousFbo;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFbo);
+        if (scaler->outputFbo == 0) {
+            glGenFramebuffers(1, &scaler->outputFbo);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, scaler->outputFbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, scaler->output, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+    }
+
+    // 2. The rows: the source region -> dstWidth x srcHeight.
+    /* The render passes writing the source are ordered before the dispatch by the GL. */
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, source);
+    glUseProgram(scaler->horizontal.program);
+    glUniform4i(scaler->horizontal.paramsLoc, srcWidth, 0, 0, 0);
+    glBindImageTexture(0, scaler->intermediate, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    computeDispatch(&scaler->horizontal, dstWidth, srcHeight, 1);
+
+    // 3. The columns: dstWidth x srcHeight -> dstWidth x dstHeight.
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    glBindTexture(GL_TEXTURE_2D, scaler->intermediate);
+    glUseProgram(scaler->vertical.program);
+    glUniform4i(scaler->vertical.paramsLoc, srcHeight, 0, 0, 0);
+    glBindImageTexture(0, scaler->output, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+    computeDispatch(&scaler->vertical, dstWidth, dstHeight, 1);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+    glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    return scaler->outputFbo;
+}
+
+bool initComputeMipGenerator(ComputeMipGenerator* mips) {
+    mips->kernel.program = 0;
+    mips->dispatches = 0;
+    if (!computeResampleSupported()) {
+        printf("Compute mipmaps: compute shaders need Open GL ES 3.1\n");
+        return false;
+    }
+    /* The tile reduction needs the 8x8 groups: 3 halvings down to 1 texel per group. */
+    return createComputeKernelSized(&mips->kernel, mipmap_src, 8, 8, 1);
+}
+
+void destroyComputeMipGenerator(ComputeMipGenerator* mips) {
+    if (mips->kernel.program != 0) {
+        destroyComputeKernel(&mips->kernel);
+    }
+}
+
+int mipLevelCount(int width, int height) {
+    int levels = 1;
+    while (width > 1 || height > 1) {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        levels++;
+    }
+    return levels;
+}
+
+void computeGenerateMipmap(ComputeMipGenerator* mips, unsigned int texture, int width, int height, int levels) {
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glUseProgram(mips->kernel.program);
+    mips->dispatches = 0;
+
+    // 1. One dispatch per run of levels: up to COMPUTE_MIPMAP_LEVELS, the run ends after an odd sized level.
+    int sourceLevel = 0;
+    while (sourceLevel + 1 < levels) {
+        int firstWidth = width > 1 ? width / 2 : 1;
+        int firstHeight = height > 1 ? height / 2 : 1;
+        int count = 0;
+        do {
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+            count++;
+            glBindImageTexture(count - 1, texture, sourceLevel + count, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+        } while (count < COMPUTE_MIPMAP_LEVELS && sourceLevel + count + 1 < levels && width % 2 == 0 && height % 2 == 0);
+
+        /* The previous dispatch wrote the source level. */
+        if (sourceLevel > 0) {
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        }
+        glUniform4i(mips->kernel.paramsLoc, sourceLevel, count, 0, 0);
+        computeDispatch(&mips->kernel, firstWidth, firstHeight, 1);
+        mips->dispatches++;
+        sourceLevel += count;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+// Milliseconds per run of "run" (warmed up, timed between glFinish calls).
+template <typename Run>
+static double measure(Run run) {
+    const int frames = 20;
+    for (int frame = 0; frame < 3; frame++) {
+        run();
+    }
+    glFinish();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++) {
+        run();
+    }
+    glFinish();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000.0 / frames;
+}
+
+// The framebuffer binding is restored by the caller.
+static unsigned int createBenchmarkTexture(int width, int height, int levels, unsigned int* fbo) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, *fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    glClearColor(0.2f, 0.4f, 0.6f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    return texture;
+}
+
+ResamplePath selectScalePath(int srcWidth, int srcHeight, int dstWidth, int dstHeight, ResampleBenchmark* result) {
+    GLint previousFbo;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFbo);
+    unsigned int fbos[2];
+    unsigned int textures[2] = {
+        createBenchmarkTexture(srcWidth, srcHeight, 1, &fbos[0]),
+        createBenchmarkTexture(dstWidth, dstHeight, 1, &fbos[1]),
+    };
+
+    // 1. The driver: one filtered blit.
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbos[0]);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[1]);
+    result->driverMs = measure([&]() {
+        glBlitFramebuffer(0, 0, srcWidth, srcHeight, 0, 0, dstWidth, dstHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    });
+
+    // 2. The compute scaler and the 1:1 copy of its output into the destination.
+    result->computeMs = 0.0;
+    ComputeScaler scaler;
+    if (initComputeScaler(&scaler, RESAMPLE_BILINEAR)) {
+        result->computeMs = measure([&]() {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, computeScale(&scaler, textures[0], srcWidth, srcHeight, dstWidth, dstHeight));
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[1]);
+            glBlitFramebuffer(0, 0, dstWidth, dstHeight, 0, 0, dstWidth, dstHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        });
+        destroyComputeScaler(&scaler);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+    glDeleteFramebuffers(2, fbos);
+    glDeleteTextures(2, textures);
+    return result->computeMs > 0.0 && result->computeMs < result->driverMs ? RESAMPLE_COMPUTE : RESAMPLE_DRIVER;
+}
+
+ResamplePath selectMipmapPath(ComputeMipGenerator* mips, int width, int height, ResampleBenchmark* result) {
+    GLint previousFbo;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFbo);
+    unsigned int fbo;
+    int levels = mipLevelCount(width, height);
+    unsigned int texture = createBenchmarkTexture(width, height, levels, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+
+    result->driverMs = measure([&]() {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    });
+
+    result->computeMs = 0.0;
+    if (mips != NULL && mips->kernel.program != 0) {
+        result->computeMs = measure([&]() { computeGenerateMipmap(mips, texture, width, height, levels); });
+    }
+
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &texture);
+    return result->computeMs > 0.0 && result->computeMs < result->driverMs ? RESAMPLE_COMPUTE : RESAMPLE_DRIVER;
+}
@@ -0,0 +1,155 @@
+/**
+ * Compute shader replacements of the driver's scaling and mipmap paths, and a benchmark which picks
+ * the faster one on the device.
+ *
+ * Scaler: glBlitFramebuffer(..., GL_LINEAR) only filters bilinearly (2x2 texels, it aliases when the
+ * image is minified) and its cost is up to the driver. computeScale resamples with a separable filter
+ * in two dispatches: the rows into an RGBA16F intermediate image (the negative lobes of the bicubic
+ * and Lanczos filters overshoot) and the columns into the RGBA8 output image. When the image is
+ * downscaled the filter is widened by the scale (at most COMPUTE_SCALER_MAX_SUPPORT), so every
+ * source texel contributes. The filters:
+ *
+ *  bilinear    tent filter, 2 taps per axis when upscaling, the same image as the blit
+ *  bicubic     Catmull-Rom spline, 4 taps per axis
+ *  lanczos     Lanczos 3 windowed sinc, 6 taps per axis
+ *
+ * Mipmaps: glGenerateMipmap usually runs one pass per level (with a flush of the render target
+ * between them on the tile based GPUs). computeGenerateMipmap writes up to COMPUTE_MIPMAP_LEVELS
+ * levels with one dispatch: every 8x8 work group averages a 16x16 tile of the source level into its
+ * 8x8 texels of the first level and keeps them in shared memory, the next levels are reduced from
+ * there (4x4, 2x2 and 1x1 texels of the tile) without another dispatch or memory round trip. A
+ * dispatch stops after a level with an odd size: the last texel of its next level also covers the
+ * extra row/column, which can belong to the next tile. The levels must be immutable (glTexStorage2D)
+ * RGBA8 (image load/store).
+ *
+ * The benchmarks run a few warm-up and 20 timed passes of each path between glFinish calls and return
+ * the faster path (the compute path is only a candidate if the device has ES 3.1).
+ *
+ * Usage:
+ *
+ *   ComputeScaler scaler;
+ *   initComputeScaler(&scaler, RESAMPLE_LANCZOS);
+ *   unsigned int fbo = computeScale(&scaler, sourceTexture, srcWidth, srcHeight, dstWidth, dstHeight);
+ *   glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo); // the scaled image, 1:1 blit into the window
+ *   destroyComputeScaler(&scaler);
+ *
+ *   ComputeMipGenerator mips;
+ *   initComputeMipGenerator(&mips);
+ *   computeGenerateMipmap(&mips, texture, width, height, levels);
+ *   destroyComputeMipGenerator(&mips);
+ *
+ *   ResampleBenchmark result;
+ *   ResamplePath path = selectMipmapPath(&mips, width, height, &result);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+ (the compute paths: Open GL ES 3.1+)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_COMPUTE_RESAMPLE_H
+#define GLES_COMMON_COMPUTE_RESAMPLE_H
+
+#include "common/compute.h"
+
+// Widest filter footprint when downscaling, in filter radii (the loop bound of the scaler kernel).
+#define COMPUTE_SCALER_MAX_SUPPORT 4
+
+// Levels written by one mipmap dispatch (the ES 3.1 minimum of the compute image units).
+#define COMPUTE_MIPMAP_LEVELS 4
+
+enum ResampleFilter {
+    RESAMPLE_BILINEAR,
+    RESAMPLE_BICUBIC,
+    RESAMPLE_LANCZOS,
+    RESAMPLE_FILTER_COUNT,
+};
+
+extern const char* resampleFilterNames[RESAMPLE_FILTER_COUNT];
+
+// The filter of a name, RESAMPLE_FILTER_COUNT if there is no such filter.
+ResampleFilter findResampleFilter(const char* name);
+
+enum ResamplePath {
+    RESAMPLE_DRIVER,  // glBlitFramebuffer / glGenerateMipmap
+    RESAMPLE_COMPUTE, // computeScale / computeGenerateMipmap
+};
+
+extern const char* resamplePathNames[2];
+
+// True if the context has compute shaders (ES 3.1+).
+bool computeResampleSupported();
+
+struct ComputeScaler {
+    ComputeKernel horizontal;
+    ComputeKernel vertical;
+    ResampleFilter filter;
+
+    // The intermediate (RGBA16F, output width x source height) and the output (RGBA8) images.
+    unsigned int intermediate;
+    int intermediateWidth;
+    int intermediateHeight;
+    unsigned int output;
+    unsigned int outputFbo;
+    int outputWidth;
+    int outputHeight;
+};
+
+// Build the kernels of the filter. Returns false without compute shaders.
+bool initComputeScaler(ComputeScaler* scaler, ResampleFilter filter);
+void destroyComputeScaler(ComputeScaler* scaler);
+
+// Scale the bottom left srcWidth x srcHeight region of a color texture to dstWidth x dstHeight.
+/* The images are (re)created for the sizes. Returns the framebuffer of the output image, the writes
+ * are made visible to the blits and the texture fetches. Leaves GL_TEXTURE_2D of unit 0 unbound. */
+unsigned int computeScale(ComputeScaler* scaler, unsigned int source, int srcWidth, int srcHeight, int dstWidth,
+                          int dstHeight);
+
+struct ComputeMipGenerator {
+    ComputeKernel kernel;
+    int dispatches; // of the last computeGenerateMipmap
+};
+
+// Build the kernel. Returns false without compute shaders.
+bool initComputeMipGenerator(ComputeMipGenerator* mips);
+void destroyComputeMipGenerator(ComputeMipGenerator* mips);
+
+// Write the levels 1 ... levels - 1 of an immutable RGBA8 texture from its level 0.
+/* The levels are made visible to the texture fetches. Leaves GL_TEXTURE_2D of unit 0 unbound. */
+void computeGenerateMipmap(ComputeMipGenerator* mips, unsigned int texture, int width, int height, int levels);
+
+// Levels of the full mip chain of a size.
+int mipLevelCount(int width, int height);
+
+// Measured cost of the two paths.
+struct ResampleBenchmark {
+    double driverMs;
+    double computeMs; // 0 if there are no compute shaders
+};
+
+// Compare the driver blit (GL_LINEAR) with the bilinear compute scaler for the sizes.
+ResamplePath selectScalePath(int srcWidth, int srcHeight, int dstWidth, int dstHeight, ResampleBenchmark* result);
+
+// Compare glGenerateMipmap with computeGenerateMipmap on an RGBA8 texture of the size (NULL mips: the driver path).
+ResamplePath selectMipmapPath(ComputeMipGenerator* mips, int width, int height, ResampleBenchmark* result);
+
+#endif // GLES_COMMON_COMPUTE_RESAMPLE_H
@@ -0,0 +1,131 @@
+/**
+ * GPU reset detection and the resource registry, see context_recovery.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/context_recovery.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#include "common/gl_handle.h"
+#include "common/gl_state.h"
+#include "common/sampler_cache.h"
+
+struct GpuResourceGroup {
+    int id;
+    const char* name;
+    GpuResourceCallback release;
+    GpuResourceCallback rebuild;
+    void* user;
+};
+
+struct ResourceRegistry {
+    std::vector<GpuResourceGroup> groups;
+    int nextId;
+    bool resetStatusLoaded;
+    PFNGLGETGRAPHICSRESETSTATUSKHRPROC getGraphicsResetStatus;
+};
+
+static ResourceRegistry& resourceRegistry() {
+    static ResourceRegistry registry;
+    return registry;
+}
+
+static bool hasGLExtension(const char* name) {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int idx = 0; idx < count; idx++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, idx), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int registerGpuResources(const char* name, GpuResourceCallback release, GpuResourceCallback rebuild, void* user) {
+    ResourceRegistry& registry = resourceRegistry();
+    GpuResourceGroup group = { ++registry.nextId, name, release, rebuild, user };
+    registry.groups.push_back(group);
+    return group.id;
+}
+
+void unregisterGpuResources(int id) {
+    std::vector<GpuResourceGroup>& groups = resourceRegistry().groups;
+    for (size_t idx = 0; idx < groups.size(); idx++) {
+        if (groups[idx].id == id) {
+            groups.erase(groups.begin() + idx);
+            return;
+        }
+    }
+}
+
+int contextResetStatus() {
+    // R.1. The entry point of the robustness extension (the same for every context of the display).
+    ResourceRegistry& registry = resourceRegistry();
+    if (!registry.resetStatusLoaded) {
+        registry.resetStatusLoaded = true;
+        if (hasGLExtension("GL_KHR_robustness")) {
+            registry.getGraphicsResetStatus =
+                (PFNGLGETGRAPHICSRESETSTATUSKHRPROC)eglGetProcAddress("glGetGraphicsResetStatusKHR");
+        } else if (hasGLExtension("GL_EXT_robustness")) {
+            registry.getGraphicsResetStatus =
+                (PFNGLGETGRAPHICSRESETSTATUSKHRPROC)eglGetProcAddress("glGetGraphicsResetStatusEXT");
+        }
+    }
+    return registry.getGraphicsResetStatus != NULL ? (int)registry.getGraphicsResetStatus() : GL_NO_ERROR;
+}
+
+const char* contextResetName(int status) {
+    switch (status) {
+        case GL_GUILTY_CONTEXT_RESET_KHR: return "guilty";
+        case GL_INNOCENT_CONTEXT_RESET_KHR: return "innocent";
+        case GL_UNKNOWN_CONTEXT_RESET_KHR: return "unknown";
+        default: return "no";
+    }
+}
+
+void releaseGpuResources() {
+    std::vector<GpuResourceGroup>& groups = resourceRegistry().groups;
+    for (size_t idx = groups.size(); idx > 0; idx--) {
+        groups[idx - 1].release(groups[idx - 1].user);
+    }
+
+    // C.1. The shared caches of the common modules hold names of the old context.
+    flushGlDeletionQueue();
+    destroySamplerCache();
+    stateCacheInvalidate();
+}
+
+int rebuildGpuResources() {
+    std::vector<GpuResourceGroup>& groups = resourceRegistry().groups;
+    for (const GpuResourceGroup& group : groups) {
+        group.rebuild(group.user);
+    }
+    return (int)groups.size();
+}
@@ -0,0 +1,83 @@
+/**
+ * GPU reset detection and the registry of the resources to rebuild after a context loss.
+ *
+ * After a GPU reset (GL_KHR_robustness / GL_EXT_robustness, the context created with
+ * EGL_EXT_create_context_robustness and the "lose context on reset" strategy) every
+ * object of the context is gone and the context must be recreated. The demo context
+ * ("--robust", see demo_context.h) checks the reset status after every swap; after a
+ * reset it releases the registered resources, recreates the context and rebuilds them:
+ * the demo continues with the next frame instead of a process restart.
+ *
+ * The resources are registered as groups with two callbacks:
+ *  release  Forget the GL objects (the destroy function of the group: on a lost context
+ *           the GL calls are ignored, on a simulated loss they delete the objects). The
+ *           CPU data needed for the rebuild is kept.
+ *  rebuild  Create the objects again on the new context from the kept CPU data: the
+ *           programs come from the binary program cache (see program_cache.h) and the
+ *           assets from the memory mapped bundle (see asset_bundle.h), no recompile,
+ *           decode or file read.
+ * The groups are released in the reverse order of the registration and rebuilt in the
+ * order. The shared caches of the common modules (sampler cache, deletion queue, state
+ * cache) are reset between the two.
+ *
+ * Usage:
+ *
+ *   static void releaseScene(void* user) { destroyScene((Scene*)user); }
+ *   static void rebuildScene(void* user) { createSceneObjects((Scene*)user); }
+ *   int id = registerGpuResources("scene", releaseScene, rebuildScene, &scene);
+ *   ...
+ *   unregisterGpuResources(id);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *  * EGL
+ *  * GL_KHR_robustness or GL_EXT_robustness (the reset status)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_CONTEXT_RECOVERY_H
+#define GLES_COMMON_CONTEXT_RECOVERY_H
+
+typedef void (*GpuResourceCallback)(void* user);
+
+// Register a group of GL objects, returns its id for unregisterGpuResources.
+/* "rebuild" returns nothing: a failed rebuild is reported by the group (ex.: a program without a cache entry
+ * is compiled again, it is only slower). */
+int registerGpuResources(const char* name, GpuResourceCallback release, GpuResourceCallback rebuild, void* user);
+
+void unregisterGpuResources(int id);
+
+// The reset status of the current context: GL_NO_ERROR or GL_GUILTY/INNOCENT/UNKNOWN_CONTEXT_RESET_KHR.
+/* GL_NO_ERROR without GL_KHR_robustness or GL_EXT_robustness (the reset can't be detected). */
+int contextResetStatus();
+
+// "guilty", "innocent", "unknown" (the reset status) or "no".
+const char* contextResetName(int status);
+
+// Run the release callbacks (reverse order) and reset the shared caches: before the context is destroyed.
+void releaseGpuResources();
+
+// Run the rebuild callbacks on the new context, returns the number of groups.
+int rebuildGpuResources();
+
+#endif // GLES_COMMON_CONTEXT_RECOVERY_H
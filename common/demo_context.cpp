@@ -0,0 +1,886 @@
+/**
+ * Window or headless (EGL offscreen) context creation for the demos.
+ * See demo_context.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/demo_context.h"
+#include "common/context_recovery.h"
+#include "common/device_profile.h"
+#include "common/frame_stats.h"
+#include "common/gl_debug.h"
+#include "common/gl_handle.h"
+#include "common/gpu_memory.h"
+#include "common/hud.h"
+#include "common/idle_loop.h"
+#include "common/input_queue.h"
+#include "common/image_writer.h"
+#include "common/low_latency.h"
+#include "common/overdraw.h"
+#include "common/perf_counters.h"
+#include "common/startup_profile.h"
+#include "common/swap_damage.h"
+#include "common/time_source.h"
+#include "common/trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+#include <GLFW/glfw3.h>
+
+// From the EGL_KHR_create_context extension:
+#ifndef EGL_OPENGL_ES3_BIT_KHR
+#define EGL_OPENGL_ES3_BIT_KHR 0x0040
+#endif
+
+// From the EGL_MESA_platform_surfaceless extension:
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+// Defined by the frame capture layer (x_gles_capture/gl_capture.cpp), NULL if it is not preloaded.
+extern "C" void glesCaptureEndFrame() __attribute__((weak));
+
+static const int defaultWidth = 1024;
+static const int defaultHeight = 600;
+static const int defaultHeadlessFrames = 100;
+
+static void ErrorCallbackGLFW(int error, const char* description) {
+    printf("Glfw Error %d: %s\n", error, description);
+}
+
+static void FramebufferSizeCallbackGLFW(GLFWwindow* window, int width, int height) {
+    DemoContext* demo = (DemoContext*)glfwGetWindowUserPointer(window);
+    /* A minimized window reports a 0x0 framebuffer: keep the last valid size. */
+    if (width > 0 && height > 0) {
+        demo->width = width;
+        demo->height = height;
+    }
+}
+
+// Window events into the input queue (see input_queue.h), drained by demoPollEvents.
+static void pushWindowEvent(GLFWwindow* window, int type, int code, int action, int mods, double x, double y) {
+    DemoContext* demo = (DemoContext*)glfwGetWindowUserPointer(window);
+    if (demo->input == NULL) {
+        return;
+    }
+    InputEvent event = {};
+    event.type = type;
+    event.code = code;
+    event.action = action;
+    event.mods = mods;
+    event.x = x;
+    event.y = y;
+    inputQueuePush(demo->input, INPUT_SOURCE_WINDOW, event);
+}
+
+static void KeyCallbackGLFW(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    pushWindowEvent(window, INPUT_KEY, key, action, mods, 0.0, 0.0);
+}
+
+static void MouseButtonCallbackGLFW(GLFWwindow* window, int button, int action, int mods) {
+    pushWindowEvent(window, INPUT_MOUSE_BUTTON, button, action, mods, 0.0, 0.0);
+}
+
+static void CursorPosCallbackGLFW(GLFWwindow* window, double x, double y) {
+    pushWindowEvent(window, INPUT_CURSOR, 0, 0, 0, x, y);
+}
+
+static void ScrollCallbackGLFW(GLFWwindow* window, double x, double y) {
+    pushWindowEvent(window, INPUT_SCROLL, 0, 0, 0, x, y);
+}
+
+static double steadyTime() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static bool hasExtension(const char* extensions, const char* name) {
+    if (extensions == NULL) {
+        return false;
+    }
+
+    size_t nameLength = strlen(name);
+    for (const char* ptr = strstr(extensions, name); ptr != NULL; ptr = strstr(ptr + 1, name)) {
+        bool startOk = (ptr == extensions) || (ptr[-1] == ' ');
+        bool endOk = (ptr[nameLength] == ' ') || (ptr[nameLength] == '\0');
+        if (startOk && endOk) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static EGLDisplay getSurfacelessDisplay() {
+    const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (!hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+        return EGL_NO_DISPLAY;
+    }
+
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay == NULL) {
+        return EGL_NO_DISPLAY;
+    }
+
+    return getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+}
+
+static void parseDemoOptions(DemoContext* demo, int argc, char** argv) {
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--headless") == 0) {
+            demo->headless = true;
+        } else if (strcmp(argv[idx], "--surfaceless") == 0) {
+            demo->headless = true;
+            demo->surfaceless = true;
+        } else if (strcmp(argv[idx], "--no-vsync") == 0) {
+            demo->noVsync = true;
+        } else if (strcmp(argv[idx], "--gl-debug") == 0) {
+            demo->glDebug = true;
+        } else if (strcmp(argv[idx], "--frame-stats") == 0) {
+            demo->frameStatsRequested = true;
+        } else if (strcmp(argv[idx], "--overdraw-heatmap") == 0) {
+            demo->overdrawRequested = true;
+        } else if (strcmp(argv[idx], "--low-latency") == 0) {
+            demo->lowLatencyRequested = true;
+        } else if (strcmp(argv[idx], "--idle") == 0) {
+            demo->idleRequested = true;
+        } else if (strcmp(argv[idx], "--fps-limit") == 0 && idx + 1 < argc) {
+            demo->fpsLimit = atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--fixed-time") == 0 && idx + 1 < argc) {
+            demo->timeSourceMode = TIME_SOURCE_FIXED;
+            demo->timeStep = atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--time-source") == 0 && idx + 1 < argc) {
+            TimeSourceMode mode;
+            if (parseTimeSourceMode(argv[++idx], &mode)) {
+                demo->timeSourceMode = mode;
+            }
+        } else if (strcmp(argv[idx], "--time-step") == 0 && idx + 1 < argc) {
+            demo->timeStep = atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--time-file") == 0 && idx + 1 < argc) {
+            demo->timeFilePath = argv[++idx];
+        } else if (strcmp(argv[idx], "--trace") == 0 && idx + 1 < argc) {
+            demo->tracePath = argv[++idx];
+        } else if (strcmp(argv[idx], "--gpu-memory") == 0) {
+            demo->gpuMemoryReport = true;
+        } else if (strcmp(argv[idx], "--gpu-memory-budget") == 0 && idx + 1 < argc) {
+            demo->gpuMemoryReport = true;
+            gpuMemorySetBudget((size_t)(atof(argv[++idx]) * 1024.0 * 1024.0));
+        } else if (strcmp(argv[idx], "--hud") == 0) {
+            demo->hudRequested = true;
+        } else if (strcmp(argv[idx], "--startup-profile") == 0) {
+            startupProfileEnable();
+        } else if (strcmp(argv[idx], "--dump-frame") == 0 && idx + 1 < argc) {
+            demo->dumpFramePath = argv[++idx];
+        } else if (strcmp(argv[idx], "--robust") == 0) {
+            demo->robust = true;
+        } else if (strcmp(argv[idx], "--simulate-context-loss") == 0 && idx + 1 < argc) {
+            demo->robust = true;
+            demo->simulatedLossFrame = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--device-profile") == 0) {
+            demo->deviceProfileRequested = true;
+        } else if (strcmp(argv[idx], "--device-profile-refresh") == 0) {
+            demo->deviceProfileRequested = true;
+            demo->deviceProfileRefresh = true;
+        } else if (strcmp(argv[idx], "--input-thread") == 0) {
+            demo->inputThread = true;
+        } else if (strcmp(argv[idx], "--raw-mouse") == 0) {
+            demo->rawMouse = true;
+        } else if (strcmp(argv[idx], "--input-stats") == 0) {
+            demo->inputStats = true;
+        } else if (strcmp(argv[idx], "--frames") == 0 && idx + 1 < argc) {
+            demo->frameLimit = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--size") == 0 && idx + 1 < argc) {
+            int width, height;
+            if (sscanf(argv[++idx], "%dx%d", &width, &height) == 2 && width > 0 && height > 0) {
+                demo->width = width;
+                demo->height = height;
+            }
+        }
+    }
+
+    if (demo->headless && demo->frameLimit <= 0) {
+        demo->frameLimit = defaultHeadlessFrames;
+    }
+}
+
+static bool openWindow(DemoContext* demo, const char* title);
+
+static int createWindowContext(DemoContext* demo, const char* title) {
+    // 0. Add a method to report any GLFW errors.
+    glfwSetErrorCallback(ErrorCallbackGLFW);
+
+    // 1. Initialize the GLFW library.
+    if (!glfwInit()) {
+        return -1;
+    }
+
+    // 2. Add hints to use during context creation when a GLFW window is created.
+    // Here: require a GL ES 3.0 context.
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+    if (demo->robust) {
+        glfwWindowHint(GLFW_CONTEXT_ROBUSTNESS, GLFW_LOSE_CONTEXT_ON_RESET);
+    }
+
+    if (!openWindow(demo, title)) {
+        glfwTerminate();
+        return -2;
+    }
+    return 0;
+}
+
+// Steps 3-6 of the window context: also used to recreate the window after a context loss.
+static bool openWindow(DemoContext* demo, const char* title) {
+    // 3. Create window with graphics context
+    demo->window = glfwCreateWindow(demo->width, demo->height, title, NULL, NULL);
+    if (demo->window == NULL) {
+        return false;
+    }
+
+    // 4. Activate the window (display it).
+    glfwMakeContextCurrent(demo->window);
+
+    // 5. The framebuffer size can differ from the window size (ex.: HiDPI).
+    glfwGetFramebufferSize(demo->window, &demo->width, &demo->height);
+
+    // 5.1. Track the framebuffer size when the window is resized.
+    glfwSetWindowUserPointer(demo->window, demo);
+    glfwSetFramebufferSizeCallback(demo->window, FramebufferSizeCallbackGLFW);
+
+    // 5.2. The input events are queued and handled once per frame (see demoInputEvents).
+    glfwSetKeyCallback(demo->window, KeyCallbackGLFW);
+    glfwSetMouseButtonCallback(demo->window, MouseButtonCallbackGLFW);
+    glfwSetCursorPosCallback(demo->window, CursorPosCallbackGLFW);
+    glfwSetScrollCallback(demo->window, ScrollCallbackGLFW);
+    if (demo->rawMouse) {
+        /* The raw motion is only delivered while the cursor is disabled. */
+        glfwSetInputMode(demo->window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        if (glfwRawMouseMotionSupported()) {
+            glfwSetInputMode(demo->window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
+        } else {
+            printf("Raw mouse motion is not supported, the cursor motion is accelerated\n");
+        }
+    }
+
+    // 6. Uncapped rendering for benchmarks (the low latency mode has its own frame limiter).
+    if (demo->noVsync || demo->lowLatencyRequested) {
+        glfwSwapInterval(0);
+    }
+
+    return true;
+}
+
+// H.4. The context of the config ("--robust": the "lose context on reset" strategy if the extension is supported).
+static EGLContext createHeadlessEglContext(DemoContext* demo, EGLDisplay display, EGLConfig config) {
+    bool robust = demo->robust && hasExtension(eglQueryString(display, EGL_EXTENSIONS),
+                                               "EGL_EXT_create_context_robustness");
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_CLIENT_VERSION, 3,
+        robust ? EGL_CONTEXT_OPENGL_RESET_NOTIFICATION_STRATEGY_EXT : EGL_NONE, EGL_LOSE_CONTEXT_ON_RESET_EXT,
+        EGL_NONE
+    };
+    return eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+}
+
+// H.7. The offscreen framebuffer which acts as the window framebuffer.
+static bool createHeadlessFramebuffer(DemoContext* demo) {
+    glGenRenderbuffers(1, &demo->colorRB);
+    glBindRenderbuffer(GL_RENDERBUFFER, demo->colorRB);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, demo->width, demo->height);
+    gpuMemoryTrackRenderbuffer(demo->colorRB, GL_RGBA8, demo->width, demo->height, 1, "headless color");
+
+    glGenRenderbuffers(1, &demo->depthRB);
+    glBindRenderbuffer(GL_RENDERBUFFER, demo->depthRB);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, demo->width, demo->height);
+    gpuMemoryTrackRenderbuffer(demo->depthRB, GL_DEPTH24_STENCIL8, demo->width, demo->height, 1, "headless depth");
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &demo->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, demo->fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, demo->colorRB);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, demo->depthRB);
+
+    GLenum fboResult = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (fboResult != GL_FRAMEBUFFER_COMPLETE) {
+        printf("ERROR::FRAMEBUFFER:: Framebuffer is not complete! (0x%x)\n", fboResult);
+        return false;
+    }
+
+    // H.7.1. Keep the FBO bound: demos which never bind a framebuffer render into it.
+    return true;
+}
+
+static void destroyHeadlessFramebuffer(DemoContext* demo) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &demo->fbo);
+    glDeleteRenderbuffers(1, &demo->colorRB);
+    glDeleteRenderbuffers(1, &demo->depthRB);
+    gpuMemoryReleaseRenderbuffers(1, &demo->colorRB);
+    gpuMemoryReleaseRenderbuffers(1, &demo->depthRB);
+}
+
+static int createHeadlessContext(DemoContext* demo) {
+    // H.1. Access the display and initialize EGL.
+    /* For surfaceless rendering prefer the Mesa surfaceless platform: it does not need any
+     * window system (ex.: CI render nodes). The pbuffer mode also falls back to it if the
+     * default display is not available. */
+    EGLDisplay display = demo->surfaceless ? getSurfacelessDisplay() : EGL_NO_DISPLAY;
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    int major = 0;
+    int minor = 0;
+    if (!eglInitialize(display, &major, &minor)) {
+        display = demo->surfaceless ? EGL_NO_DISPLAY : getSurfacelessDisplay();
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+            printf("Error: eglInitialize failed\n");
+            return -1;
+        }
+    }
+
+    if (demo->surfaceless && !hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+        printf("Error: EGL_KHR_surfaceless_context is not supported\n");
+        eglTerminate(display);
+        return -1;
+    }
+
+    // H.2. Use the Open GL ES API subset.
+    eglBindAPI(EGL_OPENGL_ES_API);
+
+    // H.3. Select an EGL configuration.
+    /* The surface type is only relevant for the pbuffer case, rendering goes into an FBO anyway. */
+    EGLConfig config;
+    {
+        const EGLint configAttribs[] = {
+            EGL_RED_SIZE, 8,
+            EGL_GREEN_SIZE, 8,
+            EGL_BLUE_SIZE, 8,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT_KHR,
+            EGL_SURFACE_TYPE, demo->surfaceless ? 0 : EGL_PBUFFER_BIT,
+            EGL_NONE
+        };
+        EGLint numConfigs = 0;
+
+        if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs != 1) {
+            printf("Error: couldn't get an EGL visual config\n");
+            eglTerminate(display);
+            return -2;
+        }
+    }
+
+    // H.4. Create an EGL OpenGL ES context.
+    if (demo->robust && !hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_EXT_create_context_robustness")) {
+        printf("Robust context: EGL_EXT_create_context_robustness is not supported, GPU resets can't be detected\n");
+    }
+    EGLContext context = createHeadlessEglContext(demo, display, config);
+    if (context == EGL_NO_CONTEXT) {
+        printf("Error: eglCreateContext failed\n");
+        eglTerminate(display);
+        return -2;
+    }
+
+    // H.5. Create a (small) PBufferSurface, the real rendering target is the FBO.
+    EGLSurface surface = EGL_NO_SURFACE;
+    if (!demo->surfaceless) {
+        static const EGLint pbufferAttribs[] = {
+            EGL_WIDTH, 1,
+            EGL_HEIGHT, 1,
+            EGL_NONE
+        };
+
+        surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+        if (surface == EGL_NO_SURFACE) {
+            printf("Error: unable to create PBufferSurface\n");
+            eglTerminate(display);
+            return -2;
+        }
+    }
+
+    // H.6. Activate the context.
+    if (!eglMakeCurrent(display, surface, surface, context)) {
+        printf("Error: eglMakeCurrent failed\n");
+        eglTerminate(display);
+        return -2;
+    }
+
+    demo->eglDisplay = display;
+    demo->eglContext = context;
+    demo->eglSurface = surface;
+    demo->eglConfig = config;
+
+    // H.7. Create the offscreen framebuffer which acts as the window framebuffer.
+    if (!createHeadlessFramebuffer(demo)) {
+        return -2;
+    }
+
+    printf("Headless EGL %d.%d (%s): %s %dx%d\n", major, minor, demo->surfaceless ? "surfaceless" : "pbuffer",
+           (const char*)glGetString(GL_RENDERER), demo->width, demo->height);
+
+    return 0;
+}
+
+// The GL modules of the context which are recreated after a context loss.
+static void createContextModules(DemoContext* demo) {
+    /* Window mode: the context is created with EGL (GLFW_EGL_CONTEXT_API), the current display is GLFW's. */
+    demo->swapDamage = createSwapDamage(demo->headless);
+
+    if (demo->overdrawRequested) {
+        demo->overdraw = createOverdraw(demoDefaultFramebuffer(demo));
+    }
+
+    if (demo->lowLatencyRequested) {
+        /* Default limit: the refresh rate of the display, the frames are not synchronized to it. */
+        double fpsLimit = demo->fpsLimit;
+        if (fpsLimit < 0.0) {
+            GLFWmonitor* monitor = demo->headless ? NULL : glfwGetPrimaryMonitor();
+            const GLFWvidmode* mode = monitor ? glfwGetVideoMode(monitor) : NULL;
+            fpsLimit = (mode && mode->refreshRate > 0) ? mode->refreshRate : 60.0;
+        }
+        demo->lowLatency = createLowLatency(fpsLimit);
+    }
+
+    if (demo->hudRequested) {
+        demo->hud = createHud();
+    }
+}
+
+static void destroyContextModules(DemoContext* demo) {
+    if (demo->hud) {
+        destroyHud(demo->hud);
+        demo->hud = NULL;
+    }
+
+    if (demo->overdraw) {
+        destroyOverdraw(demo->overdraw);
+        demo->overdraw = NULL;
+    }
+
+    if (demo->lowLatency) {
+        destroyLowLatency(demo->lowLatency);
+        demo->lowLatency = NULL;
+    }
+
+    if (demo->swapDamage) {
+        destroySwapDamage(demo->swapDamage);
+        demo->swapDamage = NULL;
+    }
+}
+
+int createDemoContext(DemoContext* demo, int argc, char** argv, const char* title) {
+    memset(demo, 0, sizeof(*demo));
+    demo->width = defaultWidth;
+    demo->height = defaultHeight;
+    demo->fpsLimit = -1.0;
+
+    demo->timeSourceMode = TIME_SOURCE_REAL;
+    demo->title = title;
+
+    parseDemoOptions(demo, argc, argv);
+
+    // The robust context recreates the modules of createContextModules, the others keep queries of the old context.
+    bool perfCountersRequested = false;
+    for (int idx = 1; idx < argc; idx++) {
+        perfCountersRequested |= strncmp(argv[idx], "--perf-counters", 15) == 0;
+    }
+    if (demo->robust && (demo->frameStatsRequested || demo->tracePath || demo->idleRequested || perfCountersRequested)) {
+        printf("--robust can't be combined with --frame-stats, --trace, --idle or --perf-counters\n");
+        return -1;
+    }
+
+    demo->timeSource = createTimeSource((TimeSourceMode)demo->timeSourceMode, demo->timeStep, demo->timeFilePath);
+    if (demo->timeSource == NULL) {
+        return -1;
+    }
+
+    startupPhase(demo->headless ? "EGL context" : "GLFW window");
+    int result = demo->headless ? createHeadlessContext(demo) : createWindowContext(demo, title);
+    if (result != 0) {
+        destroyTimeSource(demo->timeSource);
+        demo->timeSource = NULL;
+        return result;
+    }
+
+    startupProfileContextReady();
+    startupPhase("demo context");
+
+    if (demo->glDebug) {
+        enableGLDebugOutput(true);
+    }
+
+    if (demo->deviceProfileRequested) {
+        printDeviceProfile(loadDeviceProfile(demo->deviceProfileRefresh));
+    }
+
+    if (demo->tracePath) {
+        demo->trace = createTrace(demo->tracePath);
+    }
+
+    demo->perfCounters = createPerfCounters(argc, argv);
+
+    if (demo->frameStatsRequested) {
+        demo->frameStats = createFrameStats();
+    }
+
+    if (demo->idleRequested) {
+        demo->idleLoop = createIdleLoop(demo->window);
+    }
+
+    if (!demo->headless || demo->inputThread) {
+        demo->input = createInputQueue(1024, demo->inputThread);
+        /* The event driven loop waits in glfwWaitEvents: the joystick events must wake it. */
+        inputQueueWakeEvents(demo->input, demo->idleLoop != NULL);
+    }
+
+    createContextModules(demo);
+
+    startupPhase("setup");
+    demo->startTime = steadyTime();
+    return 0;
+}
+
+void destroyDemoContext(DemoContext* demo) {
+    // XX. Wait for the queued work so the measured time covers the whole rendering.
+    glFinish();
+
+    if (demo->frameLimit > 0) {
+        double elapsed = steadyTime() - demo->startTime;
+        printf("Rendered %d frames in %.3f s: %.2f fps\n",
+               demo->frameCount, elapsed, elapsed > 0.0 ? demo->frameCount / elapsed : 0.0);
+    }
+
+    if (demo->frameStats) {
+        destroyFrameStats(demo->frameStats);
+        demo->frameStats = NULL;
+    }
+
+    // The GPU is idle: delete the queued objects (see gl_handle.h) before the leaks are listed.
+    flushGlDeletionQueue();
+
+    // The objects still alive here are the resources of the demo (or its leaks): list the largest ones.
+    if (demo->gpuMemoryReport) {
+        gpuMemoryPrint(8);
+    }
+
+    destroyContextModules(demo);
+
+    if (demo->perfCounters) {
+        destroyPerfCounters(demo->perfCounters);
+        demo->perfCounters = NULL;
+    }
+
+    if (demo->trace) {
+        destroyTrace(demo->trace);
+        demo->trace = NULL;
+    }
+
+    if (demo->input) {
+        if (demo->inputStats) {
+            printInputStats(demo->input);
+        }
+        destroyInputQueue(demo->input);
+        demo->input = NULL;
+    }
+
+    if (demo->idleLoop) {
+        destroyIdleLoop(demo->idleLoop);
+        demo->idleLoop = NULL;
+    }
+
+    if (demo->timeSource) {
+        destroyTimeSource(demo->timeSource);
+        demo->timeSource = NULL;
+    }
+
+    if (demo->headless) {
+        destroyHeadlessFramebuffer(demo);
+
+        EGLDisplay display = (EGLDisplay)demo->eglDisplay;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (demo->eglSurface != EGL_NO_SURFACE) {
+            eglDestroySurface(display, (EGLSurface)demo->eglSurface);
+        }
+        eglDestroyContext(display, (EGLContext)demo->eglContext);
+        eglTerminate(display);
+    } else {
+        // XX. Destroy the window.
+        glfwDestroyWindow(demo->window);
+        // XX. Destroy the GLFW.
+        glfwTerminate();
+    }
+}
+
+bool demoShouldClose(DemoContext* demo) {
+    if (demo->frameCount == 0) {
+        startupPhase("first frame");
+    }
+
+    if (demo->frameLimit > 0 && demo->frameCount >= demo->frameLimit) {
+        return true;
+    }
+
+    /* The context couldn't be recreated after a reset. */
+    if (demo->headless ? demo->eglContext == EGL_NO_CONTEXT : demo->window == NULL) {
+        return true;
+    }
+
+    return !demo->headless && glfwWindowShouldClose(demo->window);
+}
+
+void demoPollEvents(DemoContext* demo) {
+    TraceZone zone("poll events");
+
+    /* Low latency: the input is sampled right before the frame is rendered, not before the waits. */
+    if (demo->lowLatency) {
+        lowLatencyWaitForFrame(demo->lowLatency);
+    }
+
+    if (demo->idleLoop) {
+        idleLoopWait(demo->idleLoop);
+    } else if (!demo->headless) {
+        glfwPollEvents();
+    }
+
+    // The events of the frame: every event of the callbacks and of the joystick thread at once.
+    demo->inputEventCount = demo->input ? inputQueueDrain(demo->input, &demo->inputEvents) : 0;
+
+    if (demo->lowLatency) {
+        lowLatencyInputSampled(demo->lowLatency);
+    }
+}
+
+int demoInputEvents(const DemoContext* demo, const InputEvent** events) {
+    *events = demo->inputEvents;
+    return demo->inputEventCount;
+}
+
+// Read back the default framebuffer (the back buffer in window mode) and write it into the "--dump-frame" file.
+static void dumpFrame(const DemoContext* demo) {
+    ImageFileFormat format = IMAGE_FILE_PPM;
+    const char* extension = strrchr(demo->dumpFramePath, '.');
+    for (int idx = 0; extension != NULL && idx < IMAGE_FILE_FORMAT_COUNT; idx++) {
+        if (strcmp(extension + 1, imageFileFormatNames[idx]) == 0) {
+            format = (ImageFileFormat)idx;
+        }
+    }
+
+    GLint readFramebuffer = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, demoDefaultFramebuffer(demo));
+
+    std::vector<uint8_t> pixels((size_t)demo->width * demo->height * 4);
+    std::vector<uint8_t> rgb;
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, demo->width, demo->height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+
+    if (writeImageFile(demo->dumpFramePath, format, pixels.data(), demo->width, demo->height, &rgb)) {
+        printf("Frame %d written to %s\n", demo->frameCount, demo->dumpFramePath);
+    } else {
+        printf("Error: unable to write the frame into %s\n", demo->dumpFramePath);
+    }
+}
+
+// R.1. GPU reset ("--robust"): release the registered resources, recreate the context and rebuild them.
+static void recoverDemoContext(DemoContext* demo, int status) {
+    printf("Context lost: %s context reset after frame %d\n", contextResetName(status), demo->frameCount);
+    double startTime = steadyTime();
+
+    // R.1.1. The resources and the modules forget the objects of the old context.
+    releaseGpuResources();
+    destroyContextModules(demo);
+
+    // R.1.2. A new context (the same config) with a new offscreen framebuffer, or a new window.
+    bool recreated;
+    if (demo->headless) {
+        destroyHeadlessFramebuffer(demo);
+        EGLDisplay display = (EGLDisplay)demo->eglDisplay;
+        EGLSurface surface = (EGLSurface)demo->eglSurface;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display, (EGLContext)demo->eglContext);
+        demo->eglContext = createHeadlessEglContext(demo, display, (EGLConfig)demo->eglConfig);
+        recreated = demo->eglContext != EGL_NO_CONTEXT && eglMakeCurrent(display, surface, surface, demo->eglContext)
+                 && createHeadlessFramebuffer(demo);
+    } else {
+        glfwDestroyWindow(demo->window);
+        recreated = openWindow(demo, demo->title);
+    }
+    if (!recreated) {
+        printf("Context recovery: the new context can't be created, stopping\n");
+        demo->eglContext = EGL_NO_CONTEXT;
+        demo->window = NULL;
+        return;
+    }
+
+    // R.1.3. The state of the new context and the rebuilt resources (finished: the time covers the uploads).
+    if (demo->glDebug) {
+        enableGLDebugOutput(true);
+    }
+    createContextModules(demo);
+    glViewport(0, 0, demo->width, demo->height);
+    int groups = rebuildGpuResources();
+    glFinish();
+
+    demo->contextLosses++;
+    printf("Context recovered in %.1f ms: %d resource groups rebuilt\n", (steadyTime() - startTime) * 1000.0, groups);
+}
+
+void demoSwapBuffers(DemoContext* demo) {
+    /* The heatmap replaces the frame (and it is part of the captured frame). */
+    if (demo->overdraw) {
+        overdrawResolve(demo->overdraw, demoDefaultFramebuffer(demo), demo->width, demo->height);
+        swapDamageAdd(demo->swapDamage, 0, 0, demo->width, demo->height);
+    }
+
+    /* Before the swap: the back buffer is undefined after it. */
+    if (demo->dumpFramePath && demo->frameCount + 1 == demo->frameLimit) {
+        dumpFrame(demo);
+    }
+
+    /* After the capture: the HUD values differ in every run. */
+    if (demo->hud) {
+        int x, y, width, height;
+        hudDraw(demo->hud, demoDefaultFramebuffer(demo), demo->width, demo->height, &x, &y, &width, &height);
+        swapDamageAdd(demo->swapDamage, x, y, width, height);
+    }
+
+    demo->frameCount++;
+
+    /* Frame boundary for the capture layer (x_gles_capture/gl_capture.cpp) if it is preloaded. */
+    if (glesCaptureEndFrame) {
+        glesCaptureEndFrame();
+    }
+
+    if (demo->frameStats) {
+        frameStatsBeforeSwap(demo->frameStats);
+    }
+
+    if (demo->idleLoop) {
+        idleLoopEndFrame(demo->idleLoop);
+    }
+
+    traceBeginZone("swap");
+    if (swapDamageSwap(demo->swapDamage, demo->width, demo->height)) {
+        /* Presented with the damage rectangles of the frame. */
+    } else if (demo->headless) {
+        /* Nothing to present: just make sure the commands are submitted. */
+        glFlush();
+    } else {
+        glfwSwapBuffers(demo->window);
+    }
+    traceEndZone();
+    /* The objects released in this frame are deleted when the GPU finished it. */
+    glDeletionQueueEndFrame();
+    if (demo->frameCount == 1) {
+        startupProfileFirstFrame();
+    }
+    traceEndFrame(demo->frameCount - 1);
+    perfCountersEndFrame(demo->frameCount - 1);
+
+    if (demo->frameStats) {
+        frameStatsAfterSwap(demo->frameStats);
+    }
+
+    if (demo->lowLatency) {
+        lowLatencyAfterSwap(demo->lowLatency);
+    }
+
+    /* The status query is a cheap client side check, the simulated reset recreates the context the same way. */
+    if (demo->robust) {
+        int status = demo->frameCount == demo->simulatedLossFrame ? GL_UNKNOWN_CONTEXT_RESET_KHR
+                                                                   : contextResetStatus();
+        if (status != GL_NO_ERROR) {
+            recoverDemoContext(demo, status);
+        }
+    }
+}
+
+void demoRequestRedraw(DemoContext* demo, double delay) {
+    if (demo->idleLoop) {
+        idleLoopRequestRedraw(demo->idleLoop, delay);
+    }
+}
+
+void demoAddSwapDamage(DemoContext* demo, int x, int y, int width, int height) {
+    swapDamageAdd(demo->swapDamage, x, y, width, height);
+}
+
+bool demoBeginPartialRedraw(DemoContext* demo, int* x, int* y, int* width, int* height) {
+    SwapDamageRect region;
+    bool partial = !demo->overdraw && swapDamageBeginRedraw(demo->swapDamage, demo->width, demo->height, &region);
+    *x = region.x;
+    *y = region.y;
+    *width = region.width;
+    *height = region.height;
+    return partial;
+}
+
+void demoSwapInterval(DemoContext* demo, int interval) {
+    if (!demo->headless && !demo->noVsync && !demo->lowLatencyRequested) {
+        glfwSwapInterval(interval);
+    }
+}
+
+double demoGetTime(const DemoContext* demo) {
+    if (demo->headless) {
+        return steadyTime() - demo->startTime;
+    }
+    return glfwGetTime();
+}
+
+double demoAnimationTime(const DemoContext* demo) {
+    return timeSourceFrameTime(demo->timeSource, demo->frameCount, demoGetTime(demo));
+}
+
+bool demoMakeCurrent(DemoContext* demo, bool current) {
+    if (!demo->headless) {
+        glfwMakeContextCurrent(current ? demo->window : NULL);
+        return glfwGetCurrentContext() == (current ? demo->window : NULL);
+    }
+
+    EGLDisplay display = (EGLDisplay)demo->eglDisplay;
+    if (!current) {
+        return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
+    EGLSurface surface = (EGLSurface)demo->eglSurface;
+    return eglMakeCurrent(display, surface, surface, (EGLContext)demo->eglContext);
+}
+
+void demoGetFramebufferSize(const DemoContext* demo, int* width, int* height) {
+    *width = demo->width;
+    *height = demo->height;
+}
+
+unsigned int demoDefaultFramebuffer(const DemoContext* demo) {
+    return demo->fbo;
+}
@@ -0,0 +1,262 @@
+/**
+ * Window or headless (EGL offscreen) context creation for the demos.
+ *
+ * By default a GLFW window with an OpenGL ES 3.0 context is created (as in
+ * the "01_gles_glfw" example). Command line options handled here:
+ *
+ *  --headless       No window: create an EGL pbuffer context and render into an
+ *                   offscreen FBO at full speed (no vsync).
+ *  --surfaceless    Same as --headless but without any EGL surface
+ *                   (EGL_KHR_surfaceless_context, ex.: Mesa's surfaceless platform).
+ *  --frames N       Stop after N frames and report the frames/sec value.
+ *                   Headless runs default to 100 frames.
+ *  --size WxH       Window/offscreen framebuffer size (default: 1024x600).
+ *  --no-vsync       Disable the vsync of the window (glfwSwapInterval(0)).
+ *  --frame-stats    Record the frame, CPU, swap and GPU times of every frame and
+ *                   print their percentiles at exit (see frame_stats.h).
+ *  --gl-debug       Print the GL debug messages of the driver (see gl_debug.h).
+ *  --low-latency    Swap interval 0, CPU frame limiter and late input sampling in
+ *                   demoPollEvents; print the input-to-swap latency (see low_latency.h).
+ *  --fps-limit N    Frame limit of the low latency mode (default: the monitor refresh
+ *                   rate or 60, 0: no limit).
+ *  --idle           Event driven loop: demoPollEvents waits for an event or the animation
+ *                   clock (demoRequestRedraw), print the CPU/GPU utilisation (see idle_loop.h).
+ *  --overdraw-heatmap
+ *                   Show the fragments per pixel as a heatmap instead of the frame and
+ *                   print the average/max overdraw (see overdraw.h).
+ *  --time-source real|fixed|recorded, --time-step S, --time-file FILE
+ *                   Clock of the animations (demoAnimationTime): the real time (recorded into the
+ *                   file if given), fixed steps or the times recorded in the file (see time_source.h).
+ *  --fixed-time STEP
+ *                   Animate frame N at N * STEP seconds instead of the clock, every run renders
+ *                   the same frames (ex.: the golden image check).
+ *  --trace FILE     Record the CPU zones and the GPU passes on a timeline and write it
+ *                   as a Chrome trace (JSON) at exit (see trace.h).
+ *  --perf-counters  Sample the hardware counters of the GpuTimer passes and print them per pass
+ *                   at exit (GL_AMD_performance_monitor or GL_INTEL_performance_query, see
+ *                   perf_counters.h for the other "--perf-counters-*" options).
+ *  --gpu-memory     Print the estimated GPU memory (live/peak per category) at exit (see gpu_memory.h).
+ *  --gpu-memory-budget MB
+ *                   Warn when the estimated GPU memory grows above the budget.
+ *  --hud            Draw the performance HUD (frame rate, frame time graph, GPU passes, memory and
+ *                   counters) on top of the frames (see hud.h).
+ *  --startup-profile
+ *                   Print the CPU/GPU time of the startup phases at the first frame (see startup_profile.h).
+ *  --dump-frame FILE
+ *                   Write the last frame of "--frames N" into an image file, the extension
+ *                   selects the format (ppm, png, qoi or raw, see image_writer.h).
+ *  --robust         Create the context with the "lose context on reset" strategy
+ *                   (EGL_EXT_create_context_robustness) and check the reset status after every
+ *                   swap: after a GPU reset the context is recreated and the registered resources
+ *                   are rebuilt (see context_recovery.h). Not with the frame stats, the trace,
+ *                   the idle loop or the perf counters (their queries don't survive a reset).
+ *  --simulate-context-loss N
+ *                   Handle the swap of frame N as a reset (the context is really recreated), implies --robust.
+ *  --device-profile Load the capability and calibration profile of the GPU (calibrated and stored at the
+ *                   first run) and print it: the features take their defaults from it (see device_profile.h).
+ *  --device-profile-refresh
+ *                   Same as --device-profile, but calibrate again.
+ *  --input-thread   Read the joysticks and gamepads (Linux evdev) from a dedicated thread into the input
+ *                   queue (see input_queue.h, the window events are always queued).
+ *  --raw-mouse      Disable the cursor and use the raw (unaccelerated) mouse motion if supported.
+ *  --input-stats    Print the pushed, coalesced and dropped input events at exit.
+ *
+ * In the headless mode the "window" framebuffer is an FBO, so the demos must
+ * use demoDefaultFramebuffer() instead of the framebuffer 0.
+ *
+ * Dependencies:
+ *  * C++11
+ *  * GLFW 3.0+
+ *  * Open GL ES 3.0+
+ *  * EGL
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_DEMO_CONTEXT_H
+#define GLES_COMMON_DEMO_CONTEXT_H
+
+typedef struct GLFWwindow GLFWwindow;
+struct FrameStats;
+struct Overdraw;
+struct LowLatency;
+struct SwapDamage;
+struct IdleLoop;
+struct TimeSource;
+struct Trace;
+struct PerfCounters;
+struct Hud;
+struct InputQueue;
+struct InputEvent;
+
+struct DemoContext {
+    // Window mode: the GLFW window (NULL in headless mode).
+    GLFWwindow* window;
+
+    // Headless mode: EGL objects (EGLDisplay, EGLContext, EGLSurface).
+    void* eglDisplay;
+    void* eglContext;
+    void* eglSurface;
+
+    // Headless mode: offscreen framebuffer used instead of the window.
+    unsigned int fbo;
+    unsigned int colorRB;
+    unsigned int depthRB;
+
+    int width;
+    int height;
+
+    bool headless;
+    bool surfaceless;
+    bool noVsync;
+    bool glDebug;
+
+    // Frame pacing statistics ("--frame-stats", NULL if disabled).
+    FrameStats* frameStats;
+    bool frameStatsRequested;
+
+    // Overdraw heatmap ("--overdraw-heatmap", NULL if disabled).
+    Overdraw* overdraw;
+    bool overdrawRequested;
+
+    // Low latency mode ("--low-latency", NULL if disabled).
+    LowLatency* lowLatency;
+    bool lowLatencyRequested;
+    double fpsLimit; // "--fps-limit N", negative: the default
+
+    // Event driven loop ("--idle", NULL if disabled).
+    IdleLoop* idleLoop;
+    bool idleRequested;
+
+    // Damage rectangles of the current frame and partial redraw (see swap_damage.h).
+    SwapDamage* swapDamage;
+
+    // Clock of the animations ("--time-source", "--time-step", "--time-file", see time_source.h).
+    TimeSource* timeSource;
+    int timeSourceMode; // TimeSourceMode
+    double timeStep;
+    const char* timeFilePath;
+
+    // Timeline trace file ("--trace FILE", NULL if disabled).
+    const char* tracePath;
+    Trace* trace;
+
+    // Hardware counters of the passes ("--perf-counters*", NULL if disabled).
+    PerfCounters* perfCounters;
+
+    // Performance HUD ("--hud", NULL if disabled).
+    Hud* hud;
+    bool hudRequested;
+
+    // Print the GPU memory totals at exit ("--gpu-memory" or "--gpu-memory-budget MB").
+    bool gpuMemoryReport;
+
+    // Image file of the last frame ("--dump-frame FILE", NULL if disabled).
+    const char* dumpFramePath;
+
+    // Robust context ("--robust", "--simulate-context-loss N"): recreated after a GPU reset.
+    bool robust;
+    int simulatedLossFrame; // 0: no simulated reset
+    int contextLosses;
+    const char* title;
+    void* eglConfig;        // headless mode: the EGLConfig of the (re)created contexts
+
+    // Batched input events ("--input-thread", "--raw-mouse", "--input-stats"), drained by demoPollEvents.
+    InputQueue* input;
+    const InputEvent* inputEvents;
+    int inputEventCount;
+    bool inputThread;
+    bool rawMouse;
+    bool inputStats;
+
+    // Capability and tuning profile of the GPU ("--device-profile", "--device-profile-refresh").
+    bool deviceProfileRequested;
+    bool deviceProfileRefresh;
+
+    // Number of frames to render (0: until the window is closed).
+    int frameLimit;
+    int frameCount;
+    double startTime;
+};
+
+// Parse the command line options and create the window or the headless context.
+/* Returns 0 on success or a negative value which can be used as the exit code. */
+int createDemoContext(DemoContext* demo, int argc, char** argv, const char* title);
+
+// Destroy the context/window and report the frame rate if a frame limit was requested.
+void destroyDemoContext(DemoContext* demo);
+
+// Returns true if the render loop should stop (window closed or frame limit reached).
+bool demoShouldClose(DemoContext* demo);
+
+// Poll and handle events (inputs, window resize, etc.). No-op in headless mode.
+/* In the low latency mode it first waits for the previous frame and the frame limiter. In the idle
+ * mode it waits until an event arrives or the time requested by demoRequestRedraw passes. */
+void demoPollEvents(DemoContext* demo);
+
+// The scene is animated: draw the next frame after "delay" seconds at the latest even without an event.
+/* Only used by the idle mode ("--idle"), call it every frame while the animation runs. */
+void demoRequestRedraw(DemoContext* demo, double delay);
+
+// The input events of the frame: the events since the previous demoPollEvents, in time order.
+/* The cursor motion, the scroll and the joystick axes are coalesced (see input_queue.h). The events
+ * are valid until the next demoPollEvents. */
+int demoInputEvents(const DemoContext* demo, const InputEvent** events);
+
+// Swap the front-back buffers (window) or flush the rendering (headless).
+void demoSwapBuffers(DemoContext* demo);
+
+// The rectangle (origin: bottom left) changed since the previous frame: add it to the damage of the next swap.
+/* Uses EGL_KHR_swap_buffers_with_damage (or the EXT) in window mode, ignored without the extension.
+ * Without any rectangle the whole frame is presented. */
+void demoAddSwapDamage(DemoContext* demo, int x, int y, int width, int height);
+
+// Region of the default framebuffer to redraw in this frame: the damage and the older damage of the back buffer.
+/* Call after the damage of the frame was added, before the first draw into the default framebuffer.
+ * Returns false (and the whole framebuffer) if the buffer age is unknown (EGL_EXT_buffer_age or
+ * EGL_KHR_partial_update is needed) or no damage was added. Otherwise only the region must be
+ * rendered (ex.: scissor test), the rest of the back buffer has the contents of the previous frames. */
+bool demoBeginPartialRedraw(DemoContext* demo, int* x, int* y, int* width, int* height);
+
+// Set the swap interval (vsync) of the window. No-op in headless mode or with "--no-vsync".
+void demoSwapInterval(DemoContext* demo, int interval);
+
+// Seconds elapsed since the context was created.
+/* The wall clock: use it for the measurements, the animations use demoAnimationTime. */
+double demoGetTime(const DemoContext* demo);
+
+// Time of the animations in the current frame, the same value for every call of the frame.
+/* The real, fixed step or recorded time of the "--time-source" option. */
+double demoAnimationTime(const DemoContext* demo);
+
+// Make the context current on the calling thread, or release it (current: false).
+/* A context is current on one thread at a time: release it before making it current on another thread
+ * (see render_thread.h). Returns false if it failed. */
+bool demoMakeCurrent(DemoContext* demo, bool current);
+
+// Size of the framebuffer returned by demoDefaultFramebuffer.
+/* In window mode it follows the resizes of the window (updated by demoPollEvents). */
+void demoGetFramebufferSize(const DemoContext* demo, int* width, int* height);
+
+// The framebuffer to use as the "window": 0 or the headless offscreen FBO.
+unsigned int demoDefaultFramebuffer(const DemoContext* demo);
+
+#endif // GLES_COMMON_DEMO_CONTEXT_H
@@ -0,0 +1,203 @@
+/**
+ * Depth buffer linearization and asynchronous read back.
+ * See depth_readback.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/depth_readback.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <GLES3/gl31.h>
+
+// Texture unit of the depth texture during the dispatch.
+#define DEPTH_READBACK_UNIT 7
+
+const char* depth_linearize_src = R"(#version 310 es
+precision highp float;
+
+uniform highp sampler2D depthImage;
+uniform vec2 uPlanes; // near, far
+
+layout(std430, binding = 0) writeonly buffer LinearDepth {
+    float linearDepth[];
+};
+
+void main() {
+    ivec2 pos = GLOBAL_ID_2D;
+    if (any(greaterThanEqual(pos, uGridSize.xy))) {
+        return;
+    }
+
+    // The closest depth of the block (uParams.x: the downsample factor), clamped to the image.
+    ivec2 last = textureSize(depthImage, 0) - 1;
+    float depth = 1.0;
+    for (int y = 0; y < uParams.x; y++) {
+        for (int x = 0; x < uParams.x; x++) {
+            depth = min(depth, texelFetch(depthImage, min(pos * uParams.x + ivec2(x, y), last), 0).r);
+        }
+    }
+
+    // Window depth -> NDC -> view space distance (the inverse of the projection's z row).
+    float ndc = depth * 2.0 - 1.0;
+    float nearPlane = uPlanes.x;
+    float farPlane = uPlanes.y;
+    linearDepth[pos.y * uGridSize.x + pos.x] = 2.0 * nearPlane * farPlane / (farPlane + nearPlane - ndc * (farPlane - nearPlane));
+}
+)";
+
+void projectionDepthPlanes(const float* projection, float* nearPlane, float* farPlane) {
+    // m[10] = -(f + n) / (f - n), m[14] = -2fn / (f - n)
+    float a = projection[10];
+    float b = projection[14];
+    *nearPlane = b / (a - 1.0f);
+    *farPlane = b / (a + 1.0f);
+}
+
+void initDepthReadback(DepthReadback* readback, int factor) {
+    createComputeKernel2D(&readback->kernel, depth_linearize_src, 0, 0, COMPUTE_SWIZZLE_AUTO);
+    readback->planesLoc = glGetUniformLocation(readback->kernel.program, "uPlanes");
+    readback->factor = factor < 1 ? 1 : factor;
+
+    glUseProgram(readback->kernel.program);
+    glUniform1i(glGetUniformLocation(readback->kernel.program, "depthImage"), DEPTH_READBACK_UNIT);
+    glUseProgram(0);
+
+    readback->output.buffer = 0;
+    readback->output.count = 0;
+    initComputeReadbacks(&readback->readbacks);
+    readback->pendingCount = 0;
+    readback->width = 0;
+    readback->height = 0;
+
+    readback->resultWidth = 0;
+    readback->resultHeight = 0;
+    readback->resultFrame = -1;
+
+    readback->submitCount = 0;
+    readback->skipCount = 0;
+    readback->resultCount = 0;
+    readback->latencySum = 0;
+}
+
+void destroyDepthReadback(DepthReadback* readback) {
+    printf("Depth readback: %d submitted, %d skipped (every slot in flight), %d results, average latency %.2f frames\n",
+           readback->submitCount, readback->skipCount, readback->resultCount,
+           readback->resultCount ? (double)readback->latencySum / readback->resultCount : 0.0);
+
+    for (int idx = 0; idx < readback->pendingCount; idx++) {
+        computeReadbackRelease(&readback->readbacks, readback->pending[idx]);
+    }
+    readback->pendingCount = 0;
+    destroyComputeReadbacks(&readback->readbacks);
+    if (readback->output.buffer != 0) {
+        destroyStorageBuffer(&readback->output);
+    }
+    destroyComputeKernel(&readback->kernel);
+}
+
+bool depthReadbackSubmit(DepthReadback* readback, unsigned int depthTexture, int width, int height,
+                         float nearPlane, float farPlane, int frame) {
+    if (readback->pendingCount == COMPUTE_READBACK_SLOTS) {
+        readback->skipCount++;
+        return false;
+    }
+
+    // 1. The output follows the size of the depth image (the pending copies are snapshots).
+    int outWidth = (width + readback->factor - 1) / readback->factor;
+    int outHeight = (height + readback->factor - 1) / readback->factor;
+    if (outWidth * outHeight > readback->output.count) {
+        if (readback->output.buffer != 0) {
+            destroyStorageBuffer(&readback->output);
+        }
+        readback->output = createStorageBuffer<float>(outWidth * outHeight);
+    }
+    readback->width = outWidth;
+    readback->height = outHeight;
+
+    // 2. Linearize: one invocation per output value.
+    /* The depth writes of the render pass are visible to the texture fetches without a barrier. */
+    glUseProgram(readback->kernel.program);
+    glUniform2f(readback->planesLoc, nearPlane, farPlane);
+    glUniform4i(readback->kernel.paramsLoc, readback->factor, 0, 0, 0);
+    glActiveTexture(GL_TEXTURE0 + DEPTH_READBACK_UNIT);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, readback->output.buffer);
+    computeDispatch(&readback->kernel, outWidth, outHeight, 1);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+
+    // 3. Copy into a staging buffer with a fence (the request issues the buffer update barrier).
+    int request = computeReadbackRequest(&readback->readbacks, readback->output, 0, outWidth * outHeight);
+    if (request < 0) {
+        readback->skipCount++;
+        return false;
+    }
+
+    int slot = readback->pendingCount++;
+    readback->pending[slot] = request;
+    readback->pendingFrame[slot] = frame;
+    readback->pendingWidth[slot] = outWidth;
+    readback->pendingHeight[slot] = outHeight;
+    readback->submitCount++;
+    return true;
+}
+
+bool depthReadbackPoll(DepthReadback* readback, int frame) {
+    // The copies finish in order: stop at the first one which is not done.
+    bool updated = false;
+    while (readback->pendingCount > 0) {
+        const float* values = (const float*)computeReadbackPoll(&readback->readbacks, readback->pending[0]);
+        if (values == NULL) {
+            break;
+        }
+
+        readback->resultWidth = readback->pendingWidth[0];
+        readback->resultHeight = readback->pendingHeight[0];
+        readback->resultFrame = readback->pendingFrame[0];
+        readback->distances.assign(values, values + readback->resultWidth * readback->resultHeight);
+        readback->resultCount++;
+        readback->latencySum += frame - readback->pendingFrame[0];
+        computeReadbackRelease(&readback->readbacks, readback->pending[0]);
+        updated = true;
+
+        readback->pendingCount--;
+        memmove(readback->pending, readback->pending + 1, readback->pendingCount * sizeof(int));
+        memmove(readback->pendingFrame, readback->pendingFrame + 1, readback->pendingCount * sizeof(int));
+        memmove(readback->pendingWidth, readback->pendingWidth + 1, readback->pendingCount * sizeof(int));
+        memmove(readback->pendingHeight, readback->pendingHeight + 1, readback->pendingCount * sizeof(int));
+    }
+    return updated;
+}
+
+float depthReadbackAt(const DepthReadback* readback, float x, float y) {
+    if (readback->resultFrame < 0) {
+        return 0.0f;
+    }
+
+    int px = (int)(x * readback->resultWidth);
+    int py = (int)(y * readback->resultHeight);
+    px = px < 0 ? 0 : (px >= readback->resultWidth ? readback->resultWidth - 1 : px);
+    py = py < 0 ? 0 : (py >= readback->resultHeight ? readback->resultHeight - 1 : py);
+    return readback->distances[py * readback->resultWidth + px];
+}
@@ -0,0 +1,112 @@
+/**
+ * Depth buffer linearization and asynchronous read back (compute stage).
+ *
+ * The raw depth of a perspective projection is non-linear (most of the
+ * range is close to the near plane), it is not a distance. This stage reads
+ * a depth texture with a compute kernel, converts every value to the view
+ * space distance with the near/far planes of the projection and optionally
+ * downsamples the image: each output value is the closest distance of a
+ * factor x factor block (conservative for the distance measurements).
+ *
+ * The output buffer is copied into a staging buffer of the compute read
+ * backs (see compute_readback.h) with a fence. depthReadbackPoll collects
+ * the copies which are done, never waiting for the GPU, and keeps the newest
+ * one in a CPU float buffer: the result is one or two frames old, the
+ * latency in frames is measured.
+ *
+ * Usage:
+ *
+ *   DepthReadback readback;
+ *   initDepthReadback(&readback, 4);
+ *   float nearPlane, farPlane;
+ *   projectionDepthPlanes(projection, &nearPlane, &farPlane);
+ *   ... every frame, after the depth is rendered ...
+ *   depthReadbackSubmit(&readback, depthTexture, width, height, nearPlane, farPlane, frame);
+ *   if (depthReadbackPoll(&readback, frame)) {
+ *       float distance = depthReadbackAt(&readback, 0.5f, 0.5f); // center of the view
+ *   }
+ *   destroyDepthReadback(&readback); // prints the statistics
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.1+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_DEPTH_READBACK_H
+#define GLES_COMMON_DEPTH_READBACK_H
+
+#include <vector>
+
+#include "common/compute.h"
+#include "common/compute_readback.h"
+
+struct DepthReadback {
+    ComputeKernel kernel;
+    int planesLoc;
+    int factor; // downsample factor
+
+    // Linear depth of the last submit, copied into the read back slots.
+    StorageBuffer<float> output;
+    ComputeReadbacks readbacks;
+    int pending[COMPUTE_READBACK_SLOTS]; // requests in submit order
+    int pendingFrame[COMPUTE_READBACK_SLOTS];
+    int pendingWidth[COMPUTE_READBACK_SLOTS];
+    int pendingHeight[COMPUTE_READBACK_SLOTS];
+    int pendingCount;
+    int width; // of the output of the last submit
+    int height;
+
+    // The newest result on the CPU.
+    std::vector<float> distances;
+    int resultWidth;
+    int resultHeight;
+    int resultFrame; // -1: no result yet
+
+    // Statistics.
+    int submitCount;
+    int skipCount; // every slot was in flight
+    int resultCount;
+    long latencySum; // frames between the submit and the poll which received it
+};
+
+// Near and far planes of an OpenGL perspective matrix (column major, as glm::perspective).
+void projectionDepthPlanes(const float* projection, float* nearPlane, float* farPlane);
+
+void initDepthReadback(DepthReadback* readback, int factor);
+
+// Print the statistics and delete the kernel and the buffers.
+void destroyDepthReadback(DepthReadback* readback);
+
+// Linearize (and downsample) the depth texture of width x height, then start its read back.
+/* The texture must be complete for texelFetch (ex.: GL_NEAREST, GL_TEXTURE_COMPARE_MODE GL_NONE).
+ * Returns false if every read back slot is in flight: the frame is skipped, the GPU is not waited for. */
+bool depthReadbackSubmit(DepthReadback* readback, unsigned int depthTexture, int width, int height,
+                         float nearPlane, float farPlane, int frame);
+
+// Collect the finished read backs. Returns true if a newer result arrived. Never blocks.
+bool depthReadbackPoll(DepthReadback* readback, int frame);
+
+// Distance at the normalized window position (0, 0: bottom left) of the newest result, 0 without result.
+float depthReadbackAt(const DepthReadback* readback, float x, float y);
+
+#endif // GLES_COMMON_DEPTH_READBACK_H
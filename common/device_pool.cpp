@@ -0,0 +1,338 @@
+/**
+ * Device pool, see device_pool.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/device_pool.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+
+// From the EGL_KHR_create_context extension:
+#ifndef EGL_OPENGL_ES3_BIT_KHR
+#define EGL_OPENGL_ES3_BIT_KHR 0x0040
+#endif
+
+// From the EGL_EXT_device_drm_render_node extension:
+#ifndef EGL_DRM_RENDER_NODE_FILE_EXT
+#define EGL_DRM_RENDER_NODE_FILE_EXT 0x3377
+#endif
+
+static bool hasExtension(const char* list, const char* name) {
+    size_t length = strlen(name);
+    for (const char* ptr = list ? strstr(list, name) : NULL; ptr != NULL; ptr = strstr(ptr + length, name)) {
+        if ((ptr == list || ptr[-1] == ' ') && (ptr[length] == ' ' || ptr[length] == '\0')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int listEGLDevices(std::vector<EGLDeviceInfo>* devices) {
+    devices->clear();
+
+    // 1. Without the device extensions only the default display is there.
+    const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLQUERYDEVICESEXTPROC queryDevices = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+    PFNEGLQUERYDEVICESTRINGEXTPROC queryDeviceString =
+        (PFNEGLQUERYDEVICESTRINGEXTPROC)eglGetProcAddress("eglQueryDeviceStringEXT");
+    EGLint count = 0;
+    if (!hasExtension(clientExtensions, "EGL_EXT_device_enumeration")
+        || !hasExtension(clientExtensions, "EGL_EXT_platform_device") || queryDevices == NULL
+        || queryDeviceString == NULL || !queryDevices(0, NULL, &count) || count == 0) {
+        devices->push_back(EGLDeviceInfo{ NULL, "default display" });
+        return 1;
+    }
+
+    // 2. Name the devices by their DRM node, the render node is preferred (no DRM master needed).
+    std::vector<EGLDeviceEXT> handles(count);
+    queryDevices(count, handles.data(), &count);
+    for (EGLint idx = 0; idx < count; idx++) {
+        const char* extensions = queryDeviceString(handles[idx], EGL_EXTENSIONS);
+        const char* file = NULL;
+        if (hasExtension(extensions, "EGL_EXT_device_drm_render_node")) {
+            file = queryDeviceString(handles[idx], EGL_DRM_RENDER_NODE_FILE_EXT);
+        }
+        if (file == NULL && hasExtension(extensions, "EGL_EXT_device_drm")) {
+            file = queryDeviceString(handles[idx], EGL_DRM_DEVICE_FILE_EXT);
+        }
+
+        std::string name = file != NULL ? file : "device " + std::to_string(idx);
+        if (file == NULL && hasExtension(extensions, "EGL_MESA_device_software")) {
+            name = "software";
+        }
+        devices->push_back(EGLDeviceInfo{ handles[idx], name });
+    }
+    return count;
+}
+
+void* openEGLDeviceDisplay(const EGLDeviceInfo& device) {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    if (device.device == NULL) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    } else {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay != NULL) {
+            display = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, device.device, NULL);
+        }
+    }
+
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+        printf("Device pool: unable to initialize the display of '%s'\n", device.name.c_str());
+        return EGL_NO_DISPLAY;
+    }
+    return display;
+}
+
+// Create and bind the context of the worker on its device (on the worker thread).
+static bool createWorkerContext(DeviceWorker* worker) {
+    EGLDisplay display = worker->display;
+    eglBindAPI(EGL_OPENGL_ES_API);
+
+    // 1. A config of any surface type if no surface is needed, otherwise one with pbuffers.
+    bool surfaceless = hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+    const EGLint configAttribs[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT_KHR,
+        EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs != 1) {
+        return false;
+    }
+
+    // 2. The context and the (optional) 1x1 pbuffer.
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_CLIENT_VERSION, 3,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT) {
+        return false;
+    }
+
+    EGLSurface surface = EGL_NO_SURFACE;
+    if (!surfaceless) {
+        const EGLint pbufferAttribs[] = {
+            EGL_WIDTH, 1,
+            EGL_HEIGHT, 1,
+            EGL_NONE
+        };
+        surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+    }
+    if ((!surfaceless && surface == EGL_NO_SURFACE) || !eglMakeCurrent(display, surface, surface, context)) {
+        if (surface != EGL_NO_SURFACE) {
+            eglDestroySurface(display, surface);
+        }
+        eglDestroyContext(display, context);
+        return false;
+    }
+
+    worker->context = context;
+    worker->surface = surface;
+    worker->renderer = (const char*)glGetString(GL_RENDERER);
+    return true;
+}
+
+static void workerMain(DevicePool* pool, DeviceWorker* worker) {
+    // 1. The context (and the state of the jobs), then tell initDevicePool the result.
+    bool ready = worker->display != EGL_NO_DISPLAY && createWorkerContext(worker);
+    if (ready && pool->createState != NULL) {
+        pool->createState(worker, pool->userData);
+    }
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        if (!ready) {
+            worker->context = EGL_NO_CONTEXT;
+        }
+        pool->started++;
+        pool->jobFinished.notify_all();
+    }
+    if (!ready) {
+        return;
+    }
+
+    // 2. Take the jobs while there are any, the queue is shared by every device.
+    while (true) {
+        DeviceJob* job;
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->jobReady.wait(lock, [pool] { return pool->stopping || !pool->queue.empty(); });
+            if (pool->queue.empty()) {
+                break;
+            }
+            job = pool->queue.front();
+            pool->queue.pop_front();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        job->function(worker, job->data);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        job->worker = worker->index;
+        job->finished = true;
+        worker->jobCount++;
+        worker->busySeconds += seconds;
+        pool->pending--;
+        pool->jobFinished.notify_all();
+    }
+
+    // 3. The state is released with the context still current.
+    if (pool->destroyState != NULL) {
+        pool->destroyState(worker, pool->userData);
+    }
+    glFinish();
+    eglMakeCurrent(worker->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (worker->surface != EGL_NO_SURFACE) {
+        eglDestroySurface(worker->display, worker->surface);
+    }
+    eglDestroyContext(worker->display, worker->context);
+    eglReleaseThread();
+}
+
+int initDevicePool(DevicePool* pool, int maxDevices, int workersPerDevice, DeviceStateFunction createState,
+                   DeviceStateFunction destroyState, void* userData) {
+    pool->createState = createState;
+    pool->destroyState = destroyState;
+    pool->userData = userData;
+    pool->pending = 0;
+    pool->started = 0;
+    pool->stopping = false;
+
+    // 1. Open the displays of the devices on this thread (eglInitialize is per display, not per thread).
+    listEGLDevices(&pool->devices);
+    if (maxDevices > 0 && (int)pool->devices.size() > maxDevices) {
+        pool->devices.resize(maxDevices);
+    }
+    for (const EGLDeviceInfo& device : pool->devices) {
+        pool->displays.push_back(openEGLDeviceDisplay(device));
+    }
+
+    // 2. Start the workers, each creates its context on its own thread.
+    for (int device = 0; device < (int)pool->devices.size(); device++) {
+        for (int idx = 0; idx < (workersPerDevice > 0 ? workersPerDevice : 1); idx++) {
+            DeviceWorker* worker = new DeviceWorker();
+            worker->index = (int)pool->workers.size();
+            worker->device = device;
+            worker->display = pool->displays[device];
+            worker->context = EGL_NO_CONTEXT;
+            worker->surface = EGL_NO_SURFACE;
+            worker->state = NULL;
+            worker->jobCount = 0;
+            worker->busySeconds = 0.0;
+            pool->workers.push_back(worker);
+        }
+    }
+    for (DeviceWorker* worker : pool->workers) {
+        worker->thread = std::thread(workerMain, pool, worker);
+    }
+
+    // 3. Drop the workers without a context.
+    {
+        std::unique_lock<std::mutex> lock(pool->mutex);
+        pool->jobFinished.wait(lock, [pool] { return pool->started == (int)pool->workers.size(); });
+    }
+    std::vector<DeviceWorker*> ready;
+    for (DeviceWorker* worker : pool->workers) {
+        if (worker->context == EGL_NO_CONTEXT) {
+            printf("Device pool: no GL ES 3 context on '%s'\n", pool->devices[worker->device].name.c_str());
+            worker->thread.join();
+            delete worker;
+        } else {
+            worker->index = (int)ready.size();
+            ready.push_back(worker);
+        }
+    }
+    pool->workers.swap(ready);
+
+    for (DeviceWorker* worker : pool->workers) {
+        printf("Device pool: worker %d on '%s': %s\n", worker->index, pool->devices[worker->device].name.c_str(),
+               worker->renderer.c_str());
+    }
+    return (int)pool->workers.size();
+}
+
+void destroyDevicePool(DevicePool* pool) {
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->stopping = true;
+    }
+    pool->jobReady.notify_all();
+
+    for (DeviceWorker* worker : pool->workers) {
+        worker->thread.join();
+        delete worker;
+    }
+    pool->workers.clear();
+
+    for (void* display : pool->displays) {
+        if (display != EGL_NO_DISPLAY) {
+            eglTerminate(display);
+        }
+    }
+    pool->displays.clear();
+}
+
+void devicePoolSubmit(DevicePool* pool, DeviceJob* job, DeviceJobFunction function, void* data) {
+    job->function = function;
+    job->data = data;
+    job->finished = false;
+    job->worker = -1;
+
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    pool->queue.push_back(job);
+    pool->pending++;
+    pool->jobReady.notify_one();
+}
+
+void devicePoolWait(DevicePool* pool, DeviceJob* job) {
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    pool->jobFinished.wait(lock, [job] { return job->finished; });
+}
+
+void devicePoolWaitAll(DevicePool* pool) {
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    pool->jobFinished.wait(lock, [pool] { return pool->pending == 0; });
+}
+
+void printDevicePoolStats(DevicePool* pool, double seconds) {
+    std::lock_guard<std::mutex> lock(pool->mutex);
+
+    int total = 0;
+    for (const DeviceWorker* worker : pool->workers) {
+        printf("  worker %d (%s): %d jobs, %.3f s busy (%.3f ms/job)\n", worker->index,
+               pool->devices[worker->device].name.c_str(), worker->jobCount, worker->busySeconds,
+               worker->jobCount > 0 ? worker->busySeconds * 1000.0 / worker->jobCount : 0.0);
+        total += worker->jobCount;
+    }
+    printf("Device pool: %d jobs on %d workers (%d devices) in %.3f s: %.1f jobs/s\n", total,
+           (int)pool->workers.size(), (int)pool->devices.size(), seconds, seconds > 0.0 ? total / seconds : 0.0);
+}
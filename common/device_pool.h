@@ -0,0 +1,151 @@
+/**
+ * Device pool: one worker per GPU (EGL device), each with its own
+ * surfaceless context, and a job queue shared by all of them.
+ *
+ * The devices are listed with EGL_EXT_device_enumeration (eglQueryDevicesEXT)
+ * and opened with eglGetPlatformDisplayEXT(EGL_PLATFORM_DEVICE_EXT): every
+ * GPU of a render node (and the software rasterizer of Mesa) is a device,
+ * independent of a window system or of EGL_DEFAULT_DISPLAY. Without the
+ * extension the default display is the only device.
+ *
+ * Every worker thread creates a GL ES 3 context on its device, without a
+ * surface (EGL_KHR_surfaceless_context, otherwise a 1x1 pbuffer), makes it
+ * current and takes the jobs from the shared queue one at a time. A device
+ * which is done early takes the next job: the faster GPUs run more of them,
+ * the throughput grows with the device count as long as the jobs are
+ * independent. The contexts of different devices share nothing: the objects
+ * a job needs live in the per-worker state created by the "createState"
+ * callback on the worker (with its context current), a job returns its
+ * results on the CPU (ex.: the read back pixels).
+ *
+ * "workersPerDevice" > 1 starts several contexts per device, they overlap
+ * the CPU part of the jobs (submission, readback) with the GPU work.
+ *
+ * Usage:
+ *
+ *   std::vector<EGLDeviceInfo> devices;
+ *   listEGLDevices(&devices);
+ *   DevicePool pool;
+ *   initDevicePool(&pool, 0, 1, createState, destroyState, &settings); // all devices
+ *   std::vector<DeviceJob> jobs(100);
+ *   for (DeviceJob& job : jobs) {
+ *       devicePoolSubmit(&pool, &job, renderJob, &job);
+ *   }
+ *   devicePoolWaitAll(&pool);
+ *   printDevicePoolStats(&pool, seconds);
+ *   destroyDevicePool(&pool);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *  * EGL (EGL_EXT_device_enumeration and EGL_EXT_platform_device for more than one device)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_DEVICE_POOL_H
+#define GLES_COMMON_DEVICE_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// An EGL device (EGLDeviceEXT, NULL: the default display).
+struct EGLDeviceInfo {
+    void* device;
+    std::string name; // the DRM render node (or primary node) file, "software" for the Mesa rasterizer
+};
+
+// List the EGL devices, returns their count (1 entry for the default display without the extensions).
+int listEGLDevices(std::vector<EGLDeviceInfo>* devices);
+
+// The initialized EGLDisplay of a device, EGL_NO_DISPLAY on error.
+void* openEGLDeviceDisplay(const EGLDeviceInfo& device);
+
+struct DeviceWorker {
+    int index;
+    int device;           // index in DevicePool::devices
+    std::string renderer; // GL_RENDERER of the context
+    void* display;        // EGLDisplay, EGLContext, EGLSurface
+    void* context;
+    void* surface;
+    void* state; // set by the createState callback
+    std::thread thread;
+
+    // Statistics (guarded by the pool mutex).
+    int jobCount;
+    double busySeconds;
+};
+
+typedef void (*DeviceJobFunction)(DeviceWorker* worker, void* data);
+typedef void (*DeviceStateFunction)(DeviceWorker* worker, void* userData);
+
+struct DeviceJob {
+    DeviceJobFunction function;
+    void* data;
+
+    // Set by the worker (guarded by the pool mutex).
+    bool finished;
+    int worker; // the worker which ran the job
+};
+
+struct DevicePool {
+    std::vector<EGLDeviceInfo> devices;
+    std::vector<void*> displays; // EGLDisplay of each device (EGL_NO_DISPLAY if it failed)
+    std::vector<DeviceWorker*> workers;
+    DeviceStateFunction createState;
+    DeviceStateFunction destroyState;
+    void* userData;
+
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable jobFinished;
+    std::deque<DeviceJob*> queue;
+    int pending; // submitted jobs which are not finished
+    int started; // workers which finished their context creation (successful or not)
+    bool stopping;
+};
+
+// Start the workers on the first "maxDevices" devices (0: every device). Returns the number of started workers.
+/* Waits until every worker has its context, the failed ones are dropped (and printed).
+ * The callbacks (optional) run on the worker threads with their contexts current. */
+int initDevicePool(DevicePool* pool, int maxDevices, int workersPerDevice, DeviceStateFunction createState,
+                   DeviceStateFunction destroyState, void* userData);
+
+// Stop the workers after the queued jobs are done.
+void destroyDevicePool(DevicePool* pool);
+
+// Queue function(worker, data) for the next free worker (the job must stay alive until it's finished).
+void devicePoolSubmit(DevicePool* pool, DeviceJob* job, DeviceJobFunction function, void* data);
+
+// Wait until the job is finished.
+void devicePoolWait(DevicePool* pool, DeviceJob* job);
+
+// Wait until every submitted job is finished.
+void devicePoolWaitAll(DevicePool* pool);
+
+// Print the jobs and the busy time of every worker, and the throughput over "seconds".
+void printDevicePoolStats(DevicePool* pool, double seconds);
+
+#endif // GLES_COMMON_DEVICE_POOL_H
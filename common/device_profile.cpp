@@ -0,0 +1,619 @@
+/**
+ * Device capability probe, see device_profile.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/device_profile.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+#include <GLES3/gl31.h>
+
+#include "common/compute.h"
+#include "common/gl_state.h"
+#include "common/program_cache.h"
+#include "common/render_formats.h"
+#include "common/shader_precision.h"
+#include "common/stream_buffer.h"
+
+// Increase when the keys or the calibration change: the old profiles are calibrated again.
+static const int PROFILE_FILE_VERSION = 3;
+
+static const char* fill_vertex_src = R"(#version 300 es
+void main() {
+    // A triangle covering the viewport.
+    vec2 position = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1)) * 4.0 - 1.0;
+    gl_Position = vec4(position, 0.0, 1.0);
+}
+)";
+
+static const char* fill_fragment_src = R"(#version 300 es
+precision mediump float;
+uniform vec4 color;
+out vec4 outColor;
+void main() {
+    outColor = color;
+}
+)";
+
+static const char* stream_kernel_src = R"(#version 310 es
+layout(std430, binding = 0) buffer Values { float values[]; };
+
+void main() {
+    int index = GLOBAL_INDEX;
+    if (index >= uGridSize.x) {
+        return;
+    }
+    float value = values[index];
+    for (int step = 0; step < 16; step++) {
+        value = value * 1.0001 + 0.5;
+    }
+    values[index] = value;
+}
+)";
+
+// 3x3 box filter: the taps of the neighbour invocations share the texture cache.
+static const char* tile_kernel_src = R"(#version 310 es
+precision highp float;
+uniform highp sampler2D uSource;
+layout(rgba8, binding = 0) writeonly uniform highp image2D uTarget;
+
+void main() {
+    ivec2 pixel = GLOBAL_ID_2D;
+    if (any(greaterThanEqual(pixel, uGridSize.xy))) {
+        return;
+    }
+    vec4 sum = vec4(0.0);
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            sum += texelFetch(uSource, clamp(pixel + ivec2(x, y), ivec2(0), uGridSize.xy - 1), 0);
+        }
+    }
+    imageStore(uTarget, pixel, sum / 9.0);
+}
+)";
+
+static DeviceProfile activeProfile;
+static bool profileLoaded = false;
+
+static double secondsNow() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t hashString(uint64_t hash, const char* str) {
+    for (const unsigned char* ptr = (const unsigned char*)str; *ptr; ptr++) {
+        hash ^= *ptr;
+        hash *= 0x100000001b3ULL;
+    }
+    hash ^= 0xff;
+    hash *= 0x100000001b3ULL;
+    return hash;
+}
+
+static const char* profileDirectory() {
+    const char* dir = getenv("GLES_DEVICE_PROFILE_DIR");
+    return dir != NULL ? dir : "device_profiles";
+}
+
+static std::string glString(GLenum name) {
+    const char* value = (const char*)glGetString(name);
+    return value != NULL ? value : "";
+}
+
+static int glInteger(GLenum name) {
+    int value = 0;
+    glGetIntegerv(name, &value);
+    return value;
+}
+
+static std::string profilePath(const std::string& vendor, const std::string& renderer, const std::string& version) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = hashString(hash, vendor.c_str());
+    hash = hashString(hash, renderer.c_str());
+    hash = hashString(hash, version.c_str());
+
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.txt", (unsigned long long)hash);
+    return std::string(profileDirectory()) + name;
+}
+
+// P.1. The capabilities: version, extensions, limits, formats and precision.
+static void probeCapabilities(DeviceProfile* profile) {
+    profile->glMajor = glInteger(GL_MAJOR_VERSION);
+    profile->glMinor = glInteger(GL_MINOR_VERSION);
+    bool es31 = profile->glMajor > 3 || (profile->glMajor == 3 && profile->glMinor >= 1);
+
+    profile->extensions.clear();
+    int count = glInteger(GL_NUM_EXTENSIONS);
+    for (int idx = 0; idx < count; idx++) {
+        profile->extensions.push_back((const char*)glGetStringi(GL_EXTENSIONS, idx));
+    }
+
+    profile->maxTextureSize = glInteger(GL_MAX_TEXTURE_SIZE);
+    profile->maxRenderbufferSize = glInteger(GL_MAX_RENDERBUFFER_SIZE);
+    profile->maxSamples = glInteger(GL_MAX_SAMPLES);
+    profile->maxDrawBuffers = glInteger(GL_MAX_DRAW_BUFFERS);
+    profile->maxUniformBlockSize = glInteger(GL_MAX_UNIFORM_BLOCK_SIZE);
+    profile->maxVertexStorageBlocks = es31 ? glInteger(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS) : 0;
+    profile->maxComputeInvocations = 0;
+    profile->maxComputeSharedMemory = 0;
+    if (es31) {
+        ComputeLimits limits;
+        queryComputeLimits(&limits);
+        profile->maxComputeInvocations = limits.maxGroupInvocations;
+        profile->maxComputeSharedMemory = limits.maxSharedMemorySize;
+    }
+
+    PrecisionFormat highp;
+    PrecisionFormat mediump;
+    queryFragmentPrecision(&highp, &mediump);
+    profile->highpPrecision = highp.precision;
+    profile->mediumpPrecision = mediump.precision;
+
+    profile->renderFormats.clear();
+    int formatCount = 0;
+    const RenderFormat* formats = renderFormats(&formatCount);
+    for (int idx = 0; idx < formatCount; idx++) {
+        if (renderFormatSupported(&formats[idx], RENDER_TARGET_RENDERBUFFER)) {
+            profile->renderFormats.push_back(formats[idx].name);
+        }
+    }
+}
+
+// P.2.1. Fill rate: full screen draws into a renderbuffer of the format (Mpixels/s, 0 if it isn't renderable).
+static double measureFillRate(unsigned int program, unsigned int format) {
+    const int size = 512;
+    const int draws = 32;
+
+    unsigned int renderbuffer;
+    glGenRenderbuffers(1, &renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, format, size, size);
+    unsigned int fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer);
+
+    double rate = 0.0;
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) {
+        glViewport(0, 0, size, size);
+        glUseProgram(program);
+        int colorLoc = glGetUniformLocation(program, "color");
+
+        // The first draw pays for the lazy allocation and the shader variant of the format.
+        glUniform4f(colorLoc, 0.0f, 0.0f, 0.0f, 1.0f);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glFinish();
+
+        double start = secondsNow();
+        for (int idx = 0; idx < draws; idx++) {
+            glUniform4f(colorLoc, (float)idx / draws, 0.5f, 0.25f, 1.0f);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        glFinish();
+        double seconds = secondsNow() - start;
+        rate = (double)size * size * draws / std::max(seconds, 1e-6) / 1000000.0;
+    }
+
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &renderbuffer);
+    return rate;
+}
+
+// P.2.2. Upload rate: glTexSubImage2D of RGBA8 images (MB/s).
+static double measureUploadRate() {
+    const int size = 1024;
+    const int uploads = 8;
+    std::vector<uint8_t> pixels((size_t)size * size * 4);
+    for (size_t idx = 0; idx < pixels.size(); idx++) {
+        pixels[idx] = (uint8_t)(idx * 7);
+    }
+
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, size, size);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glFinish();
+
+    double start = secondsNow();
+    for (int idx = 0; idx < uploads; idx++) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    }
+    glFinish();
+    double seconds = secondsNow() - start;
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDeleteTextures(1, &texture);
+    return (double)pixels.size() * uploads / std::max(seconds, 1e-6) / (1024.0 * 1024.0);
+}
+
+// P.2.3. Compute: the fastest 1D work group size of a streaming kernel (0 without compute).
+static int measureComputeGroupSize(const DeviceProfile* profile) {
+    if (profile->maxComputeInvocations <= 0) {
+        return 0;
+    }
+
+    const int count = 1 << 20;
+    const int dispatches = 4;
+    unsigned int buffer = createStorageBufferObject(count * sizeof(float), NULL);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffer);
+
+    int bestSize = 0;
+    double bestSeconds = 0.0;
+    for (int size = 32; size <= std::min(512, profile->maxComputeInvocations); size *= 2) {
+        ComputeKernel kernel;
+        if (!createComputeKernelSized(&kernel, stream_kernel_src, size, 1, 1)) {
+            continue;
+        }
+        computeDispatch(&kernel, count, 1, 1);
+        glFinish();
+
+        double start = secondsNow();
+        for (int idx = 0; idx < dispatches; idx++) {
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            computeDispatch(&kernel, count, 1, 1);
+        }
+        glFinish();
+        double seconds = secondsNow() - start;
+        destroyComputeKernel(&kernel);
+
+        if (bestSize == 0 || seconds < bestSeconds) {
+            bestSize = size;
+            bestSeconds = seconds;
+        }
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    destroyStorageBufferObject(buffer);
+    return bestSize;
+}
+
+// P.2.4. Compute: the fastest 2D tile of an image filter, then whether the swizzled groups are faster.
+static void measureComputeTile(DeviceProfile* profile) {
+    profile->computeTile[0] = 0;
+    profile->computeTile[1] = 0;
+    profile->computeTileSwizzle = false;
+    if (profile->maxComputeInvocations <= 0) {
+        return;
+    }
+
+    const int size = 1024;
+    const int dispatches = 3;
+    unsigned int textures[2];
+    glGenTextures(2, textures);
+    for (int idx = 0; idx < 2; idx++) {
+        glBindTexture(GL_TEXTURE_2D, textures[idx]);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, size, size);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, textures[0]);
+    glBindImageTexture(0, textures[1], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+    static const int tiles[][2] = { { 8, 8 }, { 16, 8 }, { 8, 16 }, { 16, 16 }, { 32, 8 }, { 32, 16 }, { 32, 32 } };
+    double bestSeconds[2] = { 0.0, 0.0 }; // [swizzle]
+    int bestTile[2][2] = { { 0, 0 }, { 0, 0 } };
+    for (const int* tile : tiles) {
+        if (tile[0] * tile[1] > profile->maxComputeInvocations) {
+            continue;
+        }
+        for (int swizzle = 0; swizzle < 2; swizzle++) {
+            ComputeKernel kernel;
+            if (!createComputeKernel2D(&kernel, tile_kernel_src, tile[0], tile[1],
+                                       swizzle ? COMPUTE_SWIZZLE_MORTON : COMPUTE_SWIZZLE_OFF)) {
+                continue;
+            }
+            computeDispatch(&kernel, size, size, 1);
+            glFinish();
+
+            double start = secondsNow();
+            for (int idx = 0; idx < dispatches; idx++) {
+                computeDispatch(&kernel, size, size, 1);
+            }
+            glFinish();
+            double seconds = secondsNow() - start;
+            destroyComputeKernel(&kernel);
+
+            if (bestTile[swizzle][0] == 0 || seconds < bestSeconds[swizzle]) {
+                bestSeconds[swizzle] = seconds;
+                bestTile[swizzle][0] = tile[0];
+                bestTile[swizzle][1] = tile[1];
+            }
+        }
+    }
+
+    /* The swizzle only pays off if it's clearly faster: otherwise the plain row order is kept. */
+    int choice = bestTile[1][0] > 0 && bestSeconds[1] < bestSeconds[0] * 0.95 ? 1 : 0;
+    profile->computeTile[0] = bestTile[choice][0];
+    profile->computeTile[1] = bestTile[choice][1];
+    profile->computeTileSwizzle = choice == 1;
+
+    glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDeleteTextures(2, textures);
+}
+
+// P.2.5. Streaming uploads: frames of 64 allocations of 16 KB, each one read by the GPU (a buffer copy).
+/* Returns the name of the fastest upload mode of stream_buffer.h. */
+static std::string measureStreamUpload() {
+    const int allocationSize = 16 * 1024;
+    const int allocations = 64;
+    const int frames = 16;
+    std::vector<uint8_t> data(allocationSize, 0x5a);
+
+    unsigned int copyBuffer;
+    glGenBuffers(1, &copyBuffer);
+    stateCacheBindBuffer(GL_COPY_WRITE_BUFFER, copyBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, allocationSize, NULL, GL_STREAM_COPY);
+
+    int bestMode = STREAM_UPLOAD_RING;
+    double bestSeconds = 0.0;
+    for (int mode = 0; mode < STREAM_UPLOAD_MODE_COUNT; mode++) {
+        StreamBuffer stream;
+        initStreamBuffer(&stream, GL_COPY_READ_BUFFER, allocationSize * allocations, (StreamUploadMode)mode);
+
+        // The first frame isn't timed: it allocates the storage.
+        double start = 0.0;
+        for (int frame = -1; frame < frames; frame++) {
+            if (frame == 0) {
+                glFinish();
+                start = secondsNow();
+            }
+
+            int offsets[allocations];
+            streamBufferBeginFrame(&stream);
+            for (int idx = 0; idx < allocations; idx++) {
+                void* dst = streamBufferAllocate(&stream, allocationSize, 256, &offsets[idx]);
+                if (dst != NULL) {
+                    memcpy(dst, data.data(), allocationSize);
+                }
+            }
+            streamBufferEndFrame(&stream);
+
+            stateCacheBindBuffer(GL_COPY_READ_BUFFER, stream.buffer);
+            for (int idx = 0; idx < allocations; idx++) {
+                if (offsets[idx] >= 0) {
+                    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offsets[idx], 0, allocationSize);
+                }
+            }
+            stateCacheBindBuffer(GL_COPY_READ_BUFFER, 0);
+        }
+        glFinish();
+        double seconds = secondsNow() - start;
+        destroyStreamBuffer(&stream);
+
+        if (mode == STREAM_UPLOAD_RING || seconds < bestSeconds) {
+            bestMode = mode;
+            bestSeconds = seconds;
+        }
+    }
+
+    stateCacheBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &copyBuffer);
+    return streamUploadModeName((StreamUploadMode)bestMode);
+}
+
+// P.2. The calibration benchmarks, the framebuffer, the viewport and the program are restored afterwards.
+static void calibrate(DeviceProfile* profile) {
+    int framebuffer = glInteger(GL_FRAMEBUFFER_BINDING);
+    int program = glInteger(GL_CURRENT_PROGRAM);
+    int viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+
+    unsigned int fillProgram = createCachedProgram(fill_vertex_src, fill_fragment_src);
+    profile->fillRateRgba8 = measureFillRate(fillProgram, GL_RGBA8);
+    profile->fillRateRgb565 = measureFillRate(fillProgram, GL_RGB565);
+    glDeleteProgram(fillProgram);
+
+    /* RGB565 halves the bandwidth and the memory: preferred unless RGBA8 is clearly faster. */
+    profile->colorFormat = profile->fillRateRgba8 > profile->fillRateRgb565 * 1.1 ? "RGBA8" : "RGB565";
+
+    profile->uploadRate = measureUploadRate();
+    profile->computeGroupSize = measureComputeGroupSize(profile);
+    measureComputeTile(profile);
+    profile->streamUpload = measureStreamUpload();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glUseProgram(program);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    if (blend) {
+        glEnable(GL_BLEND);
+    }
+    if (depthTest) {
+        glEnable(GL_DEPTH_TEST);
+    }
+    stateCacheInvalidate();
+}
+
+// P.3. The profile file: "key value" lines, the strings and the lists take the rest of the line.
+static void storeProfile(const DeviceProfile& profile, const std::string& path) {
+    mkdir(profileDirectory(), 0755);
+
+    // Write into a temporary file first so a concurrent run never reads a partial profile.
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath.c_str());
+        if (!file) {
+            printf("Device profile: unable to write '%s'\n", tmpPath.c_str());
+            return;
+        }
+        file << "profile_version " << PROFILE_FILE_VERSION << "\n";
+        file << "vendor " << profile.vendor << "\n";
+        file << "renderer " << profile.renderer << "\n";
+        file << "version " << profile.version << "\n";
+        file << "gl_version " << profile.glMajor << " " << profile.glMinor << "\n";
+        file << "max_texture_size " << profile.maxTextureSize << "\n";
+        file << "max_renderbuffer_size " << profile.maxRenderbufferSize << "\n";
+        file << "max_samples " << profile.maxSamples << "\n";
+        file << "max_draw_buffers " << profile.maxDrawBuffers << "\n";
+        file << "max_uniform_block_size " << profile.maxUniformBlockSize << "\n";
+        file << "max_vertex_storage_blocks " << profile.maxVertexStorageBlocks << "\n";
+        file << "max_compute_invocations " << profile.maxComputeInvocations << "\n";
+        file << "max_compute_shared_memory " << profile.maxComputeSharedMemory << "\n";
+        file << "precision " << profile.highpPrecision << " " << profile.mediumpPrecision << "\n";
+        file << "fill_rate " << profile.fillRateRgba8 << " " << profile.fillRateRgb565 << "\n";
+        file << "upload_rate " << profile.uploadRate << "\n";
+        file << "compute_group_size " << profile.computeGroupSize << "\n";
+        file << "compute_tile " << profile.computeTile[0] << " " << profile.computeTile[1] << " "
+             << (profile.computeTileSwizzle ? 1 : 0) << "\n";
+        file << "color_format " << profile.colorFormat << "\n";
+        file << "stream_upload " << profile.streamUpload << "\n";
+        for (const std::string& format : profile.renderFormats) {
+            file << "render_format " << format << "\n";
+        }
+        for (const std::string& extension : profile.extensions) {
+            file << "extension " << extension << "\n";
+        }
+    }
+
+    rename(tmpPath.c_str(), path.c_str());
+}
+
+// The profile must be of this file version and of the same driver (not just of the same hash).
+static bool loadProfile(DeviceProfile* profile, const std::string& path) {
+    std::ifstream file(path.c_str());
+    if (!file) {
+        return false;
+    }
+
+    int fileVersion = 0;
+    std::string vendor = profile->vendor;
+    std::string renderer = profile->renderer;
+    std::string version = profile->version;
+    profile->renderFormats.clear();
+    profile->extensions.clear();
+
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t split = line.find(' ');
+        std::string key = line.substr(0, split);
+        std::string value = split == std::string::npos ? "" : line.substr(split + 1);
+        std::istringstream values(value);
+        if (key == "profile_version") {
+            values >> fileVersion;
+        } else if (key == "vendor") {
+            vendor = value;
+        } else if (key == "renderer") {
+            renderer = value;
+        } else if (key == "version") {
+            version = value;
+        } else if (key == "gl_version") {
+            values >> profile->glMajor >> profile->glMinor;
+        } else if (key == "max_texture_size") {
+            values >> profile->maxTextureSize;
+        } else if (key == "max_renderbuffer_size") {
+            values >> profile->maxRenderbufferSize;
+        } else if (key == "max_samples") {
+            values >> profile->maxSamples;
+        } else if (key == "max_draw_buffers") {
+            values >> profile->maxDrawBuffers;
+        } else if (key == "max_uniform_block_size") {
+            values >> profile->maxUniformBlockSize;
+        } else if (key == "max_vertex_storage_blocks") {
+            values >> profile->maxVertexStorageBlocks;
+        } else if (key == "max_compute_invocations") {
+            values >> profile->maxComputeInvocations;
+        } else if (key == "max_compute_shared_memory") {
+            values >> profile->maxComputeSharedMemory;
+        } else if (key == "precision") {
+            values >> profile->highpPrecision >> profile->mediumpPrecision;
+        } else if (key == "fill_rate") {
+            values >> profile->fillRateRgba8 >> profile->fillRateRgb565;
+        } else if (key == "upload_rate") {
+            values >> profile->uploadRate;
+        } else if (key == "compute_group_size") {
+            values >> profile->computeGroupSize;
+        } else if (key == "compute_tile") {
+            int swizzle = 0;
+            values >> profile->computeTile[0] >> profile->computeTile[1] >> swizzle;
+            profile->computeTileSwizzle = swizzle != 0;
+        } else if (key == "color_format") {
+            profile->colorFormat = value;
+        } else if (key == "stream_upload") {
+            profile->streamUpload = value;
+        } else if (key == "render_format") {
+            profile->renderFormats.push_back(value);
+        } else if (key == "extension") {
+            profile->extensions.push_back(value);
+        }
+    }
+
+    return fileVersion == PROFILE_FILE_VERSION && vendor == profile->vendor && renderer == profile->renderer
+        && version == profile->version;
+}
+
+const DeviceProfile* loadDeviceProfile(bool refresh) {
+    DeviceProfile* profile = &activeProfile;
+    profile->vendor = glString(GL_VENDOR);
+    profile->renderer = glString(GL_RENDERER);
+    profile->version = glString(GL_VERSION);
+    std::string path = profilePath(profile->vendor, profile->renderer, profile->version);
+
+    if (refresh || !loadProfile(profile, path)) {
+        double start = secondsNow();
+        probeCapabilities(profile);
+        calibrate(profile);
+        printf("Device profile: calibrated in %.0f ms, stored as '%s'\n", (secondsNow() - start) * 1000.0,
+               path.c_str());
+        storeProfile(*profile, path);
+    }
+
+    profileLoaded = true;
+    return profile;
+}
+
+const DeviceProfile* deviceProfile() {
+    return profileLoaded ? &activeProfile : NULL;
+}
+
+void printDeviceProfile(const DeviceProfile* profile) {
+    printf("Device profile: %s, %s (Open GL ES %d.%d, %d extensions)\n", profile->renderer.c_str(),
+           profile->vendor.c_str(), profile->glMajor, profile->glMinor, (int)profile->extensions.size());
+    printf("  limits: texture %d, renderbuffer %d, samples %d, draw buffers %d, uniform block %d bytes\n",
+           profile->maxTextureSize, profile->maxRenderbufferSize, profile->maxSamples, profile->maxDrawBuffers,
+           profile->maxUniformBlockSize);
+    printf("  compute: %d invocations, %d bytes shared memory, vertex storage blocks: %d\n",
+           profile->maxComputeInvocations, profile->maxComputeSharedMemory, profile->maxVertexStorageBlocks);
+    printf("  precision: highp %d bits, mediump %d bits, %d renderable formats\n", profile->highpPrecision,
+           profile->mediumpPrecision, (int)profile->renderFormats.size());
+    printf("  fill rate: RGBA8 %.0f Mpixels/s, RGB565 %.0f Mpixels/s (color format: %s)\n", profile->fillRateRgba8,
+           profile->fillRateRgb565, profile->colorFormat.c_str());
+    printf("  upload: %.0f MB/s (stream buffers: %s), compute group size: %d, compute tile: %dx%d%s\n",
+           profile->uploadRate, profile->streamUpload.c_str(), profile->computeGroupSize, profile->computeTile[0],
+           profile->computeTile[1], profile->computeTileSwizzle ? " (swizzled)" : "");
+}
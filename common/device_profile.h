@@ -0,0 +1,122 @@
+/**
+ * Device capability probe and per-GPU tuning profile.
+ *
+ * The probe collects what the features of the demos otherwise query one by one
+ * (the GL ES version, the extensions, the limits, the renderable formats and the
+ * fragment shader precision) and runs short calibration benchmarks:
+ *  fill rate      Full screen draws into a 512x512 RGBA8 and RGB565 renderbuffer
+ *                 (Mpixels/s), the faster format is the preferred color format.
+ *  upload rate    glTexSubImage2D of 4 MB RGBA8 images (MB/s).
+ *  compute group  The fastest 1D work group size (32 .. 512 invocations) of a
+ *                 streaming kernel, 0 without Open GL ES 3.1.
+ *  compute tile   The fastest 2D tile (8x8 .. 32x32) of a 3x3 image filter over a
+ *                 1024x1024 RGBA8 image, with and without the Z-order swizzle of
+ *                 the work groups (kept if it's at least 5% faster).
+ *  stream upload  The fastest upload mode of stream_buffer.h for frames of 64
+ *                 allocations of 16 KB, each one read by the GPU (a buffer copy).
+ * Every benchmark waits for the GPU with glFinish and measures the CPU time.
+ *
+ * The results are stored as a text file ("key value" lines) per GPU and driver:
+ * the file name is the hash of GL_VENDOR, GL_RENDERER and GL_VERSION in the
+ * "device_profiles" directory (GLES_DEVICE_PROFILE_DIR overrides it). Later runs
+ * load the file instead of calibrating again, a driver update creates a new one.
+ *
+ * The demo context loads the profile with "--device-profile" (or calibrates
+ * again with "--device-profile-refresh", see demo_context.h). The features read
+ * their defaults from deviceProfile() if it's loaded, the built-in defaults are
+ * used otherwise; the explicit options always win:
+ *  * compute.h: the 1D work group size and the 2D tile of createComputeKernel, the swizzle
+ *    of createComputeKernel2D (COMPUTE_SWIZZLE_AUTO)
+ *  * stream_buffer.h: the upload mode of initStreamBuffer (STREAM_UPLOAD_AUTO)
+ *  * 09_gles_depth: the color format ("--color-format")
+ *  * x_gles_virtual_texture: the tile uploads per frame ("--upload-budget")
+ *
+ * Usage:
+ *
+ *   loadDeviceProfile(false); // after the context creation
+ *   ...
+ *   const DeviceProfile* profile = deviceProfile();
+ *   int groupSize = (profile != NULL && profile->computeGroupSize > 0) ? profile->computeGroupSize : 256;
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *  * Open GL ES 3.1+ (the compute calibration)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_DEVICE_PROFILE_H
+#define GLES_COMMON_DEVICE_PROFILE_H
+
+#include <string>
+#include <vector>
+
+struct DeviceProfile {
+    // Identification (the key of the profile file).
+    std::string vendor;
+    std::string renderer;
+    std::string version;
+    int glMajor;
+    int glMinor;
+
+    std::vector<std::string> extensions;
+
+    // Limits.
+    int maxTextureSize;
+    int maxRenderbufferSize;
+    int maxSamples;
+    int maxDrawBuffers;
+    int maxUniformBlockSize;
+    int maxVertexStorageBlocks;  // 0 before Open GL ES 3.1
+    int maxComputeInvocations;   // 0 before Open GL ES 3.1
+    int maxComputeSharedMemory;  // in bytes
+
+    // Fragment shader float precision (bits of the mantissa).
+    int highpPrecision;
+    int mediumpPrecision;
+
+    // The formats of render_formats.h which can be rendered into as a renderbuffer.
+    std::vector<std::string> renderFormats;
+
+    // Calibration.
+    double fillRateRgba8;  // Mpixels/s
+    double fillRateRgb565; // Mpixels/s
+    double uploadRate;     // MB/s
+    int computeGroupSize;  // 1D invocations, 0: no compute
+    int computeTile[2];    // 2D local size, 0: no compute
+    bool computeTileSwizzle;
+    std::string colorFormat;
+    std::string streamUpload; // the fastest upload mode of stream_buffer.h (ex.: "ring")
+};
+
+// Load the profile of the current GPU/driver, probe and calibrate it (and store it) if there is no profile file.
+/* "refresh": calibrate again even if the profile file exists. Requires a current GL ES context, the
+ * calibration changes the GL state (the framebuffer, the viewport and the program are restored). */
+const DeviceProfile* loadDeviceProfile(bool refresh);
+
+// The profile loaded by loadDeviceProfile, NULL if it wasn't loaded: the features use their built-in defaults.
+const DeviceProfile* deviceProfile();
+
+// Print the identification, the main limits and the calibration results.
+void printDeviceProfile(const DeviceProfile* profile);
+
+#endif // GLES_COMMON_DEVICE_PROFILE_H
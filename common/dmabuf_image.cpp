@@ -0,0 +1,814 @@
+/**
+ * Zero-copy dma-buf import and export. See dmabuf_image.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/dmabuf_image.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <linux/dma-buf.h>
+#include <linux/udmabuf.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+const char* dmaBufFormatNames[DMABUF_FORMAT_COUNT] = {
+    "xrgb8888", "abgr8888", "nv12", "yuv420", "yuyv",
+};
+
+bool parseDmaBufFormat(const char* name, DmaBufFormat* format) {
+    for (int idx = 0; idx < DMABUF_FORMAT_COUNT; idx++) {
+        if (strcmp(name, dmaBufFormatNames[idx]) == 0) {
+            *format = (DmaBufFormat)idx;
+            return true;
+        }
+    }
+
+    printf("Unknown dma-buf format '%s', valid formats:", name);
+    for (int idx = 0; idx < DMABUF_FORMAT_COUNT; idx++) {
+        printf(" %s", dmaBufFormatNames[idx]);
+    }
+    printf("\n");
+    return false;
+}
+
+#define DMABUF_FOURCC_CODE(a, b, c, d) \
+    ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+uint32_t dmaBufFourcc(DmaBufFormat format) {
+    switch (format) {
+    case DMABUF_XRGB8888: return DMABUF_FOURCC_CODE('X', 'R', '2', '4');
+    case DMABUF_ABGR8888: return DMABUF_FOURCC_CODE('A', 'B', '2', '4');
+    case DMABUF_NV12: return DMABUF_FOURCC_CODE('N', 'V', '1', '2');
+    case DMABUF_YUV420: return DMABUF_FOURCC_CODE('Y', 'U', '1', '2');
+    default: return DMABUF_FOURCC_CODE('Y', 'U', 'Y', 'V');
+    }
+}
+
+bool dmaBufFormatIsYuv(DmaBufFormat format) {
+    return format == DMABUF_NV12 || format == DMABUF_YUV420 || format == DMABUF_YUYV;
+}
+
+static bool hasExtension(const char* list, const char* name) {
+    size_t length = strlen(name);
+    for (const char* ptr = list ? strstr(list, name) : NULL; ptr != NULL; ptr = strstr(ptr + length, name)) {
+        if ((ptr == list || ptr[-1] == ' ') && (ptr[length] == ' ' || ptr[length] == '\0')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool hasGLExtension(const char* name) {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int idx = 0; idx < count; idx++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, idx), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool dmaBufImportSupported(void* display, DmaBufFormat format) {
+    const char* extensions = eglQueryString((EGLDisplay)display, EGL_EXTENSIONS);
+    if (!hasExtension(extensions, "EGL_EXT_image_dma_buf_import")) {
+        printf("dma-buf import: EGL_EXT_image_dma_buf_import is not supported\n");
+        return false;
+    }
+    if (!hasGLExtension("GL_OES_EGL_image_external_essl3")) {
+        printf("dma-buf import: GL_OES_EGL_image_external_essl3 is not supported\n");
+        return false;
+    }
+
+    // Without the modifiers extension the formats can not be listed: try the import.
+    if (!hasExtension(extensions, "EGL_EXT_image_dma_buf_import_modifiers")) {
+        return true;
+    }
+
+    PFNEGLQUERYDMABUFFORMATSEXTPROC queryFormats =
+        (PFNEGLQUERYDMABUFFORMATSEXTPROC)eglGetProcAddress("eglQueryDmaBufFormatsEXT");
+    EGLint formats[256];
+    EGLint formatCount = 0;
+    if (queryFormats == NULL || !queryFormats((EGLDisplay)display, 256, formats, &formatCount)) {
+        return true;
+    }
+    for (int idx = 0; idx < formatCount; idx++) {
+        if ((uint32_t)formats[idx] == dmaBufFourcc(format)) {
+            return true;
+        }
+    }
+    printf("dma-buf import: the %s format is not supported\n", dmaBufFormatNames[format]);
+    return false;
+}
+
+bool importDmaBufTexture(void* display, const DmaBufFrame& frame, DmaBufTexture* texture) {
+    static PFNEGLCREATEIMAGEKHRPROC createImage =
+        (PFNEGLCREATEIMAGEKHRPROC)eglGetProcAddress("eglCreateImageKHR");
+    static PFNGLEGLIMAGETARGETTEXTURE2DOESPROC imageTargetTexture =
+        (PFNGLEGLIMAGETARGETTEXTURE2DOESPROC)eglGetProcAddress("glEGLImageTargetTexture2DOES");
+    if (createImage == NULL || imageTargetTexture == NULL) {
+        return false;
+    }
+
+    // I.1. The attributes of the import: size, format and the fd, offset, pitch (and modifier) of every plane.
+    static const EGLint planeAttribs[3][5] = {
+        { EGL_DMA_BUF_PLANE0_FD_EXT, EGL_DMA_BUF_PLANE0_OFFSET_EXT, EGL_DMA_BUF_PLANE0_PITCH_EXT,
+          EGL_DMA_BUF_PLANE0_MODIFIER_LO_EXT, EGL_DMA_BUF_PLANE0_MODIFIER_HI_EXT },
+        { EGL_DMA_BUF_PLANE1_FD_EXT, EGL_DMA_BUF_PLANE1_OFFSET_EXT, EGL_DMA_BUF_PLANE1_PITCH_EXT,
+          EGL_DMA_BUF_PLANE1_MODIFIER_LO_EXT, EGL_DMA_BUF_PLANE1_MODIFIER_HI_EXT },
+        { EGL_DMA_BUF_PLANE2_FD_EXT, EGL_DMA_BUF_PLANE2_OFFSET_EXT, EGL_DMA_BUF_PLANE2_PITCH_EXT,
+          EGL_DMA_BUF_PLANE2_MODIFIER_LO_EXT, EGL_DMA_BUF_PLANE2_MODIFIER_HI_EXT },
+    };
+
+    EGLint attribs[64];
+    int count = 0;
+    attribs[count++] = EGL_WIDTH;
+    attribs[count++] = frame.width;
+    attribs[count++] = EGL_HEIGHT;
+    attribs[count++] = frame.height;
+    attribs[count++] = EGL_LINUX_DRM_FOURCC_EXT;
+    attribs[count++] = (EGLint)dmaBufFourcc(frame.format);
+    for (int plane = 0; plane < frame.planeCount; plane++) {
+        attribs[count++] = planeAttribs[plane][0];
+        attribs[count++] = frame.planes[plane].fd;
+        attribs[count++] = planeAttribs[plane][1];
+        attribs[count++] = (EGLint)frame.planes[plane].offset;
+        attribs[count++] = planeAttribs[plane][2];
+        attribs[count++] = (EGLint)frame.planes[plane].pitch;
+        /* The modifier attributes are only valid with EGL_EXT_image_dma_buf_import_modifiers. */
+        if (frame.modifier != DMABUF_MODIFIER_INVALID) {
+            attribs[count++] = planeAttribs[plane][3];
+            attribs[count++] = (EGLint)(frame.modifier & 0xffffffff);
+            attribs[count++] = planeAttribs[plane][4];
+            attribs[count++] = (EGLint)(frame.modifier >> 32);
+        }
+    }
+    if (dmaBufFormatIsYuv(frame.format)) {
+        attribs[count++] = EGL_YUV_COLOR_SPACE_HINT_EXT;
+        attribs[count++] = EGL_ITU_REC709_EXT;
+        attribs[count++] = EGL_SAMPLE_RANGE_HINT_EXT;
+        attribs[count++] = EGL_YUV_NARROW_RANGE_EXT;
+    }
+    attribs[count++] = EGL_NONE;
+
+    // I.2. Create the EGLImage (no context: the dma-buf is not a GL object) and bind it to the texture.
+    EGLImageKHR image = createImage((EGLDisplay)display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT, NULL, attribs);
+    if (image == EGL_NO_IMAGE_KHR) {
+        printf("dma-buf import of a %dx%d %s frame failed: 0x%x\n", frame.width, frame.height,
+               dmaBufFormatNames[frame.format], eglGetError());
+        return false;
+    }
+
+    texture->display = display;
+    texture->image = image;
+    texture->target = GL_TEXTURE_EXTERNAL_OES;
+    glGenTextures(1, &texture->texture);
+    glBindTexture(GL_TEXTURE_EXTERNAL_OES, texture->texture);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    imageTargetTexture(GL_TEXTURE_EXTERNAL_OES, (GLeglImageOES)image);
+    glBindTexture(GL_TEXTURE_EXTERNAL_OES, 0);
+    return glGetError() == GL_NO_ERROR;
+}
+
+void refreshDmaBufTexture(const DmaBufTexture* texture) {
+    static PFNGLEGLIMAGETARGETTEXTURE2DOESPROC imageTargetTexture =
+        (PFNGLEGLIMAGETARGETTEXTURE2DOESPROC)eglGetProcAddress("glEGLImageTargetTexture2DOES");
+    glBindTexture(texture->target, texture->texture);
+    imageTargetTexture(texture->target, (GLeglImageOES)texture->image);
+    glBindTexture(texture->target, 0);
+}
+
+void destroyDmaBufTexture(DmaBufTexture* texture) {
+    static PFNEGLDESTROYIMAGEKHRPROC destroyImage =
+        (PFNEGLDESTROYIMAGEKHRPROC)eglGetProcAddress("eglDestroyImageKHR");
+    glDeleteTextures(1, &texture->texture);
+    if (texture->image != NULL && destroyImage != NULL) {
+        destroyImage((EGLDisplay)texture->display, (EGLImageKHR)texture->image);
+    }
+    texture->texture = 0;
+    texture->image = NULL;
+}
+
+bool allocateDmaBufFrame(DmaBufAllocation* allocation, int width, int height, DmaBufFormat format) {
+    allocation->memfd = -1;
+    allocation->dmabufFd = -1;
+    allocation->mapped = NULL;
+
+    // U.1. The plane layout: 64 byte aligned rows, the chroma planes after the luma plane.
+    DmaBufFrame& frame = allocation->frame;
+    frame.width = width;
+    frame.height = height;
+    frame.format = format;
+    frame.modifier = DMABUF_MODIFIER_INVALID;
+
+    auto alignPitch = [](int bytes) { return (uint32_t)((bytes + 63) & ~63); };
+    size_t size = 0;
+    switch (format) {
+    case DMABUF_NV12:
+        frame.planeCount = 2;
+        frame.planes[0] = { -1, 0, alignPitch(width) };
+        frame.planes[1] = { -1, frame.planes[0].pitch * height, alignPitch(width) };
+        size = frame.planes[1].offset + (size_t)frame.planes[1].pitch * (height / 2);
+        break;
+    case DMABUF_YUV420:
+        frame.planeCount = 3;
+        frame.planes[0] = { -1, 0, alignPitch(width) };
+        frame.planes[1] = { -1, frame.planes[0].pitch * height, alignPitch(width / 2) };
+        frame.planes[2] = { -1, frame.planes[1].offset + frame.planes[1].pitch * (height / 2), alignPitch(width / 2) };
+        size = frame.planes[2].offset + (size_t)frame.planes[2].pitch * (height / 2);
+        break;
+    case DMABUF_YUYV:
+        frame.planeCount = 1;
+        frame.planes[0] = { -1, 0, alignPitch(width * 2) };
+        size = (size_t)frame.planes[0].pitch * height;
+        break;
+    default:
+        frame.planeCount = 1;
+        frame.planes[0] = { -1, 0, alignPitch(width * 4) };
+        size = (size_t)frame.planes[0].pitch * height;
+        break;
+    }
+
+    /* udmabuf works on whole pages. */
+    long pageSize = sysconf(_SC_PAGESIZE);
+    allocation->size = (size + pageSize - 1) / pageSize * pageSize;
+
+    // U.2. A sealed memfd (udmabuf rejects a file which can shrink) exported through /dev/udmabuf.
+    int device = open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+    if (device < 0) {
+        printf("dma-buf frame: /dev/udmabuf is not available\n");
+        return false;
+    }
+
+    allocation->memfd = memfd_create("dmabuf_frame", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    bool ready = allocation->memfd >= 0 && ftruncate(allocation->memfd, allocation->size) == 0 &&
+                 fcntl(allocation->memfd, F_ADD_SEALS, F_SEAL_SHRINK) == 0;
+    if (ready) {
+        struct udmabuf_create create;
+        memset(&create, 0, sizeof(create));
+        create.memfd = allocation->memfd;
+        create.flags = UDMABUF_FLAGS_CLOEXEC;
+        create.offset = 0;
+        create.size = allocation->size;
+        allocation->dmabufFd = ioctl(device, UDMABUF_CREATE, &create);
+    }
+    close(device);
+
+    if (allocation->dmabufFd >= 0) {
+        void* mapped = mmap(NULL, allocation->size, PROT_READ | PROT_WRITE, MAP_SHARED, allocation->memfd, 0);
+        allocation->mapped = mapped != MAP_FAILED ? (uint8_t*)mapped : NULL;
+    }
+    if (allocation->mapped == NULL) {
+        printf("dma-buf frame: udmabuf allocation of %zu bytes failed\n", allocation->size);
+        releaseDmaBufFrame(allocation);
+        return false;
+    }
+
+    for (int plane = 0; plane < frame.planeCount; plane++) {
+        frame.planes[plane].fd = allocation->dmabufFd;
+    }
+    return true;
+}
+
+// BT.709 narrow range YUV of an 8 bit RGB color.
+static void rgbToYuv(const uint8_t* rgb, uint8_t* yuv) {
+    float r = rgb[0] / 255.0f;
+    float g = rgb[1] / 255.0f;
+    float b = rgb[2] / 255.0f;
+    float y = 0.2126f * r + 0.7152f * g + 0.0722f * b;
+    yuv[0] = (uint8_t)(16.0f + y * 219.0f + 0.5f);
+    yuv[1] = (uint8_t)(128.0f + (b - y) / 1.8556f * 224.0f + 0.5f);
+    yuv[2] = (uint8_t)(128.0f + (r - y) / 1.5748f * 224.0f + 0.5f);
+}
+
+void writeDmaBufTestFrame(DmaBufAllocation* allocation, int index) {
+    static const uint8_t bars[8][3] = {
+        { 255, 255, 255 }, { 255, 255, 0 }, { 0, 255, 255 }, { 0, 255, 0 },
+        { 255, 0, 255 },   { 255, 0, 0 },   { 0, 0, 255 },   { 0, 0, 0 },
+    };
+
+    struct dma_buf_sync sync = { DMA_BUF_SYNC_START | DMA_BUF_SYNC_WRITE };
+    ioctl(allocation->dmabufFd, DMA_BUF_IOCTL_SYNC, &sync);
+
+    // W.1. The color of a pixel: vertical bars moving to the right by 4 pixels every frame.
+    const DmaBufFrame& frame = allocation->frame;
+    auto barColor = [&](int x) { return bars[((x + frame.width * 8 - index * 4) % frame.width) * 8 / frame.width]; };
+
+    for (int y = 0; y < frame.height; y++) {
+        uint8_t* row = allocation->mapped + frame.planes[0].offset + (size_t)y * frame.planes[0].pitch;
+        for (int x = 0; x < frame.width; x++) {
+            const uint8_t* rgb = barColor(x);
+            uint8_t yuv[3];
+            switch (frame.format) {
+            case DMABUF_XRGB8888:
+                row[x * 4 + 0] = rgb[2];
+                row[x * 4 + 1] = rgb[1];
+                row[x * 4 + 2] = rgb[0];
+                row[x * 4 + 3] = 255;
+                break;
+            case DMABUF_ABGR8888:
+                row[x * 4 + 0] = rgb[0];
+                row[x * 4 + 1] = rgb[1];
+                row[x * 4 + 2] = rgb[2];
+                row[x * 4 + 3] = 255;
+                break;
+            case DMABUF_YUYV:
+                rgbToYuv(rgb, yuv);
+                row[x * 2 + 0] = yuv[0];
+                row[x * 2 + 1] = (x & 1) == 0 ? yuv[1] : yuv[2];
+                break;
+            default:
+                rgbToYuv(rgb, yuv);
+                row[x] = yuv[0];
+                break;
+            }
+        }
+    }
+
+    // W.2. The half resolution chroma planes (from the left pixel of every 2x2 block).
+    if (frame.format == DMABUF_NV12 || frame.format == DMABUF_YUV420) {
+        for (int y = 0; y < frame.height / 2; y++) {
+            for (int x = 0; x < frame.width / 2; x++) {
+                uint8_t yuv[3];
+                rgbToYuv(barColor(x * 2), yuv);
+                if (frame.format == DMABUF_NV12) {
+                    uint8_t* uv = allocation->mapped + frame.planes[1].offset + (size_t)y * frame.planes[1].pitch;
+                    uv[x * 2 + 0] = yuv[1];
+                    uv[x * 2 + 1] = yuv[2];
+                } else {
+                    allocation->mapped[frame.planes[1].offset + (size_t)y * frame.planes[1].pitch + x] = yuv[1];
+                    allocation->mapped[frame.planes[2].offset + (size_t)y * frame.planes[2].pitch + x] = yuv[2];
+                }
+            }
+        }
+    }
+
+    sync.flags = DMA_BUF_SYNC_END | DMA_BUF_SYNC_WRITE;
+    ioctl(allocation->dmabufFd, DMA_BUF_IOCTL_SYNC, &sync);
+}
+
+void releaseDmaBufFrame(DmaBufAllocation* allocation) {
+    if (allocation->mapped != NULL) {
+        munmap(allocation->mapped, allocation->size);
+    }
+    if (allocation->dmabufFd >= 0) {
+        close(allocation->dmabufFd);
+    }
+    if (allocation->memfd >= 0) {
+        close(allocation->memfd);
+    }
+    allocation->mapped = NULL;
+    allocation->dmabufFd = -1;
+    allocation->memfd = -1;
+}
+
+bool dmaBufExportSupported(void* display) {
+    const char* extensions = eglQueryString((EGLDisplay)display, EGL_EXTENSIONS);
+    if (!hasExtension(extensions, "EGL_MESA_image_dma_buf_export")) {
+        printf("dma-buf export: EGL_MESA_image_dma_buf_export is not supported\n");
+        return false;
+    }
+    if (!hasExtension(extensions, "EGL_KHR_gl_texture_2D_image")) {
+        printf("dma-buf export: EGL_KHR_gl_texture_2D_image is not supported\n");
+        return false;
+    }
+    return true;
+}
+
+bool createDmaBufRenderTarget(void* display, int width, int height, DmaBufRenderTarget* target) {
+    static PFNEGLCREATEIMAGEKHRPROC createImage =
+        (PFNEGLCREATEIMAGEKHRPROC)eglGetProcAddress("eglCreateImageKHR");
+    static PFNEGLEXPORTDMABUFIMAGEQUERYMESAPROC exportQuery =
+        (PFNEGLEXPORTDMABUFIMAGEQUERYMESAPROC)eglGetProcAddress("eglExportDMABUFImageQueryMESA");
+    static PFNEGLEXPORTDMABUFIMAGEMESAPROC exportImage =
+        (PFNEGLEXPORTDMABUFIMAGEMESAPROC)eglGetProcAddress("eglExportDMABUFImageMESA");
+
+    target->display = display;
+    target->image = NULL;
+    target->frame.planeCount = 0;
+    if (createImage == NULL || exportQuery == NULL || exportImage == NULL) {
+        return false;
+    }
+
+    // E.1. The immutable texture and the FBO rendering into it.
+    glGenTextures(1, &target->texture);
+    glBindTexture(GL_TEXTURE_2D, target->texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &target->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->texture, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // E.2. The EGLImage of the texture and the layout of its memory.
+    static const EGLint imageAttribs[] = { EGL_GL_TEXTURE_LEVEL_KHR, 0, EGL_NONE };
+    EGLImageKHR image = createImage((EGLDisplay)display, eglGetCurrentContext(), EGL_GL_TEXTURE_2D_KHR,
+                                    (EGLClientBuffer)(uintptr_t)target->texture, imageAttribs);
+    if (image == EGL_NO_IMAGE_KHR) {
+        printf("dma-buf export: EGLImage of the texture failed: 0x%x\n", eglGetError());
+        return false;
+    }
+    target->image = image;
+
+    int fourcc = 0;
+    int planeCount = 0;
+    EGLuint64KHR modifiers[4] = { 0 };
+    if (!exportQuery((EGLDisplay)display, image, &fourcc, &planeCount, modifiers) || planeCount > 3) {
+        printf("dma-buf export: the layout query failed\n");
+        return false;
+    }
+
+    DmaBufFrame& frame = target->frame;
+    frame.format = DMABUF_FORMAT_COUNT;
+    for (int idx = 0; idx < DMABUF_FORMAT_COUNT; idx++) {
+        if (dmaBufFourcc((DmaBufFormat)idx) == (uint32_t)fourcc) {
+            frame.format = (DmaBufFormat)idx;
+        }
+    }
+    if (frame.format == DMABUF_FORMAT_COUNT) {
+        printf("dma-buf export: unexpected fourcc 0x%08x\n", fourcc);
+        return false;
+    }
+
+    // E.3. The descriptors: the consumers import the same memory.
+    int fds[4] = { -1, -1, -1, -1 };
+    EGLint strides[4] = { 0 };
+    EGLint offsets[4] = { 0 };
+    if (!exportImage((EGLDisplay)display, image, fds, strides, offsets)) {
+        printf("dma-buf export failed: 0x%x\n", eglGetError());
+        return false;
+    }
+
+    frame.width = width;
+    frame.height = height;
+    frame.modifier = modifiers[0];
+    frame.planeCount = planeCount;
+    for (int plane = 0; plane < planeCount; plane++) {
+        /* The planes of one buffer can share the descriptor (only the first is returned then). */
+        frame.planes[plane].fd = fds[plane] >= 0 ? fds[plane] : fds[0];
+        frame.planes[plane].offset = (uint32_t)offsets[plane];
+        frame.planes[plane].pitch = (uint32_t)strides[plane];
+    }
+    return true;
+}
+
+bool importDmaBufRenderTarget(void* display, const DmaBufFrame& frame, DmaBufRenderTarget* target) {
+    static PFNGLEGLIMAGETARGETTEXTURE2DOESPROC imageTargetTexture =
+        (PFNGLEGLIMAGETARGETTEXTURE2DOESPROC)eglGetProcAddress("glEGLImageTargetTexture2DOES");
+
+    target->display = display;
+    target->image = NULL;
+    target->texture = 0;
+    target->fbo = 0;
+    target->frame = frame;
+    if (dmaBufFormatIsYuv(frame.format) || !hasGLExtension("GL_OES_EGL_image") || imageTargetTexture == NULL) {
+        return false;
+    }
+
+    // R.1. The image of the dma-buf bound as the storage of a 2D texture (not external: it is rendered into).
+    DmaBufTexture imported;
+    if (!importDmaBufTexture(display, frame, &imported)) {
+        return false;
+    }
+    glDeleteTextures(1, &imported.texture);
+    target->image = imported.image;
+
+    glGenTextures(1, &target->texture);
+    glBindTexture(GL_TEXTURE_2D, target->texture);
+    imageTargetTexture(GL_TEXTURE_2D, (GLeglImageOES)target->image);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // R.2. The FBO of the texture.
+    glGenFramebuffers(1, &target->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->texture, 0);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return complete && glGetError() == GL_NO_ERROR;
+}
+
+void destroyDmaBufRenderTarget(DmaBufRenderTarget* target) {
+    static PFNEGLDESTROYIMAGEKHRPROC destroyImage =
+        (PFNEGLDESTROYIMAGEKHRPROC)eglGetProcAddress("eglDestroyImageKHR");
+
+    closeDmaBufFrame(&target->frame);
+
+    if (target->image != NULL && destroyImage != NULL) {
+        destroyImage((EGLDisplay)target->display, (EGLImageKHR)target->image);
+    }
+    glDeleteFramebuffers(1, &target->fbo);
+    glDeleteTextures(1, &target->texture);
+    target->image = NULL;
+    target->fbo = 0;
+    target->texture = 0;
+}
+
+int createDmaBufFence(void* display) {
+    static PFNEGLCREATESYNCKHRPROC createSync = (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+    static PFNEGLDESTROYSYNCKHRPROC destroySync = (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+    static PFNEGLDUPNATIVEFENCEFDANDROIDPROC dupFence =
+        (PFNEGLDUPNATIVEFENCEFDANDROIDPROC)eglGetProcAddress("eglDupNativeFenceFDANDROID");
+
+    bool nativeFences = hasExtension(eglQueryString((EGLDisplay)display, EGL_EXTENSIONS), "EGL_ANDROID_native_fence_sync");
+    if (!nativeFences || createSync == NULL || destroySync == NULL || dupFence == NULL) {
+        glFinish();
+        return -1;
+    }
+
+    // F.1. The fence is only created (and its fd valid) after the flush of the commands.
+    static const EGLint attribs[] = { EGL_SYNC_NATIVE_FENCE_FD_ANDROID, EGL_NO_NATIVE_FENCE_FD_ANDROID, EGL_NONE };
+    EGLSyncKHR sync = createSync((EGLDisplay)display, EGL_SYNC_NATIVE_FENCE_ANDROID, attribs);
+    if (sync == EGL_NO_SYNC_KHR) {
+        glFinish();
+        return -1;
+    }
+    glFlush();
+    int fd = dupFence((EGLDisplay)display, sync);
+    destroySync((EGLDisplay)display, sync);
+    if (fd == EGL_NO_NATIVE_FENCE_FD_ANDROID) {
+        glFinish();
+        return -1;
+    }
+    return fd;
+}
+
+void waitDmaBufFence(void* display, int fenceFd) {
+    static PFNEGLCREATESYNCKHRPROC createSync = (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+    static PFNEGLDESTROYSYNCKHRPROC destroySync = (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+    static PFNEGLWAITSYNCKHRPROC waitSync = (PFNEGLWAITSYNCKHRPROC)eglGetProcAddress("eglWaitSyncKHR");
+
+    if (fenceFd < 0) {
+        return;
+    }
+
+    // F.2. Import the fence and queue a GPU side wait, EGL takes the ownership of the fd.
+    const char* extensions = eglQueryString((EGLDisplay)display, EGL_EXTENSIONS);
+    if (hasExtension(extensions, "EGL_ANDROID_native_fence_sync") && hasExtension(extensions, "EGL_KHR_wait_sync") &&
+        createSync != NULL && destroySync != NULL && waitSync != NULL) {
+        const EGLint attribs[] = { EGL_SYNC_NATIVE_FENCE_FD_ANDROID, fenceFd, EGL_NONE };
+        EGLSyncKHR sync = createSync((EGLDisplay)display, EGL_SYNC_NATIVE_FENCE_ANDROID, attribs);
+        if (sync != EGL_NO_SYNC_KHR) {
+            waitSync((EGLDisplay)display, sync, 0);
+            destroySync((EGLDisplay)display, sync);
+            return;
+        }
+    }
+
+    // F.3. No GPU wait: a sync_file is readable once it is signaled.
+    struct pollfd pollFd = { fenceFd, POLLIN, 0 };
+    poll(&pollFd, 1, -1);
+    close(fenceFd);
+}
+
+int acceptDmaBufConsumer(const char* path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    unlink(path);
+    if (listener < 0 || bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 1) != 0) {
+        printf("dma-buf sharing: can not listen on '%s'\n", path);
+        if (listener >= 0) {
+            close(listener);
+        }
+        return -1;
+    }
+
+    printf("dma-buf sharing: waiting for the consumer on '%s'\n", path);
+    int connection = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+    close(listener);
+    unlink(path);
+    return connection;
+}
+
+int connectDmaBufProducer(const char* path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+    int connection = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (connection < 0 || connect(connection, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        printf("dma-buf sharing: can not connect to '%s'\n", path);
+        if (connection >= 0) {
+            close(connection);
+        }
+        return -1;
+    }
+    return connection;
+}
+
+// The message of the sharing: a frame layout or a fence announcement, the descriptors ride along.
+struct DmaBufMessage {
+    uint32_t type; // DMABUF_MESSAGE_*
+    int32_t index;
+    int32_t width;
+    int32_t height;
+    int32_t format;
+    int32_t planeCount;
+    uint64_t modifier;
+    uint32_t offsets[3];
+    uint32_t pitches[3];
+};
+
+static const uint32_t DMABUF_MESSAGE_FRAME = 1;
+static const uint32_t DMABUF_MESSAGE_LAST_FRAME = 2;
+static const uint32_t DMABUF_MESSAGE_FENCE = 3;
+
+static bool sendMessage(int socket, const DmaBufMessage& message, const int* fds, int fdCount) {
+    struct iovec data = { (void*)&message, sizeof(message) };
+    char control[CMSG_SPACE(sizeof(int) * 3)];
+    memset(control, 0, sizeof(control));
+
+    struct msghdr header;
+    memset(&header, 0, sizeof(header));
+    header.msg_iov = &data;
+    header.msg_iovlen = 1;
+    if (fdCount > 0) {
+        header.msg_control = control;
+        header.msg_controllen = CMSG_SPACE(sizeof(int) * fdCount);
+        struct cmsghdr* fdHeader = CMSG_FIRSTHDR(&header);
+        fdHeader->cmsg_level = SOL_SOCKET;
+        fdHeader->cmsg_type = SCM_RIGHTS;
+        fdHeader->cmsg_len = CMSG_LEN(sizeof(int) * fdCount);
+        memcpy(CMSG_DATA(fdHeader), fds, sizeof(int) * fdCount);
+    }
+    return sendmsg(socket, &header, MSG_NOSIGNAL) == (ssize_t)sizeof(message);
+}
+
+// Returns the number of received descriptors, -1 on error or end of the stream.
+static int receiveMessage(int socket, DmaBufMessage* message, int* fds, int maxFds) {
+    struct iovec data = { message, sizeof(*message) };
+    char control[CMSG_SPACE(sizeof(int) * 3)];
+
+    struct msghdr header;
+    memset(&header, 0, sizeof(header));
+    header.msg_iov = &data;
+    header.msg_iovlen = 1;
+    header.msg_control = control;
+    header.msg_controllen = sizeof(control);
+    if (recvmsg(socket, &header, MSG_WAITALL | MSG_CMSG_CLOEXEC) != (ssize_t)sizeof(*message)) {
+        return -1;
+    }
+
+    int fdCount = 0;
+    for (struct cmsghdr* fdHeader = CMSG_FIRSTHDR(&header); fdHeader != NULL; fdHeader = CMSG_NXTHDR(&header, fdHeader)) {
+        if (fdHeader->cmsg_level == SOL_SOCKET && fdHeader->cmsg_type == SCM_RIGHTS) {
+            int count = (int)((fdHeader->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            const int* received = (const int*)CMSG_DATA(fdHeader);
+            for (int idx = 0; idx < count; idx++) {
+                if (fdCount < maxFds) {
+                    fds[fdCount++] = received[idx];
+                } else {
+                    close(received[idx]);
+                }
+            }
+        }
+    }
+    return fdCount;
+}
+
+bool sendDmaBufFrames(int socket, const DmaBufFrame* frames, int count) {
+    for (int idx = 0; idx < count; idx++) {
+        const DmaBufFrame& frame = frames[idx];
+        DmaBufMessage message;
+        memset(&message, 0, sizeof(message));
+        message.type = idx + 1 == count ? DMABUF_MESSAGE_LAST_FRAME : DMABUF_MESSAGE_FRAME;
+        message.index = idx;
+        message.width = frame.width;
+        message.height = frame.height;
+        message.format = frame.format;
+        message.planeCount = frame.planeCount;
+        message.modifier = frame.modifier;
+
+        int fds[3];
+        for (int plane = 0; plane < frame.planeCount; plane++) {
+            message.offsets[plane] = frame.planes[plane].offset;
+            message.pitches[plane] = frame.planes[plane].pitch;
+            fds[plane] = frame.planes[plane].fd;
+        }
+        if (!sendMessage(socket, message, fds, frame.planeCount)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool receiveDmaBufFrames(int socket, DmaBufFrame* frames, int maxCount, int* count) {
+    *count = 0;
+    while (true) {
+        DmaBufMessage message;
+        int fds[3];
+        int fdCount = receiveMessage(socket, &message, fds, 3);
+        if (fdCount < 0) {
+            return false;
+        }
+
+        bool valid = (message.type == DMABUF_MESSAGE_FRAME || message.type == DMABUF_MESSAGE_LAST_FRAME) &&
+                     message.planeCount == fdCount && message.planeCount > 0 && *count < maxCount &&
+                     message.format >= 0 && message.format < DMABUF_FORMAT_COUNT;
+        if (!valid) {
+            for (int idx = 0; idx < fdCount; idx++) {
+                close(fds[idx]);
+            }
+            return false;
+        }
+
+        DmaBufFrame& frame = frames[(*count)++];
+        frame.width = message.width;
+        frame.height = message.height;
+        frame.format = (DmaBufFormat)message.format;
+        frame.modifier = message.modifier;
+        frame.planeCount = message.planeCount;
+        for (int plane = 0; plane < frame.planeCount; plane++) {
+            frame.planes[plane] = { fds[plane], message.offsets[plane], message.pitches[plane] };
+        }
+        if (message.type == DMABUF_MESSAGE_LAST_FRAME) {
+            return true;
+        }
+    }
+}
+
+void closeDmaBufFrame(DmaBufFrame* frame) {
+    for (int plane = 0; plane < frame->planeCount; plane++) {
+        int fd = frame->planes[plane].fd;
+        bool shared = false;
+        for (int prev = 0; prev < plane; prev++) {
+            shared = shared || frame->planes[prev].fd == fd;
+        }
+        if (fd >= 0 && !shared) {
+            close(fd);
+        }
+    }
+    frame->planeCount = 0;
+}
+
+bool sendDmaBufFence(int socket, int index, int fenceFd) {
+    DmaBufMessage message;
+    memset(&message, 0, sizeof(message));
+    message.type = DMABUF_MESSAGE_FENCE;
+    message.index = index;
+
+    bool sent = sendMessage(socket, message, &fenceFd, fenceFd >= 0 ? 1 : 0);
+    if (fenceFd >= 0) {
+        close(fenceFd);
+    }
+    return sent;
+}
+
+bool receiveDmaBufFence(int socket, int* index, int* fenceFd) {
+    DmaBufMessage message;
+    int fds[3];
+    int fdCount = receiveMessage(socket, &message, fds, 3);
+    if (fdCount < 0 || message.type != DMABUF_MESSAGE_FENCE) {
+        for (int idx = 0; idx < fdCount; idx++) {
+            close(fds[idx]);
+        }
+        return false;
+    }
+    for (int idx = 1; idx < fdCount; idx++) {
+        close(fds[idx]);
+    }
+    *index = message.index;
+    *fenceFd = fdCount > 0 ? fds[0] : -1;
+    return true;
+}
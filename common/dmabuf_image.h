@@ -0,0 +1,213 @@
+/**
+ * Zero-copy import of dma-buf frames (camera, video decoder) into GL textures and
+ * export of rendered frames as dma-bufs to other processes (encoder).
+ *
+ * A frame of a producer is one or more dma-buf file descriptors with the offset and
+ * pitch of every plane. importDmaBufTexture wraps them into an EGLImage
+ * (EGL_EXT_image_dma_buf_import) and binds it to a GL_TEXTURE_EXTERNAL_OES texture
+ * (GL_OES_EGL_image_external), the GPU samples the memory of the producer directly:
+ *
+ *   DmaBufTexture texture;
+ *   if (importDmaBufTexture(display, frame, &texture)) {
+ *       glBindTexture(texture.target, texture.texture);
+ *       ...
+ *   }
+ *   destroyDmaBufTexture(&texture);
+ *
+ * The YUV formats are converted to RGB by the sampler (the color space and range hints
+ * of the import), so the shader samples every format the same way:
+ *
+ *   #extension GL_OES_EGL_image_external_essl3 : require
+ *   uniform samplerExternalOES frame;
+ *
+ * The producers recycle a few buffers: import every buffer once and keep the texture
+ * while the buffer is in use, creating an EGLImage is much more expensive than sampling it.
+ *
+ * Without a camera the frames can be allocated with allocateDmaBufFrame through
+ * /dev/udmabuf (a memfd exported as a dma-buf) and written on the CPU.
+ *
+ * The other direction: createDmaBufRenderTarget creates a texture + FBO, wraps the texture
+ * into an EGLImage and exports its memory as dma-buf descriptors
+ * (EGL_MESA_image_dma_buf_export). The descriptors are sent once to the consumer over a
+ * unix socket (SCM_RIGHTS), the rendered frames are then only announced with a fence:
+ *
+ *   producer                                   consumer
+ *   sendDmaBufFrames(socket, targets)   ->     receiveDmaBufFrames, importDmaBufTexture
+ *   render into targets[i].fbo
+ *   sendDmaBufFence(socket, i, fence)   ->     receiveDmaBufFence, waitDmaBufFence, sample
+ *   receiveDmaBufFence, waitDmaBufFence <-     sendDmaBufFence(socket, i, fence)
+ *
+ * The fences are sync_file descriptors (EGL_ANDROID_native_fence_sync): the GPU of the
+ * receiver waits for the GPU of the sender, neither CPU waits or copies the pixels.
+ * Without the extension createDmaBufFence waits with glFinish and returns no fence.
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+ with GL_OES_EGL_image_external_essl3
+ *  * EGL with EGL_EXT_image_dma_buf_import (EGL_EXT_image_dma_buf_import_modifiers for modifiers)
+ *  * EGL_MESA_image_dma_buf_export (export), EGL_ANDROID_native_fence_sync (fences, optional)
+ *  * Linux (udmabuf for the test frames, unix sockets for the sharing)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_DMABUF_IMAGE_H
+#define GLES_COMMON_DMABUF_IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum DmaBufFormat {
+    DMABUF_XRGB8888, // DRM_FORMAT_XRGB8888: B, G, R, X bytes
+    DMABUF_ABGR8888, // DRM_FORMAT_ABGR8888: R, G, B, A bytes
+    DMABUF_NV12,     // Y plane + interleaved UV plane (half width, half height)
+    DMABUF_YUV420,   // Y, U and V planes (U and V: half width, half height)
+    DMABUF_YUYV,     // packed Y0 U Y1 V (one plane)
+    DMABUF_FORMAT_COUNT,
+};
+
+// "xrgb8888", "abgr8888", "nv12", "yuv420", "yuyv".
+extern const char* dmaBufFormatNames[DMABUF_FORMAT_COUNT];
+
+// The format of a name. Returns false (and prints the valid names) for an unknown name.
+bool parseDmaBufFormat(const char* name, DmaBufFormat* format);
+
+// The DRM fourcc code of the format (see drm_fourcc.h).
+uint32_t dmaBufFourcc(DmaBufFormat format);
+
+// The layout has a luma and chroma planes: sampled with a YUV -> RGB conversion.
+bool dmaBufFormatIsYuv(DmaBufFormat format);
+
+// DRM_FORMAT_MOD_INVALID: the producer does not know the modifier, the driver uses its implicit layout.
+#define DMABUF_MODIFIER_INVALID 0x00ffffffffffffffULL
+
+struct DmaBufPlane {
+    int fd;          // dma-buf file descriptor (the planes can share it)
+    uint32_t offset; // bytes from the start of the dma-buf
+    uint32_t pitch;  // bytes per row
+};
+
+// A frame of the producer. The descriptors stay owned by the producer.
+struct DmaBufFrame {
+    int width;
+    int height;
+    DmaBufFormat format;
+    uint64_t modifier; // tiling/compression layout, DMABUF_MODIFIER_INVALID if unknown
+    int planeCount;
+    DmaBufPlane planes[3];
+};
+
+// The display (EGLDisplay) and the current GL context can import the format.
+/* Prints the missing extension or format. Uses eglQueryDmaBufFormatsEXT when
+ * EGL_EXT_image_dma_buf_import_modifiers is available. */
+bool dmaBufImportSupported(void* display, DmaBufFormat format);
+
+// An imported frame: the EGLImage and the external texture bound to it.
+struct DmaBufTexture {
+    void* display; // EGLDisplay
+    void* image;   // EGLImageKHR
+    unsigned int texture;
+    unsigned int target; // GL_TEXTURE_EXTERNAL_OES
+};
+
+// Import the frame (no copy) into a new texture with linear filtering and clamp to edge.
+/* The YUV formats use the BT.709 narrow range hints. Needs a current context on the display. */
+bool importDmaBufTexture(void* display, const DmaBufFrame& frame, DmaBufTexture* texture);
+
+// The producer wrote new contents into the imported buffer: rebind the image to the texture.
+/* No copy either, some drivers only notice the change of an external image at the bind. */
+void refreshDmaBufTexture(const DmaBufTexture* texture);
+
+void destroyDmaBufTexture(DmaBufTexture* texture);
+
+// A frame in memory allocated through /dev/udmabuf, written on the CPU (a stand-in for a camera).
+struct DmaBufAllocation {
+    int memfd;
+    int dmabufFd;
+    size_t size;
+    uint8_t* mapped; // the memfd pages: the same memory as the dma-buf
+    DmaBufFrame frame;
+};
+
+// Allocate a width x height frame (even sizes for the subsampled formats) with 64 byte aligned rows.
+/* Returns false if /dev/udmabuf is not available (the "udmabuf" kernel module). */
+bool allocateDmaBufFrame(DmaBufAllocation* allocation, int width, int height, DmaBufFormat format);
+
+// Write the test pattern of the frame "index" (moving color bars) in the format of the allocation.
+/* Brackets the writes with DMA_BUF_IOCTL_SYNC, so the caches are flushed for the device. */
+void writeDmaBufTestFrame(DmaBufAllocation* allocation, int index);
+
+void releaseDmaBufFrame(DmaBufAllocation* allocation);
+
+// The display can export GL textures as dma-bufs.
+bool dmaBufExportSupported(void* display);
+
+// A render target whose memory is exported as dma-buf descriptors (owned by the target).
+struct DmaBufRenderTarget {
+    void* display; // EGLDisplay
+    void* image;   // EGLImageKHR of the texture
+    unsigned int texture; // GL_RGBA8
+    unsigned int fbo;
+    DmaBufFrame frame;
+};
+
+// Create a width x height RGBA8 texture, its FBO and export the texture.
+/* Fails if the exported layout is not one of the DmaBufFormat formats. */
+bool createDmaBufRenderTarget(void* display, int width, int height, DmaBufRenderTarget* target);
+
+// Render into the memory of an other device (ex.: the input buffers of a video encoder).
+/* Imports the frame as a GL_TEXTURE_2D (GL_OES_EGL_image) with an FBO, only RGB formats can be
+ * rendered. The target takes the ownership of the descriptors of the frame. */
+bool importDmaBufRenderTarget(void* display, const DmaBufFrame& frame, DmaBufRenderTarget* target);
+
+// Delete the FBO, the texture and the image, close the descriptors.
+void destroyDmaBufRenderTarget(DmaBufRenderTarget* target);
+
+// A fence after the commands submitted so far: a sync_file descriptor, the caller owns it.
+/* Returns -1 without EGL_ANDROID_native_fence_sync, after waiting for the commands with glFinish. */
+int createDmaBufFence(void* display);
+
+// Make the GPU wait for the fence before the next commands (no CPU wait). Takes the ownership of the fd.
+/* Without EGL_ANDROID_native_fence_sync the CPU waits for the fence instead. A -1 fd is ignored. */
+void waitDmaBufFence(void* display, int fenceFd);
+
+// Unix stream socket of the sharing: listen on the path and wait for the consumer, or connect to it.
+/* Both return the connected socket or -1. */
+int acceptDmaBufConsumer(const char* path);
+int connectDmaBufProducer(const char* path);
+
+// Send the layout and the descriptors of the frames (the receiver imports them once).
+bool sendDmaBufFrames(int socket, const DmaBufFrame* frames, int count);
+
+// Receive at most maxCount frames sent by sendDmaBufFrames, the receiver owns the new descriptors.
+bool receiveDmaBufFrames(int socket, DmaBufFrame* frames, int maxCount, int* count);
+
+// Close the descriptors of a received frame (the planes sharing one are closed once).
+void closeDmaBufFrame(DmaBufFrame* frame);
+
+// Announce the frame "index" with its fence (-1: none), used in both directions. Closes the fence.
+bool sendDmaBufFence(int socket, int index, int fenceFd);
+
+// Receive an announcement, the caller owns the fence (-1 if none was sent).
+/* Returns false when the other process closed the socket. */
+bool receiveDmaBufFence(int socket, int* index, int* fenceFd);
+
+#endif // GLES_COMMON_DMABUF_IMAGE_H
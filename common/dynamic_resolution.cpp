@@ -0,0 +1,90 @@
+/**
+ * Dynamic resolution controller. See dynamic_resolution.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/dynamic_resolution.h"
+
+#include <math.h>
+
+// Weight of the newest sample in the moving average.
+static const double averageWeight = 0.1;
+
+// No change while the average is within this fraction of the budget.
+static const double deadband = 0.05;
+
+// Largest change of the scale in one update (avoids overshooting on spikes).
+static const float maxStep = 0.05f;
+
+void initDynamicResolution(DynamicResolution* dynres, double budgetMs, float minScale, float maxScale) {
+    dynres->budgetMs = budgetMs;
+    dynres->minScale = minScale;
+    dynres->maxScale = maxScale;
+    dynres->scale = maxScale;
+    dynres->averageMs = 0.0;
+}
+
+float dynamicResolutionUpdate(DynamicResolution* dynres, double frameMs) {
+    if (frameMs <= 0.0) {
+        return dynres->scale;
+    }
+
+    // 1. Smooth the measurements.
+    if (dynres->averageMs <= 0.0) {
+        dynres->averageMs = frameMs;
+    } else {
+        dynres->averageMs += (frameMs - dynres->averageMs) * averageWeight;
+    }
+
+    double ratio = dynres->budgetMs / dynres->averageMs;
+    if (fabs(ratio - 1.0) < deadband) {
+        return dynres->scale;
+    }
+
+    // 2. The cost scales with the pixel count: the scale which fits the budget is scale * sqrt(ratio).
+    float target = dynres->scale * (float)sqrt(ratio);
+    float step = target - dynres->scale;
+    if (step > maxStep) {
+        step = maxStep;
+    } else if (step < -maxStep) {
+        step = -maxStep;
+    }
+
+    // 3. The frame time refers to the old scale: apply only a part of the change, the next samples correct the rest.
+    float scale = dynres->scale + step * 0.5f;
+    if (scale < dynres->minScale) {
+        scale = dynres->minScale;
+    } else if (scale > dynres->maxScale) {
+        scale = dynres->maxScale;
+    }
+
+    dynres->scale = scale;
+    return scale;
+}
+
+int dynamicResolutionSize(const DynamicResolution* dynres, int fullSize) {
+    int size = ((int)(fullSize * dynres->scale) + 1) & ~1;
+    if (size > fullSize) {
+        size = fullSize;
+    }
+    return size > 0 ? size : 1;
+}
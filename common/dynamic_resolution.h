@@ -0,0 +1,62 @@
+/**
+ * Dynamic resolution controller: scale the render resolution to hold a frame time budget.
+ *
+ * The measured (GPU) frame time is smoothed with an exponential moving average
+ * and the scale is adjusted towards the value which fits the budget: the cost
+ * is assumed to be proportional to the pixel count (scale * scale). Small
+ * deviations (within 5% of the budget) don't change the scale to avoid
+ * oscillation, and the scale is clamped to [minScale, maxScale].
+ *
+ * The render target should be allocated once at the maximum scale and only its
+ * (scaled) viewport used, so a scale change never reallocates:
+ *
+ *   DynamicResolution dynres;
+ *   initDynamicResolution(&dynres, 16.6, 0.5f, 1.0f);
+ *   while (...) {
+ *       int renderW = dynamicResolutionSize(&dynres, width);
+ *       ... render into (0, 0, renderW, renderH), upscale with a blit ...
+ *       dynamicResolutionUpdate(&dynres, gpuFrameMs);
+ *   }
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_DYNAMIC_RESOLUTION_H
+#define GLES_COMMON_DYNAMIC_RESOLUTION_H
+
+struct DynamicResolution {
+    double budgetMs;
+    float minScale;
+    float maxScale;
+
+    float scale;       // current scale of both axes
+    double averageMs;  // smoothed frame time, 0: no sample yet
+};
+
+void initDynamicResolution(DynamicResolution* dynres, double budgetMs, float minScale, float maxScale);
+
+// Feed the time of the last measured frame (ms, values <= 0 are ignored), returns the new scale.
+float dynamicResolutionUpdate(DynamicResolution* dynres, double frameMs);
+
+// Scaled size of a full resolution dimension (at least 1, rounded to even values).
+int dynamicResolutionSize(const DynamicResolution* dynres, int fullSize);
+
+#endif // GLES_COMMON_DYNAMIC_RESOLUTION_H
@@ -0,0 +1,174 @@
+/**
+ * Foveated rendering. See foveation.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/foveation.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+static PFNGLTEXTUREFOVEATIONPARAMETERSQCOMPROC textureFoveationParameters;
+static PFNGLFRAMEBUFFERFOVEATIONCONFIGQCOMPROC framebufferFoveationConfig;
+static PFNGLFRAMEBUFFERFOVEATIONPARAMETERSQCOMPROC framebufferFoveationParameters;
+
+static const char* modeNames[FOVEATION_MODE_COUNT] = { "off", "qcom-texture", "qcom-framebuffer", "multi-res" };
+
+static bool hasGLExtension(const char* name) {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int idx = 0; idx < count; idx++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, idx), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* foveationModeName(FoveationMode mode) {
+    return mode < FOVEATION_MODE_COUNT ? modeNames[mode] : "unknown";
+}
+
+FoveationMode findFoveationMode(const char* name) {
+    for (int idx = 0; idx < FOVEATION_MODE_COUNT; idx++) {
+        if (strcmp(modeNames[idx], name) == 0) {
+            return (FoveationMode)idx;
+        }
+    }
+    return FOVEATION_MODE_COUNT;
+}
+
+bool foveationModeSupported(FoveationMode mode) {
+    switch (mode) {
+    case FOVEATION_QCOM_TEXTURE:
+        if (textureFoveationParameters == NULL && hasGLExtension("GL_QCOM_texture_foveated")) {
+            textureFoveationParameters =
+                (PFNGLTEXTUREFOVEATIONPARAMETERSQCOMPROC)eglGetProcAddress("glTextureFoveationParametersQCOM");
+        }
+        return textureFoveationParameters != NULL;
+    case FOVEATION_QCOM_FRAMEBUFFER:
+        if (framebufferFoveationConfig == NULL && hasGLExtension("GL_QCOM_framebuffer_foveated")) {
+            framebufferFoveationConfig =
+                (PFNGLFRAMEBUFFERFOVEATIONCONFIGQCOMPROC)eglGetProcAddress("glFramebufferFoveationConfigQCOM");
+            framebufferFoveationParameters =
+                (PFNGLFRAMEBUFFERFOVEATIONPARAMETERSQCOMPROC)eglGetProcAddress("glFramebufferFoveationParametersQCOM");
+        }
+        return framebufferFoveationConfig != NULL && framebufferFoveationParameters != NULL;
+    case FOVEATION_OFF:
+    case FOVEATION_MULTI_RES:
+        return true;
+    default:
+        return false;
+    }
+}
+
+FoveationMode foveationBestMode() {
+    if (foveationModeSupported(FOVEATION_QCOM_TEXTURE)) {
+        return FOVEATION_QCOM_TEXTURE;
+    }
+    if (foveationModeSupported(FOVEATION_QCOM_FRAMEBUFFER)) {
+        return FOVEATION_QCOM_FRAMEBUFFER;
+    }
+    return FOVEATION_MULTI_RES;
+}
+
+void initFoveation(Foveation* foveation, FoveationMode mode, float focusX, float focusY, float foveaSize,
+                   float peripheryScale) {
+    foveation->mode = mode;
+    foveation->focusX = std::min(std::max(focusX, 0.0f), 1.0f);
+    foveation->focusY = std::min(std::max(focusY, 0.0f), 1.0f);
+    foveation->foveaSize = std::min(std::max(foveaSize, 0.05f), 1.0f);
+    foveation->peripheryScale = std::min(std::max(peripheryScale, 0.1f), 1.0f);
+    foveation->configured = 0;
+}
+
+// The QCOM density around the focus: 1 / max(1, (gain * distance)^2 - foveaArea), distances in NDC.
+/* The fovea (half size: foveaSize in NDC) keeps the full density, the frame edge (distance 1 from the
+ * focus) gets peripheryScale^2: gain^2 * (1 - foveaSize^2) = 1 / peripheryScale^2. */
+static void qcomParameters(const Foveation* foveation, float* focalX, float* focalY, float* gain, float* foveaArea) {
+    float scale = foveation->peripheryScale;
+    float size = std::min(foveation->foveaSize, 0.95f);
+    *focalX = foveation->focusX * 2.0f - 1.0f;
+    *focalY = foveation->focusY * 2.0f - 1.0f;
+    *gain = sqrtf(1.0f / (scale * scale * (1.0f - size * size)));
+    *foveaArea = (*gain * size) * (*gain * size);
+}
+
+void foveationApply(Foveation* foveation, unsigned int texture, unsigned int fbo) {
+    float focalX, focalY, gain, foveaArea;
+    qcomParameters(foveation, &focalX, &focalY, &gain, &foveaArea);
+
+    if (foveation->mode == FOVEATION_QCOM_TEXTURE) {
+        // 1. Enable once per texture (the feature bits can't be cleared later), the focus every frame.
+        if (foveation->configured != texture) {
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_FOVEATED_FEATURE_BITS_QCOM,
+                            GL_FOVEATION_ENABLE_BIT_QCOM | GL_FOVEATION_SCALED_BIN_METHOD_BIT_QCOM);
+            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_FOVEATED_MIN_PIXEL_DENSITY_QCOM,
+                            foveation->peripheryScale * foveation->peripheryScale);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            foveation->configured = texture;
+        }
+        textureFoveationParameters(texture, 0, 0, focalX, focalY, gain, gain, foveaArea);
+    } else if (foveation->mode == FOVEATION_QCOM_FRAMEBUFFER) {
+        // 2. The configuration is allowed once per FBO: a new FBO (ex.: after a resize) is configured again.
+        if (foveation->configured != fbo) {
+            unsigned int provided = 0;
+            framebufferFoveationConfig(fbo, 1, 1, GL_FOVEATION_ENABLE_BIT_QCOM | GL_FOVEATION_SCALED_BIN_METHOD_BIT_QCOM,
+                                       &provided);
+            if ((provided & GL_FOVEATION_ENABLE_BIT_QCOM) == 0) {
+                printf("Foveation: the FBO %u can't be foveated\n", fbo);
+            }
+            foveation->configured = fbo;
+        }
+        framebufferFoveationParameters(fbo, 0, 0, focalX, focalY, gain, gain, foveaArea);
+    }
+}
+
+void foveationInsetRect(const Foveation* foveation, int width, int height, int* x, int* y, int* insetWidth,
+                        int* insetHeight) {
+    *insetWidth = std::max((int)ceilf(width * foveation->foveaSize), 1);
+    *insetHeight = std::max((int)ceilf(height * foveation->foveaSize), 1);
+    /* Centered on the focus, moved inside the frame. */
+    *x = std::min(std::max((int)(width * foveation->focusX) - *insetWidth / 2, 0), width - *insetWidth);
+    *y = std::min(std::max((int)(height * foveation->focusY) - *insetHeight / 2, 0), height - *insetHeight);
+}
+
+int foveationPeripherySize(const Foveation* foveation, int fullSize) {
+    return std::max((int)ceilf(fullSize * foveation->peripheryScale), 1);
+}
+
+double foveationShadedFraction(const Foveation* foveation) {
+    if (foveation->mode != FOVEATION_MULTI_RES) {
+        return 1.0;
+    }
+    double fovea = (double)foveation->foveaSize * foveation->foveaSize;
+    double periphery = (double)foveation->peripheryScale * foveation->peripheryScale;
+    return fovea + periphery;
+}
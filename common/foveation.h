@@ -0,0 +1,107 @@
+/**
+ * Foveated rendering: full resolution around a focus point, fewer fragments in the periphery.
+ *
+ * Modes:
+ *  FOVEATION_QCOM_TEXTURE      GL_QCOM_texture_foveated: the render target texture
+ *                              is foveated, every FBO rendering into it shades the
+ *                              bins away from the focus at a lower density.
+ *  FOVEATION_QCOM_FRAMEBUFFER  GL_QCOM_framebuffer_foveated: the same for one FBO
+ *                              (configured once per FBO).
+ *  FOVEATION_MULTI_RES         Fallback without the extensions: the frame is
+ *                              rendered at "peripheryScale" into a smaller target
+ *                              and the fovea rectangle again at full resolution into
+ *                              the full size target (scissored: only the rectangle
+ *                              is shaded). The blit pass upscales the periphery and
+ *                              copies the fovea on top of it.
+ *
+ * The focus is in [0, 1] frame coordinates (origin: bottom left). The fovea is
+ * "foveaSize" times the frame width and height. The QCOM gain is chosen so the
+ * pixel density drops to peripheryScale^2 at the edge of the frame.
+ *
+ * Usage:
+ *
+ *   Foveation foveation;
+ *   initFoveation(&foveation, foveationBestMode(), 0.5f, 0.5f, 0.4f, 0.5f);
+ *   // QCOM modes: before the render pass which writes the texture / FBO.
+ *   foveationApply(&foveation, texture, fbo);
+ *   // Multi-res: render into foveationPeripherySize(...) and the foveationInsetRect(...) scissor.
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *  * GL_QCOM_texture_foveated, GL_QCOM_framebuffer_foveated (optional)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_FOVEATION_H
+#define GLES_COMMON_FOVEATION_H
+
+enum FoveationMode {
+    FOVEATION_OFF,
+    FOVEATION_QCOM_TEXTURE,
+    FOVEATION_QCOM_FRAMEBUFFER,
+    FOVEATION_MULTI_RES,
+    FOVEATION_MODE_COUNT,
+};
+
+struct Foveation {
+    FoveationMode mode;
+    float focusX;         // [0, 1] of the frame width
+    float focusY;         // [0, 1] of the frame height
+    float foveaSize;      // full resolution part of the frame width and height
+    float peripheryScale; // resolution scale of the periphery (both axes)
+
+    unsigned int configured; // QCOM modes: the texture or FBO which has the foveation enabled
+};
+
+// Name of the mode for the command line and the reports ("off", "qcom-texture", "qcom-framebuffer", "multi-res").
+const char* foveationModeName(FoveationMode mode);
+
+// Look up a mode by name (FOVEATION_MODE_COUNT if unknown).
+FoveationMode findFoveationMode(const char* name);
+
+// Check if the driver has the extension of the mode (requires a current GL ES context).
+bool foveationModeSupported(FoveationMode mode);
+
+// The QCOM texture or framebuffer foveation if supported, otherwise the multi-res fallback.
+FoveationMode foveationBestMode();
+
+// The parameters are clamped: fovea size to [0.05, 1], periphery scale to [0.1, 1].
+void initFoveation(Foveation* foveation, FoveationMode mode, float focusX, float focusY, float foveaSize,
+                   float peripheryScale);
+
+// QCOM modes: enable the foveation of the texture (or FBO) and set the focus. No-op in the other modes.
+/* Call before the rendering into the target every frame: the first call for a texture/FBO enables it. */
+void foveationApply(Foveation* foveation, unsigned int texture, unsigned int fbo);
+
+// Multi-res: the full resolution rectangle of a width x height frame (origin: bottom left).
+void foveationInsetRect(const Foveation* foveation, int width, int height, int* x, int* y, int* insetWidth,
+                        int* insetHeight);
+
+// Multi-res: the size of the periphery target of a full resolution dimension (at least 1).
+int foveationPeripherySize(const Foveation* foveation, int fullSize);
+
+// Estimated shaded part of the full resolution fragments (multi-res: the periphery and the fovea, 1: off).
+/* The QCOM modes aren't estimated (the driver picks the bin densities): 1. */
+double foveationShadedFraction(const Foveation* foveation);
+
+#endif // GLES_COMMON_FOVEATION_H
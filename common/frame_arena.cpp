@@ -0,0 +1,180 @@
+/**
+ * Frame arena and heap allocation counter. See frame_arena.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/frame_arena.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+// Header of a heap allocation made when the frame's block was full.
+/* 16 bytes: the memory after it keeps the alignment of operator new. */
+struct FrameArenaOverflow {
+    FrameArenaOverflow* next;
+    uint8_t padding[16 - sizeof(FrameArenaOverflow*)];
+};
+
+static void freeOverflows(FrameArena* arena, int block) {
+    FrameArenaOverflow* overflow = arena->overflow[block];
+    while (overflow) {
+        FrameArenaOverflow* next = overflow->next;
+        delete[] (uint8_t*)overflow;
+        overflow = next;
+    }
+    arena->overflow[block] = NULL;
+}
+
+void initFrameArena(FrameArena* arena, size_t bytesPerFrame) {
+    for (int idx = 0; idx < FRAME_ARENA_FRAMES; idx++) {
+        arena->blocks[idx] = new uint8_t[bytesPerFrame];
+        arena->capacity[idx] = bytesPerFrame;
+        arena->overflow[idx] = NULL;
+        arena->frameSize[idx] = 0;
+    }
+    arena->block = 0;
+    arena->used = 0;
+    arena->overflows = 0;
+    arena->highWater = 0;
+}
+
+void destroyFrameArena(FrameArena* arena) {
+    for (int idx = 0; idx < FRAME_ARENA_FRAMES; idx++) {
+        freeOverflows(arena, idx);
+        delete[] arena->blocks[idx];
+        arena->blocks[idx] = NULL;
+        arena->capacity[idx] = 0;
+    }
+}
+
+void frameArenaBeginFrame(FrameArena* arena) {
+    // 1. Close the current frame.
+    arena->frameSize[arena->block] = arena->used;
+    if (arena->used > arena->highWater) {
+        arena->highWater = arena->used;
+    }
+
+    // 2. Release the allocations of the next block's last frame.
+    arena->block = (arena->block + 1) % FRAME_ARENA_FRAMES;
+    arena->used = 0;
+    freeOverflows(arena, arena->block);
+
+    // 3. A frame overflowed: the block grows to the largest frame so far (nothing uses the old block now).
+    if (arena->capacity[arena->block] < arena->highWater) {
+        delete[] arena->blocks[arena->block];
+        arena->blocks[arena->block] = new uint8_t[arena->highWater];
+        arena->capacity[arena->block] = arena->highWater;
+    }
+}
+
+void* frameArenaAllocate(FrameArena* arena, size_t size, size_t alignment) {
+    assert(alignment > 0 && alignment <= 16 && (alignment & (alignment - 1)) == 0);
+
+    size_t offset = (arena->used + alignment - 1) & ~(alignment - 1);
+    arena->used = offset + size;
+    if (arena->used <= arena->capacity[arena->block]) {
+        return arena->blocks[arena->block] + offset;
+    }
+
+    // The block is full: heap allocation, released with the block.
+    FrameArenaOverflow* overflow = (FrameArenaOverflow*)new uint8_t[sizeof(FrameArenaOverflow) + size];
+    overflow->next = arena->overflow[arena->block];
+    arena->overflow[arena->block] = overflow;
+    arena->overflows++;
+    return overflow + 1;
+}
+
+// Heap allocation counter: the replaced global operator new/delete.
+/* The aligned (C++17) variants keep the default implementation and are not counted. */
+static std::atomic<uint64_t> g_heapAllocations(0);
+
+uint64_t heapAllocationCount() {
+    return g_heapAllocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(size_t size) {
+    g_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = malloc(size > 0 ? size : 1);
+    if (ptr == NULL) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    g_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    free(ptr);
+}
+
+void initAllocationCheck(AllocationCheck* check, int warmupFrames) {
+    check->warmupFrames = warmupFrames;
+    check->frame = 0;
+    check->lastCount = heapAllocationCount();
+    check->steadyAllocations = 0;
+}
+
+void allocationCheckEndFrame(AllocationCheck* check) {
+    uint64_t count = heapAllocationCount();
+    if (check->frame >= check->warmupFrames && count != check->lastCount) {
+        check->steadyAllocations += count - check->lastCount;
+        printf("Frame %d: %d heap allocations after the warm-up\n", check->frame, (int)(count - check->lastCount));
+        assert(count == check->lastCount && "steady state frames must not allocate");
+    }
+    check->lastCount = heapAllocationCount();
+    check->frame++;
+}
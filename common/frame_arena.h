@@ -0,0 +1,122 @@
+/**
+ * Frame arena: linear allocator for the CPU data of a frame, and a heap allocation counter.
+ *
+ * The per-frame data (job parameters, draw lists, readback copies, ...)
+ * is carved out of a block with a bump pointer: an allocation is an
+ * aligned add, there is no free, frameArenaBeginFrame releases everything
+ * of the block at once. The arena has FRAME_ARENA_FRAMES blocks used in
+ * turn, so the data of the previous frame stays valid while the next one
+ * is built (ex.: it's still read by the worker threads or the driver).
+ *
+ * If a frame needs more than its block, the rest is allocated from the
+ * heap (counted in "overflows") and the block grows to the frame's size
+ * when it is reused, so the overflows stop after a few frames.
+ *
+ * heapAllocationCount counts the operator new calls of the process (every
+ * thread): linking this file replaces the global operator new/delete. A
+ * demo checks that the steady state frames don't touch the heap:
+ *
+ *   AllocationCheck check;
+ *   initAllocationCheck(&check, 10);        // the first 10 frames may allocate
+ *   while (...) {
+ *       ... frame ...
+ *       allocationCheckEndFrame(&check);    // prints and asserts on a new allocation
+ *   }
+ *
+ * Usage:
+ *
+ *   FrameArena arena;
+ *   initFrameArena(&arena, 64 * 1024);
+ *   while (...) {
+ *       frameArenaBeginFrame(&arena);       // reuse the block of FRAME_ARENA_FRAMES frames ago
+ *       Params* params = frameArenaAllocArray<Params>(&arena, count);
+ *       ...
+ *   }
+ *   destroyFrameArena(&arena);
+ *
+ * The arena is not thread safe: allocate on one thread (the other threads
+ * can use the memory until the block is reused).
+ *
+ * Dependencies:
+ *  * C++11
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_FRAME_ARENA_H
+#define GLES_COMMON_FRAME_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Number of frames whose allocations are alive at the same time (each has its own block).
+#define FRAME_ARENA_FRAMES 2
+
+struct FrameArenaOverflow;
+
+struct FrameArena {
+    uint8_t* blocks[FRAME_ARENA_FRAMES];
+    size_t capacity[FRAME_ARENA_FRAMES];
+    FrameArenaOverflow* overflow[FRAME_ARENA_FRAMES]; // heap allocations of the block's frame
+
+    int block;        // current block index
+    size_t used;      // bytes used in the current frame (the overflows included)
+    size_t frameSize[FRAME_ARENA_FRAMES]; // bytes needed by the last frame of each block
+
+    // Statistics: allocations which didn't fit into the block and the largest frame.
+    int overflows;
+    size_t highWater;
+};
+
+// Create the FRAME_ARENA_FRAMES blocks of "bytesPerFrame" bytes.
+void initFrameArena(FrameArena* arena, size_t bytesPerFrame);
+
+void destroyFrameArena(FrameArena* arena);
+
+// Start a new frame: reuse the next block (the allocations made FRAME_ARENA_FRAMES frames ago are released).
+void frameArenaBeginFrame(FrameArena* arena);
+
+// Allocate "size" bytes aligned to "alignment" (power of two, at most 16), valid for FRAME_ARENA_FRAMES frames.
+/* Never fails: falls back to the heap if the block is full. */
+void* frameArenaAllocate(FrameArena* arena, size_t size, size_t alignment);
+
+template<typename T>
+T* frameArenaAllocArray(FrameArena* arena, int count) {
+    return (T*)frameArenaAllocate(arena, sizeof(T) * count, alignof(T));
+}
+
+// Number of the global operator new calls since the start of the process (every thread).
+uint64_t heapAllocationCount();
+
+struct AllocationCheck {
+    int warmupFrames;
+    int frame;
+    uint64_t lastCount;
+    uint64_t steadyAllocations; // allocations after the warm-up (0 if the check passed)
+};
+
+// Check the frames after the first "warmupFrames" (they may fill the caches and grow the containers).
+void initAllocationCheck(AllocationCheck* check, int warmupFrames);
+
+// Call at the end of every frame: prints the heap allocations of a steady state frame and asserts.
+void allocationCheckEndFrame(AllocationCheck* check);
+
+#endif // GLES_COMMON_FRAME_ARENA_H
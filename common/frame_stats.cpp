@@ -0,0 +1,221 @@
+/**
+ * Frame pacing statistics, see frame_stats.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/frame_stats.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+// Number of timestamp queries in flight, the results are usually available 1-3 frames later.
+static const int timestampRingSize = 4;
+
+struct FrameStats {
+    std::vector<double> frameMs;
+    std::vector<double> cpuMs;
+    std::vector<double> swapMs;
+    std::vector<double> gpuMs;
+
+    double lastSwapEnd;
+    double swapStart;
+
+    // GL_EXT_disjoint_timer_query timestamp queries (queries[0] == 0: not supported).
+    unsigned int queries[timestampRingSize];
+    int queryCount; // number of queries issued so far
+    int queryRead;  // number of queries read back so far
+    uint64_t lastTimestamp;
+    bool hasLastTimestamp;
+
+    PFNGLGENQUERIESEXTPROC genQueries;
+    PFNGLDELETEQUERIESEXTPROC deleteQueries;
+    PFNGLQUERYCOUNTEREXTPROC queryCounter;
+    PFNGLGETQUERYOBJECTUIVEXTPROC getQueryObjectuiv;
+    PFNGLGETQUERYOBJECTUI64VEXTPROC getQueryObjectui64v;
+};
+
+static double nowMs() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static bool hasGLExtension(const char* name) {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int idx = 0; idx < count; idx++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, idx), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void initTimestampQueries(FrameStats* stats) {
+    if (!hasGLExtension("GL_EXT_disjoint_timer_query")) {
+        return;
+    }
+
+    stats->genQueries = (PFNGLGENQUERIESEXTPROC)eglGetProcAddress("glGenQueriesEXT");
+    stats->deleteQueries = (PFNGLDELETEQUERIESEXTPROC)eglGetProcAddress("glDeleteQueriesEXT");
+    stats->queryCounter = (PFNGLQUERYCOUNTEREXTPROC)eglGetProcAddress("glQueryCounterEXT");
+    stats->getQueryObjectuiv = (PFNGLGETQUERYOBJECTUIVEXTPROC)eglGetProcAddress("glGetQueryObjectuivEXT");
+    stats->getQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VEXTPROC)eglGetProcAddress("glGetQueryObjectui64vEXT");
+    if (!stats->genQueries || !stats->deleteQueries || !stats->queryCounter
+        || !stats->getQueryObjectuiv || !stats->getQueryObjectui64v) {
+        return;
+    }
+
+    // Timestamps are optional in the extension: zero counter bits means no support.
+    int timestampBits = 0;
+    PFNGLGETQUERYIVEXTPROC getQueryiv = (PFNGLGETQUERYIVEXTPROC)eglGetProcAddress("glGetQueryivEXT");
+    if (getQueryiv) {
+        getQueryiv(GL_TIMESTAMP_EXT, GL_QUERY_COUNTER_BITS_EXT, &timestampBits);
+    }
+    if (timestampBits == 0) {
+        return;
+    }
+
+    stats->genQueries(timestampRingSize, stats->queries);
+}
+
+// Read back the finished timestamps (in order), "wait": block for all pending results.
+static void collectTimestamps(FrameStats* stats, bool wait) {
+    while (stats->queryRead < stats->queryCount) {
+        unsigned int query = stats->queries[stats->queryRead % timestampRingSize];
+
+        GLuint available = 0;
+        stats->getQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+        if (!available && !wait) {
+            break;
+        }
+
+        GLuint64 timestamp = 0;
+        stats->getQueryObjectui64v(query, GL_QUERY_RESULT_EXT, &timestamp);
+        stats->queryRead++;
+
+        if (stats->hasLastTimestamp) {
+            stats->gpuMs.push_back((timestamp - stats->lastTimestamp) / 1e6);
+        }
+        stats->lastTimestamp = timestamp;
+        stats->hasLastTimestamp = true;
+    }
+}
+
+FrameStats* createFrameStats() {
+    FrameStats* stats = new FrameStats();
+    memset(stats->queries, 0, sizeof(stats->queries));
+    stats->queryCount = 0;
+    stats->queryRead = 0;
+    stats->lastTimestamp = 0;
+    stats->hasLastTimestamp = false;
+
+    initTimestampQueries(stats);
+
+    stats->lastSwapEnd = nowMs();
+    stats->swapStart = stats->lastSwapEnd;
+    return stats;
+}
+
+void frameStatsBeforeSwap(FrameStats* stats) {
+    stats->swapStart = nowMs();
+    stats->cpuMs.push_back(stats->swapStart - stats->lastSwapEnd);
+
+    if (stats->queries[0]) {
+        // The ring is full: the oldest result must be read before its query can be reused.
+        if (stats->queryCount - stats->queryRead == timestampRingSize) {
+            collectTimestamps(stats, true);
+        }
+
+        stats->queryCounter(stats->queries[stats->queryCount % timestampRingSize], GL_TIMESTAMP_EXT);
+        stats->queryCount++;
+    }
+}
+
+void frameStatsAfterSwap(FrameStats* stats) {
+    double swapEnd = nowMs();
+    stats->swapMs.push_back(swapEnd - stats->swapStart);
+    stats->frameMs.push_back(swapEnd - stats->lastSwapEnd);
+    stats->lastSwapEnd = swapEnd;
+
+    if (stats->queries[0]) {
+        collectTimestamps(stats, false);
+    }
+}
+
+// Value below which "fraction" of the sorted samples are.
+static double percentile(const std::vector<double>& sorted, double fraction) {
+    size_t idx = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[idx];
+}
+
+static void printRow(const char* name, std::vector<double> samples) {
+    if (samples.empty()) {
+        printf("  %-6s %9s\n", name, "n/a");
+        return;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    printf("  %-6s %9.3f %9.3f %9.3f %9.3f\n", name,
+           percentile(samples, 0.50), percentile(samples, 0.95), percentile(samples, 0.99), samples.back());
+}
+
+void destroyFrameStats(FrameStats* stats) {
+    if (stats->queries[0]) {
+        collectTimestamps(stats, true);
+        stats->deleteQueries(timestampRingSize, stats->queries);
+    }
+
+    // Jitter: standard deviation of the frame time changes between consecutive frames.
+    double jitter = 0.0;
+    if (stats->frameMs.size() > 1) {
+        double sum = 0.0;
+        double sumSquares = 0.0;
+        for (size_t idx = 1; idx < stats->frameMs.size(); idx++) {
+            double delta = stats->frameMs[idx] - stats->frameMs[idx - 1];
+            sum += delta;
+            sumSquares += delta * delta;
+        }
+        double count = stats->frameMs.size() - 1;
+        double mean = sum / count;
+        jitter = sqrt(std::max(0.0, sumSquares / count - mean * mean));
+    }
+
+    printf("Frame stats (%zu frames, ms):\n", stats->frameMs.size());
+    printf("  %-6s %9s %9s %9s %9s\n", "", "p50", "p95", "p99", "max");
+    printRow("frame", stats->frameMs);
+    printRow("cpu", stats->cpuMs);
+    printRow("swap", stats->swapMs);
+    printRow("gpu", stats->gpuMs);
+    printf("  jitter %9.3f\n", jitter);
+
+    delete stats;
+}
@@ -0,0 +1,55 @@
+/**
+ * Frame pacing statistics: CPU frame time, swap time and GPU frame time.
+ *
+ * Enabled by the "--frame-stats" option of the demo context, which records
+ * every frame in demoSwapBuffers and prints a summary when the context is
+ * destroyed: p50/p95/p99/max of each time and the frame time jitter.
+ *
+ *  * frame: time between two consecutive swaps.
+ *  * cpu:   time from the end of the previous swap until the swap call
+ *           (the CPU work of the frame: events, updates, GL calls).
+ *  * swap:  time spent in the swap (vsync wait, or waiting for the GPU to
+ *           free a buffer when GPU-bound).
+ *  * gpu:   GPU timeline interval between the ends of two consecutive frames,
+ *           measured with GL_TIMESTAMP_EXT queries (if supported). When it is
+ *           close to the frame time and the cpu time is lower, the demo is GPU-bound.
+ *
+ * Use "--no-vsync" (glfwSwapInterval(0)) for uncapped measurements.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_FRAME_STATS_H
+#define GLES_COMMON_FRAME_STATS_H
+
+struct FrameStats;
+
+// Create the statistics collector. Requires a current GL ES context.
+FrameStats* createFrameStats();
+
+// Print the summary and release the queries.
+void destroyFrameStats(FrameStats* stats);
+
+// Record the frame: call right before and right after the buffer swap.
+void frameStatsBeforeSwap(FrameStats* stats);
+void frameStatsAfterSwap(FrameStats* stats);
+
+#endif // GLES_COMMON_FRAME_STATS_H
@@ -0,0 +1,195 @@
+/**
+ * CPU frustum culling of axis aligned bounding boxes. See frustum_culling.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/frustum_culling.h"
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FRUSTUM_CULLING_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FRUSTUM_CULLING_NEON 1
+#endif
+
+int addCullingBounds(CullingBounds* bounds, const float center[3], const float halfExtent[3]) {
+    int idx = bounds->count++;
+
+    // Keep the arrays padded: the last group of four is always complete.
+    size_t padded = (size_t)((bounds->count + 3) & ~3);
+    if (bounds->centerX.size() < padded) {
+        bounds->centerX.resize(padded, 0.0f);
+        bounds->centerY.resize(padded, 0.0f);
+        bounds->centerZ.resize(padded, 0.0f);
+        bounds->extentX.resize(padded, 0.0f);
+        bounds->extentY.resize(padded, 0.0f);
+        bounds->extentZ.resize(padded, 0.0f);
+    }
+
+    bounds->centerX[idx] = center[0];
+    bounds->centerY[idx] = center[1];
+    bounds->centerZ[idx] = center[2];
+    bounds->extentX[idx] = halfExtent[0];
+    bounds->extentY[idx] = halfExtent[1];
+    bounds->extentZ[idx] = halfExtent[2];
+    return idx;
+}
+
+void extractFrustumPlanes(const float* viewProjection, float planes[6][4]) {
+    // Row "i" of the column major matrix: m[i], m[4 + i], m[8 + i], m[12 + i].
+    const float* m = viewProjection;
+    for (int axis = 0; axis < 3; axis++) {
+        for (int col = 0; col < 4; col++) {
+            planes[axis * 2 + 0][col] = m[col * 4 + 3] + m[col * 4 + axis];
+            planes[axis * 2 + 1][col] = m[col * 4 + 3] - m[col * 4 + axis];
+        }
+    }
+}
+
+int frustumCullScalar(const CullingBounds* bounds, const float* viewProjection, int* visible) {
+    float planes[6][4];
+    extractFrustumPlanes(viewProjection, planes);
+
+    int visibleCount = 0;
+    for (int idx = 0; idx < bounds->count; idx++) {
+        bool inside = true;
+        for (int plane = 0; plane < 6 && inside; plane++) {
+            const float* p = planes[plane];
+            float distance = p[0] * bounds->centerX[idx] + p[1] * bounds->centerY[idx] + p[2] * bounds->centerZ[idx] + p[3];
+            float radius = fabsf(p[0]) * bounds->extentX[idx] + fabsf(p[1]) * bounds->extentY[idx] + fabsf(p[2]) * bounds->extentZ[idx];
+            inside = distance + radius >= 0.0f;
+        }
+
+        if (inside) {
+            visible[visibleCount++] = idx;
+        }
+    }
+    return visibleCount;
+}
+
+#if FRUSTUM_CULLING_SSE2
+
+int frustumCull(const CullingBounds* bounds, const float* viewProjection, int* visible) {
+    float planes[6][4];
+    extractFrustumPlanes(viewProjection, planes);
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+
+    int visibleCount = 0;
+    for (int base = 0; base < bounds->count; base += 4) {
+        __m128 cx = _mm_loadu_ps(&bounds->centerX[base]);
+        __m128 cy = _mm_loadu_ps(&bounds->centerY[base]);
+        __m128 cz = _mm_loadu_ps(&bounds->centerZ[base]);
+        __m128 ex = _mm_loadu_ps(&bounds->extentX[base]);
+        __m128 ey = _mm_loadu_ps(&bounds->extentY[base]);
+        __m128 ez = _mm_loadu_ps(&bounds->extentZ[base]);
+
+        __m128 inside = _mm_cmpeq_ps(zero, zero);
+        for (int plane = 0; plane < 6; plane++) {
+            __m128 a = _mm_set1_ps(planes[plane][0]);
+            __m128 b = _mm_set1_ps(planes[plane][1]);
+            __m128 c = _mm_set1_ps(planes[plane][2]);
+            __m128 d = _mm_set1_ps(planes[plane][3]);
+
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, cx), _mm_mul_ps(b, cy)), _mm_add_ps(_mm_mul_ps(c, cz), d));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, a), ex), _mm_mul_ps(_mm_andnot_ps(signMask, b), ey)),
+                                       _mm_mul_ps(_mm_andnot_ps(signMask, c), ez));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        for (int lane = 0; lane < 4 && base + lane < bounds->count; lane++) {
+            if (mask & (1 << lane)) {
+                visible[visibleCount++] = base + lane;
+            }
+        }
+    }
+    return visibleCount;
+}
+
+const char* frustumCullImplementation() {
+    return "SSE2";
+}
+
+#elif FRUSTUM_CULLING_NEON
+
+int frustumCull(const CullingBounds* bounds, const float* viewProjection, int* visible) {
+    float planes[6][4];
+    extractFrustumPlanes(viewProjection, planes);
+
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+
+    int visibleCount = 0;
+    for (int base = 0; base < bounds->count; base += 4) {
+        float32x4_t cx = vld1q_f32(&bounds->centerX[base]);
+        float32x4_t cy = vld1q_f32(&bounds->centerY[base]);
+        float32x4_t cz = vld1q_f32(&bounds->centerZ[base]);
+        float32x4_t ex = vld1q_f32(&bounds->extentX[base]);
+        float32x4_t ey = vld1q_f32(&bounds->extentY[base]);
+        float32x4_t ez = vld1q_f32(&bounds->extentZ[base]);
+
+        uint32x4_t inside = vdupq_n_u32(0xffffffffu);
+        for (int plane = 0; plane < 6; plane++) {
+            const float* p = planes[plane];
+
+            float32x4_t distance = vdupq_n_f32(p[3]);
+            distance = vmlaq_n_f32(distance, cx, p[0]);
+            distance = vmlaq_n_f32(distance, cy, p[1]);
+            distance = vmlaq_n_f32(distance, cz, p[2]);
+
+            float32x4_t radius = vmulq_n_f32(ex, fabsf(p[0]));
+            radius = vmlaq_n_f32(radius, ey, fabsf(p[1]));
+            radius = vmlaq_n_f32(radius, ez, fabsf(p[2]));
+
+            inside = vandq_u32(inside, vcgeq_f32(vaddq_f32(distance, radius), zero));
+        }
+
+        uint32_t lanes[4];
+        vst1q_u32(lanes, inside);
+        for (int lane = 0; lane < 4 && base + lane < bounds->count; lane++) {
+            if (lanes[lane]) {
+                visible[visibleCount++] = base + lane;
+            }
+        }
+    }
+    return visibleCount;
+}
+
+const char* frustumCullImplementation() {
+    return "NEON";
+}
+
+#else
+
+int frustumCull(const CullingBounds* bounds, const float* viewProjection, int* visible) {
+    return frustumCullScalar(bounds, viewProjection, visible);
+}
+
+const char* frustumCullImplementation() {
+    return "scalar";
+}
+
+#endif
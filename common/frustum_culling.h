@@ -0,0 +1,82 @@
+/**
+ * CPU frustum culling of axis aligned bounding boxes, four boxes at a time.
+ *
+ * The boxes are stored as a structure of arrays (center and half extent per
+ * axis) padded to a multiple of four, so one SSE (x86) or NEON (ARM) register
+ * holds the same coordinate of four boxes. The six planes of the frustum are
+ * extracted from the view-projection matrix (Gribb-Hartmann); a box is outside
+ * if it is completely behind any of the planes. Without SSE2/NEON the scalar
+ * version is used.
+ *
+ * Usage:
+ *
+ *   CullingBounds bounds;
+ *   for (...) {
+ *       addCullingBounds(&bounds, center, halfExtent); // returns the index of the box
+ *   }
+ *   std::vector<int> visible(bounds.count);
+ *   while (...) {
+ *       int visibleCount = frustumCull(&bounds, viewProjection, visible.data());
+ *       ... upload the data of visible[0 .. visibleCount - 1] for an instanced draw ...
+ *   }
+ *
+ * Dependencies:
+ *  * C++11
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_FRUSTUM_CULLING_H
+#define GLES_COMMON_FRUSTUM_CULLING_H
+
+#include <vector>
+
+struct CullingBounds {
+    // Box centers and half extents, padded to a multiple of 4 entries.
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> extentX;
+    std::vector<float> extentY;
+    std::vector<float> extentZ;
+    int count;
+
+    CullingBounds() : count(0) {}
+};
+
+// Add a box (center and half extent), returns its index.
+int addCullingBounds(CullingBounds* bounds, const float center[3], const float halfExtent[3]);
+
+// The planes (a, b, c, d: inside if a * x + b * y + c * z + d >= 0) of the column major view-projection matrix.
+/* Order: left, right, bottom, top, near, far. The planes are not normalized. */
+void extractFrustumPlanes(const float* viewProjection, float planes[6][4]);
+
+// Write the indices of the boxes intersecting the frustum into "visible" (room for bounds->count entries).
+/* Returns the number of visible boxes, the indices are in increasing order. */
+int frustumCull(const CullingBounds* bounds, const float* viewProjection, int* visible);
+
+// The reference version of frustumCull testing one box at a time.
+int frustumCullScalar(const CullingBounds* bounds, const float* viewProjection, int* visible);
+
+// Name of the instruction set used by frustumCull ("SSE2", "NEON" or "scalar").
+const char* frustumCullImplementation();
+
+#endif // GLES_COMMON_FRUSTUM_CULLING_H
@@ -0,0 +1,539 @@
+/**
+ * G-buffer for deferred shading with packed formats and tile-local variants.
+ * See gbuffer.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/gbuffer.h"
+#include "common/gpu_memory.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#include "common/program_cache.h"
+
+// Texture units of the MRT G-buffer in the lighting pass.
+#define GBUFFER_TEXTURE_UNIT 4
+
+// The per pixel struct of the pixel local storage mode (12 bytes, the fast size is at least 16).
+#define GBUFFER_PLS_MEMBERS \
+    "    layout(rgba8) mediump vec4 albedo;\n" \
+    "    layout(rg16f) highp vec2 normal;\n" \
+    "    layout(r32f) highp float viewDepth;\n"
+
+static const char* modeNames[GBUFFER_MODE_COUNT] = { "forward", "mrt", "fetch", "pls" };
+
+static const char* modeHeaders[GBUFFER_MODE_COUNT] = {
+    "#define GBUFFER_FORWARD\n",
+    "#define GBUFFER_MRT\n",
+    "#extension GL_EXT_shader_framebuffer_fetch : require\n#define GBUFFER_FETCH\n",
+    "#extension GL_EXT_shader_pixel_local_storage : require\n#define GBUFFER_PLS\n",
+};
+
+static const char* octahedral_src = R"(
+// Octahedral normal encoding: the unit sphere folded onto the [-1, 1] square.
+vec2 octahedralEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signs;
+}
+
+vec3 octahedralDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float fold = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -fold : fold;
+    n.y += n.y >= 0.0 ? -fold : fold;
+    return normalize(n);
+}
+
+// Two 16 bit unsigned normalized values in an RG16UI texel.
+highp uvec2 packNormal16(vec3 n) {
+    return uvec2(round(clamp(octahedralEncode(n) * 0.5 + 0.5, 0.0, 1.0) * 65535.0));
+}
+
+vec3 unpackNormal16(highp uvec2 bits) {
+    return octahedralDecode(vec2(bits) / 65535.0 * 2.0 - 1.0);
+}
+)";
+
+static const char* geometry_src = R"(
+#if defined(GBUFFER_PLS)
+__pixel_local_outEXT GBufferLocal {
+)" GBUFFER_PLS_MEMBERS R"(} gbuffer;
+
+void gbufferStore(vec3 albedo, vec3 normal, float viewDepth) {
+    gbuffer.albedo = vec4(albedo, 1.0);
+    gbuffer.normal = octahedralEncode(normal);
+    gbuffer.viewDepth = viewDepth;
+}
+#elif defined(GBUFFER_FETCH)
+// Location 0 is the lit image, it is not a draw buffer of the geometry pass.
+layout(location = 1) out vec4 gbufferAlbedo;
+layout(location = 2) out highp uvec2 gbufferNormal;
+layout(location = 3) out highp uint gbufferDepth;
+
+void gbufferStore(vec3 albedo, vec3 normal, float viewDepth) {
+    gbufferAlbedo = vec4(albedo, 1.0);
+    gbufferNormal = packNormal16(normal);
+    gbufferDepth = floatBitsToUint(viewDepth);
+}
+#elif defined(GBUFFER_MRT)
+layout(location = 0) out vec4 gbufferAlbedo;
+layout(location = 1) out highp uvec2 gbufferNormal;
+
+void gbufferStore(vec3 albedo, vec3 normal, float viewDepth) {
+    gbufferAlbedo = vec4(albedo, 1.0);
+    gbufferNormal = packNormal16(normal);
+}
+#endif
+)";
+
+static const char* lighting_src = R"(
+uniform highp vec4 gbufferProjection; // projection[0], projection[5], width, height
+uniform highp vec2 gbufferDepthRange; // near, far
+
+vec3 gbufferViewPosition(float viewDepth) {
+    vec2 ndc = gl_FragCoord.xy / gbufferProjection.zw * 2.0 - 1.0;
+    return vec3(ndc * viewDepth / gbufferProjection.xy, -viewDepth);
+}
+
+#if defined(GBUFFER_PLS)
+__pixel_local_inEXT GBufferLocal {
+)" GBUFFER_PLS_MEMBERS R"(} gbuffer;
+
+bool gbufferLoad(out vec3 albedo, out vec3 normal, out float viewDepth) {
+    albedo = gbuffer.albedo.rgb;
+    normal = octahedralDecode(gbuffer.normal);
+    viewDepth = gbuffer.viewDepth;
+    return viewDepth > 0.0;
+}
+#elif defined(GBUFFER_FETCH)
+// The values of the own pixel: they were written by the geometry pass of the same render pass.
+layout(location = 1) inout vec4 gbufferAlbedo;
+layout(location = 2) inout highp uvec2 gbufferNormal;
+layout(location = 3) inout highp uint gbufferDepth;
+
+bool gbufferLoad(out vec3 albedo, out vec3 normal, out float viewDepth) {
+    albedo = gbufferAlbedo.rgb;
+    normal = unpackNormal16(gbufferNormal);
+    viewDepth = uintBitsToFloat(gbufferDepth);
+    return gbufferDepth != 0u;
+}
+#elif defined(GBUFFER_MRT)
+uniform mediump sampler2D gbufferAlbedoTexture;
+uniform highp usampler2D gbufferNormalTexture;
+uniform highp sampler2D gbufferDepthTexture;
+
+bool gbufferLoad(out vec3 albedo, out vec3 normal, out float viewDepth) {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gbufferDepthTexture, pixel, 0).r;
+    float ndc = depth * 2.0 - 1.0;
+    float nearPlane = gbufferDepthRange.x;
+    float farPlane = gbufferDepthRange.y;
+    viewDepth = 2.0 * nearPlane * farPlane / (farPlane + nearPlane - ndc * (farPlane - nearPlane));
+
+    albedo = texelFetch(gbufferAlbedoTexture, pixel, 0).rgb;
+    normal = unpackNormal16(texelFetch(gbufferNormalTexture, pixel, 0).xy);
+    return depth < 1.0;
+}
+#endif
+)";
+
+/* The octahedral functions are shared by both passes. */
+static const std::string geometrySource = std::string(octahedral_src) + geometry_src;
+static const std::string lightingSource = std::string(octahedral_src) + lighting_src;
+
+const char* gbufferGeometrySrc = geometrySource.c_str();
+const char* gbufferLightingSrc = lightingSource.c_str();
+
+// Full-screen triangle writing the initial G-buffer of the pixel local storage mode.
+static const char* pls_clear_vertex_src = R"(#version 300 es
+precision highp float;
+
+void main() {
+    vec2 position = vec2(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1));
+    gl_Position = vec4(position, 1.0, 1.0);
+}
+)";
+
+static const char* pls_clear_fragment_src = R"(#version 300 es
+#extension GL_EXT_shader_pixel_local_storage : require
+precision highp float;
+
+__pixel_local_outEXT GBufferLocal {
+)" GBUFFER_PLS_MEMBERS R"(} gbuffer;
+
+void main() {
+    gbuffer.albedo = vec4(0.0);
+    gbuffer.normal = vec2(0.0);
+    gbuffer.viewDepth = 0.0;
+}
+)";
+
+static bool hasGLExtension(const char* name) {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int idx = 0; idx < count; idx++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, idx), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* gbufferModeName(GBufferMode mode) {
+    return mode < GBUFFER_MODE_COUNT ? modeNames[mode] : "unknown";
+}
+
+GBufferMode findGBufferMode(const char* name) {
+    for (int idx = 0; idx < GBUFFER_MODE_COUNT; idx++) {
+        if (strcmp(modeNames[idx], name) == 0) {
+            return (GBufferMode)idx;
+        }
+    }
+    return GBUFFER_MODE_COUNT;
+}
+
+bool gbufferModeSupported(GBufferMode mode) {
+    switch (mode) {
+    case GBUFFER_FORWARD:
+        return true;
+    case GBUFFER_MRT: {
+        int drawBuffers = 0;
+        glGetIntegerv(GL_MAX_DRAW_BUFFERS, &drawBuffers);
+        return drawBuffers >= 2;
+    }
+    case GBUFFER_FRAMEBUFFER_FETCH: {
+        int drawBuffers = 0;
+        glGetIntegerv(GL_MAX_DRAW_BUFFERS, &drawBuffers);
+        return drawBuffers >= 4 && hasGLExtension("GL_EXT_shader_framebuffer_fetch");
+    }
+    case GBUFFER_PIXEL_LOCAL_STORAGE: {
+        if (!hasGLExtension("GL_EXT_shader_pixel_local_storage")) {
+            return false;
+        }
+        int fastSize = 0;
+        glGetIntegerv(GL_MAX_SHADER_PIXEL_LOCAL_STORAGE_FAST_SIZE_EXT, &fastSize);
+        return fastSize >= 12;
+    }
+    default:
+        return false;
+    }
+}
+
+GBufferMode gbufferBestMode() {
+    if (gbufferModeSupported(GBUFFER_PIXEL_LOCAL_STORAGE)) {
+        return GBUFFER_PIXEL_LOCAL_STORAGE;
+    }
+    if (gbufferModeSupported(GBUFFER_FRAMEBUFFER_FETCH)) {
+        return GBUFFER_FRAMEBUFFER_FETCH;
+    }
+    return GBUFFER_MRT;
+}
+
+static unsigned int createRenderbuffer(unsigned int format, int width, int height, const char* label) {
+    unsigned int renderbuffer;
+    glGenRenderbuffers(1, &renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, format, width, height);
+    gpuMemoryTrackRenderbuffer(renderbuffer, format, width, height, 1, label);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    return renderbuffer;
+}
+
+static unsigned int createTexture(unsigned int format, int width, int height, const char* label) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+    gpuMemoryTrackTexture(texture, format, width, height, 1, 1, GPU_MEMORY_RENDER_TARGET, label);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+static bool checkFramebuffer(const char* name) {
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("G-buffer: the %s FBO is incomplete (0x%x)\n", name, status);
+        return false;
+    }
+    return true;
+}
+
+bool initGBuffer(GBuffer* gbuffer, GBufferMode mode, int width, int height) {
+    memset(gbuffer, 0, sizeof(*gbuffer));
+    gbuffer->mode = mode;
+    gbuffer->width = width;
+    gbuffer->height = height;
+
+    if (!gbufferModeSupported(mode)) {
+        printf("G-buffer: the '%s' mode is not supported\n", gbufferModeName(mode));
+        return false;
+    }
+
+    bool complete = true;
+    gbuffer->colorRB = createRenderbuffer(GL_RGBA8, width, height, "G-buffer color");
+    glGenFramebuffers(1, &gbuffer->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, gbuffer->fbo);
+
+    if (mode == GBUFFER_MRT) {
+        // 1. Geometry FBO: the G-buffer textures, read by the lighting pass of the separate lighting FBO.
+        gbuffer->albedo = createTexture(GL_RGBA8, width, height, "G-buffer albedo");
+        gbuffer->normal = createTexture(GL_RG16UI, width, height, "G-buffer normal");
+        gbuffer->depth = createTexture(GL_DEPTH_COMPONENT24, width, height, "G-buffer depth");
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gbuffer->albedo, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gbuffer->normal, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gbuffer->depth, 0);
+
+        GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, drawBuffers);
+        complete = checkFramebuffer("geometry");
+
+        glGenFramebuffers(1, &gbuffer->lightingFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, gbuffer->lightingFbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, gbuffer->colorRB);
+        complete = checkFramebuffer("lighting") && complete;
+    } else {
+        // 2. One FBO: the lit image, the G-buffer renderbuffers (framebuffer fetch) and the depth buffer.
+        gbuffer->lightingFbo = gbuffer->fbo;
+        gbuffer->depthRB = createRenderbuffer(GL_DEPTH_COMPONENT24, width, height, "G-buffer depth");
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, gbuffer->colorRB);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, gbuffer->depthRB);
+
+        if (mode == GBUFFER_FRAMEBUFFER_FETCH) {
+            gbuffer->albedo = createRenderbuffer(GL_RGBA8, width, height, "G-buffer albedo");
+            gbuffer->normal = createRenderbuffer(GL_RG16UI, width, height, "G-buffer normal");
+            gbuffer->depth = createRenderbuffer(GL_R32UI, width, height, "G-buffer depth");
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, gbuffer->albedo);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_RENDERBUFFER, gbuffer->normal);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_RENDERBUFFER, gbuffer->depth);
+        }
+        complete = checkFramebuffer(gbufferModeName(mode));
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // 3. The pixel local storage has no clear: a full screen pass writes the initial values.
+    if (mode == GBUFFER_PIXEL_LOCAL_STORAGE) {
+        gbuffer->clearProgram = createCachedProgram(pls_clear_vertex_src, pls_clear_fragment_src);
+        complete = gbuffer->clearProgram != 0 && complete;
+    }
+
+    if (!complete) {
+        destroyGBuffer(gbuffer);
+        return false;
+    }
+    return true;
+}
+
+void destroyGBuffer(GBuffer* gbuffer) {
+    if (gbuffer->lightingFbo != 0 && gbuffer->lightingFbo != gbuffer->fbo) {
+        glDeleteFramebuffers(1, &gbuffer->lightingFbo);
+    }
+    glDeleteFramebuffers(1, &gbuffer->fbo);
+    glDeleteRenderbuffers(1, &gbuffer->colorRB);
+    glDeleteRenderbuffers(1, &gbuffer->depthRB);
+    gpuMemoryReleaseRenderbuffers(1, &gbuffer->colorRB);
+    gpuMemoryReleaseRenderbuffers(1, &gbuffer->depthRB);
+
+    if (gbuffer->mode == GBUFFER_MRT) {
+        unsigned int textures[] = { gbuffer->albedo, gbuffer->normal, gbuffer->depth };
+        glDeleteTextures(3, textures);
+        gpuMemoryReleaseTextures(3, textures);
+    } else {
+        unsigned int renderbuffers[] = { gbuffer->albedo, gbuffer->normal, gbuffer->depth };
+        glDeleteRenderbuffers(3, renderbuffers);
+        gpuMemoryReleaseRenderbuffers(3, renderbuffers);
+    }
+    if (gbuffer->clearProgram != 0) {
+        glDeleteProgram(gbuffer->clearProgram);
+    }
+    memset(gbuffer, 0, sizeof(*gbuffer));
+}
+
+const char* gbufferShaderHeader(GBufferMode mode) {
+    return mode < GBUFFER_MODE_COUNT ? modeHeaders[mode] : "";
+}
+
+void gbufferBeginGeometry(GBuffer* gbuffer) {
+    static const float zeros[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    static const unsigned int zeroBits[4] = { 0, 0, 0, 0 };
+    static const float one = 1.0f;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, gbuffer->fbo);
+    glViewport(0, 0, gbuffer->width, gbuffer->height);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+    // 1. Clear every attachment: nothing is loaded from the memory into the tile.
+    /* The lit image is cleared too, even if the lighting pass overwrites it: the load is skipped
+     * only if the whole render pass starts with a clear. */
+    switch (gbuffer->mode) {
+    case GBUFFER_MRT: {
+        GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, drawBuffers);
+        glClearBufferfv(GL_COLOR, 0, gbuffer->clearColor);
+        glClearBufferuiv(GL_COLOR, 1, zeroBits);
+        glClearBufferfv(GL_DEPTH, 0, &one);
+        break;
+    }
+    case GBUFFER_FRAMEBUFFER_FETCH: {
+        GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+        glDrawBuffers(4, drawBuffers);
+        glClearBufferfv(GL_COLOR, 0, gbuffer->clearColor);
+        glClearBufferfv(GL_COLOR, 1, zeros);
+        glClearBufferuiv(GL_COLOR, 2, zeroBits);
+        glClearBufferuiv(GL_COLOR, 3, zeroBits);
+        glClearBufferfv(GL_DEPTH, 0, &one);
+
+        /* The geometry pass doesn't write the lit image. */
+        drawBuffers[0] = GL_NONE;
+        glDrawBuffers(4, drawBuffers);
+        break;
+    }
+    case GBUFFER_PIXEL_LOCAL_STORAGE:
+        glClearBufferfv(GL_COLOR, 0, gbuffer->clearColor);
+        glClearBufferfv(GL_DEPTH, 0, &one);
+
+        // 2. The G-buffer struct aliases the tile memory of the color attachment.
+        glEnable(GL_SHADER_PIXEL_LOCAL_STORAGE_EXT);
+        glDisable(GL_DEPTH_TEST);
+        glUseProgram(gbuffer->clearProgram);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glEnable(GL_DEPTH_TEST);
+        break;
+    default:
+        glClearBufferfv(GL_COLOR, 0, gbuffer->clearColor);
+        glClearBufferfv(GL_DEPTH, 0, &one);
+        break;
+    }
+}
+
+void gbufferBeginLighting(GBuffer* gbuffer, unsigned int program, const float* projection, float nearPlane, float farPlane) {
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+
+    if (gbuffer->mode == GBUFFER_MRT) {
+        // 1. The geometry FBO is done: the lighting FBO is overwritten by the full screen pass, don't load it.
+        glBindFramebuffer(GL_FRAMEBUFFER, gbuffer->lightingFbo);
+        GLenum color = GL_COLOR_ATTACHMENT0;
+        glInvalidateFramebuffer(GL_FRAMEBUFFER, 1, &color);
+
+        glActiveTexture(GL_TEXTURE0 + GBUFFER_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, gbuffer->albedo);
+        glActiveTexture(GL_TEXTURE0 + GBUFFER_TEXTURE_UNIT + 1);
+        glBindTexture(GL_TEXTURE_2D, gbuffer->normal);
+        glActiveTexture(GL_TEXTURE0 + GBUFFER_TEXTURE_UNIT + 2);
+        glBindTexture(GL_TEXTURE_2D, gbuffer->depth);
+        glActiveTexture(GL_TEXTURE0);
+    } else if (gbuffer->mode == GBUFFER_FRAMEBUFFER_FETCH) {
+        // 2. Same render pass: the lit image becomes a draw buffer, the G-buffer is fetched from the tile.
+        GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+        glDrawBuffers(4, drawBuffers);
+    }
+
+    glUseProgram(program);
+    glUniform4f(glGetUniformLocation(program, "gbufferProjection"), projection[0], projection[5],
+                (float)gbuffer->width, (float)gbuffer->height);
+    glUniform2f(glGetUniformLocation(program, "gbufferDepthRange"), nearPlane, farPlane);
+    if (gbuffer->mode == GBUFFER_MRT) {
+        glUniform1i(glGetUniformLocation(program, "gbufferAlbedoTexture"), GBUFFER_TEXTURE_UNIT);
+        glUniform1i(glGetUniformLocation(program, "gbufferNormalTexture"), GBUFFER_TEXTURE_UNIT + 1);
+        glUniform1i(glGetUniformLocation(program, "gbufferDepthTexture"), GBUFFER_TEXTURE_UNIT + 2);
+    }
+}
+
+void gbufferEnd(GBuffer* gbuffer) {
+    // 1. Everything but the lit image is dead: invalidate it before the tiles are written back.
+    GLenum attachments[4];
+    int count = 0;
+    switch (gbuffer->mode) {
+    case GBUFFER_MRT:
+        /* The G-buffer textures were already stored by the geometry pass. */
+        for (int idx = 0; idx < 3; idx++) {
+            glActiveTexture(GL_TEXTURE0 + GBUFFER_TEXTURE_UNIT + idx);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        break;
+    case GBUFFER_FRAMEBUFFER_FETCH:
+        attachments[count++] = GL_COLOR_ATTACHMENT1;
+        attachments[count++] = GL_COLOR_ATTACHMENT2;
+        attachments[count++] = GL_COLOR_ATTACHMENT3;
+        attachments[count++] = GL_DEPTH_ATTACHMENT;
+        break;
+    case GBUFFER_PIXEL_LOCAL_STORAGE:
+        glDisable(GL_SHADER_PIXEL_LOCAL_STORAGE_EXT);
+        attachments[count++] = GL_DEPTH_ATTACHMENT;
+        break;
+    default:
+        attachments[count++] = GL_DEPTH_ATTACHMENT;
+        break;
+    }
+
+    if (count > 0) {
+        glInvalidateFramebuffer(GL_FRAMEBUFFER, count, attachments);
+    }
+    if (gbuffer->mode == GBUFFER_FRAMEBUFFER_FETCH) {
+        /* The lit image is the only draw buffer (and the read buffer) of the output. */
+        GLenum drawBuffer = GL_COLOR_ATTACHMENT0;
+        glDrawBuffers(1, &drawBuffer);
+    }
+
+    glDepthMask(GL_TRUE);
+    glEnable(GL_DEPTH_TEST);
+}
+
+unsigned int gbufferOutputFramebuffer(const GBuffer* gbuffer) {
+    return gbuffer->lightingFbo;
+}
+
+int gbufferBytesPerPixel(GBufferMode mode) {
+    switch (mode) {
+    case GBUFFER_MRT:
+        return 4 + 4 + 4; // RGBA8 + RG16UI + DEPTH_COMPONENT24 (padded)
+    case GBUFFER_FRAMEBUFFER_FETCH:
+        return 4 + 4 + 4; // RGBA8 + RG16UI + R32UI
+    default:
+        return 0;
+    }
+}
+
+int64_t gbufferFrameBytes(GBufferMode mode, int width, int height) {
+    int64_t pixels = (int64_t)width * height;
+
+    /* The lit image is stored in every mode, the MRT G-buffer is stored and read back. With framebuffer
+     * fetch the attachments are allocated but invalidated: on a tile based GPU they are never written. */
+    int64_t bytes = pixels * 4;
+    if (mode == GBUFFER_MRT) {
+        bytes += 2 * pixels * gbufferBytesPerPixel(mode);
+    }
+    return bytes;
+}
@@ -0,0 +1,164 @@
+/**
+ * G-buffer for deferred shading with packed formats and tile-local variants.
+ *
+ * The geometry pass writes the material of the visible surface into the
+ * G-buffer, a full screen lighting pass then shades every pixel once (the
+ * shading cost doesn't depend on the overdraw of the scene). Layout, 12 bytes
+ * per pixel:
+ *  * albedo: RGBA8 (the alpha is unused),
+ *  * normal: octahedral encoding (the unit sphere folded onto a square) in two
+ *    16 bit unsigned normalized values, stored in RG16UI (color renderable in
+ *    every GL ES 3.0 implementation, unlike RG16 which needs EXT_texture_norm16),
+ *  * depth:  the view space distance of the surface.
+ *
+ * Modes:
+ *  GBUFFER_FORWARD           No G-buffer, the geometry pass shades directly:
+ *                            the reference of the comparison.
+ *  GBUFFER_MRT               Multiple render targets (glDrawBuffers): albedo and
+ *                            normal textures and a depth texture. The lighting
+ *                            pass samples them from a separate FBO, so the whole
+ *                            G-buffer is written to the memory and read back.
+ *  GBUFFER_FRAMEBUFFER_FETCH One FBO with the lit image and the G-buffer as color
+ *                            attachments (the depth in R32UI) and
+ *                            EXT_shader_framebuffer_fetch: the lighting pass
+ *                            reads the G-buffer of its own pixel ("inout" outputs).
+ *  GBUFFER_PIXEL_LOCAL_STORAGE
+ *                            EXT_shader_pixel_local_storage: the G-buffer is a
+ *                            per pixel struct of the tile memory, only the lit
+ *                            image has memory behind it.
+ *
+ * Tile based GPUs keep the attachments of a pass in the tile memory: in the
+ * last two modes the geometry and the lighting pass are the same render pass
+ * and the G-buffer attachments are invalidated at its end, so they never leave
+ * the chip (the same as RENDER_PASS_DISCARD, see render_pass.h).
+ *
+ * Usage:
+ *
+ *   GBuffer gbuffer;
+ *   initGBuffer(&gbuffer, gbufferBestMode(), width, height);
+ *   // Shaders: gbufferShaderHeader(mode) after the #version line,
+ *   // gbufferGeometrySrc / gbufferLightingSrc after the precision statements.
+ *   gbufferBeginGeometry(&gbuffer);
+ *   ... draw the scene (gbufferStore in the fragment shader) ...
+ *   gbufferBeginLighting(&gbuffer, lightingProgram, projection, near, far);
+ *   glDrawArrays(GL_TRIANGLES, 0, 3); // full screen, gbufferLoad in the fragment shader
+ *   gbufferEnd(&gbuffer);
+ *   // The lit image is the color attachment 0 of gbufferOutputFramebuffer.
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *  * EXT_shader_framebuffer_fetch, EXT_shader_pixel_local_storage (optional)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_GBUFFER_H
+#define GLES_COMMON_GBUFFER_H
+
+#include <stdint.h>
+
+enum GBufferMode {
+    GBUFFER_FORWARD,
+    GBUFFER_MRT,
+    GBUFFER_FRAMEBUFFER_FETCH,
+    GBUFFER_PIXEL_LOCAL_STORAGE,
+    GBUFFER_MODE_COUNT,
+};
+
+struct GBuffer {
+    GBufferMode mode;
+    int width;
+    int height;
+
+    unsigned int fbo;         // the geometry pass (and the lighting pass, except in the MRT mode)
+    unsigned int lightingFbo; // the lit image: a separate FBO in the MRT mode, otherwise "fbo"
+    unsigned int colorRB;     // the lit image (RGBA8)
+
+    // MRT: textures (depth: DEPTH_COMPONENT24), framebuffer fetch: renderbuffers (depth: R32UI).
+    unsigned int albedo;
+    unsigned int normal;
+    unsigned int depth;
+    unsigned int depthRB;     // forward, framebuffer fetch, pixel local storage: the depth buffer
+
+    unsigned int clearProgram; // pixel local storage: initializes the G-buffer of the tile
+
+    float clearColor[4]; // the lit image at the start of the geometry pass (the forward background)
+};
+
+// Name of the mode for the command line and the reports ("forward", "mrt", "fetch", "pls").
+const char* gbufferModeName(GBufferMode mode);
+
+// Look up a mode by name (GBUFFER_MODE_COUNT if unknown).
+GBufferMode findGBufferMode(const char* name);
+
+// Check if the driver has the extensions of the mode (requires a current GL ES context).
+bool gbufferModeSupported(GBufferMode mode);
+
+// The supported mode with the least memory traffic (pixel local storage, framebuffer fetch, MRT).
+GBufferMode gbufferBestMode();
+
+// Create the framebuffers and the attachments of the mode (clear color: black).
+/* Returns false if the mode is not supported or the FBO is incomplete. */
+bool initGBuffer(GBuffer* gbuffer, GBufferMode mode, int width, int height);
+
+void destroyGBuffer(GBuffer* gbuffer);
+
+// Source lines for the shaders of the mode, insert them after the "#version" line.
+/* The mode define (GBUFFER_MRT, GBUFFER_FETCH or GBUFFER_PLS) and the #extension directives. */
+const char* gbufferShaderHeader(GBufferMode mode);
+
+// GLSL for the geometry pass fragment shaders: append it after the precision statements.
+/* Declares the G-buffer outputs and:
+ *   void gbufferStore(vec3 albedo, vec3 normal, float viewDepth);  normal: unit length, viewDepth > 0 */
+extern const char* gbufferGeometrySrc;
+
+// GLSL for the lighting pass fragment shaders: append it after the precision statements.
+/* Declares the G-buffer inputs, the uniforms set by gbufferBeginLighting and:
+ *   bool gbufferLoad(out vec3 albedo, out vec3 normal, out float viewDepth);  false: no surface
+ *   vec3 gbufferViewPosition(float viewDepth);  the view space position of the pixel
+ * The lit color must be written to the output at location 0. */
+extern const char* gbufferLightingSrc;
+
+// Bind the FBO of the geometry pass, select its draw buffers, clear it and enable the depth test.
+/* The pixel local storage mode enables GL_SHADER_PIXEL_LOCAL_STORAGE_EXT and initializes it. */
+void gbufferBeginGeometry(GBuffer* gbuffer);
+
+// Switch to the lighting pass: use the program, set its uniforms (and bind the G-buffer textures).
+/* "projection": the column major projection matrix of the geometry pass. The depth test is disabled:
+ * the full screen triangle must write every pixel. */
+void gbufferBeginLighting(GBuffer* gbuffer, unsigned int program, const float* projection, float nearPlane, float farPlane);
+
+// End the passes: invalidate the G-buffer attachments which are not read later (and disable the pixel local storage).
+void gbufferEnd(GBuffer* gbuffer);
+
+// The framebuffer with the lit image (color attachment 0).
+unsigned int gbufferOutputFramebuffer(const GBuffer* gbuffer);
+
+// Allocated bytes of the G-buffer attachments of a pixel (without the lit image and the depth buffer).
+/* 0: the G-buffer lives only in the tile memory. */
+int gbufferBytesPerPixel(GBufferMode mode);
+
+// Estimated memory traffic of a frame: the attachments written to and read back from the memory.
+/* The depth buffer of every mode is assumed to be invalidated, the lit image is stored once. */
+int64_t gbufferFrameBytes(GBufferMode mode, int width, int height);
+
+#endif // GLES_COMMON_GBUFFER_H
@@ -0,0 +1,45 @@
+/**
+ * GL debug output (ES 3.2 core or GL_KHR_debug) shared by the demos.
+ *
+ * The messages of the driver (errors, performance warnings, ...) are
+ * printed with a "-> " prefix. With a synchronous output the message is
+ * printed from the GL call which caused it, so a breakpoint in the callback
+ * shows the offending call.
+ *
+ * The demos using common/demo_context.h enable it with "--gl-debug".
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.2+ or GL_KHR_debug
+ *  * EGL
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_GL_DEBUG_H
+#define GLES_COMMON_GL_DEBUG_H
+
+// Print the debug messages of the current context.
+/* Uses glDebugMessageCallback in ES 3.2+ contexts and the KHR entry point from eglGetProcAddress
+ * otherwise. Returns false if neither is available (the messages are not printed). */
+bool enableGLDebugOutput(bool synchronous);
+
+#endif // GLES_COMMON_GL_DEBUG_H
@@ -0,0 +1,195 @@
+/**
+ * Move-only GL object handles and the deferred deletion queue, see gl_handle.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/gl_handle.h"
+
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include <GLES3/gl3.h>
+
+#include "common/gl_state.h"
+#include "common/gpu_memory.h"
+
+typedef std::pair<GlObjectKind, unsigned int> GlObject;
+
+struct DeletionBatch {
+    GLsync fence;
+    std::vector<GlObject> objects;
+};
+
+struct DeletionQueue {
+    std::vector<GlObject> frame; // queued since the last glDeletionQueueEndFrame
+    std::deque<DeletionBatch> batches;
+    int deleted;
+};
+
+static DeletionQueue& deletionQueue() {
+    static DeletionQueue queue;
+    return queue;
+}
+
+static void deleteGlObject(const GlObject& object) {
+    unsigned int name = object.second;
+    switch (object.first) {
+        case GL_OBJECT_BUFFER:
+            glDeleteBuffers(1, &name);
+            gpuMemoryReleaseBuffers(1, &name);
+            break;
+        case GL_OBJECT_TEXTURE:
+            glDeleteTextures(1, &name);
+            gpuMemoryReleaseTextures(1, &name);
+            break;
+        case GL_OBJECT_RENDERBUFFER:
+            glDeleteRenderbuffers(1, &name);
+            gpuMemoryReleaseRenderbuffers(1, &name);
+            break;
+        case GL_OBJECT_FRAMEBUFFER: glDeleteFramebuffers(1, &name); break;
+        case GL_OBJECT_VERTEX_ARRAY: glDeleteVertexArrays(1, &name); break;
+        case GL_OBJECT_SAMPLER: glDeleteSamplers(1, &name); break;
+        case GL_OBJECT_QUERY: glDeleteQueries(1, &name); break;
+        case GL_OBJECT_PROGRAM: glDeleteProgram(name); break;
+        case GL_OBJECT_SHADER: glDeleteShader(name); break;
+        default: break;
+    }
+    deletionQueue().deleted++;
+}
+
+static void deleteBatch(DeletionBatch* batch) {
+    for (const GlObject& object : batch->objects) {
+        deleteGlObject(object);
+    }
+    if (batch->fence != NULL) {
+        glDeleteSync(batch->fence);
+    }
+}
+
+void deferGlDelete(GlObjectKind kind, unsigned int name) {
+    if (name != 0) {
+        deletionQueue().frame.push_back(GlObject(kind, name));
+    }
+}
+
+void glDeletionQueueEndFrame() {
+    DeletionQueue& queue = deletionQueue();
+    if (!queue.frame.empty()) {
+        DeletionBatch batch;
+        batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        batch.objects.swap(queue.frame);
+        queue.batches.push_back(std::move(batch));
+    }
+
+    // Q.1. The status query doesn't wait or flush: the batches are deleted in order once their fence signaled.
+    bool deleted = false;
+    while (!queue.batches.empty()) {
+        DeletionBatch& batch = queue.batches.front();
+        int status = GL_UNSIGNALED;
+        glGetSynciv(batch.fence, GL_SYNC_STATUS, 1, NULL, &status);
+        if (status != GL_SIGNALED) {
+            break;
+        }
+        deleteBatch(&batch);
+        queue.batches.pop_front();
+        deleted = true;
+    }
+
+    // Q.2. A deleted object may still be bound in the shadowed state and its name can be reused.
+    if (deleted) {
+        stateCacheInvalidate();
+    }
+}
+
+void flushGlDeletionQueue() {
+    DeletionQueue& queue = deletionQueue();
+    for (DeletionBatch& batch : queue.batches) {
+        deleteBatch(&batch);
+    }
+    queue.batches.clear();
+    for (const GlObject& object : queue.frame) {
+        deleteGlObject(object);
+    }
+    queue.frame.clear();
+    stateCacheInvalidate();
+}
+
+void glDeletionQueueGetStats(GlDeletionStats* stats) {
+    const DeletionQueue& queue = deletionQueue();
+    stats->queued = (int)queue.frame.size();
+    for (const DeletionBatch& batch : queue.batches) {
+        stats->queued += (int)batch.objects.size();
+    }
+    stats->fences = (int)queue.batches.size();
+    stats->deleted = queue.deleted;
+}
+
+GlBuffer createGlBuffer() {
+    unsigned int name = 0;
+    glGenBuffers(1, &name);
+    return GlBuffer(name);
+}
+
+GlTexture createGlTexture() {
+    unsigned int name = 0;
+    glGenTextures(1, &name);
+    return GlTexture(name);
+}
+
+GlRenderbuffer createGlRenderbuffer() {
+    unsigned int name = 0;
+    glGenRenderbuffers(1, &name);
+    return GlRenderbuffer(name);
+}
+
+GlFramebuffer createGlFramebuffer() {
+    unsigned int name = 0;
+    glGenFramebuffers(1, &name);
+    return GlFramebuffer(name);
+}
+
+GlVertexArray createGlVertexArray() {
+    unsigned int name = 0;
+    glGenVertexArrays(1, &name);
+    return GlVertexArray(name);
+}
+
+GlSampler createGlSampler() {
+    unsigned int name = 0;
+    glGenSamplers(1, &name);
+    return GlSampler(name);
+}
+
+GlQuery createGlQuery() {
+    unsigned int name = 0;
+    glGenQueries(1, &name);
+    return GlQuery(name);
+}
+
+GlProgram createGlProgram() {
+    return GlProgram(glCreateProgram());
+}
+
+GlShader createGlShader(unsigned int type) {
+    return GlShader(glCreateShader(type));
+}
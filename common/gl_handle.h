@@ -0,0 +1,149 @@
+/**
+ * Move-only GL object handles and the deferred deletion queue.
+ *
+ * A GlHandle owns one GL object name: it can be moved (ex.: returned from a
+ * function, stored in a vector) but not copied, and the object is released
+ * when the handle is destroyed or reset. Nothing is deleted right away: the
+ * name goes into the deletion queue and glDeletionQueueEndFrame closes the
+ * deletions of the frame with a fence. The objects are deleted with glDelete*
+ * once their fence has signaled, so the GPU has finished every frame which
+ * could use them and the deletion can't make the driver wait in the middle of
+ * a frame (ex.: the render targets released after a resize, the programs
+ * replaced by a shader reload).
+ *
+ * demoSwapBuffers calls glDeletionQueueEndFrame and destroyDemoContext calls
+ * flushGlDeletionQueue (before the GPU memory report). The handles which are
+ * destroyed after destroyDemoContext have no context: reset them before it
+ * (or keep them in a scope which ends before it). The queue belongs to the
+ * render thread's context, the GL workers delete their own objects.
+ *
+ * Usage:
+ *
+ *   GlBuffer vbo = createGlBuffer();
+ *   glBindBuffer(GL_ARRAY_BUFFER, vbo.get());
+ *   ...
+ *   vbo = createGlBuffer(); // the old buffer is deleted a few frames later
+ *   vbo.reset();            // the same without a new buffer
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_GL_HANDLE_H
+#define GLES_COMMON_GL_HANDLE_H
+
+enum GlObjectKind {
+    GL_OBJECT_BUFFER,
+    GL_OBJECT_TEXTURE,
+    GL_OBJECT_RENDERBUFFER,
+    GL_OBJECT_FRAMEBUFFER,
+    GL_OBJECT_VERTEX_ARRAY,
+    GL_OBJECT_SAMPLER,
+    GL_OBJECT_QUERY,
+    GL_OBJECT_PROGRAM,
+    GL_OBJECT_SHADER,
+    GL_OBJECT_KIND_COUNT,
+};
+
+// Queue the deletion of the object (0 is ignored), see glDeletionQueueEndFrame.
+/* The GPU memory tracking of the buffers, textures and renderbuffers (see gpu_memory.h) is released at the deletion. */
+void deferGlDelete(GlObjectKind kind, unsigned int name);
+
+// The deletions queued in the frame wait for a fence, the objects of the signaled fences are deleted.
+/* Call after the last GL command of the frame (demoSwapBuffers calls it after the swap). */
+void glDeletionQueueEndFrame();
+
+// Delete every queued object without waiting (ex.: after glFinish, before the context is destroyed).
+void flushGlDeletionQueue();
+
+struct GlDeletionStats {
+    int queued;  // objects waiting for their fence (or the next glDeletionQueueEndFrame)
+    int fences;  // frames with queued objects
+    int deleted; // objects deleted so far
+};
+
+void glDeletionQueueGetStats(GlDeletionStats* stats);
+
+template <GlObjectKind Kind>
+class GlHandle {
+public:
+    GlHandle() : name(0) {}
+    explicit GlHandle(unsigned int object) : name(object) {}
+    GlHandle(GlHandle&& other) : name(other.name) { other.name = 0; }
+    GlHandle(const GlHandle&) = delete;
+    ~GlHandle() { reset(); }
+
+    GlHandle& operator=(GlHandle&& other) {
+        if (this != &other) {
+            reset(other.name);
+            other.name = 0;
+        }
+        return *this;
+    }
+    GlHandle& operator=(const GlHandle&) = delete;
+
+    unsigned int get() const { return name; }
+    explicit operator bool() const { return name != 0; }
+
+    // Give up the ownership: the caller deletes the object.
+    unsigned int release() {
+        unsigned int object = name;
+        name = 0;
+        return object;
+    }
+
+    // Queue the deletion of the owned object and take the ownership of "object".
+    void reset(unsigned int object = 0) {
+        if (name != 0 && name != object) {
+            deferGlDelete(Kind, name);
+        }
+        name = object;
+    }
+
+private:
+    unsigned int name;
+};
+
+typedef GlHandle<GL_OBJECT_BUFFER> GlBuffer;
+typedef GlHandle<GL_OBJECT_TEXTURE> GlTexture;
+typedef GlHandle<GL_OBJECT_RENDERBUFFER> GlRenderbuffer;
+typedef GlHandle<GL_OBJECT_FRAMEBUFFER> GlFramebuffer;
+typedef GlHandle<GL_OBJECT_VERTEX_ARRAY> GlVertexArray;
+typedef GlHandle<GL_OBJECT_SAMPLER> GlSampler;
+typedef GlHandle<GL_OBJECT_QUERY> GlQuery;
+typedef GlHandle<GL_OBJECT_PROGRAM> GlProgram;
+typedef GlHandle<GL_OBJECT_SHADER> GlShader;
+
+// A new object of the kind (glGen*/glCreate*).
+GlBuffer createGlBuffer();
+GlTexture createGlTexture();
+GlRenderbuffer createGlRenderbuffer();
+GlFramebuffer createGlFramebuffer();
+GlVertexArray createGlVertexArray();
+GlSampler createGlSampler();
+GlQuery createGlQuery();
+GlProgram createGlProgram();
+GlShader createGlShader(unsigned int type);
+
+#endif // GLES_COMMON_GL_HANDLE_H
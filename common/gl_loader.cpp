@@ -0,0 +1,100 @@
+/**
+ * Lazy GL ES entry point loading, see gl_loader.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/gl_loader.h"
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+
+#include <EGL/egl.h>
+
+#ifdef GLES_LAZY_GL_LOADER
+// The size of the generated dispatch table (tools/gl_dispatch).
+extern const int glDispatchEntryCount;
+#endif
+
+static std::atomic<int> resolvedCount(0);
+static std::atomic<long long> resolveNs(0);
+
+// The library is opened once, the core entry points don't need the EGL_KHR_get_all_proc_addresses extension.
+static void* glesLibrary() {
+    static void* library = dlopen("libGLESv2.so.2", RTLD_LAZY | RTLD_LOCAL);
+    return library;
+}
+
+void* glLoaderResolve(const char* name) {
+    void* proc = glesLibrary() != NULL ? dlsym(glesLibrary(), name) : NULL;
+    if (proc == NULL) {
+        proc = (void*)eglGetProcAddress(name);
+    }
+    return proc;
+}
+
+void* glLoaderResolveAny(std::initializer_list<const char*> names) {
+    for (const char* name : names) {
+        void* proc = glLoaderResolve(name);
+        if (proc != NULL) {
+            return proc;
+        }
+    }
+    return NULL;
+}
+
+void* glLoaderResolveSlot(void** slot, const char* name) {
+    using namespace std::chrono;
+    steady_clock::time_point start = steady_clock::now();
+
+    void* proc = glLoaderResolve(name);
+    if (proc == NULL) {
+        printf("GL loader: the driver has no '%s' entry point\n", name);
+        abort();
+    }
+    *slot = proc;
+
+    resolvedCount++;
+    resolveNs += duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    return proc;
+}
+
+bool glLoaderEnabled() {
+#ifdef GLES_LAZY_GL_LOADER
+    return true;
+#else
+    return false;
+#endif
+}
+
+void glLoaderGetStats(int* resolved, int* entries, double* seconds) {
+    *resolved = resolvedCount;
+#ifdef GLES_LAZY_GL_LOADER
+    *entries = glDispatchEntryCount;
+#else
+    *entries = 0;
+#endif
+    *seconds = resolveNs / 1e9;
+}
@@ -0,0 +1,80 @@
+/**
+ * Lazy GL ES entry point loading.
+ *
+ * With the GLES_LAZY_GL_LOADER build option the demos don't link libGLESv2:
+ * tools/gl_dispatch generates a function for every GL ES entry point the
+ * sources use (and only those), each one resolves its entry point at its first
+ * call and jumps through a dispatch table slot afterwards. The process start
+ * doesn't relocate the hundreds of unused symbols and the extension functions
+ * with prototypes in GLES2/gl2ext.h can be called directly by name even if the
+ * libGLESv2 of the platform doesn't export them (timer queries, multiview,
+ * multi-draw, ...).
+ *
+ * The resolution (glLoaderResolve, also usable without the build option for the
+ * function pointers of the extensions): the symbol of libGLESv2 (opened at the
+ * first resolution) for the core functions, eglGetProcAddress otherwise. A
+ * missing entry point is reported with its name and aborts, as the unresolved
+ * symbol of a direct link would.
+ *
+ * "--startup-profile" prints the resolved entry point count and the time spent
+ * (see startup_profile.h).
+ *
+ * Usage:
+ *
+ *   $ cmake -DGLES_LAZY_GL_LOADER=ON ..
+ *
+ *   PFNGLQUERYCOUNTEREXTPROC queryCounter =
+ *       (PFNGLQUERYCOUNTEREXTPROC)glLoaderResolveAny({ "glQueryCounterEXT", "glQueryCounter" });
+ *
+ * The capture layer (x_gles_capture, LD_PRELOAD) only sees the calls of the
+ * default build: the lazy dispatch resolves past the preloaded symbols.
+ *
+ * Dependencies:
+ *  * C++11
+ *  * EGL
+ *  * libdl
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_GL_LOADER_H
+#define GLES_COMMON_GL_LOADER_H
+
+#include <initializer_list>
+
+// The entry point of a GL ES function (core or extension), NULL if the driver doesn't have it.
+void* glLoaderResolve(const char* name);
+
+// The entry point of the first name which resolves (ex.: the core name and its EXT/OES variants).
+void* glLoaderResolveAny(std::initializer_list<const char*> names);
+
+// Resolve the entry point into the slot of the dispatch table (the generated dispatch calls it).
+/* Aborts if the entry point is missing. The threads may resolve the same slot at the same time,
+ * they store the same value. */
+void* glLoaderResolveSlot(void** slot, const char* name);
+
+// True if the lazy dispatch is linked (GLES_LAZY_GL_LOADER).
+bool glLoaderEnabled();
+
+// The entry points resolved by the lazy dispatch so far, the size of the dispatch table and the time spent.
+void glLoaderGetStats(int* resolved, int* entries, double* seconds);
+
+#endif // GLES_COMMON_GL_LOADER_H
@@ -0,0 +1,230 @@
+/**
+ * GL state cache: skips the redundant binds and program switches.
+ * See gl_state.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/gl_state.h"
+
+#include <stdio.h>
+
+#include <GLES3/gl31.h>
+
+static StateCache g_cache;
+
+// Compare and update a shadowed binding, count the result.
+/* Disabled cache: always issued, the shadow isn't updated. */
+static bool changeState(StateCacheKind kind, unsigned int* shadow, unsigned int value) {
+    if (g_cache.enabled && *shadow == value) {
+        g_cache.skipped[kind]++;
+        return false;
+    }
+
+    *shadow = g_cache.enabled ? value : STATE_CACHE_UNKNOWN;
+    g_cache.issued[kind]++;
+    return true;
+}
+
+static int bufferTargetIndex(unsigned int target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER: return STATE_CACHE_ARRAY_BUFFER;
+        case GL_SHADER_STORAGE_BUFFER: return STATE_CACHE_STORAGE_BUFFER;
+        case GL_UNIFORM_BUFFER: return STATE_CACHE_UNIFORM_BUFFER;
+        case GL_DRAW_INDIRECT_BUFFER: return STATE_CACHE_DRAW_INDIRECT_BUFFER;
+        case GL_DISPATCH_INDIRECT_BUFFER: return STATE_CACHE_DISPATCH_INDIRECT_BUFFER;
+        case GL_COPY_READ_BUFFER: return STATE_CACHE_COPY_READ_BUFFER;
+        case GL_COPY_WRITE_BUFFER: return STATE_CACHE_COPY_WRITE_BUFFER;
+        case GL_PIXEL_PACK_BUFFER: return STATE_CACHE_PIXEL_PACK_BUFFER;
+        case GL_PIXEL_UNPACK_BUFFER: return STATE_CACHE_PIXEL_UNPACK_BUFFER;
+        default: return -1;
+    }
+}
+
+static int textureTargetIndex(unsigned int target) {
+    switch (target) {
+        case GL_TEXTURE_2D: return STATE_CACHE_TEXTURE_2D;
+        case GL_TEXTURE_CUBE_MAP: return STATE_CACHE_TEXTURE_CUBE_MAP;
+        case GL_TEXTURE_2D_ARRAY: return STATE_CACHE_TEXTURE_2D_ARRAY;
+        case GL_TEXTURE_3D: return STATE_CACHE_TEXTURE_3D;
+        default: return -1;
+    }
+}
+
+void stateCacheEnable(bool enabled) {
+    g_cache.enabled = enabled;
+    stateCacheInvalidate();
+}
+
+void stateCacheInvalidate() {
+    g_cache.program = STATE_CACHE_UNKNOWN;
+    g_cache.vertexArray = STATE_CACHE_UNKNOWN;
+    g_cache.drawFramebuffer = STATE_CACHE_UNKNOWN;
+    g_cache.readFramebuffer = STATE_CACHE_UNKNOWN;
+    for (int idx = 0; idx < STATE_CACHE_BUFFER_TARGET_COUNT; idx++) {
+        g_cache.buffers[idx] = STATE_CACHE_UNKNOWN;
+    }
+    for (int idx = 0; idx < STATE_CACHE_MAX_INDEXED_BUFFERS; idx++) {
+        g_cache.storageBuffers[idx] = STATE_CACHE_UNKNOWN;
+        g_cache.uniformBuffers[idx] = STATE_CACHE_UNKNOWN;
+    }
+    g_cache.activeTexture = STATE_CACHE_UNKNOWN;
+    for (int unit = 0; unit < STATE_CACHE_MAX_TEXTURE_UNITS; unit++) {
+        for (int idx = 0; idx < STATE_CACHE_TEXTURE_TARGET_COUNT; idx++) {
+            g_cache.textures[unit][idx] = STATE_CACHE_UNKNOWN;
+        }
+    }
+    for (int unit = 0; unit < STATE_CACHE_MAX_IMAGE_UNITS; unit++) {
+        g_cache.images[unit].texture = STATE_CACHE_UNKNOWN;
+    }
+}
+
+const StateCache* stateCacheGet() {
+    return &g_cache;
+}
+
+bool stateCacheUseProgram(unsigned int program) {
+    if (!changeState(STATE_CACHE_PROGRAM, &g_cache.program, program)) {
+        return false;
+    }
+    glUseProgram(program);
+    return true;
+}
+
+bool stateCacheBindVertexArray(unsigned int vertexArray) {
+    if (!changeState(STATE_CACHE_VERTEX_ARRAY, &g_cache.vertexArray, vertexArray)) {
+        return false;
+    }
+    glBindVertexArray(vertexArray);
+    return true;
+}
+
+bool stateCacheBindFramebuffer(unsigned int target, unsigned int fbo) {
+    if (target == GL_FRAMEBUFFER) {
+        /* Skipped only if both bindings match. */
+        if (g_cache.enabled && g_cache.drawFramebuffer == fbo && g_cache.readFramebuffer == fbo) {
+            g_cache.skipped[STATE_CACHE_FRAMEBUFFER]++;
+            return false;
+        }
+        g_cache.drawFramebuffer = g_cache.enabled ? fbo : STATE_CACHE_UNKNOWN;
+        g_cache.readFramebuffer = g_cache.drawFramebuffer;
+        g_cache.issued[STATE_CACHE_FRAMEBUFFER]++;
+    } else {
+        unsigned int* shadow = target == GL_READ_FRAMEBUFFER ? &g_cache.readFramebuffer : &g_cache.drawFramebuffer;
+        if (!changeState(STATE_CACHE_FRAMEBUFFER, shadow, fbo)) {
+            return false;
+        }
+    }
+    glBindFramebuffer(target, fbo);
+    return true;
+}
+
+bool stateCacheBindBuffer(unsigned int target, unsigned int buffer) {
+    int index = bufferTargetIndex(target);
+    if (index < 0) {
+        g_cache.issued[STATE_CACHE_BUFFER]++;
+    } else if (!changeState(STATE_CACHE_BUFFER, &g_cache.buffers[index], buffer)) {
+        return false;
+    }
+    glBindBuffer(target, buffer);
+    return true;
+}
+
+bool stateCacheBindBufferBase(unsigned int target, unsigned int index, unsigned int buffer) {
+    unsigned int* bindings = target == GL_SHADER_STORAGE_BUFFER ? g_cache.storageBuffers
+                           : (target == GL_UNIFORM_BUFFER ? g_cache.uniformBuffers : NULL);
+    if (bindings == NULL || index >= STATE_CACHE_MAX_INDEXED_BUFFERS) {
+        g_cache.issued[STATE_CACHE_BUFFER_BASE]++;
+    } else if (!changeState(STATE_CACHE_BUFFER_BASE, &bindings[index], buffer)) {
+        return false;
+    }
+
+    int generic = bufferTargetIndex(target);
+    if (generic >= 0) {
+        g_cache.buffers[generic] = g_cache.enabled ? buffer : STATE_CACHE_UNKNOWN;
+    }
+    glBindBufferBase(target, index, buffer);
+    return true;
+}
+
+bool stateCacheBindTexture(unsigned int unit, unsigned int target, unsigned int texture) {
+    int index = textureTargetIndex(target);
+    if (index < 0 || unit >= STATE_CACHE_MAX_TEXTURE_UNITS) {
+        g_cache.issued[STATE_CACHE_TEXTURE]++;
+    } else if (!changeState(STATE_CACHE_TEXTURE, &g_cache.textures[unit][index], texture)) {
+        return false;
+    }
+
+    /* The active unit switch isn't counted separately: it is a part of the bind. */
+    if (!g_cache.enabled || g_cache.activeTexture != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        g_cache.activeTexture = g_cache.enabled ? unit : STATE_CACHE_UNKNOWN;
+    }
+    glBindTexture(target, texture);
+    return true;
+}
+
+bool stateCacheBindImageTexture(unsigned int unit, unsigned int texture, int level, bool layered, int layer,
+                                unsigned int access, unsigned int format) {
+    if (unit < STATE_CACHE_MAX_IMAGE_UNITS) {
+        StateCacheImage& image = g_cache.images[unit];
+        if (g_cache.enabled && image.texture == texture && image.level == level && image.layered == layered
+            && image.layer == layer && image.access == access && image.format == format) {
+            g_cache.skipped[STATE_CACHE_IMAGE]++;
+            return false;
+        }
+
+        StateCacheImage bound = { g_cache.enabled ? texture : STATE_CACHE_UNKNOWN, level, layered, layer, access, format };
+        image = bound;
+    }
+
+    g_cache.issued[STATE_CACHE_IMAGE]++;
+    glBindImageTexture(unit, texture, level, layered ? GL_TRUE : GL_FALSE, layer, access, format);
+    return true;
+}
+
+void stateCacheResetStats() {
+    for (int kind = 0; kind < STATE_CACHE_KIND_COUNT; kind++) {
+        g_cache.issued[kind] = 0;
+        g_cache.skipped[kind] = 0;
+    }
+}
+
+void printStateCacheStats() {
+    static const char* names[STATE_CACHE_KIND_COUNT] = {
+        "program", "vertex array", "framebuffer", "buffer", "buffer base", "texture", "image",
+    };
+
+    int issued = 0;
+    int skipped = 0;
+    for (int kind = 0; kind < STATE_CACHE_KIND_COUNT; kind++) {
+        issued += g_cache.issued[kind];
+        skipped += g_cache.skipped[kind];
+    }
+
+    printf("GL state%s: %d issued, %d skipped |", g_cache.enabled ? "" : " (cache disabled)", issued, skipped);
+    for (int kind = 0; kind < STATE_CACHE_KIND_COUNT; kind++) {
+        if (g_cache.issued[kind] + g_cache.skipped[kind] > 0) {
+            printf(" %s %d/%d", names[kind], g_cache.issued[kind], g_cache.skipped[kind]);
+        }
+    }
+    printf(" (issued/skipped)\n");
+}
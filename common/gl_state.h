@@ -0,0 +1,158 @@
+/**
+ * GL state cache: shadows the bound objects of the render context and skips
+ * the redundant binds and program switches.
+ *
+ * Every redundant glUseProgram/glBind* still goes through the driver's
+ * validation, which is a measurable CPU cost on low-end cores. The
+ * stateCache* functions compare against the shadowed state and only call
+ * GL when the binding changes, so a render loop can bind what it needs
+ * without tracking it and without the "unbind to 0" calls.
+ *
+ * The cache is disabled by default: every call is issued (and counted) and
+ * the shadow is not trusted, so mixing it with direct GL binds is safe.
+ * After stateCacheEnable(true) the cached state must stay in sync with GL:
+ *
+ *  * every bind of the shadowed kinds goes through the cache, or the code
+ *    binding directly calls stateCacheInvalidate() afterwards,
+ *  * deleting a bound object unbinds it in GL but not in the cache: call
+ *    stateCacheInvalidate() after deleting objects which may be bound
+ *    (the name can be reused by the next glGen*),
+ *  * only the render thread's context is shadowed (not the GL workers').
+ *
+ * The GL_ELEMENT_ARRAY_BUFFER binding is a vertex array state and it isn't
+ * shadowed (bind it while the vertex array is bound, as usual).
+ *
+ * The issued and skipped calls are counted per kind of state, and
+ * printStateCacheStats prints them (ex.: once per second with a reset).
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.1+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_GL_STATE_H
+#define GLES_COMMON_GL_STATE_H
+
+#define STATE_CACHE_MAX_INDEXED_BUFFERS 16
+#define STATE_CACHE_MAX_TEXTURE_UNITS 16
+#define STATE_CACHE_MAX_IMAGE_UNITS 8
+
+enum StateCacheKind {
+    STATE_CACHE_PROGRAM,
+    STATE_CACHE_VERTEX_ARRAY,
+    STATE_CACHE_FRAMEBUFFER,
+    STATE_CACHE_BUFFER,        // glBindBuffer
+    STATE_CACHE_BUFFER_BASE,   // glBindBufferBase (storage and uniform buffers)
+    STATE_CACHE_TEXTURE,       // glActiveTexture + glBindTexture
+    STATE_CACHE_IMAGE,         // glBindImageTexture
+    STATE_CACHE_KIND_COUNT,
+};
+
+// Shadowed buffer targets.
+enum StateCacheBufferTarget {
+    STATE_CACHE_ARRAY_BUFFER,
+    STATE_CACHE_STORAGE_BUFFER,
+    STATE_CACHE_UNIFORM_BUFFER,
+    STATE_CACHE_DRAW_INDIRECT_BUFFER,
+    STATE_CACHE_DISPATCH_INDIRECT_BUFFER,
+    STATE_CACHE_COPY_READ_BUFFER,
+    STATE_CACHE_COPY_WRITE_BUFFER,
+    STATE_CACHE_PIXEL_PACK_BUFFER,
+    STATE_CACHE_PIXEL_UNPACK_BUFFER,
+    STATE_CACHE_BUFFER_TARGET_COUNT,
+};
+
+// Shadowed texture targets (per texture unit).
+enum StateCacheTextureTarget {
+    STATE_CACHE_TEXTURE_2D,
+    STATE_CACHE_TEXTURE_CUBE_MAP,
+    STATE_CACHE_TEXTURE_2D_ARRAY,
+    STATE_CACHE_TEXTURE_3D,
+    STATE_CACHE_TEXTURE_TARGET_COUNT,
+};
+
+struct StateCacheImage {
+    unsigned int texture;
+    int level;
+    bool layered;
+    int layer;
+    unsigned int access;
+    unsigned int format;
+};
+
+/* An unknown binding (after an invalidate) is STATE_CACHE_UNKNOWN, the next bind is always issued. */
+#define STATE_CACHE_UNKNOWN 0xffffffffu
+
+struct StateCache {
+    bool enabled;
+
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int drawFramebuffer;
+    unsigned int readFramebuffer;
+    unsigned int buffers[STATE_CACHE_BUFFER_TARGET_COUNT];
+    unsigned int storageBuffers[STATE_CACHE_MAX_INDEXED_BUFFERS];
+    unsigned int uniformBuffers[STATE_CACHE_MAX_INDEXED_BUFFERS];
+    unsigned int activeTexture; // unit index
+    unsigned int textures[STATE_CACHE_MAX_TEXTURE_UNITS][STATE_CACHE_TEXTURE_TARGET_COUNT];
+    StateCacheImage images[STATE_CACHE_MAX_IMAGE_UNITS];
+
+    // Statistics since the last reset.
+    int issued[STATE_CACHE_KIND_COUNT];
+    int skipped[STATE_CACHE_KIND_COUNT];
+};
+
+// Start/stop skipping the redundant calls (the shadowed state is unknown after both).
+void stateCacheEnable(bool enabled);
+
+// Forget the shadowed state (after direct GL binds or deleting bound objects).
+void stateCacheInvalidate();
+
+const StateCache* stateCacheGet();
+
+// The calls return true if the GL call was issued (false: it was redundant and skipped).
+bool stateCacheUseProgram(unsigned int program);
+bool stateCacheBindVertexArray(unsigned int vertexArray);
+
+// GL_FRAMEBUFFER binds both the draw and the read framebuffer.
+bool stateCacheBindFramebuffer(unsigned int target, unsigned int fbo);
+
+// Generic binding points of the StateCacheBufferTarget targets (others are issued without caching).
+bool stateCacheBindBuffer(unsigned int target, unsigned int buffer);
+
+// GL_SHADER_STORAGE_BUFFER or GL_UNIFORM_BUFFER binding points (also sets the generic binding, as GL).
+bool stateCacheBindBufferBase(unsigned int target, unsigned int index, unsigned int buffer);
+
+// Bind a texture to a unit, glActiveTexture is only called if the unit differs from the active one.
+/* GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_3D. */
+bool stateCacheBindTexture(unsigned int unit, unsigned int target, unsigned int texture);
+
+bool stateCacheBindImageTexture(unsigned int unit, unsigned int texture, int level, bool layered, int layer,
+                                unsigned int access, unsigned int format);
+
+void stateCacheResetStats();
+
+// Print the issued and skipped calls per kind since the last reset.
+void printStateCacheStats();
+
+#endif // GLES_COMMON_GL_STATE_H
@@ -0,0 +1,228 @@
+/**
+ * GL worker threads with shared EGL contexts. See gl_workers.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/gl_workers.h"
+
+#include <string.h>
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+
+static bool hasExtension(const char* list, const char* name) {
+    size_t length = strlen(name);
+    for (const char* ptr = list ? strstr(list, name) : NULL; ptr != NULL; ptr = strstr(ptr + length, name)) {
+        if ((ptr == list || ptr[-1] == ' ') && (ptr[length] == ' ' || ptr[length] == '\0')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool createSharedContext(SharedContext* shared) {
+    EGLDisplay display = eglGetCurrentDisplay();
+    EGLContext mainContext = eglGetCurrentContext();
+    if (display == EGL_NO_DISPLAY || mainContext == EGL_NO_CONTEXT) {
+        return false;
+    }
+
+    // 1. Use the same configuration as the render context.
+    EGLint configId = 0;
+    eglQueryContext(display, mainContext, EGL_CONFIG_ID, &configId);
+
+    const EGLint configAttribs[] = {
+        EGL_CONFIG_ID, configId,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs != 1) {
+        return false;
+    }
+
+    // 2. Create the shared context.
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_CLIENT_VERSION, 3,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, mainContext, contextAttribs);
+    if (context == EGL_NO_CONTEXT) {
+        return false;
+    }
+
+    // 3. The shared contexts never render to a surface: no surface if possible, otherwise a tiny pbuffer.
+    EGLSurface surface = EGL_NO_SURFACE;
+    if (!hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+        const EGLint pbufferAttribs[] = {
+            EGL_WIDTH, 1,
+            EGL_HEIGHT, 1,
+            EGL_NONE
+        };
+        surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+        if (surface == EGL_NO_SURFACE) {
+            eglDestroyContext(display, context);
+            return false;
+        }
+    }
+
+    shared->display = display;
+    shared->context = context;
+    shared->surface = surface;
+    return true;
+}
+
+bool makeSharedContextCurrent(const SharedContext* shared) {
+    eglBindAPI(EGL_OPENGL_ES_API);
+    if (shared == NULL) {
+        return eglMakeCurrent(eglGetCurrentDisplay(), EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
+    return eglMakeCurrent(shared->display, shared->surface, shared->surface, shared->context);
+}
+
+void destroySharedContext(SharedContext* shared) {
+    if (shared->surface != EGL_NO_SURFACE) {
+        eglDestroySurface(shared->display, shared->surface);
+    }
+    eglDestroyContext(shared->display, shared->context);
+    shared->context = EGL_NO_CONTEXT;
+    shared->surface = EGL_NO_SURFACE;
+}
+
+static void workerMain(GLWorkers* workers, SharedContext context) {
+    makeSharedContextCurrent(&context);
+
+    while (true) {
+        GLTask* task;
+        {
+            std::unique_lock<std::mutex> lock(workers->mutex);
+            workers->taskReady.wait(lock, [workers] { return workers->stopping || !workers->queue.empty(); });
+            if (workers->queue.empty()) {
+                break;
+            }
+            task = workers->queue.front();
+            workers->queue.pop_front();
+        }
+
+        task->function(task->data);
+
+        // The fence (and the commands before it) must be flushed so the render context can wait for it.
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+
+        std::lock_guard<std::mutex> lock(workers->mutex);
+        task->fence = fence;
+        task->finished = true;
+        workers->taskFinished.notify_all();
+    }
+
+    glFinish();
+    makeSharedContextCurrent(NULL);
+}
+
+int initGLWorkers(GLWorkers* workers, int workerCount) {
+    workers->stopping = false;
+
+    for (int idx = 0; idx < workerCount; idx++) {
+        SharedContext context;
+        if (!createSharedContext(&context)) {
+            break;
+        }
+        workers->contexts.push_back(context);
+    }
+
+    /* The contexts are created on the render thread: the share context must not be current elsewhere. */
+    for (size_t idx = 0; idx < workers->contexts.size(); idx++) {
+        workers->threads.push_back(std::thread(workerMain, workers, workers->contexts[idx]));
+    }
+    return (int)workers->threads.size();
+}
+
+void destroyGLWorkers(GLWorkers* workers) {
+    {
+        std::lock_guard<std::mutex> lock(workers->mutex);
+        workers->stopping = true;
+    }
+    workers->taskReady.notify_all();
+
+    for (size_t idx = 0; idx < workers->threads.size(); idx++) {
+        workers->threads[idx].join();
+    }
+    workers->threads.clear();
+
+    for (size_t idx = 0; idx < workers->contexts.size(); idx++) {
+        destroySharedContext(&workers->contexts[idx]);
+    }
+    workers->contexts.clear();
+}
+
+void glWorkersSubmit(GLWorkers* workers, GLTask* task, GLTaskFunction function, void* data) {
+    task->function = function;
+    task->data = data;
+    task->finished = false;
+    task->fence = 0;
+
+    // No workers: the render context is current, the task is done right away.
+    if (workers->threads.empty()) {
+        function(data);
+        task->finished = true;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(workers->mutex);
+    workers->queue.push_back(task);
+    workers->taskReady.notify_one();
+}
+
+bool glTaskPoll(GLWorkers* workers, GLTask* task) {
+    {
+        std::lock_guard<std::mutex> lock(workers->mutex);
+        if (!task->finished) {
+            return false;
+        }
+    }
+
+    if (task->fence) {
+        // Only check the fence, never wait for it.
+        GLenum result = glClientWaitSync((GLsync)task->fence, 0, 0);
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+            return false;
+        }
+        glDeleteSync((GLsync)task->fence);
+        task->fence = 0;
+    }
+    return true;
+}
+
+void glTaskWait(GLWorkers* workers, GLTask* task) {
+    {
+        std::unique_lock<std::mutex> lock(workers->mutex);
+        workers->taskFinished.wait(lock, [task] { return task->finished; });
+    }
+
+    if (task->fence) {
+        /* Server side wait: the CPU continues, the GPU orders the commands. */
+        glWaitSync((GLsync)task->fence, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync((GLsync)task->fence);
+        task->fence = 0;
+    }
+}
@@ -0,0 +1,117 @@
+/**
+ * GL worker threads with shared EGL contexts.
+ *
+ * Every worker thread owns an EGL context created with the demo's context as
+ * the share context, so the buffers, textures, shaders and programs created
+ * on a worker are usable on the render thread. A task runs on a worker, then
+ * the worker inserts a fence (and flushes it). The render thread polls the
+ * task or waits for it: the wait returns after the task function finished on
+ * the CPU and queues a glWaitSync for the fence, so the render context only
+ * uses the objects after the worker's GL commands are done.
+ *
+ * Container objects (VAOs, FBOs) are not shared between contexts: create them
+ * on the render thread from the shared buffers/textures.
+ *
+ * Without shared contexts (or with 0 workers) the tasks run right away in
+ * glWorkersSubmit on the calling thread.
+ *
+ * Usage:
+ *
+ *   GLWorkers workers;
+ *   initGLWorkers(&workers, 4);      // requires the current render context
+ *   GLTask task;
+ *   glWorkersSubmit(&workers, &task, createResource, &data); // createResource(&data) on a worker
+ *   ...
+ *   glTaskWait(&task);               // or glTaskPoll(&task) every frame
+ *   destroyGLWorkers(&workers);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *  * EGL (EGL_KHR_surfaceless_context or pbuffer support)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_GL_WORKERS_H
+#define GLES_COMMON_GL_WORKERS_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// An EGL context sharing the objects of the render context (EGLDisplay, EGLContext, EGLSurface).
+struct SharedContext {
+    void* display;
+    void* context;
+    void* surface; // EGL_NO_SURFACE with EGL_KHR_surfaceless_context, otherwise a 1x1 pbuffer
+};
+
+// Create a context sharing the objects of the current context of the calling thread.
+/* Returns false if the current context is not an EGL context or the creation failed. */
+bool createSharedContext(SharedContext* shared);
+
+// Make the shared context current on the calling thread (NULL: release the current context).
+bool makeSharedContextCurrent(const SharedContext* shared);
+
+void destroySharedContext(SharedContext* shared);
+
+typedef void (*GLTaskFunction)(void* data);
+
+struct GLTask {
+    GLTaskFunction function;
+    void* data;
+
+    // Set by the worker after the fence is flushed (guarded by the GLWorkers mutex).
+    bool finished;
+    void* fence; // GLsync, 0 if the task ran on the render thread
+};
+
+struct GLWorkers {
+    std::vector<SharedContext> contexts;
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable taskReady;
+    std::condition_variable taskFinished;
+    std::deque<GLTask*> queue;
+    bool stopping;
+};
+
+// Start "workerCount" threads, each with its own shared context. Returns the number of started workers.
+/* Requires a current GL ES context on the calling (render) thread. */
+int initGLWorkers(GLWorkers* workers, int workerCount);
+
+// Stop the threads after the queued tasks are done.
+void destroyGLWorkers(GLWorkers* workers);
+
+// Queue function(data) for a worker (the task must stay alive until it's waited for).
+void glWorkersSubmit(GLWorkers* workers, GLTask* task, GLTaskFunction function, void* data);
+
+// Returns true if the task and its GL commands are finished, never blocks (render thread only).
+bool glTaskPoll(GLWorkers* workers, GLTask* task);
+
+// Wait for the task on the CPU and make the render context wait for its GL commands (render thread only).
+void glTaskWait(GLWorkers* workers, GLTask* task);
+
+#endif // GLES_COMMON_GL_WORKERS_H
@@ -0,0 +1,298 @@
+/**
+ * GPU memory accounting. See gpu_memory.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/gpu_memory.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+// Alignment of the uncompressed images (pixels), the usual tile/superblock size.
+static const int tileAlignment = 16;
+
+const char* gpuMemoryCategoryNames[GPU_MEMORY_CATEGORY_COUNT] = {
+    "vertex", "storage", "stream", "transfer", "texture", "render target"
+};
+
+enum GpuObjectType {
+    GPU_OBJECT_BUFFER,
+    GPU_OBJECT_TEXTURE,
+    GPU_OBJECT_RENDERBUFFER,
+};
+
+struct GpuAllocation {
+    GpuMemoryCategory category;
+    size_t bytes;
+    const char* label;
+};
+
+struct GpuMemory {
+    std::mutex mutex;
+    std::unordered_map<uint64_t, GpuAllocation> objects;
+    GpuMemoryTotals totals;
+    size_t budget;
+    bool overBudget;
+};
+
+static GpuMemory& gpuMemory() {
+    static GpuMemory memory;
+    return memory;
+}
+
+static uint64_t objectKey(GpuObjectType type, unsigned int object) {
+    return ((uint64_t)type << 32) | object;
+}
+
+// Storage bytes per pixel of the uncompressed formats, the 3 component formats padded (0: unknown).
+static int pixelBytes(unsigned int format) {
+    switch (format) {
+    case GL_R8: case GL_R8I: case GL_R8UI: case GL_R8_SNORM: case GL_STENCIL_INDEX8:
+    case GL_LUMINANCE: case GL_ALPHA:
+        return 1;
+    case GL_RG8: case GL_RG8I: case GL_RG8UI: case GL_RG8_SNORM: case GL_R16F: case GL_R16I: case GL_R16UI:
+    case GL_RGB565: case GL_RGBA4: case GL_RGB5_A1: case GL_DEPTH_COMPONENT16: case GL_LUMINANCE_ALPHA:
+        return 2;
+    case GL_RGBA8: case GL_RGBA8I: case GL_RGBA8UI: case GL_RGBA8_SNORM: case GL_SRGB8_ALPHA8: case GL_RGB10_A2:
+    case GL_RGB10_A2UI: case GL_R11F_G11F_B10F: case GL_RGB9_E5: case GL_RG16F: case GL_RG16I: case GL_RG16UI:
+    case GL_R32F: case GL_R32I: case GL_R32UI: case GL_DEPTH_COMPONENT24: case GL_DEPTH_COMPONENT32F:
+    case GL_DEPTH24_STENCIL8: case GL_BGRA8_EXT: case GL_RGBA: case GL_BGRA_EXT:
+    // RGB8 and friends: stored as RGBX.
+    case GL_RGB8: case GL_RGB8I: case GL_RGB8UI: case GL_RGB8_SNORM: case GL_SRGB8: case GL_RGB:
+        return 4;
+    case GL_RGBA16F: case GL_RGBA16I: case GL_RGBA16UI: case GL_RG32F: case GL_RG32I: case GL_RG32UI:
+    case GL_DEPTH32F_STENCIL8: case GL_RGB16F: case GL_RGB16I: case GL_RGB16UI:
+        return 8;
+    case GL_RGBA32F: case GL_RGBA32I: case GL_RGBA32UI: case GL_RGB32F: case GL_RGB32I: case GL_RGB32UI:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+// Block size (pixels) and bytes of the compressed formats, false for an uncompressed format.
+static bool compressedBlock(unsigned int format, int* blockWidth, int* blockHeight, int* blockBytes) {
+    static const int astcBlocks[14][2] = {
+        { 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 },
+        { 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 },
+    };
+
+    switch (format) {
+    case GL_COMPRESSED_RGB8_ETC2: case GL_COMPRESSED_SRGB8_ETC2: case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+    case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2: case GL_COMPRESSED_R11_EAC: case GL_COMPRESSED_SIGNED_R11_EAC:
+        *blockWidth = *blockHeight = 4;
+        *blockBytes = 8;
+        return true;
+    case GL_COMPRESSED_RGBA8_ETC2_EAC: case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC: case GL_COMPRESSED_RG11_EAC:
+    case GL_COMPRESSED_SIGNED_RG11_EAC:
+        *blockWidth = *blockHeight = 4;
+        *blockBytes = 16;
+        return true;
+    default:
+        break;
+    }
+
+    int astc = -1;
+    if (format >= GL_COMPRESSED_RGBA_ASTC_4x4_KHR && format <= GL_COMPRESSED_RGBA_ASTC_12x12_KHR) {
+        astc = (int)(format - GL_COMPRESSED_RGBA_ASTC_4x4_KHR);
+    } else if (format >= GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR && format <= GL_COMPRESSED_SRGB8_ALPHA8_ASTC_12x12_KHR) {
+        astc = (int)(format - GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR);
+    }
+    if (astc < 0) {
+        return false;
+    }
+    *blockWidth = astcBlocks[astc][0];
+    *blockHeight = astcBlocks[astc][1];
+    *blockBytes = 16;
+    return true;
+}
+
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+size_t gpuMemoryImageBytes(unsigned int internalFormat, int width, int height, int depth, int levels, int samples) {
+    int blockWidth;
+    int blockHeight;
+    int blockBytes;
+    bool compressed = compressedBlock(internalFormat, &blockWidth, &blockHeight, &blockBytes);
+    if (!compressed) {
+        blockWidth = blockHeight = 1;
+        blockBytes = pixelBytes(internalFormat);
+        if (blockBytes == 0) {
+            printf("GPU memory: unknown format 0x%x, counted as 4 bytes per pixel\n", internalFormat);
+            blockBytes = 4;
+        }
+    }
+
+    size_t bytes = 0;
+    for (int level = 0; level < std::max(levels, 1); level++) {
+        size_t levelWidth = std::max(width >> level, 1);
+        size_t levelHeight = std::max(height >> level, 1);
+        if (compressed) {
+            levelWidth = (levelWidth + blockWidth - 1) / blockWidth;
+            levelHeight = (levelHeight + blockHeight - 1) / blockHeight;
+        } else {
+            levelWidth = alignUp(levelWidth, tileAlignment);
+            levelHeight = alignUp(levelHeight, tileAlignment);
+        }
+        bytes += levelWidth * levelHeight * blockBytes;
+    }
+    return bytes * std::max(depth, 1) * std::max(samples, 1);
+}
+
+static void track(GpuObjectType type, unsigned int object, size_t bytes, GpuMemoryCategory category, const char* label) {
+    if (object == 0) {
+        return;
+    }
+
+    GpuMemory& memory = gpuMemory();
+    std::lock_guard<std::mutex> lock(memory.mutex);
+    GpuMemoryTotals& totals = memory.totals;
+
+    // 1. Replace the earlier storage of the object.
+    GpuAllocation& allocation = memory.objects[objectKey(type, object)];
+    if (allocation.label != NULL) {
+        totals.live[allocation.category] -= allocation.bytes;
+        totals.liveTotal -= allocation.bytes;
+    } else {
+        totals.objects++;
+    }
+    allocation.category = category;
+    allocation.bytes = bytes;
+    allocation.label = label ? label : "unnamed";
+
+    // 2. The new totals and peaks.
+    totals.live[category] += bytes;
+    totals.liveTotal += bytes;
+    totals.peak[category] = std::max(totals.peak[category], totals.live[category]);
+    totals.peakTotal = std::max(totals.peakTotal, totals.liveTotal);
+
+    // 3. Warn once every time the live total grows above the budget.
+    if (memory.budget > 0 && totals.liveTotal > memory.budget && !memory.overBudget) {
+        printf("GPU memory: over the budget of %.1f MB: %.1f MB live after '%s' (%.1f MB %s)\n",
+               memory.budget / 1048576.0, totals.liveTotal / 1048576.0, allocation.label, bytes / 1048576.0,
+               gpuMemoryCategoryNames[category]);
+        memory.overBudget = true;
+    }
+}
+
+static void release(GpuObjectType type, int count, const unsigned int* objects) {
+    GpuMemory& memory = gpuMemory();
+    std::lock_guard<std::mutex> lock(memory.mutex);
+    for (int idx = 0; idx < count; idx++) {
+        auto found = memory.objects.find(objectKey(type, objects[idx]));
+        if (found == memory.objects.end()) {
+            continue;
+        }
+
+        memory.totals.live[found->second.category] -= found->second.bytes;
+        memory.totals.liveTotal -= found->second.bytes;
+        memory.totals.objects--;
+        memory.objects.erase(found);
+    }
+
+    if (memory.totals.liveTotal <= memory.budget) {
+        memory.overBudget = false;
+    }
+}
+
+void gpuMemoryTrackBuffer(unsigned int buffer, size_t bytes, GpuMemoryCategory category, const char* label) {
+    track(GPU_OBJECT_BUFFER, buffer, bytes, category, label);
+}
+
+void gpuMemoryTrackTexture(unsigned int texture, unsigned int internalFormat, int width, int height, int depth,
+                           int levels, GpuMemoryCategory category, const char* label) {
+    track(GPU_OBJECT_TEXTURE, texture, gpuMemoryImageBytes(internalFormat, width, height, depth, levels, 1), category,
+          label);
+}
+
+void gpuMemoryTrackRenderbuffer(unsigned int renderbuffer, unsigned int internalFormat, int width, int height,
+                                int samples, const char* label) {
+    track(GPU_OBJECT_RENDERBUFFER, renderbuffer, gpuMemoryImageBytes(internalFormat, width, height, 1, 1, samples),
+          GPU_MEMORY_RENDER_TARGET, label);
+}
+
+void gpuMemoryReleaseBuffers(int count, const unsigned int* buffers) {
+    release(GPU_OBJECT_BUFFER, count, buffers);
+}
+
+void gpuMemoryReleaseTextures(int count, const unsigned int* textures) {
+    release(GPU_OBJECT_TEXTURE, count, textures);
+}
+
+void gpuMemoryReleaseRenderbuffers(int count, const unsigned int* renderbuffers) {
+    release(GPU_OBJECT_RENDERBUFFER, count, renderbuffers);
+}
+
+void gpuMemoryGetTotals(GpuMemoryTotals* totals) {
+    GpuMemory& memory = gpuMemory();
+    std::lock_guard<std::mutex> lock(memory.mutex);
+    *totals = memory.totals;
+}
+
+void gpuMemorySetBudget(size_t bytes) {
+    GpuMemory& memory = gpuMemory();
+    std::lock_guard<std::mutex> lock(memory.mutex);
+    memory.budget = bytes;
+    memory.overBudget = false;
+}
+
+void gpuMemoryPrint(int maxObjects) {
+    GpuMemory& memory = gpuMemory();
+    std::lock_guard<std::mutex> lock(memory.mutex);
+    const GpuMemoryTotals& totals = memory.totals;
+
+    printf("GPU memory (estimated, MB):\n");
+    printf("  %-14s %10s %10s\n", "", "live", "peak");
+    for (int idx = 0; idx < GPU_MEMORY_CATEGORY_COUNT; idx++) {
+        printf("  %-14s %10.2f %10.2f\n", gpuMemoryCategoryNames[idx], totals.live[idx] / 1048576.0,
+               totals.peak[idx] / 1048576.0);
+    }
+    printf("  %-14s %10.2f %10.2f (%d objects)\n", "total", totals.liveTotal / 1048576.0, totals.peakTotal / 1048576.0,
+           totals.objects);
+    if (memory.budget > 0) {
+        printf("  budget %.1f MB: peak at %.0f%%\n", memory.budget / 1048576.0,
+               totals.peakTotal * 100.0 / memory.budget);
+    }
+
+    // The largest live objects.
+    std::vector<const GpuAllocation*> largest;
+    for (const auto& entry : memory.objects) {
+        largest.push_back(&entry.second);
+    }
+    std::sort(largest.begin(), largest.end(),
+              [](const GpuAllocation* a, const GpuAllocation* b) { return a->bytes > b->bytes; });
+    for (size_t idx = 0; idx < largest.size() && (int)idx < maxObjects; idx++) {
+        printf("  %10.2f  %-14s %s\n", largest[idx]->bytes / 1048576.0, gpuMemoryCategoryNames[largest[idx]->category],
+               largest[idx]->label);
+    }
+}
@@ -0,0 +1,99 @@
+/**
+ * GPU memory accounting of the buffers, textures and renderbuffers.
+ *
+ * The resource helpers of the shared library (render target pool, G-buffer,
+ * shadow maps, mesh uploads, compute buffers, stream buffers, texture loaders,
+ * the headless framebuffer, ...) register the size of every object they
+ * allocate and release it when the object is deleted. The totals are kept
+ * per category: the live and the peak bytes.
+ *
+ * The sizes are estimates of the driver allocation, not the requested data:
+ *  * 3 component formats are padded to 4 components (RGB8 -> 4 bytes,
+ *    RGB16F -> 8, RGB32F -> 16), the 24 bit depth formats take 4 bytes,
+ *  * the uncompressed images are aligned to 16x16 pixel tiles (the block
+ *    layout of AFBC, UBWC and the tiled formats of most mobile drivers),
+ *    RGB565 keeps its 2 bytes per pixel,
+ *  * the compressed formats (ETC2/EAC, ASTC) are counted in whole blocks,
+ *  * every mip level and multisample sample counts.
+ *
+ * Demo context options:
+ *  --gpu-memory             Print the totals per category and the largest objects at exit.
+ *  --gpu-memory-budget MB   Warn whenever the live total grows above the budget (ex.: 512 MB
+ *                           shared memory boards), also prints the report at exit.
+ *
+ * The accounting is always on (a map update per allocation), the API gives
+ * the totals to the demos (ex.: an overlay). Thread safe: the GL worker
+ * contexts allocate too.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_GPU_MEMORY_H
+#define GLES_COMMON_GPU_MEMORY_H
+
+#include <stddef.h>
+
+enum GpuMemoryCategory {
+    GPU_MEMORY_VERTEX,        // vertex and index buffers
+    GPU_MEMORY_STORAGE,       // shader storage and indirect buffers
+    GPU_MEMORY_STREAM,        // uniform and streaming rings
+    GPU_MEMORY_TRANSFER,      // pixel pack/unpack buffers
+    GPU_MEMORY_TEXTURE,       // sampled textures
+    GPU_MEMORY_RENDER_TARGET, // renderbuffers and render target textures
+    GPU_MEMORY_CATEGORY_COUNT,
+};
+
+// "vertex", "storage", "stream", "transfer", "texture", "render target".
+extern const char* gpuMemoryCategoryNames[GPU_MEMORY_CATEGORY_COUNT];
+
+struct GpuMemoryTotals {
+    size_t live[GPU_MEMORY_CATEGORY_COUNT];
+    size_t peak[GPU_MEMORY_CATEGORY_COUNT];
+    size_t liveTotal;
+    size_t peakTotal; // peak of the sum (not the sum of the category peaks)
+    int objects;
+};
+
+// Estimated allocation size of an image: every level of width x height x depth with "samples" samples.
+size_t gpuMemoryImageBytes(unsigned int internalFormat, int width, int height, int depth, int levels, int samples);
+
+// Account the (re)allocated storage of an object, it replaces the earlier size of the object.
+/* The label must be a string literal (or outlive the object). */
+void gpuMemoryTrackBuffer(unsigned int buffer, size_t bytes, GpuMemoryCategory category, const char* label);
+void gpuMemoryTrackTexture(unsigned int texture, unsigned int internalFormat, int width, int height, int depth,
+                           int levels, GpuMemoryCategory category, const char* label);
+void gpuMemoryTrackRenderbuffer(unsigned int renderbuffer, unsigned int internalFormat, int width, int height,
+                                int samples, const char* label);
+
+// The objects are deleted (call with the glDelete* arguments, unknown names are ignored).
+void gpuMemoryReleaseBuffers(int count, const unsigned int* buffers);
+void gpuMemoryReleaseTextures(int count, const unsigned int* textures);
+void gpuMemoryReleaseRenderbuffers(int count, const unsigned int* renderbuffers);
+
+void gpuMemoryGetTotals(GpuMemoryTotals* totals);
+
+// Warn when the live total grows above "bytes" (0: no budget).
+void gpuMemorySetBudget(size_t bytes);
+
+// Print the live/peak totals per category and the "maxObjects" largest live objects.
+void gpuMemoryPrint(int maxObjects);
+
+#endif // GLES_COMMON_GPU_MEMORY_H
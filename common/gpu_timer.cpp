@@ -0,0 +1,343 @@
+/**
+ * GPU timer queries for per-pass timing (GL_EXT_disjoint_timer_query).
+ * See gpu_timer.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/gpu_timer.h"
+
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#include "common/perf_counters.h"
+#include "common/trace.h"
+
+static PFNGLGENQUERIESEXTPROC genQueries;
+static PFNGLDELETEQUERIESEXTPROC deleteQueries;
+static PFNGLBEGINQUERYEXTPROC beginQuery;
+static PFNGLENDQUERYEXTPROC endQuery;
+static PFNGLGETQUERYOBJECTUIVEXTPROC getQueryObjectuiv;
+static PFNGLGETQUERYOBJECTUI64VEXTPROC getQueryObjectui64v;
+
+// The first timer with queries: its pass times are shown by the HUD (hud.h).
+static std::atomic<GpuTimer*> activeTimer(nullptr);
+
+static void registerActiveTimer(GpuTimer* timer) {
+    GpuTimer* expected = nullptr;
+    activeTimer.compare_exchange_strong(expected, timer);
+}
+
+static double secondsNow() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static bool hasGLExtension(const char* name) {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int idx = 0; idx < count; idx++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, idx), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool loadTimerQueryEntryPoints() {
+    genQueries = (PFNGLGENQUERIESEXTPROC)eglGetProcAddress("glGenQueriesEXT");
+    deleteQueries = (PFNGLDELETEQUERIESEXTPROC)eglGetProcAddress("glDeleteQueriesEXT");
+    beginQuery = (PFNGLBEGINQUERYEXTPROC)eglGetProcAddress("glBeginQueryEXT");
+    endQuery = (PFNGLENDQUERYEXTPROC)eglGetProcAddress("glEndQueryEXT");
+    getQueryObjectuiv = (PFNGLGETQUERYOBJECTUIVEXTPROC)eglGetProcAddress("glGetQueryObjectuivEXT");
+    getQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VEXTPROC)eglGetProcAddress("glGetQueryObjectui64vEXT");
+
+    return genQueries && deleteQueries && beginQuery && endQuery && getQueryObjectuiv && getQueryObjectui64v;
+}
+
+static int findPass(const GpuTimer* timer, const char* name) {
+    for (size_t idx = 0; idx < timer->passes.size(); idx++) {
+        if (strcmp(timer->passes[idx].name, name) == 0) {
+            return (int)idx;
+        }
+    }
+    return -1;
+}
+
+void initGpuTimer(GpuTimer* timer, int argc, char** argv) {
+    timer->enabled = false;
+    timer->supported = false;
+    timer->printStats = false;
+    timer->overlay = false;
+    timer->csv = NULL;
+    timer->passes.clear();
+    timer->activePass = -1;
+    timer->frameIndex = 0;
+    timer->lastPrintTime = secondsNow();
+
+    const char* csvPath = NULL;
+    bool hud = false;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--gpu-timer") == 0) {
+            timer->printStats = true;
+        } else if (strcmp(argv[idx], "--gpu-timer-csv") == 0 && idx + 1 < argc) {
+            csvPath = argv[++idx];
+        } else if (strcmp(argv[idx], "--gpu-timer-overlay") == 0) {
+            timer->overlay = true;
+        } else if (strcmp(argv[idx], "--hud") == 0) {
+            hud = true;
+        }
+    }
+
+    timer->enabled = timer->printStats || timer->overlay || csvPath != NULL || hud;
+    if (!timer->enabled) {
+        return;
+    }
+
+    if (!hasGLExtension("GL_EXT_disjoint_timer_query") || !loadTimerQueryEntryPoints()) {
+        printf("GPU timer: GL_EXT_disjoint_timer_query is not supported\n");
+        return;
+    }
+    timer->supported = true;
+    registerActiveTimer(timer);
+
+    if (csvPath != NULL) {
+        timer->csv = fopen(csvPath, "w");
+        if (timer->csv == NULL) {
+            printf("GPU timer: unable to open '%s'\n", csvPath);
+        } else {
+            fprintf(timer->csv, "frame,pass,ms\n");
+        }
+    }
+
+    // Clear any pending disjoint state.
+    int disjoint;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+}
+
+bool gpuTimerEnableQueries(GpuTimer* timer) {
+    if (timer->supported) {
+        return true;
+    }
+
+    timer->enabled = true;
+    if (!hasGLExtension("GL_EXT_disjoint_timer_query") || !loadTimerQueryEntryPoints()) {
+        return false;
+    }
+    timer->supported = true;
+    registerActiveTimer(timer);
+
+    int disjoint;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    return true;
+}
+
+void destroyGpuTimer(GpuTimer* timer) {
+    GpuTimer* expected = timer;
+    activeTimer.compare_exchange_strong(expected, nullptr);
+
+    if (timer->supported) {
+        for (size_t idx = 0; idx < timer->passes.size(); idx++) {
+            deleteQueries(GPU_TIMER_RING_SIZE, timer->passes[idx].queries);
+        }
+    }
+    timer->passes.clear();
+
+    if (timer->csv != NULL) {
+        fclose(timer->csv);
+        timer->csv = NULL;
+    }
+}
+
+void gpuTimerBeginFrame(GpuTimer* timer) {
+    if (!timer->supported) {
+        return;
+    }
+
+    // 1. A disjoint event (ex.: power state change) invalidates the results in flight.
+    int disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+
+    // 2. Collect every result which is already available, never wait for one.
+    for (size_t passIdx = 0; passIdx < timer->passes.size(); passIdx++) {
+        GpuTimerPass& pass = timer->passes[passIdx];
+
+        for (int slot = 0; slot < GPU_TIMER_RING_SIZE; slot++) {
+            if (pass.queryFrame[slot] < 0) {
+                continue;
+            }
+
+            GLuint available = 0;
+            getQueryObjectuiv(pass.queries[slot], GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+            if (!available) {
+                continue;
+            }
+
+            GLuint64 elapsedNs = 0;
+            getQueryObjectui64v(pass.queries[slot], GL_QUERY_RESULT_EXT, &elapsedNs);
+
+            /* The first frame is a warm-up frame (lazy shader compilation, driver setup), skip it. */
+            if (!disjoint && pass.queryFrame[slot] > 0) {
+                pass.lastMs = elapsedNs / 1e6;
+                pass.sumMs += pass.lastMs;
+                pass.sampleCount++;
+
+                if (timer->csv != NULL) {
+                    fprintf(timer->csv, "%d,%s,%.6f\n", pass.queryFrame[slot], pass.name, pass.lastMs);
+                }
+            }
+
+            pass.queryFrame[slot] = -1;
+        }
+    }
+}
+
+void gpuTimerBegin(GpuTimer* timer, const char* name) {
+    /* The passes are also the GPU zones of the trace ("--trace") and the samples of the counters
+     * ("--perf-counters"), with or without the timer queries. */
+    traceBeginGpuZone(name);
+    perfCountersBeginPass(name);
+
+    if (!timer->supported) {
+        return;
+    }
+
+    if (timer->activePass >= 0) {
+        printf("GPU timer: '%s' started while '%s' is active (nesting is not supported)\n",
+               name, timer->passes[timer->activePass].name);
+        return;
+    }
+
+    int passIdx = findPass(timer, name);
+    if (passIdx < 0) {
+        GpuTimerPass pass;
+        pass.name = name;
+        genQueries(GPU_TIMER_RING_SIZE, pass.queries);
+        for (int slot = 0; slot < GPU_TIMER_RING_SIZE; slot++) {
+            pass.queryFrame[slot] = -1;
+        }
+        pass.lastMs = 0.0;
+        pass.sumMs = 0.0;
+        pass.sampleCount = 0;
+
+        timer->passes.push_back(pass);
+        passIdx = (int)timer->passes.size() - 1;
+    }
+
+    /* If the slot still has a pending (not yet available) result, it is dropped. */
+    GpuTimerPass& pass = timer->passes[passIdx];
+    int slot = timer->frameIndex % GPU_TIMER_RING_SIZE;
+    pass.queryFrame[slot] = timer->frameIndex;
+
+    beginQuery(GL_TIME_ELAPSED_EXT, pass.queries[slot]);
+    timer->activePass = passIdx;
+}
+
+void gpuTimerEnd(GpuTimer* timer) {
+    perfCountersEndPass();
+    traceEndGpuZone();
+
+    if (!timer->supported || timer->activePass < 0) {
+        return;
+    }
+
+    endQuery(GL_TIME_ELAPSED_EXT);
+    timer->activePass = -1;
+}
+
+void gpuTimerEndFrame(GpuTimer* timer) {
+    if (!timer->supported) {
+        return;
+    }
+
+    timer->frameIndex++;
+
+    double now = secondsNow();
+    if (!timer->printStats || now - timer->lastPrintTime < 1.0) {
+        return;
+    }
+
+    printf("GPU:");
+    for (size_t idx = 0; idx < timer->passes.size(); idx++) {
+        GpuTimerPass& pass = timer->passes[idx];
+        double avgMs = pass.sampleCount ? pass.sumMs / pass.sampleCount : 0.0;
+        printf(" %s %.3f ms%s", pass.name, avgMs, (idx + 1 < timer->passes.size()) ? " |" : "");
+
+        pass.sumMs = 0.0;
+        pass.sampleCount = 0;
+    }
+    printf("\n");
+
+    timer->lastPrintTime = now;
+}
+
+void gpuTimerDrawOverlay(GpuTimer* timer, int x, int y) {
+    if (!timer->supported || !timer->overlay) {
+        return;
+    }
+
+    static const float colors[][3] = {
+        { 1.0f, 0.2f, 0.2f },
+        { 0.2f, 1.0f, 0.2f },
+        { 0.2f, 0.4f, 1.0f },
+        { 1.0f, 1.0f, 0.2f },
+        { 1.0f, 0.2f, 1.0f },
+        { 0.2f, 1.0f, 1.0f },
+    };
+
+    GLboolean scissorEnabled = glIsEnabled(GL_SCISSOR_TEST);
+    int scissorBox[4];
+    float clearColor[4];
+    glGetIntegerv(GL_SCISSOR_BOX, scissorBox);
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+
+    glEnable(GL_SCISSOR_TEST);
+    for (size_t idx = 0; idx < timer->passes.size(); idx++) {
+        // 1 pixel for every 10 microseconds, at least 1 pixel to show that the pass exists.
+        int width = (int)(timer->passes[idx].lastMs * 100.0) + 1;
+        const float* color = colors[idx % (sizeof(colors) / sizeof(colors[0]))];
+
+        glScissor(x, y + (int)idx * 12, width, 8);
+        glClearColor(color[0], color[1], color[2], 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    glScissor(scissorBox[0], scissorBox[1], scissorBox[2], scissorBox[3]);
+    if (!scissorEnabled) {
+        glDisable(GL_SCISSOR_TEST);
+    }
+}
+
+const GpuTimer* gpuTimerActive() {
+    return activeTimer.load();
+}
+
+double gpuTimerLastMs(const GpuTimer* timer, const char* name) {
+    int passIdx = findPass(timer, name);
+    return passIdx < 0 ? 0.0 : timer->passes[passIdx].lastMs;
+}
@@ -0,0 +1,129 @@
+/**
+ * GPU timer queries for per-pass timing (GL_EXT_disjoint_timer_query).
+ *
+ * Each named pass has a ring of GL_TIME_ELAPSED_EXT query objects. The
+ * result of a query is only read back when the driver reports it as
+ * available, so measuring never stalls the CPU waiting for the GPU.
+ * Frames where the GPU reported a disjoint event and the first (warm-up)
+ * frame are dropped.
+ *
+ * Usage:
+ *
+ *   GpuTimer timer;
+ *   initGpuTimer(&timer, argc, argv);
+ *   while (...) {
+ *       gpuTimerBeginFrame(&timer);
+ *       {
+ *           GpuTimerScope scope(&timer, "pass name");
+ *           ... draw ...
+ *       }
+ *       gpuTimerEndFrame(&timer);
+ *   }
+ *   destroyGpuTimer(&timer);
+ *
+ * Timer queries can't be nested: only one pass can be measured at a time.
+ * With a trace ("--trace FILE", see trace.h) every pass is also a GPU zone of the timeline.
+ * With "--perf-counters" (see perf_counters.h) every pass is also sampled by the hardware counters.
+ *
+ * Command line options:
+ *  --gpu-timer              Print the average GPU time of the passes every second.
+ *  --gpu-timer-csv FILE     Write every sample as a "frame,pass,ms" CSV line.
+ *  --gpu-timer-overlay      Draw the pass times as bars onto the frame
+ *                           (one bar per pass, 1 pixel of width per 10 us).
+ *  --hud                    Measure the passes for the performance HUD (see hud.h).
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_GPU_TIMER_H
+#define GLES_COMMON_GPU_TIMER_H
+
+#include <stdio.h>
+
+#include <vector>
+
+// Number of in-flight queries per pass.
+/* The results are usually available 1-3 frames later. */
+#define GPU_TIMER_RING_SIZE 4
+
+struct GpuTimerPass {
+    const char* name;
+    unsigned int queries[GPU_TIMER_RING_SIZE];
+    int queryFrame[GPU_TIMER_RING_SIZE]; // frame index of the query, -1: no result pending
+
+    double lastMs;
+    double sumMs;
+    int sampleCount;
+};
+
+struct GpuTimer {
+    bool enabled;
+    bool supported;
+    bool printStats;
+    bool overlay;
+    FILE* csv;
+
+    std::vector<GpuTimerPass> passes;
+    int activePass;
+    int frameIndex;
+    double lastPrintTime;
+};
+
+// Parse the "--gpu-timer*" options and check for GL_EXT_disjoint_timer_query support.
+/* Requires a current GL ES context. Without the extension every call is a no-op. */
+void initGpuTimer(GpuTimer* timer, int argc, char** argv);
+
+// Enable the queries even if no "--gpu-timer*" option was given (ex.: for a feedback loop).
+/* Returns false if GL_EXT_disjoint_timer_query is not supported. */
+bool gpuTimerEnableQueries(GpuTimer* timer);
+
+void destroyGpuTimer(GpuTimer* timer);
+
+// Collect the available query results of the previous frames.
+void gpuTimerBeginFrame(GpuTimer* timer);
+
+// Start/stop measuring the named pass (the name must be a string literal or outlive the timer).
+void gpuTimerBegin(GpuTimer* timer, const char* name);
+void gpuTimerEnd(GpuTimer* timer);
+
+// Finish the frame: print statistics (if requested).
+void gpuTimerEndFrame(GpuTimer* timer);
+
+// Draw the last pass times as bars onto the current framebuffer starting at (x, y) (if requested).
+/* Uses scissored clears, the scissor state is restored afterwards. */
+void gpuTimerDrawOverlay(GpuTimer* timer, int x, int y);
+
+// Last measured GPU time of a pass in milliseconds (0 if not available).
+double gpuTimerLastMs(const GpuTimer* timer, const char* name);
+
+// The first timer which was initialized with queries and is not destroyed yet (NULL: none).
+/* The HUD of the demo context shows its last pass times. */
+const GpuTimer* gpuTimerActive();
+
+// Measure the enclosing scope as a pass.
+struct GpuTimerScope {
+    GpuTimerScope(GpuTimer* timer, const char* name) : m_timer(timer) { gpuTimerBegin(m_timer, name); }
+    ~GpuTimerScope() { gpuTimerEnd(m_timer); }
+
+    GpuTimer* m_timer;
+};
+
+#endif // GLES_COMMON_GPU_TIMER_H
@@ -0,0 +1,329 @@
+/**
+ * GPU occlusion culling with a Hi-Z pyramid. See hiz_culling.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/hiz_culling.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <GLES3/gl31.h>
+
+#include "common/gpu_memory.h"
+#include "common/program_cache.h"
+
+static const char* hiz_copy_src = R"(#version 310 es
+layout(local_size_x = 8, local_size_y = 8) in;
+
+uniform highp sampler2D depthImage;
+layout(r32f, binding = 0) writeonly uniform highp image2D dst;
+uniform ivec2 dstSize;
+
+void main() {
+    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(pos, dstSize))) {
+        return;
+    }
+    imageStore(dst, pos, vec4(texelFetch(depthImage, pos, 0).r));
+}
+)";
+
+static const char* hiz_downsample_src = R"(#version 310 es
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(r32f, binding = 0) readonly uniform highp image2D src;
+layout(r32f, binding = 1) writeonly uniform highp image2D dst;
+uniform ivec2 srcSize;
+uniform ivec2 dstSize;
+
+void main() {
+    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(pos, dstSize))) {
+        return;
+    }
+
+    // The last texel of an odd sized level also covers the extra row/column.
+    ivec2 count = ivec2(2);
+    if (pos.x == dstSize.x - 1 && (srcSize.x & 1) == 1) count.x = 3;
+    if (pos.y == dstSize.y - 1 && (srcSize.y & 1) == 1) count.y = 3;
+
+    float depth = 0.0;
+    for (int y = 0; y < count.y; y++) {
+        for (int x = 0; x < count.x; x++) {
+            ivec2 srcPos = min(pos * 2 + ivec2(x, y), srcSize - 1);
+            depth = max(depth, imageLoad(src, srcPos).r);
+        }
+    }
+    imageStore(dst, pos, vec4(depth));
+}
+)";
+
+static const char* hiz_cull_src = R"(#version 310 es
+layout(local_size_x = 64) in;
+
+layout(std430, binding = 0) readonly buffer Instances {
+    vec4 instances[];
+};
+
+layout(std430, binding = 1) writeonly buffer Visible {
+    vec4 visible[];
+};
+
+layout(std430, binding = 2) buffer Command {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint reserved;
+} command;
+
+uniform highp sampler2D hiz;
+uniform mat4 viewProjection;
+uniform uint totalInstances;
+uniform ivec2 hizSize;
+uniform int hizLevels;
+
+bool isVisible(vec4 instance) {
+    // 1. Project the corners of the bounding box.
+    vec3 ndcMin = vec3(1e30);
+    vec3 ndcMax = vec3(-1e30);
+    float halfSize = instance.w * 0.5;
+    for (int corner = 0; corner < 8; corner++) {
+        vec3 offset = vec3((corner & 1) != 0 ? 1.0 : -1.0, (corner & 2) != 0 ? 1.0 : -1.0, (corner & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = viewProjection * vec4(instance.xyz + offset * halfSize, 1.0);
+        if (clip.w <= 0.0) {
+            // Crosses the camera plane: can't be tested.
+            return true;
+        }
+        vec3 ndc = clip.xyz / clip.w;
+        ndcMin = min(ndcMin, ndc);
+        ndcMax = max(ndcMax, ndc);
+    }
+
+    // 2. Frustum test.
+    if (any(lessThan(ndcMax, vec3(-1.0))) || any(greaterThan(ndcMin.xy, vec2(1.0))) || ndcMin.z > 1.0) {
+        return false;
+    }
+
+    // 3. The pyramid level where the screen rectangle covers at most 2x2 texels.
+    vec2 uvMin = clamp(ndcMin.xy * 0.5 + 0.5, 0.0, 1.0);
+    vec2 uvMax = clamp(ndcMax.xy * 0.5 + 0.5, 0.0, 1.0);
+    ivec2 pixelMin = min(ivec2(uvMin * vec2(hizSize)), hizSize - 1);
+    ivec2 pixelMax = min(ivec2(uvMax * vec2(hizSize)), hizSize - 1);
+    ivec2 extent = pixelMax - pixelMin + 1;
+    int level = clamp(int(ceil(log2(float(max(extent.x, extent.y))))), 0, hizLevels - 1);
+
+    ivec2 levelSize = max(hizSize >> level, ivec2(1));
+    ivec2 texelMin = min(pixelMin >> level, levelSize - 1);
+    ivec2 texelMax = min(pixelMax >> level, levelSize - 1);
+
+    float farthest = 0.0;
+    for (int y = texelMin.y; y <= texelMax.y; y++) {
+        for (int x = texelMin.x; x <= texelMax.x; x++) {
+            farthest = max(farthest, texelFetch(hiz, ivec2(x, y), level).r);
+        }
+    }
+
+    // 4. Occluded if the nearest point of the box is behind everything in the rectangle.
+    float nearest = max(ndcMin.z, -1.0) * 0.5 + 0.5;
+    return nearest <= farthest;
+}
+
+void main() {
+    uint idx = gl_GlobalInvocationID.x;
+    if (idx >= totalInstances) {
+        return;
+    }
+
+    vec4 instance = instances[idx];
+    if (isVisible(instance)) {
+        uint slot = atomicAdd(command.instanceCount, 1u);
+        visible[slot] = instance;
+    }
+}
+)";
+
+struct DrawElementsIndirectCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t reserved;
+};
+
+static int levelCount(int width, int height) {
+    int levels = 1;
+    for (int size = width > height ? width : height; size > 1; size >>= 1) {
+        levels++;
+    }
+    return levels;
+}
+
+void initHiZCuller(HiZCuller* culler, const float* instances, int instanceCount, int indexCount) {
+    culler->copyProgram = createCachedComputeProgram(hiz_copy_src);
+    culler->downsampleProgram = createCachedComputeProgram(hiz_downsample_src);
+    culler->cullProgram = createCachedComputeProgram(hiz_cull_src);
+
+    glUseProgram(culler->copyProgram);
+    glUniform1i(glGetUniformLocation(culler->copyProgram, "depthImage"), HIZ_TEXTURE_UNIT);
+    glUseProgram(culler->cullProgram);
+    glUniform1i(glGetUniformLocation(culler->cullProgram, "hiz"), HIZ_TEXTURE_UNIT);
+    glUseProgram(0);
+
+    culler->hizTexture = 0;
+    culler->width = 0;
+    culler->height = 0;
+    culler->levels = 0;
+    culler->instanceCount = instanceCount;
+
+    GLsizeiptr instancesSize = (GLsizeiptr)instanceCount * 4 * sizeof(float);
+
+    glGenBuffers(1, &culler->instanceBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, culler->instanceBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instancesSize, instances, GL_STATIC_DRAW);
+    gpuMemoryTrackBuffer(culler->instanceBuffer, instancesSize, GPU_MEMORY_STORAGE, "Hi-Z instances");
+
+    glGenBuffers(1, &culler->visibleBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, culler->visibleBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instancesSize, NULL, GL_DYNAMIC_COPY);
+    gpuMemoryTrackBuffer(culler->visibleBuffer, instancesSize, GPU_MEMORY_STORAGE, "Hi-Z visible instances");
+
+    DrawElementsIndirectCommand command = { (uint32_t)indexCount, 0, 0, 0, 0 };
+    glGenBuffers(1, &culler->commandBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, culler->commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(command), &command, GL_DYNAMIC_DRAW);
+    gpuMemoryTrackBuffer(culler->commandBuffer, sizeof(command), GPU_MEMORY_STORAGE, "Hi-Z indirect command");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void destroyHiZCuller(HiZCuller* culler) {
+    glDeleteProgram(culler->copyProgram);
+    glDeleteProgram(culler->downsampleProgram);
+    glDeleteProgram(culler->cullProgram);
+    if (culler->hizTexture != 0) {
+        glDeleteTextures(1, &culler->hizTexture);
+        gpuMemoryReleaseTextures(1, &culler->hizTexture);
+    }
+    unsigned int buffers[] = { culler->instanceBuffer, culler->visibleBuffer, culler->commandBuffer };
+    glDeleteBuffers(3, buffers);
+    gpuMemoryReleaseBuffers(3, buffers);
+}
+
+void hizBuild(HiZCuller* culler, unsigned int depthTexture, int width, int height) {
+    // 1. (Re)create the pyramid for the depth size.
+    if (culler->hizTexture == 0 || culler->width != width || culler->height != height) {
+        if (culler->hizTexture != 0) {
+            glDeleteTextures(1, &culler->hizTexture);
+            gpuMemoryReleaseTextures(1, &culler->hizTexture);
+        }
+
+        culler->width = width;
+        culler->height = height;
+        culler->levels = levelCount(width, height);
+
+        glGenTextures(1, &culler->hizTexture);
+        glBindTexture(GL_TEXTURE_2D, culler->hizTexture);
+        glTexStorage2D(GL_TEXTURE_2D, culler->levels, GL_R32F, width, height);
+        gpuMemoryTrackTexture(culler->hizTexture, GL_R32F, width, height, 1, culler->levels, GPU_MEMORY_RENDER_TARGET,
+                              "Hi-Z pyramid");
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    glActiveTexture(GL_TEXTURE0 + HIZ_TEXTURE_UNIT);
+
+    // 2. Level 0: copy of the depth texture (rendering before the dispatch is ordered by the GL).
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glUseProgram(culler->copyProgram);
+    glUniform2i(glGetUniformLocation(culler->copyProgram, "dstSize"), width, height);
+    glBindImageTexture(0, culler->hizTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+
+    // 3. Every other level from the previous one.
+    glUseProgram(culler->downsampleProgram);
+    int srcLoc = glGetUniformLocation(culler->downsampleProgram, "srcSize");
+    int dstLoc = glGetUniformLocation(culler->downsampleProgram, "dstSize");
+    int srcWidth = width;
+    int srcHeight = height;
+    for (int level = 1; level < culler->levels; level++) {
+        int dstWidth = srcWidth > 1 ? srcWidth / 2 : 1;
+        int dstHeight = srcHeight > 1 ? srcHeight / 2 : 1;
+
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        glUniform2i(srcLoc, srcWidth, srcHeight);
+        glUniform2i(dstLoc, dstWidth, dstHeight);
+        glBindImageTexture(0, culler->hizTexture, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(1, culler->hizTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((dstWidth + 7) / 8, (dstHeight + 7) / 8, 1);
+
+        srcWidth = dstWidth;
+        srcHeight = dstHeight;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, culler->hizTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glUseProgram(0);
+
+    // 4. The cull pass reads the pyramid with texelFetch.
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void hizCull(HiZCuller* culler, const float* viewProjection) {
+    // 1. Reset the instance counter of the indirect command.
+    uint32_t zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, culler->commandBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, offsetof(DrawElementsIndirectCommand, instanceCount), sizeof(zero), &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // 2. Test every instance.
+    glUseProgram(culler->cullProgram);
+    glUniformMatrix4fv(glGetUniformLocation(culler->cullProgram, "viewProjection"), 1, GL_FALSE, viewProjection);
+    glUniform1ui(glGetUniformLocation(culler->cullProgram, "totalInstances"), (GLuint)culler->instanceCount);
+    glUniform2i(glGetUniformLocation(culler->cullProgram, "hizSize"), culler->width, culler->height);
+    glUniform1i(glGetUniformLocation(culler->cullProgram, "hizLevels"), culler->levels);
+
+    glActiveTexture(GL_TEXTURE0 + HIZ_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, culler->hizTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, culler->instanceBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, culler->visibleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, culler->commandBuffer);
+    glDispatchCompute((culler->instanceCount + 63) / 64, 1, 1);
+    glUseProgram(0);
+
+    // 3. The draw reads the compacted instances as vertex attributes and the command.
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
+
+int hizVisibleCount(HiZCuller* culler) {
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, culler->commandBuffer);
+    const DrawElementsIndirectCommand* command = (const DrawElementsIndirectCommand*)glMapBufferRange(
+        GL_SHADER_STORAGE_BUFFER, 0, sizeof(DrawElementsIndirectCommand), GL_MAP_READ_BIT);
+    int count = command != NULL ? (int)command->instanceCount : -1;
+    glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return count;
+}
@@ -0,0 +1,93 @@
+/**
+ * GPU occlusion culling of instances against a hierarchical depth (Hi-Z) pyramid.
+ *
+ * 1. hizBuild: a compute pass copies the depth texture into level 0 of an R32F
+ *    mip chain, then every level is the max (farthest) depth of 2x2 texels of
+ *    the previous one (3x3 at the odd edges, so the pyramid stays conservative).
+ * 2. hizCull: a compute pass projects the bounding box of every instance, picks
+ *    the level where the box covers at most 2x2 texels and compares the nearest
+ *    depth of the box with the farthest depth of those texels. The visible
+ *    instances are appended (atomic counter) to a compacted buffer and the
+ *    counter is the instanceCount of a glDrawElementsIndirect command.
+ *
+ * The CPU never reads the visibility results: the draw uses the indirect
+ * command buffer written by the GPU.
+ *
+ * The instances are vec4 values: xyz: center, w: size of the cube (the box
+ * extends w / 2 in every direction).
+ *
+ * Usage:
+ *
+ *   HiZCuller culler;
+ *   initHiZCuller(&culler, instances, count, mesh.indexCount);
+ *   ... bind culler.visibleBuffer as the (divisor 1) instance attribute ...
+ *   while (...) {
+ *       ... draw the occluders into the FBO with the depth texture ...
+ *       hizBuild(&culler, depthTexture, width, height);
+ *       hizCull(&culler, viewProjection);
+ *       glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culler.commandBuffer);
+ *       glDrawElementsIndirect(GL_TRIANGLES, indexType, NULL);
+ *   }
+ *   destroyHiZCuller(&culler);
+ *
+ * Dependencies:
+ *  * Open GL ES 3.1+ (compute shaders, indirect draws)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_HIZ_CULLING_H
+#define GLES_COMMON_HIZ_CULLING_H
+
+// Texture unit used by the Hi-Z passes for the depth texture and the pyramid.
+#define HIZ_TEXTURE_UNIT 7
+
+struct HiZCuller {
+    unsigned int copyProgram;
+    unsigned int downsampleProgram;
+    unsigned int cullProgram;
+
+    // R32F pyramid (recreated if the depth texture size changes).
+    unsigned int hizTexture;
+    int width;
+    int height;
+    int levels;
+
+    unsigned int instanceBuffer; // all instances (vec4)
+    unsigned int visibleBuffer;  // compacted visible instances (vec4)
+    unsigned int commandBuffer;  // DrawElementsIndirectCommand
+    int instanceCount;
+};
+
+void initHiZCuller(HiZCuller* culler, const float* instances, int instanceCount, int indexCount);
+
+void destroyHiZCuller(HiZCuller* culler);
+
+// Build the pyramid from the depth texture (width x height), the depth must be already rendered.
+void hizBuild(HiZCuller* culler, unsigned int depthTexture, int width, int height);
+
+// Cull the instances with the column major view-projection matrix, fill the visible buffer and the command.
+void hizCull(HiZCuller* culler, const float* viewProjection);
+
+// Number of visible instances of the last hizCull (reads the command buffer back: stalls, only for statistics).
+int hizVisibleCount(HiZCuller* culler);
+
+#endif // GLES_COMMON_HIZ_CULLING_H
@@ -0,0 +1,460 @@
+/**
+ * Performance HUD. See hud.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/hud.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include <GLES3/gl3.h>
+
+#include "common/gl_state.h"
+#include "common/gpu_memory.h"
+#include "common/gpu_timer.h"
+#include "common/program_cache.h"
+
+#define NK_INCLUDE_FIXED_TYPES
+#define NK_INCLUDE_DEFAULT_ALLOCATOR
+#define NK_INCLUDE_VERTEX_BUFFER_OUTPUT
+#define NK_INCLUDE_FONT_BAKING
+#define NK_INCLUDE_DEFAULT_FONT
+#define NK_IMPLEMENTATION
+#include "thirdparty/glfw/deps/nuklear.h"
+
+static const char* hud_vertex_src = R"(#version 300 es
+layout(location = 0) in vec2 aPos;
+layout(location = 1) in vec2 aTexCoord;
+layout(location = 2) in vec4 aColor;
+
+uniform vec2 uScale;
+
+out vec2 vTexCoord;
+out vec4 vColor;
+
+void main() {
+    vTexCoord = aTexCoord;
+    vColor = aColor;
+    gl_Position = vec4(aPos * uScale + vec2(-1.0, 1.0), 0.0, 1.0);
+}
+)";
+
+static const char* hud_fragment_src = R"(#version 300 es
+precision mediump float;
+
+in vec2 vTexCoord;
+in vec4 vColor;
+
+uniform sampler2D uFont;
+
+out vec4 outColor;
+
+void main() {
+    outColor = vec4(vColor.rgb, vColor.a * texture(uFont, vTexCoord).r);
+}
+)";
+
+static const int hudWidth = 300;
+static const int rowHeight = 16;
+static const int graphHeight = 48;
+static const int maxCounters = 8;
+static const int bufferSize = 128 * 1024;
+static const int vertexBytes = 96 * 1024; // the rest of the buffer: the indices
+
+struct HudVertex {
+    float position[2];
+    float texCoord[2];
+    uint8_t color[4];
+};
+
+struct HudCounter {
+    const char* name;
+    double value;
+};
+
+struct Hud {
+    nk_context context;
+    nk_font_atlas atlas;
+    nk_draw_null_texture nullTexture;
+    nk_buffer commands;
+
+    unsigned int program;
+    int scaleLoc;
+    unsigned int fontTexture;
+    unsigned int vao;
+    unsigned int buffer; // the vertices, then the indices from "vertexBytes"
+    std::vector<uint8_t> staging;
+
+    std::chrono::steady_clock::time_point lastDraw;
+    float frameMs[HUD_HISTORY];
+    int frameCount;
+    int lastIssued;  // state cache counters at the previous draw
+    int lastSkipped;
+
+    HudCounter counters[maxCounters];
+    int counterCount;
+
+    double costMs;    // CPU time of the last draw
+    double sumCostMs;
+};
+
+static std::atomic<Hud*> activeHud(nullptr);
+
+static double elapsedMs(std::chrono::steady_clock::time_point since) {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now() - since).count();
+}
+
+Hud* createHud() {
+    Hud* hud = new Hud();
+
+    // 1. The font atlas: the default font baked into a single channel texture.
+    nk_font_atlas_init_default(&hud->atlas);
+    nk_font_atlas_begin(&hud->atlas);
+    nk_font* font = nk_font_atlas_add_default(&hud->atlas, 13.0f, NULL);
+    int atlasWidth = 0;
+    int atlasHeight = 0;
+    const void* pixels = nk_font_atlas_bake(&hud->atlas, &atlasWidth, &atlasHeight, NK_FONT_ATLAS_ALPHA8);
+
+    glGenTextures(1, &hud->fontTexture);
+    glBindTexture(GL_TEXTURE_2D, hud->fontTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8, atlasWidth, atlasHeight);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, atlasWidth, atlasHeight, GL_RED, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    gpuMemoryTrackTexture(hud->fontTexture, GL_R8, atlasWidth, atlasHeight, 1, 1, GPU_MEMORY_TEXTURE, "HUD font");
+
+    nk_font_atlas_end(&hud->atlas, nk_handle_id((int)hud->fontTexture), &hud->nullTexture);
+    nk_init_default(&hud->context, &font->handle);
+    nk_buffer_init_default(&hud->commands);
+
+    // 2. An opaque window: the HUD pixels never depend on the older frames (partial redraw).
+    hud->context.style.window.fixed_background = nk_style_item_color(nk_rgba(24, 24, 24, 255));
+    hud->context.style.window.padding = nk_vec2(6, 4);
+    hud->context.style.window.spacing = nk_vec2(4, 0);
+
+    // 3. The program, the buffer of the vertices and indices, and the VAO.
+    hud->program = createCachedProgram(hud_vertex_src, hud_fragment_src);
+    hud->scaleLoc = glGetUniformLocation(hud->program, "uScale");
+    glUseProgram(hud->program);
+    glUniform1i(glGetUniformLocation(hud->program, "uFont"), 0);
+    glUseProgram(0);
+
+    hud->staging.resize(bufferSize);
+    glGenBuffers(1, &hud->buffer);
+    stateCacheBindBuffer(GL_ARRAY_BUFFER, hud->buffer);
+    glBufferData(GL_ARRAY_BUFFER, bufferSize, NULL, GL_STREAM_DRAW);
+    gpuMemoryTrackBuffer(hud->buffer, bufferSize, GPU_MEMORY_STREAM, "HUD vertices");
+
+    glGenVertexArrays(1, &hud->vao);
+    glBindVertexArray(hud->vao);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (const void*)offsetof(HudVertex, position));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (const void*)offsetof(HudVertex, texCoord));
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(HudVertex), (const void*)offsetof(HudVertex, color));
+    /* The same buffer is the element buffer: the indices follow the vertices. */
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, hud->buffer);
+    glBindVertexArray(0);
+    stateCacheBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    hud->lastDraw = std::chrono::steady_clock::now();
+    hud->frameCount = 0;
+    hud->lastIssued = 0;
+    hud->lastSkipped = 0;
+    hud->counterCount = 0;
+    hud->costMs = 0.0;
+    hud->sumCostMs = 0.0;
+    memset(hud->frameMs, 0, sizeof(hud->frameMs));
+
+    Hud* expected = nullptr;
+    activeHud.compare_exchange_strong(expected, hud);
+    return hud;
+}
+
+void destroyHud(Hud* hud) {
+    Hud* expected = hud;
+    activeHud.compare_exchange_strong(expected, nullptr);
+
+    if (hud->frameCount > 0) {
+        printf("HUD: %.3f ms CPU per frame (%d frames)\n", hud->sumCostMs / hud->frameCount, hud->frameCount);
+    }
+
+    nk_buffer_free(&hud->commands);
+    nk_free(&hud->context);
+    nk_font_atlas_clear(&hud->atlas);
+
+    glDeleteTextures(1, &hud->fontTexture);
+    gpuMemoryReleaseTextures(1, &hud->fontTexture);
+    glDeleteVertexArrays(1, &hud->vao);
+    glDeleteProgram(hud->program);
+    glDeleteBuffers(1, &hud->buffer);
+    gpuMemoryReleaseBuffers(1, &hud->buffer);
+    delete hud;
+}
+
+void hudCounter(const char* name, double value) {
+    Hud* hud = activeHud.load();
+    if (hud == NULL) {
+        return;
+    }
+    for (int idx = 0; idx < hud->counterCount; idx++) {
+        if (strcmp(hud->counters[idx].name, name) == 0) {
+            hud->counters[idx].value = value;
+            return;
+        }
+    }
+    if (hud->counterCount < maxCounters) {
+        hud->counters[hud->counterCount++] = HudCounter { name, value };
+    }
+}
+
+static void labelRow(nk_context* context, const char* format, ...) {
+    char text[128];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    nk_layout_row_dynamic(context, rowHeight, 1);
+    nk_label(context, text, NK_TEXT_LEFT);
+}
+
+// The widgets of the frame, the height of the window follows the rows. Returns the window rectangle.
+static struct nk_rect buildHud(Hud* hud) {
+    nk_context* context = &hud->context;
+    const GpuTimer* timer = gpuTimerActive();
+    const StateCache* cache = stateCacheGet();
+    GpuMemoryTotals memory;
+    gpuMemoryGetTotals(&memory);
+
+    int rows = 3 + hud->counterCount + (timer ? (int)timer->passes.size() : 0) + (cache->enabled ? 1 : 0);
+    struct nk_rect bounds = nk_rect(0, 0, hudWidth, rows * rowHeight + graphHeight + 12);
+    nk_window_set_bounds(context, "hud", bounds);
+    if (nk_begin(context, "hud", bounds, NK_WINDOW_NO_SCROLLBAR)) {
+        // 1. The frame rate and the frame time graph (0-33 ms).
+        int frames = std::min(hud->frameCount, HUD_HISTORY);
+        double lastMs = frames > 0 ? hud->frameMs[(hud->frameCount - 1) % HUD_HISTORY] : 0.0;
+        double sumMs = 0.0;
+        for (int idx = 0; idx < frames; idx++) {
+            sumMs += hud->frameMs[idx];
+        }
+        double averageMs = frames > 0 ? sumMs / frames : 0.0;
+        labelRow(context, "%.1f fps   frame %.2f ms", averageMs > 0.0 ? 1000.0 / averageMs : 0.0, lastMs);
+
+        nk_layout_row_dynamic(context, graphHeight, 1);
+        if (nk_chart_begin(context, NK_CHART_LINES, HUD_HISTORY, 0.0f, 33.3f)) {
+            for (int idx = 0; idx < HUD_HISTORY; idx++) {
+                int frame = hud->frameCount - HUD_HISTORY + idx;
+                nk_chart_push(context, frame >= 0 ? hud->frameMs[frame % HUD_HISTORY] : 0.0f);
+            }
+            nk_chart_end(context);
+        }
+
+        // 2. The GPU passes and memory.
+        if (timer != NULL) {
+            for (size_t idx = 0; idx < timer->passes.size(); idx++) {
+                labelRow(context, "gpu %-16s %6.3f ms", timer->passes[idx].name, timer->passes[idx].lastMs);
+            }
+        }
+        labelRow(context, "gpu memory %.1f MB (peak %.1f MB)", memory.liveTotal / 1048576.0,
+                 memory.peakTotal / 1048576.0);
+
+        // 3. The counters of the frame and the cost of the HUD (the previous draw).
+        if (cache->enabled) {
+            int issued = 0;
+            int skipped = 0;
+            for (int kind = 0; kind < STATE_CACHE_KIND_COUNT; kind++) {
+                issued += cache->issued[kind];
+                skipped += cache->skipped[kind];
+            }
+            /* The statistics can be reset by the demo: the difference is only valid while they grow. */
+            labelRow(context, "binds %d issued, %d skipped", std::max(issued - hud->lastIssued, 0),
+                     std::max(skipped - hud->lastSkipped, 0));
+            hud->lastIssued = issued;
+            hud->lastSkipped = skipped;
+        }
+        for (int idx = 0; idx < hud->counterCount; idx++) {
+            labelRow(context, "%-22s %10.0f", hud->counters[idx].name, hud->counters[idx].value);
+        }
+        labelRow(context, "hud %.3f ms cpu", hud->costMs);
+    }
+    nk_end(context);
+    return bounds;
+}
+
+struct HudSavedState {
+    int program;
+    int vertexArray;
+    int arrayBuffer;
+    int drawFramebuffer;
+    int viewport[4];
+    int activeTexture;
+    int texture;
+    int sampler;
+    GLboolean blend;
+    GLboolean depthTest;
+    GLboolean cullFace;
+    GLboolean scissorTest;
+    GLboolean stencilTest;
+    int blendSrcRGB;
+    int blendDstRGB;
+    int blendSrcAlpha;
+    int blendDstAlpha;
+    int blendEquationRGB;
+    int blendEquationAlpha;
+};
+
+void hudDraw(Hud* hud, unsigned int framebuffer, int width, int height, int* x, int* y, int* hudWidth,
+             int* hudHeight) {
+    auto start = std::chrono::steady_clock::now();
+
+    // 1. The frame interval.
+    hud->frameMs[hud->frameCount % HUD_HISTORY] = (float)elapsedMs(hud->lastDraw);
+    hud->lastDraw = start;
+    hud->frameCount++;
+
+    // 2. The widgets, converted into the staging memory.
+    nk_input_begin(&hud->context);
+    nk_input_end(&hud->context);
+    struct nk_rect bounds = buildHud(hud);
+
+    static const nk_draw_vertex_layout_element vertexLayout[] = {
+        { NK_VERTEX_POSITION, NK_FORMAT_FLOAT, NK_OFFSETOF(HudVertex, position) },
+        { NK_VERTEX_TEXCOORD, NK_FORMAT_FLOAT, NK_OFFSETOF(HudVertex, texCoord) },
+        { NK_VERTEX_COLOR, NK_FORMAT_R8G8B8A8, NK_OFFSETOF(HudVertex, color) },
+        { NK_VERTEX_LAYOUT_END },
+    };
+    nk_convert_config config;
+    memset(&config, 0, sizeof(config));
+    config.vertex_layout = vertexLayout;
+    config.vertex_size = sizeof(HudVertex);
+    config.vertex_alignment = NK_ALIGNOF(HudVertex);
+    config.null = hud->nullTexture;
+    config.circle_segment_count = 12;
+    config.curve_segment_count = 12;
+    config.arc_segment_count = 12;
+    config.global_alpha = 1.0f;
+    config.shape_AA = NK_ANTI_ALIASING_OFF;
+    config.line_AA = NK_ANTI_ALIASING_OFF;
+
+    nk_buffer vertexBuffer;
+    nk_buffer indexBuffer;
+    nk_buffer_init_fixed(&vertexBuffer, hud->staging.data(), vertexBytes);
+    nk_buffer_init_fixed(&indexBuffer, hud->staging.data() + vertexBytes, bufferSize - vertexBytes);
+    int indexCount = 0;
+    if (nk_convert(&hud->context, &hud->commands, &vertexBuffer, &indexBuffer, &config) == NK_CONVERT_SUCCESS) {
+        // Every command uses the font atlas: one draw of all the indices.
+        const nk_draw_command* command;
+        nk_draw_foreach(command, &hud->context, &hud->commands) {
+            indexCount += (int)command->elem_count;
+        }
+    }
+    nk_clear(&hud->context);
+
+    *x = 0;
+    *y = std::max(height - (int)bounds.h, 0);
+    *hudWidth = std::min((int)bounds.w, width);
+    *hudHeight = std::min((int)bounds.h, height);
+
+    // 3. Draw with the HUD state, then restore the state of the demo.
+    HudSavedState state;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &state.program);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &state.vertexArray);
+    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &state.arrayBuffer);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &state.drawFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, state.viewport);
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &state.activeTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &state.texture);
+    glGetIntegerv(GL_SAMPLER_BINDING, &state.sampler);
+    state.blend = glIsEnabled(GL_BLEND);
+    state.depthTest = glIsEnabled(GL_DEPTH_TEST);
+    state.cullFace = glIsEnabled(GL_CULL_FACE);
+    state.scissorTest = glIsEnabled(GL_SCISSOR_TEST);
+    state.stencilTest = glIsEnabled(GL_STENCIL_TEST);
+    glGetIntegerv(GL_BLEND_SRC_RGB, &state.blendSrcRGB);
+    glGetIntegerv(GL_BLEND_DST_RGB, &state.blendDstRGB);
+    glGetIntegerv(GL_BLEND_SRC_ALPHA, &state.blendSrcAlpha);
+    glGetIntegerv(GL_BLEND_DST_ALPHA, &state.blendDstAlpha);
+    glGetIntegerv(GL_BLEND_EQUATION_RGB, &state.blendEquationRGB);
+    glGetIntegerv(GL_BLEND_EQUATION_ALPHA, &state.blendEquationAlpha);
+
+    if (indexCount > 0) {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, width, height);
+        glEnable(GL_BLEND);
+        glBlendEquation(GL_FUNC_ADD);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_SCISSOR_TEST);
+        glDisable(GL_STENCIL_TEST);
+
+        glUseProgram(hud->program);
+        glUniform2f(hud->scaleLoc, 2.0f / width, -2.0f / height);
+        glBindTexture(GL_TEXTURE_2D, hud->fontTexture);
+        glBindSampler(0, 0);
+
+        /* Orphan the storage (the previous frame may still read it), then upload the used ranges. */
+        stateCacheBindBuffer(GL_ARRAY_BUFFER, hud->buffer);
+        glBufferData(GL_ARRAY_BUFFER, bufferSize, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, nk_buffer_total(&vertexBuffer), hud->staging.data());
+        glBufferSubData(GL_ARRAY_BUFFER, vertexBytes, nk_buffer_total(&indexBuffer), hud->staging.data() + vertexBytes);
+
+        glBindVertexArray(hud->vao);
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, (const void*)(intptr_t)vertexBytes);
+    }
+
+    glUseProgram(state.program);
+    glBindVertexArray(state.vertexArray);
+    /* Through the state cache: the upload changed its shadowed binding. */
+    stateCacheBindBuffer(GL_ARRAY_BUFFER, state.arrayBuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, state.drawFramebuffer);
+    glViewport(state.viewport[0], state.viewport[1], state.viewport[2], state.viewport[3]);
+    glBindTexture(GL_TEXTURE_2D, state.texture);
+    glBindSampler(0, state.sampler);
+    glActiveTexture(state.activeTexture);
+    (state.blend ? glEnable : glDisable)(GL_BLEND);
+    (state.depthTest ? glEnable : glDisable)(GL_DEPTH_TEST);
+    (state.cullFace ? glEnable : glDisable)(GL_CULL_FACE);
+    (state.scissorTest ? glEnable : glDisable)(GL_SCISSOR_TEST);
+    (state.stencilTest ? glEnable : glDisable)(GL_STENCIL_TEST);
+    glBlendFuncSeparate(state.blendSrcRGB, state.blendDstRGB, state.blendSrcAlpha, state.blendDstAlpha);
+    glBlendEquationSeparate(state.blendEquationRGB, state.blendEquationAlpha);
+
+    // 4. The counters are per frame, the cost is shown in the next frame.
+    hud->counterCount = 0;
+    hud->costMs = elapsedMs(start);
+    hud->sumCostMs += hud->costMs;
+}
@@ -0,0 +1,65 @@
+/**
+ * Performance HUD: frame rate, frame time graph, GPU pass times, GPU memory and counters.
+ *
+ * Enabled by the "--hud" option of the demo context, drawn by demoSwapBuffers
+ * on top of the frame (after the "--dump-frame" capture, the golden images
+ * stay the same). It shows:
+ *
+ *  * the frame rate and the frame time (the interval of the HUD draws) with
+ *    a graph of the last HUD_HISTORY frames,
+ *  * the last GPU time of the passes of the active GpuTimer (gpu_timer.h,
+ *    "--hud" enables its queries),
+ *  * the live/peak GPU memory (gpu_memory.h),
+ *  * the state cache binds issued/skipped per frame (gl_state.h) and the
+ *    counters of the demo (hudCounter, ex.: the draw calls of a render queue),
+ *  * the CPU time of the HUD itself.
+ *
+ * The UI is built with nuklear (thirdparty/glfw/deps/nuklear.h) and converted
+ * into CPU memory, then uploaded into one orphaned dynamic buffer (vertices then
+ * indices, no fence: a mapped stream region would wait for the frame). The only texture is the baked font atlas (GL_R8,
+ * its white pixel draws the shapes) and the clip rectangles are ignored (the
+ * layout fits the window): the whole HUD is one glDrawElements per frame.
+ * The GL state (and the state cache shadow) is restored afterwards.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_HUD_H
+#define GLES_COMMON_HUD_H
+
+#define HUD_HISTORY 120
+
+struct Hud;
+
+// Bake the font atlas and create the buffers (requires a current GL ES 3.0 context).
+Hud* createHud();
+
+// Print the average CPU time of the HUD and delete the GL objects.
+void destroyHud(Hud* hud);
+
+// Draw the HUD into the top left corner of the framebuffer, returns its rectangle (origin: bottom left).
+void hudDraw(Hud* hud, unsigned int framebuffer, int width, int height, int* x, int* y, int* hudWidth, int* hudHeight);
+
+// A named value of the current frame shown by the HUD (no-op without a HUD).
+/* The name must be a string literal (or outlive the HUD). At most 8 counters are shown. */
+void hudCounter(const char* name, double value);
+
+#endif // GLES_COMMON_HUD_H
@@ -0,0 +1,264 @@
+/**
+ * Idle aware, event driven render loop. See idle_loop.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/idle_loop.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <chrono>
+#include <thread>
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+#include <GLFW/glfw3.h>
+
+// Number of frames with GPU timestamps in flight.
+#define IDLE_LOOP_QUERY_RING 4
+
+enum IdleReason {
+    IDLE_REASON_FIRST,
+    IDLE_REASON_EVENT,
+    IDLE_REASON_ANIMATION,
+    IDLE_REASON_CLOSE,
+    IDLE_REASON_COUNT,
+};
+
+static const char* reasonNames[IDLE_REASON_COUNT] = { "first", "event", "animation", "close" };
+
+struct IdleLoop {
+    GLFWwindow* window;
+
+    double nextRedraw; // INFINITY: no redraw requested
+    int frames[IDLE_REASON_COUNT];
+    double waitSeconds;
+
+    double startTime;
+    clock_t startCpu;
+
+    // GPU time of the frames: timestamp pairs, read back when available.
+    bool timestamps;
+    unsigned int queries[IDLE_LOOP_QUERY_RING][2];
+    bool pending[IDLE_LOOP_QUERY_RING];
+    int frameIndex;
+    double gpuSeconds;
+    int gpuFrames;
+
+    PFNGLGENQUERIESEXTPROC genQueries;
+    PFNGLDELETEQUERIESEXTPROC deleteQueries;
+    PFNGLQUERYCOUNTEREXTPROC queryCounter;
+    PFNGLGETQUERYOBJECTUIVEXTPROC getQueryObjectuiv;
+    PFNGLGETQUERYOBJECTUI64VEXTPROC getQueryObjectui64v;
+};
+
+static double secondsNow() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static bool hasGLExtension(const char* name) {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int idx = 0; idx < count; idx++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, idx), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool initTimestamps(IdleLoop* idle) {
+    if (!hasGLExtension("GL_EXT_disjoint_timer_query")) {
+        return false;
+    }
+
+    idle->genQueries = (PFNGLGENQUERIESEXTPROC)eglGetProcAddress("glGenQueriesEXT");
+    idle->deleteQueries = (PFNGLDELETEQUERIESEXTPROC)eglGetProcAddress("glDeleteQueriesEXT");
+    idle->queryCounter = (PFNGLQUERYCOUNTEREXTPROC)eglGetProcAddress("glQueryCounterEXT");
+    idle->getQueryObjectuiv = (PFNGLGETQUERYOBJECTUIVEXTPROC)eglGetProcAddress("glGetQueryObjectuivEXT");
+    idle->getQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VEXTPROC)eglGetProcAddress("glGetQueryObjectui64vEXT");
+    if (!idle->genQueries || !idle->deleteQueries || !idle->queryCounter || !idle->getQueryObjectuiv ||
+        !idle->getQueryObjectui64v) {
+        return false;
+    }
+
+    /* The timestamp target is optional: the counter has 0 bits without it. */
+    PFNGLGETQUERYIVEXTPROC getQueryiv = (PFNGLGETQUERYIVEXTPROC)eglGetProcAddress("glGetQueryivEXT");
+    int bits = 0;
+    if (getQueryiv) {
+        getQueryiv(GL_TIMESTAMP_EXT, GL_QUERY_COUNTER_BITS_EXT, &bits);
+    }
+    if (bits == 0) {
+        return false;
+    }
+
+    idle->genQueries(IDLE_LOOP_QUERY_RING * 2, &idle->queries[0][0]);
+    return true;
+}
+
+// Collect the GPU time of the finished frames (wait: also the ones still in flight).
+static void collectTimestamps(IdleLoop* idle, bool wait) {
+    for (int slot = 0; slot < IDLE_LOOP_QUERY_RING; slot++) {
+        if (!idle->pending[slot]) {
+            continue;
+        }
+
+        GLuint available = 0;
+        idle->getQueryObjectuiv(idle->queries[slot][1], GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+        if (!available && !wait) {
+            continue;
+        }
+
+        GLuint64 startNs = 0;
+        GLuint64 endNs = 0;
+        idle->getQueryObjectui64v(idle->queries[slot][0], GL_QUERY_RESULT_EXT, &startNs);
+        idle->getQueryObjectui64v(idle->queries[slot][1], GL_QUERY_RESULT_EXT, &endNs);
+        if (endNs > startNs) {
+            idle->gpuSeconds += (endNs - startNs) / 1e9;
+        }
+        idle->gpuFrames++;
+        idle->pending[slot] = false;
+    }
+}
+
+static void beginFrame(IdleLoop* idle, IdleReason reason) {
+    idle->frames[reason]++;
+    idle->nextRedraw = INFINITY;
+
+    if (idle->timestamps) {
+        collectTimestamps(idle, false);
+
+        /* A frame still in flight after a full ring is dropped. */
+        int slot = idle->frameIndex % IDLE_LOOP_QUERY_RING;
+        idle->queryCounter(idle->queries[slot][0], GL_TIMESTAMP_EXT);
+        idle->pending[slot] = false;
+    }
+}
+
+IdleLoop* createIdleLoop(GLFWwindow* window) {
+    IdleLoop* idle = new IdleLoop();
+    memset(idle, 0, sizeof(*idle));
+    idle->window = window;
+    idle->nextRedraw = INFINITY;
+    idle->startTime = secondsNow();
+    idle->startCpu = clock();
+    idle->timestamps = initTimestamps(idle);
+
+    printf("Idle loop: redraw on %s, GPU time: %s\n", window ? "events and animation requests" : "animation requests (headless)",
+           idle->timestamps ? "GL_TIMESTAMP_EXT" : "not supported");
+    return idle;
+}
+
+void destroyIdleLoop(IdleLoop* idle) {
+    double elapsed = secondsNow() - idle->startTime;
+    double cpuSeconds = (double)(clock() - idle->startCpu) / CLOCKS_PER_SEC;
+
+    if (idle->timestamps) {
+        collectTimestamps(idle, true);
+        idle->deleteQueries(IDLE_LOOP_QUERY_RING * 2, &idle->queries[0][0]);
+    }
+
+    int total = 0;
+    for (int reason = 0; reason < IDLE_REASON_COUNT; reason++) {
+        total += idle->frames[reason];
+    }
+
+    printf("Idle loop: %d frames in %.3f s (%.2f fps), waiting: %.1f%%\n", total, elapsed,
+           elapsed > 0.0 ? total / elapsed : 0.0, elapsed > 0.0 ? 100.0 * idle->waitSeconds / elapsed : 0.0);
+    printf("  redraws:");
+    for (int reason = 0; reason < IDLE_REASON_COUNT; reason++) {
+        printf(" %s %d%s", reasonNames[reason], idle->frames[reason], reason + 1 < IDLE_REASON_COUNT ? " |" : "\n");
+    }
+    /* The process CPU time includes every thread (ex.: driver threads). */
+    printf("  CPU utilisation: %.1f%% (%.3f s)\n", elapsed > 0.0 ? 100.0 * cpuSeconds / elapsed : 0.0, cpuSeconds);
+    if (idle->timestamps) {
+        printf("  GPU utilisation: %.1f%% (%.3f s in %d frames)\n", elapsed > 0.0 ? 100.0 * idle->gpuSeconds / elapsed : 0.0,
+               idle->gpuSeconds, idle->gpuFrames);
+    } else {
+        printf("  GPU utilisation: n/a\n");
+    }
+
+    delete idle;
+}
+
+void idleLoopRequestRedraw(IdleLoop* idle, double delay) {
+    double time = secondsNow() + (delay > 0.0 ? delay : 0.0);
+    if (time < idle->nextRedraw) {
+        idle->nextRedraw = time;
+    }
+}
+
+void idleLoopWait(IdleLoop* idle) {
+    // 1. The first frame is always drawn.
+    if (idle->frameIndex == 0) {
+        if (idle->window) {
+            glfwPollEvents();
+        }
+        beginFrame(idle, IDLE_REASON_FIRST);
+        return;
+    }
+
+    double start = secondsNow();
+    IdleReason reason = IDLE_REASON_ANIMATION;
+
+    if (idle->window == NULL) {
+        // 2. Headless: only the animation clock can request a frame.
+        if (isfinite(idle->nextRedraw) && start < idle->nextRedraw) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(idle->nextRedraw - start));
+        }
+    } else if (glfwWindowShouldClose(idle->window)) {
+        reason = IDLE_REASON_CLOSE;
+    } else {
+        // 3. Window: sleep in the event wait until an event arrives or the animation clock expires.
+        /* Any event wakes the wait (ex.: a key handled by the demo's own callback): it is redrawn. */
+        if (!isfinite(idle->nextRedraw)) {
+            glfwWaitEvents();
+            reason = IDLE_REASON_EVENT;
+        } else if (start < idle->nextRedraw) {
+            glfwWaitEventsTimeout(idle->nextRedraw - start);
+            reason = secondsNow() < idle->nextRedraw ? IDLE_REASON_EVENT : IDLE_REASON_ANIMATION;
+        } else {
+            glfwPollEvents();
+        }
+
+        if (glfwWindowShouldClose(idle->window)) {
+            reason = IDLE_REASON_CLOSE;
+        }
+    }
+
+    idle->waitSeconds += secondsNow() - start;
+    beginFrame(idle, reason);
+}
+
+void idleLoopEndFrame(IdleLoop* idle) {
+    if (idle->timestamps) {
+        int slot = idle->frameIndex % IDLE_LOOP_QUERY_RING;
+        idle->queryCounter(idle->queries[slot][1], GL_TIMESTAMP_EXT);
+        idle->pending[slot] = true;
+    }
+    idle->frameIndex++;
+}
@@ -0,0 +1,65 @@
+/**
+ * Idle aware, event driven render loop with CPU/GPU utilisation report.
+ *
+ * Enabled by the "--idle" option of the demo context. By default the render
+ * loop redraws as fast as the swap allows even if nothing changed. In the idle
+ * mode demoPollEvents blocks (glfwWaitEvents / glfwWaitEventsTimeout) until a
+ * redraw is needed:
+ *
+ *  * an event arrived: input, resize, window expose, close, etc.,
+ *  * the animation clock of the demo expired: demoRequestRedraw(demo, delay)
+ *    schedules the next frame (ex.: 1/30 s for a slow animation), a static
+ *    frame never asks for it.
+ *
+ * Headless runs have no events: they sleep until the requested redraw, without
+ * a request the next frame starts right away.
+ *
+ * When the context is destroyed the utilisation is printed: the number of
+ * frames per reason, the process CPU time and the GPU time of the frames
+ * (GL_TIMESTAMP_EXT queries at the start and the end of every frame,
+ * GL_EXT_disjoint_timer_query) over the elapsed time.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_IDLE_LOOP_H
+#define GLES_COMMON_IDLE_LOOP_H
+
+typedef struct GLFWwindow GLFWwindow;
+struct IdleLoop;
+
+// Create the idle loop of the window (NULL: headless). Requires a current GL ES context.
+IdleLoop* createIdleLoop(GLFWwindow* window);
+
+// Print the utilisation summary and delete the queries.
+void destroyIdleLoop(IdleLoop* idle);
+
+// Redraw after "delay" seconds at the latest (the earliest request of the frame wins).
+void idleLoopRequestRedraw(IdleLoop* idle, double delay);
+
+// Wait for an event or the requested redraw time, then process the events (replaces glfwPollEvents).
+/* Returns right away for the first frame and if the window should close. */
+void idleLoopWait(IdleLoop* idle);
+
+// The commands of the frame are submitted: call right before the swap.
+void idleLoopEndFrame(IdleLoop* idle);
+
+#endif // GLES_COMMON_IDLE_LOOP_H
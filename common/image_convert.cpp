@@ -0,0 +1,198 @@
+/**
+ * CPU image conversion kernels, see image_convert.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/image_convert.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define IMAGE_CONVERT_SSE2 1
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define IMAGE_CONVERT_SSSE3 1
+#endif
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define IMAGE_CONVERT_NEON 1
+#endif
+
+// Expand the first "count" pixels of a row with SIMD, returns the number of converted pixels.
+/* The rest of the row is converted by the scalar loop. */
+static int convertRowSIMD(uint8_t* dst, const uint8_t* src, int count, int channels) {
+    int idx = 0;
+#if IMAGE_CONVERT_SSSE3
+    if (channels == 3) {
+        const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+        /* Every load reads 16 bytes for 4 pixels (12 bytes): the last one must stay inside the row. */
+        for (; idx + 18 <= count; idx += 16) {
+            const uint8_t* in = src + idx * 3;
+            __m128i* out = (__m128i*)(dst + idx * 4);
+            for (int part = 0; part < 4; part++) {
+                __m128i rgb = _mm_loadu_si128((const __m128i*)(in + part * 12));
+                _mm_storeu_si128(out + part, _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+            }
+        }
+    }
+#endif
+#if IMAGE_CONVERT_SSE2
+    if (channels == 1) {
+        const __m128i alpha = _mm_set1_epi8((char)0xff);
+        for (; idx + 16 <= count; idx += 16) {
+            __m128i gray = _mm_loadu_si128((const __m128i*)(src + idx));
+            __m128i gg = _mm_unpacklo_epi8(gray, gray);
+            __m128i ga = _mm_unpacklo_epi8(gray, alpha);
+            __m128i* out = (__m128i*)(dst + idx * 4);
+            _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(gg, ga));
+            _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(gg, ga));
+            gg = _mm_unpackhi_epi8(gray, gray);
+            ga = _mm_unpackhi_epi8(gray, alpha);
+            _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(gg, ga));
+            _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(gg, ga));
+        }
+    }
+#elif IMAGE_CONVERT_NEON
+    if (channels == 1 || channels == 3) {
+        const uint8x16_t alpha = vdupq_n_u8(255);
+        for (; idx + 16 <= count; idx += 16) {
+            uint8x16x4_t rgba;
+            if (channels == 3) {
+                uint8x16x3_t rgb = vld3q_u8(src + idx * 3);
+                rgba.val[0] = rgb.val[0];
+                rgba.val[1] = rgb.val[1];
+                rgba.val[2] = rgb.val[2];
+            } else {
+                rgba.val[0] = rgba.val[1] = rgba.val[2] = vld1q_u8(src + idx);
+            }
+            rgba.val[3] = alpha;
+            vst4q_u8(dst + idx * 4, rgba);
+        }
+    }
+#else
+    (void)dst;
+    (void)src;
+    (void)count;
+    (void)channels;
+#endif
+    return idx;
+}
+
+void convertToRGBA8(uint8_t* dst, const uint8_t* src, int rowBegin, int rowEnd, int width, int channels) {
+    for (int y = rowBegin; y < rowEnd; y++) {
+        const uint8_t* in = src + (size_t)y * width * channels;
+        uint8_t* out = dst + (size_t)y * width * 4;
+
+        if (channels == 4) {
+            memcpy(out, in, (size_t)width * 4);
+            continue;
+        }
+
+        for (int x = convertRowSIMD(out, in, width, channels); x < width; x++) {
+            const uint8_t* pixel = in + x * channels;
+            uint8_t gray = pixel[0];
+            out[x * 4 + 0] = gray;
+            out[x * 4 + 1] = channels >= 3 ? pixel[1] : gray;
+            out[x * 4 + 2] = channels >= 3 ? pixel[2] : gray;
+            out[x * 4 + 3] = channels == 2 ? pixel[1] : 255;
+        }
+    }
+}
+
+// Average 2x2 blocks of the two source rows for the first "count" output pixels, returns the number written.
+/* Rounded as the scalar version: (sum + 2) / 4. */
+static int downsampleRowSIMD(uint8_t* dst, const uint8_t* row0, const uint8_t* row1, int count) {
+    int idx = 0;
+#if IMAGE_CONVERT_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    for (; idx + 4 <= count; idx += 4) {
+        __m128i result[2];
+        for (int half = 0; half < 2; half++) {
+            // 4 source pixels of both rows: 2 output pixels.
+            __m128i a = _mm_loadu_si128((const __m128i*)(row0 + idx * 8 + half * 16));
+            __m128i b = _mm_loadu_si128((const __m128i*)(row1 + idx * 8 + half * 16));
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+            __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+            result[half] = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+        }
+        _mm_storeu_si128((__m128i*)(dst + idx * 4), _mm_packus_epi16(result[0], result[1]));
+    }
+#elif IMAGE_CONVERT_NEON
+    for (; idx + 4 <= count; idx += 4) {
+        // Even and odd source pixels of both rows.
+        uint32x4x2_t a = vld2q_u32((const uint32_t*)(row0 + idx * 8));
+        uint32x4x2_t b = vld2q_u32((const uint32_t*)(row1 + idx * 8));
+        uint8x16_t a0 = vreinterpretq_u8_u32(a.val[0]);
+        uint8x16_t a1 = vreinterpretq_u8_u32(a.val[1]);
+        uint8x16_t b0 = vreinterpretq_u8_u32(b.val[0]);
+        uint8x16_t b1 = vreinterpretq_u8_u32(b.val[1]);
+        uint16x8_t lo = vaddq_u16(vaddl_u8(vget_low_u8(a0), vget_low_u8(a1)), vaddl_u8(vget_low_u8(b0), vget_low_u8(b1)));
+        uint16x8_t hi = vaddq_u16(vaddl_u8(vget_high_u8(a0), vget_high_u8(a1)), vaddl_u8(vget_high_u8(b0), vget_high_u8(b1)));
+        vst1q_u8(dst + idx * 4, vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)));
+    }
+#else
+    (void)dst;
+    (void)row0;
+    (void)row1;
+    (void)count;
+#endif
+    return idx;
+}
+
+void downsampleRGBA8(uint8_t* dst, int rowBegin, int rowEnd, const uint8_t* src, int srcWidth, int srcHeight) {
+    int dstWidth = srcWidth > 1 ? srcWidth / 2 : 1;
+
+    for (int y = rowBegin; y < rowEnd; y++) {
+        // Odd sizes: the last row/column is reused.
+        int y0 = y * 2;
+        int y1 = y0 + 1 < srcHeight ? y0 + 1 : y0;
+        const uint8_t* row0 = src + (size_t)y0 * srcWidth * 4;
+        const uint8_t* row1 = src + (size_t)y1 * srcWidth * 4;
+        uint8_t* out = dst + (size_t)y * dstWidth * 4;
+
+        int x = srcWidth > 1 ? downsampleRowSIMD(out, row0, row1, dstWidth) : 0;
+        for (; x < dstWidth; x++) {
+            int x0 = x * 2;
+            int x1 = x0 + 1 < srcWidth ? x0 + 1 : x0;
+            for (int c = 0; c < 4; c++) {
+                int sum = row0[x0 * 4 + c] + row0[x1 * 4 + c] + row1[x0 * 4 + c] + row1[x1 * 4 + c];
+                out[x * 4 + c] = (uint8_t)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+const char* imageConvertImplementation() {
+#if IMAGE_CONVERT_SSSE3
+    return "SSSE3";
+#elif IMAGE_CONVERT_SSE2
+    return "SSE2";
+#elif IMAGE_CONVERT_NEON
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,58 @@
+/**
+ * CPU image conversion kernels for the texture uploads: RGBA8 expansion and
+ * 2x2 box filter downsampling, with SSE2/SSSE3 (x86) or NEON (ARM) versions.
+ *
+ * GLES uploads with GL_RGB data are often expanded to RGBA by the driver on
+ * the CPU, one pixel at a time. The decoded images are expanded here instead
+ * (16 pixels per iteration with SSSE3 or NEON) and the mip levels are built
+ * 4 output pixels at a time. The kernels work on row ranges so an image can
+ * be split between threads (see common/job_system.h), every row is written
+ * by exactly one call. Without SIMD support the scalar versions are used, the
+ * results are bit identical.
+ *
+ * Usage:
+ *
+ *   convertToRGBA8(rgba, decoded, 0, height, width, channels);
+ *   downsampleRGBA8(level1, 0, height / 2, rgba, width, height);
+ *
+ * Dependencies:
+ *  * C++11
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_IMAGE_CONVERT_H
+#define GLES_COMMON_IMAGE_CONVERT_H
+
+#include <stdint.h>
+
+// Expand the rows [rowBegin, rowEnd) of a 1-4 channel 8 bit image to RGBA8.
+/* 1: gray -> (g, g, g, 255), 2: gray + alpha -> (g, g, g, a), 3: RGB -> (r, g, b, 255), 4: copy. */
+void convertToRGBA8(uint8_t* dst, const uint8_t* src, int rowBegin, int rowEnd, int width, int channels);
+
+// Build the rows [rowBegin, rowEnd) of the next mip level of an RGBA8 image with a 2x2 box filter.
+/* The level is max(width / 2, 1) x max(height / 2, 1), a source size of 1 reuses the same row/column. */
+void downsampleRGBA8(uint8_t* dst, int rowBegin, int rowEnd, const uint8_t* src, int srcWidth, int srcHeight);
+
+// Name of the kernels in use: "SSSE3", "SSE2", "NEON" or "scalar".
+const char* imageConvertImplementation();
+
+#endif // GLES_COMMON_IMAGE_CONVERT_H
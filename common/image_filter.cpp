@@ -0,0 +1,371 @@
+/**
+ * Compute shader image filters, see image_filter.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/image_filter.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <string>
+
+#include <GLES3/gl31.h>
+
+#include "common/gpu_memory.h"
+
+// uGridSize.xy = image size, uParams.x = radius. VERTICAL selects the axis of the pass, MAX_RADIUS is inserted.
+static const char* blur_src = R"(#version 310 es
+precision highp float;
+precision highp image2D;
+
+layout(rgba8, binding = 0) readonly uniform image2D uSource;
+layout(rgba8, binding = 1) writeonly uniform image2D uTarget;
+layout(std430, binding = 0) readonly buffer Weights { float weights[]; };
+
+// AXIS swaps the coordinates of the vertical pass: x is along the blur, y is across it.
+#ifdef VERTICAL
+#define ALONG LOCAL_SIZE_Y
+#define ACROSS LOCAL_SIZE_X
+#define AXIS(v) (v).yx
+#else
+#define ALONG LOCAL_SIZE_X
+#define ACROSS LOCAL_SIZE_Y
+#define AXIS(v) (v).xy
+#endif
+
+#define CACHE_ROW (ALONG + 2 * MAX_RADIUS)
+
+shared vec4 sCache[ACROSS * CACHE_ROW];
+
+void main() {
+    ivec2 size = AXIS(uGridSize.xy);
+    int radius = uParams.x;
+    ivec2 local = AXIS(ivec2(gl_LocalInvocationID.xy));
+    ivec2 origin = AXIS(ivec2(gl_WorkGroupID.xy) * ivec2(LOCAL_SIZE_X, LOCAL_SIZE_Y));
+    int row = local.y * CACHE_ROW;
+
+    // 1. Cache the line of the tile with the apron on both sides (clamped to the edges).
+    int across = min(origin.y + local.y, size.y - 1);
+    for (int idx = local.x; idx < ALONG + 2 * radius; idx += ALONG) {
+        int along = clamp(origin.x + idx - radius, 0, size.x - 1);
+        sCache[row + idx] = imageLoad(uSource, AXIS(ivec2(along, across)));
+    }
+    memoryBarrierShared();
+    barrier();
+
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(pixel, uGridSize.xy))) {
+        return;
+    }
+
+    // 2. Symmetric weights: weights[0] is the center.
+    int center = row + local.x + radius;
+    vec4 sum = sCache[center] * weights[0];
+    for (int tap = 1; tap <= radius; tap++) {
+        sum += (sCache[center - tap] + sCache[center + tap]) * weights[tap];
+    }
+    imageStore(uTarget, pixel, sum);
+}
+)";
+
+// uGridSize.xy = image size.
+static const char* sobel_src = R"(#version 310 es
+precision highp float;
+precision highp image2D;
+
+layout(rgba8, binding = 0) readonly uniform image2D uSource;
+layout(rgba8, binding = 1) writeonly uniform image2D uTarget;
+
+#define TILE_X (LOCAL_SIZE_X + 2)
+#define TILE_Y (LOCAL_SIZE_Y + 2)
+
+shared float sLuma[TILE_X * TILE_Y];
+
+void main() {
+    ivec2 size = uGridSize.xy;
+    ivec2 origin = ivec2(gl_WorkGroupID.xy) * ivec2(LOCAL_SIZE_X, LOCAL_SIZE_Y) - 1;
+
+    // 1. Cache the luminance of the tile with a 1 pixel border.
+    for (int idx = int(gl_LocalInvocationIndex); idx < TILE_X * TILE_Y; idx += LOCAL_SIZE_X * LOCAL_SIZE_Y) {
+        ivec2 pos = clamp(origin + ivec2(idx % TILE_X, idx / TILE_X), ivec2(0), size - 1);
+        sLuma[idx] = dot(imageLoad(uSource, pos).rgb, vec3(0.2126, 0.7152, 0.0722));
+    }
+    memoryBarrierShared();
+    barrier();
+
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(pixel, size))) {
+        return;
+    }
+
+    // 2. 3x3 Sobel operator.
+    int center = (int(gl_LocalInvocationID.y) + 1) * TILE_X + int(gl_LocalInvocationID.x) + 1;
+    float tl = sLuma[center - TILE_X - 1];
+    float t = sLuma[center - TILE_X];
+    float tr = sLuma[center - TILE_X + 1];
+    float l = sLuma[center - 1];
+    float r = sLuma[center + 1];
+    float bl = sLuma[center + TILE_X - 1];
+    float b = sLuma[center + TILE_X];
+    float br = sLuma[center + TILE_X + 1];
+
+    float gx = (tr + 2.0 * r + br) - (tl + 2.0 * l + bl);
+    float gy = (bl + 2.0 * b + br) - (tl + 2.0 * t + tr);
+    float magnitude = clamp(length(vec2(gx, gy)), 0.0, 1.0);
+    imageStore(uTarget, pixel, vec4(vec3(magnitude), 1.0));
+}
+)";
+
+// uGridSize.xy = image size.
+static const char* color_grade_src = R"(#version 310 es
+precision highp float;
+precision highp image2D;
+
+layout(rgba8, binding = 0) readonly uniform image2D uSource;
+layout(rgba8, binding = 1) writeonly uniform image2D uTarget;
+layout(std430, binding = 0) readonly buffer Grade {
+    vec4 exposureContrastSaturationGamma;
+    vec4 lift;
+    vec4 gain;
+} grade;
+
+void main() {
+    ivec2 pixel = GLOBAL_ID_2D;
+    if (any(greaterThanEqual(pixel, uGridSize.xy))) {
+        return;
+    }
+
+    vec4 params = grade.exposureContrastSaturationGamma;
+    vec4 color = imageLoad(uSource, pixel);
+
+    vec3 graded = color.rgb * exp2(params.x);
+    graded = graded * grade.gain.rgb + grade.lift.rgb;
+    graded = (graded - 0.5) * params.y + 0.5;
+    float luma = dot(graded, vec3(0.2126, 0.7152, 0.0722));
+    graded = mix(vec3(luma), graded, params.z);
+    graded = pow(max(graded, vec3(0.0)), vec3(1.0 / params.w));
+
+    imageStore(uTarget, pixel, vec4(clamp(graded, 0.0, 1.0), color.a));
+}
+)";
+
+unsigned int createFilterImage(int width, int height, const void* rgba) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+    gpuMemoryTrackTexture(texture, GL_RGBA8, width, height, 1, 1, GPU_MEMORY_TEXTURE, "filter image");
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (rgba != NULL) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+void initImageFilterPipeline(ImageFilterPipeline* filter, int width, int height) {
+    // 1. Build the kernels: the blur passes are the same kernel along the two axes.
+    char maxRadius[64];
+    snprintf(maxRadius, sizeof(maxRadius), "#define MAX_RADIUS %d\n", IMAGE_FILTER_MAX_RADIUS);
+
+    std::string horizontalSrc = blur_src;
+    horizontalSrc.insert(horizontalSrc.find('\n') + 1, maxRadius);
+    std::string verticalSrc = horizontalSrc;
+    verticalSrc.insert(verticalSrc.find('\n') + 1, "#define VERTICAL\n");
+
+    createComputeKernel(&filter->blurHorizontal, horizontalSrc.c_str(), 2);
+    createComputeKernel(&filter->blurVertical, verticalSrc.c_str(), 2);
+    createComputeKernel(&filter->sobel, sobel_src, 2);
+    createComputeKernel2D(&filter->colorGrade, color_grade_src, 0, 0, COMPUTE_SWIZZLE_AUTO);
+
+    // 2. Create the ping-pong images.
+    filter->width = width;
+    filter->height = height;
+    filter->targets[0] = createFilterImage(width, height, NULL);
+    filter->targets[1] = createFilterImage(width, height, NULL);
+
+    filter->stages.clear();
+    filter->passCount = 0;
+}
+
+void destroyImageFilterPipeline(ImageFilterPipeline* filter) {
+    for (size_t idx = 0; idx < filter->stages.size(); idx++) {
+        if (filter->stages[idx].params.buffer != 0) {
+            destroyStorageBuffer(&filter->stages[idx].params);
+        }
+    }
+    filter->stages.clear();
+
+    glDeleteTextures(2, filter->targets);
+    gpuMemoryReleaseTextures(2, filter->targets);
+    destroyComputeKernel(&filter->blurHorizontal);
+    destroyComputeKernel(&filter->blurVertical);
+    destroyComputeKernel(&filter->sobel);
+    destroyComputeKernel(&filter->colorGrade);
+}
+
+void imageFilterAddBlur(ImageFilterPipeline* filter, float sigma) {
+    ImageFilterStage stage;
+    stage.type = IMAGE_FILTER_BLUR;
+    stage.radius = (int)ceilf(sigma * 3.0f);
+    stage.radius = stage.radius < 1 ? 1 : (stage.radius > IMAGE_FILTER_MAX_RADIUS ? IMAGE_FILTER_MAX_RADIUS : stage.radius);
+
+    // Normalized weights of the center and one side.
+    float weights[IMAGE_FILTER_MAX_RADIUS + 1];
+    float sum = 0.0f;
+    for (int tap = 0; tap <= stage.radius; tap++) {
+        weights[tap] = expf(-(float)(tap * tap) / (2.0f * sigma * sigma));
+        sum += tap == 0 ? weights[tap] : 2.0f * weights[tap];
+    }
+    for (int tap = 0; tap <= stage.radius; tap++) {
+        weights[tap] /= sum;
+    }
+
+    stage.params = createStorageBuffer<float>(stage.radius + 1, weights);
+    filter->stages.push_back(stage);
+    filter->passCount += 2;
+}
+
+void imageFilterAddSobel(ImageFilterPipeline* filter) {
+    ImageFilterStage stage;
+    stage.type = IMAGE_FILTER_SOBEL;
+    stage.radius = 1;
+    stage.params.buffer = 0;
+    stage.params.count = 0;
+
+    filter->stages.push_back(stage);
+    filter->passCount += 1;
+}
+
+void imageFilterAddColorGrade(ImageFilterPipeline* filter, const ColorGrade& grade) {
+    ImageFilterStage stage;
+    stage.type = IMAGE_FILTER_COLOR_GRADE;
+    stage.radius = 0;
+
+    // std430 layout of the kernel's Grade block: 3 vec4.
+    const float params[12] = {
+        grade.exposure, grade.contrast, grade.saturation, grade.gamma,
+        grade.lift[0], grade.lift[1], grade.lift[2], 0.0f,
+        grade.gain[0], grade.gain[1], grade.gain[2], 0.0f,
+    };
+    stage.params = createStorageBuffer<float>(12, params);
+
+    filter->stages.push_back(stage);
+    filter->passCount += 1;
+}
+
+// Record one pass from "source" into the ping-pong image which isn't the source, returns the written image.
+static unsigned int recordPass(ImageFilterPipeline* filter, ComputeQueue* queue, const ComputeKernel* kernel,
+                               const ImageFilterStage& stage, unsigned int source) {
+    unsigned int target = source == filter->targets[0] ? filter->targets[1] : filter->targets[0];
+
+    computeQueueAdd(queue, kernel, filter->width, filter->height, 1);
+    computeQueueBindImage(queue, 0, source, GL_READ_ONLY, GL_RGBA8);
+    computeQueueBindImage(queue, 1, target, GL_WRITE_ONLY, GL_RGBA8);
+    if (stage.params.buffer != 0) {
+        computeQueueBind(queue, 0, stage.params.buffer);
+    }
+    computeQueueParams(queue, stage.radius);
+    computeQueueBarrier(queue, GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    return target;
+}
+
+unsigned int imageFilterRecord(ImageFilterPipeline* filter, ComputeQueue* queue, unsigned int source) {
+    unsigned int current = source;
+    for (size_t idx = 0; idx < filter->stages.size(); idx++) {
+        const ImageFilterStage& stage = filter->stages[idx];
+        switch (stage.type) {
+            case IMAGE_FILTER_BLUR:
+                current = recordPass(filter, queue, &filter->blurHorizontal, stage, current);
+                current = recordPass(filter, queue, &filter->blurVertical, stage, current);
+                break;
+            case IMAGE_FILTER_SOBEL:
+                current = recordPass(filter, queue, &filter->sobel, stage, current);
+                break;
+            case IMAGE_FILTER_COLOR_GRADE:
+                current = recordPass(filter, queue, &filter->colorGrade, stage, current);
+                break;
+        }
+    }
+    return current;
+}
+
+static void executeGraphPass(RenderGraph* graph, int pass, void* userData) {
+    (void)pass;
+    const ImageFilterGraphPass* data = (const ImageFilterGraphPass*)userData;
+    const ImageFilterStage& stage = data->filter->stages[data->stage];
+
+    ComputeQueue* queue = data->queue;
+    computeQueueAdd(queue, data->kernel, data->filter->width, data->filter->height, 1);
+    computeQueueBindImage(queue, 0, renderGraphTexture(graph, data->source), GL_READ_ONLY, GL_RGBA8);
+    computeQueueBindImage(queue, 1, renderGraphTexture(graph, data->target), GL_WRITE_ONLY, GL_RGBA8);
+    if (stage.params.buffer != 0) {
+        computeQueueBind(queue, 0, stage.params.buffer);
+    }
+    computeQueueParams(queue, stage.radius);
+    computeQueueSubmit(queue);
+}
+
+int imageFilterAddToGraph(ImageFilterPipeline* filter, RenderGraph* graph, ComputeQueue* queue, int source) {
+    static const char* passNames[][2] = {
+        { "blur horizontal", "blur vertical" },
+        { "sobel", "" },
+        { "color grade", "" },
+    };
+
+    // The passes point into the vector: no reallocation after the first pass.
+    filter->graphPasses.clear();
+    filter->graphPasses.reserve(filter->passCount);
+
+    RenderTargetKey key = { RENDER_TARGET_TEXTURE, GL_RGBA8, filter->width, filter->height, 0 };
+    int current = source;
+    for (size_t idx = 0; idx < filter->stages.size(); idx++) {
+        const ImageFilterStage& stage = filter->stages[idx];
+        int dispatches = stage.type == IMAGE_FILTER_BLUR ? 2 : 1;
+
+        for (int dispatch = 0; dispatch < dispatches; dispatch++) {
+            ImageFilterGraphPass data;
+            data.filter = filter;
+            data.stage = (int)idx;
+            data.queue = queue;
+            data.source = current;
+            switch (stage.type) {
+                case IMAGE_FILTER_BLUR: data.kernel = dispatch == 0 ? &filter->blurHorizontal : &filter->blurVertical; break;
+                case IMAGE_FILTER_SOBEL: data.kernel = &filter->sobel; break;
+                case IMAGE_FILTER_COLOR_GRADE: data.kernel = &filter->colorGrade; break;
+            }
+
+            const char* name = passNames[stage.type][dispatch];
+            data.target = renderGraphCreateTexture(graph, name, key);
+            filter->graphPasses.push_back(data);
+
+            int pass = renderGraphAddPass(graph, name, executeGraphPass, &filter->graphPasses.back());
+            renderGraphUse(graph, pass, data.source, RENDER_GRAPH_IMAGE_READ);
+            renderGraphUse(graph, pass, data.target, RENDER_GRAPH_IMAGE_WRITE);
+            current = data.target;
+        }
+    }
+    return current;
+}
@@ -0,0 +1,141 @@
+/**
+ * Compute shader image filters working on RGBA8 images (image load/store):
+ * separable Gaussian blur, Sobel edge detection and colour grading.
+ *
+ * The stages of a pipeline are recorded into a compute queue and ping-pong
+ * between two RGBA8 images of the pipeline, so the source image is never
+ * written. Every pass works on LOCAL_SIZE_X x LOCAL_SIZE_Y tiles which are
+ * cached in shared memory with their apron (the blur radius along the axis
+ * of the pass, 1 pixel around the tile for Sobel), the pixels outside of the
+ * image are clamped to the edge.
+ *
+ * The images must be immutable textures (glTexStorage2D): the ES 3.1
+ * glBindImageTexture only accepts those, createFilterImage creates one.
+ *
+ * Usage:
+ *
+ *   ImageFilterPipeline filter;
+ *   initImageFilterPipeline(&filter, width, height);
+ *   imageFilterAddBlur(&filter, 4.0f);
+ *   imageFilterAddColorGrade(&filter, grade);
+ *
+ *   unsigned int result = imageFilterRecord(&filter, &queue, source);
+ *   computeQueueBarrier(&queue, GL_FRAMEBUFFER_BARRIER_BIT); // or GL_TEXTURE_FETCH_BARRIER_BIT, ...
+ *   computeQueueSubmit(&queue);
+ *
+ *   destroyImageFilterPipeline(&filter);
+ *
+ * Or as render graph passes (see render_graph.h): every pass writes its own
+ * transient texture, the graph places the barriers and aliases the textures.
+ *
+ *   int result = imageFilterAddToGraph(&filter, &graph, &queue, sourceResource);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.1+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_IMAGE_FILTER_H
+#define GLES_COMMON_IMAGE_FILTER_H
+
+#include <vector>
+
+#include "common/compute.h"
+#include "common/render_graph.h"
+
+// Largest blur radius in pixels (the size of the shared memory apron).
+#define IMAGE_FILTER_MAX_RADIUS 16
+
+enum ImageFilterType {
+    IMAGE_FILTER_BLUR,
+    IMAGE_FILTER_SOBEL,
+    IMAGE_FILTER_COLOR_GRADE,
+};
+
+// Applied in order: exposure, gain and lift, contrast, saturation, gamma.
+struct ColorGrade {
+    float exposure;   // in stops
+    float contrast;   // 1: unchanged, around the 0.5 mid point
+    float saturation; // 0: gray, 1: unchanged
+    float gamma;      // 1: unchanged
+    float lift[3];
+    float gain[3];
+};
+
+struct ImageFilterStage {
+    ImageFilterType type;
+    int radius;                  // blur radius in pixels
+    StorageBuffer<float> params; // blur weights or the colour grade (0 for Sobel)
+};
+
+struct ImageFilterPipeline;
+
+// User data of a render graph pass: one dispatch.
+struct ImageFilterGraphPass {
+    ImageFilterPipeline* filter;
+    const ComputeKernel* kernel;
+    int stage;
+    ComputeQueue* queue;
+    int source; // graph resources
+    int target;
+};
+
+struct ImageFilterPipeline {
+    ComputeKernel blurHorizontal;
+    ComputeKernel blurVertical;
+    ComputeKernel sobel;
+    ComputeKernel colorGrade;
+
+    int width;
+    int height;
+    unsigned int targets[2]; // RGBA8 ping-pong images
+
+    std::vector<ImageFilterStage> stages;
+    int passCount; // dispatches per run (a blur is 2)
+
+    std::vector<ImageFilterGraphPass> graphPasses; // imageFilterAddToGraph
+};
+
+// Create an immutable RGBA8 texture usable as a filter source (data can be NULL).
+unsigned int createFilterImage(int width, int height, const void* rgba);
+
+void initImageFilterPipeline(ImageFilterPipeline* filter, int width, int height);
+void destroyImageFilterPipeline(ImageFilterPipeline* filter);
+
+// Gaussian blur, the radius is 3 sigma (at most IMAGE_FILTER_MAX_RADIUS).
+void imageFilterAddBlur(ImageFilterPipeline* filter, float sigma);
+
+// Gradient magnitude of the luminance as a gray image.
+void imageFilterAddSobel(ImageFilterPipeline* filter);
+
+void imageFilterAddColorGrade(ImageFilterPipeline* filter, const ColorGrade& grade);
+
+// Record the stages reading "source" (an image of the pipeline's size), returns the image with the result.
+/* The result is "source" if there are no stages. The writes of the last pass still need a barrier for the reader. */
+unsigned int imageFilterRecord(ImageFilterPipeline* filter, ComputeQueue* queue, unsigned int source);
+
+// Add a pass per dispatch to the graph reading the "source" resource, returns the resource with the result.
+/* The passes record into the queue and submit it. The pass data is valid until the next call. */
+int imageFilterAddToGraph(ImageFilterPipeline* filter, RenderGraph* graph, ComputeQueue* queue, int source);
+
+#endif // GLES_COMMON_IMAGE_FILTER_H
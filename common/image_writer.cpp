@@ -0,0 +1,320 @@
+/**
+ * Image files of captured frames. See image_writer.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/image_writer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "thirdparty/glfw/deps/stb_image_write.h"
+
+#include "common/readback_convert.h"
+
+const char* imageFileFormatNames[IMAGE_FILE_FORMAT_COUNT] = {
+    "ppm", "png", "qoi", "raw",
+};
+
+bool parseImageFileFormat(const char* name, ImageFileFormat* format) {
+    for (int idx = 0; idx < IMAGE_FILE_FORMAT_COUNT; idx++) {
+        if (strcmp(name, imageFileFormatNames[idx]) == 0) {
+            *format = (ImageFileFormat)idx;
+            return true;
+        }
+    }
+
+    printf("Unknown image format '%s', valid formats:", name);
+    for (int idx = 0; idx < IMAGE_FILE_FORMAT_COUNT; idx++) {
+        printf(" %s", imageFileFormatNames[idx]);
+    }
+    printf("\n");
+    return false;
+}
+
+// The RGB rows top row first after "offset" bytes of the scratch buffer.
+static uint8_t* flipRGB(const uint8_t* pixels, int width, int height, size_t offset, std::vector<uint8_t>* rgb) {
+    rgb->resize(offset + (size_t)width * height * 3);
+    uint8_t* rows = rgb->data() + offset;
+    ReadbackConversion conversion = { width, height, READBACK_SOURCE_RGBA8, READBACK_RGB8, READBACK_ALPHA_KEEP, true, 0, 0 };
+    convertReadbackRows(&conversion, rows, pixels, 0, height);
+    return rows;
+}
+
+// QOI encoding of the RGB channels (alpha: 255) into the scratch buffer, returns the size.
+/* "top" is the first pixel of the top row, "rowStride" is negative for the bottom row first read backs. */
+static size_t encodeQOI(const uint8_t* top, int width, int height, ptrdiff_t rowStride, int pixelSize,
+                        std::vector<uint8_t>* out) {
+    // Q.1. The header: magic, big endian size, 3 channels, sRGB.
+    out->resize(14 + (size_t)width * height * 4 + 8);
+    uint8_t* dst = out->data();
+    size_t size = 0;
+    auto put32 = [&](uint32_t value) {
+        dst[size++] = (uint8_t)(value >> 24);
+        dst[size++] = (uint8_t)(value >> 16);
+        dst[size++] = (uint8_t)(value >> 8);
+        dst[size++] = (uint8_t)value;
+    };
+    memcpy(dst, "qoif", 4);
+    size = 4;
+    put32(width);
+    put32(height);
+    dst[size++] = 3;
+    dst[size++] = 0;
+
+    // Q.2. The pixels top row first: runs, the index of seen colors, small differences or the color.
+    uint32_t index[64] = { 0 };
+    uint8_t prev[3] = { 0, 0, 0 };
+    int run = 0;
+    for (int row = 0; row < height; row++) {
+        const uint8_t* src = top + row * rowStride;
+        for (int x = 0; x < width; x++) {
+            const uint8_t* px = src + x * pixelSize;
+            bool last = row == height - 1 && x == width - 1;
+            if (px[0] == prev[0] && px[1] == prev[1] && px[2] == prev[2]) {
+                run++;
+                if (run == 62 || last) {
+                    dst[size++] = (uint8_t)(0xc0 | (run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                dst[size++] = (uint8_t)(0xc0 | (run - 1));
+                run = 0;
+            }
+
+            uint32_t color = px[0] | (px[1] << 8) | (px[2] << 16) | 0xff000000u;
+            int hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + 255 * 11) % 64;
+            if (index[hash] == color) {
+                dst[size++] = (uint8_t)hash;
+            } else {
+                index[hash] = color;
+                int dr = (int8_t)(px[0] - prev[0]);
+                int dg = (int8_t)(px[1] - prev[1]);
+                int db = (int8_t)(px[2] - prev[2]);
+                int drg = dr - dg;
+                int dbg = db - dg;
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    dst[size++] = (uint8_t)(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+                } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+                    dst[size++] = (uint8_t)(0x80 | (dg + 32));
+                    dst[size++] = (uint8_t)(((drg + 8) << 4) | (dbg + 8));
+                } else {
+                    dst[size++] = 0xfe;
+                    dst[size++] = px[0];
+                    dst[size++] = px[1];
+                    dst[size++] = px[2];
+                }
+            }
+            memcpy(prev, px, 3);
+        }
+    }
+
+    // Q.3. The end marker.
+    static const uint8_t end[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    memcpy(dst + size, end, sizeof(end));
+    return size + sizeof(end);
+}
+
+// stb_image_write callback: append the PNG chunks to the output vector.
+static void appendPNG(void* context, void* data, int size) {
+    std::vector<uint8_t>* out = (std::vector<uint8_t>*)context;
+    out->insert(out->end(), (const uint8_t*)data, (const uint8_t*)data + size);
+}
+
+size_t encodeImage(ImageFileFormat format, const uint8_t* pixels, int width, int height, std::vector<uint8_t>* out) {
+    if (format == IMAGE_FILE_PNG) {
+        std::vector<uint8_t> rgb;
+        const uint8_t* rows = flipRGB(pixels, width, height, 0, &rgb);
+        out->clear();
+        stbi_write_png_to_func(appendPNG, out, width, height, 3, rows, width * 3);
+        return out->size();
+    }
+
+    // E.1. The header (PPM) followed by the rows, or the QOI stream.
+    if (format == IMAGE_FILE_QOI) {
+        const ptrdiff_t rowStride = (ptrdiff_t)width * 4;
+        return encodeQOI(pixels + (height - 1) * rowStride, width, height, -rowStride, 4, out);
+    }
+    char header[64] = "";
+    size_t headerSize = 0;
+    if (format == IMAGE_FILE_PPM) {
+        headerSize = snprintf(header, sizeof(header), "P6\n%d\n%d\n255\n", width, height);
+    }
+    flipRGB(pixels, width, height, headerSize, out);
+    memcpy(out->data(), header, headerSize);
+    return headerSize + (size_t)width * height * 3;
+}
+
+bool writeImageFile(const char* fileName, ImageFileFormat format, const uint8_t* pixels, int width, int height,
+                    std::vector<uint8_t>* rgb) {
+    if (format == IMAGE_FILE_PNG) {
+        /* stb_image_write opens the file and writes the whole PNG at once. */
+        const uint8_t* rows = flipRGB(pixels, width, height, 0, rgb);
+        return stbi_write_png(fileName, width, height, 3, rows, width * 3) != 0;
+    }
+
+    // W.1. The whole file in the scratch buffer.
+    size_t size = encodeImage(format, pixels, width, height, rgb);
+
+    // W.2. One write for the file.
+    FILE* file = fopen(fileName, "wb");
+    if (file == NULL) {
+        return false;
+    }
+    bool written = fwrite(rgb->data(), 1, size, file) == size;
+    return fclose(file) == 0 && written;
+}
+
+bool writeRGBImageFile(const char* fileName, ImageFileFormat format, const uint8_t* rgb, int width, int height,
+                       std::vector<uint8_t>* scratch) {
+    if (format == IMAGE_FILE_PNG) {
+        return stbi_write_png(fileName, width, height, 3, rgb, width * 3) != 0;
+    }
+
+    // R.1. QOI is encoded in the scratch buffer, PPM and raw write the header and the rows as they are.
+    const uint8_t* data = rgb;
+    size_t size = (size_t)width * height * 3;
+    char header[64] = "";
+    size_t headerSize = 0;
+    if (format == IMAGE_FILE_QOI) {
+        size = encodeQOI(rgb, width, height, (ptrdiff_t)width * 3, 3, scratch);
+        data = scratch->data();
+    } else if (format == IMAGE_FILE_PPM) {
+        headerSize = snprintf(header, sizeof(header), "P6\n%d\n%d\n255\n", width, height);
+    }
+
+    // R.2. The header and the pixels: without a copy of the frame.
+    FILE* file = fopen(fileName, "wb");
+    if (file == NULL) {
+        return false;
+    }
+    bool written = fwrite(header, 1, headerSize, file) == headerSize && fwrite(data, 1, size, file) == size;
+    return fclose(file) == 0 && written;
+}
+
+size_t imageInputFrameSize(ImageInput input, int width, int height) {
+    return (size_t)width * height * (input == IMAGE_INPUT_RGB ? 3 : 4);
+}
+
+ImageWriter::ImageWriter(int width, int height, ImageFileFormat format, int threadCount, const char* pattern,
+                         ImageInput input)
+    : m_width(width)
+    , m_height(height)
+    , m_format(format)
+    , m_input(input)
+    , m_pattern(pattern)
+    , m_first(0)
+    , m_count(0)
+    , m_finished(false)
+    , m_joined(false)
+    , m_busySeconds(0.0)
+{
+    // Two frames per writer thread (but at least 8) can wait in memory.
+    threadCount = std::max(threadCount, 1);
+    size_t poolSize = std::max(8, threadCount * 2);
+    size_t frameSize = imageInputFrameSize(input, width, height);
+    m_pixels.resize(poolSize * frameSize);
+    m_queue.resize(poolSize);
+    for (size_t idx = 0; idx < poolSize; idx++) {
+        m_free.push_back(&m_pixels[idx * frameSize]);
+    }
+    for (int idx = 0; idx < threadCount; idx++) {
+        m_threads.emplace_back(&ImageWriter::run, this);
+    }
+}
+
+ImageWriter::~ImageWriter() {
+    finish();
+}
+
+uint8_t* ImageWriter::acquire() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_queueSpace.wait(lock, [this] { return !m_free.empty(); });
+    uint8_t* pixels = m_free.back();
+    m_free.pop_back();
+    return pixels;
+}
+
+void ImageWriter::push(int frameIndex, uint8_t* pixels) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queue[(m_first + m_count) % m_queue.size()] = Frame{ frameIndex, pixels };
+    m_count++;
+    m_queueReady.notify_one();
+}
+
+void ImageWriter::finish() {
+    if (m_joined) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_finished = true;
+    }
+    m_queueReady.notify_all();
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+    m_joined = true;
+}
+
+void ImageWriter::run() {
+    std::vector<uint8_t> scratch; // conversion buffer of the thread
+    while (true) {
+        Frame frame;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_queueReady.wait(lock, [this] { return m_finished || m_count > 0; });
+            if (m_count == 0) {
+                return;
+            }
+            frame = m_queue[m_first];
+            m_first = (m_first + 1) % m_queue.size();
+            m_count--;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        char fileName[256];
+        snprintf(fileName, sizeof(fileName), m_pattern.c_str(), frame.index);
+        std::string path = std::string(fileName) + "." + imageFileFormatNames[m_format];
+        bool written = m_input == IMAGE_INPUT_RGB
+            ? writeRGBImageFile(path.c_str(), m_format, frame.pixels, m_width, m_height, &scratch)
+            : writeImageFile(path.c_str(), m_format, frame.pixels, m_width, m_height, &scratch);
+        if (!written) {
+            printf("Can not write '%s'\n", path.c_str());
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // Return the buffer to the pool.
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_free.push_back(frame.pixels);
+            m_busySeconds += seconds;
+        }
+        m_queueSpace.notify_one();
+    }
+}
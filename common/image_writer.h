@@ -0,0 +1,143 @@
+/**
+ * Image files of captured frames: PPM, PNG, QOI or raw RGB, written on worker threads.
+ *
+ * The frames are R8G8B8A8 read backs (bottom row first, as glReadPixels returns them).
+ * A frame is converted in one pass: the alpha is stripped with SIMD (see common/readback_convert.h)
+ * while the rows are reordered top row first, then the whole file is written with a single fwrite.
+ * With IMAGE_INPUT_RGB the frames are already converted (top row first RGB, ex.: straight from the
+ * mapped PBO on a job system): the writers only encode them, PPM and raw skip the copy too.
+ *
+ *   ImageWriter writer(width, height, IMAGE_FILE_QOI, 4, "out_%04d");
+ *   uint8_t* pixels = writer.acquire(); // a free frame buffer of the pool
+ *   ... copy the frame ...
+ *   writer.push(frameIndex, pixels);     // encoded and written by a worker: "out_0000.qoi"
+ *   writer.finish();
+ *
+ * The buffers are a fixed pool allocated up front: capturing a frame doesn't allocate, a
+ * buffer returns to the pool once it's written. PNG uses the vendored stb_image_write
+ * (zlib, slow but small), QOI is a fast lossless format (https://qoiformat.org).
+ *
+ * Dependencies:
+ *  * C++11
+ *  * stb_image_write (thirdparty/glfw/deps)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_IMAGE_WRITER_H
+#define GLES_COMMON_IMAGE_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum ImageFileFormat {
+    IMAGE_FILE_PPM, // binary PPM (P6)
+    IMAGE_FILE_PNG,
+    IMAGE_FILE_QOI,
+    IMAGE_FILE_RAW, // RGB bytes without a header
+    IMAGE_FILE_FORMAT_COUNT,
+};
+
+// "ppm", "png", "qoi", "raw": also the file extensions.
+extern const char* imageFileFormatNames[IMAGE_FILE_FORMAT_COUNT];
+
+// The format of a name. Returns false (and prints the valid names) for an unknown name.
+bool parseImageFileFormat(const char* name, ImageFileFormat* format);
+
+// The frames of an ImageWriter.
+enum ImageInput {
+    IMAGE_INPUT_READBACK, // R8G8B8A8, bottom row first
+    IMAGE_INPUT_RGB,      // R8G8B8, top row first
+};
+
+// Bytes of a width x height frame.
+size_t imageInputFrameSize(ImageInput input, int width, int height);
+
+// Write a width x height R8G8B8A8 image (bottom row first) into the file.
+/* "rgb" is a scratch buffer, it keeps its memory between the calls. */
+bool writeImageFile(const char* fileName, ImageFileFormat format, const uint8_t* pixels, int width, int height,
+                    std::vector<uint8_t>* rgb);
+
+// Write a width x height R8G8B8 image (top row first) into the file.
+/* "scratch" holds the QOI stream, the other formats write the pixels directly. */
+bool writeRGBImageFile(const char* fileName, ImageFileFormat format, const uint8_t* rgb, int width, int height,
+                       std::vector<uint8_t>* scratch);
+
+// Encode a width x height R8G8B8A8 image (bottom row first) in memory, returns the size of the data in "out".
+/* "out" may be larger than the returned size (it keeps its memory between the calls). */
+size_t encodeImage(ImageFileFormat format, const uint8_t* pixels, int width, int height, std::vector<uint8_t>* out);
+
+// Writes the captured frames on worker threads.
+class ImageWriter {
+public:
+    // "pattern": printf pattern of the file name for the frame index, without the extension.
+    ImageWriter(int width, int height, ImageFileFormat format, int threadCount, const char* pattern,
+                ImageInput input = IMAGE_INPUT_READBACK);
+    ~ImageWriter();
+
+    // A free frame buffer (imageInputFrameSize bytes) from the pool. Blocks if the writers are too far behind.
+    uint8_t* acquire();
+
+    // Queue a frame for writing, "pixels" is a buffer returned by acquire.
+    void push(int frameIndex, uint8_t* pixels);
+
+    // Write out every queued frame and stop the worker threads.
+    void finish();
+
+    // Seconds the workers spent converting and writing (summed over the threads).
+    double busySeconds() const { return m_busySeconds; }
+
+private:
+    struct Frame {
+        int index;
+        uint8_t* pixels;
+    };
+
+    void run();
+
+    int m_width;
+    int m_height;
+    ImageFileFormat m_format;
+    ImageInput m_input;
+    std::string m_pattern;
+
+    std::vector<uint8_t> m_pixels; // the frame buffers of the pool
+    std::vector<uint8_t*> m_free;
+    std::vector<Frame> m_queue;    // ring: the frames waiting for the writers
+    size_t m_first;
+    size_t m_count;
+    bool m_finished;
+    bool m_joined;
+    double m_busySeconds;
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_queueReady;
+    std::condition_variable m_queueSpace;
+};
+
+#endif // GLES_COMMON_IMAGE_WRITER_H
@@ -0,0 +1,367 @@
+/**
+ * Batched input, see input_queue.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/input_queue.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include <GLFW/glfw3.h>
+
+// Single producer, single consumer ring: the producer owns "head", the consumer owns "tail".
+struct InputRing {
+    std::vector<InputEvent> events; // power of two size
+    uint32_t mask;
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+    std::atomic<uint32_t> pushed;
+    std::atomic<uint32_t> dropped;
+};
+
+// The evdev absolute axes (ABS_CNT).
+static const int JOYSTICK_AXIS_COUNT = 64;
+
+struct JoystickDevice {
+    int fd;
+    std::string name;
+    int axisMin[JOYSTICK_AXIS_COUNT];
+    int axisMax[JOYSTICK_AXIS_COUNT];
+};
+
+struct InputQueue {
+    InputRing rings[INPUT_SOURCE_COUNT];
+
+    // Consumer side.
+    std::vector<InputEvent> pending[INPUT_SOURCE_COUNT];
+    std::vector<InputEvent> frameEvents;
+    long long delivered;
+    int drains;
+    int maxPerFrame;
+
+    // Joystick thread.
+    std::thread thread;
+    std::vector<JoystickDevice> joysticks;
+    int stopPipe[2];
+    std::atomic<bool> wake;
+};
+
+double inputQueueTime() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+bool inputQueuePush(InputQueue* input, InputSource source, const InputEvent& event) {
+    InputRing& ring = input->rings[source];
+    uint32_t head = ring.head.load(std::memory_order_relaxed);
+    uint32_t tail = ring.tail.load(std::memory_order_acquire);
+    if (head - tail > ring.mask) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    InputEvent& slot = ring.events[head & ring.mask];
+    slot = event;
+    if (slot.time == 0.0) {
+        slot.time = inputQueueTime();
+    }
+    slot.samples = 1;
+    ring.head.store(head + 1, std::memory_order_release);
+    ring.pushed.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+// Move the pushed events of the ring into "events" (in push order).
+static void takeRingEvents(InputRing* ring, std::vector<InputEvent>* events) {
+    uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint32_t head = ring->head.load(std::memory_order_acquire);
+    for (; tail != head; tail++) {
+        events->push_back(ring->events[tail & ring->mask]);
+    }
+    ring->tail.store(tail, std::memory_order_release);
+}
+
+// The motion events of the same kind merge, the key of the kind (-1: discrete event).
+static long long motionKey(const InputEvent& event) {
+    switch (event.type) {
+    case INPUT_CURSOR:
+    case INPUT_SCROLL:
+        return event.type;
+    case INPUT_JOYSTICK_AXIS:
+        return ((long long)(event.device + 1) << 32) | ((long long)event.code << 8) | event.type;
+    default:
+        return -1;
+    }
+}
+
+int inputQueueDrain(InputQueue* input, const InputEvent** events) {
+    // D.1. Take the events of every ring: each one is in time order already.
+    for (int source = 0; source < INPUT_SOURCE_COUNT; source++) {
+        input->pending[source].clear();
+        takeRingEvents(&input->rings[source], &input->pending[source]);
+    }
+
+    // D.2. Merge the sources in time order and coalesce the motion since the last discrete event.
+    /* A key or a button between two motions keeps both: the motion before it is the position of the press. */
+    input->frameEvents.clear();
+    std::map<long long, size_t> lastMotion;
+    size_t next[INPUT_SOURCE_COUNT] = { 0 };
+    while (true) {
+        int source = -1;
+        for (int idx = 0; idx < INPUT_SOURCE_COUNT; idx++) {
+            if (next[idx] < input->pending[idx].size()
+                && (source < 0 || input->pending[idx][next[idx]].time < input->pending[source][next[source]].time)) {
+                source = idx;
+            }
+        }
+        if (source < 0) {
+            break;
+        }
+        const InputEvent& event = input->pending[source][next[source]++];
+
+        long long key = motionKey(event);
+        if (key < 0) {
+            lastMotion.clear();
+            input->frameEvents.push_back(event);
+            continue;
+        }
+        std::map<long long, size_t>::iterator found = lastMotion.find(key);
+        if (found == lastMotion.end()) {
+            lastMotion[key] = input->frameEvents.size();
+            input->frameEvents.push_back(event);
+            continue;
+        }
+        InputEvent& merged = input->frameEvents[found->second];
+        if (event.type == INPUT_SCROLL) {
+            merged.x += event.x;
+            merged.y += event.y;
+        } else {
+            merged.x = event.x;
+            merged.y = event.y;
+        }
+        merged.time = event.time;
+        merged.samples += event.samples;
+    }
+
+    int count = (int)input->frameEvents.size();
+    input->delivered += count;
+    input->drains++;
+    input->maxPerFrame = std::max(input->maxPerFrame, count);
+    *events = input->frameEvents.data();
+    return count;
+}
+
+void inputQueueWakeEvents(InputQueue* input, bool wake) {
+    input->wake = wake;
+}
+
+#ifdef __linux__
+static bool testBit(const unsigned long* bits, int bit) {
+    const int bitsPerLong = 8 * sizeof(unsigned long);
+    return (bits[bit / bitsPerLong] >> (bit % bitsPerLong)) & 1;
+}
+
+// J.1. The evdev devices with joystick or gamepad buttons and absolute axes.
+static void openJoysticks(InputQueue* input) {
+    DIR* dir = opendir("/dev/input");
+    if (dir == NULL) {
+        return;
+    }
+    const int bitsPerLong = 8 * sizeof(unsigned long);
+    while (dirent* entry = readdir(dir)) {
+        if (strncmp(entry->d_name, "event", 5) != 0) {
+            continue;
+        }
+        std::string path = std::string("/dev/input/") + entry->d_name;
+        int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK);
+        if (fd < 0) {
+            continue;
+        }
+
+        unsigned long keyBits[(KEY_CNT + bitsPerLong - 1) / bitsPerLong] = { 0 };
+        unsigned long absBits[(ABS_CNT + bitsPerLong - 1) / bitsPerLong] = { 0 };
+        if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keyBits)), keyBits) < 0
+            || ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(absBits)), absBits) < 0
+            || !(testBit(keyBits, BTN_JOYSTICK) || testBit(keyBits, BTN_GAMEPAD)) || !testBit(absBits, ABS_X)) {
+            close(fd);
+            continue;
+        }
+
+        // The kernel timestamps on the steady clock of the event times.
+        int clock = CLOCK_MONOTONIC;
+        ioctl(fd, EVIOCSCLOCKID, &clock);
+
+        JoystickDevice device;
+        device.fd = fd;
+        char name[128] = "";
+        ioctl(fd, EVIOCGNAME(sizeof(name)), name);
+        device.name = name;
+        for (int axis = 0; axis < JOYSTICK_AXIS_COUNT; axis++) {
+            input_absinfo info;
+            bool known = testBit(absBits, axis) && ioctl(fd, EVIOCGABS(axis), &info) == 0;
+            device.axisMin[axis] = known ? info.minimum : -1;
+            device.axisMax[axis] = known ? info.maximum : 1;
+        }
+        input->joysticks.push_back(device);
+    }
+    closedir(dir);
+}
+
+// J.2. Read the kernel events of every joystick until the stop pipe is written.
+static void readJoysticks(InputQueue* input) {
+    std::vector<pollfd> fds;
+    for (const JoystickDevice& device : input->joysticks) {
+        fds.push_back({ device.fd, POLLIN, 0 });
+    }
+    fds.push_back({ input->stopPipe[0], POLLIN, 0 });
+
+    while (poll(fds.data(), fds.size(), -1) >= 0 && !(fds.back().revents & POLLIN)) {
+        bool pushed = false;
+        for (size_t idx = 0; idx + 1 < fds.size(); idx++) {
+            const JoystickDevice& device = input->joysticks[idx];
+            input_event raw[64];
+            ssize_t size;
+            while ((size = read(device.fd, raw, sizeof(raw))) > 0) {
+                for (size_t rawIdx = 0; rawIdx < size / sizeof(input_event); rawIdx++) {
+                    const input_event& ev = raw[rawIdx];
+                    InputEvent event = {};
+                    event.device = (int)idx;
+                    event.code = ev.code;
+                    event.time = ev.time.tv_sec + ev.time.tv_usec * 1e-6;
+                    if (ev.type == EV_ABS && ev.code < JOYSTICK_AXIS_COUNT) {
+                        int range = std::max(1, device.axisMax[ev.code] - device.axisMin[ev.code]);
+                        event.type = INPUT_JOYSTICK_AXIS;
+                        event.x = 2.0 * (ev.value - device.axisMin[ev.code]) / range - 1.0;
+                    } else if (ev.type == EV_KEY && ev.code >= BTN_MISC) {
+                        event.type = INPUT_JOYSTICK_BUTTON;
+                        event.action = ev.value != 0;
+                    } else {
+                        continue;
+                    }
+                    pushed |= inputQueuePush(input, INPUT_SOURCE_JOYSTICK, event);
+                }
+            }
+        }
+        if (pushed && input->wake) {
+            glfwPostEmptyEvent();
+        }
+    }
+}
+#endif
+
+InputQueue* createInputQueue(int capacity, bool joystickThread) {
+    InputQueue* input = new InputQueue();
+    int size = 1;
+    while (size < capacity) {
+        size *= 2;
+    }
+    for (int source = 0; source < INPUT_SOURCE_COUNT; source++) {
+        InputRing& ring = input->rings[source];
+        ring.events.resize(size);
+        ring.mask = (uint32_t)size - 1;
+        ring.head = 0;
+        ring.tail = 0;
+        ring.pushed = 0;
+        ring.dropped = 0;
+    }
+    input->delivered = 0;
+    input->drains = 0;
+    input->maxPerFrame = 0;
+    input->stopPipe[0] = -1;
+    input->stopPipe[1] = -1;
+    input->wake = false;
+
+#ifdef __linux__
+    if (joystickThread) {
+        openJoysticks(input);
+        if (input->joysticks.empty()) {
+            printf("Input: no joystick or gamepad in /dev/input (or no read permission)\n");
+        } else if (pipe(input->stopPipe) == 0) {
+            for (const JoystickDevice& device : input->joysticks) {
+                printf("Input: joystick thread reads '%s'\n", device.name.c_str());
+            }
+            input->thread = std::thread(readJoysticks, input);
+        }
+    }
+#else
+    if (joystickThread) {
+        printf("Input: the joystick thread needs Linux evdev\n");
+    }
+#endif
+    return input;
+}
+
+void destroyInputQueue(InputQueue* input) {
+    if (input == NULL) {
+        return;
+    }
+#ifdef __linux__
+    if (input->thread.joinable()) {
+        char stop = 1;
+        if (write(input->stopPipe[1], &stop, 1) == 1) {
+            input->thread.join();
+        } else {
+            input->thread.detach();
+        }
+    }
+    for (const JoystickDevice& device : input->joysticks) {
+        close(device.fd);
+    }
+    if (input->stopPipe[0] >= 0) {
+        close(input->stopPipe[0]);
+        close(input->stopPipe[1]);
+    }
+#endif
+    delete input;
+}
+
+void printInputStats(const InputQueue* input) {
+    long long pushed = 0;
+    long long dropped = 0;
+    for (int source = 0; source < INPUT_SOURCE_COUNT; source++) {
+        pushed += input->rings[source].pushed;
+        dropped += input->rings[source].dropped;
+    }
+    printf("Input: %lld events pushed, %lld delivered in %d frames (%lld coalesced), %lld dropped, "
+           "at most %d per frame\n", pushed, input->delivered, input->drains, pushed - input->delivered, dropped,
+           input->maxPerFrame);
+}
@@ -0,0 +1,112 @@
+/**
+ * Batched input: a lock-free event queue drained once per frame.
+ *
+ * The producers push the timestamped input events into single producer, single
+ * consumer rings (no lock, no allocation): the GLFW callbacks of the window
+ * (keys, mouse buttons, cursor motion, scroll) into one ring, the joystick
+ * thread into another. The render loop drains both once per frame
+ * (inputQueueDrain): the events are merged in time order and the motion is
+ * coalesced (the consecutive cursor positions and joystick axis values become
+ * the last one, the scroll offsets are summed, "samples" counts the merged
+ * events), the keys and the buttons are kept one by one. A 1000 Hz mouse
+ * costs one event per frame instead of a callback per report.
+ *
+ * The joystick thread (Linux) reads the evdev devices of the joysticks and the
+ * gamepads (/dev/input/event*), the raw kernel events with their timestamps:
+ * the joysticks are sampled at their own rate from a dedicated thread instead
+ * of being polled by the render loop. GLFW only handles the window events on
+ * the main thread; the thread wakes the idle loop with glfwPostEmptyEvent.
+ *
+ * The times are seconds of the steady (monotonic) clock. A full ring drops the
+ * new events and counts them.
+ *
+ * Usage:
+ *
+ *   InputQueue* input = createInputQueue(1024, true);
+ *   inputQueuePush(input, INPUT_SOURCE_WINDOW, event); // GLFW callback
+ *   ...
+ *   const InputEvent* events;
+ *   int count = inputQueueDrain(input, &events);      // once per frame
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Linux evdev (the joystick thread)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_INPUT_QUEUE_H
+#define GLES_COMMON_INPUT_QUEUE_H
+
+enum InputEventType {
+    INPUT_KEY,             // code: GLFW key, action: GLFW_PRESS/RELEASE/REPEAT, mods
+    INPUT_MOUSE_BUTTON,    // code: GLFW mouse button, action, mods
+    INPUT_CURSOR,          // x, y: the cursor position in screen coordinates (coalesced)
+    INPUT_SCROLL,          // x, y: the scroll offsets (coalesced: summed)
+    INPUT_JOYSTICK_AXIS,   // device, code: evdev ABS_* axis, x: [-1, 1] (coalesced per axis)
+    INPUT_JOYSTICK_BUTTON, // device, code: evdev BTN_* button, action: 1 pressed, 0 released
+};
+
+enum InputSource {
+    INPUT_SOURCE_WINDOW,   // the GLFW callbacks (the thread of glfwPollEvents)
+    INPUT_SOURCE_JOYSTICK, // the joystick thread
+    INPUT_SOURCE_COUNT,
+};
+
+struct InputEvent {
+    int type; // InputEventType
+    int device;
+    int code;
+    int action;
+    int mods;
+    double x;
+    double y;
+    double time;  // steady clock seconds
+    int samples;  // the pushed events merged into this one
+};
+
+struct InputQueue;
+
+// Create the rings ("capacity" events each) and start the joystick thread if requested.
+/* The joystick thread only runs if a joystick or a gamepad can be opened. */
+InputQueue* createInputQueue(int capacity, bool joystickThread);
+
+// Stop the joystick thread and release the queue.
+void destroyInputQueue(InputQueue* input);
+
+// Print the statistics: the pushed, delivered and dropped events, the events per frame.
+void printInputStats(const InputQueue* input);
+
+// The steady clock of the event times.
+double inputQueueTime();
+
+// Push an event of the source (only one thread per source), the time is set if it's 0.
+/* Returns false if the ring is full (the event is dropped). */
+bool inputQueuePush(InputQueue* input, InputSource source, const InputEvent& event);
+
+// Take every pushed event: merged in time order, the motion coalesced. Call it from one thread.
+/* The events are valid until the next call. */
+int inputQueueDrain(InputQueue* input, const InputEvent** events);
+
+// Call glfwPostEmptyEvent after the joystick events (wakes the event driven loop from the thread).
+void inputQueueWakeEvents(InputQueue* input, bool wake);
+
+#endif // GLES_COMMON_INPUT_QUEUE_H
@@ -0,0 +1,171 @@
+/**
+ * Work-stealing job system. See job_system.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/job_system.h"
+
+// Take a job from the back of the own queue or steal one from the front of an other queue.
+static bool takeJob(JobSystem* jobs, int self, Job* job) {
+    int queueCount = (int)jobs->queues.size();
+    for (int offset = 0; offset < queueCount; offset++) {
+        int idx = (self + offset) % queueCount;
+        JobQueue* queue = jobs->queues[idx];
+
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        if (queue->count == 0) {
+            continue;
+        }
+
+        if (offset == 0) {
+            *job = queue->jobs[(queue->first + queue->count - 1) % JOB_QUEUE_CAPACITY];
+        } else {
+            *job = queue->jobs[queue->first];
+            queue->first = (queue->first + 1) % JOB_QUEUE_CAPACITY;
+            jobs->stolenJobs++;
+        }
+        queue->count--;
+        jobs->queuedJobs--;
+        return true;
+    }
+    return false;
+}
+
+static void runJob(JobSystem* jobs, const Job& job) {
+    job.function(job.data, job.begin, job.end);
+    jobs->pendingJobs--;
+}
+
+static void workerMain(JobSystem* jobs, int self) {
+    while (true) {
+        Job job;
+        if (takeJob(jobs, self, &job)) {
+            runJob(jobs, job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(jobs->wakeMutex);
+        jobs->wake.wait(lock, [jobs] { return jobs->quit || jobs->queuedJobs > 0; });
+        if (jobs->quit) {
+            return;
+        }
+    }
+}
+
+void initJobSystem(JobSystem* jobs, int threadCount) {
+    if (threadCount <= 0) {
+        threadCount = (int)std::thread::hardware_concurrency();
+    }
+    if (threadCount <= 0) {
+        threadCount = 1;
+    }
+
+    jobs->threadCount = threadCount;
+    jobs->queuedJobs = 0;
+    jobs->pendingJobs = 0;
+    jobs->stolenJobs = 0;
+    jobs->quit = false;
+
+    for (int idx = 0; idx < threadCount; idx++) {
+        JobQueue* queue = new JobQueue();
+        queue->first = 0;
+        queue->count = 0;
+        jobs->queues.push_back(queue);
+    }
+    for (int idx = 1; idx < threadCount; idx++) {
+        jobs->workers.push_back(std::thread(workerMain, jobs, idx));
+    }
+}
+
+void destroyJobSystem(JobSystem* jobs) {
+    {
+        std::lock_guard<std::mutex> lock(jobs->wakeMutex);
+        jobs->quit = true;
+    }
+    jobs->wake.notify_all();
+
+    for (size_t idx = 0; idx < jobs->workers.size(); idx++) {
+        jobs->workers[idx].join();
+    }
+    jobs->workers.clear();
+
+    for (size_t idx = 0; idx < jobs->queues.size(); idx++) {
+        delete jobs->queues[idx];
+    }
+    jobs->queues.clear();
+}
+
+void jobSystemParallelFor(JobSystem* jobs, int count, int grainSize, JobFunction function, void* data) {
+    if (count <= 0) {
+        return;
+    }
+    if (grainSize < 1) {
+        grainSize = 1;
+    }
+
+    // 1. Single thread: no queues, no synchronization.
+    if (jobs->threadCount == 1) {
+        function(data, 0, count);
+        return;
+    }
+
+    // 2. Deal the ranges out to the queues (round-robin, so every thread starts with local work).
+    /* The counters are raised first: they never go below the number of jobs in the queues. */
+    int jobCount = (count + grainSize - 1) / grainSize;
+    jobs->pendingJobs += jobCount;
+    {
+        std::lock_guard<std::mutex> lock(jobs->wakeMutex);
+        jobs->queuedJobs += jobCount;
+    }
+    for (int idx = 0; idx < jobCount; idx++) {
+        Job job = { function, data, idx * grainSize, idx * grainSize + grainSize < count ? idx * grainSize + grainSize : count };
+
+        JobQueue* queue = jobs->queues[idx % jobs->threadCount];
+        bool queued = false;
+        {
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            if (queue->count < JOB_QUEUE_CAPACITY) {
+                queue->jobs[(queue->first + queue->count) % JOB_QUEUE_CAPACITY] = job;
+                queue->count++;
+                queued = true;
+            }
+        }
+
+        // 2.1. The queue is full: wake the workers for the queued jobs and run this one right away.
+        if (!queued) {
+            jobs->wake.notify_all();
+            jobs->queuedJobs--;
+            runJob(jobs, job);
+        }
+    }
+    jobs->wake.notify_all();
+
+    // 3. Work on the jobs until every job is done (the last ones may still run on other threads).
+    while (jobs->pendingJobs > 0) {
+        Job job;
+        if (takeJob(jobs, 0, &job)) {
+            runJob(jobs, job);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
@@ -0,0 +1,101 @@
+/**
+ * Small work-stealing job system for data parallel loops (ex.: transform updates).
+ *
+ * Every thread (the workers and the calling thread) owns a queue of jobs.
+ * jobSystemParallelFor splits the index range into jobs of "grainSize" items
+ * and deals them out to the queues. A thread takes the jobs of its own queue
+ * from the back and, when it runs out of work, steals from the front of the
+ * other queues. The calling thread works on the jobs too and returns when
+ * every job of the loop is finished.
+ *
+ * Usage:
+ *
+ *   JobSystem jobs;
+ *   initJobSystem(&jobs, 0);   // 0: one thread per CPU core
+ *   while (...) {
+ *       jobSystemParallelFor(&jobs, count, 256, updateRange, &data); // updateRange(&data, begin, end)
+ *   }
+ *   destroyJobSystem(&jobs);
+ *
+ * The jobs must not call jobSystemParallelFor (no nesting) and the loops must
+ * be started from one thread at a time.
+ *
+ * Dependencies:
+ *  * C++11 (std::thread)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_JOB_SYSTEM_H
+#define GLES_COMMON_JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef void (*JobFunction)(void* data, int begin, int end);
+
+struct Job {
+    JobFunction function;
+    void* data;
+    int begin;
+    int end;
+};
+
+// Jobs a queue can hold, a loop with more jobs runs the rest on the calling thread while they are dealt out.
+#define JOB_QUEUE_CAPACITY 256
+
+// Fixed ring of jobs: no heap allocation after the init.
+struct JobQueue {
+    std::mutex mutex;
+    Job jobs[JOB_QUEUE_CAPACITY];
+    int first; // index of the front job
+    int count;
+};
+
+struct JobSystem {
+    // Queue 0 belongs to the calling thread, queue N to the worker thread N - 1.
+    std::vector<JobQueue*> queues;
+    std::vector<std::thread> workers;
+    int threadCount;
+
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::atomic<int> queuedJobs;
+    std::atomic<int> pendingJobs;
+    bool quit;
+
+    // Statistics: jobs executed from an other thread's queue.
+    std::atomic<int> stolenJobs;
+};
+
+// Start the worker threads. "threadCount" includes the calling thread (0: one per CPU core).
+void initJobSystem(JobSystem* jobs, int threadCount);
+
+// Stop and join the worker threads.
+void destroyJobSystem(JobSystem* jobs);
+
+// Run function(data, begin, end) for [0, count) in ranges of at most grainSize items, waits for all of them.
+void jobSystemParallelFor(JobSystem* jobs, int count, int grainSize, JobFunction function, void* data);
+
+#endif // GLES_COMMON_JOB_SYSTEM_H
@@ -0,0 +1,149 @@
+/**
+ * Low latency frame mode: late input sampling, CPU frame limiter and
+ * input-to-swap latency measurement. See low_latency.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/low_latency.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <GLES3/gl3.h>
+
+struct LowLatency {
+    double periodMs; // 0: no frame limit
+    double nextFrameMs;
+
+    GLsync fence; // end of the previous frame's GPU work
+    double inputMs;
+    double fenceInputMs; // input time of the frame of the fence
+    bool inputSampled;
+
+    std::vector<double> inputToSwapMs;
+    std::vector<double> inputToGpuMs;
+    std::vector<double> waitMs;
+};
+
+static double nowMs() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+LowLatency* createLowLatency(double fpsLimit) {
+    LowLatency* lowLatency = new LowLatency();
+    lowLatency->periodMs = fpsLimit > 0.0 ? 1000.0 / fpsLimit : 0.0;
+    lowLatency->nextFrameMs = nowMs();
+    lowLatency->fence = NULL;
+    lowLatency->inputMs = 0.0;
+    lowLatency->fenceInputMs = 0.0;
+    lowLatency->inputSampled = false;
+
+    if (fpsLimit > 0.0) {
+        printf("Low latency mode: swap interval 0, frame limit: %.1f fps\n", fpsLimit);
+    } else {
+        printf("Low latency mode: swap interval 0, no frame limit\n");
+    }
+    return lowLatency;
+}
+
+void lowLatencyWaitForFrame(LowLatency* lowLatency) {
+    double startMs = nowMs();
+
+    // 1. The previous frame is done on the GPU: the new frame doesn't queue behind it.
+    if (lowLatency->fence != NULL) {
+        glClientWaitSync(lowLatency->fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(lowLatency->fence);
+        lowLatency->fence = NULL;
+        lowLatency->inputToGpuMs.push_back(nowMs() - lowLatency->fenceInputMs);
+    }
+
+    // 2. Frame limiter: sleep until the start of the next frame slot.
+    if (lowLatency->periodMs > 0.0) {
+        double now = nowMs();
+        if (now < lowLatency->nextFrameMs) {
+            std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(lowLatency->nextFrameMs - now));
+        }
+
+        /* A late frame starts a new schedule instead of rendering the missed slots back to back. */
+        lowLatency->nextFrameMs += lowLatency->periodMs;
+        if (lowLatency->nextFrameMs < now) {
+            lowLatency->nextFrameMs = now + lowLatency->periodMs;
+        }
+    }
+
+    lowLatency->waitMs.push_back(nowMs() - startMs);
+}
+
+void lowLatencyInputSampled(LowLatency* lowLatency) {
+    lowLatency->inputMs = nowMs();
+    lowLatency->inputSampled = true;
+}
+
+void lowLatencyAfterSwap(LowLatency* lowLatency) {
+    if (!lowLatency->inputSampled) {
+        return;
+    }
+
+    lowLatency->inputToSwapMs.push_back(nowMs() - lowLatency->inputMs);
+    lowLatency->inputSampled = false;
+
+    if (lowLatency->fence == NULL) {
+        lowLatency->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        lowLatency->fenceInputMs = lowLatency->inputMs;
+    }
+}
+
+// Value below which "fraction" of the sorted samples are.
+static double percentile(const std::vector<double>& sorted, double fraction) {
+    size_t idx = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[idx];
+}
+
+static void printRow(const char* name, std::vector<double> samples) {
+    if (samples.empty()) {
+        printf("  %-11s %9s\n", name, "n/a");
+        return;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    printf("  %-11s %9.3f %9.3f %9.3f %9.3f\n", name,
+           percentile(samples, 0.50), percentile(samples, 0.95), percentile(samples, 0.99), samples.back());
+}
+
+void destroyLowLatency(LowLatency* lowLatency) {
+    if (lowLatency->fence != NULL) {
+        glDeleteSync(lowLatency->fence);
+    }
+
+    printf("Latency (%zu frames, ms):\n", lowLatency->inputToSwapMs.size());
+    printf("  %-11s %9s %9s %9s %9s\n", "", "p50", "p95", "p99", "max");
+    printRow("input-swap", lowLatency->inputToSwapMs);
+    printRow("input-gpu", lowLatency->inputToGpuMs);
+    printRow("wait", lowLatency->waitMs);
+
+    delete lowLatency;
+}
@@ -0,0 +1,65 @@
+/**
+ * Low latency frame mode: late input sampling, CPU frame limiter and
+ * input-to-swap latency measurement.
+ *
+ * Enabled by the "--low-latency" option of the demo context. With vsync the
+ * input polled at the top of the render loop waits for the rendering and then
+ * for the next vblank, and the GPU queue can hold more frames: the input can be
+ * more than a frame old when it is presented. In the low latency mode:
+ *
+ *  * the swap interval is 0 (no vsync wait in the swap),
+ *  * demoPollEvents first waits for the GPU to finish the previous frame (fence)
+ *    and for the CPU frame limiter ("--fps-limit N", default: the refresh rate
+ *    of the monitor or 60), then polls the input: the frame is rendered right
+ *    after the input was sampled and never queues behind another frame,
+ *  * the time from the input sampling to the return of the swap ("input-swap")
+ *    and to the end of the GPU work ("input-gpu", an upper bound: the next
+ *    frame's fence wait observes it) are recorded for every frame and their
+ *    percentiles are printed when the context is destroyed.
+ *
+ * Without vsync the frames can tear, the limiter keeps the frame rate (and the
+ * power usage) at the display rate. See also demoAddSwapDamage for the partial
+ * presentation with EGL_KHR_swap_buffers_with_damage.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_LOW_LATENCY_H
+#define GLES_COMMON_LOW_LATENCY_H
+
+struct LowLatency;
+
+// Create the limiter with the target frame rate (0: no limit). Requires a current GL ES context.
+LowLatency* createLowLatency(double fpsLimit);
+
+// Print the latency summary and release the fence.
+void destroyLowLatency(LowLatency* lowLatency);
+
+// Wait for the previous frame's GPU work and for the frame limiter: call right before sampling the input.
+void lowLatencyWaitForFrame(LowLatency* lowLatency);
+
+// The input of the frame was sampled.
+void lowLatencyInputSampled(LowLatency* lowLatency);
+
+// Record the frame: call right after the buffer swap.
+void lowLatencyAfterSwap(LowLatency* lowLatency);
+
+#endif // GLES_COMMON_LOW_LATENCY_H
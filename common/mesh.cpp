@@ -0,0 +1,462 @@
+/**
+ * Indexed mesh helpers (CPU side), see mesh.h for the details.
+ * The GL buffer and VAO creation is in mesh_upload.cpp.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/mesh.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+
+// From the GLES3/gl3.h header: the CPU side is also built into the asset tools, which do not depend on GL.
+#define GL_UNSIGNED_SHORT 0x1403
+#define GL_UNSIGNED_INT 0x1405
+
+MeshData createIndexedMesh(const float* vertices, int vertexCount, int stride, int positionOffset, int texCoordOffset) {
+    MeshData mesh;
+    std::map<std::vector<float>, uint32_t> uniqueVertices;
+
+    for (int idx = 0; idx < vertexCount; idx++) {
+        const float* vertex = vertices + idx * stride;
+
+        std::vector<float> key(vertex + positionOffset, vertex + positionOffset + 3);
+        if (texCoordOffset >= 0) {
+            key.insert(key.end(), vertex + texCoordOffset, vertex + texCoordOffset + 2);
+        }
+
+        auto found = uniqueVertices.find(key);
+        if (found != uniqueVertices.end()) {
+            mesh.indices.push_back(found->second);
+            continue;
+        }
+
+        uint32_t index = (uint32_t)uniqueVertices.size();
+        uniqueVertices[key] = index;
+        mesh.indices.push_back(index);
+
+        mesh.positions.insert(mesh.positions.end(), key.begin(), key.begin() + 3);
+        if (texCoordOffset >= 0) {
+            mesh.texCoords.insert(mesh.texCoords.end(), key.begin() + 3, key.end());
+        }
+    }
+
+    return mesh;
+}
+
+// Size of the simulated LRU cache used for the scoring (the optimization works well for smaller real caches too).
+static const int optimizeCacheSize = 32;
+
+// Vertex score of the Forsyth algorithm: recently used vertices and vertices with few remaining triangles are preferred.
+static float vertexScore(int cachePosition, int remainingTriangles) {
+    if (remainingTriangles == 0) {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            // The vertices of the last triangle: fixed score to avoid favouring the same triangle strip direction.
+            score = 0.75f;
+        } else {
+            float scale = 1.0f / (optimizeCacheSize - 3);
+            score = powf(1.0f - (cachePosition - 3) * scale, 1.5f);
+        }
+    }
+
+    // Bonus for vertices with few triangles left, so lone triangles don't stay behind.
+    score += 2.0f * powf((float)remainingTriangles, -0.5f);
+    return score;
+}
+
+void optimizeTriangleOrder(std::vector<uint32_t>* indices, int vertexCount) {
+    int triangleCount = (int)indices->size() / 3;
+    const std::vector<uint32_t>& input = *indices;
+
+    // 1. Triangle adjacency for every vertex.
+    std::vector<int> remaining(vertexCount, 0);
+    for (uint32_t index : input) {
+        remaining[index]++;
+    }
+
+    std::vector<int> adjacencyStart(vertexCount + 1, 0);
+    for (int idx = 0; idx < vertexCount; idx++) {
+        adjacencyStart[idx + 1] = adjacencyStart[idx] + remaining[idx];
+    }
+
+    std::vector<int> adjacency(input.size());
+    {
+        std::vector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for (int triangle = 0; triangle < triangleCount; triangle++) {
+            for (int corner = 0; corner < 3; corner++) {
+                adjacency[fill[input[triangle * 3 + corner]]++] = triangle;
+            }
+        }
+    }
+
+    // 2. Initial scores.
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> scores(vertexCount);
+    for (int idx = 0; idx < vertexCount; idx++) {
+        scores[idx] = vertexScore(-1, remaining[idx]);
+    }
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (int triangle = 0; triangle < triangleCount; triangle++) {
+        triangleScores[triangle] = scores[input[triangle * 3]] + scores[input[triangle * 3 + 1]] + scores[input[triangle * 3 + 2]];
+    }
+
+    // 3. Emit the best triangle, update the cache and the scores of the touched vertices.
+    std::vector<uint32_t> output;
+    output.reserve(input.size());
+    std::vector<uint32_t> cache;
+
+    int bestTriangle = -1;
+    int scanPosition = 0;
+    for (int step = 0; step < triangleCount; step++) {
+        if (bestTriangle < 0) {
+            /* Nothing useful in the cache: take the best remaining triangle (linear scan). */
+            while (emitted[scanPosition]) {
+                scanPosition++;
+            }
+            bestTriangle = scanPosition;
+            for (int triangle = scanPosition; triangle < triangleCount; triangle++) {
+                if (!emitted[triangle] && triangleScores[triangle] > triangleScores[bestTriangle]) {
+                    bestTriangle = triangle;
+                }
+            }
+        }
+
+        emitted[bestTriangle] = true;
+        std::vector<uint32_t> newCache;
+        for (int corner = 0; corner < 3; corner++) {
+            uint32_t vertex = input[bestTriangle * 3 + corner];
+            output.push_back(vertex);
+            newCache.push_back(vertex);
+            remaining[vertex]--;
+
+            // Remove the emitted triangle from the vertex's adjacency list.
+            int* begin = adjacency.data() + adjacencyStart[vertex];
+            int* end = begin + remaining[vertex] + 1;
+            *std::find(begin, end, bestTriangle) = *(end - 1);
+        }
+
+        for (uint32_t vertex : cache) {
+            if (std::find(newCache.begin(), newCache.end(), vertex) == newCache.end()) {
+                newCache.push_back(vertex);
+            }
+        }
+
+        // Update the vertices in the cache (and the ones which just dropped out of it).
+        for (size_t position = 0; position < newCache.size(); position++) {
+            uint32_t vertex = newCache[position];
+            cachePosition[vertex] = position < (size_t)optimizeCacheSize ? (int)position : -1;
+            scores[vertex] = vertexScore(cachePosition[vertex], remaining[vertex]);
+        }
+
+        // Rescore the triangles of the touched vertices and select the next best one.
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (uint32_t vertex : newCache) {
+            for (int idx = 0; idx < remaining[vertex]; idx++) {
+                int triangle = adjacency[adjacencyStart[vertex] + idx];
+                float score = scores[input[triangle * 3]] + scores[input[triangle * 3 + 1]] + scores[input[triangle * 3 + 2]];
+                triangleScores[triangle] = score;
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestTriangle = triangle;
+                }
+            }
+        }
+
+        if (newCache.size() > (size_t)optimizeCacheSize) {
+            newCache.resize(optimizeCacheSize);
+        }
+        cache.swap(newCache);
+    }
+
+    indices->swap(output);
+}
+
+void optimizeMesh(MeshData* mesh) {
+    int vertexCount = (int)mesh->positions.size() / 3;
+    optimizeTriangleOrder(&mesh->indices, vertexCount);
+
+    // Reorder the vertices by first use: the vertex fetches follow the index order.
+    std::vector<int> remap(vertexCount, -1);
+    std::vector<float> positions;
+    std::vector<float> texCoords;
+    bool hasTexCoords = !mesh->texCoords.empty();
+
+    for (uint32_t& index : mesh->indices) {
+        if (remap[index] < 0) {
+            remap[index] = (int)positions.size() / 3;
+            positions.insert(positions.end(), &mesh->positions[index * 3], &mesh->positions[index * 3] + 3);
+            if (hasTexCoords) {
+                texCoords.insert(texCoords.end(), &mesh->texCoords[index * 2], &mesh->texCoords[index * 2] + 2);
+            }
+        }
+        index = remap[index];
+    }
+
+    mesh->positions.swap(positions);
+    mesh->texCoords.swap(texCoords);
+}
+
+float meshACMR(const MeshData& mesh, int cacheSize) {
+    std::vector<uint32_t> fifo;
+    int misses = 0;
+
+    for (uint32_t index : mesh.indices) {
+        if (std::find(fifo.begin(), fifo.end(), index) == fifo.end()) {
+            misses++;
+            fifo.push_back(index);
+            if ((int)fifo.size() > cacheSize) {
+                fifo.erase(fifo.begin());
+            }
+        }
+    }
+
+    return mesh.indices.empty() ? 0.0f : misses / (mesh.indices.size() / 3.0f);
+}
+
+MeshData createCubeMesh() {
+    static const float vertices[] = {
+        // positions          // texture coords
+        -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
+         0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
+         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
+        -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
+
+        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+         0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
+         0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
+         0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
+        -0.5f,  0.5f,  0.5f,  0.0f, 1.0f,
+        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+
+        -0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+        -0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+        -0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+
+         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+         0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+         0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+         0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+
+        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+         0.5f, -0.5f, -0.5f,  1.0f, 1.0f,
+         0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
+         0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
+        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+
+        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
+         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+        -0.5f,  0.5f,  0.5f,  0.0f, 0.0f,
+        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f
+    };
+
+    MeshData mesh = createIndexedMesh(vertices, 36, 3 + 2, 0, 3);
+    optimizeMesh(&mesh);
+    return mesh;
+}
+
+MeshData createGridMesh(int columns, int rows) {
+    MeshData mesh;
+    for (int y = 0; y <= rows; y++) {
+        for (int x = 0; x <= columns; x++) {
+            float u = (float)x / columns;
+            float v = (float)y / rows;
+            mesh.positions.push_back(u - 0.5f);
+            mesh.positions.push_back(v - 0.5f);
+            mesh.positions.push_back(0.0f);
+            mesh.texCoords.push_back(u);
+            mesh.texCoords.push_back(v);
+        }
+    }
+
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < columns; x++) {
+            uint32_t corner = y * (columns + 1) + x;
+            uint32_t quad[] = {
+                corner, corner + 1, corner + columns + 2,
+                corner + columns + 2, corner + columns + 1, corner,
+            };
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+
+    optimizeMesh(&mesh);
+    return mesh;
+}
+
+std::vector<WireframeVertex> expandWireframeMesh(const MeshData& mesh) {
+    std::vector<WireframeVertex> vertices(mesh.indices.size());
+    for (size_t idx = 0; idx < mesh.indices.size(); idx++) {
+        WireframeVertex& vertex = vertices[idx];
+        memcpy(vertex.position, &mesh.positions[mesh.indices[idx] * 3], sizeof(vertex.position));
+        memset(vertex.barycentric, 0, sizeof(vertex.barycentric));
+        vertex.barycentric[idx % 3] = 255;
+    }
+    return vertices;
+}
+
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent <= 0) {
+        return sign;
+    }
+    if (exponent >= 31) {
+        return sign | 0x7c00;
+    }
+    // Round to nearest, a mantissa overflow correctly carries into the exponent.
+    return sign | (uint16_t)(((exponent << 10) | (mantissa >> 13)) + ((mantissa >> 12) & 1));
+}
+
+// Write the position or the texture coords of a vertex in the upload format.
+static void writePosition(uint8_t* dst, const MeshData& mesh, int idx, bool packed) {
+    if (packed) {
+        // half4 position (w = 1.0).
+        uint16_t* position = (uint16_t*)dst;
+        for (int c = 0; c < 3; c++) {
+            position[c] = floatToHalf(mesh.positions[idx * 3 + c]);
+        }
+        position[3] = floatToHalf(1.0f);
+    } else {
+        memcpy(dst, &mesh.positions[idx * 3], 3 * sizeof(float));
+    }
+}
+
+static void writeTexCoord(uint8_t* dst, const MeshData& mesh, int idx, bool packed) {
+    bool hasTexCoords = !mesh.texCoords.empty();
+    for (int c = 0; c < 2; c++) {
+        float uv = hasTexCoords ? mesh.texCoords[idx * 2 + c] : 0.0f;
+        if (packed) {
+            // unorm16x2 texture coords.
+            ((uint16_t*)dst)[c] = (uint16_t)(std::min(std::max(uv, 0.0f), 1.0f) * 65535.0f + 0.5f);
+        } else {
+            ((float*)dst)[c] = uv;
+        }
+    }
+}
+
+MeshStreams packMesh(const MeshData& mesh, bool packed, MeshLayout layout,
+                     std::vector<uint8_t>* vertexData, std::vector<uint8_t>* indexData) {
+    MeshStreams streams;
+    int vertexCount = (int)mesh.positions.size() / 3;
+    streams.vertexCount = vertexCount;
+    streams.packed = packed;
+    streams.layout = layout;
+
+    // 1. Place the streams in the buffer: the offsets and strides of the attributes.
+    int positionSize = packed ? 4 * sizeof(uint16_t) : 3 * sizeof(float);
+    int texCoordSize = packed ? 2 * sizeof(uint16_t) : 2 * sizeof(float);
+    int vertexSize = positionSize + texCoordSize;
+
+    streams.positionOffset = 0;
+    streams.positionStride = vertexSize;
+    streams.texCoordOffset = positionSize;
+    streams.texCoordStride = vertexSize;
+    size_t bufferSize = (size_t)vertexCount * vertexSize;
+    if (layout == MESH_LAYOUT_PLANAR) {
+        streams.positionStride = positionSize;
+        streams.texCoordOffset = vertexCount * positionSize;
+        streams.texCoordStride = texCoordSize;
+    }
+
+    // The stream read by the depth-only passes.
+    streams.depthOffset = streams.positionOffset;
+    streams.depthStride = streams.positionStride;
+    if (layout == MESH_LAYOUT_POSITION_STREAM) {
+        streams.depthOffset = bufferSize;
+        streams.depthStride = positionSize;
+        bufferSize += (size_t)vertexCount * positionSize;
+    }
+    streams.vertexBufferSize = bufferSize;
+
+    // 2. Write the vertex data in the requested format.
+    vertexData->assign(bufferSize, 0);
+    for (int idx = 0; idx < vertexCount; idx++) {
+        writePosition(&(*vertexData)[streams.positionOffset + idx * streams.positionStride], mesh, idx, packed);
+        writeTexCoord(&(*vertexData)[streams.texCoordOffset + idx * streams.texCoordStride], mesh, idx, packed);
+        if (streams.depthOffset != streams.positionOffset) {
+            writePosition(&(*vertexData)[streams.depthOffset + idx * streams.depthStride], mesh, idx, packed);
+        }
+    }
+
+    // 3. 16 bit indices are enough for most meshes and halve the index fetches.
+    if (vertexCount <= 65536) {
+        streams.indexType = GL_UNSIGNED_SHORT;
+        indexData->resize(mesh.indices.size() * sizeof(uint16_t));
+        for (size_t idx = 0; idx < mesh.indices.size(); idx++) {
+            ((uint16_t*)indexData->data())[idx] = (uint16_t)mesh.indices[idx];
+        }
+    } else {
+        streams.indexType = GL_UNSIGNED_INT;
+        indexData->resize(mesh.indices.size() * sizeof(uint32_t));
+        memcpy(indexData->data(), mesh.indices.data(), indexData->size());
+    }
+    streams.indexCount = mesh.indices.size();
+    streams.indexBufferSize = indexData->size();
+
+    return streams;
+}
+
+const char* meshLayoutName(MeshLayout layout) {
+    switch (layout) {
+        case MESH_LAYOUT_INTERLEAVED: return "interleaved";
+        case MESH_LAYOUT_PLANAR: return "planar";
+        case MESH_LAYOUT_POSITION_STREAM: return "position-stream";
+    }
+    return "unknown";
+}
+
+bool parseMeshLayout(const char* name, MeshLayout* layout) {
+    const MeshLayout layouts[] = { MESH_LAYOUT_INTERLEAVED, MESH_LAYOUT_PLANAR, MESH_LAYOUT_POSITION_STREAM };
+    for (MeshLayout candidate : layouts) {
+        if (strcmp(name, meshLayoutName(candidate)) == 0) {
+            *layout = candidate;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,159 @@
+/**
+ * Indexed mesh helpers: vertex deduplication, vertex cache optimization and
+ * optional packed vertex formats.
+ *
+ * A mesh is built from an expanded (non-indexed) triangle list: identical
+ * vertices are merged and an index buffer is created. The triangle order is
+ * then optimized for the post-transform vertex cache (Tom Forsyth's
+ * "Linear-Speed Vertex Cache Optimisation") and the vertices are reordered
+ * by their first use, so the vertex fetches are mostly sequential.
+ *
+ * Vertex formats for the upload:
+ *  * default: position: 3 x float, texture coords: 2 x float (20 bytes)
+ *  * packed:  position: 4 x half float, texture coords: 2 x normalized
+ *             unsigned short (12 bytes). The texture coords must be in [0, 1].
+ *
+ * Vertex stream layouts (all streams are stored in the same buffer object):
+ *  * interleaved:     one stream with the position and the texture coords.
+ *  * planar:          one stream per attribute.
+ *  * position stream: the interleaved stream and a copy of the positions in a
+ *                     separate, tightly packed stream.
+ * The layout is selected per pass with the two VAOs of the mesh: "vao" has every
+ * attribute, "positionVao" only the position. The depth-only passes use the
+ * "positionVao" which fetches only the positions in the planar and position
+ * stream layouts, the interleaved layout reads the whole vertex with a stride.
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_MESH_H
+#define GLES_COMMON_MESH_H
+
+#include <stdint.h>
+
+#include <vector>
+
+struct MeshData {
+    std::vector<float> positions; // 3 floats per vertex
+    std::vector<float> texCoords; // 2 floats per vertex (empty if there are no texture coords)
+    std::vector<uint32_t> indices; // triangle list
+};
+
+enum MeshLayout {
+    MESH_LAYOUT_INTERLEAVED,
+    MESH_LAYOUT_PLANAR,
+    MESH_LAYOUT_POSITION_STREAM,
+};
+
+// Placement of the vertex streams and the indices, as written by packMesh.
+/* Fixed size fields: stored as is in the asset bundles (see common/asset_bundle.h). */
+struct MeshStreams {
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexType;
+    uint32_t packed;
+    uint32_t layout;           // MeshLayout
+    uint32_t vertexBufferSize; // in bytes, every stream included
+    uint32_t indexBufferSize;
+    uint32_t positionOffset;
+    uint32_t positionStride;
+    uint32_t texCoordOffset;
+    uint32_t texCoordStride;
+    uint32_t depthOffset;      // position stream of the "positionVao"
+    uint32_t depthStride;
+};
+
+struct MeshBuffers {
+    unsigned int vao;         // every attribute
+    unsigned int positionVao; // only the position, for the depth-only passes
+    unsigned int vbo;
+    unsigned int ibo;
+    int indexCount;
+    unsigned int indexType; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, based on the vertex count
+    MeshLayout layout;
+    int vertexBufferSize;   // in bytes, every stream included
+};
+
+// Build an indexed mesh from an expanded triangle list.
+/* "stride" is in floats, "texCoordOffset" is -1 if the vertices have no texture coords. */
+MeshData createIndexedMesh(const float* vertices, int vertexCount, int stride, int positionOffset, int texCoordOffset);
+
+// Reorder the triangles for the vertex cache and the vertices by their first use.
+void optimizeMesh(MeshData* mesh);
+
+// Reorder only the triangles for the vertex cache (ex.: index buffers which share the vertices, see mesh_lod.h).
+void optimizeTriangleOrder(std::vector<uint32_t>* indices, int vertexCount);
+
+// Average number of vertex shader invocations per triangle with a FIFO cache of "cacheSize" entries.
+/* ACMR, 0.5 is the theoretical best for large regular meshes, 3.0 is the worst. */
+float meshACMR(const MeshData& mesh, int cacheSize);
+
+// Unit cube (-0.5 .. 0.5) with per face texture coords, indexed and optimized.
+MeshData createCubeMesh();
+
+// Grid of columns x rows quads in the XY plane (-0.5 .. 0.5), texture coords: 0 .. 1.
+/* Built row by row and optimized as the cube, for vertex fetch measurements with large meshes. */
+MeshData createGridMesh(int columns, int rows);
+
+// Vertex of the single pass wireframe: each triangle has its own 3 vertices (16 bytes).
+/* The barycentric coords are normalized unsigned bytes, one of the first 3 is 255 (the 4th is padding). */
+struct WireframeVertex {
+    float position[3];
+    uint8_t barycentric[4];
+};
+
+// Expand the indexed triangles into unshared vertices with barycentric coords.
+/* Works for any index buffer: the distance to the edges is interpolated from the barycentric coords,
+ * which can't be assigned to shared vertices in general. */
+std::vector<WireframeVertex> expandWireframeMesh(const MeshData& mesh);
+
+// Convert a float to IEEE half float (values too small for a normal half become 0).
+/* Used by the packed format and the texture coords of the quantized meshes (see mesh_quantize.h). */
+uint16_t floatToHalf(float value);
+
+// Write the vertex streams and the indices of the mesh in the upload format.
+MeshStreams packMesh(const MeshData& mesh, bool packed, MeshLayout layout,
+                     std::vector<uint8_t>* vertexData, std::vector<uint8_t>* indexData);
+
+// Create the VAOs with VBO and IBO from packed data (ex.: straight from a mapped asset bundle).
+MeshBuffers uploadPackedMesh(const MeshStreams& streams, const void* vertexData, const void* indexData,
+                             int positionLoc, int texCoordLoc);
+
+// Upload the mesh into a VAO with VBO and IBO. Attribute locations of -1 are skipped.
+/* Same as uploadMeshLayout with MESH_LAYOUT_INTERLEAVED. */
+MeshBuffers uploadMesh(const MeshData& mesh, bool packed, int positionLoc, int texCoordLoc);
+
+// Upload the mesh into the VAOs with VBO and IBO in the selected stream layout.
+MeshBuffers uploadMeshLayout(const MeshData& mesh, bool packed, MeshLayout layout, int positionLoc, int texCoordLoc);
+
+// Name of the layout for the command line options ("interleaved", "planar", "position-stream").
+const char* meshLayoutName(MeshLayout layout);
+
+// Parse a layout name, returns false for an unknown name.
+bool parseMeshLayout(const char* name, MeshLayout* layout);
+
+void destroyMeshBuffers(MeshBuffers* buffers);
+
+#endif // GLES_COMMON_MESH_H
@@ -0,0 +1,365 @@
+/**
+ * Level of detail chains for indexed meshes.
+ * See mesh_lod.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/mesh_lod.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <tuple>
+
+// Symmetric 4x4 matrix of the squared plane distances (a00 a01 a02 a03 a11 a12 a13 a22 a23 a33) and the plane weights.
+struct Quadric {
+    double a[10];
+    double weight;
+};
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+};
+
+static void addQuadric(Quadric* dst, const Quadric& src) {
+    for (int idx = 0; idx < 10; idx++) {
+        dst->a[idx] += src.a[idx];
+    }
+    dst->weight += src.weight;
+}
+
+// Plane n.x + d = 0 with weight w.
+static void addPlane(Quadric* q, const double n[3], double d, double w) {
+    q->a[0] += w * n[0] * n[0];
+    q->a[1] += w * n[0] * n[1];
+    q->a[2] += w * n[0] * n[2];
+    q->a[3] += w * n[0] * d;
+    q->a[4] += w * n[1] * n[1];
+    q->a[5] += w * n[1] * n[2];
+    q->a[6] += w * n[1] * d;
+    q->a[7] += w * n[2] * n[2];
+    q->a[8] += w * n[2] * d;
+    q->a[9] += w * d * d;
+    q->weight += w;
+}
+
+// Weighted mean of the squared distances of the point from the planes.
+static double quadricError(const Quadric& q, const float* p) {
+    double x = p[0], y = p[1], z = p[2];
+    double error = q.a[0] * x * x + 2.0 * q.a[1] * x * y + 2.0 * q.a[2] * x * z + 2.0 * q.a[3] * x
+                 + q.a[4] * y * y + 2.0 * q.a[5] * y * z + 2.0 * q.a[6] * y
+                 + q.a[7] * z * z + 2.0 * q.a[8] * z
+                 + q.a[9];
+    return q.weight > 0.0 ? fabs(error) / q.weight : 0.0;
+}
+
+static void triangleNormal(const float* p0, const float* p1, const float* p2, double n[3]) {
+    double e1[3] = { (double)p1[0] - p0[0], (double)p1[1] - p0[1], (double)p1[2] - p0[2] };
+    double e2[3] = { (double)p2[0] - p0[0], (double)p2[1] - p0[1], (double)p2[2] - p0[2] };
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+// Positions on a 1e-5 grid: the key of the vertices which are merged or treated as the same point.
+static std::tuple<long, long, long> positionKey(const float* p) {
+    return std::make_tuple(lround(p[0] * 1e5), lround(p[1] * 1e5), lround(p[2] * 1e5));
+}
+
+MeshData weldMeshPositions(const MeshData& mesh) {
+    MeshData welded;
+    std::map<std::tuple<long, long, long>, uint32_t> uniquePositions;
+    std::vector<uint32_t> remap(mesh.positions.size() / 3);
+    for (size_t idx = 0; idx < remap.size(); idx++) {
+        const float* p = &mesh.positions[idx * 3];
+        auto inserted = uniquePositions.insert(std::make_pair(positionKey(p), (uint32_t)(welded.positions.size() / 3)));
+        if (inserted.second) {
+            welded.positions.insert(welded.positions.end(), p, p + 3);
+        }
+        remap[idx] = inserted.first->second;
+    }
+
+    // The triangles which became degenerate (ex.: at the poles of a sphere) are dropped.
+    for (size_t idx = 0; idx + 2 < mesh.indices.size(); idx += 3) {
+        uint32_t a = remap[mesh.indices[idx]], b = remap[mesh.indices[idx + 1]], c = remap[mesh.indices[idx + 2]];
+        if (a != b && b != c && a != c) {
+            welded.indices.push_back(a);
+            welded.indices.push_back(b);
+            welded.indices.push_back(c);
+        }
+    }
+
+    optimizeMesh(&welded);
+    return welded;
+}
+
+std::vector<uint32_t> simplifyMesh(const MeshData& mesh, size_t targetIndexCount, float* error) {
+    int vertexCount = (int)mesh.positions.size() / 3;
+    const float* positions = mesh.positions.data();
+    std::vector<uint32_t> indices = mesh.indices;
+    double maxCost = 0.0;
+
+    // 1. Lock the vertices of the attribute seams and the borders.
+    std::vector<char> locked(vertexCount, 0);
+    {
+        std::map<std::tuple<long, long, long>, int> firstVertex;
+        for (int idx = 0; idx < vertexCount; idx++) {
+            auto inserted = firstVertex.insert(std::make_pair(positionKey(&positions[idx * 3]), idx));
+            if (!inserted.second) {
+                locked[idx] = 1;
+                locked[inserted.first->second] = 1;
+            }
+        }
+
+        /* A directed edge without its reverse is on the border. */
+        std::set<uint64_t> edges;
+        for (size_t idx = 0; idx < indices.size(); idx += 3) {
+            for (int e = 0; e < 3; e++) {
+                edges.insert((uint64_t)indices[idx + e] << 32 | indices[idx + (e + 1) % 3]);
+            }
+        }
+        for (uint64_t edge : edges) {
+            uint32_t a = (uint32_t)(edge >> 32), b = (uint32_t)edge;
+            if (edges.count((uint64_t)b << 32 | a) == 0) {
+                locked[a] = locked[b] = 1;
+            }
+        }
+    }
+
+    // 2. Quadrics of the triangle planes, weighted by the triangle areas.
+    std::vector<Quadric> quadrics(vertexCount);
+    memset(quadrics.data(), 0, quadrics.size() * sizeof(Quadric));
+    for (size_t idx = 0; idx < indices.size(); idx += 3) {
+        const float* p0 = &positions[indices[idx] * 3];
+        double n[3];
+        triangleNormal(p0, &positions[indices[idx + 1] * 3], &positions[indices[idx + 2] * 3], n);
+        double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0) {
+            continue;
+        }
+        n[0] /= length;
+        n[1] /= length;
+        n[2] /= length;
+        double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+        for (int c = 0; c < 3; c++) {
+            addPlane(&quadrics[indices[idx + c]], n, d, length * 0.5);
+        }
+    }
+
+    // 3. Collapse passes: the cheapest edges first, each vertex is changed once per pass.
+    targetIndexCount -= targetIndexCount % 3;
+    while (indices.size() > targetIndexCount) {
+        size_t triangleCount = indices.size() / 3;
+
+        // 3.1. Triangle adjacency of the vertices.
+        std::vector<int> adjacencyStart(vertexCount + 1, 0);
+        for (uint32_t index : indices) {
+            adjacencyStart[index + 1]++;
+        }
+        for (int idx = 0; idx < vertexCount; idx++) {
+            adjacencyStart[idx + 1] += adjacencyStart[idx];
+        }
+        std::vector<int> adjacency(indices.size());
+        {
+            std::vector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+            for (size_t idx = 0; idx < indices.size(); idx++) {
+                adjacency[fill[indices[idx]]++] = (int)(idx / 3);
+            }
+        }
+
+        // 3.2. Both directions of every edge, the cost is the error of the merged quadrics at the kept vertex.
+        std::vector<Collapse> collapses;
+        for (size_t idx = 0; idx < indices.size(); idx++) {
+            uint32_t from = indices[idx];
+            uint32_t to = indices[idx - idx % 3 + (idx % 3 + 1) % 3];
+            for (int dir = 0; dir < 2; dir++) {
+                if (!locked[from]) {
+                    Quadric merged = quadrics[from];
+                    addQuadric(&merged, quadrics[to]);
+                    collapses.push_back({ from, to, quadricError(merged, &positions[to * 3]) });
+                }
+                std::swap(from, to);
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(),
+                  [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+        // 3.3. Collapse the edges which keep the surface manifold and don't flip a triangle.
+        size_t removeCount = (indices.size() - targetIndexCount) / 3;
+        size_t removed = 0;
+        std::vector<char> touched(vertexCount, 0);
+        std::vector<char> dead(triangleCount, 0);
+        for (const Collapse& collapse : collapses) {
+            if (removed >= removeCount) {
+                break;
+            }
+            uint32_t from = collapse.from;
+            uint32_t to = collapse.to;
+            if (touched[from] || touched[to]) {
+                continue;
+            }
+
+            // Link condition: the common neighbours are exactly the opposite vertices of the shared triangles.
+            std::set<uint32_t> fromNeighbours;
+            std::set<uint32_t> toNeighbours;
+            int sharedCount = 0;
+            bool valid = true;
+            for (int a = adjacencyStart[from]; a < adjacencyStart[from + 1] && valid; a++) {
+                const uint32_t* triangle = &indices[adjacency[a] * 3];
+                bool shared = triangle[0] == to || triangle[1] == to || triangle[2] == to;
+                sharedCount += shared;
+                for (int c = 0; c < 3; c++) {
+                    fromNeighbours.insert(triangle[c]);
+                }
+                if (shared) {
+                    continue;
+                }
+
+                // The triangle keeps its facing with the kept vertex (at most ~80 degrees of rotation).
+                const float* p[3];
+                const float* q[3];
+                for (int c = 0; c < 3; c++) {
+                    p[c] = &positions[triangle[c] * 3];
+                    q[c] = triangle[c] == from ? &positions[to * 3] : p[c];
+                }
+                double before[3], after[3];
+                triangleNormal(p[0], p[1], p[2], before);
+                triangleNormal(q[0], q[1], q[2], after);
+                double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+                double lengths = sqrt((before[0] * before[0] + before[1] * before[1] + before[2] * before[2])
+                                    * (after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+                valid = dot > 0.2 * lengths;
+            }
+            for (int a = adjacencyStart[to]; a < adjacencyStart[to + 1]; a++) {
+                const uint32_t* triangle = &indices[adjacency[a] * 3];
+                for (int c = 0; c < 3; c++) {
+                    toNeighbours.insert(triangle[c]);
+                }
+            }
+            int commonCount = 0;
+            for (uint32_t vertex : fromNeighbours) {
+                commonCount += vertex != from && vertex != to && toNeighbours.count(vertex);
+            }
+            if (!valid || sharedCount == 0 || commonCount != sharedCount) {
+                continue;
+            }
+
+            // Move the triangles of "from" to "to", the shared ones become degenerate.
+            for (int a = adjacencyStart[from]; a < adjacencyStart[from + 1]; a++) {
+                uint32_t* triangle = &indices[adjacency[a] * 3];
+                for (int c = 0; c < 3; c++) {
+                    touched[triangle[c]] = 1;
+                    if (triangle[c] == from) {
+                        triangle[c] = to;
+                    }
+                }
+                if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2]) {
+                    dead[adjacency[a]] = 1;
+                    removed++;
+                }
+            }
+            addQuadric(&quadrics[to], quadrics[from]);
+            maxCost = std::max(maxCost, collapse.cost);
+        }
+
+        if (removed == 0) {
+            break;
+        }
+
+        // 3.4. Drop the collapsed triangles.
+        size_t writeIdx = 0;
+        for (size_t idx = 0; idx < triangleCount; idx++) {
+            if (!dead[idx]) {
+                memmove(&indices[writeIdx], &indices[idx * 3], 3 * sizeof(uint32_t));
+                writeIdx += 3;
+            }
+        }
+        indices.resize(writeIdx);
+    }
+
+    *error = (float)sqrt(maxCost);
+    return indices;
+}
+
+MeshLodChain buildMeshLods(MeshData* mesh, int levelCount, float ratio) {
+    MeshLodChain chain;
+    memset(&chain, 0, sizeof(chain));
+    int vertexCount = (int)mesh->positions.size() / 3;
+    for (int idx = 0; idx < vertexCount; idx++) {
+        const float* p = &mesh->positions[idx * 3];
+        chain.radius = std::max(chain.radius, sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]));
+    }
+
+    // 1. Level 0 is the mesh itself, the others are simplified from it with decreasing targets.
+    std::vector<uint32_t> levels = mesh->indices;
+    chain.levels[0].indexCount = (uint32_t)mesh->indices.size();
+    chain.levelCount = 1;
+
+    size_t target = mesh->indices.size();
+    levelCount = std::min(levelCount, MESH_LOD_MAX_LEVELS);
+    while ((int)chain.levelCount < levelCount) {
+        const MeshLod& previous = chain.levels[chain.levelCount - 1];
+        target = (size_t)(target / 3 * ratio) * 3;
+        if (target < 3) {
+            break;
+        }
+
+        float error = 0.0f;
+        std::vector<uint32_t> indices = simplifyMesh(*mesh, target, &error);
+        if (indices.size() >= previous.indexCount) {
+            break;
+        }
+        optimizeTriangleOrder(&indices, vertexCount);
+
+        // 2. The levels are placed one after the other, the error never decreases along the chain.
+        MeshLod& level = chain.levels[chain.levelCount++];
+        level.firstIndex = (uint32_t)levels.size();
+        level.indexCount = (uint32_t)indices.size();
+        level.error = std::max(error, previous.error);
+        levels.insert(levels.end(), indices.begin(), indices.end());
+    }
+
+    mesh->indices.swap(levels);
+    return chain;
+}
+
+float meshLodProjectionScale(const float* projection, int viewportHeight) {
+    return projection[5] * viewportHeight * 0.5f;
+}
+
+int selectMeshLod(const MeshLodChain& chain, float scale, float depth, float projectionScale, float maxErrorPixels) {
+    if (depth <= 0.0f) {
+        return 0;
+    }
+
+    float pixelsPerUnit = scale * projectionScale / depth;
+    int level = 0;
+    while (level + 1 < (int)chain.levelCount && chain.levels[level + 1].error * pixelsPerUnit <= maxErrorPixels) {
+        level++;
+    }
+    return level;
+}
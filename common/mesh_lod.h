@@ -0,0 +1,110 @@
+/**
+ * Level of detail chains for indexed meshes: offline simplification and the
+ * per instance level selection from the projected screen size.
+ *
+ * The simplified levels are built with quadric error metric edge collapses
+ * (Garland-Heckbert). Every collapse moves a vertex onto one of its
+ * neighbours (half edge collapse), so no vertex is created or moved: all the
+ * levels index the vertices of the full detail mesh and only the index
+ * buffer grows. The levels are stored one after the other in the index
+ * buffer of the mesh, a level is drawn with its index range:
+ *
+ *   MeshData sphere = weldMeshPositions(...);
+ *   MeshLodChain lods = buildMeshLods(&sphere, MESH_LOD_MAX_LEVELS, 0.5f);
+ *   MeshBuffers buffers = uploadMesh(sphere, false, 0, -1);
+ *   ...
+ *   float projectionScale = meshLodProjectionScale(glm::value_ptr(projection), height);
+ *   int level = selectMeshLod(lods, instanceScale, viewDepth, projectionScale, 1.0f);
+ *   glDrawElements(GL_TRIANGLES, lods.levels[level].indexCount, buffers.indexType,
+ *                  (void*)(lods.levels[level].firstIndex * indexSize));
+ *
+ * The vertices of the borders (edges with one triangle) and of the attribute
+ * seams (vertices at the same position with different texture coords) are
+ * locked, weldMeshPositions removes the seams of the meshes without textures.
+ *
+ * The error of a level is the distance from the full detail surface in mesh
+ * units. A level is selected if its error projected to the screen is below
+ * a pixel limit: the projected size of the instance decides the level, the
+ * small and distant instances use the coarse levels, so the number of
+ * triangles drawn follows the covered screen area rather than the instance
+ * count.
+ *
+ * The simplification runs on the CPU only (it is built into the offline
+ * "tools/asset_bundle" packer, the "--lods N" option).
+ *
+ * Dependencies:
+ *  * C++11
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_MESH_LOD_H
+#define GLES_COMMON_MESH_LOD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "common/mesh.h"
+
+#define MESH_LOD_MAX_LEVELS 8
+
+struct MeshLod {
+    uint32_t firstIndex; // in the index buffer of the mesh
+    uint32_t indexCount;
+    float error;         // distance from the full detail surface (mesh units)
+    uint32_t reserved;
+};
+
+// The levels of a mesh, finest first (also the layout of the mesh LOD assets, see asset_bundle.h).
+struct MeshLodChain {
+    uint32_t levelCount;
+    float radius; // bounding sphere around the origin of the mesh
+    uint32_t reserved[2];
+    MeshLod levels[MESH_LOD_MAX_LEVELS];
+};
+
+// Copy of the mesh without texture coords, the vertices at the same position are merged.
+/* Positions closer than 1e-5 are merged (ex.: the seam of a UV sphere). The result is optimized. */
+MeshData weldMeshPositions(const MeshData& mesh);
+
+// Simplify the triangles of the mesh to at most "targetIndexCount" indices with edge collapses.
+/* Returns the new index buffer (of the same vertices) and its error in "error". The result can
+ * be larger than the target if no more edge can be collapsed without flipping a triangle. */
+std::vector<uint32_t> simplifyMesh(const MeshData& mesh, size_t targetIndexCount, float* error);
+
+// Replace the indices of the mesh with "levelCount" levels, each with "ratio" of the triangles of the previous one.
+/* Level 0 is the original index buffer. The chain stops early when a level can't be simplified
+ * further. The triangles of every level are optimized for the vertex cache. */
+MeshLodChain buildMeshLods(MeshData* mesh, int levelCount, float ratio);
+
+// Pixels per mesh unit at one unit of view depth: the projection (column major 4x4) scaled to the viewport.
+/* For glm::perspective(fovy, ...) it is viewportHeight / (2 * tan(fovy / 2)). */
+float meshLodProjectionScale(const float* projection, int viewportHeight);
+
+// The coarsest level whose error is at most "maxErrorPixels" on the screen.
+/* "scale" is the scale of the instance and "depth" its distance along the view direction (the w of
+ * the clip coords). The projected radius of the instance in pixels is
+ * radius * scale * projectionScale / depth, the error of the levels is projected the same way. */
+int selectMeshLod(const MeshLodChain& chain, float scale, float depth, float projectionScale, float maxErrorPixels);
+
+#endif // GLES_COMMON_MESH_LOD_H
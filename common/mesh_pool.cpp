@@ -0,0 +1,181 @@
+/**
+ * Mesh pool for vertex pulling, see mesh_pool.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/mesh_pool.h"
+
+#include <string.h>
+
+#include <GLES3/gl31.h>
+
+#include "common/gpu_memory.h"
+#include "common/mesh_quantize.h"
+
+const char* meshPoolFetchSrc = R"(
+struct PoolMesh {
+    uvec4 range; // first vertex, first index word, index count, 16 bit indices
+    vec4 boundsMin;
+    vec4 boundsSize;
+};
+
+layout(std430, binding = 0) readonly buffer PoolVertices { uint poolVertices[]; };
+layout(std430, binding = 1) readonly buffer PoolIndices { uint poolIndices[]; };
+layout(std430, binding = 2) readonly buffer PoolMeshes { PoolMesh poolMeshes[]; };
+
+struct PooledVertex {
+    vec3 position;
+    vec3 normal;
+    vec2 texCoord;
+};
+
+uint pooledIndexCount(uint meshId) {
+    return poolMeshes[meshId].range.z;
+}
+
+PooledVertex fetchPooledVertex(uint meshId, uint corner) {
+    PoolMesh mesh = poolMeshes[meshId];
+
+    uint index;
+    if (mesh.range.w != 0u) {
+        uint word = poolIndices[mesh.range.y + corner / 2u];
+        index = (corner & 1u) != 0u ? word >> 16 : word & 0xffffu;
+    } else {
+        index = poolIndices[mesh.range.y + corner];
+    }
+
+    // QuantizedVertex: position unorm16 x 3, normal snorm8 x 2, texture coords half x 2.
+    uint base = (mesh.range.x + index) * 3u;
+    uint word0 = poolVertices[base];
+    uint word1 = poolVertices[base + 1u];
+    uint word2 = poolVertices[base + 2u];
+
+    PooledVertex vertex;
+    vec3 quantized = vec3(unpackUnorm2x16(word0), float(word1 & 0xffffu) / 65535.0);
+    vertex.position = mesh.boundsMin.xyz + quantized * mesh.boundsSize.xyz;
+    vertex.normal = octahedralDecode(unpackSnorm4x8(word1).zw);
+    vertex.texCoord = unpackHalf2x16(word2);
+    return vertex;
+}
+)";
+
+bool meshPoolSupported(int extraBlocks) {
+    int maxBlocks = 0;
+    glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &maxBlocks);
+    return maxBlocks >= MESH_POOL_BINDING_COUNT + extraBlocks;
+}
+
+void initMeshPool(MeshPool* pool) {
+    pool->vertexWords.clear();
+    pool->indexWords.clear();
+    pool->meshes.clear();
+    pool->maxIndexCount = 0;
+    pool->vertexCount = 0;
+    pool->vertexBuffer = 0;
+    pool->indexBuffer = 0;
+    pool->meshBuffer = 0;
+}
+
+int addPoolMesh(MeshPool* pool, const QuantizedMesh& mesh) {
+    static_assert(sizeof(QuantizedVertex) == 3 * sizeof(uint32_t), "the shader reads 3 uints per vertex");
+
+    MeshPoolEntry entry = {};
+    entry.firstVertex = (uint32_t)pool->vertexCount;
+    entry.firstIndexWord = (uint32_t)pool->indexWords.size();
+    entry.indexCount = (uint32_t)mesh.indices.size();
+    entry.index16 = mesh.vertices.size() <= 65536 ? 1 : 0;
+    for (int axis = 0; axis < 3; axis++) {
+        entry.boundsMin[axis] = mesh.boundsMin[axis];
+        entry.boundsSize[axis] = mesh.boundsSize[axis];
+    }
+
+    // 1. The vertices as is: the shader decodes the same bits as the quantized vertex attributes.
+    size_t vertexWord = pool->vertexWords.size();
+    pool->vertexWords.resize(vertexWord + mesh.vertices.size() * 3);
+    memcpy(&pool->vertexWords[vertexWord], mesh.vertices.data(), mesh.vertices.size() * sizeof(QuantizedVertex));
+
+    // 2. The indices stay relative to the mesh, in the low half of the word first.
+    if (entry.index16) {
+        for (size_t idx = 0; idx < mesh.indices.size(); idx += 2) {
+            uint32_t high = idx + 1 < mesh.indices.size() ? mesh.indices[idx + 1] : 0;
+            pool->indexWords.push_back(mesh.indices[idx] | (high << 16));
+        }
+    } else {
+        pool->indexWords.insert(pool->indexWords.end(), mesh.indices.begin(), mesh.indices.end());
+    }
+
+    pool->vertexCount += (int)mesh.vertices.size();
+    if ((int)entry.indexCount > pool->maxIndexCount) {
+        pool->maxIndexCount = (int)entry.indexCount;
+    }
+    pool->meshes.push_back(entry);
+    return (int)pool->meshes.size() - 1;
+}
+
+static unsigned int createStorageBuffer(const void* data, size_t size, const char* label) {
+    unsigned int buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_STATIC_DRAW);
+    gpuMemoryTrackBuffer(buffer, size, GPU_MEMORY_VERTEX, label);
+    return buffer;
+}
+
+void uploadMeshPool(MeshPool* pool) {
+    // An empty buffer can't be bound to a storage binding (the size must be > 0).
+    uint32_t placeholder = 0;
+    pool->vertexBuffer = createStorageBuffer(pool->vertexWords.empty() ? &placeholder : pool->vertexWords.data(),
+                                             pool->vertexWords.empty() ? 4 : pool->vertexWords.size() * 4,
+                                             "mesh pool vertices");
+    pool->indexBuffer = createStorageBuffer(pool->indexWords.empty() ? &placeholder : pool->indexWords.data(),
+                                            pool->indexWords.empty() ? 4 : pool->indexWords.size() * 4,
+                                            "mesh pool indices");
+    pool->meshBuffer = createStorageBuffer(pool->meshes.empty() ? (const void*)&placeholder : pool->meshes.data(),
+                                           pool->meshes.empty() ? 4 : pool->meshes.size() * sizeof(MeshPoolEntry),
+                                           "mesh pool table");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    std::vector<uint32_t>().swap(pool->vertexWords);
+    std::vector<uint32_t>().swap(pool->indexWords);
+}
+
+void bindMeshPool(const MeshPool* pool) {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_POOL_VERTEX_BINDING, pool->vertexBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_POOL_INDEX_BINDING, pool->indexBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_POOL_MESH_BINDING, pool->meshBuffer);
+}
+
+std::string meshPoolShaderSource(const char* source) {
+    // The functions after the precision statement (the line of the first "precision").
+    std::string result = source;
+    size_t precision = result.find("precision");
+    size_t lineEnd = precision != std::string::npos ? result.find('\n', precision) : result.find('\n');
+    result.insert(lineEnd + 1, std::string(octahedralDecodeSrc) + meshPoolFetchSrc);
+    return result;
+}
+
+void destroyMeshPool(MeshPool* pool) {
+    const unsigned int buffers[] = { pool->vertexBuffer, pool->indexBuffer, pool->meshBuffer };
+    glDeleteBuffers(3, buffers);
+    gpuMemoryReleaseBuffers(3, buffers);
+    initMeshPool(pool);
+}
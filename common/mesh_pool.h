@@ -0,0 +1,128 @@
+/**
+ * Mesh pool for vertex pulling: many meshes in shared storage buffers, fetched by the vertex shader.
+ *
+ * The fixed function vertex fetch needs a VAO (or at least an attribute setup)
+ * per vertex format and buffer: every mesh change between the draws switches
+ * the VAO and the draws of different meshes can't be merged. The pool appends
+ * the quantized meshes (see mesh_quantize.h) into three shader storage
+ * buffers shared by every mesh:
+ *  * vertices: the 12 byte QuantizedVertex as 3 uints,
+ *  * indices:  relative to the first vertex of the mesh, 2 x 16 bits per uint if
+ *              the mesh has at most 65536 vertices, 32 bits otherwise,
+ *  * meshes:   the first vertex, the first index word, the index count, the index
+ *              size and the dequantization bounds of every mesh.
+ * The vertex shader decodes the vertex itself (fetchPooledVertex): a
+ * non-indexed draw of "indexCount" vertices walks the index buffer of the
+ * mesh with gl_VertexID. The draws use no vertex attribute at all: any mesh
+ * can be drawn in any draw without a state change, an instanced draw can even
+ * draw a different mesh per instance (padded to the largest index count, the
+ * extra vertices are discarded by the shader).
+ *
+ * The cost: the indices are read by the shader instead of the index fetch
+ * hardware and the post-transform vertex cache is not used (every corner of
+ * every triangle runs the vertex shader).
+ *
+ * Usage:
+ *
+ *   MeshPool pool;
+ *   initMeshPool(&pool);
+ *   int cubeId = addPoolMesh(&pool, quantizeMesh(cube, computeMeshNormals(cube)));
+ *   uploadMeshPool(&pool);
+ *   // the vertex shader source: fetchPooledVertex(meshId, uint(gl_VertexID))
+ *   program = createCachedProgram(meshPoolShaderSource(vertex_src).c_str(), fragment_src);
+ *   bindMeshPool(&pool);
+ *   glDrawArrays(GL_TRIANGLES, 0, pool.meshes[cubeId].indexCount);
+ *   destroyMeshPool(&pool);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.1+ with shader storage blocks in the vertex shader
+ *    (GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS can be 0)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_MESH_POOL_H
+#define GLES_COMMON_MESH_POOL_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+struct QuantizedMesh;
+
+// Shader storage binding points of the pool, the demos can use the next ones.
+static const int MESH_POOL_VERTEX_BINDING = 0;
+static const int MESH_POOL_INDEX_BINDING = 1;
+static const int MESH_POOL_MESH_BINDING = 2;
+static const int MESH_POOL_BINDING_COUNT = 3;
+
+// An entry of the mesh table (std430, as read by the shader).
+struct MeshPoolEntry {
+    uint32_t firstVertex;    // in vertices
+    uint32_t firstIndexWord; // in uints of the index buffer
+    uint32_t indexCount;
+    uint32_t index16;        // 1: two 16 bit indices per uint
+    float boundsMin[4];
+    float boundsSize[4];
+};
+
+struct MeshPool {
+    // CPU copy until uploadMeshPool.
+    std::vector<uint32_t> vertexWords;
+    std::vector<uint32_t> indexWords;
+
+    std::vector<MeshPoolEntry> meshes;
+    int maxIndexCount;
+    int vertexCount;
+
+    unsigned int vertexBuffer;
+    unsigned int indexBuffer;
+    unsigned int meshBuffer;
+};
+
+// The vertex shader has at least MESH_POOL_BINDING_COUNT + "extraBlocks" shader storage blocks.
+bool meshPoolSupported(int extraBlocks);
+
+void initMeshPool(MeshPool* pool);
+
+// Append the mesh to the pool, returns its index in "meshes". Call before uploadMeshPool.
+int addPoolMesh(MeshPool* pool, const QuantizedMesh& mesh);
+
+// Create the storage buffers and free the CPU copy.
+void uploadMeshPool(MeshPool* pool);
+
+// Bind the buffers to the MESH_POOL_*_BINDING points.
+void bindMeshPool(const MeshPool* pool);
+
+// GLSL of the vertex fetch for the vertex shaders (ES 3.1):
+/*   struct PooledVertex { vec3 position; vec3 normal; vec2 texCoord; };
+ *   uint pooledIndexCount(uint meshId);
+ *   PooledVertex fetchPooledVertex(uint meshId, uint corner);  corner: position in the index buffer */
+extern const char* meshPoolFetchSrc;
+
+// The vertex shader with octahedralDecodeSrc and meshPoolFetchSrc after its first precision statement.
+std::string meshPoolShaderSource(const char* source);
+
+void destroyMeshPool(MeshPool* pool);
+
+#endif // GLES_COMMON_MESH_POOL_H
@@ -0,0 +1,278 @@
+/**
+ * Quantized vertex format. See mesh_quantize.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/mesh_quantize.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <GLES3/gl3.h>
+
+#include "common/gpu_memory.h"
+
+const char* octahedralDecodeSrc = R"(
+vec3 octahedralDecode(vec2 encoded) {
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    // The lower hemisphere is folded over the diagonals of the square.
+    float fold = max(-normal.z, 0.0);
+    normal.xy += vec2(normal.x >= 0.0 ? -fold : fold, normal.y >= 0.0 ? -fold : fold);
+    return normalize(normal);
+}
+)";
+
+static float signNotZero(float value) {
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+static void octahedralEncode(const float normal[3], int8_t encoded[2]) {
+    // 1. Project onto the octahedron |x| + |y| + |z| = 1, fold the lower half to the outer triangles.
+    float length = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+    float x = normal[0] / length;
+    float y = normal[1] / length;
+    if (normal[2] < 0.0f) {
+        float foldedX = (1.0f - fabsf(y)) * signNotZero(x);
+        float foldedY = (1.0f - fabsf(x)) * signNotZero(y);
+        x = foldedX;
+        y = foldedY;
+    }
+
+    // 2. snorm8: the GL decodes max(c / 127, -1).
+    encoded[0] = (int8_t)lrintf(std::min(std::max(x, -1.0f), 1.0f) * 127.0f);
+    encoded[1] = (int8_t)lrintf(std::min(std::max(y, -1.0f), 1.0f) * 127.0f);
+}
+
+// The C++ version of octahedralDecodeSrc, for the error measurement.
+static void octahedralDecode(const int8_t encoded[2], float normal[3]) {
+    float x = std::max(encoded[0] / 127.0f, -1.0f);
+    float y = std::max(encoded[1] / 127.0f, -1.0f);
+    float z = 1.0f - fabsf(x) - fabsf(y);
+    float fold = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -fold : fold;
+    y += y >= 0.0f ? -fold : fold;
+
+    float length = sqrtf(x * x + y * y + z * z);
+    normal[0] = x / length;
+    normal[1] = y / length;
+    normal[2] = z / length;
+}
+
+std::vector<float> computeMeshNormals(const MeshData& mesh) {
+    int vertexCount = (int)mesh.positions.size() / 3;
+    std::vector<float> normals(vertexCount * 3, 0.0f);
+
+    // 1. The cross product of two edges: its length is twice the area of the triangle.
+    for (size_t idx = 0; idx + 2 < mesh.indices.size(); idx += 3) {
+        const float* p0 = &mesh.positions[mesh.indices[idx] * 3];
+        const float* p1 = &mesh.positions[mesh.indices[idx + 1] * 3];
+        const float* p2 = &mesh.positions[mesh.indices[idx + 2] * 3];
+        float edge1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        float edge2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        float normal[3] = {
+            edge1[1] * edge2[2] - edge1[2] * edge2[1],
+            edge1[2] * edge2[0] - edge1[0] * edge2[2],
+            edge1[0] * edge2[1] - edge1[1] * edge2[0],
+        };
+        for (int corner = 0; corner < 3; corner++) {
+            float* sum = &normals[mesh.indices[idx + corner] * 3];
+            sum[0] += normal[0];
+            sum[1] += normal[1];
+            sum[2] += normal[2];
+        }
+    }
+
+    // 2. Normalize the sums.
+    for (int idx = 0; idx < vertexCount; idx++) {
+        float* normal = &normals[idx * 3];
+        float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (length > 0.0f) {
+            normal[0] /= length;
+            normal[1] /= length;
+            normal[2] /= length;
+        } else {
+            normal[0] = 0.0f;
+            normal[1] = 0.0f;
+            normal[2] = 1.0f;
+        }
+    }
+    return normals;
+}
+
+QuantizedMesh quantizeMesh(const MeshData& mesh, const std::vector<float>& normals) {
+    QuantizedMesh result;
+    int vertexCount = (int)mesh.positions.size() / 3;
+    result.indices = mesh.indices;
+    result.vertices.resize(vertexCount);
+    result.maxPositionError = 0.0f;
+    result.maxNormalError = 0.0f;
+
+    // 1. Bounds of the positions.
+    for (int c = 0; c < 3; c++) {
+        float minimum = vertexCount ? mesh.positions[c] : 0.0f;
+        float maximum = minimum;
+        for (int idx = 1; idx < vertexCount; idx++) {
+            minimum = std::min(minimum, mesh.positions[idx * 3 + c]);
+            maximum = std::max(maximum, mesh.positions[idx * 3 + c]);
+        }
+        result.boundsMin[c] = minimum;
+        result.boundsSize[c] = maximum > minimum ? maximum - minimum : 1.0f;
+    }
+
+    // 2. Quantize every vertex and measure the error of the decoded values.
+    bool hasTexCoords = !mesh.texCoords.empty();
+    for (int idx = 0; idx < vertexCount; idx++) {
+        QuantizedVertex& vertex = result.vertices[idx];
+        const float* position = &mesh.positions[idx * 3];
+
+        float distance = 0.0f;
+        for (int c = 0; c < 3; c++) {
+            float relative = (position[c] - result.boundsMin[c]) / result.boundsSize[c];
+            vertex.position[c] = (uint16_t)lrintf(std::min(std::max(relative, 0.0f), 1.0f) * 65535.0f);
+
+            float decoded = result.boundsMin[c] + vertex.position[c] / 65535.0f * result.boundsSize[c];
+            distance += (decoded - position[c]) * (decoded - position[c]);
+        }
+        result.maxPositionError = std::max(result.maxPositionError, sqrtf(distance));
+
+        const float* normal = &normals[idx * 3];
+        octahedralEncode(normal, vertex.normal);
+        float decoded[3];
+        octahedralDecode(vertex.normal, decoded);
+        float cosine = decoded[0] * normal[0] + decoded[1] * normal[1] + decoded[2] * normal[2];
+        float angle = acosf(std::min(std::max(cosine, -1.0f), 1.0f)) * 180.0f / (float)M_PI;
+        result.maxNormalError = std::max(result.maxNormalError, angle);
+
+        for (int c = 0; c < 2; c++) {
+            vertex.texCoord[c] = floatToHalf(hasTexCoords ? mesh.texCoords[idx * 2 + c] : 0.0f);
+        }
+    }
+    return result;
+}
+
+void meshDequantizationMatrix(const QuantizedMesh& mesh, float matrix[16]) {
+    memset(matrix, 0, 16 * sizeof(float));
+    for (int c = 0; c < 3; c++) {
+        matrix[c * 4 + c] = mesh.boundsSize[c];
+        matrix[12 + c] = mesh.boundsMin[c];
+    }
+    matrix[15] = 1.0f;
+}
+
+// Create the VAOs and the buffers, the element buffer binding is part of the VAO state.
+static void createMeshBuffers(MeshBuffers* buffers, const void* vertexData, int vertexBufferSize,
+                              const std::vector<uint32_t>& indices, int vertexCount) {
+    buffers->layout = MESH_LAYOUT_INTERLEAVED;
+    buffers->indexCount = (int)indices.size();
+    buffers->vertexBufferSize = vertexBufferSize;
+
+    glGenVertexArrays(1, &buffers->vao);
+    glGenVertexArrays(1, &buffers->positionVao);
+    glBindVertexArray(buffers->vao);
+
+    glGenBuffers(1, &buffers->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers->vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertexBufferSize, vertexData, GL_STATIC_DRAW);
+    gpuMemoryTrackBuffer(buffers->vbo, vertexBufferSize, GPU_MEMORY_VERTEX, "quantized mesh vertices");
+
+    glGenBuffers(1, &buffers->ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers->ibo);
+    if (vertexCount <= 65536) {
+        std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+        buffers->indexType = GL_UNSIGNED_SHORT;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(uint16_t), shortIndices.data(),
+                     GL_STATIC_DRAW);
+        gpuMemoryTrackBuffer(buffers->ibo, shortIndices.size() * sizeof(uint16_t), GPU_MEMORY_VERTEX,
+                             "quantized mesh indices");
+    } else {
+        buffers->indexType = GL_UNSIGNED_INT;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+        gpuMemoryTrackBuffer(buffers->ibo, indices.size() * sizeof(uint32_t), GPU_MEMORY_VERTEX,
+                             "quantized mesh indices");
+    }
+
+    glBindVertexArray(buffers->positionVao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers->ibo);
+    glBindVertexArray(buffers->vao);
+}
+
+// Set the attribute in both VAOs ("vao" is bound, the position is also in the "positionVao").
+static void setAttribute(const MeshBuffers& buffers, int loc, int size, GLenum type, bool normalized,
+                         int stride, size_t offset, bool position) {
+    if (loc < 0) {
+        return;
+    }
+    glVertexAttribPointer(loc, size, type, normalized ? GL_TRUE : GL_FALSE, stride, (void*)offset);
+    glEnableVertexAttribArray(loc);
+    if (position) {
+        glBindVertexArray(buffers.positionVao);
+        glVertexAttribPointer(loc, size, type, normalized ? GL_TRUE : GL_FALSE, stride, (void*)offset);
+        glEnableVertexAttribArray(loc);
+        glBindVertexArray(buffers.vao);
+    }
+}
+
+MeshBuffers uploadQuantizedMesh(const QuantizedMesh& mesh, int positionLoc, int normalLoc, int texCoordLoc) {
+    MeshBuffers buffers;
+    int vertexCount = (int)mesh.vertices.size();
+    createMeshBuffers(&buffers, mesh.vertices.data(), vertexCount * sizeof(QuantizedVertex), mesh.indices, vertexCount);
+
+    /* A 3 component attribute: w is 1.0. */
+    int stride = sizeof(QuantizedVertex);
+    setAttribute(buffers, positionLoc, 3, GL_UNSIGNED_SHORT, true, stride, offsetof(QuantizedVertex, position), true);
+    setAttribute(buffers, normalLoc, 2, GL_BYTE, true, stride, offsetof(QuantizedVertex, normal), false);
+    setAttribute(buffers, texCoordLoc, 2, GL_HALF_FLOAT, false, stride, offsetof(QuantizedVertex, texCoord), false);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return buffers;
+}
+
+MeshBuffers uploadMeshWithNormals(const MeshData& mesh, const std::vector<float>& normals,
+                                  int positionLoc, int normalLoc, int texCoordLoc) {
+    int vertexCount = (int)mesh.positions.size() / 3;
+    bool hasTexCoords = !mesh.texCoords.empty();
+    std::vector<float> vertices(vertexCount * 8);
+    for (int idx = 0; idx < vertexCount; idx++) {
+        float* vertex = &vertices[idx * 8];
+        memcpy(vertex, &mesh.positions[idx * 3], 3 * sizeof(float));
+        memcpy(vertex + 3, &normals[idx * 3], 3 * sizeof(float));
+        vertex[6] = hasTexCoords ? mesh.texCoords[idx * 2] : 0.0f;
+        vertex[7] = hasTexCoords ? mesh.texCoords[idx * 2 + 1] : 0.0f;
+    }
+
+    MeshBuffers buffers;
+    createMeshBuffers(&buffers, vertices.data(), vertices.size() * sizeof(float), mesh.indices, vertexCount);
+
+    int stride = 8 * sizeof(float);
+    setAttribute(buffers, positionLoc, 3, GL_FLOAT, false, stride, 0, true);
+    setAttribute(buffers, normalLoc, 3, GL_FLOAT, false, stride, 3 * sizeof(float), false);
+    setAttribute(buffers, texCoordLoc, 2, GL_FLOAT, false, stride, 6 * sizeof(float), false);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return buffers;
+}
@@ -0,0 +1,99 @@
+/**
+ * Quantized vertex format: 12 bytes per vertex, decompressed by the vertex shader.
+ *
+ * The float meshes with normals take 32 bytes per vertex (3 + 3 + 2 floats).
+ * The quantized vertex stores:
+ *  * position:  3 x normalized unsigned short relative to the bounds of the mesh
+ *               (0: the minimum, 65535: the maximum of each axis),
+ *  * normal:    2 x normalized signed byte, octahedral encoding,
+ *  * tex coord: 2 x half float (any range, unlike the packed format of mesh.h).
+ *
+ * The position attribute reads [0, 1]: the dequantization (scale by the size
+ * of the bounds, translate to the minimum) is folded into the model matrix
+ * with meshDequantizationMatrix, so the shader only multiplies as before.
+ * The normals use the normal matrix of the original model matrix (the
+ * dequantization scale is not part of it) after octahedralDecode.
+ *
+ * Usage:
+ *
+ *   std::vector<float> normals = computeMeshNormals(mesh);
+ *   QuantizedMesh quantized = quantizeMesh(mesh, normals);
+ *   MeshBuffers buffers = uploadQuantizedMesh(quantized, positionLoc, normalLoc, texCoordLoc);
+ *   float dequantize[16];
+ *   meshDequantizationMatrix(quantized, dequantize);
+ *   // uModel = model * dequantize, the vertex shader source includes octahedralDecodeSrc.
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_MESH_QUANTIZE_H
+#define GLES_COMMON_MESH_QUANTIZE_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "common/mesh.h"
+
+struct QuantizedVertex {
+    uint16_t position[3]; // unorm16, relative to the bounds
+    int8_t normal[2];     // snorm8, octahedral
+    uint16_t texCoord[2]; // half float
+};
+
+struct QuantizedMesh {
+    std::vector<QuantizedVertex> vertices;
+    std::vector<uint32_t> indices;
+
+    float boundsMin[3];
+    float boundsSize[3]; // 1.0 for a flat axis
+
+    // Largest difference between the decoded and the original data.
+    float maxPositionError; // object space distance
+    float maxNormalError;   // degrees
+};
+
+// GLSL function for the vertex shaders: append it after the precision statements.
+/*   vec3 octahedralDecode(vec2 encoded);  the unit normal of the snorm8x2 attribute */
+extern const char* octahedralDecodeSrc;
+
+// Smooth vertex normals (3 floats per vertex): the area weighted sum of the triangle normals.
+/* Vertices without a triangle (or only degenerate ones) get (0, 0, 1). */
+std::vector<float> computeMeshNormals(const MeshData& mesh);
+
+// Quantize the vertices of the mesh, "normals" has 3 floats per vertex (ex.: computeMeshNormals).
+QuantizedMesh quantizeMesh(const MeshData& mesh, const std::vector<float>& normals);
+
+// Column major matrix which maps the [0, 1] position attribute to object space: model * matrix.
+void meshDequantizationMatrix(const QuantizedMesh& mesh, float matrix[16]);
+
+// Upload the quantized mesh into the VAOs with VBO and IBO. Attribute locations of -1 are skipped.
+MeshBuffers uploadQuantizedMesh(const QuantizedMesh& mesh, int positionLoc, int normalLoc, int texCoordLoc);
+
+// Upload the float reference of the quantized format: 3 + 3 + 2 floats per vertex, interleaved.
+MeshBuffers uploadMeshWithNormals(const MeshData& mesh, const std::vector<float>& normals,
+                                  int positionLoc, int normalLoc, int texCoordLoc);
+
+#endif // GLES_COMMON_MESH_QUANTIZE_H
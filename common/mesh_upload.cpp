@@ -0,0 +1,119 @@
+/**
+ * Indexed mesh helpers: upload of the packed vertex streams into the GL buffers
+ * and VAOs, see mesh.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/mesh.h"
+
+#include <stddef.h>
+
+#include <GLES3/gl3.h>
+
+#include "common/gpu_memory.h"
+
+static void setPositionPointer(int positionLoc, bool packed, int stride, size_t offset) {
+    if (packed) {
+        glVertexAttribPointer(positionLoc, 4, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offset);
+    } else {
+        glVertexAttribPointer(positionLoc, 3, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+    }
+    glEnableVertexAttribArray(positionLoc);
+}
+
+static void setTexCoordPointer(int texCoordLoc, bool packed, int stride, size_t offset) {
+    if (packed) {
+        glVertexAttribPointer(texCoordLoc, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offset);
+    } else {
+        glVertexAttribPointer(texCoordLoc, 2, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+    }
+    glEnableVertexAttribArray(texCoordLoc);
+}
+
+MeshBuffers uploadMesh(const MeshData& mesh, bool packed, int positionLoc, int texCoordLoc) {
+    return uploadMeshLayout(mesh, packed, MESH_LAYOUT_INTERLEAVED, positionLoc, texCoordLoc);
+}
+
+MeshBuffers uploadMeshLayout(const MeshData& mesh, bool packed, MeshLayout layout, int positionLoc, int texCoordLoc) {
+    std::vector<uint8_t> vertexData;
+    std::vector<uint8_t> indexData;
+    MeshStreams streams = packMesh(mesh, packed, layout, &vertexData, &indexData);
+
+    return uploadPackedMesh(streams, vertexData.data(), indexData.data(), positionLoc, texCoordLoc);
+}
+
+MeshBuffers uploadPackedMesh(const MeshStreams& streams, const void* vertexData, const void* indexData,
+                             int positionLoc, int texCoordLoc) {
+    MeshBuffers buffers;
+    buffers.layout = (MeshLayout)streams.layout;
+    buffers.indexCount = streams.indexCount;
+    buffers.indexType = streams.indexType;
+    buffers.vertexBufferSize = streams.vertexBufferSize;
+    bool packed = streams.packed != 0;
+
+    // 1. Create the buffers and the VAOs (the element buffer binding is part of the VAO state).
+    glGenVertexArrays(1, &buffers.vao);
+    glBindVertexArray(buffers.vao);
+
+    glGenBuffers(1, &buffers.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.vbo);
+    glBufferData(GL_ARRAY_BUFFER, streams.vertexBufferSize, vertexData, GL_STATIC_DRAW);
+    gpuMemoryTrackBuffer(buffers.vbo, streams.vertexBufferSize, GPU_MEMORY_VERTEX, "mesh vertices");
+
+    glGenBuffers(1, &buffers.ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, streams.indexBufferSize, indexData, GL_STATIC_DRAW);
+    gpuMemoryTrackBuffer(buffers.ibo, streams.indexBufferSize, GPU_MEMORY_VERTEX, "mesh indices");
+
+    if (positionLoc >= 0) {
+        setPositionPointer(positionLoc, packed, streams.positionStride, streams.positionOffset);
+    }
+    if (texCoordLoc >= 0) {
+        setTexCoordPointer(texCoordLoc, packed, streams.texCoordStride, streams.texCoordOffset);
+    }
+
+    // 2. The position-only VAO for the depth passes.
+    glGenVertexArrays(1, &buffers.positionVao);
+    glBindVertexArray(buffers.positionVao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.ibo);
+    if (positionLoc >= 0) {
+        setPositionPointer(positionLoc, packed, streams.depthStride, streams.depthOffset);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return buffers;
+}
+
+void destroyMeshBuffers(MeshBuffers* buffers) {
+    glDeleteVertexArrays(1, &buffers->vao);
+    glDeleteVertexArrays(1, &buffers->positionVao);
+    glDeleteBuffers(1, &buffers->vbo);
+    glDeleteBuffers(1, &buffers->ibo);
+    gpuMemoryReleaseBuffers(1, &buffers->vbo);
+    gpuMemoryReleaseBuffers(1, &buffers->ibo);
+    buffers->vao = 0;
+    buffers->positionVao = 0;
+    buffers->vbo = 0;
+    buffers->ibo = 0;
+}
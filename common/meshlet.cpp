@@ -0,0 +1,158 @@
+/**
+ * Meshlets: the CPU side builder. See meshlet.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/meshlet.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+static void normalize(float v[3]) {
+    float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (length > 0.0f) {
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+    }
+}
+
+// Bounding sphere (center of the box of the vertices) and normal cone of the triangles of a meshlet.
+static void computeMeshletBounds(const MeshData& mesh, const std::vector<uint32_t>& indices, Meshlet* meshlet) {
+    const uint32_t* triangles = &indices[meshlet->firstIndex];
+    int indexCount = meshlet->triangleCount * 3;
+
+    // 1. The sphere.
+    float boxMin[3] = { 1e30f, 1e30f, 1e30f };
+    float boxMax[3] = { -1e30f, -1e30f, -1e30f };
+    for (int idx = 0; idx < indexCount; idx++) {
+        const float* position = &mesh.positions[triangles[idx] * 3];
+        for (int c = 0; c < 3; c++) {
+            boxMin[c] = std::min(boxMin[c], position[c]);
+            boxMax[c] = std::max(boxMax[c], position[c]);
+        }
+    }
+    for (int c = 0; c < 3; c++) {
+        meshlet->center[c] = (boxMin[c] + boxMax[c]) * 0.5f;
+    }
+    float radiusSquared = 0.0f;
+    for (int idx = 0; idx < indexCount; idx++) {
+        const float* position = &mesh.positions[triangles[idx] * 3];
+        float dx = position[0] - meshlet->center[0];
+        float dy = position[1] - meshlet->center[1];
+        float dz = position[2] - meshlet->center[2];
+        radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+    }
+    meshlet->radius = sqrtf(radiusSquared);
+
+    // 2. The cone axis: the average of the unit triangle normals (the degenerate triangles are skipped).
+    std::vector<float> normals(meshlet->triangleCount * 3, 0.0f);
+    float axis[3] = { 0.0f, 0.0f, 0.0f };
+    for (uint32_t triangle = 0; triangle < meshlet->triangleCount; triangle++) {
+        const float* p0 = &mesh.positions[triangles[triangle * 3] * 3];
+        const float* p1 = &mesh.positions[triangles[triangle * 3 + 1] * 3];
+        const float* p2 = &mesh.positions[triangles[triangle * 3 + 2] * 3];
+        float edge1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        float edge2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        float* normal = &normals[triangle * 3];
+        normal[0] = edge1[1] * edge2[2] - edge1[2] * edge2[1];
+        normal[1] = edge1[2] * edge2[0] - edge1[0] * edge2[2];
+        normal[2] = edge1[0] * edge2[1] - edge1[1] * edge2[0];
+        normalize(normal);
+        axis[0] += normal[0];
+        axis[1] += normal[1];
+        axis[2] += normal[2];
+    }
+    normalize(axis);
+
+    // 3. The cutoff: the view direction must be within 90 degrees minus the cone angle of the axis.
+    float minDot = 1.0f;
+    for (uint32_t triangle = 0; triangle < meshlet->triangleCount; triangle++) {
+        const float* normal = &normals[triangle * 3];
+        if (normal[0] != 0.0f || normal[1] != 0.0f || normal[2] != 0.0f) {
+            minDot = std::min(minDot, normal[0] * axis[0] + normal[1] * axis[1] + normal[2] * axis[2]);
+        }
+    }
+    if (minDot <= 0.0f) {
+        memset(meshlet->coneAxis, 0, sizeof(meshlet->coneAxis));
+        meshlet->coneCutoff = 1.0f;
+    } else {
+        memcpy(meshlet->coneAxis, axis, sizeof(meshlet->coneAxis));
+        meshlet->coneCutoff = sqrtf(1.0f - minDot * minDot);
+    }
+}
+
+// Vertices of the triangle which the meshlet doesn't use yet.
+static uint32_t newVertexCount(const uint32_t* triangle, const std::vector<int>& vertexMeshlet, int meshletIdx) {
+    uint32_t count = 0;
+    for (int corner = 0; corner < 3; corner++) {
+        bool repeated = (corner > 0 && triangle[corner] == triangle[0]) || (corner > 1 && triangle[corner] == triangle[1]);
+        if (vertexMeshlet[triangle[corner]] != meshletIdx && !repeated) {
+            count++;
+        }
+    }
+    return count;
+}
+
+MeshletData buildMeshlets(const MeshData& mesh) {
+    MeshletData result;
+    result.indices.reserve(mesh.indices.size());
+
+    // The last meshlet which uses the vertex (-1: none).
+    std::vector<int> vertexMeshlet(mesh.positions.size() / 3, -1);
+
+    Meshlet current;
+    memset(&current, 0, sizeof(current));
+    for (size_t idx = 0; idx + 2 < mesh.indices.size(); idx += 3) {
+        const uint32_t* triangle = &mesh.indices[idx];
+        int meshletIdx = (int)result.meshlets.size();
+
+        // 1. Start a new meshlet if the triangle doesn't fit.
+        uint32_t newVertices = newVertexCount(triangle, vertexMeshlet, meshletIdx);
+        if (current.triangleCount == MESHLET_MAX_TRIANGLES || current.vertexCount + newVertices > MESHLET_MAX_VERTICES) {
+            result.meshlets.push_back(current);
+            memset(&current, 0, sizeof(current));
+            current.firstIndex = (uint32_t)result.indices.size();
+            meshletIdx++;
+            newVertices = newVertexCount(triangle, vertexMeshlet, meshletIdx);
+        }
+
+        // 2. Add the triangle.
+        for (int corner = 0; corner < 3; corner++) {
+            vertexMeshlet[triangle[corner]] = meshletIdx;
+        }
+        current.vertexCount += newVertices;
+        current.triangleCount++;
+        result.indices.insert(result.indices.end(), triangle, triangle + 3);
+    }
+    if (current.triangleCount > 0) {
+        result.meshlets.push_back(current);
+    }
+
+    // 3. The bounds of every meshlet.
+    for (Meshlet& meshlet : result.meshlets) {
+        computeMeshletBounds(mesh, result.indices, &meshlet);
+    }
+    return result;
+}
@@ -0,0 +1,128 @@
+/**
+ * Meshlets: clusters of up to 64 vertices and 124 triangles with a bounding
+ * sphere and a normal cone, culled on the GPU.
+ *
+ * buildMeshlets (CPU only, also used by the "tools/asset_bundle" packer)
+ * walks the triangles in their index buffer order and starts a new meshlet
+ * when the next triangle would exceed the vertex or the triangle limit. The
+ * triangles should be in vertex cache order (optimizeMesh): neighbouring
+ * triangles then end up in the same meshlet, so the bounds are tight. The
+ * index buffer of the result is the index buffer of the mesh, reordered by
+ * the meshlets (each meshlet is a contiguous range of it).
+ *
+ * The normal cone (axis, cutoff) contains the normals of every triangle of
+ * the meshlet. Seen from "camera", the whole meshlet is back-facing if
+ *   dot(center - camera, axis) >= cutoff * length(center - camera) + radius
+ * A meshlet with normals spread over more than a hemisphere has no cone
+ * (axis: 0, cutoff: 1), it is never back-face culled.
+ *
+ * meshletCull runs one work group per meshlet: the first invocation tests
+ * the bounding sphere against the frustum planes and the cone against the
+ * camera, the visible meshlets get a range of the culled index buffer
+ * (atomic add on the index count of a DrawElementsIndirectCommand) and every
+ * invocation copies one triangle. The draw is a single glDrawElementsIndirect
+ * of the culled index buffer, the CPU reads nothing back.
+ *
+ * The tests run in object space: the frustum planes are extracted from the
+ * model-view-projection matrix and the camera position is in object space.
+ *
+ * Usage:
+ *
+ *   optimizeMesh(&mesh);
+ *   MeshletData meshlets = buildMeshlets(mesh);
+ *   MeshletCuller culler;
+ *   initMeshletCuller(&culler, meshlets);
+ *   ... bind culler.culledIndexBuffer as the element buffer of the mesh VAO ...
+ *   while (...) {
+ *       meshletCull(&culler, modelViewProjection, objectSpaceCamera, true);
+ *       glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culler.commandBuffer);
+ *       glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, NULL);
+ *   }
+ *   destroyMeshletCuller(&culler);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.1+ (compute shaders, indirect draws; buildMeshlets has no GL calls)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_MESHLET_H
+#define GLES_COMMON_MESHLET_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "common/mesh.h"
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// One meshlet, also the std430 layout of the GPU buffer (vec4, vec4, uvec4).
+struct Meshlet {
+    float center[3];
+    float radius;
+    float coneAxis[3];
+    float coneCutoff;
+    uint32_t firstIndex; // in the reordered index buffer
+    uint32_t triangleCount;
+    uint32_t vertexCount;
+    uint32_t reserved;
+};
+
+struct MeshletData {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> indices; // the triangles of the mesh in meshlet order
+};
+
+// Header of the meshlet assets (see asset_bundle.h), followed by the meshlets and the indices.
+struct MeshletHeader {
+    uint32_t meshletCount;
+    uint32_t indexCount;
+};
+
+struct MeshletCuller {
+    unsigned int cullProgram;
+
+    unsigned int meshletBuffer;     // Meshlet array
+    unsigned int indexBuffer;       // source indices (uint32)
+    unsigned int culledIndexBuffer; // the visible triangles (uint32), the element buffer of the draw
+    unsigned int commandBuffer;     // DrawElementsIndirectCommand and the visible meshlet count
+    int meshletCount;
+    int indexCount;
+};
+
+// Split the triangles of the mesh into meshlets and compute their bounds.
+MeshletData buildMeshlets(const MeshData& mesh);
+
+void initMeshletCuller(MeshletCuller* culler, const MeshletData& meshlets);
+
+void destroyMeshletCuller(MeshletCuller* culler);
+
+// Cull the meshlets with the column major model-view-projection matrix and the object space camera position.
+/* "coneCulling" false: only the frustum test. Fills the culled index buffer and the command. */
+void meshletCull(MeshletCuller* culler, const float* modelViewProjection, const float camera[3], bool coneCulling);
+
+// Visible meshlets and indices of the last meshletCull (reads the command buffer back: stalls, only for statistics).
+void meshletVisibleCount(MeshletCuller* culler, int* meshlets, int* indices);
+
+#endif // GLES_COMMON_MESHLET_H
@@ -0,0 +1,220 @@
+/**
+ * Meshlets: the compute culling pass. See meshlet.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/meshlet.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+
+#include <GLES3/gl31.h>
+
+#include "common/frustum_culling.h"
+#include "common/gpu_memory.h"
+#include "common/program_cache.h"
+
+static const char* meshlet_cull_src = R"(#version 310 es
+layout(local_size_x = 128) in;
+
+struct Meshlet {
+    vec4 sphere; // xyz: center, w: radius
+    vec4 cone;   // xyz: axis, w: cutoff
+    uvec4 range; // x: first index, y: triangle count
+};
+
+layout(std430, binding = 0) readonly buffer Meshlets {
+    Meshlet meshlets[];
+};
+
+layout(std430, binding = 1) readonly buffer Indices {
+    uint indices[];
+};
+
+layout(std430, binding = 2) writeonly buffer Culled {
+    uint culled[];
+};
+
+layout(std430, binding = 3) buffer Command {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint reserved;
+    uint visibleMeshlets;
+} command;
+
+uniform vec4 planes[6]; // normalized, object space
+uniform vec3 camera;    // object space
+uniform uint meshletCount;
+uniform bool coneCulling;
+
+shared bool visible;
+shared uint offset;
+
+bool isVisible(Meshlet meshlet) {
+    vec3 center = meshlet.sphere.xyz;
+    float radius = meshlet.sphere.w;
+    for (int plane = 0; plane < 6; plane++) {
+        if (dot(planes[plane].xyz, center) + planes[plane].w < -radius) {
+            return false;
+        }
+    }
+
+    vec3 view = center - camera;
+    return !coneCulling || dot(view, meshlet.cone.xyz) < meshlet.cone.w * length(view) + radius;
+}
+
+void main() {
+    // The work groups are a 2D grid if there are more than 65535 meshlets.
+    uint meshletIdx = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+    bool valid = meshletIdx < meshletCount;
+    Meshlet meshlet;
+    if (valid) {
+        meshlet = meshlets[meshletIdx];
+    }
+
+    // 1. One invocation tests the meshlet and reserves the range of its triangles.
+    if (gl_LocalInvocationIndex == 0u) {
+        visible = valid && isVisible(meshlet);
+        if (visible) {
+            offset = atomicAdd(command.count, meshlet.range.y * 3u);
+            atomicAdd(command.visibleMeshlets, 1u);
+        }
+    }
+    memoryBarrierShared();
+    barrier();
+
+    // 2. Every invocation copies one triangle.
+    uint triangle = gl_LocalInvocationIndex;
+    if (visible && triangle < meshlet.range.y) {
+        uint src = meshlet.range.x + triangle * 3u;
+        uint dst = offset + triangle * 3u;
+        culled[dst] = indices[src];
+        culled[dst + 1u] = indices[src + 1u];
+        culled[dst + 2u] = indices[src + 2u];
+    }
+}
+)";
+
+// The indirect command and the visible meshlet count after it.
+struct MeshletCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t reserved;
+    uint32_t visibleMeshlets;
+};
+
+void initMeshletCuller(MeshletCuller* culler, const MeshletData& meshlets) {
+    culler->cullProgram = createCachedComputeProgram(meshlet_cull_src);
+    culler->meshletCount = (int)meshlets.meshlets.size();
+    culler->indexCount = (int)meshlets.indices.size();
+
+    glGenBuffers(1, &culler->meshletBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, culler->meshletBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(culler->meshletCount, 1) * sizeof(Meshlet),
+                 meshlets.meshlets.data(), GL_STATIC_DRAW);
+    gpuMemoryTrackBuffer(culler->meshletBuffer, std::max(culler->meshletCount, 1) * sizeof(Meshlet), GPU_MEMORY_STORAGE,
+                         "meshlets");
+
+    GLsizeiptr indicesSize = std::max(culler->indexCount, 1) * sizeof(uint32_t);
+    glGenBuffers(1, &culler->indexBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, culler->indexBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, indicesSize, meshlets.indices.data(), GL_STATIC_DRAW);
+    gpuMemoryTrackBuffer(culler->indexBuffer, indicesSize, GPU_MEMORY_STORAGE, "meshlet indices");
+
+    glGenBuffers(1, &culler->culledIndexBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, culler->culledIndexBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, indicesSize, NULL, GL_DYNAMIC_COPY);
+    gpuMemoryTrackBuffer(culler->culledIndexBuffer, indicesSize, GPU_MEMORY_STORAGE, "meshlet culled indices");
+
+    MeshletCommand command = { 0, 1, 0, 0, 0, 0 };
+    glGenBuffers(1, &culler->commandBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, culler->commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(command), &command, GL_DYNAMIC_DRAW);
+    gpuMemoryTrackBuffer(culler->commandBuffer, sizeof(command), GPU_MEMORY_STORAGE, "meshlet indirect command");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void destroyMeshletCuller(MeshletCuller* culler) {
+    glDeleteProgram(culler->cullProgram);
+    unsigned int buffers[] = { culler->meshletBuffer, culler->indexBuffer, culler->culledIndexBuffer,
+                               culler->commandBuffer };
+    glDeleteBuffers(4, buffers);
+    gpuMemoryReleaseBuffers(4, buffers);
+}
+
+void meshletCull(MeshletCuller* culler, const float* modelViewProjection, const float camera[3], bool coneCulling) {
+    // 1. Reset the index count of the indirect command and the visible meshlet count.
+    MeshletCommand command = { 0, 1, 0, 0, 0, 0 };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, culler->commandBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(command), &command);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // 2. The object space frustum planes, normalized for the sphere distances.
+    float planes[6][4];
+    extractFrustumPlanes(modelViewProjection, planes);
+    for (int plane = 0; plane < 6; plane++) {
+        float length = sqrtf(planes[plane][0] * planes[plane][0] + planes[plane][1] * planes[plane][1] +
+                             planes[plane][2] * planes[plane][2]);
+        for (int c = 0; c < 4; c++) {
+            planes[plane][c] /= length;
+        }
+    }
+
+    // 3. One work group per meshlet.
+    glUseProgram(culler->cullProgram);
+    glUniform4fv(glGetUniformLocation(culler->cullProgram, "planes"), 6, &planes[0][0]);
+    glUniform3fv(glGetUniformLocation(culler->cullProgram, "camera"), 1, camera);
+    glUniform1ui(glGetUniformLocation(culler->cullProgram, "meshletCount"), (GLuint)culler->meshletCount);
+    glUniform1i(glGetUniformLocation(culler->cullProgram, "coneCulling"), coneCulling ? 1 : 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, culler->meshletBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, culler->indexBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, culler->culledIndexBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, culler->commandBuffer);
+    int groupsX = std::min(culler->meshletCount, 65535);
+    int groupsY = groupsX > 0 ? (culler->meshletCount + groupsX - 1) / groupsX : 0;
+    if (groupsX > 0) {
+        glDispatchCompute(groupsX, groupsY, 1);
+    }
+    glUseProgram(0);
+
+    // 4. The draw reads the culled indices and the command.
+    glMemoryBarrier(GL_ELEMENT_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
+
+void meshletVisibleCount(MeshletCuller* culler, int* meshlets, int* indices) {
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, culler->commandBuffer);
+    const MeshletCommand* command = (const MeshletCommand*)glMapBufferRange(
+        GL_SHADER_STORAGE_BUFFER, 0, sizeof(MeshletCommand), GL_MAP_READ_BIT);
+    *meshlets = command != NULL ? (int)command->visibleMeshlets : -1;
+    *indices = command != NULL ? (int)command->count : -1;
+    glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
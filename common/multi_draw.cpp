@@ -0,0 +1,191 @@
+/**
+ * Multi-draw batches, see multi_draw.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/multi_draw.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+// GL_ANGLE_multi_draw: not in the Khronos gl2ext.h.
+typedef void (GL_APIENTRYP PFNGLMULTIDRAWARRAYSANGLEPROC)(GLenum mode, const GLint* firsts, const GLsizei* counts,
+                                                          GLsizei drawcount);
+typedef void (GL_APIENTRYP PFNGLMULTIDRAWELEMENTSANGLEPROC)(GLenum mode, const GLsizei* counts, GLenum type,
+                                                            const void* const* offsets, GLsizei drawcount);
+
+const char* multiDrawModeNames[MULTI_DRAW_MODE_COUNT] = { "loop", "ext", "angle" };
+
+static const char* multiDrawExtensions[MULTI_DRAW_MODE_COUNT] = {
+    NULL, "GL_EXT_multi_draw_arrays", "GL_ANGLE_multi_draw",
+};
+
+// The entry points of both extensions share the signatures.
+static PFNGLMULTIDRAWARRAYSEXTPROC multiDrawArrays[MULTI_DRAW_MODE_COUNT];
+static PFNGLMULTIDRAWELEMENTSEXTPROC multiDrawElements[MULTI_DRAW_MODE_COUNT];
+
+static bool hasGLExtension(const char* name) {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int idx = 0; idx < count; idx++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, idx), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseMultiDrawMode(const char* name, MultiDrawMode* mode) {
+    if (strcmp(name, "auto") == 0) {
+        *mode = bestMultiDrawMode();
+        return true;
+    }
+    for (int idx = 0; idx < MULTI_DRAW_MODE_COUNT; idx++) {
+        if (strcmp(name, multiDrawModeNames[idx]) == 0) {
+            *mode = (MultiDrawMode)idx;
+            return true;
+        }
+    }
+
+    printf("Unknown multi-draw mode '%s' (loop, ext, angle, auto)\n", name);
+    return false;
+}
+
+bool multiDrawSupported(MultiDrawMode mode) {
+    return multiDrawExtensions[mode] == NULL || hasGLExtension(multiDrawExtensions[mode]);
+}
+
+MultiDrawMode bestMultiDrawMode() {
+    if (multiDrawSupported(MULTI_DRAW_ANGLE)) {
+        return MULTI_DRAW_ANGLE;
+    }
+    return multiDrawSupported(MULTI_DRAW_EXT) ? MULTI_DRAW_EXT : MULTI_DRAW_LOOP;
+}
+
+std::string multiDrawShaderSource(const char* source, MultiDrawMode mode, int attributeLocation) {
+    // The declarations go right after the "#version" line: the extension directive must precede any code.
+    std::string declarations;
+    if (mode == MULTI_DRAW_ANGLE) {
+        declarations = "#extension GL_ANGLE_multi_draw : require\n#define DRAW_INDEX gl_DrawID\n";
+    } else if (mode == MULTI_DRAW_EXT) {
+        declarations = "layout(location = " + std::to_string(attributeLocation) + ") in highp float aDrawIndex;\n"
+                       "#define DRAW_INDEX int(aDrawIndex)\n";
+    } else {
+        declarations = "uniform highp int uDrawIndex;\n#define DRAW_INDEX uDrawIndex\n";
+    }
+
+    std::string result = source;
+    result.insert(result.find('\n') + 1, declarations);
+    return result;
+}
+
+bool initMultiDrawBatch(MultiDrawBatch* batch, MultiDrawMode mode, unsigned int program) {
+    batch->mode = mode;
+    batch->drawIndexLoc = glGetUniformLocation(program, "uDrawIndex");
+    batch->driverCalls = 0;
+    multiDrawClear(batch);
+
+    if (!multiDrawSupported(mode)) {
+        printf("Multi-draw: %s is not supported\n", multiDrawExtensions[mode]);
+        return false;
+    }
+    if (mode == MULTI_DRAW_EXT && multiDrawArrays[mode] == NULL) {
+        multiDrawArrays[mode] = (PFNGLMULTIDRAWARRAYSEXTPROC)eglGetProcAddress("glMultiDrawArraysEXT");
+        multiDrawElements[mode] = (PFNGLMULTIDRAWELEMENTSEXTPROC)eglGetProcAddress("glMultiDrawElementsEXT");
+    } else if (mode == MULTI_DRAW_ANGLE && multiDrawArrays[mode] == NULL) {
+        multiDrawArrays[mode] = (PFNGLMULTIDRAWARRAYSEXTPROC)(PFNGLMULTIDRAWARRAYSANGLEPROC)
+            eglGetProcAddress("glMultiDrawArraysANGLE");
+        multiDrawElements[mode] = (PFNGLMULTIDRAWELEMENTSEXTPROC)(PFNGLMULTIDRAWELEMENTSANGLEPROC)
+            eglGetProcAddress("glMultiDrawElementsANGLE");
+    }
+    if (mode != MULTI_DRAW_LOOP && (multiDrawArrays[mode] == NULL || multiDrawElements[mode] == NULL)) {
+        printf("Multi-draw: the entry points of %s are missing\n", multiDrawExtensions[mode]);
+        return false;
+    }
+    return true;
+}
+
+void multiDrawUseProgram(MultiDrawBatch* batch, unsigned int program) {
+    glUseProgram(program);
+    batch->drawIndexLoc = glGetUniformLocation(program, "uDrawIndex");
+}
+
+void multiDrawClear(MultiDrawBatch* batch) {
+    batch->firsts.clear();
+    batch->counts.clear();
+    batch->offsets.clear();
+}
+
+void multiDrawAddArrays(MultiDrawBatch* batch, int first, int count) {
+    batch->firsts.push_back(first);
+    batch->counts.push_back(count);
+}
+
+void multiDrawAddElements(MultiDrawBatch* batch, int count, size_t byteOffset) {
+    batch->counts.push_back(count);
+    batch->offsets.push_back((const void*)(uintptr_t)byteOffset);
+}
+
+void submitMultiDrawArrays(MultiDrawBatch* batch, unsigned int primitive) {
+    int drawCount = (int)batch->counts.size();
+    if (drawCount == 0) {
+        return;
+    }
+    if (batch->mode != MULTI_DRAW_LOOP) {
+        multiDrawArrays[batch->mode](primitive, batch->firsts.data(), batch->counts.data(), drawCount);
+        batch->driverCalls++;
+        return;
+    }
+    for (int idx = 0; idx < drawCount; idx++) {
+        glUniform1i(batch->drawIndexLoc, idx);
+        glDrawArrays(primitive, batch->firsts[idx], batch->counts[idx]);
+    }
+    batch->driverCalls += drawCount * 2;
+}
+
+void submitMultiDrawElements(MultiDrawBatch* batch, unsigned int primitive, unsigned int indexType) {
+    int drawCount = (int)batch->counts.size();
+    if (drawCount == 0) {
+        return;
+    }
+    if (batch->mode != MULTI_DRAW_LOOP) {
+        multiDrawElements[batch->mode](primitive, batch->counts.data(), indexType, batch->offsets.data(), drawCount);
+        batch->driverCalls++;
+        return;
+    }
+    for (int idx = 0; idx < drawCount; idx++) {
+        glUniform1i(batch->drawIndexLoc, idx);
+        glDrawElements(primitive, batch->counts[idx], indexType, batch->offsets[idx]);
+    }
+    batch->driverCalls += drawCount * 2;
+}
+
+int multiDrawTakeDriverCalls(MultiDrawBatch* batch) {
+    int calls = batch->driverCalls;
+    batch->driverCalls = 0;
+    return calls;
+}
@@ -0,0 +1,118 @@
+/**
+ * Multi-draw batches: many ranges of the same buffers submitted with one call.
+ *
+ * A scene with many sub-meshes in one buffer usually issues one draw call per
+ * sub-mesh with a uniform change in between (the per draw data): two driver
+ * calls per sub-mesh, each validating the whole state. The batch collects the
+ * ranges of a frame and submits them in the selected mode:
+ *  loop   glDrawArrays/glDrawElements per range with the "uDrawIndex" uniform (the baseline).
+ *  ext    One glMultiDrawArraysEXT/glMultiDrawElementsEXT call (GL_EXT_multi_draw_arrays). The
+ *         extension has no draw index in the shader: the index of the sub-mesh must be a vertex
+ *         attribute ("aDrawIndex", filled by the application when the buffer is built).
+ *  angle  One glMultiDrawArraysANGLE/glMultiDrawElementsANGLE call (GL_ANGLE_multi_draw), the
+ *         shader reads gl_DrawID.
+ * The vertex shaders use the DRAW_INDEX macro (an int) which multiDrawShaderSource defines for
+ * the mode, the same shader source works in every mode.
+ *
+ * Usage:
+ *
+ *   MultiDrawMode mode = bestMultiDrawMode();
+ *   program = createCachedProgram(multiDrawShaderSource(vertex_src, mode, 1).c_str(), fragment_src);
+ *   MultiDrawBatch batch;
+ *   initMultiDrawBatch(&batch, mode, program);
+ *   // every frame:
+ *   multiDrawClear(&batch);
+ *   multiDrawAddArrays(&batch, first, count); // ...
+ *   submitMultiDrawArrays(&batch, GL_TRIANGLES);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *  * EGL
+ *  * GL_EXT_multi_draw_arrays or GL_ANGLE_multi_draw (optional)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_MULTI_DRAW_H
+#define GLES_COMMON_MULTI_DRAW_H
+
+#include <string>
+#include <vector>
+
+enum MultiDrawMode {
+    MULTI_DRAW_LOOP,
+    MULTI_DRAW_EXT,
+    MULTI_DRAW_ANGLE,
+    MULTI_DRAW_MODE_COUNT,
+};
+
+// "loop", "ext", "angle".
+extern const char* multiDrawModeNames[MULTI_DRAW_MODE_COUNT];
+
+// The mode of a name, "auto" selects bestMultiDrawMode (a GL context is needed).
+/* Returns false (and prints the valid names) for an unknown name. */
+bool parseMultiDrawMode(const char* name, MultiDrawMode* mode);
+
+// The extension of the mode is available (the loop is always available).
+bool multiDrawSupported(MultiDrawMode mode);
+
+// GL_ANGLE_multi_draw (gl_DrawID), then GL_EXT_multi_draw_arrays, then the loop.
+MultiDrawMode bestMultiDrawMode();
+
+// The vertex shader with the DRAW_INDEX macro of the mode after the "#version" line.
+/* loop: the "uDrawIndex" uniform, ext: the "aDrawIndex" float attribute at "attributeLocation",
+ * angle: gl_DrawID (with the extension directive). */
+std::string multiDrawShaderSource(const char* source, MultiDrawMode mode, int attributeLocation);
+
+struct MultiDrawBatch {
+    MultiDrawMode mode;
+    int drawIndexLoc; // "uDrawIndex" of the loop mode
+
+    std::vector<int> firsts;
+    std::vector<int> counts;
+    std::vector<const void*> offsets; // element ranges: the byte offsets into the index buffer
+
+    int driverCalls; // GL calls of the submissions since the last multiDrawTakeDriverCalls
+};
+
+// Resolve the entry points of the mode and the "uDrawIndex" location of the program.
+/* Returns false (and prints the extension) if the mode isn't supported. */
+bool initMultiDrawBatch(MultiDrawBatch* batch, MultiDrawMode mode, unsigned int program);
+
+// Use the program for the next submissions (the "uDrawIndex" location of the loop mode).
+void multiDrawUseProgram(MultiDrawBatch* batch, unsigned int program);
+
+void multiDrawClear(MultiDrawBatch* batch);
+
+// Add a range of vertices (glDrawArrays) / indices (glDrawElements, "byteOffset" into the index buffer).
+/* The DRAW_INDEX of a range is its position in the batch. Don't mix arrays and elements in a batch. */
+void multiDrawAddArrays(MultiDrawBatch* batch, int first, int count);
+void multiDrawAddElements(MultiDrawBatch* batch, int count, size_t byteOffset);
+
+// Draw the collected ranges with the bound program and VAO.
+void submitMultiDrawArrays(MultiDrawBatch* batch, unsigned int primitive);
+void submitMultiDrawElements(MultiDrawBatch* batch, unsigned int primitive, unsigned int indexType);
+
+// GL calls of the submissions since the previous call.
+int multiDrawTakeDriverCalls(MultiDrawBatch* batch);
+
+#endif // GLES_COMMON_MULTI_DRAW_H
@@ -0,0 +1,373 @@
+/**
+ * Order independent transparency, see oit.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/oit.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include <GLES3/gl31.h>
+
+#include "common/gl_state.h"
+#include "common/gpu_memory.h"
+#include "common/program_cache.h"
+#include "common/render_formats.h"
+
+#define OIT_STRING(value) #value
+#define OIT_VALUE(value) OIT_STRING(value)
+
+static const char* modeNames[OIT_MODE_COUNT] = { "weighted", "linked-list" };
+
+// The weight falls with the window depth: the nearer surfaces dominate the average (clamped for RGBA16F).
+static const char* weighted_header_src =
+    "#define OIT 1\n"
+    "precision highp float;\n"
+    "layout(location = 0) out vec4 oitAccum;\n"
+    "layout(location = 1) out vec4 oitCoverage;\n"
+    "void oitWrite(vec4 color) {\n"
+    "    float weight = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1e3 * pow(1.0 - 0.9 * gl_FragCoord.z, 3.0),\n"
+    "                         1e-2, 3e2);\n"
+    "    oitAccum = vec4(color.rgb * color.a * weight, color.a);\n"
+    "    oitCoverage = vec4(color.a * weight);\n"
+    "}\n";
+
+// The head node of every pixel (width * height words), then the nodes: the packed color, the depth bits and the next
+// node (0xffffffff: the end of the list).
+#define OIT_LIST_DECLARATIONS \
+    "layout(std430, binding = " OIT_VALUE(OIT_STORAGE_BINDING) ") coherent buffer OitNodes {\n" \
+    "    uint count;\n" \
+    "    uint capacity;\n" \
+    "    uint width;\n" \
+    "    uint headCount;\n" \
+    "    uint data[];\n" \
+    "} oitList;\n" \
+    "uint oitHead(ivec2 pixel) {\n" \
+    "    return uint(pixel.y) * oitList.width + uint(pixel.x);\n" \
+    "}\n"
+
+// The words before the heads: count, capacity, width, headCount.
+#define OIT_LIST_HEADER_WORDS 4
+
+static const char* linked_list_header_src =
+    "#define OIT 1\n"
+    "precision highp float;\n"
+    "precision highp int;\n"
+    "layout(early_fragment_tests) in;\n"
+    OIT_LIST_DECLARATIONS
+    "void oitWrite(vec4 color) {\n"
+    "    if (color.a <= 0.0) {\n"
+    "        return;\n"
+    "    }\n"
+    "    uint node = atomicAdd(oitList.count, 1u);\n"
+    "    if (node >= oitList.capacity) {\n"
+    "        return;\n"
+    "    }\n"
+    "    uint next = atomicExchange(oitList.data[oitHead(ivec2(gl_FragCoord.xy))], node);\n"
+    "    uint base = oitList.headCount + node * 3u;\n"
+    "    oitList.data[base] = packUnorm4x8(color);\n"
+    "    oitList.data[base + 1u] = floatBitsToUint(gl_FragCoord.z);\n"
+    "    oitList.data[base + 2u] = next;\n"
+    "}\n";
+
+// Full-screen triangle without vertex attributes (the linked list resolve needs the 3.1 shading language in both stages).
+#define OIT_FULLSCREEN_VERTEX_BODY                                                                     \
+    "precision highp float;\n"                                                                        \
+    "void main() {\n"                                                                                 \
+    "    vec2 position = vec2(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1));\n" \
+    "    gl_Position = vec4(position, 0.0, 1.0);\n"                                                   \
+    "}\n"
+
+static const char* fullscreen_vertex_src = "#version 300 es\n" OIT_FULLSCREEN_VERTEX_BODY;
+static const char* fullscreen_vertex_310_src = "#version 310 es\n" OIT_FULLSCREEN_VERTEX_BODY;
+
+// The weighted average color over the framebuffer, the alpha is the coverage of the surfaces.
+static const char* composite_fragment_src = R"(#version 300 es
+precision highp float;
+
+uniform highp sampler2D uAccum;
+uniform highp sampler2D uCoverage;
+
+out vec4 outColor;
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 accum = texelFetch(uAccum, pixel, 0);
+    float revealage = accum.a;
+    if (revealage >= 1.0) {
+        discard;
+    }
+    float coverage = texelFetch(uCoverage, pixel, 0).r;
+    outColor = vec4(accum.rgb / max(coverage, 1e-5), 1.0 - revealage);
+}
+)";
+
+// Sort the fragments of the pixel and blend them back to front, premultiplied output (GL_ONE, GL_ONE_MINUS_SRC_ALPHA).
+static const char* resolve_fragment_src =
+    "#version 310 es\n"
+    "#define OIT_MAX_FRAGMENTS " OIT_VALUE(OIT_MAX_FRAGMENTS) "\n"
+    "precision highp float;\n"
+    "precision highp int;\n"
+    OIT_LIST_DECLARATIONS
+    R"(
+out vec4 outColor;
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    uint head = oitHead(pixel);
+    uint node = oitList.data[head];
+    oitList.data[head] = 0xffffffffu;
+
+    // 1. Collect the fragments: the color and the depth bits (a positive float sorts like its bits).
+    uvec2 fragments[OIT_MAX_FRAGMENTS];
+    int count = 0;
+    while (node != 0xffffffffu && count < OIT_MAX_FRAGMENTS) {
+        uint base = oitList.headCount + node * 3u;
+        fragments[count] = uvec2(oitList.data[base], oitList.data[base + 1u]);
+        node = oitList.data[base + 2u];
+        count++;
+    }
+    if (count == 0) {
+        discard;
+    }
+
+    // 2. Insertion sort, the farthest first.
+    for (int idx = 1; idx < count; idx++) {
+        uvec2 fragment = fragments[idx];
+        int other = idx - 1;
+        while (other >= 0 && fragments[other].y < fragment.y) {
+            fragments[other + 1] = fragments[other];
+            other--;
+        }
+        fragments[other + 1] = fragment;
+    }
+
+    // 3. Blend back to front: the premultiplied color and the remaining transmittance.
+    vec3 color = vec3(0.0);
+    float transmittance = 1.0;
+    for (int idx = 0; idx < count; idx++) {
+        vec4 fragment = unpackUnorm4x8(fragments[idx].x);
+        color = fragment.rgb * fragment.a + color * (1.0 - fragment.a);
+        transmittance *= 1.0 - fragment.a;
+    }
+    outColor = vec4(color, 1.0 - transmittance);
+}
+)";
+
+const char* oitModeName(OitMode mode) {
+    return mode < OIT_MODE_COUNT ? modeNames[mode] : "unknown";
+}
+
+OitMode findOitMode(const char* name) {
+    for (int idx = 0; idx < OIT_MODE_COUNT; idx++) {
+        if (strcmp(modeNames[idx], name) == 0) {
+            return (OitMode)idx;
+        }
+    }
+    return OIT_MODE_COUNT;
+}
+
+bool oitModeSupported(OitMode mode) {
+    switch (mode) {
+    case OIT_WEIGHTED: {
+        int drawBuffers = 0;
+        glGetIntegerv(GL_MAX_DRAW_BUFFERS, &drawBuffers);
+        return drawBuffers >= 2 && renderFormatSupported(findRenderFormat(GL_RGBA16F), RENDER_TARGET_TEXTURE)
+            && renderFormatSupported(findRenderFormat(GL_R16F), RENDER_TARGET_TEXTURE);
+    }
+    case OIT_LINKED_LIST: {
+        int major = 0;
+        int minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major * 10 + minor < 31) {
+            return false;
+        }
+        int storageBlocks = 0;
+        glGetIntegerv(GL_MAX_FRAGMENT_SHADER_STORAGE_BLOCKS, &storageBlocks);
+        return storageBlocks >= 1;
+    }
+    default:
+        return false;
+    }
+}
+
+static unsigned int createTexture(unsigned int format, int width, int height, const char* label) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+    gpuMemoryTrackTexture(texture, format, width, height, 1, 1, GPU_MEMORY_RENDER_TARGET, label);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    return texture;
+}
+
+bool initOit(Oit* oit, OitMode mode, int width, int height, int averageLayers) {
+    memset(oit, 0, sizeof(*oit));
+    oit->mode = mode;
+    oit->width = width;
+    oit->height = height;
+
+    if (!oitModeSupported(mode)) {
+        printf("OIT: the '%s' mode is not supported\n", oitModeName(mode));
+        return false;
+    }
+
+    glGenVertexArrays(1, &oit->vao);
+    if (mode == OIT_WEIGHTED) {
+        // 1. The accumulation targets, both blended with the same blend state.
+        oit->accumTexture = createTexture(GL_RGBA16F, width, height, "oit accum");
+        oit->coverageTexture = createTexture(GL_R16F, width, height, "oit coverage");
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &oit->fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, oit->fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, oit->accumTexture, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, oit->coverageTexture, 0);
+        static const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, drawBuffers);
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            printf("OIT: the accumulation FBO is incomplete (0x%x)\n", status);
+            destroyOit(oit);
+            return false;
+        }
+
+        oit->resolveProgram = createCachedProgram(fullscreen_vertex_src, composite_fragment_src);
+        glUseProgram(oit->resolveProgram);
+        glUniform1i(glGetUniformLocation(oit->resolveProgram, "uAccum"), 0);
+        glUniform1i(glGetUniformLocation(oit->resolveProgram, "uCoverage"), 1);
+        glUseProgram(0);
+    } else {
+        // 2. The heads start empty, the resolve empties them again every frame.
+        oit->nodeCapacity = width * height * (averageLayers > 0 ? averageLayers : 8);
+        size_t headWords = OIT_LIST_HEADER_WORDS + (size_t)width * height;
+        size_t bufferSize = oitMemoryBytes(oit);
+        std::vector<uint32_t> heads(headWords, 0xffffffffu);
+        heads[0] = 0;
+        heads[1] = (uint32_t)oit->nodeCapacity;
+        heads[2] = (uint32_t)width;
+        heads[3] = (uint32_t)(width * height);
+        glGenBuffers(1, &oit->nodeBuffer);
+        stateCacheBindBuffer(GL_SHADER_STORAGE_BUFFER, oit->nodeBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, bufferSize, NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, headWords * sizeof(uint32_t), heads.data());
+        stateCacheBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        gpuMemoryTrackBuffer(oit->nodeBuffer, bufferSize, GPU_MEMORY_STORAGE, "oit nodes");
+
+        oit->resolveProgram = createCachedProgram(fullscreen_vertex_310_src, resolve_fragment_src);
+    }
+    return true;
+}
+
+void destroyOit(Oit* oit) {
+    unsigned int textures[2] = { oit->accumTexture, oit->coverageTexture };
+    glDeleteTextures(2, textures);
+    gpuMemoryReleaseTextures(2, textures);
+    if (oit->nodeBuffer) {
+        glDeleteBuffers(1, &oit->nodeBuffer);
+        gpuMemoryReleaseBuffers(1, &oit->nodeBuffer);
+    }
+    glDeleteFramebuffers(1, &oit->fbo);
+    glDeleteVertexArrays(1, &oit->vao);
+    if (oit->resolveProgram) {
+        glDeleteProgram(oit->resolveProgram);
+    }
+    memset(oit, 0, sizeof(*oit));
+}
+
+const char* oitShaderHeader(OitMode mode) {
+    return mode == OIT_LINKED_LIST ? linked_list_header_src : weighted_header_src;
+}
+
+void oitBegin(Oit* oit, unsigned int framebuffer) {
+    glDepthMask(GL_FALSE);
+    if (oit->mode == OIT_WEIGHTED) {
+        // Target 0: rgb += color * alpha * weight, a *= 1 - alpha. Target 1: r += alpha * weight.
+        static const float accumClear[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+        static const float coverageClear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        glBindFramebuffer(GL_FRAMEBUFFER, oit->fbo);
+        glClearBufferfv(GL_COLOR, 0, accumClear);
+        glClearBufferfv(GL_COLOR, 1, coverageClear);
+        glEnable(GL_BLEND);
+        glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+        return;
+    }
+
+    // The resets of the previous resolve and the shader writes come before the counter reset and the appends.
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    uint32_t count = 0;
+    stateCacheBindBuffer(GL_SHADER_STORAGE_BUFFER, oit->nodeBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(count), &count);
+    stateCacheBindBufferBase(GL_SHADER_STORAGE_BUFFER, OIT_STORAGE_BINDING, oit->nodeBuffer);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+}
+
+void oitResolve(Oit* oit, unsigned int framebuffer) {
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glEnable(GL_BLEND);
+    glUseProgram(oit->resolveProgram);
+    glBindVertexArray(oit->vao);
+
+    if (oit->mode == OIT_WEIGHTED) {
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, oit->coverageTexture);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, oit->accumTexture);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    } else {
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+    if (depthTest) {
+        glEnable(GL_DEPTH_TEST);
+    }
+    stateCacheInvalidate();
+}
+
+size_t oitMemoryBytes(const Oit* oit) {
+    if (oit->mode == OIT_WEIGHTED) {
+        return (size_t)oit->width * oit->height * (8 + 2);
+    }
+    return (OIT_LIST_HEADER_WORDS + (size_t)oit->width * oit->height + (size_t)oit->nodeCapacity * 3) * sizeof(uint32_t);
+}
@@ -0,0 +1,139 @@
+/**
+ * Order independent transparency: the transparent surfaces are drawn in any order, without sorting.
+ *
+ * Two modes:
+ *
+ *  OIT_WEIGHTED     Weighted blended OIT (McGuire and Bavoil, 2013). The
+ *                   surfaces are accumulated with additive blending into two
+ *                   float targets: RGBA16F (the premultiplied colors times a
+ *                   depth weight, the alpha channel is the product of the
+ *                   transmittances) and R16F (the sum of the weighted
+ *                   alphas). The composite pass draws the weighted average
+ *                   color over the framebuffer. One blend state serves both
+ *                   targets (glBlendFuncSeparate), so no indexed blending is
+ *                   needed: Open GL ES 3.0 with GL_EXT_color_buffer_half_float
+ *                   or GL_EXT_color_buffer_float. An approximation: the
+ *                   nearer surfaces only weigh more, the order is lost.
+ *  OIT_LINKED_LIST  Per pixel linked lists, the exact reference. Every
+ *                   fragment is appended to the nodes of a storage buffer
+ *                   (an atomic counter), the same buffer holds the head node
+ *                   of every pixel (atomicExchange, so no image atomics are
+ *                   needed). The resolve pass sorts the fragments of the
+ *                   pixel (at most OIT_MAX_FRAGMENTS, the rest is dropped)
+ *                   and blends them back to front. Open GL ES 3.1 with a
+ *                   storage block in the fragment shaders. The fragments
+ *                   beyond the node capacity are lost.
+ *
+ * The weighted accumulation targets have no depth buffer: the transparent
+ * surfaces are not depth tested against the opaque ones. The linked list
+ * pass draws into the framebuffer with the color writes disabled, so its
+ * depth buffer (without writes) rejects the hidden fragments.
+ *
+ * Usage:
+ *
+ *   Oit oit;
+ *   if (!initOit(&oit, OIT_WEIGHTED, width, height, 0)) { ... not supported ... }
+ *   // the fragment shaders of the transparent surfaces: insert oitShaderHeader(mode) after the #version line
+ *   while (...) {
+ *       ... draw the opaque surfaces into the framebuffer ...
+ *       oitBegin(&oit, framebuffer);
+ *       ... draw the transparent surfaces, the fragment shaders call oitWrite(color) ...
+ *       oitResolve(&oit, framebuffer);   // composite over the framebuffer
+ *   }
+ *   destroyOit(&oit);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+ (the linked lists: Open GL ES 3.1+)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_OIT_H
+#define GLES_COMMON_OIT_H
+
+#include <stddef.h>
+
+// Storage buffer binding of the linked list mode (the heads and the nodes).
+#define OIT_STORAGE_BINDING 0
+
+// Fragments sorted per pixel by the linked list resolve.
+#define OIT_MAX_FRAGMENTS 16
+
+enum OitMode {
+    OIT_WEIGHTED,
+    OIT_LINKED_LIST,
+    OIT_MODE_COUNT,
+};
+
+struct Oit {
+    OitMode mode;
+    int width;
+    int height;
+
+    // Weighted: the accumulation targets.
+    unsigned int fbo;
+    unsigned int accumTexture;    // RGBA16F
+    unsigned int coverageTexture; // R16F
+
+    // Linked list: the head node of every pixel then the nodes (12 bytes: color, depth, next).
+    unsigned int nodeBuffer;
+    int nodeCapacity;
+
+    unsigned int resolveProgram;
+    unsigned int vao;
+};
+
+// Name of the mode for the command line and the reports ("weighted", "linked-list").
+const char* oitModeName(OitMode mode);
+
+// Look up a mode by name (OIT_MODE_COUNT if unknown).
+OitMode findOitMode(const char* name);
+
+// Check if the context supports the mode (requires a current GL ES context).
+bool oitModeSupported(OitMode mode);
+
+// Create the targets of the mode. "averageLayers": the node capacity of the linked lists per pixel (0: 8).
+/* Returns false if the mode is not supported or the FBO is incomplete. */
+bool initOit(Oit* oit, OitMode mode, int width, int height, int averageLayers);
+
+void destroyOit(Oit* oit);
+
+// Source lines for the fragment shaders of the transparent surfaces, insert them after the "#version" line.
+/* Defines OIT, sets the default float (and with the linked lists the int) precision to highp, declares the outputs (or the buffers) and:
+ *   void oitWrite(vec4 color);  the color is not premultiplied
+ * The fragment shader must not declare other outputs. */
+const char* oitShaderHeader(OitMode mode);
+
+// Start the transparent pass: bind the targets and set the blend state (weighted),
+// or bind the node buffer to the framebuffer pass with the color writes disabled (linked list).
+/* The depth writes are disabled. */
+void oitBegin(Oit* oit, unsigned int framebuffer);
+
+// Composite the transparent surfaces over the framebuffer.
+/* Leaves the framebuffer bound, the blending enabled with (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA), the
+ * color and the depth writes enabled. The linked list resolve also resets the heads for the next frame. */
+void oitResolve(Oit* oit, unsigned int framebuffer);
+
+// Allocated bytes of the targets (and of the node buffer).
+size_t oitMemoryBytes(const Oit* oit);
+
+#endif // GLES_COMMON_OIT_H
@@ -0,0 +1,373 @@
+/**
+ * Overdraw heatmap: fragments per pixel of the demo's default framebuffer.
+ * See overdraw.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/overdraw.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <GLES3/gl3.h>
+
+#include "common/gpu_memory.h"
+#include "common/program_cache.h"
+
+// Full-screen triangle without vertex attributes.
+static const char* fullscreen_vertex_src = R"(#version 300 es
+precision highp float;
+
+void main() {
+    vec2 position = vec2(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1));
+    gl_Position = vec4(position, 0.0, 1.0);
+}
+)";
+
+// Adds the value of one stencil bit (the stencil test selects the pixels which have it).
+static const char* accumulate_fragment_src = R"(#version 300 es
+precision mediump float;
+
+out vec4 outColor;
+
+uniform float uValue;
+
+void main() {
+    outColor = vec4(uValue, 0.0, 0.0, 0.0);
+}
+)";
+
+static const char* heatmap_fragment_src = R"(#version 300 es
+precision mediump float;
+
+out vec4 outColor;
+
+uniform mediump sampler2D uCounts;
+
+void main() {
+    float count = floor(texelFetch(uCounts, ivec2(gl_FragCoord.xy), 0).r * 255.0 + 0.5);
+
+    vec3 color;
+    if (count < 0.5) {
+        color = vec3(0.0);
+    } else if (count < 1.5) {
+        color = vec3(0.0, 0.2, 1.0);
+    } else if (count < 2.5) {
+        color = vec3(0.0, 0.9, 1.0);
+    } else if (count < 3.5) {
+        color = vec3(0.0, 1.0, 0.2);
+    } else if (count < 5.5) {
+        color = vec3(1.0, 1.0, 0.0);
+    } else if (count < 7.5) {
+        color = vec3(1.0, 0.1, 0.0);
+    } else {
+        color = vec3(1.0);
+    }
+    outColor = vec4(color, 1.0);
+}
+)";
+
+struct Overdraw {
+    unsigned int accumulateProgram;
+    int valueLoc;
+    unsigned int heatmapProgram;
+    unsigned int vao;
+
+    // R8 copy of the counts for the heatmap.
+    unsigned int countTexture;
+    int width;
+    int height;
+    std::vector<uint8_t> pixels;
+
+    // Statistics of the whole run and of the current print interval.
+    int frames;
+    double sumAverage;
+    int maxCount;
+    int intervalFrames;
+    double intervalAverage;
+    double intervalOverdrawn;
+    int intervalMax;
+    double lastPrintTime;
+};
+
+// GL state changed by the resolve.
+struct SavedState {
+    int program;
+    int vertexArray;
+    int drawFramebuffer;
+    int readFramebuffer;
+    int viewport[4];
+    int activeTexture;
+    int texture;
+    int sampler;
+    int packBuffer;
+    int packAlignment;
+
+    GLboolean blend;
+    GLboolean depthTest;
+    GLboolean depthMask;
+    GLboolean cullFace;
+    GLboolean scissorTest;
+    GLboolean stencilTest;
+    GLboolean colorMask[4];
+    int blendSrcRGB, blendDstRGB, blendSrcAlpha, blendDstAlpha;
+    int blendEquationRGB, blendEquationAlpha;
+    float clearColor[4];
+};
+
+static double secondsNow() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void saveState(SavedState* state) {
+    glGetIntegerv(GL_CURRENT_PROGRAM, &state->program);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &state->vertexArray);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &state->drawFramebuffer);
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &state->readFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, state->viewport);
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &state->activeTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &state->texture);
+    glGetIntegerv(GL_SAMPLER_BINDING, &state->sampler);
+    glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &state->packBuffer);
+    glGetIntegerv(GL_PACK_ALIGNMENT, &state->packAlignment);
+
+    state->blend = glIsEnabled(GL_BLEND);
+    state->depthTest = glIsEnabled(GL_DEPTH_TEST);
+    state->cullFace = glIsEnabled(GL_CULL_FACE);
+    state->scissorTest = glIsEnabled(GL_SCISSOR_TEST);
+    state->stencilTest = glIsEnabled(GL_STENCIL_TEST);
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &state->depthMask);
+    glGetBooleanv(GL_COLOR_WRITEMASK, state->colorMask);
+    glGetIntegerv(GL_BLEND_SRC_RGB, &state->blendSrcRGB);
+    glGetIntegerv(GL_BLEND_DST_RGB, &state->blendDstRGB);
+    glGetIntegerv(GL_BLEND_SRC_ALPHA, &state->blendSrcAlpha);
+    glGetIntegerv(GL_BLEND_DST_ALPHA, &state->blendDstAlpha);
+    glGetIntegerv(GL_BLEND_EQUATION_RGB, &state->blendEquationRGB);
+    glGetIntegerv(GL_BLEND_EQUATION_ALPHA, &state->blendEquationAlpha);
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, state->clearColor);
+}
+
+static void restoreState(const SavedState* state) {
+    glUseProgram(state->program);
+    glBindVertexArray(state->vertexArray);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, state->drawFramebuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, state->readFramebuffer);
+    glViewport(state->viewport[0], state->viewport[1], state->viewport[2], state->viewport[3]);
+    glBindTexture(GL_TEXTURE_2D, state->texture);
+    glBindSampler(0, state->sampler);
+    glActiveTexture(state->activeTexture);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, state->packBuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, state->packAlignment);
+
+    (state->blend ? glEnable : glDisable)(GL_BLEND);
+    (state->depthTest ? glEnable : glDisable)(GL_DEPTH_TEST);
+    (state->cullFace ? glEnable : glDisable)(GL_CULL_FACE);
+    (state->scissorTest ? glEnable : glDisable)(GL_SCISSOR_TEST);
+    (state->stencilTest ? glEnable : glDisable)(GL_STENCIL_TEST);
+    glDepthMask(state->depthMask);
+    glColorMask(state->colorMask[0], state->colorMask[1], state->colorMask[2], state->colorMask[3]);
+    glBlendFuncSeparate(state->blendSrcRGB, state->blendDstRGB, state->blendSrcAlpha, state->blendDstAlpha);
+    glBlendEquationSeparate(state->blendEquationRGB, state->blendEquationAlpha);
+    glClearColor(state->clearColor[0], state->clearColor[1], state->clearColor[2], state->clearColor[3]);
+}
+
+// Clear the counts and count every fragment of the next frame.
+static void startCounting(unsigned int framebuffer) {
+    int drawFramebuffer;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    GLboolean scissorTest = glIsEnabled(GL_SCISSOR_TEST);
+    glDisable(GL_SCISSOR_TEST);
+    glStencilMask(0xff);
+    glClearStencil(0);
+    glClear(GL_STENCIL_BUFFER_BIT);
+    if (scissorTest) {
+        glEnable(GL_SCISSOR_TEST);
+    }
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer);
+
+    /* The stencil test always passes, also counts the fragments which fail the depth test. */
+    glEnable(GL_STENCIL_TEST);
+    glStencilFunc(GL_ALWAYS, 0, 0xff);
+    glStencilOp(GL_KEEP, GL_INCR, GL_INCR);
+}
+
+Overdraw* createOverdraw(unsigned int framebuffer) {
+    int stencilBits = 0;
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, framebuffer == 0 ? GL_STENCIL : GL_STENCIL_ATTACHMENT,
+                                          GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE, &stencilBits);
+    if (stencilBits < 8) {
+        printf("Overdraw: the framebuffer has no 8 bit stencil buffer (%d bits)\n", stencilBits);
+        return NULL;
+    }
+
+    Overdraw* overdraw = new Overdraw();
+    overdraw->accumulateProgram = createCachedProgram(fullscreen_vertex_src, accumulate_fragment_src);
+    overdraw->valueLoc = glGetUniformLocation(overdraw->accumulateProgram, "uValue");
+    overdraw->heatmapProgram = createCachedProgram(fullscreen_vertex_src, heatmap_fragment_src);
+    glUseProgram(overdraw->heatmapProgram);
+    glUniform1i(glGetUniformLocation(overdraw->heatmapProgram, "uCounts"), 0);
+    glUseProgram(0);
+    glGenVertexArrays(1, &overdraw->vao);
+
+    overdraw->countTexture = 0;
+    overdraw->width = 0;
+    overdraw->height = 0;
+
+    overdraw->frames = 0;
+    overdraw->sumAverage = 0.0;
+    overdraw->maxCount = 0;
+    overdraw->intervalFrames = 0;
+    overdraw->intervalAverage = 0.0;
+    overdraw->intervalOverdrawn = 0.0;
+    overdraw->intervalMax = 0;
+    overdraw->lastPrintTime = secondsNow();
+
+    startCounting(framebuffer);
+    return overdraw;
+}
+
+void destroyOverdraw(Overdraw* overdraw) {
+    if (overdraw->frames > 0) {
+        printf("Overdraw: %d frames, average %.2f fragments/pixel, max %d%s\n", overdraw->frames,
+               overdraw->sumAverage / overdraw->frames, overdraw->maxCount, overdraw->maxCount >= 255 ? "+" : "");
+    }
+
+    glDeleteTextures(1, &overdraw->countTexture);
+    gpuMemoryReleaseTextures(1, &overdraw->countTexture);
+    glDeleteVertexArrays(1, &overdraw->vao);
+    glDeleteProgram(overdraw->accumulateProgram);
+    glDeleteProgram(overdraw->heatmapProgram);
+    delete overdraw;
+}
+
+static void updateStatistics(Overdraw* overdraw) {
+    uint64_t sum = 0;
+    int overdrawn = 0;
+    int maxCount = 0;
+    size_t pixelCount = (size_t)overdraw->width * overdraw->height;
+    for (size_t idx = 0; idx < pixelCount; idx++) {
+        int count = overdraw->pixels[idx * 4];
+        sum += count;
+        overdrawn += count > 1;
+        maxCount = std::max(maxCount, count);
+    }
+
+    double average = pixelCount ? (double)sum / pixelCount : 0.0;
+    overdraw->frames++;
+    overdraw->sumAverage += average;
+    overdraw->maxCount = std::max(overdraw->maxCount, maxCount);
+
+    overdraw->intervalFrames++;
+    overdraw->intervalAverage += average;
+    overdraw->intervalOverdrawn += pixelCount ? 100.0 * overdrawn / pixelCount : 0.0;
+    overdraw->intervalMax = std::max(overdraw->intervalMax, maxCount);
+
+    double now = secondsNow();
+    if (now - overdraw->lastPrintTime < 1.0) {
+        return;
+    }
+
+    printf("Overdraw: average %.2f fragments/pixel, max %d, %.1f%% of the pixels drawn more than once\n",
+           overdraw->intervalAverage / overdraw->intervalFrames, overdraw->intervalMax,
+           overdraw->intervalOverdrawn / overdraw->intervalFrames);
+    overdraw->intervalFrames = 0;
+    overdraw->intervalAverage = 0.0;
+    overdraw->intervalOverdrawn = 0.0;
+    overdraw->intervalMax = 0;
+    overdraw->lastPrintTime = now;
+}
+
+void overdrawResolve(Overdraw* overdraw, unsigned int framebuffer, int width, int height) {
+    SavedState state;
+    saveState(&state);
+
+    // 1. The count texture follows the framebuffer size.
+    glActiveTexture(GL_TEXTURE0);
+    if (overdraw->width != width || overdraw->height != height) {
+        glDeleteTextures(1, &overdraw->countTexture);
+        gpuMemoryReleaseTextures(1, &overdraw->countTexture);
+        glGenTextures(1, &overdraw->countTexture);
+        glBindTexture(GL_TEXTURE_2D, overdraw->countTexture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8, width, height);
+        gpuMemoryTrackTexture(overdraw->countTexture, GL_R8, width, height, 1, 1, GPU_MEMORY_RENDER_TARGET,
+                              "overdraw count");
+
+        overdraw->width = width;
+        overdraw->height = height;
+        overdraw->pixels.resize((size_t)width * height * 4);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+    glBindVertexArray(overdraw->vao);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_SCISSOR_TEST);
+    glDepthMask(GL_FALSE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glStencilMask(0x00);
+
+    // 2. Accumulate the stencil counts into the red channel, one additive pass per bit.
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glUseProgram(overdraw->accumulateProgram);
+    glEnable(GL_STENCIL_TEST);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+    glEnable(GL_BLEND);
+    glBlendEquation(GL_FUNC_ADD);
+    glBlendFunc(GL_ONE, GL_ONE);
+    for (int bit = 0; bit < 8; bit++) {
+        /* The bit values are exact in the 8 bit unorm channel: the sum is the count. */
+        glStencilFunc(GL_EQUAL, 1 << bit, 1 << bit);
+        glUniform1f(overdraw->valueLoc, (1 << bit) / 255.0f);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    glDisable(GL_BLEND);
+    glDisable(GL_STENCIL_TEST);
+
+    // 3. Read back the counts for the statistics and copy them for the heatmap.
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, overdraw->pixels.data());
+    updateStatistics(overdraw);
+
+    glBindTexture(GL_TEXTURE_2D, overdraw->countTexture);
+    glBindSampler(0, 0);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+
+    // 4. Colour map.
+    glUseProgram(overdraw->heatmapProgram);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    restoreState(&state);
+    startCounting(framebuffer);
+}
@@ -0,0 +1,62 @@
+/**
+ * Overdraw heatmap: fragments per pixel of the demo's default framebuffer.
+ *
+ * Enabled by the "--overdraw-heatmap" option of the demo context. Every rasterized
+ * fragment increments the stencil value of its pixel (GL_INCR, the depth
+ * failed fragments included), so the counting works with any shader and any
+ * blend state of the demo. In demoSwapBuffers the frame is resolved:
+ *
+ *  1. The stencil counts are accumulated into the colour buffer with additive
+ *     blending: one stencil tested full-screen pass per bit of the count
+ *     (8 passes, each adds its bit value into the R8 unorm channel).
+ *  2. The counts are read back for the statistics and copied into an R8 texture.
+ *  3. The texture is colour-mapped onto the framebuffer:
+ *     black: no fragment, blue: 1, cyan: 2, green: 3, yellow: 4-5, red: 6-7, white: 8+.
+ *
+ * The average and the maximum fragments per pixel (and the pixels drawn more
+ * than once) are printed every second and summarized when the context is
+ * destroyed. The counts saturate at 255.
+ *
+ * Only the draws into demoDefaultFramebuffer() are counted (intermediate FBOs
+ * have their own or no stencil buffer), a blit into the framebuffer is not a
+ * fragment. The demo must not use the stencil buffer of the default
+ * framebuffer, and the GL state is restored after the resolve.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_OVERDRAW_H
+#define GLES_COMMON_OVERDRAW_H
+
+struct Overdraw;
+
+// Create the fragment counter. Requires a current GL ES context with a stencil buffer.
+/* Returns NULL if the default framebuffer has no stencil buffer. */
+Overdraw* createOverdraw(unsigned int framebuffer);
+
+// Print the summary and release the GL objects.
+void destroyOverdraw(Overdraw* overdraw);
+
+// Draw the heatmap of the frame onto the framebuffer and start counting the next frame.
+/* Call before the buffer swap, the size is the current size of the framebuffer. */
+void overdrawResolve(Overdraw* overdraw, unsigned int framebuffer, int width, int height);
+
+#endif // GLES_COMMON_OVERDRAW_H
@@ -0,0 +1,491 @@
+/**
+ * GPU particle system. See particle_system.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/particle_system.h"
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <GLES3/gl31.h>
+
+#include "common/program_cache.h"
+
+// The counters and the indirect command at the start of the dead list buffer (in uints).
+#define PARTICLE_HEADER_SIZE 8
+#define PARTICLE_DEAD_COUNT 4
+#define PARTICLE_ALIVE_COUNT 6
+
+// Inserted after the #version line of every kernel (after the runtime's prelude).
+static const char* particle_common_src = R"(
+struct Particle {
+    vec4 position; // w: age
+    vec4 velocity; // w: lifetime
+};
+
+// The header of the dead list buffer, the first 4 values are the DrawArraysIndirectCommand of the draw.
+struct ParticleCounters {
+    uint drawCount;
+    uint instanceCount;
+    uint drawFirst;
+    uint drawReserved;
+    uint deadCount;
+    uint emitBudget;
+    uint aliveCount[2];
+};
+)";
+
+// uParams: x = particles to emit (negative: keep the budget), y = alive list to empty (negative: none).
+static const char* particle_counters_src = R"(#version 310 es
+layout(std430, binding = 0) buffer DeadList { ParticleCounters counters; uint dead[]; };
+
+void main() {
+    if (GLOBAL_INDEX != 0) {
+        return;
+    }
+
+    if (uParams.x >= 0) {
+        counters.emitBudget = min(uint(uParams.x), counters.deadCount);
+    }
+    if (uParams.y >= 0) {
+        counters.aliveCount[uParams.y] = 0u;
+    }
+}
+)";
+
+// uParams: x = particles to emit, y = alive list, z = seed.
+static const char* particle_emit_src = R"(#version 310 es
+layout(std430, binding = 0) writeonly buffer Particles { Particle particles[]; };
+layout(std430, binding = 1) buffer DeadList { ParticleCounters counters; uint dead[]; };
+layout(std430, binding = 2) writeonly buffer AliveList { uint alive[]; };
+
+uniform vec4 uEmitterPosition;  // w: radius
+uniform vec4 uEmitterDirection; // w: cosine of the cone half angle
+uniform vec2 uSpeed;
+uniform vec2 uLifetime;
+
+uint hash(uint value) {
+    value ^= value >> 16;
+    value *= 0x7feb352du;
+    value ^= value >> 15;
+    value *= 0x846ca68bu;
+    value ^= value >> 16;
+    return value;
+}
+
+float random(inout uint state) {
+    state = hash(state);
+    return float(state >> 8) / 16777216.0;
+}
+
+void main() {
+    uint idx = uint(GLOBAL_INDEX);
+    if (idx >= counters.emitBudget) {
+        return;
+    }
+
+    // 1. The budget is at most the dead count: every invocation gets a slot.
+    uint slot = dead[atomicAdd(counters.deadCount, 0xFFFFFFFFu) - 1u];
+
+    // 2. A direction in the cone around the emitter direction and a point in the emitter sphere.
+    uint state = hash(idx ^ hash(uint(uParams.z)));
+    float cosTheta = mix(uEmitterDirection.w, 1.0, random(state));
+    float sinTheta = sqrt(max(1.0 - cosTheta * cosTheta, 0.0));
+    float phi = random(state) * 6.2831853;
+    vec3 axis = uEmitterDirection.xyz;
+    vec3 tangent = normalize(cross(abs(axis.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0), axis));
+    vec3 bitangent = cross(axis, tangent);
+    vec3 direction = (tangent * cos(phi) + bitangent * sin(phi)) * sinTheta + axis * cosTheta;
+
+    vec3 offset = vec3(random(state), random(state), random(state)) * 2.0 - 1.0;
+    vec3 position = uEmitterPosition.xyz + offset * uEmitterPosition.w;
+    float speed = mix(uSpeed.x, uSpeed.y, random(state));
+    float lifetime = mix(uLifetime.x, uLifetime.y, random(state));
+
+    particles[slot] = Particle(vec4(position, 0.0), vec4(direction * speed, lifetime));
+    alive[atomicAdd(counters.aliveCount[uParams.y], 1u)] = slot;
+}
+)";
+
+// uParams: x = capacity, y = input alive list, z = output alive list.
+static const char* particle_simulate_src = R"(#version 310 es
+layout(std430, binding = 0) buffer Particles { Particle particles[]; };
+layout(std430, binding = 1) buffer DeadList { ParticleCounters counters; uint dead[]; };
+layout(std430, binding = 2) readonly buffer AliveIn { uint aliveIn[]; };
+layout(std430, binding = 3) writeonly buffer AliveOut { uint aliveOut[]; };
+
+uniform float uDeltaTime;
+uniform vec3 uGravity;
+uniform float uDrag;
+uniform vec2 uGround; // x: height, y: bounce
+
+void main() {
+    uint idx = uint(GLOBAL_INDEX);
+    if (idx >= counters.aliveCount[uParams.y]) {
+        return;
+    }
+
+    uint slot = aliveIn[idx];
+    Particle particle = particles[slot];
+    float age = particle.position.w + uDeltaTime;
+    if (age >= particle.velocity.w) {
+        dead[atomicAdd(counters.deadCount, 1u)] = slot;
+        return;
+    }
+
+    vec3 velocity = particle.velocity.xyz * max(1.0 - uDrag * uDeltaTime, 0.0) + uGravity * uDeltaTime;
+    vec3 position = particle.position.xyz + velocity * uDeltaTime;
+    if (position.y < uGround.x && velocity.y < 0.0) {
+        position.y = uGround.x;
+        velocity.y = -velocity.y * uGround.y;
+    }
+
+    particles[slot] = Particle(vec4(position, age), vec4(velocity, particle.velocity.w));
+    aliveOut[atomicAdd(counters.aliveCount[uParams.z], 1u)] = slot;
+}
+)";
+
+// Back to front: the key is the inverted squared distance, the unused entries get the largest key.
+/* uParams: x = capacity, y = alive list. */
+static const char* particle_keys_src = R"(#version 310 es
+layout(std430, binding = 0) readonly buffer Particles { Particle particles[]; };
+layout(std430, binding = 1) readonly buffer DeadList { ParticleCounters counters; uint dead[]; };
+layout(std430, binding = 2) readonly buffer AliveList { uint alive[]; };
+layout(std430, binding = 3) writeonly buffer Keys { uint keys[]; };
+
+uniform vec3 uCamera;
+
+void main() {
+    uint idx = uint(GLOBAL_INDEX);
+    if (idx >= uint(uParams.x)) {
+        return;
+    }
+
+    if (idx >= counters.aliveCount[uParams.y]) {
+        keys[idx] = 0xFFFFFFFFu;
+        return;
+    }
+
+    vec3 delta = particles[alive[idx]].position.xyz - uCamera;
+    keys[idx] = ~floatBitsToUint(dot(delta, delta));
+}
+)";
+
+// Copy the alive particles in list order for the draw and set the instance count. uParams: y = alive list.
+static const char* particle_gather_src = R"(#version 310 es
+layout(std430, binding = 0) readonly buffer Particles { Particle particles[]; };
+layout(std430, binding = 1) buffer DeadList { ParticleCounters counters; uint dead[]; };
+layout(std430, binding = 2) readonly buffer AliveList { uint alive[]; };
+layout(std430, binding = 3) writeonly buffer DrawParticles { Particle drawParticles[]; };
+
+void main() {
+    uint idx = uint(GLOBAL_INDEX);
+    uint count = counters.aliveCount[uParams.y];
+    if (idx == 0u) {
+        counters.instanceCount = count;
+    }
+    if (idx >= count) {
+        return;
+    }
+
+    drawParticles[idx] = particles[alive[idx]];
+}
+)";
+
+// Every instance is a quad (4 vertex strip) facing the camera, the corner comes from gl_VertexID.
+static const char* particle_vertex_src = R"(#version 300 es
+precision highp float;
+
+in vec4 aPosition; // w: age
+in vec4 aVelocity; // w: lifetime
+
+uniform mat4 uView;
+uniform mat4 uProjection;
+uniform float uSize;
+
+out vec2 vCorner;
+out vec4 vColor;
+
+void main() {
+    vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1)) * 2.0 - 1.0;
+    float life = clamp(aPosition.w / aVelocity.w, 0.0, 1.0);
+
+    // The offset is added in view space: the quad is parallel to the image plane.
+    vec4 viewPosition = uView * vec4(aPosition.xyz, 1.0);
+    viewPosition.xy += corner * uSize * mix(0.5, 1.5, life);
+    gl_Position = uProjection * viewPosition;
+
+    vCorner = corner;
+    vColor = vec4(mix(vec3(1.0, 0.85, 0.4), vec3(0.8, 0.2, 0.1), life), (1.0 - life) * 0.6);
+}
+)";
+
+static const char* particle_fragment_src = R"(#version 300 es
+precision mediump float;
+
+in vec2 vCorner;
+in vec4 vColor;
+
+out vec4 outColor;
+
+void main() {
+    float falloff = max(1.0 - dot(vCorner, vCorner), 0.0);
+    outColor = vec4(vColor.rgb, vColor.a * falloff);
+}
+)";
+
+static void buildParticleKernel(ComputeKernel* kernel, const char* source) {
+    std::string kernelSrc = source;
+    kernelSrc.insert(kernelSrc.find('\n') + 1, particle_common_src);
+    createComputeKernel(kernel, kernelSrc.c_str(), 1);
+}
+
+void initParticleSystem(ParticleSystem* system, int capacity) {
+    system->capacity = capacity;
+    system->current = 0;
+    system->frame = 0;
+    system->time = 0.0;
+    system->aliveBound = 0;
+
+    system->gravity[0] = 0.0f;
+    system->gravity[1] = -9.81f;
+    system->gravity[2] = 0.0f;
+    system->drag = 0.1f;
+    system->groundHeight = 0.0f;
+    system->bounce = 0.4f;
+    system->particleSize = 0.02f;
+
+    // 1. The kernels and the radix sort of the whole pool.
+    buildParticleKernel(&system->countersKernel, particle_counters_src);
+    buildParticleKernel(&system->emitKernel, particle_emit_src);
+    buildParticleKernel(&system->simulateKernel, particle_simulate_src);
+    buildParticleKernel(&system->keysKernel, particle_keys_src);
+    buildParticleKernel(&system->gatherKernel, particle_gather_src);
+
+    initComputePrimitives(&system->prims);
+    computePrimitivesReserve(&system->prims, capacity);
+    initComputeQueue(&system->queue);
+
+    // 2. Every slot starts in the dead list, the draw command is a 4 vertex strip without instances.
+    std::vector<unsigned int> deadList(PARTICLE_HEADER_SIZE + capacity, 0);
+    deadList[0] = 4;
+    deadList[PARTICLE_DEAD_COUNT] = (unsigned int)capacity;
+    for (int idx = 0; idx < capacity; idx++) {
+        deadList[PARTICLE_HEADER_SIZE + idx] = (unsigned int)(capacity - 1 - idx);
+    }
+
+    system->particles = createStorageBuffer<ParticleState>(capacity);
+    system->drawParticles = createStorageBuffer<ParticleState>(capacity);
+    system->aliveLists[0] = createStorageBuffer<unsigned int>(capacity);
+    system->aliveLists[1] = createStorageBuffer<unsigned int>(capacity);
+    system->deadList = createStorageBuffer<unsigned int>((int)deadList.size(), deadList.data());
+    system->sortKeys = createStorageBuffer<unsigned int>(capacity);
+
+    // 3. The draw: the gathered particles are per instance attributes.
+    system->drawProgram = createCachedProgram(particle_vertex_src, particle_fragment_src);
+    system->viewLoc = glGetUniformLocation(system->drawProgram, "uView");
+    system->projectionLoc = glGetUniformLocation(system->drawProgram, "uProjection");
+    system->particleSizeLoc = glGetUniformLocation(system->drawProgram, "uSize");
+
+    int aPositionLoc = glGetAttribLocation(system->drawProgram, "aPosition");
+    int aVelocityLoc = glGetAttribLocation(system->drawProgram, "aVelocity");
+    glGenVertexArrays(1, &system->drawVao);
+    glBindVertexArray(system->drawVao);
+    glBindBuffer(GL_ARRAY_BUFFER, system->drawParticles.buffer);
+    glVertexAttribPointer(aPositionLoc, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleState), NULL);
+    glVertexAttribPointer(aVelocityLoc, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleState),
+                          (void*)offsetof(ParticleState, velocity));
+    glVertexAttribDivisor(aPositionLoc, 1);
+    glVertexAttribDivisor(aVelocityLoc, 1);
+    glEnableVertexAttribArray(aPositionLoc);
+    glEnableVertexAttribArray(aVelocityLoc);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void destroyParticleSystem(ParticleSystem* system) {
+    glDeleteVertexArrays(1, &system->drawVao);
+    glDeleteProgram(system->drawProgram);
+
+    destroyStorageBuffer(&system->particles);
+    destroyStorageBuffer(&system->drawParticles);
+    destroyStorageBuffer(&system->aliveLists[0]);
+    destroyStorageBuffer(&system->aliveLists[1]);
+    destroyStorageBuffer(&system->deadList);
+    destroyStorageBuffer(&system->sortKeys);
+
+    destroyComputePrimitives(&system->prims);
+    destroyComputeKernel(&system->countersKernel);
+    destroyComputeKernel(&system->emitKernel);
+    destroyComputeKernel(&system->simulateKernel);
+    destroyComputeKernel(&system->keysKernel);
+    destroyComputeKernel(&system->gatherKernel);
+}
+
+void particleEmit(ParticleSystem* system, const ParticleEmitter& emitter, int count) {
+    if (count <= 0) {
+        return;
+    }
+
+    unsigned int program = system->emitKernel.program;
+    glProgramUniform4f(program, glGetUniformLocation(program, "uEmitterPosition"),
+                       emitter.position[0], emitter.position[1], emitter.position[2], emitter.radius);
+    glProgramUniform4f(program, glGetUniformLocation(program, "uEmitterDirection"),
+                       emitter.direction[0], emitter.direction[1], emitter.direction[2], emitter.spread);
+    glProgramUniform2f(program, glGetUniformLocation(program, "uSpeed"), emitter.speed[0], emitter.speed[1]);
+    glProgramUniform2f(program, glGetUniformLocation(program, "uLifetime"), emitter.lifetime[0], emitter.lifetime[1]);
+
+    // 1. Clamp the emission to the dead count on the GPU, the CPU doesn't know it.
+    ComputeQueue* queue = &system->queue;
+    computeQueueAdd(queue, &system->countersKernel, 1, 1, 1);
+    computeQueueBind(queue, 0, system->deadList.buffer);
+    computeQueueParams(queue, count, -1);
+    computeQueueBarrier(queue, GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // 2. One invocation per requested particle, those above the budget return.
+    computeQueueAdd(queue, &system->emitKernel, count, 1, 1);
+    computeQueueBind(queue, 0, system->particles.buffer);
+    computeQueueBind(queue, 1, system->deadList.buffer);
+    computeQueueBind(queue, 2, system->aliveLists[system->current].buffer);
+    computeQueueParams(queue, count, system->current, (int)system->frame++);
+    computeQueueBarrier(queue, GL_SHADER_STORAGE_BARRIER_BIT);
+    computeQueueSubmit(queue);
+
+    // 3. Every emitted particle may be alive until the longest lifetime passes.
+    /* With a margin for the rounding of the float ages summed on the GPU. */
+    ParticleEmission emission = { system->time + emitter.lifetime[1] + 0.1, count };
+    system->emissions.push_back(emission);
+    system->aliveBound = std::min(system->aliveBound + count, system->capacity);
+}
+
+void particleSimulate(ParticleSystem* system, float deltaTime) {
+    unsigned int program = system->simulateKernel.program;
+    glProgramUniform1f(program, glGetUniformLocation(program, "uDeltaTime"), deltaTime);
+    glProgramUniform3fv(program, glGetUniformLocation(program, "uGravity"), 1, system->gravity);
+    glProgramUniform1f(program, glGetUniformLocation(program, "uDrag"), system->drag);
+    glProgramUniform2f(program, glGetUniformLocation(program, "uGround"), system->groundHeight, system->bounce);
+
+    // 1. Empty the output list. The grid covers the particles alive before the step.
+    int next = 1 - system->current;
+    int grid = system->aliveBound;
+    ComputeQueue* queue = &system->queue;
+    computeQueueAdd(queue, &system->countersKernel, 1, 1, 1);
+    computeQueueBind(queue, 0, system->deadList.buffer);
+    computeQueueParams(queue, -1, next);
+    computeQueueBarrier(queue, GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // 2. The survivors are compacted into the output list, the others are pushed onto the dead list.
+    computeQueueAdd(queue, &system->simulateKernel, grid, 1, 1);
+    computeQueueBind(queue, 0, system->particles.buffer);
+    computeQueueBind(queue, 1, system->deadList.buffer);
+    computeQueueBind(queue, 2, system->aliveLists[system->current].buffer);
+    computeQueueBind(queue, 3, system->aliveLists[next].buffer);
+    computeQueueParams(queue, system->capacity, system->current, next);
+    computeQueueBarrier(queue, GL_SHADER_STORAGE_BARRIER_BIT);
+    computeQueueSubmit(queue);
+
+    system->current = next;
+
+    // 3. Drop the emissions whose particles are all dead after the step.
+    system->time += deltaTime;
+    int bound = 0;
+    size_t kept = 0;
+    for (size_t idx = 0; idx < system->emissions.size(); idx++) {
+        if (system->emissions[idx].end > system->time) {
+            bound += system->emissions[idx].count;
+            system->emissions[kept++] = system->emissions[idx];
+        }
+    }
+    system->emissions.resize(kept);
+    system->aliveBound = std::min(bound, system->capacity);
+}
+
+void particleSort(ParticleSystem* system, const float camera[3]) {
+    unsigned int program = system->keysKernel.program;
+    glProgramUniform3fv(program, glGetUniformLocation(program, "uCamera"), 1, camera);
+
+    // Only the first "aliveBound" entries of the list can be alive, the rest isn't sorted.
+    int count = system->aliveBound;
+    if (count <= 0) {
+        return;
+    }
+
+    ComputeQueue* queue = &system->queue;
+    computeQueueAdd(queue, &system->keysKernel, count, 1, 1);
+    computeQueueBind(queue, 0, system->particles.buffer);
+    computeQueueBind(queue, 1, system->deadList.buffer);
+    computeQueueBind(queue, 2, system->aliveLists[system->current].buffer);
+    computeQueueBind(queue, 3, system->sortKeys.buffer);
+    computeQueueParams(queue, count, system->current);
+    computeQueueBarrier(queue, GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // The alive list is the value array of the sort: it ends up in back to front order.
+    computeRadixSort(&system->prims, queue, system->sortKeys, system->aliveLists[system->current], count);
+    computeQueueSubmit(queue);
+}
+
+void particleDraw(ParticleSystem* system, const float* view, const float* projection, bool additive) {
+    // 1. Copy the particles in draw order, the instance count goes into the indirect command.
+    ComputeQueue* queue = &system->queue;
+    computeQueueAdd(queue, &system->gatherKernel, std::max(system->aliveBound, 1), 1, 1);
+    computeQueueBind(queue, 0, system->particles.buffer);
+    computeQueueBind(queue, 1, system->deadList.buffer);
+    computeQueueBind(queue, 2, system->aliveLists[system->current].buffer);
+    computeQueueBind(queue, 3, system->drawParticles.buffer);
+    computeQueueParams(queue, system->capacity, system->current);
+    computeQueueBarrier(queue, GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    computeQueueSubmit(queue);
+
+    // 2. One instanced strip per particle, blended without depth writes.
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    GLboolean depthMask = GL_TRUE;
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, additive ? GL_ONE : GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);
+
+    glUseProgram(system->drawProgram);
+    glUniformMatrix4fv(system->viewLoc, 1, GL_FALSE, view);
+    glUniformMatrix4fv(system->projectionLoc, 1, GL_FALSE, projection);
+    glUniform1f(system->particleSizeLoc, system->particleSize);
+    glBindVertexArray(system->drawVao);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, system->deadList.buffer);
+    glDrawArraysIndirect(GL_TRIANGLE_STRIP, NULL);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+
+    glDepthMask(depthMask);
+    if (!blend) {
+        glDisable(GL_BLEND);
+    }
+}
+
+int particleAliveCount(ParticleSystem* system) {
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    unsigned int count = 0;
+    readStorageBuffer(system->deadList, PARTICLE_ALIVE_COUNT + system->current, 1, &count);
+    return (int)count;
+}
@@ -0,0 +1,166 @@
+/**
+ * GPU particle system: emission, simulation, depth sort and billboard
+ * drawing on the GPU, the CPU only issues the passes.
+ *
+ * The particles live in a fixed pool of "capacity" slots. The free slots are
+ * a dead list (a stack of slot indices), the live ones an alive list; both
+ * are sized by atomic counters in a small header of the dead list buffer,
+ * which also holds the DrawArraysIndirectCommand of the draw. Every frame:
+ *  * emit:     takes up to N slots from the dead list (never more than it
+ *              holds), initializes them from the emitter and appends them to
+ *              the alive list.
+ *  * simulate: integrates the alive particles (gravity, drag, a ground plane),
+ *              the particles at the end of their life go back to the dead
+ *              list, the others are appended to the other alive list
+ *              (ping-pong: the list is compacted every frame).
+ *  * sort:     writes a back-to-front depth key per alive particle and radix
+ *              sorts the alive list by it (computeRadixSort), the alive count
+ *              isn't known on the CPU so the whole pool is sorted with the
+ *              unused keys at the end.
+ *  * draw:     copies the alive particles in list order into the vertex
+ *              buffer of the draw and sets the instance count of the indirect
+ *              command, then every particle is an instance of a 4 vertex
+ *              strip: the vertex shader expands gl_VertexID into the corners
+ *              of a camera-facing quad. Alpha blended, no depth writes.
+ *
+ * The CPU never reads the counters back. It keeps the emitted counts with
+ * the end of their longest lifetime: the particles of an older emission are
+ * dead, so the sum of the newer ones is an upper bound of the alive count.
+ * The simulate, sort and draw passes cover this bound (the invocations above
+ * the alive count return right away, the compute runtime has no indirect
+ * dispatches), a partly filled pool doesn't pay for its unused slots.
+ * Additive blending doesn't depend on the order: the sort pass can be skipped.
+ *
+ * Usage:
+ *
+ *   ParticleSystem particles;
+ *   initParticleSystem(&particles, 1000000);
+ *   while (...) {
+ *       particleEmit(&particles, emitter, count);
+ *       particleSimulate(&particles, deltaTime);
+ *       particleSort(&particles, cameraPosition);
+ *       particleDraw(&particles, view, projection);
+ *   }
+ *   destroyParticleSystem(&particles);
+ *
+ * Every pass submits its own dispatches, so they can be timed separately.
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.1+ (compute shaders, indirect draws)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_PARTICLE_SYSTEM_H
+#define GLES_COMMON_PARTICLE_SYSTEM_H
+
+#include <vector>
+
+#include "common/compute.h"
+#include "common/compute_primitives.h"
+
+// One particle, also the std430 layout of the GPU buffers (vec4, vec4).
+struct ParticleState {
+    float position[3];
+    float age;      // seconds since the emission
+    float velocity[3];
+    float lifetime; // seconds
+};
+
+// The particles are emitted from a sphere around "position" into a cone around "direction".
+struct ParticleEmitter {
+    float position[3];
+    float radius;
+    float direction[3]; // normalized
+    float spread;       // cosine of the half angle of the cone
+    float speed[2];     // min, max
+    float lifetime[2];  // min, max, in seconds
+};
+
+// Particles emitted at "time" are dead after "end" (simulation time in seconds).
+struct ParticleEmission {
+    double end;
+    int count;
+};
+
+struct ParticleSystem {
+    int capacity;
+
+    ComputeKernel countersKernel;
+    ComputeKernel emitKernel;
+    ComputeKernel simulateKernel;
+    ComputeKernel keysKernel;
+    ComputeKernel gatherKernel;
+    ComputePrimitives prims;
+    ComputeQueue queue;
+
+    StorageBuffer<ParticleState> particles;     // the pool
+    StorageBuffer<ParticleState> drawParticles; // the alive particles in draw order, the instance data of the draw
+    StorageBuffer<unsigned int> aliveLists[2];  // slot indices
+    StorageBuffer<unsigned int> deadList;       // header (indirect command, counters) + slot indices
+    StorageBuffer<unsigned int> sortKeys;
+
+    unsigned int drawProgram;
+    unsigned int drawVao;
+    int viewLoc;
+    int projectionLoc;
+    int particleSizeLoc;
+
+    int current;        // the alive list holding the particles
+    unsigned int frame; // seed of the emission
+
+    // Upper bound of the alive count: the emissions which may still have alive particles.
+    double time;
+    std::vector<ParticleEmission> emissions;
+    int aliveBound;
+
+    // Simulation parameters.
+    float gravity[3];
+    float drag;         // velocity lost per second (0..1)
+    float groundHeight; // the particles bounce on the y = groundHeight plane
+    float bounce;       // kept part of the vertical velocity at a bounce
+    float particleSize; // half size of the billboards (world units)
+};
+
+// Create the pool with every slot in the dead list (the kernels and the draw program are built here).
+void initParticleSystem(ParticleSystem* system, int capacity);
+
+void destroyParticleSystem(ParticleSystem* system);
+
+// Emit up to "count" particles (less if the dead list has fewer slots).
+void particleEmit(ParticleSystem* system, const ParticleEmitter& emitter, int count);
+
+// Move the particles by "deltaTime" seconds and free those at the end of their life.
+void particleSimulate(ParticleSystem* system, float deltaTime);
+
+// Sort the alive particles back to front as seen from "camera" (world space).
+void particleSort(ParticleSystem* system, const float camera[3]);
+
+// Draw the alive particles as billboards with the column major view and projection matrices.
+/* Enables GL_BLEND (src alpha, one minus src alpha or one with "additive") and disables the depth writes,
+ * both are restored after the draw. */
+void particleDraw(ParticleSystem* system, const float* view, const float* projection, bool additive = false);
+
+// Alive particles after the last simulation (reads the counters back: stalls, only for statistics).
+int particleAliveCount(ParticleSystem* system);
+
+#endif // GLES_COMMON_PARTICLE_SYSTEM_H
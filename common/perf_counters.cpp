@@ -0,0 +1,657 @@
+/**
+ * Hardware performance counters of the GPU passes. See perf_counters.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/perf_counters.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+// Upper limit of the sampled counters: every counter is printed per pass.
+static const size_t maxSelectedCounters = 32;
+
+static const char* defaultPatterns[] = { "cycle", "tex miss", "bandwidth", "bytes", "tile" };
+
+enum PerfCounterBackend {
+    PERF_BACKEND_AMD,
+    PERF_BACKEND_INTEL,
+};
+
+struct PerfCounter {
+    std::string name; // "<group>/<counter>" (AMD) or "<query>/<counter>" (Intel)
+    GLuint group;     // AMD: the group, Intel: unused
+    GLuint id;        // AMD: the counter, Intel: the counter id
+    GLenum dataType;  // AMD: GL_COUNTER_TYPE_AMD, Intel: the counter data type
+    GLuint offset;    // Intel: offset in the query data
+};
+
+struct PerfPass {
+    const char* name;
+    std::vector<double> sums; // one per selected counter
+    int samples;
+};
+
+// A pass in flight: the monitor (AMD) or query handle (Intel) and the frame which issued it.
+struct PerfSample {
+    int pass;
+    GLuint handle;
+    int frame;
+};
+
+struct PerfCounters {
+    PerfCounterBackend backend;
+    std::vector<PerfCounter> counters;
+    std::vector<PerfPass> passes;
+
+    std::vector<GLuint> freeHandles;
+    std::vector<PerfSample> pending;
+    int activePass; // -1: no pass is sampled
+    int nesting;    // depth of the nested passes inside the active one
+    int frame;
+    FILE* csv;
+
+    // Intel: the selected query.
+    GLuint intelQuery;
+    GLuint intelDataSize;
+    std::vector<uint8_t> data;
+
+    PFNGLGETPERFMONITORGROUPSAMDPROC getPerfMonitorGroups;
+    PFNGLGETPERFMONITORCOUNTERSAMDPROC getPerfMonitorCounters;
+    PFNGLGETPERFMONITORGROUPSTRINGAMDPROC getPerfMonitorGroupString;
+    PFNGLGETPERFMONITORCOUNTERSTRINGAMDPROC getPerfMonitorCounterString;
+    PFNGLGETPERFMONITORCOUNTERINFOAMDPROC getPerfMonitorCounterInfo;
+    PFNGLGENPERFMONITORSAMDPROC genPerfMonitors;
+    PFNGLDELETEPERFMONITORSAMDPROC deletePerfMonitors;
+    PFNGLSELECTPERFMONITORCOUNTERSAMDPROC selectPerfMonitorCounters;
+    PFNGLBEGINPERFMONITORAMDPROC beginPerfMonitor;
+    PFNGLENDPERFMONITORAMDPROC endPerfMonitor;
+    PFNGLGETPERFMONITORCOUNTERDATAAMDPROC getPerfMonitorCounterData;
+
+    PFNGLGETFIRSTPERFQUERYIDINTELPROC getFirstPerfQueryId;
+    PFNGLGETNEXTPERFQUERYIDINTELPROC getNextPerfQueryId;
+    PFNGLGETPERFQUERYINFOINTELPROC getPerfQueryInfo;
+    PFNGLGETPERFCOUNTERINFOINTELPROC getPerfCounterInfo;
+    PFNGLCREATEPERFQUERYINTELPROC createPerfQuery;
+    PFNGLDELETEPERFQUERYINTELPROC deletePerfQuery;
+    PFNGLBEGINPERFQUERYINTELPROC beginPerfQuery;
+    PFNGLENDPERFQUERYINTELPROC endPerfQuery;
+    PFNGLGETPERFQUERYDATAINTELPROC getPerfQueryData;
+};
+
+static std::atomic<PerfCounters*> activeCounters(nullptr);
+
+static bool hasGLExtension(const char* name) {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int idx = 0; idx < count; idx++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, idx), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool loadAmdEntryPoints(PerfCounters* pc) {
+    pc->getPerfMonitorGroups = (PFNGLGETPERFMONITORGROUPSAMDPROC)eglGetProcAddress("glGetPerfMonitorGroupsAMD");
+    pc->getPerfMonitorCounters = (PFNGLGETPERFMONITORCOUNTERSAMDPROC)eglGetProcAddress("glGetPerfMonitorCountersAMD");
+    pc->getPerfMonitorGroupString =
+        (PFNGLGETPERFMONITORGROUPSTRINGAMDPROC)eglGetProcAddress("glGetPerfMonitorGroupStringAMD");
+    pc->getPerfMonitorCounterString =
+        (PFNGLGETPERFMONITORCOUNTERSTRINGAMDPROC)eglGetProcAddress("glGetPerfMonitorCounterStringAMD");
+    pc->getPerfMonitorCounterInfo =
+        (PFNGLGETPERFMONITORCOUNTERINFOAMDPROC)eglGetProcAddress("glGetPerfMonitorCounterInfoAMD");
+    pc->genPerfMonitors = (PFNGLGENPERFMONITORSAMDPROC)eglGetProcAddress("glGenPerfMonitorsAMD");
+    pc->deletePerfMonitors = (PFNGLDELETEPERFMONITORSAMDPROC)eglGetProcAddress("glDeletePerfMonitorsAMD");
+    pc->selectPerfMonitorCounters =
+        (PFNGLSELECTPERFMONITORCOUNTERSAMDPROC)eglGetProcAddress("glSelectPerfMonitorCountersAMD");
+    pc->beginPerfMonitor = (PFNGLBEGINPERFMONITORAMDPROC)eglGetProcAddress("glBeginPerfMonitorAMD");
+    pc->endPerfMonitor = (PFNGLENDPERFMONITORAMDPROC)eglGetProcAddress("glEndPerfMonitorAMD");
+    pc->getPerfMonitorCounterData =
+        (PFNGLGETPERFMONITORCOUNTERDATAAMDPROC)eglGetProcAddress("glGetPerfMonitorCounterDataAMD");
+
+    return pc->getPerfMonitorGroups && pc->getPerfMonitorCounters && pc->getPerfMonitorGroupString
+        && pc->getPerfMonitorCounterString && pc->getPerfMonitorCounterInfo && pc->genPerfMonitors
+        && pc->deletePerfMonitors && pc->selectPerfMonitorCounters && pc->beginPerfMonitor && pc->endPerfMonitor
+        && pc->getPerfMonitorCounterData;
+}
+
+static bool loadIntelEntryPoints(PerfCounters* pc) {
+    pc->getFirstPerfQueryId = (PFNGLGETFIRSTPERFQUERYIDINTELPROC)eglGetProcAddress("glGetFirstPerfQueryIdINTEL");
+    pc->getNextPerfQueryId = (PFNGLGETNEXTPERFQUERYIDINTELPROC)eglGetProcAddress("glGetNextPerfQueryIdINTEL");
+    pc->getPerfQueryInfo = (PFNGLGETPERFQUERYINFOINTELPROC)eglGetProcAddress("glGetPerfQueryInfoINTEL");
+    pc->getPerfCounterInfo = (PFNGLGETPERFCOUNTERINFOINTELPROC)eglGetProcAddress("glGetPerfCounterInfoINTEL");
+    pc->createPerfQuery = (PFNGLCREATEPERFQUERYINTELPROC)eglGetProcAddress("glCreatePerfQueryINTEL");
+    pc->deletePerfQuery = (PFNGLDELETEPERFQUERYINTELPROC)eglGetProcAddress("glDeletePerfQueryINTEL");
+    pc->beginPerfQuery = (PFNGLBEGINPERFQUERYINTELPROC)eglGetProcAddress("glBeginPerfQueryINTEL");
+    pc->endPerfQuery = (PFNGLENDPERFQUERYINTELPROC)eglGetProcAddress("glEndPerfQueryINTEL");
+    pc->getPerfQueryData = (PFNGLGETPERFQUERYDATAINTELPROC)eglGetProcAddress("glGetPerfQueryDataINTEL");
+
+    return pc->getFirstPerfQueryId && pc->getNextPerfQueryId && pc->getPerfQueryInfo && pc->getPerfCounterInfo
+        && pc->createPerfQuery && pc->deletePerfQuery && pc->beginPerfQuery && pc->endPerfQuery
+        && pc->getPerfQueryData;
+}
+
+static std::string lowerCase(const std::string& text) {
+    std::string lower = text;
+    for (char& c : lower) {
+        c = (char)tolower((unsigned char)c);
+    }
+    return lower;
+}
+
+// Every (space separated) word of the pattern is in the name, "*" matches every name.
+static bool matchPattern(const std::string& name, const std::string& pattern) {
+    if (pattern == "*") {
+        return true;
+    }
+
+    std::string lowerName = lowerCase(name);
+    std::string lowerPattern = lowerCase(pattern);
+    size_t start = 0;
+    bool anyWord = false;
+    while (start < lowerPattern.size()) {
+        size_t end = lowerPattern.find(' ', start);
+        if (end == std::string::npos) {
+            end = lowerPattern.size();
+        }
+        if (end > start) {
+            if (lowerName.find(lowerPattern.substr(start, end - start)) == std::string::npos) {
+                return false;
+            }
+            anyWord = true;
+        }
+        start = end + 1;
+    }
+    return anyWord;
+}
+
+static bool matchAny(const std::string& name, const std::vector<std::string>& patterns) {
+    for (const std::string& pattern : patterns) {
+        if (matchPattern(name, pattern)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 1. AMD: the matching counters of every group (up to the active limit of the group).
+static void selectAmdCounters(PerfCounters* pc, const std::vector<std::string>& patterns, bool list) {
+    GLint groupCount = 0;
+    pc->getPerfMonitorGroups(&groupCount, 0, NULL);
+    std::vector<GLuint> groups(groupCount > 0 ? groupCount : 0);
+    pc->getPerfMonitorGroups(&groupCount, (GLsizei)groups.size(), groups.data());
+
+    for (GLuint group : groups) {
+        char groupName[256] = "";
+        pc->getPerfMonitorGroupString(group, sizeof(groupName), NULL, groupName);
+
+        GLint counterCount = 0;
+        GLint maxActive = 0;
+        pc->getPerfMonitorCounters(group, &counterCount, &maxActive, 0, NULL);
+        std::vector<GLuint> ids(counterCount > 0 ? counterCount : 0);
+        pc->getPerfMonitorCounters(group, &counterCount, &maxActive, (GLsizei)ids.size(), ids.data());
+
+        int active = 0;
+        for (GLuint id : ids) {
+            char counterName[256] = "";
+            pc->getPerfMonitorCounterString(group, id, sizeof(counterName), NULL, counterName);
+
+            PerfCounter counter;
+            counter.name = std::string(groupName) + "/" + counterName;
+            counter.group = group;
+            counter.id = id;
+            counter.dataType = GL_UNSIGNED_INT;
+            counter.offset = 0;
+            pc->getPerfMonitorCounterInfo(group, id, GL_COUNTER_TYPE_AMD, &counter.dataType);
+
+            if (list) {
+                printf("  %s\n", counter.name.c_str());
+            }
+            if (active < maxActive && pc->counters.size() < maxSelectedCounters && matchAny(counter.name, patterns)) {
+                pc->counters.push_back(counter);
+                active++;
+            }
+        }
+    }
+}
+
+// 1. Intel: the query with the most matching counters (only those are reported).
+static void selectIntelCounters(PerfCounters* pc, const std::vector<std::string>& patterns, bool list) {
+    GLuint queryId = 0;
+    pc->getFirstPerfQueryId(&queryId);
+    while (queryId != 0) {
+        char queryName[256] = "";
+        GLuint dataSize = 0;
+        GLuint counterCount = 0;
+        GLuint instances = 0;
+        GLuint caps = 0;
+        pc->getPerfQueryInfo(queryId, sizeof(queryName), queryName, &dataSize, &counterCount, &instances, &caps);
+
+        std::vector<PerfCounter> matching;
+        for (GLuint id = 1; id <= counterCount; id++) {
+            char counterName[256] = "";
+            char description[4];
+            GLuint offset = 0;
+            GLuint counterSize = 0;
+            GLuint type = 0;
+            GLuint dataType = 0;
+            GLuint64 maxValue = 0;
+            pc->getPerfCounterInfo(queryId, id, sizeof(counterName), counterName, sizeof(description), description,
+                                   &offset, &counterSize, &type, &dataType, &maxValue);
+
+            PerfCounter counter;
+            counter.name = std::string(queryName) + "/" + counterName;
+            counter.group = 0;
+            counter.id = id;
+            counter.dataType = dataType;
+            counter.offset = offset;
+
+            if (list) {
+                printf("  %s\n", counter.name.c_str());
+            }
+            if (matching.size() < maxSelectedCounters && offset + counterSize <= dataSize
+                && matchAny(counter.name, patterns)) {
+                matching.push_back(counter);
+            }
+        }
+
+        if (matching.size() > pc->counters.size()) {
+            pc->counters = matching;
+            pc->intelQuery = queryId;
+            pc->intelDataSize = dataSize;
+        }
+
+        GLuint nextId = 0;
+        pc->getNextPerfQueryId(queryId, &nextId);
+        queryId = nextId;
+    }
+}
+
+static GLuint acquireHandle(PerfCounters* pc) {
+    if (!pc->freeHandles.empty()) {
+        GLuint handle = pc->freeHandles.back();
+        pc->freeHandles.pop_back();
+        return handle;
+    }
+
+    GLuint handle = 0;
+    if (pc->backend == PERF_BACKEND_AMD) {
+        pc->genPerfMonitors(1, &handle);
+        /* The same selection for every monitor, one call per group. */
+        for (size_t start = 0; start < pc->counters.size();) {
+            size_t end = start;
+            std::vector<GLuint> ids;
+            while (end < pc->counters.size() && pc->counters[end].group == pc->counters[start].group) {
+                ids.push_back(pc->counters[end].id);
+                end++;
+            }
+            pc->selectPerfMonitorCounters(handle, GL_TRUE, pc->counters[start].group, (GLint)ids.size(), ids.data());
+            start = end;
+        }
+    } else {
+        pc->createPerfQuery(pc->intelQuery, &handle);
+    }
+    return handle;
+}
+
+static void deleteHandle(PerfCounters* pc, GLuint handle) {
+    if (pc->backend == PERF_BACKEND_AMD) {
+        pc->deletePerfMonitors(1, &handle);
+    } else {
+        pc->deletePerfQuery(handle);
+    }
+}
+
+static int findCounter(const PerfCounters* pc, GLuint group, GLuint id) {
+    for (size_t idx = 0; idx < pc->counters.size(); idx++) {
+        if (pc->counters[idx].group == group && pc->counters[idx].id == id) {
+            return (int)idx;
+        }
+    }
+    return -1;
+}
+
+// 2. AMD result: (group, counter, value) records, the size of the value depends on the counter type.
+static bool readAmdSample(PerfCounters* pc, GLuint monitor, bool wait, std::vector<double>* values) {
+    GLuint available = 0;
+    pc->getPerfMonitorCounterData(monitor, GL_PERFMON_RESULT_AVAILABLE_AMD, sizeof(available), &available, NULL);
+    if (!available && !wait) {
+        return false;
+    }
+
+    GLuint size = 0;
+    pc->getPerfMonitorCounterData(monitor, GL_PERFMON_RESULT_SIZE_AMD, sizeof(size), &size, NULL);
+    std::vector<GLuint> data(size / sizeof(GLuint));
+    GLint written = 0;
+    pc->getPerfMonitorCounterData(monitor, GL_PERFMON_RESULT_AMD, size, data.data(), &written);
+
+    size_t count = (size_t)written / sizeof(GLuint);
+    for (size_t idx = 0; idx + 2 <= count;) {
+        int counter = findCounter(pc, data[idx], data[idx + 1]);
+        idx += 2;
+        if (counter < 0 || idx >= count) {
+            break;
+        }
+
+        GLenum type = pc->counters[counter].dataType;
+        if (type == GL_UNSIGNED_INT64_AMD && idx + 1 < count) {
+            uint64_t value;
+            memcpy(&value, &data[idx], sizeof(value));
+            (*values)[counter] = (double)value;
+            idx += 2;
+        } else if (type == GL_FLOAT || type == GL_PERCENTAGE_AMD) {
+            float value;
+            memcpy(&value, &data[idx], sizeof(value));
+            (*values)[counter] = value;
+            idx += 1;
+        } else {
+            (*values)[counter] = data[idx];
+            idx += 1;
+        }
+    }
+    return true;
+}
+
+// 2. Intel result: the counters are at their offset in the query data.
+static bool readIntelSample(PerfCounters* pc, GLuint query, bool wait, std::vector<double>* values) {
+    pc->data.resize(pc->intelDataSize);
+    GLuint written = 0;
+    pc->getPerfQueryData(query, wait ? GL_PERFQUERY_WAIT_INTEL : GL_PERFQUERY_DONOT_FLUSH_INTEL, pc->intelDataSize,
+                         pc->data.data(), &written);
+    if (written == 0) {
+        return false;
+    }
+
+    for (size_t idx = 0; idx < pc->counters.size(); idx++) {
+        const PerfCounter& counter = pc->counters[idx];
+        const uint8_t* ptr = pc->data.data() + counter.offset;
+        switch (counter.dataType) {
+        case GL_PERFQUERY_COUNTER_DATA_UINT32_INTEL:
+        case GL_PERFQUERY_COUNTER_DATA_BOOL32_INTEL: {
+            uint32_t value;
+            memcpy(&value, ptr, sizeof(value));
+            (*values)[idx] = value;
+            break;
+        }
+        case GL_PERFQUERY_COUNTER_DATA_UINT64_INTEL: {
+            uint64_t value;
+            memcpy(&value, ptr, sizeof(value));
+            (*values)[idx] = (double)value;
+            break;
+        }
+        case GL_PERFQUERY_COUNTER_DATA_FLOAT_INTEL: {
+            float value;
+            memcpy(&value, ptr, sizeof(value));
+            (*values)[idx] = value;
+            break;
+        }
+        default: {
+            double value;
+            memcpy(&value, ptr, sizeof(value));
+            (*values)[idx] = value;
+            break;
+        }
+        }
+    }
+    return true;
+}
+
+// Read back the finished samples (in order), "wait": block for all pending samples.
+static void collectSamples(PerfCounters* pc, bool wait) {
+    std::vector<double> values(pc->counters.size());
+    size_t done = 0;
+    for (; done < pc->pending.size(); done++) {
+        PerfSample& sample = pc->pending[done];
+        std::fill(values.begin(), values.end(), 0.0);
+        bool ready = pc->backend == PERF_BACKEND_AMD ? readAmdSample(pc, sample.handle, wait, &values)
+                                                     : readIntelSample(pc, sample.handle, wait, &values);
+        if (!ready) {
+            break;
+        }
+
+        PerfPass& pass = pc->passes[sample.pass];
+        for (size_t idx = 0; idx < values.size(); idx++) {
+            pass.sums[idx] += values[idx];
+            if (pc->csv != NULL) {
+                fprintf(pc->csv, "%d,%s,%s,%.6g\n", sample.frame, pass.name, pc->counters[idx].name.c_str(), values[idx]);
+            }
+        }
+        pass.samples++;
+        pc->freeHandles.push_back(sample.handle);
+    }
+    pc->pending.erase(pc->pending.begin(), pc->pending.begin() + done);
+}
+
+// The sample of the active pass is the last pending one.
+static void endActivePass(PerfCounters* pc) {
+    GLuint handle = pc->pending.back().handle;
+    if (pc->backend == PERF_BACKEND_AMD) {
+        pc->endPerfMonitor(handle);
+    } else {
+        pc->endPerfQuery(handle);
+    }
+    pc->activePass = -1;
+}
+
+PerfCounters* createPerfCounters(int argc, char** argv) {
+    bool enabled = false;
+    bool list = false;
+    bool global = false;
+    const char* csvPath = NULL;
+    std::vector<std::string> patterns(defaultPatterns, defaultPatterns + sizeof(defaultPatterns) / sizeof(defaultPatterns[0]));
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--perf-counters") == 0) {
+            enabled = true;
+        } else if (strcmp(argv[idx], "--perf-counters-select") == 0 && idx + 1 < argc) {
+            enabled = true;
+            patterns.clear();
+            std::string selection = argv[++idx];
+            for (size_t start = 0; start <= selection.size();) {
+                size_t end = selection.find(',', start);
+                if (end == std::string::npos) {
+                    end = selection.size();
+                }
+                if (end > start) {
+                    patterns.push_back(selection.substr(start, end - start));
+                }
+                start = end + 1;
+            }
+        } else if (strcmp(argv[idx], "--perf-counters-list") == 0) {
+            enabled = true;
+            list = true;
+        } else if (strcmp(argv[idx], "--perf-counters-csv") == 0 && idx + 1 < argc) {
+            enabled = true;
+            csvPath = argv[++idx];
+        } else if (strcmp(argv[idx], "--perf-counters-global") == 0) {
+            enabled = true;
+            global = true;
+        }
+    }
+    if (!enabled) {
+        return NULL;
+    }
+
+    PerfCounters* pc = new PerfCounters();
+    pc->activePass = -1;
+    pc->nesting = 0;
+    pc->frame = 0;
+    pc->csv = NULL;
+    pc->intelQuery = 0;
+    pc->intelDataSize = 0;
+
+    const char* extension = NULL;
+    if (hasGLExtension("GL_AMD_performance_monitor") && loadAmdEntryPoints(pc)) {
+        pc->backend = PERF_BACKEND_AMD;
+        extension = "GL_AMD_performance_monitor";
+        if (list) {
+            printf("Perf counters (%s):\n", extension);
+        }
+        selectAmdCounters(pc, patterns, list);
+    } else if (hasGLExtension("GL_INTEL_performance_query") && loadIntelEntryPoints(pc)) {
+        pc->backend = PERF_BACKEND_INTEL;
+        extension = "GL_INTEL_performance_query";
+        if (list) {
+            printf("Perf counters (%s):\n", extension);
+        }
+        selectIntelCounters(pc, patterns, list);
+    } else {
+        printf("Perf counters: neither GL_AMD_performance_monitor nor GL_INTEL_performance_query is supported\n");
+        delete pc;
+        return NULL;
+    }
+
+    if (pc->counters.empty()) {
+        printf("Perf counters: no counter matches the selection (see --perf-counters-list)\n");
+        delete pc;
+        return NULL;
+    }
+
+    if (global) {
+        if (hasGLExtension("GL_QCOM_perfmon_global_mode")) {
+            glEnable(GL_PERFMON_GLOBAL_MODE_QCOM);
+        } else {
+            printf("Perf counters: GL_QCOM_perfmon_global_mode is not supported\n");
+        }
+    }
+
+    if (csvPath != NULL) {
+        pc->csv = fopen(csvPath, "w");
+        if (pc->csv == NULL) {
+            printf("Perf counters: unable to open '%s'\n", csvPath);
+        } else {
+            fprintf(pc->csv, "frame,pass,counter,value\n");
+        }
+    }
+
+    PerfCounters* expected = nullptr;
+    if (!activeCounters.compare_exchange_strong(expected, pc)) {
+        printf("Perf counters: the counters are already active\n");
+        if (pc->csv != NULL) {
+            fclose(pc->csv);
+        }
+        delete pc;
+        return NULL;
+    }
+
+    printf("Perf counters (%s): %zu counters selected\n", extension, pc->counters.size());
+    return pc;
+}
+
+void destroyPerfCounters(PerfCounters* pc) {
+    PerfCounters* expected = pc;
+    activeCounters.compare_exchange_strong(expected, nullptr);
+
+    /* A pass which is still open (ex.: the loop was left in a pass) is ended without its nested passes. */
+    if (pc->activePass >= 0) {
+        endActivePass(pc);
+    }
+    collectSamples(pc, true);
+
+    printf("Perf counters, average per pass:\n");
+    for (const PerfPass& pass : pc->passes) {
+        printf("  %s (%d samples)\n", pass.name, pass.samples);
+        for (size_t idx = 0; idx < pc->counters.size(); idx++) {
+            printf("    %-48s %16.2f\n", pc->counters[idx].name.c_str(),
+                   pass.samples > 0 ? pass.sums[idx] / pass.samples : 0.0);
+        }
+    }
+
+    for (GLuint handle : pc->freeHandles) {
+        deleteHandle(pc, handle);
+    }
+    if (pc->csv != NULL) {
+        fclose(pc->csv);
+    }
+    delete pc;
+}
+
+void perfCountersEndFrame(int frame) {
+    PerfCounters* pc = activeCounters.load();
+    if (pc == NULL) {
+        return;
+    }
+
+    collectSamples(pc, false);
+    pc->frame = frame + 1;
+}
+
+void perfCountersBeginPass(const char* name) {
+    PerfCounters* pc = activeCounters.load();
+    if (pc == NULL) {
+        return;
+    }
+
+    if (pc->activePass >= 0) {
+        pc->nesting++;
+        return;
+    }
+
+    int passIdx = -1;
+    for (size_t idx = 0; idx < pc->passes.size(); idx++) {
+        if (strcmp(pc->passes[idx].name, name) == 0) {
+            passIdx = (int)idx;
+        }
+    }
+    if (passIdx < 0) {
+        PerfPass pass;
+        pass.name = name;
+        pass.sums.assign(pc->counters.size(), 0.0);
+        pass.samples = 0;
+        pc->passes.push_back(pass);
+        passIdx = (int)pc->passes.size() - 1;
+    }
+
+    PerfSample sample = { passIdx, acquireHandle(pc), pc->frame };
+    if (pc->backend == PERF_BACKEND_AMD) {
+        pc->beginPerfMonitor(sample.handle);
+    } else {
+        pc->beginPerfQuery(sample.handle);
+    }
+    pc->pending.push_back(sample);
+    pc->activePass = passIdx;
+}
+
+void perfCountersEndPass() {
+    PerfCounters* pc = activeCounters.load();
+    if (pc == NULL || pc->activePass < 0) {
+        return;
+    }
+
+    if (pc->nesting > 0) {
+        pc->nesting--;
+        return;
+    }
+
+    endActivePass(pc);
+}
@@ -0,0 +1,77 @@
+/**
+ * Hardware performance counters of the GPU passes (vendor query extensions).
+ *
+ * The GPU timers (gpu_timer.h) say how long a pass takes, the counters say
+ * why: shader cycles, texture cache misses, external memory bandwidth, tile
+ * counts. Every GpuTimer pass (gpuTimerBegin/gpuTimerEnd, GpuTimerScope) is
+ * also sampled by the active counters, the results are read back at the end
+ * of the frames when they are available (never waited for) and the average of
+ * every counter per pass is printed when the context is destroyed.
+ *
+ * Backends, the first supported one is used:
+ *  * GL_AMD_performance_monitor: AMD (Mesa radeonsi), Qualcomm Adreno and
+ *    freedreno. The counters of the groups are selected by name (up to the
+ *    active limit of every group). With GL_QCOM_perfmon_global_mode the
+ *    "--perf-counters-global" option also counts the other contexts.
+ *  * GL_INTEL_performance_query: Intel. The counters come in fixed sets
+ *    (queries, ex.: "RenderBasic"): the query with the most selected counters
+ *    is used.
+ * The Arm Mali drivers have no GL counter extension (the counters are read
+ * through the kernel instrumentation outside of GL, ex.: HWCPipe), without
+ * any backend the options only print a message.
+ *
+ * Command line options (also handled by the demo context):
+ *  --perf-counters          Sample the default counters: the names with "cycle",
+ *                           "tex" + "miss", "bandwidth", "bytes" or "tile".
+ *  --perf-counters-select LIST
+ *                           Comma separated name patterns instead of the defaults:
+ *                           every word of a pattern must be in the (group and)
+ *                           counter name, case insensitive ("*": every counter).
+ *  --perf-counters-list     Print every counter of the driver.
+ *  --perf-counters-csv FILE Write every sample as a "frame,pass,counter,value" line.
+ *  --perf-counters-global   GL_QCOM_perfmon_global_mode: count every context.
+ *
+ * Like the timer queries the passes can't be nested: a nested pass is not
+ * sampled on its own (it counts into the enclosing one).
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_PERF_COUNTERS_H
+#define GLES_COMMON_PERF_COUNTERS_H
+
+struct PerfCounters;
+
+// Parse the "--perf-counters*" options and select the counters (the active counters of the process).
+/* Requires a current GL ES context. Returns NULL without any option, supported backend or matching counter. */
+PerfCounters* createPerfCounters(int argc, char** argv);
+
+// Wait for the pending samples, print the averages per pass and delete the counters.
+void destroyPerfCounters(PerfCounters* counters);
+
+// The frame ended: read back the available samples.
+void perfCountersEndFrame(int frame);
+
+// Start/stop sampling the named pass (the name must be a string literal or outlive the counters).
+void perfCountersBeginPass(const char* name);
+void perfCountersEndPass();
+
+#endif // GLES_COMMON_PERF_COUNTERS_H
@@ -0,0 +1,196 @@
+/**
+ * GPU picking with an object ID buffer, see pick_buffer.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/pick_buffer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <GLES3/gl3.h>
+
+#include "common/gpu_memory.h"
+
+// Read back format: RGBA_INTEGER/UNSIGNED_INT is always supported for unsigned integer buffers (only red is used).
+static const int PICK_PIXEL_BYTES = 4 * sizeof(uint32_t);
+
+void initPickBuffer(PickBuffer* pick, int region) {
+    memset(pick, 0, sizeof(*pick));
+    pick->region = std::max(1, std::min(region, PICK_BUFFER_MAX_REGION)) | 1;
+    pick->resultFrame = -1;
+
+    size_t bytes = (size_t)pick->region * pick->region * PICK_PIXEL_BYTES;
+    glGenBuffers(PICK_BUFFER_SLOTS, pick->pbo);
+    for (int slot = 0; slot < PICK_BUFFER_SLOTS; slot++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pick->pbo[slot]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+        gpuMemoryTrackBuffer(pick->pbo[slot], bytes, GPU_MEMORY_TRANSFER, "pick readback");
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    glGenRenderbuffers(1, &pick->renderbuffer);
+}
+
+void destroyPickBuffer(PickBuffer* pick) {
+    if (pick->submitCount > 0) {
+        printf("Pick buffer: %dx%d region, %d read backs (%d skipped: every slot in flight), %d results, "
+               "average latency: %.2f frames\n", pick->region, pick->region, pick->submitCount, pick->skipCount,
+               pick->resultCount, pick->resultCount ? (double)pick->latencySum / pick->resultCount : 0.0);
+    }
+
+    for (int slot = 0; slot < PICK_BUFFER_SLOTS; slot++) {
+        if (pick->fence[slot] != NULL) {
+            glDeleteSync((GLsync)pick->fence[slot]);
+        }
+    }
+    gpuMemoryReleaseBuffers(PICK_BUFFER_SLOTS, pick->pbo);
+    glDeleteBuffers(PICK_BUFFER_SLOTS, pick->pbo);
+    gpuMemoryReleaseRenderbuffers(1, &pick->renderbuffer);
+    glDeleteRenderbuffers(1, &pick->renderbuffer);
+    memset(pick, 0, sizeof(*pick));
+}
+
+void pickBufferAttach(PickBuffer* pick, int width, int height) {
+    if (width != pick->width || height != pick->height) {
+        glBindRenderbuffer(GL_RENDERBUFFER, pick->renderbuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_R32UI, width, height);
+        gpuMemoryTrackRenderbuffer(pick->renderbuffer, GL_R32UI, width, height, 1, "pick IDs");
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        pick->width = width;
+        pick->height = height;
+    }
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, pick->renderbuffer);
+}
+
+void pickBufferBegin(PickBuffer* pick) {
+    (void)pick;
+    static const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    static const GLuint background[4] = { 0, 0, 0, 0 };
+    glDrawBuffers(2, drawBuffers);
+
+    /* The clear is scissored like any other: the whole buffer is cleared. */
+    GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+    glDisable(GL_SCISSOR_TEST);
+    glClearBufferuiv(GL_COLOR, 1, background);
+    if (scissor) {
+        glEnable(GL_SCISSOR_TEST);
+    }
+}
+
+bool pickBufferSubmit(PickBuffer* pick, int x, int y, int frame) {
+    static const GLenum drawBuffer = GL_COLOR_ATTACHMENT0;
+    glDrawBuffers(1, &drawBuffer);
+
+    /* Every read back is in flight: skip this frame rather than wait for the GPU. */
+    if (pick->writeCount - pick->readCount >= PICK_BUFFER_SLOTS) {
+        pick->skipCount++;
+        return false;
+    }
+    if (pick->width <= 0 || pick->height <= 0) {
+        return false;
+    }
+
+    // 1. The region around the cursor, clipped at the edges of the framebuffer.
+    x = std::max(0, std::min(x, pick->width - 1));
+    y = std::max(0, std::min(y, pick->height - 1));
+    int half = pick->region / 2;
+    int x0 = std::max(0, x - half);
+    int y0 = std::max(0, y - half);
+    int x1 = std::min(pick->width, x + half + 1);
+    int y1 = std::min(pick->height, y + half + 1);
+
+    // 2. Copy it into the pixel pack buffer of the slot: the copy is queued, nothing waits.
+    int slot = pick->writeCount % PICK_BUFFER_SLOTS;
+    GLint framebuffer = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadBuffer(GL_COLOR_ATTACHMENT1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pick->pbo[slot]);
+    glReadPixels(x0, y0, x1 - x0, y1 - y0, GL_RGBA_INTEGER, GL_UNSIGNED_INT, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+    pick->fence[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pick->slotFrame[slot] = frame;
+    pick->slotX[slot] = x - x0;
+    pick->slotY[slot] = y - y0;
+    pick->slotWidth[slot] = x1 - x0;
+    pick->slotHeight[slot] = y1 - y0;
+    pick->writeCount++;
+    pick->submitCount++;
+    return true;
+}
+
+// The ID under the cursor, or the closest one of the region (0: only background).
+static uint32_t findId(const uint32_t* pixels, int width, int height, int x, int y, bool* exact) {
+    *exact = true;
+    uint32_t id = pixels[(y * width + x) * 4];
+    if (id != 0) {
+        return id;
+    }
+
+    *exact = false;
+    int bestDistance = -1;
+    for (int py = 0; py < height; py++) {
+        for (int px = 0; px < width; px++) {
+            uint32_t candidate = pixels[(py * width + px) * 4];
+            int distance = (px - x) * (px - x) + (py - y) * (py - y);
+            if (candidate != 0 && (bestDistance < 0 || distance < bestDistance)) {
+                bestDistance = distance;
+                id = candidate;
+            }
+        }
+    }
+    return id;
+}
+
+bool pickBufferPoll(PickBuffer* pick, int frame) {
+    bool received = false;
+    while (pick->readCount < pick->writeCount) {
+        int slot = pick->readCount % PICK_BUFFER_SLOTS;
+        GLenum status = glClientWaitSync((GLsync)pick->fence[slot], 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+        glDeleteSync((GLsync)pick->fence[slot]);
+        pick->fence[slot] = NULL;
+
+        size_t bytes = (size_t)pick->slotWidth[slot] * pick->slotHeight[slot] * PICK_PIXEL_BYTES;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pick->pbo[slot]);
+        const uint32_t* pixels = (const uint32_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+        if (pixels != NULL) {
+            pick->resultId = findId(pixels, pick->slotWidth[slot], pick->slotHeight[slot],
+                                    pick->slotX[slot], pick->slotY[slot], &pick->resultExact);
+            pick->resultFrame = pick->slotFrame[slot];
+            pick->resultCount++;
+            pick->latencySum += frame - pick->slotFrame[slot];
+            received = true;
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        pick->readCount++;
+    }
+    return received;
+}
@@ -0,0 +1,119 @@
+/**
+ * GPU picking with an object ID buffer and an asynchronous read back.
+ *
+ * The picked object is found without any CPU side geometry (no ray casts
+ * against the meshes): the draws of the scene write the ID of their object
+ * into a second color attachment (R32UI, MRT) of the scene FBO, next to the
+ * color. After the pass a small region around the cursor is copied into a
+ * pixel pack buffer of a ring with a fence (glReadPixels into a PBO does not
+ * wait for the GPU). pickBufferPoll maps the copies whose fence signalled,
+ * never blocking: the answer arrives one or two frames after the click and
+ * the latency in frames is measured.
+ *
+ * The ID 0 is the background (the clear value). Thin objects are easy to
+ * miss by a pixel: without an ID under the cursor the closest ID of the
+ * region is returned.
+ *
+ * Usage:
+ *
+ *   PickBuffer pick;
+ *   initPickBuffer(&pick, 9); // 9x9 region around the cursor
+ *   ... on resize, with the scene FBO bound ...
+ *   pickBufferAttach(&pick, width, height);
+ *   ... every frame, after the clears of the scene pass ...
+ *   pickBufferBegin(&pick);  // both attachments are drawn, the IDs are cleared
+ *   ... draws, the fragment shaders declare "layout(location = 1) out uint outId" ...
+ *   pickBufferSubmit(&pick, cursorX, cursorY, frame); // read back the region
+ *   if (pickBufferPoll(&pick, frame)) {
+ *       printf("%u\n", pick.resultId);
+ *   }
+ *   destroyPickBuffer(&pick); // prints the statistics
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_PICK_BUFFER_H
+#define GLES_COMMON_PICK_BUFFER_H
+
+#include <stdint.h>
+
+// Read backs in flight: copies older than this are done on every GPU (the frame latency is lower).
+#define PICK_BUFFER_SLOTS 3
+
+// Largest side of the read back region.
+#define PICK_BUFFER_MAX_REGION 32
+
+struct PickBuffer {
+    unsigned int renderbuffer; // R32UI: color attachment 1 of the scene FBO
+    int width;
+    int height;
+    int region; // side of the read back region (odd: the cursor is in the center)
+
+    // Ring of the read backs, in submit order.
+    unsigned int pbo[PICK_BUFFER_SLOTS];
+    void* fence[PICK_BUFFER_SLOTS]; // GLsync
+    int slotFrame[PICK_BUFFER_SLOTS];
+    int slotX[PICK_BUFFER_SLOTS]; // the cursor inside the region
+    int slotY[PICK_BUFFER_SLOTS];
+    int slotWidth[PICK_BUFFER_SLOTS]; // the region is clipped at the edges
+    int slotHeight[PICK_BUFFER_SLOTS];
+    int writeCount;
+    int readCount;
+
+    // The newest result.
+    uint32_t resultId; // 0: background
+    int resultFrame;   // -1: no result yet
+    bool resultExact;  // the ID is under the cursor (not the closest one of the region)
+
+    // Statistics.
+    int submitCount;
+    int skipCount; // every slot was in flight
+    int resultCount;
+    long latencySum; // frames between the submit and the poll which received it
+};
+
+void initPickBuffer(PickBuffer* pick, int region);
+
+// Print the statistics and delete the ID buffer and the pixel pack buffers.
+void destroyPickBuffer(PickBuffer* pick);
+
+// (Re)create the ID buffer for the size and attach it to GL_COLOR_ATTACHMENT1 of the bound FBO.
+/* Call when the size changes (or the FBO got new attachments), before the completeness check. */
+void pickBufferAttach(PickBuffer* pick, int width, int height);
+
+// Draw into both attachments and clear the IDs to 0, the scene FBO must be bound.
+/* Call after the clears of the pass: glClear with a float clear color is undefined for integer
+ * buffers, the render pass clears only the first attachment (the default draw buffer). */
+void pickBufferBegin(PickBuffer* pick);
+
+// Restore the color only draw buffer and start the read back of the region around the cursor.
+/* The cursor is in framebuffer pixels (origin: bottom left). Returns false if every slot is in
+ * flight: the frame is skipped, the GPU is not waited for. */
+bool pickBufferSubmit(PickBuffer* pick, int x, int y, int frame);
+
+// Collect the finished read backs. Returns true if a newer result arrived. Never blocks.
+bool pickBufferPoll(PickBuffer* pick, int frame);
+
+#endif // GLES_COMMON_PICK_BUFFER_H
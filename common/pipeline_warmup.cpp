@@ -0,0 +1,212 @@
+/**
+ * Pipeline warmup. See pipeline_warmup.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/pipeline_warmup.h"
+
+#include <stdio.h>
+
+#include <chrono>
+
+#include <GLES3/gl3.h>
+
+PipelineState defaultPipelineState(unsigned int program, unsigned int vao) {
+    PipelineState state;
+    state.program = program;
+    state.vao = vao;
+    state.mode = GL_TRIANGLES;
+    state.indexType = 0;
+    state.blend = false;
+    state.blendSrc = GL_ONE;
+    state.blendDst = GL_ZERO;
+    state.depthTest = false;
+    state.depthFunc = GL_LESS;
+    state.depthWrite = true;
+    state.cullFace = false;
+    state.colorFormat = 0;
+    state.depthFormat = 0;
+    state.samples = 0;
+    state.framebuffer = 0;
+    return state;
+}
+
+static bool samePipelineState(const PipelineState& a, const PipelineState& b) {
+    return a.program == b.program && a.vao == b.vao && a.mode == b.mode && a.indexType == b.indexType &&
+           a.blend == b.blend && (!a.blend || (a.blendSrc == b.blendSrc && a.blendDst == b.blendDst)) &&
+           a.depthTest == b.depthTest && (!a.depthTest || a.depthFunc == b.depthFunc) && a.depthWrite == b.depthWrite &&
+           a.cullFace == b.cullFace && a.colorFormat == b.colorFormat && a.depthFormat == b.depthFormat &&
+           a.samples == b.samples && a.framebuffer == b.framebuffer;
+}
+
+void pipelineWarmupAdd(PipelineWarmup* warmup, const PipelineState& state) {
+    for (size_t idx = 0; idx < warmup->states.size(); idx++) {
+        if (samePipelineState(warmup->states[idx], state)) {
+            return;
+        }
+    }
+    warmup->states.push_back(state);
+}
+
+static void setEnabled(GLenum capability, bool enabled) {
+    if (enabled) {
+        glEnable(capability);
+    } else {
+        glDisable(capability);
+    }
+}
+
+// The 4x4 offscreen target of the state's formats, created at its first use.
+static unsigned int warmupFramebuffer(PipelineWarmup* warmup, const PipelineState& state) {
+    for (size_t idx = 0; idx < warmup->targets.size(); idx++) {
+        const PipelineWarmupTarget& target = warmup->targets[idx];
+        if (target.colorFormat == state.colorFormat && target.depthFormat == state.depthFormat && target.samples == state.samples) {
+            return target.fbo;
+        }
+    }
+
+    PipelineWarmupTarget target;
+    target.colorFormat = state.colorFormat;
+    target.depthFormat = state.depthFormat;
+    target.samples = state.samples;
+    target.colorRB = 0;
+    target.depthRB = 0;
+
+    glGenFramebuffers(1, &target.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+    if (state.colorFormat) {
+        glGenRenderbuffers(1, &target.colorRB);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.colorRB);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, state.samples, state.colorFormat, 4, 4);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.colorRB);
+    } else {
+        GLenum none = GL_NONE;
+        glDrawBuffers(1, &none);
+    }
+    if (state.depthFormat) {
+        bool stencil = state.depthFormat == GL_DEPTH24_STENCIL8 || state.depthFormat == GL_DEPTH32F_STENCIL8;
+        glGenRenderbuffers(1, &target.depthRB);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.depthRB);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, state.samples, state.depthFormat, 4, 4);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT,
+                                  GL_RENDERBUFFER, target.depthRB);
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        printf("Pipeline warmup: the 0x%x/0x%x (%d samples) target is not complete\n",
+               state.colorFormat, state.depthFormat, state.samples);
+    }
+
+    warmup->targets.push_back(target);
+    return target.fbo;
+}
+
+double runPipelineWarmup(PipelineWarmup* warmup) {
+    auto startTime = std::chrono::steady_clock::now();
+
+    // 1. Save the state which is changed by the draws.
+    int program, vao, framebuffer, viewport[4], scissor[4], depthFunc, blendSrc, blendDst;
+    unsigned char depthWrite;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_SCISSOR_BOX, scissor);
+    glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+    glGetIntegerv(GL_BLEND_SRC_RGB, &blendSrc);
+    glGetIntegerv(GL_BLEND_DST_RGB, &blendDst);
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &depthWrite);
+    bool blend = glIsEnabled(GL_BLEND);
+    bool depthTest = glIsEnabled(GL_DEPTH_TEST);
+    bool cullFace = glIsEnabled(GL_CULL_FACE);
+    bool scissorTest = glIsEnabled(GL_SCISSOR_TEST);
+
+    // 2. One small draw per state: the driver builds the variant, only a few pixels are covered.
+    for (size_t idx = 0; idx < warmup->states.size(); idx++) {
+        const PipelineState& state = warmup->states[idx];
+
+        if (state.colorFormat || state.depthFormat) {
+            glBindFramebuffer(GL_FRAMEBUFFER, warmupFramebuffer(warmup, state));
+            glViewport(0, 0, 4, 4);
+            glDisable(GL_SCISSOR_TEST);
+        } else {
+            /* The application's framebuffer: only the pixel at the origin can change. */
+            glBindFramebuffer(GL_FRAMEBUFFER, state.framebuffer);
+            glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(0, 0, 1, 1);
+        }
+
+        setEnabled(GL_BLEND, state.blend);
+        glBlendFunc(state.blendSrc, state.blendDst);
+        setEnabled(GL_DEPTH_TEST, state.depthTest);
+        glDepthFunc(state.depthFunc);
+        glDepthMask(state.depthWrite ? GL_TRUE : GL_FALSE);
+        setEnabled(GL_CULL_FACE, state.cullFace);
+
+        /* 6 vertices: whole primitives for triangles, lines and points. */
+        glUseProgram(state.program);
+        glBindVertexArray(state.vao);
+        if (state.indexType == 0) {
+            glDrawArrays(state.mode, 0, 6);
+        } else {
+            glDrawElements(state.mode, 6, state.indexType, NULL);
+        }
+    }
+
+    // 3. Wait for the GPU: the compiles triggered by the draws are finished when this returns.
+    glFinish();
+
+    // 4. Restore the state.
+    glUseProgram(program);
+    glBindVertexArray(vao);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glScissor(scissor[0], scissor[1], scissor[2], scissor[3]);
+    glDepthFunc(depthFunc);
+    glBlendFunc(blendSrc, blendDst);
+    glDepthMask(depthWrite);
+    setEnabled(GL_BLEND, blend);
+    setEnabled(GL_DEPTH_TEST, depthTest);
+    setEnabled(GL_CULL_FACE, cullFace);
+    setEnabled(GL_SCISSOR_TEST, scissorTest);
+
+    warmup->draws = (int)warmup->states.size();
+    warmup->ms = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count() * 1000.0;
+    return warmup->ms;
+}
+
+void destroyPipelineWarmup(PipelineWarmup* warmup) {
+    for (size_t idx = 0; idx < warmup->targets.size(); idx++) {
+        PipelineWarmupTarget& target = warmup->targets[idx];
+        glDeleteFramebuffers(1, &target.fbo);
+        if (target.colorRB) {
+            glDeleteRenderbuffers(1, &target.colorRB);
+        }
+        if (target.depthRB) {
+            glDeleteRenderbuffers(1, &target.depthRB);
+        }
+    }
+    warmup->targets.clear();
+    warmup->states.clear();
+}
@@ -0,0 +1,115 @@
+/**
+ * Pipeline warmup: draw every declared state combination once at load time.
+ *
+ * Many drivers finish the shader compilation (or build a shader variant)
+ * only at the first draw with a given combination of program, vertex
+ * layout, primitive, blend, depth and framebuffer formats. That first draw
+ * of a state can take milliseconds, so the first frame of a demo, or the
+ * first frame after a mode toggle, hitches. The warmup issues one tiny draw
+ * per declared combination at load time (after the programs were built or
+ * loaded from the program binary cache) and waits for the GPU, so the real
+ * frames only reuse the finished variants.
+ *
+ * A state with color/depth formats is drawn into a 4x4 offscreen framebuffer
+ * of those formats (created once per format combination). A state without
+ * formats is drawn into its "framebuffer" instead (ex.: demoDefaultFramebuffer)
+ * with a 1x1 scissor: the frame must clear it afterwards. The GL state
+ * touched by the warmup is restored.
+ *
+ * Usage:
+ *
+ *   PipelineWarmup warmup;
+ *   PipelineState state = defaultPipelineState(program, vao);
+ *   state.indexType = GL_UNSIGNED_SHORT;
+ *   state.depthTest = true;
+ *   pipelineWarmupAdd(&warmup, state);
+ *   state.mode = GL_LINES;
+ *   pipelineWarmupAdd(&warmup, state);
+ *   double ms = runPipelineWarmup(&warmup);
+ *   destroyPipelineWarmup(&warmup);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_PIPELINE_WARMUP_H
+#define GLES_COMMON_PIPELINE_WARMUP_H
+
+#include <vector>
+
+struct PipelineState {
+    unsigned int program;
+    unsigned int vao;          // the vertex layout, its buffers must hold at least 6 vertices (and indices)
+    unsigned int mode;         // GL_TRIANGLES, GL_LINES, ...
+    unsigned int indexType;    // 0: glDrawArrays, otherwise the type of the vertex array's index buffer
+
+    bool blend;
+    unsigned int blendSrc;     // glBlendFunc factors
+    unsigned int blendDst;
+    bool depthTest;
+    unsigned int depthFunc;
+    bool depthWrite;
+    bool cullFace;
+
+    // Target: offscreen formats (0: none) or, if both are 0, the framebuffer object to draw into.
+    unsigned int colorFormat;  // ex.: GL_RGBA8, GL_RGBA16F
+    unsigned int depthFormat;  // ex.: GL_DEPTH_COMPONENT24, GL_DEPTH24_STENCIL8
+    int samples;               // MSAA samples of the offscreen target (0: single sampled)
+    unsigned int framebuffer;
+};
+
+// An offscreen target of a format combination (created by runPipelineWarmup).
+struct PipelineWarmupTarget {
+    unsigned int colorFormat;
+    unsigned int depthFormat;
+    int samples;
+    unsigned int fbo;
+    unsigned int colorRB;
+    unsigned int depthRB;
+};
+
+struct PipelineWarmup {
+    std::vector<PipelineState> states;
+    std::vector<PipelineWarmupTarget> targets;
+
+    // Statistics of the last run.
+    int draws;
+    double ms;
+
+    PipelineWarmup() : draws(0), ms(0.0) {}
+};
+
+// Triangles from the vertex array with glDrawArrays, no blend, no depth test, into the framebuffer 0.
+PipelineState defaultPipelineState(unsigned int program, unsigned int vao);
+
+// Declare a state combination (duplicates are drawn once).
+void pipelineWarmupAdd(PipelineWarmup* warmup, const PipelineState& state);
+
+// Draw every declared state once and wait for the GPU. Returns the time spent in milliseconds.
+double runPipelineWarmup(PipelineWarmup* warmup);
+
+// Delete the offscreen targets.
+void destroyPipelineWarmup(PipelineWarmup* warmup);
+
+#endif // GLES_COMMON_PIPELINE_WARMUP_H
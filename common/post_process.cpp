@@ -0,0 +1,300 @@
+/**
+ * Post-processing chain. See post_process.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/post_process.h"
+
+#include <stdio.h>
+#include <string>
+
+#include <GLES3/gl3.h>
+
+#include "common/program_cache.h"
+#include "common/render_pass.h"
+
+static const char* post_vertex_src = R"(#version 310 es
+precision highp float;
+
+out vec2 vTex;
+
+void main() {
+    // Full-screen triangle: (-1, -1), (3, -1), (-1, 3).
+    vec2 pos = vec2(float((gl_VertexID & 1) << 2) - 1.0, float((gl_VertexID & 2) << 1) - 1.0);
+    gl_Position = vec4(pos, 0.0, 1.0);
+    vTex = pos * 0.5 + 0.5;
+}
+)";
+
+static const char* post_fragment_header_src = R"(#version 310 es
+precision mediump float;
+
+in vec2 vTex;
+out vec4 outColor;
+
+uniform sampler2D uInput0;
+uniform sampler2D uInput1;
+uniform vec2 uTexelSize; // of uInput0
+uniform vec2 uDirection;
+uniform float uThreshold;
+uniform float uIntensity;
+uniform float uExposure;
+
+vec3 downsample() {
+    // The bilinear taps in the middle of 2x2 texel blocks average 4 texels each.
+    vec3 color = texture(uInput0, vTex + uTexelSize * vec2(-0.5, -0.5)).rgb;
+    color += texture(uInput0, vTex + uTexelSize * vec2( 0.5, -0.5)).rgb;
+    color += texture(uInput0, vTex + uTexelSize * vec2(-0.5,  0.5)).rgb;
+    color += texture(uInput0, vTex + uTexelSize * vec2( 0.5,  0.5)).rgb;
+    return color * 0.25;
+}
+
+vec3 blur() {
+    // 9 tap gaussian with the bilinear filter merging the taps in pairs.
+    const float offsets[3] = float[](0.0, 1.3846153846, 3.2307692308);
+    const float weights[3] = float[](0.2270270270, 0.3162162162, 0.0702702703);
+
+    vec3 color = texture(uInput0, vTex).rgb * weights[0];
+    for (int idx = 1; idx < 3; idx++) {
+        vec2 offset = uDirection * uTexelSize * offsets[idx];
+        color += texture(uInput0, vTex + offset).rgb * weights[idx];
+        color += texture(uInput0, vTex - offset).rgb * weights[idx];
+    }
+    return color;
+}
+)";
+
+static const char* post_stage_main_src[POST_STAGE_COUNT] = {
+    // POST_DOWNSAMPLE
+    R"(
+void main() {
+    outColor = vec4(downsample(), 1.0);
+}
+)",
+    // POST_BRIGHT_DOWNSAMPLE
+    R"(
+void main() {
+    vec3 color = downsample();
+    float luma = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    outColor = vec4(color * (max(luma - uThreshold, 0.0) / max(luma, 0.0001)), 1.0);
+}
+)",
+    // POST_BLUR_HORIZONTAL
+    R"(
+void main() {
+    outColor = vec4(blur(), 1.0);
+}
+)",
+    // POST_BLUR_VERTICAL
+    R"(
+void main() {
+    outColor = vec4(blur(), 1.0);
+}
+)",
+    // POST_BLOOM_TONEMAP
+    R"(
+void main() {
+    vec3 color = texture(uInput0, vTex).rgb + texture(uInput1, vTex).rgb * uIntensity;
+    outColor = vec4(vec3(1.0) - exp(-color * uExposure), 1.0);
+}
+)",
+};
+
+static unsigned int stageProgram(PostChain* chain, PostStage stage) {
+    if (chain->programs[stage] == 0) {
+        /* The blur stages share the source: the direction is a uniform. */
+        std::string fragmentSrc = std::string(post_fragment_header_src) + post_stage_main_src[stage];
+        unsigned int program = createCachedProgram(post_vertex_src, fragmentSrc.c_str());
+
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "uInput0"), 0);
+        glUniform1i(glGetUniformLocation(program, "uInput1"), 1);
+        glUseProgram(0);
+
+        chain->programs[stage] = program;
+    }
+    return chain->programs[stage];
+}
+
+void initPostChain(PostChain* chain, RenderTargetPool* pool) {
+    chain->passes.clear();
+    for (int idx = 0; idx < POST_STAGE_COUNT; idx++) {
+        chain->programs[idx] = 0;
+    }
+    glGenVertexArrays(1, &chain->vao);
+    chain->pool = pool;
+    chain->fullResolution = false;
+    chain->threshold = 0.6f;
+    chain->intensity = 0.8f;
+    chain->exposure = 1.5f;
+    chain->pixelsPerFrame = 0;
+}
+
+void destroyPostChain(PostChain* chain) {
+    for (int idx = 0; idx < POST_STAGE_COUNT; idx++) {
+        if (chain->programs[idx] != 0) {
+            glDeleteProgram(chain->programs[idx]);
+        }
+    }
+    glDeleteVertexArrays(1, &chain->vao);
+    chain->passes.clear();
+}
+
+int addPostPass(PostChain* chain, const char* name, PostStage stage, int input0, int input1, int divisor) {
+    PostPass pass;
+    pass.name = name;
+    pass.stage = stage;
+    pass.inputs[0] = input0;
+    pass.inputs[1] = input1;
+    pass.divisor = divisor;
+
+    chain->passes.push_back(pass);
+    return (int)chain->passes.size() - 1;
+}
+
+void addBloomPasses(PostChain* chain) {
+    /* The bloom is a wide blur: the quarter resolution is enough for it. */
+    int bright = addPostPass(chain, "bright", POST_BRIGHT_DOWNSAMPLE, POST_INPUT_SCENE, POST_INPUT_NONE, 2);
+    int down = addPostPass(chain, "downsample", POST_DOWNSAMPLE, bright, POST_INPUT_NONE, 4);
+    int blurH = addPostPass(chain, "blur H", POST_BLUR_HORIZONTAL, down, POST_INPUT_NONE, 4);
+    int blurV = addPostPass(chain, "blur V", POST_BLUR_VERTICAL, blurH, POST_INPUT_NONE, 4);
+    addPostPass(chain, "tonemap", POST_BLOOM_TONEMAP, POST_INPUT_SCENE, blurV, 0);
+}
+
+static int passDivisor(const PostChain* chain, const PostPass& pass) {
+    return (chain->fullResolution && pass.divisor > 0) ? 1 : pass.divisor;
+}
+
+void runPostChain(PostChain* chain, unsigned int sceneTexture, int width, int height, unsigned int outputFbo) {
+    size_t passCount = chain->passes.size();
+
+    // 1. Count the readers of each pass output: the target is released after the last one.
+    std::vector<int> readers(passCount, 0);
+    for (size_t idx = 0; idx < passCount; idx++) {
+        for (int input = 0; input < 2; input++) {
+            if (chain->passes[idx].inputs[input] >= 0) {
+                readers[chain->passes[idx].inputs[input]]++;
+            }
+        }
+    }
+
+    std::vector<RenderTarget*> outputs(passCount, (RenderTarget*)NULL);
+    chain->pixelsPerFrame = 0;
+
+    glBindVertexArray(chain->vao);
+    for (size_t idx = 0; idx < passCount; idx++) {
+        const PostPass& pass = chain->passes[idx];
+        int divisor = passDivisor(chain, pass);
+
+        // 2. Acquire the output target (a target released by an earlier pass is reused).
+        unsigned int fbo = outputFbo;
+        int outWidth = width;
+        int outHeight = height;
+        if (divisor > 0) {
+            outWidth = width / divisor > 0 ? width / divisor : 1;
+            outHeight = height / divisor > 0 ? height / divisor : 1;
+            outputs[idx] = acquireRenderTarget(chain->pool, GL_RGBA8, outWidth, outHeight);
+            if (outputs[idx] == NULL) {
+                break;
+            }
+            fbo = outputs[idx]->fbo;
+        }
+
+        // 3. Bind the inputs.
+        int input0Size[2] = { width, height };
+        for (int input = 0; input < 2; input++) {
+            unsigned int texture = 0;
+            if (pass.inputs[input] == POST_INPUT_SCENE) {
+                texture = sceneTexture;
+            } else if (pass.inputs[input] >= 0 && outputs[pass.inputs[input]] != NULL) {
+                const RenderTarget* target = outputs[pass.inputs[input]];
+                texture = target->texture;
+                if (input == 0) {
+                    input0Size[0] = target->key.width;
+                    input0Size[1] = target->key.height;
+                }
+            }
+
+            glActiveTexture(GL_TEXTURE0 + input);
+            glBindTexture(GL_TEXTURE_2D, texture);
+        }
+        glActiveTexture(GL_TEXTURE0);
+
+        // 4. Draw the full-screen triangle: every pixel is overwritten, the old contents are not loaded.
+        RenderPass renderPass = createRenderPass(pass.name, fbo, outWidth, outHeight);
+        renderPass.color = { RENDER_PASS_DONT_CARE, RENDER_PASS_STORE, 4 };
+        beginRenderPass(&renderPass);
+
+        unsigned int program = stageProgram(chain, pass.stage);
+        glUseProgram(program);
+        glUniform2f(glGetUniformLocation(program, "uTexelSize"), 1.0f / input0Size[0], 1.0f / input0Size[1]);
+        glUniform2f(glGetUniformLocation(program, "uDirection"),
+                    pass.stage == POST_BLUR_HORIZONTAL ? 1.0f : 0.0f, pass.stage == POST_BLUR_VERTICAL ? 1.0f : 0.0f);
+        glUniform1f(glGetUniformLocation(program, "uThreshold"), chain->threshold);
+        glUniform1f(glGetUniformLocation(program, "uIntensity"), chain->intensity);
+        glUniform1f(glGetUniformLocation(program, "uExposure"), chain->exposure);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        endRenderPass(&renderPass);
+        chain->pixelsPerFrame += (int64_t)outWidth * outHeight;
+
+        // 5. Release the inputs which have no more readers (and the outputs which have none at all).
+        for (int input = 0; input < 2; input++) {
+            int inputPass = pass.inputs[input];
+            if (inputPass >= 0 && --readers[inputPass] == 0) {
+                releaseRenderTarget(chain->pool, outputs[inputPass]);
+            }
+        }
+        if (readers[idx] == 0) {
+            releaseRenderTarget(chain->pool, outputs[idx]);
+        }
+    }
+
+    // 6. Release everything left over after an error.
+    for (size_t idx = 0; idx < passCount; idx++) {
+        if (outputs[idx] != NULL && outputs[idx]->inUse) {
+            releaseRenderTarget(chain->pool, outputs[idx]);
+        }
+    }
+
+    glUseProgram(0);
+    glBindVertexArray(0);
+}
+
+void printPostChainReport(const PostChain* chain, int width, int height) {
+    int64_t fullResolutionMemory = 0;
+
+    printf("Post-processing chain%s:\n", chain->fullResolution ? " (full resolution)" : "");
+    for (size_t idx = 0; idx < chain->passes.size(); idx++) {
+        const PostPass& pass = chain->passes[idx];
+        int divisor = passDivisor(chain, pass);
+        printf("  %-12s %s\n", pass.name,
+               divisor == 0 ? "output" : divisor == 1 ? "1/1" : divisor == 2 ? "1/2" : divisor == 4 ? "1/4" : "1/N");
+        if (pass.divisor > 0) {
+            fullResolutionMemory += (int64_t)width * height * 4;
+        }
+    }
+
+    printf("  %.2f Mpixels/frame, render targets: %.2f MiB (%.2f MiB with a window sized target per pass)\n",
+           chain->pixelsPerFrame / 1e6, renderTargetPoolMemory(chain->pool) / (1024.0 * 1024.0),
+           fullResolutionMemory / (1024.0 * 1024.0));
+}
@@ -0,0 +1,102 @@
+/**
+ * Post-processing chain: a list of full-screen passes rendered into pooled targets.
+ *
+ * Each pass samples the scene texture and/or the outputs of earlier passes and
+ * renders into a render target of the scene size divided by its divisor
+ * (divisor 0: the output framebuffer). The targets come from a
+ * RenderTargetPool: a target is released as soon as its last reader is done,
+ * so a later pass of the same size reuses it. The bloom chain
+ * (addBloomPasses) only needs one half and two quarter resolution targets:
+ *
+ *   scene -> bright (1/2) -> downsample (1/4) -> blur H (1/4) -> blur V (1/4)
+ *   scene + blur V -> bloom + tonemap (output)
+ *
+ * The passes use the texture units 0 and 1 and their own VAO (no vertex
+ * buffers: the full-screen triangle is generated from gl_VertexID). The depth
+ * test and the blending must be disabled while the chain runs.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_POST_PROCESS_H
+#define GLES_COMMON_POST_PROCESS_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "common/render_target_pool.h"
+
+// Pass input: the scene texture or no input (other values: index of an earlier pass).
+#define POST_INPUT_SCENE -1
+#define POST_INPUT_NONE -2
+
+enum PostStage {
+    POST_DOWNSAMPLE,        // 2x2 box filter (4 bilinear taps)
+    POST_BRIGHT_DOWNSAMPLE, // downsample and keep the color above the threshold
+    POST_BLUR_HORIZONTAL,   // 9 tap gaussian blur (5 bilinear taps)
+    POST_BLUR_VERTICAL,
+    POST_BLOOM_TONEMAP,     // input 0 + input 1 * intensity, exponential tone mapping
+    POST_STAGE_COUNT,
+};
+
+struct PostPass {
+    const char* name;
+    PostStage stage;
+    int inputs[2];
+    int divisor; // output size: scene size / divisor, 0: the output framebuffer
+};
+
+struct PostChain {
+    std::vector<PostPass> passes;
+    unsigned int programs[POST_STAGE_COUNT]; // created on the first use of a stage
+    unsigned int vao;
+    RenderTargetPool* pool;
+
+    // Render every intermediate target at full resolution (to compare the cost).
+    bool fullResolution;
+
+    float threshold;
+    float intensity;
+    float exposure;
+
+    // Number of pixels shaded by the last runPostChain call.
+    int64_t pixelsPerFrame;
+};
+
+void initPostChain(PostChain* chain, RenderTargetPool* pool);
+
+void destroyPostChain(PostChain* chain);
+
+// Append a pass, returns its index to be used as the input of later passes.
+int addPostPass(PostChain* chain, const char* name, PostStage stage, int input0, int input1, int divisor);
+
+// Append the bloom passes (see above) with the final pass rendering into the output framebuffer.
+void addBloomPasses(PostChain* chain);
+
+// Run the passes on the scene texture, the last pass should render into outputFbo (width x height).
+void runPostChain(PostChain* chain, unsigned int sceneTexture, int width, int height, unsigned int outputFbo);
+
+// Print the passes, the shaded pixels and the pooled memory compared to window sized intermediates.
+/* Call after the first runPostChain since the targets are allocated there. */
+void printPostChainReport(const PostChain* chain, int width, int height);
+
+#endif // GLES_COMMON_POST_PROCESS_H
@@ -0,0 +1,484 @@
+/**
+ * Shader program cache with on-disk program binary persistence.
+ * See program_cache.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/program_cache.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES3/gl31.h>
+#include <GLES2/gl2ext.h>
+
+// Header of a cache file, followed by "length" bytes of program binary.
+struct ProgramCacheHeader {
+    uint32_t magic;
+    uint32_t format;
+    uint32_t length;
+};
+
+static const uint32_t PROGRAM_CACHE_MAGIC = 0x42504C47; // "GLPB"
+
+// A table of registerOptimizedShaders.
+struct OptimizedShaderTable {
+    const OptimizedShader* shaders;
+    int count;
+};
+
+// A function static: the registrations run before main, in any order with the other globals.
+static std::vector<OptimizedShaderTable>& optimizedShaderTables() {
+    static std::vector<OptimizedShaderTable> tables;
+    return tables;
+}
+
+void registerOptimizedShaders(const OptimizedShader* shaders, int count) {
+    optimizedShaderTables().push_back({ shaders, count });
+}
+
+// The optimized replacement of a source, or the source itself.
+static const char* optimizedSource(const char* src) {
+    static const char* setting = getenv("GLES_OPTIMIZED_SHADERS");
+    if (src == NULL || (setting != NULL && strcmp(setting, "0") == 0)) {
+        return src;
+    }
+
+    for (const OptimizedShaderTable& table : optimizedShaderTables()) {
+        for (int idx = 0; idx < table.count; idx++) {
+            if (table.shaders[idx].source == src || strcmp(table.shaders[idx].source, src) == 0) {
+                return table.shaders[idx].optimized;
+            }
+        }
+    }
+    return src;
+}
+
+static bool hasGLExtension(const char* name) {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int idx = 0; idx < count; idx++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, idx), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// FNV-1a 64 bit hash, good enough to tell the shader sources apart.
+static uint64_t hashString(uint64_t hash, const char* str) {
+    if (str == NULL) {
+        return hash;
+    }
+
+    for (const unsigned char* ptr = (const unsigned char*)str; *ptr; ptr++) {
+        hash ^= *ptr;
+        hash *= 0x100000001b3ULL;
+    }
+
+    // Include a separator so "ab" + "c" differs from "a" + "bc".
+    hash ^= 0xff;
+    hash *= 0x100000001b3ULL;
+    return hash;
+}
+
+static const char* cacheDirectory() {
+    const char* dir = getenv("GLES_PROGRAM_CACHE_DIR");
+    if (dir == NULL) {
+        return "program_cache";
+    }
+    return dir;
+}
+
+static bool cacheSupported() {
+    if (cacheDirectory()[0] == '\0') {
+        return false;
+    }
+
+    // Without any supported binary format glGetProgramBinary can't be used.
+    int formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    return formatCount > 0;
+}
+
+static std::string cachePath(const char* const* sources, int sourceCount,
+                             const char* const* varyings = NULL, int varyingCount = 0) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    // The driver identification is part of the key: a different GPU/driver
+    // produces a different entry instead of a failing glProgramBinary call.
+    hash = hashString(hash, (const char*)glGetString(GL_VENDOR));
+    hash = hashString(hash, (const char*)glGetString(GL_RENDERER));
+    hash = hashString(hash, (const char*)glGetString(GL_VERSION));
+
+    for (int idx = 0; idx < sourceCount; idx++) {
+        hash = hashString(hash, sources[idx]);
+    }
+    // The transform feedback outputs are linked into the binary as well.
+    for (int idx = 0; idx < varyingCount; idx++) {
+        hash = hashString(hash, varyings[idx]);
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)hash);
+
+    return std::string(cacheDirectory()) + name;
+}
+
+// Hand the cached binary to the driver without checking the result (see loadProgramBinary).
+static bool submitProgramBinary(unsigned int program, const std::string& path) {
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    ProgramCacheHeader header;
+    if (!file.read((char*)&header, sizeof(header)) || header.magic != PROGRAM_CACHE_MAGIC) {
+        return false;
+    }
+
+    std::vector<char> binary(header.length);
+    if (!file.read(binary.data(), binary.size())) {
+        return false;
+    }
+
+    glProgramBinary(program, header.format, binary.data(), header.length);
+    return true;
+}
+
+static bool loadProgramBinary(unsigned int program, const std::string& path) {
+    if (!submitProgramBinary(program, path)) {
+        return false;
+    }
+
+    // The driver is allowed to reject any binary (ex.: after a driver update).
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    return success;
+}
+
+static void storeProgramBinary(unsigned int program, const std::string& path) {
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    ProgramCacheHeader header = { PROGRAM_CACHE_MAGIC, format, (uint32_t)length };
+
+    mkdir(cacheDirectory(), 0755);
+
+    // Write into a temporary file first so a concurrent run never sees a partial entry.
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath.c_str(), std::ios::out | std::ios::binary);
+        if (!file) {
+            printf("Program cache: unable to write '%s'\n", tmpPath.c_str());
+            return;
+        }
+        file.write((const char*)&header, sizeof(header));
+        file.write(binary.data(), length);
+    }
+
+    rename(tmpPath.c_str(), path.c_str());
+}
+
+// Print the info log and exit if the shader didn't compile.
+static void checkShader(GLenum type, unsigned int shader) {
+    int success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char info[512];
+        glGetShaderInfoLog(shader, 512, NULL, info);
+        const char* name = (type == GL_VERTEX_SHADER) ? "Vertex"
+                         : (type == GL_FRAGMENT_SHADER) ? "Fragment"
+                         : (type == GL_TESS_CONTROL_SHADER_EXT) ? "Tessellation control"
+                         : (type == GL_TESS_EVALUATION_SHADER_EXT) ? "Tessellation evaluation" : "Compute";
+        printf("%s shader error:\n%s\n", name, info);
+        exit(-3);
+    }
+}
+
+static unsigned int compileShader(GLenum type, const char* src) {
+    unsigned int shader = glCreateShader(type);
+    glShaderSource(shader, 1, &src, NULL);
+    glCompileShader(shader);
+    checkShader(type, shader);
+
+    return shader;
+}
+
+// "GLES_SHADER_DUMP_DIR": write the sources of a program once per process (the programs can be built by GL workers).
+static void dumpProgramSources(const GLenum* types, const char* const* sources, int sourceCount) {
+    static const char* dir = getenv("GLES_SHADER_DUMP_DIR");
+    if (dir == NULL || dir[0] == '\0') {
+        return;
+    }
+
+    static std::mutex mutex;
+    static std::vector<uint64_t> dumped;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (int idx = 0; idx < sourceCount; idx++) {
+        hash = hashString(hash, sources[idx]);
+    }
+    if (std::find(dumped.begin(), dumped.end(), hash) != dumped.end()) {
+        return;
+    }
+
+    mkdir(dir, 0755);
+    for (int idx = 0; idx < sourceCount; idx++) {
+        const char* extension = (types[idx] == GL_VERTEX_SHADER) ? "vert"
+                              : (types[idx] == GL_FRAGMENT_SHADER) ? "frag"
+                              : (types[idx] == GL_TESS_CONTROL_SHADER_EXT) ? "tesc"
+                              : (types[idx] == GL_TESS_EVALUATION_SHADER_EXT) ? "tese" : "comp";
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%03d.%s", dir, (int)dumped.size(), extension);
+
+        std::ofstream file(path, std::ios::out | std::ios::binary);
+        if (!file) {
+            printf("Program cache: unable to write '%s'\n", path);
+            return;
+        }
+        file << sources[idx];
+    }
+    dumped.push_back(hash);
+}
+
+static unsigned int createProgram(const GLenum* types, const char* const* sources, int sourceCount,
+                                  const char* const* varyings = NULL, int varyingCount = 0) {
+    dumpProgramSources(types, sources, sourceCount);
+    bool useCache = cacheSupported();
+    std::string path;
+
+    unsigned int program = glCreateProgram();
+
+    // 1. Try to restore the program from the cache.
+    if (useCache) {
+        path = cachePath(sources, sourceCount, varyings, varyingCount);
+        if (loadProgramBinary(program, path)) {
+            return program;
+        }
+
+        /* A program object which failed glProgramBinary is still usable,
+         * but start from a clean object to avoid any driver quirks. */
+        glDeleteProgram(program);
+        program = glCreateProgram();
+    }
+
+    // 2. Compile the shaders and link the program.
+    unsigned int shaders[4];
+    for (int idx = 0; idx < sourceCount; idx++) {
+        shaders[idx] = compileShader(types[idx], sources[idx]);
+        glAttachShader(program, shaders[idx]);
+    }
+
+    if (useCache) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    if (varyingCount > 0) {
+        glTransformFeedbackVaryings(program, varyingCount, varyings, GL_INTERLEAVED_ATTRIBS);
+    }
+
+    glLinkProgram(program);
+
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char info[512];
+        glGetProgramInfoLog(program, 512, NULL, info);
+        printf("Program error:\n%s\n", info);
+        exit(-3);
+    }
+
+    // 3. The shaders can be removed after linking.
+    for (int idx = 0; idx < sourceCount; idx++) {
+        glDetachShader(program, shaders[idx]);
+        glDeleteShader(shaders[idx]);
+    }
+
+    // 4. Store the binary for the next run.
+    if (useCache) {
+        storeProgramBinary(program, path);
+    }
+
+    return program;
+}
+
+unsigned int createCachedProgram(const char* vertex_src, const char* fragment_src) {
+    const GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+    const char* sources[] = { optimizedSource(vertex_src), optimizedSource(fragment_src) };
+
+    return createProgram(types, sources, 2);
+}
+
+unsigned int createCachedFeedbackProgram(const char* vertex_src, const char* fragment_src,
+                                         const char* const* varyings, int varyingCount) {
+    const GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+    const char* sources[] = { optimizedSource(vertex_src), optimizedSource(fragment_src) };
+
+    return createProgram(types, sources, 2, varyings, varyingCount);
+}
+
+unsigned int createCachedComputeProgram(const char* compute_src) {
+    const GLenum types[] = { GL_COMPUTE_SHADER };
+    const char* sources[] = { optimizedSource(compute_src) };
+
+    return createProgram(types, sources, 1);
+}
+
+unsigned int createCachedTessellationProgram(const char* vertex_src, const char* control_src,
+                                             const char* evaluation_src, const char* fragment_src) {
+    const GLenum types[] = { GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER_EXT, GL_TESS_EVALUATION_SHADER_EXT,
+                             GL_FRAGMENT_SHADER };
+    const char* sources[] = { optimizedSource(vertex_src), optimizedSource(control_src),
+                              optimizedSource(evaluation_src), optimizedSource(fragment_src) };
+
+    return createProgram(types, sources, 4);
+}
+
+static bool parallelCompileChecked = false;
+static bool parallelCompile = false;
+
+bool programCacheParallelCompile() {
+    return parallelCompile;
+}
+
+// State of a program between the submit and the status check of createCachedPrograms.
+struct PendingProgram {
+    GLenum types[2];
+    const char* sources[2];
+    int sourceCount;
+    unsigned int shaders[2];
+    unsigned int program;
+    bool fromCache;
+    std::string path;
+};
+
+void createCachedPrograms(const CachedProgramDesc* programs, int count) {
+    // 1. Let the driver use its own compiler threads (once per process).
+    if (!parallelCompileChecked) {
+        parallelCompileChecked = true;
+        if (hasGLExtension("GL_KHR_parallel_shader_compile")) {
+            PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxShaderCompilerThreads =
+                (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)eglGetProcAddress("glMaxShaderCompilerThreadsKHR");
+            if (maxShaderCompilerThreads) {
+                /* 0xFFFFFFFF: as many threads as the driver wants. */
+                maxShaderCompilerThreads(0xFFFFFFFFu);
+                parallelCompile = true;
+            }
+        }
+    }
+
+    // 2. Submit every program: the cached binary or the compiles and the link, no status query.
+    bool useCache = cacheSupported();
+    std::vector<PendingProgram> pending(count);
+    for (int idx = 0; idx < count; idx++) {
+        PendingProgram& build = pending[idx];
+        if (programs[idx].computeSrc) {
+            build.types[0] = GL_COMPUTE_SHADER;
+            build.sources[0] = optimizedSource(programs[idx].computeSrc);
+            build.sourceCount = 1;
+        } else {
+            build.types[0] = GL_VERTEX_SHADER;
+            build.types[1] = GL_FRAGMENT_SHADER;
+            build.sources[0] = optimizedSource(programs[idx].vertexSrc);
+            build.sources[1] = optimizedSource(programs[idx].fragmentSrc);
+            build.sourceCount = 2;
+        }
+
+        dumpProgramSources(build.types, build.sources, build.sourceCount);
+        build.program = glCreateProgram();
+        build.fromCache = false;
+        if (useCache) {
+            build.path = cachePath(build.sources, build.sourceCount);
+            build.fromCache = submitProgramBinary(build.program, build.path);
+        }
+        if (build.fromCache) {
+            continue;
+        }
+
+        for (int shader = 0; shader < build.sourceCount; shader++) {
+            build.shaders[shader] = glCreateShader(build.types[shader]);
+            glShaderSource(build.shaders[shader], 1, &build.sources[shader], NULL);
+            glCompileShader(build.shaders[shader]);
+            glAttachShader(build.program, build.shaders[shader]);
+        }
+        if (useCache) {
+            glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glLinkProgram(build.program);
+    }
+
+    // 3. Check the results in submission order (the first query waits, the others are done by then).
+    for (int idx = 0; idx < count; idx++) {
+        PendingProgram& build = pending[idx];
+
+        int success;
+        glGetProgramiv(build.program, GL_LINK_STATUS, &success);
+        if (build.fromCache) {
+            // 3.1. The driver rejected the cached binary: build this one from source.
+            if (!success) {
+                glDeleteProgram(build.program);
+                build.program = createProgram(build.types, build.sources, build.sourceCount);
+            }
+            *programs[idx].program = build.program;
+            continue;
+        }
+
+        if (!success) {
+            for (int shader = 0; shader < build.sourceCount; shader++) {
+                checkShader(build.types[shader], build.shaders[shader]);
+            }
+
+            char info[512];
+            glGetProgramInfoLog(build.program, 512, NULL, info);
+            printf("Program error:\n%s\n", info);
+            exit(-3);
+        }
+
+        for (int shader = 0; shader < build.sourceCount; shader++) {
+            glDetachShader(build.program, build.shaders[shader]);
+            glDeleteShader(build.shaders[shader]);
+        }
+        if (useCache) {
+            storeProgramBinary(build.program, build.path);
+        }
+        *programs[idx].program = build.program;
+    }
+}
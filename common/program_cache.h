@@ -0,0 +1,101 @@
+/**
+ * Shader program cache with on-disk program binary persistence.
+ *
+ * The source strings of a program are hashed together with the GL driver
+ * identification strings (vendor, renderer, version). The linked program
+ * binary is stored under that hash via glGetProgramBinary and on the next
+ * run it is restored with glProgramBinary which skips the compile/link steps.
+ * If the driver rejects the stored binary (ex.: driver update) the program is
+ * compiled from source again and the cache entry is rewritten.
+ *
+ * The cache directory can be changed with the GLES_PROGRAM_CACHE_DIR
+ * environment variable (default: "program_cache" in the working directory).
+ * Setting GLES_PROGRAM_CACHE_DIR to an empty string disables the disk cache.
+ *
+ * With the GLES_OPTIMIZE_SHADERS build option every add_program target links
+ * the shaders of its source optimized offline (see tools/shader_optimize.cpp):
+ * the cached programs compile the optimized text instead of a registered
+ * source. GLES_OPTIMIZED_SHADERS=0 in the environment uses the original sources
+ * (to compare the two).
+ *
+ * GLES_SHADER_DUMP_DIR writes the final sources of every requested program
+ * into that directory (NNN.vert, NNN.frag or NNN.comp, NNN: the order of the
+ * first request), the input of the shader statistics report (x_gles_bench/gles_shader_stats.cpp).
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+ (3.1+ for compute programs)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_PROGRAM_CACHE_H
+#define GLES_COMMON_PROGRAM_CACHE_H
+
+// Create a vertex + fragment shader program.
+/* Loads the program binary from the cache if possible, otherwise compiles the
+ * sources and stores the resulting binary. On compile/link error the
+ * info log is printed and the process exits (same as the demo helpers). */
+unsigned int createCachedProgram(const char* vertex_src, const char* fragment_src);
+
+// Create a vertex + fragment shader program which captures "varyings" with transform feedback.
+/* The outputs are written interleaved (GL_INTERLEAVED_ATTRIBS) into one buffer, in the given order.
+ * Same caching rules as above, the varyings are part of the cache key. */
+unsigned int createCachedFeedbackProgram(const char* vertex_src, const char* fragment_src,
+                                         const char* const* varyings, int varyingCount);
+
+// Create a compute shader program (same caching rules as above).
+unsigned int createCachedComputeProgram(const char* compute_src);
+
+// Create a vertex + tessellation control/evaluation + fragment shader program (same caching rules as above).
+/* Needs OpenGL ES 3.2 or GL_EXT_tessellation_shader (see terrain.h). */
+unsigned int createCachedTessellationProgram(const char* vertex_src, const char* control_src,
+                                             const char* evaluation_src, const char* fragment_src);
+
+// A program of createCachedPrograms: vertex + fragment or compute sources.
+struct CachedProgramDesc {
+    const char* vertexSrc;
+    const char* fragmentSrc;
+    const char* computeSrc; // set instead of the two above for a compute program
+    unsigned int* program;  // receives the program
+};
+
+// Create many programs at once (same caching rules as above).
+/* Every cache load, compile and link is issued before the first status query,
+ * so the driver can build the programs concurrently: with KHR_parallel_shader_compile
+ * it uses its own compiler threads (glMaxShaderCompilerThreadsKHR), the startup
+ * then waits for the slowest program instead of the sum of all of them. */
+void createCachedPrograms(const CachedProgramDesc* programs, int count);
+
+// True if KHR_parallel_shader_compile is used by createCachedPrograms (valid after the first call).
+bool programCacheParallelCompile();
+
+// A shader source and its offline optimized replacement.
+struct OptimizedShader {
+    const char* source;
+    const char* optimized;
+};
+
+// Register optimized replacements: the programs above compile "optimized" for a source with the same text.
+/* Called before main by the sources generated by tools/shader_optimize, the table must stay valid. */
+void registerOptimizedShaders(const OptimizedShader* shaders, int count);
+
+#endif // GLES_COMMON_PROGRAM_CACHE_H
@@ -0,0 +1,333 @@
+/**
+ * Quality governor, see quality_governor.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/quality_governor.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+// Time constants of the frame time averages (seconds).
+static const double fastTimeConstant = 0.5;
+static const double slowTimeConstant = 5.0;
+
+// A step down within this many seconds after a step up reverts it.
+static const double revertWindow = 10.0;
+static const double maxUpHold = 60.0;
+
+// Thermal: the sampling interval, the heating slope and the minimum time between two thermal steps.
+static const double thermalInterval = 1.0;
+static const double heatingSlope = 0.01;
+static const double thermalHold = 10.0;
+static const double defaultThermalLimit = 85.0;
+
+void initQualityGovernor(QualityGovernor* governor, double targetMs) {
+    memset(governor, 0, sizeof(*governor));
+    governor->targetMs = targetMs;
+    governor->downMargin = 0.1;
+    governor->upMargin = 0.25;
+    governor->downHold = 1.0;
+    governor->upHold = 5.0;
+    governor->settleTime = 2.0;
+    governor->thermalMargin = 5.0;
+    governor->overSince = -1.0;
+    governor->underSince = -1.0;
+    governor->lastChange = -1.0;
+    governor->lastSampleTime = -1.0;
+    governor->currentUpHold = governor->upHold;
+    governor->thermalLimit = defaultThermalLimit;
+    governor->lastThermalRead = -1.0;
+}
+
+// Read a sysfs file with one integer (ex.: millidegrees), false on failure.
+static bool readInteger(const char* path, long* value) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return false;
+    }
+    bool valid = fscanf(file, "%ld", value) == 1;
+    fclose(file);
+    return valid;
+}
+
+static bool readWord(const char* path, char* word, int size) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return false;
+    }
+    bool valid = fgets(word, size, file) != NULL;
+    fclose(file);
+    word[strcspn(word, "\n")] = '\0';
+    return valid;
+}
+
+// The lowest passive trip point of a zone directory (degrees Celsius), 0 without one.
+static double passiveTripPoint(const char* zone) {
+    double lowest = 0.0;
+    for (int trip = 0; trip < 16; trip++) {
+        char path[320];
+        char type[64];
+        long milli;
+        snprintf(path, sizeof(path), "%s/trip_point_%d_type", zone, trip);
+        if (!readWord(path, type, sizeof(type))) {
+            break;
+        }
+        snprintf(path, sizeof(path), "%s/trip_point_%d_temp", zone, trip);
+        if (strcmp(type, "passive") == 0 && readInteger(path, &milli) && milli > 0
+            && (lowest == 0.0 || milli / 1000.0 < lowest)) {
+            lowest = milli / 1000.0;
+        }
+    }
+    return lowest;
+}
+
+bool qualityGovernorOpenThermal(QualityGovernor* governor, const char* path, double limit) {
+    governor->thermal = false;
+    double zoneLimit = 0.0;
+
+    if (path != NULL) {
+        snprintf(governor->thermalPath, sizeof(governor->thermalPath), "%s", path);
+    } else {
+        // 1. The first zone with "gpu" in its type, otherwise the first readable zone.
+        int found = -1;
+        for (int zone = 0; zone < 64; zone++) {
+            char file[128];
+            char type[64];
+            long milli;
+            snprintf(file, sizeof(file), "/sys/class/thermal/thermal_zone%d/temp", zone);
+            if (!readInteger(file, &milli)) {
+                continue;
+            }
+            snprintf(file, sizeof(file), "/sys/class/thermal/thermal_zone%d/type", zone);
+            bool gpu = readWord(file, type, sizeof(type)) && (strstr(type, "gpu") != NULL || strstr(type, "GPU") != NULL);
+            if (found < 0 || gpu) {
+                found = zone;
+            }
+            if (gpu) {
+                break;
+            }
+        }
+        if (found < 0) {
+            printf("Quality governor: no thermal zone, only the frame time is used\n");
+            return false;
+        }
+
+        char zone[96];
+        snprintf(zone, sizeof(zone), "/sys/class/thermal/thermal_zone%d", found);
+        snprintf(governor->thermalPath, sizeof(governor->thermalPath), "%s/temp", zone);
+        zoneLimit = passiveTripPoint(zone);
+    }
+
+    long milli;
+    if (!readInteger(governor->thermalPath, &milli)) {
+        printf("Quality governor: the thermal zone %s can't be read, only the frame time is used\n",
+               governor->thermalPath);
+        return false;
+    }
+
+    governor->thermal = true;
+    governor->temperature = milli / 1000.0;
+    governor->temperatureSlope = 0.0;
+    governor->thermalLimit = limit > 0.0 ? limit : zoneLimit > 0.0 ? zoneLimit : defaultThermalLimit;
+    printf("Quality governor: thermal zone %s, %.1f C, throttle point %.1f C%s\n", governor->thermalPath,
+           governor->temperature, governor->thermalLimit,
+           limit > 0.0 ? "" : zoneLimit > 0.0 ? " (passive trip point)" : " (default)");
+    return true;
+}
+
+int qualityGovernorAddKnob(QualityGovernor* governor, const char* name, const int* values, int levelCount,
+                           const char* const* labels) {
+    if (governor->knobCount >= QUALITY_MAX_KNOBS || levelCount < 1) {
+        return -1;
+    }
+
+    QualityKnob& knob = governor->knobs[governor->knobCount];
+    knob.name = name;
+    knob.levelCount = std::min(levelCount, QUALITY_MAX_LEVELS);
+    knob.level = 0;
+    for (int level = 0; level < knob.levelCount; level++) {
+        knob.values[level] = values[level];
+        knob.labels[level] = labels != NULL ? labels[level] : NULL;
+    }
+    return governor->knobCount++;
+}
+
+int qualityKnobValue(const QualityGovernor* governor, int knob) {
+    const QualityKnob& entry = governor->knobs[knob];
+    return entry.values[entry.level];
+}
+
+static void formatLevel(const QualityKnob& knob, int level, char* buffer, int size) {
+    if (knob.labels[level] != NULL) {
+        snprintf(buffer, size, "%s", knob.labels[level]);
+    } else {
+        snprintf(buffer, size, "%d", knob.values[level]);
+    }
+}
+
+// Sample the thermal zone: the temperature and its smoothed slope.
+static void readThermal(QualityGovernor* governor, double now) {
+    if (!governor->thermal || (governor->lastThermalRead >= 0.0 && now - governor->lastThermalRead < thermalInterval)) {
+        return;
+    }
+
+    long milli;
+    if (!readInteger(governor->thermalPath, &milli)) {
+        return;
+    }
+    double temperature = milli / 1000.0;
+    if (governor->lastThermalRead >= 0.0) {
+        double slope = (temperature - governor->temperature) / (now - governor->lastThermalRead);
+        governor->temperatureSlope += (slope - governor->temperatureSlope) * 0.3;
+    }
+    governor->temperature = temperature;
+    governor->lastThermalRead = now;
+}
+
+// Step the first knob which can go lower (down) or the last lowered one (up), log the decision.
+static bool step(QualityGovernor* governor, double now, bool up, bool thermalReason) {
+    int knobIdx = -1;
+    if (up) {
+        for (int idx = governor->knobCount - 1; idx >= 0 && knobIdx < 0; idx--) {
+            knobIdx = governor->knobs[idx].level > 0 ? idx : -1;
+        }
+    } else {
+        for (int idx = 0; idx < governor->knobCount && knobIdx < 0; idx++) {
+            knobIdx = governor->knobs[idx].level + 1 < governor->knobs[idx].levelCount ? idx : -1;
+        }
+    }
+    if (knobIdx < 0) {
+        return false;
+    }
+
+    // 1. A step down soon after a step up: that level doesn't fit, wait longer before the next try.
+    if (!up && governor->lastChangeUp && now - governor->lastChange < revertWindow) {
+        governor->currentUpHold = std::min(governor->currentUpHold * 2.0, maxUpHold);
+        governor->revertedUpCount++;
+    }
+
+    QualityKnob& knob = governor->knobs[knobIdx];
+    char from[32];
+    char to[32];
+    formatLevel(knob, knob.level, from, sizeof(from));
+    knob.level += up ? -1 : 1;
+    formatLevel(knob, knob.level, to, sizeof(to));
+
+    char thermalText[96] = "";
+    if (governor->thermal) {
+        snprintf(thermalText, sizeof(thermalText), ", %.1f C (%+.2f C/s, throttle point %.1f C)",
+                 governor->temperature, governor->temperatureSlope, governor->thermalLimit);
+    }
+    const char* reason = up ? "under the target" : thermalReason ? "thermal" : "over the target";
+    printf("Quality governor: %.1f s: %s %s -> %s (%s: frame time %.2f ms, average %.2f ms, target %.2f ms%s)\n",
+           now, knob.name, from, to, reason, governor->fastMs, governor->slowMs, governor->targetMs, thermalText);
+
+    if (up) {
+        governor->upCount++;
+    } else {
+        governor->downCount++;
+        governor->thermalDownCount += thermalReason ? 1 : 0;
+    }
+
+    // 2. The averages are restarted with the new configuration after the settle time.
+    governor->lastChange = now;
+    governor->lastChangeUp = up;
+    governor->fastMs = 0.0;
+    governor->slowMs = 0.0;
+    governor->overSince = -1.0;
+    governor->underSince = -1.0;
+    governor->lastSampleTime = -1.0;
+    return true;
+}
+
+bool qualityGovernorUpdate(QualityGovernor* governor, double now, double frameMs) {
+    readThermal(governor, now);
+
+    // 1. The measurements of the settle time belong to the previous configuration (or to its reallocation).
+    if (governor->lastChange >= 0.0 && now - governor->lastChange < governor->settleTime) {
+        return false;
+    }
+    if (frameMs <= 0.0) {
+        return false;
+    }
+
+    // 2. The frame time trend: time based weights, the frame rate doesn't change the time constants.
+    if (governor->lastSampleTime < 0.0) {
+        governor->fastMs = frameMs;
+        governor->slowMs = frameMs;
+    } else {
+        double dt = std::max(now - governor->lastSampleTime, 0.0);
+        governor->fastMs += (frameMs - governor->fastMs) * (1.0 - exp(-dt / fastTimeConstant));
+        governor->slowMs += (frameMs - governor->slowMs) * (1.0 - exp(-dt / slowTimeConstant));
+    }
+    governor->lastSampleTime = now;
+
+    bool over = governor->fastMs > governor->targetMs * (1.0 + governor->downMargin);
+    bool under = governor->slowMs < governor->targetMs * (1.0 - governor->upMargin);
+    governor->overSince = over ? (governor->overSince < 0.0 ? now : governor->overSince) : -1.0;
+    governor->underSince = under ? (governor->underSince < 0.0 ? now : governor->underSince) : -1.0;
+
+    // 3. Thermal: over the throttle point, or close to it and still heating. Cool: a whole margin under the warning.
+    bool hot = false;
+    bool cool = true;
+    if (governor->thermal) {
+        double warning = governor->thermalLimit - governor->thermalMargin;
+        hot = governor->temperature >= governor->thermalLimit
+           || (governor->temperature >= warning && governor->temperatureSlope > heatingSlope);
+        cool = governor->temperature < warning - governor->thermalMargin;
+    }
+
+    // 4. One step per decision.
+    if (over && now - governor->overSince >= governor->downHold) {
+        return step(governor, now, false, false);
+    }
+    if (hot && (governor->lastChange < 0.0 || now - governor->lastChange >= thermalHold)) {
+        return step(governor, now, false, true);
+    }
+    if (under && cool && now - governor->underSince >= governor->currentUpHold) {
+        return step(governor, now, true, false);
+    }
+    return false;
+}
+
+void formatQualityLevels(const QualityGovernor* governor, char* buffer, int size) {
+    int length = 0;
+    buffer[0] = '\0';
+    for (int idx = 0; idx < governor->knobCount && length < size; idx++) {
+        char level[32];
+        formatLevel(governor->knobs[idx], governor->knobs[idx].level, level, sizeof(level));
+        length += snprintf(buffer + length, size - length, "%s%s %s", idx > 0 ? ", " : "", governor->knobs[idx].name, level);
+    }
+}
+
+void printQualityGovernorStats(const QualityGovernor* governor) {
+    char levels[256];
+    formatQualityLevels(governor, levels, sizeof(levels));
+    printf("Quality governor: %d steps down (%d thermal), %d up (%d reverted, up hold: %.0f s), final: %s\n",
+           governor->downCount, governor->thermalDownCount, governor->upCount, governor->revertedUpCount,
+           governor->currentUpHold, levels);
+}
@@ -0,0 +1,152 @@
+/**
+ * Quality governor: step the quality knobs of a demo down and up to hold a
+ * frame time target over long sessions, also when the device heats up.
+ *
+ * Fanless devices throttle after a few minutes of load: the clocks drop and
+ * the frame time spikes. A one-shot quality selection at startup (see
+ * device_profile.h) can't follow that, a per-frame controller of a single
+ * value (see dynamic_resolution.h) can't trade between different features.
+ * The governor owns a list of knobs (ex.: MSAA, shadow resolution, shader
+ * precision, internal resolution), each with a few levels from the best
+ * quality to the cheapest one, and makes one step at a time:
+ *
+ *   down  The short term frame time (~0.5 s average) is over the target by
+ *         "downMargin" for "downHold" seconds, or the thermal zone is within
+ *         "thermalMargin" of its throttle point and heating up. The first
+ *         knob in the registration order which can go lower is stepped.
+ *   up    The long term frame time (~5 s average) is under the target by
+ *         "upMargin" for the up hold time and the zone is cool (two margins
+ *         under the throttle point). The last lowered knob is restored first
+ *         (the reverse order).
+ *
+ * The margins, the hold times and the settle time after every change (the
+ * measurements of the old configuration and the reallocation spikes are
+ * dropped) are the hysteresis. A step up which has to be reverted within
+ * 10 seconds doubles the up hold time (up to 60 s): the governor doesn't
+ * oscillate around a level which doesn't fit. Every decision is logged with
+ * its reason.
+ *
+ * The frame time is the GPU time of the frame if the demo measures it (see
+ * gpu_timer.h), the CPU frame time otherwise. The thermal zone is read from
+ * sysfs (/sys/class/thermal/thermal_zone<N>/temp, millidegrees Celsius) once
+ * per second: the zone with "gpu" in its type, otherwise the first one, or a
+ * given file. The throttle point is the lowest passive trip point of the zone
+ * (85 C without one). Without a thermal zone only the frame time is used.
+ *
+ * Usage:
+ *
+ *   QualityGovernor governor;
+ *   initQualityGovernor(&governor, 16.6);
+ *   qualityGovernorOpenThermal(&governor, NULL); // auto
+ *   static const int msaaLevels[] = { 4, 2, 0 };
+ *   int msaa = qualityGovernorAddKnob(&governor, "MSAA", msaaLevels, 3, NULL);
+ *   while (...) {
+ *       int samples = qualityKnobValue(&governor, msaa);
+ *       ... render ...
+ *       if (qualityGovernorUpdate(&governor, now, frameMs)) {
+ *           ... apply the changed knobs ...
+ *       }
+ *   }
+ *   printQualityGovernorStats(&governor);
+ *
+ * Dependencies:
+ *  * C++11
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_QUALITY_GOVERNOR_H
+#define GLES_COMMON_QUALITY_GOVERNOR_H
+
+#define QUALITY_MAX_KNOBS 8
+#define QUALITY_MAX_LEVELS 8
+
+struct QualityKnob {
+    const char* name;
+    int values[QUALITY_MAX_LEVELS];         // level 0: the best quality, the last level: the cheapest
+    const char* labels[QUALITY_MAX_LEVELS]; // NULL: the value is printed
+    int levelCount;
+    int level;
+};
+
+struct QualityGovernor {
+    double targetMs;
+    double downMargin;    // step down over targetMs * (1 + downMargin), default: 0.1
+    double upMargin;      // step up under targetMs * (1 - upMargin), default: 0.25
+    double downHold;      // seconds over the target before a step down, default: 1
+    double upHold;        // seconds under the target before a step up, default: 5
+    double settleTime;    // seconds without measurements after a change, default: 2
+    double thermalMargin; // degrees Celsius under the throttle point, default: 5
+
+    QualityKnob knobs[QUALITY_MAX_KNOBS]; // stepped down in this order, restored in the reverse order
+    int knobCount;
+
+    // Frame time trend: exponential averages with 0.5 s and 5 s time constants (0: no sample yet).
+    double fastMs;
+    double slowMs;
+    double lastSampleTime;
+    double overSince;  // -1: the fast average is within the target
+    double underSince; // -1: the slow average is not under the target
+    double lastChange;
+    bool lastChangeUp;
+    double currentUpHold; // upHold, doubled after every reverted step up
+
+    // Thermal zone, sampled once per second.
+    char thermalPath[256];
+    bool thermal;
+    double temperature;      // degrees Celsius
+    double temperatureSlope; // degrees Celsius per second (smoothed)
+    double thermalLimit;     // the throttle point
+    double lastThermalRead;
+
+    // Statistics.
+    int downCount;
+    int thermalDownCount;
+    int upCount;
+    int revertedUpCount;
+};
+
+void initQualityGovernor(QualityGovernor* governor, double targetMs);
+
+// Use the thermal zone file (millidegrees Celsius) or find one in /sys/class/thermal (path: NULL).
+/* limit > 0 overrides the throttle point of the zone. Returns false if no zone can be read:
+ * the governor only uses the frame time. */
+bool qualityGovernorOpenThermal(QualityGovernor* governor, const char* path, double limit = 0.0);
+
+// Add a knob with its levels (best quality first), returns its index or -1 if there is no room.
+/* The labels (optional, one per level) must outlive the governor. The knob starts at level 0. */
+int qualityGovernorAddKnob(QualityGovernor* governor, const char* name, const int* values, int levelCount,
+                           const char* const* labels);
+
+// The value of the current level of the knob.
+int qualityKnobValue(const QualityGovernor* governor, int knob);
+
+// Feed the frame time of a frame (ms, values <= 0 are ignored) at the time "now" (seconds).
+/* Returns true if a knob changed (one step per call, the decision is printed). */
+bool qualityGovernorUpdate(QualityGovernor* governor, double now, double frameMs);
+
+// The current levels as "name label, name label, ..." (truncated to the buffer).
+void formatQualityLevels(const QualityGovernor* governor, char* buffer, int size);
+
+// Print the number of the steps and the final levels.
+void printQualityGovernorStats(const QualityGovernor* governor);
+
+#endif // GLES_COMMON_QUALITY_GOVERNOR_H
@@ -0,0 +1,402 @@
+/**
+ * Read back post-processing kernels. See readback_convert.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/readback_convert.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "common/job_system.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define READBACK_CONVERT_SSE2 1
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define READBACK_CONVERT_SSSE3 1
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define READBACK_CONVERT_NEON 1
+#endif
+
+int readbackLayoutSize(ReadbackLayout layout) {
+    return layout == READBACK_RGB8 || layout == READBACK_BGR8 ? 3 : 4;
+}
+
+// The scalar kernels: the reference results and the tails of the SIMD loops.
+/* Every kernel processes the elements [begin, count). */
+
+static void floatToUnormScalar(uint8_t* dst, const float* src, int begin, int count) {
+    for (int idx = begin; idx < count; idx++) {
+        // Same order and NaN handling as min/max of SSE: the second operand if the compare fails.
+        float value = src[idx] < 1.0f ? src[idx] : 1.0f;
+        value = value > 0.0f ? value : 0.0f;
+        dst[idx] = (uint8_t)lrintf(value * 255.0f);
+    }
+}
+
+static void premultiplyScalar(uint8_t* pixels, int begin, int count) {
+    for (int idx = begin; idx < count; idx++) {
+        uint8_t* px = pixels + idx * 4;
+        for (int channel = 0; channel < 3; channel++) {
+            // c * a / 255 rounded: exact for every 8 bit input.
+            unsigned value = px[channel] * px[3] + 128;
+            px[channel] = (uint8_t)((value + (value >> 8)) >> 8);
+        }
+    }
+}
+
+static void unpremultiplyScalar(uint8_t* pixels, int begin, int count) {
+    for (int idx = begin; idx < count; idx++) {
+        uint8_t* px = pixels + idx * 4;
+        unsigned alpha = px[3];
+        for (int channel = 0; channel < 3; channel++) {
+            unsigned value = alpha == 0 ? 0 : (px[channel] * 255 + alpha / 2) / alpha;
+            px[channel] = (uint8_t)std::min(value, 255u);
+        }
+    }
+}
+
+static void swizzleScalar(uint8_t* dst, const uint8_t* src, int begin, int count, ReadbackLayout layout) {
+    int size = readbackLayoutSize(layout);
+    bool swap = layout == READBACK_BGRA8 || layout == READBACK_BGR8;
+    for (int idx = begin; idx < count; idx++) {
+        const uint8_t* px = src + idx * 4;
+        uint8_t* out = dst + idx * size;
+        out[0] = px[swap ? 2 : 0];
+        out[1] = px[1];
+        out[2] = px[swap ? 0 : 2];
+        if (size == 4) {
+            out[3] = px[3];
+        }
+    }
+}
+
+// The SIMD kernels, each returns the number of processed elements: the scalar kernel does the rest.
+
+static int floatToUnormSIMD(uint8_t* dst, const float* src, int count) {
+    int idx = 0;
+#if READBACK_CONVERT_SSE2
+    /* cvtps rounds to nearest even with the default MXCSR, as lrintf with the default rounding mode. */
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 scale = _mm_set1_ps(255.0f);
+    for (; idx + 16 <= count; idx += 16) {
+        __m128i words[4];
+        for (int part = 0; part < 4; part++) {
+            __m128 value = _mm_max_ps(_mm_min_ps(_mm_loadu_ps(src + idx + part * 4), one), zero);
+            words[part] = _mm_cvtps_epi32(_mm_mul_ps(value, scale));
+        }
+        __m128i shorts = _mm_packs_epi32(words[0], words[1]);
+        __m128i shorts2 = _mm_packs_epi32(words[2], words[3]);
+        _mm_storeu_si128((__m128i*)(dst + idx), _mm_packus_epi16(shorts, shorts2));
+    }
+#elif READBACK_CONVERT_NEON
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    for (; idx + 8 <= count; idx += 8) {
+        float32x4_t low = vmaxq_f32(vminq_f32(vld1q_f32(src + idx), one), zero);
+        float32x4_t high = vmaxq_f32(vminq_f32(vld1q_f32(src + idx + 4), one), zero);
+        uint16x4_t lowWords = vmovn_u32(vcvtnq_u32_f32(vmulq_n_f32(low, 255.0f)));
+        uint16x4_t highWords = vmovn_u32(vcvtnq_u32_f32(vmulq_n_f32(high, 255.0f)));
+        vst1_u8(dst + idx, vmovn_u16(vcombine_u16(lowWords, highWords)));
+    }
+#else
+    (void)dst;
+    (void)src;
+    (void)count;
+#endif
+    return idx;
+}
+
+static int premultiplySIMD(uint8_t* pixels, int count) {
+    int idx = 0;
+#if READBACK_CONVERT_SSE2
+    // 4 pixels per iteration in 16 bit lanes, the alpha lanes are restored at the end.
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16(128);
+    const __m128i alphaMask = _mm_set1_epi32((int)0xff000000);
+    for (; idx + 4 <= count; idx += 4) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(pixels + idx * 4));
+        __m128i halves[2] = { _mm_unpacklo_epi8(px, zero), _mm_unpackhi_epi8(px, zero) };
+        for (int part = 0; part < 2; part++) {
+            __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(halves[part], 0xff), 0xff);
+            __m128i value = _mm_add_epi16(_mm_mullo_epi16(halves[part], alpha), half);
+            halves[part] = _mm_srli_epi16(_mm_add_epi16(value, _mm_srli_epi16(value, 8)), 8);
+        }
+        __m128i colors = _mm_packus_epi16(halves[0], halves[1]);
+        colors = _mm_or_si128(_mm_andnot_si128(alphaMask, colors), _mm_and_si128(alphaMask, px));
+        _mm_storeu_si128((__m128i*)(pixels + idx * 4), colors);
+    }
+#elif READBACK_CONVERT_NEON
+    // 16 pixels per iteration, de-interleaved: the alpha plane is stored as it was loaded.
+    for (; idx + 16 <= count; idx += 16) {
+        uint8x16x4_t px = vld4q_u8(pixels + idx * 4);
+        for (int channel = 0; channel < 3; channel++) {
+            uint16x8_t low = vmull_u8(vget_low_u8(px.val[channel]), vget_low_u8(px.val[3]));
+            uint16x8_t high = vmull_u8(vget_high_u8(px.val[channel]), vget_high_u8(px.val[3]));
+            // (u + 128 + ((u + 128) >> 8)) >> 8 == (u + ((u + 128) >> 8) + 128) >> 8
+            px.val[channel] = vcombine_u8(vraddhn_u16(low, vrshrq_n_u16(low, 8)),
+                                          vraddhn_u16(high, vrshrq_n_u16(high, 8)));
+        }
+        vst4q_u8(pixels + idx * 4, px);
+    }
+#else
+    (void)pixels;
+    (void)count;
+#endif
+    return idx;
+}
+
+static int unpremultiplySIMD(uint8_t* pixels, int count) {
+    int idx = 0;
+#if READBACK_CONVERT_SSE2
+    /* One pixel per 32 bit float vector: (c * 255 + a / 2) / a is below 2^17, the float division
+     * truncated is the integer division. Alpha 0 divides to inf/NaN, cvtt returns 0x80000000 for
+     * both and the signed packs saturate it to 0. */
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaMask = _mm_set1_epi32((int)0xff000000);
+    for (; idx + 4 <= count; idx += 4) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(pixels + idx * 4));
+        __m128i halves[2] = { _mm_unpacklo_epi8(px, zero), _mm_unpackhi_epi8(px, zero) };
+        __m128i words[4];
+        for (int part = 0; part < 4; part++) {
+            __m128i channels = part % 2 == 0 ? _mm_unpacklo_epi16(halves[part / 2], zero)
+                                             : _mm_unpackhi_epi16(halves[part / 2], zero);
+            __m128i alpha = _mm_shuffle_epi32(channels, 0xff);
+            __m128i value = _mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(channels, 8), channels),
+                                          _mm_srli_epi32(alpha, 1));
+            words[part] = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(value), _mm_cvtepi32_ps(alpha)));
+        }
+        __m128i colors = _mm_packus_epi16(_mm_packs_epi32(words[0], words[1]), _mm_packs_epi32(words[2], words[3]));
+        colors = _mm_or_si128(_mm_andnot_si128(alphaMask, colors), _mm_and_si128(alphaMask, px));
+        _mm_storeu_si128((__m128i*)(pixels + idx * 4), colors);
+    }
+#elif READBACK_CONVERT_NEON
+    // 8 pixels per iteration, the saturating narrows clamp to 255, alpha 0 is masked to 0.
+    for (; idx + 8 <= count; idx += 8) {
+        uint8x8x4_t px = vld4_u8(pixels + idx * 4);
+        uint16x8_t alpha = vmovl_u8(px.val[3]);
+        uint32x4_t alphas[2] = { vmovl_u16(vget_low_u16(alpha)), vmovl_u16(vget_high_u16(alpha)) };
+        uint8x8_t visible = vtst_u8(px.val[3], px.val[3]);
+        for (int channel = 0; channel < 3; channel++) {
+            uint16x8_t color = vmovl_u8(px.val[channel]);
+            uint16x4_t words[2];
+            for (int part = 0; part < 2; part++) {
+                uint16x4_t colors = part == 0 ? vget_low_u16(color) : vget_high_u16(color);
+                uint32x4_t value = vaddq_u32(vmull_n_u16(colors, 255), vshrq_n_u32(alphas[part], 1));
+                float32x4_t quotient = vdivq_f32(vcvtq_f32_u32(value), vcvtq_f32_u32(alphas[part]));
+                words[part] = vqmovn_u32(vcvtq_u32_f32(quotient));
+            }
+            px.val[channel] = vand_u8(vqmovn_u16(vcombine_u16(words[0], words[1])), visible);
+        }
+        vst4_u8(pixels + idx * 4, px);
+    }
+#else
+    (void)pixels;
+    (void)count;
+#endif
+    return idx;
+}
+
+static int swizzleSIMD(uint8_t* dst, const uint8_t* src, int count, ReadbackLayout layout) {
+    int idx = 0;
+#if READBACK_CONVERT_SSSE3
+    if (layout == READBACK_RGB8 || layout == READBACK_BGR8) {
+        // 4 pixels per shuffle, the 16 byte store overlaps the next 4 bytes: 2 pixels must follow the group.
+        const __m128i mask = layout == READBACK_RGB8
+            ? _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1)
+            : _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+        for (; idx + 6 <= count; idx += 4) {
+            __m128i pixels = _mm_loadu_si128((const __m128i*)(src + idx * 4));
+            _mm_storeu_si128((__m128i*)(dst + idx * 3), _mm_shuffle_epi8(pixels, mask));
+        }
+        return idx;
+    }
+#endif
+#if READBACK_CONVERT_SSE2
+    if (layout == READBACK_BGRA8) {
+        // Red and blue swap places within each 32 bit pixel.
+        const __m128i keep = _mm_set1_epi32((int)0xff00ff00);
+        const __m128i low = _mm_set1_epi32(0x000000ff);
+        const __m128i high = _mm_set1_epi32(0x00ff0000);
+        for (; idx + 4 <= count; idx += 4) {
+            __m128i px = _mm_loadu_si128((const __m128i*)(src + idx * 4));
+            __m128i swapped = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(px, 16), low),
+                                           _mm_and_si128(_mm_slli_epi32(px, 16), high));
+            _mm_storeu_si128((__m128i*)(dst + idx * 4), _mm_or_si128(_mm_and_si128(px, keep), swapped));
+        }
+        return idx;
+    }
+#elif READBACK_CONVERT_NEON
+    if (layout == READBACK_BGRA8 || layout == READBACK_RGB8 || layout == READBACK_BGR8) {
+        // 16 pixels per iteration: the de-interleaving load, the planes are stored in the new order.
+        for (; idx + 16 <= count; idx += 16) {
+            uint8x16x4_t px = vld4q_u8(src + idx * 4);
+            if (layout != READBACK_RGB8) {
+                uint8x16_t red = px.val[0];
+                px.val[0] = px.val[2];
+                px.val[2] = red;
+            }
+            if (layout == READBACK_BGRA8) {
+                vst4q_u8(dst + idx * 4, px);
+            } else {
+                uint8x16x3_t colors = { { px.val[0], px.val[1], px.val[2] } };
+                vst3q_u8(dst + idx * 3, colors);
+            }
+        }
+        return idx;
+    }
+#endif
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (layout == READBACK_RGB8 || layout == READBACK_BGR8) {
+        // 4 pixels as 4 words in, 3 words out.
+        for (; idx + 4 <= count; idx += 4) {
+            uint32_t in[4];
+            memcpy(in, src + idx * 4, sizeof(in));
+            if (layout == READBACK_BGR8) {
+                for (uint32_t& word : in) {
+                    word = (word & 0xff00ff00u) | ((word >> 16) & 0xffu) | ((word & 0xffu) << 16);
+                }
+            }
+            uint32_t out[3] = {
+                (in[0] & 0xffffff) | (in[1] << 24),
+                ((in[1] >> 8) & 0xffff) | (in[2] << 16),
+                ((in[2] >> 16) & 0xff) | (in[3] << 8),
+            };
+            memcpy(dst + idx * 3, out, sizeof(out));
+        }
+    }
+#endif
+    (void)dst;
+    (void)src;
+    (void)count;
+    (void)layout;
+    return idx;
+}
+
+// Convert the destination rows [rowBegin, rowEnd), "simd": the SIMD kernels before the scalar ones.
+/* A chunk of READBACK_CHUNK pixels is converted to RGBA8 in the stack buffer (when the source is
+ * float or the alpha changes), then swizzled into the destination row. */
+static void convertRows(const ReadbackConversion* conversion, uint8_t* dst, const void* src,
+                        int rowBegin, int rowEnd, bool simd) {
+    const int width = conversion->width;
+    const int pixelSize = readbackLayoutSize(conversion->layout);
+    const bool floats = conversion->source == READBACK_SOURCE_RGBA32F;
+    const size_t srcStride = conversion->srcStride > 0 ? (size_t)conversion->srcStride
+                                                        : (size_t)width * (floats ? 16 : 4);
+    const size_t dstStride = conversion->dstStride > 0 ? (size_t)conversion->dstStride : (size_t)width * pixelSize;
+    const bool copy = !floats && conversion->alpha == READBACK_ALPHA_KEEP && conversion->layout == READBACK_RGBA8;
+
+    uint8_t chunk[READBACK_CHUNK * 4];
+    for (int row = rowBegin; row < rowEnd; row++) {
+        int srcRow = conversion->flip ? conversion->height - 1 - row : row;
+        const uint8_t* srcLine = (const uint8_t*)src + srcRow * srcStride;
+        uint8_t* dstLine = dst + row * dstStride;
+        if (copy) {
+            memcpy(dstLine, srcLine, (size_t)width * 4);
+            continue;
+        }
+
+        for (int x = 0; x < width; x += READBACK_CHUNK) {
+            int count = std::min(READBACK_CHUNK, width - x);
+
+            // 1. The RGBA8 pixels: converted from float, copied if the alpha step changes them or read in place.
+            const uint8_t* rgba = srcLine + (size_t)x * 4;
+            if (floats) {
+                const float* values = (const float*)srcLine + (size_t)x * 4;
+                floatToUnormScalar(chunk, values, simd ? floatToUnormSIMD(chunk, values, count * 4) : 0, count * 4);
+                rgba = chunk;
+            } else if (conversion->alpha != READBACK_ALPHA_KEEP) {
+                memcpy(chunk, rgba, (size_t)count * 4);
+                rgba = chunk;
+            }
+
+            // 2. The alpha step in the chunk.
+            if (conversion->alpha == READBACK_ALPHA_PREMULTIPLY) {
+                premultiplyScalar(chunk, simd ? premultiplySIMD(chunk, count) : 0, count);
+            } else if (conversion->alpha == READBACK_ALPHA_UNPREMULTIPLY) {
+                unpremultiplyScalar(chunk, simd ? unpremultiplySIMD(chunk, count) : 0, count);
+            }
+
+            // 3. The layout of the destination.
+            uint8_t* out = dstLine + (size_t)x * pixelSize;
+            if (conversion->layout == READBACK_RGBA8) {
+                memcpy(out, rgba, (size_t)count * 4);
+            } else {
+                swizzleScalar(out, rgba, simd ? swizzleSIMD(out, rgba, count, conversion->layout) : 0, count,
+                              conversion->layout);
+            }
+        }
+    }
+}
+
+void convertReadbackRows(const ReadbackConversion* conversion, uint8_t* dst, const void* src, int rowBegin, int rowEnd) {
+    convertRows(conversion, dst, src, rowBegin, rowEnd, true);
+}
+
+void convertReadbackRowsScalar(const ReadbackConversion* conversion, uint8_t* dst, const void* src,
+                               int rowBegin, int rowEnd) {
+    convertRows(conversion, dst, src, rowBegin, rowEnd, false);
+}
+
+// The conversion of a job system loop, the jobs process ranges of destination rows.
+struct ReadbackJob {
+    const ReadbackConversion* conversion;
+    uint8_t* dst;
+    const void* src;
+};
+
+static void convertReadbackJob(void* data, int begin, int end) {
+    ReadbackJob* job = (ReadbackJob*)data;
+    convertReadbackRows(job->conversion, job->dst, job->src, begin, end);
+}
+
+void convertReadback(const ReadbackConversion* conversion, uint8_t* dst, const void* src, JobSystem* jobs) {
+    if (jobs == NULL) {
+        convertReadbackRows(conversion, dst, src, 0, conversion->height);
+        return;
+    }
+
+    // Rows per job: about 64 KiB of output.
+    int rowSize = conversion->width * readbackLayoutSize(conversion->layout);
+    int grain = rowSize > 0 ? 64 * 1024 / rowSize : 1;
+    ReadbackJob job = { conversion, dst, src };
+    jobSystemParallelFor(jobs, conversion->height, std::max(grain, 1), convertReadbackJob, &job);
+}
+
+const char* readbackConvertImplementation() {
+#if READBACK_CONVERT_SSSE3
+    return "SSSE3";
+#elif READBACK_CONVERT_SSE2
+    return "SSE2";
+#elif READBACK_CONVERT_NEON
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,107 @@
+/**
+ * Read back post-processing: glReadPixels rows into CPU images with SIMD kernels.
+ *
+ * A read back is R8G8B8A8 (or RGBA32F) with the bottom row first. The
+ * conversion writes it in the layout of the consumer in one pass per row:
+ *
+ *  * vertical flip: the source rows are read bottom to top,
+ *  * float -> unorm8: RGBA32F is clamped to [0, 1] and rounded to nearest even,
+ *  * premultiply (c * a / 255, rounded) or unpremultiply (c * 255 / a, rounded down),
+ *  * RGBA (copy), BGRA (red/blue swap), RGB or BGR (alpha stripped).
+ *
+ * The row is processed in chunks of READBACK_CHUNK pixels: the float
+ * conversion and the alpha step work on a small RGBA8 buffer which stays in
+ * the L1 cache, the swizzle writes the destination. The kernels use SSE2
+ * (SSSE3 for the swizzles when enabled) or NEON (AArch64), the results are bit
+ * identical to the scalar reference (convertReadbackRowsScalar; NaN floats
+ * excepted). The conversion works on row ranges, convertReadback splits an
+ * image into row bands on a job system (see common/job_system.h).
+ *
+ * Usage:
+ *
+ *   ReadbackConversion conversion = { width, height, READBACK_SOURCE_RGBA8, READBACK_RGB8,
+ *                                     READBACK_ALPHA_KEEP, true, 0, 0 };
+ *   const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, ...); // a PBO of the read back ring
+ *   convertReadback(&conversion, rgb, mapped, &jobs);                // top row first RGB
+ *
+ * Dependencies:
+ *  * C++11
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_READBACK_CONVERT_H
+#define GLES_COMMON_READBACK_CONVERT_H
+
+#include <stdint.h>
+
+struct JobSystem;
+
+// Pixels per conversion step of a row.
+#define READBACK_CHUNK 256
+
+// Pixels of the read back.
+enum ReadbackSource {
+    READBACK_SOURCE_RGBA8,   // GL_RGBA, GL_UNSIGNED_BYTE
+    READBACK_SOURCE_RGBA32F, // GL_RGBA, GL_FLOAT
+};
+
+// Pixel layout of the converted image.
+enum ReadbackLayout {
+    READBACK_RGBA8,
+    READBACK_BGRA8,
+    READBACK_RGB8,
+    READBACK_BGR8,
+};
+
+enum ReadbackAlpha {
+    READBACK_ALPHA_KEEP,
+    READBACK_ALPHA_PREMULTIPLY,
+    READBACK_ALPHA_UNPREMULTIPLY, // alpha 0: black
+};
+
+struct ReadbackConversion {
+    int width;
+    int height;
+    ReadbackSource source;
+    ReadbackLayout layout;
+    ReadbackAlpha alpha;
+    bool flip;     // the source is bottom row first (glReadPixels), the destination top row first
+    int srcStride; // bytes per source row, 0: tightly packed (GL_PACK_ALIGNMENT 4 is tight for RGBA)
+    int dstStride; // bytes per destination row, 0: tightly packed
+};
+
+// Bytes per pixel of a layout: 3 or 4.
+int readbackLayoutSize(ReadbackLayout layout);
+
+// Convert the destination rows [rowBegin, rowEnd).
+void convertReadbackRows(const ReadbackConversion* conversion, uint8_t* dst, const void* src, int rowBegin, int rowEnd);
+
+// The reference version of convertReadbackRows, one channel at a time.
+void convertReadbackRowsScalar(const ReadbackConversion* conversion, uint8_t* dst, const void* src, int rowBegin, int rowEnd);
+
+// Convert the whole image: row bands on the job system, or on the calling thread if "jobs" is NULL.
+void convertReadback(const ReadbackConversion* conversion, uint8_t* dst, const void* src, JobSystem* jobs);
+
+// Name of the kernels in use: "SSSE3", "SSE2", "NEON" or "scalar".
+const char* readbackConvertImplementation();
+
+#endif // GLES_COMMON_READBACK_CONVERT_H
@@ -0,0 +1,168 @@
+/**
+ * Table of the sized render target formats. See render_formats.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/render_formats.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <GLES3/gl3.h>
+
+static const RenderFormat formats[] = {
+    { "RGBA8",              GL_RGBA8,              false, 4, NULL },
+    { "RGB8",               GL_RGB8,               false, 3, NULL },
+    { "RGB565",             GL_RGB565,             false, 2, NULL },
+    { "RGB10_A2",           GL_RGB10_A2,           false, 4, NULL },
+    { "R11F_G11F_B10F",     GL_R11F_G11F_B10F,     false, 4, "GL_EXT_color_buffer_float" },
+    { "RGBA16F",            GL_RGBA16F,            false, 8, "GL_EXT_color_buffer_float|GL_EXT_color_buffer_half_float" },
+    { "R16F",               GL_R16F,               false, 2, "GL_EXT_color_buffer_float|GL_EXT_color_buffer_half_float" },
+    { "R8",                 GL_R8,                 false, 1, NULL },
+    { "RG8",                GL_RG8,                false, 2, NULL },
+    { "DEPTH_COMPONENT16",  GL_DEPTH_COMPONENT16,  true,  2, NULL },
+    { "DEPTH_COMPONENT24",  GL_DEPTH_COMPONENT24,  true,  4, NULL },
+    { "DEPTH_COMPONENT32F", GL_DEPTH_COMPONENT32F, true,  4, NULL },
+    { "DEPTH24_STENCIL8",   GL_DEPTH24_STENCIL8,   true,  4, NULL },
+    { "DEPTH32F_STENCIL8",  GL_DEPTH32F_STENCIL8,  true,  8, NULL },
+};
+
+static const int formatCount = sizeof(formats) / sizeof(formats[0]);
+
+// Probe results per format and kind: 0: not probed, 1: supported, -1: not supported.
+static int probed[sizeof(formats) / sizeof(formats[0])][2];
+
+static bool hasAnyExtension(const char* names) {
+    const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+    if (extensions == NULL) {
+        return false;
+    }
+
+    const char* name = names;
+    while (*name != '\0') {
+        const char* end = strchr(name, '|');
+        size_t length = end ? (size_t)(end - name) : strlen(name);
+
+        for (const char* ptr = strstr(extensions, name); ptr != NULL; ptr = strstr(ptr + 1, name)) {
+            if (strncmp(ptr, name, length) == 0 && (ptr[length] == ' ' || ptr[length] == '\0')) {
+                return true;
+            }
+        }
+
+        name += length + (end ? 1 : 0);
+    }
+    return false;
+}
+
+const RenderFormat* renderFormats(int* count) {
+    *count = formatCount;
+    return formats;
+}
+
+const RenderFormat* findRenderFormat(const char* name) {
+    for (int idx = 0; idx < formatCount; idx++) {
+        if (strcmp(formats[idx].name, name) == 0) {
+            return &formats[idx];
+        }
+    }
+    return NULL;
+}
+
+const RenderFormat* findRenderFormat(unsigned int format) {
+    for (int idx = 0; idx < formatCount; idx++) {
+        if (formats[idx].format == format) {
+            return &formats[idx];
+        }
+    }
+    return NULL;
+}
+
+static bool probeFormat(const RenderFormat* format, RenderTargetKind kind) {
+    // 1. Formats which need an extension are not even tried without it.
+    if (format->extensions != NULL && !hasAnyExtension(format->extensions)) {
+        return false;
+    }
+
+    // 2. Create a small attachment and check the FBO completeness.
+    /* Errors in the probing (ex.: unsupported renderbuffer formats) are consumed. */
+    GLint previousFbo;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFbo);
+
+    unsigned int fbo;
+    unsigned int object;
+    GLenum attachment = format->depth ? GL_DEPTH_ATTACHMENT : GL_COLOR_ATTACHMENT0;
+    if (format->format == GL_DEPTH24_STENCIL8 || format->format == GL_DEPTH32F_STENCIL8) {
+        attachment = GL_DEPTH_STENCIL_ATTACHMENT;
+    }
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    if (kind == RENDER_TARGET_TEXTURE) {
+        glGenTextures(1, &object);
+        glBindTexture(GL_TEXTURE_2D, object);
+        glTexStorage2D(GL_TEXTURE_2D, 1, format->format, 4, 4);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, object, 0);
+    } else {
+        glGenRenderbuffers(1, &object);
+        glBindRenderbuffer(GL_RENDERBUFFER, object);
+        glRenderbufferStorage(GL_RENDERBUFFER, format->format, 4, 4);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, object);
+    }
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    bool error = glGetError() != GL_NO_ERROR;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+    glDeleteFramebuffers(1, &fbo);
+    if (kind == RENDER_TARGET_TEXTURE) {
+        glDeleteTextures(1, &object);
+    } else {
+        glDeleteRenderbuffers(1, &object);
+    }
+
+    return complete && !error;
+}
+
+bool renderFormatSupported(const RenderFormat* format, RenderTargetKind kind) {
+    int idx = (int)(format - formats);
+    if (idx < 0 || idx >= formatCount) {
+        return false;
+    }
+
+    if (probed[idx][kind] == 0) {
+        probed[idx][kind] = probeFormat(format, kind) ? 1 : -1;
+    }
+    return probed[idx][kind] > 0;
+}
+
+void printRenderFormats() {
+    printf("Render target formats (texture/renderbuffer):\n");
+    for (int idx = 0; idx < formatCount; idx++) {
+        const RenderFormat* format = &formats[idx];
+        printf("  %-20s %d B/pixel  %-3s %-3s%s%s\n", format->name, format->bytesPerPixel,
+               renderFormatSupported(format, RENDER_TARGET_TEXTURE) ? "yes" : "no",
+               renderFormatSupported(format, RENDER_TARGET_RENDERBUFFER) ? "yes" : "no",
+               format->extensions ? "  requires: " : "", format->extensions ? format->extensions : "");
+    }
+}
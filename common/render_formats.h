@@ -0,0 +1,61 @@
+/**
+ * Table of the sized render target formats with capability probing.
+ *
+ * ES 3.0 requires only a subset of the sized formats to be color renderable:
+ * GL_R11F_G11F_B10F and GL_RGBA16F need EXT_color_buffer_float (or
+ * EXT_color_buffer_half_float), the others in the table are core formats.
+ * Whether a format really works as a texture or renderbuffer attachment is
+ * probed once by checking the completeness of a small FBO.
+ *
+ * The formats are named as the GL enums without the "GL_" prefix
+ * (ex.: "RGB565", "DEPTH_COMPONENT24").
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_RENDER_FORMATS_H
+#define GLES_COMMON_RENDER_FORMATS_H
+
+#include "common/render_target_pool.h"
+
+struct RenderFormat {
+    const char* name;
+    unsigned int format;    // sized internal format
+    bool depth;             // depth (stencil) format
+    int bytesPerPixel;      // storage size (the usual padding included)
+    const char* extensions; // required for rendering ("|" separated alternatives), NULL: core
+};
+
+// The table of the known formats.
+const RenderFormat* renderFormats(int* count);
+
+// Look up a format by name or by internal format (NULL if unknown).
+const RenderFormat* findRenderFormat(const char* name);
+const RenderFormat* findRenderFormat(unsigned int format);
+
+// Check (once, the result is cached) if the format can be rendered into as a texture or a renderbuffer.
+/* Requires a current GL ES context. */
+bool renderFormatSupported(const RenderFormat* format, RenderTargetKind kind);
+
+// Print the table with the probed texture/renderbuffer support.
+void printRenderFormats();
+
+#endif // GLES_COMMON_RENDER_FORMATS_H
@@ -0,0 +1,393 @@
+/**
+ * Render graph: pass culling, barrier placement and transient texture aliasing.
+ * See render_graph.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/render_graph.h"
+
+#include <stdio.h>
+
+#include <GLES3/gl31.h>
+
+static bool isWrite(RenderGraphAccess access) {
+    return access == RENDER_GRAPH_IMAGE_WRITE || access == RENDER_GRAPH_STORAGE_WRITE
+        || access == RENDER_GRAPH_ATTACHMENT_WRITE || access == RENDER_GRAPH_TEXTURE_UPLOAD;
+}
+
+// Writes which are only visible to the later commands after a matching glMemoryBarrier.
+static bool isIncoherentWrite(RenderGraphAccess access) {
+    return access == RENDER_GRAPH_IMAGE_WRITE || access == RENDER_GRAPH_STORAGE_WRITE;
+}
+
+unsigned int renderGraphAccessBarrier(RenderGraphAccess access) {
+    switch (access) {
+        case RENDER_GRAPH_SAMPLE: return GL_TEXTURE_FETCH_BARRIER_BIT;
+        case RENDER_GRAPH_IMAGE_READ: return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+        case RENDER_GRAPH_IMAGE_WRITE: return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+        case RENDER_GRAPH_STORAGE_READ: return GL_SHADER_STORAGE_BARRIER_BIT;
+        case RENDER_GRAPH_STORAGE_WRITE: return GL_SHADER_STORAGE_BARRIER_BIT;
+        case RENDER_GRAPH_VERTEX_READ: return GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT;
+        case RENDER_GRAPH_INDEX_READ: return GL_ELEMENT_ARRAY_BARRIER_BIT;
+        case RENDER_GRAPH_INDIRECT_READ: return GL_COMMAND_BARRIER_BIT;
+        case RENDER_GRAPH_UNIFORM_READ: return GL_UNIFORM_BARRIER_BIT;
+        case RENDER_GRAPH_BUFFER_READ: return GL_BUFFER_UPDATE_BARRIER_BIT;
+        case RENDER_GRAPH_ATTACHMENT_READ: return GL_FRAMEBUFFER_BARRIER_BIT;
+        case RENDER_GRAPH_ATTACHMENT_WRITE: return GL_FRAMEBUFFER_BARRIER_BIT;
+        case RENDER_GRAPH_TEXTURE_UPLOAD: return GL_TEXTURE_UPDATE_BARRIER_BIT;
+    }
+    return GL_ALL_BARRIER_BITS;
+}
+
+static int64_t transientBytes(const RenderGraphResource& resource) {
+    int samples = resource.key.samples > 0 ? resource.key.samples : 1;
+    return (int64_t)resource.key.width * resource.key.height * samples * renderTargetBytesPerPixel(resource.key.format);
+}
+
+static int addResource(RenderGraph* graph, const char* name, bool transient, unsigned int object) {
+    RenderGraphResource resource;
+    resource.name = name;
+    resource.transient = transient;
+    resource.exported = false;
+    resource.key.kind = RENDER_TARGET_TEXTURE;
+    resource.key.format = 0;
+    resource.key.width = 0;
+    resource.key.height = 0;
+    resource.key.samples = 0;
+    resource.object = object;
+    resource.target = NULL;
+    resource.firstPass = -1;
+    resource.lastPass = -1;
+
+    graph->resources.push_back(resource);
+    graph->compiled = false;
+    return (int)graph->resources.size() - 1;
+}
+
+static void releaseTransients(RenderGraph* graph) {
+    for (size_t idx = 0; idx < graph->resources.size(); idx++) {
+        RenderGraphResource& resource = graph->resources[idx];
+        if (resource.target != NULL) {
+            releaseRenderTarget(graph->pool, resource.target);
+            resource.target = NULL;
+        }
+    }
+}
+
+void initRenderGraph(RenderGraph* graph, RenderTargetPool* pool) {
+    graph->pool = pool;
+    graph->resources.clear();
+    graph->passes.clear();
+    graph->compiled = false;
+
+    graph->culledPasses = 0;
+    graph->barriers = 0;
+    graph->writerBarriers = 0;
+    graph->transientCount = 0;
+    graph->peakTransients = 0;
+    graph->transientMemory = 0;
+    graph->peakTransientMemory = 0;
+}
+
+void destroyRenderGraph(RenderGraph* graph) {
+    renderGraphReset(graph);
+}
+
+void renderGraphReset(RenderGraph* graph) {
+    releaseTransients(graph);
+    graph->resources.clear();
+    graph->passes.clear();
+    graph->compiled = false;
+}
+
+int renderGraphCreateTexture(RenderGraph* graph, const char* name, const RenderTargetKey& key) {
+    int resource = addResource(graph, name, true, 0);
+    graph->resources[resource].key = key;
+    return resource;
+}
+
+int renderGraphImportTexture(RenderGraph* graph, const char* name, unsigned int texture) {
+    return addResource(graph, name, false, texture);
+}
+
+int renderGraphImportBuffer(RenderGraph* graph, const char* name, unsigned int buffer) {
+    return addResource(graph, name, false, buffer);
+}
+
+int renderGraphImportFramebuffer(RenderGraph* graph, const char* name, unsigned int fbo) {
+    return addResource(graph, name, false, fbo);
+}
+
+void renderGraphExport(RenderGraph* graph, int resource) {
+    graph->resources[resource].exported = true;
+    graph->compiled = false;
+}
+
+int renderGraphAddPass(RenderGraph* graph, const char* name, RenderGraphExecuteFn execute, void* userData) {
+    RenderGraphPass pass;
+    pass.name = name;
+    pass.execute = execute;
+    pass.userData = userData;
+    pass.sideEffect = false;
+    pass.culled = false;
+    pass.barrier = 0;
+
+    graph->passes.push_back(pass);
+    graph->compiled = false;
+    return (int)graph->passes.size() - 1;
+}
+
+void renderGraphUse(RenderGraph* graph, int pass, int resource, RenderGraphAccess access) {
+    RenderGraphUse use = { resource, access };
+    graph->passes[pass].uses.push_back(use);
+    graph->compiled = false;
+}
+
+void renderGraphSideEffect(RenderGraph* graph, int pass) {
+    graph->passes[pass].sideEffect = true;
+    graph->compiled = false;
+}
+
+void renderGraphCompile(RenderGraph* graph) {
+    std::vector<RenderGraphResource>& resources = graph->resources;
+    std::vector<RenderGraphPass>& passes = graph->passes;
+
+    // 1. Culling: walk backwards from the results (imported, exported resources and the side effects).
+    /* A resource is needed if a kept pass after the current one reads it. */
+    std::vector<bool> needed(resources.size());
+    for (size_t idx = 0; idx < resources.size(); idx++) {
+        needed[idx] = !resources[idx].transient || resources[idx].exported;
+    }
+
+    graph->culledPasses = 0;
+    for (int passIdx = (int)passes.size() - 1; passIdx >= 0; passIdx--) {
+        RenderGraphPass& pass = passes[passIdx];
+
+        bool keep = pass.sideEffect;
+        for (size_t idx = 0; idx < pass.uses.size(); idx++) {
+            keep = keep || (isWrite(pass.uses[idx].access) && needed[pass.uses[idx].resource]);
+        }
+
+        pass.culled = !keep;
+        if (!keep) {
+            graph->culledPasses++;
+            continue;
+        }
+
+        for (size_t idx = 0; idx < pass.uses.size(); idx++) {
+            if (!isWrite(pass.uses[idx].access)) {
+                needed[pass.uses[idx].resource] = true;
+            }
+        }
+    }
+
+    // 2. Lifetimes and barriers of the kept passes in execution order.
+    /* pendingWrite: the resource has incoherent writes, visibleBits: the barriers issued since then. */
+    std::vector<bool> pendingWrite(resources.size(), false);
+    std::vector<unsigned int> visibleBits(resources.size(), 0);
+    for (size_t idx = 0; idx < resources.size(); idx++) {
+        resources[idx].firstPass = -1;
+        resources[idx].lastPass = -1;
+    }
+
+    graph->barriers = 0;
+    graph->writerBarriers = 0;
+    for (int passIdx = 0; passIdx < (int)passes.size(); passIdx++) {
+        RenderGraphPass& pass = passes[passIdx];
+        pass.barrier = 0;
+        if (pass.culled) {
+            continue;
+        }
+
+        // 2.1. The bits which the accesses of the pass need and which were not issued since the writes.
+        bool writesIncoherent = false;
+        for (size_t idx = 0; idx < pass.uses.size(); idx++) {
+            const RenderGraphUse& use = pass.uses[idx];
+            unsigned int bit = renderGraphAccessBarrier(use.access);
+            if (pendingWrite[use.resource] && (visibleBits[use.resource] & bit) == 0) {
+                pass.barrier |= bit;
+            }
+            writesIncoherent = writesIncoherent || isIncoherentWrite(use.access);
+
+            RenderGraphResource& resource = resources[use.resource];
+            resource.firstPass = resource.firstPass < 0 ? passIdx : resource.firstPass;
+            resource.lastPass = passIdx;
+        }
+
+        // 2.2. One barrier makes every pending write visible to the issued access types.
+        if (pass.barrier != 0) {
+            graph->barriers++;
+            for (size_t idx = 0; idx < resources.size(); idx++) {
+                visibleBits[idx] |= pendingWrite[idx] ? pass.barrier : 0;
+            }
+        }
+
+        // 2.3. The writes of the pass are not visible to anything yet.
+        for (size_t idx = 0; idx < pass.uses.size(); idx++) {
+            if (isIncoherentWrite(pass.uses[idx].access)) {
+                pendingWrite[pass.uses[idx].resource] = true;
+                visibleBits[pass.uses[idx].resource] = 0;
+            }
+        }
+        graph->writerBarriers += writesIncoherent ? 1 : 0;
+    }
+
+    // 3. Aliasing statistics: the transient textures alive at the same time.
+    graph->transientCount = 0;
+    graph->transientMemory = 0;
+    graph->peakTransients = 0;
+    graph->peakTransientMemory = 0;
+    for (size_t idx = 0; idx < resources.size(); idx++) {
+        if (resources[idx].transient && resources[idx].firstPass >= 0) {
+            graph->transientCount++;
+            graph->transientMemory += transientBytes(resources[idx]);
+        }
+    }
+    for (int passIdx = 0; passIdx < (int)passes.size(); passIdx++) {
+        int alive = 0;
+        int64_t memory = 0;
+        for (size_t idx = 0; idx < resources.size(); idx++) {
+            const RenderGraphResource& resource = resources[idx];
+            if (resource.transient && resource.firstPass >= 0 && resource.firstPass <= passIdx
+                && (resource.lastPass >= passIdx || resource.exported)) {
+                alive++;
+                memory += transientBytes(resource);
+            }
+        }
+        graph->peakTransients = alive > graph->peakTransients ? alive : graph->peakTransients;
+        graph->peakTransientMemory = memory > graph->peakTransientMemory ? memory : graph->peakTransientMemory;
+    }
+
+    graph->compiled = true;
+}
+
+bool renderGraphExecute(RenderGraph* graph) {
+    if (!graph->compiled) {
+        renderGraphCompile(graph);
+    }
+
+    for (int passIdx = 0; passIdx < (int)graph->passes.size(); passIdx++) {
+        RenderGraphPass& pass = graph->passes[passIdx];
+        if (pass.culled) {
+            continue;
+        }
+
+        // 1. Acquire the transient textures first used by the pass.
+        for (size_t idx = 0; idx < pass.uses.size(); idx++) {
+            RenderGraphResource& resource = graph->resources[pass.uses[idx].resource];
+            if (!resource.transient || resource.firstPass != passIdx || resource.target != NULL) {
+                continue;
+            }
+
+            resource.target = acquireRenderTarget(graph->pool, resource.key);
+            if (resource.target == NULL) {
+                printf("Render graph: unable to create the transient '%s' of pass '%s'\n", resource.name, pass.name);
+                return false;
+            }
+        }
+
+        // 2. Run the pass after its barrier.
+        if (pass.barrier != 0) {
+            glMemoryBarrier(pass.barrier);
+        }
+        pass.execute(graph, passIdx, pass.userData);
+
+        // 3. Give back the transient textures last used by the pass, the next passes can reuse them.
+        for (size_t idx = 0; idx < pass.uses.size(); idx++) {
+            RenderGraphResource& resource = graph->resources[pass.uses[idx].resource];
+            if (resource.target != NULL && resource.lastPass == passIdx && !resource.exported) {
+                releaseRenderTarget(graph->pool, resource.target);
+                resource.target = NULL;
+            }
+        }
+    }
+
+    return true;
+}
+
+unsigned int renderGraphTexture(const RenderGraph* graph, int resource) {
+    const RenderGraphResource& res = graph->resources[resource];
+    if (res.transient) {
+        return res.target != NULL ? res.target->texture : 0;
+    }
+    return res.object;
+}
+
+unsigned int renderGraphObject(const RenderGraph* graph, int resource) {
+    return renderGraphTexture(graph, resource);
+}
+
+unsigned int renderGraphFramebuffer(const RenderGraph* graph, int resource) {
+    const RenderGraphResource& res = graph->resources[resource];
+    if (res.transient) {
+        return res.target != NULL ? res.target->fbo : 0;
+    }
+    return res.object;
+}
+
+static void printBarrierBits(unsigned int bits) {
+    static const struct {
+        unsigned int bit;
+        const char* name;
+    } names[] = {
+        { GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT, "vertex" },
+        { GL_ELEMENT_ARRAY_BARRIER_BIT, "index" },
+        { GL_UNIFORM_BARRIER_BIT, "uniform" },
+        { GL_TEXTURE_FETCH_BARRIER_BIT, "texture fetch" },
+        { GL_SHADER_IMAGE_ACCESS_BARRIER_BIT, "image" },
+        { GL_COMMAND_BARRIER_BIT, "command" },
+        { GL_PIXEL_BUFFER_BARRIER_BIT, "pixel buffer" },
+        { GL_TEXTURE_UPDATE_BARRIER_BIT, "texture update" },
+        { GL_BUFFER_UPDATE_BARRIER_BIT, "buffer update" },
+        { GL_FRAMEBUFFER_BARRIER_BIT, "framebuffer" },
+        { GL_SHADER_STORAGE_BARRIER_BIT, "storage" },
+    };
+
+    const char* separator = "";
+    for (size_t idx = 0; idx < sizeof(names) / sizeof(names[0]); idx++) {
+        if (bits & names[idx].bit) {
+            printf("%s%s", separator, names[idx].name);
+            separator = " | ";
+        }
+    }
+}
+
+void printRenderGraph(const RenderGraph* graph) {
+    printf("Render graph: %d passes (%d culled), %d barriers (%d with a barrier after every writer)\n",
+           (int)graph->passes.size(), graph->culledPasses, graph->barriers, graph->writerBarriers);
+
+    for (size_t passIdx = 0; passIdx < graph->passes.size(); passIdx++) {
+        const RenderGraphPass& pass = graph->passes[passIdx];
+        printf("  %2d. %s", (int)passIdx, pass.name);
+        if (pass.culled) {
+            printf(" (culled)");
+        } else if (pass.barrier != 0) {
+            printf(" after barrier: ");
+            printBarrierBits(pass.barrier);
+        }
+        printf("\n");
+    }
+
+    printf("  transient textures: %d (%.1f MB), at most %d alive (%.1f MB)\n",
+           graph->transientCount, graph->transientMemory / (1024.0 * 1024.0),
+           graph->peakTransients, graph->peakTransientMemory / (1024.0 * 1024.0));
+}
@@ -0,0 +1,186 @@
+/**
+ * Render graph: passes declare the resources they read and write, the graph
+ * culls the unused passes, inserts the memory barriers and aliases the
+ * transient textures.
+ *
+ * The passes are added in execution order, so the order of the declarations
+ * is the order of the dependencies (a read sees the last write declared
+ * before it). renderGraphCompile then:
+ *
+ *  * culls the passes whose results are never used: a pass is kept if it
+ *    has a side effect (ex.: a read back to the CPU), writes an imported or
+ *    exported resource or writes a resource read by a kept pass,
+ *  * computes the lifetime (first and last kept pass) of every resource,
+ *  * computes the glMemoryBarrier bits of every pass. Only the incoherent
+ *    writes (image stores, storage buffer writes) need a barrier and only
+ *    for the access types which did not see them yet, so every barrier is
+ *    issued once with the merged bits of the pass (see renderGraphAccessBarrier).
+ *
+ * renderGraphExecute acquires the transient textures from a render target
+ * pool before their first pass and releases them after their last pass: two
+ * transients whose lifetimes don't overlap share the same texture (a chain
+ * of N passes only needs 2 textures).
+ *
+ * Usage (every frame):
+ *
+ *   renderGraphReset(&graph);
+ *   int source = renderGraphImportTexture(&graph, "source", texture);
+ *   int blurred = renderGraphCreateTexture(&graph, "blurred", key);
+ *   int pass = renderGraphAddPass(&graph, "blur", executeBlur, &blurData);
+ *   renderGraphUse(&graph, pass, source, RENDER_GRAPH_IMAGE_READ);
+ *   renderGraphUse(&graph, pass, blurred, RENDER_GRAPH_IMAGE_WRITE);
+ *   ...
+ *   renderGraphCompile(&graph);
+ *   renderGraphExecute(&graph); // calls executeBlur(&graph, pass, &blurData)
+ *
+ * The execute callbacks issue their GL commands right away (the barriers are
+ * issued between the callbacks) and get the GL objects with
+ * renderGraphTexture/renderGraphObject/renderGraphFramebuffer.
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.1+ (glMemoryBarrier)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_RENDER_GRAPH_H
+#define GLES_COMMON_RENDER_GRAPH_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "common/render_target_pool.h"
+
+// How a pass accesses a resource.
+enum RenderGraphAccess {
+    RENDER_GRAPH_SAMPLE,           // texture fetch
+    RENDER_GRAPH_IMAGE_READ,       // imageLoad
+    RENDER_GRAPH_IMAGE_WRITE,      // imageStore (incoherent)
+    RENDER_GRAPH_STORAGE_READ,     // shader storage buffer read
+    RENDER_GRAPH_STORAGE_WRITE,    // shader storage buffer write (incoherent)
+    RENDER_GRAPH_VERTEX_READ,      // vertex attributes
+    RENDER_GRAPH_INDEX_READ,       // index buffer
+    RENDER_GRAPH_INDIRECT_READ,    // draw/dispatch indirect commands
+    RENDER_GRAPH_UNIFORM_READ,     // uniform buffer
+    RENDER_GRAPH_BUFFER_READ,      // buffer copy, map or read back
+    RENDER_GRAPH_ATTACHMENT_READ,  // framebuffer attachment load, blend, glReadPixels or blit source
+    RENDER_GRAPH_ATTACHMENT_WRITE, // framebuffer attachment (render target)
+    RENDER_GRAPH_TEXTURE_UPLOAD,   // glTexSubImage2D and friends
+};
+
+typedef void (*RenderGraphExecuteFn)(struct RenderGraph* graph, int pass, void* userData);
+
+struct RenderGraphResource {
+    const char* name;
+    bool transient;       // texture acquired from the pool, only valid during its lifetime
+    bool exported;        // the contents are used after the graph (it stays acquired until the reset)
+    RenderTargetKey key;  // transient textures
+    unsigned int object;  // imported texture, buffer or framebuffer (0: the window framebuffer)
+    RenderTarget* target; // transient: the pooled target during the execution
+
+    // Compile results.
+    int firstPass; // -1: not used by any kept pass
+    int lastPass;
+};
+
+struct RenderGraphUse {
+    int resource;
+    RenderGraphAccess access;
+};
+
+struct RenderGraphPass {
+    const char* name;
+    RenderGraphExecuteFn execute;
+    void* userData;
+    std::vector<RenderGraphUse> uses;
+    bool sideEffect;
+
+    // Compile results.
+    bool culled;
+    unsigned int barrier; // glMemoryBarrier bits issued before the pass (0: none)
+};
+
+struct RenderGraph {
+    RenderTargetPool* pool;
+    std::vector<RenderGraphResource> resources;
+    std::vector<RenderGraphPass> passes;
+    bool compiled;
+
+    // Statistics of the last compile/execute.
+    int culledPasses;
+    int barriers;        // glMemoryBarrier calls
+    int writerBarriers;  // glMemoryBarrier calls of a barrier after every incoherent writer pass
+    int transientCount;
+    int peakTransients;  // the most transient textures alive at the same time
+    int64_t transientMemory;
+    int64_t peakTransientMemory;
+};
+
+void initRenderGraph(RenderGraph* graph, RenderTargetPool* pool);
+
+// Release the transient textures (exported ones too).
+void destroyRenderGraph(RenderGraph* graph);
+
+// Release the transient textures and remove the passes and resources, for the next frame.
+void renderGraphReset(RenderGraph* graph);
+
+// Texture from the pool, alive from its first to its last pass.
+int renderGraphCreateTexture(RenderGraph* graph, const char* name, const RenderTargetKey& key);
+
+// Existing GL objects, their contents are used outside of the graph (the passes writing them are kept).
+int renderGraphImportTexture(RenderGraph* graph, const char* name, unsigned int texture);
+int renderGraphImportBuffer(RenderGraph* graph, const char* name, unsigned int buffer);
+int renderGraphImportFramebuffer(RenderGraph* graph, const char* name, unsigned int fbo);
+
+// The contents of the resource are used after the execution (keeps its writers and its texture).
+void renderGraphExport(RenderGraph* graph, int resource);
+
+// Add a pass, returns its index.
+int renderGraphAddPass(RenderGraph* graph, const char* name, RenderGraphExecuteFn execute, void* userData);
+
+// Declare an access of the pass (a pass can use a resource more than once, ex.: read and write).
+void renderGraphUse(RenderGraph* graph, int pass, int resource, RenderGraphAccess access);
+
+// Keep the pass even if nothing reads its results (ex.: it reads back to the CPU).
+void renderGraphSideEffect(RenderGraph* graph, int pass);
+
+// Cull the passes, compute the lifetimes and the barriers.
+void renderGraphCompile(RenderGraph* graph);
+
+// Run the kept passes with their barriers (compiles first if needed).
+/* Returns false if a transient texture can't be created (the remaining passes are skipped). */
+bool renderGraphExecute(RenderGraph* graph);
+
+// The GL objects of a resource (transient: only valid during its lifetime).
+unsigned int renderGraphTexture(const RenderGraph* graph, int resource);
+unsigned int renderGraphObject(const RenderGraph* graph, int resource);
+// Framebuffer of a transient texture (its only attachment) or the imported framebuffer.
+unsigned int renderGraphFramebuffer(const RenderGraph* graph, int resource);
+
+// The glMemoryBarrier bit which makes incoherent writes visible to an access.
+unsigned int renderGraphAccessBarrier(RenderGraphAccess access);
+
+// Print the passes (with their barriers and culling) and the statistics.
+void printRenderGraph(const RenderGraph* graph);
+
+#endif // GLES_COMMON_RENDER_GRAPH_H
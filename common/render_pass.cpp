@@ -0,0 +1,308 @@
+/**
+ * Render passes with load/store actions. See render_pass.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/render_pass.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <GLES3/gl3.h>
+
+// Collect the attachment names for glInvalidateFramebuffer (the window framebuffer uses different names).
+static int collectAttachments(const RenderPass* pass, bool colorSelected, bool depthSelected, GLenum* attachments) {
+    int count = 0;
+    if (colorSelected && pass->color.bytesPerPixel > 0) {
+        attachments[count++] = pass->fbo == 0 ? GL_COLOR : GL_COLOR_ATTACHMENT0;
+    }
+    if (depthSelected && pass->depth.bytesPerPixel > 0) {
+        /* Attachments which are not present in the framebuffer are ignored. */
+        attachments[count++] = pass->fbo == 0 ? GL_DEPTH : GL_DEPTH_ATTACHMENT;
+        attachments[count++] = pass->fbo == 0 ? GL_STENCIL : GL_STENCIL_ATTACHMENT;
+    }
+    return count;
+}
+
+// The tracked attachments of a clear/coverage mask (the stencil goes with the depth).
+static unsigned int attachmentMask(const RenderPass* pass, unsigned int mask) {
+    unsigned int attachments = 0;
+    if ((mask & GL_COLOR_BUFFER_BIT) && pass->color.bytesPerPixel > 0) {
+        attachments |= GL_COLOR_BUFFER_BIT;
+    }
+    if ((mask & (GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT)) && pass->depth.bytesPerPixel > 0) {
+        attachments |= GL_DEPTH_BUFFER_BIT;
+    }
+    return attachments;
+}
+
+static int attachmentCount(unsigned int attachments) {
+    return ((attachments & GL_COLOR_BUFFER_BIT) ? 1 : 0) + ((attachments & GL_DEPTH_BUFFER_BIT) ? 1 : 0);
+}
+
+static int64_t clearBytes(const RenderPass* pass, unsigned int attachments, const RenderPassRect& rect) {
+    int64_t area = (int64_t)rect.width * rect.height;
+    int64_t bytes = 0;
+    if (attachments & GL_COLOR_BUFFER_BIT) {
+        bytes += area * pass->color.bytesPerPixel;
+    }
+    if (attachments & GL_DEPTH_BUFFER_BIT) {
+        bytes += area * pass->depth.bytesPerPixel;
+    }
+    return bytes;
+}
+
+// Record the next clear of the execution, returns the attachments which don't have to be cleared.
+static unsigned int trackClear(RenderPass* pass, unsigned int mask, int x, int y, int width, int height) {
+    if (pass->clearCount >= RENDER_PASS_MAX_CLEARS) {
+        return 0;
+    }
+
+    unsigned int attachments = attachmentMask(pass, mask);
+    RenderPassClear& clear = pass->clears[pass->clearCount++];
+
+    /* Same clear as in the previous execution: its coverage is known. */
+    bool sameClear = clear.mask == attachments && clear.rect.x == x && clear.rect.y == y
+                     && clear.rect.width == width && clear.rect.height == height;
+    unsigned int skipped = (sameClear && pass->skipRedundantClears) ? clear.redundantMask : 0;
+
+    clear.rect = { x, y, width, height };
+    clear.mask = attachments;
+    clear.pendingMask = attachments;
+    if (!sameClear) {
+        clear.redundantMask = 0;
+    }
+
+    pass->issuedClears += attachmentCount(attachments & ~skipped);
+    pass->skippedClears += attachmentCount(skipped);
+    pass->skippedClearBytes += clearBytes(pass, skipped, clear.rect);
+    return skipped;
+}
+
+// The GL clear mask without the skipped attachments.
+static GLbitfield clearMaskWithout(GLbitfield mask, unsigned int skipped) {
+    if (skipped & GL_COLOR_BUFFER_BIT) {
+        mask &= ~GL_COLOR_BUFFER_BIT;
+    }
+    if (skipped & GL_DEPTH_BUFFER_BIT) {
+        mask &= ~(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    }
+    return mask;
+}
+
+RenderPass createRenderPass(const char* name, unsigned int fbo, int width, int height) {
+    RenderPass pass;
+    pass.name = name;
+    pass.fbo = fbo;
+    pass.width = width;
+    pass.height = height;
+    pass.color = { RENDER_PASS_LOAD, RENDER_PASS_STORE, 0 };
+    pass.depth = { RENDER_PASS_LOAD, RENDER_PASS_STORE, 0 };
+    pass.clearColor[0] = 0.0f;
+    pass.clearColor[1] = 0.0f;
+    pass.clearColor[2] = 0.0f;
+    pass.clearColor[3] = 1.0f;
+    pass.clearDepth = 1.0f;
+    pass.invalidate = true;
+
+    pass.skipRedundantClears = true;
+    memset(pass.clears, 0, sizeof(pass.clears));
+    pass.clearCount = 0;
+    pass.executions = 0;
+    pass.issuedClears = 0;
+    pass.redundantClears = 0;
+    pass.skippedClears = 0;
+    pass.skippedClearBytes = 0;
+    pass.reported = false;
+    return pass;
+}
+
+void beginRenderPass(RenderPass* pass) {
+    glBindFramebuffer(GL_FRAMEBUFFER, pass->fbo);
+    glViewport(0, 0, pass->width, pass->height);
+    glScissor(0, 0, pass->width, pass->height);
+    pass->clearCount = 0;
+
+    // 1. CLEAR: a full clear also tells the driver that nothing has to be loaded.
+    GLbitfield clearMask = 0;
+    if (pass->color.bytesPerPixel > 0 && pass->color.load == RENDER_PASS_CLEAR) {
+        clearMask |= GL_COLOR_BUFFER_BIT;
+    }
+    if (pass->depth.bytesPerPixel > 0 && pass->depth.load == RENDER_PASS_CLEAR) {
+        clearMask |= GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT;
+    }
+
+    /* A clear overwritten in the previous execution is replaced by an invalidation. */
+    unsigned int skipped = 0;
+    if (clearMask != 0) {
+        skipped = trackClear(pass, clearMask, 0, 0, pass->width, pass->height);
+        clearMask = clearMaskWithout(clearMask, skipped);
+    }
+
+    // 2. DONT_CARE: the previous contents are not needed.
+    if (pass->invalidate) {
+        GLenum attachments[3];
+        int count = collectAttachments(pass,
+                                       pass->color.load == RENDER_PASS_DONT_CARE || (skipped & GL_COLOR_BUFFER_BIT),
+                                       pass->depth.load == RENDER_PASS_DONT_CARE || (skipped & GL_DEPTH_BUFFER_BIT),
+                                       attachments);
+        if (count > 0) {
+            glInvalidateFramebuffer(GL_FRAMEBUFFER, count, attachments);
+        }
+    }
+
+    if (clearMask & GL_COLOR_BUFFER_BIT) {
+        glClearColor(pass->clearColor[0], pass->clearColor[1], pass->clearColor[2], pass->clearColor[3]);
+    }
+    if (clearMask & GL_DEPTH_BUFFER_BIT) {
+        glClearDepthf(pass->clearDepth);
+    }
+    if (clearMask != 0) {
+        glClear(clearMask);
+    }
+}
+
+void renderPassClear(RenderPass* pass, unsigned int mask, int x, int y, int width, int height) {
+    GLbitfield clearMask = clearMaskWithout(mask, trackClear(pass, mask, x, y, width, height));
+
+    glScissor(x, y, width, height);
+    if (clearMask == 0) {
+        return;
+    }
+
+    GLboolean scissorTest = glIsEnabled(GL_SCISSOR_TEST);
+    glEnable(GL_SCISSOR_TEST);
+    glClear(clearMask);
+    if (!scissorTest) {
+        glDisable(GL_SCISSOR_TEST);
+    }
+}
+
+void renderPassCovered(RenderPass* pass, unsigned int mask, int x, int y, int width, int height) {
+    static const char* attachmentNames[] = { "", "color", "depth", "color and depth" };
+
+    unsigned int attachments = attachmentMask(pass, mask);
+    for (int idx = 0; idx < pass->clearCount; idx++) {
+        RenderPassClear& clear = pass->clears[idx];
+        unsigned int overwritten = clear.pendingMask & attachments;
+        bool inside = clear.rect.x >= x && clear.rect.y >= y
+                      && clear.rect.x + clear.rect.width <= x + width && clear.rect.y + clear.rect.height <= y + height;
+        if (!overwritten || !inside) {
+            continue;
+        }
+
+        clear.pendingMask &= ~overwritten;
+        pass->redundantClears += attachmentCount(overwritten);
+
+        if (!pass->reported) {
+            int nameIdx = ((overwritten & GL_COLOR_BUFFER_BIT) ? 1 : 0) + ((overwritten & GL_DEPTH_BUFFER_BIT) ? 2 : 0);
+            printf("Render pass '%s': the %s clear of %dx%d at (%d, %d) is overwritten before it is used "
+                   "(%.2f MiB per frame)%s\n", pass->name, attachmentNames[nameIdx], clear.rect.width, clear.rect.height,
+                   clear.rect.x, clear.rect.y, clearBytes(pass, overwritten, clear.rect) / (1024.0 * 1024.0),
+                   pass->skipRedundantClears ? ", skipping it" : "");
+            pass->reported = true;
+        }
+    }
+}
+
+void endRenderPass(RenderPass* pass) {
+    // 1. The clears overwritten in this execution are skipped by the next one.
+    for (int idx = 0; idx < RENDER_PASS_MAX_CLEARS; idx++) {
+        RenderPassClear& clear = pass->clears[idx];
+        if (idx < pass->clearCount) {
+            clear.redundantMask = clear.mask & ~clear.pendingMask;
+        } else {
+            clear.mask = 0;
+            clear.redundantMask = 0;
+        }
+    }
+    pass->executions++;
+
+    if (!pass->invalidate) {
+        return;
+    }
+
+    // 2. DISCARD: the contents won't be used, no need to write them back to the memory.
+    GLenum attachments[3];
+    int count = collectAttachments(pass, pass->color.store == RENDER_PASS_DISCARD,
+                                   pass->depth.store == RENDER_PASS_DISCARD, attachments);
+    if (count > 0) {
+        glBindFramebuffer(GL_FRAMEBUFFER, pass->fbo);
+        glInvalidateFramebuffer(GL_FRAMEBUFFER, count, attachments);
+    }
+}
+
+static int64_t attachmentBytesSaved(const RenderPass* pass, const RenderPassAttachment& attachment) {
+    int64_t size = (int64_t)pass->width * pass->height * attachment.bytesPerPixel;
+    int64_t saved = 0;
+
+    /* A clear is cheap even without invalidation: the tiles are initialized in the tile memory. */
+    if (attachment.load == RENDER_PASS_CLEAR || (attachment.load == RENDER_PASS_DONT_CARE && pass->invalidate)) {
+        saved += size;
+    }
+    if (attachment.store == RENDER_PASS_DISCARD && pass->invalidate) {
+        saved += size;
+    }
+    return saved;
+}
+
+int64_t renderPassBytesSaved(const RenderPass* pass) {
+    return attachmentBytesSaved(pass, pass->color) + attachmentBytesSaved(pass, pass->depth);
+}
+
+void printRenderPassReport(const RenderPass* const* passes, int count) {
+    static const char* loadNames[] = { "load", "clear", "dont care" };
+    static const char* storeNames[] = { "store", "discard" };
+
+    int64_t total = 0;
+    printf("Render passes (estimated memory traffic saved per frame%s):\n",
+           (count > 0 && !passes[0]->invalidate) ? ", invalidation disabled" : "");
+    for (int idx = 0; idx < count; idx++) {
+        const RenderPass* pass = passes[idx];
+        int64_t saved = renderPassBytesSaved(pass);
+        total += saved;
+
+        printf("  %-12s color: %s/%s depth: %s/%s -> %.2f MiB\n", pass->name,
+               pass->color.bytesPerPixel ? loadNames[pass->color.load] : "-",
+               pass->color.bytesPerPixel ? storeNames[pass->color.store] : "-",
+               pass->depth.bytesPerPixel ? loadNames[pass->depth.load] : "-",
+               pass->depth.bytesPerPixel ? storeNames[pass->depth.store] : "-",
+               saved / (1024.0 * 1024.0));
+    }
+    printf("  total: %.2f MiB/frame\n", total / (1024.0 * 1024.0));
+}
+
+void printRenderPassClearReport(const RenderPass* const* passes, int count) {
+    int64_t total = 0;
+    printf("Render pass clears (attachments per frame%s):\n",
+           (count > 0 && !passes[0]->skipRedundantClears) ? ", skipping disabled" : "");
+    for (int idx = 0; idx < count; idx++) {
+        const RenderPass* pass = passes[idx];
+        double executions = pass->executions > 0 ? pass->executions : 1;
+        total += (int64_t)(pass->skippedClearBytes / executions);
+
+        printf("  %-12s issued: %.2f redundant: %.2f skipped: %.2f -> %.2f MiB not written\n", pass->name,
+               pass->issuedClears / executions, pass->redundantClears / executions, pass->skippedClears / executions,
+               pass->skippedClearBytes / executions / (1024.0 * 1024.0));
+    }
+    printf("  total: %.2f MiB/frame\n", total / (1024.0 * 1024.0));
+}
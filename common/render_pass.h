@@ -0,0 +1,165 @@
+/**
+ * Render passes with load/store actions for the framebuffer attachments.
+ *
+ * Tile based (TBDR) GPUs render a pass in on-chip tile memory: at the start of
+ * the pass the attachments are loaded from the memory and at the end they are
+ * written back. The GL has no explicit render passes, but the driver can skip
+ * these copies if the contents are cleared or invalidated:
+ *
+ *  * Load action:  RENDER_PASS_LOAD      keep the previous contents (memory read),
+ *                  RENDER_PASS_CLEAR     glClear at the start of the pass,
+ *                  RENDER_PASS_DONT_CARE glInvalidateFramebuffer at the start
+ *                                        (the pass overwrites every pixel).
+ *  * Store action: RENDER_PASS_STORE     the contents are used later (memory write),
+ *                  RENDER_PASS_DISCARD   glInvalidateFramebuffer at the end of the pass.
+ *
+ * The "depth" attachment covers the stencil too (ex.: GL_DEPTH24_STENCIL8).
+ *
+ * Usage:
+ *
+ *   RenderPass pass = createRenderPass("scene", fbo, width, height);
+ *   pass.depth = { RENDER_PASS_CLEAR, RENDER_PASS_DISCARD, 4 };
+ *   ...
+ *   beginRenderPass(&pass);
+ *   ... draw ...
+ *   endRenderPass(&pass);
+ *
+ * renderPassBytesSaved estimates the memory traffic avoided every frame
+ * compared to loading and storing every attachment.
+ *
+ * Redundant clears: a clear is wasted bandwidth if the cleared pixels are
+ * overwritten before anything reads them (ex.: a clear followed by a full
+ * screen blit, a "clear then full overwrite" pattern). The pass tracks its
+ * clears (the load action clear and the renderPassClear calls) and the
+ * rectangles declared as overwritten with renderPassCovered:
+ *
+ *   beginRenderPass(&pass);                        // RENDER_PASS_CLEAR
+ *   glBlitFramebuffer(... the whole pass ...);
+ *   renderPassCovered(&pass, GL_COLOR_BUFFER_BIT, 0, 0, width, height);
+ *
+ * A clear which is fully overwritten is reported once at runtime and, with
+ * skipRedundantClears, it is skipped in the next executions of the pass (the
+ * load action clear becomes an invalidation) as long as the coverage stays.
+ * The decision is based on the previous execution: if an execution stops
+ * covering the clear, its pixels are undefined for that one frame.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_RENDER_PASS_H
+#define GLES_COMMON_RENDER_PASS_H
+
+#include <stdint.h>
+
+// Number of clears tracked in one execution of a pass (the load action clear included).
+#define RENDER_PASS_MAX_CLEARS 4
+
+enum RenderPassLoadAction {
+    RENDER_PASS_LOAD,
+    RENDER_PASS_CLEAR,
+    RENDER_PASS_DONT_CARE,
+};
+
+enum RenderPassStoreAction {
+    RENDER_PASS_STORE,
+    RENDER_PASS_DISCARD,
+};
+
+struct RenderPassAttachment {
+    RenderPassLoadAction load;
+    RenderPassStoreAction store;
+    int bytesPerPixel; // 0: the framebuffer has no such attachment
+};
+
+struct RenderPassRect {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// A clear of a pass execution, matched with the clear of the same order in the next execution.
+struct RenderPassClear {
+    RenderPassRect rect;
+    unsigned int mask;          // requested GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT (depth: with the stencil)
+    unsigned int pendingMask;   // attachments not overwritten yet in this execution
+    unsigned int redundantMask; // attachments overwritten in the previous execution
+};
+
+struct RenderPass {
+    const char* name;
+    unsigned int fbo; // 0: the window framebuffer
+    int width;
+    int height;
+
+    RenderPassAttachment color; // GL_COLOR_ATTACHMENT0
+    RenderPassAttachment depth; // depth and stencil
+
+    float clearColor[4];
+    float clearDepth;
+
+    // false: never call glInvalidateFramebuffer (to compare the performance).
+    bool invalidate;
+
+    // false: always issue the clears, even the redundant ones (to compare the performance).
+    bool skipRedundantClears;
+
+    // Clear tracking (updated by beginRenderPass, renderPassClear, renderPassCovered and endRenderPass).
+    RenderPassClear clears[RENDER_PASS_MAX_CLEARS];
+    int clearCount;
+    int executions;
+    int issuedClears;             // attachments cleared
+    int redundantClears;          // attachments cleared (or skipped) and fully overwritten
+    int skippedClears;            // attachments not cleared
+    int64_t skippedClearBytes;    // bytes not written by the skipped clears
+    bool reported;                // a redundant clear was reported
+};
+
+// Render pass without attachments on the given framebuffer (clear color: black, clear depth: 1.0).
+RenderPass createRenderPass(const char* name, unsigned int fbo, int width, int height);
+
+// Bind the framebuffer (as GL_FRAMEBUFFER), set the viewport/scissor box and apply the load actions.
+/* The clears use the current color and depth write masks. */
+void beginRenderPass(RenderPass* pass);
+
+// Clear a rectangle of the attachments during the pass (with the current clear values).
+/* The scissor test is used: the scissor box is left on the rectangle, the scissor test state is kept. */
+void renderPassClear(RenderPass* pass, unsigned int mask, int x, int y, int width, int height);
+
+// Declare that the rectangle of the attachments was overwritten without reading it (ex.: a blit,
+// an opaque quad): the clears of the pass inside the rectangle were redundant.
+void renderPassCovered(RenderPass* pass, unsigned int mask, int x, int y, int width, int height);
+
+// Apply the store actions.
+/* The framebuffer of the pass is bound again if an attachment is discarded, so a resolve
+ * blit can be issued between the draws and endRenderPass. */
+void endRenderPass(RenderPass* pass);
+
+// Estimated number of bytes not loaded from or stored to the memory by one execution of the pass.
+int64_t renderPassBytesSaved(const RenderPass* pass);
+
+// Print the per frame estimate of each pass and their sum.
+void printRenderPassReport(const RenderPass* const* passes, int count);
+
+// Print the issued, redundant and skipped clears of each pass per frame (ex.: at exit).
+void printRenderPassClearReport(const RenderPass* const* passes, int count);
+
+#endif // GLES_COMMON_RENDER_PASS_H
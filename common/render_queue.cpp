@@ -0,0 +1,291 @@
+/**
+ * Render queue: radix sorted draw items merged into instanced draws.
+ * See render_queue.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/render_queue.h"
+
+#include <string.h>
+
+#include <chrono>
+
+#include <GLES3/gl3.h>
+
+#include "common/gl_state.h"
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int indexSize(unsigned int indexType) {
+    switch (indexType) {
+        case GL_UNSIGNED_BYTE: return 1;
+        case GL_UNSIGNED_SHORT: return 2;
+        default: return 4;
+    }
+}
+
+// The items draw the same primitives with the same state (only their instance values differ).
+static bool sameDraw(const RenderQueueItem& lhs, const RenderQueueItem& rhs) {
+    return lhs.program == rhs.program && lhs.vao == rhs.vao && lhs.texture == rhs.texture && lhs.mode == rhs.mode
+        && lhs.first == rhs.first && lhs.count == rhs.count && lhs.indexType == rhs.indexType;
+}
+
+static void drawInstanced(const RenderQueueItem& item, int instanceCount) {
+    if (item.indexType == 0) {
+        glDrawArraysInstanced(item.mode, item.first, item.count, instanceCount);
+    } else {
+        const void* offset = (const void*)(uintptr_t)(item.first * indexSize(item.indexType));
+        glDrawElementsInstanced(item.mode, item.count, item.indexType, offset, instanceCount);
+    }
+}
+
+void initRenderQueue(RenderQueue* queue, int instanceLocation, int instanceBufferSize) {
+    queue->items.clear();
+    queue->itemKeys.clear();
+    queue->instanceLocation = instanceLocation;
+
+    // The items and the sort buffers are sized for a full instance buffer: the frames don't allocate.
+    /* More items grow the vectors once, they keep their capacity between the frames. */
+    size_t itemCapacity = instanceBufferSize > 0 ? instanceBufferSize / 16 : 0;
+    queue->items.reserve(itemCapacity);
+    queue->itemKeys.reserve(itemCapacity);
+    for (int idx = 0; idx < 2; idx++) {
+        queue->keys[idx].reserve(itemCapacity);
+        queue->order[idx].reserve(itemCapacity);
+    }
+    initStreamBuffer(&queue->instances, GL_ARRAY_BUFFER, instanceBufferSize > 0 ? instanceBufferSize : 256);
+
+    queue->sorted = NULL;
+    queue->isSorted = false;
+    queue->retained = false;
+
+    queue->itemCount = 0;
+    queue->drawCalls = 0;
+    queue->stateChanges = 0;
+    queue->sortMs = 0.0;
+    queue->submitMs = 0.0;
+}
+
+void destroyRenderQueue(RenderQueue* queue) {
+    destroyStreamBuffer(&queue->instances);
+    queue->items.clear();
+    queue->itemKeys.clear();
+}
+
+uint64_t renderQueueKey(int pass, int programId, int vaoId, int textureId, int variant, float depth) {
+    depth = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+    uint64_t depthBits = (uint64_t)(depth * 65535.0f);
+
+    return ((uint64_t)(pass & 0xf) << 60) | ((uint64_t)(programId & 0xfff) << 48) | ((uint64_t)(vaoId & 0xfff) << 36)
+         | ((uint64_t)(textureId & 0xfff) << 24) | ((uint64_t)(variant & 0xff) << 16) | depthBits;
+}
+
+void renderQueueAdd(RenderQueue* queue, const RenderQueueItem& item) {
+    queue->items.push_back(item);
+    queue->itemKeys.push_back(item.key);
+    queue->isSorted = false;
+}
+
+void renderQueueClear(RenderQueue* queue) {
+    queue->items.clear();
+    queue->itemKeys.clear();
+    queue->sorted = NULL;
+    queue->isSorted = false;
+    queue->retained = false;
+}
+
+void renderQueueSort(RenderQueue* queue) {
+    auto start = std::chrono::steady_clock::now();
+    size_t count = queue->items.size();
+    const uint64_t* itemKeys = queue->itemKeys.data();
+
+    // 1. Collect the bits which differ between the keys.
+    uint64_t differentBits = 0;
+    for (size_t idx = 0; idx < count; idx++) {
+        differentBits |= itemKeys[idx] ^ itemKeys[0];
+    }
+
+    // 2. Only the digits which differ are sorted (ex.: the unused ids), count them in one pass.
+    int digits[8];
+    int digitCount = 0;
+    for (int digit = 0; digit < 8; digit++) {
+        if ((differentBits >> (digit * 8)) & 0xff) {
+            digits[digitCount++] = digit;
+        }
+    }
+
+    uint32_t histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+    for (size_t idx = 0; idx < count; idx++) {
+        for (int pass = 0; pass < digitCount; pass++) {
+            histograms[pass][(itemKeys[idx] >> (digits[pass] * 8)) & 0xff]++;
+        }
+    }
+
+    // 3. Least significant digit first, every pass is a stable scatter (the first one reads the item keys).
+    for (int idx = 0; idx < 2; idx++) {
+        queue->keys[idx].resize(count);
+        queue->order[idx].resize(count);
+    }
+
+    int src = -1;
+    for (int pass = 0; pass < digitCount; pass++) {
+        uint32_t* offsets = histograms[pass];
+        uint32_t sum = 0;
+        for (int bucket = 0; bucket < 256; bucket++) {
+            uint32_t bucketCount = offsets[bucket];
+            offsets[bucket] = sum;
+            sum += bucketCount;
+        }
+
+        int dst = src == 0 ? 1 : 0;
+        int shift = digits[pass] * 8;
+        uint64_t* dstKeys = queue->keys[dst].data();
+        uint32_t* dstOrder = queue->order[dst].data();
+        if (src < 0) {
+            for (size_t idx = 0; idx < count; idx++) {
+                uint32_t pos = offsets[(itemKeys[idx] >> shift) & 0xff]++;
+                dstKeys[pos] = itemKeys[idx];
+                dstOrder[pos] = (uint32_t)idx;
+            }
+        } else {
+            const uint64_t* srcKeys = queue->keys[src].data();
+            const uint32_t* srcOrder = queue->order[src].data();
+            for (size_t idx = 0; idx < count; idx++) {
+                uint64_t key = srcKeys[idx];
+                uint32_t pos = offsets[(key >> shift) & 0xff]++;
+                dstKeys[pos] = key;
+                dstOrder[pos] = srcOrder[idx];
+            }
+        }
+        src = dst;
+    }
+
+    // 4. Every key is the same: the submission order.
+    if (src < 0) {
+        src = 0;
+        for (size_t idx = 0; idx < count; idx++) {
+            queue->order[0][idx] = (uint32_t)idx;
+        }
+    }
+
+    queue->sorted = queue->order[src].data();
+    queue->isSorted = true;
+    queue->sortMs = millisecondsSince(start);
+}
+
+void renderQueueSubmit(RenderQueue* queue, bool retain) {
+    if (!queue->isSorted) {
+        renderQueueSort(queue);
+    } else if (queue->retained) {
+        // The order of the kept items is still valid: nothing to sort.
+        queue->sortMs = 0.0;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    const std::vector<RenderQueueItem>& items = queue->items;
+    int count = (int)items.size();
+    int location = queue->instanceLocation;
+
+    queue->itemCount = count;
+    queue->drawCalls = 0;
+    queue->stateChanges = 0;
+
+    // 1. The instance values in key order: every merged draw reads a contiguous range.
+    int baseOffset = -1;
+    if (location >= 0 && count > 0) {
+        streamBufferBeginFrame(&queue->instances);
+        float* instances = (float*)streamBufferAllocate(&queue->instances, count * 4 * sizeof(float), 16, &baseOffset);
+        if (instances != NULL) {
+            for (int idx = 0; idx < count; idx++) {
+                memcpy(&instances[idx * 4], items[queue->sorted[idx]].instance, 4 * sizeof(float));
+            }
+        }
+        streamBufferEndFrame(&queue->instances);
+    }
+
+    // 2. Merge the runs of identical draws, change only the state which differs from the previous run.
+    const RenderQueueItem* previous = NULL;
+    for (int runStart = 0; runStart < count;) {
+        const RenderQueueItem& item = items[queue->sorted[runStart]];
+        int runEnd = runStart + 1;
+        while (runEnd < count && sameDraw(item, items[queue->sorted[runEnd]])) {
+            runEnd++;
+        }
+
+        if (previous == NULL || previous->program != item.program) {
+            stateCacheUseProgram(item.program);
+            queue->stateChanges++;
+        }
+        bool vaoChanged = previous == NULL || previous->vao != item.vao;
+        if (vaoChanged) {
+            stateCacheBindVertexArray(item.vao);
+            queue->stateChanges++;
+        }
+        if (previous == NULL || previous->texture != item.texture) {
+            stateCacheBindTexture(0, GL_TEXTURE_2D, item.texture);
+            queue->stateChanges++;
+        }
+        previous = &item;
+
+        if (location < 0) {
+            drawInstanced(item, runEnd - runStart);
+            queue->drawCalls++;
+        } else if (baseOffset >= 0) {
+            // 2.1. No base instance in ES: point the attribute at the first value of the run.
+            stateCacheBindBuffer(GL_ARRAY_BUFFER, queue->instances.buffer);
+            glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float),
+                                  (const void*)(uintptr_t)(baseOffset + runStart * 4 * sizeof(float)));
+            if (vaoChanged) {
+                glVertexAttribDivisor(location, 1);
+                glEnableVertexAttribArray(location);
+            }
+            drawInstanced(item, runEnd - runStart);
+            queue->drawCalls++;
+        } else {
+            // 2.2. The instance buffer is full: one draw per item with a constant attribute value.
+            if (vaoChanged) {
+                glDisableVertexAttribArray(location);
+            }
+            for (int idx = runStart; idx < runEnd; idx++) {
+                glVertexAttrib4fv(location, items[queue->sorted[idx]].instance);
+                drawInstanced(item, 1);
+                queue->drawCalls++;
+            }
+        }
+
+        runStart = runEnd;
+    }
+
+    if (baseOffset >= 0 && count > 0) {
+        stateCacheBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    if (retain) {
+        queue->retained = true;
+    } else {
+        renderQueueClear(queue);
+    }
+    queue->submitMs = millisecondsSince(start);
+}
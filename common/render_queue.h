@@ -0,0 +1,137 @@
+/**
+ * Render queue: draw items sorted by a 64 bit state key, merged into instanced draws.
+ *
+ * The draws of a frame are collected as items with a sort key. The key
+ * orders them by pass, then by state (program, vertex array, texture and a
+ * caller defined variant), then by depth, so a frame costs as few state
+ * changes as possible and the opaque draws of a state run front to back
+ * (early depth test). The keys are radix sorted (8 bit digits, the digits
+ * where every key is the same are skipped: a frame with one state only
+ * sorts the depth and the variant), which is linear in the item count and
+ * stable: equal keys keep their submission order.
+ *
+ * After the sort the consecutive items with the same draw (program, vertex
+ * array, texture, mode and range) are merged into one instanced draw. Every
+ * item has a vec4 instance value (ex.: position and rotation) which is
+ * written in sorted order into a stream buffer and read by the
+ * "instanceLocation" attribute with a divisor of 1. ES has no base instance,
+ * so the attribute pointer is moved to the first item of every draw.
+ *
+ * Key layout (from the most significant bit):
+ *
+ *   | pass 4 | program 12 | vertex array 12 | texture 12 | variant 8 | depth 16 |
+ *
+ * The ids are small integers chosen by the caller (GL names can be used as
+ * long as they fit), they only group the items: the merge compares the real
+ * draw fields. Back to front passes (ex.: transparent) use 1 - depth.
+ *
+ * Usage:
+ *
+ *   RenderQueue queue;
+ *   initRenderQueue(&queue, instanceLocation, maxItems * 16);
+ *   while (...) {
+ *       RenderQueueItem item = { renderQueueKey(0, 1, 1, 0, 0, depth), program, vao, 0,
+ *                                GL_TRIANGLES, 0, indexCount, GL_UNSIGNED_SHORT, { x, y, z, angle } };
+ *       renderQueueAdd(&queue, item);
+ *       ...
+ *       renderQueueSubmit(&queue); // sort, merge and draw, then clear
+ *   }
+ *   destroyRenderQueue(&queue);
+ *
+ * A queue submitted with "retain" keeps its items and their sorted order:
+ * while nothing which feeds the keys changed (ex.: the camera version, see
+ * common/camera.h), the next frames only call renderQueueSubmit again and
+ * skip the item building and the sort. renderQueueClear starts a new list.
+ *
+ * The uniforms are per program: set them before the submit. The queue owns
+ * the instance attribute of the vertex arrays it draws (it enables it with
+ * the stream buffer as its source). The binds go through the state cache.
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_RENDER_QUEUE_H
+#define GLES_COMMON_RENDER_QUEUE_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "common/stream_buffer.h"
+
+struct RenderQueueItem {
+    uint64_t key;
+    unsigned int program;
+    unsigned int vao;
+    unsigned int texture;    // GL_TEXTURE_2D on the unit 0 (0: none)
+    unsigned int mode;       // GL_TRIANGLES, GL_LINES, ...
+    int first;               // first vertex (glDrawArrays) or index
+    int count;
+    unsigned int indexType;  // 0: glDrawArrays, otherwise the type of the vertex array's index buffer
+    float instance[4];
+};
+
+struct RenderQueue {
+    std::vector<RenderQueueItem> items;
+    std::vector<uint64_t> itemKeys; // the keys of the items, densely packed for the sort
+    int instanceLocation;
+    StreamBuffer instances;
+
+    // Radix sort buffers (kept between the frames).
+    std::vector<uint64_t> keys[2];
+    std::vector<uint32_t> order[2];
+    const uint32_t* sorted; // items in key order, valid after the sort
+    bool isSorted;
+    bool retained; // the items of the last submit were kept
+
+    // Statistics of the last submit.
+    int itemCount;
+    int drawCalls;
+    int stateChanges; // program, vertex array and texture binds (the first draw's included)
+    double sortMs;
+    double submitMs;  // merge, instance upload and the GL calls
+};
+
+// The instance buffer holds "instanceBufferSize" bytes per frame (16 bytes per item).
+void initRenderQueue(RenderQueue* queue, int instanceLocation, int instanceBufferSize);
+void destroyRenderQueue(RenderQueue* queue);
+
+// Depth is in [0, 1] (clamped), the ids are masked to their bit count.
+uint64_t renderQueueKey(int pass, int programId, int vaoId, int textureId, int variant, float depth);
+
+void renderQueueAdd(RenderQueue* queue, const RenderQueueItem& item);
+
+// Drop the items (also the ones kept by a retained submit).
+void renderQueueClear(RenderQueue* queue);
+
+// Radix sort the items by key (renderQueueSubmit sorts if this wasn't called).
+void renderQueueSort(RenderQueue* queue);
+
+// Draw the items in key order, merging the identical consecutive draws, and clear the queue.
+/* If the instance buffer is full, the remaining items are drawn one by one with a constant attribute.
+ * "retain": keep the items and their order for the next submit (no clear, no sort). */
+void renderQueueSubmit(RenderQueue* queue, bool retain = false);
+
+#endif // GLES_COMMON_RENDER_QUEUE_H
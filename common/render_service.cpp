@@ -0,0 +1,348 @@
+/**
+ * Render service, see render_service.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/render_service.h"
+
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+#include <GLES3/gl3.h>
+
+#include "common/gpu_memory.h"
+
+bool parseRenderJob(const std::string& line, RenderJob* job) {
+    std::istringstream stream(line);
+    std::string size;
+    if (!(stream >> job->id >> size >> job->scene)
+        || sscanf(size.c_str(), "%dx%d", &job->width, &job->height) != 2
+        || job->width < 1 || job->height < 1) {
+        return false;
+    }
+
+    // The camera is optional: the position and the zoom.
+    job->camera[0] = 0.0f;
+    job->camera[1] = 0.0f;
+    job->camera[2] = 1.0f;
+    for (int idx = 0; idx < 3 && stream >> job->camera[idx]; idx++) {
+    }
+    return true;
+}
+
+// Write everything (the sockets without SIGPIPE on a closed client). Returns false on error.
+static bool sendAll(RenderService* service, const void* data, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    while (size > 0) {
+        ssize_t written = service->socketPath.empty() ? write(service->output, bytes, size)
+                                                      : send(service->output, bytes, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        size -= written;
+        service->sentBytes += written;
+    }
+    return true;
+}
+
+static bool sendError(RenderService* service, const std::string& line) {
+    service->errorCount++;
+    std::string answer = "error " + line + "\n";
+    return sendAll(service, answer.data(), answer.size());
+}
+
+// Read the lines of the next batch: wait for the first one, then take only what is there already.
+/* Returns false at the end of the input (the lines before it are still returned). */
+static bool readLines(RenderService* service, std::vector<std::string>* lines) {
+    char buffer[64 * 1024];
+    while (true) {
+        // 1. The complete lines of the read bytes.
+        size_t end;
+        while ((int)lines->size() < service->maxBatch && (end = service->pending.find('\n')) != std::string::npos) {
+            std::string line = service->pending.substr(0, end);
+            service->pending.erase(0, end + 1);
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (!line.empty()) {
+                lines->push_back(line);
+            }
+        }
+        if ((int)lines->size() >= service->maxBatch) {
+            return true;
+        }
+
+        // 2. Block for the first line only.
+        struct pollfd descriptor = { service->input, POLLIN, 0 };
+        int ready = poll(&descriptor, 1, lines->empty() ? -1 : 0);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready == 0) {
+            return true;
+        }
+
+        ssize_t count = ready > 0 ? read(service->input, buffer, sizeof(buffer)) : -1;
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            // 3. The end of the input: the last line may have no line break.
+            if (!service->pending.empty() && (int)lines->size() < service->maxBatch) {
+                lines->push_back(service->pending);
+            }
+            service->pending.clear();
+            return false;
+        }
+        service->pending.append(buffer, count);
+    }
+}
+
+// Grow the atlas renderbuffer to at least width x height (it never shrinks).
+static void ensureAtlas(RenderService* service, int width, int height) {
+    if (width <= service->atlasWidth && height <= service->atlasHeight) {
+        return;
+    }
+    service->atlasWidth = std::max(width, service->atlasWidth);
+    service->atlasHeight = std::max(height, service->atlasHeight);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, service->renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, service->atlasWidth, service->atlasHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    gpuMemoryTrackRenderbuffer(service->renderbuffer, GL_RGBA8, service->atlasWidth, service->atlasHeight, 0,
+                               "render service atlas");
+}
+
+// Draw the jobs (all of the same size) into the tiles of one atlas, read it back and answer every job.
+static bool renderAtlasPass(RenderService* service, const std::vector<const RenderJob*>& jobs,
+                            RenderJobFunction draw, void* data) {
+    int width = jobs[0]->width;
+    int height = jobs[0]->height;
+    int count = (int)jobs.size();
+    int columns = std::min(std::max((int)ceil(sqrt((double)count)), 1), service->maxAtlasSize / width);
+    int rows = (count + columns - 1) / columns;
+    int atlasWidth = columns * width;
+    int atlasHeight = rows * height;
+
+    // 1. One tile per job: the viewport and the scissor of the tile.
+    ensureAtlas(service, atlasWidth, atlasHeight);
+    glBindFramebuffer(GL_FRAMEBUFFER, service->fbo);
+    glEnable(GL_SCISSOR_TEST);
+    std::vector<bool> drawn(count);
+    for (int idx = 0; idx < count; idx++) {
+        int x = (idx % columns) * width;
+        int y = (idx / columns) * height;
+        glViewport(x, y, width, height);
+        glScissor(x, y, width, height);
+        drawn[idx] = draw(*jobs[idx], data);
+    }
+    glDisable(GL_SCISSOR_TEST);
+
+    // 2. One readback of the used part of the atlas.
+    service->pixels.resize((size_t)atlasWidth * atlasHeight * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, atlasWidth, atlasHeight, GL_RGBA, GL_UNSIGNED_BYTE, service->pixels.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    service->passCount++;
+
+    // 3. Cut out, encode and send the tiles.
+    service->tile.resize((size_t)width * height * 4);
+    for (int idx = 0; idx < count; idx++) {
+        const RenderJob& job = *jobs[idx];
+        if (!drawn[idx]) {
+            if (!sendError(service, job.id + " unknown scene " + job.scene)) {
+                return false;
+            }
+            continue;
+        }
+
+        int x = (idx % columns) * width;
+        int y = (idx / columns) * height;
+        for (int row = 0; row < height; row++) {
+            memcpy(&service->tile[(size_t)row * width * 4],
+                   &service->pixels[((size_t)(y + row) * atlasWidth + x) * 4], (size_t)width * 4);
+        }
+        size_t size = encodeImage(service->format, service->tile.data(), width, height, &service->encoded);
+
+        char header[256];
+        int headerSize = snprintf(header, sizeof(header), "%s %s %zu\n", job.id.c_str(),
+                                  imageFileFormatNames[service->format], size);
+        if (!sendAll(service, header, headerSize) || !sendAll(service, service->encoded.data(), size)) {
+            return false;
+        }
+        service->jobCount++;
+    }
+    return true;
+}
+
+bool initRenderService(RenderService* service, const char* socketPath, int input, int output,
+                       ImageFileFormat format, int maxBatch) {
+    service->socketPath = socketPath != NULL ? socketPath : "";
+    service->listener = -1;
+    service->input = input;
+    service->output = output;
+    service->pending.clear();
+    service->stopping = false;
+    service->format = format;
+    service->maxBatch = maxBatch > 0 ? maxBatch : 1;
+
+    service->jobCount = 0;
+    service->batchCount = 0;
+    service->passCount = 0;
+    service->errorCount = 0;
+    service->sentBytes = 0;
+    service->renderSeconds = 0.0;
+
+    // 1. The atlas target, its storage comes with the first batch.
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &service->maxAtlasSize);
+    service->maxAtlasSize = std::min(service->maxAtlasSize, 8192);
+    service->atlasWidth = 0;
+    service->atlasHeight = 0;
+    glGenRenderbuffers(1, &service->renderbuffer);
+    ensureAtlas(service, 1, 1);
+    glGenFramebuffers(1, &service->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, service->fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, service->renderbuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // 2. The socket: the clients connect one after the other.
+    if (socketPath == NULL) {
+        return true;
+    }
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+
+    service->input = service->output = -1;
+    service->listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    unlink(socketPath);
+    if (service->listener < 0 || bind(service->listener, (struct sockaddr*)&address, sizeof(address)) != 0
+        || listen(service->listener, 4) != 0) {
+        printf("Render service: can not listen on '%s'\n", socketPath);
+        return false;
+    }
+    printf("Render service: listening on '%s'\n", socketPath);
+    return true;
+}
+
+bool renderServiceStep(RenderService* service, RenderJobFunction draw, void* data) {
+    // 1. Socket mode: wait for the next client.
+    if (service->listener >= 0 && service->input < 0) {
+        service->input = service->output = accept4(service->listener, NULL, NULL, SOCK_CLOEXEC);
+        if (service->input < 0) {
+            return false;
+        }
+    } else if (service->input < 0) {
+        return false;
+    }
+
+    // 2. The lines of the batch, the end of the input closes the client (or stops the service).
+    std::vector<std::string> lines;
+    bool open = readLines(service, &lines);
+    service->batchCount += lines.empty() ? 0 : 1;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<RenderJob> jobs;
+    bool sent = true;
+    for (size_t idx = 0; idx < lines.size() && sent; idx++) {
+        RenderJob job;
+        if (lines[idx] == "quit") {
+            service->stopping = true;
+            break;
+        } else if (!parseRenderJob(lines[idx], &job) || job.width > service->maxAtlasSize
+                   || job.height > service->maxAtlasSize) {
+            sent = sendError(service, lines[idx]);
+        } else {
+            jobs.push_back(job);
+        }
+    }
+
+    // 3. The jobs of a size together, in atlas passes of at most the tiles which fit.
+    std::vector<bool> done(jobs.size(), false);
+    for (size_t first = 0; first < jobs.size() && sent; first++) {
+        if (done[first]) {
+            continue;
+        }
+        int capacity = (service->maxAtlasSize / jobs[first].width) * (service->maxAtlasSize / jobs[first].height);
+        std::vector<const RenderJob*> pass;
+        for (size_t idx = first; idx < jobs.size() && sent; idx++) {
+            if (!done[idx] && jobs[idx].width == jobs[first].width && jobs[idx].height == jobs[first].height) {
+                done[idx] = true;
+                pass.push_back(&jobs[idx]);
+                if ((int)pass.size() == capacity) {
+                    sent = renderAtlasPass(service, pass, draw, data);
+                    pass.clear();
+                }
+            }
+        }
+        if (!pass.empty() && sent) {
+            sent = renderAtlasPass(service, pass, draw, data);
+        }
+    }
+    service->renderSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // 4. A closed input ends the client (socket mode) or the service.
+    if (!open || !sent) {
+        if (service->listener >= 0) {
+            close(service->input);
+            service->input = service->output = -1;
+            service->pending.clear();
+        } else {
+            service->stopping = true;
+        }
+    }
+    return !service->stopping;
+}
+
+void destroyRenderService(RenderService* service) {
+    printf("Render service: %d images in %d batches (%d atlas passes), %d errors, %.1f MiB sent, "
+           "%.3f ms/image\n", service->jobCount, service->batchCount, service->passCount, service->errorCount,
+           service->sentBytes / (1024.0 * 1024.0),
+           service->jobCount > 0 ? service->renderSeconds * 1000.0 / service->jobCount : 0.0);
+
+    glDeleteFramebuffers(1, &service->fbo);
+    glDeleteRenderbuffers(1, &service->renderbuffer);
+    gpuMemoryReleaseRenderbuffers(1, &service->renderbuffer);
+
+    if (service->listener >= 0) {
+        if (service->input >= 0) {
+            close(service->input);
+        }
+        close(service->listener);
+        unlink(service->socketPath.c_str());
+    }
+}
@@ -0,0 +1,133 @@
+/**
+ * Render service: a long running offscreen renderer which takes render jobs
+ * as text lines and streams the images back, batched into atlas passes.
+ *
+ * Rendering one image per process pays the process start, the EGL display
+ * and context creation and the shader compilation for every image. The
+ * service keeps the context, the programs and the targets of the demo warm
+ * and reads the jobs from stdin or from the clients of a unix socket (one
+ * client at a time, the next one is accepted when it disconnects). A job is
+ * one line:
+ *
+ *   <id> <width>x<height> <scene> [<x> <y> <zoom>]
+ *
+ * The id is echoed in the answer, the scene and the camera (position and
+ * zoom, default: 0 0 1) are handed to the draw callback of the demo. "quit"
+ * stops the service after the jobs before it.
+ *
+ * The service waits for the first line, then takes every line which is
+ * already there (up to "maxBatch"). The jobs of the same size are drawn
+ * into the tiles of one large atlas framebuffer (viewport + scissor per
+ * tile, as many tiles as GL_MAX_RENDERBUFFER_SIZE allows), the atlas is
+ * read back with one glReadPixels and every tile is encoded (PPM, PNG, QOI
+ * or raw, see common/image_writer.h) and answered. The answers come per
+ * atlas pass (the jobs of a size in their order), the id tells them apart:
+ *
+ *   <id> <format> <bytes>\n<bytes of the image>
+ *
+ * An invalid line or an unknown scene is answered with "error <line>\n".
+ * The atlas grows to the largest batch and is kept between the batches.
+ *
+ * Usage:
+ *
+ *   RenderService service;
+ *   if (initRenderService(&service, socketPath, 0, 1, IMAGE_FILE_PPM, 64)) {
+ *       while (renderServiceStep(&service, drawJob, &scene)) {
+ *       }
+ *   }
+ *   destroyRenderService(&service);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *  * POSIX (poll, unix sockets)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_RENDER_SERVICE_H
+#define GLES_COMMON_RENDER_SERVICE_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "common/image_writer.h"
+
+struct RenderJob {
+    std::string id;
+    int width;
+    int height;
+    std::string scene;
+    float camera[3]; // x, y, zoom
+};
+
+// Draw the job into the current viewport (the tile of the job in the atlas, cleared by the callback).
+/* Returns false for an unknown scene: the job is answered with an error. */
+typedef bool (*RenderJobFunction)(const RenderJob& job, void* data);
+
+struct RenderService {
+    std::string socketPath; // empty: the "input" and "output" descriptors
+    int listener;
+    int input;
+    int output;
+    std::string pending; // the read bytes after the last complete line
+    bool stopping;
+
+    ImageFileFormat format;
+    int maxBatch;
+
+    // The atlas target, grown to the largest batch.
+    unsigned int fbo;
+    unsigned int renderbuffer;
+    int atlasWidth;
+    int atlasHeight;
+    int maxAtlasSize;
+    std::vector<uint8_t> pixels;
+    std::vector<uint8_t> tile;
+    std::vector<uint8_t> encoded;
+
+    // Statistics.
+    int jobCount;
+    int batchCount;  // the header lines read together
+    int passCount;   // the atlas passes (one per size of a batch, more if the atlas is full)
+    int errorCount;
+    size_t sentBytes;
+    double renderSeconds; // draws, readbacks and encoding
+};
+
+// Take the jobs from a unix socket (socketPath) or the "input" descriptor, the answers go to "output".
+/* Requires a current GL ES context. Returns false if the socket can't be opened. */
+bool initRenderService(RenderService* service, const char* socketPath, int input, int output,
+                       ImageFileFormat format, int maxBatch);
+
+// Wait for jobs, render them and send the answers. Returns false when the service is done
+// ("quit", the end of the input).
+bool renderServiceStep(RenderService* service, RenderJobFunction draw, void* data);
+
+// Delete the atlas, close the socket and print the statistics.
+void destroyRenderService(RenderService* service);
+
+// Parse a job line. Returns false for an invalid line.
+bool parseRenderJob(const std::string& line, RenderJob* job);
+
+#endif // GLES_COMMON_RENDER_SERVICE_H
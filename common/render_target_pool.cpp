@@ -0,0 +1,219 @@
+/**
+ * Pool of texture render targets. See render_target_pool.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/render_target_pool.h"
+#include "common/gl_handle.h"
+#include "common/gpu_memory.h"
+#include "common/render_formats.h"
+
+#include <stdio.h>
+
+#include <GLES3/gl3.h>
+
+// The attachment point of a format: depth (stencil) or color 0.
+static GLenum formatAttachment(unsigned int format) {
+    switch (format) {
+        case GL_DEPTH_COMPONENT16:
+        case GL_DEPTH_COMPONENT24:
+        case GL_DEPTH_COMPONENT32F: return GL_DEPTH_ATTACHMENT;
+        case GL_DEPTH24_STENCIL8:
+        case GL_DEPTH32F_STENCIL8: return GL_DEPTH_STENCIL_ATTACHMENT;
+        default: return GL_COLOR_ATTACHMENT0;
+    }
+}
+
+static bool sameKey(const RenderTargetKey& lhs, const RenderTargetKey& rhs) {
+    return lhs.kind == rhs.kind && lhs.format == rhs.format && lhs.width == rhs.width
+        && lhs.height == rhs.height && lhs.samples == rhs.samples;
+}
+
+static int64_t targetMemory(const RenderTarget* target) {
+    int samples = target->key.samples > 1 ? target->key.samples : 1;
+    return (int64_t)target->key.width * target->key.height * samples * renderTargetBytesPerPixel(target->key.format);
+}
+
+// The frames in flight may still render into the target (ex.: the targets released after a resize).
+static void deleteRenderTarget(RenderTarget* target) {
+    deferGlDelete(GL_OBJECT_FRAMEBUFFER, target->fbo);
+    deferGlDelete(GL_OBJECT_TEXTURE, target->texture);
+    deferGlDelete(GL_OBJECT_RENDERBUFFER, target->renderbuffer);
+    delete target;
+}
+
+static RenderTarget* createRenderTarget(const RenderTargetKey& key) {
+    if (key.kind == RENDER_TARGET_TEXTURE && key.samples > 0) {
+        printf("Render target pool: multisampled textures are not supported, use a renderbuffer\n");
+        return NULL;
+    }
+
+    RenderTarget* target = new RenderTarget();
+    target->key = key;
+    target->texture = 0;
+    target->renderbuffer = 0;
+    target->inUse = false;
+    target->lastUsedFrame = 0;
+
+    // 1. Immutable storage: the size and format never change, a resize acquires a new target.
+    if (key.kind == RENDER_TARGET_TEXTURE) {
+        GLenum filter = formatAttachment(key.format) == GL_COLOR_ATTACHMENT0 ? GL_LINEAR : GL_NEAREST;
+
+        glGenTextures(1, &target->texture);
+        glBindTexture(GL_TEXTURE_2D, target->texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, key.format, key.width, key.height);
+        gpuMemoryTrackTexture(target->texture, key.format, key.width, key.height, 1, 1, GPU_MEMORY_RENDER_TARGET,
+                              "render target pool");
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    } else {
+        glGenRenderbuffers(1, &target->renderbuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, target->renderbuffer);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, key.samples, key.format, key.width, key.height);
+        gpuMemoryTrackRenderbuffer(target->renderbuffer, key.format, key.width, key.height, key.samples,
+                                   "render target pool");
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    }
+
+    // 2. FBO with the target as the only attachment.
+    /* The current framebuffer binding is kept. */
+    GLint previousFbo;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFbo);
+
+    glGenFramebuffers(1, &target->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+    attachRenderTarget(target);
+
+    GLenum fboResult = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+
+    if (fboResult != GL_FRAMEBUFFER_COMPLETE) {
+        printf("Render target pool: %dx%d target (format: 0x%x, samples: %d) is not complete (0x%x)\n",
+               key.width, key.height, key.format, key.samples, fboResult);
+        deleteRenderTarget(target);
+        return NULL;
+    }
+
+    return target;
+}
+
+void initRenderTargetPool(RenderTargetPool* pool) {
+    pool->targets.clear();
+    pool->frame = 0;
+    pool->allocations = 0;
+    pool->peakMemory = 0;
+}
+
+void destroyRenderTargetPool(RenderTargetPool* pool) {
+    for (size_t idx = 0; idx < pool->targets.size(); idx++) {
+        deleteRenderTarget(pool->targets[idx]);
+    }
+    pool->targets.clear();
+}
+
+RenderTarget* acquireRenderTarget(RenderTargetPool* pool, const RenderTargetKey& key) {
+    for (size_t idx = 0; idx < pool->targets.size(); idx++) {
+        RenderTarget* target = pool->targets[idx];
+        if (!target->inUse && sameKey(target->key, key)) {
+            target->inUse = true;
+            target->lastUsedFrame = pool->frame;
+            return target;
+        }
+    }
+
+    RenderTarget* target = createRenderTarget(key);
+    if (target != NULL) {
+        target->inUse = true;
+        target->lastUsedFrame = pool->frame;
+        pool->targets.push_back(target);
+
+        pool->allocations++;
+        int64_t memory = renderTargetPoolMemory(pool);
+        if (memory > pool->peakMemory) {
+            pool->peakMemory = memory;
+        }
+    }
+    return target;
+}
+
+RenderTarget* acquireRenderTarget(RenderTargetPool* pool, unsigned int format, int width, int height) {
+    RenderTargetKey key = { RENDER_TARGET_TEXTURE, format, width, height, 0 };
+    return acquireRenderTarget(pool, key);
+}
+
+void releaseRenderTarget(RenderTargetPool* pool, RenderTarget* target) {
+    if (target != NULL) {
+        target->inUse = false;
+        target->lastUsedFrame = pool->frame;
+    }
+}
+
+void renderTargetPoolEndFrame(RenderTargetPool* pool) {
+    pool->frame++;
+
+    /* The GL keeps the objects alive until the GPU is done with them. */
+    for (size_t idx = 0; idx < pool->targets.size();) {
+        RenderTarget* target = pool->targets[idx];
+        if (!target->inUse && pool->frame - target->lastUsedFrame > RENDER_TARGET_POOL_IDLE_FRAMES) {
+            deleteRenderTarget(target);
+            pool->targets.erase(pool->targets.begin() + idx);
+        } else {
+            idx++;
+        }
+    }
+}
+
+void attachRenderTarget(const RenderTarget* target) {
+    GLenum attachment = formatAttachment(target->key.format);
+
+    /* A depth only target replacing a depth-stencil one: the old stencil image must go too. */
+    if (attachment == GL_DEPTH_ATTACHMENT) {
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_RENDERBUFFER, 0);
+    }
+    if (target->key.kind == RENDER_TARGET_TEXTURE) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, target->texture, 0);
+    } else {
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, target->renderbuffer);
+    }
+}
+
+int64_t renderTargetPoolMemory(const RenderTargetPool* pool) {
+    int64_t size = 0;
+    for (size_t idx = 0; idx < pool->targets.size(); idx++) {
+        size += targetMemory(pool->targets[idx]);
+    }
+    return size;
+}
+
+void printRenderTargetPoolStats(const RenderTargetPool* pool) {
+    printf("Render target pool: %d targets, %.2f MiB (peak: %.2f MiB), %d allocations in %d frames\n",
+           (int)pool->targets.size(), renderTargetPoolMemory(pool) / (1024.0 * 1024.0),
+           pool->peakMemory / (1024.0 * 1024.0), pool->allocations, pool->frame);
+}
+
+int renderTargetBytesPerPixel(unsigned int format) {
+    const RenderFormat* renderFormat = findRenderFormat(format);
+    return renderFormat != NULL ? renderFormat->bytesPerPixel : 4;
+}
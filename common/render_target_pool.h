@@ -0,0 +1,120 @@
+/**
+ * Pool of render targets (texture or renderbuffer + FBO) reused between passes and frames.
+ *
+ * A target is acquired for the pass which renders into it and released when
+ * the last pass which samples it is done. A released target is handed out
+ * again for the next request with the same key (kind, format, size, samples),
+ * so a chain of passes only allocates as many targets as are alive at the
+ * same time.
+ *
+ * The demos acquire their attachments every frame with the current
+ * framebuffer size: after a window resize the new size is allocated on the
+ * first request and the targets of the old size are deleted once they were
+ * not used for RENDER_TARGET_POOL_IDLE_FRAMES frames (renderTargetPoolEndFrame).
+ *
+ * Usage:
+ *
+ *   RenderTargetPool pool;
+ *   initRenderTargetPool(&pool);
+ *   while (...) {
+ *       RenderTarget* target = acquireRenderTarget(&pool, GL_RGBA8, width / 2, height / 2);
+ *       ... render into target->fbo, sample target->texture ...
+ *       releaseRenderTarget(&pool, target);
+ *       renderTargetPoolEndFrame(&pool);
+ *   }
+ *   destroyRenderTargetPool(&pool);
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_RENDER_TARGET_POOL_H
+#define GLES_COMMON_RENDER_TARGET_POOL_H
+
+#include <stdint.h>
+
+#include <vector>
+
+// Free targets are deleted after this many frames without use.
+#define RENDER_TARGET_POOL_IDLE_FRAMES 3
+
+enum RenderTargetKind {
+    RENDER_TARGET_TEXTURE,
+    RENDER_TARGET_RENDERBUFFER,
+};
+
+struct RenderTargetKey {
+    RenderTargetKind kind;
+    unsigned int format; // sized internal format (ex.: GL_RGBA8, GL_DEPTH_COMPONENT24)
+    int width;
+    int height;
+    int samples;         // 0: single sampled (multisampling is only supported for renderbuffers)
+};
+
+struct RenderTarget {
+    RenderTargetKey key;
+    unsigned int texture;      // RENDER_TARGET_TEXTURE
+    unsigned int renderbuffer; // RENDER_TARGET_RENDERBUFFER
+    unsigned int fbo;          // FBO with this target as its only (color or depth) attachment
+    bool inUse;
+    int lastUsedFrame;
+};
+
+struct RenderTargetPool {
+    std::vector<RenderTarget*> targets;
+    int frame;
+
+    // Statistics.
+    int allocations;
+    int64_t peakMemory;
+};
+
+void initRenderTargetPool(RenderTargetPool* pool);
+
+// Delete every target (acquired ones too).
+void destroyRenderTargetPool(RenderTargetPool* pool);
+
+// Return a free target with the given key, a new one is created if there is none.
+/* Textures use linear filtering (nearest for depth formats) and clamp to the edge.
+ * Returns NULL if the target can't be created or its FBO is not complete. */
+RenderTarget* acquireRenderTarget(RenderTargetPool* pool, const RenderTargetKey& key);
+
+// Single sampled color texture target.
+RenderTarget* acquireRenderTarget(RenderTargetPool* pool, unsigned int format, int width, int height);
+
+// Give the target back to the pool, it can be acquired again by the next pass.
+void releaseRenderTarget(RenderTargetPool* pool, RenderTarget* target);
+
+// Delete the free targets which were not used in the last RENDER_TARGET_POOL_IDLE_FRAMES frames.
+void renderTargetPoolEndFrame(RenderTargetPool* pool);
+
+// Attach the target to the currently bound GL_FRAMEBUFFER (at the color 0 or the depth (stencil) attachment).
+void attachRenderTarget(const RenderTarget* target);
+
+// Number of bytes allocated for the targets of the pool.
+int64_t renderTargetPoolMemory(const RenderTargetPool* pool);
+
+// Print the number of targets, their memory and the allocation statistics.
+void printRenderTargetPoolStats(const RenderTargetPool* pool);
+
+// Bytes per pixel of a sized color or depth format (4 for unknown formats).
+int renderTargetBytesPerPixel(unsigned int format);
+
+#endif // GLES_COMMON_RENDER_TARGET_POOL_H
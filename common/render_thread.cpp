@@ -0,0 +1,211 @@
+/**
+ * Render thread, see render_thread.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/render_thread.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <GLFW/glfw3.h>
+
+#include "common/demo_context.h"
+#include "common/startup_profile.h"
+#include "common/time_source.h"
+
+struct RenderThread {
+    DemoContext* demo;
+    RenderThreadFunction render;
+    void* user;
+
+    // Packet of frame N: packets[N % 2].
+    std::vector<uint8_t> packets[2];
+
+    // The frames handed over by the main thread and the frames whose packet the render thread finished.
+    std::atomic<int> submitted;
+    std::atomic<int> released;
+    std::atomic<bool> stopping;
+    std::atomic<int> state; // 0: starting, 1: running, -1: the context can't be made current
+
+    /* Only to sleep while the other thread is a whole frame behind: the handover itself is the counters. */
+    std::atomic<int> sleepers;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    std::thread thread;
+
+    double mainWaitSeconds;   // main thread, in renderThreadBeginFrame
+    double renderWaitSeconds; // render thread, before a frame
+};
+
+static double steadyTime() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Wake the other thread if it sleeps (after a counter changed).
+static void wakeThreads(RenderThread* thread) {
+    if (thread->sleepers.load() > 0) {
+        std::lock_guard<std::mutex> lock(thread->sleepMutex);
+        thread->wake.notify_all();
+    }
+}
+
+// Wait until the condition is true, returns the waiting time.
+template<typename Condition>
+static double waitFor(RenderThread* thread, Condition condition) {
+    if (condition()) {
+        return 0.0;
+    }
+
+    double startTime = steadyTime();
+    /* A few yields first: the other thread is usually about to finish its frame. */
+    for (int spin = 0; spin < 64; spin++) {
+        std::this_thread::yield();
+        if (condition()) {
+            return steadyTime() - startTime;
+        }
+    }
+
+    thread->sleepers++;
+    {
+        std::unique_lock<std::mutex> lock(thread->sleepMutex);
+        thread->wake.wait(lock, condition);
+    }
+    thread->sleepers--;
+    return steadyTime() - startTime;
+}
+
+static void renderLoop(RenderThread* thread) {
+    DemoContext* demo = thread->demo;
+
+    thread->state = demoMakeCurrent(demo, true) ? 1 : -1;
+    wakeThreads(thread);
+    if (thread->state < 0) {
+        return;
+    }
+
+    for (int frame = 0;; frame++) {
+        thread->renderWaitSeconds += waitFor(thread, [thread, frame]() {
+            return thread->submitted.load() > frame || thread->stopping.load();
+        });
+        if (thread->submitted.load() <= frame) {
+            break;
+        }
+
+        thread->render(demo, thread->packets[frame % 2].data(), frame, thread->user);
+
+        /* The packet is free for frame + 2 before the swap: the simulation overlaps the vsync block. */
+        thread->released = frame + 1;
+        wakeThreads(thread);
+
+        demoSwapBuffers(demo);
+    }
+
+    demoMakeCurrent(demo, false);
+}
+
+RenderThread* createRenderThread(DemoContext* demo, size_t packetSize, RenderThreadFunction render, void* user) {
+    if (demo->lowLatency || demo->idleLoop || demo->robust) {
+        printf("Render thread: can't be combined with --low-latency, --idle or --robust\n");
+        return NULL;
+    }
+
+    RenderThread* thread = new RenderThread();
+    thread->demo = demo;
+    thread->render = render;
+    thread->user = user;
+    thread->packets[0].assign(packetSize, 0);
+    thread->packets[1].assign(packetSize, 0);
+    thread->submitted = 0;
+    thread->released = 0;
+    thread->stopping = false;
+    thread->state = 0;
+    thread->sleepers = 0;
+    thread->mainWaitSeconds = 0.0;
+    thread->renderWaitSeconds = 0.0;
+
+    // 1. The setup is finished: the first frame phase starts (its GPU timestamp needs the context here).
+    startupPhase("first frame");
+
+    // 2. Move the context to the render thread.
+    demoMakeCurrent(demo, false);
+    thread->thread = std::thread(renderLoop, thread);
+    waitFor(thread, [thread]() { return thread->state.load() != 0; });
+
+    if (thread->state < 0) {
+        printf("Render thread: the context can't be made current on the thread\n");
+        thread->thread.join();
+        demoMakeCurrent(demo, true);
+        delete thread;
+        return NULL;
+    }
+    return thread;
+}
+
+void destroyRenderThread(RenderThread* thread) {
+    thread->stopping = true;
+    wakeThreads(thread);
+    thread->thread.join();
+
+    demoMakeCurrent(thread->demo, true);
+
+    int frames = thread->submitted;
+    if (frames > 0) {
+        printf("Render thread: %d frames, main thread waited %.3f ms/frame (render bound), "
+               "render thread waited %.3f ms/frame (simulation bound)\n", frames,
+               thread->mainWaitSeconds * 1000.0 / frames, thread->renderWaitSeconds * 1000.0 / frames);
+    }
+    delete thread;
+}
+
+void* renderThreadBeginFrame(RenderThread* thread) {
+    int frame = thread->submitted.load();
+    /* The packet was used by frame - 2: the render thread must be done with it. */
+    thread->mainWaitSeconds += waitFor(thread, [thread, frame]() { return thread->released.load() >= frame - 1; });
+    return thread->packets[frame % 2].data();
+}
+
+void renderThreadSubmit(RenderThread* thread) {
+    thread->submitted++;
+    wakeThreads(thread);
+}
+
+bool renderThreadShouldClose(RenderThread* thread) {
+    const DemoContext* demo = thread->demo;
+    if (demo->frameLimit > 0 && thread->submitted.load() >= demo->frameLimit) {
+        return true;
+    }
+    /* glfwWindowShouldClose can be called from any thread. */
+    return !demo->headless && glfwWindowShouldClose(demo->window);
+}
+
+double renderThreadAnimationTime(const RenderThread* thread) {
+    return timeSourceFrameTime(thread->demo->timeSource, thread->submitted.load(), demoGetTime(thread->demo));
+}
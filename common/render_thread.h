@@ -0,0 +1,90 @@
+/**
+ * Render thread: the GL submission of the frames on a dedicated thread.
+ *
+ * The main thread keeps the GLFW events and the simulation, the render thread
+ * owns the context (made current on it by createRenderThread) and calls the
+ * render function and demoSwapBuffers for every frame. The two threads share
+ * a double-buffered frame packet: the main thread writes the packet of frame
+ * N + 1 while the render thread draws frame N from the other one, so the
+ * simulation and the GL submission (and the vsync block of the swap) overlap.
+ * The packets are handed over with atomic frame counters, no lock: a thread
+ * only sleeps when the other one is a whole frame behind (the main thread
+ * can't overwrite a packet in use, the render thread has nothing to draw).
+ *
+ * The render function only reads its packet and the GL objects: every state
+ * the simulation changes goes through the packet. The main thread must not
+ * call GL while the render thread runs (destroyRenderThread makes the context
+ * current on it again). The frame count of the DemoContext belongs to the
+ * render thread: the loop uses renderThreadShouldClose and
+ * renderThreadAnimationTime instead of demoShouldClose and demoAnimationTime.
+ * Not with "--low-latency", "--idle" or "--robust" (they wait or recreate the
+ * context in the swap).
+ *
+ * Usage:
+ *
+ *   RenderThread* thread = createRenderThread(&demo, sizeof(Packet), renderFrame, &scene);
+ *   while (!renderThreadShouldClose(thread)) {
+ *       demoPollEvents(&demo);
+ *       Packet* packet = (Packet*)renderThreadBeginFrame(thread); // might wait for the render thread
+ *       update(packet, renderThreadAnimationTime(thread));
+ *       renderThreadSubmit(thread);
+ *   }
+ *   destroyRenderThread(thread);  // draws the submitted frames, prints the wait times
+ *
+ * Dependencies:
+ *  * C++11 (std::thread)
+ *  * GLFW 3.0+ or EGL (the context of demo_context.h)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_RENDER_THREAD_H
+#define GLES_COMMON_RENDER_THREAD_H
+
+#include <stddef.h>
+
+struct DemoContext;
+struct RenderThread;
+
+// Draw the frame of the packet (called on the render thread, demoSwapBuffers is called after it).
+typedef void (*RenderThreadFunction)(DemoContext* demo, const void* packet, int frame, void* user);
+
+// Release the context on the calling thread and start the render thread with it.
+/* The packets are "packetSize" bytes, zeroed at the start. Returns NULL (and the context stays current)
+ * if the demo options don't allow a render thread or the context can't be moved to the thread. */
+RenderThread* createRenderThread(DemoContext* demo, size_t packetSize, RenderThreadFunction render, void* user);
+
+// Draw the submitted frames, stop the thread, make the context current again and print the wait times.
+void destroyRenderThread(RenderThread* thread);
+
+// The packet of the next frame: waits until the render thread finished reading it (two frames ago).
+void* renderThreadBeginFrame(RenderThread* thread);
+
+// Hand the packet of renderThreadBeginFrame over to the render thread.
+void renderThreadSubmit(RenderThread* thread);
+
+// The window was closed or every frame of the frame limit was submitted.
+bool renderThreadShouldClose(RenderThread* thread);
+
+// Time of the animations in the frame being simulated (the next submitted frame).
+double renderThreadAnimationTime(const RenderThread* thread);
+
+#endif // GLES_COMMON_RENDER_THREAD_H
@@ -0,0 +1,167 @@
+/**
+ * Shared sampler object cache and texture filter modes.
+ * See sampler_cache.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/sampler_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+struct CachedSampler {
+    SamplerDesc desc;
+    GLuint sampler;
+};
+
+static std::vector<CachedSampler> samplers;
+static float anisotropyLimit = 0.0f; // 0: not queried yet
+
+const char* samplerFilterNames[SAMPLER_FILTER_COUNT] = {
+    "point", "bilinear", "point-mip", "bilinear-mip", "trilinear",
+};
+
+static const int filterModes[SAMPLER_FILTER_COUNT][2] = {
+    { GL_NEAREST, GL_NEAREST },
+    { GL_LINEAR, GL_LINEAR },
+    { GL_NEAREST_MIPMAP_NEAREST, GL_NEAREST },
+    { GL_LINEAR_MIPMAP_NEAREST, GL_LINEAR },
+    { GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR },
+};
+
+bool samplerFilterDesc(const char* name, SamplerDesc* desc) {
+    for (int idx = 0; idx < SAMPLER_FILTER_COUNT; idx++) {
+        if (strcmp(name, samplerFilterNames[idx]) == 0) {
+            desc->minFilter = filterModes[idx][0];
+            desc->magFilter = filterModes[idx][1];
+            desc->wrap = GL_REPEAT;
+            desc->anisotropy = 1.0f;
+            desc->minLod = -1000.0f;
+            desc->maxLod = 1000.0f;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* samplerFilterName(const SamplerDesc& desc) {
+    for (int idx = 0; idx < SAMPLER_FILTER_COUNT; idx++) {
+        if (desc.minFilter == filterModes[idx][0] && desc.magFilter == filterModes[idx][1]) {
+            return samplerFilterNames[idx];
+        }
+    }
+    return "custom";
+}
+
+bool parseSamplerOptions(int argc, char** argv, SamplerDesc* desc, float* lodBias) {
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--filter") == 0 && idx + 1 < argc) {
+            /* Keep the wrap mode of the default, only the filters change. */
+            SamplerDesc named;
+            if (!samplerFilterDesc(argv[++idx], &named)) {
+                printf("Sampler: unknown filter mode '%s' (point, bilinear, point-mip, bilinear-mip, trilinear)\n",
+                       argv[idx]);
+                return false;
+            }
+            desc->minFilter = named.minFilter;
+            desc->magFilter = named.magFilter;
+        } else if (strcmp(argv[idx], "--anisotropy") == 0 && idx + 1 < argc) {
+            desc->anisotropy = (float)atof(argv[++idx]);
+            if (desc->anisotropy < 1.0f || desc->anisotropy > 16.0f) {
+                printf("Sampler: invalid anisotropy (valid range: 1-16)\n");
+                return false;
+            }
+        } else if (strcmp(argv[idx], "--lod-bias") == 0 && idx + 1 < argc) {
+            float bias = (float)atof(argv[++idx]);
+            if (lodBias != NULL) {
+                *lodBias = bias;
+            }
+        } else if (strcmp(argv[idx], "--min-lod") == 0 && idx + 1 < argc) {
+            desc->minLod = (float)atof(argv[++idx]);
+        }
+    }
+    return true;
+}
+
+float maxSamplerAnisotropy() {
+    if (anisotropyLimit == 0.0f) {
+        anisotropyLimit = 1.0f;
+
+        int count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (int idx = 0; idx < count; idx++) {
+            if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, idx), "GL_EXT_texture_filter_anisotropic") == 0) {
+                glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &anisotropyLimit);
+                break;
+            }
+        }
+    }
+    return anisotropyLimit;
+}
+
+unsigned int getCachedSampler(const SamplerDesc& request) {
+    SamplerDesc desc = request;
+    float limit = maxSamplerAnisotropy();
+    desc.anisotropy = desc.anisotropy < 1.0f ? 1.0f : (desc.anisotropy > limit ? limit : desc.anisotropy);
+
+    for (size_t idx = 0; idx < samplers.size(); idx++) {
+        const SamplerDesc& cached = samplers[idx].desc;
+        if (cached.minFilter == desc.minFilter && cached.magFilter == desc.magFilter && cached.wrap == desc.wrap
+            && cached.anisotropy == desc.anisotropy && cached.minLod == desc.minLod && cached.maxLod == desc.maxLod) {
+            return samplers[idx].sampler;
+        }
+    }
+
+    CachedSampler entry;
+    entry.desc = desc;
+    glGenSamplers(1, &entry.sampler);
+    glSamplerParameteri(entry.sampler, GL_TEXTURE_MIN_FILTER, desc.minFilter);
+    glSamplerParameteri(entry.sampler, GL_TEXTURE_MAG_FILTER, desc.magFilter);
+    glSamplerParameteri(entry.sampler, GL_TEXTURE_WRAP_S, desc.wrap);
+    glSamplerParameteri(entry.sampler, GL_TEXTURE_WRAP_T, desc.wrap);
+    glSamplerParameterf(entry.sampler, GL_TEXTURE_MIN_LOD, desc.minLod);
+    glSamplerParameterf(entry.sampler, GL_TEXTURE_MAX_LOD, desc.maxLod);
+    if (limit > 1.0f) {
+        glSamplerParameterf(entry.sampler, GL_TEXTURE_MAX_ANISOTROPY_EXT, desc.anisotropy);
+    }
+
+    samplers.push_back(entry);
+    return entry.sampler;
+}
+
+int samplerCacheSize() {
+    return (int)samplers.size();
+}
+
+void destroySamplerCache() {
+    for (size_t idx = 0; idx < samplers.size(); idx++) {
+        glDeleteSamplers(1, &samplers[idx].sampler);
+    }
+    samplers.clear();
+    anisotropyLimit = 0.0f;
+}
@@ -0,0 +1,94 @@
+/**
+ * Sampler objects: shared sampler cache, texture filter modes and anisotropy.
+ *
+ * The filter and wrap state is not set on every texture (glTexParameteri)
+ * but on sampler objects bound to the texture units (glBindSampler), which
+ * override the texture parameters. getCachedSampler returns the same sampler
+ * for the same description: a scene with many textures uses a few samplers
+ * and changing the quality of every texture is changing a few objects.
+ *
+ * Named filter modes (cheapest first):
+ *
+ *   point         GL_NEAREST, no mip levels
+ *   bilinear      GL_LINEAR, no mip levels
+ *   point-mip     GL_NEAREST_MIPMAP_NEAREST
+ *   bilinear-mip  GL_LINEAR_MIPMAP_NEAREST
+ *   trilinear     GL_LINEAR_MIPMAP_LINEAR
+ *
+ * The anisotropy (GL_EXT_texture_filter_anisotropic) is clamped to the limit
+ * of the driver and ignored without the extension. OpenGL ES samplers have
+ * no LOD bias state: the bias is a parameter of the texture() call of the
+ * shader (parsed here with the other options), GL_TEXTURE_MIN_LOD and
+ * GL_TEXTURE_MAX_LOD clamp the level range of the sampler.
+ *
+ * Command line options (parseSamplerOptions):
+ *  --filter NAME      One of the modes above.
+ *  --anisotropy N     Maximum anisotropy (1: off).
+ *  --lod-bias B       Level of detail bias of the shader (negative: sharper).
+ *  --min-lod L        Finest mip level used by the sampler.
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_SAMPLER_CACHE_H
+#define GLES_COMMON_SAMPLER_CACHE_H
+
+struct SamplerDesc {
+    int minFilter;    // GL_NEAREST .. GL_LINEAR_MIPMAP_LINEAR
+    int magFilter;    // GL_NEAREST or GL_LINEAR
+    int wrap;         // GL_TEXTURE_WRAP_S and T
+    float anisotropy; // 1: off
+    float minLod;
+    float maxLod;
+};
+
+// The named filter modes, cheapest first.
+#define SAMPLER_FILTER_COUNT 5
+extern const char* samplerFilterNames[SAMPLER_FILTER_COUNT];
+
+// Description of a named filter mode with GL_REPEAT wrap and no anisotropy. Returns false for an unknown name.
+bool samplerFilterDesc(const char* name, SamplerDesc* desc);
+
+// Name of the filter mode of the description (ignoring the other state), "custom" if it has none.
+const char* samplerFilterName(const SamplerDesc& desc);
+
+// Parse the "--filter", "--anisotropy", "--lod-bias" and "--min-lod" options on top of the defaults in "desc".
+/* Prints the error and returns false for an invalid value. "lodBias" may be NULL. */
+bool parseSamplerOptions(int argc, char** argv, SamplerDesc* desc, float* lodBias);
+
+// The maximum anisotropy of the driver, 1 without GL_EXT_texture_filter_anisotropic.
+float maxSamplerAnisotropy();
+
+// The sampler object of the description, created at the first use.
+/* The anisotropy is clamped first: requests above the limit of the driver share one sampler. */
+unsigned int getCachedSampler(const SamplerDesc& desc);
+
+// Number of sampler objects in the cache.
+int samplerCacheSize();
+
+// Delete every sampler of the cache (unbinds them from the texture units).
+void destroySamplerCache();
+
+#endif // GLES_COMMON_SAMPLER_CACHE_H
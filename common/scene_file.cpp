@@ -0,0 +1,386 @@
+/**
+ * Memory mapped scene files, see scene_file.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/scene_file.h"
+
+#include <fcntl.h>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "common/frustum_culling.h"
+
+// Meshes whose reads are requested ahead of the uploads by sceneStreamMeshes.
+#define SCENE_PREFETCH_MESHES 8
+
+static size_t alignSceneOffset(size_t offset) {
+    return (offset + SCENE_FILE_ALIGNMENT - 1) & ~(size_t)(SCENE_FILE_ALIGNMENT - 1);
+}
+
+// Apply an madvise hint to the pages of a blob (the start is rounded down to the page).
+static void adviseBlob(const Scene* scene, const SceneFileMesh& mesh, int advice) {
+    static const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = (size_t)mesh.offset & ~(pageSize - 1);
+    madvise((void*)(scene->data + start), (size_t)(mesh.offset + mesh.size - start), advice);
+}
+
+static bool tableInFile(size_t fileSize, uint64_t offset, uint32_t count, size_t entrySize) {
+    return offset % 8 == 0 && offset <= fileSize && (uint64_t)count * entrySize <= fileSize - offset;
+}
+
+// The world box of the local box: the center is transformed, the extent by the absolute matrix.
+static void transformBounds(const float* world, const float* localMin, const float* localMax, float* worldMin,
+                            float* worldMax) {
+    for (int row = 0; row < 3; row++) {
+        float center = world[12 + row];
+        float extent = 0.0f;
+        for (int col = 0; col < 3; col++) {
+            float localCenter = (localMin[col] + localMax[col]) * 0.5f;
+            float localExtent = (localMax[col] - localMin[col]) * 0.5f;
+            center += world[col * 4 + row] * localCenter;
+            extent += fabsf(world[col * 4 + row]) * localExtent;
+        }
+        worldMin[row] = center - extent;
+        worldMax[row] = center + extent;
+    }
+}
+
+// Build the subtree of the items [first, first + count) into the (already allocated) node.
+static void buildBvhNode(Scene* scene, int nodeIndex, int first, int count) {
+    // 1. The bounds of the items and of their centers.
+    float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    float centerMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float centerMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (int idx = first; idx < first + count; idx++) {
+        int item = scene->bvhItems[idx];
+        for (int axis = 0; axis < 3; axis++) {
+            float itemMin = scene->boundsMin[item * 3 + axis];
+            float itemMax = scene->boundsMax[item * 3 + axis];
+            boundsMin[axis] = std::min(boundsMin[axis], itemMin);
+            boundsMax[axis] = std::max(boundsMax[axis], itemMax);
+            centerMin[axis] = std::min(centerMin[axis], (itemMin + itemMax) * 0.5f);
+            centerMax[axis] = std::max(centerMax[axis], (itemMin + itemMax) * 0.5f);
+        }
+    }
+
+    SceneBvhNode node;
+    memcpy(node.boundsMin, boundsMin, sizeof(boundsMin));
+    memcpy(node.boundsMax, boundsMax, sizeof(boundsMax));
+    if (count <= SCENE_BVH_LEAF_SIZE) {
+        node.first = first;
+        node.count = count;
+        scene->bvh[nodeIndex] = node;
+        return;
+    }
+
+    // 2. Split at the median of the centers along the longest axis, the children are allocated next to each other.
+    int axis = 0;
+    for (int other = 1; other < 3; other++) {
+        if (centerMax[other] - centerMin[other] > centerMax[axis] - centerMin[axis]) {
+            axis = other;
+        }
+    }
+    const std::vector<float>& itemMin = scene->boundsMin;
+    const std::vector<float>& itemMax = scene->boundsMax;
+    int half = count / 2;
+    std::nth_element(scene->bvhItems.begin() + first, scene->bvhItems.begin() + first + half,
+                     scene->bvhItems.begin() + first + count, [&](int a, int b) {
+                         return itemMin[a * 3 + axis] + itemMax[a * 3 + axis] < itemMin[b * 3 + axis] + itemMax[b * 3 + axis];
+                     });
+
+    node.first = (int)scene->bvh.size();
+    node.count = 0;
+    scene->bvh.push_back(SceneBvhNode());
+    scene->bvh.push_back(SceneBvhNode());
+    scene->bvh[nodeIndex] = node;
+
+    buildBvhNode(scene, node.first, first, half);
+    buildBvhNode(scene, node.first + 1, first + half, count - half);
+}
+
+bool openScene(Scene* scene, const char* path) {
+    scene->data = NULL;
+    scene->size = 0;
+    scene->nodes = NULL;
+    scene->meshes = NULL;
+    scene->materials = NULL;
+    scene->nodeCount = 0;
+    scene->meshCount = 0;
+    scene->materialCount = 0;
+    scene->residentMeshes = 0;
+    scene->residentBytes = 0;
+
+    // 1. Map the whole file without reading it ahead: the mesh blobs are read in the order of the streaming.
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("Scene: unable to open '%s'\n", path);
+        return false;
+    }
+
+    struct stat info;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("Scene: unable to map '%s'\n", path);
+        return false;
+    }
+    madvise(data, info.st_size, MADV_RANDOM);
+
+    scene->data = (const uint8_t*)data;
+    scene->size = info.st_size;
+
+    // 2. Check the header, the tables and the references.
+    const SceneFileHeader* header = (const SceneFileHeader*)scene->data;
+    bool valid = scene->size >= sizeof(SceneFileHeader)
+              && memcmp(header->magic, SCENE_FILE_MAGIC, sizeof(header->magic)) == 0
+              && header->version == SCENE_FILE_VERSION
+              && tableInFile(scene->size, header->nodeOffset, header->nodeCount, sizeof(SceneFileNode))
+              && tableInFile(scene->size, header->meshOffset, header->meshCount, sizeof(SceneFileMesh))
+              && tableInFile(scene->size, header->materialOffset, header->materialCount, sizeof(SceneFileMaterial));
+
+    if (valid) {
+        scene->nodes = (const SceneFileNode*)(scene->data + header->nodeOffset);
+        scene->meshes = (const SceneFileMesh*)(scene->data + header->meshOffset);
+        scene->materials = (const SceneFileMaterial*)(scene->data + header->materialOffset);
+        scene->nodeCount = header->nodeCount;
+        scene->meshCount = header->meshCount;
+        scene->materialCount = header->materialCount;
+
+        for (int idx = 0; idx < scene->meshCount && valid; idx++) {
+            const SceneFileMesh& mesh = scene->meshes[idx];
+            valid = mesh.offset % SCENE_FILE_ALIGNMENT == 0 && mesh.offset <= scene->size
+                 && mesh.size >= sizeof(MeshStreams) && mesh.size <= scene->size - mesh.offset;
+        }
+        for (int idx = 0; idx < scene->nodeCount && valid; idx++) {
+            const SceneFileNode& node = scene->nodes[idx];
+            valid = node.parent < idx && node.parent >= -1 && node.mesh < scene->meshCount && node.mesh >= -1
+                 && node.material < scene->materialCount && node.material >= -1;
+        }
+    }
+
+    if (!valid) {
+        printf("Scene: '%s' is not a valid (version %d) scene file\n", path, SCENE_FILE_VERSION);
+        closeScene(scene);
+        return false;
+    }
+
+    // 3. The world transforms of the nodes.
+    scene->transforms = TransformHierarchy();
+    for (int idx = 0; idx < scene->nodeCount; idx++) {
+        const SceneFileNode& node = scene->nodes[idx];
+        addTransformNode(&scene->transforms, node.parent);
+        setTransformNode(&scene->transforms, idx, node.translation, node.rotation, node.scale);
+    }
+    static const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    updateTransformHierarchy(&scene->transforms, identity, NULL);
+
+    // 4. The world bounds of the mesh nodes and the BVH over them.
+    scene->boundsMin.assign((size_t)scene->nodeCount * 3, FLT_MAX);
+    scene->boundsMax.assign((size_t)scene->nodeCount * 3, -FLT_MAX);
+    scene->bvhItems.clear();
+    for (int idx = 0; idx < scene->nodeCount; idx++) {
+        int mesh = scene->nodes[idx].mesh;
+        if (mesh >= 0) {
+            transformBounds(&scene->transforms.world[idx * 16], scene->meshes[mesh].boundsMin,
+                            scene->meshes[mesh].boundsMax, &scene->boundsMin[idx * 3], &scene->boundsMax[idx * 3]);
+            scene->bvhItems.push_back(idx);
+        }
+    }
+    scene->bvh.clear();
+    scene->bvh.reserve(scene->bvhItems.size() * 2 / SCENE_BVH_LEAF_SIZE + 1);
+    scene->bvh.push_back(SceneBvhNode());
+    buildBvhNode(scene, 0, 0, (int)scene->bvhItems.size());
+
+    scene->meshBuffers.assign(scene->meshCount, MeshBuffers());
+    scene->meshResident.assign(scene->meshCount, 0);
+    scene->meshPrefetched.assign(scene->meshCount, 0);
+    return true;
+}
+
+void closeScene(Scene* scene) {
+    for (int idx = 0; idx < (int)scene->meshResident.size(); idx++) {
+        if (scene->meshResident[idx]) {
+            destroyMeshBuffers(&scene->meshBuffers[idx]);
+        }
+    }
+    scene->meshBuffers.clear();
+    scene->meshResident.clear();
+    scene->meshPrefetched.clear();
+    scene->residentMeshes = 0;
+    scene->residentBytes = 0;
+
+    if (scene->data != NULL) {
+        munmap((void*)scene->data, scene->size);
+    }
+    scene->data = NULL;
+    scene->size = 0;
+    scene->nodes = NULL;
+    scene->meshes = NULL;
+    scene->materials = NULL;
+    scene->nodeCount = 0;
+    scene->meshCount = 0;
+    scene->materialCount = 0;
+}
+
+// Squared distance of the point to the box (0 inside).
+static float boxDistanceSquared(const float* boundsMin, const float* boundsMax, const float point[3]) {
+    float distance = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        float delta = std::max(std::max(boundsMin[axis] - point[axis], point[axis] - boundsMax[axis]), 0.0f);
+        distance += delta * delta;
+    }
+    return distance;
+}
+
+int sceneStreamMeshes(Scene* scene, const float cameraPosition[3], size_t byteBudget, int positionLoc, int texCoordLoc) {
+    if (scene->residentMeshes == scene->meshCount) {
+        return 0;
+    }
+
+    // 1. The distance of the nearest node of every mesh which is not resident yet.
+    std::vector<float> distances(scene->meshCount, FLT_MAX);
+    for (size_t idx = 0; idx < scene->bvhItems.size(); idx++) {
+        int node = scene->bvhItems[idx];
+        int mesh = scene->nodes[node].mesh;
+        if (!scene->meshResident[mesh]) {
+            float distance = boxDistanceSquared(&scene->boundsMin[node * 3], &scene->boundsMax[node * 3], cameraPosition);
+            distances[mesh] = std::min(distances[mesh], distance);
+        }
+    }
+
+    std::vector<int> pending;
+    for (int mesh = 0; mesh < scene->meshCount; mesh++) {
+        if (!scene->meshResident[mesh]) {
+            pending.push_back(mesh);
+        }
+    }
+    std::sort(pending.begin(), pending.end(), [&](int a, int b) { return distances[a] < distances[b]; });
+
+    // 2. Upload the nearest meshes within the budget, straight from the mapped blobs.
+    int uploaded = 0;
+    size_t uploadedBytes = 0;
+    size_t next = 0;
+    for (; next < pending.size() && (uploaded == 0 || uploadedBytes < byteBudget); next++) {
+        int mesh = pending[next];
+        const SceneFileMesh& entry = scene->meshes[mesh];
+        const uint8_t* blob = scene->data + entry.offset;
+        MeshStreams streams;
+        memcpy(&streams, blob, sizeof(streams));
+
+        size_t vertexOffset = alignSceneOffset(sizeof(MeshStreams));
+        size_t indexOffset = alignSceneOffset(vertexOffset + streams.vertexBufferSize);
+        scene->meshResident[mesh] = 1;
+        scene->residentMeshes++;
+        if (indexOffset + streams.indexBufferSize > entry.size) {
+            printf("Scene: mesh %d is truncated\n", mesh);
+            continue;
+        }
+
+        scene->meshBuffers[mesh] = uploadPackedMesh(streams, blob + vertexOffset, blob + indexOffset, positionLoc, texCoordLoc);
+        adviseBlob(scene, entry, MADV_DONTNEED);
+        uploadedBytes += (size_t)entry.size;
+        uploaded++;
+    }
+    scene->residentBytes += uploadedBytes;
+
+    // 3. Request the reads of the next meshes, they are (likely) uploaded by the next calls.
+    for (size_t end = std::min(next + SCENE_PREFETCH_MESHES, pending.size()); next < end; next++) {
+        int mesh = pending[next];
+        if (!scene->meshPrefetched[mesh]) {
+            adviseBlob(scene, scene->meshes[mesh], MADV_WILLNEED);
+            scene->meshPrefetched[mesh] = 1;
+        }
+    }
+    return uploaded;
+}
+
+bool sceneFullyResident(const Scene* scene) {
+    return scene->residentMeshes == scene->meshCount;
+}
+
+// Visit the BVH, "outside" is true for the boxes which don't intersect the volume of the query.
+template <typename Outside>
+static int collectBvhNodes(const Scene* scene, Outside outside, std::vector<int>* nodes) {
+    nodes->clear();
+    if (scene->bvhItems.empty()) {
+        return 0;
+    }
+
+    int stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const SceneBvhNode& node = scene->bvh[stack[--stackSize]];
+        if (outside(node.boundsMin, node.boundsMax)) {
+            continue;
+        }
+
+        if (node.count > 0) {
+            for (int idx = node.first; idx < node.first + node.count; idx++) {
+                int item = scene->bvhItems[idx];
+                if (!outside(&scene->boundsMin[item * 3], &scene->boundsMax[item * 3])) {
+                    nodes->push_back(item);
+                }
+            }
+        } else {
+            stack[stackSize++] = node.first;
+            stack[stackSize++] = node.first + 1;
+        }
+    }
+    return (int)nodes->size();
+}
+
+int sceneCullFrustum(const Scene* scene, const float* viewProjection, std::vector<int>* nodes) {
+    float planes[6][4];
+    extractFrustumPlanes(viewProjection, planes);
+
+    // The box is outside if its corner farthest along the normal is behind a plane.
+    return collectBvhNodes(scene, [&](const float* boundsMin, const float* boundsMax) {
+        for (int plane = 0; plane < 6; plane++) {
+            float x = planes[plane][0] >= 0.0f ? boundsMax[0] : boundsMin[0];
+            float y = planes[plane][1] >= 0.0f ? boundsMax[1] : boundsMin[1];
+            float z = planes[plane][2] >= 0.0f ? boundsMax[2] : boundsMin[2];
+            if (planes[plane][0] * x + planes[plane][1] * y + planes[plane][2] * z + planes[plane][3] < 0.0f) {
+                return true;
+            }
+        }
+        return false;
+    }, nodes);
+}
+
+int sceneQuerySphere(const Scene* scene, const float center[3], float radius, std::vector<int>* nodes) {
+    return collectBvhNodes(scene, [&](const float* boundsMin, const float* boundsMax) {
+        return boxDistanceSquared(boundsMin, boundsMax, center) > radius * radius;
+    }, nodes);
+}
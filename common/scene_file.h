@@ -0,0 +1,172 @@
+/**
+ * Memory mapped scene files: the nodes (transforms with mesh and material
+ * references), the meshes and the materials of a scene, with a bounding
+ * volume hierarchy for the culling and the spatial queries and a loader
+ * which streams the meshes in distance order.
+ *
+ * The file starts with a header and the node, mesh and material tables
+ * followed by the mesh blobs (MeshStreams, the vertex streams and the
+ * indices, each part aligned to 64 bytes as the mesh assets of
+ * common/asset_bundle.h). The file is mapped in one piece, but unlike the
+ * asset bundles it is not read ahead: openScene only touches the tables,
+ * the mesh blobs are read (MADV_WILLNEED) and uploaded by sceneStreamMeshes
+ * in the order of the distance to the camera, a byte budget per call. The
+ * scene is interactive after the tables are read: the nodes of the meshes
+ * which are not resident yet are skipped by the draws.
+ *
+ * The world matrices of the nodes are computed with the transform hierarchy
+ * (see common/transform_hierarchy.h, the parents come first in the file), the
+ * world bounds of the mesh nodes are the boxes of the BVH. The BVH is built
+ * by median splits of the longest axis with at most SCENE_BVH_LEAF_SIZE nodes
+ * per leaf, the frustum and the sphere queries visit the subtrees which
+ * intersect the volume.
+ *
+ * The scene files are written by the "tools/scene_pack" generator at build time.
+ *
+ * Usage:
+ *
+ *   Scene scene;
+ *   if (openScene(&scene, "demo_city.scene")) {
+ *       while (...) {
+ *           sceneStreamMeshes(&scene, cameraPosition, 256 * 1024, positionLoc, texCoordLoc);
+ *           sceneCullFrustum(&scene, viewProjection, &visible);
+ *           ... draw the visible nodes with a resident mesh (scene.meshBuffers) ...
+ *       }
+ *       closeScene(&scene); // deletes the uploaded meshes and unmaps the file
+ *   }
+ *
+ * Dependencies:
+ *  * C++11
+ *  * POSIX (mmap)
+ *  * Open GL ES 3.0+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_SCENE_FILE_H
+#define GLES_COMMON_SCENE_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "common/mesh.h"
+#include "common/transform_hierarchy.h"
+
+#define SCENE_FILE_MAGIC "GLESSCN"
+#define SCENE_FILE_VERSION 1
+#define SCENE_FILE_ALIGNMENT 64
+#define SCENE_BVH_LEAF_SIZE 4
+
+// File layout: header, the tables at their offsets, then the mesh blobs.
+struct SceneFileHeader {
+    char magic[8]; // SCENE_FILE_MAGIC with the terminating NUL
+    uint32_t version;
+    uint32_t nodeCount;
+    uint32_t meshCount;
+    uint32_t materialCount;
+    uint64_t nodeOffset;     // SceneFileNode table
+    uint64_t meshOffset;     // SceneFileMesh table
+    uint64_t materialOffset; // SceneFileMaterial table
+};
+
+// A node: the local transform relative to the parent and the references (-1: none).
+struct SceneFileNode {
+    int32_t parent;   // a lower index, -1: root
+    int32_t mesh;
+    int32_t material;
+    uint32_t reserved;
+    float translation[3];
+    float scale[3];
+    float rotation[4]; // unit quaternion (xyzw)
+};
+
+struct SceneFileMesh {
+    uint64_t offset; // of the blob from the start of the file, SCENE_FILE_ALIGNMENT aligned
+    uint64_t size;
+    float boundsMin[3]; // of the positions
+    float boundsMax[3];
+};
+
+struct SceneFileMaterial {
+    float baseColor[4];
+};
+
+// "count" > 0: leaf with the nodes bvhItems[first .. first + count), 0: inner node with the children first, first + 1.
+struct SceneBvhNode {
+    float boundsMin[3];
+    int32_t first;
+    float boundsMax[3];
+    int32_t count;
+};
+
+struct Scene {
+    const uint8_t* data;
+    size_t size;
+    const SceneFileNode* nodes;
+    const SceneFileMesh* meshes;
+    const SceneFileMaterial* materials;
+    int nodeCount;
+    int meshCount;
+    int materialCount;
+
+    // World matrices (transforms.world) and the world bounds of the nodes (3 floats per node, empty without mesh).
+    TransformHierarchy transforms;
+    std::vector<float> boundsMin;
+    std::vector<float> boundsMax;
+
+    // The BVH over the nodes with a mesh, the root is the first node.
+    std::vector<SceneBvhNode> bvh;
+    std::vector<int> bvhItems;
+
+    // Streaming state: the uploaded meshes (meshResident[mesh] != 0) and the requested reads.
+    std::vector<MeshBuffers> meshBuffers;
+    std::vector<uint8_t> meshResident;
+    std::vector<uint8_t> meshPrefetched;
+    int residentMeshes;
+    size_t residentBytes;
+};
+
+// Map the scene file, check its tables, compute the world transforms and bounds and build the BVH.
+/* No GL calls: the meshes are uploaded by sceneStreamMeshes. Returns false (and prints the reason) on failure. */
+bool openScene(Scene* scene, const char* path);
+
+// Delete the uploaded meshes and unmap the file.
+void closeScene(Scene* scene);
+
+// Upload the meshes which are not resident yet in the order of the distance of their nearest node to the camera.
+/* Uploads meshes until "byteBudget" bytes of mesh data are uploaded (at least one mesh), then requests the reads of
+ * the next ones (MADV_WILLNEED) so the kernel fetches them while the frame is drawn. The pages of the uploaded blobs
+ * are released. Returns the number of uploaded meshes. */
+int sceneStreamMeshes(Scene* scene, const float cameraPosition[3], size_t byteBudget, int positionLoc, int texCoordLoc);
+
+// True if every mesh is uploaded.
+bool sceneFullyResident(const Scene* scene);
+
+// Collect the nodes with a mesh whose world bounds intersect the frustum of the column major view-projection matrix.
+/* Returns the number of nodes, "nodes" is replaced. */
+int sceneCullFrustum(const Scene* scene, const float* viewProjection, std::vector<int>* nodes);
+
+// Collect the nodes with a mesh whose world bounds intersect the sphere. Returns the number of nodes.
+int sceneQuerySphere(const Scene* scene, const float center[3], float radius, std::vector<int>* nodes);
+
+#endif // GLES_COMMON_SCENE_FILE_H
@@ -0,0 +1,197 @@
+/**
+ * Precision tiers of the fragment shaders. See shader_precision.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/shader_precision.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <GLES3/gl3.h>
+
+#include "common/program_cache.h"
+
+const char* shaderPrecisionNames[SHADER_PRECISION_COUNT] = {
+    "highp", "mediump", "auto",
+};
+
+const int precisionMaxDiff = 2;
+
+bool parseShaderPrecision(const char* name, ShaderPrecision* precision) {
+    for (int idx = 0; idx < SHADER_PRECISION_COUNT; idx++) {
+        if (strcmp(name, shaderPrecisionNames[idx]) == 0) {
+            *precision = (ShaderPrecision)idx;
+            return true;
+        }
+    }
+
+    printf("Unknown shader precision '%s' (highp, mediump, auto)\n", name);
+    return false;
+}
+
+void queryFragmentPrecision(PrecisionFormat* highp, PrecisionFormat* mediump) {
+    int range[2];
+    int precision;
+
+    glGetShaderPrecisionFormat(GL_FRAGMENT_SHADER, GL_HIGH_FLOAT, range, &precision);
+    highp->rangeMin = range[0];
+    highp->rangeMax = range[1];
+    highp->precision = precision;
+
+    glGetShaderPrecisionFormat(GL_FRAGMENT_SHADER, GL_MEDIUM_FLOAT, range, &precision);
+    mediump->rangeMin = range[0];
+    mediump->rangeMax = range[1];
+    mediump->precision = precision;
+}
+
+bool mediumpIsReduced() {
+    PrecisionFormat highp;
+    PrecisionFormat mediump;
+    queryFragmentPrecision(&highp, &mediump);
+    return mediump.precision < highp.precision;
+}
+
+std::string precisionShaderSource(const char* source, ShaderPrecision precision) {
+    std::string result = source;
+    if (precision == SHADER_PRECISION_MEDIUMP) {
+        size_t highp = result.find("precision highp float;");
+        if (highp != std::string::npos) {
+            result.replace(highp, strlen("precision highp float;"), "precision mediump float;");
+        }
+    }
+    return result;
+}
+
+bool initPrecisionVariants(PrecisionVariants* variants, const char* vertexSrc, const char* fragmentSrc) {
+    variants->programs[SHADER_PRECISION_HIGHP] = createCachedProgram(vertexSrc, fragmentSrc);
+    variants->programs[SHADER_PRECISION_MEDIUMP] =
+        createCachedProgram(vertexSrc, precisionShaderSource(fragmentSrc, SHADER_PRECISION_MEDIUMP).c_str());
+    variants->selected = SHADER_PRECISION_HIGHP;
+    variants->reduced = mediumpIsReduced();
+    variants->checked = false;
+    variants->maxDiff = 0;
+    variants->meanDiff = 0.0;
+    return variants->programs[SHADER_PRECISION_HIGHP] != 0 && variants->programs[SHADER_PRECISION_MEDIUMP] != 0;
+}
+
+// Render the callback with both programs into an RGBA8 target and compare the pixels.
+static void comparePrecisionVariants(PrecisionVariants* variants, int width, int height, PrecisionDrawFunc draw,
+                                     void* user) {
+    int previousFramebuffer;
+    int previousViewport[4];
+    int previousProgram;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+
+    // P.1. One offscreen RGBA8 framebuffer for both variants.
+    unsigned int renderbuffer;
+    glGenRenderbuffers(1, &renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    unsigned int fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer);
+    glViewport(0, 0, width, height);
+
+    // P.2. The highp image, then the mediump image.
+    std::vector<unsigned char> pixels[2];
+    for (int variant = 0; variant < 2; variant++) {
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glUseProgram(variants->programs[variant]);
+        draw(variants->programs[variant], user);
+
+        pixels[variant].resize((size_t)width * height * 4);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels[variant].data());
+    }
+
+    // P.3. Largest and average channel difference.
+    int maxDiff = 0;
+    double sum = 0.0;
+    for (size_t idx = 0; idx < pixels[0].size(); idx++) {
+        int diff = abs((int)pixels[0][idx] - (int)pixels[1][idx]);
+        maxDiff = diff > maxDiff ? diff : maxDiff;
+        sum += diff;
+    }
+    variants->checked = true;
+    variants->maxDiff = maxDiff;
+    variants->meanDiff = pixels[0].empty() ? 0.0 : sum / pixels[0].size();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    /* A program deleted while it was current is gone once the variants were bound. */
+    glUseProgram(glIsProgram(previousProgram) ? previousProgram : 0);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &renderbuffer);
+}
+
+unsigned int selectPrecisionVariant(PrecisionVariants* variants, ShaderPrecision precision, int width, int height,
+                                    PrecisionDrawFunc draw, void* user, int maxDiff) {
+    // 1. Auto: mediump only where the device computes it with fewer bits.
+    ShaderPrecision selected = precision;
+    if (precision == SHADER_PRECISION_AUTO) {
+        selected = variants->reduced ? SHADER_PRECISION_MEDIUMP : SHADER_PRECISION_HIGHP;
+    }
+
+    // 2. The image check of the mediump variant, auto falls back to highp if the difference is visible.
+    if (draw != NULL && selected == SHADER_PRECISION_MEDIUMP && width > 0 && height > 0) {
+        comparePrecisionVariants(variants, width, height, draw, user);
+        if (precision == SHADER_PRECISION_AUTO && variants->maxDiff > maxDiff) {
+            selected = SHADER_PRECISION_HIGHP;
+        }
+    }
+
+    variants->selected = selected;
+    return variants->programs[selected];
+}
+
+unsigned int precisionVariantProgram(const PrecisionVariants* variants) {
+    return variants->programs[variants->selected];
+}
+
+void printPrecisionVariants(const PrecisionVariants* variants, const char* label) {
+    PrecisionFormat highp;
+    PrecisionFormat mediump;
+    queryFragmentPrecision(&highp, &mediump);
+
+    printf("%s: %s (fragment mediump: %d bits, highp: %d bits", label, shaderPrecisionNames[variants->selected],
+           mediump.precision, highp.precision);
+    if (variants->checked) {
+        printf(", mediump image vs highp: max diff %d, mean %.3f", variants->maxDiff, variants->meanDiff);
+    }
+    printf(")\n");
+}
+
+void destroyPrecisionVariants(PrecisionVariants* variants) {
+    glDeleteProgram(variants->programs[SHADER_PRECISION_HIGHP]);
+    glDeleteProgram(variants->programs[SHADER_PRECISION_MEDIUMP]);
+    variants->programs[SHADER_PRECISION_HIGHP] = 0;
+    variants->programs[SHADER_PRECISION_MEDIUMP] = 0;
+}
@@ -0,0 +1,131 @@
+/**
+ * Precision tiers of the fragment shaders: mediump and highp variants of one
+ * program, the variant chosen per device and checked against highp.
+ *
+ * The demos declare "precision highp float;" in every fragment shader, which
+ * is required for positions and depth but not for a colour or a texture
+ * sample. On GPUs with a real fp16 path (Mali, PowerVR, Adreno) mediump runs
+ * twice as many operations per cycle and uses half of the registers (more
+ * fragments in flight). Desktop GPUs and software renderers compute mediump
+ * in fp32: glGetShaderPrecisionFormat then reports the same precision for
+ * both and the mediump variant gains nothing.
+ *
+ * A PrecisionVariants builds both programs from one source (only the first
+ * "precision highp float;" of the fragment shader is changed). The selection:
+ *
+ *  highp    Always the highp variant.
+ *  mediump  Always the mediump variant (the image difference is still measured).
+ *  auto     The mediump variant if the device has a reduced mediump and the
+ *           image of the mediump variant is within "maxDiff" (RGBA8 levels) of
+ *           the highp image, otherwise highp.
+ *
+ * The image check renders the same draw callback with both programs into an
+ * offscreen RGBA8 framebuffer and compares the pixels. The draw callback must
+ * set the uniforms of the program it receives (the locations can differ).
+ *
+ * Usage:
+ *
+ *   PrecisionVariants variants;
+ *   initPrecisionVariants(&variants, vertex_src, fragment_src);
+ *   unsigned int program = selectPrecisionVariant(&variants, SHADER_PRECISION_AUTO, width, height, draw, &scene);
+ *   printPrecisionVariants(&variants);
+ *   ...
+ *   destroyPrecisionVariants(&variants);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_SHADER_PRECISION_H
+#define GLES_COMMON_SHADER_PRECISION_H
+
+#include <string>
+
+enum ShaderPrecision {
+    SHADER_PRECISION_HIGHP,
+    SHADER_PRECISION_MEDIUMP,
+    SHADER_PRECISION_AUTO, // selectPrecisionVariant only: by the device and the image check
+    SHADER_PRECISION_COUNT,
+};
+
+// "highp", "mediump", "auto".
+extern const char* shaderPrecisionNames[SHADER_PRECISION_COUNT];
+
+// The precision of a name. Returns false (and prints the valid names) for an unknown name.
+bool parseShaderPrecision(const char* name, ShaderPrecision* precision);
+
+// Range (log2) and precision (bits of the mantissa) of a fragment shader float type.
+struct PrecisionFormat {
+    int rangeMin;
+    int rangeMax;
+    int precision;
+};
+
+// The glGetShaderPrecisionFormat values of the fragment shader highp and mediump floats.
+void queryFragmentPrecision(PrecisionFormat* highp, PrecisionFormat* mediump);
+
+// True if the fragment shader mediump floats have fewer mantissa bits than highp (a faster fp16 path).
+bool mediumpIsReduced();
+
+// The source with its first "precision highp float;" statement changed to the given precision.
+/* The explicit "highp" qualifiers of the source are kept, SHADER_PRECISION_AUTO returns the source. */
+std::string precisionShaderSource(const char* source, ShaderPrecision precision);
+
+// Draws the scene of the image check with "program" (bound by the caller).
+typedef void (*PrecisionDrawFunc)(unsigned int program, void* user);
+
+struct PrecisionVariants {
+    unsigned int programs[2]; // by ShaderPrecision: highp, mediump
+    ShaderPrecision selected;
+    bool reduced;             // mediumpIsReduced() of the device
+
+    // Image check of the mediump variant (see selectPrecisionVariant).
+    bool checked;
+    int maxDiff;              // RGBA8 levels
+    double meanDiff;
+};
+
+// Default "maxDiff" of the image check: 2 levels of an 8 bit channel.
+extern const int precisionMaxDiff;
+
+// Build the highp and the mediump program of the sources (through the program cache).
+/* Only the fragment shader gets a mediump variant. Returns false if a program failed. */
+bool initPrecisionVariants(PrecisionVariants* variants, const char* vertexSrc, const char* fragmentSrc);
+
+// Select the variant of "precision" and return its program.
+/* With a draw callback the mediump image is compared with the highp image (width x height pixels),
+ * the auto selection falls back to highp above "maxDiff". Without a callback auto only uses
+ * the device query. Restores the framebuffer, viewport and program bindings. */
+unsigned int selectPrecisionVariant(PrecisionVariants* variants, ShaderPrecision precision, int width, int height,
+                                    PrecisionDrawFunc draw, void* user, int maxDiff = precisionMaxDiff);
+
+// The program of the selected variant.
+unsigned int precisionVariantProgram(const PrecisionVariants* variants);
+
+// One line: the selected variant, the precision formats and the image difference.
+void printPrecisionVariants(const PrecisionVariants* variants, const char* label = "Precision");
+
+void destroyPrecisionVariants(PrecisionVariants* variants);
+
+#endif // GLES_COMMON_SHADER_PRECISION_H
@@ -0,0 +1,399 @@
+/**
+ * Shader hot reload. See shader_reload.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/shader_reload.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+static bool hasGLExtension(const char* name) {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int idx = 0; idx < count; idx++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, idx), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static double nowSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool readFile(const std::string& path, std::string* content) {
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    *content = stream.str();
+    return true;
+}
+
+static long long modificationTime(const std::string& path) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return 0;
+    }
+    return (long long)info.st_mtime;
+}
+
+static std::string directoryOf(const std::string& path) {
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+}
+
+static std::string fileNameOf(const std::string& path) {
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// Compile the shaders and start the link of the pending program, finishBuild checks the result.
+/* With KHR_parallel_shader_compile none of these calls wait for the compiler. */
+static void startBuild(ReloadableProgram* program) {
+    const GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+    const char* sources[2] = { program->vertexSrc.c_str(), program->fragmentSrc.c_str() };
+
+    program->pendingProgram = glCreateProgram();
+    for (int idx = 0; idx < 2; idx++) {
+        program->pendingShaders[idx] = glCreateShader(types[idx]);
+        glShaderSource(program->pendingShaders[idx], 1, &sources[idx], NULL);
+        glCompileShader(program->pendingShaders[idx]);
+        glAttachShader(program->pendingProgram, program->pendingShaders[idx]);
+    }
+    glLinkProgram(program->pendingProgram);
+}
+
+// Check the link status (waits for the link), on failure keep the info logs and delete the program.
+static void finishBuild(ReloadableProgram* program) {
+    int success;
+    glGetProgramiv(program->pendingProgram, GL_LINK_STATUS, &success);
+    if (!success) {
+        char info[1024];
+        const char* names[2] = { "Vertex shader", "Fragment shader" };
+        for (int idx = 0; idx < 2; idx++) {
+            int compiled;
+            glGetShaderiv(program->pendingShaders[idx], GL_COMPILE_STATUS, &compiled);
+            if (!compiled) {
+                glGetShaderInfoLog(program->pendingShaders[idx], sizeof(info), NULL, info);
+                program->log += std::string(names[idx]) + " error:\n" + info + "\n";
+            }
+        }
+        if (program->log.empty()) {
+            glGetProgramInfoLog(program->pendingProgram, sizeof(info), NULL, info);
+            program->log = std::string("Program error:\n") + info + "\n";
+        }
+    }
+
+    for (int idx = 0; idx < 2; idx++) {
+        glDetachShader(program->pendingProgram, program->pendingShaders[idx]);
+        glDeleteShader(program->pendingShaders[idx]);
+        program->pendingShaders[idx] = 0;
+    }
+    if (!success) {
+        glDeleteProgram(program->pendingProgram);
+        program->pendingProgram = 0;
+    }
+}
+
+// GL worker task: the whole build on the worker's shared context.
+static void buildOnWorker(void* data) {
+    ReloadableProgram* program = (ReloadableProgram*)data;
+    startBuild(program);
+    finishBuild(program);
+}
+
+static void watchDirectory(ShaderReload* reload, const std::string& dir) {
+#if defined(__linux__)
+    for (size_t idx = 0; idx < reload->watchedDirs.size(); idx++) {
+        if (reload->watchedDirs[idx] == dir) {
+            return;
+        }
+    }
+    if (reload->watchFd < 0) {
+        return;
+    }
+
+    /* Editors often write a new file and rename it over the old one: the directory is watched. */
+    int watch = inotify_add_watch(reload->watchFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (watch < 0) {
+        printf("Shader reload: can't watch the \"%s\" directory\n", dir.c_str());
+        return;
+    }
+    reload->watches.push_back(watch);
+    reload->watchedDirs.push_back(dir);
+#else
+    (void)reload;
+    (void)dir;
+#endif
+}
+
+// Mark the programs whose files changed.
+static void checkFileChanges(ShaderReload* reload) {
+#if defined(__linux__)
+    if (reload->watchFd >= 0) {
+        // 1. Read every pending event (non-blocking), match the file names of the programs.
+        char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t length;
+        while ((length = read(reload->watchFd, buffer, sizeof(buffer))) > 0) {
+            for (char* ptr = buffer; ptr < buffer + length;) {
+                const struct inotify_event* event = (const struct inotify_event*)ptr;
+                ptr += sizeof(struct inotify_event) + event->len;
+                if (event->len == 0) {
+                    continue;
+                }
+
+                std::string dir;
+                for (size_t idx = 0; idx < reload->watches.size(); idx++) {
+                    if (reload->watches[idx] == event->wd) {
+                        dir = reload->watchedDirs[idx];
+                    }
+                }
+                for (size_t idx = 0; idx < reload->programs.size(); idx++) {
+                    ReloadableProgram* program = reload->programs[idx];
+                    const std::string* paths[2] = { &program->vertexPath, &program->fragmentPath };
+                    for (int file = 0; file < 2; file++) {
+                        if (directoryOf(*paths[file]) == dir && fileNameOf(*paths[file]) == event->name) {
+                            program->dirty = true;
+                        }
+                    }
+                }
+            }
+        }
+        return;
+    }
+#endif
+
+    // 2. No inotify: compare the modification times twice per second.
+    double now = nowSeconds();
+    if (now - reload->lastCheck < 0.5) {
+        return;
+    }
+    reload->lastCheck = now;
+
+    for (size_t idx = 0; idx < reload->programs.size(); idx++) {
+        ReloadableProgram* program = reload->programs[idx];
+        long long modified[2] = { modificationTime(program->vertexPath), modificationTime(program->fragmentPath) };
+        if (modified[0] != program->modified[0] || modified[1] != program->modified[1]) {
+            program->modified[0] = modified[0];
+            program->modified[1] = modified[1];
+            program->dirty = true;
+        }
+    }
+}
+
+void initShaderReload(ShaderReload* reload, bool useWorker) {
+    // 1. The worker with the shared context (no thread if the context can't be shared).
+    int started = initGLWorkers(&reload->workers, useWorker ? 1 : 0);
+    reload->useWorker = started > 0;
+    if (useWorker && !reload->useWorker) {
+        printf("Shader reload: no shared context, the programs are built on the render thread\n");
+    }
+
+    // 2. Builds on the render thread: let the driver compile in the background.
+    reload->parallelCompile = false;
+    if (!reload->useWorker && hasGLExtension("GL_KHR_parallel_shader_compile")) {
+        PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxShaderCompilerThreads =
+            (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)eglGetProcAddress("glMaxShaderCompilerThreadsKHR");
+        if (maxShaderCompilerThreads) {
+            /* 0xFFFFFFFF: as many threads as the driver wants. */
+            maxShaderCompilerThreads(0xFFFFFFFFu);
+            reload->parallelCompile = true;
+        }
+    }
+
+#if defined(__linux__)
+    reload->watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#else
+    reload->watchFd = -1;
+#endif
+    reload->lastCheck = nowSeconds();
+    reload->reloads = 0;
+    reload->failures = 0;
+}
+
+void destroyShaderReload(ShaderReload* reload) {
+    /* The worker finishes the queued builds first. */
+    destroyGLWorkers(&reload->workers);
+
+    for (size_t idx = 0; idx < reload->programs.size(); idx++) {
+        ReloadableProgram* program = reload->programs[idx];
+        if (program->building && reload->useWorker && program->task.fence) {
+            glDeleteSync((GLsync)program->task.fence);
+        }
+        if (program->building && program->pendingProgram) {
+            if (!reload->useWorker) {
+                finishBuild(program);
+            }
+            glDeleteProgram(program->pendingProgram);
+        }
+        glDeleteProgram(program->program);
+        delete program;
+    }
+    reload->programs.clear();
+
+#if defined(__linux__)
+    if (reload->watchFd >= 0) {
+        close(reload->watchFd);
+    }
+#endif
+    reload->watchFd = -1;
+    reload->watches.clear();
+    reload->watchedDirs.clear();
+}
+
+ReloadableProgram* shaderReloadAdd(ShaderReload* reload, const char* vertexPath, const char* fragmentPath,
+                                   const char* defaultVertexSrc, const char* defaultFragmentSrc) {
+    ReloadableProgram* program = new ReloadableProgram();
+    program->vertexPath = vertexPath;
+    program->fragmentPath = fragmentPath;
+    program->program = 0;
+    program->version = 0;
+    program->dirty = false;
+    program->building = false;
+    program->pendingProgram = 0;
+    program->pendingShaders[0] = 0;
+    program->pendingShaders[1] = 0;
+    program->buildStart = 0.0;
+
+    // 1. Read the sources, a missing file is created from the default source.
+    const char* defaults[2] = { defaultVertexSrc, defaultFragmentSrc };
+    std::string* sources[2] = { &program->vertexSrc, &program->fragmentSrc };
+    const std::string* paths[2] = { &program->vertexPath, &program->fragmentPath };
+    for (int idx = 0; idx < 2; idx++) {
+        if (readFile(*paths[idx], sources[idx])) {
+            continue;
+        }
+
+        std::ofstream file(paths[idx]->c_str(), std::ios::out | std::ios::binary);
+        file << defaults[idx];
+        if (!file) {
+            printf("Shader reload: can't create \"%s\"\n", paths[idx]->c_str());
+            delete program;
+            return NULL;
+        }
+        *sources[idx] = defaults[idx];
+        printf("Shader reload: created \"%s\" from the built-in source\n", paths[idx]->c_str());
+    }
+    program->modified[0] = modificationTime(program->vertexPath);
+    program->modified[1] = modificationTime(program->fragmentPath);
+
+    // 2. The first build is done right away: the program is needed for the first frame.
+    startBuild(program);
+    finishBuild(program);
+    if (!program->pendingProgram) {
+        printf("%s", program->log.c_str());
+        delete program;
+        return NULL;
+    }
+    program->program = program->pendingProgram;
+    program->pendingProgram = 0;
+    program->version = 1;
+
+    watchDirectory(reload, directoryOf(program->vertexPath));
+    watchDirectory(reload, directoryOf(program->fragmentPath));
+    reload->programs.push_back(program);
+    return program;
+}
+
+int shaderReloadPoll(ShaderReload* reload) {
+    checkFileChanges(reload);
+
+    int swapped = 0;
+    for (size_t idx = 0; idx < reload->programs.size(); idx++) {
+        ReloadableProgram* program = reload->programs[idx];
+
+        // 1. Start the rebuild of a changed program (the changes during a build start the next one).
+        if (program->dirty && !program->building) {
+            program->dirty = false;
+            if (!readFile(program->vertexPath, &program->vertexSrc) || !readFile(program->fragmentPath, &program->fragmentSrc)) {
+                printf("Shader reload: can't read \"%s\" or \"%s\"\n", program->vertexPath.c_str(), program->fragmentPath.c_str());
+                continue;
+            }
+
+            program->building = true;
+            program->buildStart = nowSeconds();
+            program->log.clear();
+            if (reload->useWorker) {
+                glWorkersSubmit(&reload->workers, &program->task, buildOnWorker, program);
+            } else {
+                startBuild(program);
+            }
+            continue;
+        }
+
+        // 2. Check the build without waiting (without the extension the link status query waits).
+        if (!program->building) {
+            continue;
+        }
+        if (reload->useWorker) {
+            if (!glTaskPoll(&reload->workers, &program->task)) {
+                continue;
+            }
+        } else {
+            if (reload->parallelCompile) {
+                int complete = 0;
+                glGetProgramiv(program->pendingProgram, GL_COMPLETION_STATUS_KHR, &complete);
+                if (!complete) {
+                    continue;
+                }
+            }
+            finishBuild(program);
+        }
+        program->building = false;
+
+        // 3. Swap in the new program, or keep the old one if the build failed.
+        double buildMs = (nowSeconds() - program->buildStart) * 1000.0;
+        if (program->pendingProgram) {
+            glDeleteProgram(program->program);
+            program->program = program->pendingProgram;
+            program->pendingProgram = 0;
+            program->version++;
+            reload->reloads++;
+            swapped++;
+            printf("Shader reload: \"%s\" + \"%s\" rebuilt in %.1f ms\n", program->vertexPath.c_str(),
+                   program->fragmentPath.c_str(), buildMs);
+        } else {
+            reload->failures++;
+            printf("Shader reload: \"%s\" + \"%s\" failed, the old program stays:\n%s", program->vertexPath.c_str(),
+                   program->fragmentPath.c_str(), program->log.c_str());
+        }
+    }
+    return swapped;
+}
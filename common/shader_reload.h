@@ -0,0 +1,130 @@
+/**
+ * Shader hot reload: programs built from source files, rebuilt in the background when a file changes.
+ *
+ * The sources of a program are read from a vertex and a fragment shader
+ * file (missing files are created from the built-in sources, so the demo's
+ * shaders can be edited right away). The files are watched with inotify
+ * (Linux, other systems check the modification times twice per second).
+ *
+ * A change starts a rebuild which never blocks the frames:
+ *
+ *  * With a shared context (see gl_workers.h) the shaders are compiled and
+ *    linked on a GL worker thread.
+ *  * Otherwise the build is issued on the render thread and, with
+ *    KHR_parallel_shader_compile, its completion is polled every frame
+ *    (GL_COMPLETION_STATUS_KHR). Without the extension the build blocks
+ *    the frame which starts it.
+ *
+ * The finished program replaces the live one in shaderReloadPoll, between
+ * two frames: the render thread only ever sees a linked program. If the new
+ * sources don't compile, the info log is printed and the old program stays.
+ * Uniform and attribute locations can change: re-query them when the
+ * "version" of the program changes.
+ *
+ * Usage:
+ *
+ *   ShaderReload reload;
+ *   initShaderReload(&reload, true);   // requires the current render context
+ *   ReloadableProgram* program = shaderReloadAdd(&reload, "shaders/color.vert", "shaders/color.frag",
+ *                                                vertex_src, fragment_src);
+ *   while (...) {
+ *       shaderReloadPoll(&reload);
+ *       if (program->version != knownVersion) { ... query the locations ... }
+ *       glUseProgram(program->program);
+ *       ...
+ *   }
+ *   destroyShaderReload(&reload);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *  * EGL (for the GL worker)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_SHADER_RELOAD_H
+#define GLES_COMMON_SHADER_RELOAD_H
+
+#include <string>
+#include <vector>
+
+#include "common/gl_workers.h"
+
+struct ReloadableProgram {
+    std::string vertexPath;
+    std::string fragmentPath;
+
+    // The live program and its version (incremented at every swap).
+    unsigned int program;
+    int version;
+
+    // The rebuild in flight: "dirty" is set by a file change, "building" until the swap (or the failure).
+    bool dirty;
+    bool building;
+    std::string vertexSrc;
+    std::string fragmentSrc;
+    unsigned int pendingProgram;  // 0 if the build failed
+    unsigned int pendingShaders[2];
+    std::string log;
+    double buildStart;
+    GLTask task;
+
+    // Modification times of the files (used without inotify).
+    long long modified[2];
+};
+
+struct ShaderReload {
+    std::vector<ReloadableProgram*> programs;
+
+    // The GL worker of the rebuilds (no thread without shared contexts).
+    GLWorkers workers;
+    bool useWorker;
+    bool parallelCompile; // KHR_parallel_shader_compile for the builds on the render thread
+
+    // inotify descriptor and the watched directories (Linux).
+    int watchFd;
+    std::vector<int> watches;
+    std::vector<std::string> watchedDirs;
+    double lastCheck;
+
+    // Statistics.
+    int reloads;
+    int failures;
+};
+
+// Start the file watcher and, if "useWorker" is set, a GL worker thread with a shared context.
+/* Requires a current GL ES context on the calling (render) thread. */
+void initShaderReload(ShaderReload* reload, bool useWorker);
+
+// Stop the watcher and the worker, delete the programs.
+void destroyShaderReload(ShaderReload* reload);
+
+// Load (or create from the default sources) the shader files and build the program right away.
+/* Returns NULL if the first build fails, the info log is printed. */
+ReloadableProgram* shaderReloadAdd(ShaderReload* reload, const char* vertexPath, const char* fragmentPath,
+                                   const char* defaultVertexSrc, const char* defaultFragmentSrc);
+
+// Call once per frame on the render thread: start the rebuilds of the changed programs and swap in the finished ones.
+/* Never waits for a build. Returns the number of programs swapped in this call. */
+int shaderReloadPoll(ShaderReload* reload);
+
+#endif // GLES_COMMON_SHADER_RELOAD_H
@@ -0,0 +1,367 @@
+/**
+ * Directional light shadow maps: depth-only light space passes, hardware PCF and cascades.
+ * See shadow_map.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/shadow_map.h"
+#include "common/gpu_memory.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <GLES3/gl3.h>
+
+// Weight of the newest sample in the moving average of the budget controller.
+static const double averageWeight = 0.1;
+
+// No change while the average is within this fraction of the budget.
+static const double deadband = 0.05;
+
+// Frames to skip after a change: the timer results of the old configuration are still in flight.
+static const int settleFrames = 10;
+
+const char* shadowSamplingSrc = R"(
+uniform highp sampler2DArrayShadow shadowMaps;
+uniform highp mat4 shadowMatrices[4];
+uniform highp vec4 shadowSplits;
+uniform int shadowCascadeCount;
+
+int shadowCascade(float viewDepth) {
+    for (int idx = 0; idx < shadowCascadeCount; idx++) {
+        if (viewDepth <= shadowSplits[idx]) {
+            return idx;
+        }
+    }
+    return -1;
+}
+
+float shadowFactor(vec3 worldPos, float viewDepth) {
+    int cascade = shadowCascade(viewDepth);
+    if (cascade < 0) {
+        return 1.0;
+    }
+
+    // Orthographic projection: no perspective divide.
+    vec3 coord = (shadowMatrices[cascade] * vec4(worldPos, 1.0)).xyz * 0.5 + 0.5;
+    return texture(shadowMaps, vec4(coord.xy, float(cascade), coord.z));
+}
+)";
+
+static float dot3(const float* a, const float* b) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void cross3(const float* a, const float* b, float* result) {
+    result[0] = a[1] * b[2] - a[2] * b[1];
+    result[1] = a[2] * b[0] - a[0] * b[2];
+    result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static void normalize3(float* v) {
+    float length = sqrtf(dot3(v, v));
+    v[0] /= length;
+    v[1] /= length;
+    v[2] /= length;
+}
+
+static bool createShadowTargets(ShadowMaps* shadows) {
+    // 1. The depth texture: one layer per cascade, compared (and filtered) by the texture unit.
+    glGenTextures(1, &shadows->texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, shadows->texture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT16, shadows->size, shadows->size, shadows->cascadeCount);
+    gpuMemoryTrackTexture(shadows->texture, GL_DEPTH_COMPONENT16, shadows->size, shadows->size, shadows->cascadeCount, 1,
+                          GPU_MEMORY_RENDER_TARGET, "shadow maps");
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    /* Linear filter of a compare texture: the 2x2 comparison results are filtered (PCF). */
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // 2. A depth-only FBO per layer: no color attachment, the draw and read buffers are disabled.
+    bool complete = true;
+    for (int idx = 0; idx < shadows->cascadeCount; idx++) {
+        ShadowCascade& cascade = shadows->cascades[idx];
+        glGenFramebuffers(1, &cascade.fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, cascade.fbo);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadows->texture, 0, idx);
+
+        GLenum disableColor = GL_NONE;
+        glDrawBuffers(1, &disableColor);
+        glReadBuffer(GL_NONE);
+
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            printf("Shadow maps: the FBO of cascade %d is incomplete (0x%x)\n", idx, status);
+            complete = false;
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return complete;
+}
+
+static void destroyShadowTargets(ShadowMaps* shadows) {
+    for (int idx = 0; idx < SHADOW_MAX_CASCADES; idx++) {
+        if (shadows->cascades[idx].fbo != 0) {
+            glDeleteFramebuffers(1, &shadows->cascades[idx].fbo);
+            shadows->cascades[idx].fbo = 0;
+        }
+    }
+    if (shadows->texture != 0) {
+        glDeleteTextures(1, &shadows->texture);
+        gpuMemoryReleaseTextures(1, &shadows->texture);
+        shadows->texture = 0;
+    }
+}
+
+bool initShadowMaps(ShadowMaps* shadows, int size, int cascadeCount) {
+    shadows->texture = 0;
+    for (int idx = 0; idx < SHADOW_MAX_CASCADES; idx++) {
+        shadows->cascades[idx].fbo = 0;
+        shadows->cascades[idx].splitNear = 0.0f;
+        shadows->cascades[idx].splitFar = 0.0f;
+        shadows->cascades[idx].texelSize = 0.0f;
+    }
+    shadows->size = 0;
+    shadows->cascadeCount = 0;
+
+    shadows->splitLambda = 0.75f;
+    shadows->casterDistance = 50.0f;
+    shadows->slopeBias = 2.0f;
+    shadows->constantBias = 4.0f;
+
+    shadows->budgetMs = 0.0;
+    shadows->averageMs = 0.0;
+    shadows->maxSize = size;
+    shadows->maxCascades = cascadeCount;
+    shadows->settleFrames = 0;
+    shadows->changeCount = 0;
+
+    return resizeShadowMaps(shadows, size, cascadeCount);
+}
+
+void destroyShadowMaps(ShadowMaps* shadows) {
+    destroyShadowTargets(shadows);
+}
+
+bool resizeShadowMaps(ShadowMaps* shadows, int size, int cascadeCount) {
+    if (cascadeCount < 1 || cascadeCount > SHADOW_MAX_CASCADES) {
+        printf("Shadow maps: the cascade count must be in [1, %d]\n", SHADOW_MAX_CASCADES);
+        return false;
+    }
+
+    destroyShadowTargets(shadows);
+    shadows->size = size;
+    shadows->cascadeCount = cascadeCount;
+    return createShadowTargets(shadows);
+}
+
+void updateShadowCascades(ShadowMaps* shadows, const float* view, float fovY, float aspect, float nearPlane,
+                          float shadowDistance, const float lightDirection[3]) {
+    // 1. Light space basis: "forward" is the direction the light travels.
+    float forward[3] = { lightDirection[0], lightDirection[1], lightDirection[2] };
+    normalize3(forward);
+    float up[3] = { 0.0f, 1.0f, 0.0f };
+    if (fabsf(forward[1]) > 0.99f) {
+        up[0] = 1.0f;
+        up[1] = 0.0f;
+    }
+    float right[3];
+    cross3(forward, up, right);
+    normalize3(right);
+    cross3(right, forward, up);
+
+    // 2. Half extent of the frustum at unit distance: the corners of a slice are (+-z * tanX, +-z * tanY, -z).
+    float tanY = tanf(fovY * 0.5f);
+    float tanX = tanY * aspect;
+    float cornerScale = sqrtf(tanX * tanX + tanY * tanY);
+
+    float splitNear = nearPlane;
+    for (int idx = 0; idx < shadows->cascadeCount; idx++) {
+        ShadowCascade& cascade = shadows->cascades[idx];
+
+        // 3. Practical split scheme: a mix of the logarithmic and the uniform distribution.
+        float part = (float)(idx + 1) / shadows->cascadeCount;
+        float logSplit = nearPlane * powf(shadowDistance / nearPlane, part);
+        float uniformSplit = nearPlane + (shadowDistance - nearPlane) * part;
+        float splitFar = shadows->splitLambda * logSplit + (1.0f - shadows->splitLambda) * uniformSplit;
+        cascade.splitNear = splitNear;
+        cascade.splitFar = splitFar;
+
+        // 4. Bounding sphere of the slice: the point of the view axis at equal distance from the near and far
+        //    corners (or the far plane center). It only depends on the slice: the radius is the same every frame.
+        float nearRadius = splitNear * cornerScale;
+        float farRadius = splitFar * cornerScale;
+        float centerDistance = (splitFar * splitFar + farRadius * farRadius - splitNear * splitNear
+                                - nearRadius * nearRadius) / (2.0f * (splitFar - splitNear));
+        if (centerDistance > splitFar) {
+            centerDistance = splitFar;
+        }
+        float radius = sqrtf((centerDistance - splitNear) * (centerDistance - splitNear) + nearRadius * nearRadius);
+        /* Rounded up: the float noise must not change the texel size. */
+        radius = ceilf(radius * 16.0f) / 16.0f;
+
+        // 5. World space center: the inverse of the rigid view transform applied to (0, 0, -centerDistance).
+        float viewCenter[3] = { -view[12], -view[13], -centerDistance - view[14] };
+        float center[3];
+        for (int axis = 0; axis < 3; axis++) {
+            center[axis] = view[axis * 4 + 0] * viewCenter[0] + view[axis * 4 + 1] * viewCenter[1]
+                         + view[axis * 4 + 2] * viewCenter[2];
+        }
+
+        // 6. Light view-projection: the eye is behind the sphere by "casterDistance", the orthographic box
+        //    is [-radius, radius]^2 and [0, casterDistance + 2 * radius] deep.
+        float eye[3];
+        for (int axis = 0; axis < 3; axis++) {
+            eye[axis] = center[axis] - forward[axis] * (radius + shadows->casterDistance);
+        }
+        float depthScale = -2.0f / (shadows->casterDistance + 2.0f * radius);
+
+        float* m = cascade.viewProjection;
+        for (int axis = 0; axis < 3; axis++) {
+            m[axis * 4 + 0] = right[axis] / radius;
+            m[axis * 4 + 1] = up[axis] / radius;
+            m[axis * 4 + 2] = -forward[axis] * depthScale;
+            m[axis * 4 + 3] = 0.0f;
+        }
+        m[12] = -dot3(right, eye) / radius;
+        m[13] = -dot3(up, eye) / radius;
+        m[14] = dot3(forward, eye) * depthScale - 1.0f;
+        m[15] = 1.0f;
+
+        // 7. Snap the projection to whole texels: the world moves in texel steps in the light space.
+        float halfSize = shadows->size * 0.5f;
+        float originX = m[12] * halfSize;
+        float originY = m[13] * halfSize;
+        m[12] += (roundf(originX) - originX) / halfSize;
+        m[13] += (roundf(originY) - originY) / halfSize;
+
+        cascade.texelSize = 2.0f * radius / shadows->size;
+        splitNear = splitFar;
+    }
+}
+
+void shadowMapsBeginCascade(ShadowMaps* shadows, int cascade) {
+    glBindFramebuffer(GL_FRAMEBUFFER, shadows->cascades[cascade].fbo);
+    glViewport(0, 0, shadows->size, shadows->size);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    /* The depth of the lit surfaces is pushed away from the light: no self shadowing ("acne"). */
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(shadows->slopeBias, shadows->constantBias);
+}
+
+void shadowMapsEnd(ShadowMaps* shadows) {
+    (void)shadows;
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(0.0f, 0.0f);
+}
+
+void shadowMapsBind(const ShadowMaps* shadows, unsigned int program, int unit) {
+    // The compare mode and the filter are texture parameters: no sampler object may override them.
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, shadows->texture);
+    glBindSampler(unit, 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    float matrices[SHADOW_MAX_CASCADES * 16];
+    float splits[SHADOW_MAX_CASCADES] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int idx = 0; idx < shadows->cascadeCount; idx++) {
+        for (int elem = 0; elem < 16; elem++) {
+            matrices[idx * 16 + elem] = shadows->cascades[idx].viewProjection[elem];
+        }
+        splits[idx] = shadows->cascades[idx].splitFar;
+    }
+
+    glUniform1i(glGetUniformLocation(program, "shadowMaps"), unit);
+    glUniformMatrix4fv(glGetUniformLocation(program, "shadowMatrices"), shadows->cascadeCount, GL_FALSE, matrices);
+    glUniform4fv(glGetUniformLocation(program, "shadowSplits"), 1, splits);
+    glUniform1i(glGetUniformLocation(program, "shadowCascadeCount"), shadows->cascadeCount);
+}
+
+void shadowMapsSetBudget(ShadowMaps* shadows, double budgetMs) {
+    shadows->budgetMs = budgetMs;
+    shadows->averageMs = 0.0;
+    shadows->settleFrames = settleFrames;
+}
+
+bool shadowMapsBudgetUpdate(ShadowMaps* shadows, double shadowMs) {
+    if (shadows->budgetMs <= 0.0 || shadowMs <= 0.0) {
+        return false;
+    }
+    if (shadows->settleFrames > 0) {
+        shadows->settleFrames--;
+        return false;
+    }
+
+    // 1. Smooth the measurements.
+    if (shadows->averageMs <= 0.0) {
+        shadows->averageMs = shadowMs;
+    } else {
+        shadows->averageMs += (shadowMs - shadows->averageMs) * averageWeight;
+    }
+
+    double ratio = shadows->budgetMs / shadows->averageMs;
+    if (fabs(ratio - 1.0) < deadband) {
+        return false;
+    }
+
+    // 2. The cost is assumed to be proportional to the texel count: size * size * cascadeCount.
+    int size = shadows->size;
+    int cascadeCount = shadows->cascadeCount;
+    if (ratio < 1.0) {
+        // 2.1. Over the budget: halve the resolution first, drop the farthest cascade at the smallest size.
+        if (size / 2 >= SHADOW_MIN_SIZE) {
+            size /= 2;
+        } else if (cascadeCount > 1) {
+            cascadeCount--;
+        } else {
+            return false;
+        }
+    } else {
+        // 2.2. Under the budget: restore in the reverse order, only if the next step fits.
+        double predictedMs;
+        if (cascadeCount < shadows->maxCascades) {
+            predictedMs = shadows->averageMs * (cascadeCount + 1) / cascadeCount;
+            cascadeCount++;
+        } else if (size < shadows->maxSize) {
+            predictedMs = shadows->averageMs * 4.0;
+            size *= 2;
+        } else {
+            return false;
+        }
+        if (predictedMs > shadows->budgetMs * (1.0 - deadband)) {
+            return false;
+        }
+    }
+
+    resizeShadowMaps(shadows, size, cascadeCount);
+    shadows->averageMs = 0.0;
+    shadows->settleFrames = settleFrames;
+    shadows->changeCount++;
+    printf("Shadow budget: %dx%d, %d cascades (%.3f ms for %.3f ms)\n", size, size, cascadeCount, shadowMs,
+           shadows->budgetMs);
+    return true;
+}
@@ -0,0 +1,145 @@
+/**
+ * Directional light shadow maps: depth-only light space passes, hardware
+ * PCF and cascades.
+ *
+ * The cascades are the layers of one GL_TEXTURE_2D_ARRAY of
+ * GL_DEPTH_COMPONENT16 (half the memory and bandwidth of the 32 bit formats,
+ * enough for the short orthographic depth range of a cascade). Each layer is
+ * the depth attachment of its own FBO with the color outputs disabled
+ * (glDrawBuffers(GL_NONE)), so the light pass only rasterizes the depth.
+ * The texture has GL_TEXTURE_COMPARE_MODE set: the shaders sample it with a
+ * sampler2DArrayShadow and the depth comparison and the bilinear filtering of
+ * the four results (2x2 PCF) is done by the texture unit.
+ *
+ * Cascades: the view frustum (up to the shadow distance) is split along the
+ * view direction by the "practical" scheme (a mix of the logarithmic and the
+ * uniform split, "splitLambda"), each part gets one layer. The orthographic
+ * light projection of a cascade covers the bounding sphere of its part of the
+ * frustum and is snapped to whole texels, so the shadow edges don't shimmer
+ * when the camera moves or rotates. The casters between the light and the
+ * sphere are kept by moving the near plane "casterDistance" towards the light.
+ * The light view-projection of every cascade can be used to cull the casters
+ * (ex.: with frustumCull of common/frustum_culling.h), the cubes far from the
+ * camera are only drawn into the cascades which see them.
+ *
+ * Frame budget: shadowMapsBudgetUpdate takes the measured GPU time of the
+ * shadow passes and trades the resolution and the cascade count for it: the
+ * size is halved (down to SHADOW_MIN_SIZE) and then a cascade is dropped if
+ * the passes are over the budget, and they are restored in the reverse order
+ * when the cost of the next step fits.
+ *
+ * Usage:
+ *
+ *   ShadowMaps shadows;
+ *   initShadowMaps(&shadows, 1024, 3);
+ *   while (...) {
+ *       updateShadowCascades(&shadows, view, fovY, aspect, nearPlane, shadowDistance, lightDirection);
+ *       for (int idx = 0; idx < shadows.cascadeCount; idx++) {
+ *           shadowMapsBeginCascade(&shadows, idx);
+ *           ... draw the casters with shadows.cascades[idx].viewProjection, empty fragment shader ...
+ *       }
+ *       shadowMapsEnd(&shadows);
+ *       ... bind the default framebuffer and its viewport ...
+ *       shadowMapsBind(&shadows, program, 6); // the sampler2DArrayShadow on the unit 6
+ *       ... draw the scene, the fragment shader calls shadowFactor(worldPos, viewDepth) ...
+ *   }
+ *   destroyShadowMaps(&shadows);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_SHADOW_MAP_H
+#define GLES_COMMON_SHADOW_MAP_H
+
+#define SHADOW_MAX_CASCADES 4
+#define SHADOW_MIN_SIZE 256
+
+struct ShadowCascade {
+    float viewProjection[16]; // world space -> light clip space, column major
+    float splitNear;          // view space distance range of the cascade
+    float splitFar;
+    float texelSize;          // world space size of a texel
+    unsigned int fbo;
+};
+
+struct ShadowMaps {
+    unsigned int texture; // GL_TEXTURE_2D_ARRAY, GL_DEPTH_COMPONENT16, one layer per cascade
+    int size;
+    int cascadeCount;
+    ShadowCascade cascades[SHADOW_MAX_CASCADES];
+
+    float splitLambda;    // 0: uniform split, 1: logarithmic split (default: 0.75)
+    float casterDistance; // casters this far from the cascade sphere (towards the light) are included (default: 50)
+    float slopeBias;      // glPolygonOffset of the light passes (default: 2, 4)
+    float constantBias;
+
+    // Frame budget (shadowMapsBudgetUpdate), the requested size and cascade count are the upper limits.
+    double budgetMs;
+    double averageMs;
+    int maxSize;
+    int maxCascades;
+    int settleFrames; // frames left until the measurements refer to the current configuration
+    int changeCount;
+};
+
+// GLSL functions for the fragment shaders: append it after the precision statements.
+/* Declares the "shadowMaps" sampler and the cascade uniforms set by shadowMapsBind and:
+ *   int shadowCascade(float viewDepth);                  the cascade (view space distance), -1 past the last
+ *   float shadowFactor(vec3 worldPos, float viewDepth);  0: in shadow, 1: lit (hardware PCF)
+ */
+extern const char* shadowSamplingSrc;
+
+// Create the depth texture (size x size, cascadeCount layers) and the FBO of every cascade.
+/* Returns false (with a message) if the cascade count is not in [1, SHADOW_MAX_CASCADES] or an FBO is incomplete. */
+bool initShadowMaps(ShadowMaps* shadows, int size, int cascadeCount);
+
+void destroyShadowMaps(ShadowMaps* shadows);
+
+// Reallocate the texture and the FBOs with a different size or cascade count.
+bool resizeShadowMaps(ShadowMaps* shadows, int size, int cascadeCount);
+
+// Split the view frustum and fit the light projection of every cascade.
+/* "view" is the column major camera view matrix (rigid transform), the frustum is described by "fovY" (radians),
+ * "aspect" and the [nearPlane, shadowDistance] range. "lightDirection" is the direction the light travels. */
+void updateShadowCascades(ShadowMaps* shadows, const float* view, float fovY, float aspect, float nearPlane,
+                          float shadowDistance, const float lightDirection[3]);
+
+// Bind the FBO and the viewport of the cascade, clear its depth and enable the polygon offset.
+void shadowMapsBeginCascade(ShadowMaps* shadows, int cascade);
+
+// Disable the polygon offset of the light passes. The caller binds its framebuffer and viewport again.
+void shadowMapsEnd(ShadowMaps* shadows);
+
+// Bind the shadow maps to the texture unit and set the uniforms of shadowSamplingSrc (the program must be in use).
+void shadowMapsBind(const ShadowMaps* shadows, unsigned int program, int unit);
+
+// Enable the budget controller: the shadow passes should take at most "budgetMs" of GPU time.
+void shadowMapsSetBudget(ShadowMaps* shadows, double budgetMs);
+
+// Feed the measured GPU time of the shadow passes of a frame, returns true if the maps were reallocated.
+/* Ignored (false) without a budget or if "shadowMs" is not positive (no timer result yet). */
+bool shadowMapsBudgetUpdate(ShadowMaps* shadows, double shadowMs);
+
+#endif // GLES_COMMON_SHADOW_MAP_H
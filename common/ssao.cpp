@@ -0,0 +1,394 @@
+/**
+ * Screen-space ambient occlusion, see ssao.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/ssao.h"
+
+#include <stdio.h>
+
+#include <GLES3/gl31.h>
+
+#include "common/depth_readback.h"
+#include "common/program_cache.h"
+
+// Texture units of the depth texture during the dispatches and of the result during the composite.
+#define SSAO_DEPTH_UNIT 7
+#define SSAO_COMPOSITE_UNIT 6
+
+// uGridSize.xy: the half resolution size, uParams.x: the sample count. APRON is inserted.
+static const char* ssao_src = R"(#version 310 es
+precision highp float;
+precision highp uimage2D;
+
+uniform highp sampler2D depthImage;
+layout(r32ui, binding = 0) writeonly uniform uimage2D aoImage;
+uniform vec2 uPlanes;     // near, far
+uniform vec2 uProjection; // projection[0][0], projection[1][1]
+uniform vec3 uShape;      // radius, intensity, bias
+
+#define TILE_W (LOCAL_SIZE_X + 2 * APRON)
+#define TILE_H (LOCAL_SIZE_Y + 2 * APRON)
+
+shared float sDepth[TILE_W * TILE_H];
+
+float linearDepth(float depth) {
+    float ndc = depth * 2.0 - 1.0;
+    return 2.0 * uPlanes.x * uPlanes.y / (uPlanes.y + uPlanes.x - ndc * (uPlanes.y - uPlanes.x));
+}
+
+// View space position of a half resolution texel (its depth is the full resolution texel at 2x).
+vec3 viewPosition(ivec2 texel, float distance) {
+    vec2 ndc = (vec2(texel * 2) + 0.5) / vec2(textureSize(depthImage, 0)) * 2.0 - 1.0;
+    return vec3(ndc / uProjection * distance, -distance);
+}
+
+float tileDepth(ivec2 tilePos) {
+    return sDepth[tilePos.y * TILE_W + tilePos.x];
+}
+
+void main() {
+    ivec2 pos = GLOBAL_ID_2D;
+    ivec2 local = ivec2(gl_LocalInvocationID.xy);
+
+    // 1. The linear depth of the tile and its apron, clamped to the image (the background is the far plane).
+    /* Every invocation takes part in the loads and the barrier, also the ones outside the image. */
+    ivec2 origin = pos - local - APRON;
+    ivec2 fullSize = textureSize(depthImage, 0);
+    for (int idx = int(gl_LocalInvocationIndex); idx < TILE_W * TILE_H; idx += LOCAL_SIZE_X * LOCAL_SIZE_Y) {
+        ivec2 texel = clamp(origin + ivec2(idx % TILE_W, idx / TILE_W), ivec2(0), uGridSize.xy - 1);
+        float depth = texelFetch(depthImage, min(texel * 2, fullSize - 1), 0).r;
+        sDepth[idx] = depth >= 1.0 ? uPlanes.y : linearDepth(depth);
+    }
+    barrier();
+
+    if (any(greaterThanEqual(pos, uGridSize.xy))) {
+        return;
+    }
+
+    ivec2 center = local + APRON;
+    float distance = tileDepth(center);
+    float radius = uShape.x;
+    float screenRadius = min(radius * uProjection.y / distance * 0.5 * float(uGridSize.y), float(APRON));
+    float ao = 1.0;
+    if (distance < uPlanes.y && screenRadius >= 1.0) {
+        // 2. The normal from the neighbour of each axis with the smaller depth step (not across the edges).
+        vec3 position = viewPosition(pos, distance);
+        vec3 left = viewPosition(pos - ivec2(1, 0), tileDepth(center - ivec2(1, 0)));
+        vec3 right = viewPosition(pos + ivec2(1, 0), tileDepth(center + ivec2(1, 0)));
+        vec3 down = viewPosition(pos - ivec2(0, 1), tileDepth(center - ivec2(0, 1)));
+        vec3 up = viewPosition(pos + ivec2(0, 1), tileDepth(center + ivec2(0, 1)));
+        vec3 dx = abs(right.z - position.z) < abs(position.z - left.z) ? right - position : position - left;
+        vec3 dy = abs(up.z - position.z) < abs(position.z - down.z) ? up - position : position - down;
+        vec3 normal = normalize(cross(dx, dy));
+
+        // 3. The samples on a golden angle spiral, rotated per pixel (interleaved gradient noise).
+        /* The obscurance estimator of "Scalable Ambient Obscurance": (R^2 - v.v)^3 * max(v.n - bias, 0) / v.v. */
+        float noise = fract(52.9829189 * fract(dot(vec2(pos), vec2(0.06711056, 0.00583715))));
+        float radius2 = radius * radius;
+        float sum = 0.0;
+        int samples = uParams.x;
+        for (int idx = 0; idx < samples; idx++) {
+            float fraction = (float(idx) + 0.5) / float(samples);
+            float angle = float(idx) * 2.39996323 + noise * 6.2831853;
+            ivec2 offset = ivec2(round(vec2(cos(angle), sin(angle)) * fraction * screenRadius));
+
+            vec3 v = viewPosition(pos + offset, tileDepth(center + offset)) - position;
+            float vv = dot(v, v);
+            float f = max(radius2 - vv, 0.0);
+            sum += f * f * f * max((dot(v, normal) - uShape.z) / (vv + 0.01 * radius2), 0.0);
+        }
+        ao = max(0.0, 1.0 - sum * uShape.y * 5.0 / (radius2 * radius2 * radius2 * float(samples)));
+    }
+
+    imageStore(aoImage, pos, uvec4(packHalf2x16(vec2(ao, distance)), 0u, 0u, 0u));
+}
+)";
+
+// uGridSize.xy: the full resolution size.
+static const char* ssao_upsample_src = R"(#version 310 es
+precision highp float;
+precision highp image2D;
+precision highp uimage2D;
+
+uniform highp sampler2D depthImage;
+layout(r32ui, binding = 0) readonly uniform uimage2D aoImage;
+layout(rgba8, binding = 1) writeonly uniform image2D outImage;
+uniform vec2 uPlanes; // near, far
+
+void main() {
+    ivec2 pos = GLOBAL_ID_2D;
+    if (any(greaterThanEqual(pos, uGridSize.xy))) {
+        return;
+    }
+
+    float depth = texelFetch(depthImage, pos, 0).r;
+    float ao = 1.0;
+    if (depth < 1.0) {
+        float ndc = depth * 2.0 - 1.0;
+        float distance = 2.0 * uPlanes.x * uPlanes.y / (uPlanes.y + uPlanes.x - ndc * (uPlanes.y - uPlanes.x));
+
+        // The 3x3 half resolution texels around the pixel: a gaussian of the distance (in half resolution
+        // texels) times a gaussian of the relative depth difference (5% of the distance).
+        ivec2 halfSize = imageSize(aoImage);
+        ivec2 halfPos = min(pos / 2, halfSize - 1);
+        float sum = 0.0;
+        float weightSum = 0.0;
+        for (int y = -1; y <= 1; y++) {
+            for (int x = -1; x <= 1; x++) {
+                ivec2 texel = clamp(halfPos + ivec2(x, y), ivec2(0), halfSize - 1);
+                vec2 value = unpackHalf2x16(imageLoad(aoImage, texel).r);
+                vec2 offset = vec2(texel * 2 - pos) * 0.5;
+                float step = (value.y - distance) / (0.05 * distance);
+                float weight = exp(-0.5 * dot(offset, offset) - step * step);
+                sum += value.x * weight;
+                weightSum += weight;
+            }
+        }
+
+        // No neighbour at this depth (a thin silhouette): the nearest texel.
+        ao = weightSum > 1e-4 ? sum / weightSum : unpackHalf2x16(imageLoad(aoImage, halfPos).r).x;
+    }
+
+    imageStore(outImage, pos, vec4(ao));
+}
+)";
+
+static const char* ssao_composite_vertex_src = R"(#version 310 es
+precision highp float;
+
+// A triangle covering the viewport, without vertex attributes.
+void main() {
+    vec2 corner = vec2(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1));
+    gl_Position = vec4(corner, 0.0, 1.0);
+}
+)";
+
+static const char* ssao_composite_fragment_src = R"(#version 310 es
+precision highp float;
+
+uniform highp sampler2D aoImage;
+
+out vec4 outColor;
+
+void main() {
+    outColor = vec4(vec3(texelFetch(aoImage, ivec2(gl_FragCoord.xy), 0).r), 1.0);
+}
+)";
+
+void initSsaoStage(SsaoStage* stage, GpuTimer* timer, int maxSamples, double budgetMs) {
+    // The AO kernel's tile is fixed: its shared memory is sized by the local size.
+    ComputeDefines defines;
+    computeDefine(&defines, "APRON", SSAO_TILE_APRON);
+    createComputeKernel2D(&stage->aoKernel, ssao_src, 8, 8, COMPUTE_SWIZZLE_OFF, &defines);
+    createComputeKernel2D(&stage->upsampleKernel, ssao_upsample_src, 0, 0, COMPUTE_SWIZZLE_AUTO);
+    stage->aoPlanesLoc = glGetUniformLocation(stage->aoKernel.program, "uPlanes");
+    stage->aoProjectionLoc = glGetUniformLocation(stage->aoKernel.program, "uProjection");
+    stage->aoShapeLoc = glGetUniformLocation(stage->aoKernel.program, "uShape");
+    stage->upsamplePlanesLoc = glGetUniformLocation(stage->upsampleKernel.program, "uPlanes");
+
+    glUseProgram(stage->aoKernel.program);
+    glUniform1i(glGetUniformLocation(stage->aoKernel.program, "depthImage"), SSAO_DEPTH_UNIT);
+    glUseProgram(stage->upsampleKernel.program);
+    glUniform1i(glGetUniformLocation(stage->upsampleKernel.program, "depthImage"), SSAO_DEPTH_UNIT);
+
+    stage->compositeProgram = createCachedProgram(ssao_composite_vertex_src, ssao_composite_fragment_src);
+    glUseProgram(stage->compositeProgram);
+    glUniform1i(glGetUniformLocation(stage->compositeProgram, "aoImage"), SSAO_COMPOSITE_UNIT);
+    glUseProgram(0);
+
+    stage->radius = 0.5f;
+    stage->intensity = 1.0f;
+    stage->bias = 0.01f;
+    stage->planes[0] = stage->planes[1] = 0.0f;
+    stage->projectionScale[0] = stage->projectionScale[1] = 1.0f;
+
+    maxSamples = maxSamples < SSAO_MIN_SAMPLES ? SSAO_MIN_SAMPLES : maxSamples;
+    stage->maxSamples = maxSamples > SSAO_MAX_SAMPLES ? SSAO_MAX_SAMPLES : maxSamples;
+    stage->samples = stage->maxSamples;
+    stage->timer = timer;
+    stage->budgetMs = budgetMs;
+    stage->framesSinceChange = 0;
+    stage->averageMs = 0.0;
+    if (budgetMs > 0.0 && !gpuTimerEnableQueries(timer)) {
+        printf("SSAO: no GPU timer queries, the sample count is fixed\n");
+        stage->budgetMs = 0.0;
+    }
+
+    stage->frames = 0;
+    stage->sampleSum = 0;
+    stage->changes = 0;
+}
+
+void destroySsaoStage(SsaoStage* stage) {
+    printf("SSAO: %d frames, %.1f samples/pixel on average, %d sample count changes (budget: %.3f ms)\n",
+           stage->frames, stage->frames ? (double)stage->sampleSum / stage->frames : 0.0, stage->changes,
+           stage->budgetMs);
+
+    destroyComputeKernel(&stage->aoKernel);
+    destroyComputeKernel(&stage->upsampleKernel);
+    glDeleteProgram(stage->compositeProgram);
+    stage->compositeProgram = 0;
+}
+
+static void bindDepth(RenderGraph* graph, int depth) {
+    glActiveTexture(GL_TEXTURE0 + SSAO_DEPTH_UNIT);
+    glBindTexture(GL_TEXTURE_2D, renderGraphTexture(graph, depth));
+    glActiveTexture(GL_TEXTURE0);
+}
+
+static void executeAo(RenderGraph* graph, int pass, void* userData) {
+    (void)pass;
+    const SsaoGraphPass* data = (const SsaoGraphPass*)userData;
+    SsaoStage* stage = data->stage;
+
+    GpuTimerScope timerScope(stage->timer, "ssao");
+    glUseProgram(stage->aoKernel.program);
+    glUniform2fv(stage->aoPlanesLoc, 1, stage->planes);
+    glUniform2fv(stage->aoProjectionLoc, 1, stage->projectionScale);
+    glUniform3f(stage->aoShapeLoc, stage->radius, stage->intensity, stage->bias);
+    glUniform4i(stage->aoKernel.paramsLoc, stage->samples, 0, 0, 0);
+    bindDepth(graph, data->depth);
+    glBindImageTexture(0, renderGraphTexture(graph, data->target), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32UI);
+    computeDispatch(&stage->aoKernel, data->width, data->height, 1);
+}
+
+static void executeUpsample(RenderGraph* graph, int pass, void* userData) {
+    (void)pass;
+    const SsaoGraphPass* data = (const SsaoGraphPass*)userData;
+    SsaoStage* stage = data->stage;
+
+    GpuTimerScope timerScope(stage->timer, "ssao upsample");
+    glUseProgram(stage->upsampleKernel.program);
+    glUniform2fv(stage->upsamplePlanesLoc, 1, stage->planes);
+    bindDepth(graph, data->depth);
+    glBindImageTexture(0, renderGraphTexture(graph, data->source), 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32UI);
+    glBindImageTexture(1, renderGraphTexture(graph, data->target), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+    computeDispatch(&stage->upsampleKernel, data->width, data->height, 1);
+}
+
+int ssaoAddToGraph(SsaoStage* stage, RenderGraph* graph, int depth, int width, int height, const float* projection) {
+    // The near/far planes and the x/y scales of the projection (m[0], m[5], see viewPosition in the shader).
+    projectionDepthPlanes(projection, &stage->planes[0], &stage->planes[1]);
+    stage->projectionScale[0] = projection[0];
+    stage->projectionScale[1] = projection[5];
+
+    RenderTargetKey halfKey = { RENDER_TARGET_TEXTURE, GL_R32UI, (width + 1) / 2, (height + 1) / 2, 0 };
+    RenderTargetKey fullKey = { RENDER_TARGET_TEXTURE, GL_RGBA8, width, height, 0 };
+    int halfAo = renderGraphCreateTexture(graph, "ssao half", halfKey);
+    int ao = renderGraphCreateTexture(graph, "ssao", fullKey);
+
+    stage->aoPass.stage = stage;
+    stage->aoPass.depth = depth;
+    stage->aoPass.source = -1;
+    stage->aoPass.target = halfAo;
+    stage->aoPass.width = halfKey.width;
+    stage->aoPass.height = halfKey.height;
+    int aoPass = renderGraphAddPass(graph, "ssao", executeAo, &stage->aoPass);
+    renderGraphUse(graph, aoPass, depth, RENDER_GRAPH_SAMPLE);
+    renderGraphUse(graph, aoPass, halfAo, RENDER_GRAPH_IMAGE_WRITE);
+
+    stage->upsamplePass.stage = stage;
+    stage->upsamplePass.depth = depth;
+    stage->upsamplePass.source = halfAo;
+    stage->upsamplePass.target = ao;
+    stage->upsamplePass.width = width;
+    stage->upsamplePass.height = height;
+    int upsamplePass = renderGraphAddPass(graph, "ssao upsample", executeUpsample, &stage->upsamplePass);
+    renderGraphUse(graph, upsamplePass, depth, RENDER_GRAPH_SAMPLE);
+    renderGraphUse(graph, upsamplePass, halfAo, RENDER_GRAPH_IMAGE_READ);
+    renderGraphUse(graph, upsamplePass, ao, RENDER_GRAPH_IMAGE_WRITE);
+
+    stage->frames++;
+    stage->sampleSum += stage->samples;
+    return ao;
+}
+
+void ssaoComposite(SsaoStage* stage, unsigned int aoTexture, bool view) {
+    // The result is written with image stores: make them visible to the texture fetch.
+    glMemoryBarrier(renderGraphAccessBarrier(RENDER_GRAPH_SAMPLE));
+
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+    if (view) {
+        glDisable(GL_BLEND);
+    } else {
+        // destination * occlusion
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ZERO, GL_SRC_COLOR);
+    }
+
+    glActiveTexture(GL_TEXTURE0 + SSAO_COMPOSITE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, aoTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glUseProgram(stage->compositeProgram);
+    glBindVertexArray(0);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    if (depthTest) {
+        glEnable(GL_DEPTH_TEST);
+    }
+    if (blend) {
+        glEnable(GL_BLEND);
+    } else {
+        glDisable(GL_BLEND);
+    }
+}
+
+bool ssaoAdaptSamples(SsaoStage* stage) {
+    if (stage->budgetMs <= 0.0) {
+        return false;
+    }
+
+    // 1. Average the GPU time of the current count (the first results after a change may be older ones).
+    stage->framesSinceChange++;
+    double ms = gpuTimerLastMs(stage->timer, "ssao");
+    if (ms <= 0.0 || stage->framesSinceChange <= GPU_TIMER_RING_SIZE) {
+        return false;
+    }
+    stage->averageMs = stage->averageMs == 0.0 ? ms : stage->averageMs * 0.75 + ms * 0.25;
+    if (stage->framesSinceChange < SSAO_ADAPT_FRAMES) {
+        return false;
+    }
+
+    // 2. Over the budget: scale down in proportion. Well under it: grow by at most 50%.
+    int samples = stage->samples;
+    if (stage->averageMs > stage->budgetMs * 1.1) {
+        samples = (int)(stage->samples * stage->budgetMs / stage->averageMs);
+    } else if (stage->averageMs < stage->budgetMs * 0.75) {
+        samples = (int)(stage->samples * stage->budgetMs * 0.9 / stage->averageMs);
+        samples = samples > stage->samples * 3 / 2 ? stage->samples * 3 / 2 : samples;
+    }
+    samples = samples < SSAO_MIN_SAMPLES ? SSAO_MIN_SAMPLES : (samples > stage->maxSamples ? stage->maxSamples : samples);
+    if (samples == stage->samples) {
+        return false;
+    }
+
+    printf("SSAO: %d -> %d samples (%.3f ms, budget %.3f ms)\n", stage->samples, samples, stage->averageMs,
+           stage->budgetMs);
+    stage->samples = samples;
+    stage->framesSinceChange = 0;
+    stage->averageMs = 0.0;
+    stage->changes++;
+    return true;
+}
@@ -0,0 +1,160 @@
+/**
+ * Screen-space ambient occlusion from a depth texture (compute stage).
+ *
+ * The occlusion is estimated from the depth buffer alone, so the depth of
+ * the frame (ex.: the output of a depth prepass) is enough: no normal
+ * buffer and no extra geometry pass. Two passes are added to a render graph
+ * (see render_graph.h):
+ *
+ *   ssao           Half resolution. A work group of 8x8 invocations loads
+ *                  the linear depth of its tile and an apron of
+ *                  SSAO_TILE_APRON texels into shared memory, then every
+ *                  invocation reconstructs its view space position and
+ *                  normal and tests its samples (a spiral rotated per
+ *                  pixel) against the shared tile only. The sampling radius
+ *                  is clamped to the apron on the screen. The occlusion and
+ *                  the linear depth are stored as a packHalf2x16 pair in an
+ *                  R32UI image.
+ *   ssao upsample  Full resolution. A joint bilateral 3x3 blur of the half
+ *                  resolution result: the weights fall off with the
+ *                  distance and with the depth difference to the full
+ *                  resolution depth, so the occlusion doesn't bleed over
+ *                  the silhouettes. Writes an RGBA8 image.
+ *
+ * Both images are transient textures of the graph, the full resolution one
+ * is the result (export it, ssaoComposite samples it after the graph).
+ *
+ * The sample count adapts to a GPU time budget of the "ssao" pass (measured
+ * with the GPU timer of the stage): over the budget the count is scaled down
+ * in proportion, well under it the count grows (by at most 50% per step),
+ * between SSAO_MIN_SAMPLES and the initial count. The query results arrive
+ * a few frames late, the controller waits SSAO_ADAPT_FRAMES frames after a
+ * change before it measures again.
+ *
+ * Usage:
+ *
+ *   SsaoStage ssao;
+ *   initSsaoStage(&ssao, &gpuTimer, 16, 1.0); // at most 16 samples, 1 ms budget
+ *   ... every frame, after the depth is rendered ...
+ *   renderGraphReset(&graph);
+ *   int depth = renderGraphImportTexture(&graph, "depth", depthTexture);
+ *   int ao = ssaoAddToGraph(&ssao, &graph, depth, width, height, projection);
+ *   renderGraphExport(&graph, ao);
+ *   renderGraphExecute(&graph);
+ *   ... in the output pass ...
+ *   ssaoComposite(&ssao, renderGraphTexture(&graph, ao), false);
+ *   ... after gpuTimerEndFrame ...
+ *   ssaoAdaptSamples(&ssao);
+ *   destroySsaoStage(&ssao); // prints the statistics
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.1+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_SSAO_H
+#define GLES_COMMON_SSAO_H
+
+#include "common/compute.h"
+#include "common/gpu_timer.h"
+#include "common/render_graph.h"
+
+// Shared memory apron of the AO tile in half resolution texels (the largest sampling radius on the screen).
+#define SSAO_TILE_APRON 8
+
+// Range of the adaptive sample count.
+#define SSAO_MIN_SAMPLES 4
+#define SSAO_MAX_SAMPLES 64
+
+// Frames after a sample count change before the GPU time is measured again.
+#define SSAO_ADAPT_FRAMES 8
+
+struct SsaoStage;
+
+// User data of the render graph passes.
+struct SsaoGraphPass {
+    SsaoStage* stage;
+    int depth; // graph resources
+    int source;
+    int target;
+    int width; // of the target
+    int height;
+};
+
+struct SsaoStage {
+    ComputeKernel aoKernel;
+    ComputeKernel upsampleKernel;
+    int aoPlanesLoc;
+    int aoProjectionLoc;
+    int aoShapeLoc;
+    int upsamplePlanesLoc;
+    unsigned int compositeProgram;
+    int compositeViewLoc;
+
+    float radius;    // sampling radius in view space units
+    float intensity;
+    float bias;      // ignores the occluders closer to the tangent plane (view space units)
+
+    // Frame parameters of ssaoAddToGraph.
+    float planes[2];
+    float projectionScale[2];
+
+    // Adaptive sample count.
+    GpuTimer* timer; // the passes are timed as "ssao" and "ssao upsample"
+    double budgetMs; // 0: fixed count
+    int maxSamples;
+    int samples;
+    int framesSinceChange;
+    double averageMs; // since the last change, 0: no sample yet
+
+    SsaoGraphPass aoPass;
+    SsaoGraphPass upsamplePass;
+
+    // Statistics.
+    int frames;
+    long sampleSum;
+    int changes;
+};
+
+// Build the kernels and the composite program. The budget needs the queries of the timer (enabled here).
+/* maxSamples is the initial count too (clamped to SSAO_MIN_SAMPLES-SSAO_MAX_SAMPLES), budgetMs 0 keeps it. */
+void initSsaoStage(SsaoStage* stage, GpuTimer* timer, int maxSamples, double budgetMs);
+
+// Print the statistics and delete the kernels and the program.
+void destroySsaoStage(SsaoStage* stage);
+
+// Add the AO and the upsample passes reading the "depth" resource (width x height), returns the result resource.
+/* The depth texture must be complete for texelFetch (ex.: GL_NEAREST, GL_TEXTURE_COMPARE_MODE GL_NONE). The
+ * projection is the perspective matrix of the depth (column major, as glm::perspective). The pass data is
+ * valid until the next call. */
+int ssaoAddToGraph(SsaoStage* stage, RenderGraph* graph, int depth, int width, int height, const float* projection);
+
+// Multiply the current framebuffer with the occlusion (view: show the occlusion itself), a fullscreen draw.
+/* The result of the graph is sampled here (its texture fetch barrier is issued). Uses the viewport and the
+ * scissor of the caller, the blend and depth test states are restored. */
+void ssaoComposite(SsaoStage* stage, unsigned int aoTexture, bool view);
+
+// Update the sample count from the last GPU time of the "ssao" pass. Returns true if the count changed.
+bool ssaoAdaptSamples(SsaoStage* stage);
+
+#endif // GLES_COMMON_SSAO_H
@@ -0,0 +1,229 @@
+/**
+ * Startup phase profiler. See startup_profile.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/startup_profile.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#include "common/gl_loader.h"
+
+struct StartupPhase {
+    const char* name;
+    double startMs;       // since the static initialization
+    unsigned int query;   // GL_TIMESTAMP_EXT at the start of the phase (0: none)
+};
+
+struct StartupProfile {
+    std::chrono::steady_clock::time_point initTime;
+    double initSinceExecMs; // negative: unknown
+
+    bool enabled;
+    bool finished;
+    bool gpuSupported;
+    std::vector<StartupPhase> phases;
+
+    PFNGLGENQUERIESEXTPROC genQueries;
+    PFNGLDELETEQUERIESEXTPROC deleteQueries;
+    PFNGLQUERYCOUNTEREXTPROC queryCounter;
+    PFNGLGETQUERYOBJECTUI64VEXTPROC getQueryObjectui64v;
+};
+
+// Time between the exec of the process and now (ms), negative if unknown.
+/* The start time in /proc/self/stat (field 22) is in clock ticks since the boot (CLOCK_BOOTTIME). */
+static double sinceExecMs() {
+    FILE* file = fopen("/proc/self/stat", "r");
+    if (file == NULL) {
+        return -1.0;
+    }
+    char line[1024];
+    size_t length = fread(line, 1, sizeof(line) - 1, file);
+    fclose(file);
+    line[length] = '\0';
+
+    // The command name (field 2) is in parentheses and can have spaces: the fields after the last ')'.
+    const char* fields = strrchr(line, ')');
+    unsigned long long startTicks = 0;
+    if (fields == NULL
+        || sscanf(fields + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu",
+                  &startTicks) != 1) {
+        return -1.0;
+    }
+
+    struct timespec now;
+    if (clock_gettime(CLOCK_BOOTTIME, &now) != 0) {
+        return -1.0;
+    }
+    double nowMs = now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+    return nowMs - startTicks * 1000.0 / sysconf(_SC_CLK_TCK);
+}
+
+static StartupProfile& startupProfile() {
+    static StartupProfile profile = [] {
+        StartupProfile init;
+        init.initTime = std::chrono::steady_clock::now();
+        init.initSinceExecMs = sinceExecMs();
+        init.enabled = false;
+        init.finished = false;
+        init.gpuSupported = false;
+        init.phases.push_back(StartupPhase { "process", 0.0, 0 });
+        init.genQueries = NULL;
+        init.deleteQueries = NULL;
+        init.queryCounter = NULL;
+        init.getQueryObjectui64v = NULL;
+        return init;
+    }();
+    return profile;
+}
+
+// The profile starts with the static initializers of the program, not at the first phase.
+static const bool startupProfileInitialized = (startupProfile(), true);
+
+static double nowMs(const StartupProfile& profile) {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now() - profile.initTime).count();
+}
+
+static bool hasGLExtension(const char* name) {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int idx = 0; idx < count; idx++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, idx), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static unsigned int gpuTimestamp(StartupProfile& profile) {
+    if (!profile.gpuSupported) {
+        return 0;
+    }
+    unsigned int query = 0;
+    profile.genQueries(1, &query);
+    profile.queryCounter(query, GL_TIMESTAMP_EXT);
+    return query;
+}
+
+void startupPhase(const char* name) {
+    StartupProfile& profile = startupProfile();
+    /* The same phase again (ex.: a loop condition): it continues. */
+    if (profile.finished || strcmp(profile.phases.back().name, name) == 0) {
+        return;
+    }
+    StartupPhase phase = { name, nowMs(profile), gpuTimestamp(profile) };
+    profile.phases.push_back(phase);
+}
+
+void startupProfileEnable() {
+    startupProfile().enabled = true;
+}
+
+void startupProfileContextReady() {
+    StartupProfile& profile = startupProfile();
+    if (!profile.enabled || profile.finished || !hasGLExtension("GL_EXT_disjoint_timer_query")) {
+        return;
+    }
+
+    profile.genQueries = (PFNGLGENQUERIESEXTPROC)eglGetProcAddress("glGenQueriesEXT");
+    profile.deleteQueries = (PFNGLDELETEQUERIESEXTPROC)eglGetProcAddress("glDeleteQueriesEXT");
+    profile.queryCounter = (PFNGLQUERYCOUNTEREXTPROC)eglGetProcAddress("glQueryCounterEXT");
+    profile.getQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VEXTPROC)eglGetProcAddress("glGetQueryObjectui64vEXT");
+    PFNGLGETQUERYIVEXTPROC getQueryiv = (PFNGLGETQUERYIVEXTPROC)eglGetProcAddress("glGetQueryivEXT");
+
+    // Timestamps are optional in the extension: zero counter bits means no support.
+    int timestampBits = 0;
+    if (getQueryiv) {
+        getQueryiv(GL_TIMESTAMP_EXT, GL_QUERY_COUNTER_BITS_EXT, &timestampBits);
+    }
+    profile.gpuSupported = profile.genQueries && profile.deleteQueries && profile.queryCounter
+        && profile.getQueryObjectui64v && timestampBits > 0;
+}
+
+void startupProfileFirstFrame() {
+    StartupProfile& profile = startupProfile();
+    if (profile.finished) {
+        return;
+    }
+    profile.finished = true;
+
+    double endMs = nowMs(profile);
+    unsigned int endQuery = gpuTimestamp(profile);
+    if (!profile.enabled) {
+        return;
+    }
+
+    // 1. The GPU timestamps of the boundaries (waits for the first frame on the GPU).
+    std::vector<GLuint64> gpuNs(profile.phases.size() + 1, 0);
+    for (size_t idx = 0; idx <= profile.phases.size(); idx++) {
+        unsigned int query = idx < profile.phases.size() ? profile.phases[idx].query : endQuery;
+        if (query != 0) {
+            profile.getQueryObjectui64v(query, GL_QUERY_RESULT_EXT, &gpuNs[idx]);
+            profile.deleteQueries(1, &query);
+        }
+    }
+    GLint disjoint = 0;
+    if (profile.gpuSupported) {
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    }
+
+    // 2. The breakdown: the phases in order, the start relative to the exec of the process.
+    double execOffsetMs = profile.initSinceExecMs > 0.0 ? profile.initSinceExecMs : 0.0;
+    printf("Startup profile (ms):\n");
+    printf("  %-20s %10s %10s %10s\n", "phase", "start", "cpu", "gpu");
+    if (profile.initSinceExecMs > 0.0) {
+        printf("  %-20s %10.1f %10.1f %10s\n", "before main", 0.0, profile.initSinceExecMs, "-");
+    }
+    for (size_t idx = 0; idx < profile.phases.size(); idx++) {
+        const StartupPhase& phase = profile.phases[idx];
+        double phaseEndMs = idx + 1 < profile.phases.size() ? profile.phases[idx + 1].startMs : endMs;
+
+        char gpu[32] = "-";
+        if (gpuNs[idx] != 0 && gpuNs[idx + 1] != 0 && !disjoint) {
+            snprintf(gpu, sizeof(gpu), "%.2f", (gpuNs[idx + 1] - gpuNs[idx]) / 1e6);
+        }
+        printf("  %-20s %10.1f %10.2f %10s\n", phase.name, execOffsetMs + phase.startMs, phaseEndMs - phase.startMs,
+               gpu);
+    }
+    printf("  first frame presented %.1f ms after %s%s\n", execOffsetMs + endMs,
+           profile.initSinceExecMs > 0.0 ? "the exec" : "the static initialization",
+           disjoint ? " (GPU disjoint: no GPU times)" : "");
+
+    // 3. The lazy dispatch (GLES_LAZY_GL_LOADER): the entry points used until the first frame.
+    if (glLoaderEnabled()) {
+        int resolved, entries;
+        double seconds;
+        glLoaderGetStats(&resolved, &entries, &seconds);
+        printf("  GL entry points: %d of %d resolved lazily in %.2f ms\n", resolved, entries, seconds * 1000.0);
+    }
+}
@@ -0,0 +1,72 @@
+/**
+ * Startup phase profiler: CPU and GPU time of the init steps until the first frame.
+ *
+ * Enabled by the "--startup-profile" option of the demo context. The startup
+ * is split into phases, every startupPhase call ends the current phase and
+ * begins the next one. The breakdown is printed when the first frame was
+ * presented (after the first demoSwapBuffers):
+ *
+ *  * start: time since the process was started (exec), the time before the
+ *    static initializers (dynamic loading) comes from /proc/self/stat with a
+ *    clock tick resolution (usually 10 ms).
+ *  * cpu:   wall time of the phase on the main thread.
+ *  * gpu:   GPU timeline interval between the completion of the previous phase
+ *           and of this phase (GL_TIMESTAMP_EXT queries at the phase boundaries,
+ *           GL_EXT_disjoint_timer_query). Much longer than the cpu time: the work
+ *           queued in the phase (uploads, shader compiles of lazy drivers) runs late.
+ *
+ * The demo context adds its own phases: "process" (static initializers and
+ * the code before createDemoContext), the window or EGL context creation, the
+ * "demo context" helpers, "setup" (until the demo begins a phase) and the
+ * "first frame" (from the first demoShouldClose until the end of the first swap).
+ * The phases are recorded on the main thread only.
+ *
+ * Usage:
+ *
+ *   createDemoContext(&demo, argc, argv, "title");
+ *   startupPhase("shaders");
+ *   ... compile ...
+ *   startupPhase("textures");
+ *   ... upload ...
+ *
+ * The phase names must be string literals (or outlive the profile). Without
+ * the option only the CPU time of the boundaries is recorded, nothing is printed.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_STARTUP_PROFILE_H
+#define GLES_COMMON_STARTUP_PROFILE_H
+
+// End the current startup phase and begin the next one. Ignored after the first frame.
+void startupPhase(const char* name);
+
+// Print the breakdown at the first frame ("--startup-profile", called by the demo context).
+void startupProfileEnable();
+
+// The GL context is current: the next phases get GPU timestamps (if supported).
+void startupProfileContextReady();
+
+// The first frame was presented: end the last phase and print the breakdown (if enabled).
+/* Waits for the GPU timestamps of the phases (once). */
+void startupProfileFirstFrame();
+
+#endif // GLES_COMMON_STARTUP_PROFILE_H
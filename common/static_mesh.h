@@ -0,0 +1,365 @@
+/**
+ * Compile time (constexpr) generation of procedural meshes: cube, plane, grid,
+ * sphere and torus with the tessellation as template parameters.
+ *
+ * The generators build the indexed vertex data in the upload formats of
+ * common/mesh.h during the compilation: a "static constexpr" mesh is stored in
+ * the read-only data of the binary and uploaded as is with uploadPackedMesh,
+ * there is no generation or packing at startup:
+ *
+ *   static constexpr auto sphere = staticSphere<StaticPackedVertex, 32, 16>();
+ *   MeshBuffers buffers = uploadPackedMesh(staticMeshStreams(sphere), sphere.vertices, sphere.indices, 0, 1);
+ *
+ * Vertex formats (same as the default and packed formats of common/mesh.h):
+ *  * StaticVertex:       position: 3 x float, texture coords: 2 x float (20 bytes)
+ *  * StaticPackedVertex: position: 4 x half float, texture coords: 2 x normalized
+ *                        unsigned short (12 bytes)
+ * The indices are 16 bit up to 65536 vertices, 32 bit above.
+ *
+ * Every mesh fits into the unit cube ([-0.5, 0.5]), the triangles are counter
+ * clockwise seen from the outside (the plane and the grid: from +Y and +Z).
+ * The triangle order is not optimized for the vertex cache (optimizeMesh needs
+ * the runtime MeshData, see staticMeshData), the vertices are in row order.
+ *
+ * Large meshes increase the compile time: the compiler evaluates every vertex
+ * (GCC: raise -fconstexpr-ops-limit / -fconstexpr-loop-limit above ~100k vertices).
+ *
+ * Dependencies:
+ *  * C++14 (relaxed constexpr)
+ *  * Open GL ES 3.0+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_STATIC_MESH_H
+#define GLES_COMMON_STATIC_MESH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <type_traits>
+
+#include <GLES3/gl3.h>
+
+#include "common/mesh.h"
+
+struct StaticVertex {
+    float position[3];
+    float texCoord[2];
+};
+
+struct StaticPackedVertex {
+    uint16_t position[4]; // half float, w = 1.0
+    uint16_t texCoord[2]; // unorm16
+};
+
+template <typename Vertex, int VertexCount, int IndexCount>
+struct StaticMesh {
+    typedef typename std::conditional<(VertexCount <= 65536), uint16_t, uint32_t>::type Index;
+
+    static constexpr int vertexCount = VertexCount;
+    static constexpr int indexCount = IndexCount;
+
+    Vertex vertices[VertexCount];
+    Index indices[IndexCount];
+};
+
+namespace static_mesh_detail {
+
+constexpr double pi = 3.14159265358979323846;
+
+// sin/cos of the standard library are not constexpr: Taylor series after a range reduction to [-pi, pi].
+constexpr double sine(double x) {
+    while (x > pi) {
+        x -= 2.0 * pi;
+    }
+    while (x < -pi) {
+        x += 2.0 * pi;
+    }
+
+    double term = x;
+    double sum = x;
+    for (int n = 1; n < 12; n++) {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double cosine(double x) {
+    return sine(x + pi / 2.0);
+}
+
+// Same conversion as the packed format of common/mesh.cpp: round to nearest, flush to zero, no NaN.
+constexpr uint16_t floatToHalf(float value) {
+    uint16_t sign = value < 0.0f ? 0x8000 : 0;
+    double magnitude = value < 0.0f ? -value : value;
+    if (magnitude < 1.0 / 16384.0) {
+        return sign;
+    }
+
+    int exponent = 0;
+    while (magnitude >= 2.0) {
+        magnitude *= 0.5;
+        exponent++;
+    }
+    while (magnitude < 1.0) {
+        magnitude *= 2.0;
+        exponent--;
+    }
+    if (exponent + 15 >= 31) {
+        return sign | 0x7c00;
+    }
+
+    /* A mantissa of 1024 after the rounding carries into the exponent. */
+    uint32_t mantissa = (uint32_t)((magnitude - 1.0) * 1024.0 + 0.5);
+    return sign | (uint16_t)((((uint32_t)(exponent + 15)) << 10) + mantissa);
+}
+
+constexpr uint16_t floatToUnorm16(float value) {
+    return (uint16_t)((value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value)) * 65535.0f + 0.5f);
+}
+
+constexpr void writeVertex(StaticVertex& vertex, float x, float y, float z, float u, float v) {
+    vertex.position[0] = x;
+    vertex.position[1] = y;
+    vertex.position[2] = z;
+    vertex.texCoord[0] = u;
+    vertex.texCoord[1] = v;
+}
+
+constexpr void writeVertex(StaticPackedVertex& vertex, float x, float y, float z, float u, float v) {
+    vertex.position[0] = floatToHalf(x);
+    vertex.position[1] = floatToHalf(y);
+    vertex.position[2] = floatToHalf(z);
+    vertex.position[3] = floatToHalf(1.0f);
+    vertex.texCoord[0] = floatToUnorm16(u);
+    vertex.texCoord[1] = floatToUnorm16(v);
+}
+
+// Two triangles of the quad (a, b, c, d counter clockwise) at the index "at", returns the next index.
+template <typename Index>
+constexpr int writeQuad(Index* indices, int at, uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    indices[at + 0] = (Index)a;
+    indices[at + 1] = (Index)b;
+    indices[at + 2] = (Index)c;
+    indices[at + 3] = (Index)c;
+    indices[at + 4] = (Index)d;
+    indices[at + 5] = (Index)a;
+    return at + 6;
+}
+
+} // namespace static_mesh_detail
+
+// Unit cube: 4 vertices per face (the texture covers each face, upright on the side faces).
+template <typename Vertex>
+constexpr StaticMesh<Vertex, 24, 36> staticCube() {
+    using namespace static_mesh_detail;
+
+    // Per face: the normal axis and sign, the u and v axes and signs (u x v points outwards).
+    const int faces[6][6] = {
+        { 0, +1, 2, -1, 1, +1 }, { 0, -1, 2, +1, 1, +1 },
+        { 1, +1, 0, +1, 2, -1 }, { 1, -1, 0, +1, 2, +1 },
+        { 2, +1, 0, +1, 1, +1 }, { 2, -1, 0, -1, 1, +1 },
+    };
+
+    StaticMesh<Vertex, 24, 36> mesh{};
+    int index = 0;
+    for (int face = 0; face < 6; face++) {
+        const int* axes = faces[face];
+        for (int corner = 0; corner < 4; corner++) {
+            // Corners counter clockwise seen from the outside: (0, 0), (1, 0), (1, 1), (0, 1).
+            float u = (corner == 1 || corner == 2) ? 1.0f : 0.0f;
+            float v = (corner >= 2) ? 1.0f : 0.0f;
+
+            float position[3] = { 0.0f, 0.0f, 0.0f };
+            position[axes[0]] = 0.5f * axes[1];
+            position[axes[2]] = (u - 0.5f) * axes[3];
+            position[axes[4]] = (v - 0.5f) * axes[5];
+            writeVertex(mesh.vertices[face * 4 + corner], position[0], position[1], position[2], u, v);
+        }
+
+        uint32_t base = face * 4;
+        index = writeQuad(mesh.indices, index, base, base + 1, base + 2, base + 3);
+    }
+    return mesh;
+}
+
+// Grid of Columns x Rows quads in the XY plane (facing +Z), same layout as createGridMesh.
+template <typename Vertex, int Columns, int Rows>
+constexpr StaticMesh<Vertex, (Columns + 1) * (Rows + 1), Columns * Rows * 6> staticGrid() {
+    using namespace static_mesh_detail;
+    static_assert(Columns > 0 && Rows > 0, "the grid needs at least one quad");
+
+    StaticMesh<Vertex, (Columns + 1) * (Rows + 1), Columns * Rows * 6> mesh{};
+    for (int y = 0; y <= Rows; y++) {
+        for (int x = 0; x <= Columns; x++) {
+            float u = (float)x / Columns;
+            float v = (float)y / Rows;
+            writeVertex(mesh.vertices[y * (Columns + 1) + x], u - 0.5f, v - 0.5f, 0.0f, u, v);
+        }
+    }
+
+    int index = 0;
+    for (int y = 0; y < Rows; y++) {
+        for (int x = 0; x < Columns; x++) {
+            uint32_t corner = y * (Columns + 1) + x;
+            index = writeQuad(mesh.indices, index, corner, corner + 1, corner + Columns + 2, corner + Columns + 1);
+        }
+    }
+    return mesh;
+}
+
+// Plane of Columns x Rows quads in the XZ plane (facing +Y, ex.: a floor).
+template <typename Vertex, int Columns, int Rows>
+constexpr StaticMesh<Vertex, (Columns + 1) * (Rows + 1), Columns * Rows * 6> staticPlane() {
+    using namespace static_mesh_detail;
+    static_assert(Columns > 0 && Rows > 0, "the plane needs at least one quad");
+
+    StaticMesh<Vertex, (Columns + 1) * (Rows + 1), Columns * Rows * 6> mesh{};
+    for (int z = 0; z <= Rows; z++) {
+        for (int x = 0; x <= Columns; x++) {
+            float u = (float)x / Columns;
+            float v = (float)z / Rows;
+            /* v runs towards -Z: the rows are counter clockwise seen from +Y. */
+            writeVertex(mesh.vertices[z * (Columns + 1) + x], u - 0.5f, 0.0f, 0.5f - v, u, v);
+        }
+    }
+
+    int index = 0;
+    for (int z = 0; z < Rows; z++) {
+        for (int x = 0; x < Columns; x++) {
+            uint32_t corner = z * (Columns + 1) + x;
+            index = writeQuad(mesh.indices, index, corner, corner + 1, corner + Columns + 2, corner + Columns + 1);
+        }
+    }
+    return mesh;
+}
+
+// UV sphere (radius 0.5) of Slices around the Y axis and Stacks from the top to the bottom pole.
+/* The seam and the poles have duplicated vertices for the texture coords, the pole rows have one triangle per quad. */
+template <typename Vertex, int Slices, int Stacks>
+constexpr StaticMesh<Vertex, (Slices + 1) * (Stacks + 1), Slices * (Stacks - 1) * 6> staticSphere() {
+    using namespace static_mesh_detail;
+    static_assert(Slices >= 3 && Stacks >= 2, "the sphere needs at least 3 slices and 2 stacks");
+
+    typedef StaticMesh<Vertex, (Slices + 1) * (Stacks + 1), Slices * (Stacks - 1) * 6> Mesh;
+    typedef typename Mesh::Index Index;
+
+    Mesh mesh{};
+    for (int stack = 0; stack <= Stacks; stack++) {
+        double theta = pi * stack / Stacks; // 0: top pole
+        for (int slice = 0; slice <= Slices; slice++) {
+            double phi = 2.0 * pi * slice / Slices;
+            float x = (float)(0.5 * sine(theta) * sine(phi));
+            float y = (float)(0.5 * cosine(theta));
+            float z = (float)(0.5 * sine(theta) * cosine(phi));
+            writeVertex(mesh.vertices[stack * (Slices + 1) + slice], x, y, z,
+                        (float)slice / Slices, 1.0f - (float)stack / Stacks);
+        }
+    }
+
+    int index = 0;
+    for (int stack = 0; stack < Stacks; stack++) {
+        for (int slice = 0; slice < Slices; slice++) {
+            uint32_t top = stack * (Slices + 1) + slice;
+            uint32_t bottom = top + Slices + 1;
+            if (stack > 0) {
+                mesh.indices[index++] = (Index)top;
+                mesh.indices[index++] = (Index)bottom;
+                mesh.indices[index++] = (Index)(top + 1);
+            }
+            if (stack < Stacks - 1) {
+                mesh.indices[index++] = (Index)(top + 1);
+                mesh.indices[index++] = (Index)bottom;
+                mesh.indices[index++] = (Index)(bottom + 1);
+            }
+        }
+    }
+    return mesh;
+}
+
+// Torus around the Y axis (ring radius 0.35, tube radius 0.15) of Segments around the ring and Sides around the tube.
+template <typename Vertex, int Segments, int Sides>
+constexpr StaticMesh<Vertex, (Segments + 1) * (Sides + 1), Segments * Sides * 6> staticTorus() {
+    using namespace static_mesh_detail;
+    static_assert(Segments >= 3 && Sides >= 3, "the torus needs at least 3 segments and 3 sides");
+
+    StaticMesh<Vertex, (Segments + 1) * (Sides + 1), Segments * Sides * 6> mesh{};
+    for (int segment = 0; segment <= Segments; segment++) {
+        double phi = 2.0 * pi * segment / Segments;
+        for (int side = 0; side <= Sides; side++) {
+            double theta = 2.0 * pi * side / Sides;
+            double ring = 0.35 + 0.15 * cosine(theta);
+            writeVertex(mesh.vertices[segment * (Sides + 1) + side], (float)(ring * sine(phi)),
+                        (float)(0.15 * sine(theta)), (float)(ring * cosine(phi)),
+                        (float)segment / Segments, (float)side / Sides);
+        }
+    }
+
+    int index = 0;
+    for (int segment = 0; segment < Segments; segment++) {
+        for (int side = 0; side < Sides; side++) {
+            uint32_t corner = segment * (Sides + 1) + side;
+            uint32_t next = corner + Sides + 1;
+            index = writeQuad(mesh.indices, index, corner, next, next + 1, corner + 1);
+        }
+    }
+    return mesh;
+}
+
+// Placement of the vertex and index data for uploadPackedMesh (interleaved layout).
+template <typename Vertex, int VertexCount, int IndexCount>
+constexpr MeshStreams staticMeshStreams(const StaticMesh<Vertex, VertexCount, IndexCount>& mesh) {
+    (void)mesh;
+    typedef typename StaticMesh<Vertex, VertexCount, IndexCount>::Index Index;
+    const uint32_t stride = sizeof(Vertex);
+
+    MeshStreams streams{};
+    streams.vertexCount = VertexCount;
+    streams.indexCount = IndexCount;
+    streams.indexType = sizeof(Index) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    streams.packed = std::is_same<Vertex, StaticPackedVertex>::value;
+    streams.layout = MESH_LAYOUT_INTERLEAVED;
+    streams.vertexBufferSize = VertexCount * stride;
+    streams.indexBufferSize = IndexCount * sizeof(Index);
+    streams.positionOffset = offsetof(Vertex, position);
+    streams.positionStride = stride;
+    streams.texCoordOffset = offsetof(Vertex, texCoord);
+    streams.texCoordStride = stride;
+    streams.depthOffset = streams.positionOffset;
+    streams.depthStride = stride;
+    return streams;
+}
+
+// Runtime copy of an unpacked static mesh (ex.: for optimizeMesh or expandWireframeMesh).
+template <int VertexCount, int IndexCount>
+MeshData staticMeshData(const StaticMesh<StaticVertex, VertexCount, IndexCount>& mesh) {
+    MeshData data;
+    for (int idx = 0; idx < VertexCount; idx++) {
+        data.positions.insert(data.positions.end(), mesh.vertices[idx].position, mesh.vertices[idx].position + 3);
+        data.texCoords.insert(data.texCoords.end(), mesh.vertices[idx].texCoord, mesh.vertices[idx].texCoord + 2);
+    }
+    data.indices.assign(mesh.indices, mesh.indices + IndexCount);
+    return data;
+}
+
+#endif // GLES_COMMON_STATIC_MESH_H
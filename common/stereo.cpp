@@ -0,0 +1,235 @@
+/**
+ * Stereo rendering into a two layer texture array. See stereo.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/stereo.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#include "common/gpu_memory.h"
+
+static PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC framebufferTextureMultiview;
+
+static const char* modeNames[STEREO_MODE_COUNT] = { "two-pass", "multiview" };
+
+#define STEREO_EYES_BLOCK \
+    "layout(std140) uniform StereoEyes {\n" \
+    "    mat4 stereoView[2];\n" \
+    "    mat4 stereoProjection[2];\n" \
+    "};\n"
+
+static const char* modeHeaders[STEREO_MODE_COUNT] = {
+    "uniform int uStereoEye;\n" STEREO_EYES_BLOCK "#define STEREO_EYE uStereoEye\n",
+    "#extension GL_OVR_multiview2 : require\nlayout(num_views = 2) in;\n" STEREO_EYES_BLOCK
+    "#define STEREO_EYE int(gl_ViewID_OVR)\n",
+};
+
+static bool hasGLExtension(const char* name) {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int idx = 0; idx < count; idx++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, idx), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* stereoModeName(StereoMode mode) {
+    return mode < STEREO_MODE_COUNT ? modeNames[mode] : "unknown";
+}
+
+StereoMode findStereoMode(const char* name) {
+    for (int idx = 0; idx < STEREO_MODE_COUNT; idx++) {
+        if (strcmp(modeNames[idx], name) == 0) {
+            return (StereoMode)idx;
+        }
+    }
+    return STEREO_MODE_COUNT;
+}
+
+bool stereoMultiviewSupported() {
+    if (!hasGLExtension("GL_OVR_multiview2")) {
+        return false;
+    }
+    if (framebufferTextureMultiview == NULL) {
+        framebufferTextureMultiview =
+            (PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC)eglGetProcAddress("glFramebufferTextureMultiviewOVR");
+    }
+    int maxViews = 0;
+    glGetIntegerv(GL_MAX_VIEWS_OVR, &maxViews);
+    return framebufferTextureMultiview != NULL && maxViews >= 2;
+}
+
+static unsigned int createLayers(unsigned int format, int width, int height, const char* label) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, format, width, height, 2);
+    gpuMemoryTrackTexture(texture, format, width, height, 2, 1, GPU_MEMORY_RENDER_TARGET, label);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return texture;
+}
+
+static bool checkFramebuffer(const char* name) {
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("Stereo: the %s FBO is incomplete (0x%x)\n", name, status);
+        return false;
+    }
+    return true;
+}
+
+bool initStereoTarget(StereoTarget* stereo, StereoMode mode, int eyeWidth, int eyeHeight) {
+    memset(stereo, 0, sizeof(*stereo));
+    stereo->mode = mode;
+    stereo->width = eyeWidth;
+    stereo->height = eyeHeight;
+    stereo->eyeLoc = -1;
+
+    if (mode == STEREO_MULTIVIEW && !stereoMultiviewSupported()) {
+        printf("Stereo: GL_OVR_multiview2 is not supported\n");
+        return false;
+    }
+
+    stereo->color = createLayers(GL_RGBA8, eyeWidth, eyeHeight, "stereo color");
+    stereo->depth = createLayers(GL_DEPTH_COMPONENT24, eyeWidth, eyeHeight, "stereo depth");
+
+    // 1. One FBO per layer: the draws of the two pass mode (with the depth layer) and the reads of the composite.
+    bool complete = true;
+    glGenFramebuffers(2, stereo->eyeFbos);
+    for (int eye = 0; eye < 2; eye++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, stereo->eyeFbos[eye]);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, stereo->color, 0, eye);
+        if (mode == STEREO_TWO_PASS) {
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, stereo->depth, 0, eye);
+        }
+        complete = checkFramebuffer(eye == 0 ? "left eye" : "right eye") && complete;
+    }
+
+    // 2. Multiview: both layers of the color and the depth in one FBO.
+    if (mode == STEREO_MULTIVIEW) {
+        glGenFramebuffers(1, &stereo->fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, stereo->fbo);
+        framebufferTextureMultiview(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, stereo->color, 0, 0, 2);
+        framebufferTextureMultiview(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, stereo->depth, 0, 0, 2);
+        complete = checkFramebuffer("multiview") && complete;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // 3. The uniform block of the eye matrices.
+    glGenBuffers(1, &stereo->eyesBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, stereo->eyesBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, 4 * 16 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+    gpuMemoryTrackBuffer(stereo->eyesBuffer, 4 * 16 * sizeof(float), GPU_MEMORY_STREAM, "stereo eyes");
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    if (!complete) {
+        destroyStereoTarget(stereo);
+        return false;
+    }
+    return true;
+}
+
+void destroyStereoTarget(StereoTarget* stereo) {
+    glDeleteFramebuffers(2, stereo->eyeFbos);
+    if (stereo->fbo) {
+        glDeleteFramebuffers(1, &stereo->fbo);
+    }
+    unsigned int textures[] = { stereo->color, stereo->depth };
+    glDeleteTextures(2, textures);
+    gpuMemoryReleaseTextures(2, textures);
+    glDeleteBuffers(1, &stereo->eyesBuffer);
+    gpuMemoryReleaseBuffers(1, &stereo->eyesBuffer);
+    memset(stereo, 0, sizeof(*stereo));
+}
+
+const char* stereoShaderHeader(StereoMode mode) {
+    return modeHeaders[mode];
+}
+
+void stereoSetupProgram(unsigned int program) {
+    unsigned int block = glGetUniformBlockIndex(program, "StereoEyes");
+    if (block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, block, STEREO_EYES_BINDING);
+    }
+}
+
+void stereoSetEyes(StereoTarget* stereo, const float* views, const float* projections) {
+    glBindBuffer(GL_UNIFORM_BUFFER, stereo->eyesBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, 2 * 16 * sizeof(float), views);
+    glBufferSubData(GL_UNIFORM_BUFFER, 2 * 16 * sizeof(float), 2 * 16 * sizeof(float), projections);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, STEREO_EYES_BINDING, stereo->eyesBuffer);
+}
+
+int stereoPassCount(const StereoTarget* stereo) {
+    return stereo->mode == STEREO_MULTIVIEW ? 1 : 2;
+}
+
+void stereoBeginEye(StereoTarget* stereo, unsigned int program, int eye) {
+    if (stereo->mode == STEREO_MULTIVIEW) {
+        glBindFramebuffer(GL_FRAMEBUFFER, stereo->fbo);
+    } else {
+        glBindFramebuffer(GL_FRAMEBUFFER, stereo->eyeFbos[eye]);
+        if (stereo->eyeProgram != program) {
+            stereo->eyeProgram = program;
+            stereo->eyeLoc = glGetUniformLocation(program, "uStereoEye");
+        }
+        glUniform1i(stereo->eyeLoc, eye);
+    }
+    glViewport(0, 0, stereo->width, stereo->height);
+    /* Multiview: the clear writes every view. */
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void stereoComposite(StereoTarget* stereo, unsigned int framebuffer, int width, int height) {
+    // 1. The depth isn't needed after the draws: don't store it.
+    const GLenum depthAttachment = GL_DEPTH_ATTACHMENT;
+    if (stereo->mode == STEREO_MULTIVIEW) {
+        glBindFramebuffer(GL_FRAMEBUFFER, stereo->fbo);
+        glInvalidateFramebuffer(GL_FRAMEBUFFER, 1, &depthAttachment);
+    } else {
+        for (int eye = 0; eye < 2; eye++) {
+            glBindFramebuffer(GL_FRAMEBUFFER, stereo->eyeFbos[eye]);
+            glInvalidateFramebuffer(GL_FRAMEBUFFER, 1, &depthAttachment);
+        }
+    }
+
+    // 2. The left eye into the left half, the right eye into the right half.
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    for (int eye = 0; eye < 2; eye++) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, stereo->eyeFbos[eye]);
+        glBlitFramebuffer(0, 0, stereo->width, stereo->height, eye * width / 2, 0, (eye + 1) * width / 2, height,
+                          GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+}
@@ -0,0 +1,126 @@
+/**
+ * Stereo rendering into a two layer texture array: OVR_multiview or one pass per eye.
+ *
+ * The eyes are the layers 0 (left) and 1 (right) of a color and a depth
+ * GL_TEXTURE_2D_ARRAY. The view and projection matrices of the eyes are in a
+ * uniform block ("StereoEyes", std140, binding STEREO_EYES_BINDING), the
+ * vertex shader selects them with STEREO_EYE.
+ *
+ * Modes:
+ *  STEREO_TWO_PASS   The scene is drawn twice, into an FBO per layer: the
+ *                    eye index is a uniform set by stereoBeginEye.
+ *  STEREO_MULTIVIEW  GL_OVR_multiview2: both layers are attached to one FBO
+ *                    (glFramebufferTextureMultiviewOVR) and every draw renders
+ *                    both eyes, STEREO_EYE is gl_ViewID_OVR. The CPU submits
+ *                    the draws once and the driver can share the vertex work
+ *                    which doesn't depend on the view.
+ *
+ * Usage:
+ *
+ *   StereoTarget stereo;
+ *   initStereoTarget(&stereo, stereoMultiviewSupported() ? STEREO_MULTIVIEW : STEREO_TWO_PASS, eyeWidth, eyeHeight);
+ *   // Vertex shader: stereoShaderHeader(mode) after the "#version" line, then
+ *   //   gl_Position = stereoProjection[STEREO_EYE] * stereoView[STEREO_EYE] * position;
+ *   stereoSetupProgram(program);
+ *   ...
+ *   stereoSetEyes(&stereo, views, projections);
+ *   for (int eye = 0; eye < stereoPassCount(&stereo); eye++) {
+ *       glUseProgram(program);
+ *       stereoBeginEye(&stereo, program, eye); // bind, viewport, clear
+ *       ... draw the scene ...
+ *   }
+ *   stereoComposite(&stereo, demoDefaultFramebuffer(&demo), width, height); // side by side
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *  * GL_OVR_multiview2 (optional)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_STEREO_H
+#define GLES_COMMON_STEREO_H
+
+// Uniform buffer binding of the "StereoEyes" block.
+#define STEREO_EYES_BINDING 2
+
+enum StereoMode {
+    STEREO_TWO_PASS,
+    STEREO_MULTIVIEW,
+    STEREO_MODE_COUNT,
+};
+
+struct StereoTarget {
+    StereoMode mode;
+    int width;  // size of one eye
+    int height;
+
+    unsigned int color;      // RGBA8 2D array, layer = eye
+    unsigned int depth;      // DEPTH_COMPONENT24 2D array
+    unsigned int fbo;        // multiview: both layers (two pass: 0)
+    unsigned int eyeFbos[2]; // one layer each: the two pass draws and the composite reads
+    unsigned int eyesBuffer; // the "StereoEyes" uniform block
+
+    // Two pass mode: location of "uStereoEye" in the last program of stereoBeginEye.
+    unsigned int eyeProgram;
+    int eyeLoc;
+};
+
+// Name of the mode for the command line and the reports ("two-pass", "multiview").
+const char* stereoModeName(StereoMode mode);
+
+// Look up a mode by name (STEREO_MODE_COUNT if unknown).
+StereoMode findStereoMode(const char* name);
+
+// GL_OVR_multiview2 with at least two views (requires a current GL ES context).
+bool stereoMultiviewSupported();
+
+// Create the eye layers and the framebuffers of the mode.
+/* Returns false if the mode is not supported or an FBO is incomplete. */
+bool initStereoTarget(StereoTarget* stereo, StereoMode mode, int eyeWidth, int eyeHeight);
+
+void destroyStereoTarget(StereoTarget* stereo);
+
+// Source lines for the vertex shaders of the mode, insert them after the "#version" line.
+/* The #extension and the view count (multiview), the "StereoEyes" block
+ *   mat4 stereoView[2];
+ *   mat4 stereoProjection[2];
+ * and STEREO_EYE: the eye index of the vertex (int). */
+const char* stereoShaderHeader(StereoMode mode);
+
+// Bind the "StereoEyes" block of the program to STEREO_EYES_BINDING.
+void stereoSetupProgram(unsigned int program);
+
+// Upload the matrices of the frame: two column major mat4 each (left, right).
+void stereoSetEyes(StereoTarget* stereo, const float* views, const float* projections);
+
+// Number of stereoBeginEye passes of a frame: 1 (multiview) or 2.
+int stereoPassCount(const StereoTarget* stereo);
+
+// Bind the FBO of the pass, set the viewport, clear the color and the depth and set the eye of the program.
+/* The program must be in use (two pass mode: its "uStereoEye" uniform is set). */
+void stereoBeginEye(StereoTarget* stereo, unsigned int program, int eye);
+
+// Blit the eyes side by side into the framebuffer (left half: the left eye) and invalidate the depth layers.
+void stereoComposite(StereoTarget* stereo, unsigned int framebuffer, int width, int height);
+
+#endif // GLES_COMMON_STEREO_H
@@ -0,0 +1,168 @@
+/**
+ * Streaming buffer allocator. See stream_buffer.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/stream_buffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <GLES3/gl3.h>
+
+#include "common/device_profile.h"
+#include "common/gl_state.h"
+#include "common/gpu_memory.h"
+
+static const char* mode_names[STREAM_UPLOAD_MODE_COUNT] = { "ring", "invalidate", "orphan", "sub_data" };
+
+const char* streamUploadModeName(StreamUploadMode mode) {
+    return mode < STREAM_UPLOAD_MODE_COUNT ? mode_names[mode] : "auto";
+}
+
+bool parseStreamUploadMode(const char* name, StreamUploadMode* mode) {
+    for (int idx = 0; idx <= STREAM_UPLOAD_MODE_COUNT; idx++) {
+        if (strcmp(name, streamUploadModeName((StreamUploadMode)idx)) == 0) {
+            *mode = (StreamUploadMode)idx;
+            return true;
+        }
+    }
+    return false;
+}
+
+void initStreamBuffer(StreamBuffer* stream, unsigned int target, int regionSize, StreamUploadMode mode) {
+    const DeviceProfile* profile = deviceProfile();
+    if (mode == STREAM_UPLOAD_AUTO &&
+        (profile == NULL || !parseStreamUploadMode(profile->streamUpload.c_str(), &mode) || mode == STREAM_UPLOAD_AUTO)) {
+        mode = STREAM_UPLOAD_RING;
+    }
+
+    // Every region starts at an offset which satisfies any usual alignment (UBO offsets: 256 at most).
+    stream->target = target;
+    stream->mode = mode;
+    stream->regionSize = (regionSize + 255) / 256 * 256;
+    stream->regionCount = mode == STREAM_UPLOAD_RING ? STREAM_BUFFER_REGIONS : 1;
+    stream->region = stream->regionCount - 1;
+    stream->used = 0;
+    stream->mapped = NULL;
+    stream->staging = mode == STREAM_UPLOAD_SUB_DATA ? (uint8_t*)malloc(stream->regionSize) : NULL;
+    stream->stalls = 0;
+    for (int idx = 0; idx < STREAM_BUFFER_REGIONS; idx++) {
+        stream->fences[idx] = NULL;
+    }
+
+    int bufferSize = stream->regionSize * stream->regionCount;
+    glGenBuffers(1, &stream->buffer);
+    stateCacheBindBuffer(target, stream->buffer);
+    glBufferData(target, bufferSize, NULL, GL_STREAM_DRAW);
+    gpuMemoryTrackBuffer(stream->buffer, bufferSize, GPU_MEMORY_STREAM, "stream buffer");
+    stateCacheBindBuffer(target, 0);
+}
+
+void destroyStreamBuffer(StreamBuffer* stream) {
+    for (int idx = 0; idx < STREAM_BUFFER_REGIONS; idx++) {
+        if (stream->fences[idx]) {
+            glDeleteSync((GLsync)stream->fences[idx]);
+            stream->fences[idx] = NULL;
+        }
+    }
+
+    free(stream->staging);
+    stream->staging = NULL;
+
+    glDeleteBuffers(1, &stream->buffer);
+    gpuMemoryReleaseBuffers(1, &stream->buffer);
+    stream->buffer = 0;
+}
+
+void streamBufferBeginFrame(StreamBuffer* stream) {
+    stream->used = 0;
+    if (stream->mode != STREAM_UPLOAD_RING) {
+        // The driver synchronizes: it renames the storage on orphaning, or waits/copies for the other modes.
+        if (stream->mode == STREAM_UPLOAD_SUB_DATA) {
+            stream->mapped = stream->staging;
+            return;
+        }
+
+        GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+        stateCacheBindBuffer(stream->target, stream->buffer);
+        if (stream->mode == STREAM_UPLOAD_ORPHAN) {
+            glBufferData(stream->target, stream->regionSize, NULL, GL_STREAM_DRAW);
+            access |= GL_MAP_UNSYNCHRONIZED_BIT;
+        }
+        stream->mapped = (uint8_t*)glMapBufferRange(stream->target, 0, stream->regionSize, access);
+        stateCacheBindBuffer(stream->target, 0);
+        return;
+    }
+
+    // 1. The draws of the previous frame are done with the previous region after this fence.
+    if (stream->fences[stream->region]) {
+        glDeleteSync((GLsync)stream->fences[stream->region]);
+    }
+    stream->fences[stream->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    // 2. Move to the next region, wait if the GPU could still read it.
+    stream->region = (stream->region + 1) % STREAM_BUFFER_REGIONS;
+
+    GLsync fence = (GLsync)stream->fences[stream->region];
+    if (fence) {
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            stream->stalls++;
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        }
+        glDeleteSync(fence);
+        stream->fences[stream->region] = NULL;
+    }
+
+    // 3. The fence guarantees that the GPU is done with the range: no need for the driver to synchronize.
+    stateCacheBindBuffer(stream->target, stream->buffer);
+    stream->mapped = (uint8_t*)glMapBufferRange(stream->target, stream->region * stream->regionSize, stream->regionSize,
+                                                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    stateCacheBindBuffer(stream->target, 0);
+}
+
+void* streamBufferAllocate(StreamBuffer* stream, int size, int alignment, int* offset) {
+    int start = (stream->used + alignment - 1) & ~(alignment - 1);
+    if (stream->mapped == NULL || start + size > stream->regionSize) {
+        printf("Stream buffer: region is full (%d + %d > %d bytes)\n", start, size, stream->regionSize);
+        *offset = -1;
+        return NULL;
+    }
+
+    stream->used = start + size;
+    *offset = stream->region * stream->regionSize + start;
+    return stream->mapped + start;
+}
+
+void streamBufferEndFrame(StreamBuffer* stream) {
+    stateCacheBindBuffer(stream->target, stream->buffer);
+    if (stream->mode == STREAM_UPLOAD_SUB_DATA) {
+        if (stream->used > 0) {
+            glBufferSubData(stream->target, 0, stream->used, stream->staging);
+        }
+    } else {
+        glUnmapBuffer(stream->target);
+    }
+    stateCacheBindBuffer(stream->target, 0);
+    stream->mapped = NULL;
+}
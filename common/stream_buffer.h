@@ -0,0 +1,124 @@
+/**
+ * Streaming buffer allocator for data written by the CPU every frame (vertices, instances, constants).
+ *
+ * One large buffer object is split into regions, one per frame in flight.
+ * Every frame the next region is mapped with GL_MAP_UNSYNCHRONIZED_BIT and
+ * GL_MAP_INVALIDATE_RANGE_BIT: the driver neither waits for the GPU nor
+ * copies the buffer. A fence inserted after the frame's draws guards the
+ * region, it's only waited for when the region comes around again
+ * (STREAM_BUFFER_REGIONS frames later), which is normally already signaled.
+ *
+ * The allocations are sub-ranges of the mapped region: the caller writes
+ * the data directly into the returned pointer, then uses the returned
+ * offset (ex.: glVertexAttribPointer offset, glBindBufferRange).
+ *
+ * The fenced ring above is STREAM_UPLOAD_RING, the other upload modes leave
+ * the synchronization to the driver and use a single region:
+ *
+ *  STREAM_UPLOAD_INVALIDATE  glMapBufferRange with GL_MAP_INVALIDATE_RANGE_BIT only.
+ *  STREAM_UPLOAD_ORPHAN      glBufferData(NULL) every frame (the driver renames the
+ *                            storage), then an unsynchronized map.
+ *  STREAM_UPLOAD_SUB_DATA    The allocations are in CPU memory, copied with
+ *                            glBufferSubData at the end of the frame.
+ *
+ * Which one is the fastest depends on the driver: glesbench compares them
+ * ("stream_*" benchmarks) and the device profile calibrates the default mode
+ * (STREAM_UPLOAD_AUTO, the ring without a loaded profile).
+ *
+ * Usage:
+ *
+ *   StreamBuffer stream;
+ *   initStreamBuffer(&stream, GL_ARRAY_BUFFER, 4 * 1024 * 1024);
+ *   while (...) {
+ *       streamBufferBeginFrame(&stream);               // map the next region
+ *       int offset;
+ *       float* vertices = (float*)streamBufferAllocate(&stream, size, 16, &offset);
+ *       ... write the vertices ...
+ *       streamBufferEndFrame(&stream);                 // unmap, ready for the draws
+ *       ... draw from stream.buffer at "offset" ...
+ *   }
+ *   destroyStreamBuffer(&stream);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_STREAM_BUFFER_H
+#define GLES_COMMON_STREAM_BUFFER_H
+
+#include <stdint.h>
+
+// Number of frames which can be in flight (each has its own region in the buffer).
+#define STREAM_BUFFER_REGIONS 3
+
+enum StreamUploadMode {
+    STREAM_UPLOAD_RING,       // fenced regions mapped with GL_MAP_UNSYNCHRONIZED_BIT
+    STREAM_UPLOAD_INVALIDATE,
+    STREAM_UPLOAD_ORPHAN,
+    STREAM_UPLOAD_SUB_DATA,
+    STREAM_UPLOAD_MODE_COUNT,
+    STREAM_UPLOAD_AUTO = STREAM_UPLOAD_MODE_COUNT // the calibrated mode of the device profile
+};
+
+struct StreamBuffer {
+    unsigned int buffer;
+    unsigned int target; // binding point used for the mapping (ex.: GL_ARRAY_BUFFER)
+    StreamUploadMode mode;
+    int regionSize;
+    int regionCount;     // STREAM_BUFFER_REGIONS for the ring, 1 otherwise
+
+    int region;    // current region index
+    int used;      // bytes used in the current region
+    uint8_t* mapped;
+    uint8_t* staging;    // STREAM_UPLOAD_SUB_DATA: the CPU copy of the region
+    void* fences[STREAM_BUFFER_REGIONS]; // GLsync of each region's last use
+
+    // Statistics: frames where the GPU still used the next region (the CPU had to wait).
+    int stalls;
+};
+
+// Name of a mode ("ring", "invalidate", "orphan", "sub_data").
+const char* streamUploadModeName(StreamUploadMode mode);
+
+// Parse a mode name, returns false if it is unknown ("auto" is STREAM_UPLOAD_AUTO).
+bool parseStreamUploadMode(const char* name, StreamUploadMode* mode);
+
+// Create the buffer with the regions of "regionSize" bytes (multiple of 256) the mode needs.
+void initStreamBuffer(StreamBuffer* stream, unsigned int target, int regionSize,
+                      StreamUploadMode mode = STREAM_UPLOAD_AUTO);
+
+void destroyStreamBuffer(StreamBuffer* stream);
+
+// Fence the previous region and map the next one (waits only if the GPU still uses it).
+/* The other modes orphan or map the single region, or reset the CPU staging copy. */
+void streamBufferBeginFrame(StreamBuffer* stream);
+
+// Allocate "size" bytes at an offset aligned to "alignment" (power of two) in the mapped region.
+/* Returns the pointer to write to and the buffer offset in "offset", NULL if the region is full. */
+void* streamBufferAllocate(StreamBuffer* stream, int size, int alignment, int* offset);
+
+// Unmap the region (STREAM_UPLOAD_SUB_DATA: upload it), must be called before the draws which use the written data.
+void streamBufferEndFrame(StreamBuffer* stream);
+
+#endif // GLES_COMMON_STREAM_BUFFER_H
@@ -0,0 +1,227 @@
+/**
+ * Swap damage tracking and partial redraw. See swap_damage.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/swap_damage.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+struct SwapDamage {
+    bool headless;
+
+    // Damage of the current frame.
+    SwapDamageRect rects[SWAP_DAMAGE_MAX_RECTS];
+    int rectCount;
+
+    // Bounding box of the damage of the previous frames (newest first), width 0: the whole framebuffer.
+    SwapDamageRect history[SWAP_DAMAGE_HISTORY];
+    int historyCount;
+    int width; // framebuffer size of the history
+    int height;
+
+    PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC swapBuffersWithDamage;
+    PFNEGLSETDAMAGEREGIONKHRPROC setDamageRegion;
+    bool bufferAge;
+
+    // Statistics of the frames with damage.
+    int totalFrames;
+    int frames;
+    double presentedFraction;
+};
+
+static bool hasExtension(const char* extensions, const char* name) {
+    if (extensions == NULL) {
+        return false;
+    }
+
+    size_t nameLength = strlen(name);
+    for (const char* ptr = strstr(extensions, name); ptr != NULL; ptr = strstr(ptr + 1, name)) {
+        bool startOk = (ptr == extensions) || (ptr[-1] == ' ');
+        bool endOk = (ptr[nameLength] == ' ') || (ptr[nameLength] == '\0');
+        if (startOk && endOk) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static SwapDamageRect unite(const SwapDamageRect& a, const SwapDamageRect& b) {
+    int x0 = std::min(a.x, b.x);
+    int y0 = std::min(a.y, b.y);
+    int x1 = std::max(a.x + a.width, b.x + b.width);
+    int y1 = std::max(a.y + a.height, b.y + b.height);
+    return { x0, y0, x1 - x0, y1 - y0 };
+}
+
+// Clip the rectangle to the framebuffer.
+static SwapDamageRect clip(const SwapDamageRect& rect, int width, int height) {
+    int x0 = std::max(rect.x, 0);
+    int y0 = std::max(rect.y, 0);
+    int x1 = std::min(rect.x + rect.width, width);
+    int y1 = std::min(rect.y + rect.height, height);
+    return { x0, y0, std::max(x1 - x0, 0), std::max(y1 - y0, 0) };
+}
+
+static SwapDamageRect boundingBox(const SwapDamage* damage) {
+    SwapDamageRect box = damage->rects[0];
+    for (int idx = 1; idx < damage->rectCount; idx++) {
+        box = unite(box, damage->rects[idx]);
+    }
+    return box;
+}
+
+SwapDamage* createSwapDamage(bool headless) {
+    SwapDamage* damage = new SwapDamage();
+    damage->headless = headless;
+    damage->rectCount = 0;
+    damage->historyCount = 0;
+    damage->width = 0;
+    damage->height = 0;
+    damage->swapBuffersWithDamage = NULL;
+    damage->setDamageRegion = NULL;
+    damage->bufferAge = false;
+    damage->totalFrames = 0;
+    damage->frames = 0;
+    damage->presentedFraction = 0.0;
+
+    if (!headless) {
+        const char* extensions = eglQueryString(eglGetCurrentDisplay(), EGL_EXTENSIONS);
+        if (hasExtension(extensions, "EGL_KHR_swap_buffers_with_damage")) {
+            damage->swapBuffersWithDamage =
+                (PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC)eglGetProcAddress("eglSwapBuffersWithDamageKHR");
+        } else if (hasExtension(extensions, "EGL_EXT_swap_buffers_with_damage")) {
+            damage->swapBuffersWithDamage =
+                (PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC)eglGetProcAddress("eglSwapBuffersWithDamageEXT");
+        }
+        if (hasExtension(extensions, "EGL_KHR_partial_update")) {
+            damage->setDamageRegion = (PFNEGLSETDAMAGEREGIONKHRPROC)eglGetProcAddress("eglSetDamageRegionKHR");
+        }
+        damage->bufferAge = damage->setDamageRegion != NULL || hasExtension(extensions, "EGL_EXT_buffer_age");
+    }
+    return damage;
+}
+
+void destroySwapDamage(SwapDamage* damage) {
+    if (damage->frames > 0) {
+        printf("Swap damage: %d of %d frames, %.1f%% of the framebuffer damaged on average%s\n", damage->frames,
+               damage->totalFrames, 100.0 * damage->presentedFraction / damage->frames,
+               (damage->headless || damage->swapBuffersWithDamage) ? "" : " (swap with damage is not supported)");
+    }
+    delete damage;
+}
+
+void swapDamageAdd(SwapDamage* damage, int x, int y, int width, int height) {
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    SwapDamageRect rect = { x, y, width, height };
+    if (damage->rectCount == SWAP_DAMAGE_MAX_RECTS) {
+        /* Too many rectangles: merge the new one into the last one. */
+        damage->rects[SWAP_DAMAGE_MAX_RECTS - 1] = unite(damage->rects[SWAP_DAMAGE_MAX_RECTS - 1], rect);
+        return;
+    }
+    damage->rects[damage->rectCount++] = rect;
+}
+
+bool swapDamageBeginRedraw(SwapDamage* damage, int width, int height, SwapDamageRect* region) {
+    *region = { 0, 0, width, height };
+    if (damage->rectCount == 0) {
+        return false;
+    }
+
+    // 1. The age of the back buffer: the number of frames since its contents were presented (0: unknown).
+    EGLint age = 1;
+    if (!damage->headless) {
+        age = 0;
+        if (damage->bufferAge) {
+            eglQuerySurface(eglGetCurrentDisplay(), eglGetCurrentSurface(EGL_DRAW), EGL_BUFFER_AGE_KHR, &age);
+        }
+    }
+    /* The buffer must have been presented with the current size (a resize damages everything). */
+    if (age <= 0 || age > damage->historyCount || width != damage->width || height != damage->height) {
+        return false;
+    }
+
+    // 2. The contents are "age" frames old: the damage of the frames since then must be redrawn too.
+    SwapDamageRect box = boundingBox(damage);
+    for (int idx = 0; idx < age - 1; idx++) {
+        if (damage->history[idx].width == 0) {
+            return false;
+        }
+        box = unite(box, damage->history[idx]);
+    }
+    *region = clip(box, width, height);
+
+    // 3. Partial update: the rest of the buffer doesn't have to be loaded by the GPU.
+    if (damage->setDamageRegion != NULL) {
+        EGLint rect[4] = { region->x, region->y, region->width, region->height };
+        damage->setDamageRegion(eglGetCurrentDisplay(), eglGetCurrentSurface(EGL_DRAW), rect, 1);
+    }
+    return true;
+}
+
+bool swapDamageSwap(SwapDamage* damage, int width, int height) {
+    bool swapped = false;
+    SwapDamageRect box = { 0, 0, 0, 0 };
+    damage->totalFrames++;
+    if (width != damage->width || height != damage->height) {
+        damage->historyCount = 0;
+        damage->width = width;
+        damage->height = height;
+    } else if (damage->rectCount > 0) {
+        box = clip(boundingBox(damage), width, height);
+
+        damage->frames++;
+        damage->presentedFraction += (double)box.width * box.height / ((double)width * height);
+
+        if (!damage->headless && damage->swapBuffersWithDamage != NULL) {
+            EGLint rects[SWAP_DAMAGE_MAX_RECTS * 4];
+            for (int idx = 0; idx < damage->rectCount; idx++) {
+                SwapDamageRect rect = clip(damage->rects[idx], width, height);
+                rects[idx * 4 + 0] = rect.x;
+                rects[idx * 4 + 1] = rect.y;
+                rects[idx * 4 + 2] = rect.width;
+                rects[idx * 4 + 3] = rect.height;
+            }
+            damage->swapBuffersWithDamage(eglGetCurrentDisplay(), eglGetCurrentSurface(EGL_DRAW),
+                                          rects, damage->rectCount);
+            swapped = true;
+        }
+    }
+
+    // The frame becomes the newest history entry (width 0: the whole framebuffer changed).
+    for (int idx = SWAP_DAMAGE_HISTORY - 1; idx > 0; idx--) {
+        damage->history[idx] = damage->history[idx - 1];
+    }
+    damage->history[0] = box;
+    damage->historyCount = std::min(damage->historyCount + 1, SWAP_DAMAGE_HISTORY);
+    damage->rectCount = 0;
+    return swapped;
+}
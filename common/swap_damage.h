@@ -0,0 +1,76 @@
+/**
+ * Swap damage tracking and partial redraw (EGL_KHR_swap_buffers_with_damage,
+ * EGL_KHR_partial_update, EGL_EXT_buffer_age).
+ *
+ * For mostly static frames only a part of the window changes. The demo
+ * reports the changed rectangles of the frame (demoAddSwapDamage) and:
+ *
+ *  * the swap passes them to eglSwapBuffersWithDamageKHR (or the EXT): the
+ *    compositor and the display controller only update the dirty area,
+ *  * demoBeginPartialRedraw returns the region of the back buffer which must be
+ *    redrawn: the damage of this frame and of the frames since this back buffer
+ *    was presented last (its EGL_BUFFER_AGE), or the whole framebuffer if the
+ *    age is unknown. With EGL_KHR_partial_update the region is also set with
+ *    eglSetDamageRegionKHR, so a tile based GPU doesn't load the rest of the
+ *    buffer. The demo must only render inside the region (ex.: scissor test).
+ *
+ * The headless offscreen framebuffer keeps its contents: its age is always 1.
+ * The damage is reported in framebuffer coordinates (origin: bottom left).
+ * The average damaged part of the framebuffer is printed at exit.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_SWAP_DAMAGE_H
+#define GLES_COMMON_SWAP_DAMAGE_H
+
+// Maximum number of damage rectangles of a frame (more are merged into their bounding box).
+#define SWAP_DAMAGE_MAX_RECTS 8
+// Number of previous frames kept for the buffer age.
+#define SWAP_DAMAGE_HISTORY 4
+
+struct SwapDamageRect {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+struct SwapDamage;
+
+// Load the extensions of the current EGL display (window mode) or use the offscreen framebuffer (headless).
+SwapDamage* createSwapDamage(bool headless);
+
+// Print the summary (if the damage was tracked).
+void destroySwapDamage(SwapDamage* damage);
+
+// Add a changed rectangle of the current frame.
+void swapDamageAdd(SwapDamage* damage, int x, int y, int width, int height);
+
+// The region of the back buffer to redraw, call after the damage of the frame was added and before
+// drawing into the window. Returns false if the whole framebuffer must be redrawn.
+bool swapDamageBeginRedraw(SwapDamage* damage, int width, int height, SwapDamageRect* region);
+
+// Swap with the damage rectangles of the frame if possible (window mode), returns false if the
+// caller must swap (or flush) normally. Starts the tracking of the next frame.
+bool swapDamageSwap(SwapDamage* damage, int width, int height);
+
+#endif // GLES_COMMON_SWAP_DAMAGE_H
@@ -0,0 +1,267 @@
+/**
+ * Temporal upscaling. See temporal_upscale.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/temporal_upscale.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <GLES3/gl31.h>
+
+#include "common/gpu_memory.h"
+#include "common/program_cache.h"
+#include "common/render_pass.h"
+
+static const char* resolve_vertex_src = R"(#version 310 es
+precision highp float;
+
+void main() {
+    // Full-screen triangle: (-1, -1), (3, -1), (-1, 3).
+    vec2 pos = vec2(float((gl_VertexID & 1) << 2) - 1.0, float((gl_VertexID & 2) << 1) - 1.0);
+    gl_Position = vec4(pos, 0.0, 1.0);
+}
+)";
+
+static const char* resolve_fragment_src = R"(#version 310 es
+precision highp float;
+
+layout(binding = 0) uniform highp sampler2D uColor;   // the render region at the bottom left
+layout(binding = 1) uniform highp sampler2D uMotion;  // UV units: current - previous position
+layout(binding = 2) uniform highp sampler2D uHistory;
+
+uniform vec2 uRenderSize;
+uniform vec2 uOutputSize;
+uniform vec2 uJitter; // render pixels
+uniform int uReset;
+
+out vec4 outColor;
+
+void main() {
+    // 1. The render texel with the closest jittered sample: its sample is at texel + 0.5 - jitter.
+    vec2 outputUV = gl_FragCoord.xy / uOutputSize;
+    vec2 renderPos = outputUV * uRenderSize;
+    ivec2 maxTexel = ivec2(uRenderSize) - 1;
+    ivec2 texel = clamp(ivec2(floor(renderPos + uJitter)), ivec2(0), maxTexel);
+    vec2 offset = renderPos - (vec2(texel) + 0.5 - uJitter);
+    vec3 current = texelFetch(uColor, texel, 0).rgb;
+
+    // 2. The neighbourhood of the current sample bounds the history, its longest motion moves the edges.
+    /* The background next to a moving edge has no motion, but its history has the edge in it. */
+    vec3 minColor = current;
+    vec3 maxColor = current;
+    vec2 motion = vec2(0.0);
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            ivec2 neighbour = clamp(texel + ivec2(x, y), ivec2(0), maxTexel);
+            vec3 color = texelFetch(uColor, neighbour, 0).rgb;
+            minColor = min(minColor, color);
+            maxColor = max(maxColor, color);
+            vec2 neighbourMotion = texelFetch(uMotion, neighbour, 0).xy;
+            motion = dot(neighbourMotion, neighbourMotion) > dot(motion, motion) ? neighbourMotion : motion;
+        }
+    }
+
+    // 3. Reproject and clamp the history.
+    vec2 historyUV = outputUV - motion;
+    vec3 history = clamp(texture(uHistory, historyUV).rgb, minColor, maxColor);
+    bool inside = all(greaterThanEqual(historyUV, vec2(0.0))) && all(lessThanEqual(historyUV, vec2(1.0)));
+
+    // 4. A sample close to the pixel center counts more (Gaussian of the distance in render pixels).
+    float weight = exp(-2.29 * dot(offset, offset));
+    float alpha = (uReset != 0 || !inside) ? 1.0 : mix(0.02, 0.2, weight);
+    outColor = vec4(mix(history, current, alpha), 1.0);
+}
+)";
+
+static unsigned int createTexture(unsigned int format, int width, int height, unsigned int filter, const char* label) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+    gpuMemoryTrackTexture(texture, format, width, height, 1, 1, GPU_MEMORY_RENDER_TARGET, label);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+static bool checkFramebuffer(const char* name) {
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("Temporal upscale: the %s FBO is incomplete (0x%x)\n", name, status);
+        return false;
+    }
+    return true;
+}
+
+// Element "index" (from 1) of the Halton sequence of a base: a low discrepancy point in [0, 1).
+static float halton(int index, int base) {
+    float result = 0.0f;
+    float fraction = 1.0f;
+    while (index > 0) {
+        fraction /= base;
+        result += fraction * (index % base);
+        index /= base;
+    }
+    return result;
+}
+
+bool initTemporalUpscale(TemporalUpscale* upscale, int width, int height) {
+    memset(upscale, 0, sizeof(*upscale));
+    upscale->width = width;
+    upscale->height = height;
+    upscale->reset = true;
+
+    // 1. The scene FBO: color and motion draw buffers, depth.
+    bool complete = true;
+    upscale->sceneColor = createTexture(GL_RGBA8, width, height, GL_NEAREST, "temporal scene color");
+    upscale->sceneMotion = createTexture(GL_RG16F, width, height, GL_NEAREST, "temporal scene motion");
+    glGenRenderbuffers(1, &upscale->sceneDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, upscale->sceneDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    gpuMemoryTrackRenderbuffer(upscale->sceneDepth, GL_DEPTH_COMPONENT24, width, height, 1, "temporal scene depth");
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &upscale->sceneFbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, upscale->sceneFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, upscale->sceneColor, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, upscale->sceneMotion, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, upscale->sceneDepth);
+    GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+    complete = checkFramebuffer("scene") && complete;
+
+    // 2. The two histories (bilinear: the reprojection lands between the pixels).
+    glGenFramebuffers(2, upscale->historyFbos);
+    for (int idx = 0; idx < 2; idx++) {
+        upscale->history[idx] = createTexture(GL_RGBA8, width, height, GL_LINEAR, "temporal history");
+        glBindFramebuffer(GL_FRAMEBUFFER, upscale->historyFbos[idx]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, upscale->history[idx], 0);
+        complete = checkFramebuffer("history") && complete;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // 3. The resolve program, an empty VAO for the full-screen triangle.
+    upscale->program = createCachedProgram(resolve_vertex_src, resolve_fragment_src);
+    if (upscale->program != 0) {
+        upscale->renderSizeLoc = glGetUniformLocation(upscale->program, "uRenderSize");
+        upscale->outputSizeLoc = glGetUniformLocation(upscale->program, "uOutputSize");
+        upscale->jitterLoc = glGetUniformLocation(upscale->program, "uJitter");
+        upscale->resetLoc = glGetUniformLocation(upscale->program, "uReset");
+    }
+    glGenVertexArrays(1, &upscale->vao);
+
+    if (!complete || upscale->program == 0) {
+        destroyTemporalUpscale(upscale);
+        return false;
+    }
+    return true;
+}
+
+void destroyTemporalUpscale(TemporalUpscale* upscale) {
+    glDeleteFramebuffers(1, &upscale->sceneFbo);
+    glDeleteFramebuffers(2, upscale->historyFbos);
+    unsigned int textures[] = { upscale->sceneColor, upscale->sceneMotion, upscale->history[0], upscale->history[1] };
+    glDeleteTextures(4, textures);
+    gpuMemoryReleaseTextures(4, textures);
+    glDeleteRenderbuffers(1, &upscale->sceneDepth);
+    gpuMemoryReleaseRenderbuffers(1, &upscale->sceneDepth);
+    if (upscale->program != 0) {
+        glDeleteProgram(upscale->program);
+    }
+    glDeleteVertexArrays(1, &upscale->vao);
+    memset(upscale, 0, sizeof(*upscale));
+}
+
+void temporalUpscaleReset(TemporalUpscale* upscale) {
+    upscale->reset = true;
+}
+
+void temporalUpscaleBeginFrame(TemporalUpscale* upscale, int renderWidth, int renderHeight, float* jitterNdc) {
+    upscale->renderWidth = std::min(std::max(renderWidth, 1), upscale->width);
+    upscale->renderHeight = std::min(std::max(renderHeight, 1), upscale->height);
+
+    /* Centered on the pixel: in (-0.5, 0.5) render pixels. */
+    int phase = upscale->frame % TEMPORAL_UPSCALE_PHASES + 1;
+    upscale->jitter[0] = halton(phase, 2) - 0.5f;
+    upscale->jitter[1] = halton(phase, 3) - 0.5f;
+    upscale->frame++;
+
+    jitterNdc[0] = upscale->jitter[0] * 2.0f / upscale->renderWidth;
+    jitterNdc[1] = upscale->jitter[1] * 2.0f / upscale->renderHeight;
+}
+
+void temporalUpscaleClearMotion(TemporalUpscale* upscale) {
+    (void)upscale;
+    const float zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glClearBufferfv(GL_COLOR, 1, zero);
+}
+
+void temporalUpscaleResolve(TemporalUpscale* upscale) {
+    int next = 1 - upscale->current;
+
+    // 1. The scene is only read from now on: its depth isn't stored.
+    glBindFramebuffer(GL_FRAMEBUFFER, upscale->sceneFbo);
+    const GLenum depthAttachment = GL_DEPTH_ATTACHMENT;
+    glInvalidateFramebuffer(GL_FRAMEBUFFER, 1, &depthAttachment);
+
+    // 2. Every pixel of the next history is written: its old contents are not loaded.
+    RenderPass pass = createRenderPass("temporal resolve", upscale->historyFbos[next], upscale->width, upscale->height);
+    pass.color = { RENDER_PASS_DONT_CARE, RENDER_PASS_STORE, 4 };
+    beginRenderPass(&pass);
+
+    glUseProgram(upscale->program);
+    glUniform2f(upscale->renderSizeLoc, (float)upscale->renderWidth, (float)upscale->renderHeight);
+    glUniform2f(upscale->outputSizeLoc, (float)upscale->width, (float)upscale->height);
+    glUniform2f(upscale->jitterLoc, upscale->jitter[0], upscale->jitter[1]);
+    glUniform1i(upscale->resetLoc, upscale->reset ? 1 : 0);
+
+    unsigned int inputs[] = { upscale->sceneColor, upscale->sceneMotion, upscale->history[upscale->current] };
+    for (int idx = 0; idx < 3; idx++) {
+        glActiveTexture(GL_TEXTURE0 + idx);
+        glBindTexture(GL_TEXTURE_2D, inputs[idx]);
+    }
+
+    glBindVertexArray(upscale->vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    for (int idx = 2; idx >= 0; idx--) {
+        glActiveTexture(GL_TEXTURE0 + idx);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    glUseProgram(0);
+    endRenderPass(&pass);
+
+    upscale->current = next;
+    upscale->reset = false;
+}
+
+unsigned int temporalUpscaleOutputFramebuffer(const TemporalUpscale* upscale) {
+    return upscale->historyFbos[upscale->current];
+}
@@ -0,0 +1,117 @@
+/**
+ * Temporal upscaling: accumulate jittered low resolution frames into an output resolution history.
+ *
+ * Every frame is rendered at the (dynamic) render resolution with a sub-pixel
+ * jitter of the projection (Halton 2, 3 sequence, 8 phases), so the samples of
+ * consecutive frames cover different positions inside the output pixels. The
+ * scene also writes its screen space motion (UV units, current minus previous
+ * position) into the second color attachment.
+ *
+ * The resolve pass runs at the output resolution:
+ *  * the current sample: the render texel whose jittered sample position is the
+ *    closest to the output pixel, weighted by its distance (Gaussian),
+ *  * the history: reprojected with the motion vector and clamped to the 3x3
+ *    neighbourhood of the current sample (no ghosting of disoccluded areas),
+ *  * the blend: mostly history, more of the current sample if it lands close
+ *    to the pixel center. A history outside the frame or a reset is replaced.
+ *
+ * The history doesn't depend on the render resolution: the dynamic resolution
+ * can change the scale every frame without a reset.
+ *
+ * Usage:
+ *
+ *   TemporalUpscale upscale;
+ *   initTemporalUpscale(&upscale, width, height);
+ *   while (...) {
+ *       float jitter[2];
+ *       temporalUpscaleBeginFrame(&upscale, renderW, renderH, jitter); // NDC offset for gl_Position.xy
+ *       glBindFramebuffer(GL_FRAMEBUFFER, upscale.sceneFbo); glViewport(0, 0, renderW, renderH);
+ *       ... clear, temporalUpscaleClearMotion(&upscale), draw (location 0: color, 1: motion) ...
+ *       temporalUpscaleResolve(&upscale);
+ *       // The result: temporalUpscaleOutputFramebuffer(&upscale), width x height.
+ *   }
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.1+
+ *  * EXT_color_buffer_half_float or EXT_color_buffer_float (RG16F motion vectors)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_TEMPORAL_UPSCALE_H
+#define GLES_COMMON_TEMPORAL_UPSCALE_H
+
+#define TEMPORAL_UPSCALE_PHASES 8
+
+struct TemporalUpscale {
+    int width;  // output size (and the maximum render size)
+    int height;
+
+    // Scene: RGBA8 color, RG16F motion, 24 bit depth (the render resolution region at the bottom left).
+    unsigned int sceneColor;
+    unsigned int sceneMotion;
+    unsigned int sceneDepth;
+    unsigned int sceneFbo;
+
+    // The output resolution history (RGBA8): the resolve reads one and writes the other.
+    unsigned int history[2];
+    unsigned int historyFbos[2];
+    int current; // the history of the last resolve
+
+    unsigned int program;
+    unsigned int vao;
+    int renderSizeLoc;
+    int outputSizeLoc;
+    int jitterLoc;
+    int resetLoc;
+
+    int renderWidth;  // of the current frame
+    int renderHeight;
+    float jitter[2];  // of the current frame, render pixels
+    int frame;
+    bool reset;       // the next resolve ignores the history
+};
+
+// Create the scene and history targets of a width x height output.
+/* Returns false if the motion format isn't renderable or the program can't be built. */
+bool initTemporalUpscale(TemporalUpscale* upscale, int width, int height);
+
+void destroyTemporalUpscale(TemporalUpscale* upscale);
+
+// The next resolve starts a new history (ex.: a camera cut).
+void temporalUpscaleReset(TemporalUpscale* upscale);
+
+// Select the jitter of the frame rendered at renderWidth x renderHeight (clamped to the output size).
+/* "jitterNdc": the offset to add to gl_Position.xy (multiplied by w), the jitter in NDC units. */
+void temporalUpscaleBeginFrame(TemporalUpscale* upscale, int renderWidth, int renderHeight, float* jitterNdc);
+
+// Clear the motion attachment of the bound scene FBO to zero: the background doesn't move.
+/* glClear writes the clear color into every draw buffer, call this after it. */
+void temporalUpscaleClearMotion(TemporalUpscale* upscale);
+
+// Resolve the scene of the frame into the next history (a full screen pass at the output resolution).
+void temporalUpscaleResolve(TemporalUpscale* upscale);
+
+// The framebuffer of the last resolve (color attachment 0, width x height).
+unsigned int temporalUpscaleOutputFramebuffer(const TemporalUpscale* upscale);
+
+#endif // GLES_COMMON_TEMPORAL_UPSCALE_H
@@ -0,0 +1,403 @@
+/**
+ * Tessellated heightmap terrain, see terrain.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/terrain.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES3/gl31.h>
+#include <GLES2/gl2ext.h>
+
+#include "common/gpu_memory.h"
+#include "common/mesh.h"
+#include "common/program_cache.h"
+
+static const int TERRAIN_HEIGHT_SIZE = 512;
+
+static PFNGLPATCHPARAMETERIEXTPROC patchParameteri = NULL;
+
+// The body of the shaders: the "#version" (and extension) lines come from terrainShaderHeader.
+static const char* terrain_common_src = R"(
+precision highp float;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform vec4 params; // size, height scale, pixels per unit at distance 1 / edge pixels, max level
+uniform highp sampler2D heightMap;
+
+vec3 terrainPosition(vec2 grid, float height) {
+    return vec3((grid.x - 0.5) * params.x, height * params.y, (grid.y - 0.5) * params.x);
+}
+)";
+
+static const char* terrain_vs_main_src = R"(
+layout(location = 0) in vec2 aGrid;
+out vec2 vsGrid;
+
+void main() {
+    vsGrid = aGrid;
+}
+)";
+
+static const char* terrain_control_src = R"(
+layout(vertices = 4) out;
+
+in vec2 vsGrid[];
+out vec2 tcGrid[];
+
+// Segments of the edge p0-p1: the edge is a sphere around its middle, its projected diameter
+// divided by the target segment length (the same value for both patches of the edge).
+float edgeLevel(vec3 p0, vec3 p1) {
+    vec3 center = (view * vec4((p0 + p1) * 0.5, 1.0)).xyz;
+    float pixels = distance(p0, p1) * params.z / max(-center.z, 0.01);
+    return clamp(pixels, 1.0, params.w);
+}
+
+// The box of the patch is completely outside of one of the clip planes.
+bool patchCulled(vec2 grid0, vec2 grid1) {
+    vec4 corners[8];
+    for (int idx = 0; idx < 8; idx++) {
+        vec2 grid = vec2((idx & 1) != 0 ? grid1.x : grid0.x, (idx & 2) != 0 ? grid1.y : grid0.y);
+        corners[idx] = projection * view * vec4(terrainPosition(grid, (idx & 4) != 0 ? 1.0 : 0.0), 1.0);
+    }
+    for (int plane = 0; plane < 6; plane++) {
+        int axis = plane / 2;
+        float sign = (plane % 2 == 0) ? 1.0 : -1.0;
+        bool outside = true;
+        for (int idx = 0; idx < 8 && outside; idx++) {
+            outside = sign * corners[idx][axis] > corners[idx].w;
+        }
+        if (outside) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void main() {
+    tcGrid[gl_InvocationID] = vsGrid[gl_InvocationID];
+
+    if (gl_InvocationID == 0) {
+        if (patchCulled(vsGrid[0], vsGrid[2])) {
+            gl_TessLevelOuter[0] = 0.0;
+            gl_TessLevelOuter[1] = 0.0;
+            gl_TessLevelOuter[2] = 0.0;
+            gl_TessLevelOuter[3] = 0.0;
+            gl_TessLevelInner[0] = 0.0;
+            gl_TessLevelInner[1] = 0.0;
+        } else {
+            vec3 corners[4];
+            for (int idx = 0; idx < 4; idx++) {
+                corners[idx] = terrainPosition(vsGrid[idx], textureLod(heightMap, vsGrid[idx], 0.0).r);
+            }
+            // Corners: 0 (0, 0), 1 (1, 0), 2 (1, 1), 3 (0, 1). Outer edges: u = 0, v = 0, u = 1, v = 1.
+            float edgeU0 = edgeLevel(corners[3], corners[0]);
+            float edgeV0 = edgeLevel(corners[0], corners[1]);
+            float edgeU1 = edgeLevel(corners[1], corners[2]);
+            float edgeV1 = edgeLevel(corners[2], corners[3]);
+            gl_TessLevelOuter[0] = edgeU0;
+            gl_TessLevelOuter[1] = edgeV0;
+            gl_TessLevelOuter[2] = edgeU1;
+            gl_TessLevelOuter[3] = edgeV1;
+            gl_TessLevelInner[0] = max(edgeV0, edgeV1);
+            gl_TessLevelInner[1] = max(edgeU0, edgeU1);
+        }
+    }
+}
+)";
+
+static const char* terrain_evaluation_src = R"(
+layout(quads, fractional_odd_spacing, ccw) in;
+
+in vec2 tcGrid[];
+out vec3 worldPos;
+out vec3 normal;
+
+void main() {
+    vec2 grid = mix(mix(tcGrid[0], tcGrid[1], gl_TessCoord.x), mix(tcGrid[3], tcGrid[2], gl_TessCoord.x),
+                    gl_TessCoord.y);
+    float height = textureLod(heightMap, grid, 0.0).r;
+
+    // Normal from the central differences of the height texture.
+    vec2 texel = 1.0 / vec2(textureSize(heightMap, 0));
+    float left = textureLod(heightMap, grid - vec2(texel.x, 0.0), 0.0).r;
+    float right = textureLod(heightMap, grid + vec2(texel.x, 0.0), 0.0).r;
+    float down = textureLod(heightMap, grid - vec2(0.0, texel.y), 0.0).r;
+    float up = textureLod(heightMap, grid + vec2(0.0, texel.y), 0.0).r;
+    vec2 step = 2.0 * texel * params.x;
+    normal = normalize(vec3((left - right) * params.y / step.x, 1.0, (down - up) * params.y / step.y));
+
+    worldPos = terrainPosition(grid, height);
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+}
+)";
+
+static const char* terrain_fragment_src = R"(
+in vec3 worldPos;
+in vec3 normal;
+out vec4 outColor;
+
+void main() {
+    // Grass on the flat, rock on the slopes, snow at the top; faded into the clear color with the distance.
+    vec3 n = normalize(normal);
+    float heightT = worldPos.y / params.y;
+    vec3 albedo = mix(vec3(0.25, 0.45, 0.2), vec3(0.45, 0.4, 0.35), smoothstep(0.75, 0.55, n.y));
+    albedo = mix(albedo, vec3(0.95), smoothstep(0.7, 0.8, heightT) * smoothstep(0.5, 0.7, n.y));
+
+    float light = max(dot(n, normalize(vec3(0.4, 0.8, 0.3))), 0.0) * 0.85 + 0.15;
+    float depth = length((view * vec4(worldPos, 1.0)).xyz);
+    float fog = smoothstep(params.x * 0.2, params.x * 0.6, depth);
+    outColor = vec4(mix(albedo * light, vec3(0.0, 0.3, 0.3), fog), 1.0);
+}
+)";
+
+static bool hasGLExtension(const char* name) {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int idx = 0; idx < count; idx++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, idx), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool isGles32() {
+    int major = 0;
+    int minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    return major > 3 || (major == 3 && minor >= 2);
+}
+
+bool terrainTessellationSupported() {
+    return isGles32() || hasGLExtension("GL_EXT_tessellation_shader");
+}
+
+// All stages of a program have the same version: 3.20 or 3.10 with the extension.
+static std::string terrainShaderHeader(bool tessellationStage) {
+    if (isGles32()) {
+        return "#version 320 es\n";
+    }
+    return tessellationStage ? "#version 310 es\n#extension GL_EXT_tessellation_shader : require\n"
+                             : "#version 310 es\n";
+}
+
+// Value noise on a "cells" x "cells" lattice which wraps around, smoothstep interpolated.
+static float valueNoise(float x, float y, int cells, unsigned int seed) {
+    auto lattice = [&](int ix, int iy) {
+        unsigned int hash = (unsigned int)(((ix % cells) + cells) % cells) * 73856093u ^
+                            (unsigned int)(((iy % cells) + cells) % cells) * 19349663u ^ seed * 83492791u;
+        hash = (hash ^ (hash >> 13)) * 0x5bd1e995u;
+        return (float)((hash ^ (hash >> 15)) & 0xffff) / 65535.0f;
+    };
+    int ix = (int)floorf(x);
+    int iy = (int)floorf(y);
+    float fx = x - ix;
+    float fy = y - iy;
+    fx = fx * fx * (3.0f - 2.0f * fx);
+    fy = fy * fy * (3.0f - 2.0f * fy);
+    float top = lattice(ix, iy) + (lattice(ix + 1, iy) - lattice(ix, iy)) * fx;
+    float bottom = lattice(ix, iy + 1) + (lattice(ix + 1, iy + 1) - lattice(ix, iy + 1)) * fx;
+    return top + (bottom - top) * fy;
+}
+
+// Ridged fractal noise: sharp mountain crests with flatter valleys, normalized into [0, 1].
+static unsigned int createHeightTexture() {
+    const int size = TERRAIN_HEIGHT_SIZE;
+    std::vector<float> heights(size * size);
+    float minHeight = 1e9f;
+    float maxHeight = -1e9f;
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            float value = 0.0f;
+            float amplitude = 1.0f;
+            int cells = 4;
+            for (int octave = 0; octave < 6; octave++) {
+                float noise = valueNoise((float)x * cells / size, (float)y * cells / size, cells, octave);
+                float ridge = 1.0f - fabsf(noise * 2.0f - 1.0f);
+                value += ridge * ridge * amplitude;
+                amplitude *= 0.5f;
+                cells *= 2;
+            }
+            heights[y * size + x] = value;
+            minHeight = fminf(minHeight, value);
+            maxHeight = fmaxf(maxHeight, value);
+        }
+    }
+
+    std::vector<uint16_t> texels(size * size);
+    for (int idx = 0; idx < size * size; idx++) {
+        texels[idx] = floatToHalf((heights[idx] - minHeight) / (maxHeight - minHeight));
+    }
+
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R16F, size, size);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RED, GL_HALF_FLOAT, texels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    gpuMemoryTrackTexture(texture, GL_R16F, size, size, 1, 1, GPU_MEMORY_TEXTURE, "terrain height");
+    return texture;
+}
+
+bool initTessTerrain(TessTerrain* terrain, int patchesPerSide, float size, float heightScale, float edgePixels) {
+    memset(terrain, 0, sizeof(*terrain));
+    if (!terrainTessellationSupported()) {
+        printf("Terrain: OpenGL ES 3.2 or GL_EXT_tessellation_shader is required\n");
+        return false;
+    }
+    patchParameteri = (PFNGLPATCHPARAMETERIEXTPROC)eglGetProcAddress(isGles32() ? "glPatchParameteri"
+                                                                                   : "glPatchParameteriEXT");
+    if (patchParameteri == NULL) {
+        printf("Terrain: glPatchParameteri is not available\n");
+        return false;
+    }
+
+    terrain->patchesPerSide = patchesPerSide;
+    terrain->size = size;
+    terrain->heightScale = heightScale;
+    terrain->edgePixels = edgePixels;
+    glGetIntegerv(GL_MAX_TESS_GEN_LEVEL_EXT, &terrain->maxLevel);
+
+    // 1. Program: the shared uniforms and helpers go into every stage.
+    std::string vertexSrc = terrainShaderHeader(false) + terrain_vs_main_src;
+    std::string controlSrc = terrainShaderHeader(true) + terrain_common_src + terrain_control_src;
+    std::string evaluationSrc = terrainShaderHeader(true) + terrain_common_src + terrain_evaluation_src;
+    std::string fragmentSrc = terrainShaderHeader(false) + terrain_common_src + terrain_fragment_src;
+    terrain->program = createCachedTessellationProgram(vertexSrc.c_str(), controlSrc.c_str(),
+                                                       evaluationSrc.c_str(), fragmentSrc.c_str());
+    terrain->projectionLoc = glGetUniformLocation(terrain->program, "projection");
+    terrain->viewLoc = glGetUniformLocation(terrain->program, "view");
+    terrain->paramsLoc = glGetUniformLocation(terrain->program, "params");
+    glUseProgram(terrain->program);
+    glUniform1i(glGetUniformLocation(terrain->program, "heightMap"), 0);
+
+    // 2. The corners of every patch in the grid coordinates (4 vertices per patch, no index buffer).
+    std::vector<float> corners;
+    corners.reserve((size_t)patchesPerSide * patchesPerSide * 8);
+    for (int z = 0; z < patchesPerSide; z++) {
+        for (int x = 0; x < patchesPerSide; x++) {
+            float x0 = (float)x / patchesPerSide;
+            float x1 = (float)(x + 1) / patchesPerSide;
+            float z0 = (float)z / patchesPerSide;
+            float z1 = (float)(z + 1) / patchesPerSide;
+            const float patch[8] = { x0, z0, x1, z0, x1, z1, x0, z1 };
+            corners.insert(corners.end(), patch, patch + 8);
+        }
+    }
+    terrain->patchVertexCount = patchesPerSide * patchesPerSide * 4;
+
+    glGenVertexArrays(1, &terrain->vao);
+    glGenBuffers(1, &terrain->vertexBuffer);
+    glBindVertexArray(terrain->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, terrain->vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, corners.size() * sizeof(float), corners.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gpuMemoryTrackBuffer(terrain->vertexBuffer, corners.size() * sizeof(float), GPU_MEMORY_VERTEX, "terrain patches");
+
+    // 3. The heights.
+    terrain->heightTexture = createHeightTexture();
+
+    // 4. The tessellator output, read back one frame later (no stall).
+    if (isGles32() || hasGLExtension("GL_EXT_geometry_shader")) {
+        glGenQueries(1, &terrain->primitivesQuery);
+    }
+    return true;
+}
+
+void drawTessTerrain(TessTerrain* terrain, const float* projection, const float* view, int viewportHeight) {
+    // T.1. Collect the previous frame's triangle count if the driver has it.
+    if (terrain->queryPending) {
+        unsigned int available = 0;
+        glGetQueryObjectuiv(terrain->primitivesQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            unsigned int triangles = 0;
+            glGetQueryObjectuiv(terrain->primitivesQuery, GL_QUERY_RESULT, &triangles);
+            terrain->generatedTriangles += triangles;
+            terrain->generatedFrames++;
+            terrain->queryPending = false;
+        }
+    }
+
+    // T.2. An edge of length L at distance d covers L * projection[1][1] * (height / 2) / d pixels.
+    float pixelsPerUnit = projection[5] * viewportHeight * 0.5f;
+    glUseProgram(terrain->program);
+    glUniformMatrix4fv(terrain->projectionLoc, 1, GL_FALSE, projection);
+    glUniformMatrix4fv(terrain->viewLoc, 1, GL_FALSE, view);
+    glUniform4f(terrain->paramsLoc, terrain->size, terrain->heightScale, pixelsPerUnit / terrain->edgePixels,
+                (float)terrain->maxLevel);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, terrain->heightTexture);
+    glBindVertexArray(terrain->vao);
+    patchParameteri(GL_PATCH_VERTICES_EXT, 4);
+
+    bool query = terrain->primitivesQuery != 0 && !terrain->queryPending;
+    if (query) {
+        glBeginQuery(GL_PRIMITIVES_GENERATED_EXT, terrain->primitivesQuery);
+    }
+    glDrawArrays(GL_PATCHES_EXT, 0, terrain->patchVertexCount);
+    if (query) {
+        glEndQuery(GL_PRIMITIVES_GENERATED_EXT);
+        terrain->queryPending = true;
+    }
+    glBindVertexArray(0);
+}
+
+double terrainTakeTriangleCount(TessTerrain* terrain) {
+    if (terrain->primitivesQuery == 0 || terrain->generatedFrames == 0) {
+        return -1.0;
+    }
+    double average = terrain->generatedTriangles / terrain->generatedFrames;
+    terrain->generatedTriangles = 0.0;
+    terrain->generatedFrames = 0;
+    return average;
+}
+
+void destroyTessTerrain(TessTerrain* terrain) {
+    if (terrain->primitivesQuery != 0) {
+        glDeleteQueries(1, &terrain->primitivesQuery);
+    }
+    glDeleteTextures(1, &terrain->heightTexture);
+    gpuMemoryReleaseTextures(1, &terrain->heightTexture);
+    glDeleteBuffers(1, &terrain->vertexBuffer);
+    gpuMemoryReleaseBuffers(1, &terrain->vertexBuffer);
+    glDeleteVertexArrays(1, &terrain->vao);
+    glDeleteProgram(terrain->program);
+    memset(terrain, 0, sizeof(*terrain));
+}
@@ -0,0 +1,100 @@
+/**
+ * Tessellated heightmap terrain: distance adaptive detail from a coarse patch grid.
+ *
+ * The terrain is a grid of quad patches (4 corners each, a few KB of vertices)
+ * displaced by a height texture. The tessellation control shader picks the
+ * subdivision of every patch edge from its length on the screen: an edge is
+ * split until its segments are about "edgePixels" pixels long, so the detail
+ * follows the distance (and the resolution) without any stored high resolution
+ * mesh or CPU side LOD selection. The edge factor only depends on the two end
+ * points of the edge (the edge is measured as a sphere projected at its middle,
+ * independent of the view direction), the two patches sharing an edge compute
+ * the same factor: no cracks between patches of different detail.
+ *
+ * The control shader also culls the patches: the bounding box of the patch
+ * (its corners at the lowest and the highest terrain height) is tested against
+ * the clip space planes and a patch outside of the frustum gets the outer
+ * factor 0, which discards it before the evaluation shader runs.
+ *
+ * The evaluation shader samples the height texture at the generated vertices
+ * and computes the normal from the neighbouring texels.
+ *
+ * Usage:
+ *
+ *   if (!terrainTessellationSupported()) { ... }
+ *   TessTerrain terrain;
+ *   initTessTerrain(&terrain, 32, 64.0f, 6.0f, 12.0f);
+ *   // every frame, with depth test:
+ *   drawTessTerrain(&terrain, glm::value_ptr(projection), glm::value_ptr(view), viewportHeight);
+ *   destroyTessTerrain(&terrain);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.2 or Open GL ES 3.1 + GL_EXT_tessellation_shader
+ *  * EGL
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_TERRAIN_H
+#define GLES_COMMON_TERRAIN_H
+
+struct TessTerrain {
+    unsigned int program;
+    unsigned int vao;
+    unsigned int vertexBuffer; // patch corners on the grid, in [0, 1]
+    unsigned int heightTexture; // R16F, [0, 1] heights
+
+    int patchesPerSide;
+    int patchVertexCount;
+    float size;        // world units per side, centered on the origin (the XZ plane)
+    float heightScale; // world height of the 1.0 texel
+    float edgePixels;  // target length of the tessellated edges on the screen
+    int maxLevel;      // GL_MAX_TESS_GEN_LEVEL
+
+    int projectionLoc;
+    int viewLoc;
+    int paramsLoc;
+
+    // GL_PRIMITIVES_GENERATED of the draws (0 without ES 3.2 or GL_EXT_geometry_shader).
+    unsigned int primitivesQuery;
+    bool queryPending;
+    double generatedTriangles; // the sum since the last terrainTakeTriangleCount
+    int generatedFrames;
+};
+
+// OpenGL ES 3.2 or GL_EXT_tessellation_shader is available.
+bool terrainTessellationSupported();
+
+// Create the patch grid, the height texture (procedural ridged noise) and the program.
+/* Returns false (and prints the reason) without tessellation support. */
+bool initTessTerrain(TessTerrain* terrain, int patchesPerSide, float size, float heightScale, float edgePixels);
+
+// Draw the terrain with the "projection" and "view" matrices (column major) into a viewport "viewportHeight"
+// pixels high. Uses the program, the VAO and the texture unit 0, the depth test is up to the caller.
+void drawTessTerrain(TessTerrain* terrain, const float* projection, const float* view, int viewportHeight);
+
+// Average triangles generated per frame by the tessellator since the previous call (-1 without the query).
+double terrainTakeTriangleCount(TessTerrain* terrain);
+
+void destroyTessTerrain(TessTerrain* terrain);
+
+#endif // GLES_COMMON_TERRAIN_H
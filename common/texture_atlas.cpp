@@ -0,0 +1,151 @@
+/**
+ * Texture atlases of many small images in the layers of an array texture.
+ * See texture_atlas.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/texture_atlas.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+
+#include <GLES3/gl3.h>
+
+#include "common/gpu_memory.h"
+
+bool loadTextureAtlas(TextureAtlas* atlas, const char* path) {
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file) {
+        printf("Texture atlas: unable to open '%s'\n", path);
+        return false;
+    }
+
+    // 1. Check the header and read the entries.
+    TextureAtlasHeader& header = atlas->header;
+    if (!file.read((char*)&header, sizeof(header)) || memcmp(header.magic, TEXTURE_ATLAS_MAGIC, sizeof(header.magic)) != 0
+        || header.version != TEXTURE_ATLAS_VERSION) {
+        printf("Texture atlas: '%s' is not a version %d atlas\n", path, TEXTURE_ATLAS_VERSION);
+        return false;
+    }
+    if (header.width == 0 || header.height == 0 || header.layerCount == 0 || header.levelCount == 0
+        || header.levelCount > 16) {
+        printf("Texture atlas: '%s' has an invalid size\n", path);
+        return false;
+    }
+
+    atlas->entries.resize(header.entryCount);
+    file.read((char*)atlas->entries.data(), header.entryCount * sizeof(AtlasEntry));
+
+    // 2. The pixels of the levels follow the entries.
+    size_t size = 0;
+    atlas->levelOffsets.resize(header.levelCount);
+    for (uint32_t level = 0; level < header.levelCount; level++) {
+        atlas->levelOffsets[level] = size;
+        size += atlasLevelSize(header, level) * header.layerCount;
+    }
+    atlas->pixels.resize(size);
+    if (!file.read((char*)atlas->pixels.data(), size)) {
+        printf("Texture atlas: '%s' is truncated\n", path);
+        return false;
+    }
+
+    for (const AtlasEntry& entry : atlas->entries) {
+        if (entry.layer >= header.layerCount || entry.x + entry.width > header.width || entry.y + entry.height > header.height
+            || memchr(entry.name, '\0', ATLAS_NAME_SIZE) == NULL) {
+            printf("Texture atlas: '%s' has an invalid entry\n", path);
+            return false;
+        }
+    }
+    return true;
+}
+
+const AtlasEntry* findAtlasEntry(const TextureAtlas* atlas, const char* name) {
+    for (const AtlasEntry& entry : atlas->entries) {
+        if (strcmp(entry.name, name) == 0) {
+            return &entry;
+        }
+    }
+    return NULL;
+}
+
+void atlasEntryRect(const TextureAtlas* atlas, const AtlasEntry& entry, float rect[4]) {
+    rect[0] = (float)entry.x / atlas->header.width;
+    rect[1] = (float)entry.y / atlas->header.height;
+    rect[2] = (float)entry.width / atlas->header.width;
+    rect[3] = (float)entry.height / atlas->header.height;
+}
+
+unsigned int uploadTextureAtlas(const TextureAtlas* atlas) {
+    const TextureAtlasHeader& header = atlas->header;
+
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, header.levelCount, GL_RGBA8, header.width, header.height, header.layerCount);
+    gpuMemoryTrackTexture(texture, GL_RGBA8, header.width, header.height, header.layerCount, header.levelCount,
+                          GPU_MEMORY_TEXTURE, "texture atlas");
+
+    /* One upload per level: the layers of a level are stored one after the other. */
+    for (uint32_t level = 0; level < header.levelCount; level++) {
+        int width = header.width >> level ? header.width >> level : 1;
+        int height = header.height >> level ? header.height >> level : 1;
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, width, height, header.layerCount, GL_RGBA, GL_UNSIGNED_BYTE,
+                        &atlas->pixels[atlas->levelOffsets[level]]);
+    }
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return texture;
+}
+
+unsigned int uploadAtlasEntryTexture(const TextureAtlas* atlas, const AtlasEntry& entry) {
+    // The rows of the rectangle are read straight from the layer with the unpack row length.
+    const uint8_t* layer = &atlas->pixels[atlasLevelSize(atlas->header, 0) * entry.layer];
+    int levelCount = 1;
+    while ((entry.width | entry.height) >> levelCount) {
+        levelCount++;
+    }
+
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, levelCount, GL_RGBA8, entry.width, entry.height);
+    gpuMemoryTrackTexture(texture, GL_RGBA8, entry.width, entry.height, 1, levelCount, GPU_MEMORY_TEXTURE,
+                          "atlas entry");
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, atlas->header.width);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, entry.width, entry.height, GL_RGBA, GL_UNSIGNED_BYTE,
+                    layer + ((size_t)entry.y * atlas->header.width + entry.x) * 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
@@ -0,0 +1,113 @@
+/**
+ * Texture atlases of many small images in the layers of an array texture.
+ *
+ * The images are packed offline (by the "tools/texture_atlas" builder) into
+ * the layers of one GL_TEXTURE_2D_ARRAY: every material is a rectangle in
+ * one of the layers. The draws of the different materials need no texture
+ * rebind: the layer and the rectangle of the material are per instance
+ * attributes, so one instanced draw covers any mix of materials.
+ *
+ * File layout: header, "entryCount" entries, then the RGBA8 pixels of every
+ * mip level (the layers of a level one after the other, level 0 first). Each
+ * rectangle is surrounded by a gutter of its edge pixels and is placed on a
+ * grid of 2^(levelCount - 1) texels, so the mip levels never mix two images:
+ * the chain stops at the level where the gutter is one texel wide.
+ *
+ * Usage:
+ *
+ *   TextureAtlas atlas;
+ *   if (loadTextureAtlas(&atlas, "demo_textures.atlas")) {
+ *       unsigned int texture = uploadTextureAtlas(&atlas);
+ *       float rect[4];
+ *       atlasEntryRect(&atlas, *findAtlasEntry(&atlas, "kitten"), rect);
+ *       // per instance: vec4(rect) and the layer of the entry, in the shader:
+ *       // texture(atlas, vec3(rect.xy + uv * rect.zw, layer))
+ *   }
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_TEXTURE_ATLAS_H
+#define GLES_COMMON_TEXTURE_ATLAS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#define TEXTURE_ATLAS_MAGIC "GLESATL"
+#define TEXTURE_ATLAS_VERSION 1
+#define ATLAS_NAME_SIZE 48
+
+struct TextureAtlasHeader {
+    char magic[8]; // TEXTURE_ATLAS_MAGIC with the terminating NUL
+    uint32_t version;
+    uint32_t width;  // of the layers
+    uint32_t height;
+    uint32_t layerCount;
+    uint32_t levelCount;
+    uint32_t entryCount;
+};
+
+// Rectangle of an image in the level 0 of its layer (without the gutter).
+struct AtlasEntry {
+    char name[ATLAS_NAME_SIZE]; // NUL terminated
+    uint32_t layer;
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct TextureAtlas {
+    TextureAtlasHeader header;
+    std::vector<AtlasEntry> entries;
+    std::vector<uint8_t> pixels;      // every level of every layer
+    std::vector<size_t> levelOffsets; // in "pixels"
+};
+
+// Size of one layer of a mip level in bytes (also used by the offline builder, which does not link GL).
+inline size_t atlasLevelSize(const TextureAtlasHeader& header, int level) {
+    size_t width = header.width >> level ? header.width >> level : 1;
+    size_t height = header.height >> level ? header.height >> level : 1;
+    return width * height * 4;
+}
+
+// Read the atlas file. Returns false (and prints the reason) on failure.
+bool loadTextureAtlas(TextureAtlas* atlas, const char* path);
+
+// Find an entry by name, NULL if the atlas doesn't contain it.
+const AtlasEntry* findAtlasEntry(const TextureAtlas* atlas, const char* name);
+
+// Texture coords of the entry in its layer: xy: offset, zw: scale (uv * zw + xy).
+void atlasEntryRect(const TextureAtlas* atlas, const AtlasEntry& entry, float rect[4]);
+
+// Create an immutable GL_TEXTURE_2D_ARRAY with every layer and level of the atlas (trilinear, clamped).
+unsigned int uploadTextureAtlas(const TextureAtlas* atlas);
+
+// Create a GL_TEXTURE_2D of one entry alone (with a full mip chain), ex.: to compare with the atlas.
+unsigned int uploadAtlasEntryTexture(const TextureAtlas* atlas, const AtlasEntry& entry);
+
+#endif // GLES_COMMON_TEXTURE_ATLAS_H
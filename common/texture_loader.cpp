@@ -0,0 +1,497 @@
+/**
+ * Asynchronous texture loader, see texture_loader.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/texture_loader.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <GLES3/gl3.h>
+
+#include "common/gl_workers.h"
+#include "common/gpu_memory.h"
+#include "common/image_convert.h"
+#include "common/job_system.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "common/stb_image.h"
+
+// One level of the mip chain inside TextureRequest::pixels.
+struct MipLevel {
+    int width;
+    int height;
+    size_t offset;
+    size_t size;
+};
+
+struct TextureRequest {
+    std::string path;
+    TextureLoadStatus status;
+
+    // Decoded RGBA8 mip chain (filled by a decode worker, released after the upload).
+    std::vector<uint8_t> pixels;
+    std::vector<MipLevel> levels;
+    unsigned int compressedFormat; // 0: RGBA8, otherwise the KTX glInternalFormat
+    size_t memorySize;
+    bool decodeOnly; // textureLoaderRequestImage: the chain stays on the CPU for the caller
+
+    unsigned int texture;
+    GLsync fence; // Signaled when the upload is finished, 0 before the upload.
+};
+
+struct TextureLoader {
+    std::vector<std::thread> workers;
+    std::thread uploader;
+
+    std::mutex mutex;
+    std::condition_variable decodeReady;
+    std::condition_variable uploadReady;
+    std::deque<int> decodeQueue;
+    std::deque<int> uploadQueue;
+    std::deque<TextureRequest> requests; // deque: the elements never move
+    bool stopping;
+
+    // Shared context used by the uploader thread (see common/gl_workers.h).
+    SharedContext uploadContext;
+    bool hasUploader; // false: upload in textureLoaderPoll
+
+    // Threads of the RGBA8 conversion and the mip chain (see common/job_system.h).
+    /* The decode workers take turns: the loops must be started from one thread at a time. */
+    JobSystem jobs;
+    std::mutex jobsMutex;
+};
+
+// Source and destination of a parallel image loop, the jobs process ranges of rows.
+struct ImageJob {
+    uint8_t* dst;
+    const uint8_t* src;
+    int width;
+    int height;
+    int channels;
+};
+
+static void convertRows(void* data, int begin, int end) {
+    ImageJob* job = (ImageJob*)data;
+    convertToRGBA8(job->dst, job->src, begin, end, job->width, job->channels);
+}
+
+static void downsampleRows(void* data, int begin, int end) {
+    ImageJob* job = (ImageJob*)data;
+    downsampleRGBA8(job->dst, begin, end, job->src, job->width, job->height);
+}
+
+// Rows per job: about 64 KiB of RGBA8 output.
+static int rowGrain(int width) {
+    int grain = 16 * 1024 / width;
+    return grain > 0 ? grain : 1;
+}
+
+// Convert the decoded image to RGBA8 and build its mip chain with a 2x2 box filter.
+/* Every level is split into row ranges on the job system, the levels follow each other. */
+static void buildMipChain(TextureLoader* loader, TextureRequest* request, const uint8_t* image,
+                          int width, int height, int channels) {
+    size_t total = 0;
+    for (int w = width, h = height; ; w = w > 1 ? w / 2 : 1, h = h > 1 ? h / 2 : 1) {
+        request->levels.push_back(MipLevel{ w, h, total, (size_t)w * h * 4 });
+        total += (size_t)w * h * 4;
+        if (w == 1 && h == 1) {
+            break;
+        }
+    }
+
+    request->pixels.resize(total);
+
+    std::lock_guard<std::mutex> lock(loader->jobsMutex);
+
+    // 1. The decoded image is converted straight into the base level.
+    ImageJob convert = { request->pixels.data(), image, width, height, channels };
+    jobSystemParallelFor(&loader->jobs, height, rowGrain(width), convertRows, &convert);
+
+    // 2. Each level is built from the previous one.
+    for (size_t idx = 1; idx < request->levels.size(); idx++) {
+        const MipLevel& src = request->levels[idx - 1];
+        const MipLevel& dst = request->levels[idx];
+
+        ImageJob downsample = { request->pixels.data() + dst.offset, request->pixels.data() + src.offset,
+                                src.width, src.height, 4 };
+        jobSystemParallelFor(&loader->jobs, dst.height, rowGrain(dst.width), downsampleRows, &downsample);
+    }
+}
+
+static uint32_t readUint32(const uint8_t* data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+bool parseKTX(const uint8_t* data, size_t size, const char* name, unsigned int* internalFormat,
+              std::vector<KTXLevel>* levels) {
+    // 1. Check the header: 12 byte identifier + 13 uint32 fields.
+    static const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+    const size_t headerSize = 12 + 13 * 4;
+    if (size < headerSize || memcmp(data, identifier, sizeof(identifier)) != 0
+        || readUint32(&data[12]) != 0x04030201) {
+        printf("Texture loader: '%s' is not a (little endian) KTX 1.1 file\n", name);
+        return false;
+    }
+
+    uint32_t glType = readUint32(&data[16]);
+    uint32_t format = readUint32(&data[28]);
+    int width = readUint32(&data[36]);
+    int height = readUint32(&data[40]);
+    uint32_t faces = readUint32(&data[52]);
+    uint32_t levelCount = readUint32(&data[56]);
+    uint32_t keyValueBytes = readUint32(&data[60]);
+
+    if (glType != 0 || faces != 1 || levelCount == 0 || readUint32(&data[44]) != 0 || readUint32(&data[48]) != 0) {
+        printf("Texture loader: '%s' is not a compressed 2D texture with mip levels\n", name);
+        return false;
+    }
+
+    // 2. Collect the mip levels (each is prefixed by its size and padded to 4 bytes).
+    levels->clear();
+    size_t offset = headerSize + keyValueBytes;
+    for (uint32_t level = 0; level < levelCount; level++) {
+        if (offset + 4 > size) {
+            break;
+        }
+        size_t levelSize = readUint32(&data[offset]);
+        offset += 4;
+        if (offset + levelSize > size) {
+            break;
+        }
+
+        int levelWidth = width >> level;
+        int levelHeight = height >> level;
+        levels->push_back(KTXLevel{ levelWidth > 0 ? levelWidth : 1, levelHeight > 0 ? levelHeight : 1,
+                                    offset, levelSize });
+        offset += (levelSize + 3) & ~(size_t)3;
+    }
+
+    if (levels->size() != levelCount) {
+        printf("Texture loader: '%s' is truncated\n", name);
+        levels->clear();
+        return false;
+    }
+
+    *internalFormat = format;
+    return true;
+}
+
+// Load a KTX 1.1 file with a compressed 2D texture (ex.: ETC2 from the "ktx_etc2" tool).
+static bool loadKTX(TextureRequest* request) {
+    std::ifstream file(request->path.c_str(), std::ios::in | std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    unsigned int internalFormat;
+    std::vector<KTXLevel> levels;
+    if (!parseKTX(data.data(), data.size(), request->path.c_str(), &internalFormat, &levels)) {
+        return false;
+    }
+
+    // The levels are packed after each other, without the size prefixes.
+    std::vector<uint8_t> pixels;
+    for (size_t idx = 0; idx < levels.size(); idx++) {
+        const KTXLevel& level = levels[idx];
+        request->levels.push_back(MipLevel{ level.width, level.height, pixels.size(), level.size });
+        pixels.insert(pixels.end(), data.begin() + level.offset, data.begin() + level.offset + level.size);
+    }
+
+    request->pixels.swap(pixels);
+    request->compressedFormat = internalFormat;
+    return true;
+}
+
+// Create the immutable texture and copy the mip chain into it via a pixel unpack buffer.
+/* Returns the fence which is signaled when the upload is finished. */
+static GLsync uploadTexture(TextureRequest* request) {
+    const MipLevel& base = request->levels[0];
+
+    glGenTextures(1, &request->texture);
+    glBindTexture(GL_TEXTURE_2D, request->texture);
+    glTexStorage2D(GL_TEXTURE_2D, (int)request->levels.size(),
+                   request->compressedFormat ? request->compressedFormat : GL_RGBA8, base.width, base.height);
+    gpuMemoryTrackTexture(request->texture, request->compressedFormat ? request->compressedFormat : GL_RGBA8,
+                          base.width, base.height, 1, (int)request->levels.size(), GPU_MEMORY_TEXTURE,
+                          "loaded texture");
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    /* The whole chain is copied into the buffer with one memcpy, the texture
+     * uploads then read from the buffer offsets (no client memory access). */
+    unsigned int pbo;
+    glGenBuffers(1, &pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, request->pixels.size(), NULL, GL_STREAM_DRAW);
+    gpuMemoryTrackBuffer(pbo, request->pixels.size(), GPU_MEMORY_TRANSFER, "texture loader upload");
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, request->pixels.size(),
+                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    memcpy(mapped, request->pixels.data(), request->pixels.size());
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    for (size_t idx = 0; idx < request->levels.size(); idx++) {
+        const MipLevel& level = request->levels[idx];
+        if (request->compressedFormat) {
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, (int)idx, 0, 0, level.width, level.height,
+                                      request->compressedFormat, level.size, (const void*)level.offset);
+        } else {
+            glTexSubImage2D(GL_TEXTURE_2D, (int)idx, 0, 0, level.width, level.height,
+                            GL_RGBA, GL_UNSIGNED_BYTE, (const void*)level.offset);
+        }
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    /* The buffer is only released by the driver after the copies are done. */
+    glDeleteBuffers(1, &pbo);
+    gpuMemoryReleaseBuffers(1, &pbo);
+
+    // The fence (and the commands before it) must be flushed so the render context can wait for it.
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    request->memorySize = request->pixels.size();
+    request->pixels.clear();
+    request->pixels.shrink_to_fit();
+
+    return fence;
+}
+
+static void decodeWorker(TextureLoader* loader) {
+    // The flip flag of stb_image is a global unless the thread local variant is used.
+    stbi_set_flip_vertically_on_load_thread(1);
+
+    while (true) {
+        int requestIdx;
+        TextureRequest* request;
+        {
+            std::unique_lock<std::mutex> lock(loader->mutex);
+            loader->decodeReady.wait(lock, [loader] { return loader->stopping || !loader->decodeQueue.empty(); });
+            if (loader->stopping) {
+                return;
+            }
+            requestIdx = loader->decodeQueue.front();
+            request = &loader->requests[requestIdx];
+            loader->decodeQueue.pop_front();
+        }
+
+        bool loaded;
+        const std::string& path = request->path;
+        if (path.size() > 4 && path.compare(path.size() - 4, 4, ".ktx") == 0) {
+            /* The KTX files are already compressed and contain the mip chain. */
+            loaded = loadKTX(request);
+        } else {
+            int width, height, channels;
+            /* Decoded with the channels of the file, the expansion to RGBA8 is done by buildMipChain. */
+            uint8_t* image = stbi_load(path.c_str(), &width, &height, &channels, 0);
+            loaded = image != NULL;
+            if (!loaded) {
+                printf("Texture loader: unable to load '%s': %s\n", path.c_str(), stbi_failure_reason());
+            } else {
+                buildMipChain(loader, request, image, width, height, channels);
+                stbi_image_free(image);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(loader->mutex);
+        if (!loaded) {
+            request->status = TEXTURE_FAILED;
+        } else if (request->decodeOnly) {
+            request->status = TEXTURE_READY;
+        } else {
+            loader->uploadQueue.push_back(requestIdx);
+            loader->uploadReady.notify_one();
+        }
+    }
+}
+
+static void uploadWorker(TextureLoader* loader) {
+    makeSharedContextCurrent(&loader->uploadContext);
+
+    while (true) {
+        TextureRequest* request;
+        {
+            std::unique_lock<std::mutex> lock(loader->mutex);
+            loader->uploadReady.wait(lock, [loader] { return loader->stopping || !loader->uploadQueue.empty(); });
+            if (loader->stopping) {
+                break;
+            }
+            request = &loader->requests[loader->uploadQueue.front()];
+            loader->uploadQueue.pop_front();
+        }
+
+        /* The request is not touched by the other threads until the fence is published. */
+        GLsync fence = uploadTexture(request);
+
+        std::lock_guard<std::mutex> lock(loader->mutex);
+        request->fence = fence;
+    }
+
+    glFinish();
+    makeSharedContextCurrent(NULL);
+}
+
+TextureLoader* createTextureLoader(int workerCount) {
+    TextureLoader* loader = new TextureLoader();
+    loader->stopping = false;
+    loader->hasUploader = createSharedContext(&loader->uploadContext);
+    initJobSystem(&loader->jobs, 0);
+
+    if (loader->hasUploader) {
+        loader->uploader = std::thread(uploadWorker, loader);
+    } else {
+        printf("Texture loader: no shared context, uploading on the render thread\n");
+    }
+
+    for (int idx = 0; idx < (workerCount > 0 ? workerCount : 1); idx++) {
+        loader->workers.push_back(std::thread(decodeWorker, loader));
+    }
+
+    return loader;
+}
+
+void destroyTextureLoader(TextureLoader* loader) {
+    {
+        std::lock_guard<std::mutex> lock(loader->mutex);
+        loader->stopping = true;
+    }
+    loader->decodeReady.notify_all();
+    loader->uploadReady.notify_all();
+
+    for (size_t idx = 0; idx < loader->workers.size(); idx++) {
+        loader->workers[idx].join();
+    }
+
+    if (loader->hasUploader) {
+        loader->uploader.join();
+        destroySharedContext(&loader->uploadContext);
+    }
+    destroyJobSystem(&loader->jobs);
+
+    for (size_t idx = 0; idx < loader->requests.size(); idx++) {
+        if (loader->requests[idx].fence) {
+            glDeleteSync(loader->requests[idx].fence);
+        }
+    }
+
+    delete loader;
+}
+
+static int queueRequest(TextureLoader* loader, const char* path, bool decodeOnly) {
+    std::lock_guard<std::mutex> lock(loader->mutex);
+
+    TextureRequest request;
+    request.path = path;
+    request.status = TEXTURE_PENDING;
+    request.compressedFormat = 0;
+    request.memorySize = 0;
+    request.decodeOnly = decodeOnly;
+    request.texture = 0;
+    request.fence = 0;
+    loader->requests.push_back(request);
+
+    int requestIdx = (int)loader->requests.size() - 1;
+    loader->decodeQueue.push_back(requestIdx);
+    loader->decodeReady.notify_one();
+
+    return requestIdx;
+}
+
+int textureLoaderRequest(TextureLoader* loader, const char* path) {
+    return queueRequest(loader, path, false);
+}
+
+int textureLoaderRequestImage(TextureLoader* loader, const char* path) {
+    return queueRequest(loader, path, true);
+}
+
+TextureLoadStatus textureLoaderPollImage(TextureLoader* loader, int request, TextureImage* image) {
+    std::lock_guard<std::mutex> lock(loader->mutex);
+    TextureRequest& entry = loader->requests[request];
+
+    /* The decode worker publishes the chain with the status, it is not touched afterwards. */
+    if (entry.status == TEXTURE_READY && entry.decodeOnly) {
+        image->internalFormat = entry.compressedFormat ? entry.compressedFormat : GL_RGBA8;
+        image->levels.clear();
+        for (size_t idx = 0; idx < entry.levels.size(); idx++) {
+            const MipLevel& level = entry.levels[idx];
+            image->levels.push_back(KTXLevel{ level.width, level.height, level.offset, level.size });
+        }
+        image->pixels.swap(entry.pixels);
+
+        entry.levels.clear();
+        std::vector<uint8_t>().swap(entry.pixels);
+    }
+    return entry.status;
+}
+
+TextureLoadStatus textureLoaderPoll(TextureLoader* loader, int request, unsigned int* texture) {
+    std::unique_lock<std::mutex> lock(loader->mutex);
+    TextureRequest& entry = loader->requests[request];
+
+    if (entry.status == TEXTURE_PENDING && !loader->hasUploader) {
+        // No uploader thread: do the upload of a decoded image here.
+        for (size_t idx = 0; idx < loader->uploadQueue.size(); idx++) {
+            if (loader->uploadQueue[idx] == request) {
+                loader->uploadQueue.erase(loader->uploadQueue.begin() + idx);
+                entry.fence = uploadTexture(&entry);
+                break;
+            }
+        }
+    }
+
+    if (entry.status == TEXTURE_PENDING && entry.fence) {
+        // Only check the fence, never wait for it.
+        GLenum result = glClientWaitSync(entry.fence, 0, 0);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+            glDeleteSync(entry.fence);
+            entry.fence = 0;
+            entry.status = TEXTURE_READY;
+        }
+    }
+
+    if (entry.status == TEXTURE_READY) {
+        *texture = entry.texture;
+    }
+    return entry.status;
+}
+
+size_t textureLoaderMemorySize(TextureLoader* loader, int request) {
+    std::lock_guard<std::mutex> lock(loader->mutex);
+    const TextureRequest& entry = loader->requests[request];
+    /* The size is written by the uploader, it is only safe to read after the fence was seen. */
+    return entry.status == TEXTURE_READY ? entry.memorySize : 0;
+}
@@ -0,0 +1,123 @@
+/**
+ * Asynchronous texture loader: decode on worker threads, upload on a shared context.
+ *
+ * The images are decoded (stb_image) on a pool of worker threads, one image
+ * per worker. The decoded pixels are expanded to RGBA8 and the full mipmap
+ * chain is built with SIMD kernels (see common/image_convert.h), split into
+ * row ranges over the threads of a job system (see common/job_system.h).
+ * A dedicated uploader thread owns an EGL context which shares its objects
+ * with the demo's context: it creates the textures with immutable storage
+ * (glTexStorage2D), copies the mip chain through a pixel unpack buffer and
+ * inserts a fence. The render thread polls the fence without blocking, so
+ * the first frames never wait for the image decode.
+ *
+ * Files with the ".ktx" extension are loaded as KTX 1.1 compressed textures
+ * (ex.: ETC2 written by the "tools/ktx_etc2" converter) with all of their
+ * mip levels, these are uploaded with glCompressedTexSubImage2D.
+ *
+ * If no shared context can be created (ex.: the context is not an EGL one)
+ * the upload is done by textureLoaderPoll on the render thread instead.
+ *
+ * textureLoaderRequestImage only decodes: the mip chain is handed over on
+ * the CPU, for callers which upload the levels themselves (ex.: the mip
+ * streaming of common/texture_residency.h).
+ *
+ * Usage:
+ *
+ *   TextureLoader* loader = createTextureLoader(2);
+ *   int request = textureLoaderRequest(loader, "image.jpg");
+ *   while (...) {
+ *       unsigned int texture;
+ *       if (textureLoaderPoll(loader, request, &texture) == TEXTURE_READY) { ... }
+ *   }
+ *   destroyTextureLoader(loader);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *  * EGL (EGL_KHR_surfaceless_context or pbuffer support for the uploader)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_TEXTURE_LOADER_H
+#define GLES_COMMON_TEXTURE_LOADER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+struct TextureLoader;
+
+enum TextureLoadStatus {
+    TEXTURE_PENDING,
+    TEXTURE_READY,
+    TEXTURE_FAILED,
+};
+
+// Create the loader with "workerCount" decode threads.
+/* Requires a current GL ES context on the calling (render) thread,
+ * the uploader context shares its objects with it. */
+TextureLoader* createTextureLoader(int workerCount);
+
+// Stop the threads. Textures which are already created are not deleted.
+void destroyTextureLoader(TextureLoader* loader);
+
+// Queue an image file for loading. Returns the request id used for polling.
+/* The image is flipped vertically to match the GL texture coordinate system. */
+int textureLoaderRequest(TextureLoader* loader, const char* path);
+
+// Check a request without blocking, on TEXTURE_READY the texture name is returned.
+/* The texture is RGBA8 (or the KTX format) with a complete mip chain and trilinear filtering. */
+TextureLoadStatus textureLoaderPoll(TextureLoader* loader, int request, unsigned int* texture);
+
+// Size of the uploaded mip chain in bytes (0 until the texture is ready).
+size_t textureLoaderMemorySize(TextureLoader* loader, int request);
+
+// Mip level of a compressed texture, the offset is from the start of the KTX file data.
+struct KTXLevel {
+    int width;
+    int height;
+    size_t offset;
+    size_t size;
+};
+
+// Mip chain decoded by textureLoaderRequestImage, the level offsets are from the start of "pixels".
+struct TextureImage {
+    unsigned int internalFormat; // GL_RGBA8 or the KTX glInternalFormat
+    std::vector<uint8_t> pixels;
+    std::vector<KTXLevel> levels;
+};
+
+// Queue an image file for decoding only, no texture is created. Returns the request id used for polling.
+int textureLoaderRequestImage(TextureLoader* loader, const char* path);
+
+// Check a decode only request without blocking, on TEXTURE_READY the mip chain is moved into "image".
+/* The chain is handed over once: the following polls return TEXTURE_READY with an empty image. */
+TextureLoadStatus textureLoaderPollImage(TextureLoader* loader, int request, TextureImage* image);
+
+// Parse a KTX 1.1 file in memory with a compressed 2D texture and its mip levels.
+/* Returns false (and prints the reason with the "name" of the file) for unsupported files. */
+bool parseKTX(const uint8_t* data, size_t size, const char* name, unsigned int* internalFormat,
+              std::vector<KTXLevel>* levels);
+
+#endif // GLES_COMMON_TEXTURE_LOADER_H
@@ -0,0 +1,340 @@
+/**
+ * Texture residency, see texture_residency.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/texture_residency.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+
+#include <GLES3/gl3.h>
+
+#include "common/gpu_memory.h"
+
+static int levelSize(int size, int level) {
+    return (size >> level) > 0 ? size >> level : 1;
+}
+
+// The largest edge of the level, the screen sizes are compared to it.
+static int levelEdge(const ResidentTexture& texture, int level) {
+    return std::max(levelSize(texture.width, level), levelSize(texture.height, level));
+}
+
+// The coarsest level which is still at least as large as the screen size.
+static int wantedLevel(const ResidentTexture& texture, float screenSize) {
+    int level = 0;
+    while (level < texture.tailLevel && levelEdge(texture, level + 1) >= screenSize) {
+        level++;
+    }
+    return level;
+}
+
+// Register the resident range in the GPU memory accounting.
+static void trackResident(const ResidentTexture& texture) {
+    if (texture.residentBase >= texture.levelCount) {
+        gpuMemoryReleaseTextures(1, &texture.texture);
+        return;
+    }
+    gpuMemoryTrackTexture(texture.texture, texture.internalFormat, levelSize(texture.width, texture.residentBase),
+                          levelSize(texture.height, texture.residentBase), 1,
+                          texture.levelCount - texture.residentBase, GPU_MEMORY_TEXTURE, "resident texture");
+}
+
+// Define one level from the decoded chain and move the base level clamp down to it.
+static void uploadLevel(TextureResidency* residency, ResidentTexture* texture, int level) {
+    const KTXLevel& data = texture->image.levels[level];
+    const uint8_t* pixels = texture->image.pixels.data() + data.offset;
+
+    glBindTexture(GL_TEXTURE_2D, texture->texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (texture->internalFormat != GL_RGBA8) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, texture->internalFormat, data.width, data.height, 0,
+                               (int)data.size, pixels);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, data.width, data.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    }
+    if (level < texture->residentBase) {
+        texture->residentBase = level;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    residency->residentBytes += texture->levelBytes[level];
+    residency->uploadedLevels++;
+    residency->uploadedBytes += data.size;
+}
+
+// Clamp the base level above the finest resident level and release its storage.
+static void evictLevel(TextureResidency* residency, ResidentTexture* texture) {
+    int level = texture->residentBase++;
+
+    glBindTexture(GL_TEXTURE_2D, texture->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture->residentBase);
+    /* A 0x0 image has no storage: the level stays outside of the clamp until it is uploaded again. */
+    if (texture->internalFormat != GL_RGBA8) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, texture->internalFormat, 0, 0, 0, 0, NULL);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    residency->residentBytes -= texture->levelBytes[level];
+    residency->evictedLevels++;
+    residency->evictedBytes += texture->levelBytes[level];
+    trackResident(*texture);
+}
+
+// Evict levels of other textures until "bytes" fit into the budget. Returns false if there is no victim left.
+/* Victims: not used in this frame, levels finer than their use needs or smaller on the screen than the
+ * requester. The least recently used goes first, then the unneeded levels, then the smallest one. */
+static bool makeRoom(TextureResidency* residency, size_t bytes, const ResidentTexture* requester) {
+    float requesterSize = requester != NULL ? requester->screenSize : 0.0f;
+
+    while (residency->residentBytes + bytes > residency->budget) {
+        ResidentTexture* victim = NULL;
+        for (ResidentTexture& texture : residency->textures) {
+            if (&texture == requester || texture.residentBase >= texture.tailLevel) {
+                continue;
+            }
+            bool unused = texture.lastUsedFrame < residency->frame;
+            bool excess = texture.residentBase < texture.wantedBase;
+            if (!unused && !excess && texture.screenSize >= requesterSize) {
+                continue;
+            }
+
+            if (victim == NULL || texture.lastUsedFrame < victim->lastUsedFrame) {
+                victim = &texture;
+            } else if (texture.lastUsedFrame == victim->lastUsedFrame) {
+                bool victimExcess = victim->residentBase < victim->wantedBase;
+                if ((excess && !victimExcess) || (excess == victimExcess && texture.screenSize < victim->screenSize)) {
+                    victim = &texture;
+                }
+            }
+        }
+
+        if (victim == NULL) {
+            return false;
+        }
+        evictLevel(residency, victim);
+    }
+    return true;
+}
+
+// The first decode: the size of the chain, the clamp of the levels and the coarse tail.
+static void initLevels(TextureResidency* residency, ResidentTexture* texture) {
+    const TextureImage& image = texture->image;
+    texture->internalFormat = image.internalFormat;
+    texture->width = image.levels[0].width;
+    texture->height = image.levels[0].height;
+    texture->levelCount = (int)image.levels.size();
+    texture->residentBase = texture->levelCount;
+    texture->tailLevel = texture->levelCount - 1;
+    for (int level = 0; level < texture->levelCount; level++) {
+        texture->levelBytes.push_back(gpuMemoryImageBytes(texture->internalFormat, image.levels[level].width,
+                                                          image.levels[level].height, 1, 1, 1));
+        if (level < texture->tailLevel && levelEdge(*texture, level) <= TEXTURE_RESIDENCY_TAIL_SIZE) {
+            texture->tailLevel = level;
+        }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture->levelCount - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    /* The tail is always resident, also over the budget (the accounting shows it). */
+    size_t tailBytes = 0;
+    for (int level = texture->tailLevel; level < texture->levelCount; level++) {
+        tailBytes += texture->levelBytes[level];
+    }
+    makeRoom(residency, tailBytes, NULL);
+    for (int level = texture->levelCount - 1; level >= texture->tailLevel; level--) {
+        uploadLevel(residency, texture, level);
+    }
+    trackResident(*texture);
+}
+
+void initTextureResidency(TextureResidency* residency, TextureLoader* loader, size_t budget, size_t uploadBudget) {
+    residency->loader = loader;
+    residency->textures.clear();
+    residency->budget = budget;
+    residency->uploadBudget = uploadBudget;
+    residency->residentBytes = 0;
+    residency->frame = 0;
+    residency->decodesInFlight = 0;
+
+    residency->decodeCount = 0;
+    residency->uploadedLevels = 0;
+    residency->uploadedBytes = 0;
+    residency->evictedLevels = 0;
+    residency->evictedBytes = 0;
+    residency->skippedLevels = 0;
+    residency->overBudgetFrames = 0;
+    residency->peakBytes = 0;
+}
+
+void destroyTextureResidency(TextureResidency* residency) {
+    printf("Texture residency: %d textures, %d decodes, uploaded %d levels (%.1f MiB), evicted %d levels (%.1f MiB), "
+           "%d uploads skipped without room\n", (int)residency->textures.size(), residency->decodeCount,
+           residency->uploadedLevels, residency->uploadedBytes / (1024.0 * 1024.0), residency->evictedLevels,
+           residency->evictedBytes / (1024.0 * 1024.0), residency->skippedLevels);
+    printf("Texture residency: peak %.1f MiB of the %.1f MiB budget, %d frames over the budget\n",
+           residency->peakBytes / (1024.0 * 1024.0), residency->budget / (1024.0 * 1024.0),
+           residency->overBudgetFrames);
+
+    for (ResidentTexture& texture : residency->textures) {
+        glDeleteTextures(1, &texture.texture);
+        gpuMemoryReleaseTextures(1, &texture.texture);
+    }
+    residency->textures.clear();
+}
+
+int textureResidencyAdd(TextureResidency* residency, const char* path) {
+    ResidentTexture texture;
+    texture.path = path;
+    texture.internalFormat = 0;
+    texture.width = 0;
+    texture.height = 0;
+    texture.levelCount = 0;
+    texture.residentBase = 0;
+    texture.tailLevel = 0;
+    texture.wantedBase = 0;
+    texture.screenSize = 0.0f;
+    texture.lastUsedFrame = -1;
+    texture.decodeRequest = -1;
+    texture.failed = false;
+
+    /* Mutable storage: the levels are defined and released one by one (see the header). */
+    glGenTextures(1, &texture.texture);
+    glBindTexture(GL_TEXTURE_2D, texture.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    residency->textures.push_back(texture);
+    return (int)residency->textures.size() - 1;
+}
+
+unsigned int textureResidencyUse(TextureResidency* residency, int texture, float screenSize) {
+    ResidentTexture& entry = residency->textures[texture];
+    if (entry.lastUsedFrame != residency->frame || screenSize > entry.screenSize) {
+        entry.screenSize = screenSize;
+    }
+    entry.lastUsedFrame = residency->frame;
+    return entry.texture;
+}
+
+void textureResidencyUpdate(TextureResidency* residency) {
+    // 1. The finest level needed by the uses of the frame (the others only need their tail).
+    for (ResidentTexture& texture : residency->textures) {
+        if (texture.levelCount > 0) {
+            texture.wantedBase = texture.lastUsedFrame == residency->frame ? wantedLevel(texture, texture.screenSize)
+                                                                           : texture.tailLevel;
+        }
+    }
+
+    // 2. Collect the finished decodes.
+    for (ResidentTexture& texture : residency->textures) {
+        if (texture.decodeRequest < 0) {
+            continue;
+        }
+        TextureLoadStatus status = textureLoaderPollImage(residency->loader, texture.decodeRequest, &texture.image);
+        if (status == TEXTURE_PENDING) {
+            continue;
+        }
+        texture.decodeRequest = -1;
+        residency->decodesInFlight--;
+
+        if (status == TEXTURE_FAILED || texture.image.levels.empty()) {
+            texture.failed = true;
+        } else if (texture.levelCount == 0) {
+            initLevels(residency, &texture);
+            texture.wantedBase = texture.lastUsedFrame == residency->frame ? wantedLevel(texture, texture.screenSize)
+                                                                           : texture.tailLevel;
+        }
+    }
+
+    // 3. Stream the missing levels in, the largest textures on the screen first.
+    std::vector<ResidentTexture*> order;
+    for (ResidentTexture& texture : residency->textures) {
+        bool missing = texture.levelCount == 0 || texture.residentBase > texture.wantedBase;
+        if (texture.lastUsedFrame == residency->frame && missing && !texture.failed) {
+            order.push_back(&texture);
+        }
+    }
+    std::sort(order.begin(), order.end(),
+              [](const ResidentTexture* a, const ResidentTexture* b) { return a->screenSize > b->screenSize; });
+
+    size_t uploaded = 0;
+    for (ResidentTexture* texture : order) {
+        // 3.1. The levels come from a decoded image: queue the decode if it is not there.
+        if (texture->image.levels.empty()) {
+            if (texture->decodeRequest < 0 && residency->decodesInFlight < TEXTURE_RESIDENCY_MAX_DECODES) {
+                texture->decodeRequest = textureLoaderRequestImage(residency->loader, texture->path.c_str());
+                residency->decodesInFlight++;
+                residency->decodeCount++;
+            }
+            continue;
+        }
+
+        // 3.2. One level finer at a time, while the frame's upload budget lasts and room can be made.
+        while (texture->residentBase > texture->wantedBase
+               && (uploaded == 0 || uploaded + texture->levelBytes[texture->residentBase - 1] <= residency->uploadBudget)) {
+            int level = texture->residentBase - 1;
+            if (!makeRoom(residency, texture->levelBytes[level], texture)) {
+                residency->skippedLevels++;
+                break;
+            }
+            uploadLevel(residency, texture, level);
+            uploaded += texture->levelBytes[level];
+        }
+        trackResident(*texture);
+    }
+
+    // 4. Release the decoded images of the textures which left the screen (or have every level).
+    for (ResidentTexture& texture : residency->textures) {
+        if (!texture.image.levels.empty() && (texture.lastUsedFrame < residency->frame || texture.residentBase == 0)) {
+            texture.image.levels.clear();
+            std::vector<uint8_t>().swap(texture.image.pixels);
+        }
+    }
+
+    // 5. A lowered budget (or the tails alone) can be over: evict what the uses allow.
+    if (!makeRoom(residency, 0, NULL)) {
+        residency->overBudgetFrames++;
+    }
+    residency->peakBytes = std::max(residency->peakBytes, residency->residentBytes);
+    residency->frame++;
+}
+
+int textureResidencyDetailedCount(const TextureResidency* residency) {
+    int count = 0;
+    for (const ResidentTexture& texture : residency->textures) {
+        if (texture.levelCount > 0 && texture.residentBase < texture.tailLevel) {
+            count++;
+        }
+    }
+    return count;
+}
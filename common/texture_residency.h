@@ -0,0 +1,145 @@
+/**
+ * Texture residency: stream the mip levels of many textures in and out
+ * under a GPU memory budget.
+ *
+ * Every texture starts with its coarse tail only (the levels of at most
+ * TEXTURE_RESIDENCY_TAIL_SIZE pixels, never evicted). The demo reports the
+ * textures it draws with their size on the screen (in pixels) every frame;
+ * the finest level a texture needs is the first one which is still at least
+ * as large as its screen size. Once per frame the manager:
+ *
+ *   1. collects the decoded images of the async texture loader (decode only
+ *      requests, see common/texture_loader.h, at most
+ *      TEXTURE_RESIDENCY_MAX_DECODES in flight),
+ *   2. streams the missing levels in, one level finer at a time, the largest
+ *      textures on the screen first, until "uploadBudget" bytes are uploaded
+ *      in the frame (at least one level),
+ *   3. makes room for a level by evicting the finest resident level of other
+ *      textures: the least recently used first, then the levels finer than
+ *      their use needs, then the smallest ones on the screen. A texture which
+ *      is larger on the screen than the one that needs the room is not
+ *      touched: the level is skipped until room is made elsewhere.
+ *
+ * The resident range is the GL_TEXTURE_BASE_LEVEL - GL_TEXTURE_MAX_LEVEL
+ * clamp of the texture: the sampler never reads a missing level, the image
+ * gets sharper as the levels arrive. An evicted level is redefined as 0x0,
+ * so the driver releases its memory. This needs mutable storage: the
+ * immutable glTexStorage2D textures of the loader can't release their
+ * levels. The levels which aren't needed any more are kept as a cache while
+ * the budget allows it. The decoded image is kept while the texture is on
+ * the screen (its needed levels change with its size) and released when it
+ * is not used in a frame: an evicted level is decoded again when it is
+ * needed later.
+ *
+ * The sizes are the ones of the GPU memory accounting (see common/gpu_memory.h),
+ * the resident range of each texture is registered there too.
+ *
+ * Usage:
+ *
+ *   TextureResidency residency;
+ *   initTextureResidency(&residency, loader, 64 << 20, 4 << 20);
+ *   int texture = textureResidencyAdd(&residency, "image.jpg");
+ *   while (...) {
+ *       glBindTexture(GL_TEXTURE_2D, textureResidencyUse(&residency, texture, 200.0f));
+ *       ... draw ...
+ *       textureResidencyUpdate(&residency);
+ *   }
+ *   destroyTextureResidency(&residency);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_TEXTURE_RESIDENCY_H
+#define GLES_COMMON_TEXTURE_RESIDENCY_H
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "common/texture_loader.h"
+
+#define TEXTURE_RESIDENCY_TAIL_SIZE 64
+#define TEXTURE_RESIDENCY_MAX_DECODES 4
+
+struct ResidentTexture {
+    std::string path;
+    unsigned int texture;
+    unsigned int internalFormat; // 0 until the first decode is finished
+    int width;
+    int height;
+    int levelCount;
+    std::vector<size_t> levelBytes;
+
+    int residentBase;  // GL_TEXTURE_BASE_LEVEL, levelCount: nothing is resident
+    int tailLevel;     // the levels from here are never evicted
+    int wantedBase;    // the finest level needed by the uses of the frame
+    float screenSize;  // the largest size of the uses of the frame (pixels)
+    int lastUsedFrame; // -1: never used
+
+    int decodeRequest; // -1: no decode in flight
+    TextureImage image; // the decoded mip chain while levels are missing
+    bool failed;
+};
+
+struct TextureResidency {
+    TextureLoader* loader;
+    std::vector<ResidentTexture> textures;
+    size_t budget;       // bytes of the resident levels
+    size_t uploadBudget; // bytes uploaded per frame
+    size_t residentBytes;
+    int frame;
+    int decodesInFlight;
+
+    // Statistics.
+    int decodeCount;
+    int uploadedLevels;
+    size_t uploadedBytes;
+    int evictedLevels;
+    size_t evictedBytes;
+    int skippedLevels;    // uploads without room in the budget
+    int overBudgetFrames; // the coarse tails alone are over the budget
+    size_t peakBytes;
+};
+
+void initTextureResidency(TextureResidency* residency, TextureLoader* loader, size_t budget, size_t uploadBudget);
+
+// Delete the textures and print the statistics.
+void destroyTextureResidency(TextureResidency* residency);
+
+// Register an image file (JPEG, PNG, KTX, ...), returns its index. Nothing is loaded until it is used.
+int textureResidencyAdd(TextureResidency* residency, const char* path);
+
+// Mark the texture used in this frame with its size on the screen, returns the GL texture to bind.
+/* The texture is incomplete (samples black) until its coarse tail is loaded. */
+unsigned int textureResidencyUse(TextureResidency* residency, int texture, float screenSize);
+
+// Stream in and evict the levels for the uses of the frame. Call once per frame, after the draws.
+void textureResidencyUpdate(TextureResidency* residency);
+
+// The number of textures which have more than their coarse tail resident.
+int textureResidencyDetailedCount(const TextureResidency* residency);
+
+#endif // GLES_COMMON_TEXTURE_RESIDENCY_H
@@ -0,0 +1,344 @@
+/**
+ * Streaming texture uploads. See texture_upload.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/texture_upload.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#include "common/gpu_memory.h"
+#include "common/image_convert.h"
+
+const char* textureUploadFormatNames[TEXTURE_UPLOAD_FORMAT_COUNT] = {
+    "rgb", "rgba", "bgra",
+};
+
+static bool hasGLExtension(const char* name) {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int idx = 0; idx < count; idx++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, idx), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int formatBytes(TextureUploadFormat format) {
+    return format == TEXTURE_UPLOAD_RGB ? 3 : 4;
+}
+
+// Transfer format/type and the internal formats of glTexImage2D and glTexStorage2D.
+static void uploadFormats(TextureUploadFormat format, GLenum* transfer, GLenum* imageFormat, GLenum* storageFormat) {
+    switch (format) {
+    case TEXTURE_UPLOAD_RGB:
+        *transfer = GL_RGB;
+        *imageFormat = GL_RGB8;
+        *storageFormat = GL_RGB8;
+        break;
+    case TEXTURE_UPLOAD_RGBA:
+        *transfer = GL_RGBA;
+        *imageFormat = GL_RGBA8;
+        *storageFormat = GL_RGBA8;
+        break;
+    default:
+        /* EXT_texture_format_BGRA8888 only allows the unsized internal format in glTexImage2D. */
+        *transfer = GL_BGRA_EXT;
+        *imageFormat = GL_BGRA_EXT;
+        *storageFormat = GL_BGRA8_EXT;
+        break;
+    }
+}
+
+std::string textureUploadPathName(const TextureUploadPath& path) {
+    return std::string(path.texStorage ? "storage" : "image") + (path.pbo ? "-pbo-" : "-direct-") +
+           textureUploadFormatNames[path.format] + "-" + std::to_string(path.alignment);
+}
+
+bool parseTextureUploadPath(const char* name, TextureUploadPath* path) {
+    char allocation[16];
+    char source[16];
+    char format[16];
+    int alignment = 0;
+    if (sscanf(name, "%15[^-]-%15[^-]-%15[^-]-%d", allocation, source, format, &alignment) == 4 &&
+        (alignment == 1 || alignment == 4 || alignment == 8)) {
+        TextureUploadPath result = { strcmp(allocation, "storage") == 0, strcmp(source, "pbo") == 0,
+                                     TEXTURE_UPLOAD_FORMAT_COUNT, alignment };
+        for (int idx = 0; idx < TEXTURE_UPLOAD_FORMAT_COUNT; idx++) {
+            if (strcmp(format, textureUploadFormatNames[idx]) == 0) {
+                result.format = (TextureUploadFormat)idx;
+            }
+        }
+
+        bool validAllocation = result.texStorage || strcmp(allocation, "image") == 0;
+        bool validSource = result.pbo || strcmp(source, "direct") == 0;
+        if (validAllocation && validSource && result.format != TEXTURE_UPLOAD_FORMAT_COUNT) {
+            *path = result;
+            return true;
+        }
+    }
+
+    printf("Invalid upload path '%s' (<image|storage>-<direct|pbo>-<rgb|rgba|bgra>-<1|4|8>)\n", name);
+    return false;
+}
+
+static bool pathSupported(TextureUploadFormat source, const TextureUploadPath& path) {
+    if (path.format == TEXTURE_UPLOAD_BGRA) {
+        if (source != TEXTURE_UPLOAD_BGRA || !hasGLExtension("GL_EXT_texture_format_BGRA8888")) {
+            return false;
+        }
+        /* The sized BGRA8 format of glTexStorage2D comes from EXT_texture_storage. */
+        if (path.texStorage && !hasGLExtension("GL_EXT_texture_storage")) {
+            return false;
+        }
+        return true;
+    }
+    if (path.format == TEXTURE_UPLOAD_RGB) {
+        return source == TEXTURE_UPLOAD_RGB;
+    }
+    return true;
+}
+
+std::vector<TextureUploadPath> textureUploadCandidates(TextureUploadFormat source) {
+    static const int alignments[] = { 1, 4, 8 };
+
+    std::vector<TextureUploadPath> paths;
+    for (int storage = 0; storage < 2; storage++) {
+        for (int pbo = 0; pbo < 2; pbo++) {
+            for (int format = 0; format < TEXTURE_UPLOAD_FORMAT_COUNT; format++) {
+                for (int alignment : alignments) {
+                    TextureUploadPath path = { storage != 0, pbo != 0, (TextureUploadFormat)format, alignment };
+                    if (pathSupported(source, path)) {
+                        paths.push_back(path);
+                    }
+                }
+            }
+        }
+    }
+    return paths;
+}
+
+bool initStreamTexture(StreamTexture* stream, int width, int height, TextureUploadFormat source,
+                       const TextureUploadPath& path, int levels) {
+    if (!pathSupported(source, path)) {
+        printf("Upload path '%s' is not supported for %s frames\n", textureUploadPathName(path).c_str(),
+               textureUploadFormatNames[source]);
+        return false;
+    }
+
+    stream->width = width;
+    stream->height = height;
+    stream->source = source;
+    stream->path = path;
+    stream->levels = levels;
+    stream->pboIndex = 0;
+    stream->pbos[0] = stream->pbos[1] = stream->pbos[2] = 0;
+
+    int alignment = path.alignment;
+    stream->rowBytes = (width * formatBytes(path.format) + alignment - 1) / alignment * alignment;
+    size_t frameBytes = (size_t)stream->rowBytes * height;
+
+    GLenum transfer;
+    GLenum imageFormat;
+    GLenum storageFormat;
+    uploadFormats(path.format, &transfer, &imageFormat, &storageFormat);
+
+    // U.1. The texture: immutable storage once, or the first glTexImage2D.
+    glGenTextures(1, &stream->texture);
+    glBindTexture(GL_TEXTURE_2D, stream->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if (path.texStorage) {
+        glTexStorage2D(GL_TEXTURE_2D, levels, storageFormat, width, height);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, imageFormat, width, height, 0, transfer, GL_UNSIGNED_BYTE, NULL);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    gpuMemoryTrackTexture(stream->texture, path.texStorage ? storageFormat : imageFormat, width, height, 1, levels,
+                          GPU_MEMORY_TEXTURE, "stream texture");
+
+    // U.2. The staging memory: the PBO ring, or a frame in client memory for the converted/padded rows.
+    if (path.pbo) {
+        glGenBuffers(3, stream->pbos);
+        for (int idx = 0; idx < 3; idx++) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stream->pbos[idx]);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, frameBytes, NULL, GL_STREAM_DRAW);
+            gpuMemoryTrackBuffer(stream->pbos[idx], frameBytes, GPU_MEMORY_TRANSFER, "stream texture upload");
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    } else if (path.format != source || stream->rowBytes != width * formatBytes(source)) {
+        stream->staging.resize(frameBytes);
+    }
+    return glGetError() == GL_NO_ERROR;
+}
+
+// A source row in the transfer format: copy, RGB -> RGBA expansion or the red/blue swap.
+static void convertRow(uint8_t* dst, const uint8_t* src, int width, TextureUploadFormat source,
+                       TextureUploadFormat format) {
+    if (source == format) {
+        memcpy(dst, src, (size_t)width * formatBytes(format));
+    } else if (source == TEXTURE_UPLOAD_RGB) {
+        convertToRGBA8(dst, src, 0, 1, width, 3);
+    } else {
+        for (int x = 0; x < width; x++) {
+            dst[x * 4 + 0] = src[x * 4 + 2];
+            dst[x * 4 + 1] = src[x * 4 + 1];
+            dst[x * 4 + 2] = src[x * 4 + 0];
+            dst[x * 4 + 3] = src[x * 4 + 3];
+        }
+    }
+}
+
+static void convertFrame(uint8_t* dst, const StreamTexture* stream, const uint8_t* pixels) {
+    int sourceRow = stream->width * formatBytes(stream->source);
+    for (int y = 0; y < stream->height; y++) {
+        convertRow(dst + (size_t)y * stream->rowBytes, pixels + (size_t)y * sourceRow, stream->width, stream->source,
+                   stream->path.format);
+    }
+}
+
+void streamTextureUpload(StreamTexture* stream, const uint8_t* pixels) {
+    const TextureUploadPath& path = stream->path;
+    size_t frameBytes = (size_t)stream->rowBytes * stream->height;
+
+    // U.3. The pixels of the call: the mapped next PBO of the ring, the staging frame or the frame itself.
+    const void* data = pixels;
+    if (path.pbo) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stream->pbos[stream->pboIndex]);
+        stream->pboIndex = (stream->pboIndex + 1) % 3;
+
+        /* Invalidating the whole buffer lets the driver hand out new memory if the GPU still reads the old one. */
+        uint8_t* mapped = (uint8_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, frameBytes,
+                                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped == NULL) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return;
+        }
+        convertFrame(mapped, stream, pixels);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        data = NULL;
+    } else if (!stream->staging.empty()) {
+        convertFrame(stream->staging.data(), stream, pixels);
+        data = stream->staging.data();
+    }
+
+    // U.4. The copy into the texture.
+    GLenum transfer;
+    GLenum imageFormat;
+    GLenum storageFormat;
+    uploadFormats(path.format, &transfer, &imageFormat, &storageFormat);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, path.alignment);
+    glBindTexture(GL_TEXTURE_2D, stream->texture);
+    if (path.texStorage) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, stream->width, stream->height, transfer, GL_UNSIGNED_BYTE, data);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, imageFormat, stream->width, stream->height, 0, transfer, GL_UNSIGNED_BYTE, data);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void destroyStreamTexture(StreamTexture* stream) {
+    glDeleteTextures(1, &stream->texture);
+    gpuMemoryReleaseTextures(1, &stream->texture);
+    if (stream->path.pbo) {
+        glDeleteBuffers(3, stream->pbos);
+        gpuMemoryReleaseBuffers(3, stream->pbos);
+    }
+    stream->texture = 0;
+    stream->staging.clear();
+}
+
+std::vector<TextureUploadResult> benchmarkTextureUploadPaths(int width, int height, TextureUploadFormat source,
+                                                             int frames) {
+    // B.1. Two different frames, so no upload can be skipped as a repeat.
+    size_t frameBytes = (size_t)width * height * formatBytes(source);
+    std::vector<uint8_t> pixels[2];
+    for (int frame = 0; frame < 2; frame++) {
+        pixels[frame].resize(frameBytes);
+        for (size_t idx = 0; idx < frameBytes; idx++) {
+            pixels[frame][idx] = (uint8_t)(idx * 7 + frame * 101);
+        }
+    }
+
+    // B.2. Warm up then time every path between two glFinish calls.
+    std::vector<TextureUploadResult> results;
+    for (const TextureUploadPath& path : textureUploadCandidates(source)) {
+        StreamTexture stream;
+        if (!initStreamTexture(&stream, width, height, source, path)) {
+            destroyStreamTexture(&stream);
+            continue;
+        }
+
+        for (int frame = 0; frame < 2; frame++) {
+            streamTextureUpload(&stream, pixels[frame].data());
+        }
+        glFinish();
+
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; frame++) {
+            streamTextureUpload(&stream, pixels[frame % 2].data());
+        }
+        glFinish();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        destroyStreamTexture(&stream);
+
+        TextureUploadResult result;
+        result.path = path;
+        result.msPerFrame = seconds * 1000.0 / frames;
+        result.gigabytesPerSecond = seconds > 0.0 ? frameBytes * (double)frames / seconds / 1e9 : 0.0;
+        results.push_back(result);
+    }
+    return results;
+}
+
+TextureUploadPath selectTextureUploadPath(int width, int height, TextureUploadFormat source,
+                                          std::vector<TextureUploadResult>* results, int frames) {
+    std::vector<TextureUploadResult> measured = benchmarkTextureUploadPaths(width, height, source, frames);
+
+    // Without any measurement: the immutable texture from client memory in the source format.
+    TextureUploadPath best = { true, false, source == TEXTURE_UPLOAD_BGRA ? TEXTURE_UPLOAD_RGBA : source, 4 };
+    double bestMs = 0.0;
+    for (const TextureUploadResult& result : measured) {
+        if (bestMs == 0.0 || result.msPerFrame < bestMs) {
+            best = result.path;
+            bestMs = result.msPerFrame;
+        }
+    }
+
+    if (results != NULL) {
+        *results = measured;
+    }
+    return best;
+}
@@ -0,0 +1,140 @@
+/**
+ * Streaming texture uploads (ex.: video frames) with the fastest path of the device.
+ *
+ * A frame can reach a texture in many ways and the drivers differ a lot in
+ * which one is fast. An upload path is the combination of:
+ *
+ *  allocation  "image": glTexImage2D every frame (the driver can orphan the old storage),
+ *              "storage": glTexStorage2D once, then glTexSubImage2D into the immutable texture.
+ *  source      "direct": from client memory (the driver copies it before the call returns),
+ *              "pbo": written into a ring of 3 pixel unpack buffers (mapped with
+ *              GL_MAP_INVALIDATE_BUFFER_BIT), the copy into the texture is done by the GPU/driver.
+ *  format      The transfer format: "rgb", "rgba" or "bgra" (EXT_texture_format_BGRA8888). The frames
+ *              are converted on the CPU if it differs from their format (RGB -> RGBA expansion,
+ *              BGRA <-> RGBA swizzle), the conversion is part of the cost.
+ *  alignment   GL_UNPACK_ALIGNMENT 1, 4 or 8, the transferred rows are padded to it.
+ *
+ * The name of a path is "<allocation>-<source>-<format>-<alignment>", ex.: "storage-pbo-rgba-4".
+ * selectTextureUploadPath streams a few frames of the given size through every
+ * path the device supports (textureUploadCandidates) and returns the fastest.
+ * The frames are timed between two glFinish calls, so the time includes the
+ * conversion, the copies and the GPU side of the upload.
+ *
+ * Usage:
+ *
+ *   TextureUploadPath path = selectTextureUploadPath(1920, 1080, TEXTURE_UPLOAD_RGB);
+ *   StreamTexture stream;
+ *   initStreamTexture(&stream, 1920, 1080, TEXTURE_UPLOAD_RGB, path);
+ *   while (...) {
+ *       streamTextureUpload(&stream, framePixels);
+ *       glBindTexture(GL_TEXTURE_2D, stream.texture);
+ *       ...
+ *   }
+ *   destroyStreamTexture(&stream);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *  * EXT_texture_format_BGRA8888 (optional, + EXT_texture_storage for the BGRA storage paths)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_TEXTURE_UPLOAD_H
+#define GLES_COMMON_TEXTURE_UPLOAD_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+enum TextureUploadFormat {
+    TEXTURE_UPLOAD_RGB,  // 3 bytes per pixel
+    TEXTURE_UPLOAD_RGBA, // 4 bytes per pixel
+    TEXTURE_UPLOAD_BGRA, // 4 bytes per pixel, red and blue swapped
+    TEXTURE_UPLOAD_FORMAT_COUNT,
+};
+
+// "rgb", "rgba", "bgra".
+extern const char* textureUploadFormatNames[TEXTURE_UPLOAD_FORMAT_COUNT];
+
+struct TextureUploadPath {
+    bool texStorage;            // glTexStorage2D + glTexSubImage2D instead of glTexImage2D every frame
+    bool pbo;                   // through the pixel unpack buffers instead of client memory
+    TextureUploadFormat format; // transfer format
+    int alignment;              // GL_UNPACK_ALIGNMENT: 1, 4 or 8
+};
+
+// "<image|storage>-<direct|pbo>-<format>-<alignment>".
+std::string textureUploadPathName(const TextureUploadPath& path);
+
+// The path of a name. Returns false (and prints the expected form) for an invalid name.
+bool parseTextureUploadPath(const char* name, TextureUploadPath* path);
+
+// The paths of frames in the "source" format which the device supports.
+/* The transfer formats: the source format itself, RGBA for RGB frames, RGBA for BGRA frames and
+ * BGRA only with EXT_texture_format_BGRA8888 (and EXT_texture_storage for the storage paths). */
+std::vector<TextureUploadPath> textureUploadCandidates(TextureUploadFormat source);
+
+// A texture which receives a new frame with every streamTextureUpload.
+struct StreamTexture {
+    unsigned int texture;
+    int width;
+    int height;
+    TextureUploadFormat source;
+    TextureUploadPath path;
+    int rowBytes;                 // a padded row of the transfer format
+    int levels;                   // mip levels, the uploads only write level 0
+
+    unsigned int pbos[3];         // ring of pixel unpack buffers (the "pbo" paths)
+    int pboIndex;
+    std::vector<uint8_t> staging; // converted/padded frame of the "direct" paths
+};
+
+// Create the texture of width x height frames in the "source" format and the buffers of the path.
+/* Returns false if the path is not supported by the device (see textureUploadCandidates). With more
+ * than 1 level the caller generates the mipmaps after every upload (the "image" paths only allocate
+ * level 0, glGenerateMipmap allocates the others). */
+bool initStreamTexture(StreamTexture* stream, int width, int height, TextureUploadFormat source,
+                       const TextureUploadPath& path, int levels = 1);
+
+// Upload a frame: tightly packed rows (bottom row first) in the source format.
+/* Leaves GL_TEXTURE_2D of the active texture unit and GL_PIXEL_UNPACK_BUFFER unbound. */
+void streamTextureUpload(StreamTexture* stream, const uint8_t* pixels);
+
+void destroyStreamTexture(StreamTexture* stream);
+
+// Measured cost of a path.
+struct TextureUploadResult {
+    TextureUploadPath path;
+    double msPerFrame;
+    double gigabytesPerSecond; // of the source frames
+};
+
+// Stream "frames" frames (after 2 warm-up frames) through every candidate path, in candidate order.
+std::vector<TextureUploadResult> benchmarkTextureUploadPaths(int width, int height, TextureUploadFormat source,
+                                                             int frames);
+
+// The fastest candidate path for width x height frames in the "source" format (results: every measurement).
+TextureUploadPath selectTextureUploadPath(int width, int height, TextureUploadFormat source,
+                                          std::vector<TextureUploadResult>* results = NULL, int frames = 8);
+
+#endif // GLES_COMMON_TEXTURE_UPLOAD_H
@@ -0,0 +1,161 @@
+/**
+ * Animation clock of the demos. See time_source.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/time_source.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+const char* timeSourceModeNames[TIME_SOURCE_MODE_COUNT] = { "real", "fixed", "recorded" };
+
+struct TimeSource {
+    TimeSourceMode mode;
+    double step;
+    std::string path; // real: the record, recorded: the replayed file
+
+    // Times of the frames: recorded (real) or replayed (recorded).
+    std::vector<double> times;
+
+    int frame; // frame of "time", -1: not sampled yet
+    double time;
+};
+
+bool parseTimeSourceMode(const char* name, TimeSourceMode* mode) {
+    for (int idx = 0; idx < TIME_SOURCE_MODE_COUNT; idx++) {
+        if (strcmp(name, timeSourceModeNames[idx]) == 0) {
+            *mode = (TimeSourceMode)idx;
+            return true;
+        }
+    }
+
+    printf("Error: unknown time source '%s', valid values:", name);
+    for (int idx = 0; idx < TIME_SOURCE_MODE_COUNT; idx++) {
+        printf(" %s", timeSourceModeNames[idx]);
+    }
+    printf("\n");
+    return false;
+}
+
+static bool readTimes(const std::string& path, std::vector<double>* times) {
+    std::ifstream file(path.c_str());
+    if (!file) {
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line[0] != '#') {
+            times->push_back(atof(line.c_str()));
+        }
+    }
+    return true;
+}
+
+TimeSource* createTimeSource(TimeSourceMode mode, double step, const char* path) {
+    TimeSource* source = new TimeSource();
+    source->mode = mode;
+    source->step = step > 0.0 ? step : 1.0 / 60.0;
+    source->path = path ? path : "";
+    source->frame = -1;
+    source->time = 0.0;
+
+    if (mode == TIME_SOURCE_RECORDED) {
+        if (source->path.empty()) {
+            printf("Error: the recorded time source needs a time file (--time-file FILE)\n");
+            delete source;
+            return NULL;
+        }
+        if (!readTimes(source->path, &source->times) || source->times.empty()) {
+            printf("Error: no frame times in '%s'\n", source->path.c_str());
+            delete source;
+            return NULL;
+        }
+        printf("Time source: %zu recorded frame times from %s\n", source->times.size(), source->path.c_str());
+    } else if (mode == TIME_SOURCE_FIXED) {
+        printf("Time source: fixed %.6f s steps\n", source->step);
+    }
+    return source;
+}
+
+void destroyTimeSource(TimeSource* source) {
+    if (source->mode == TIME_SOURCE_REAL && !source->path.empty()) {
+        FILE* file = fopen(source->path.c_str(), "w");
+        if (file == NULL) {
+            printf("Error: unable to open '%s'\n", source->path.c_str());
+        } else {
+            fprintf(file, "# frame times (s)\n");
+            for (double time : source->times) {
+                fprintf(file, "%.9f\n", time);
+            }
+            fclose(file);
+            printf("Recorded %zu frame times into %s\n", source->times.size(), source->path.c_str());
+        }
+    }
+
+    delete source;
+}
+
+// Replayed time of a frame, past the end the last interval (or the step) continues.
+static double recordedTime(const TimeSource* source, int frame) {
+    const std::vector<double>& times = source->times;
+    if (frame < (int)times.size()) {
+        return times[frame];
+    }
+
+    size_t last = times.size() - 1;
+    double interval = last > 0 ? times[last] - times[last - 1] : source->step;
+    return times[last] + (frame - (double)last) * interval;
+}
+
+double timeSourceFrameTime(TimeSource* source, int frame, double realTime) {
+    if (frame == source->frame) {
+        return source->time;
+    }
+
+    switch (source->mode) {
+    case TIME_SOURCE_REAL:
+        source->time = realTime;
+        /* A skipped frame did not animate: it keeps the time of the previous frame in the record. */
+        if (!source->path.empty()) {
+            while ((int)source->times.size() <= frame) {
+                source->times.push_back(realTime);
+            }
+        }
+        break;
+    case TIME_SOURCE_FIXED:
+        source->time = frame * source->step;
+        break;
+    default:
+        source->time = recordedTime(source, frame);
+        break;
+    }
+
+    source->frame = frame;
+    return source->time;
+}
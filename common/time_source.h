@@ -0,0 +1,73 @@
+/**
+ * Animation clock of the demos: real, fixed step or recorded time.
+ *
+ * demoAnimationTime (demo_context.h) returns the time of the current frame
+ * from the time source selected by the options of the demo context:
+ *
+ *  --time-source real      The clock (demoGetTime), the default. With
+ *                          "--time-file FILE" the time of every frame is
+ *                          recorded into the file.
+ *  --time-source fixed     Frame N at N * "--time-step" seconds (default: 1/60),
+ *                          "--fixed-time STEP" is the short form.
+ *  --time-source recorded  Replay the times of a "--time-file" recorded by an
+ *                          earlier real run (frame N at its N-th time, past the
+ *                          end the last interval continues).
+ *
+ * The time is sampled once per frame: every call of the frame gets the same
+ * value. With the fixed and recorded sources frame N renders the same content
+ * in every run, with or without vsync, so the runs can be compared (or the
+ * frames cached). The measurements (frame rate, timers) always use the clock.
+ *
+ * Time file: a "#" comment line, then one time (seconds) per line.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_TIME_SOURCE_H
+#define GLES_COMMON_TIME_SOURCE_H
+
+enum TimeSourceMode {
+    TIME_SOURCE_REAL,
+    TIME_SOURCE_FIXED,
+    TIME_SOURCE_RECORDED,
+    TIME_SOURCE_MODE_COUNT,
+};
+
+// "real", "fixed", "recorded": the values of "--time-source".
+extern const char* timeSourceModeNames[TIME_SOURCE_MODE_COUNT];
+
+// The mode of a name. Returns false (and prints the valid names) for an unknown name.
+bool parseTimeSourceMode(const char* name, TimeSourceMode* mode);
+
+struct TimeSource;
+
+// Create the time source: "step" is the fixed step, "path" the time file (NULL: none).
+/* Returns NULL (and prints the error) if the times of a recorded source can not be read. */
+TimeSource* createTimeSource(TimeSourceMode mode, double step, const char* path);
+
+// Write the recorded times (real source with a time file) and delete the time source.
+void destroyTimeSource(TimeSource* source);
+
+// Animation time of the frame: the first call of a frame samples it, the later calls return the same value.
+/* "realTime" is the clock (only used by the real source). */
+double timeSourceFrameTime(TimeSource* source, int frame, double realTime);
+
+#endif // GLES_COMMON_TIME_SOURCE_H
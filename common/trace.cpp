@@ -0,0 +1,359 @@
+/**
+ * CPU and GPU timeline trace. See trace.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/trace.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+// Thread id of the GPU row, the CPU threads are numbered from 1 (the thread which created the trace).
+static const int gpuThreadId = 0;
+
+struct TraceEvent {
+    const char* name;
+    double startUs;
+    double durationUs; // negative: instant event (frame marker)
+    int threadId;
+    int frame;
+};
+
+// A GPU zone: its timestamp queries and the GPU -> CPU clock offset of the frame which issued it.
+struct GpuZone {
+    const char* name;
+    unsigned int queries[2];
+    double offsetUs;
+    int frame;
+};
+
+struct Trace {
+    std::string path;
+    std::chrono::steady_clock::time_point startTime;
+
+    std::mutex mutex; // events and threads
+    std::vector<TraceEvent> events;
+    std::vector<std::thread::id> threads; // index + 1: the thread id of the events
+
+    // GPU zones: GL thread only.
+    bool gpuSupported;
+    double gpuOffsetUs;
+    int frame;
+    std::vector<GpuZone> openGpuZones;
+    std::vector<GpuZone> pendingGpuZones;
+    std::vector<unsigned int> freeQueries;
+    int droppedGpuZones;
+
+    PFNGLGENQUERIESEXTPROC genQueries;
+    PFNGLDELETEQUERIESEXTPROC deleteQueries;
+    PFNGLQUERYCOUNTEREXTPROC queryCounter;
+    PFNGLGETQUERYOBJECTUIVEXTPROC getQueryObjectuiv;
+    PFNGLGETQUERYOBJECTUI64VEXTPROC getQueryObjectui64v;
+};
+
+static std::atomic<Trace*> activeTrace(nullptr);
+
+// Open CPU zones of the thread: name and start time.
+struct OpenZone {
+    const char* name;
+    double startUs;
+};
+static thread_local std::vector<OpenZone> openZones;
+
+static double nowUs(const Trace* trace) {
+    using namespace std::chrono;
+    return duration<double, std::micro>(steady_clock::now() - trace->startTime).count();
+}
+
+static bool hasGLExtension(const char* name) {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int idx = 0; idx < count; idx++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, idx), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool initGpuQueries(Trace* trace) {
+    if (!hasGLExtension("GL_EXT_disjoint_timer_query")) {
+        return false;
+    }
+
+    trace->genQueries = (PFNGLGENQUERIESEXTPROC)eglGetProcAddress("glGenQueriesEXT");
+    trace->deleteQueries = (PFNGLDELETEQUERIESEXTPROC)eglGetProcAddress("glDeleteQueriesEXT");
+    trace->queryCounter = (PFNGLQUERYCOUNTEREXTPROC)eglGetProcAddress("glQueryCounterEXT");
+    trace->getQueryObjectuiv = (PFNGLGETQUERYOBJECTUIVEXTPROC)eglGetProcAddress("glGetQueryObjectuivEXT");
+    trace->getQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VEXTPROC)eglGetProcAddress("glGetQueryObjectui64vEXT");
+    if (!trace->genQueries || !trace->deleteQueries || !trace->queryCounter
+        || !trace->getQueryObjectuiv || !trace->getQueryObjectui64v) {
+        return false;
+    }
+
+    // Timestamps are optional in the extension: zero counter bits means no support.
+    int timestampBits = 0;
+    PFNGLGETQUERYIVEXTPROC getQueryiv = (PFNGLGETQUERYIVEXTPROC)eglGetProcAddress("glGetQueryivEXT");
+    if (getQueryiv) {
+        getQueryiv(GL_TIMESTAMP_EXT, GL_QUERY_COUNTER_BITS_EXT, &timestampBits);
+    }
+    return timestampBits > 0;
+}
+
+// Offset of the GPU clock to the trace clock: the current GPU time and the CPU time at the same moment.
+static void syncGpuClock(Trace* trace) {
+    GLint64 gpuNs = 0;
+    glGetInteger64v(GL_TIMESTAMP_EXT, &gpuNs);
+    trace->gpuOffsetUs = nowUs(trace) - gpuNs / 1000.0;
+}
+
+// Index of the calling thread in the events (the mutex must be locked).
+static int threadId(Trace* trace) {
+    std::thread::id id = std::this_thread::get_id();
+    for (size_t idx = 0; idx < trace->threads.size(); idx++) {
+        if (trace->threads[idx] == id) {
+            return (int)idx + 1;
+        }
+    }
+    trace->threads.push_back(id);
+    return (int)trace->threads.size();
+}
+
+static void addEvent(Trace* trace, const char* name, double startUs, double durationUs, int tid) {
+    std::lock_guard<std::mutex> lock(trace->mutex);
+    TraceEvent event = { name, startUs, durationUs, tid < 0 ? threadId(trace) : tid, trace->frame };
+    trace->events.push_back(event);
+}
+
+// Read back the finished GPU zones (in order), "wait": block for all pending results.
+static void collectGpuZones(Trace* trace, bool wait) {
+    /* A disjoint event (ex.: power state change) invalidates the timestamps in flight. */
+    int disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+
+    size_t done = 0;
+    for (; done < trace->pendingGpuZones.size(); done++) {
+        GpuZone& zone = trace->pendingGpuZones[done];
+
+        GLuint available = 0;
+        trace->getQueryObjectuiv(zone.queries[1], GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+        if (!available && !wait) {
+            break;
+        }
+
+        GLuint64 beginNs = 0;
+        GLuint64 endNs = 0;
+        trace->getQueryObjectui64v(zone.queries[0], GL_QUERY_RESULT_EXT, &beginNs);
+        trace->getQueryObjectui64v(zone.queries[1], GL_QUERY_RESULT_EXT, &endNs);
+        trace->freeQueries.push_back(zone.queries[0]);
+        trace->freeQueries.push_back(zone.queries[1]);
+
+        if (disjoint || endNs < beginNs) {
+            trace->droppedGpuZones++;
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(trace->mutex);
+        TraceEvent event = { zone.name, beginNs / 1000.0 + zone.offsetUs, (endNs - beginNs) / 1000.0, gpuThreadId,
+                             zone.frame };
+        trace->events.push_back(event);
+    }
+    trace->pendingGpuZones.erase(trace->pendingGpuZones.begin(), trace->pendingGpuZones.begin() + done);
+}
+
+Trace* createTrace(const char* path) {
+    Trace* trace = new Trace();
+    trace->path = path;
+    trace->startTime = std::chrono::steady_clock::now();
+    trace->gpuOffsetUs = 0.0;
+    trace->frame = 0;
+    trace->droppedGpuZones = 0;
+    trace->gpuSupported = initGpuQueries(trace);
+    trace->threads.push_back(std::this_thread::get_id());
+
+    if (trace->gpuSupported) {
+        int disjoint;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+        syncGpuClock(trace);
+    } else {
+        printf("Trace: GL_EXT_disjoint_timer_query timestamps are not supported, CPU zones only\n");
+    }
+
+    Trace* expected = nullptr;
+    if (!activeTrace.compare_exchange_strong(expected, trace)) {
+        printf("Trace: a trace is already active\n");
+        delete trace;
+        return NULL;
+    }
+    return trace;
+}
+
+// One event of the trace file: a complete ("X") zone or an instant ("i") frame marker.
+static void writeEvent(FILE* file, const TraceEvent& event) {
+    if (event.durationUs < 0.0) {
+        fprintf(file, "{\"name\":\"frame %d\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+                event.frame, event.startUs, event.threadId);
+    } else {
+        fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d,"
+                      "\"args\":{\"frame\":%d}}",
+                event.name, event.startUs, event.durationUs, event.threadId, event.frame);
+    }
+}
+
+void destroyTrace(Trace* trace) {
+    Trace* expected = trace;
+    activeTrace.compare_exchange_strong(expected, nullptr);
+
+    if (trace->gpuSupported) {
+        glFinish();
+        collectGpuZones(trace, true);
+        for (GpuZone& zone : trace->openGpuZones) {
+            trace->freeQueries.push_back(zone.queries[0]);
+            trace->freeQueries.push_back(zone.queries[1]);
+        }
+        if (!trace->freeQueries.empty()) {
+            trace->deleteQueries((int)trace->freeQueries.size(), trace->freeQueries.data());
+        }
+    }
+
+    FILE* file = fopen(trace->path.c_str(), "w");
+    if (file == NULL) {
+        printf("Trace: unable to open '%s'\n", trace->path.c_str());
+        delete trace;
+        return;
+    }
+
+    // The names of the rows, then the events.
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"GL ES demo\"}},\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"GPU\"}}", gpuThreadId);
+    for (size_t idx = 0; idx < trace->threads.size(); idx++) {
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %zu\"}}",
+                (int)idx + 1, idx == 0 ? "main" : "thread", idx);
+    }
+    for (const TraceEvent& event : trace->events) {
+        fprintf(file, ",\n");
+        writeEvent(file, event);
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    printf("Trace: %zu events of %d frames written to %s", trace->events.size(), trace->frame, trace->path.c_str());
+    if (trace->droppedGpuZones > 0) {
+        printf(" (%d GPU zones dropped: disjoint)", trace->droppedGpuZones);
+    }
+    printf("\n");
+    delete trace;
+}
+
+void traceEndFrame(int frame) {
+    Trace* trace = activeTrace.load();
+    if (trace == NULL) {
+        return;
+    }
+
+    trace->frame = frame;
+    addEvent(trace, NULL, nowUs(trace), -1.0, -1);
+    if (trace->gpuSupported) {
+        collectGpuZones(trace, false);
+        syncGpuClock(trace);
+    }
+    trace->frame = frame + 1;
+}
+
+void traceBeginZone(const char* name) {
+    Trace* trace = activeTrace.load();
+    if (trace == NULL) {
+        return;
+    }
+
+    OpenZone zone = { name, nowUs(trace) };
+    openZones.push_back(zone);
+}
+
+void traceEndZone() {
+    Trace* trace = activeTrace.load();
+    if (trace == NULL || openZones.empty()) {
+        return;
+    }
+
+    OpenZone zone = openZones.back();
+    openZones.pop_back();
+    addEvent(trace, zone.name, zone.startUs, nowUs(trace) - zone.startUs, -1);
+}
+
+void traceBeginGpuZone(const char* name) {
+    Trace* trace = activeTrace.load();
+    if (trace == NULL) {
+        return;
+    }
+
+    traceBeginZone(name);
+    if (!trace->gpuSupported) {
+        return;
+    }
+
+    if (trace->freeQueries.size() < 2) {
+        unsigned int queries[16];
+        trace->genQueries(16, queries);
+        trace->freeQueries.insert(trace->freeQueries.end(), queries, queries + 16);
+    }
+
+    GpuZone zone;
+    zone.name = name;
+    zone.queries[1] = trace->freeQueries.back();
+    trace->freeQueries.pop_back();
+    zone.queries[0] = trace->freeQueries.back();
+    trace->freeQueries.pop_back();
+    zone.offsetUs = trace->gpuOffsetUs;
+    zone.frame = trace->frame;
+
+    trace->queryCounter(zone.queries[0], GL_TIMESTAMP_EXT);
+    trace->openGpuZones.push_back(zone);
+}
+
+void traceEndGpuZone() {
+    Trace* trace = activeTrace.load();
+    if (trace == NULL) {
+        return;
+    }
+
+    if (trace->gpuSupported && !trace->openGpuZones.empty()) {
+        GpuZone zone = trace->openGpuZones.back();
+        trace->openGpuZones.pop_back();
+        trace->queryCounter(zone.queries[1], GL_TIMESTAMP_EXT);
+        trace->pendingGpuZones.push_back(zone);
+    }
+    traceEndZone();
+}
@@ -0,0 +1,95 @@
+/**
+ * CPU and GPU timeline trace in the Chrome trace (JSON) format.
+ *
+ * Enabled by the "--trace FILE" option of the demo context. The trace records
+ * the scoped CPU zones of every thread and the GPU zones on one timeline and
+ * writes them into FILE when the context is destroyed. The file opens in
+ * chrome://tracing or https://ui.perfetto.dev: a bubble shows up as a gap on
+ * the GPU row while the main thread is busy (or the other way around).
+ *
+ *  * CPU zones: TraceZone (or traceBeginZone/traceEndZone) on any thread, the
+ *    demo context adds the "poll events" and "swap" zones of every frame.
+ *  * GPU zones: GL_TIMESTAMP_EXT queries (GL_EXT_disjoint_timer_query) at the
+ *    begin and the end of the zone, also a CPU zone for the submission. Every
+ *    GpuTimer pass (gpu_timer.h) is a GPU zone. The results are read back
+ *    at the end of the frames when they are available, never waited for.
+ *    Nested GPU zones are fine, the zones are only recorded on the GL thread.
+ *  * Frames: an instant event after the swap of every frame (demoSwapBuffers).
+ *
+ * The GPU timestamps are moved onto the CPU clock with the offset of the
+ * GL_TIMESTAMP_EXT value and the CPU time at the end of the frame before
+ * the one which issued them: the error is the latency of the timestamp get
+ * (small on most drivers). Without timestamp support only the CPU zones are
+ * recorded.
+ *
+ * Usage:
+ *
+ *   {
+ *       TraceZone zone("matrix update");
+ *       ...
+ *   }
+ *   {
+ *       TraceGpuZone zone("shadow pass");
+ *       ... draw ...
+ *   }
+ *
+ * The zone names must be string literals (or outlive the trace). Every call
+ * is a no-op without an active trace.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_TRACE_H
+#define GLES_COMMON_TRACE_H
+
+struct Trace;
+
+// Start the trace of the process (the active trace), written into "path" by destroyTrace.
+/* Requires a current GL ES context for the GPU zones. Returns NULL if a trace is already active. */
+Trace* createTrace(const char* path);
+
+// Wait for the pending GPU results, write the trace file and delete the trace.
+void destroyTrace(Trace* trace);
+
+// The frame ended (after the swap): frame marker, read back the available GPU results.
+void traceEndFrame(int frame);
+
+// Start/end a CPU zone on the calling thread.
+void traceBeginZone(const char* name);
+void traceEndZone();
+
+// Start/end a GPU zone (and the CPU zone of its submission) on the GL thread.
+void traceBeginGpuZone(const char* name);
+void traceEndGpuZone();
+
+// Trace the enclosing scope as a CPU zone.
+struct TraceZone {
+    TraceZone(const char* name) { traceBeginZone(name); }
+    ~TraceZone() { traceEndZone(); }
+};
+
+// Trace the enclosing scope as a GPU zone.
+struct TraceGpuZone {
+    TraceGpuZone(const char* name) { traceBeginGpuZone(name); }
+    ~TraceGpuZone() { traceEndGpuZone(); }
+};
+
+#endif // GLES_COMMON_TRACE_H
@@ -0,0 +1,360 @@
+/**
+ * Transform hierarchy. See transform_hierarchy.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/transform_hierarchy.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TRANSFORM_HIERARCHY_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define TRANSFORM_HIERARCHY_NEON 1
+#endif
+
+int addTransformNode(TransformHierarchy* scene, int parent) {
+    if (parent >= scene->count) {
+        return -1;
+    }
+
+    int idx = scene->count++;
+    scene->parents.push_back(parent);
+
+    // Keep the arrays padded: the last group of four is always complete (the padding is an identity transform).
+    size_t padded = (size_t)((scene->count + 3) & ~3);
+    if (scene->translationX.size() < padded) {
+        scene->translationX.resize(padded, 0.0f);
+        scene->translationY.resize(padded, 0.0f);
+        scene->translationZ.resize(padded, 0.0f);
+        scene->rotationX.resize(padded, 0.0f);
+        scene->rotationY.resize(padded, 0.0f);
+        scene->rotationZ.resize(padded, 0.0f);
+        scene->rotationW.resize(padded, 1.0f);
+        scene->scaleX.resize(padded, 1.0f);
+        scene->scaleY.resize(padded, 1.0f);
+        scene->scaleZ.resize(padded, 1.0f);
+        scene->local.resize(padded * 16, 0.0f);
+        scene->world.resize(padded * 16, 0.0f);
+    }
+    return idx;
+}
+
+void setTransformNode(TransformHierarchy* scene, int node, const float translation[3], const float rotation[4], const float scale[3]) {
+    scene->translationX[node] = translation[0];
+    scene->translationY[node] = translation[1];
+    scene->translationZ[node] = translation[2];
+    scene->rotationX[node] = rotation[0];
+    scene->rotationY[node] = rotation[1];
+    scene->rotationZ[node] = rotation[2];
+    scene->rotationW[node] = rotation[3];
+    scene->scaleX[node] = scale[0];
+    scene->scaleY[node] = scale[1];
+    scene->scaleZ[node] = scale[2];
+}
+
+// out = a * b (column major 4x4 matrices).
+static void multiplyMatrixScalar(const float* a, const float* b, float* out) {
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+            out[col * 4 + row] = a[0 * 4 + row] * b[col * 4 + 0] + a[1 * 4 + row] * b[col * 4 + 1] +
+                                 a[2 * 4 + row] * b[col * 4 + 2] + a[3 * 4 + row] * b[col * 4 + 3];
+        }
+    }
+}
+
+void updateTransformHierarchyScalar(TransformHierarchy* scene, const float* viewProjection, float* mvp) {
+    for (int idx = 0; idx < scene->count; idx++) {
+        // 1. Local matrix: translate * rotate * scale.
+        float x = scene->rotationX[idx];
+        float y = scene->rotationY[idx];
+        float z = scene->rotationZ[idx];
+        float w = scene->rotationW[idx];
+        float sx = scene->scaleX[idx];
+        float sy = scene->scaleY[idx];
+        float sz = scene->scaleZ[idx];
+
+        float* m = &scene->local[idx * 16];
+        m[0] = (1.0f - 2.0f * (y * y + z * z)) * sx;
+        m[1] = 2.0f * (x * y + w * z) * sx;
+        m[2] = 2.0f * (x * z - w * y) * sx;
+        m[3] = 0.0f;
+        m[4] = 2.0f * (x * y - w * z) * sy;
+        m[5] = (1.0f - 2.0f * (x * x + z * z)) * sy;
+        m[6] = 2.0f * (y * z + w * x) * sy;
+        m[7] = 0.0f;
+        m[8] = 2.0f * (x * z + w * y) * sz;
+        m[9] = 2.0f * (y * z - w * x) * sz;
+        m[10] = (1.0f - 2.0f * (x * x + y * y)) * sz;
+        m[11] = 0.0f;
+        m[12] = scene->translationX[idx];
+        m[13] = scene->translationY[idx];
+        m[14] = scene->translationZ[idx];
+        m[15] = 1.0f;
+
+        // 2. World matrix: parent world * local (the parent is already done).
+        float* world = &scene->world[idx * 16];
+        int parent = scene->parents[idx];
+        if (parent < 0) {
+            memcpy(world, m, 16 * sizeof(float));
+        } else {
+            multiplyMatrixScalar(&scene->world[parent * 16], m, world);
+        }
+
+        // 3. MVP: view-projection * world.
+        if (mvp) {
+            multiplyMatrixScalar(viewProjection, world, &mvp[idx * 16]);
+        }
+    }
+}
+
+#if TRANSFORM_HIERARCHY_SSE2
+
+// m * v, the columns of "m" are in registers.
+static inline __m128 transformColumn(const __m128 m[4], __m128 v) {
+    __m128 result = _mm_mul_ps(m[0], _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+    result = _mm_add_ps(result, _mm_mul_ps(m[1], _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+    result = _mm_add_ps(result, _mm_mul_ps(m[2], _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+    result = _mm_add_ps(result, _mm_mul_ps(m[3], _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+    return result;
+}
+
+// Store the same column of four nodes: the registers hold the x, y, z, w of the nodes in their lanes.
+static inline void storeColumns(float* matrices, int column, __m128 x, __m128 y, __m128 z, __m128 w) {
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    _mm_storeu_ps(&matrices[0 * 16 + column * 4], x);
+    _mm_storeu_ps(&matrices[1 * 16 + column * 4], y);
+    _mm_storeu_ps(&matrices[2 * 16 + column * 4], z);
+    _mm_storeu_ps(&matrices[3 * 16 + column * 4], w);
+}
+
+void updateTransformHierarchy(TransformHierarchy* scene, const float* viewProjection, float* mvp) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+
+    // 1. Local matrices of four nodes at a time (structure of arrays, lane "i" is the node base + i).
+    for (int base = 0; base < scene->count; base += 4) {
+        __m128 x = _mm_loadu_ps(&scene->rotationX[base]);
+        __m128 y = _mm_loadu_ps(&scene->rotationY[base]);
+        __m128 z = _mm_loadu_ps(&scene->rotationZ[base]);
+        __m128 w = _mm_loadu_ps(&scene->rotationW[base]);
+        __m128 sx = _mm_loadu_ps(&scene->scaleX[base]);
+        __m128 sy = _mm_loadu_ps(&scene->scaleY[base]);
+        __m128 sz = _mm_loadu_ps(&scene->scaleZ[base]);
+
+        __m128 xx = _mm_mul_ps(x, x);
+        __m128 yy = _mm_mul_ps(y, y);
+        __m128 zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y);
+        __m128 xz = _mm_mul_ps(x, z);
+        __m128 yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x);
+        __m128 wy = _mm_mul_ps(w, y);
+        __m128 wz = _mm_mul_ps(w, z);
+
+        float* matrices = &scene->local[base * 16];
+        storeColumns(matrices, 0,
+                     _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+                     _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx),
+                     _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx),
+                     zero);
+        storeColumns(matrices, 1,
+                     _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy),
+                     _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+                     _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy),
+                     zero);
+        storeColumns(matrices, 2,
+                     _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz),
+                     _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz),
+                     _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz),
+                     zero);
+        storeColumns(matrices, 3,
+                     _mm_loadu_ps(&scene->translationX[base]),
+                     _mm_loadu_ps(&scene->translationY[base]),
+                     _mm_loadu_ps(&scene->translationZ[base]),
+                     one);
+    }
+
+    // 2. World and MVP matrices in parent order, the view-projection stays in registers.
+    __m128 viewProjectionColumns[4];
+    for (int col = 0; col < 4; col++) {
+        viewProjectionColumns[col] = _mm_loadu_ps(&viewProjection[col * 4]);
+    }
+
+    for (int idx = 0; idx < scene->count; idx++) {
+        const float* local = &scene->local[idx * 16];
+        float* world = &scene->world[idx * 16];
+        int parent = scene->parents[idx];
+
+        __m128 columns[4];
+        if (parent < 0) {
+            for (int col = 0; col < 4; col++) {
+                columns[col] = _mm_loadu_ps(&local[col * 4]);
+            }
+        } else {
+            __m128 parentColumns[4];
+            for (int col = 0; col < 4; col++) {
+                parentColumns[col] = _mm_loadu_ps(&scene->world[parent * 16 + col * 4]);
+            }
+            for (int col = 0; col < 4; col++) {
+                columns[col] = transformColumn(parentColumns, _mm_loadu_ps(&local[col * 4]));
+            }
+        }
+
+        for (int col = 0; col < 4; col++) {
+            _mm_storeu_ps(&world[col * 4], columns[col]);
+        }
+        if (mvp) {
+            for (int col = 0; col < 4; col++) {
+                _mm_storeu_ps(&mvp[idx * 16 + col * 4], transformColumn(viewProjectionColumns, columns[col]));
+            }
+        }
+    }
+}
+
+const char* transformHierarchyImplementation() {
+    return "SSE2";
+}
+
+#elif TRANSFORM_HIERARCHY_NEON
+
+// m * v, the columns of "m" are in registers.
+static inline float32x4_t transformColumn(const float32x4_t m[4], float32x4_t v) {
+    float32x4_t result = vmulq_n_f32(m[0], vgetq_lane_f32(v, 0));
+    result = vmlaq_n_f32(result, m[1], vgetq_lane_f32(v, 1));
+    result = vmlaq_n_f32(result, m[2], vgetq_lane_f32(v, 2));
+    result = vmlaq_n_f32(result, m[3], vgetq_lane_f32(v, 3));
+    return result;
+}
+
+// Store the same column of four nodes: the registers hold the x, y, z, w of the nodes in their lanes.
+static inline void storeColumns(float* matrices, int column, float32x4_t x, float32x4_t y, float32x4_t z, float32x4_t w) {
+    float32x4x2_t xy = vtrnq_f32(x, y); // x0 y0 x2 y2, x1 y1 x3 y3
+    float32x4x2_t zw = vtrnq_f32(z, w);
+    vst1q_f32(&matrices[0 * 16 + column * 4], vcombine_f32(vget_low_f32(xy.val[0]), vget_low_f32(zw.val[0])));
+    vst1q_f32(&matrices[1 * 16 + column * 4], vcombine_f32(vget_low_f32(xy.val[1]), vget_low_f32(zw.val[1])));
+    vst1q_f32(&matrices[2 * 16 + column * 4], vcombine_f32(vget_high_f32(xy.val[0]), vget_high_f32(zw.val[0])));
+    vst1q_f32(&matrices[3 * 16 + column * 4], vcombine_f32(vget_high_f32(xy.val[1]), vget_high_f32(zw.val[1])));
+}
+
+void updateTransformHierarchy(TransformHierarchy* scene, const float* viewProjection, float* mvp) {
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+
+    // 1. Local matrices of four nodes at a time (structure of arrays, lane "i" is the node base + i).
+    for (int base = 0; base < scene->count; base += 4) {
+        float32x4_t x = vld1q_f32(&scene->rotationX[base]);
+        float32x4_t y = vld1q_f32(&scene->rotationY[base]);
+        float32x4_t z = vld1q_f32(&scene->rotationZ[base]);
+        float32x4_t w = vld1q_f32(&scene->rotationW[base]);
+        float32x4_t sx = vld1q_f32(&scene->scaleX[base]);
+        float32x4_t sy = vld1q_f32(&scene->scaleY[base]);
+        float32x4_t sz = vld1q_f32(&scene->scaleZ[base]);
+
+        float32x4_t xx = vmulq_f32(x, x);
+        float32x4_t yy = vmulq_f32(y, y);
+        float32x4_t zz = vmulq_f32(z, z);
+        float32x4_t xy = vmulq_f32(x, y);
+        float32x4_t xz = vmulq_f32(x, z);
+        float32x4_t yz = vmulq_f32(y, z);
+        float32x4_t wx = vmulq_f32(w, x);
+        float32x4_t wy = vmulq_f32(w, y);
+        float32x4_t wz = vmulq_f32(w, z);
+
+        float* matrices = &scene->local[base * 16];
+        storeColumns(matrices, 0,
+                     vmulq_f32(vmlsq_n_f32(one, vaddq_f32(yy, zz), 2.0f), sx),
+                     vmulq_f32(vmulq_n_f32(vaddq_f32(xy, wz), 2.0f), sx),
+                     vmulq_f32(vmulq_n_f32(vsubq_f32(xz, wy), 2.0f), sx),
+                     zero);
+        storeColumns(matrices, 1,
+                     vmulq_f32(vmulq_n_f32(vsubq_f32(xy, wz), 2.0f), sy),
+                     vmulq_f32(vmlsq_n_f32(one, vaddq_f32(xx, zz), 2.0f), sy),
+                     vmulq_f32(vmulq_n_f32(vaddq_f32(yz, wx), 2.0f), sy),
+                     zero);
+        storeColumns(matrices, 2,
+                     vmulq_f32(vmulq_n_f32(vaddq_f32(xz, wy), 2.0f), sz),
+                     vmulq_f32(vmulq_n_f32(vsubq_f32(yz, wx), 2.0f), sz),
+                     vmulq_f32(vmlsq_n_f32(one, vaddq_f32(xx, yy), 2.0f), sz),
+                     zero);
+        storeColumns(matrices, 3,
+                     vld1q_f32(&scene->translationX[base]),
+                     vld1q_f32(&scene->translationY[base]),
+                     vld1q_f32(&scene->translationZ[base]),
+                     one);
+    }
+
+    // 2. World and MVP matrices in parent order, the view-projection stays in registers.
+    float32x4_t viewProjectionColumns[4];
+    for (int col = 0; col < 4; col++) {
+        viewProjectionColumns[col] = vld1q_f32(&viewProjection[col * 4]);
+    }
+
+    for (int idx = 0; idx < scene->count; idx++) {
+        const float* local = &scene->local[idx * 16];
+        float* world = &scene->world[idx * 16];
+        int parent = scene->parents[idx];
+
+        float32x4_t columns[4];
+        if (parent < 0) {
+            for (int col = 0; col < 4; col++) {
+                columns[col] = vld1q_f32(&local[col * 4]);
+            }
+        } else {
+            float32x4_t parentColumns[4];
+            for (int col = 0; col < 4; col++) {
+                parentColumns[col] = vld1q_f32(&scene->world[parent * 16 + col * 4]);
+            }
+            for (int col = 0; col < 4; col++) {
+                columns[col] = transformColumn(parentColumns, vld1q_f32(&local[col * 4]));
+            }
+        }
+
+        for (int col = 0; col < 4; col++) {
+            vst1q_f32(&world[col * 4], columns[col]);
+        }
+        if (mvp) {
+            for (int col = 0; col < 4; col++) {
+                vst1q_f32(&mvp[idx * 16 + col * 4], transformColumn(viewProjectionColumns, columns[col]));
+            }
+        }
+    }
+}
+
+const char* transformHierarchyImplementation() {
+    return "NEON";
+}
+
+#else
+
+void updateTransformHierarchy(TransformHierarchy* scene, const float* viewProjection, float* mvp) {
+    updateTransformHierarchyScalar(scene, viewProjection, mvp);
+}
+
+const char* transformHierarchyImplementation() {
+    return "scalar";
+}
+
+#endif
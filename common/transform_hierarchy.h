@@ -0,0 +1,98 @@
+/**
+ * Transform hierarchy: world and model-view-projection matrices of a scene graph, four nodes at a time.
+ *
+ * The nodes are stored in a flat array sorted by parent: the parent of a
+ * node always has a lower index, so one pass in index order sees every
+ * world matrix before its children need it. The local transforms
+ * (translation, rotation quaternion, scale) are a structure of arrays
+ * padded to a multiple of four: one SSE (x86) or NEON (ARM) register holds
+ * the same component of four nodes, the local matrices of four nodes are
+ * built at once and transposed into place. The world (parent world * local)
+ * and MVP (view-projection * world) products are register-blocked column
+ * multiplies. Without SSE2/NEON the scalar version is used.
+ *
+ * The MVP matrices can be written straight into a mapped instance buffer and
+ * used as a mat4 attribute: the vertex shader does one matrix multiply
+ * instead of "projection * view * model".
+ *
+ * Usage:
+ *
+ *   TransformHierarchy scene;
+ *   int root = addTransformNode(&scene, -1);
+ *   int child = addTransformNode(&scene, root);
+ *   setTransformNode(&scene, child, translation, rotation, scale);
+ *   while (...) {
+ *       scene.rotationY[child] = ...;                // the local transforms can be animated in place
+ *       updateTransformHierarchy(&scene, viewProjection, mvp); // mvp: 16 floats per node
+ *   }
+ *
+ * Dependencies:
+ *  * C++11
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_TRANSFORM_HIERARCHY_H
+#define GLES_COMMON_TRANSFORM_HIERARCHY_H
+
+#include <vector>
+
+struct TransformHierarchy {
+    // Parent of every node (always a lower index), -1: root.
+    std::vector<int> parents;
+
+    // Local transforms, padded to a multiple of 4 entries. The rotation is a unit quaternion.
+    std::vector<float> translationX;
+    std::vector<float> translationY;
+    std::vector<float> translationZ;
+    std::vector<float> rotationX;
+    std::vector<float> rotationY;
+    std::vector<float> rotationZ;
+    std::vector<float> rotationW;
+    std::vector<float> scaleX;
+    std::vector<float> scaleY;
+    std::vector<float> scaleZ;
+
+    // Column major matrices, 16 floats per node (padded like the local transforms).
+    std::vector<float> local;
+    std::vector<float> world;
+    int count;
+
+    TransformHierarchy() : count(0) {}
+};
+
+// Add a node with an identity local transform, returns its index (-1 if the parent doesn't exist yet).
+int addTransformNode(TransformHierarchy* scene, int parent);
+
+// Set the local transform: translation (xyz), rotation (quaternion xyzw) and scale (xyz).
+void setTransformNode(TransformHierarchy* scene, int node, const float translation[3], const float rotation[4], const float scale[3]);
+
+// Compute the local and world matrix of every node and write view-projection * world into "mvp".
+/* "mvp": 16 floats per node (ex.: a mapped instance buffer), NULL: only the world matrices are updated. */
+void updateTransformHierarchy(TransformHierarchy* scene, const float* viewProjection, float* mvp);
+
+// The reference version of updateTransformHierarchy computing one node and one matrix element at a time.
+void updateTransformHierarchyScalar(TransformHierarchy* scene, const float* viewProjection, float* mvp);
+
+// Name of the instruction set used by updateTransformHierarchy ("SSE2", "NEON" or "scalar").
+const char* transformHierarchyImplementation();
+
+#endif // GLES_COMMON_TRANSFORM_HIERARCHY_H
@@ -0,0 +1,121 @@
+/**
+ * Frame constants in uniform buffer objects, see uniform_ring.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/uniform_ring.h"
+
+#include <string.h>
+
+#include <GLES3/gl3.h>
+
+void initUniformRing(UniformRing* ring, int segmentSize) {
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &ring->alignment);
+    if (ring->alignment <= 0) {
+        ring->alignment = 256;
+    }
+
+    // Every segment starts at an aligned offset.
+    initStreamBuffer(&ring->stream, GL_UNIFORM_BUFFER, (segmentSize + ring->alignment - 1) / ring->alignment * ring->alignment);
+}
+
+void destroyUniformRing(UniformRing* ring) {
+    destroyStreamBuffer(&ring->stream);
+}
+
+void bindConstantBlocks(unsigned int program) {
+    unsigned int frameBlock = glGetUniformBlockIndex(program, "FrameConstants");
+    if (frameBlock != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, frameBlock, FRAME_CONSTANTS_BINDING);
+    }
+
+    unsigned int objectBlock = glGetUniformBlockIndex(program, "ObjectConstants");
+    if (objectBlock != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, objectBlock, OBJECT_CONSTANTS_BINDING);
+    }
+}
+
+void uniformRingBeginFrame(UniformRing* ring) {
+    streamBufferBeginFrame(&ring->stream);
+}
+
+int uniformRingWrite(UniformRing* ring, const void* data, int size) {
+    // Each allocation starts at an aligned offset for glBindBufferRange.
+    int offset;
+    void* dst = streamBufferAllocate(&ring->stream, size, ring->alignment, &offset);
+    if (dst != NULL) {
+        memcpy(dst, data, size);
+    }
+    return offset;
+}
+
+void uniformRingEndFrame(UniformRing* ring) {
+    streamBufferEndFrame(&ring->stream);
+}
+
+void uniformRingBind(UniformRing* ring, unsigned int binding, int offset, int size) {
+    if (offset < 0) {
+        return;
+    }
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, ring->stream.buffer, offset, size);
+}
+
+void initConstantCache(ConstantCache* cache, int size) {
+    glGenBuffers(1, &cache->buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, cache->buffer);
+    glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    cache->size = size;
+    cache->version = 0;
+    cache->valid = false;
+    cache->uploads = 0;
+    cache->skips = 0;
+}
+
+void destroyConstantCache(ConstantCache* cache) {
+    glDeleteBuffers(1, &cache->buffer);
+    cache->buffer = 0;
+}
+
+bool constantCacheStale(ConstantCache* cache, uint32_t version) {
+    if (cache->valid && cache->version == version) {
+        cache->skips++;
+        return false;
+    }
+    return true;
+}
+
+void constantCacheUpload(ConstantCache* cache, uint32_t version, const void* data) {
+    // Rare uploads: the driver synchronizes the sub data with the draws still using the old values.
+    glBindBuffer(GL_UNIFORM_BUFFER, cache->buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, cache->size, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    cache->version = version;
+    cache->valid = true;
+    cache->uploads++;
+}
+
+void constantCacheBind(ConstantCache* cache, unsigned int binding) {
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, cache->buffer);
+}
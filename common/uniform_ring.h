@@ -0,0 +1,156 @@
+/**
+ * Frame constants in std140 uniform buffer objects, sub-allocated from a ring buffer.
+ *
+ * The shaders declare two uniform blocks:
+ *
+ *   layout(std140) uniform FrameConstants {   // binding: FRAME_CONSTANTS_BINDING
+ *       mat4 projection;
+ *       mat4 view;
+ *   };
+ *
+ *   layout(std140) uniform ObjectConstants {  // binding: OBJECT_CONSTANTS_BINDING
+ *       mat4 model;
+ *       vec4 color;
+ *   };
+ *
+ * Every frame the constants of the frame and of each object are written into
+ * one mapped range of a large uniform buffer and each draw only binds its
+ * part via glBindBufferRange. The buffer is a StreamBuffer (see
+ * common/stream_buffer.h): one segment per frame in flight, a fence guards
+ * each segment before it is written again.
+ *
+ * Usage:
+ *
+ *   UniformRing ring;
+ *   initUniformRing(&ring, 64 * 1024);
+ *   bindConstantBlocks(program);
+ *   while (...) {
+ *       uniformRingBeginFrame(&ring);                  // map the next segment
+ *       int frame = uniformRingWrite(&ring, &frameConstants, sizeof(frameConstants));
+ *       int object = uniformRingWrite(&ring, &objectConstants, sizeof(objectConstants));
+ *       uniformRingEndFrame(&ring);                    // unmap, ready for the draws
+ *
+ *       uniformRingBind(&ring, FRAME_CONSTANTS_BINDING, frame, sizeof(frameConstants));
+ *       uniformRingBind(&ring, OBJECT_CONSTANTS_BINDING, object, sizeof(objectConstants));
+ *       ... draw ...
+ *   }
+ *   destroyUniformRing(&ring);
+ *
+ * The constants which rarely change (ex.: a static camera, see
+ * common/camera.h) can live in a ConstantCache instead: a plain uniform
+ * buffer which is only re-uploaded when the version of its inputs differs
+ * from the uploaded one, so the static frames only bind it.
+ *
+ *   ConstantCache frame;
+ *   initConstantCache(&frame, sizeof(FrameConstants));
+ *   while (...) {
+ *       if (constantCacheStale(&frame, camera.version)) {
+ *           constantCacheUpload(&frame, camera.version, &frameConstants);
+ *       }
+ *       constantCacheBind(&frame, FRAME_CONSTANTS_BINDING);
+ *       ... draw ...
+ *   }
+ *   destroyConstantCache(&frame);
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_UNIFORM_RING_H
+#define GLES_COMMON_UNIFORM_RING_H
+
+#include <stdint.h>
+
+#include "common/stream_buffer.h"
+
+#define FRAME_CONSTANTS_BINDING 0
+#define OBJECT_CONSTANTS_BINDING 1
+
+// Number of frames which can be in flight (each has its own segment in the buffer).
+#define UNIFORM_RING_SEGMENTS STREAM_BUFFER_REGIONS
+
+// std140 layout of the "FrameConstants" block (column major matrices).
+struct FrameConstants {
+    float projection[16];
+    float view[16];
+};
+
+// std140 layout of the "ObjectConstants" block.
+struct ObjectConstants {
+    float model[16];
+    float color[4];
+};
+
+struct UniformRing {
+    StreamBuffer stream;
+    int alignment; // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+};
+
+// Create the uniform buffer with UNIFORM_RING_SEGMENTS segments of "segmentSize" bytes.
+void initUniformRing(UniformRing* ring, int segmentSize);
+
+void destroyUniformRing(UniformRing* ring);
+
+// Connect the "FrameConstants" and "ObjectConstants" blocks of the program to their bindings.
+/* A program without one of the blocks is fine. */
+void bindConstantBlocks(unsigned int program);
+
+// Map the next segment (waits only if the GPU still uses it, UNIFORM_RING_SEGMENTS frames later).
+void uniformRingBeginFrame(UniformRing* ring);
+
+// Copy the data into the mapped segment, returns the offset for uniformRingBind (-1 if the segment is full).
+int uniformRingWrite(UniformRing* ring, const void* data, int size);
+
+// Unmap the segment: must be called before the draws which use the written constants.
+void uniformRingEndFrame(UniformRing* ring);
+
+// Bind a written range to a uniform block binding point.
+void uniformRingBind(UniformRing* ring, unsigned int binding, int offset, int size);
+
+struct ConstantCache {
+    unsigned int buffer;
+    int size;
+    uint32_t version; // of the uploaded data
+    bool valid;       // false until the first upload
+
+    // Statistics: the uploads and the stale checks which found the data current.
+    int uploads;
+    int skips;
+};
+
+// Create the uniform buffer of "size" bytes, nothing is uploaded yet.
+void initConstantCache(ConstantCache* cache, int size);
+
+void destroyConstantCache(ConstantCache* cache);
+
+// True if the buffer doesn't hold the data of "version" yet.
+bool constantCacheStale(ConstantCache* cache, uint32_t version);
+
+// Upload "size" bytes (see initConstantCache) and remember the version.
+void constantCacheUpload(ConstantCache* cache, uint32_t version, const void* data);
+
+// Bind the whole buffer to a uniform block binding point.
+void constantCacheBind(ConstantCache* cache, unsigned int binding);
+
+#endif // GLES_COMMON_UNIFORM_RING_H
@@ -0,0 +1,653 @@
+/**
+ * Video output sink. See video_sink.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/video_sink.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <deque>
+#include <vector>
+
+#include <linux/videodev2.h>
+
+#include <GLES3/gl3.h>
+
+#include "common/dmabuf_image.h"
+#include "common/gpu_memory.h"
+
+// Packs the NV12 bytes of the source into RGBA8 texels (see video_sink.h).
+static const char* nv12_vertex_src = R"(#version 300 es
+void main() {
+    gl_Position = vec4(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0, 0.0, 1.0);
+}
+)";
+
+static const char* nv12_fragment_src = R"(#version 300 es
+precision highp float;
+
+uniform sampler2D source;
+uniform int chromaRow; // the first row of the chroma plane
+
+out vec4 outColor;
+
+// BT.709 narrow range.
+vec3 yuv(vec3 rgb) {
+    float y = dot(rgb, vec3(0.2126, 0.7152, 0.0722));
+    return vec3(16.0 + y * 219.0, 128.0 + (rgb.b - y) / 1.8556 * 224.0, 128.0 + (rgb.r - y) / 1.5748 * 224.0) / 255.0;
+}
+
+vec3 pixel(int x, int y) {
+    return texelFetch(source, ivec2(x, y), 0).rgb;
+}
+
+void main() {
+    ivec2 size = textureSize(source, 0);
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    int x = texel.x * 4;
+
+    // The planes are stored top row first, the rows of the source are bottom up.
+    if (texel.y < size.y) {
+        int y = size.y - 1 - texel.y;
+        outColor = vec4(yuv(pixel(x, y)).x, yuv(pixel(x + 1, y)).x, yuv(pixel(x + 2, y)).x, yuv(pixel(x + 3, y)).x);
+    } else if (texel.y >= chromaRow) {
+        int y = size.y - 2 - (texel.y - chromaRow) * 2;
+        vec3 left = (pixel(x, y) + pixel(x + 1, y) + pixel(x, y + 1) + pixel(x + 1, y + 1)) * 0.25;
+        vec3 right = (pixel(x + 2, y) + pixel(x + 3, y) + pixel(x + 2, y + 1) + pixel(x + 3, y + 1)) * 0.25;
+        outColor = vec4(yuv(left).yz, yuv(right).yz);
+    } else {
+        outColor = vec4(0.0); // padding rows of the encoder between the planes
+    }
+}
+)";
+
+// Frames converted on the GPU but not handed to the encoder/file yet (the copy path).
+static const int readbackRingSize = 3;
+
+struct EncoderBuffer {
+    void* mapped;
+    size_t length;
+    bool queued; // owned by the driver
+};
+
+struct VideoSink {
+    void* display;
+    int width;
+    int height;
+    int fps;
+    const char* outputPath;
+    FILE* output;
+
+    // The conversion pass.
+    unsigned int program;
+    int chromaRowLoc;
+
+    // Copy path: the packed frame and the readback ring.
+    unsigned int packedTexture;
+    unsigned int packedFbo;
+    unsigned int pbos[readbackRingSize];
+
+    // V4L2 encoder (-1: raw NV12 file) and the NV12 layout of its input buffers.
+    int device;
+    int bytesPerLine;
+    int layoutHeight;
+    std::vector<EncoderBuffer> inputs;
+    std::vector<EncoderBuffer> outputs;
+
+    // Zero-copy path: the input buffers of the encoder as render targets.
+    bool zeroCopy;
+    std::vector<DmaBufRenderTarget> inputTargets;
+
+    // The converted frames in submit order (slot: the PBO or the encoder input buffer).
+    struct Pending {
+        int slot;
+        GLsync fence;
+    };
+    std::deque<Pending> pending;
+    int nextSlot;
+
+    int submitted;
+    int queuedToEncoder;
+    size_t outputBytes;
+    double copySeconds;
+};
+
+static int xioctl(int fd, unsigned long request, void* arg) {
+    int result;
+    do {
+        result = ioctl(fd, request, arg);
+    } while (result < 0 && errno == EINTR);
+    return result;
+}
+
+// V. The encoder.
+
+// Dequeue a finished buffer of the queue without blocking. Returns false if none is ready.
+static bool dequeueBuffer(VideoSink* sink, uint32_t type, uint32_t* index, uint32_t* bytesUsed, uint32_t* flags) {
+    struct v4l2_plane plane;
+    struct v4l2_buffer buffer;
+    memset(&plane, 0, sizeof(plane));
+    memset(&buffer, 0, sizeof(buffer));
+    buffer.type = type;
+    buffer.memory = V4L2_MEMORY_MMAP;
+    buffer.m.planes = &plane;
+    buffer.length = 1;
+    if (xioctl(sink->device, VIDIOC_DQBUF, &buffer) < 0) {
+        return false;
+    }
+    *index = buffer.index;
+    *bytesUsed = plane.bytesused;
+    *flags = buffer.flags;
+    return true;
+}
+
+static bool queueBuffer(VideoSink* sink, uint32_t type, uint32_t index, uint32_t bytesUsed) {
+    std::vector<EncoderBuffer>& buffers = type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE ? sink->inputs : sink->outputs;
+
+    struct v4l2_plane plane;
+    struct v4l2_buffer buffer;
+    memset(&plane, 0, sizeof(plane));
+    memset(&buffer, 0, sizeof(buffer));
+    buffer.type = type;
+    buffer.memory = V4L2_MEMORY_MMAP;
+    buffer.index = index;
+    buffer.m.planes = &plane;
+    buffer.length = 1;
+    buffer.field = V4L2_FIELD_NONE;
+    plane.bytesused = bytesUsed;
+    plane.length = buffers[index].length;
+    if (type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) {
+        long long usec = (long long)sink->queuedToEncoder * 1000000 / sink->fps;
+        buffer.timestamp.tv_sec = usec / 1000000;
+        buffer.timestamp.tv_usec = usec % 1000000;
+    }
+    if (xioctl(sink->device, VIDIOC_QBUF, &buffer) < 0) {
+        printf("Video sink: VIDIOC_QBUF failed: %s\n", strerror(errno));
+        return false;
+    }
+    buffers[index].queued = true;
+    return true;
+}
+
+// Collect the encoded packets and the consumed input buffers. Returns true once the last packet arrived.
+static bool drainEncoder(VideoSink* sink) {
+    uint32_t index;
+    uint32_t bytesUsed;
+    uint32_t flags;
+    bool last = false;
+    while (dequeueBuffer(sink, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, &index, &bytesUsed, &flags)) {
+        fwrite(sink->outputs[index].mapped, 1, bytesUsed, sink->output);
+        sink->outputBytes += bytesUsed;
+        sink->outputs[index].queued = false;
+        last = (flags & V4L2_BUF_FLAG_LAST) != 0;
+        if (!last) {
+            queueBuffer(sink, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, index, 0);
+        }
+    }
+    while (dequeueBuffer(sink, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, &index, &bytesUsed, &flags)) {
+        sink->inputs[index].queued = false;
+    }
+    return last;
+}
+
+// Wait until the encoder has a free input buffer (or "slot" is free). Returns the index, -1 on timeout.
+static int waitEncoderInput(VideoSink* sink, int slot) {
+    for (int attempt = 0; attempt < 100; attempt++) {
+        drainEncoder(sink);
+        for (size_t idx = 0; idx < sink->inputs.size(); idx++) {
+            if (!sink->inputs[idx].queued && (slot < 0 || (int)idx == slot)) {
+                return (int)idx;
+            }
+        }
+        struct pollfd pollFd = { sink->device, POLLIN | POLLOUT, 0 };
+        poll(&pollFd, 1, 100);
+    }
+    printf("Video sink: the encoder does not return the input buffers\n");
+    return -1;
+}
+
+static bool mapBuffers(VideoSink* sink, uint32_t type, std::vector<EncoderBuffer>* buffers, int count) {
+    struct v4l2_requestbuffers request;
+    memset(&request, 0, sizeof(request));
+    request.count = count;
+    request.type = type;
+    request.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(sink->device, VIDIOC_REQBUFS, &request) < 0 || request.count == 0) {
+        return false;
+    }
+
+    buffers->resize(request.count);
+    for (uint32_t idx = 0; idx < request.count; idx++) {
+        struct v4l2_plane plane;
+        struct v4l2_buffer buffer;
+        memset(&plane, 0, sizeof(plane));
+        memset(&buffer, 0, sizeof(buffer));
+        buffer.type = type;
+        buffer.memory = V4L2_MEMORY_MMAP;
+        buffer.index = idx;
+        buffer.m.planes = &plane;
+        buffer.length = 1;
+        if (xioctl(sink->device, VIDIOC_QUERYBUF, &buffer) < 0) {
+            return false;
+        }
+
+        void* mapped = mmap(NULL, plane.length, PROT_READ | PROT_WRITE, MAP_SHARED, sink->device, plane.m.mem_offset);
+        (*buffers)[idx].mapped = mapped != MAP_FAILED ? mapped : NULL;
+        (*buffers)[idx].length = plane.length;
+        (*buffers)[idx].queued = false;
+        if ((*buffers)[idx].mapped == NULL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// V.1. Configure the encoder: H.264 packets out of NV12 frames, the rate and the buffers of both queues.
+static bool openEncoder(VideoSink* sink, const char* path, int bitrate) {
+    sink->device = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (sink->device < 0) {
+        printf("Video sink: can not open '%s'\n", path);
+        return false;
+    }
+
+    struct v4l2_capability capability;
+    memset(&capability, 0, sizeof(capability));
+    uint32_t caps = 0;
+    if (xioctl(sink->device, VIDIOC_QUERYCAP, &capability) == 0) {
+        caps = (capability.capabilities & V4L2_CAP_DEVICE_CAPS) ? capability.device_caps : capability.capabilities;
+    }
+    if ((caps & V4L2_CAP_VIDEO_M2M_MPLANE) == 0 || (caps & V4L2_CAP_STREAMING) == 0) {
+        printf("Video sink: '%s' is not a multi-planar memory-to-memory device\n", path);
+        return false;
+    }
+
+    struct v4l2_format format;
+    memset(&format, 0, sizeof(format));
+    format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    format.fmt.pix_mp.width = sink->width;
+    format.fmt.pix_mp.height = sink->height;
+    format.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_H264;
+    format.fmt.pix_mp.num_planes = 1;
+    format.fmt.pix_mp.plane_fmt[0].sizeimage = sink->width * sink->height;
+    if (xioctl(sink->device, VIDIOC_S_FMT, &format) < 0 || format.fmt.pix_mp.pixelformat != V4L2_PIX_FMT_H264) {
+        printf("Video sink: '%s' can not encode H.264\n", path);
+        return false;
+    }
+
+    /* The contiguous NV12 layout: the chroma plane follows the luma plane in the same buffer. */
+    memset(&format, 0, sizeof(format));
+    format.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+    format.fmt.pix_mp.width = sink->width;
+    format.fmt.pix_mp.height = sink->height;
+    format.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_NV12;
+    format.fmt.pix_mp.num_planes = 1;
+    if (xioctl(sink->device, VIDIOC_S_FMT, &format) < 0 || format.fmt.pix_mp.pixelformat != V4L2_PIX_FMT_NV12 ||
+        format.fmt.pix_mp.num_planes != 1) {
+        printf("Video sink: '%s' does not take contiguous NV12 frames\n", path);
+        return false;
+    }
+    sink->bytesPerLine = format.fmt.pix_mp.plane_fmt[0].bytesperline;
+    sink->layoutHeight = format.fmt.pix_mp.height;
+
+    struct v4l2_streamparm rate;
+    memset(&rate, 0, sizeof(rate));
+    rate.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+    rate.parm.output.timeperframe.numerator = 1;
+    rate.parm.output.timeperframe.denominator = sink->fps;
+    xioctl(sink->device, VIDIOC_S_PARM, &rate);
+
+    struct v4l2_ext_control control;
+    struct v4l2_ext_controls controls;
+    memset(&control, 0, sizeof(control));
+    memset(&controls, 0, sizeof(controls));
+    control.id = V4L2_CID_MPEG_VIDEO_BITRATE;
+    control.value = bitrate;
+    controls.ctrl_class = V4L2_CTRL_CLASS_MPEG;
+    controls.count = 1;
+    controls.controls = &control;
+    if (xioctl(sink->device, VIDIOC_S_EXT_CTRLS, &controls) < 0) {
+        printf("Video sink: the bitrate can not be set, using the default of the encoder\n");
+    }
+
+    if (!mapBuffers(sink, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, &sink->inputs, 4) ||
+        !mapBuffers(sink, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, &sink->outputs, 4)) {
+        printf("Video sink: the buffers of '%s' can not be mapped\n", path);
+        return false;
+    }
+    size_t frameBytes = (size_t)sink->bytesPerLine * (sink->layoutHeight + sink->height / 2);
+    if (sink->inputs[0].length < frameBytes) {
+        printf("Video sink: the input buffers of '%s' are too small\n", path);
+        return false;
+    }
+
+    // V.2. Hand every packet buffer to the encoder and start both queues.
+    for (size_t idx = 0; idx < sink->outputs.size(); idx++) {
+        if (!queueBuffer(sink, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, idx, 0)) {
+            return false;
+        }
+    }
+    int types[2] = { V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE };
+    for (int type : types) {
+        if (xioctl(sink->device, VIDIOC_STREAMON, &type) < 0) {
+            printf("Video sink: VIDIOC_STREAMON failed: %s\n", strerror(errno));
+            return false;
+        }
+    }
+    return true;
+}
+
+// V.3. Zero-copy: export the input buffers of the encoder and render into them.
+static bool importEncoderInputs(VideoSink* sink) {
+    if (!dmaBufImportSupported(sink->display, DMABUF_ABGR8888)) {
+        return false;
+    }
+
+    sink->inputTargets.resize(sink->inputs.size());
+    auto release = [sink](size_t count) {
+        for (size_t idx = 0; idx < count; idx++) {
+            destroyDmaBufRenderTarget(&sink->inputTargets[idx]);
+        }
+        sink->inputTargets.clear();
+        return false;
+    };
+    for (size_t idx = 0; idx < sink->inputs.size(); idx++) {
+        struct v4l2_exportbuffer exported;
+        memset(&exported, 0, sizeof(exported));
+        exported.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+        exported.index = idx;
+        exported.plane = 0;
+        exported.flags = O_CLOEXEC | O_RDWR;
+        if (xioctl(sink->device, VIDIOC_EXPBUF, &exported) < 0) {
+            return release(idx);
+        }
+
+        /* The whole NV12 buffer as one RGBA8 image of width/4 texels: the luma rows, the padding, the chroma rows. */
+        DmaBufFrame frame;
+        frame.width = sink->width / 4;
+        frame.height = sink->layoutHeight + sink->height / 2;
+        frame.format = DMABUF_ABGR8888;
+        frame.modifier = DMABUF_MODIFIER_INVALID;
+        frame.planeCount = 1;
+        frame.planes[0] = { exported.fd, 0, (uint32_t)sink->bytesPerLine };
+        if (!importDmaBufRenderTarget(sink->display, frame, &sink->inputTargets[idx])) {
+            return release(idx + 1);
+        }
+    }
+    return true;
+}
+
+static unsigned int createConversionProgram() {
+    unsigned int shaders[2] = { glCreateShader(GL_VERTEX_SHADER), glCreateShader(GL_FRAGMENT_SHADER) };
+    glShaderSource(shaders[0], 1, &nv12_vertex_src, NULL);
+    glShaderSource(shaders[1], 1, &nv12_fragment_src, NULL);
+    unsigned int program = glCreateProgram();
+    for (unsigned int shader : shaders) {
+        glCompileShader(shader);
+        glAttachShader(program, shader);
+        glDeleteShader(shader);
+    }
+    glLinkProgram(program);
+
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char info[512];
+        glGetProgramInfoLog(program, 512, NULL, info);
+        printf("Video sink: NV12 program error:\n%s\n", info);
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+VideoSink* createVideoSink(void* display, const char* outputPath, const char* device, int width, int height,
+                           int fps, int bitrate) {
+    if (width % 4 != 0 || height % 2 != 0) {
+        printf("Video sink: the frame size must be a multiple of 4x2 (%dx%d)\n", width, height);
+        return NULL;
+    }
+
+    VideoSink* sink = new VideoSink();
+    sink->display = display;
+    sink->width = width;
+    sink->height = height;
+    sink->fps = fps > 0 ? fps : 60;
+    sink->outputPath = outputPath;
+    sink->device = -1;
+    sink->bytesPerLine = width;
+    sink->layoutHeight = height;
+    sink->zeroCopy = false;
+    sink->nextSlot = 0;
+    sink->submitted = 0;
+    sink->queuedToEncoder = 0;
+    sink->outputBytes = 0;
+    sink->copySeconds = 0.0;
+
+    // C.1. The output file and the encoder.
+    sink->output = fopen(outputPath, "wb");
+    sink->program = createConversionProgram();
+    bool ready = sink->output != NULL && sink->program != 0;
+    if (sink->output == NULL) {
+        printf("Video sink: can not create '%s'\n", outputPath);
+    }
+    if (ready && device != NULL) {
+        ready = openEncoder(sink, device, bitrate);
+        sink->zeroCopy = ready && importEncoderInputs(sink);
+    }
+    if (!ready) {
+        destroyVideoSink(sink);
+        return NULL;
+    }
+    sink->chromaRowLoc = glGetUniformLocation(sink->program, "chromaRow");
+    glUseProgram(sink->program);
+    glUniform1i(glGetUniformLocation(sink->program, "source"), 0);
+    glUseProgram(0);
+
+    // C.2. Copy path: the packed frame in an own texture, read back through the PBO ring.
+    if (!sink->zeroCopy) {
+        int packedHeight = height + height / 2;
+        glGenTextures(1, &sink->packedTexture);
+        glBindTexture(GL_TEXTURE_2D, sink->packedTexture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width / 4, packedHeight);
+        gpuMemoryTrackTexture(sink->packedTexture, GL_RGBA8, width / 4, packedHeight, 1, 1, GPU_MEMORY_RENDER_TARGET,
+                              "video sink NV12");
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &sink->packedFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, sink->packedFbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sink->packedTexture, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glGenBuffers(readbackRingSize, sink->pbos);
+        for (int idx = 0; idx < readbackRingSize; idx++) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, sink->pbos[idx]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)width * packedHeight, NULL, GL_STREAM_READ);
+            gpuMemoryTrackBuffer(sink->pbos[idx], (size_t)width * packedHeight, GPU_MEMORY_TRANSFER,
+                                 "video sink readback");
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    printf("Video sink: %dx%d at %d fps into '%s' (%s, %s)\n", width, height, sink->fps, outputPath,
+           device != NULL ? "V4L2 H.264" : "raw NV12",
+           sink->zeroCopy ? "zero-copy dma-buf input" : "GPU conversion + PBO copy");
+    return sink;
+}
+
+// P.1. The oldest converted frame is finished: hand it to the encoder or write it out.
+static void completeOldest(VideoSink* sink) {
+    VideoSink::Pending frame = sink->pending.front();
+    sink->pending.pop_front();
+    glClientWaitSync(frame.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    glDeleteSync(frame.fence);
+
+    size_t frameBytes = (size_t)sink->bytesPerLine * (sink->layoutHeight + sink->height / 2);
+    if (sink->zeroCopy) {
+        if (queueBuffer(sink, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, frame.slot, frameBytes)) {
+            sink->queuedToEncoder++;
+        }
+        drainEncoder(sink);
+        return;
+    }
+
+    // P.2. The copy path: the rows of the packed frame into the file or into a free input buffer of the encoder.
+    auto start = std::chrono::steady_clock::now();
+    size_t packedBytes = (size_t)sink->width * (sink->height + sink->height / 2);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, sink->pbos[frame.slot]);
+    const uint8_t* packed = (const uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, packedBytes, GL_MAP_READ_BIT);
+    if (packed != NULL) {
+        if (sink->device < 0) {
+            fwrite(packed, 1, packedBytes, sink->output);
+            sink->outputBytes += packedBytes;
+        } else {
+            int input = waitEncoderInput(sink, -1);
+            if (input >= 0) {
+                uint8_t* dst = (uint8_t*)sink->inputs[input].mapped;
+                for (int row = 0; row < sink->height; row++) {
+                    memcpy(dst + (size_t)row * sink->bytesPerLine, packed + (size_t)row * sink->width, sink->width);
+                }
+                uint8_t* chroma = dst + (size_t)sink->bytesPerLine * sink->layoutHeight;
+                const uint8_t* packedChroma = packed + (size_t)sink->width * sink->height;
+                for (int row = 0; row < sink->height / 2; row++) {
+                    memcpy(chroma + (size_t)row * sink->bytesPerLine, packedChroma + (size_t)row * sink->width,
+                           sink->width);
+                }
+                if (queueBuffer(sink, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, input, frameBytes)) {
+                    sink->queuedToEncoder++;
+                }
+            }
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    sink->copySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (sink->device >= 0) {
+        drainEncoder(sink);
+    }
+}
+
+void videoSinkSubmit(VideoSink* sink, unsigned int texture) {
+    // S.1. A free slot: the oldest frame is completed once every slot is in flight.
+    int ringSize = sink->zeroCopy ? (int)sink->inputTargets.size() : readbackRingSize;
+    if ((int)sink->pending.size() >= ringSize) {
+        completeOldest(sink);
+    }
+    int slot = sink->nextSlot;
+    sink->nextSlot = (sink->nextSlot + 1) % ringSize;
+    if (sink->zeroCopy && waitEncoderInput(sink, slot) < 0) {
+        return;
+    }
+
+    // S.2. The conversion pass into the encoder buffer or the own packed frame.
+    glBindFramebuffer(GL_FRAMEBUFFER, sink->zeroCopy ? sink->inputTargets[slot].fbo : sink->packedFbo);
+    glViewport(0, 0, sink->width / 4, sink->layoutHeight + sink->height / 2);
+    glUseProgram(sink->program);
+    glUniform1i(sink->chromaRowLoc, sink->layoutHeight);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // S.3. Copy path: start the read back of the packed frame (returns without waiting).
+    if (!sink->zeroCopy) {
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, sink->pbos[slot]);
+        glReadPixels(0, 0, sink->width / 4, sink->height + sink->height / 2, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    sink->pending.push_back({ slot, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+    sink->submitted++;
+}
+
+void destroyVideoSink(VideoSink* sink) {
+    // D.1. The frames still on the GPU.
+    while (!sink->pending.empty()) {
+        completeOldest(sink);
+    }
+
+    // D.2. Drain the encoder: the stop command flags the last packet.
+    if (sink->device >= 0 && !sink->outputs.empty()) {
+        struct v4l2_encoder_cmd command;
+        memset(&command, 0, sizeof(command));
+        command.cmd = V4L2_ENC_CMD_STOP;
+        bool stopped = xioctl(sink->device, VIDIOC_ENCODER_CMD, &command) == 0;
+        for (int attempt = 0; stopped && attempt < 50; attempt++) {
+            if (drainEncoder(sink)) {
+                break;
+            }
+            struct pollfd pollFd = { sink->device, POLLIN, 0 };
+            poll(&pollFd, 1, 100);
+        }
+
+        int types[2] = { V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE };
+        for (int type : types) {
+            xioctl(sink->device, VIDIOC_STREAMOFF, &type);
+        }
+    }
+
+    if (sink->submitted > 0) {
+        printf("Video sink: %d frames, %zu bytes written to '%s', CPU copy: %.3f ms/frame\n", sink->submitted,
+               sink->outputBytes, sink->outputPath, sink->copySeconds * 1000.0 / sink->submitted);
+    }
+
+    // D.3. Release the GL objects, the mappings and the device.
+    for (DmaBufRenderTarget& target : sink->inputTargets) {
+        destroyDmaBufRenderTarget(&target);
+    }
+    if (sink->packedFbo != 0) {
+        glDeleteFramebuffers(1, &sink->packedFbo);
+        glDeleteTextures(1, &sink->packedTexture);
+        glDeleteBuffers(readbackRingSize, sink->pbos);
+        gpuMemoryReleaseTextures(1, &sink->packedTexture);
+        gpuMemoryReleaseBuffers(readbackRingSize, sink->pbos);
+    }
+    glDeleteProgram(sink->program);
+
+    for (const EncoderBuffer& buffer : sink->inputs) {
+        if (buffer.mapped != NULL) {
+            munmap(buffer.mapped, buffer.length);
+        }
+    }
+    for (const EncoderBuffer& buffer : sink->outputs) {
+        if (buffer.mapped != NULL) {
+            munmap(buffer.mapped, buffer.length);
+        }
+    }
+    if (sink->device >= 0) {
+        close(sink->device);
+    }
+    if (sink->output != NULL) {
+        fclose(sink->output);
+    }
+    delete sink;
+}
@@ -0,0 +1,69 @@
+/**
+ * Video output sink of the offscreen renderer: GPU RGB -> NV12 conversion and a
+ * V4L2 memory-to-memory hardware encoder (H.264) or a raw NV12 file.
+ *
+ * A pass packs the NV12 bytes of a frame into an RGBA8 target of width/4 x height*3/2
+ * texels: the rows of the luma plane (4 Y values per texel) followed by the rows of the
+ * half resolution interleaved chroma plane (U0 V0 U1 V1 per texel, BT.709 narrow range).
+ * The target is the memory of the encoder: the input buffers of the encoder are exported
+ * (VIDIOC_EXPBUF) and imported as GL render targets (see dmabuf_image.h), so no CPU touches
+ * a pixel. Without the dma-buf import the packed frame is read back through a ring of
+ * PBOs and copied into the encoder buffer (1.5 bytes per pixel instead of 4):
+ *
+ *   VideoSink* sink = createVideoSink("out.h264", "/dev/video11", width, height, 60, 8000000);
+ *   for every frame:
+ *       render into "texture" (RGBA, the size of the sink)
+ *       videoSinkSubmit(sink, texture);
+ *   destroyVideoSink(sink); // drains the encoder
+ *
+ * Without a device the frames are written to the output file as raw NV12
+ * (ex.: ffplay -f rawvideo -pixel_format nv12 -video_size WxH out.nv12).
+ * The conversion and the encoding run asynchronously, a few frames behind the rendering.
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+
+ *  * EGL (dma-buf import for the zero-copy path, see dmabuf_image.h)
+ *  * Linux V4L2 (a stateful M2M encoder with the contiguous NV12 input format)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_VIDEO_SINK_H
+#define GLES_COMMON_VIDEO_SINK_H
+
+struct VideoSink;
+
+// Open the encoder "device" (NULL: raw NV12 output) and the output file.
+/* The width must be a multiple of 4 and the height a multiple of 2. Needs a current context,
+ * "display" is its EGLDisplay (the dma-buf import of the encoder buffers). Returns NULL on error. */
+VideoSink* createVideoSink(void* display, const char* outputPath, const char* device, int width, int height,
+                           int fps, int bitrate);
+
+// Convert the frame in "texture" (RGBA, the size of the sink) and queue it for the encoder.
+/* Blocks only when every buffer of the ring is still in use. Changes the framebuffer binding,
+ * the viewport, the program and the texture of the active texture unit. */
+void videoSinkSubmit(VideoSink* sink, unsigned int texture);
+
+// Encode the queued frames, close the output and print the frame count, size and CPU copy cost.
+void destroyVideoSink(VideoSink* sink);
+
+#endif // GLES_COMMON_VIDEO_SINK_H
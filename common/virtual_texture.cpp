@@ -0,0 +1,656 @@
+/**
+ * Virtual texturing: tile streaming into a physical cache texture.
+ * See virtual_texture.h for the details.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "common/virtual_texture.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <GLES3/gl3.h>
+
+#include "common/gpu_memory.h"
+
+// Feedback images in flight (read backs which are not parsed yet).
+#define VT_READBACK_RING 3
+
+const char* virtualTextureSamplingSrc = R"(
+uniform highp sampler2D vtPhysical;
+uniform highp sampler2D vtPageTable;
+// x: tiles per side at level 0, y: the coarsest level, z: 1 / physical texture size, w: level bias
+uniform highp vec4 vtParams;
+// The image in the level 0 tiles (the rest of the last row/column is padding)
+uniform highp vec2 vtImageScale;
+
+// Same as the GL_NEAREST_MIPMAP_* level selection.
+int virtualTextureLevel(highp vec2 vuv) {
+    highp vec2 texel = vuv * (vtParams.x * 120.0);
+    highp vec2 dx = dFdx(texel);
+    highp vec2 dy = dFdy(texel);
+    highp float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + vtParams.w;
+    return int(clamp(floor(lod + 0.5), 0.0, vtParams.y));
+}
+
+ivec2 virtualTextureTile(highp vec2 vuv, int level) {
+    int side = int(vtParams.x) >> level;
+    return clamp(ivec2(vuv * float(side)), ivec2(0), ivec2(side - 1));
+}
+
+vec4 sampleVirtualTexture(highp vec2 uv) {
+    highp vec2 vuv = uv * vtImageScale;
+    int level = virtualTextureLevel(vuv);
+    ivec2 tile = virtualTextureTile(vuv, level);
+
+    // Slot and level of the finest resident tile
+    highp vec3 entry = floor(texelFetch(vtPageTable, tile, level).xyz * 255.0 + 0.5);
+    int mapped = int(entry.z);
+    highp vec2 inTile = vuv * float(int(vtParams.x) >> mapped) - vec2(tile >> (mapped - level));
+    highp vec2 texel = entry.xy * 128.0 + 4.0 + clamp(inTile, 0.0, 1.0) * 120.0;
+    return texture(vtPhysical, texel * vtParams.z);
+}
+
+vec4 virtualTextureFeedback(highp vec2 uv) {
+    highp vec2 vuv = uv * vtImageScale;
+    int level = virtualTextureLevel(vuv);
+    return vec4(vec2(virtualTextureTile(vuv, level)), float(level), 255.0) / 255.0;
+}
+)";
+
+struct StreamedTile {
+    uint32_t tile;
+    std::vector<uint8_t> pixels;
+};
+
+struct VirtualTexture {
+    VirtualTextureHeader header;
+    const uint8_t* data; // the mapped file
+    size_t size;
+    const uint64_t* offsets;
+    std::vector<uint32_t> levelFirst; // index of the first tile of every level
+
+    int cacheTiles; // per side
+    int feedbackScale;
+    int uploadBudget;
+
+    GLuint physical;
+    GLuint pageTable;
+    std::vector<uint8_t> pageEntries; // RGBA8 of every tile: the slot x, y and the mapped level
+
+    // Feedback target and its read back.
+    GLuint feedbackFbo;
+    GLuint feedbackColor;
+    GLuint feedbackDepth;
+    int feedbackWidth;
+    int feedbackHeight;
+    GLuint pbo[VT_READBACK_RING];
+    GLsync fence[VT_READBACK_RING];
+    int pboWidth[VT_READBACK_RING];
+    int pboHeight[VT_READBACK_RING];
+    int writeCount;
+    int readCount;
+    GLint savedFbo;
+    GLint savedViewport[4];
+
+    // Cache state, only used by the render thread.
+    std::vector<int> tileSlot;        // slot or -1
+    std::vector<uint8_t> tilePending; // queued, streaming or streamed but not uploaded
+    std::vector<uint32_t> tileSeen;   // frame of the last feedback which had the tile
+    std::vector<int> slotTile;        // tile or -1
+    std::vector<uint32_t> slotUsed;   // frame of the last feedback which used the slot
+    uint32_t frame;
+    uint32_t feedbackFrame;
+    bool pageTableDirty;
+
+    // Streaming thread.
+    std::thread streamer;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool quit;
+    std::deque<uint32_t> requests;
+    std::deque<StreamedTile> ready;
+
+    // Statistics.
+    uint64_t streamedCount;
+    uint64_t evictedCount;
+    uint64_t droppedCount;
+    uint64_t hitCount;
+    uint64_t missCount;
+    uint64_t feedbackCount;
+};
+
+static bool mapTileFile(VirtualTexture* vt, const char* path) {
+    // 1. Map the whole file: the tiles are paged in by the streaming thread when they are copied.
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("Virtual texture: unable to open '%s'\n", path);
+        return false;
+    }
+
+    struct stat info;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("Virtual texture: unable to map '%s'\n", path);
+        return false;
+    }
+
+    // 2. The tiles are read in the order of the view: no read ahead of the neighbour pages.
+    madvise(data, info.st_size, MADV_RANDOM);
+
+    vt->data = (const uint8_t*)data;
+    vt->size = info.st_size;
+
+    // 3. Check the header and that every tile is inside the file.
+    const VirtualTextureHeader* header = (const VirtualTextureHeader*)vt->data;
+    bool valid = vt->size >= sizeof(VirtualTextureHeader)
+              && memcmp(header->magic, VIRTUAL_TEXTURE_MAGIC, sizeof(header->magic)) == 0
+              && header->version == VIRTUAL_TEXTURE_VERSION
+              && header->levelCount >= 1 && header->levelCount <= VT_MAX_LEVELS
+              && header->tiles == 1u << (header->levelCount - 1)
+              && header->tileCount == virtualTextureTileIndex(*header, header->levelCount - 1, 0, 0) + 1
+              && sizeof(VirtualTextureHeader) + (size_t)header->tileCount * sizeof(uint64_t) <= vt->size;
+
+    if (valid) {
+        vt->header = *header;
+        vt->offsets = (const uint64_t*)(vt->data + sizeof(VirtualTextureHeader));
+
+        for (uint32_t idx = 0; idx < header->tileCount && valid; idx++) {
+            uint64_t offset = vt->offsets[idx];
+            valid = offset % VT_TILE_BYTES == 0 && offset <= vt->size && VT_TILE_BYTES <= vt->size - offset;
+        }
+        valid = valid && vt->offsets[header->tileCount - 1] != 0;
+    }
+
+    if (!valid) {
+        printf("Virtual texture: '%s' is not a valid (version %d) tile file\n", path, VIRTUAL_TEXTURE_VERSION);
+        munmap((void*)vt->data, vt->size);
+        vt->data = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+static void copyTile(const VirtualTexture* vt, uint32_t tile, uint8_t* dst) {
+    uint64_t offset = vt->offsets[tile];
+    if (offset == 0) {
+        memset(dst, 0, VT_TILE_BYTES);
+    } else {
+        memcpy(dst, vt->data + offset, VT_TILE_BYTES);
+    }
+}
+
+static void streamTiles(VirtualTexture* vt) {
+    std::unique_lock<std::mutex> lock(vt->mutex);
+    while (true) {
+        vt->wake.wait(lock, [vt] { return vt->quit || !vt->requests.empty(); });
+        if (vt->quit) {
+            break;
+        }
+
+        StreamedTile streamed;
+        streamed.tile = vt->requests.front();
+        vt->requests.pop_front();
+        lock.unlock();
+
+        /* The page faults (the disk reads) of the mapping happen here, not on the render thread. */
+        streamed.pixels.resize(VT_TILE_BYTES);
+        copyTile(vt, streamed.tile, streamed.pixels.data());
+
+        lock.lock();
+        vt->ready.push_back(std::move(streamed));
+    }
+}
+
+static int tileLevel(const VirtualTexture* vt, uint32_t tile) {
+    int level = 0;
+    while (level + 1 < (int)vt->header.levelCount && tile >= vt->levelFirst[level + 1]) {
+        level++;
+    }
+    return level;
+}
+
+static void uploadTile(VirtualTexture* vt, uint32_t tile, int slot, const uint8_t* pixels) {
+    glBindTexture(GL_TEXTURE_2D, vt->physical);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % vt->cacheTiles) * VT_TILE_SIZE, (slot / vt->cacheTiles) * VT_TILE_SIZE,
+                    VT_TILE_SIZE, VT_TILE_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+    vt->tileSlot[tile] = slot;
+    vt->slotTile[slot] = (int)tile;
+    vt->slotUsed[slot] = vt->frame;
+    vt->pageTableDirty = true;
+}
+
+VirtualTexture* createVirtualTexture(const char* path, int cacheTiles, int feedbackScale, int uploadBudget) {
+    VirtualTexture* vt = new VirtualTexture();
+    if (!mapTileFile(vt, path)) {
+        delete vt;
+        return NULL;
+    }
+
+    // 1. Physical cache: the largest square of slots which fits into the texture size limit.
+    GLint maxSize = 2048;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    vt->cacheTiles = std::max(2, std::min(cacheTiles, std::min(255, (int)maxSize / VT_TILE_SIZE)));
+    vt->feedbackScale = std::max(1, feedbackScale);
+    vt->uploadBudget = std::max(1, uploadBudget);
+
+    int physicalSize = vt->cacheTiles * VT_TILE_SIZE;
+    glGenTextures(1, &vt->physical);
+    glBindTexture(GL_TEXTURE_2D, vt->physical);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, physicalSize, physicalSize);
+    gpuMemoryTrackTexture(vt->physical, GL_RGBA8, physicalSize, physicalSize, 1, 1, GPU_MEMORY_TEXTURE,
+                          "virtual texture cache");
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // 2. Page table: a mip level for every level of tiles, only read with texelFetch.
+    const VirtualTextureHeader& header = vt->header;
+    glGenTextures(1, &vt->pageTable);
+    glBindTexture(GL_TEXTURE_2D, vt->pageTable);
+    glTexStorage2D(GL_TEXTURE_2D, header.levelCount, GL_RGBA8, header.tiles, header.tiles);
+    gpuMemoryTrackTexture(vt->pageTable, GL_RGBA8, header.tiles, header.tiles, 1, header.levelCount,
+                          GPU_MEMORY_TEXTURE, "virtual texture page table");
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    vt->levelFirst.resize(header.levelCount);
+    for (uint32_t level = 0; level < header.levelCount; level++) {
+        vt->levelFirst[level] = virtualTextureTileIndex(header, level, 0, 0);
+    }
+    vt->pageEntries.resize((size_t)header.tileCount * 4);
+
+    // 3. Feedback target, created at the first frame.
+    glGenFramebuffers(1, &vt->feedbackFbo);
+    glGenRenderbuffers(1, &vt->feedbackColor);
+    glGenRenderbuffers(1, &vt->feedbackDepth);
+    vt->feedbackWidth = 0;
+    vt->feedbackHeight = 0;
+    glGenBuffers(VT_READBACK_RING, vt->pbo);
+    for (int idx = 0; idx < VT_READBACK_RING; idx++) {
+        vt->fence[idx] = 0;
+        vt->pboWidth[idx] = 0;
+        vt->pboHeight[idx] = 0;
+    }
+    vt->writeCount = 0;
+    vt->readCount = 0;
+
+    // 4. Empty cache but the coarsest tile: pinned into the slot 0, every page table entry falls back to it.
+    int slotCount = vt->cacheTiles * vt->cacheTiles;
+    vt->tileSlot.assign(header.tileCount, -1);
+    vt->tilePending.assign(header.tileCount, 0);
+    vt->tileSeen.assign(header.tileCount, 0);
+    vt->slotTile.assign(slotCount, -1);
+    vt->slotUsed.assign(slotCount, 0);
+    vt->frame = 1;
+    vt->feedbackFrame = 0;
+
+    std::vector<uint8_t> pixels(VT_TILE_BYTES);
+    copyTile(vt, header.tileCount - 1, pixels.data());
+    uploadTile(vt, header.tileCount - 1, 0, pixels.data());
+    vt->slotUsed[0] = UINT32_MAX;
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    vt->streamedCount = 0;
+    vt->evictedCount = 0;
+    vt->droppedCount = 0;
+    vt->hitCount = 0;
+    vt->missCount = 0;
+    vt->feedbackCount = 0;
+
+    vt->quit = false;
+    vt->streamer = std::thread(streamTiles, vt);
+
+    virtualTextureUpdate(vt);
+    return vt;
+}
+
+void destroyVirtualTexture(VirtualTexture* vt) {
+    if (vt == NULL) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(vt->mutex);
+        vt->quit = true;
+    }
+    vt->wake.notify_all();
+    vt->streamer.join();
+
+    int physicalSize = vt->cacheTiles * VT_TILE_SIZE;
+    double cacheMB = physicalSize * (double)physicalSize * 4 / (1024.0 * 1024.0);
+    double tableMB = vt->header.tileCount * 4 / (1024.0 * 1024.0);
+    // RGBA8 + 16 bit depth target and the RGBA8 read back buffers.
+    double feedbackMB = (double)vt->feedbackWidth * vt->feedbackHeight * (4 + 2 + 4 * VT_READBACK_RING) / (1024.0 * 1024.0);
+    uint64_t lookups = vt->hitCount + vt->missCount;
+    int resident = 0;
+    for (size_t idx = 0; idx < vt->slotTile.size(); idx++) {
+        resident += vt->slotTile[idx] >= 0;
+    }
+
+    printf("Virtual texture: %ux%u image, %u levels, %u tiles (%.1f MB), %d of %d slots resident\n",
+           vt->header.width, vt->header.height, vt->header.levelCount, vt->header.tileCount,
+           vt->size / (1024.0 * 1024.0), resident, (int)vt->slotTile.size());
+    printf("Virtual texture: %llu tiles streamed, %llu evicted, %llu dropped, %llu feedback frames, hit rate %.1f%%\n",
+           (unsigned long long)vt->streamedCount, (unsigned long long)vt->evictedCount,
+           (unsigned long long)vt->droppedCount, (unsigned long long)vt->feedbackCount,
+           lookups ? 100.0 * vt->hitCount / lookups : 100.0);
+    printf("Virtual texture: GPU memory %.1f MB (cache %.1f MB, page table %.2f MB, feedback %.2f MB)\n",
+           cacheMB + tableMB + feedbackMB, cacheMB, tableMB, feedbackMB);
+
+    for (int idx = 0; idx < VT_READBACK_RING; idx++) {
+        if (vt->fence[idx] != 0) {
+            glDeleteSync(vt->fence[idx]);
+        }
+    }
+    glDeleteBuffers(VT_READBACK_RING, vt->pbo);
+    glDeleteRenderbuffers(1, &vt->feedbackColor);
+    glDeleteRenderbuffers(1, &vt->feedbackDepth);
+    glDeleteFramebuffers(1, &vt->feedbackFbo);
+    glDeleteTextures(1, &vt->pageTable);
+    glDeleteTextures(1, &vt->physical);
+    gpuMemoryReleaseBuffers(VT_READBACK_RING, vt->pbo);
+    gpuMemoryReleaseRenderbuffers(1, &vt->feedbackColor);
+    gpuMemoryReleaseRenderbuffers(1, &vt->feedbackDepth);
+    gpuMemoryReleaseTextures(1, &vt->pageTable);
+    gpuMemoryReleaseTextures(1, &vt->physical);
+
+    munmap((void*)vt->data, vt->size);
+    delete vt;
+}
+
+void virtualTextureBeginFeedback(VirtualTexture* vt, int width, int height) {
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &vt->savedFbo);
+    glGetIntegerv(GL_VIEWPORT, vt->savedViewport);
+
+    int feedbackWidth = std::max(1, width / vt->feedbackScale);
+    int feedbackHeight = std::max(1, height / vt->feedbackScale);
+    glBindFramebuffer(GL_FRAMEBUFFER, vt->feedbackFbo);
+
+    if (feedbackWidth != vt->feedbackWidth || feedbackHeight != vt->feedbackHeight) {
+        vt->feedbackWidth = feedbackWidth;
+        vt->feedbackHeight = feedbackHeight;
+
+        glBindRenderbuffer(GL_RENDERBUFFER, vt->feedbackColor);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, feedbackWidth, feedbackHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, vt->feedbackDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, feedbackWidth, feedbackHeight);
+        gpuMemoryTrackRenderbuffer(vt->feedbackColor, GL_RGBA8, feedbackWidth, feedbackHeight, 1,
+                                   "virtual texture feedback");
+        gpuMemoryTrackRenderbuffer(vt->feedbackDepth, GL_DEPTH_COMPONENT16, feedbackWidth, feedbackHeight, 1,
+                                   "virtual texture feedback depth");
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, vt->feedbackColor);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, vt->feedbackDepth);
+    }
+
+    // Alpha 0: no tile (the background).
+    static const float noTile[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glViewport(0, 0, feedbackWidth, feedbackHeight);
+    glClearBufferfv(GL_COLOR, 0, noTile);
+    glClearBufferfi(GL_DEPTH_STENCIL, 0, 1.0f, 0);
+}
+
+void virtualTextureEndFeedback(VirtualTexture* vt) {
+    /* Every read back is in flight: skip this frame rather than wait for the GPU. */
+    if (vt->writeCount - vt->readCount < VT_READBACK_RING) {
+        int slot = vt->writeCount % VT_READBACK_RING;
+        size_t bytes = (size_t)vt->feedbackWidth * vt->feedbackHeight * 4;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, vt->pbo[slot]);
+        if (vt->pboWidth[slot] != vt->feedbackWidth || vt->pboHeight[slot] != vt->feedbackHeight) {
+            glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+            gpuMemoryTrackBuffer(vt->pbo[slot], bytes, GPU_MEMORY_TRANSFER, "virtual texture feedback readback");
+            vt->pboWidth[slot] = vt->feedbackWidth;
+            vt->pboHeight[slot] = vt->feedbackHeight;
+        }
+        glReadPixels(0, 0, vt->feedbackWidth, vt->feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        vt->fence[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        vt->writeCount++;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, vt->savedFbo);
+    glViewport(vt->savedViewport[0], vt->savedViewport[1], vt->savedViewport[2], vt->savedViewport[3]);
+}
+
+// Update the cache usage from a feedback image and request the missing tiles.
+static void parseFeedback(VirtualTexture* vt, const uint8_t* pixels, int width, int height) {
+    const VirtualTextureHeader& header = vt->header;
+    vt->feedbackFrame = vt->frame;
+    vt->feedbackCount++;
+
+    std::vector<uint32_t> missing;
+    for (int idx = 0; idx < width * height; idx++) {
+        const uint8_t* texel = pixels + idx * 4;
+        int level = texel[2];
+        if (texel[3] != 255 || level >= (int)header.levelCount) {
+            continue;
+        }
+        uint32_t side = header.tiles >> level;
+        if (texel[0] >= side || texel[1] >= side) {
+            continue;
+        }
+
+        uint32_t tile = vt->levelFirst[level] + texel[1] * side + texel[0];
+        if (vt->tileSeen[tile] == vt->frame) {
+            continue;
+        }
+        vt->tileSeen[tile] = vt->frame;
+
+        if (vt->tileSlot[tile] >= 0) {
+            vt->slotUsed[vt->tileSlot[tile]] = std::max(vt->slotUsed[vt->tileSlot[tile]], vt->frame);
+            vt->hitCount++;
+            continue;
+        }
+        vt->missCount++;
+        if (!vt->tilePending[tile]) {
+            missing.push_back(tile);
+        }
+
+        /* The resident parents are on the screen instead of the tile: keep them. */
+        int x = texel[0];
+        int y = texel[1];
+        for (int parent = level + 1; parent < (int)header.levelCount; parent++) {
+            x /= 2;
+            y /= 2;
+            int slot = vt->tileSlot[vt->levelFirst[parent] + y * (header.tiles >> parent) + x];
+            if (slot >= 0) {
+                vt->slotUsed[slot] = std::max(vt->slotUsed[slot], vt->frame);
+                break;
+            }
+        }
+    }
+
+    // Coarse levels first: they replace the blurriest fallbacks and cover the most of the screen.
+    std::stable_sort(missing.begin(), missing.end(), [](uint32_t a, uint32_t b) { return a > b; });
+
+    /* The older requests which were not started are replaced: the view moved on. */
+    size_t limit = (size_t)vt->uploadBudget * 4;
+    {
+        std::lock_guard<std::mutex> lock(vt->mutex);
+        for (size_t idx = 0; idx < vt->requests.size(); idx++) {
+            vt->tilePending[vt->requests[idx]] = 0;
+        }
+        vt->requests.clear();
+        for (size_t idx = 0; idx < missing.size() && idx < limit; idx++) {
+            vt->requests.push_back(missing[idx]);
+            vt->tilePending[missing[idx]] = 1;
+        }
+    }
+    vt->wake.notify_one();
+}
+
+// Free slot or the least recently used one which is not in the last feedback, -1 if there is none.
+static int allocateSlot(VirtualTexture* vt) {
+    int best = -1;
+    for (int slot = 0; slot < (int)vt->slotTile.size(); slot++) {
+        if (vt->slotTile[slot] < 0) {
+            return slot;
+        }
+        if (vt->slotUsed[slot] < vt->feedbackFrame && (best < 0 || vt->slotUsed[slot] < vt->slotUsed[best])) {
+            best = slot;
+        }
+    }
+
+    if (best >= 0) {
+        vt->tileSlot[vt->slotTile[best]] = -1;
+        vt->slotTile[best] = -1;
+        vt->evictedCount++;
+    }
+    return best;
+}
+
+static void rebuildPageTable(VirtualTexture* vt) {
+    const VirtualTextureHeader& header = vt->header;
+
+    // From the coarsest level: a tile which is not resident maps to the entry of its parent.
+    glBindTexture(GL_TEXTURE_2D, vt->pageTable);
+    for (int level = header.levelCount - 1; level >= 0; level--) {
+        int side = header.tiles >> level;
+        uint8_t* entries = &vt->pageEntries[(size_t)vt->levelFirst[level] * 4];
+
+        for (int y = 0; y < side; y++) {
+            for (int x = 0; x < side; x++) {
+                uint8_t* entry = entries + (y * side + x) * 4;
+                int slot = vt->tileSlot[vt->levelFirst[level] + y * side + x];
+
+                if (slot >= 0) {
+                    entry[0] = (uint8_t)(slot % vt->cacheTiles);
+                    entry[1] = (uint8_t)(slot / vt->cacheTiles);
+                    entry[2] = (uint8_t)level;
+                    entry[3] = 255;
+                } else {
+                    const uint8_t* parent = &vt->pageEntries[(vt->levelFirst[level + 1] + (y / 2) * (side / 2) + x / 2) * 4];
+                    memcpy(entry, parent, 4);
+                }
+            }
+        }
+
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, side, side, GL_RGBA, GL_UNSIGNED_BYTE, entries);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    vt->pageTableDirty = false;
+}
+
+void virtualTextureUpdate(VirtualTexture* vt) {
+    // 1. Parse the feedback images which are ready, in order.
+    while (vt->readCount < vt->writeCount) {
+        int slot = vt->readCount % VT_READBACK_RING;
+        GLenum status = glClientWaitSync(vt->fence[slot], 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+        glDeleteSync(vt->fence[slot]);
+        vt->fence[slot] = 0;
+
+        size_t bytes = (size_t)vt->pboWidth[slot] * vt->pboHeight[slot] * 4;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, vt->pbo[slot]);
+        const uint8_t* pixels = (const uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+        if (pixels != NULL) {
+            parseFeedback(vt, pixels, vt->pboWidth[slot], vt->pboHeight[slot]);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        vt->readCount++;
+    }
+
+    // 2. Upload the streamed tiles within the budget of the frame.
+    for (int count = 0; count < vt->uploadBudget; count++) {
+        StreamedTile streamed;
+        {
+            std::lock_guard<std::mutex> lock(vt->mutex);
+            if (vt->ready.empty()) {
+                break;
+            }
+            streamed = std::move(vt->ready.front());
+            vt->ready.pop_front();
+        }
+
+        vt->tilePending[streamed.tile] = 0;
+        if (vt->tileSlot[streamed.tile] >= 0) {
+            continue;
+        }
+
+        /* Every slot is on the screen: the cache is too small for the view, the parent stays in use. */
+        int slot = allocateSlot(vt);
+        if (slot < 0) {
+            vt->droppedCount++;
+            continue;
+        }
+        uploadTile(vt, streamed.tile, slot, streamed.pixels.data());
+        vt->streamedCount++;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // 3. Map the new tiles.
+    if (vt->pageTableDirty) {
+        rebuildPageTable(vt);
+    }
+
+    vt->frame++;
+}
+
+void virtualTextureBind(VirtualTexture* vt, unsigned int program, bool feedback, int physicalUnit, int pageTableUnit) {
+    glActiveTexture(GL_TEXTURE0 + physicalUnit);
+    glBindTexture(GL_TEXTURE_2D, vt->physical);
+    glActiveTexture(GL_TEXTURE0 + pageTableUnit);
+    glBindTexture(GL_TEXTURE_2D, vt->pageTable);
+    glActiveTexture(GL_TEXTURE0);
+
+    // The feedback target has feedbackScale times larger derivatives: select the level of the full resolution.
+    const VirtualTextureHeader& header = vt->header;
+    float bias = feedback ? -log2f((float)vt->feedbackScale) : 0.0f;
+    float span = (float)(header.tiles * VT_TILE_CONTENT);
+    glUniform1i(glGetUniformLocation(program, "vtPhysical"), physicalUnit);
+    glUniform1i(glGetUniformLocation(program, "vtPageTable"), pageTableUnit);
+    glUniform4f(glGetUniformLocation(program, "vtParams"), (float)header.tiles, (float)(header.levelCount - 1),
+                1.0f / (vt->cacheTiles * VT_TILE_SIZE), bias);
+    glUniform2f(glGetUniformLocation(program, "vtImageScale"), header.width / span, header.height / span);
+}
+
+const VirtualTextureHeader* virtualTextureHeader(const VirtualTexture* vt) {
+    return &vt->header;
+}
@@ -0,0 +1,140 @@
+/**
+ * Virtual texturing: images far larger than GL_MAX_TEXTURE_SIZE (and the GPU
+ * memory) streamed as tiles into a fixed size physical cache texture.
+ *
+ * The image is tiled offline (by the "tools/virtual_texture" tiler) into a
+ * mip pyramid of 128x128 RGBA8 pages: 120x120 texels of the image with a 4
+ * texel border of the neighbour tiles for the bilinear filter. Level 0 is a
+ * square of a power of two tiles per side, every level halves it down to one
+ * tile. The pages are stored one after the other in one file which is mapped
+ * into the memory.
+ *
+ * Every frame:
+ *  1. Feedback: the scene is drawn into a small (1/feedbackScale) RGBA8
+ *     target, each pixel writes the tile and the level it samples. The image
+ *     is read back into a pixel pack buffer with a fence and parsed a few
+ *     frames later, when the fence signals: the GPU is never waited for.
+ *  2. The visible tiles which are not resident are queued to the streaming
+ *     thread, coarse levels first. It reads them from the mapped file (the
+ *     page faults and the disk reads are on that thread) into staging copies.
+ *  3. The streamed tiles are uploaded into free or least recently used slots
+ *     of the physical texture, at most "uploadBudget" per frame. The tile of
+ *     the coarsest level is pinned: every texel always has a resident tile.
+ *  4. Page table: a texture with one texel per tile and one mip level per
+ *     level, each texel holds the slot and the level of the finest resident
+ *     tile covering it. It is rebuilt when the cache changed.
+ *
+ * The fragment shaders sample with the GLSL functions of
+ * virtualTextureSamplingSrc (bilinear within the selected level): the GPU
+ * memory is the cache, the page table and the feedback target, independent
+ * of the size of the image.
+ *
+ * Usage:
+ *
+ *   VirtualTexture* vt = createVirtualTexture("image.vtex", 16, 8, 8);
+ *   while (...) {
+ *       virtualTextureBeginFeedback(vt, width, height);
+ *       ... draw with a program which outputs virtualTextureFeedback(uv) ...
+ *       virtualTextureEndFeedback(vt);
+ *       virtualTextureUpdate(vt);
+ *       virtualTextureBind(vt, 1, 2);
+ *       ... draw with a program which outputs sampleVirtualTexture(uv) ...
+ *   }
+ *   destroyVirtualTexture(vt); // prints the cache statistics
+ *
+ * Dependencies:
+ *  * C++11
+ *  * POSIX (mmap)
+ *  * Open GL ES 3.0+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_COMMON_VIRTUAL_TEXTURE_H
+#define GLES_COMMON_VIRTUAL_TEXTURE_H
+
+#include <stdint.h>
+
+#define VIRTUAL_TEXTURE_MAGIC "GLESVTX"
+#define VIRTUAL_TEXTURE_VERSION 1
+
+// Stored tile (page) size, the border and the image texels per tile.
+#define VT_TILE_SIZE 128
+#define VT_TILE_BORDER 4
+#define VT_TILE_CONTENT (VT_TILE_SIZE - 2 * VT_TILE_BORDER)
+#define VT_TILE_BYTES (VT_TILE_SIZE * VT_TILE_SIZE * 4)
+
+// At most 256 tiles per side at level 0 (the tile coords of the feedback are 8 bit): 30720 texels.
+#define VT_MAX_LEVELS 9
+
+// File layout: header, the offset of every tile (level 0 first, rows from the bottom), then the tiles.
+/* An offset of 0 is a tile outside of the image (black), the tiles are VT_TILE_BYTES aligned. */
+struct VirtualTextureHeader {
+    char magic[8]; // VIRTUAL_TEXTURE_MAGIC with the terminating NUL
+    uint32_t version;
+    uint32_t width;      // of the image
+    uint32_t height;
+    uint32_t tiles;      // per side at level 0, a power of two
+    uint32_t levelCount; // log2(tiles) + 1
+    uint32_t tileCount;  // every level
+};
+
+// Index of a tile in the offset table.
+inline uint32_t virtualTextureTileIndex(const VirtualTextureHeader& header, int level, int x, int y) {
+    uint32_t first = 0;
+    for (int idx = 0; idx < level; idx++) {
+        uint32_t side = header.tiles >> idx;
+        first += side * side;
+    }
+    return first + y * (header.tiles >> level) + x;
+}
+
+// The sampling functions, insert them after the precision statements of a GLSL ES 3.00 (or later) fragment shader.
+/* vec4 sampleVirtualTexture(vec2 uv): the color of the image at uv (0 .. 1 covers the image).
+ * vec4 virtualTextureFeedback(vec2 uv): the output of the feedback pass. */
+extern const char* virtualTextureSamplingSrc;
+
+struct VirtualTexture;
+
+// Map the tile file, create the physical cache of "cacheTiles" x "cacheTiles" slots and start the streaming thread.
+/* The feedback target is 1/"feedbackScale" of the framebuffer size. Returns NULL (and prints the reason) on failure. */
+VirtualTexture* createVirtualTexture(const char* path, int cacheTiles, int feedbackScale, int uploadBudget);
+
+// Stop the streaming thread, delete the GL objects and print the statistics.
+void destroyVirtualTexture(VirtualTexture* vt);
+
+// Bind the feedback target (and set its viewport) for a framebuffer of width x height.
+void virtualTextureBeginFeedback(VirtualTexture* vt, int width, int height);
+
+// Start the read back of the feedback and restore the previous framebuffer binding.
+void virtualTextureEndFeedback(VirtualTexture* vt);
+
+// Parse the feedback which is ready, stream and upload the tiles, update the page table. Never waits for the GPU.
+void virtualTextureUpdate(VirtualTexture* vt);
+
+// Bind the physical and the page table textures to the texture units and set the uniforms of the program in use.
+/* "feedback": the program writes virtualTextureFeedback (the level selection matches the feedback target size). */
+void virtualTextureBind(VirtualTexture* vt, unsigned int program, bool feedback, int physicalUnit, int pageTableUnit);
+
+// Size and levels of the image.
+const VirtualTextureHeader* virtualTextureHeader(const VirtualTexture* vt);
+
+#endif // GLES_COMMON_VIRTUAL_TEXTURE_H
@@ -0,0 +1,279 @@
+/**
+ * Offline asset bundle packer (see common/asset_bundle.h for the format).
+ *
+ * Packs shader sources and KTX textures from files and bakes the built-in
+ * meshes (indexed, vertex cache optimized and packed into their vertex
+ * streams) into one bundle file. The runtime maps the file and uploads the
+ * assets without any processing.
+ *
+ * Options (processed in order, "--packed", "--vertex-layout", "--lods" and
+ * "--meshlets" apply to the meshes after them):
+ *  --shader NAME FILE       Shader source text.
+ *  --texture NAME FILE      KTX 1.1 compressed texture (ex.: from "ktx_etc2").
+ *  --packed                 Half float positions and normalized texture coords (see common/mesh.h).
+ *  --vertex-layout LAYOUT   interleaved (default), planar or position-stream.
+ *  --cube-mesh NAME         The unit cube of createCubeMesh.
+ *  --grid-mesh NAME N       Grid of NxN quads (createGridMesh).
+ *  --sphere-mesh NAME       UV sphere of 64x32 quads without texture coords (the seam is welded).
+ *  --lods N                 Simplify the meshes into N levels of detail, each with half of the
+ *                           triangles of the previous one (see common/mesh_lod.h, default: 1).
+ *  --meshlets               Split the meshes into meshlets of up to 64 vertices and 124 triangles with
+ *                           bounding spheres and normal cones (see common/meshlet.h), the mesh indices
+ *                           are in meshlet order.
+ *
+ * Compile:
+ * $ g++ -I.. asset_bundle.cpp ../common/mesh.cpp ../common/mesh_lod.cpp ../common/meshlet.cpp -o asset_bundle
+ *
+ * Run:
+ * $ ./asset_bundle demo_assets.bundle --texture kitten kitten_10.ktx --cube-mesh cube
+ *
+ * Bake a sphere with 8 levels of detail (the index ranges are in the "sphere" mesh LOD asset):
+ * $ ./asset_bundle lod.bundle --lods 8 --sphere-mesh sphere
+ *
+ * Bake a 512x512 grid with its meshlets (for x_gles_compute_meshlets --bundle):
+ * $ ./asset_bundle meshlets.bundle --meshlets --grid-mesh grid 512
+ *
+ * Dependencies:
+ *  * C++11
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#include "common/asset_bundle.h"
+#include "common/mesh.h"
+#include "common/mesh_lod.h"
+#include "common/meshlet.h"
+#include "common/static_mesh.h"
+
+struct Asset {
+    AssetEntry entry;
+    std::vector<uint8_t> data;
+};
+
+static size_t alignOffset(size_t offset) {
+    return (offset + ASSET_BUNDLE_ALIGNMENT - 1) & ~(size_t)(ASSET_BUNDLE_ALIGNMENT - 1);
+}
+
+static bool readFile(const char* path, std::vector<uint8_t>* data) {
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file) {
+        printf("Error: unable to open '%s'\n", path);
+        return false;
+    }
+    data->assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return true;
+}
+
+static bool addAsset(std::vector<Asset>* assets, const char* name, AssetType type, std::vector<uint8_t>* data) {
+    if (strlen(name) >= ASSET_NAME_SIZE) {
+        printf("Error: the asset name '%s' is longer than %d characters\n", name, ASSET_NAME_SIZE - 1);
+        return false;
+    }
+
+    Asset asset;
+    memset(&asset.entry, 0, sizeof(asset.entry));
+    strcpy(asset.entry.name, name);
+    asset.entry.type = type;
+    asset.entry.size = data->size();
+    asset.data.swap(*data);
+    assets->push_back(asset);
+    return true;
+}
+
+// Mesh asset: MeshStreams header, vertex streams and indices, each part aligned.
+static std::vector<uint8_t> bakeMesh(const MeshData& mesh, bool packed, MeshLayout layout) {
+    std::vector<uint8_t> vertexData;
+    std::vector<uint8_t> indexData;
+    MeshStreams streams = packMesh(mesh, packed, layout, &vertexData, &indexData);
+
+    size_t vertexOffset = alignOffset(sizeof(MeshStreams));
+    size_t indexOffset = alignOffset(vertexOffset + vertexData.size());
+
+    std::vector<uint8_t> blob(indexOffset + indexData.size(), 0);
+    memcpy(blob.data(), &streams, sizeof(streams));
+    memcpy(&blob[vertexOffset], vertexData.data(), vertexData.size());
+    memcpy(&blob[indexOffset], indexData.data(), indexData.size());
+    return blob;
+}
+
+// Meshlet asset: MeshletHeader, meshlets and indices, each part aligned.
+static std::vector<uint8_t> bakeMeshlets(const MeshletData& meshlets) {
+    MeshletHeader header = { (uint32_t)meshlets.meshlets.size(), (uint32_t)meshlets.indices.size() };
+    size_t meshletOffset = alignOffset(sizeof(MeshletHeader));
+    size_t indexOffset = alignOffset(meshletOffset + meshlets.meshlets.size() * sizeof(Meshlet));
+
+    std::vector<uint8_t> blob(indexOffset + meshlets.indices.size() * sizeof(uint32_t), 0);
+    memcpy(blob.data(), &header, sizeof(header));
+    memcpy(&blob[meshletOffset], meshlets.meshlets.data(), meshlets.meshlets.size() * sizeof(Meshlet));
+    memcpy(&blob[indexOffset], meshlets.indices.data(), meshlets.indices.size() * sizeof(uint32_t));
+    return blob;
+}
+
+// Bake the mesh, with "lodLevels" > 1 the levels are added to its indices and their ranges as a mesh LOD asset.
+/* With "meshlets" the triangles are reordered by the meshlets first (the levels of detail follow them). */
+static bool addMesh(std::vector<Asset>* assets, const char* name, MeshData mesh, bool packed, MeshLayout layout,
+                    int lodLevels, bool meshlets) {
+    if (meshlets) {
+        MeshletData data = buildMeshlets(mesh);
+        mesh.indices = data.indices;
+        printf("%s: %d meshlets, %.1f triangles/meshlet\n", name, (int)data.meshlets.size(),
+               data.indices.size() / 3.0 / std::max((int)data.meshlets.size(), 1));
+
+        std::vector<uint8_t> blob = bakeMeshlets(data);
+        if (!addAsset(assets, name, ASSET_MESHLETS, &blob)) {
+            return false;
+        }
+    }
+
+    if (lodLevels > 1) {
+        MeshLodChain chain = buildMeshLods(&mesh, lodLevels, 0.5f);
+        printf("%s: %u levels:", name, chain.levelCount);
+        for (uint32_t idx = 0; idx < chain.levelCount; idx++) {
+            printf(" %u (%.5f)", chain.levels[idx].indexCount / 3, chain.levels[idx].error);
+        }
+        printf(" triangles (error)\n");
+
+        std::vector<uint8_t> data((const uint8_t*)&chain, (const uint8_t*)&chain + sizeof(chain));
+        if (!addAsset(assets, name, ASSET_MESH_LODS, &data)) {
+            return false;
+        }
+    }
+
+    std::vector<uint8_t> data = bakeMesh(mesh, packed, layout);
+    return addAsset(assets, name, ASSET_MESH, &data);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        printf("Usage: %s <output.bundle> [--shader NAME FILE] [--texture NAME FILE.ktx] [--packed]\n"
+               "       [--vertex-layout LAYOUT] [--lods N] [--cube-mesh NAME] [--grid-mesh NAME N]\n"
+               "       [--sphere-mesh NAME] [--meshlets] ...\n", argv[0]);
+        return -1;
+    }
+
+    // 1. Collect the assets.
+    std::vector<Asset> assets;
+    bool packed = false;
+    MeshLayout layout = MESH_LAYOUT_INTERLEAVED;
+    int lodLevels = 1;
+    bool meshlets = false;
+    for (int idx = 2; idx < argc; idx++) {
+        std::vector<uint8_t> data;
+        bool added = true;
+        if (strcmp(argv[idx], "--shader") == 0 && idx + 2 < argc) {
+            added = readFile(argv[idx + 2], &data);
+            data.push_back('\0');
+            added = added && addAsset(&assets, argv[idx + 1], ASSET_SHADER, &data);
+            idx += 2;
+        } else if (strcmp(argv[idx], "--texture") == 0 && idx + 2 < argc) {
+            static const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+            added = readFile(argv[idx + 2], &data);
+            if (added && (data.size() < sizeof(identifier) || memcmp(data.data(), identifier, sizeof(identifier)) != 0)) {
+                printf("Error: '%s' is not a KTX 1.1 file\n", argv[idx + 2]);
+                added = false;
+            }
+            added = added && addAsset(&assets, argv[idx + 1], ASSET_TEXTURE, &data);
+            idx += 2;
+        } else if (strcmp(argv[idx], "--packed") == 0) {
+            packed = true;
+        } else if (strcmp(argv[idx], "--vertex-layout") == 0 && idx + 1 < argc) {
+            if (!parseMeshLayout(argv[++idx], &layout)) {
+                printf("Error: unknown vertex layout '%s'\n", argv[idx]);
+                added = false;
+            }
+        } else if (strcmp(argv[idx], "--cube-mesh") == 0 && idx + 1 < argc) {
+            added = addMesh(&assets, argv[idx + 1], createCubeMesh(), packed, layout, lodLevels, meshlets);
+            idx += 1;
+        } else if (strcmp(argv[idx], "--grid-mesh") == 0 && idx + 2 < argc) {
+            int size = atoi(argv[idx + 2]);
+            if (size < 1 || size > 2048) {
+                printf("Error: invalid grid size (valid range: 1-2048)\n");
+                added = false;
+            } else {
+                added = addMesh(&assets, argv[idx + 1], createGridMesh(size, size), packed, layout, lodLevels, meshlets);
+            }
+            idx += 2;
+        } else if (strcmp(argv[idx], "--sphere-mesh") == 0 && idx + 1 < argc) {
+            MeshData sphere = weldMeshPositions(staticMeshData(staticSphere<StaticVertex, 64, 32>()));
+            added = addMesh(&assets, argv[idx + 1], sphere, packed, layout, lodLevels, meshlets);
+            idx += 1;
+        } else if (strcmp(argv[idx], "--lods") == 0 && idx + 1 < argc) {
+            lodLevels = atoi(argv[++idx]);
+            if (lodLevels < 1 || lodLevels > MESH_LOD_MAX_LEVELS) {
+                printf("Error: invalid level count (valid range: 1-%d)\n", MESH_LOD_MAX_LEVELS);
+                added = false;
+            }
+        } else if (strcmp(argv[idx], "--meshlets") == 0) {
+            meshlets = true;
+        } else {
+            printf("Error: unknown or incomplete option '%s'\n", argv[idx]);
+            added = false;
+        }
+
+        if (!added) {
+            return -2;
+        }
+    }
+
+    // 2. Place the blobs after the table of contents.
+    size_t offset = alignOffset(sizeof(AssetBundleHeader) + assets.size() * sizeof(AssetEntry));
+    for (size_t idx = 0; idx < assets.size(); idx++) {
+        assets[idx].entry.offset = offset;
+        offset = alignOffset(offset + assets[idx].data.size());
+    }
+
+    // 3. Write the bundle.
+    std::ofstream file(argv[1], std::ios::out | std::ios::binary);
+    if (!file) {
+        printf("Error: unable to open '%s'\n", argv[1]);
+        return -3;
+    }
+
+    AssetBundleHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ASSET_BUNDLE_MAGIC, sizeof(header.magic));
+    header.version = ASSET_BUNDLE_VERSION;
+    header.entryCount = assets.size();
+    file.write((const char*)&header, sizeof(header));
+    for (size_t idx = 0; idx < assets.size(); idx++) {
+        file.write((const char*)&assets[idx].entry, sizeof(AssetEntry));
+    }
+
+    static const char padding[ASSET_BUNDLE_ALIGNMENT] = {};
+    for (size_t idx = 0; idx < assets.size(); idx++) {
+        file.write(padding, assets[idx].entry.offset - (size_t)file.tellp());
+        file.write((const char*)assets[idx].data.data(), assets[idx].data.size());
+    }
+    size_t fileSize = (size_t)file.tellp();
+    file.close();
+
+    printf("%s: %d assets, %zu bytes\n", argv[1], (int)assets.size(), fileSize);
+    return 0;
+}
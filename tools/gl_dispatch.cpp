@@ -0,0 +1,234 @@
+/**
+ * Generator of the lazy GL ES dispatch (GLES_LAZY_GL_LOADER build option).
+ *
+ * Collects the GL ES prototypes of the Khronos headers (GLES2/gl2.h, GLES3/gl3.h,
+ * gl31.h, gl32.h and the extension prototypes of GLES2/gl2ext.h) and the "gl..."
+ * identifiers of the demo sources. For every prototype which is used by a source
+ * the output has a function of the same name and signature: the first call
+ * resolves the entry point of the driver (see common/gl_loader.h) into a slot of
+ * the dispatch table, the later calls jump through the slot. The unused entry
+ * points are neither generated nor resolved.
+ *
+ * Run (the CMake build does this for the gles_common library):
+ * $ ./gl_dispatch gl_dispatch.cpp /usr/include common/*.cpp 07_gles_cube/*.cpp ...
+ *
+ * Dependencies:
+ *  * C++11
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Prototype {
+    std::string returnType;
+    std::string parameters; // the declared list, with the names
+    std::vector<std::string> names;
+};
+
+static bool readFile(const std::string& path, std::string* text) {
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    *text = stream.str();
+    return true;
+}
+
+static bool writeFile(const std::string& path, const std::string& text) {
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+    if (!file) {
+        printf("Error: unable to write '%s'\n", path.c_str());
+        return false;
+    }
+    file << text;
+    return (bool)file;
+}
+
+static std::string trim(const std::string& text) {
+    size_t start = text.find_first_not_of(" \t\r\n");
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return start == std::string::npos ? "" : text.substr(start, end - start + 1);
+}
+
+// The whitespace runs (the line breaks of the long prototypes) are replaced by one space.
+static std::string collapseSpaces(const std::string& text) {
+    std::string result;
+    for (char chr : text) {
+        if (isspace((unsigned char)chr)) {
+            if (!result.empty() && result.back() != ' ') {
+                result += ' ';
+            }
+        } else {
+            result += chr;
+        }
+    }
+    return trim(result);
+}
+
+// The trailing identifier of every parameter ("const void *const*indices": "indices"), none for "void".
+static std::vector<std::string> parameterNames(const std::string& parameters) {
+    std::vector<std::string> names;
+    if (parameters.empty() || parameters == "void") {
+        return names;
+    }
+    std::stringstream list(parameters);
+    std::string parameter;
+    while (std::getline(list, parameter, ',')) {
+        parameter = trim(parameter);
+        size_t start = parameter.size();
+        while (start > 0 && (isalnum((unsigned char)parameter[start - 1]) || parameter[start - 1] == '_')) {
+            start--;
+        }
+        names.push_back(parameter.substr(start));
+    }
+    return names;
+}
+
+// Every "GL_APICALL <type> GL_APIENTRY <name> (<parameters>);" of the header.
+static void parsePrototypes(const std::string& text, std::map<std::string, Prototype>* prototypes) {
+    for (size_t pos = text.find("GL_APICALL "); pos != std::string::npos; pos = text.find("GL_APICALL ", pos + 1)) {
+        size_t end = text.find(';', pos);
+        if (end == std::string::npos) {
+            break;
+        }
+        std::string declaration = collapseSpaces(text.substr(pos + 11, end - pos - 11));
+        size_t entry = declaration.find("GL_APIENTRY ");
+        size_t open = declaration.find('(');
+        size_t close = declaration.rfind(')');
+        if (entry == std::string::npos || open == std::string::npos || close == std::string::npos || open < entry) {
+            continue;
+        }
+
+        std::string name = trim(declaration.substr(entry + 12, open - entry - 12));
+        Prototype prototype;
+        prototype.returnType = trim(declaration.substr(0, entry));
+        prototype.parameters = trim(declaration.substr(open + 1, close - open - 1));
+        prototype.names = parameterNames(prototype.parameters);
+        prototypes->insert(std::make_pair(name, prototype));
+    }
+}
+
+// The "gl[A-Z]..." identifiers of a source.
+static void collectIdentifiers(const std::string& text, std::set<std::string>* identifiers) {
+    for (size_t pos = 0; pos + 2 < text.size(); pos++) {
+        bool start = text[pos] == 'g' && text[pos + 1] == 'l' && isupper((unsigned char)text[pos + 2])
+                  && (pos == 0 || !(isalnum((unsigned char)text[pos - 1]) || text[pos - 1] == '_'));
+        if (!start) {
+            continue;
+        }
+        size_t end = pos + 2;
+        while (end < text.size() && (isalnum((unsigned char)text[end]) || text[end] == '_')) {
+            end++;
+        }
+        identifiers->insert(text.substr(pos, end - pos));
+        pos = end;
+    }
+}
+
+static std::string generateSource(const std::map<std::string, Prototype>& prototypes,
+                                  const std::set<std::string>& used) {
+    std::string functions;
+    int slot = 0;
+    for (const auto& item : prototypes) {
+        if (used.count(item.first) == 0) {
+            continue;
+        }
+        const Prototype& prototype = item.second;
+        std::string arguments;
+        for (const std::string& name : prototype.names) {
+            arguments += (arguments.empty() ? "" : ", ") + name;
+        }
+        functions += prototype.returnType + " GL_APIENTRY " + item.first + "(" + prototype.parameters + ") {\n";
+        functions += "    return ((" + prototype.returnType + " (GL_APIENTRY*)(" + prototype.parameters + "))"
+                     "dispatch(" + std::to_string(slot) + ", \"" + item.first + "\"))(" + arguments + ");\n";
+        functions += "}\n\n";
+        slot++;
+    }
+
+    std::string output = "// Generated by tools/gl_dispatch from the GL ES headers and the demo sources, do not edit.\n"
+                         "#include <stddef.h>\n\n"
+                         "#include <GLES3/gl32.h>\n"
+                         "#include <GLES2/gl2ext.h>\n\n"
+                         "#include \"common/gl_loader.h\"\n\n";
+    output += "extern const int glDispatchEntryCount = " + std::to_string(slot) + ";\n\n";
+    output += "static void* dispatchTable[" + std::to_string(slot > 0 ? slot : 1) + "];\n\n";
+    output += "static inline void* dispatch(int slot, const char* name) {\n"
+              "    void* proc = dispatchTable[slot];\n"
+              "    return proc != NULL ? proc : glLoaderResolveSlot(&dispatchTable[slot], name);\n"
+              "}\n\n";
+    output += "extern \"C\" {\n\n" + functions + "} // extern \"C\"\n";
+    return output;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        printf("Usage: %s <output.cpp> <GL ES include dir> <source files...>\n", argv[0]);
+        return -1;
+    }
+
+    // 1. The prototypes: the core headers and the extension prototypes (GL_GLEXT_PROTOTYPES in gl2ext.h).
+    std::map<std::string, Prototype> prototypes;
+    const char* headers[] = { "GLES2/gl2.h", "GLES3/gl3.h", "GLES3/gl31.h", "GLES3/gl32.h", "GLES2/gl2ext.h" };
+    for (const char* header : headers) {
+        std::string text;
+        if (readFile(std::string(argv[2]) + "/" + header, &text)) {
+            parsePrototypes(text, &prototypes);
+        }
+    }
+    if (prototypes.empty()) {
+        printf("Error: no GL ES prototypes in '%s'\n", argv[2]);
+        return -1;
+    }
+
+    // 2. The identifiers of the sources: only these entry points get a dispatch slot.
+    std::set<std::string> used;
+    for (int idx = 3; idx < argc; idx++) {
+        std::string text;
+        if (!readFile(argv[idx], &text)) {
+            printf("Error: unable to read '%s'\n", argv[idx]);
+            return -1;
+        }
+        collectIdentifiers(text, &used);
+    }
+
+    std::string output = generateSource(prototypes, used);
+    if (!writeFile(argv[1], output)) {
+        return -1;
+    }
+    int count = 0;
+    for (const auto& item : prototypes) {
+        count += used.count(item.first);
+    }
+    printf("gl_dispatch: %d of %d entry points used by %d sources\n", count, (int)prototypes.size(), argc - 3);
+    return 0;
+}
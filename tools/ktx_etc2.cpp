@@ -0,0 +1,343 @@
+/**
+ * Offline image to ETC2 (RGB8) KTX converter.
+ *
+ * Decodes an image (anything stb_image can load), builds the full mipmap
+ * chain and compresses every level into GL_COMPRESSED_RGB8_ETC2 blocks.
+ * The result is written as a KTX 1.1 file which can be uploaded with
+ * glCompressedTex(Sub)Image2D without any processing at load time.
+ *
+ * The encoder only uses the ETC1 compatible (individual/differential) block
+ * modes of ETC2: it is simple and fast, not the best possible quality.
+ * The image is flipped vertically to match the GL texture coordinate system.
+ *
+ * Compile:
+ * $ g++ -I.. ktx_etc2.cpp -o ktx_etc2
+ *
+ * Run:
+ * $ ./ktx_etc2 input.jpg output.ktx
+ *
+ * Dependencies:
+ *  * C++11
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <fstream>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "common/stb_image.h"
+
+// From the GLES3/gl3.h header (the tool does not depend on GL).
+#define GL_RGB 0x1907
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+
+// ETC1/ETC2 intensity modifier tables (large/small positive values, the negatives are mirrored).
+static const int etcModifiers[8][2] = {
+    { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 },
+};
+
+// The 2 bit pixel index -> modifier mapping: 0: +small, 1: +large, 2: -small, 3: -large.
+static int modifierValue(int table, int index) {
+    int value = etcModifiers[table][index & 1];
+    return (index & 2) ? -value : value;
+}
+
+static int clampByte(int value) {
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+struct Image {
+    int width;
+    int height;
+    std::vector<uint8_t> pixels; // RGB8
+};
+
+// Encoded form of one sub-block (2x4 or 4x2 pixels).
+struct SubBlock {
+    int base[3];       // expanded 8 bit base color
+    int table;
+    int indices[8];
+    int error;
+};
+
+// Find the best modifier table and pixel indices for a sub-block with a given base color.
+static void encodeSubBlock(const int pixels[8][3], const int base[3], SubBlock* result) {
+    result->error = -1;
+    for (int table = 0; table < 8; table++) {
+        int indices[8];
+        int error = 0;
+
+        for (int pixel = 0; pixel < 8; pixel++) {
+            int bestError = -1;
+            for (int index = 0; index < 4; index++) {
+                int modifier = modifierValue(table, index);
+                int pixelError = 0;
+                for (int c = 0; c < 3; c++) {
+                    int diff = clampByte(base[c] + modifier) - pixels[pixel][c];
+                    pixelError += diff * diff;
+                }
+                if (bestError < 0 || pixelError < bestError) {
+                    bestError = pixelError;
+                    indices[pixel] = index;
+                }
+            }
+            error += bestError;
+        }
+
+        if (result->error < 0 || error < result->error) {
+            result->error = error;
+            result->table = table;
+            memcpy(result->indices, indices, sizeof(indices));
+        }
+    }
+    memcpy(result->base, base, sizeof(result->base));
+}
+
+// Encode a 4x4 RGB block (block[y][x]) into the 8 byte ETC2 representation.
+static void encodeBlock(const int block[4][4][3], uint8_t output[8]) {
+    uint64_t bestBits = 0;
+    int bestError = -1;
+
+    for (int flip = 0; flip < 2; flip++) {
+        // 1. Collect the pixels of the two sub-blocks.
+        /* flip = 0: left/right 2x4 halves, flip = 1: top/bottom 4x2 halves. */
+        int pixels[2][8][3];
+        int pixelX[2][8];
+        int pixelY[2][8];
+        int average[2][3] = { { 0, 0, 0 }, { 0, 0, 0 } };
+        int count[2] = { 0, 0 };
+
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 4; x++) {
+                int sub = flip ? (y >= 2) : (x >= 2);
+                int idx = count[sub]++;
+                pixelX[sub][idx] = x;
+                pixelY[sub][idx] = y;
+                for (int c = 0; c < 3; c++) {
+                    pixels[sub][idx][c] = block[y][x][c];
+                    average[sub][c] += block[y][x][c];
+                }
+            }
+        }
+
+        // 2. Quantize the average colors: differential mode (5 bit + 3 bit delta) if
+        //    the colors are close enough, individual mode (4 bit each) otherwise.
+        int quant5[2][3];
+        int quant4[2][3];
+        bool differential = true;
+        for (int sub = 0; sub < 2; sub++) {
+            for (int c = 0; c < 3; c++) {
+                int value = (average[sub][c] + 4) / 8;
+                quant5[sub][c] = (value * 31 + 127) / 255;
+                quant4[sub][c] = (value * 15 + 127) / 255;
+            }
+        }
+        for (int c = 0; c < 3; c++) {
+            int delta = quant5[1][c] - quant5[0][c];
+            if (delta < -4 || delta > 3) {
+                differential = false;
+            }
+        }
+
+        int base[2][3];
+        for (int sub = 0; sub < 2; sub++) {
+            for (int c = 0; c < 3; c++) {
+                base[sub][c] = differential ? ((quant5[sub][c] << 3) | (quant5[sub][c] >> 2))
+                                            : ((quant4[sub][c] << 4) | quant4[sub][c]);
+            }
+        }
+
+        // 3. Select the tables and the pixel indices.
+        SubBlock subBlocks[2];
+        encodeSubBlock(pixels[0], base[0], &subBlocks[0]);
+        encodeSubBlock(pixels[1], base[1], &subBlocks[1]);
+
+        int error = subBlocks[0].error + subBlocks[1].error;
+        if (bestError >= 0 && error >= bestError) {
+            continue;
+        }
+        bestError = error;
+
+        // 4. Pack the bits (big endian 64 bit word).
+        uint64_t bits = 0;
+        for (int c = 0; c < 3; c++) {
+            uint64_t colorBits;
+            if (differential) {
+                int delta = quant5[1][c] - quant5[0][c];
+                colorBits = (quant5[0][c] << 3) | (delta & 0x7);
+            } else {
+                colorBits = (quant4[0][c] << 4) | quant4[1][c];
+            }
+            bits |= colorBits << (56 - c * 8);
+        }
+        bits |= (uint64_t)subBlocks[0].table << 37;
+        bits |= (uint64_t)subBlocks[1].table << 34;
+        bits |= (uint64_t)(differential ? 1 : 0) << 33;
+        bits |= (uint64_t)flip << 32;
+
+        /* The pixels are indexed in column major order: index = x * 4 + y,
+         * the MSB of the index goes to bit (16 + index), the LSB to bit (index). */
+        for (int sub = 0; sub < 2; sub++) {
+            for (int idx = 0; idx < 8; idx++) {
+                int pixelIndex = pixelX[sub][idx] * 4 + pixelY[sub][idx];
+                int value = subBlocks[sub].indices[idx];
+                bits |= (uint64_t)((value >> 1) & 1) << (16 + pixelIndex);
+                bits |= (uint64_t)(value & 1) << pixelIndex;
+            }
+        }
+        bestBits = bits;
+    }
+
+    for (int idx = 0; idx < 8; idx++) {
+        output[idx] = (uint8_t)(bestBits >> (56 - idx * 8));
+    }
+}
+
+// Compress an RGB8 image, the edge pixels are repeated for the partial blocks.
+static std::vector<uint8_t> encodeImage(const Image& image) {
+    int blocksX = (image.width + 3) / 4;
+    int blocksY = (image.height + 3) / 4;
+    std::vector<uint8_t> output(blocksX * blocksY * 8);
+
+    for (int by = 0; by < blocksY; by++) {
+        for (int bx = 0; bx < blocksX; bx++) {
+            int block[4][4][3];
+            for (int y = 0; y < 4; y++) {
+                for (int x = 0; x < 4; x++) {
+                    int px = bx * 4 + x < image.width ? bx * 4 + x : image.width - 1;
+                    int py = by * 4 + y < image.height ? by * 4 + y : image.height - 1;
+                    for (int c = 0; c < 3; c++) {
+                        block[y][x][c] = image.pixels[(py * image.width + px) * 3 + c];
+                    }
+                }
+            }
+            encodeBlock(block, &output[(by * blocksX + bx) * 8]);
+        }
+    }
+
+    return output;
+}
+
+// Downscale the image to half size with a 2x2 box filter.
+static Image halfImage(const Image& source) {
+    Image result;
+    result.width = source.width > 1 ? source.width / 2 : 1;
+    result.height = source.height > 1 ? source.height / 2 : 1;
+    result.pixels.resize(result.width * result.height * 3);
+
+    for (int y = 0; y < result.height; y++) {
+        int y0 = y * 2;
+        int y1 = y0 + 1 < source.height ? y0 + 1 : y0;
+        for (int x = 0; x < result.width; x++) {
+            int x0 = x * 2;
+            int x1 = x0 + 1 < source.width ? x0 + 1 : x0;
+            for (int c = 0; c < 3; c++) {
+                int sum = source.pixels[(y0 * source.width + x0) * 3 + c] + source.pixels[(y0 * source.width + x1) * 3 + c]
+                        + source.pixels[(y1 * source.width + x0) * 3 + c] + source.pixels[(y1 * source.width + x1) * 3 + c];
+                result.pixels[(y * result.width + x) * 3 + c] = (uint8_t)((sum + 2) / 4);
+            }
+        }
+    }
+
+    return result;
+}
+
+static void writeUint32(std::ofstream& file, uint32_t value) {
+    file.write((const char*)&value, sizeof(value));
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        printf("Usage: %s <input image> <output.ktx>\n", argv[0]);
+        return -1;
+    }
+
+    // 1. Load the source image as RGB8.
+    Image image;
+    {
+        stbi_set_flip_vertically_on_load(true);
+        int channels;
+        uint8_t* data = stbi_load(argv[1], &image.width, &image.height, &channels, 3);
+        if (data == NULL) {
+            printf("Error: unable to load '%s': %s\n", argv[1], stbi_failure_reason());
+            return -2;
+        }
+        image.pixels.assign(data, data + image.width * image.height * 3);
+        stbi_image_free(data);
+    }
+
+    // 2. Compress every mip level.
+    std::vector<std::vector<uint8_t>> levels;
+    {
+        Image level = image;
+        while (true) {
+            levels.push_back(encodeImage(level));
+            if (level.width == 1 && level.height == 1) {
+                break;
+            }
+            level = halfImage(level);
+        }
+    }
+
+    // 3. Write the KTX 1.1 file.
+    {
+        std::ofstream file(argv[2], std::ios::out | std::ios::binary);
+        if (!file) {
+            printf("Error: unable to open '%s'\n", argv[2]);
+            return -3;
+        }
+
+        static const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+        file.write((const char*)identifier, sizeof(identifier));
+        writeUint32(file, 0x04030201);              // endianness
+        writeUint32(file, 0);                       // glType (compressed)
+        writeUint32(file, 1);                       // glTypeSize
+        writeUint32(file, 0);                       // glFormat (compressed)
+        writeUint32(file, GL_COMPRESSED_RGB8_ETC2); // glInternalFormat
+        writeUint32(file, GL_RGB);                  // glBaseInternalFormat
+        writeUint32(file, image.width);
+        writeUint32(file, image.height);
+        writeUint32(file, 0);                       // pixelDepth
+        writeUint32(file, 0);                       // numberOfArrayElements
+        writeUint32(file, 1);                       // numberOfFaces
+        writeUint32(file, levels.size());           // numberOfMipmapLevels
+        writeUint32(file, 0);                       // bytesOfKeyValueData
+
+        size_t total = 0;
+        for (size_t idx = 0; idx < levels.size(); idx++) {
+            /* The ETC2 blocks are 8 bytes, so no mip padding is needed. */
+            writeUint32(file, levels[idx].size());
+            file.write((const char*)levels[idx].data(), levels[idx].size());
+            total += levels[idx].size();
+        }
+        file.close();
+
+        printf("%s: %dx%d, %d levels, %zu bytes (RGBA8: %zu bytes)\n", argv[2], image.width, image.height,
+               (int)levels.size(), total, (size_t)image.width * image.height * 4 * 4 / 3);
+    }
+
+    return 0;
+}
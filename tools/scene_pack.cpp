@@ -0,0 +1,266 @@
+/**
+ * Offline scene file generator (see common/scene_file.h for the format).
+ *
+ * Generates a procedural city: N x N blocks, each block is a node with a
+ * terrain tile (a unique displaced grid mesh per block, so the blocks are
+ * streamed one by one), buildings (instances of the shared cube mesh) and
+ * trees (instances of the shared sphere mesh) as its children. The meshes
+ * are indexed, vertex cache optimized and packed into their vertex streams
+ * like the mesh assets of the asset bundles, the runtime uploads them from
+ * the mapped file without any processing.
+ *
+ * Options:
+ *  --city N          Blocks per side (default: 16).
+ *  --tile-detail N   Quads per side of the terrain tiles (default: 32).
+ *  --packed          Half float positions and normalized texture coords (see common/mesh.h).
+ *
+ * Compile:
+ * $ g++ -I.. scene_pack.cpp ../common/mesh.cpp -o scene_pack
+ *
+ * Run:
+ * $ ./scene_pack demo_city.scene --city 16 --tile-detail 32
+ *
+ * Dependencies:
+ *  * C++11
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#include "common/mesh.h"
+#include "common/scene_file.h"
+#include "common/static_mesh.h"
+
+// World size of a block, the terrain tile covers it.
+static const float blockSize = 10.0f;
+
+static size_t alignOffset(size_t offset) {
+    return (offset + SCENE_FILE_ALIGNMENT - 1) & ~(size_t)(SCENE_FILE_ALIGNMENT - 1);
+}
+
+// Deterministic pseudo random numbers in [0, 1) (the scene is the same on every build).
+static float randomUnit(uint32_t* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return (*state >> 8) / 16777216.0f;
+}
+
+// Mesh blob: MeshStreams header, vertex streams and indices, each part aligned (the mesh assets of the bundles).
+static void addMesh(std::vector<SceneFileMesh>* meshes, std::vector<std::vector<uint8_t> >* blobs, const MeshData& mesh,
+                    bool packed) {
+    std::vector<uint8_t> vertexData;
+    std::vector<uint8_t> indexData;
+    MeshStreams streams = packMesh(mesh, packed, MESH_LAYOUT_INTERLEAVED, &vertexData, &indexData);
+
+    size_t vertexOffset = alignOffset(sizeof(MeshStreams));
+    size_t indexOffset = alignOffset(vertexOffset + vertexData.size());
+    std::vector<uint8_t> blob(indexOffset + indexData.size(), 0);
+    memcpy(blob.data(), &streams, sizeof(streams));
+    memcpy(&blob[vertexOffset], vertexData.data(), vertexData.size());
+    memcpy(&blob[indexOffset], indexData.data(), indexData.size());
+
+    SceneFileMesh entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.size = blob.size();
+    for (int axis = 0; axis < 3; axis++) {
+        entry.boundsMin[axis] = mesh.positions[axis];
+        entry.boundsMax[axis] = mesh.positions[axis];
+    }
+    for (size_t idx = 0; idx < mesh.positions.size(); idx += 3) {
+        for (int axis = 0; axis < 3; axis++) {
+            entry.boundsMin[axis] = std::min(entry.boundsMin[axis], mesh.positions[idx + axis]);
+            entry.boundsMax[axis] = std::max(entry.boundsMax[axis], mesh.positions[idx + axis]);
+        }
+    }
+    meshes->push_back(entry);
+    blobs->push_back(std::vector<uint8_t>());
+    blobs->back().swap(blob);
+}
+
+// Terrain tile of the block: the grid turned into the XZ plane (facing +Y) with rolling hills.
+static MeshData createTerrainTile(int detail, int blockX, int blockZ) {
+    MeshData mesh = createGridMesh(detail, detail);
+    for (size_t idx = 0; idx < mesh.positions.size(); idx += 3) {
+        float x = mesh.positions[idx];
+        float z = -mesh.positions[idx + 1];
+        float worldX = (blockX + x) * 0.7f;
+        float worldZ = (blockZ + z) * 0.7f;
+        float height = 0.015f * (sinf(worldX * 1.3f) * cosf(worldZ * 0.9f) + 0.5f * sinf(worldX * 3.1f + worldZ * 2.3f));
+        mesh.positions[idx] = x;
+        mesh.positions[idx + 1] = height;
+        mesh.positions[idx + 2] = z;
+    }
+    return mesh;
+}
+
+static SceneFileNode makeNode(int parent, int mesh, int material, const float translation[3], const float scale[3],
+                              float yaw) {
+    SceneFileNode node;
+    memset(&node, 0, sizeof(node));
+    node.parent = parent;
+    node.mesh = mesh;
+    node.material = material;
+    memcpy(node.translation, translation, sizeof(node.translation));
+    memcpy(node.scale, scale, sizeof(node.scale));
+    node.rotation[1] = sinf(yaw * 0.5f);
+    node.rotation[3] = cosf(yaw * 0.5f);
+    return node;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Usage: %s <output.scene> [--city N] [--tile-detail N] [--packed]\n", argv[0]);
+        return -1;
+    }
+
+    int citySize = 16;
+    int tileDetail = 32;
+    bool packed = false;
+    for (int idx = 2; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--city") == 0 && idx + 1 < argc) {
+            citySize = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--tile-detail") == 0 && idx + 1 < argc) {
+            tileDetail = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--packed") == 0) {
+            packed = true;
+        } else {
+            printf("Error: unknown or incomplete option '%s'\n", argv[idx]);
+            return -2;
+        }
+    }
+    if (citySize < 1 || citySize > 256 || tileDetail < 1 || tileDetail > 512) {
+        printf("Error: invalid size (valid ranges: --city 1-256, --tile-detail 1-512)\n");
+        return -2;
+    }
+
+    // 1. The materials: ground, building and tree colors.
+    static const SceneFileMaterial materials[] = {
+        { { 0.32f, 0.50f, 0.22f, 1.0f } }, { { 0.40f, 0.52f, 0.25f, 1.0f } },
+        { { 0.47f, 0.42f, 0.30f, 1.0f } }, { { 0.36f, 0.45f, 0.28f, 1.0f } },
+        { { 0.62f, 0.62f, 0.64f, 1.0f } }, { { 0.72f, 0.66f, 0.58f, 1.0f } },
+        { { 0.48f, 0.52f, 0.60f, 1.0f } }, { { 0.80f, 0.78f, 0.74f, 1.0f } },
+        { { 0.16f, 0.42f, 0.14f, 1.0f } }, { { 0.24f, 0.50f, 0.18f, 1.0f } },
+    };
+    const int groundMaterial = 0;
+    const int buildingMaterial = 4;
+    const int treeMaterial = 8;
+
+    // 2. The shared meshes, then a terrain tile per block.
+    std::vector<SceneFileMesh> meshes;
+    std::vector<std::vector<uint8_t> > blobs;
+    const int cubeMesh = 0;
+    const int sphereMesh = 1;
+    addMesh(&meshes, &blobs, createCubeMesh(), packed);
+    MeshData sphere = staticMeshData(staticSphere<StaticVertex, 16, 8>());
+    optimizeMesh(&sphere);
+    addMesh(&meshes, &blobs, sphere, packed);
+
+    // 3. The nodes: the root, the blocks and their children (the parents always come first).
+    std::vector<SceneFileNode> nodes;
+    const float one[3] = { 1.0f, 1.0f, 1.0f };
+    const float origin[3] = { 0.0f, 0.0f, 0.0f };
+    nodes.push_back(makeNode(-1, -1, -1, origin, one, 0.0f));
+    uint32_t random = 12345;
+    for (int blockZ = 0; blockZ < citySize; blockZ++) {
+        for (int blockX = 0; blockX < citySize; blockX++) {
+            int tileMesh = (int)meshes.size();
+            addMesh(&meshes, &blobs, createTerrainTile(tileDetail, blockX, blockZ), packed);
+
+            const float blockPosition[3] = { (blockX - citySize * 0.5f + 0.5f) * blockSize, 0.0f,
+                                             (blockZ - citySize * 0.5f + 0.5f) * blockSize };
+            int block = (int)nodes.size();
+            nodes.push_back(makeNode(0, -1, -1, blockPosition, one, 0.0f));
+
+            const float tileScale[3] = { blockSize, blockSize, blockSize };
+            nodes.push_back(makeNode(block, tileMesh, groundMaterial + (blockX + blockZ) % 4, origin, tileScale, 0.0f));
+
+            // Buildings on a 2x2 lot grid, a tree on the free lots.
+            for (int lot = 0; lot < 4; lot++) {
+                float lotX = ((lot & 1) - 0.5f) * blockSize * 0.45f;
+                float lotZ = ((lot >> 1) - 0.5f) * blockSize * 0.45f;
+                if (randomUnit(&random) < 0.75f) {
+                    float width = 1.5f + 2.0f * randomUnit(&random);
+                    float depth = 1.5f + 2.0f * randomUnit(&random);
+                    float height = 1.0f + 8.0f * randomUnit(&random) * randomUnit(&random);
+                    const float position[3] = { lotX, height * 0.5f, lotZ };
+                    const float scale[3] = { width, height, depth };
+                    int material = buildingMaterial + (int)(randomUnit(&random) * 4) % 4;
+                    nodes.push_back(makeNode(block, cubeMesh, material, position, scale, randomUnit(&random) * 1.5f));
+                } else {
+                    float radius = 0.8f + 0.8f * randomUnit(&random);
+                    const float position[3] = { lotX, radius * 1.2f, lotZ };
+                    const float scale[3] = { radius * 2.0f, radius * 2.0f, radius * 2.0f };
+                    nodes.push_back(makeNode(block, sphereMesh, treeMaterial + lot % 2, position, scale, 0.0f));
+                }
+            }
+        }
+    }
+
+    // 4. Place the tables after the header and the blobs after the tables.
+    SceneFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic));
+    header.version = SCENE_FILE_VERSION;
+    header.nodeCount = nodes.size();
+    header.meshCount = meshes.size();
+    header.materialCount = sizeof(materials) / sizeof(materials[0]);
+    header.nodeOffset = alignOffset(sizeof(header));
+    header.meshOffset = alignOffset(header.nodeOffset + nodes.size() * sizeof(SceneFileNode));
+    header.materialOffset = alignOffset(header.meshOffset + meshes.size() * sizeof(SceneFileMesh));
+    size_t offset = alignOffset(header.materialOffset + header.materialCount * sizeof(SceneFileMaterial));
+    for (size_t idx = 0; idx < meshes.size(); idx++) {
+        meshes[idx].offset = offset;
+        offset = alignOffset(offset + meshes[idx].size);
+    }
+
+    // 5. Write the scene file.
+    std::ofstream file(argv[1], std::ios::out | std::ios::binary);
+    if (!file) {
+        printf("Error: unable to open '%s'\n", argv[1]);
+        return -3;
+    }
+
+    static const char padding[SCENE_FILE_ALIGNMENT] = {};
+    file.write((const char*)&header, sizeof(header));
+    file.write(padding, header.nodeOffset - (size_t)file.tellp());
+    file.write((const char*)nodes.data(), nodes.size() * sizeof(SceneFileNode));
+    file.write(padding, header.meshOffset - (size_t)file.tellp());
+    file.write((const char*)meshes.data(), meshes.size() * sizeof(SceneFileMesh));
+    file.write(padding, header.materialOffset - (size_t)file.tellp());
+    file.write((const char*)materials, sizeof(materials));
+    for (size_t idx = 0; idx < meshes.size(); idx++) {
+        file.write(padding, meshes[idx].offset - (size_t)file.tellp());
+        file.write((const char*)blobs[idx].data(), blobs[idx].size());
+    }
+    size_t fileSize = (size_t)file.tellp();
+    file.close();
+
+    printf("%s: %d nodes, %d meshes, %zu bytes\n", argv[1], (int)nodes.size(), (int)meshes.size(), fileSize);
+    return 0;
+}
@@ -0,0 +1,277 @@
+/**
+ * Offline optimizer of the shaders embedded in a demo source (GLES_OPTIMIZE_SHADERS build option).
+ *
+ * Extracts the complete shaders of a source file: the raw string literals
+ * assigned to a "const char* NAME" which start with a #version line and have
+ * a main function. Every shader goes through the build host tools:
+ *
+ *   glslang        ESSL -> SPIR-V (OpenGL semantics, the uniforms stay outside of blocks)
+ *   spirv-opt -O   constant folding, inlining, dead code and dead branch removal
+ *   spirv-cross    SPIR-V -> ESSL of the original version (names kept from the debug info)
+ *   glslang        validation of the generated ESSL
+ *
+ * The output is a C++ source with the original and the optimized text of every
+ * shader which passed all steps, registered for the program cache
+ * (registerOptimizedShaders in common/program_cache.h). At run time the cached
+ * programs use the optimized text wherever the source matches the original
+ * exactly, so the shaders patched at run time (#define insertions, snippets,
+ * the compute prelude) keep their original source.
+ *
+ * glslang only accepts desktop GLSL for OpenGL SPIR-V: the #version line is
+ * changed to "#version 430" for the SPIR-V step. The desktop path drops the
+ * precision qualifiers, the shaders with a mediump default or an #extension are
+ * kept as they are. Every skipped shader is reported with the failed step.
+ *
+ * Run (the CMake build does this for every add_program target):
+ * $ ./shader_optimize gles_cube.cpp gles_cube_shaders.cpp work_dir \
+ *       --glslang glslang --spirv-opt spirv-opt --spirv-cross spirv-cross
+ *
+ * Dependencies:
+ *  * C++11
+ *  * glslang, SPIRV-Tools and SPIRV-Cross command line tools
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/stat.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Shader {
+    std::string name;
+    std::string source;    // the text of the raw string literal
+    std::string stage;     // glslang stage name: "vert", "frag" or "comp"
+    std::string version;   // ESSL version number: "300", "310" or "320"
+    std::string optimized; // empty if any step failed
+};
+
+struct Tools {
+    const char* glslang;
+    const char* spirvOpt;
+    const char* spirvCross;
+};
+
+static bool readFile(const std::string& path, std::string* text) {
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    *text = stream.str();
+    return true;
+}
+
+static bool writeFile(const std::string& path, const std::string& text) {
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+    if (!file) {
+        printf("Error: unable to write '%s'\n", path.c_str());
+        return false;
+    }
+    file << text;
+    return (bool)file;
+}
+
+// The identifier before the "=" in front of "position" ("" if it is not an assignment).
+static std::string assignedName(const std::string& text, size_t position) {
+    size_t end = position;
+    while (end > 0 && isspace((unsigned char)text[end - 1])) {
+        end--;
+    }
+    if (end == 0 || text[end - 1] != '=') {
+        return "";
+    }
+    end--;
+    while (end > 0 && isspace((unsigned char)text[end - 1])) {
+        end--;
+    }
+
+    size_t start = end;
+    while (start > 0 && (isalnum((unsigned char)text[start - 1]) || text[start - 1] == '_')) {
+        start--;
+    }
+    return text.substr(start, end - start);
+}
+
+// Stage from the name (vertex/fragment/compute) or from the contents.
+static std::string shaderStage(const std::string& name, const std::string& source) {
+    if (name.find("compute") != std::string::npos || source.find("local_size_") != std::string::npos) {
+        return "comp";
+    }
+    if (name.find("vertex") != std::string::npos || source.find("gl_Position") != std::string::npos) {
+        return "vert";
+    }
+    return "frag";
+}
+
+// 1. The complete shaders of the source.
+static std::vector<Shader> extractShaders(const std::string& text) {
+    std::vector<Shader> shaders;
+    size_t position = 0;
+    while ((position = text.find("R\"(", position)) != std::string::npos) {
+        size_t start = position + 3;
+        size_t end = text.find(")\"", start);
+        if (end == std::string::npos) {
+            break;
+        }
+
+        Shader shader;
+        shader.name = assignedName(text, position);
+        shader.source = text.substr(start, end - start);
+        position = end + 2;
+
+        int version = 0;
+        if (shader.name.empty() || sscanf(shader.source.c_str(), "#version %d es", &version) != 1 ||
+            shader.source.find("void main") == std::string::npos) {
+            continue;
+        }
+        shader.version = std::to_string(version);
+        shader.stage = shaderStage(shader.name, shader.source);
+        shaders.push_back(shader);
+    }
+    return shaders;
+}
+
+static std::string quote(const std::string& text) {
+    return "'" + text + "'";
+}
+
+static bool run(const std::string& command) {
+    return system((command + " > /dev/null").c_str()) == 0;
+}
+
+// 2. ESSL -> SPIR-V -> optimized SPIR-V -> ESSL, returns the failed step or NULL.
+static const char* optimizeShader(const Tools& tools, const std::string& workDir, Shader* shader) {
+    if (shader->source.find("precision mediump float") != std::string::npos) {
+        return "mediump default precision";
+    }
+    if (shader->source.find("#extension") != std::string::npos) {
+        return "#extension";
+    }
+
+    std::string base = workDir + "/" + shader->name;
+    std::string desktop = shader->source.substr(shader->source.find('\n'));
+    if (!writeFile(base + ".glsl", "#version 430" + desktop)) {
+        return "write";
+    }
+
+    if (!run(quote(tools.glslang) + " -G --auto-map-locations --auto-map-bindings -S " + shader->stage +
+             " -o " + quote(base + ".spv") + " " + quote(base + ".glsl"))) {
+        return "glslang";
+    }
+    if (!run(quote(tools.spirvOpt) + " -O " + quote(base + ".spv") + " -o " + quote(base + ".opt.spv"))) {
+        return "spirv-opt";
+    }
+    if (!run(quote(tools.spirvCross) + " " + quote(base + ".opt.spv") + " --es --version " + shader->version +
+             " --fs-default-float-precision highp --output " + quote(base + ".opt." + shader->stage))) {
+        return "spirv-cross";
+    }
+    if (!run(quote(tools.glslang) + " -S " + shader->stage + " " + quote(base + ".opt." + shader->stage))) {
+        return "validation";
+    }
+    if (!readFile(base + ".opt." + shader->stage, &shader->optimized)) {
+        return "read";
+    }
+    return NULL;
+}
+
+// 3. The C++ source of the optimized shaders.
+static std::string generateSource(const char* sourcePath, const std::vector<Shader>& shaders) {
+    std::string output = "// Generated by tools/shader_optimize from " + std::string(sourcePath) + ", do not edit.\n"
+                         "#include \"common/program_cache.h\"\n";
+
+    int count = 0;
+    for (const Shader& shader : shaders) {
+        count += shader.optimized.empty() ? 0 : 1;
+    }
+    if (count == 0) {
+        return output;
+    }
+
+    output += "\nstatic const OptimizedShader optimizedShaders[] = {\n";
+    for (const Shader& shader : shaders) {
+        if (!shader.optimized.empty()) {
+            output += "    // " + shader.name + "\n";
+            output += "    { R\"glsl(" + shader.source + ")glsl\",\n";
+            output += "      R\"glsl(" + shader.optimized + ")glsl\" },\n";
+        }
+    }
+    output += "};\n\n";
+    output += "static const bool optimizedShadersRegistered =\n"
+              "    (registerOptimizedShaders(optimizedShaders, " + std::to_string(count) + "), true);\n";
+    return output;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        printf("Usage: %s <source.cpp> <output.cpp> <work dir> [--glslang PATH] [--spirv-opt PATH] [--spirv-cross PATH]\n",
+               argv[0]);
+        return -1;
+    }
+
+    Tools tools = { "glslang", "spirv-opt", "spirv-cross" };
+    for (int idx = 4; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--glslang") == 0 && idx + 1 < argc) {
+            tools.glslang = argv[++idx];
+        } else if (strcmp(argv[idx], "--spirv-opt") == 0 && idx + 1 < argc) {
+            tools.spirvOpt = argv[++idx];
+        } else if (strcmp(argv[idx], "--spirv-cross") == 0 && idx + 1 < argc) {
+            tools.spirvCross = argv[++idx];
+        } else {
+            printf("Error: unknown option '%s'\n", argv[idx]);
+            return -1;
+        }
+    }
+
+    std::string text;
+    if (!readFile(argv[1], &text)) {
+        printf("Error: unable to read '%s'\n", argv[1]);
+        return -1;
+    }
+
+    std::vector<Shader> shaders = extractShaders(text);
+    mkdir(argv[3], 0755);
+
+    int optimized = 0;
+    for (Shader& shader : shaders) {
+        const char* failed = optimizeShader(tools, argv[3], &shader);
+        if (failed != NULL) {
+            printf("shader_optimize: %s: '%s' kept (%s)\n", argv[1], shader.name.c_str(), failed);
+            shader.optimized.clear();
+        } else {
+            optimized++;
+        }
+    }
+
+    if (!writeFile(argv[2], generateSource(argv[1], shaders))) {
+        return -1;
+    }
+    printf("shader_optimize: %s: %d of %d shaders optimized\n", argv[1], optimized, (int)shaders.size());
+    return 0;
+}
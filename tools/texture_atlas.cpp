@@ -0,0 +1,282 @@
+/**
+ * Offline texture atlas builder (see common/texture_atlas.h for the format).
+ *
+ * Decodes the images (anything stb_image can load), packs them into the
+ * layers of an array texture with a shelf packer (tallest images first),
+ * fills the gutter around every image with its edge pixels and builds the
+ * mip levels of the layers with a 2x2 box filter. The images are flipped
+ * vertically to match the GL texture coordinate system.
+ *
+ * Options (processed in order, "--split" applies to the images after it):
+ *  --layer-size N           Width and height of the layers (default: 512).
+ *  --gutter N               Edge pixels around the images, a power of two (default: 8),
+ *                           the atlas has log2(N) + 1 mip levels.
+ *  --split N                Split the images into NxN tiles, named NAME_0 .. NAME_(N*N-1)
+ *                           in row order from the bottom left (default: 1, no split).
+ *  --image NAME FILE        Add an image.
+ *
+ * Compile:
+ * $ g++ -I.. texture_atlas.cpp ../common/image_convert.cpp -o texture_atlas
+ *
+ * Run:
+ * $ ./texture_atlas demo_textures.atlas --image kitten kitten_10.jpg --split 4 --image tile kitten_10.jpg
+ *
+ * Dependencies:
+ *  * C++11
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "common/stb_image.h"
+
+#include "common/image_convert.h"
+#include "common/texture_atlas.h"
+
+struct Image {
+    AtlasEntry entry;
+    int sourceIndex; // in "sources"
+    int sourceX;
+    int sourceY;
+};
+
+struct Source {
+    int width;
+    int height;
+    std::vector<uint8_t> pixels; // RGBA8
+};
+
+static bool loadImage(const char* path, Source* source) {
+    stbi_set_flip_vertically_on_load(true);
+    int channels;
+    uint8_t* data = stbi_load(path, &source->width, &source->height, &channels, 4);
+    if (data == NULL) {
+        printf("Error: unable to load '%s': %s\n", path, stbi_failure_reason());
+        return false;
+    }
+    source->pixels.assign(data, data + (size_t)source->width * source->height * 4);
+    stbi_image_free(data);
+    return true;
+}
+
+static bool addImages(std::vector<Image>* images, const char* name, int sourceIndex, const Source& source, int split) {
+    if (strlen(name) + 8 >= ATLAS_NAME_SIZE) {
+        printf("Error: the image name '%s' is longer than %d characters\n", name, ATLAS_NAME_SIZE - 9);
+        return false;
+    }
+    if (source.width < split || source.height < split) {
+        printf("Error: the image '%s' is smaller than its %dx%d tiles\n", name, split, split);
+        return false;
+    }
+
+    // The last row/column of tiles gets the remainder of the size.
+    int tileWidth = source.width / split;
+    int tileHeight = source.height / split;
+    for (int ty = 0; ty < split; ty++) {
+        for (int tx = 0; tx < split; tx++) {
+            Image image;
+            memset(&image.entry, 0, sizeof(image.entry));
+            if (split == 1) {
+                strcpy(image.entry.name, name);
+            } else {
+                snprintf(image.entry.name, ATLAS_NAME_SIZE, "%s_%d", name, ty * split + tx);
+            }
+            image.entry.width = tx + 1 < split ? tileWidth : source.width - tx * tileWidth;
+            image.entry.height = ty + 1 < split ? tileHeight : source.height - ty * tileHeight;
+            image.sourceIndex = sourceIndex;
+            image.sourceX = tx * tileWidth;
+            image.sourceY = ty * tileHeight;
+            images->push_back(image);
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        printf("Usage: %s <output.atlas> [--layer-size N] [--gutter N] [--split N] --image NAME FILE ...\n", argv[0]);
+        return -1;
+    }
+
+    // 1. Collect the images.
+    std::vector<Source> sources;
+    std::vector<Image> images;
+    int layerSize = 512;
+    int gutter = 8;
+    int split = 1;
+    for (int idx = 2; idx < argc; idx++) {
+        bool added = true;
+        if (strcmp(argv[idx], "--layer-size") == 0 && idx + 1 < argc) {
+            layerSize = atoi(argv[++idx]);
+            if (layerSize < 16 || layerSize > 4096) {
+                printf("Error: invalid layer size (valid range: 16-4096)\n");
+                added = false;
+            }
+        } else if (strcmp(argv[idx], "--gutter") == 0 && idx + 1 < argc) {
+            gutter = atoi(argv[++idx]);
+            if (gutter < 1 || gutter > 64 || (gutter & (gutter - 1)) != 0) {
+                printf("Error: the gutter must be a power of two (valid range: 1-64)\n");
+                added = false;
+            }
+        } else if (strcmp(argv[idx], "--split") == 0 && idx + 1 < argc) {
+            split = atoi(argv[++idx]);
+            if (split < 1 || split > 64) {
+                printf("Error: invalid split count (valid range: 1-64)\n");
+                added = false;
+            }
+        } else if (strcmp(argv[idx], "--image") == 0 && idx + 2 < argc) {
+            sources.push_back(Source());
+            added = loadImage(argv[idx + 2], &sources.back())
+                 && addImages(&images, argv[idx + 1], (int)sources.size() - 1, sources.back(), split);
+            idx += 2;
+        } else {
+            printf("Error: unknown or incomplete option '%s'\n", argv[idx]);
+            added = false;
+        }
+
+        if (!added) {
+            return -2;
+        }
+    }
+
+    if (images.empty()) {
+        printf("Error: no images\n");
+        return -2;
+    }
+
+    // 2. Shelf packing, the tallest images first. The cells (image and gutter) are aligned to the
+    //    texel grid of the last mip level: a texel of any level belongs to one image only.
+    int levelCount = 1;
+    while ((1 << (levelCount - 1)) < gutter) {
+        levelCount++;
+    }
+    int align = 1 << (levelCount - 1);
+
+    std::vector<int> order(images.size());
+    for (size_t idx = 0; idx < images.size(); idx++) {
+        order[idx] = (int)idx;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&images](int a, int b) { return images[a].entry.height > images[b].entry.height; });
+
+    int layerCount = 1;
+    int shelfX = 0;
+    int shelfY = 0;
+    int shelfHeight = 0;
+    for (int imageIdx : order) {
+        AtlasEntry& entry = images[imageIdx].entry;
+        int cellWidth = (entry.width + 2 * gutter + align - 1) / align * align;
+        int cellHeight = (entry.height + 2 * gutter + align - 1) / align * align;
+        if (cellWidth > layerSize || cellHeight > layerSize) {
+            printf("Error: the image '%s' (%ux%u) does not fit into a %dx%d layer\n", entry.name, entry.width,
+                   entry.height, layerSize, layerSize);
+            return -2;
+        }
+
+        if (shelfX + cellWidth > layerSize) {
+            // Next shelf, or next layer if the shelf doesn't fit.
+            shelfX = 0;
+            shelfY += shelfHeight;
+            shelfHeight = 0;
+        }
+        if (shelfY + cellHeight > layerSize) {
+            layerCount++;
+            shelfX = 0;
+            shelfY = 0;
+            shelfHeight = 0;
+        }
+
+        entry.layer = layerCount - 1;
+        entry.x = shelfX + gutter;
+        entry.y = shelfY + gutter;
+        shelfX += cellWidth;
+        shelfHeight = std::max(shelfHeight, cellHeight);
+    }
+
+    // 3. Copy the images into the layers, the gutter repeats the edge pixels (clamped coords).
+    TextureAtlasHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TEXTURE_ATLAS_MAGIC, sizeof(header.magic));
+    header.version = TEXTURE_ATLAS_VERSION;
+    header.width = layerSize;
+    header.height = layerSize;
+    header.layerCount = layerCount;
+    header.levelCount = levelCount;
+    header.entryCount = images.size();
+
+    size_t layerBytes = atlasLevelSize(header, 0);
+    std::vector<std::vector<uint8_t>> levels(1, std::vector<uint8_t>(layerBytes * layerCount, 0));
+    for (const Image& image : images) {
+        const AtlasEntry& entry = image.entry;
+        const Source& source = sources[image.sourceIndex];
+        uint8_t* layer = &levels[0][layerBytes * entry.layer];
+        for (int y = -gutter; y < (int)entry.height + gutter; y++) {
+            int sy = image.sourceY + std::min(std::max(y, 0), (int)entry.height - 1);
+            for (int x = -gutter; x < (int)entry.width + gutter; x++) {
+                int sx = image.sourceX + std::min(std::max(x, 0), (int)entry.width - 1);
+                memcpy(&layer[((size_t)(entry.y + y) * layerSize + entry.x + x) * 4],
+                       &source.pixels[((size_t)sy * source.width + sx) * 4], 4);
+            }
+        }
+    }
+
+    // 4. The mip levels of every layer.
+    for (int level = 1; level < levelCount; level++) {
+        size_t srcBytes = atlasLevelSize(header, level - 1);
+        size_t dstBytes = atlasLevelSize(header, level);
+        int srcSize = std::max(layerSize >> (level - 1), 1);
+        levels.push_back(std::vector<uint8_t>(dstBytes * layerCount));
+        for (int layer = 0; layer < layerCount; layer++) {
+            downsampleRGBA8(&levels[level][dstBytes * layer], 0, std::max(srcSize / 2, 1),
+                            &levels[level - 1][srcBytes * layer], srcSize, srcSize);
+        }
+    }
+
+    // 5. Write the atlas.
+    std::ofstream file(argv[1], std::ios::out | std::ios::binary);
+    if (!file) {
+        printf("Error: unable to open '%s'\n", argv[1]);
+        return -3;
+    }
+
+    file.write((const char*)&header, sizeof(header));
+    for (const Image& image : images) {
+        file.write((const char*)&image.entry, sizeof(AtlasEntry));
+    }
+    for (const std::vector<uint8_t>& level : levels) {
+        file.write((const char*)level.data(), level.size());
+    }
+    size_t fileSize = (size_t)file.tellp();
+    file.close();
+
+    printf("%s: %d images in %d %dx%d layers, %d levels, %zu bytes\n", argv[1], (int)images.size(), layerCount,
+           layerSize, layerSize, levelCount, fileSize);
+    return 0;
+}
@@ -0,0 +1,239 @@
+/**
+ * Offline virtual texture tiler (see common/virtual_texture.h for the format).
+ *
+ * Decodes an image (anything stb_image can load) or generates a procedural
+ * test pattern of any size, builds its mip pyramid with a 2x2 box filter and
+ * cuts every level into 128x128 pages: 120x120 texels with a 4 texel border
+ * (the neighbour texels or the repeated edge of the image). The tiles outside
+ * of the image are not stored.
+ *
+ * The source image and its levels are in the memory during the tiling (the
+ * renderer only needs the tiles of the view): a 16384x16384 image needs
+ * about 1.4 GB.
+ *
+ * Dependencies:
+ *  * C++11
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "common/stb_image.h"
+
+#include "common/image_convert.h"
+#include "common/virtual_texture.h"
+
+struct Level {
+    int width;
+    int height;
+    std::vector<uint8_t> pixels; // RGBA8, rows from the bottom
+};
+
+static bool loadImage(const char* path, Level* level) {
+    stbi_set_flip_vertically_on_load(true);
+    int channels;
+    uint8_t* data = stbi_load(path, &level->width, &level->height, &channels, 4);
+    if (data == NULL) {
+        printf("Error: unable to load '%s': %s\n", path, stbi_failure_reason());
+        return false;
+    }
+    level->pixels.assign(data, data + (size_t)level->width * level->height * 4);
+    stbi_image_free(data);
+    return true;
+}
+
+// Test pattern with details at every scale: 4096, 512, 64 and 8 texel grids over a color gradient.
+static void generatePattern(Level* level, int size) {
+    level->width = size;
+    level->height = size;
+    level->pixels.resize((size_t)size * size * 4);
+
+    for (int y = 0; y < size; y++) {
+        uint8_t* row = &level->pixels[(size_t)y * size * 4];
+        for (int x = 0; x < size; x++) {
+            int r = 64 + x * 160 / size;
+            int g = 64 + y * 160 / size;
+            int b = (((x >> 9) ^ (y >> 9)) & 1) ? 176 : 80;
+
+            if (((x >> 3) ^ (y >> 3)) & 1) {
+                r -= 24;
+                g -= 24;
+                b -= 24;
+            }
+            if ((x & 63) < 2 || (y & 63) < 2) {
+                r = g = b = 32;
+            }
+            if ((x & 511) < 6 || (y & 511) < 6) {
+                r = g = b = 240;
+            }
+            if ((x & 4095) < 24 || (y & 4095) < 24) {
+                r = 240;
+                g = b = 32;
+            }
+
+            row[x * 4 + 0] = (uint8_t)r;
+            row[x * 4 + 1] = (uint8_t)g;
+            row[x * 4 + 2] = (uint8_t)b;
+            row[x * 4 + 3] = 255;
+        }
+    }
+}
+
+// Copy a tile with its border, the texels outside of the level repeat its edge.
+static void cutTile(uint8_t* tile, const Level& level, int tileX, int tileY) {
+    for (int py = 0; py < VT_TILE_SIZE; py++) {
+        int sy = tileY * VT_TILE_CONTENT - VT_TILE_BORDER + py;
+        sy = sy < 0 ? 0 : (sy >= level.height ? level.height - 1 : sy);
+
+        for (int px = 0; px < VT_TILE_SIZE; px++) {
+            int sx = tileX * VT_TILE_CONTENT - VT_TILE_BORDER + px;
+            sx = sx < 0 ? 0 : (sx >= level.width ? level.width - 1 : sx);
+
+            memcpy(&tile[(py * VT_TILE_SIZE + px) * 4], &level.pixels[((size_t)sy * level.width + sx) * 4], 4);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        printf("Usage: %s <output.vtex> (--image FILE | --procedural SIZE)\n", argv[0]);
+        return -1;
+    }
+
+    Level source;
+    source.width = 0;
+    for (int idx = 2; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--image") == 0 && idx + 1 < argc) {
+            if (!loadImage(argv[++idx], &source)) {
+                return -2;
+            }
+        } else if (strcmp(argv[idx], "--procedural") == 0 && idx + 1 < argc) {
+            int size = atoi(argv[++idx]);
+            if (size < 1 || size > 256 * VT_TILE_CONTENT) {
+                printf("Error: invalid procedural size (valid range: 1-%d)\n", 256 * VT_TILE_CONTENT);
+                return -2;
+            }
+            generatePattern(&source, size);
+        } else {
+            printf("Error: unknown or incomplete option '%s'\n", argv[idx]);
+            return -2;
+        }
+    }
+
+    if (source.width == 0) {
+        printf("Error: no image\n");
+        return -2;
+    }
+
+    // 1. Level 0: a power of two tiles per side which cover the image.
+    VirtualTextureHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, VIRTUAL_TEXTURE_MAGIC, sizeof(header.magic));
+    header.version = VIRTUAL_TEXTURE_VERSION;
+    header.width = source.width;
+    header.height = source.height;
+    header.tiles = 1;
+    header.levelCount = 1;
+
+    int largest = source.width > source.height ? source.width : source.height;
+    while ((int)header.tiles * VT_TILE_CONTENT < largest) {
+        header.tiles *= 2;
+        header.levelCount++;
+    }
+    if (header.levelCount > VT_MAX_LEVELS) {
+        printf("Error: the image (%dx%d) is larger than %dx%d\n", source.width, source.height,
+               256 * VT_TILE_CONTENT, 256 * VT_TILE_CONTENT);
+        return -2;
+    }
+    header.tileCount = virtualTextureTileIndex(header, header.levelCount - 1, 0, 0) + 1;
+
+    // 2. Mip levels of the image.
+    std::vector<Level> levels(header.levelCount);
+    levels[0] = source;
+    source.pixels.clear();
+    source.pixels.shrink_to_fit();
+    for (uint32_t level = 1; level < header.levelCount; level++) {
+        const Level& prev = levels[level - 1];
+        Level& next = levels[level];
+        next.width = prev.width > 1 ? prev.width / 2 : 1;
+        next.height = prev.height > 1 ? prev.height / 2 : 1;
+        next.pixels.resize((size_t)next.width * next.height * 4);
+        downsampleRGBA8(next.pixels.data(), 0, next.height, prev.pixels.data(), prev.width, prev.height);
+    }
+
+    // 3. Tile offsets: the tiles which have texels of the image, after the table.
+    std::vector<uint64_t> offsets(header.tileCount, 0);
+    uint64_t tableEnd = sizeof(header) + offsets.size() * sizeof(uint64_t);
+    uint64_t offset = (tableEnd + VT_TILE_BYTES - 1) / VT_TILE_BYTES * VT_TILE_BYTES;
+    uint32_t storedCount = 0;
+    for (uint32_t level = 0; level < header.levelCount; level++) {
+        int side = header.tiles >> level;
+        for (int ty = 0; ty < side; ty++) {
+            for (int tx = 0; tx < side; tx++) {
+                if (tx * VT_TILE_CONTENT < levels[level].width && ty * VT_TILE_CONTENT < levels[level].height) {
+                    offsets[virtualTextureTileIndex(header, level, tx, ty)] = offset;
+                    offset += VT_TILE_BYTES;
+                    storedCount++;
+                }
+            }
+        }
+    }
+
+    // 4. Write the header, the table and the tiles in the same order.
+    std::ofstream file(argv[1], std::ios::out | std::ios::binary);
+    if (!file) {
+        printf("Error: unable to open '%s'\n", argv[1]);
+        return -3;
+    }
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)offsets.data(), offsets.size() * sizeof(uint64_t));
+    std::vector<uint8_t> tile(VT_TILE_BYTES, 0);
+    file.write((const char*)tile.data(), (offsets.size() ? offsets[0] : tableEnd) - tableEnd);
+
+    for (uint32_t level = 0; level < header.levelCount; level++) {
+        int side = header.tiles >> level;
+        for (int ty = 0; ty < side; ty++) {
+            for (int tx = 0; tx < side; tx++) {
+                if (offsets[virtualTextureTileIndex(header, level, tx, ty)] != 0) {
+                    cutTile(tile.data(), levels[level], tx, ty);
+                    file.write((const char*)tile.data(), tile.size());
+                }
+            }
+        }
+    }
+
+    if (!file) {
+        printf("Error: unable to write '%s'\n", argv[1]);
+        return -3;
+    }
+
+    printf("%s: %ux%u image, %u levels, %u of %u tiles, %llu bytes\n", argv[1], header.width, header.height,
+           header.levelCount, storedCount, header.tileCount, (unsigned long long)offset);
+    return 0;
+}
@@ -0,0 +1,1056 @@
+/**
+ * GL ES micro-benchmark suite with JSON output ("glesbench").
+ *
+ * Every benchmark of the table below measures one part of the driver/GPU:
+ *
+ *  draw_calls            Cube draws (common/mesh.h) with a uniform change each, into a few pixels.
+ *  vertex_fetch          A 512x512 quad grid mesh (position + texture coords) drawn into a few pixels.
+ *  vertex_fetch_packed   A 255x255 quad grid in the packed format, generated at compile time (common/static_mesh.h).
+ *  vertex_normal_float   A wavy 512x512 quad grid with float positions, normals and texture coords (32 bytes/vertex).
+ *  vertex_normal_quant   The same grid quantized (common/mesh_quantize.h, 12 bytes/vertex), decoded by the shader.
+ *  fill_rate             Full-screen triangles with a constant colour, no blending.
+ *  fill_rate_blend       The same with alpha blending (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA).
+ *  texture_sampling      Full-screen triangles sampling a mipmapped RGBA8 texture (one texel per pixel).
+ *  shading_highp         Full-screen triangles with 8 lights (diffuse + specular) per pixel in a highp fragment shader.
+ *  shading_mediump       The same shader in mediump (common/shader_precision.h), the setup prints the
+ *                        precision formats and the difference of the mediump image from the highp one.
+ *  fbo_blit              glBlitFramebuffer between two RGBA8 framebuffers of the framebuffer size.
+ *  compute_latency       One-invocation dispatch followed by glFinish (round trip time).
+ *  compute_throughput    Back to back dispatches of 4096 invocations (common/compute.h kernels).
+ *  buffer_upload         glBufferSubData of 16 MiB.
+ *  buffer_readback       glMapBufferRange (read) of 16 MiB written by the GPU.
+ *  texture_upload        glTexSubImage2D of a 1024x1024 RGBA8 texture.
+ *  read_pixels           glReadPixels of the RGBA8 framebuffer.
+ *  stream_MODE_SIZE      Streaming uploads through common/stream_buffer.h with each upload mode
+ *                        (ring, invalidate, orphan, sub_data): frames of 256 allocations of 256 B,
+ *                        16 of 16 KB or 1 of 4 MB, each one read by the GPU (a buffer copy).
+ *
+ * Measurement: a calibration run sizes the trials to about "--trial-ms"
+ * milliseconds, then "--warmup" trials are dropped and "--trials" trials are
+ * measured. A trial is timed with the wall clock between two glFinish calls,
+ * so it covers the CPU and the GPU side of the work. The value of a trial is
+ * the amount of work per second (ex.: Gpixels/s) or, for the latency
+ * benchmarks, the time per work item (lower is better).
+ *
+ * The suite always runs headless ("--headless" is added unless
+ * "--surfaceless" is given), the framebuffer is the offscreen FBO of the
+ * demo context ("--size WxH").
+ *
+ * Run:
+ * $ ./glesbench --json results.json
+ * $ ./glesbench --surfaceless --filter fill --trials 10
+ *
+ * Options (and the options of the demo context):
+ *  --list          Print the benchmark names and exit.
+ *  --filter TEXT   Only run the benchmarks whose name contains TEXT (can be repeated).
+ *  --trials N      Measured trials per benchmark (default: 5).
+ *  --warmup N      Dropped trials before the measured ones (default: 1).
+ *  --trial-ms MS   Target duration of a trial (default: 50).
+ *  --json FILE     Write the results as JSON (default: glesbench.json, "-": standard output,
+ *                  everything else is printed to the standard error then).
+ *
+ * JSON output:
+ *
+ *   { "renderer": ..., "vendor": ..., "version": ..., "width": W, "height": H,
+ *     "benchmarks": [ { "name": ..., "unit": ..., "higher_is_better": true,
+ *                       "iterations": N, "trials": [ ... ],
+ *                       "median": M, "mean": M, "min": M, "max": M, "stddev": S }, ... ] }
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.1+ (the compute benchmarks)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <GLES3/gl31.h>
+
+#include "common/compute.h"
+#include "common/demo_context.h"
+#include "common/gl_state.h"
+#include "common/mesh.h"
+#include "common/mesh_quantize.h"
+#include "common/program_cache.h"
+#include "common/shader_precision.h"
+#include "common/static_mesh.h"
+#include "common/stream_buffer.h"
+
+// Geometry benchmarks: the cube and the grid mesh with an offset/scale uniform.
+const char* mesh_vertex_src = R"(#version 300 es
+precision highp float;
+
+in vec3 aPos;
+in vec2 aTexCoord;
+out vec2 texCoord;
+
+uniform vec4 uTransform; // xy: offset, z: scale
+
+void main() {
+    gl_Position = vec4(aPos.xy * uTransform.z + uTransform.xy, 0.0, 1.0);
+    texCoord = aTexCoord;
+}
+)";
+
+const char* mesh_fragment_src = R"(#version 300 es
+precision mediump float;
+
+in vec2 texCoord;
+out vec4 outColor;
+
+void main() {
+    outColor = vec4(texCoord, 0.5, 1.0);
+}
+)";
+
+// Vertex formats with normals: the float version and the quantized one (dequantized by uModel).
+const char* normal_float_vertex_src = R"(#version 300 es
+precision highp float;
+
+in vec3 aNormal;
+#define NORMAL aNormal
+)";
+
+const char* normal_quantized_vertex_src = R"(#version 300 es
+precision highp float;
+
+in vec2 aNormal;
+#define NORMAL octahedralDecode(aNormal)
+)";
+
+const char* normal_vertex_main_src = R"(
+in vec3 aPos;
+in vec2 aTexCoord;
+out vec2 texCoord;
+
+uniform mat4 uModel;
+uniform vec4 uTransform; // xy: offset, z: scale
+
+void main() {
+    vec4 position = uModel * vec4(aPos, 1.0);
+    gl_Position = vec4(position.xy * uTransform.z + uTransform.xy, 0.0, 1.0);
+    texCoord = aTexCoord + NORMAL.xy * 0.5;
+}
+)";
+
+// Full-screen triangle without vertex attributes.
+const char* fullscreen_vertex_src = R"(#version 300 es
+precision highp float;
+
+out vec2 texCoord;
+
+void main() {
+    vec2 position = vec2(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1));
+    gl_Position = vec4(position, 0.0, 1.0);
+    texCoord = position * 0.5 + 0.5;
+}
+)";
+
+const char* color_fragment_src = R"(#version 300 es
+precision mediump float;
+
+out vec4 outColor;
+
+uniform vec4 uColor;
+
+void main() {
+    outColor = uColor;
+}
+)";
+
+const char* texture_fragment_src = R"(#version 300 es
+precision mediump float;
+
+in vec2 texCoord;
+out vec4 outColor;
+
+uniform sampler2D uTexture;
+uniform vec2 uScale; // framebuffer size / texture size: one texel per pixel
+
+void main() {
+    outColor = texture(uTexture, texCoord * uScale);
+}
+)";
+
+// ALU bound shading: a lit sphere normal per pixel, 8 directional lights with diffuse and specular terms.
+/* Written in highp, the mediump variant comes from common/shader_precision.h. */
+const char* shading_fragment_src = R"(#version 300 es
+precision highp float;
+
+in vec2 texCoord;
+out vec4 outColor;
+
+uniform vec4 uLights[8]; // xyz: direction, w: intensity
+
+void main() {
+    vec2 p = texCoord * 2.0 - 1.0;
+    vec3 normal = normalize(vec3(p, sqrt(max(1.0 - dot(p, p), 0.0)) + 0.1));
+
+    vec3 color = vec3(0.05);
+    for (int idx = 0; idx < 8; idx++) {
+        vec3 light = normalize(uLights[idx].xyz);
+        vec3 halfway = normalize(light + vec3(0.0, 0.0, 1.0));
+        float diffuse = max(dot(normal, light), 0.0);
+        float specular = pow(max(dot(normal, halfway), 0.0), 32.0);
+        color += uLights[idx].w * (diffuse * vec3(0.6, 0.5, 0.4) + specular);
+    }
+    outColor = vec4(color / (1.0 + color), 1.0);
+}
+)";
+
+// Compute benchmarks: every invocation writes its index.
+const char* compute_src = R"(#version 310 es
+layout(std430, binding = 0) writeonly buffer Values { uint values[]; };
+
+void main() {
+    int idx = GLOBAL_INDEX;
+    if (idx < uGridSize.x) {
+        values[idx] = uint(idx);
+    }
+}
+)";
+
+struct BenchContext {
+    int width;
+    int height;
+    unsigned int framebuffer;
+};
+
+struct Benchmark {
+    const char* name;
+    const char* unit;
+    // Work per reported unit (ex.: 1e9 for Gpixels/s), for the latencies: reported units per second (1e6 for us).
+    double unitScale;
+    bool latency; // report the time per work item instead of the work per second
+
+    // Create the resources, returns NULL if the benchmark is not supported.
+    void* (*setup)(const BenchContext* context);
+    // Issue "iterations" times the work, returns the amount of work (the framework waits with glFinish).
+    double (*run)(void* state, int iterations);
+    void (*teardown)(void* state);
+};
+
+struct BenchResult {
+    const Benchmark* benchmark;
+    int iterations;
+    std::vector<double> trials;
+    double median;
+    double mean;
+    double min;
+    double max;
+    double stddev;
+};
+
+static unsigned int createTexture(int width, int height, int levels) {
+    std::vector<uint8_t> pixels((size_t)width * height * 4);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t* pixel = &pixels[((size_t)y * width + x) * 4];
+            pixel[0] = (uint8_t)x;
+            pixel[1] = (uint8_t)y;
+            pixel[2] = (uint8_t)((x ^ y) * 7);
+            pixel[3] = 255;
+        }
+    }
+
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, width, height);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    if (levels > 1) {
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+static unsigned int createTextureFramebuffer(unsigned int texture) {
+    unsigned int fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return fbo;
+}
+
+static bool hasCompute() {
+    int major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    return major > 3 || (major == 3 && minor >= 1);
+}
+
+// B.1. Draw calls and vertex fetch: a mesh drawn "drawsPerIteration" times into a few pixels.
+struct MeshBench {
+    unsigned int program;
+    int transformLoc;
+    MeshBuffers mesh;
+    int drawsPerIteration;
+};
+
+static MeshBench* setupMeshBench(const MeshData& data, int drawsPerIteration) {
+    MeshBench* bench = new MeshBench();
+    bench->program = createCachedProgram(mesh_vertex_src, mesh_fragment_src);
+    bench->transformLoc = glGetUniformLocation(bench->program, "uTransform");
+    bench->mesh = uploadMesh(data, false, glGetAttribLocation(bench->program, "aPos"),
+                             glGetAttribLocation(bench->program, "aTexCoord"));
+    bench->drawsPerIteration = drawsPerIteration;
+    return bench;
+}
+
+static void* setupDrawCalls(const BenchContext*) {
+    return setupMeshBench(createCubeMesh(), 1000);
+}
+
+static void* setupVertexFetch(const BenchContext*) {
+    return setupMeshBench(createGridMesh(512, 512), 1);
+}
+
+// Grid of 255x255 quads generated at compile time in the packed format, in row order (see common/static_mesh.h).
+static void* setupVertexFetchPacked(const BenchContext*) {
+    static constexpr auto grid = staticGrid<StaticPackedVertex, 255, 255>();
+
+    MeshBench* bench = new MeshBench();
+    bench->program = createCachedProgram(mesh_vertex_src, mesh_fragment_src);
+    bench->transformLoc = glGetUniformLocation(bench->program, "uTransform");
+    bench->mesh = uploadPackedMesh(staticMeshStreams(grid), grid.vertices, grid.indices,
+                                   glGetAttribLocation(bench->program, "aPos"),
+                                   glGetAttribLocation(bench->program, "aTexCoord"));
+    bench->drawsPerIteration = 1;
+    return bench;
+}
+
+// Wavy grid for the vertex formats with normals: every normal and position differs.
+static MeshData createWaveGrid(std::vector<float>* normals) {
+    MeshData data = createGridMesh(512, 512);
+    for (size_t idx = 0; idx < data.positions.size(); idx += 3) {
+        data.positions[idx + 2] = 0.05f * sinf(data.positions[idx] * 40.0f) * cosf(data.positions[idx + 1] * 40.0f);
+    }
+    *normals = computeMeshNormals(data);
+    return data;
+}
+
+static MeshBench* setupNormalMeshBench(bool quantized) {
+    std::vector<float> normals;
+    MeshData data = createWaveGrid(&normals);
+
+    MeshBench* bench = new MeshBench();
+    std::string vertexSrc = quantized ? std::string(normal_quantized_vertex_src) + octahedralDecodeSrc
+                                      : std::string(normal_float_vertex_src);
+    vertexSrc += normal_vertex_main_src;
+    bench->program = createCachedProgram(vertexSrc.c_str(), mesh_fragment_src);
+    bench->transformLoc = glGetUniformLocation(bench->program, "uTransform");
+    int positionLoc = glGetAttribLocation(bench->program, "aPos");
+    int normalLoc = glGetAttribLocation(bench->program, "aNormal");
+    int texCoordLoc = glGetAttribLocation(bench->program, "aTexCoord");
+    bench->drawsPerIteration = 1;
+
+    /* The model matrix is the identity: the quantized mesh only needs the dequantization. */
+    float model[16] = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 };
+    int vertexCount = (int)data.positions.size() / 3;
+    if (quantized) {
+        QuantizedMesh mesh = quantizeMesh(data, normals);
+        meshDequantizationMatrix(mesh, model);
+        bench->mesh = uploadQuantizedMesh(mesh, positionLoc, normalLoc, texCoordLoc);
+        printf("  quantized: %d bytes/vertex, max position error: %.2g (grid size: 1), max normal error: %.2f deg\n",
+               bench->mesh.vertexBufferSize / vertexCount, mesh.maxPositionError, mesh.maxNormalError);
+    } else {
+        bench->mesh = uploadMeshWithNormals(data, normals, positionLoc, normalLoc, texCoordLoc);
+    }
+    printf("  %d vertices, %.2f MiB vertex data, %d indices\n", vertexCount,
+           bench->mesh.vertexBufferSize / (1024.0 * 1024.0), bench->mesh.indexCount);
+
+    glUseProgram(bench->program);
+    glUniformMatrix4fv(glGetUniformLocation(bench->program, "uModel"), 1, GL_FALSE, model);
+    glUseProgram(0);
+    return bench;
+}
+
+static void* setupVertexNormalFloat(const BenchContext*) {
+    return setupNormalMeshBench(false);
+}
+
+static void* setupVertexNormalQuantized(const BenchContext*) {
+    return setupNormalMeshBench(true);
+}
+
+static void drawMesh(MeshBench* bench, int iterations) {
+    glUseProgram(bench->program);
+    glBindVertexArray(bench->mesh.vao);
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        for (int idx = 0; idx < bench->drawsPerIteration; idx++) {
+            /* A different uniform value per draw: the driver can't skip the state validation. */
+            float offset = (idx % 16) * 0.001f - 0.99f;
+            glUniform4f(bench->transformLoc, offset, -0.99f, 0.004f, 0.0f);
+            glDrawElements(GL_TRIANGLES, bench->mesh.indexCount, bench->mesh.indexType, NULL);
+        }
+    }
+    glBindVertexArray(0);
+}
+
+static double runDrawCalls(void* state, int iterations) {
+    MeshBench* bench = (MeshBench*)state;
+    drawMesh(bench, iterations);
+    return (double)iterations * bench->drawsPerIteration;
+}
+
+static double runVertexFetch(void* state, int iterations) {
+    MeshBench* bench = (MeshBench*)state;
+    drawMesh(bench, iterations);
+    /* Every index is a vertex fetch (minus the post-transform cache hits). */
+    return (double)iterations * bench->mesh.indexCount;
+}
+
+static void teardownMeshBench(void* state) {
+    MeshBench* bench = (MeshBench*)state;
+    destroyMeshBuffers(&bench->mesh);
+    glDeleteProgram(bench->program);
+    delete bench;
+}
+
+// B.2. Fill rate and texture sampling: full-screen triangles.
+struct FillBench {
+    unsigned int program;
+    unsigned int texture;
+    bool blend;
+    int pixels;
+};
+
+// Layers drawn per iteration.
+static const int fillLayers = 8;
+
+static FillBench* setupFill(const BenchContext* context, bool blend) {
+    FillBench* bench = new FillBench();
+    bench->program = createCachedProgram(fullscreen_vertex_src, color_fragment_src);
+    bench->texture = 0;
+    bench->blend = blend;
+    bench->pixels = context->width * context->height;
+
+    glUseProgram(bench->program);
+    glUniform4f(glGetUniformLocation(bench->program, "uColor"), 0.2f, 0.4f, 0.8f, 0.5f);
+    return bench;
+}
+
+static void* setupFillRate(const BenchContext* context) {
+    return setupFill(context, false);
+}
+
+static void* setupFillRateBlend(const BenchContext* context) {
+    return setupFill(context, true);
+}
+
+static void* setupTextureSampling(const BenchContext* context) {
+    FillBench* bench = new FillBench();
+    bench->program = createCachedProgram(fullscreen_vertex_src, texture_fragment_src);
+    bench->texture = createTexture(2048, 2048, 12);
+    bench->blend = false;
+    bench->pixels = context->width * context->height;
+
+    glUseProgram(bench->program);
+    glUniform1i(glGetUniformLocation(bench->program, "uTexture"), 0);
+    glUniform2f(glGetUniformLocation(bench->program, "uScale"), context->width / 2048.0f, context->height / 2048.0f);
+    return bench;
+}
+
+static void setShadingUniforms(unsigned int program) {
+    float lights[8 * 4];
+    for (int idx = 0; idx < 8; idx++) {
+        float angle = idx * 0.785f;
+        lights[idx * 4 + 0] = cosf(angle);
+        lights[idx * 4 + 1] = sinf(angle);
+        lights[idx * 4 + 2] = 0.5f + 0.1f * idx;
+        lights[idx * 4 + 3] = 0.15f;
+    }
+    glUniform4fv(glGetUniformLocation(program, "uLights"), 8, lights);
+}
+
+// The image check of the precision variants: one full-screen triangle.
+static void drawShadingCheck(unsigned int program, void*) {
+    setShadingUniforms(program);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+static FillBench* setupShading(const BenchContext* context, ShaderPrecision precision) {
+    PrecisionVariants variants;
+    if (!initPrecisionVariants(&variants, fullscreen_vertex_src, shading_fragment_src)) {
+        destroyPrecisionVariants(&variants);
+        return NULL;
+    }
+
+    FillBench* bench = new FillBench();
+    bench->program = selectPrecisionVariant(&variants, precision, context->width, context->height,
+                                            drawShadingCheck, NULL);
+    bench->texture = 0;
+    bench->blend = false;
+    bench->pixels = context->width * context->height;
+    if (precision == SHADER_PRECISION_MEDIUMP) {
+        printPrecisionVariants(&variants, "  precision");
+    }
+
+    /* The bench owns the program of the selected variant. */
+    glDeleteProgram(variants.programs[variants.selected == SHADER_PRECISION_HIGHP ? SHADER_PRECISION_MEDIUMP
+                                                                                  : SHADER_PRECISION_HIGHP]);
+
+    glUseProgram(bench->program);
+    setShadingUniforms(bench->program);
+    return bench;
+}
+
+static void* setupShadingHighp(const BenchContext* context) {
+    return setupShading(context, SHADER_PRECISION_HIGHP);
+}
+
+static void* setupShadingMediump(const BenchContext* context) {
+    return setupShading(context, SHADER_PRECISION_MEDIUMP);
+}
+
+static double runFill(void* state, int iterations) {
+    FillBench* bench = (FillBench*)state;
+
+    glUseProgram(bench->program);
+    if (bench->texture) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, bench->texture);
+    }
+    if (bench->blend) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    for (int idx = 0; idx < iterations * fillLayers; idx++) {
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    glDisable(GL_BLEND);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return (double)iterations * fillLayers * bench->pixels;
+}
+
+static void teardownFill(void* state) {
+    FillBench* bench = (FillBench*)state;
+    glDeleteTextures(1, &bench->texture);
+    glDeleteProgram(bench->program);
+    delete bench;
+}
+
+// B.3. Framebuffer blit between two textures of the framebuffer size.
+struct BlitBench {
+    unsigned int textures[2];
+    unsigned int fbos[2];
+    int width;
+    int height;
+};
+
+static void* setupBlit(const BenchContext* context) {
+    BlitBench* bench = new BlitBench();
+    bench->width = context->width;
+    bench->height = context->height;
+    for (int idx = 0; idx < 2; idx++) {
+        bench->textures[idx] = createTexture(bench->width, bench->height, 1);
+        bench->fbos[idx] = createTextureFramebuffer(bench->textures[idx]);
+    }
+    return bench;
+}
+
+static double runBlit(void* state, int iterations) {
+    BlitBench* bench = (BlitBench*)state;
+    for (int idx = 0; idx < iterations; idx++) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, bench->fbos[idx & 1]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, bench->fbos[(idx + 1) & 1]);
+        glBlitFramebuffer(0, 0, bench->width, bench->height, 0, 0, bench->width, bench->height,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+    /* Read and written once. */
+    return (double)iterations * bench->width * bench->height * 4 * 2;
+}
+
+static void teardownBlit(void* state) {
+    BlitBench* bench = (BlitBench*)state;
+    glDeleteFramebuffers(2, bench->fbos);
+    glDeleteTextures(2, bench->textures);
+    delete bench;
+}
+
+// B.4. Compute dispatches.
+struct ComputeBench {
+    ComputeKernel kernel;
+    StorageBuffer<uint32_t> values;
+};
+
+// Invocations of a throughput dispatch.
+static const int computeInvocations = 4096;
+
+static void* setupCompute(const BenchContext*) {
+    if (!hasCompute()) {
+        return NULL;
+    }
+
+    ComputeBench* bench = new ComputeBench();
+    createComputeKernel(&bench->kernel, compute_src, 1);
+    bench->values = createStorageBuffer<uint32_t>(computeInvocations);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, bench->values.buffer);
+    return bench;
+}
+
+static double runComputeLatency(void* state, int iterations) {
+    ComputeBench* bench = (ComputeBench*)state;
+    for (int idx = 0; idx < iterations; idx++) {
+        computeDispatch(&bench->kernel, 1, 1, 1);
+        glFinish();
+    }
+    return iterations;
+}
+
+static double runComputeThroughput(void* state, int iterations) {
+    ComputeBench* bench = (ComputeBench*)state;
+    for (int idx = 0; idx < iterations * 100; idx++) {
+        computeDispatch(&bench->kernel, computeInvocations, 1, 1);
+    }
+    return (double)iterations * 100;
+}
+
+static void teardownCompute(void* state) {
+    ComputeBench* bench = (ComputeBench*)state;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    destroyStorageBuffer(&bench->values);
+    destroyComputeKernel(&bench->kernel);
+    delete bench;
+}
+
+// B.5. Transfers.
+struct TransferBench {
+    unsigned int buffer;
+    unsigned int texture;
+    unsigned int fbo;
+    int width;
+    int height;
+    std::vector<uint8_t> data;
+};
+
+static const int transferBufferSize = 16 * 1024 * 1024;
+static const int transferTextureSize = 1024;
+
+static void* setupBufferUpload(const BenchContext*) {
+    TransferBench* bench = new TransferBench();
+    bench->data.assign(transferBufferSize, 0x5a);
+    glGenBuffers(1, &bench->buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bench->buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, transferBufferSize, NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return bench;
+}
+
+static double runBufferUpload(void* state, int iterations) {
+    TransferBench* bench = (TransferBench*)state;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bench->buffer);
+    for (int idx = 0; idx < iterations; idx++) {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, 0, transferBufferSize, bench->data.data());
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return (double)iterations * transferBufferSize;
+}
+
+static void* setupBufferReadback(const BenchContext*) {
+    TransferBench* bench = (TransferBench*)setupBufferUpload(NULL);
+    bench->data.resize(transferBufferSize);
+    return bench;
+}
+
+static double runBufferReadback(void* state, int iterations) {
+    TransferBench* bench = (TransferBench*)state;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bench->buffer);
+    for (int idx = 0; idx < iterations; idx++) {
+        /* The buffer is rewritten on the GPU side first: the map has to wait and can't reuse a CPU copy. */
+        glBufferSubData(GL_COPY_WRITE_BUFFER, 0, 4, &idx);
+        const void* mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, transferBufferSize, GL_MAP_READ_BIT);
+        if (mapped != NULL) {
+            memcpy(bench->data.data(), mapped, transferBufferSize);
+        }
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return (double)iterations * transferBufferSize;
+}
+
+static void* setupTextureUpload(const BenchContext*) {
+    TransferBench* bench = new TransferBench();
+    bench->width = transferTextureSize;
+    bench->height = transferTextureSize;
+    bench->texture = createTexture(bench->width, bench->height, 1);
+    bench->data.assign((size_t)bench->width * bench->height * 4, 0x5a);
+    return bench;
+}
+
+static double runTextureUpload(void* state, int iterations) {
+    TransferBench* bench = (TransferBench*)state;
+    glBindTexture(GL_TEXTURE_2D, bench->texture);
+    for (int idx = 0; idx < iterations; idx++) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, bench->width, bench->height, GL_RGBA, GL_UNSIGNED_BYTE,
+                        bench->data.data());
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return (double)iterations * bench->data.size();
+}
+
+static void* setupReadPixels(const BenchContext* context) {
+    TransferBench* bench = new TransferBench();
+    bench->width = context->width;
+    bench->height = context->height;
+    bench->texture = createTexture(bench->width, bench->height, 1);
+    bench->fbo = createTextureFramebuffer(bench->texture);
+    bench->data.resize((size_t)bench->width * bench->height * 4);
+    return bench;
+}
+
+static double runReadPixels(void* state, int iterations) {
+    TransferBench* bench = (TransferBench*)state;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, bench->fbo);
+    for (int idx = 0; idx < iterations; idx++) {
+        glReadPixels(0, 0, bench->width, bench->height, GL_RGBA, GL_UNSIGNED_BYTE, bench->data.data());
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    return (double)iterations * bench->data.size();
+}
+
+static void teardownTransfer(void* state) {
+    TransferBench* bench = (TransferBench*)state;
+    glDeleteBuffers(1, &bench->buffer);
+    glDeleteFramebuffers(1, &bench->fbo);
+    glDeleteTextures(1, &bench->texture);
+    delete bench;
+}
+
+// B.6. Streaming uploads: every frame "count" allocations of "size" bytes, each one read by the GPU like a draw would.
+struct StreamBench {
+    StreamBuffer stream;
+    unsigned int copyBuffer;
+    int size;
+    int count;
+    std::vector<uint8_t> data;
+    std::vector<int> offsets;
+};
+
+template <StreamUploadMode mode, int size, int count>
+static void* setupStream(const BenchContext*) {
+    StreamBench* bench = new StreamBench();
+    bench->size = size;
+    bench->count = count;
+    bench->data.assign(size, 0x5a);
+    bench->offsets.resize(count);
+    initStreamBuffer(&bench->stream, GL_COPY_READ_BUFFER, size * count, mode);
+
+    glGenBuffers(1, &bench->copyBuffer);
+    stateCacheBindBuffer(GL_COPY_WRITE_BUFFER, bench->copyBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_COPY);
+    stateCacheBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return bench;
+}
+
+static double runStream(void* state, int iterations) {
+    StreamBench* bench = (StreamBench*)state;
+    stateCacheBindBuffer(GL_COPY_WRITE_BUFFER, bench->copyBuffer);
+    for (int frame = 0; frame < iterations; frame++) {
+        streamBufferBeginFrame(&bench->stream);
+        for (int idx = 0; idx < bench->count; idx++) {
+            void* dst = streamBufferAllocate(&bench->stream, bench->size, 256, &bench->offsets[idx]);
+            if (dst != NULL) {
+                memcpy(dst, bench->data.data(), bench->size);
+            }
+        }
+        streamBufferEndFrame(&bench->stream);
+
+        stateCacheBindBuffer(GL_COPY_READ_BUFFER, bench->stream.buffer);
+        for (int idx = 0; idx < bench->count; idx++) {
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, bench->offsets[idx], 0, bench->size);
+        }
+        stateCacheBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    stateCacheBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return (double)iterations * bench->size * bench->count;
+}
+
+static void teardownStream(void* state) {
+    StreamBench* bench = (StreamBench*)state;
+    destroyStreamBuffer(&bench->stream);
+    glDeleteBuffers(1, &bench->copyBuffer);
+    delete bench;
+}
+
+#define STREAM_BENCHMARKS(mode, name) \
+    { "stream_" name "_256b", "GB/s", 1e9, false, setupStream<mode, 256, 256>,             runStream, teardownStream }, \
+    { "stream_" name "_16k",  "GB/s", 1e9, false, setupStream<mode, 16 * 1024, 16>,        runStream, teardownStream }, \
+    { "stream_" name "_4m",   "GB/s", 1e9, false, setupStream<mode, 4 * 1024 * 1024, 1>, runStream, teardownStream }
+
+static const Benchmark benchmarks[] = {
+    { "draw_calls",          "Mdraws/s",      1e6, false, setupDrawCalls,         runDrawCalls,         teardownMeshBench },
+    { "vertex_fetch",        "Mvertices/s",   1e6, false, setupVertexFetch,       runVertexFetch,       teardownMeshBench },
+    { "vertex_fetch_packed", "Mvertices/s",   1e6, false, setupVertexFetchPacked, runVertexFetch,       teardownMeshBench },
+    { "vertex_normal_float", "Mvertices/s",   1e6, false, setupVertexNormalFloat, runVertexFetch,       teardownMeshBench },
+    { "vertex_normal_quant", "Mvertices/s",   1e6, false, setupVertexNormalQuantized, runVertexFetch,   teardownMeshBench },
+    { "fill_rate",           "Gpixels/s",     1e9, false, setupFillRate,          runFill,              teardownFill },
+    { "fill_rate_blend",     "Gpixels/s",     1e9, false, setupFillRateBlend,     runFill,              teardownFill },
+    { "texture_sampling",    "Gtexels/s",     1e9, false, setupTextureSampling,   runFill,              teardownFill },
+    { "shading_highp",       "Gpixels/s",     1e9, false, setupShadingHighp,      runFill,              teardownFill },
+    { "shading_mediump",     "Gpixels/s",     1e9, false, setupShadingMediump,    runFill,              teardownFill },
+    { "fbo_blit",            "GB/s",          1e9, false, setupBlit,              runBlit,              teardownBlit },
+    { "compute_latency",     "us",            1e6, true,  setupCompute,           runComputeLatency,    teardownCompute },
+    { "compute_throughput",  "kdispatches/s", 1e3, false, setupCompute,           runComputeThroughput, teardownCompute },
+    { "buffer_upload",       "GB/s",          1e9, false, setupBufferUpload,      runBufferUpload,      teardownTransfer },
+    { "buffer_readback",     "GB/s",          1e9, false, setupBufferReadback,    runBufferReadback,    teardownTransfer },
+    { "texture_upload",      "GB/s",          1e9, false, setupTextureUpload,     runTextureUpload,     teardownTransfer },
+    { "read_pixels",         "GB/s",          1e9, false, setupReadPixels,        runReadPixels,        teardownTransfer },
+    STREAM_BENCHMARKS(STREAM_UPLOAD_RING, "ring"),
+    STREAM_BENCHMARKS(STREAM_UPLOAD_INVALIDATE, "invalidate"),
+    STREAM_BENCHMARKS(STREAM_UPLOAD_ORPHAN, "orphan"),
+    STREAM_BENCHMARKS(STREAM_UPLOAD_SUB_DATA, "sub_data"),
+};
+
+static const int benchmarkCount = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+// Wall time of "iterations" runs, the GPU is idle before and done after.
+static double timeRun(const DemoContext* demo, const Benchmark* benchmark, void* state, int iterations, double* work) {
+    glFinish();
+    double startTime = demoGetTime(demo);
+    *work = benchmark->run(state, iterations);
+    glFinish();
+    return demoGetTime(demo) - startTime;
+}
+
+static bool runBenchmark(const DemoContext* demo, const BenchContext* context, const Benchmark* benchmark,
+                         int trials, int warmup, double trialMs, BenchResult* result) {
+    void* state = benchmark->setup(context);
+    if (state == NULL) {
+        return false;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, context->framebuffer);
+    glViewport(0, 0, context->width, context->height);
+
+    // 1. Calibrate: the first run also compiles the shaders and touches the resources.
+    double work = 0.0;
+    int iterations = 1;
+    double elapsed = timeRun(demo, benchmark, state, iterations, &work);
+    elapsed = timeRun(demo, benchmark, state, iterations, &work);
+    if (elapsed > 0.0) {
+        iterations = std::max(1, (int)(trialMs / 1000.0 / elapsed));
+    }
+
+    // 2. Warm-up and measured trials.
+    result->benchmark = benchmark;
+    result->iterations = iterations;
+    result->trials.clear();
+    for (int trial = 0; trial < warmup + trials; trial++) {
+        elapsed = timeRun(demo, benchmark, state, iterations, &work);
+        if (trial < warmup) {
+            continue;
+        }
+
+        elapsed = std::max(elapsed, 1e-9);
+        result->trials.push_back(benchmark->latency ? elapsed / work * benchmark->unitScale
+                                                    : work / elapsed / benchmark->unitScale);
+    }
+
+    benchmark->teardown(state);
+    glBindFramebuffer(GL_FRAMEBUFFER, context->framebuffer);
+
+    // 3. Statistics of the trials.
+    std::vector<double> sorted = result->trials;
+    std::sort(sorted.begin(), sorted.end());
+    size_t count = sorted.size();
+    result->median = count % 2 ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) * 0.5;
+    result->min = sorted.front();
+    result->max = sorted.back();
+
+    double sum = 0.0;
+    for (double value : sorted) {
+        sum += value;
+    }
+    result->mean = sum / count;
+
+    double variance = 0.0;
+    for (double value : sorted) {
+        variance += (value - result->mean) * (value - result->mean);
+    }
+    result->stddev = count > 1 ? sqrt(variance / (count - 1)) : 0.0;
+    return true;
+}
+
+static void writeJSONString(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', file);
+            fputc(*c, file);
+        } else if ((unsigned char)*c < 0x20) {
+            fprintf(file, "\\u%04x", *c);
+        } else {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+static void writeJSON(FILE* file, const BenchContext* context, const std::vector<BenchResult>& results) {
+    fprintf(file, "{\n  \"renderer\": ");
+    writeJSONString(file, (const char*)glGetString(GL_RENDERER));
+    fprintf(file, ",\n  \"vendor\": ");
+    writeJSONString(file, (const char*)glGetString(GL_VENDOR));
+    fprintf(file, ",\n  \"version\": ");
+    writeJSONString(file, (const char*)glGetString(GL_VERSION));
+    fprintf(file, ",\n  \"width\": %d,\n  \"height\": %d,\n  \"benchmarks\": [", context->width, context->height);
+
+    for (size_t idx = 0; idx < results.size(); idx++) {
+        const BenchResult& result = results[idx];
+        fprintf(file, "%s\n    { \"name\": \"%s\", \"unit\": \"%s\", \"higher_is_better\": %s, \"iterations\": %d,\n",
+                idx ? "," : "", result.benchmark->name, result.benchmark->unit,
+                result.benchmark->latency ? "false" : "true", result.iterations);
+
+        fprintf(file, "      \"trials\": [");
+        for (size_t trial = 0; trial < result.trials.size(); trial++) {
+            fprintf(file, "%s%.6g", trial ? ", " : "", result.trials[trial]);
+        }
+        fprintf(file, "],\n      \"median\": %.6g, \"mean\": %.6g, \"min\": %.6g, \"max\": %.6g, \"stddev\": %.6g }",
+                result.median, result.mean, result.min, result.max, result.stddev);
+    }
+    fprintf(file, "\n  ]\n}\n");
+}
+
+static bool selected(const char* name, const std::vector<const char*>& filters) {
+    if (filters.empty()) {
+        return true;
+    }
+    for (const char* filter : filters) {
+        if (strstr(name, filter) != NULL) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char **argv) {
+    // 1. Parse the options.
+    std::vector<const char*> filters;
+    const char* jsonPath = "glesbench.json";
+    int trials = 5;
+    int warmup = 1;
+    double trialMs = 50.0;
+    bool headless = false;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--list") == 0) {
+            for (int bench = 0; bench < benchmarkCount; bench++) {
+                printf("%-22s %s\n", benchmarks[bench].name, benchmarks[bench].unit);
+            }
+            return 0;
+        } else if (strcmp(argv[idx], "--filter") == 0 && idx + 1 < argc) {
+            filters.push_back(argv[++idx]);
+        } else if (strcmp(argv[idx], "--trials") == 0 && idx + 1 < argc) {
+            trials = std::max(1, atoi(argv[++idx]));
+        } else if (strcmp(argv[idx], "--warmup") == 0 && idx + 1 < argc) {
+            warmup = std::max(0, atoi(argv[++idx]));
+        } else if (strcmp(argv[idx], "--trial-ms") == 0 && idx + 1 < argc) {
+            trialMs = std::max(1.0, atof(argv[++idx]));
+        } else if (strcmp(argv[idx], "--json") == 0 && idx + 1 < argc) {
+            jsonPath = argv[++idx];
+        } else if (strcmp(argv[idx], "--headless") == 0 || strcmp(argv[idx], "--surfaceless") == 0) {
+            headless = true;
+        }
+    }
+
+    // 2. Open the output and create the headless context.
+    FILE* json;
+    if (strcmp(jsonPath, "-") == 0) {
+        /* Everything else printed (context info, the table) goes to the standard error. */
+        json = fdopen(dup(STDOUT_FILENO), "w");
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    } else {
+        json = fopen(jsonPath, "w");
+    }
+    if (json == NULL) {
+        printf("Error: unable to open '%s'\n", jsonPath);
+        return -1;
+    }
+
+    std::vector<char*> contextArgs(argv, argv + argc);
+    char headlessOption[] = "--headless";
+    if (!headless) {
+        contextArgs.push_back(headlessOption);
+    }
+
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, (int)contextArgs.size(), contextArgs.data(), "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
+    demo.frameLimit = 0;
+
+    BenchContext context;
+    demoGetFramebufferSize(&demo, &context.width, &context.height);
+    context.framebuffer = demoDefaultFramebuffer(&demo);
+
+    // 3. Run the selected benchmarks.
+    printf("%-22s %12s %12s %12s %10s  %s\n", "benchmark", "median", "min", "max", "stddev", "unit");
+    std::vector<BenchResult> results;
+    for (int idx = 0; idx < benchmarkCount; idx++) {
+        const Benchmark* benchmark = &benchmarks[idx];
+        if (!selected(benchmark->name, filters)) {
+            continue;
+        }
+
+        BenchResult result;
+        if (!runBenchmark(&demo, &context, benchmark, trials, warmup, trialMs, &result)) {
+            printf("%-22s not supported\n", benchmark->name);
+            continue;
+        }
+        printf("%-22s %12.4f %12.4f %12.4f %10.4f  %s\n", benchmark->name, result.median, result.min, result.max,
+               result.stddev, benchmark->unit);
+        results.push_back(result);
+    }
+
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+        printf("Warning: GL error 0x%x during the benchmarks\n", error);
+    }
+
+    // 4. Write the results.
+    writeJSON(json, &context, results);
+    fclose(json);
+    if (strcmp(jsonPath, "-") != 0) {
+        printf("Wrote '%s'\n", jsonPath);
+    }
+
+    destroyDemoContext(&demo);
+    return 0;
+}
@@ -0,0 +1,454 @@
+/**
+ * Golden image check of the demos ("golden_image").
+ *
+ * Every run of the run list renders a fixed number of frames with a fixed
+ * animation step ("--frames N --fixed-time STEP" of the demo context, so the
+ * frames do not depend on the clock or the vsync) and writes the last frame
+ * ("--dump-frame"). The frame is compared with the golden image of the run:
+ * a pixel differs if any of its channels differs by more than "--tolerance",
+ * the run fails if more than "--max-bad" percent of the pixels differ (the
+ * driver and the GPU round differently, an exact match is not expected). A
+ * diff image (<name>.diff.ppm: the differing pixels in red) is written for
+ * the failed runs.
+ *
+ * The runs also print their frame statistics ("--frame-stats"): the frame
+ * rate and the frame, CPU and GPU time percentiles are recorded next to the
+ * image result, so an optimization is checked for both its speed and its
+ * output in one run. "--update" writes the frames as the new golden images
+ * and the results as the golden timings (<golden dir>/timings.json); the
+ * later checks print the frame and GPU time changes against them. The times
+ * only fail the check with "--time-threshold", they depend on the machine.
+ *
+ * The "golden_check" and "golden_update" build targets generate the run list
+ * (golden_runs.txt: the cube, floor, depth cube, shadow map, deferred,
+ * clustered lights and wireframe demos) and run the check.
+ *
+ * Run:
+ * $ make golden_update
+ * $ make golden_check
+ * $ ./golden_image golden_runs.txt --golden ../golden --out golden_out --tolerance 4
+ *
+ * Run list, one run per line ("#": comment): <name> <demo binary> <options...>
+ *
+ * Options:
+ *  --golden DIR           Golden images and timings (default: golden).
+ *  --out DIR              Frames, diff images and results (default: golden_out).
+ *  --update               Write the frames and the timings as the new goldens.
+ *  --frames N             Frames of every run, the last one is compared (default: 60).
+ *  --step SECONDS         Animation step of the frames (default: 1/60).
+ *  --tolerance N          Allowed difference of a channel (default: 8).
+ *  --max-bad PCT          Allowed percentage of differing pixels (default: 0.1).
+ *  --time-threshold PCT   Fail if the frame or GPU time (p50) grew by more than PCT percent (default: 0, off).
+ *  --json FILE            Results (default: <out dir>/golden_results.json).
+ *
+ * JSON output, one run per line (the golden timings are read back line by line):
+ *
+ *   { "runs": [
+ *     { "name": "cube", "status": "pass", "max_diff": N, "bad_percent": P, "fps": F,
+ *       "frame_p50": T, "frame_p95": T, "cpu_p50": T, "cpu_p95": T, "gpu_p50": T, "gpu_p95": T }, ... ] }
+ *
+ * Dependencies:
+ *  * C++11
+ *  * POSIX (popen)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "common/image_writer.h"
+
+// p50/p95 of a frame statistics row (negative: not available).
+struct TimeStats {
+    double p50;
+    double p95;
+};
+
+struct GoldenRun {
+    std::string name;
+    std::string command;
+    std::string status; // "pass", "fail", "slower", "new", "updated" or "error"
+    int maxDiff;
+    double badPercent;
+    double fps;
+    TimeStats frame;
+    TimeStats cpu;
+    TimeStats gpu;
+};
+
+struct Image {
+    int width;
+    int height;
+    std::vector<uint8_t> rgb; // top row first
+};
+
+// 1. The runs of the run list: "<name> <command...>" per line.
+static std::vector<GoldenRun> readRunList(const char* path) {
+    std::vector<GoldenRun> runs;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line[start] == '#') {
+            continue;
+        }
+        size_t nameEnd = line.find_first_of(" \t", start);
+        size_t commandStart = nameEnd == std::string::npos ? std::string::npos : line.find_first_not_of(" \t", nameEnd);
+        if (commandStart == std::string::npos) {
+            printf("Warning: run without a command: '%s'\n", line.c_str());
+            continue;
+        }
+
+        GoldenRun run;
+        run.name = line.substr(start, nameEnd - start);
+        run.command = line.substr(commandStart);
+        run.status = "error";
+        run.maxDiff = -1;
+        run.badPercent = -1.0;
+        run.fps = -1.0;
+        run.frame = run.cpu = run.gpu = TimeStats{ -1.0, -1.0 };
+        runs.push_back(run);
+    }
+    return runs;
+}
+
+// 2. Run the demo and parse the frame rate and the frame statistics of its output.
+/* "Rendered N frames in T s: F fps" and the "frame", "cpu" and "gpu" rows of frame_stats.cpp. */
+static bool executeRun(GoldenRun* run, const std::string& framePath, int frames, double step) {
+    char options[128];
+    snprintf(options, sizeof(options), " --frames %d --fixed-time %.9g --frame-stats", frames, step);
+    std::string command = run->command + options + " --dump-frame '" + framePath + "' 2>&1";
+
+    remove(framePath.c_str());
+    FILE* pipe = popen(command.c_str(), "r");
+    if (pipe == NULL) {
+        printf("%s: unable to run '%s'\n", run->name.c_str(), command.c_str());
+        return false;
+    }
+
+    std::string output;
+    char line[512];
+    while (fgets(line, sizeof(line), pipe)) {
+        output += line;
+
+        int renderedFrames;
+        double seconds;
+        double fps;
+        char row[16];
+        double p50;
+        double p95;
+        if (sscanf(line, "Rendered %d frames in %lf s: %lf fps", &renderedFrames, &seconds, &fps) == 3) {
+            run->fps = fps;
+        } else if (sscanf(line, " %15s %lf %lf", row, &p50, &p95) == 3) {
+            TimeStats stats = { p50, p95 };
+            if (strcmp(row, "frame") == 0) {
+                run->frame = stats;
+            } else if (strcmp(row, "cpu") == 0) {
+                run->cpu = stats;
+            } else if (strcmp(row, "gpu") == 0) {
+                run->gpu = stats;
+            }
+        }
+    }
+
+    int status = pclose(pipe);
+    if (status != 0) {
+        printf("%s: '%s' failed (exit code %d), output:\n%s", run->name.c_str(), command.c_str(),
+               WIFEXITED(status) ? WEXITSTATUS(status) : -1, output.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Whitespace and "#" comments between the fields of a PPM header.
+static void skipPPMSeparators(std::istream& file) {
+    while (file) {
+        int next = file.peek();
+        if (next == '#') {
+            file.ignore(1 << 16, '\n');
+        } else if (next == ' ' || next == '\t' || next == '\r' || next == '\n') {
+            file.get();
+        } else {
+            break;
+        }
+    }
+}
+
+static bool readPPM(const std::string& path, Image* image) {
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    std::string magic;
+    file >> magic;
+    if (!file || magic != "P6") {
+        return false;
+    }
+
+    int maxValue = 0;
+    skipPPMSeparators(file);
+    file >> image->width;
+    skipPPMSeparators(file);
+    file >> image->height;
+    skipPPMSeparators(file);
+    file >> maxValue;
+    file.get();
+    if (!file || image->width <= 0 || image->height <= 0 || maxValue != 255) {
+        return false;
+    }
+
+    image->rgb.resize((size_t)image->width * image->height * 3);
+    file.read((char*)image->rgb.data(), image->rgb.size());
+    return (size_t)file.gcount() == image->rgb.size();
+}
+
+// 3. Compare with the golden image, the differing pixels are red in the diff image (the others a dark gray).
+/* Returns the number of differing pixels, the diff is R8G8B8A8 bottom row first (for writeImageFile). */
+static size_t compareImages(const Image& frame, const Image& golden, int tolerance, int* maxDiff,
+                            std::vector<uint8_t>* diff) {
+    size_t badPixels = 0;
+    *maxDiff = 0;
+    diff->resize((size_t)frame.width * frame.height * 4);
+    for (int y = 0; y < frame.height; y++) {
+        uint8_t* diffRow = &(*diff)[(size_t)(frame.height - 1 - y) * frame.width * 4];
+        for (int x = 0; x < frame.width; x++) {
+            const uint8_t* a = &frame.rgb[((size_t)y * frame.width + x) * 3];
+            const uint8_t* b = &golden.rgb[((size_t)y * frame.width + x) * 3];
+            int pixelDiff = 0;
+            for (int channel = 0; channel < 3; channel++) {
+                pixelDiff = std::max(pixelDiff, abs((int)a[channel] - (int)b[channel]));
+            }
+            *maxDiff = std::max(*maxDiff, pixelDiff);
+
+            uint8_t* out = &diffRow[x * 4];
+            if (pixelDiff > tolerance) {
+                badPixels++;
+                out[0] = 255;
+                out[1] = 0;
+                out[2] = 0;
+            } else {
+                uint8_t gray = (uint8_t)((b[0] + b[1] + b[2]) / 9);
+                out[0] = out[1] = out[2] = gray;
+            }
+            out[3] = 255;
+        }
+    }
+    return badPixels;
+}
+
+static bool copyFile(const std::string& from, const std::string& to) {
+    std::ifstream source(from.c_str(), std::ios::in | std::ios::binary);
+    std::ofstream target(to.c_str(), std::ios::out | std::ios::binary);
+    if (!source || !target) {
+        return false;
+    }
+    target << source.rdbuf();
+    return (bool)target;
+}
+
+static void writeJSON(FILE* json, const std::vector<GoldenRun>& runs) {
+    fprintf(json, "{ \"runs\": [\n");
+    for (size_t idx = 0; idx < runs.size(); idx++) {
+        const GoldenRun& run = runs[idx];
+        fprintf(json, "  { \"name\": \"%s\", \"status\": \"%s\", \"max_diff\": %d, \"bad_percent\": %.4f, \"fps\": %.2f, "
+                      "\"frame_p50\": %.3f, \"frame_p95\": %.3f, \"cpu_p50\": %.3f, \"cpu_p95\": %.3f, "
+                      "\"gpu_p50\": %.3f, \"gpu_p95\": %.3f }%s\n",
+                run.name.c_str(), run.status.c_str(), run.maxDiff, run.badPercent, run.fps, run.frame.p50,
+                run.frame.p95, run.cpu.p50, run.cpu.p95, run.gpu.p50, run.gpu.p95, idx + 1 < runs.size() ? "," : "");
+    }
+    fprintf(json, "] }\n");
+}
+
+// Number after "<key>": in a JSON line (negative if it is missing).
+static double jsonNumber(const std::string& line, const char* key) {
+    std::string pattern = std::string("\"") + key + "\": ";
+    size_t pos = line.find(pattern);
+    return pos == std::string::npos ? -1.0 : atof(line.c_str() + pos + pattern.size());
+}
+
+// The golden timings: the frame and GPU p50 of every run of an earlier (update) result file.
+static std::vector<GoldenRun> readTimings(const std::string& path) {
+    std::vector<GoldenRun> timings;
+    std::ifstream file(path.c_str());
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t nameStart = line.find("\"name\": \"");
+        if (nameStart == std::string::npos) {
+            continue;
+        }
+        nameStart += 9;
+        GoldenRun run;
+        run.name = line.substr(nameStart, line.find('"', nameStart) - nameStart);
+        run.fps = jsonNumber(line, "fps");
+        run.frame = TimeStats{ jsonNumber(line, "frame_p50"), jsonNumber(line, "frame_p95") };
+        run.cpu = TimeStats{ jsonNumber(line, "cpu_p50"), jsonNumber(line, "cpu_p95") };
+        run.gpu = TimeStats{ jsonNumber(line, "gpu_p50"), jsonNumber(line, "gpu_p95") };
+        timings.push_back(run);
+    }
+    return timings;
+}
+
+// Change of a time in percent (0 if any of them is not available).
+static double timeChange(double value, double golden) {
+    return (value > 0.0 && golden > 0.0) ? (value - golden) * 100.0 / golden : 0.0;
+}
+
+int main(int argc, char **argv) {
+    // 1. Parse the options.
+    if (argc < 2 || argv[1][0] == '-') {
+        printf("Usage: %s <run list> [--golden DIR] [--out DIR] [--update] [--frames N] [--step SECONDS] "
+               "[--tolerance N] [--max-bad PCT] [--time-threshold PCT] [--json FILE]\n", argv[0]);
+        return -1;
+    }
+
+    const char* runListPath = argv[1];
+    std::string goldenDir = "golden";
+    std::string outDir = "golden_out";
+    std::string jsonPath;
+    bool update = false;
+    int frames = 60;
+    double step = 1.0 / 60.0;
+    int tolerance = 8;
+    double maxBadPercent = 0.1;
+    double timeThreshold = 0.0;
+    for (int idx = 2; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--golden") == 0 && idx + 1 < argc) {
+            goldenDir = argv[++idx];
+        } else if (strcmp(argv[idx], "--out") == 0 && idx + 1 < argc) {
+            outDir = argv[++idx];
+        } else if (strcmp(argv[idx], "--json") == 0 && idx + 1 < argc) {
+            jsonPath = argv[++idx];
+        } else if (strcmp(argv[idx], "--update") == 0) {
+            update = true;
+        } else if (strcmp(argv[idx], "--frames") == 0 && idx + 1 < argc) {
+            frames = std::max(1, atoi(argv[++idx]));
+        } else if (strcmp(argv[idx], "--step") == 0 && idx + 1 < argc) {
+            step = atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--tolerance") == 0 && idx + 1 < argc) {
+            tolerance = std::max(0, atoi(argv[++idx]));
+        } else if (strcmp(argv[idx], "--max-bad") == 0 && idx + 1 < argc) {
+            maxBadPercent = std::max(0.0, atof(argv[++idx]));
+        } else if (strcmp(argv[idx], "--time-threshold") == 0 && idx + 1 < argc) {
+            timeThreshold = std::max(0.0, atof(argv[++idx]));
+        }
+    }
+    if (jsonPath.empty()) {
+        jsonPath = outDir + "/golden_results.json";
+    }
+
+    std::vector<GoldenRun> runs = readRunList(runListPath);
+    if (runs.empty()) {
+        printf("Error: no runs in '%s'\n", runListPath);
+        return -1;
+    }
+    mkdir(outDir.c_str(), 0755);
+    if (update) {
+        mkdir(goldenDir.c_str(), 0755);
+    }
+    std::string timingsPath = goldenDir + "/timings.json";
+    std::vector<GoldenRun> timings = update ? std::vector<GoldenRun>() : readTimings(timingsPath);
+
+    // 2. Render, compare and update every run.
+    printf("%-16s %-8s %8s %8s %9s %9s %9s %9s %8s %8s\n", "run", "status", "max diff", "bad %", "fps", "frame ms",
+           "cpu ms", "gpu ms", "frame %", "gpu %");
+    int failed = 0;
+    std::vector<uint8_t> diff;
+    std::vector<uint8_t> scratch;
+    for (GoldenRun& run : runs) {
+        std::string framePath = outDir + "/" + run.name + ".ppm";
+        std::string goldenPath = goldenDir + "/" + run.name + ".ppm";
+        std::string diffPath = outDir + "/" + run.name + ".diff.ppm";
+        remove(diffPath.c_str());
+
+        Image frame;
+        if (!executeRun(&run, framePath, frames, step) || !readPPM(framePath, &frame)) {
+            printf("%-16s %-8s (no frame in '%s')\n", run.name.c_str(), run.status.c_str(), framePath.c_str());
+            failed++;
+            continue;
+        }
+
+        Image golden;
+        if (update) {
+            run.status = copyFile(framePath, goldenPath) ? "updated" : "error";
+        } else if (!readPPM(goldenPath, &golden)) {
+            run.status = "new";
+        } else if (golden.width != frame.width || golden.height != frame.height) {
+            printf("%s: the frame is %dx%d, the golden image is %dx%d\n", run.name.c_str(), frame.width, frame.height,
+                   golden.width, golden.height);
+            run.status = "fail";
+        } else {
+            size_t badPixels = compareImages(frame, golden, tolerance, &run.maxDiff, &diff);
+            run.badPercent = badPixels * 100.0 / ((double)frame.width * frame.height);
+            run.status = run.badPercent > maxBadPercent ? "fail" : "pass";
+            if (badPixels > 0) {
+                writeImageFile(diffPath.c_str(), IMAGE_FILE_PPM, diff.data(), frame.width, frame.height, &scratch);
+            }
+        }
+
+        // 2.1. Time changes against the golden timings.
+        double frameChange = 0.0;
+        double gpuChange = 0.0;
+        for (const GoldenRun& timing : timings) {
+            if (timing.name == run.name) {
+                frameChange = timeChange(run.frame.p50, timing.frame.p50);
+                gpuChange = timeChange(run.gpu.p50, timing.gpu.p50);
+            }
+        }
+        if (timeThreshold > 0.0 && run.status == "pass" && std::max(frameChange, gpuChange) > timeThreshold) {
+            run.status = "slower";
+        }
+        if (run.status == "fail" || run.status == "slower" || run.status == "error") {
+            failed++;
+        }
+
+        printf("%-16s %-8s %8d %8.3f %9.2f %9.3f %9.3f %9.3f %+7.1f%% %+7.1f%%\n", run.name.c_str(), run.status.c_str(),
+               run.maxDiff, run.badPercent, run.fps, run.frame.p50, run.cpu.p50, run.gpu.p50, frameChange, gpuChange);
+    }
+
+    // 3. The results, the update also makes them the golden timings.
+    FILE* json = fopen(jsonPath.c_str(), "w");
+    if (json == NULL) {
+        printf("Error: unable to open '%s'\n", jsonPath.c_str());
+    } else {
+        writeJSON(json, runs);
+        fclose(json);
+        printf("Wrote '%s'\n", jsonPath.c_str());
+    }
+    if (update) {
+        if (copyFile(jsonPath, timingsPath)) {
+            printf("Updated the golden images and timings in '%s'\n", goldenDir.c_str());
+        } else {
+            printf("Error: unable to write '%s'\n", timingsPath.c_str());
+            failed++;
+        }
+    }
+
+    printf("%d of %zu runs failed (tolerance %d, max %.2f%% differing pixels)\n", failed, runs.size(), tolerance,
+           maxBadPercent);
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,516 @@
+/**
+ * Shader statistics report of the demo programs ("shader_stats").
+ *
+ * Reads the program sources dumped by the demos (GLES_SHADER_DUMP_DIR, see
+ * common/program_cache.h): one directory per demo run with NNN.vert + NNN.frag
+ * or NNN.comp files per program. The "shader_report" build target runs the
+ * demos (cube, floor, depth cube, wireframe, compute) with the dump enabled and
+ * then this report.
+ *
+ * Every program is built by the driver of the context: the size of its
+ * program binary (GL_PROGRAM_BINARY_LENGTH), the compile + link time and the
+ * active uniforms are the portable cost proxies. If the Mali Offline Compiler
+ * ("malioc") is found (or given with "--malioc") every stage is also compiled
+ * for a Mali core and the report has the cycle estimates of the longest path
+ * (arithmetic, load/store, varying and texture units) and the work registers.
+ * Other vendor compilers (ex.: the Adreno offline compiler) fit in the same
+ * per stage columns, only the Mali one is integrated.
+ *
+ * Regression tracking: "--baseline" compares with the JSON of an earlier run,
+ * every binary size, cycle count or register count that grew by more than
+ * "--threshold" percent is printed and the exit code is 1 (for CI). The build
+ * times are not compared, they depend on the load of the machine.
+ *
+ * Run:
+ * $ make shader_report
+ * $ ./shader_stats shader_dump --json shader_stats.json --baseline old_shader_stats.json
+ *
+ * Options (and the options of the demo context):
+ *  --malioc PATH     The Mali Offline Compiler (default: "malioc" if it is in the PATH).
+ *  --core NAME       Mali core of malioc (ex.: Mali-G78, default: the malioc default).
+ *  --json FILE       Write the report as JSON (default: shader_stats.json).
+ *  --baseline FILE   Compare with an earlier JSON report.
+ *  --threshold PCT   Allowed growth before a value counts as a regression (default: 5).
+ *
+ * JSON output, one program per line (the baseline is read back line by line):
+ *
+ *   { "renderer": ..., "programs": [
+ *     { "name": "07_gles_floor/000", "binary_bytes": N, "build_ms": T, "uniforms": N, "stages": [
+ *       { "stage": "vert", "alu": C, "load_store": C, "varying": C, "texture": C, "work_registers": N }, ... ] },
+ *     ... ] }
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.0+ (3.1+ for the compute programs)
+ *  * Mali Offline Compiler (optional)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <GLES3/gl31.h>
+
+#include "common/demo_context.h"
+
+// Offline compiler estimates of one stage (negative: not available).
+struct StageStats {
+    std::string stage; // "vert", "frag" or "comp"
+    std::string path;
+    double alu;
+    double loadStore;
+    double varying;
+    double texture;
+    int workRegisters;
+};
+
+struct ProgramStats {
+    std::string name; // "<demo>/<NNN>"
+    std::vector<StageStats> stages;
+    bool built;
+    int binaryBytes;
+    double buildMs;
+    int uniforms;
+};
+
+static bool readFile(const std::string& path, std::string* text) {
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    *text = stream.str();
+    return true;
+}
+
+static std::vector<std::string> listDirectory(const std::string& path) {
+    std::vector<std::string> names;
+    DIR* dir = opendir(path.c_str());
+    if (dir == NULL) {
+        return names;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            names.push_back(entry->d_name);
+        }
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+// 1. The programs of the dump: the stage files of a demo grouped by their number.
+static std::vector<ProgramStats> collectPrograms(const std::string& dumpDir) {
+    std::vector<ProgramStats> programs;
+    for (const std::string& demo : listDirectory(dumpDir)) {
+        std::string demoDir = dumpDir + "/" + demo;
+        struct stat info;
+        if (stat(demoDir.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) {
+            continue;
+        }
+
+        for (const std::string& file : listDirectory(demoDir)) {
+            size_t dot = file.rfind('.');
+            if (dot == std::string::npos) {
+                continue;
+            }
+            std::string name = demo + "/" + file.substr(0, dot);
+            std::string stage = file.substr(dot + 1);
+            if (stage != "vert" && stage != "frag" && stage != "comp") {
+                continue;
+            }
+
+            if (programs.empty() || programs.back().name != name) {
+                ProgramStats program;
+                program.name = name;
+                program.built = false;
+                program.binaryBytes = 0;
+                program.buildMs = 0.0;
+                program.uniforms = 0;
+                programs.push_back(program);
+            }
+            StageStats stats = { stage, demoDir + "/" + file, -1.0, -1.0, -1.0, -1.0, -1 };
+            programs.back().stages.push_back(stats);
+        }
+    }
+
+    // The vertex stage first (the files are sorted by name: "frag" < "vert").
+    for (ProgramStats& program : programs) {
+        std::stable_sort(program.stages.begin(), program.stages.end(),
+                         [](const StageStats& a, const StageStats& b) { return a.stage == "vert" && b.stage != "vert"; });
+    }
+    return programs;
+}
+
+static GLenum stageType(const std::string& stage) {
+    return stage == "vert" ? GL_VERTEX_SHADER : stage == "frag" ? GL_FRAGMENT_SHADER : GL_COMPUTE_SHADER;
+}
+
+// 2. Build the program with the driver: binary size, build time and active uniforms.
+static void buildProgram(const DemoContext* demo, ProgramStats* program) {
+    unsigned int handle = glCreateProgram();
+    std::vector<unsigned int> shaders;
+
+    glFinish();
+    double startTime = demoGetTime(demo);
+    for (const StageStats& stage : program->stages) {
+        std::string source;
+        if (!readFile(stage.path, &source)) {
+            printf("Error: unable to read '%s'\n", stage.path.c_str());
+            continue;
+        }
+        const char* src = source.c_str();
+        unsigned int shader = glCreateShader(stageType(stage.stage));
+        glShaderSource(shader, 1, &src, NULL);
+        glCompileShader(shader);
+        glAttachShader(handle, shader);
+        shaders.push_back(shader);
+    }
+    glProgramParameteri(handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(handle);
+
+    int success = 0;
+    glGetProgramiv(handle, GL_LINK_STATUS, &success);
+    program->buildMs = (demoGetTime(demo) - startTime) * 1000.0;
+    program->built = success != 0;
+    if (success) {
+        glGetProgramiv(handle, GL_PROGRAM_BINARY_LENGTH, &program->binaryBytes);
+        glGetProgramiv(handle, GL_ACTIVE_UNIFORMS, &program->uniforms);
+    } else {
+        char info[512];
+        glGetProgramInfoLog(handle, 512, NULL, info);
+        printf("%s: build error:\n%s\n", program->name.c_str(), info);
+    }
+
+    for (unsigned int shader : shaders) {
+        glDeleteShader(shader);
+    }
+    glDeleteProgram(handle);
+}
+
+// 3. The malioc estimates of a stage: the first "Work registers" and "Longest path cycles" of its report.
+/* The cycle columns depend on the architecture (Midgard: A LS T, Bifrost: A LS V T, Valhall: FMA CVT SFU
+ * LS V T), they are named by the header line which ends with "Bound". The arithmetic cost is the busiest
+ * arithmetic unit. */
+static void runMalioc(const std::string& malioc, const std::string& core, StageStats* stage) {
+    const char* stageOption = stage->stage == "vert" ? "--vertex" : stage->stage == "frag" ? "--fragment" : "--compute";
+    std::string command = "'" + malioc + "' " + (core.empty() ? "" : "--core '" + core + "' ") + stageOption +
+                          " '" + stage->path + "' 2>&1";
+    FILE* pipe = popen(command.c_str(), "r");
+    if (pipe == NULL) {
+        return;
+    }
+
+    std::vector<std::string> columns;
+    bool cyclesFound = false;
+    char line[1024];
+    while (fgets(line, sizeof(line), pipe)) {
+        const char* registers = strstr(line, "Work registers:");
+        if (registers != NULL && stage->workRegisters < 0) {
+            stage->workRegisters = atoi(registers + strlen("Work registers:"));
+        }
+
+        if (strstr(line, "Bound") != NULL && columns.empty()) {
+            std::istringstream tokens(line);
+            std::string token;
+            while (tokens >> token && token != "Bound") {
+                columns.push_back(token);
+            }
+        }
+
+        const char* cycles = strstr(line, "Longest path cycles:");
+        if (cycles != NULL && !cyclesFound && !columns.empty()) {
+            cyclesFound = true;
+            stage->alu = stage->loadStore = stage->varying = stage->texture = 0.0;
+
+            std::istringstream values(cycles + strlen("Longest path cycles:"));
+            for (const std::string& column : columns) {
+                double value = 0.0;
+                if (!(values >> value)) {
+                    break;
+                }
+                if (column == "LS") {
+                    stage->loadStore = value;
+                } else if (column == "V") {
+                    stage->varying = value;
+                } else if (column == "T") {
+                    stage->texture = value;
+                } else {
+                    stage->alu = std::max(stage->alu, value);
+                }
+            }
+        }
+    }
+    pclose(pipe);
+}
+
+static std::string findInPath(const char* name) {
+    std::string command = std::string("command -v ") + name + " 2>/dev/null";
+    FILE* pipe = popen(command.c_str(), "r");
+    if (pipe == NULL) {
+        return "";
+    }
+    char line[1024] = { 0 };
+    std::string path = fgets(line, sizeof(line), pipe) ? line : "";
+    pclose(pipe);
+    while (!path.empty() && (path.back() == '\n' || path.back() == '\r')) {
+        path.pop_back();
+    }
+    return path;
+}
+
+static void writeJSONString(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', file);
+        }
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+static void writeJSON(FILE* file, const std::vector<ProgramStats>& programs) {
+    fprintf(file, "{ \"renderer\": ");
+    writeJSONString(file, (const char*)glGetString(GL_RENDERER));
+    fprintf(file, ", \"programs\": [");
+    for (size_t idx = 0; idx < programs.size(); idx++) {
+        const ProgramStats& program = programs[idx];
+        fprintf(file, "%s\n  { \"name\": ", idx ? "," : "");
+        writeJSONString(file, program.name.c_str());
+        fprintf(file, ", \"binary_bytes\": %d, \"build_ms\": %.3f, \"uniforms\": %d, \"stages\": [",
+                program.binaryBytes, program.buildMs, program.uniforms);
+        for (size_t stage = 0; stage < program.stages.size(); stage++) {
+            const StageStats& stats = program.stages[stage];
+            fprintf(file, "%s { \"stage\": \"%s\", \"alu\": %.3f, \"load_store\": %.3f, \"varying\": %.3f, "
+                    "\"texture\": %.3f, \"work_registers\": %d }", stage ? "," : "", stats.stage.c_str(), stats.alu,
+                    stats.loadStore, stats.varying, stats.texture, stats.workRegisters);
+        }
+        fprintf(file, " ] }");
+    }
+    fprintf(file, "\n] }\n");
+}
+
+// The number after "key": at or after "from" in a line of the JSON report (false if missing).
+static bool jsonNumber(const std::string& line, const char* key, size_t* from, double* value) {
+    size_t position = line.find("\"" + std::string(key) + "\": ", *from);
+    if (position == std::string::npos) {
+        return false;
+    }
+    *from = position + strlen(key) + 4;
+    *value = atof(line.c_str() + *from);
+    return true;
+}
+
+// 4. Read a baseline report (the lines written by writeJSON).
+static std::vector<ProgramStats> readBaseline(const char* path) {
+    std::vector<ProgramStats> programs;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t name = line.find("{ \"name\": \"");
+        if (name == std::string::npos) {
+            continue;
+        }
+
+        ProgramStats program;
+        size_t nameStart = name + strlen("{ \"name\": \"");
+        program.name = line.substr(nameStart, line.find('"', nameStart) - nameStart);
+        program.built = true;
+
+        size_t from = nameStart;
+        double value = 0.0;
+        jsonNumber(line, "binary_bytes", &from, &value);
+        program.binaryBytes = (int)value;
+        program.buildMs = 0.0;
+        program.uniforms = 0;
+
+        StageStats stage;
+        while (jsonNumber(line, "alu", &from, &stage.alu)) {
+            jsonNumber(line, "load_store", &from, &stage.loadStore);
+            jsonNumber(line, "varying", &from, &stage.varying);
+            jsonNumber(line, "texture", &from, &stage.texture);
+            jsonNumber(line, "work_registers", &from, &value);
+            stage.workRegisters = (int)value;
+            program.stages.push_back(stage);
+        }
+        programs.push_back(program);
+    }
+    return programs;
+}
+
+// True (and prints it) if "value" grew by more than "threshold" percent from "base".
+static bool checkRegression(const std::string& name, const char* metric, double base, double value, double threshold) {
+    if (base <= 0.0 || value <= base * (1.0 + threshold / 100.0)) {
+        return false;
+    }
+    printf("Regression: %s %s %.6g -> %.6g (+%.1f%%)\n", name.c_str(), metric, base, value,
+           (value / base - 1.0) * 100.0);
+    return true;
+}
+
+static int compareBaseline(const std::vector<ProgramStats>& programs, const std::vector<ProgramStats>& baseline,
+                           double threshold) {
+    int regressions = 0;
+    for (const ProgramStats& program : programs) {
+        const ProgramStats* base = NULL;
+        for (const ProgramStats& candidate : baseline) {
+            if (candidate.name == program.name) {
+                base = &candidate;
+                break;
+            }
+        }
+        if (base == NULL) {
+            printf("New program: %s\n", program.name.c_str());
+            continue;
+        }
+
+        regressions += checkRegression(program.name, "binary bytes", base->binaryBytes, program.binaryBytes, threshold);
+        for (size_t idx = 0; idx < program.stages.size() && idx < base->stages.size(); idx++) {
+            const StageStats& stage = program.stages[idx];
+            const StageStats& old = base->stages[idx];
+            std::string name = program.name + "." + stage.stage;
+            regressions += checkRegression(name, "alu cycles", old.alu, stage.alu, threshold);
+            regressions += checkRegression(name, "load/store cycles", old.loadStore, stage.loadStore, threshold);
+            regressions += checkRegression(name, "varying cycles", old.varying, stage.varying, threshold);
+            regressions += checkRegression(name, "texture cycles", old.texture, stage.texture, threshold);
+            regressions += checkRegression(name, "work registers", old.workRegisters, stage.workRegisters, threshold);
+        }
+    }
+    return regressions;
+}
+
+int main(int argc, char **argv) {
+    // 1. Parse the options.
+    if (argc < 2 || argv[1][0] == '-') {
+        printf("Usage: %s <dump dir> [--malioc PATH] [--core NAME] [--json FILE] [--baseline FILE] [--threshold PCT]\n",
+               argv[0]);
+        return -1;
+    }
+
+    const char* dumpDir = argv[1];
+    std::string malioc;
+    std::string core;
+    const char* jsonPath = "shader_stats.json";
+    const char* baselinePath = NULL;
+    double threshold = 5.0;
+    bool headless = false;
+    for (int idx = 2; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--malioc") == 0 && idx + 1 < argc) {
+            malioc = argv[++idx];
+        } else if (strcmp(argv[idx], "--core") == 0 && idx + 1 < argc) {
+            core = argv[++idx];
+        } else if (strcmp(argv[idx], "--json") == 0 && idx + 1 < argc) {
+            jsonPath = argv[++idx];
+        } else if (strcmp(argv[idx], "--baseline") == 0 && idx + 1 < argc) {
+            baselinePath = argv[++idx];
+        } else if (strcmp(argv[idx], "--threshold") == 0 && idx + 1 < argc) {
+            threshold = std::max(0.0, atof(argv[++idx]));
+        } else if (strcmp(argv[idx], "--headless") == 0 || strcmp(argv[idx], "--surfaceless") == 0) {
+            headless = true;
+        }
+    }
+
+    std::vector<ProgramStats> programs = collectPrograms(dumpDir);
+    if (programs.empty()) {
+        printf("Error: no program sources in '%s' (run the demos with GLES_SHADER_DUMP_DIR=%s/<demo>)\n", dumpDir,
+               dumpDir);
+        return -1;
+    }
+    if (malioc.empty()) {
+        malioc = findInPath("malioc");
+    }
+
+    // 2. The headless context of the driver proxy.
+    std::vector<char*> contextArgs(argv, argv + argc);
+    char headlessOption[] = "--headless";
+    if (!headless) {
+        contextArgs.push_back(headlessOption);
+    }
+
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, (int)contextArgs.size(), contextArgs.data(), "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
+    demo.frameLimit = 0;
+
+    // 3. Build every program and run the offline compiler on its stages.
+    printf("Offline compiler: %s\n", malioc.empty() ? "none (malioc not found), driver proxy only" : malioc.c_str());
+    printf("%-32s %10s %9s %8s  %s\n", "program", "binary", "build ms", "uniforms", "stage: alu / ls / varying / tex cycles, registers");
+    for (ProgramStats& program : programs) {
+        buildProgram(&demo, &program);
+        printf("%-32s %10d %9.2f %8d ", program.name.c_str(), program.binaryBytes, program.buildMs, program.uniforms);
+        for (StageStats& stage : program.stages) {
+            if (!malioc.empty()) {
+                runMalioc(malioc, core, &stage);
+            }
+            if (stage.alu >= 0.0) {
+                printf(" %s: %.2f / %.2f / %.2f / %.2f, %d", stage.stage.c_str(), stage.alu, stage.loadStore,
+                       stage.varying, stage.texture, stage.workRegisters);
+            } else {
+                printf(" %s", stage.stage.c_str());
+            }
+        }
+        printf("\n");
+    }
+
+    FILE* json = fopen(jsonPath, "w");
+    if (json == NULL) {
+        printf("Error: unable to open '%s'\n", jsonPath);
+    } else {
+        writeJSON(json, programs);
+        fclose(json);
+        printf("Wrote '%s'\n", jsonPath);
+    }
+
+    int failed = 0;
+    for (const ProgramStats& program : programs) {
+        failed += program.built ? 0 : 1;
+    }
+
+    // 4. Regressions against the baseline.
+    int regressions = 0;
+    if (baselinePath != NULL) {
+        std::vector<ProgramStats> baseline = readBaseline(baselinePath);
+        if (baseline.empty()) {
+            printf("Error: no programs in the baseline '%s'\n", baselinePath);
+            regressions = 1;
+        } else {
+            regressions = compareBaseline(programs, baseline, threshold);
+            printf("%d regressions above %.1f%% against '%s'\n", regressions, threshold, baselinePath);
+        }
+    }
+
+    destroyDemoContext(&demo);
+    return (failed > 0 || regressions > 0) ? 1 : 0;
+}
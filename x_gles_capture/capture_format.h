@@ -0,0 +1,206 @@
+/**
+ * Binary format of the GL frame captures (written by gl_capture.cpp, read by gl_replay.cpp).
+ *
+ * A capture file starts with a CaptureHeader followed by the records of
+ * the GL calls in call order. Every record is a CaptureRecord header and
+ * "size" bytes of payload. The payload is a sequence of 32 bit words:
+ *
+ *  * integers, enums and object names are one word (the object names are
+ *    the names of the captured process, the replay maps them),
+ *  * floats are one word (IEEE bit pattern),
+ *  * offsets, sizes and sync handles are two words (low word first),
+ *  * data blocks (buffer/texture contents, shader sources, names) are a
+ *    length word and the bytes, padded to a multiple of 4 bytes.
+ *
+ * The file contains every call of the process from its start until the end
+ * of the captured frame: the calls before CAPTURE_FRAME_BEGIN create the
+ * resources and the state the frame depends on (instead of snapshotting
+ * the objects), the calls between CAPTURE_FRAME_BEGIN and CAPTURE_FRAME_END
+ * are the frame itself.
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#ifndef GLES_CAPTURE_FORMAT_H
+#define GLES_CAPTURE_FORMAT_H
+
+#include <stdint.h>
+
+#define CAPTURE_MAGIC "GLESCAP1"
+#define CAPTURE_VERSION 1
+
+// Vertex attributes which can be sourced from client memory (CAPTURE_CLIENT_ARRAY).
+#define CAPTURE_MAX_ATTRIBS 16
+
+struct CaptureHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t frame; // index of the captured frame
+};
+
+struct CaptureRecord {
+    uint32_t op;   // CaptureOp
+    uint32_t size; // payload bytes
+};
+
+// The recorded calls.
+/* The payload of a record is the arguments of the call in order, except where noted. */
+enum CaptureOp {
+    CAPTURE_FRAME_BEGIN,
+    CAPTURE_FRAME_END,
+
+    // State.
+    CAPTURE_ENABLE,
+    CAPTURE_DISABLE,
+    CAPTURE_BLEND_FUNC,
+    CAPTURE_BLEND_FUNC_SEPARATE,
+    CAPTURE_BLEND_EQUATION,
+    CAPTURE_CULL_FACE,
+    CAPTURE_FRONT_FACE,
+    CAPTURE_DEPTH_FUNC,
+    CAPTURE_DEPTH_MASK,
+    CAPTURE_COLOR_MASK,
+    CAPTURE_POLYGON_OFFSET,
+    CAPTURE_LINE_WIDTH,
+    CAPTURE_STENCIL_FUNC,
+    CAPTURE_STENCIL_OP,
+    CAPTURE_STENCIL_MASK,
+    CAPTURE_VIEWPORT,
+    CAPTURE_SCISSOR,
+    CAPTURE_CLEAR_COLOR,
+    CAPTURE_CLEAR_DEPTH,
+    CAPTURE_CLEAR_STENCIL,
+    CAPTURE_CLEAR,
+    CAPTURE_PIXEL_STORE,
+    CAPTURE_FLUSH,
+    CAPTURE_FINISH,
+
+    // Buffers.
+    CAPTURE_GEN_BUFFERS,             // count, names
+    CAPTURE_DELETE_BUFFERS,          // count, names
+    CAPTURE_BIND_BUFFER,
+    CAPTURE_BIND_BUFFER_BASE,
+    CAPTURE_BIND_BUFFER_RANGE,
+    CAPTURE_BUFFER_DATA,             // target, size, usage, has data, data
+    CAPTURE_BUFFER_SUB_DATA,         // target, offset, data
+    CAPTURE_COPY_BUFFER_SUB_DATA,
+    CAPTURE_MAP_BUFFER_RANGE,        // target, offset, length, access
+    CAPTURE_UNMAP_BUFFER,            // target, written data (empty for read mappings)
+
+    // Vertex arrays.
+    CAPTURE_GEN_VERTEX_ARRAYS,
+    CAPTURE_DELETE_VERTEX_ARRAYS,
+    CAPTURE_BIND_VERTEX_ARRAY,
+    CAPTURE_VERTEX_ATTRIB_POINTER,   // index, size, type, normalized, stride, offset (buffer sourced)
+    CAPTURE_VERTEX_ATTRIB_I_POINTER, // index, size, type, stride, offset (buffer sourced)
+    CAPTURE_CLIENT_ARRAY,            // index, size, type, normalized, integer, stride, data (client memory, before a draw)
+    CAPTURE_ENABLE_VERTEX_ATTRIB_ARRAY,
+    CAPTURE_DISABLE_VERTEX_ATTRIB_ARRAY,
+    CAPTURE_VERTEX_ATTRIB_DIVISOR,
+    CAPTURE_VERTEX_ATTRIB_4F,
+
+    // Textures.
+    CAPTURE_GEN_TEXTURES,
+    CAPTURE_DELETE_TEXTURES,
+    CAPTURE_ACTIVE_TEXTURE,
+    CAPTURE_BIND_TEXTURE,
+    CAPTURE_TEX_PARAMETER_I,
+    CAPTURE_TEX_PARAMETER_F,
+    CAPTURE_TEX_STORAGE_2D,
+    CAPTURE_TEX_STORAGE_3D,
+    CAPTURE_TEX_IMAGE_2D,             // target, level, internal format, width, height, format, type, pixels (*)
+    CAPTURE_TEX_SUB_IMAGE_2D,         // target, level, x, y, width, height, format, type, pixels (*)
+    CAPTURE_TEX_SUB_IMAGE_3D,         // target, level, x, y, z, width, height, depth, format, type, pixels (*)
+    CAPTURE_COMPRESSED_TEX_IMAGE_2D,  // target, level, internal format, width, height, image size, pixels (*)
+    CAPTURE_COMPRESSED_TEX_SUB_IMAGE_2D, // target, level, x, y, width, height, format, image size, pixels (*)
+    CAPTURE_GENERATE_MIPMAP,
+    CAPTURE_BIND_IMAGE_TEXTURE,
+    /* (*) pixels: a "from unpack buffer" word, then the offset or the data. */
+
+    // Framebuffers.
+    CAPTURE_GEN_FRAMEBUFFERS,
+    CAPTURE_DELETE_FRAMEBUFFERS,
+    CAPTURE_BIND_FRAMEBUFFER,
+    CAPTURE_FRAMEBUFFER_TEXTURE_2D,
+    CAPTURE_FRAMEBUFFER_TEXTURE_LAYER,
+    CAPTURE_FRAMEBUFFER_RENDERBUFFER,
+    CAPTURE_GEN_RENDERBUFFERS,
+    CAPTURE_DELETE_RENDERBUFFERS,
+    CAPTURE_BIND_RENDERBUFFER,
+    CAPTURE_RENDERBUFFER_STORAGE,
+    CAPTURE_RENDERBUFFER_STORAGE_MULTISAMPLE,
+    CAPTURE_BLIT_FRAMEBUFFER,
+    CAPTURE_INVALIDATE_FRAMEBUFFER,  // target, count, attachments
+    CAPTURE_READ_BUFFER,
+    CAPTURE_DRAW_BUFFERS,            // count, buffers
+    CAPTURE_READ_PIXELS,             // x, y, width, height, format, type, "into pack buffer", offset
+
+    // Shaders and programs (one name space).
+    CAPTURE_CREATE_SHADER,           // type, name
+    CAPTURE_SHADER_SOURCE,           // shader, source (the strings joined)
+    CAPTURE_COMPILE_SHADER,
+    CAPTURE_DELETE_SHADER,
+    CAPTURE_CREATE_PROGRAM,          // name
+    CAPTURE_ATTACH_SHADER,
+    CAPTURE_DETACH_SHADER,
+    CAPTURE_BIND_ATTRIB_LOCATION,    // program, index, name
+    CAPTURE_PROGRAM_PARAMETER,
+    CAPTURE_LINK_PROGRAM,
+    CAPTURE_DELETE_PROGRAM,
+    CAPTURE_USE_PROGRAM,
+    CAPTURE_UNIFORM_LOCATION,        // program, name, location (result of glGetUniformLocation)
+    CAPTURE_UNIFORM_BLOCK_INDEX,     // program, name, index (result of glGetUniformBlockIndex)
+    CAPTURE_UNIFORM_BLOCK_BINDING,
+
+    // Uniforms (location first).
+    CAPTURE_UNIFORM_1I,
+    CAPTURE_UNIFORM_2I,
+    CAPTURE_UNIFORM_3I,
+    CAPTURE_UNIFORM_4I,
+    CAPTURE_UNIFORM_1UI,
+    CAPTURE_UNIFORM_1F,
+    CAPTURE_UNIFORM_2F,
+    CAPTURE_UNIFORM_3F,
+    CAPTURE_UNIFORM_4F,
+    CAPTURE_UNIFORM_4FV,             // location, count, values
+    CAPTURE_UNIFORM_MATRIX_3FV,      // location, count, transpose, values
+    CAPTURE_UNIFORM_MATRIX_4FV,      // location, count, transpose, values
+
+    // Draws and dispatches.
+    CAPTURE_DRAW_ARRAYS,
+    CAPTURE_DRAW_ARRAYS_INSTANCED,
+    CAPTURE_DRAW_ELEMENTS,           // mode, count, type, instance count (-1: not instanced), "client indices", offset or indices
+    CAPTURE_DRAW_ARRAYS_INDIRECT,
+    CAPTURE_DRAW_ELEMENTS_INDIRECT,
+    CAPTURE_DISPATCH_COMPUTE,
+    CAPTURE_DISPATCH_COMPUTE_INDIRECT,
+    CAPTURE_MEMORY_BARRIER,
+
+    // Synchronization (the handles are mapped like the names).
+    CAPTURE_FENCE_SYNC,              // condition, flags, handle
+    CAPTURE_CLIENT_WAIT_SYNC,
+    CAPTURE_WAIT_SYNC,
+    CAPTURE_DELETE_SYNC,
+
+    CAPTURE_OP_COUNT
+};
+
+#endif // GLES_CAPTURE_FORMAT_H
@@ -0,0 +1,1374 @@
+/**
+ * GL frame capture layer: records one frame of any demo into a capture file
+ * (see capture_format.h), replayed by "x_gles_replay".
+ *
+ * The library is preloaded into the demo process and defines the GL ES
+ * entry points used by the demos: every wrapper forwards the call to the
+ * driver and records it with its data (buffer and texture contents, shader
+ * sources, client side vertex arrays and indices). The calls of the frames
+ * before the captured one are recorded too, the replay uses them to
+ * recreate the resources and the state at the start of the frame.
+ *
+ * The frames are counted by the "glesCaptureEndFrame" hook of
+ * demoSwapBuffers (common/demo_context.cpp) or by eglSwapBuffers if the
+ * hook is not called. The file is closed at the end of the captured frame,
+ * the process keeps running without recording.
+ *
+ * Limitations:
+ *  * Only the calls of the thread which issued the first GL call are
+ *    recorded (ex.: the uploads of the common/gl_workers.h threads are not).
+ *  * glProgramBinary is not forwarded: the program cache falls back to
+ *    compiling the sources, which are recorded.
+ *  * The attribute locations are assumed to be the same in the replay
+ *    (the uniform locations and the uniform block indices are remapped).
+ *  * The entry points looked up by GLFW are not wrapped: glfwGetProcAddress
+ *    and the GLFW swap bypass the layer (the hook counts those frames).
+ *
+ * Environment variables:
+ *  GLCAPTURE_FILE    Capture file (default: frame.glcap).
+ *  GLCAPTURE_FRAME   Index of the captured frame (default: 1, the frame 0 is a warm-up frame).
+ *
+ * Run:
+ * $ LD_PRELOAD=./libgles_capture.so GLCAPTURE_FRAME=10 ./07_gles_cube --surfaceless --frames 11
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.1+
+ *  * EGL
+ *  * dlsym(RTLD_NEXT)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include "x_gles_capture/capture_format.h"
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES3/gl31.h>
+
+// Attribute of the vertex array 0 sourced from client memory.
+struct ClientArray {
+    bool enabled;
+    bool client;
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    bool integer;
+    GLsizei stride;
+    const void* pointer;
+    GLuint divisor;
+};
+
+struct CaptureState {
+    bool initialized;
+    bool recording;
+    bool frameHook;
+    FILE* file;
+    const char* path;
+    int captureFrame;
+    int frameIndex;
+    std::thread::id thread;
+
+    // Record being built.
+    uint32_t op;
+    std::vector<uint32_t> payload;
+
+    uint64_t recordCount;
+    uint64_t byteCount;
+
+    // Bound vertex array: the client arrays are only allowed with the vertex array 0.
+    GLuint vertexArray;
+    ClientArray clientArrays[CAPTURE_MAX_ATTRIBS];
+};
+
+static CaptureState g_capture;
+
+static void* realSymbol(const char* name, bool procAddress) {
+    void* symbol = dlsym(RTLD_NEXT, name);
+
+    /* Entry points which are not exported by the GL library (ex.: ES 3.1 on an older libGLESv2). */
+    if (symbol == NULL && procAddress) {
+        typedef void* (*GetProcAddress)(const char*);
+        static GetProcAddress getProcAddress = (GetProcAddress)dlsym(RTLD_NEXT, "eglGetProcAddress");
+        if (getProcAddress != NULL) {
+            symbol = getProcAddress(name);
+        }
+    }
+
+    if (symbol == NULL) {
+        printf("GL capture: '%s' was not found\n", name);
+        abort();
+    }
+    return symbol;
+}
+
+// The driver's entry point of a wrapped function (looked up at the first call).
+#define REAL(name) ([]() { static decltype(&name) fn = (decltype(&name))realSymbol(#name, true); return fn; }())
+
+static void beginRecord(uint32_t op) {
+    g_capture.op = op;
+    g_capture.payload.clear();
+}
+
+static void put(uint32_t value) {
+    g_capture.payload.push_back(value);
+}
+
+static void put(int32_t value) {
+    g_capture.payload.push_back((uint32_t)value);
+}
+
+static void put(GLboolean value) {
+    g_capture.payload.push_back(value);
+}
+
+static void put(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    g_capture.payload.push_back(bits);
+}
+
+static void put(uint64_t value) {
+    g_capture.payload.push_back((uint32_t)value);
+    g_capture.payload.push_back((uint32_t)(value >> 32));
+}
+
+static void put(int64_t value) {
+    put((uint64_t)value);
+}
+
+static void putData(const void* data, size_t size) {
+    g_capture.payload.push_back((uint32_t)size);
+
+    size_t start = g_capture.payload.size();
+    g_capture.payload.resize(start + (size + 3) / 4, 0);
+    if (size > 0) {
+        memcpy(&g_capture.payload[start], data, size);
+    }
+}
+
+static void putString(const char* text) {
+    putData(text, strlen(text));
+}
+
+static void endRecord() {
+    CaptureRecord record = { g_capture.op, (uint32_t)(g_capture.payload.size() * 4) };
+    fwrite(&record, sizeof(record), 1, g_capture.file);
+    fwrite(g_capture.payload.data(), 4, g_capture.payload.size(), g_capture.file);
+
+    g_capture.recordCount++;
+    g_capture.byteCount += sizeof(record) + record.size;
+}
+
+static void initCapture() {
+    g_capture.initialized = true;
+    g_capture.thread = std::this_thread::get_id();
+
+    const char* path = getenv("GLCAPTURE_FILE");
+    const char* frame = getenv("GLCAPTURE_FRAME");
+    g_capture.path = path ? path : "frame.glcap";
+    g_capture.captureFrame = frame ? atoi(frame) : 1;
+
+    g_capture.file = fopen(g_capture.path, "wb");
+    if (g_capture.file == NULL) {
+        printf("GL capture: unable to open '%s'\n", g_capture.path);
+        return;
+    }
+
+    CaptureHeader header;
+    memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+    header.version = CAPTURE_VERSION;
+    header.frame = (uint32_t)g_capture.captureFrame;
+    fwrite(&header, sizeof(header), 1, g_capture.file);
+
+    g_capture.recording = true;
+    if (g_capture.captureFrame == 0) {
+        beginRecord(CAPTURE_FRAME_BEGIN);
+        endRecord();
+    }
+}
+
+// Returns true if the calls of the current thread are recorded.
+static bool capturing() {
+    if (!g_capture.initialized) {
+        initCapture();
+    }
+    return g_capture.recording && std::this_thread::get_id() == g_capture.thread;
+}
+
+// Record a call with scalar arguments.
+template <typename... Args>
+static void record(uint32_t op, Args... args) {
+    if (!capturing()) {
+        return;
+    }
+
+    beginRecord(op);
+    int expand[] = { 0, (put(args), 0)... };
+    (void)expand;
+    endRecord();
+}
+
+static void recordNames(uint32_t op, GLsizei count, const GLuint* names) {
+    if (!capturing()) {
+        return;
+    }
+
+    beginRecord(op);
+    put(count);
+    for (GLsizei idx = 0; idx < count; idx++) {
+        put(names[idx]);
+    }
+    endRecord();
+}
+
+static void captureEndFrame() {
+    if (!capturing()) {
+        return;
+    }
+
+    if (g_capture.frameIndex == g_capture.captureFrame) {
+        beginRecord(CAPTURE_FRAME_END);
+        endRecord();
+
+        fclose(g_capture.file);
+        g_capture.file = NULL;
+        g_capture.recording = false;
+        printf("GL capture: frame %d written to '%s' (%llu calls, %.1f MiB)\n", g_capture.captureFrame,
+               g_capture.path, (unsigned long long)g_capture.recordCount, g_capture.byteCount / (1024.0 * 1024.0));
+        return;
+    }
+
+    g_capture.frameIndex++;
+    if (g_capture.frameIndex == g_capture.captureFrame) {
+        beginRecord(CAPTURE_FRAME_BEGIN);
+        endRecord();
+    }
+}
+
+__attribute__((destructor)) static void finishCapture() {
+    if (g_capture.file != NULL) {
+        fclose(g_capture.file);
+        printf("GL capture: the process exited before the end of frame %d, '%s' is incomplete\n",
+               g_capture.captureFrame, g_capture.path);
+    }
+}
+
+// Bytes of one pixel of a glTexImage format/type pair.
+static size_t pixelBytes(GLenum format, GLenum type) {
+    switch (type) {
+    case GL_UNSIGNED_SHORT_5_6_5:
+    case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+        return 2;
+    case GL_UNSIGNED_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_10F_11F_11F_REV:
+    case GL_UNSIGNED_INT_5_9_9_9_REV:
+    case GL_UNSIGNED_INT_24_8:
+        return 4;
+    case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+        return 8;
+    }
+
+    size_t components = 1;
+    switch (format) {
+    case GL_RGBA:
+    case GL_RGBA_INTEGER:
+        components = 4;
+        break;
+    case GL_RGB:
+    case GL_RGB_INTEGER:
+        components = 3;
+        break;
+    case GL_RG:
+    case GL_RG_INTEGER:
+    case GL_LUMINANCE_ALPHA:
+        components = 2;
+        break;
+    }
+
+    switch (type) {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+        return components;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+    case GL_HALF_FLOAT:
+        return components * 2;
+    default:
+        return components * 4;
+    }
+}
+
+// Bytes read by a texture upload from the client memory (follows the unpack state).
+static size_t imageBytes(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, bool image3D) {
+    if (width <= 0 || height <= 0 || depth <= 0) {
+        return 0;
+    }
+
+    GLint alignment = 4, rowLength = 0, skipRows = 0, skipPixels = 0, imageHeight = 0, skipImages = 0;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glGetIntegerv(GL_UNPACK_ROW_LENGTH, &rowLength);
+    glGetIntegerv(GL_UNPACK_SKIP_ROWS, &skipRows);
+    glGetIntegerv(GL_UNPACK_SKIP_PIXELS, &skipPixels);
+    if (image3D) {
+        glGetIntegerv(GL_UNPACK_IMAGE_HEIGHT, &imageHeight);
+        glGetIntegerv(GL_UNPACK_SKIP_IMAGES, &skipImages);
+    }
+
+    size_t pixel = pixelBytes(format, type);
+    size_t rowBytes = (size_t)(rowLength ? rowLength : width) * pixel;
+    rowBytes = (rowBytes + alignment - 1) / alignment * alignment;
+    size_t imageRows = imageHeight ? imageHeight : height;
+
+    /* The last row is not padded to the alignment. */
+    size_t rows = (skipImages + depth - 1) * imageRows + skipRows + height - 1;
+    return rows * rowBytes + (skipPixels + width) * pixel;
+}
+
+// Texture data: from the bound unpack buffer (offset) or from the client memory.
+static void putPixels(const void* pixels, size_t size) {
+    GLint unpackBuffer = 0;
+    glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpackBuffer);
+
+    put((uint32_t)(unpackBuffer != 0));
+    if (unpackBuffer != 0) {
+        put((uint64_t)(uintptr_t)pixels);
+    } else {
+        putData(pixels, pixels ? size : 0);
+    }
+}
+
+static size_t attribBytes(GLint size, GLenum type) {
+    switch (type) {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+        return size;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+    case GL_HALF_FLOAT:
+        return size * 2;
+    case GL_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_2_10_10_10_REV:
+        return 4;
+    default:
+        return size * 4;
+    }
+}
+
+static bool anyClientArray() {
+    if (g_capture.vertexArray != 0) {
+        return false;
+    }
+    for (int idx = 0; idx < CAPTURE_MAX_ATTRIBS; idx++) {
+        if (g_capture.clientArrays[idx].enabled && g_capture.clientArrays[idx].client) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Record the contents of the enabled client arrays used by a draw (before the draw record).
+static void putClientArrays(GLsizei vertexCount, GLsizei instanceCount) {
+    if (!anyClientArray()) {
+        return;
+    }
+
+    for (int idx = 0; idx < CAPTURE_MAX_ATTRIBS; idx++) {
+        const ClientArray& array = g_capture.clientArrays[idx];
+        if (!array.enabled || !array.client) {
+            continue;
+        }
+
+        GLsizei elements = array.divisor ? (instanceCount + array.divisor - 1) / array.divisor : vertexCount;
+        if (elements <= 0) {
+            continue;
+        }
+
+        size_t elementBytes = attribBytes(array.size, array.type);
+        size_t stride = array.stride ? array.stride : elementBytes;
+
+        beginRecord(CAPTURE_CLIENT_ARRAY);
+        put((uint32_t)idx);
+        put(array.size);
+        put(array.type);
+        put(array.normalized);
+        put((uint32_t)array.integer);
+        put(array.stride);
+        putData(array.pointer, (elements - 1) * stride + elementBytes);
+        endRecord();
+    }
+}
+
+static size_t indexBytes(GLenum type) {
+    return type == GL_UNSIGNED_BYTE ? 1 : (type == GL_UNSIGNED_SHORT ? 2 : 4);
+}
+
+// Number of vertices referenced by an indexed draw (only needed for the client arrays).
+static GLsizei elementsVertexCount(GLsizei count, GLenum type, const void* indices, bool clientIndices) {
+    if (count <= 0 || !anyClientArray()) {
+        return 0;
+    }
+
+    const void* data = indices;
+    if (!clientIndices) {
+        data = REAL(glMapBufferRange)(GL_ELEMENT_ARRAY_BUFFER, (GLintptr)indices, count * indexBytes(type), GL_MAP_READ_BIT);
+        if (data == NULL) {
+            return 0;
+        }
+    }
+
+    GLuint maxIndex = 0;
+    for (GLsizei idx = 0; idx < count; idx++) {
+        GLuint index;
+        if (type == GL_UNSIGNED_BYTE) {
+            index = ((const uint8_t*)data)[idx];
+        } else if (type == GL_UNSIGNED_SHORT) {
+            index = ((const uint16_t*)data)[idx];
+        } else {
+            index = ((const uint32_t*)data)[idx];
+        }
+        maxIndex = index > maxIndex ? index : maxIndex;
+    }
+
+    if (!clientIndices) {
+        REAL(glUnmapBuffer)(GL_ELEMENT_ARRAY_BUFFER);
+    }
+    return (GLsizei)maxIndex + 1;
+}
+
+static void recordDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instanceCount) {
+    if (!capturing()) {
+        return;
+    }
+
+    /* The indices are in client memory if no element buffer is bound (only possible with the vertex array 0). */
+    GLint elementBuffer = 1;
+    if (g_capture.vertexArray == 0) {
+        glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &elementBuffer);
+    }
+    bool clientIndices = elementBuffer == 0;
+
+    putClientArrays(elementsVertexCount(count, type, indices, clientIndices), instanceCount);
+
+    beginRecord(CAPTURE_DRAW_ELEMENTS);
+    put(mode);
+    put(count);
+    put(type);
+    put(instanceCount);
+    put((uint32_t)clientIndices);
+    if (clientIndices) {
+        putData(indices, count * indexBytes(type));
+    } else {
+        put((uint64_t)(uintptr_t)indices);
+    }
+    endRecord();
+}
+
+extern "C" {
+
+// Called by demoSwapBuffers (common/demo_context.cpp) at the end of every frame.
+void glesCaptureEndFrame() {
+    g_capture.frameHook = true;
+    captureEndFrame();
+}
+
+EGLBoolean eglSwapBuffers(EGLDisplay display, EGLSurface surface) {
+    static decltype(&eglSwapBuffers) swapBuffers = (decltype(&eglSwapBuffers))realSymbol("eglSwapBuffers", false);
+
+    /* Without the demo context hook every swap ends a frame. */
+    if (!g_capture.frameHook) {
+        captureEndFrame();
+    }
+    return swapBuffers(display, surface);
+}
+
+// State.
+
+void glEnable(GLenum cap) {
+    REAL(glEnable)(cap);
+    record(CAPTURE_ENABLE, cap);
+}
+
+void glDisable(GLenum cap) {
+    REAL(glDisable)(cap);
+    record(CAPTURE_DISABLE, cap);
+}
+
+void glBlendFunc(GLenum sfactor, GLenum dfactor) {
+    REAL(glBlendFunc)(sfactor, dfactor);
+    record(CAPTURE_BLEND_FUNC, sfactor, dfactor);
+}
+
+void glBlendFuncSeparate(GLenum sfactorRGB, GLenum dfactorRGB, GLenum sfactorAlpha, GLenum dfactorAlpha) {
+    REAL(glBlendFuncSeparate)(sfactorRGB, dfactorRGB, sfactorAlpha, dfactorAlpha);
+    record(CAPTURE_BLEND_FUNC_SEPARATE, sfactorRGB, dfactorRGB, sfactorAlpha, dfactorAlpha);
+}
+
+void glBlendEquation(GLenum mode) {
+    REAL(glBlendEquation)(mode);
+    record(CAPTURE_BLEND_EQUATION, mode);
+}
+
+void glCullFace(GLenum mode) {
+    REAL(glCullFace)(mode);
+    record(CAPTURE_CULL_FACE, mode);
+}
+
+void glFrontFace(GLenum mode) {
+    REAL(glFrontFace)(mode);
+    record(CAPTURE_FRONT_FACE, mode);
+}
+
+void glDepthFunc(GLenum func) {
+    REAL(glDepthFunc)(func);
+    record(CAPTURE_DEPTH_FUNC, func);
+}
+
+void glDepthMask(GLboolean flag) {
+    REAL(glDepthMask)(flag);
+    record(CAPTURE_DEPTH_MASK, flag);
+}
+
+void glColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha) {
+    REAL(glColorMask)(red, green, blue, alpha);
+    record(CAPTURE_COLOR_MASK, red, green, blue, alpha);
+}
+
+void glPolygonOffset(GLfloat factor, GLfloat units) {
+    REAL(glPolygonOffset)(factor, units);
+    record(CAPTURE_POLYGON_OFFSET, factor, units);
+}
+
+void glLineWidth(GLfloat width) {
+    REAL(glLineWidth)(width);
+    record(CAPTURE_LINE_WIDTH, width);
+}
+
+void glStencilFunc(GLenum func, GLint ref, GLuint mask) {
+    REAL(glStencilFunc)(func, ref, mask);
+    record(CAPTURE_STENCIL_FUNC, func, ref, mask);
+}
+
+void glStencilOp(GLenum fail, GLenum zfail, GLenum zpass) {
+    REAL(glStencilOp)(fail, zfail, zpass);
+    record(CAPTURE_STENCIL_OP, fail, zfail, zpass);
+}
+
+void glStencilMask(GLuint mask) {
+    REAL(glStencilMask)(mask);
+    record(CAPTURE_STENCIL_MASK, mask);
+}
+
+void glViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    REAL(glViewport)(x, y, width, height);
+    record(CAPTURE_VIEWPORT, x, y, width, height);
+}
+
+void glScissor(GLint x, GLint y, GLsizei width, GLsizei height) {
+    REAL(glScissor)(x, y, width, height);
+    record(CAPTURE_SCISSOR, x, y, width, height);
+}
+
+void glClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) {
+    REAL(glClearColor)(red, green, blue, alpha);
+    record(CAPTURE_CLEAR_COLOR, red, green, blue, alpha);
+}
+
+void glClearDepthf(GLfloat depth) {
+    REAL(glClearDepthf)(depth);
+    record(CAPTURE_CLEAR_DEPTH, depth);
+}
+
+void glClearStencil(GLint s) {
+    REAL(glClearStencil)(s);
+    record(CAPTURE_CLEAR_STENCIL, s);
+}
+
+void glClear(GLbitfield mask) {
+    REAL(glClear)(mask);
+    record(CAPTURE_CLEAR, mask);
+}
+
+void glPixelStorei(GLenum pname, GLint param) {
+    REAL(glPixelStorei)(pname, param);
+    record(CAPTURE_PIXEL_STORE, pname, param);
+}
+
+void glFlush() {
+    REAL(glFlush)();
+    record(CAPTURE_FLUSH);
+}
+
+void glFinish() {
+    REAL(glFinish)();
+    record(CAPTURE_FINISH);
+}
+
+// Buffers.
+
+void glGenBuffers(GLsizei n, GLuint* buffers) {
+    REAL(glGenBuffers)(n, buffers);
+    recordNames(CAPTURE_GEN_BUFFERS, n, buffers);
+}
+
+void glDeleteBuffers(GLsizei n, const GLuint* buffers) {
+    REAL(glDeleteBuffers)(n, buffers);
+    recordNames(CAPTURE_DELETE_BUFFERS, n, buffers);
+}
+
+void glBindBuffer(GLenum target, GLuint buffer) {
+    REAL(glBindBuffer)(target, buffer);
+    record(CAPTURE_BIND_BUFFER, target, buffer);
+}
+
+void glBindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    REAL(glBindBufferBase)(target, index, buffer);
+    record(CAPTURE_BIND_BUFFER_BASE, target, index, buffer);
+}
+
+void glBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    REAL(glBindBufferRange)(target, index, buffer, offset, size);
+    record(CAPTURE_BIND_BUFFER_RANGE, target, index, buffer, (int64_t)offset, (int64_t)size);
+}
+
+void glBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+    REAL(glBufferData)(target, size, data, usage);
+    if (capturing()) {
+        beginRecord(CAPTURE_BUFFER_DATA);
+        put(target);
+        put((int64_t)size);
+        put(usage);
+        put((uint32_t)(data != NULL));
+        putData(data, data ? size : 0);
+        endRecord();
+    }
+}
+
+void glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+    REAL(glBufferSubData)(target, offset, size, data);
+    if (capturing()) {
+        beginRecord(CAPTURE_BUFFER_SUB_DATA);
+        put(target);
+        put((int64_t)offset);
+        putData(data, size);
+        endRecord();
+    }
+}
+
+void glCopyBufferSubData(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size) {
+    REAL(glCopyBufferSubData)(readTarget, writeTarget, readOffset, writeOffset, size);
+    record(CAPTURE_COPY_BUFFER_SUB_DATA, readTarget, writeTarget, (int64_t)readOffset, (int64_t)writeOffset, (int64_t)size);
+}
+
+void* glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+    void* pointer = REAL(glMapBufferRange)(target, offset, length, access);
+    if (pointer != NULL) {
+        record(CAPTURE_MAP_BUFFER_RANGE, target, (int64_t)offset, (int64_t)length, access);
+    }
+    return pointer;
+}
+
+GLboolean glUnmapBuffer(GLenum target) {
+    if (capturing()) {
+        /* The written contents are only complete at the unmap. */
+        GLint access = 0;
+        GLint64 length = 0;
+        void* pointer = NULL;
+        glGetBufferParameteriv(target, GL_BUFFER_ACCESS_FLAGS, &access);
+        glGetBufferParameteri64v(target, GL_BUFFER_MAP_LENGTH, &length);
+        glGetBufferPointerv(target, GL_BUFFER_MAP_POINTER, &pointer);
+
+        bool written = (access & GL_MAP_WRITE_BIT) && pointer != NULL;
+
+        beginRecord(CAPTURE_UNMAP_BUFFER);
+        put(target);
+        putData(pointer, written ? length : 0);
+        endRecord();
+    }
+    return REAL(glUnmapBuffer)(target);
+}
+
+// Vertex arrays.
+
+void glGenVertexArrays(GLsizei n, GLuint* arrays) {
+    REAL(glGenVertexArrays)(n, arrays);
+    recordNames(CAPTURE_GEN_VERTEX_ARRAYS, n, arrays);
+}
+
+void glDeleteVertexArrays(GLsizei n, const GLuint* arrays) {
+    REAL(glDeleteVertexArrays)(n, arrays);
+    recordNames(CAPTURE_DELETE_VERTEX_ARRAYS, n, arrays);
+
+    for (GLsizei idx = 0; idx < n; idx++) {
+        if (arrays[idx] == g_capture.vertexArray) {
+            g_capture.vertexArray = 0;
+        }
+    }
+}
+
+void glBindVertexArray(GLuint array) {
+    REAL(glBindVertexArray)(array);
+    g_capture.vertexArray = array;
+    record(CAPTURE_BIND_VERTEX_ARRAY, array);
+}
+
+static void vertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, bool integer,
+                                GLsizei stride, const void* pointer) {
+    if (!capturing()) {
+        return;
+    }
+
+    bool client = false;
+    if (g_capture.vertexArray == 0 && index < CAPTURE_MAX_ATTRIBS) {
+        GLint arrayBuffer = 0;
+        glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &arrayBuffer);
+        client = arrayBuffer == 0;
+
+        ClientArray& array = g_capture.clientArrays[index];
+        array.client = client;
+        array.size = size;
+        array.type = type;
+        array.normalized = normalized;
+        array.integer = integer;
+        array.stride = stride;
+        array.pointer = pointer;
+    }
+
+    /* The client arrays are recorded with their contents at the draws. */
+    if (client) {
+        return;
+    }
+
+    if (integer) {
+        record(CAPTURE_VERTEX_ATTRIB_I_POINTER, index, size, type, stride, (uint64_t)(uintptr_t)pointer);
+    } else {
+        record(CAPTURE_VERTEX_ATTRIB_POINTER, index, size, type, normalized, stride, (uint64_t)(uintptr_t)pointer);
+    }
+}
+
+void glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) {
+    REAL(glVertexAttribPointer)(index, size, type, normalized, stride, pointer);
+    vertexAttribPointer(index, size, type, normalized, false, stride, pointer);
+}
+
+void glVertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void* pointer) {
+    REAL(glVertexAttribIPointer)(index, size, type, stride, pointer);
+    vertexAttribPointer(index, size, type, GL_FALSE, true, stride, pointer);
+}
+
+void glEnableVertexAttribArray(GLuint index) {
+    REAL(glEnableVertexAttribArray)(index);
+    if (g_capture.vertexArray == 0 && index < CAPTURE_MAX_ATTRIBS) {
+        g_capture.clientArrays[index].enabled = true;
+    }
+    record(CAPTURE_ENABLE_VERTEX_ATTRIB_ARRAY, index);
+}
+
+void glDisableVertexAttribArray(GLuint index) {
+    REAL(glDisableVertexAttribArray)(index);
+    if (g_capture.vertexArray == 0 && index < CAPTURE_MAX_ATTRIBS) {
+        g_capture.clientArrays[index].enabled = false;
+    }
+    record(CAPTURE_DISABLE_VERTEX_ATTRIB_ARRAY, index);
+}
+
+void glVertexAttribDivisor(GLuint index, GLuint divisor) {
+    REAL(glVertexAttribDivisor)(index, divisor);
+    if (g_capture.vertexArray == 0 && index < CAPTURE_MAX_ATTRIBS) {
+        g_capture.clientArrays[index].divisor = divisor;
+    }
+    record(CAPTURE_VERTEX_ATTRIB_DIVISOR, index, divisor);
+}
+
+void glVertexAttrib4f(GLuint index, GLfloat x, GLfloat y, GLfloat z, GLfloat w) {
+    REAL(glVertexAttrib4f)(index, x, y, z, w);
+    record(CAPTURE_VERTEX_ATTRIB_4F, index, x, y, z, w);
+}
+
+void glVertexAttrib4fv(GLuint index, const GLfloat* v) {
+    REAL(glVertexAttrib4fv)(index, v);
+    record(CAPTURE_VERTEX_ATTRIB_4F, index, v[0], v[1], v[2], v[3]);
+}
+
+// Textures.
+
+void glGenTextures(GLsizei n, GLuint* textures) {
+    REAL(glGenTextures)(n, textures);
+    recordNames(CAPTURE_GEN_TEXTURES, n, textures);
+}
+
+void glDeleteTextures(GLsizei n, const GLuint* textures) {
+    REAL(glDeleteTextures)(n, textures);
+    recordNames(CAPTURE_DELETE_TEXTURES, n, textures);
+}
+
+void glActiveTexture(GLenum texture) {
+    REAL(glActiveTexture)(texture);
+    record(CAPTURE_ACTIVE_TEXTURE, texture);
+}
+
+void glBindTexture(GLenum target, GLuint texture) {
+    REAL(glBindTexture)(target, texture);
+    record(CAPTURE_BIND_TEXTURE, target, texture);
+}
+
+void glTexParameteri(GLenum target, GLenum pname, GLint param) {
+    REAL(glTexParameteri)(target, pname, param);
+    record(CAPTURE_TEX_PARAMETER_I, target, pname, param);
+}
+
+void glTexParameterf(GLenum target, GLenum pname, GLfloat param) {
+    REAL(glTexParameterf)(target, pname, param);
+    record(CAPTURE_TEX_PARAMETER_F, target, pname, param);
+}
+
+void glTexStorage2D(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height) {
+    REAL(glTexStorage2D)(target, levels, internalformat, width, height);
+    record(CAPTURE_TEX_STORAGE_2D, target, levels, internalformat, width, height);
+}
+
+void glTexStorage3D(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth) {
+    REAL(glTexStorage3D)(target, levels, internalformat, width, height, depth);
+    record(CAPTURE_TEX_STORAGE_3D, target, levels, internalformat, width, height, depth);
+}
+
+void glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border,
+                  GLenum format, GLenum type, const void* pixels) {
+    REAL(glTexImage2D)(target, level, internalformat, width, height, border, format, type, pixels);
+    if (capturing()) {
+        beginRecord(CAPTURE_TEX_IMAGE_2D);
+        put(target);
+        put(level);
+        put(internalformat);
+        put(width);
+        put(height);
+        put(format);
+        put(type);
+        putPixels(pixels, imageBytes(width, height, 1, format, type, false));
+        endRecord();
+    }
+}
+
+void glTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+                     GLenum format, GLenum type, const void* pixels) {
+    REAL(glTexSubImage2D)(target, level, xoffset, yoffset, width, height, format, type, pixels);
+    if (capturing()) {
+        beginRecord(CAPTURE_TEX_SUB_IMAGE_2D);
+        put(target);
+        put(level);
+        put(xoffset);
+        put(yoffset);
+        put(width);
+        put(height);
+        put(format);
+        put(type);
+        putPixels(pixels, imageBytes(width, height, 1, format, type, false));
+        endRecord();
+    }
+}
+
+void glTexSubImage3D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width,
+                     GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels) {
+    REAL(glTexSubImage3D)(target, level, xoffset, yoffset, zoffset, width, height, depth, format, type, pixels);
+    if (capturing()) {
+        beginRecord(CAPTURE_TEX_SUB_IMAGE_3D);
+        put(target);
+        put(level);
+        put(xoffset);
+        put(yoffset);
+        put(zoffset);
+        put(width);
+        put(height);
+        put(depth);
+        put(format);
+        put(type);
+        putPixels(pixels, imageBytes(width, height, depth, format, type, true));
+        endRecord();
+    }
+}
+
+void glCompressedTexImage2D(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height,
+                            GLint border, GLsizei imageSize, const void* data) {
+    REAL(glCompressedTexImage2D)(target, level, internalformat, width, height, border, imageSize, data);
+    if (capturing()) {
+        beginRecord(CAPTURE_COMPRESSED_TEX_IMAGE_2D);
+        put(target);
+        put(level);
+        put(internalformat);
+        put(width);
+        put(height);
+        put(imageSize);
+        putPixels(data, imageSize);
+        endRecord();
+    }
+}
+
+void glCompressedTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width,
+                               GLsizei height, GLenum format, GLsizei imageSize, const void* data) {
+    REAL(glCompressedTexSubImage2D)(target, level, xoffset, yoffset, width, height, format, imageSize, data);
+    if (capturing()) {
+        beginRecord(CAPTURE_COMPRESSED_TEX_SUB_IMAGE_2D);
+        put(target);
+        put(level);
+        put(xoffset);
+        put(yoffset);
+        put(width);
+        put(height);
+        put(format);
+        put(imageSize);
+        putPixels(data, imageSize);
+        endRecord();
+    }
+}
+
+void glGenerateMipmap(GLenum target) {
+    REAL(glGenerateMipmap)(target);
+    record(CAPTURE_GENERATE_MIPMAP, target);
+}
+
+void glBindImageTexture(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access,
+                        GLenum format) {
+    REAL(glBindImageTexture)(unit, texture, level, layered, layer, access, format);
+    record(CAPTURE_BIND_IMAGE_TEXTURE, unit, texture, level, layered, layer, access, format);
+}
+
+// Framebuffers.
+
+void glGenFramebuffers(GLsizei n, GLuint* framebuffers) {
+    REAL(glGenFramebuffers)(n, framebuffers);
+    recordNames(CAPTURE_GEN_FRAMEBUFFERS, n, framebuffers);
+}
+
+void glDeleteFramebuffers(GLsizei n, const GLuint* framebuffers) {
+    REAL(glDeleteFramebuffers)(n, framebuffers);
+    recordNames(CAPTURE_DELETE_FRAMEBUFFERS, n, framebuffers);
+}
+
+void glBindFramebuffer(GLenum target, GLuint framebuffer) {
+    REAL(glBindFramebuffer)(target, framebuffer);
+    record(CAPTURE_BIND_FRAMEBUFFER, target, framebuffer);
+}
+
+void glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level) {
+    REAL(glFramebufferTexture2D)(target, attachment, textarget, texture, level);
+    record(CAPTURE_FRAMEBUFFER_TEXTURE_2D, target, attachment, textarget, texture, level);
+}
+
+void glFramebufferTextureLayer(GLenum target, GLenum attachment, GLuint texture, GLint level, GLint layer) {
+    REAL(glFramebufferTextureLayer)(target, attachment, texture, level, layer);
+    record(CAPTURE_FRAMEBUFFER_TEXTURE_LAYER, target, attachment, texture, level, layer);
+}
+
+void glFramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer) {
+    REAL(glFramebufferRenderbuffer)(target, attachment, renderbuffertarget, renderbuffer);
+    record(CAPTURE_FRAMEBUFFER_RENDERBUFFER, target, attachment, renderbuffertarget, renderbuffer);
+}
+
+void glGenRenderbuffers(GLsizei n, GLuint* renderbuffers) {
+    REAL(glGenRenderbuffers)(n, renderbuffers);
+    recordNames(CAPTURE_GEN_RENDERBUFFERS, n, renderbuffers);
+}
+
+void glDeleteRenderbuffers(GLsizei n, const GLuint* renderbuffers) {
+    REAL(glDeleteRenderbuffers)(n, renderbuffers);
+    recordNames(CAPTURE_DELETE_RENDERBUFFERS, n, renderbuffers);
+}
+
+void glBindRenderbuffer(GLenum target, GLuint renderbuffer) {
+    REAL(glBindRenderbuffer)(target, renderbuffer);
+    record(CAPTURE_BIND_RENDERBUFFER, target, renderbuffer);
+}
+
+void glRenderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height) {
+    REAL(glRenderbufferStorage)(target, internalformat, width, height);
+    record(CAPTURE_RENDERBUFFER_STORAGE, target, internalformat, width, height);
+}
+
+void glRenderbufferStorageMultisample(GLenum target, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height) {
+    REAL(glRenderbufferStorageMultisample)(target, samples, internalformat, width, height);
+    record(CAPTURE_RENDERBUFFER_STORAGE_MULTISAMPLE, target, samples, internalformat, width, height);
+}
+
+void glBlitFramebuffer(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1,
+                       GLint dstY1, GLbitfield mask, GLenum filter) {
+    REAL(glBlitFramebuffer)(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
+    record(CAPTURE_BLIT_FRAMEBUFFER, srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
+}
+
+void glInvalidateFramebuffer(GLenum target, GLsizei numAttachments, const GLenum* attachments) {
+    REAL(glInvalidateFramebuffer)(target, numAttachments, attachments);
+    if (capturing()) {
+        beginRecord(CAPTURE_INVALIDATE_FRAMEBUFFER);
+        put(target);
+        put(numAttachments);
+        for (GLsizei idx = 0; idx < numAttachments; idx++) {
+            put(attachments[idx]);
+        }
+        endRecord();
+    }
+}
+
+void glReadBuffer(GLenum src) {
+    REAL(glReadBuffer)(src);
+    record(CAPTURE_READ_BUFFER, src);
+}
+
+void glDrawBuffers(GLsizei n, const GLenum* bufs) {
+    REAL(glDrawBuffers)(n, bufs);
+    recordNames(CAPTURE_DRAW_BUFFERS, n, bufs);
+}
+
+void glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels) {
+    REAL(glReadPixels)(x, y, width, height, format, type, pixels);
+    if (capturing()) {
+        /* Only the read itself is replayed, the results are not recorded. */
+        GLint packBuffer = 0;
+        glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &packBuffer);
+        record(CAPTURE_READ_PIXELS, x, y, width, height, format, type, (uint32_t)(packBuffer != 0),
+               (uint64_t)(uintptr_t)pixels);
+    }
+}
+
+// Shaders and programs.
+
+GLuint glCreateShader(GLenum type) {
+    GLuint shader = REAL(glCreateShader)(type);
+    record(CAPTURE_CREATE_SHADER, type, shader);
+    return shader;
+}
+
+void glShaderSource(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length) {
+    REAL(glShaderSource)(shader, count, string, length);
+    if (capturing()) {
+        std::string source;
+        for (GLsizei idx = 0; idx < count; idx++) {
+            if (length != NULL && length[idx] >= 0) {
+                source.append(string[idx], length[idx]);
+            } else {
+                source.append(string[idx]);
+            }
+        }
+
+        beginRecord(CAPTURE_SHADER_SOURCE);
+        put(shader);
+        putData(source.data(), source.size());
+        endRecord();
+    }
+}
+
+void glCompileShader(GLuint shader) {
+    REAL(glCompileShader)(shader);
+    record(CAPTURE_COMPILE_SHADER, shader);
+}
+
+void glDeleteShader(GLuint shader) {
+    REAL(glDeleteShader)(shader);
+    record(CAPTURE_DELETE_SHADER, shader);
+}
+
+GLuint glCreateProgram() {
+    GLuint program = REAL(glCreateProgram)();
+    record(CAPTURE_CREATE_PROGRAM, program);
+    return program;
+}
+
+void glAttachShader(GLuint program, GLuint shader) {
+    REAL(glAttachShader)(program, shader);
+    record(CAPTURE_ATTACH_SHADER, program, shader);
+}
+
+void glDetachShader(GLuint program, GLuint shader) {
+    REAL(glDetachShader)(program, shader);
+    record(CAPTURE_DETACH_SHADER, program, shader);
+}
+
+void glBindAttribLocation(GLuint program, GLuint index, const GLchar* name) {
+    REAL(glBindAttribLocation)(program, index, name);
+    if (capturing()) {
+        beginRecord(CAPTURE_BIND_ATTRIB_LOCATION);
+        put(program);
+        put(index);
+        putString(name);
+        endRecord();
+    }
+}
+
+void glProgramParameteri(GLuint program, GLenum pname, GLint value) {
+    REAL(glProgramParameteri)(program, pname, value);
+    record(CAPTURE_PROGRAM_PARAMETER, program, pname, value);
+}
+
+void glProgramBinary(GLuint, GLenum, const void*, GLsizei) {
+    /* Not forwarded: the program stays unlinked and the caller has to compile the (recorded) sources. */
+}
+
+void glLinkProgram(GLuint program) {
+    REAL(glLinkProgram)(program);
+    record(CAPTURE_LINK_PROGRAM, program);
+}
+
+void glDeleteProgram(GLuint program) {
+    REAL(glDeleteProgram)(program);
+    record(CAPTURE_DELETE_PROGRAM, program);
+}
+
+void glUseProgram(GLuint program) {
+    REAL(glUseProgram)(program);
+    record(CAPTURE_USE_PROGRAM, program);
+}
+
+GLint glGetUniformLocation(GLuint program, const GLchar* name) {
+    GLint location = REAL(glGetUniformLocation)(program, name);
+    if (capturing()) {
+        beginRecord(CAPTURE_UNIFORM_LOCATION);
+        put(program);
+        put(location);
+        putString(name);
+        endRecord();
+    }
+    return location;
+}
+
+GLuint glGetUniformBlockIndex(GLuint program, const GLchar* uniformBlockName) {
+    GLuint index = REAL(glGetUniformBlockIndex)(program, uniformBlockName);
+    if (capturing()) {
+        beginRecord(CAPTURE_UNIFORM_BLOCK_INDEX);
+        put(program);
+        put(index);
+        putString(uniformBlockName);
+        endRecord();
+    }
+    return index;
+}
+
+void glUniformBlockBinding(GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding) {
+    REAL(glUniformBlockBinding)(program, uniformBlockIndex, uniformBlockBinding);
+    record(CAPTURE_UNIFORM_BLOCK_BINDING, program, uniformBlockIndex, uniformBlockBinding);
+}
+
+// Uniforms.
+
+void glUniform1i(GLint location, GLint v0) {
+    REAL(glUniform1i)(location, v0);
+    record(CAPTURE_UNIFORM_1I, location, v0);
+}
+
+void glUniform2i(GLint location, GLint v0, GLint v1) {
+    REAL(glUniform2i)(location, v0, v1);
+    record(CAPTURE_UNIFORM_2I, location, v0, v1);
+}
+
+void glUniform3i(GLint location, GLint v0, GLint v1, GLint v2) {
+    REAL(glUniform3i)(location, v0, v1, v2);
+    record(CAPTURE_UNIFORM_3I, location, v0, v1, v2);
+}
+
+void glUniform4i(GLint location, GLint v0, GLint v1, GLint v2, GLint v3) {
+    REAL(glUniform4i)(location, v0, v1, v2, v3);
+    record(CAPTURE_UNIFORM_4I, location, v0, v1, v2, v3);
+}
+
+void glUniform1ui(GLint location, GLuint v0) {
+    REAL(glUniform1ui)(location, v0);
+    record(CAPTURE_UNIFORM_1UI, location, v0);
+}
+
+void glUniform1f(GLint location, GLfloat v0) {
+    REAL(glUniform1f)(location, v0);
+    record(CAPTURE_UNIFORM_1F, location, v0);
+}
+
+void glUniform2f(GLint location, GLfloat v0, GLfloat v1) {
+    REAL(glUniform2f)(location, v0, v1);
+    record(CAPTURE_UNIFORM_2F, location, v0, v1);
+}
+
+void glUniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) {
+    REAL(glUniform3f)(location, v0, v1, v2);
+    record(CAPTURE_UNIFORM_3F, location, v0, v1, v2);
+}
+
+void glUniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) {
+    REAL(glUniform4f)(location, v0, v1, v2, v3);
+    record(CAPTURE_UNIFORM_4F, location, v0, v1, v2, v3);
+}
+
+static void recordUniformv(uint32_t op, GLint location, GLsizei count, const GLboolean* transpose,
+                           const GLfloat* value, int components) {
+    if (!capturing()) {
+        return;
+    }
+
+    beginRecord(op);
+    put(location);
+    put(count);
+    if (transpose != NULL) {
+        put(*transpose);
+    }
+    putData(value, count * components * sizeof(GLfloat));
+    endRecord();
+}
+
+void glUniform4fv(GLint location, GLsizei count, const GLfloat* value) {
+    REAL(glUniform4fv)(location, count, value);
+    recordUniformv(CAPTURE_UNIFORM_4FV, location, count, NULL, value, 4);
+}
+
+void glUniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+    REAL(glUniformMatrix3fv)(location, count, transpose, value);
+    recordUniformv(CAPTURE_UNIFORM_MATRIX_3FV, location, count, &transpose, value, 9);
+}
+
+void glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+    REAL(glUniformMatrix4fv)(location, count, transpose, value);
+    recordUniformv(CAPTURE_UNIFORM_MATRIX_4FV, location, count, &transpose, value, 16);
+}
+
+// Draws and dispatches.
+
+void glDrawArrays(GLenum mode, GLint first, GLsizei count) {
+    if (capturing()) {
+        putClientArrays(first + count, 1);
+    }
+    REAL(glDrawArrays)(mode, first, count);
+    record(CAPTURE_DRAW_ARRAYS, mode, first, count);
+}
+
+void glDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instancecount) {
+    if (capturing()) {
+        putClientArrays(first + count, instancecount);
+    }
+    REAL(glDrawArraysInstanced)(mode, first, count, instancecount);
+    record(CAPTURE_DRAW_ARRAYS_INSTANCED, mode, first, count, instancecount);
+}
+
+void glDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+    recordDrawElements(mode, count, type, indices, -1);
+    REAL(glDrawElements)(mode, count, type, indices);
+}
+
+void glDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount) {
+    recordDrawElements(mode, count, type, indices, instancecount);
+    REAL(glDrawElementsInstanced)(mode, count, type, indices, instancecount);
+}
+
+void glDrawArraysIndirect(GLenum mode, const void* indirect) {
+    REAL(glDrawArraysIndirect)(mode, indirect);
+    record(CAPTURE_DRAW_ARRAYS_INDIRECT, mode, (uint64_t)(uintptr_t)indirect);
+}
+
+void glDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect) {
+    REAL(glDrawElementsIndirect)(mode, type, indirect);
+    record(CAPTURE_DRAW_ELEMENTS_INDIRECT, mode, type, (uint64_t)(uintptr_t)indirect);
+}
+
+void glDispatchCompute(GLuint num_groups_x, GLuint num_groups_y, GLuint num_groups_z) {
+    REAL(glDispatchCompute)(num_groups_x, num_groups_y, num_groups_z);
+    record(CAPTURE_DISPATCH_COMPUTE, num_groups_x, num_groups_y, num_groups_z);
+}
+
+void glDispatchComputeIndirect(GLintptr indirect) {
+    REAL(glDispatchComputeIndirect)(indirect);
+    record(CAPTURE_DISPATCH_COMPUTE_INDIRECT, (int64_t)indirect);
+}
+
+void glMemoryBarrier(GLbitfield barriers) {
+    REAL(glMemoryBarrier)(barriers);
+    record(CAPTURE_MEMORY_BARRIER, barriers);
+}
+
+// Synchronization.
+
+GLsync glFenceSync(GLenum condition, GLbitfield flags) {
+    GLsync sync = REAL(glFenceSync)(condition, flags);
+    record(CAPTURE_FENCE_SYNC, condition, flags, (uint64_t)(uintptr_t)sync);
+    return sync;
+}
+
+GLenum glClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+    GLenum result = REAL(glClientWaitSync)(sync, flags, timeout);
+    record(CAPTURE_CLIENT_WAIT_SYNC, (uint64_t)(uintptr_t)sync, flags, (uint64_t)timeout);
+    return result;
+}
+
+void glWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+    REAL(glWaitSync)(sync, flags, timeout);
+    record(CAPTURE_WAIT_SYNC, (uint64_t)(uintptr_t)sync, flags, (uint64_t)timeout);
+}
+
+void glDeleteSync(GLsync sync) {
+    REAL(glDeleteSync)(sync);
+    record(CAPTURE_DELETE_SYNC, (uint64_t)(uintptr_t)sync);
+}
+
+// The entry points looked up at runtime (ex.: by the GL ES 3.1 helpers) get the wrappers too.
+__eglMustCastToProperFunctionPointerType eglGetProcAddress(const char* procname) {
+    static const struct {
+        const char* name;
+        __eglMustCastToProperFunctionPointerType function;
+    } wrappers[] = {
+#define WRAPPER(name) { #name, (__eglMustCastToProperFunctionPointerType)name }
+        WRAPPER(glBindBufferBase),
+        WRAPPER(glBindBufferRange),
+        WRAPPER(glBindImageTexture),
+        WRAPPER(glDispatchCompute),
+        WRAPPER(glDispatchComputeIndirect),
+        WRAPPER(glDrawArraysIndirect),
+        WRAPPER(glDrawElementsIndirect),
+        WRAPPER(glMemoryBarrier),
+        WRAPPER(glMapBufferRange),
+        WRAPPER(glUnmapBuffer),
+        WRAPPER(glProgramBinary),
+        WRAPPER(glProgramParameteri),
+        WRAPPER(glTexStorage2D),
+        WRAPPER(glTexStorage3D),
+        WRAPPER(glInvalidateFramebuffer),
+        WRAPPER(glVertexAttribDivisor),
+        WRAPPER(glDrawArraysInstanced),
+        WRAPPER(glDrawElementsInstanced),
+        WRAPPER(glFenceSync),
+        WRAPPER(glClientWaitSync),
+        WRAPPER(glWaitSync),
+        WRAPPER(glDeleteSync),
+#undef WRAPPER
+    };
+
+    static decltype(&eglGetProcAddress) getProcAddress =
+        (decltype(&eglGetProcAddress))realSymbol("eglGetProcAddress", false);
+
+    for (size_t idx = 0; idx < sizeof(wrappers) / sizeof(wrappers[0]); idx++) {
+        if (strcmp(wrappers[idx].name, procname) == 0) {
+            return wrappers[idx].function;
+        }
+    }
+    return getProcAddress(procname);
+}
+
+} // extern "C"
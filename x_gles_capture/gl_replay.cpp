@@ -0,0 +1,667 @@
+/**
+ * Headless replay of a GL frame capture (see gl_capture.cpp) for GPU
+ * performance regression tests.
+ *
+ * The calls before the captured frame are replayed once to recreate the
+ * resources and the state, then the frame is replayed "--repeat" times.
+ * Every repeat is followed by a glFinish: the wall time of a repeat is the
+ * full CPU+GPU time of the frame, the GPU time is measured with
+ * GL_EXT_disjoint_timer_query (if supported). The first repeat is a
+ * warm-up and is not counted.
+ *
+ * The object names, the sync objects, the uniform locations and the
+ * uniform block indices of the captured process are mapped to the ones of
+ * the replay. The framebuffer 0 of a windowed capture is replayed into the
+ * headless offscreen framebuffer.
+ *
+ * Run:
+ * $ LD_PRELOAD=./libgles_capture.so GLCAPTURE_FRAME=10 ./07_gles_cube --surfaceless --frames 11
+ * $ ./x_gles_replay frame.glcap --surfaceless --repeat 200
+ *
+ * Options (and the options of the demo context):
+ *  FILE           The capture file (first argument).
+ *  --repeat N     Number of measured repeats of the frame (default: 100).
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.1+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <GLES3/gl31.h>
+
+#include "common/demo_context.h"
+#include "common/gpu_timer.h"
+#include "x_gles_capture/capture_format.h"
+
+struct ReplayCapture {
+    uint32_t frame;
+    std::vector<uint32_t> words;
+    std::vector<size_t> records; // word offset of every CaptureRecord
+    size_t frameBegin;          // index of the CAPTURE_FRAME_BEGIN record
+    size_t frameEnd;            // index of the CAPTURE_FRAME_END record
+};
+
+enum ReplayNameSpace {
+    REPLAY_BUFFERS,
+    REPLAY_TEXTURES,
+    REPLAY_FRAMEBUFFERS,
+    REPLAY_RENDERBUFFERS,
+    REPLAY_VERTEX_ARRAYS,
+    REPLAY_PROGRAMS, // shaders and programs
+    REPLAY_NAME_SPACE_COUNT
+};
+
+struct Replay {
+    GLuint defaultFramebuffer;
+
+    // Captured name -> replay name.
+    std::unordered_map<uint32_t, GLuint> names[REPLAY_NAME_SPACE_COUNT];
+    std::unordered_map<uint64_t, GLsync> syncs;
+
+    // (replay program, captured location/index) -> replay location/index.
+    std::unordered_map<uint64_t, GLint> uniformLocations;
+    std::unordered_map<uint64_t, GLuint> uniformBlocks;
+    GLuint program;
+
+    // The captured framebuffer 0 is bound (its attachment names are translated).
+    bool drawDefault;
+    bool readDefault;
+
+    std::vector<uint8_t> clientArrays[CAPTURE_MAX_ATTRIBS];
+    std::vector<uint8_t> readPixels;
+};
+
+static bool loadCapture(const char* path, ReplayCapture* capture) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        printf("Error: unable to open '%s'\n", path);
+        return false;
+    }
+
+    size_t size = (size_t)file.tellg();
+    capture->words.resize((size + 3) / 4);
+    file.seekg(0);
+    file.read((char*)capture->words.data(), size);
+
+    CaptureHeader header;
+    if (size < sizeof(header)) {
+        printf("Error: '%s' is not a capture file\n", path);
+        return false;
+    }
+    memcpy(&header, capture->words.data(), sizeof(header));
+    if (memcmp(header.magic, CAPTURE_MAGIC, sizeof(header.magic)) != 0 || header.version != CAPTURE_VERSION) {
+        printf("Error: '%s' is not a capture file (or an unsupported version)\n", path);
+        return false;
+    }
+    capture->frame = header.frame;
+
+    capture->records.clear();
+    capture->frameBegin = (size_t)-1;
+    capture->frameEnd = (size_t)-1;
+
+    size_t wordCount = size / 4;
+    size_t offset = sizeof(header) / 4;
+    while (offset + 2 <= wordCount) {
+        uint32_t op = capture->words[offset];
+        uint32_t recordWords = 2 + capture->words[offset + 1] / 4;
+        if (op >= CAPTURE_OP_COUNT || offset + recordWords > wordCount) {
+            break;
+        }
+
+        if (op == CAPTURE_FRAME_BEGIN) {
+            capture->frameBegin = capture->records.size();
+        } else if (op == CAPTURE_FRAME_END) {
+            capture->frameEnd = capture->records.size();
+        }
+        capture->records.push_back(offset);
+        offset += recordWords;
+    }
+
+    if (capture->frameBegin == (size_t)-1 || capture->frameEnd == (size_t)-1) {
+        printf("Error: '%s' is incomplete (the end of the captured frame is missing)\n", path);
+        return false;
+    }
+    return true;
+}
+
+static GLuint mapName(const Replay* replay, ReplayNameSpace space, uint32_t name) {
+    if (name == 0) {
+        return space == REPLAY_FRAMEBUFFERS ? replay->defaultFramebuffer : 0;
+    }
+
+    /* A name which was never generated (ex.: a hard coded one) is used as is. */
+    auto it = replay->names[space].find(name);
+    return it == replay->names[space].end() ? name : it->second;
+}
+
+static void genNames(Replay* replay, ReplayNameSpace space, const uint32_t* w, void (*gen)(GLsizei, GLuint*)) {
+    std::vector<GLuint> names(w[0]);
+    gen((GLsizei)w[0], names.data());
+    for (uint32_t idx = 0; idx < w[0]; idx++) {
+        replay->names[space][w[1 + idx]] = names[idx];
+    }
+}
+
+static void deleteNames(Replay* replay, ReplayNameSpace space, const uint32_t* w, void (*del)(GLsizei, const GLuint*)) {
+    std::vector<GLuint> names(w[0]);
+    for (uint32_t idx = 0; idx < w[0]; idx++) {
+        names[idx] = mapName(replay, space, w[1 + idx]);
+        replay->names[space].erase(w[1 + idx]);
+    }
+    del((GLsizei)w[0], names.data());
+}
+
+static uint64_t programKey(GLuint program, uint32_t value) {
+    return ((uint64_t)program << 32) | value;
+}
+
+static GLint uniformLocation(const Replay* replay, uint32_t location) {
+    auto it = replay->uniformLocations.find(programKey(replay->program, location));
+    return it == replay->uniformLocations.end() ? (GLint)location : it->second;
+}
+
+// The buffer names of the default framebuffer are not valid for the offscreen framebuffer.
+static GLenum framebufferAttachment(const Replay* replay, bool defaultBound, GLenum attachment) {
+    if (!defaultBound || replay->defaultFramebuffer == 0) {
+        return attachment;
+    }
+
+    switch (attachment) {
+    case GL_BACK:
+    case GL_COLOR:
+        return GL_COLOR_ATTACHMENT0;
+    case GL_DEPTH:
+        return GL_DEPTH_ATTACHMENT;
+    case GL_STENCIL:
+        return GL_STENCIL_ATTACHMENT;
+    default:
+        return attachment;
+    }
+}
+
+static GLsync findSync(const Replay* replay, uint64_t handle) {
+    auto it = replay->syncs.find(handle);
+    return it == replay->syncs.end() ? NULL : it->second;
+}
+
+static float wordFloat(uint32_t word) {
+    float value;
+    memcpy(&value, &word, sizeof(value));
+    return value;
+}
+
+static uint64_t wordPair(const uint32_t* w) {
+    return (uint64_t)w[0] | ((uint64_t)w[1] << 32);
+}
+
+// A data block: its bytes or NULL if it is empty.
+static const void* wordData(const uint32_t* w) {
+    return w[0] ? (const void*)(w + 1) : NULL;
+}
+
+// Texture data: an offset into the unpack buffer or the recorded bytes.
+static const void* wordPixels(const uint32_t* w) {
+    return w[0] ? (const void*)(uintptr_t)wordPair(w + 1) : wordData(w + 1);
+}
+
+static std::string wordString(const uint32_t* w) {
+    return std::string((const char*)(w + 1), w[0]);
+}
+
+// Arguments of the current record.
+#define U(n) (w[n])
+#define I(n) ((GLint)w[n])
+#define F(n) wordFloat(w[n])
+#define Q(n) wordPair(w + (n))
+#define OFFSET(n) ((const void*)(uintptr_t)wordPair(w + (n)))
+
+static void replayRecord(Replay* replay, uint32_t op, const uint32_t* w) {
+    switch (op) {
+    case CAPTURE_FRAME_BEGIN:
+    case CAPTURE_FRAME_END:
+        break;
+
+    // State.
+    case CAPTURE_ENABLE:               glEnable(U(0)); break;
+    case CAPTURE_DISABLE:              glDisable(U(0)); break;
+    case CAPTURE_BLEND_FUNC:           glBlendFunc(U(0), U(1)); break;
+    case CAPTURE_BLEND_FUNC_SEPARATE:  glBlendFuncSeparate(U(0), U(1), U(2), U(3)); break;
+    case CAPTURE_BLEND_EQUATION:       glBlendEquation(U(0)); break;
+    case CAPTURE_CULL_FACE:            glCullFace(U(0)); break;
+    case CAPTURE_FRONT_FACE:           glFrontFace(U(0)); break;
+    case CAPTURE_DEPTH_FUNC:           glDepthFunc(U(0)); break;
+    case CAPTURE_DEPTH_MASK:           glDepthMask(U(0)); break;
+    case CAPTURE_COLOR_MASK:           glColorMask(U(0), U(1), U(2), U(3)); break;
+    case CAPTURE_POLYGON_OFFSET:       glPolygonOffset(F(0), F(1)); break;
+    case CAPTURE_LINE_WIDTH:           glLineWidth(F(0)); break;
+    case CAPTURE_STENCIL_FUNC:         glStencilFunc(U(0), I(1), U(2)); break;
+    case CAPTURE_STENCIL_OP:           glStencilOp(U(0), U(1), U(2)); break;
+    case CAPTURE_STENCIL_MASK:         glStencilMask(U(0)); break;
+    case CAPTURE_VIEWPORT:             glViewport(I(0), I(1), I(2), I(3)); break;
+    case CAPTURE_SCISSOR:              glScissor(I(0), I(1), I(2), I(3)); break;
+    case CAPTURE_CLEAR_COLOR:          glClearColor(F(0), F(1), F(2), F(3)); break;
+    case CAPTURE_CLEAR_DEPTH:          glClearDepthf(F(0)); break;
+    case CAPTURE_CLEAR_STENCIL:        glClearStencil(I(0)); break;
+    case CAPTURE_CLEAR:                glClear(U(0)); break;
+    case CAPTURE_PIXEL_STORE:          glPixelStorei(U(0), I(1)); break;
+    case CAPTURE_FLUSH:                glFlush(); break;
+    case CAPTURE_FINISH:               glFinish(); break;
+
+    // Buffers.
+    case CAPTURE_GEN_BUFFERS:          genNames(replay, REPLAY_BUFFERS, w, glGenBuffers); break;
+    case CAPTURE_DELETE_BUFFERS:       deleteNames(replay, REPLAY_BUFFERS, w, glDeleteBuffers); break;
+    case CAPTURE_BIND_BUFFER:          glBindBuffer(U(0), mapName(replay, REPLAY_BUFFERS, U(1))); break;
+    case CAPTURE_BIND_BUFFER_BASE:     glBindBufferBase(U(0), U(1), mapName(replay, REPLAY_BUFFERS, U(2))); break;
+    case CAPTURE_BIND_BUFFER_RANGE:
+        glBindBufferRange(U(0), U(1), mapName(replay, REPLAY_BUFFERS, U(2)), (GLintptr)Q(3), (GLsizeiptr)Q(5));
+        break;
+    case CAPTURE_BUFFER_DATA:          glBufferData(U(0), (GLsizeiptr)Q(1), wordData(w + 5), U(3)); break;
+    case CAPTURE_BUFFER_SUB_DATA:      glBufferSubData(U(0), (GLintptr)Q(1), U(3), wordData(w + 3)); break;
+    case CAPTURE_COPY_BUFFER_SUB_DATA:
+        glCopyBufferSubData(U(0), U(1), (GLintptr)Q(2), (GLintptr)Q(4), (GLsizeiptr)Q(6));
+        break;
+    case CAPTURE_MAP_BUFFER_RANGE:
+        /* The whole range is written at the unmap: no explicit flushes. */
+        glMapBufferRange(U(0), (GLintptr)Q(1), (GLsizeiptr)Q(3), U(5) & ~GL_MAP_FLUSH_EXPLICIT_BIT);
+        break;
+    case CAPTURE_UNMAP_BUFFER: {
+        void* pointer = NULL;
+        glGetBufferPointerv(U(0), GL_BUFFER_MAP_POINTER, &pointer);
+        if (pointer != NULL && U(1) > 0) {
+            memcpy(pointer, wordData(w + 1), U(1));
+        }
+        glUnmapBuffer(U(0));
+        break;
+    }
+
+    // Vertex arrays.
+    case CAPTURE_GEN_VERTEX_ARRAYS:    genNames(replay, REPLAY_VERTEX_ARRAYS, w, glGenVertexArrays); break;
+    case CAPTURE_DELETE_VERTEX_ARRAYS: deleteNames(replay, REPLAY_VERTEX_ARRAYS, w, glDeleteVertexArrays); break;
+    case CAPTURE_BIND_VERTEX_ARRAY:    glBindVertexArray(mapName(replay, REPLAY_VERTEX_ARRAYS, U(0))); break;
+    case CAPTURE_VERTEX_ATTRIB_POINTER:
+        glVertexAttribPointer(U(0), I(1), U(2), U(3), I(4), OFFSET(5));
+        break;
+    case CAPTURE_VERTEX_ATTRIB_I_POINTER:
+        glVertexAttribIPointer(U(0), I(1), U(2), I(3), OFFSET(4));
+        break;
+    case CAPTURE_CLIENT_ARRAY: {
+        if (U(0) >= CAPTURE_MAX_ATTRIBS) {
+            break;
+        }
+
+        /* The contents must stay valid until the draw: copied out of the record. */
+        std::vector<uint8_t>& data = replay->clientArrays[U(0)];
+        const uint8_t* bytes = (const uint8_t*)(w + 7);
+        data.assign(bytes, bytes + U(6));
+
+        /* A client pointer is only set while no array buffer is bound. */
+        GLint arrayBuffer = 0;
+        glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &arrayBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if (U(4)) {
+            glVertexAttribIPointer(U(0), I(1), U(2), I(5), data.data());
+        } else {
+            glVertexAttribPointer(U(0), I(1), U(2), U(3), I(5), data.data());
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, arrayBuffer);
+        break;
+    }
+    case CAPTURE_ENABLE_VERTEX_ATTRIB_ARRAY:  glEnableVertexAttribArray(U(0)); break;
+    case CAPTURE_DISABLE_VERTEX_ATTRIB_ARRAY: glDisableVertexAttribArray(U(0)); break;
+    case CAPTURE_VERTEX_ATTRIB_DIVISOR:       glVertexAttribDivisor(U(0), U(1)); break;
+    case CAPTURE_VERTEX_ATTRIB_4F:            glVertexAttrib4f(U(0), F(1), F(2), F(3), F(4)); break;
+
+    // Textures.
+    case CAPTURE_GEN_TEXTURES:         genNames(replay, REPLAY_TEXTURES, w, glGenTextures); break;
+    case CAPTURE_DELETE_TEXTURES:      deleteNames(replay, REPLAY_TEXTURES, w, glDeleteTextures); break;
+    case CAPTURE_ACTIVE_TEXTURE:       glActiveTexture(U(0)); break;
+    case CAPTURE_BIND_TEXTURE:         glBindTexture(U(0), mapName(replay, REPLAY_TEXTURES, U(1))); break;
+    case CAPTURE_TEX_PARAMETER_I:      glTexParameteri(U(0), U(1), I(2)); break;
+    case CAPTURE_TEX_PARAMETER_F:      glTexParameterf(U(0), U(1), F(2)); break;
+    case CAPTURE_TEX_STORAGE_2D:       glTexStorage2D(U(0), I(1), U(2), I(3), I(4)); break;
+    case CAPTURE_TEX_STORAGE_3D:       glTexStorage3D(U(0), I(1), U(2), I(3), I(4), I(5)); break;
+    case CAPTURE_TEX_IMAGE_2D:
+        glTexImage2D(U(0), I(1), I(2), I(3), I(4), 0, U(5), U(6), wordPixels(w + 7));
+        break;
+    case CAPTURE_TEX_SUB_IMAGE_2D:
+        glTexSubImage2D(U(0), I(1), I(2), I(3), I(4), I(5), U(6), U(7), wordPixels(w + 8));
+        break;
+    case CAPTURE_TEX_SUB_IMAGE_3D:
+        glTexSubImage3D(U(0), I(1), I(2), I(3), I(4), I(5), I(6), I(7), U(8), U(9), wordPixels(w + 10));
+        break;
+    case CAPTURE_COMPRESSED_TEX_IMAGE_2D:
+        glCompressedTexImage2D(U(0), I(1), U(2), I(3), I(4), 0, I(5), wordPixels(w + 6));
+        break;
+    case CAPTURE_COMPRESSED_TEX_SUB_IMAGE_2D:
+        glCompressedTexSubImage2D(U(0), I(1), I(2), I(3), I(4), I(5), U(6), I(7), wordPixels(w + 8));
+        break;
+    case CAPTURE_GENERATE_MIPMAP:      glGenerateMipmap(U(0)); break;
+    case CAPTURE_BIND_IMAGE_TEXTURE:
+        glBindImageTexture(U(0), mapName(replay, REPLAY_TEXTURES, U(1)), I(2), U(3), I(4), U(5), U(6));
+        break;
+
+    // Framebuffers.
+    case CAPTURE_GEN_FRAMEBUFFERS:     genNames(replay, REPLAY_FRAMEBUFFERS, w, glGenFramebuffers); break;
+    case CAPTURE_DELETE_FRAMEBUFFERS:  deleteNames(replay, REPLAY_FRAMEBUFFERS, w, glDeleteFramebuffers); break;
+    case CAPTURE_BIND_FRAMEBUFFER:
+        if (U(0) != GL_READ_FRAMEBUFFER) {
+            replay->drawDefault = U(1) == 0;
+        }
+        if (U(0) != GL_DRAW_FRAMEBUFFER) {
+            replay->readDefault = U(1) == 0;
+        }
+        glBindFramebuffer(U(0), mapName(replay, REPLAY_FRAMEBUFFERS, U(1)));
+        break;
+    case CAPTURE_FRAMEBUFFER_TEXTURE_2D:
+        glFramebufferTexture2D(U(0), U(1), U(2), mapName(replay, REPLAY_TEXTURES, U(3)), I(4));
+        break;
+    case CAPTURE_FRAMEBUFFER_TEXTURE_LAYER:
+        glFramebufferTextureLayer(U(0), U(1), mapName(replay, REPLAY_TEXTURES, U(2)), I(3), I(4));
+        break;
+    case CAPTURE_FRAMEBUFFER_RENDERBUFFER:
+        glFramebufferRenderbuffer(U(0), U(1), U(2), mapName(replay, REPLAY_RENDERBUFFERS, U(3)));
+        break;
+    case CAPTURE_GEN_RENDERBUFFERS:    genNames(replay, REPLAY_RENDERBUFFERS, w, glGenRenderbuffers); break;
+    case CAPTURE_DELETE_RENDERBUFFERS: deleteNames(replay, REPLAY_RENDERBUFFERS, w, glDeleteRenderbuffers); break;
+    case CAPTURE_BIND_RENDERBUFFER:    glBindRenderbuffer(U(0), mapName(replay, REPLAY_RENDERBUFFERS, U(1))); break;
+    case CAPTURE_RENDERBUFFER_STORAGE: glRenderbufferStorage(U(0), U(1), I(2), I(3)); break;
+    case CAPTURE_RENDERBUFFER_STORAGE_MULTISAMPLE:
+        glRenderbufferStorageMultisample(U(0), I(1), U(2), I(3), I(4));
+        break;
+    case CAPTURE_BLIT_FRAMEBUFFER:
+        glBlitFramebuffer(I(0), I(1), I(2), I(3), I(4), I(5), I(6), I(7), U(8), U(9));
+        break;
+    case CAPTURE_INVALIDATE_FRAMEBUFFER: {
+        bool defaultBound = U(0) == GL_READ_FRAMEBUFFER ? replay->readDefault : replay->drawDefault;
+        std::vector<GLenum> attachments(U(1));
+        for (uint32_t idx = 0; idx < U(1); idx++) {
+            attachments[idx] = framebufferAttachment(replay, defaultBound, U(2 + idx));
+        }
+        glInvalidateFramebuffer(U(0), I(1), attachments.data());
+        break;
+    }
+    case CAPTURE_READ_BUFFER:          glReadBuffer(framebufferAttachment(replay, replay->readDefault, U(0))); break;
+    case CAPTURE_DRAW_BUFFERS: {
+        std::vector<GLenum> buffers(U(0));
+        for (uint32_t idx = 0; idx < U(0); idx++) {
+            buffers[idx] = framebufferAttachment(replay, replay->drawDefault, U(1 + idx));
+        }
+        glDrawBuffers(I(0), buffers.data());
+        break;
+    }
+    case CAPTURE_READ_PIXELS:
+        if (U(6)) {
+            glReadPixels(I(0), I(1), I(2), I(3), U(4), U(5), (void*)(uintptr_t)Q(7));
+        } else {
+            /* Large enough for any format (at most 16 bytes per pixel) and row alignment. */
+            replay->readPixels.resize((size_t)(I(2) + 1) * I(3) * 16 + 8);
+            glReadPixels(I(0), I(1), I(2), I(3), U(4), U(5), replay->readPixels.data());
+        }
+        break;
+
+    // Shaders and programs.
+    case CAPTURE_CREATE_SHADER:        replay->names[REPLAY_PROGRAMS][U(1)] = glCreateShader(U(0)); break;
+    case CAPTURE_SHADER_SOURCE: {
+        const GLchar* source = (const GLchar*)(w + 2);
+        GLint length = I(1);
+        glShaderSource(mapName(replay, REPLAY_PROGRAMS, U(0)), 1, &source, &length);
+        break;
+    }
+    case CAPTURE_COMPILE_SHADER:       glCompileShader(mapName(replay, REPLAY_PROGRAMS, U(0))); break;
+    case CAPTURE_DELETE_SHADER:
+        glDeleteShader(mapName(replay, REPLAY_PROGRAMS, U(0)));
+        replay->names[REPLAY_PROGRAMS].erase(U(0));
+        break;
+    case CAPTURE_CREATE_PROGRAM:       replay->names[REPLAY_PROGRAMS][U(0)] = glCreateProgram(); break;
+    case CAPTURE_ATTACH_SHADER:
+        glAttachShader(mapName(replay, REPLAY_PROGRAMS, U(0)), mapName(replay, REPLAY_PROGRAMS, U(1)));
+        break;
+    case CAPTURE_DETACH_SHADER:
+        glDetachShader(mapName(replay, REPLAY_PROGRAMS, U(0)), mapName(replay, REPLAY_PROGRAMS, U(1)));
+        break;
+    case CAPTURE_BIND_ATTRIB_LOCATION:
+        glBindAttribLocation(mapName(replay, REPLAY_PROGRAMS, U(0)), U(1), wordString(w + 2).c_str());
+        break;
+    case CAPTURE_PROGRAM_PARAMETER:    glProgramParameteri(mapName(replay, REPLAY_PROGRAMS, U(0)), U(1), I(2)); break;
+    case CAPTURE_LINK_PROGRAM:         glLinkProgram(mapName(replay, REPLAY_PROGRAMS, U(0))); break;
+    case CAPTURE_DELETE_PROGRAM:
+        glDeleteProgram(mapName(replay, REPLAY_PROGRAMS, U(0)));
+        replay->names[REPLAY_PROGRAMS].erase(U(0));
+        break;
+    case CAPTURE_USE_PROGRAM:
+        replay->program = mapName(replay, REPLAY_PROGRAMS, U(0));
+        glUseProgram(replay->program);
+        break;
+    case CAPTURE_UNIFORM_LOCATION: {
+        GLuint program = mapName(replay, REPLAY_PROGRAMS, U(0));
+        replay->uniformLocations[programKey(program, U(1))] = glGetUniformLocation(program, wordString(w + 2).c_str());
+        break;
+    }
+    case CAPTURE_UNIFORM_BLOCK_INDEX: {
+        GLuint program = mapName(replay, REPLAY_PROGRAMS, U(0));
+        replay->uniformBlocks[programKey(program, U(1))] = glGetUniformBlockIndex(program, wordString(w + 2).c_str());
+        break;
+    }
+    case CAPTURE_UNIFORM_BLOCK_BINDING: {
+        GLuint program = mapName(replay, REPLAY_PROGRAMS, U(0));
+        auto it = replay->uniformBlocks.find(programKey(program, U(1)));
+        glUniformBlockBinding(program, it == replay->uniformBlocks.end() ? U(1) : it->second, U(2));
+        break;
+    }
+
+    // Uniforms.
+    case CAPTURE_UNIFORM_1I:  glUniform1i(uniformLocation(replay, U(0)), I(1)); break;
+    case CAPTURE_UNIFORM_2I:  glUniform2i(uniformLocation(replay, U(0)), I(1), I(2)); break;
+    case CAPTURE_UNIFORM_3I:  glUniform3i(uniformLocation(replay, U(0)), I(1), I(2), I(3)); break;
+    case CAPTURE_UNIFORM_4I:  glUniform4i(uniformLocation(replay, U(0)), I(1), I(2), I(3), I(4)); break;
+    case CAPTURE_UNIFORM_1UI: glUniform1ui(uniformLocation(replay, U(0)), U(1)); break;
+    case CAPTURE_UNIFORM_1F:  glUniform1f(uniformLocation(replay, U(0)), F(1)); break;
+    case CAPTURE_UNIFORM_2F:  glUniform2f(uniformLocation(replay, U(0)), F(1), F(2)); break;
+    case CAPTURE_UNIFORM_3F:  glUniform3f(uniformLocation(replay, U(0)), F(1), F(2), F(3)); break;
+    case CAPTURE_UNIFORM_4F:  glUniform4f(uniformLocation(replay, U(0)), F(1), F(2), F(3), F(4)); break;
+    case CAPTURE_UNIFORM_4FV:
+        glUniform4fv(uniformLocation(replay, U(0)), I(1), (const GLfloat*)(w + 3));
+        break;
+    case CAPTURE_UNIFORM_MATRIX_3FV:
+        glUniformMatrix3fv(uniformLocation(replay, U(0)), I(1), U(2), (const GLfloat*)(w + 4));
+        break;
+    case CAPTURE_UNIFORM_MATRIX_4FV:
+        glUniformMatrix4fv(uniformLocation(replay, U(0)), I(1), U(2), (const GLfloat*)(w + 4));
+        break;
+
+    // Draws and dispatches.
+    case CAPTURE_DRAW_ARRAYS:            glDrawArrays(U(0), I(1), I(2)); break;
+    case CAPTURE_DRAW_ARRAYS_INSTANCED:  glDrawArraysInstanced(U(0), I(1), I(2), I(3)); break;
+    case CAPTURE_DRAW_ELEMENTS: {
+        const void* indices = U(4) ? wordData(w + 5) : OFFSET(5);
+        if (I(3) < 0) {
+            glDrawElements(U(0), I(1), U(2), indices);
+        } else {
+            glDrawElementsInstanced(U(0), I(1), U(2), indices, I(3));
+        }
+        break;
+    }
+    case CAPTURE_DRAW_ARRAYS_INDIRECT:   glDrawArraysIndirect(U(0), OFFSET(1)); break;
+    case CAPTURE_DRAW_ELEMENTS_INDIRECT: glDrawElementsIndirect(U(0), U(1), OFFSET(2)); break;
+    case CAPTURE_DISPATCH_COMPUTE:       glDispatchCompute(U(0), U(1), U(2)); break;
+    case CAPTURE_DISPATCH_COMPUTE_INDIRECT: glDispatchComputeIndirect((GLintptr)Q(0)); break;
+    case CAPTURE_MEMORY_BARRIER:         glMemoryBarrier(U(0)); break;
+
+    // Synchronization.
+    case CAPTURE_FENCE_SYNC:             replay->syncs[Q(2)] = glFenceSync(U(0), U(1)); break;
+    case CAPTURE_CLIENT_WAIT_SYNC: {
+        /* A fence of the frames before the setup is not known: nothing to wait for. */
+        GLsync sync = findSync(replay, Q(0));
+        if (sync != NULL) {
+            glClientWaitSync(sync, U(2), Q(3));
+        }
+        break;
+    }
+    case CAPTURE_WAIT_SYNC: {
+        GLsync sync = findSync(replay, Q(0));
+        if (sync != NULL) {
+            glWaitSync(sync, U(2), Q(3));
+        }
+        break;
+    }
+    case CAPTURE_DELETE_SYNC: {
+        GLsync sync = findSync(replay, Q(0));
+        if (sync != NULL) {
+            glDeleteSync(sync);
+            replay->syncs.erase(Q(0));
+        }
+        break;
+    }
+    }
+}
+
+#undef U
+#undef I
+#undef F
+#undef Q
+#undef OFFSET
+
+static void replayRecords(Replay* replay, const ReplayCapture* capture, size_t first, size_t last) {
+    for (size_t idx = first; idx < last; idx++) {
+        const uint32_t* record = &capture->words[capture->records[idx]];
+        replayRecord(replay, record[0], record + 2);
+    }
+}
+
+static int countGLErrors() {
+    int count = 0;
+    while (glGetError() != GL_NO_ERROR) {
+        count++;
+    }
+    return count;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || strncmp(argv[1], "--", 2) == 0) {
+        printf("Usage: %s FILE [--repeat N] [--headless | --surfaceless] [--size WxH]\n", argv[0]);
+        return -1;
+    }
+
+    // 1. Load the capture.
+    ReplayCapture capture;
+    if (!loadCapture(argv[1], &capture)) {
+        return -1;
+    }
+
+    int repeat = 100;
+    for (int idx = 2; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--repeat") == 0 && idx + 1 < argc) {
+            repeat = atoi(argv[++idx]);
+        }
+    }
+    repeat = repeat > 0 ? repeat : 1;
+
+    // 2. Create the window (or the headless offscreen context).
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
+    demo.frameLimit = 0;
+
+    GpuTimer timer;
+    initGpuTimer(&timer, 0, NULL);
+    bool gpuTime = gpuTimerEnableQueries(&timer);
+
+    Replay replay;
+    replay.defaultFramebuffer = demoDefaultFramebuffer(&demo);
+    replay.program = 0;
+    replay.drawDefault = true;
+    replay.readDefault = true;
+
+    // 3. Recreate the resources and the state of the start of the frame.
+    size_t frameCalls = capture.frameEnd - capture.frameBegin - 1;
+    printf("Replaying frame %u of '%s': %zu setup calls, %zu frame calls, %d repeats\n", capture.frame, argv[1],
+           capture.frameBegin, frameCalls, repeat);
+
+    replayRecords(&replay, &capture, 0, capture.frameBegin);
+    glFinish();
+    int setupErrors = countGLErrors();
+
+    // 4. Replay the frame, the first repeat is a warm-up (lazy shader compilation, first use of the resources).
+    std::vector<double> wallMs;
+    int frameErrors = 0;
+    for (int idx = 0; idx <= repeat && !demoShouldClose(&demo); idx++) {
+        gpuTimerBeginFrame(&timer);
+        double startTime = demoGetTime(&demo);
+
+        gpuTimerBegin(&timer, "frame");
+        replayRecords(&replay, &capture, capture.frameBegin + 1, capture.frameEnd);
+        gpuTimerEnd(&timer);
+        glFinish();
+
+        if (idx > 0) {
+            wallMs.push_back((demoGetTime(&demo) - startTime) * 1000.0);
+        }
+        frameErrors += countGLErrors();
+        gpuTimerEndFrame(&timer);
+
+        demoSwapBuffers(&demo);
+        demoPollEvents(&demo);
+    }
+    gpuTimerBeginFrame(&timer);
+
+    // 5. Report the frame times.
+    if (!wallMs.empty()) {
+        double sum = 0.0;
+        for (double ms : wallMs) {
+            sum += ms;
+        }
+        std::sort(wallMs.begin(), wallMs.end());
+        printf("Wall: avg %.3f ms | median %.3f ms | min %.3f ms | max %.3f ms\n", sum / wallMs.size(),
+               wallMs[wallMs.size() / 2], wallMs.front(), wallMs.back());
+    }
+
+    if (gpuTime && !timer.passes.empty() && timer.passes[0].sampleCount > 0) {
+        const GpuTimerPass& pass = timer.passes[0];
+        printf("GPU: avg %.3f ms (%d samples)\n", pass.sumMs / pass.sampleCount, pass.sampleCount);
+    } else {
+        printf("GPU: no timer query results (GL_EXT_disjoint_timer_query)\n");
+    }
+
+    if (setupErrors > 0 || frameErrors > 0) {
+        printf("Warning: %d GL errors in the setup, %d in the frame repeats\n", setupErrors, frameErrors);
+    }
+
+    // XX. Delete the context (the replayed objects are deleted with it).
+    destroyGpuTimer(&timer);
+    destroyDemoContext(&demo);
+
+    return 0;
+}
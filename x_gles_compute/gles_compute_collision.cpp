@@ -7,10 +7,64 @@
  * Run:
  * $ ./gles_triangle_vao
  *
+ * Run with N independent triangles (batched simulation, one invocation per triangle):
+ * $ ./x_gles_compute_collision --triangles 1000000
+ *
+ * Run with two (ping-pong) buffers for the compute input/output:
+ * $ ./x_gles_compute_collision --triangles 1000000 --ping-pong
+ *
+ * Pipelined frames: the simulation runs one frame ahead of the draw, frame N draws the triangles
+ * computed by the dispatch of frame N - 1 while its own dispatch writes the next state. The three
+ * buffers rotate (read, written, drawn two frames ago) and the only barrier is issued before the
+ * dispatch: nothing orders the dispatch and the draw of a frame, so a GPU with concurrent compute and
+ * graphics queues can overlap them:
+ * $ ./x_gles_compute_collision --triangles 1000000 --pipelined --gpu-timer
+ *
+ * Fixed timestep: the simulation advances "--sim-rate HZ" steps per second of the animation clock
+ * whatever the frame rate is. The steps of a frame (0, 1 or more, at most 8) run as one chain of
+ * ping-pong dispatches and the draw interpolates between the last two states; the steps per second
+ * and the frames per second are reported separately:
+ * $ ./x_gles_compute_collision --triangles 1000000 --sim-rate 120
+ *
+ * Let the compute pass decide what is drawn: the triangles inside the (zoomed) view are
+ * appended to a draw buffer and counted into a DrawArraysIndirectCommand, the CPU issues
+ * glDrawArraysIndirect without reading anything back:
+ * $ ./x_gles_compute_collision --triangles 1000000 --indirect --zoom 2
+ *
+ * Particle-particle collisions: N particles are binned into a uniform grid
+ * (a counting sort: atomic cell counts, a scan of the counts, a scatter into
+ * cell order), then every particle resolves its collisions with the
+ * particles of the 3x3 neighbour cells. The per-stage GPU times are printed
+ * every second:
+ * $ ./x_gles_compute_collision --particles 1000000
+ *
+ * The particles are drawn from the simulation buffer as a vertex attribute
+ * ("--vertex-fetch attrib", default) or fetched by the vertex shader from the
+ * SSBO with gl_VertexID ("--vertex-fetch ssbo", no VAO attribute path).
+ * "--vertex-fetch both" draws with both every frame and times them separately:
+ * $ ./x_gles_compute_collision --particles 1000000 --vertex-fetch both
+ *
+ * The particle state is a vec4 of 16 bytes ("--particle-format float") or
+ * packed into 8 bytes: half floats ("half", packHalf2x16) or 16 bit fixed
+ * point ("unorm16", packUnorm2x16 over the position and velocity ranges).
+ * The kernels unpack on read and pack on write, the scatter copies the packed
+ * values and the draw reads them as GL_HALF_FLOAT or normalized
+ * GL_UNSIGNED_SHORT attributes. The particle state traffic of a frame and its
+ * bandwidth are printed next to the stage times:
+ * $ ./x_gles_compute_collision --particles 1000000 --particle-format unorm16
+ *
+ * The work group size of the compute kernels is a compile time define of the
+ * kernel variant, it can be tuned per GPU without editing the shaders:
+ * $ ./x_gles_compute_collision --triangles 1000000 --group-size 128
+ *
+ * The render loops bind through the GL state cache (common/gl_state.h), the
+ * redundant binds and program switches are skipped and the issued/skipped
+ * calls are printed every second. "--no-state-cache" issues every call.
+ *
  * Dependencies:
  *  * C++11
  *  * GLFW 3.0+
- *  * Open GL ES 3.0+
+ *  * Open GL ES 3.1+
  *  * EGL
  *
  * MIT License
@@ -34,9 +88,14 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  * OFTWARE.
  */
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
 
-#include <GLFW/glfw3.h>
 #include <GLES3/gl32.h>
 #include <GLES3/gl3ext.h>
 
@@ -44,6 +103,14 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "common/compute.h"
+#include "common/compute_primitives.h"
+#include "common/program_cache.h"
+#include "common/demo_context.h"
+#include "common/gl_debug.h"
+#include "common/gl_state.h"
+#include "common/gpu_timer.h"
+
 const char* vertex_src = R"(#version 310 es
 precision highp float;
 
@@ -57,6 +124,21 @@ void main() {
 }
 )";
 
+// Fixed timestep mode: the position between the previous and the current simulation step.
+const char* interpolated_vertex_src = R"(#version 310 es
+precision highp float;
+
+layout(location = 0) in vec4 aPos;
+layout(location = 1) in vec4 aPrevPos;
+
+uniform mat4 transform;
+uniform float alpha;
+
+void main() {
+    gl_Position = transform * vec4(mix(aPrevPos.xy, aPos.xy, alpha), 0.0, 1.0);
+}
+)";
+
 const char* fragment_src = R"(#version 310 es
 precision highp float;
 
@@ -70,28 +152,56 @@ void main() {
 )";
 
 
+// Each invocation moves one triangle (3 vec4 values).
+/* The local size ("--group-size") is inserted by the compute runtime, the INDIRECT define enables the draw output. */
 const char* compute_src = R"(#version 310 es
 
-layout (local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
-
-layout(std140, binding=0) buffer destBuffer {
-  vec4 data[3];
+layout(std430, binding=0) writeonly buffer destBuffer {
+  vec4 data[];
 } outVertices;
 
 
 layout(std430, binding=1) readonly buffer srcBuffer {
-  vec4 data[3];
+  vec4 data[];
 } inVertices;
 
+uniform uint triangleCount;
+
+#ifdef INDIRECT
+// Indirect mode: the visible triangles are appended to the draw buffer.
+layout(std430, binding=2) writeonly buffer drawBuffer {
+  vec4 data[];
+} drawVertices;
+
+// DrawArraysIndirectCommand, "count" is reset to 0 before the dispatch.
+layout(std430, binding=3) buffer commandBuffer {
+  uint count;
+  uint instanceCount;
+  uint first;
+  uint reserved;
+} command;
+
+uniform mat4 transform;
+#endif
+
 void main() {
+    uint triangle = gl_GlobalInvocationID.x;
+    if (triangle >= triangleCount) {
+        return;
+    }
+
+    // The "base" index is the first vertex of the current triangle.
+    uint base = triangle * 3u;
+
     // direction should be 1.0 or -1.0
-    vec2 direction = clamp(inVertices.data[0].zw, -1.0f, 1.0f);
-    vec2 speed = clamp(inVertices.data[1].zw, 0.0001f, 0.3f);
+    vec2 direction = clamp(inVertices.data[base + 0u].zw, -1.0f, 1.0f);
+    vec2 speed = clamp(inVertices.data[base + 1u].zw, 0.0001f, 0.3f);
 
     bool haveEdge = false;
     bvec2 foundCollision = bvec2(0, 0);
-    for (int vIdx = 0; vIdx < 3; vIdx++) {
-        vec2 currPos = inVertices.data[vIdx].xy;
+    vec2 positions[3];
+    for (uint vIdx = 0u; vIdx < 3u; vIdx++) {
+        vec2 currPos = inVertices.data[base + vIdx].xy;
 
         currPos.xy += speed * direction;
 
@@ -101,7 +211,8 @@ void main() {
             foundCollision = collision;
         }
 
-        outVertices.data[vIdx] = vec4(currPos, 0.0f, 0.0f);
+        outVertices.data[base + vIdx] = vec4(currPos, 0.0f, 0.0f);
+        positions[vIdx] = currPos;
     }
 
     if (haveEdge) {
@@ -110,164 +221,617 @@ void main() {
         direction = unchangedDirection + invertDirection;
     }
 
-    outVertices.data[0].zw = direction;
-    outVertices.data[1].zw = speed;
+    outVertices.data[base + 0u].zw = direction;
+    outVertices.data[base + 1u].zw = speed;
+
+#ifdef INDIRECT
+    // Keep the triangle if its bounding rectangle overlaps the view.
+    vec2 clipMin = vec2(1e30);
+    vec2 clipMax = vec2(-1e30);
+    for (uint vIdx = 0u; vIdx < 3u; vIdx++) {
+        vec4 clip = transform * vec4(positions[vIdx], 0.0, 1.0);
+        clipMin = min(clipMin, clip.xy / clip.w);
+        clipMax = max(clipMax, clip.xy / clip.w);
+    }
+
+    if (all(lessThanEqual(clipMin, vec2(1.0))) && all(greaterThanEqual(clipMax, vec2(-1.0)))) {
+        uint first = atomicAdd(command.count, 3u);
+        for (uint vIdx = 0u; vIdx < 3u; vIdx++) {
+            drawVertices.data[first + vIdx] = vec4(positions[vIdx], 0.0f, 0.0f);
+        }
+    }
+#endif
 }
 )";
 
-static void ErrorCallbackGLFW(int error, const char* description) {
-    printf("Glfw Error %d: %s\n", error, description);
+// The command read by glDrawArraysIndirect (same layout as the "commandBuffer" SSBO).
+struct DrawArraysIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint first;
+    GLuint reserved;
+};
+
+static float randomRange(float min, float max) {
+    return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+// Particle mode: a particle is a vec4 (position xy, velocity zw) in [-1, 1]^2, stored as a PACKED_VEC4
+// of the "--particle-format" (see the packed vec4 arrays of common/compute.h).
+/* The grid has about one cell per particle, the particle radius is PARTICLE_RADIUS cell sizes
+ * (below half a cell, so the colliding particles are always in neighbour cells). */
+#define PARTICLE_RADIUS 0.35
+
+// With VERTEX_PULLING the particle is read from the simulation SSBO by gl_VertexID (no vertex attributes).
+const char* particle_vertex_src = R"(#version 310 es
+precision highp float;
+
+#ifdef VERTEX_PULLING
+layout(std430, binding = 0) readonly buffer Particles { PACKED_VEC4 particles[]; };
+#else
+in vec4 aParticle;
+#endif
+out vec3 vColor;
+
+uniform float uPointSize;
+uniform float uMaxSpeed;
+
+void main() {
+#ifdef VERTEX_PULLING
+    vec4 particle = UNPACK_VEC4(particles[gl_VertexID]);
+#else
+    vec4 particle = UNPACK_ATTRIB(aParticle);
+#endif
+    gl_Position = vec4(particle.xy, 0.0, 1.0);
+    gl_PointSize = uPointSize;
+    vColor = mix(vec3(0.2, 0.4, 1.0), vec3(1.0, 0.3, 0.1), clamp(length(particle.zw) / uMaxSpeed, 0.0, 1.0));
 }
+)";
 
-static void on_gl_error(GLenum source, GLenum type, GLuint id, GLenum severity,
-                          GLsizei length, const GLchar* message, const void *userParam) {
+// Particle draw paths ("--vertex-fetch"), FETCH_BOTH draws with both every frame.
+enum VertexFetch {
+    FETCH_ATTRIB = 1 << 0,
+    FETCH_SSBO = 1 << 1,
+    FETCH_BOTH = FETCH_ATTRIB | FETCH_SSBO,
+};
 
-    printf("-> %s\n", message);
+const char* particle_fragment_src = R"(#version 310 es
+precision highp float;
+
+in vec3 vColor;
+out vec4 outColor;
+
+void main() {
+    outColor = vec4(vColor, 1.0);
 }
+)";
 
-int main(int argc, char **argv) {
-    // 0. Add a method to report any GLFW errors.
-    glfwSetErrorCallback(ErrorCallbackGLFW);
+// The kernels below get uGridSize/uParams/GLOBAL_INDEX from the compute runtime (see common/compute.h).
+// uParams: x = particle count, y = grid cells per axis.
+const char* particle_common_src = R"(
+float cellSize(int gridSize) {
+    return 2.0 / float(gridSize);
+}
 
-    // 1. Initialize the GLFW library.
-    if (!glfwInit()) {
-        return -1;
+int cellIndex(vec2 position, int gridSize) {
+    ivec2 cell = clamp(ivec2((position + 1.0) * 0.5 * float(gridSize)), ivec2(0), ivec2(gridSize - 1));
+    return cell.y * gridSize + cell.x;
+}
+)";
+
+// Grid: the cell count + 1 (the extra count stays zero, its scan is the particle count).
+const char* particle_clear_src = R"(#version 310 es
+layout(std430, binding = 0) writeonly buffer CellCounts { uint counts[]; };
+
+void main() {
+    int idx = GLOBAL_INDEX;
+    if (idx < uGridSize.x) {
+        counts[idx] = 0u;
     }
+}
+)";
 
-    // 2. Add hints to use during context creation when a GLFW window is created.
-    // Here: require a GL ES 3.0 context.
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
-    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+// Move the particles, bounce on the walls and count them into their cells.
+const char* particle_bin_src = R"(#version 310 es
+layout(std430, binding = 0) buffer Particles { PACKED_VEC4 particles[]; };
+layout(std430, binding = 1) buffer CellCounts { uint counts[]; };
+layout(std430, binding = 2) writeonly buffer ParticleCells { uvec2 particleCells[]; }; // cell, rank in the cell
 
-    // 3. Create window with graphics context
-    GLFWwindow* window = glfwCreateWindow(1024, 600, "GLDEMO", NULL, NULL);
-    if (window == NULL) {
-        return -2;
+void main() {
+    int idx = GLOBAL_INDEX;
+    if (idx >= uParams.x) {
+        return;
     }
 
-    // 4. Activate the window (display it).
-    glfwMakeContextCurrent(window);
+    vec4 particle = UNPACK_VEC4(particles[idx]);
+    particle.xy += particle.zw;
 
-    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-    glDebugMessageCallback(on_gl_error, NULL);
+    float limit = 1.0 - PARTICLE_RADIUS * cellSize(uParams.y);
+    bvec2 outside = greaterThan(abs(particle.xy), vec2(limit));
+    particle.zw = mix(particle.zw, -sign(particle.xy) * abs(particle.zw), outside);
+    particle.xy = clamp(particle.xy, -limit, limit);
+    particles[idx] = PACK_VEC4(particle);
 
-    // 5. Set the view port to match the window size.
-    {
-        int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
-        glViewport(0, 0, display_w, display_h);
+    int cell = cellIndex(particle.xy, uParams.y);
+    particleCells[idx] = uvec2(cell, atomicAdd(counts[cell], 1u));
+}
+)";
+
+// Counting sort: write the particles in cell order (the packed values are copied as they are).
+const char* particle_scatter_src = R"(#version 310 es
+layout(std430, binding = 0) readonly buffer Particles { PACKED_VEC4 particles[]; };
+layout(std430, binding = 1) readonly buffer ParticleCells { uvec2 particleCells[]; };
+layout(std430, binding = 2) readonly buffer CellStarts { uint cellStarts[]; };
+layout(std430, binding = 3) writeonly buffer Sorted { PACKED_VEC4 sorted[]; };
+
+void main() {
+    int idx = GLOBAL_INDEX;
+    if (idx >= uParams.x) {
+        return;
     }
 
-    // 6. Create the vertex shader.
-    unsigned int vertex_shader;
-    {
-        // 6.1. Create a vertex shader object.
-        vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-
-        // 6.2. Specify the shader source.
-        glShaderSource(vertex_shader, 1, &vertex_src, NULL);
-
-        // 6.3. Compile the shader.
-        glCompileShader(vertex_shader);
-
-        // 6.4. Check if there is any error during compilation.
-        int success;
-        glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            char info[512];
-            glGetShaderInfoLog(vertex_shader, 512, NULL, info);
-            printf("Vertex shader error:\n%s\n", info);
-            return -3;
-        }
+    uvec2 cell = particleCells[idx];
+    sorted[cellStarts[cell.x] + cell.y] = particles[idx];
+}
+)";
+
+// Resolve the collisions with the particles of the 3x3 neighbour cells (equal masses, elastic).
+/* Every invocation only writes its own particle from the sorted copy: the result doesn't depend on the order. */
+const char* particle_collide_src = R"(#version 310 es
+layout(std430, binding = 0) readonly buffer Sorted { PACKED_VEC4 sorted[]; };
+layout(std430, binding = 1) readonly buffer CellStarts { uint cellStarts[]; };
+layout(std430, binding = 2) writeonly buffer Particles { PACKED_VEC4 particles[]; };
+
+void main() {
+    int idx = GLOBAL_INDEX;
+    if (idx >= uParams.x) {
+        return;
     }
 
-    // 7. Create the fragment shader.
-    unsigned int fragment_shader;
-    {
-        // 7.1. Create a fragment shader object.
-        fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-
-        // 7.2. Specify the shader source.
-        glShaderSource(fragment_shader, 1, &fragment_src, NULL);
-
-        // 7.3. Compile the shader.
-        glCompileShader(fragment_shader);
-
-        // 7.4. Check if there is any error during compilation.
-        int success;
-        glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            char info[512];
-            glGetShaderInfoLog(fragment_shader, 512, NULL, info);
-            printf("Fragment shader error:\n%s\n", info);
-            return -3;
+    vec4 particle = UNPACK_VEC4(sorted[idx]);
+    float diameter = 2.0 * PARTICLE_RADIUS * cellSize(uParams.y);
+    ivec2 cell = clamp(ivec2((particle.xy + 1.0) * 0.5 * float(uParams.y)), ivec2(0), ivec2(uParams.y - 1));
+
+    vec2 push = vec2(0.0);
+    vec2 velocityChange = vec2(0.0);
+    for (int y = max(cell.y - 1, 0); y <= min(cell.y + 1, uParams.y - 1); y++) {
+        for (int x = max(cell.x - 1, 0); x <= min(cell.x + 1, uParams.y - 1); x++) {
+            int neighbourCell = y * uParams.y + x;
+            uint end = cellStarts[neighbourCell + 1];
+            for (uint other = cellStarts[neighbourCell]; other < end; other++) {
+                vec4 neighbour = UNPACK_VEC4(sorted[other]);
+                vec2 delta = particle.xy - neighbour.xy;
+                float distance = length(delta);
+                if (int(other) == idx || distance >= diameter || distance <= 0.0) {
+                    continue;
+                }
+
+                // Separate the overlap (half by each particle), swap the approaching normal velocities.
+                vec2 normal = delta / distance;
+                push += normal * (diameter - distance) * 0.5;
+                float approach = dot(particle.zw - neighbour.zw, normal);
+                if (approach < 0.0) {
+                    velocityChange -= approach * normal;
+                }
+            }
         }
     }
 
-    // 8. Create a shader program and attach the vertex/fragment shaders.
-    unsigned int shader_program;
-    {
-        shader_program = glCreateProgram();
-        glAttachShader(shader_program, vertex_shader);
-        glAttachShader(shader_program, fragment_shader);
-        glLinkProgram(shader_program);
-
-        int success;
-        glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
-        if(!success) {
-            char info[512];
-            glGetProgramInfoLog(shader_program, 512, NULL, info);
-            printf("Program error:\n%s\n", info);
-            return -3;
+    particles[idx] = PACK_VEC4(vec4(particle.xy + push, particle.zw + velocityChange));
+}
+)";
+
+// Build a particle kernel with the common functions and the packing macros (groupSize 0: selected by the runtime).
+static void buildParticleKernel(ComputeKernel* kernel, const char* source, int groupSize,
+                                const ComputeDefines& packingDefines) {
+    ComputeDefines defines = packingDefines;
+    computeDefineFloat(&defines, "PARTICLE_RADIUS", (float)PARTICLE_RADIUS);
+
+    std::string kernelSrc = source;
+    kernelSrc.insert(kernelSrc.find('\n') + 1, particle_common_src);
+    if (groupSize <= 0 || !createComputeKernelSized(kernel, kernelSrc.c_str(), groupSize, 1, 1, &defines)) {
+        createComputeKernel(kernel, kernelSrc.c_str(), 1, &defines);
+    }
+}
+
+// Draw the particles as points with the VAO of the attribute path or from the particle SSBO.
+static void drawParticles(unsigned int program, unsigned int vao, unsigned int particleSsbo, int particleCount,
+                          float pointSize, float maxSpeed) {
+    stateCacheUseProgram(program);
+    glUniform1f(glGetUniformLocation(program, "uPointSize"), pointSize);
+    glUniform1f(glGetUniformLocation(program, "uMaxSpeed"), maxSpeed);
+    stateCacheBindVertexArray(vao);
+    if (particleSsbo) {
+        stateCacheBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, particleSsbo);
+    }
+
+    glDrawArrays(GL_POINTS, 0, particleCount);
+}
+
+// Particle mode render loop.
+static int runParticles(DemoContext* demo, int particleCount, int vertexFetch, int groupSize, bool stateCache,
+                        ComputePacking packing, GpuTimer* gpuTimer) {
+    int gridSize = 1;
+    while (gridSize * gridSize < particleCount) {
+        gridSize++;
+    }
+    int cellCount = gridSize * gridSize;
+    float radius = (float)(PARTICLE_RADIUS * 2.0 / gridSize);
+    float maxSpeed = radius * 0.25f;
+
+    // P.0. The packing of the particle state: the positions stay in [-1, 1], the velocities are clamped to 4x the
+    // initial maximum speed (the collisions exchange the velocities, they rarely exceed it).
+    const float packRange[4] = { 1.0f, 1.0f, 4.0f * maxSpeed, 4.0f * maxSpeed };
+    ComputeDefines packingDefines;
+    computeDefinePacking(&packingDefines, packing, packRange);
+    size_t particleSize = computePackingSize(packing);
+
+    // P.1. Build the draw programs and the kernels.
+    /* ES 3.1 does not require SSBO support in the vertex shader (the minimum of the limit is 0). */
+    if (vertexFetch & FETCH_SSBO) {
+        int maxVertexBlocks = 0;
+        glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &maxVertexBlocks);
+        if (maxVertexBlocks < 1) {
+            printf("Vertex shader storage blocks are not supported, using the vertex attribute path\n");
+            vertexFetch = FETCH_ATTRIB;
         }
     }
 
-    // 9. The vertex and fragment shaders can be removed after linking.
-    {
-        glDeleteShader(vertex_shader);
-        glDeleteShader(fragment_shader);
+    unsigned int particle_program = 0;
+    unsigned int pulling_program = 0;
+    if (vertexFetch & FETCH_ATTRIB) {
+        std::string attribSrc = computeSpecializeSource(particle_vertex_src, &packingDefines);
+        particle_program = createCachedProgram(attribSrc.c_str(), particle_fragment_src);
+    }
+    if (vertexFetch & FETCH_SSBO) {
+        ComputeDefines pullingDefines = packingDefines;
+        computeDefineFlag(&pullingDefines, "VERTEX_PULLING");
+        std::string pullingSrc = computeSpecializeSource(particle_vertex_src, &pullingDefines);
+        pulling_program = createCachedProgram(pullingSrc.c_str(), particle_fragment_src);
     }
 
-    // C.1. Create the Compute shader
-    unsigned int compute_shader;
+    ComputeKernel clearKernel;
+    ComputeKernel binKernel;
+    ComputeKernel scatterKernel;
+    ComputeKernel collideKernel;
+    buildParticleKernel(&clearKernel, particle_clear_src, groupSize, packingDefines);
+    buildParticleKernel(&binKernel, particle_bin_src, groupSize, packingDefines);
+    buildParticleKernel(&scatterKernel, particle_scatter_src, groupSize, packingDefines);
+    buildParticleKernel(&collideKernel, particle_collide_src, groupSize, packingDefines);
+
+    ComputePrimitives prims;
+    initComputePrimitives(&prims);
+    computePrimitivesReserve(&prims, cellCount + 1);
+
+    // P.2. Random positions and velocities.
+    std::vector<float> initial(particleCount * 4);
+    srand(42);
+    for (int idx = 0; idx < particleCount; idx++) {
+        float angle = randomRange(0.0f, 6.2831853f);
+        float speed = randomRange(0.1f, 1.0f) * maxSpeed;
+        initial[idx * 4 + 0] = randomRange(-0.95f, 0.95f);
+        initial[idx * 4 + 1] = randomRange(-0.95f, 0.95f);
+        initial[idx * 4 + 2] = cosf(angle) * speed;
+        initial[idx * 4 + 3] = sinf(angle) * speed;
+    }
+
+    // P.3. The simulation buffers: the particles are also the vertex input of the draw.
+    /* The packed formats are arrays of uint pairs, the buffers are sized by the words of a particle. */
+    int particleWords = (int)(particleSize / sizeof(unsigned int));
+    std::vector<unsigned int> packed(particleCount * particleWords);
+    computePackVec4(packing, packRange, initial.data(), particleCount, packed.data());
+    StorageBuffer<unsigned int> particles = createStorageBuffer<unsigned int>(particleCount * particleWords, packed.data());
+    StorageBuffer<unsigned int> sorted = createStorageBuffer<unsigned int>(particleCount * particleWords);
+    StorageBuffer<unsigned int> particleCells = createStorageBuffer<unsigned int>(particleCount * 2);
+    StorageBuffer<unsigned int> cellCounts = createStorageBuffer<unsigned int>(cellCount + 1);
+    StorageBuffer<unsigned int> cellStarts = createStorageBuffer<unsigned int>(cellCount + 1);
+
+    unsigned int particle_vao = 0;
+    if (particle_program) {
+        int aParticleLoc = glGetAttribLocation(particle_program, "aParticle");
+        glGenVertexArrays(1, &particle_vao);
+        glBindVertexArray(particle_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, particles.buffer);
+        unsigned int attribType;
+        bool attribNormalized;
+        computePackingAttribFormat(packing, &attribType, &attribNormalized);
+        glVertexAttribPointer(aParticleLoc, 4, attribType, attribNormalized ? GL_TRUE : GL_FALSE, (int)particleSize,
+                              NULL);
+        glEnableVertexAttribArray(aParticleLoc);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // P.4. The stages are submitted one by one, so each of them gets its own GPU time.
+    if (!gpuTimer->enabled) {
+        gpuTimerEnableQueries(gpuTimer);
+        gpuTimer->printStats = true;
+    }
+
+    printf("%d particles, %dx%d grid cells, radius %.5f, vertex fetch: %s\n", particleCount, gridSize, gridSize, radius,
+           vertexFetch == FETCH_BOTH ? "both" : (vertexFetch == FETCH_SSBO ? "ssbo" : "attrib"));
+
+    // P.4.0. The particle state traffic of a frame: bin, scatter and collide read and write every particle once and
+    // every draw reads it (the neighbour reads of the collisions mostly hit the cache, they are not counted).
+    int drawCount = (vertexFetch & FETCH_ATTRIB ? 1 : 0) + (vertexFetch & FETCH_SSBO ? 1 : 0);
+    double frameBytes = (double)particleCount * particleSize * (6 + drawCount);
+    printf("particle format: %s, %d bytes/particle, %.2f MB of particle state traffic per frame\n",
+           computePackingName(packing), (int)particleSize, frameBytes / (1024.0 * 1024.0));
+
+    // P.4.1. The vertex shader reads the SSBO directly: no vertex attribute barrier is needed.
+    GLbitfield drawBarrier = GL_SHADER_STORAGE_BARRIER_BIT;
+    if (vertexFetch & FETCH_ATTRIB) {
+        drawBarrier |= GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT;
+    }
+
+    ComputeQueue queue;
+    initComputeQueue(&queue);
+
+    // P.4.2. From here on every bind of the loop goes through the state cache.
+    stateCacheEnable(stateCache);
+
+    double statsStartTime = demoGetTime(demo);
+    int statsFrames = 0;
+    while (!demoShouldClose(demo))
     {
-        compute_shader = glCreateShader(GL_COMPUTE_SHADER);
-        glShaderSource(compute_shader, 1, &compute_src, NULL);
-        glCompileShader(compute_shader);
-        int success;
-        glGetShaderiv(compute_shader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            char info[512];
-            glGetShaderInfoLog(compute_shader, 512, NULL, info);
-            printf("Compute shader error:\n%s\n", info);
-            return -3;
+        demoPollEvents(demo);
+        gpuTimerBeginFrame(gpuTimer);
+
+        // P.5. Move the particles and count them into the cells.
+        {
+            GpuTimerScope timerScope(gpuTimer, "bin");
+            computeQueueAdd(&queue, &clearKernel, cellCount + 1, 1, 1);
+            computeQueueBind(&queue, 0, cellCounts.buffer);
+            computeQueueBarrier(&queue, GL_SHADER_STORAGE_BARRIER_BIT);
+
+            computeQueueAdd(&queue, &binKernel, particleCount, 1, 1);
+            computeQueueBind(&queue, 0, particles.buffer);
+            computeQueueBind(&queue, 1, cellCounts.buffer);
+            computeQueueBind(&queue, 2, particleCells.buffer);
+            computeQueueParams(&queue, particleCount, gridSize);
+            computeQueueBarrier(&queue, GL_SHADER_STORAGE_BARRIER_BIT);
+            computeQueueSubmit(&queue);
+        }
+
+        // P.6. The scan of the counts is the first sorted index of every cell.
+        {
+            GpuTimerScope timerScope(gpuTimer, "scan");
+            computeExclusiveScan(&prims, &queue, cellCounts, cellStarts, cellCount + 1);
+            computeQueueSubmit(&queue);
+        }
+
+        // P.7. Write the particles in cell order.
+        {
+            GpuTimerScope timerScope(gpuTimer, "scatter");
+            computeQueueAdd(&queue, &scatterKernel, particleCount, 1, 1);
+            computeQueueBind(&queue, 0, particles.buffer);
+            computeQueueBind(&queue, 1, particleCells.buffer);
+            computeQueueBind(&queue, 2, cellStarts.buffer);
+            computeQueueBind(&queue, 3, sorted.buffer);
+            computeQueueParams(&queue, particleCount, gridSize);
+            computeQueueBarrier(&queue, GL_SHADER_STORAGE_BARRIER_BIT);
+            computeQueueSubmit(&queue);
+        }
+
+        // P.8. Resolve the collisions from the sorted copy back into the particles (in cell order).
+        {
+            GpuTimerScope timerScope(gpuTimer, "collide");
+            computeQueueAdd(&queue, &collideKernel, particleCount, 1, 1);
+            computeQueueBind(&queue, 0, sorted.buffer);
+            computeQueueBind(&queue, 1, cellStarts.buffer);
+            computeQueueBind(&queue, 2, particles.buffer);
+            computeQueueParams(&queue, particleCount, gridSize);
+            computeQueueBarrier(&queue, drawBarrier);
+            computeQueueSubmit(&queue);
+        }
+
+        // P.9. Draw the particles as points.
+        {
+            int width, height;
+            demoGetFramebufferSize(demo, &width, &height);
+            glViewport(0, 0, width, height);
+
+            glClearColor(0.0, 0.1, 0.1, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            float pointSize = radius * height > 1.0f ? radius * height : 1.0f;
+
+            // P.9.1. The particle buffer is read as a vertex attribute.
+            if (particle_program) {
+                GpuTimerScope timerScope(gpuTimer, "draw attrib");
+                drawParticles(particle_program, particle_vao, 0, particleCount, pointSize, maxSpeed);
+            }
+
+            // P.9.2. The vertex shader reads the particle SSBO (no vertex attributes).
+            if (pulling_program) {
+                GpuTimerScope timerScope(gpuTimer, "draw ssbo");
+                drawParticles(pulling_program, 0, particles.buffer, particleCount, pointSize, maxSpeed);
+            }
+        }
+
+        gpuTimerDrawOverlay(gpuTimer, 10, 10);
+        gpuTimerEndFrame(gpuTimer);
+
+        demoSwapBuffers(demo);
+
+        statsFrames++;
+        double statsElapsed = demoGetTime(demo) - statsStartTime;
+        if (statsElapsed >= 1.0) {
+            printf("%d particles: %.3f ms/frame, %.2f M particles/s, %.2f GB/s particle state\n",
+                   particleCount, statsElapsed * 1000.0 / statsFrames,
+                   (double)particleCount * statsFrames / statsElapsed / 1e6,
+                   frameBytes * statsFrames / statsElapsed / 1e9);
+            printStateCacheStats();
+            stateCacheResetStats();
+            statsStartTime = demoGetTime(demo);
+            statsFrames = 0;
         }
     }
 
-    // C.2. Create the Compute program
-    unsigned int compute_program;
-    {
-        compute_program = glCreateProgram();
-        glAttachShader(compute_program, compute_shader);
-        glLinkProgram(compute_program);
-
-        int success;
-        glGetProgramiv(compute_program, GL_LINK_STATUS, &success);
-        if(!success) {
-            char info[512];
-            glGetProgramInfoLog(compute_program, 512, NULL, info);
-            printf("Compute Program error:\n%s\n", info);
-            return -3;
+    // XX. Destroy the particle resources.
+    glDeleteVertexArrays(1, &particle_vao);
+    destroyStorageBuffer(&particles);
+    destroyStorageBuffer(&sorted);
+    destroyStorageBuffer(&particleCells);
+    destroyStorageBuffer(&cellCounts);
+    destroyStorageBuffer(&cellStarts);
+    destroyComputePrimitives(&prims);
+    destroyComputeKernel(&clearKernel);
+    destroyComputeKernel(&binKernel);
+    destroyComputeKernel(&scatterKernel);
+    destroyComputeKernel(&collideKernel);
+    glDeleteProgram(particle_program);
+    glDeleteProgram(pulling_program);
+
+    destroyGpuTimer(gpuTimer);
+    destroyDemoContext(demo);
+
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    // Simulated triangle count: "--triangles N" (default: the single hard-coded triangle).
+    // Ping-pong buffers: "--ping-pong" (default: in-place update of a single buffer).
+    // Simulation one frame ahead of the draw with 3 rotating buffers: "--pipelined".
+    // GPU driven draw: "--indirect" (default: the CPU draws every triangle), "--zoom S" scales the view.
+    // Particle-particle collisions: "--particles N" (replaces the triangle simulation),
+    // "--vertex-fetch attrib|ssbo|both" selects how the draw reads the particles,
+    // "--particle-format float|half|unorm16" the storage of the particle state (default: float).
+    // Issue every bind (no GL state cache): "--no-state-cache".
+    // Fixed timestep simulation (interpolated draw): "--sim-rate HZ" (default: one step per frame).
+    int triangleCount = 1;
+    int particleCount = 0;
+    int vertexFetch = FETCH_ATTRIB;
+    ComputePacking particleFormat = COMPUTE_PACK_FLOAT32;
+    // Work group size of the kernels: "--group-size N" (default: 64 for the triangles, automatic for the particles).
+    int groupSize = 0;
+    bool pingPong = false;
+    bool pipelined = false;
+    bool indirect = false;
+    float zoom = 1.0f;
+    bool stateCache = true;
+    double simRate = 0.0;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--triangles") == 0 && idx + 1 < argc) {
+            triangleCount = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--ping-pong") == 0) {
+            pingPong = true;
+        } else if (strcmp(argv[idx], "--pipelined") == 0) {
+            pipelined = true;
+        } else if (strcmp(argv[idx], "--indirect") == 0) {
+            indirect = true;
+        } else if (strcmp(argv[idx], "--zoom") == 0 && idx + 1 < argc) {
+            zoom = (float)atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--particles") == 0 && idx + 1 < argc) {
+            particleCount = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--no-state-cache") == 0) {
+            stateCache = false;
+        } else if (strcmp(argv[idx], "--sim-rate") == 0 && idx + 1 < argc) {
+            simRate = atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--group-size") == 0 && idx + 1 < argc) {
+            groupSize = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--particle-format") == 0 && idx + 1 < argc) {
+            idx++;
+            if (!parseComputePacking(argv[idx], &particleFormat)) {
+                printf("Unknown particle format: %s (float, half or unorm16)\n", argv[idx]);
+                return -1;
+            }
+        } else if (strcmp(argv[idx], "--vertex-fetch") == 0 && idx + 1 < argc) {
+            idx++;
+            if (strcmp(argv[idx], "ssbo") == 0) {
+                vertexFetch = FETCH_SSBO;
+            } else if (strcmp(argv[idx], "both") == 0) {
+                vertexFetch = FETCH_BOTH;
+            } else {
+                vertexFetch = FETCH_ATTRIB;
+            }
         }
     }
 
+    if (triangleCount < 1) {
+        printf("Invalid triangle count: %d\n", triangleCount);
+        return -1;
+    }
+
+    if (zoom <= 0.0f) {
+        printf("Invalid zoom: %f\n", zoom);
+        return -1;
+    }
+
+    /* The indirect mode's draw buffer and command would need their own copies per frame in flight. */
+    if (pipelined && indirect) {
+        printf("--pipelined is not supported with --indirect\n");
+        return -1;
+    }
+
+    /* The interpolation draws the last two states: the two buffers of the ping-pong mode. */
+    if (simRate < 0.0 || (simRate > 0.0 && (pipelined || indirect || particleCount > 0))) {
+        printf("--sim-rate needs a positive rate and is not supported with --pipelined, --indirect or --particles\n");
+        return -1;
+    }
+    if (simRate > 0.0) {
+        pingPong = true;
+    }
+
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    /* See the "01_gles_glfw" example for the GLFW steps. This also handles the
+     * "--headless" and "--frames N" command line options. */
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
+
+    // 4.1. In the batched mode do not wait for vsync, the frame time should show the simulation cost.
+    if (triangleCount > 1 || particleCount > 0) {
+        demoSwapInterval(&demo, 0);
+    }
+
+    enableGLDebugOutput(true);
+
+    // 4.2. The particle mode has its own render loop.
+    if (particleCount > 0) {
+        GpuTimer particleTimer;
+        initGpuTimer(&particleTimer, argc, argv);
+        return runParticles(&demo, particleCount, vertexFetch, groupSize, stateCache, particleFormat, &particleTimer);
+    }
+
+    // 5. Set the view port to match the window size.
+    {
+        int display_w, display_h;
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
+        glViewport(0, 0, display_w, display_h);
+    }
+
+    // 6. Create the shader program.
+    /* The program binary is loaded from the program cache if it was already
+     * compiled in a previous run, otherwise the sources are compiled and linked. */
+    unsigned int shader_program = createCachedProgram(vertex_src, fragment_src);
+
+    // C.1. Create the Compute program variant (also using the program cache).
+    /* The indirect mode enables the draw buffer output of the same shader. */
+    ComputeKernelVariants computeVariants;
+    initComputeKernelVariants(&computeVariants, compute_src, 1);
+
+    ComputeDefines computeDefines;
+    if (indirect) {
+        computeDefineFlag(&computeDefines, "INDIRECT");
+    }
+
+    const ComputeKernel* computeKernel = computeKernelVariant(&computeVariants, &computeDefines,
+                                                              groupSize > 0 ? groupSize : 64);
+    if (computeKernel == NULL) {
+        return -4;
+    }
+    unsigned int compute_program = computeKernel->program;
+    int workGroupSize = computeKernel->localSize[0];
+
     // V.1. Create a Vertex Buffer object for vertices data
 
     // C.X. Change the vertices to be a series of vec4 values
-
-    const float vertices[] = {
+    /* Each triangle is 3 vec4 values: the 1st vertex's zw stores the direction,
+     * the 2nd vertex's zw stores the speed. */
+    std::vector<float> vertices = {
         //          0. zw stores direction
         -0.5f, 0.5f, 1.0f, 1.0f,
         //          1. zw stores speed
@@ -275,32 +839,66 @@ int main(int argc, char **argv) {
         0.0f, -0.5f, 0.0f, 0.0f,
     };
 
-    unsigned int vertices_vbo;
-    {
+    // C.X. Batched mode: generate "triangleCount" small triangles at random positions.
+    if (triangleCount > 1) {
+        vertices.resize(triangleCount * 3 * 4);
+
+        srand(42);
+        for (int idx = 0; idx < triangleCount; idx++) {
+            float *triangle = &vertices[idx * 3 * 4];
+
+            float centerX = randomRange(-0.9f, 0.9f);
+            float centerY = randomRange(-0.9f, 0.9f);
+            float size = 0.02f;
+
+            // positions
+            triangle[0] = centerX - size; triangle[1] = centerY + size;
+            triangle[4] = centerX + size; triangle[5] = centerY + size;
+            triangle[8] = centerX;        triangle[9] = centerY - size;
+
+            // direction
+            triangle[2] = (rand() % 2) ? 1.0f : -1.0f;
+            triangle[3] = (rand() % 2) ? 1.0f : -1.0f;
+
+            // speed
+            triangle[6] = randomRange(0.001f, 0.01f);
+            triangle[7] = randomRange(0.001f, 0.01f);
+
+            triangle[10] = 0.0f; triangle[11] = 0.0f;
+        }
+    }
+
+    // V.1.0. In the ping-pong mode there are two buffers: one is read and the other is written by the compute shader.
+    /* Pipelined mode: a third one, the buffer written by a dispatch was drawn two frames earlier. */
+    int bufferCount = pipelined ? 3 : (pingPong ? 2 : 1);
+    unsigned int vertices_vbo[3] = { 0, 0, 0 };
+    for (int idx = 0; idx < bufferCount; idx++) {
         // V.1.1. Generate the buffer object.
-        glGenBuffers(1, &vertices_vbo);
+        glGenBuffers(1, &vertices_vbo[idx]);
 
         // V.1.2. Bind the VBO to the "GL_ARRAY_BUFFER".
-        glBindBuffer(GL_ARRAY_BUFFER, vertices_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vertices_vbo[idx]);
 
         // V.1.3. Allocate "Upload" the data for the active "GL_ARRAY_BUFFER".
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
+        /* Every buffer gets the initial data, the first frame reads (and draws) the first buffer.
+         * After the upload only the GPU writes (compute) and reads (draw) the buffer: GL_DYNAMIC_COPY. */
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_DYNAMIC_COPY);
 
         // V.1.4. Unbind the "GL_ARRAY_BUFFER".
         glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
-    // V.1.2. Specify the Vertex Array Object.
+    // V.1.2. Specify the Vertex Array Object(s), one for each buffer.
     /* VAO is used to describe how the VBOs are accessed (layout/format). */
-    unsigned int vao;
-    {
+    unsigned int vao[3] = { 0, 0, 0 };
+    for (int idx = 0; idx < bufferCount; idx++) {
         int aPosLoc = glGetAttribLocation(shader_program, "aPos");
 
-        glGenVertexArrays(1, &vao);
+        glGenVertexArrays(1, &vao[idx]);
 
-        glBindVertexArray(vao);
+        glBindVertexArray(vao[idx]);
 
-        glBindBuffer(GL_ARRAY_BUFFER, vertices_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vertices_vbo[idx]);
 
         glVertexAttribPointer(aPosLoc, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), NULL);
 
@@ -310,6 +908,30 @@ int main(int argc, char **argv) {
         glBindVertexArray(0);
     }
 
+    // I.1. Indirect mode: the draw buffer (at most every triangle), its VAO and the indirect command.
+    unsigned int draw_vbo = 0;
+    unsigned int draw_vao = 0;
+    unsigned int command_buffer = 0;
+    if (indirect) {
+        glGenBuffers(1, &draw_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, draw_vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), NULL, GL_DYNAMIC_COPY);
+
+        int aPosLoc = glGetAttribLocation(shader_program, "aPos");
+        glGenVertexArrays(1, &draw_vao);
+        glBindVertexArray(draw_vao);
+        glVertexAttribPointer(aPosLoc, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), NULL);
+        glEnableVertexAttribArray(aPosLoc);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        DrawArraysIndirectCommand command = { 0, 1, 0, 0 };
+        glGenBuffers(1, &command_buffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(command), &command, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
     // 11. Query the uniform location
     int uniformColorLoc;
     {
@@ -318,51 +940,189 @@ int main(int argc, char **argv) {
 
     int transformLoc = glGetUniformLocation(shader_program, "transform");
 
+    // S.1. Fixed timestep mode: the interpolating program and a VAO for each (current, previous) buffer pair.
+    unsigned int interpolated_program = 0;
+    unsigned int interpolated_vao[2] = { 0, 0 };
+    int alphaLoc = -1;
+    if (simRate > 0.0) {
+        interpolated_program = createCachedProgram(interpolated_vertex_src, fragment_src);
+        alphaLoc = glGetUniformLocation(interpolated_program, "alpha");
+        uniformColorLoc = glGetUniformLocation(interpolated_program, "uColor");
+        transformLoc = glGetUniformLocation(interpolated_program, "transform");
+
+        glGenVertexArrays(2, interpolated_vao);
+        for (int idx = 0; idx < 2; idx++) {
+            glBindVertexArray(interpolated_vao[idx]);
+            glBindBuffer(GL_ARRAY_BUFFER, vertices_vbo[idx]);
+            glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), NULL);
+            glEnableVertexAttribArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, vertices_vbo[1 - idx]);
+            glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), NULL);
+            glEnableVertexAttribArray(1);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
 
+    // C.2. Query the compute uniform location and calculate the dispatch size.
+    int triangleCountLoc = glGetUniformLocation(compute_program, "triangleCount");
+    int computeTransformLoc = glGetUniformLocation(compute_program, "transform");
+    int workGroupCount = (triangleCount + workGroupSize - 1) / workGroupSize;
+    {
+        int maxWorkGroupCount;
+        glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &maxWorkGroupCount);
+        if (workGroupCount > maxWorkGroupCount) {
+            printf("Too many triangles: %d (max: %d)\n", triangleCount, maxWorkGroupCount * workGroupSize);
+            return -4;
+        }
+    }
+
+    // C.X. Statistics to report the simulation throughput.
+    double statsStartTime = demoGetTime(&demo);
+    int statsFrames = 0;
+    int statsSteps = 0;
+
+    // S.2. Fixed timestep mode: the animation time not simulated yet, at most maxSimSteps steps per frame.
+    /* A frame slower than maxSimSteps steps drops the rest of its time instead of running late forever. */
+    const int maxSimSteps = 8;
+    const double simStep = simRate > 0.0 ? 1.0 / simRate : 0.0;
+    double simAccumulator = 0.0;
+    double simLastTime = demoAnimationTime(&demo);
+    int droppedSteps = 0;
+
+    // C.X. Index of the buffer holding the current simulation state.
+    int currentBuffer = 0;
+
+    // T.1. Create the GPU timer for the per-pass timing ("--gpu-timer" options).
+    GpuTimer gpuTimer;
+    initGpuTimer(&gpuTimer, argc, argv);
 
+    // XX. The view transform, shared by the draw and the culling of the indirect mode.
+    glm::mat4 transform = glm::mat4(1.0f);
+    transform = glm::scale(transform, glm::vec3(zoom, zoom, 1.0f));
+
+    // XX. From here on every bind of the render loop goes through the state cache.
+    stateCacheEnable(stateCache);
 
     static float color = 0;
     // X. Create a render loop.
-    while (!glfwWindowShouldClose(window))
+    while (!demoShouldClose(&demo))
     {
         // X. Poll and handle events (inputs, window resize, etc.)
-        glfwPollEvents();
+        demoPollEvents(&demo);
+
+        // T.2. Collect the GPU times of the previous frames.
+        gpuTimerBeginFrame(&gpuTimer);
 
         // C.3. Run Compute Program
-        {
-            glUseProgram(compute_program);
+        /* In-place mode: the same buffer is the source and the destination.
+         * Ping-pong mode: read the current buffer and write the other one, so the
+         * compute pass never writes a buffer which is still read by a previous draw.
+         * Pipelined mode: write the next buffer of the ring, the draw shows the current one. */
+        int nextBuffer = pipelined ? (currentBuffer + 1) % 3 : (pingPong ? 1 - currentBuffer : currentBuffer);
+        int drawBuffer = pipelined ? currentBuffer : nextBuffer;
+        int simSteps = 1;
+        if (simRate > 0.0) {
+            // S.3. The steps of the elapsed time: one dispatch each, the barrier orders the chain.
+            double time = demoAnimationTime(&demo);
+            simAccumulator += time - simLastTime;
+            simLastTime = time;
+            simSteps = (int)(simAccumulator / simStep);
+            simAccumulator -= simSteps * simStep;
+            if (simSteps > maxSimSteps) {
+                droppedSteps += simSteps - maxSimSteps;
+                simSteps = maxSimSteps;
+            }
+
+            GpuTimerScope timerScope(&gpuTimer, "compute");
+            stateCacheUseProgram(compute_program);
+            glUniform1ui(triangleCountLoc, triangleCount);
+            for (int step = 0; step < simSteps; step++) {
+                stateCacheBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, vertices_vbo[1 - currentBuffer]);
+                stateCacheBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, vertices_vbo[currentBuffer]);
+                glDispatchCompute(workGroupCount, 1, 1);
+                glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+                currentBuffer = 1 - currentBuffer;
+            }
+            /* The last state is drawn with the one before it (the other buffer). */
+            nextBuffer = currentBuffer;
+            drawBuffer = currentBuffer;
+        } else {
+            GpuTimerScope timerScope(&gpuTimer, "compute");
+
+            // C.3.0. Indirect mode: restart the vertex count (a CPU write, nothing is read back).
+            int drawVerticesLoc = 2;
+            int commandLoc = 3;
+            if (indirect) {
+                GLuint zero = 0;
+                stateCacheBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+                glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(zero), &zero);
+
+                stateCacheBindBufferBase(GL_SHADER_STORAGE_BUFFER, drawVerticesLoc, draw_vbo);
+                stateCacheBindBufferBase(GL_SHADER_STORAGE_BUFFER, commandLoc, command_buffer);
+            }
+
+            stateCacheUseProgram(compute_program);
+            glUniform1ui(triangleCountLoc, triangleCount);
+            if (indirect) {
+                glUniformMatrix4fv(computeTransformLoc, 1, GL_FALSE, glm::value_ptr(transform));
+            }
+
+            // C.3.0. Pipelined mode: the writes of the previous frame's dispatch are read by this dispatch and
+            // this frame's draw, one barrier before the dispatch covers both.
+            if (pipelined) {
+                glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+            }
 
             int outVerticesLoc = 0;
             int inVerticesLoc = 1;
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, outVerticesLoc, vertices_vbo);
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, inVerticesLoc, vertices_vbo);
-
-            glDispatchCompute(1, 1, 1);
-
-            glUseProgram(0);
-
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, outVerticesLoc, 0);
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, inVerticesLoc, 0);
-
-            glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+            /* The bindings stay for the next frame: in-place mode skips them, ping-pong mode swaps them. */
+            stateCacheBindBufferBase(GL_SHADER_STORAGE_BUFFER, outVerticesLoc, vertices_vbo[nextBuffer]);
+            stateCacheBindBufferBase(GL_SHADER_STORAGE_BUFFER, inVerticesLoc, vertices_vbo[currentBuffer]);
+
+            glDispatchCompute(workGroupCount, 1, 1);
+
+            // C.3.1. The written buffer is used as a vertex input by the draw and
+            // in the ping-pong mode as the SSBO input of the next frame's dispatch.
+            /* The pipelined mode draws it in the next frame: the barrier of C.3.0 is issued then. */
+            GLbitfield barriers = GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT;
+            if (pingPong) {
+                barriers |= GL_SHADER_STORAGE_BARRIER_BIT;
+            }
+            // C.3.2. The indirect draw reads its command from the buffer written by the shader.
+            if (indirect) {
+                barriers |= GL_COMMAND_BARRIER_BIT;
+            }
+            if (!pipelined) {
+                glMemoryBarrier(barriers);
+            }
         }
 
+        gpuTimerBegin(&gpuTimer, "draw");
 
         // X. Clear the color image.
         glClearColor(0.0, 0.3, 0.3, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
         // X. Use the shader program to draw.
-        glUseProgram(shader_program);
+        /* Fixed timestep mode: the fraction of the next step already elapsed blends the last two states. */
+        if (simRate > 0.0) {
+            stateCacheUseProgram(interpolated_program);
+            glUniform1f(alphaLoc, (float)(simAccumulator / simStep));
+        } else {
+            stateCacheUseProgram(shader_program);
+        }
 
-        // V.3. Use the VAO
-        glBindVertexArray(vao);
+        // V.3. Use the VAO (the compacted draw buffer in the indirect mode).
+        if (simRate > 0.0) {
+            stateCacheBindVertexArray(interpolated_vao[drawBuffer]);
+        } else {
+            stateCacheBindVertexArray(indirect ? draw_vao : vao[drawBuffer]);
+        }
 
         // XX. Update the transformation matrix.
         {
-            glm::mat4 transform = glm::mat4(1.0f);
-            //transform = glm::rotate(transform, (float)glfwGetTime() / 10.f, glm::vec3(0.0f, 0.0f, 1.0f));
-            //transform = glm::scale(transform, glm::vec3(0.5, 0.5, 0.5));
+            //transform = glm::rotate(transform, (float)demoGetTime(&demo) / 10.f, glm::vec3(0.0f, 0.0f, 1.0f));
             glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(transform));
         }
 
@@ -372,16 +1132,68 @@ int main(int argc, char **argv) {
         //if (color > 1.0) { color = 0.0; }
 
         // X. Draw the triangles.
-        glDrawArrays(GL_TRIANGLES, 0, 3);
+        /* Indirect mode: the vertex count is only known by the GPU. */
+        if (indirect) {
+            stateCacheBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+            glDrawArraysIndirect(GL_TRIANGLES, NULL);
+        } else {
+            glDrawArrays(GL_TRIANGLES, 0, triangleCount * 3);
+        }
+        gpuTimerEnd(&gpuTimer);
+
+        // T.3. Show the pass times (if requested).
+        gpuTimerDrawOverlay(&gpuTimer, 10, 10);
+        gpuTimerEndFrame(&gpuTimer);
+
+        // C.X. The freshly written buffer is the input of the next frame.
+        currentBuffer = nextBuffer;
 
         // X. Swap the fron-back buffers to display the rendered image in the window.
-        glfwSwapBuffers(window);
+        demoSwapBuffers(&demo);
+
+        // X. Report the frame time and the simulated triangles per second.
+        statsFrames++;
+        statsSteps += simSteps;
+        double statsElapsed = demoGetTime(&demo) - statsStartTime;
+        if (statsElapsed >= 1.0) {
+            /* Fixed timestep mode: the simulation throughput is measured apart from the frame rate. */
+            if (simRate > 0.0) {
+                printf("%d triangles: %.3f ms/frame, %.1f steps/s, %.2f M triangle steps/s (%d steps dropped)\n",
+                       triangleCount, statsElapsed * 1000.0 / statsFrames, statsSteps / statsElapsed,
+                       (double)triangleCount * statsSteps / statsElapsed / 1e6, droppedSteps);
+            } else {
+                printf("%d triangles: %.3f ms/frame, %.2f M triangles/s\n",
+                       triangleCount, statsElapsed * 1000.0 / statsFrames,
+                       (double)triangleCount * statsFrames / statsElapsed / 1e6);
+            }
+            printStateCacheStats();
+            stateCacheResetStats();
+            statsStartTime = demoGetTime(&demo);
+            statsFrames = 0;
+            statsSteps = 0;
+        }
     }
 
-    // XX. Destroy the window.
-    glfwDestroyWindow(window);
-    // XX. Destroy the GLFW.
-    glfwTerminate();
+    // XX. Destroy the compute program.
+    destroyComputeKernelVariants(&computeVariants);
+
+    // XX. Destroy the VAOs of the fixed timestep mode.
+    if (simRate > 0.0) {
+        glDeleteVertexArrays(2, interpolated_vao);
+    }
+
+    // XX. Destroy the buffers of the indirect mode.
+    if (indirect) {
+        glDeleteVertexArrays(1, &draw_vao);
+        glDeleteBuffers(1, &draw_vbo);
+        glDeleteBuffers(1, &command_buffer);
+    }
+
+    // XX. Destroy the GPU timer queries.
+    destroyGpuTimer(&gpuTimer);
+
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
 
     return 0;
 }
@@ -0,0 +1,341 @@
+/**
+ * Offline batch image filtering with compute shaders (see common/image_filter.h).
+ *
+ * Runs a filter pipeline (Gaussian blur, Sobel, colour grading in any order)
+ * over a batch of images and reports the throughput. Meant for headless
+ * runs: the input is an image file (or a generated test pattern) and the
+ * last result can be written out as a ppm file.
+ *
+ * Run:
+ * $ ./x_gles_compute_filter --surfaceless --image-size 8192x8192 --filters blur,grade,sobel --batch 50
+ * $ ./x_gles_compute_filter --surfaceless --input photo.jpg --output filtered.ppm --transfers
+ *
+ * Options (and the options of the demo context):
+ *  --input FILE       Source image (stb_image formats), default: a generated pattern.
+ *  --image-size WxH   Size of the generated pattern (default: 4096x4096).
+ *  --filters LIST     Comma separated stages: blur, sobel, grade (default: blur,grade).
+ *  --sigma F          Blur sigma in pixels (default: 4, the radius is 3 sigma, at most 16).
+ *  --batch N          Number of filtered images (default: 20, after a warm-up image).
+ *  --transfers        Upload the source and read back the result for every image
+ *                     (the full offline round trip), otherwise only the filtering is measured.
+ *  --output FILE      Write the last result as a binary ppm file.
+ *  --render-graph     Run the passes as a render graph (common/render_graph.h): the
+ *                     barriers are placed by the graph and the pass images are pooled
+ *                     transients. The graph of the first image is printed.
+ *
+ * The GB/s value is the image traffic of the passes: every pass reads and
+ * writes the image once (4 bytes per pixel each), the apron reads aren't counted.
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.1+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <GLES3/gl31.h>
+
+#include "common/compute.h"
+#include "common/demo_context.h"
+#include "common/gpu_memory.h"
+#include "common/image_filter.h"
+#include "common/render_graph.h"
+#include "common/render_target_pool.h"
+#include "common/stb_image.h"
+
+// Write out an R8G8B8A8 image as a binary ppm file.
+static void writePPM(const char* fileName, const uint8_t* pixels, int width, int height) {
+    std::vector<uint8_t> rgb(width * height * 3);
+    for (int idx = 0; idx < width * height; idx++) {
+        rgb[idx * 3 + 0] = pixels[idx * 4 + 0];
+        rgb[idx * 3 + 1] = pixels[idx * 4 + 1];
+        rgb[idx * 3 + 2] = pixels[idx * 4 + 2];
+    }
+
+    std::ofstream file(fileName, std::ios::out | std::ios::binary);
+    file << "P6\n" << width << "\n" << height << "\n" << 255 << "\n";
+    file.write((const char*)rgb.data(), rgb.size());
+    file.close();
+}
+
+// Colour gradients with a checker pattern: edges for Sobel and colours for the grading.
+static void generatePattern(std::vector<uint8_t>* pixels, int width, int height) {
+    pixels->resize((size_t)width * height * 4);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t* pixel = &(*pixels)[((size_t)y * width + x) * 4];
+            bool checker = ((x / 64) + (y / 64)) & 1;
+            pixel[0] = (uint8_t)(x * 255 / width);
+            pixel[1] = (uint8_t)(y * 255 / height);
+            pixel[2] = checker ? 224 : 32;
+            pixel[3] = 255;
+        }
+    }
+}
+
+struct UploadPass {
+    int source;
+    int width;
+    int height;
+    const uint8_t* pixels;
+};
+
+struct ReadBackPass {
+    int image;
+    int width;
+    int height;
+    unsigned int readFbo;
+    uint8_t* result;
+};
+
+static void executeUpload(RenderGraph* graph, int pass, void* userData) {
+    (void)pass;
+    const UploadPass* data = (const UploadPass*)userData;
+    glBindTexture(GL_TEXTURE_2D, renderGraphTexture(graph, data->source));
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, data->width, data->height, GL_RGBA, GL_UNSIGNED_BYTE, data->pixels);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+static void executeReadBack(RenderGraph* graph, int pass, void* userData) {
+    (void)pass;
+    const ReadBackPass* data = (const ReadBackPass*)userData;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, data->readFbo);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           renderGraphTexture(graph, data->image), 0);
+    glReadPixels(0, 0, data->width, data->height, GL_RGBA, GL_UNSIGNED_BYTE, data->result);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
+
+int main(int argc, char **argv) {
+    // 0-4. Create the window (or the headless offscreen context), nothing is rendered.
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
+    demo.frameLimit = 0;
+
+    // 5. Parse the options.
+    const char* inputFile = NULL;
+    const char* outputFile = NULL;
+    const char* filters = "blur,grade";
+    int width = 4096;
+    int height = 4096;
+    float sigma = 4.0f;
+    int batch = 20;
+    bool transfers = false;
+    bool useGraph = false;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--input") == 0 && idx + 1 < argc) {
+            inputFile = argv[++idx];
+        } else if (strcmp(argv[idx], "--output") == 0 && idx + 1 < argc) {
+            outputFile = argv[++idx];
+        } else if (strcmp(argv[idx], "--filters") == 0 && idx + 1 < argc) {
+            filters = argv[++idx];
+        } else if (strcmp(argv[idx], "--image-size") == 0 && idx + 1 < argc) {
+            sscanf(argv[++idx], "%dx%d", &width, &height);
+        } else if (strcmp(argv[idx], "--sigma") == 0 && idx + 1 < argc) {
+            sigma = (float)atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--batch") == 0 && idx + 1 < argc) {
+            batch = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--transfers") == 0) {
+            transfers = true;
+        } else if (strcmp(argv[idx], "--render-graph") == 0) {
+            useGraph = true;
+        }
+    }
+    batch = batch > 0 ? batch : 1;
+
+    // 6. Load or generate the source image.
+    std::vector<uint8_t> pixels;
+    if (inputFile != NULL) {
+        int channels;
+        uint8_t* image = stbi_load(inputFile, &width, &height, &channels, 4);
+        if (image == NULL) {
+            printf("Error: unable to load '%s': %s\n", inputFile, stbi_failure_reason());
+            destroyDemoContext(&demo);
+            return -1;
+        }
+        pixels.assign(image, image + (size_t)width * height * 4);
+        stbi_image_free(image);
+    } else {
+        generatePattern(&pixels, width, height);
+    }
+
+    int maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    if (width <= 0 || height <= 0 || width > maxSize || height > maxSize) {
+        printf("Error: the image size %dx%d is not supported (max: %d)\n", width, height, maxSize);
+        destroyDemoContext(&demo);
+        return -1;
+    }
+
+    // 7. Build the pipeline from the filter list.
+    ImageFilterPipeline filter;
+    initImageFilterPipeline(&filter, width, height);
+    {
+        ColorGrade grade = { 0.25f, 1.15f, 1.3f, 1.1f, { 0.02f, 0.0f, -0.02f }, { 1.05f, 1.0f, 0.92f } };
+
+        std::string list = filters;
+        size_t start = 0;
+        while (start <= list.size()) {
+            size_t end = list.find(',', start);
+            std::string name = list.substr(start, end == std::string::npos ? std::string::npos : end - start);
+            if (name == "blur") {
+                imageFilterAddBlur(&filter, sigma);
+            } else if (name == "sobel") {
+                imageFilterAddSobel(&filter);
+            } else if (name == "grade") {
+                imageFilterAddColorGrade(&filter, grade);
+            } else {
+                printf("Error: unknown filter '%s' (blur, sobel, grade)\n", name.c_str());
+                destroyImageFilterPipeline(&filter);
+                destroyDemoContext(&demo);
+                return -1;
+            }
+            if (end == std::string::npos) {
+                break;
+            }
+            start = end + 1;
+        }
+    }
+
+    unsigned int source = createFilterImage(width, height, pixels.data());
+    std::vector<uint8_t> result((size_t)width * height * 4);
+
+    // 8. The result is read back through a framebuffer.
+    unsigned int readFbo;
+    glGenFramebuffers(1, &readFbo);
+
+    ComputeQueue queue;
+    initComputeQueue(&queue);
+
+    RenderTargetPool pool;
+    initRenderTargetPool(&pool);
+    RenderGraph graph;
+    initRenderGraph(&graph, &pool);
+
+    printf("Filtering %d images of %dx%d (%s, %d passes)%s%s\n", batch, width, height, filters, filter.passCount,
+           transfers ? " with uploads and read backs" : "", useGraph ? " as a render graph" : "");
+
+    // 9. Filter the batch, the first image is a warm-up (kernel compilation, first use of the images).
+    double startTime = 0.0;
+    unsigned int target = source;
+    for (int image = 0; image <= batch; image++) {
+        if (image == 1) {
+            glFinish();
+            startTime = demoGetTime(&demo);
+        }
+
+        bool readBack = transfers || (image == batch && outputFile != NULL);
+        if (useGraph) {
+            // 9.G.1. The upload, the filter passes and the read back (the result is exported if it isn't read).
+            renderGraphReset(&graph);
+            int sourceResource = renderGraphImportTexture(&graph, "source", source);
+
+            UploadPass upload = { sourceResource, width, height, pixels.data() };
+            if (transfers) {
+                int pass = renderGraphAddPass(&graph, "upload", executeUpload, &upload);
+                renderGraphUse(&graph, pass, sourceResource, RENDER_GRAPH_TEXTURE_UPLOAD);
+            }
+
+            int resultResource = imageFilterAddToGraph(&filter, &graph, &queue, sourceResource);
+
+            ReadBackPass readBackData = { resultResource, width, height, readFbo, result.data() };
+            if (readBack) {
+                int pass = renderGraphAddPass(&graph, "read back", executeReadBack, &readBackData);
+                renderGraphUse(&graph, pass, resultResource, RENDER_GRAPH_ATTACHMENT_READ);
+                renderGraphSideEffect(&graph, pass);
+            } else {
+                renderGraphExport(&graph, resultResource);
+            }
+
+            // 9.G.2. Place the barriers and run the passes.
+            renderGraphCompile(&graph);
+            if (image == 0) {
+                printRenderGraph(&graph);
+            }
+            renderGraphExecute(&graph);
+            renderTargetPoolEndFrame(&pool);
+            continue;
+        }
+
+        // 9.1. A new frame of the batch.
+        if (transfers) {
+            glBindTexture(GL_TEXTURE_2D, source);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+
+        // 9.2. Record and submit the passes.
+        target = imageFilterRecord(&filter, &queue, source);
+        computeQueueBarrier(&queue, GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+        computeQueueSubmit(&queue);
+
+        // 9.3. Read back the result (waits for the GPU).
+        if (readBack) {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, readFbo);
+            glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, result.data());
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        }
+    }
+    glFinish();
+    double elapsed = demoGetTime(&demo) - startTime;
+
+    // 10. Report the throughput.
+    {
+        double pixelCount = (double)width * height * batch;
+        double bytes = pixelCount * filter.passCount * 8.0;
+        printf("Filtered in %.3f s: %.3f ms/image | %.1f Mpixel/s | %.2f GB/s image traffic\n",
+               elapsed, elapsed * 1000.0 / batch, pixelCount / (elapsed * 1e6), bytes / (elapsed * 1e9));
+    }
+
+    if (useGraph) {
+        printRenderTargetPoolStats(&pool);
+    }
+
+    if (outputFile != NULL) {
+        writePPM(outputFile, result.data(), width, height);
+        printf("Wrote '%s'\n", outputFile);
+    }
+
+    // XX. Delete the images and the pipeline.
+    destroyRenderGraph(&graph);
+    destroyRenderTargetPool(&pool);
+    glDeleteFramebuffers(1, &readFbo);
+    glDeleteTextures(1, &source);
+    gpuMemoryReleaseTextures(1, &source);
+    destroyImageFilterPipeline(&filter);
+
+    destroyDemoContext(&demo);
+
+    return 0;
+}
@@ -0,0 +1,616 @@
+/**
+ * Benchmark of tiled matrix multiply (GEMM) and 2D convolution compute kernels
+ * against a multithreaded SIMD (SSE2 or NEON, see common/job_system.h) CPU
+ * implementation, to choose the GPU or the CPU path per workload size.
+ *
+ * GEMM: C = A * B with square N x N float matrices (N: a multiple of 32). A
+ * work group of 8x8 invocations computes a 32x32 block of C: the 32x32 blocks
+ * of A and B along K are loaded into shared memory with vec4 loads, every
+ * invocation accumulates 4 rows x 4 columns (a vec4 per row) in registers.
+ *
+ * Convolution: an N x N image of 4 channels (vec4) filtered by a K x K kernel
+ * of 4x4 channel mixing matrices (a 4 channel in, 4 channel out layer of a
+ * CNN, clamp to edge). A work group of 8x8 output pixels loads its input tile
+ * with the halo and the kernel weights into shared memory.
+ *
+ * Both kernels are built in highp and mediump variants: in the mediump one the
+ * shared memory and the accumulators are mediump, so GPUs with fp16 ALUs run
+ * them at half precision (the buffers stay 32 bit floats). The results are
+ * checked against the CPU: the error is the largest difference relative to the
+ * largest CPU value.
+ *
+ * For every size (x2 steps) the GFLOPS of the GPU (from the recording of the
+ * dispatch to the end of a glFinish, no upload or read back) and of the CPU
+ * are printed. The first run of every size is a warm-up run and isn't timed.
+ * At the end the size from which the GPU is faster is printed per workload.
+ *
+ * Run:
+ * $ ./x_gles_compute_gemm --surfaceless
+ * $ ./x_gles_compute_gemm --surfaceless --workload conv --kernel-size 5 --max-size 2048
+ *
+ * Options (and the options of the demo context):
+ *  --min-size N        Smallest matrix/image size (default: 64).
+ *  --max-size N        Largest matrix/image size (default: 1024).
+ *  --iterations N      Timed runs per size (default: 5).
+ *  --workload NAME     gemm, conv or all (default).
+ *  --precision NAME    highp, mediump or all (default).
+ *  --kernel-size K     Convolution kernel size: 1, 3, 5 or 7 (default: 3).
+ *  --threads N         CPU threads, including the main thread (default: one per core).
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.1+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <GLES3/gl31.h>
+
+#include "common/compute.h"
+#include "common/demo_context.h"
+#include "common/job_system.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GEMM_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define GEMM_NEON 1
+#endif
+
+// Shared by the kernels: LOWP is the precision of the shared memory and of the accumulators.
+static const char* bench_common_src = R"(#version 310 es
+#ifdef HALF
+#define LOWP mediump
+#else
+#define LOWP highp
+#endif
+precision highp float;
+
+#define SHARED_BARRIER() memoryBarrierShared(); barrier()
+)";
+
+// Local size 8x8, a work group computes a 32x32 block of C. uParams: x = N.
+static const char* gemm_src = R"(
+#define TILE 32
+
+layout(std430, binding = 0) readonly buffer MatrixA { vec4 values[]; } a;
+layout(std430, binding = 1) readonly buffer MatrixB { vec4 values[]; } b;
+layout(std430, binding = 2) writeonly buffer MatrixC { vec4 values[]; } c;
+
+// The rows of the A block are padded by one float against shared memory bank conflicts.
+shared LOWP float sA[TILE * (TILE + 1)];
+shared LOWP vec4 sB[TILE * TILE / 4];
+
+void main() {
+    int rowVectors = uParams.x / 4;
+    int tx = int(gl_LocalInvocationID.x);
+    int ty = int(gl_LocalInvocationID.y);
+    int lid = int(gl_LocalInvocationIndex);
+    int blockRow = int(gl_WorkGroupID.y) * TILE;
+    int blockVector = int(gl_WorkGroupID.x) * (TILE / 4);
+
+    LOWP vec4 acc0 = vec4(0.0);
+    LOWP vec4 acc1 = vec4(0.0);
+    LOWP vec4 acc2 = vec4(0.0);
+    LOWP vec4 acc3 = vec4(0.0);
+
+    for (int k = 0; k < uParams.x; k += TILE) {
+        // 1. Load the 32x32 blocks of A and B along K: 4+4 vec4 loads per invocation.
+        for (int item = 0; item < 4; item++) {
+            int idx = lid + item * 64;
+            int row = idx / 8;
+            int column = idx % 8;
+            vec4 value = a.values[(blockRow + row) * rowVectors + k / 4 + column];
+            int base = row * (TILE + 1) + column * 4;
+            sA[base] = value.x;
+            sA[base + 1] = value.y;
+            sA[base + 2] = value.z;
+            sA[base + 3] = value.w;
+            sB[idx] = b.values[(k + row) * rowVectors + blockVector + column];
+        }
+        SHARED_BARRIER();
+
+        // 2. 4 rows x 4 columns per invocation: a vec4 of B is reused by the 4 rows.
+        int rowBase = ty * 4 * (TILE + 1);
+        for (int kk = 0; kk < TILE; kk++) {
+            LOWP vec4 bValue = sB[kk * 8 + tx];
+            acc0 += sA[rowBase + kk] * bValue;
+            acc1 += sA[rowBase + (TILE + 1) + kk] * bValue;
+            acc2 += sA[rowBase + 2 * (TILE + 1) + kk] * bValue;
+            acc3 += sA[rowBase + 3 * (TILE + 1) + kk] * bValue;
+        }
+        SHARED_BARRIER();
+    }
+
+    int first = (blockRow + ty * 4) * rowVectors + blockVector + tx;
+    c.values[first] = acc0;
+    c.values[first + rowVectors] = acc1;
+    c.values[first + 2 * rowVectors] = acc2;
+    c.values[first + 3 * rowVectors] = acc3;
+}
+)";
+
+// Local size 8x8, one output pixel per invocation. uParams: x = width, y = height. RADIUS: (kernel size - 1) / 2.
+static const char* conv_src = R"(
+#define SIZE (2 * RADIUS + 1)
+#define TILE_X (LOCAL_SIZE_X + 2 * RADIUS)
+#define TILE_Y (LOCAL_SIZE_Y + 2 * RADIUS)
+#define INVOCATIONS (LOCAL_SIZE_X * LOCAL_SIZE_Y)
+
+layout(std430, binding = 0) readonly buffer Input { vec4 values[]; } src;
+layout(std430, binding = 1) readonly buffer Weights { mat4 values[]; } weights;
+layout(std430, binding = 2) writeonly buffer Output { vec4 values[]; } dst;
+
+shared LOWP vec4 sInput[TILE_X * TILE_Y];
+shared LOWP mat4 sWeights[SIZE * SIZE];
+
+void main() {
+    int lid = int(gl_LocalInvocationIndex);
+    ivec2 origin = ivec2(gl_WorkGroupID.xy) * ivec2(LOCAL_SIZE_X, LOCAL_SIZE_Y) - RADIUS;
+
+    // 1. Load the input tile with the halo (clamped to the edges) and the weights.
+    for (int idx = lid; idx < TILE_X * TILE_Y; idx += INVOCATIONS) {
+        ivec2 pos = clamp(origin + ivec2(idx % TILE_X, idx / TILE_X), ivec2(0), uParams.xy - 1);
+        sInput[idx] = src.values[pos.y * uParams.x + pos.x];
+    }
+    for (int idx = lid; idx < SIZE * SIZE; idx += INVOCATIONS) {
+        sWeights[idx] = weights.values[idx];
+    }
+    SHARED_BARRIER();
+
+    // 2. Mix the 4 channels of every tap.
+    ivec2 local = ivec2(gl_LocalInvocationID.xy);
+    LOWP vec4 acc = vec4(0.0);
+    for (int y = 0; y < SIZE; y++) {
+        for (int x = 0; x < SIZE; x++) {
+            acc += sWeights[y * SIZE + x] * sInput[(local.y + y) * TILE_X + local.x + x];
+        }
+    }
+
+    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+    if (pos.x < uParams.x && pos.y < uParams.y) {
+        dst.values[pos.y * uParams.x + pos.x] = acc;
+    }
+}
+)";
+
+enum Workload {
+    WORKLOAD_GEMM,
+    WORKLOAD_CONV,
+    WORKLOAD_COUNT
+};
+
+enum Precision {
+    PRECISION_HIGHP,
+    PRECISION_MEDIUMP,
+    PRECISION_COUNT
+};
+
+static const char* workload_names[WORKLOAD_COUNT] = { "gemm", "conv" };
+static const char* precision_names[PRECISION_COUNT] = { "highp", "mediump" };
+
+// Largest relative error of a precision (mediump: fp16 has 11 bits of mantissa).
+static const double precision_tolerance[PRECISION_COUNT] = { 1e-4, 2e-2 };
+
+// CPU implementation: one job per block of rows.
+struct CpuWorkload {
+    int size;
+    int radius;
+    const float* a;       // gemm: A, conv: the input image
+    const float* b;       // gemm: B, conv: the weights
+    float* c;
+};
+
+#if GEMM_SSE2
+// c[0..count) += a * b[0..count)
+static void multiplyAdd(float* c, const float* b, float a, int count) {
+    __m128 factor = _mm_set1_ps(a);
+    int idx = 0;
+    for (; idx + 8 <= count; idx += 8) {
+        __m128 c0 = _mm_add_ps(_mm_loadu_ps(c + idx), _mm_mul_ps(factor, _mm_loadu_ps(b + idx)));
+        __m128 c1 = _mm_add_ps(_mm_loadu_ps(c + idx + 4), _mm_mul_ps(factor, _mm_loadu_ps(b + idx + 4)));
+        _mm_storeu_ps(c + idx, c0);
+        _mm_storeu_ps(c + idx + 4, c1);
+    }
+    for (; idx < count; idx++) {
+        c[idx] += a * b[idx];
+    }
+}
+
+// output = sum of weights[tap] * *inputs[tap] (column major 4x4 matrices, vec4 inputs).
+static void mixTaps(const float* weights, const float* const* inputs, int taps, float* output) {
+    __m128 acc = _mm_setzero_ps();
+    for (int tap = 0; tap < taps; tap++) {
+        const float* m = weights + tap * 16;
+        const float* v = inputs[tap];
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(m), _mm_set1_ps(v[0])));
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(m + 4), _mm_set1_ps(v[1])));
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(m + 8), _mm_set1_ps(v[2])));
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(m + 12), _mm_set1_ps(v[3])));
+    }
+    _mm_storeu_ps(output, acc);
+}
+
+static const char* cpuImplementation() {
+    return "SSE2";
+}
+
+#elif GEMM_NEON
+static void multiplyAdd(float* c, const float* b, float a, int count) {
+    int idx = 0;
+    for (; idx + 8 <= count; idx += 8) {
+        float32x4_t c0 = vmlaq_n_f32(vld1q_f32(c + idx), vld1q_f32(b + idx), a);
+        float32x4_t c1 = vmlaq_n_f32(vld1q_f32(c + idx + 4), vld1q_f32(b + idx + 4), a);
+        vst1q_f32(c + idx, c0);
+        vst1q_f32(c + idx + 4, c1);
+    }
+    for (; idx < count; idx++) {
+        c[idx] += a * b[idx];
+    }
+}
+
+static void mixTaps(const float* weights, const float* const* inputs, int taps, float* output) {
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (int tap = 0; tap < taps; tap++) {
+        const float* m = weights + tap * 16;
+        const float* v = inputs[tap];
+        acc = vmlaq_n_f32(acc, vld1q_f32(m), v[0]);
+        acc = vmlaq_n_f32(acc, vld1q_f32(m + 4), v[1]);
+        acc = vmlaq_n_f32(acc, vld1q_f32(m + 8), v[2]);
+        acc = vmlaq_n_f32(acc, vld1q_f32(m + 12), v[3]);
+    }
+    vst1q_f32(output, acc);
+}
+
+static const char* cpuImplementation() {
+    return "NEON";
+}
+
+#else
+static void multiplyAdd(float* c, const float* b, float a, int count) {
+    for (int idx = 0; idx < count; idx++) {
+        c[idx] += a * b[idx];
+    }
+}
+
+static void mixTaps(const float* weights, const float* const* inputs, int taps, float* output) {
+    float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int tap = 0; tap < taps; tap++) {
+        const float* m = weights + tap * 16;
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                acc[row] += m[column * 4 + row] * inputs[tap][column];
+            }
+        }
+    }
+    memcpy(output, acc, sizeof(acc));
+}
+
+static const char* cpuImplementation() {
+    return "scalar";
+}
+#endif
+
+// Rows of C = A * B, K is split in blocks so a block of B rows stays in the cache.
+static void gemmRows(void* data, int begin, int end) {
+    const CpuWorkload* cpu = (const CpuWorkload*)data;
+    int n = cpu->size;
+    memset(&cpu->c[(size_t)begin * n], 0, (size_t)(end - begin) * n * sizeof(float));
+
+    for (int kBegin = 0; kBegin < n; kBegin += 64) {
+        int kEnd = kBegin + 64 < n ? kBegin + 64 : n;
+        for (int row = begin; row < end; row++) {
+            float* c = &cpu->c[(size_t)row * n];
+            const float* a = &cpu->a[(size_t)row * n];
+            for (int k = kBegin; k < kEnd; k++) {
+                multiplyAdd(c, &cpu->b[(size_t)k * n], a[k], n);
+            }
+        }
+    }
+}
+
+static void convRows(void* data, int begin, int end) {
+    const CpuWorkload* cpu = (const CpuWorkload*)data;
+    int n = cpu->size;
+    int kernelSize = 2 * cpu->radius + 1;
+    const float* inputs[7 * 7];
+
+    for (int y = begin; y < end; y++) {
+        for (int x = 0; x < n; x++) {
+            // Clamp to edge, like the kernel.
+            for (int ky = 0; ky < kernelSize; ky++) {
+                int sy = y + ky - cpu->radius;
+                sy = sy < 0 ? 0 : (sy >= n ? n - 1 : sy);
+                for (int kx = 0; kx < kernelSize; kx++) {
+                    int sx = x + kx - cpu->radius;
+                    sx = sx < 0 ? 0 : (sx >= n ? n - 1 : sx);
+                    inputs[ky * kernelSize + kx] = &cpu->a[((size_t)sy * n + sx) * 4];
+                }
+            }
+            mixTaps(cpu->b, inputs, kernelSize * kernelSize, &cpu->c[((size_t)y * n + x) * 4]);
+        }
+    }
+}
+
+struct Bench {
+    DemoContext* demo;
+    ComputeQueue* queue;
+    JobSystem* jobs;
+    ComputeKernel kernels[WORKLOAD_COUNT][PRECISION_COUNT];
+    bool enabled[WORKLOAD_COUNT][PRECISION_COUNT];
+    int radius;
+    int iterations;
+
+    // Smallest size from which the GPU is faster at every larger size (0: the CPU is faster at the largest size).
+    int gpuFasterFrom[WORKLOAD_COUNT][PRECISION_COUNT];
+};
+
+// Wait for the GPU, then start the clock.
+static double gpuBegin(Bench* bench) {
+    glFinish();
+    return demoGetTime(bench->demo);
+}
+
+// Submit the recorded dispatch and wait for it, returns the elapsed milliseconds.
+static double gpuEnd(Bench* bench, double start) {
+    computeQueueBarrier(bench->queue, GL_BUFFER_UPDATE_BARRIER_BIT);
+    computeQueueSubmit(bench->queue);
+    glFinish();
+    return (demoGetTime(bench->demo) - start) * 1000.0;
+}
+
+// Largest difference relative to the largest value of the CPU result.
+static double relativeError(const std::vector<float>& gpu, const std::vector<float>& cpu) {
+    double maxValue = 1e-6;
+    double maxError = 0.0;
+    for (size_t idx = 0; idx < cpu.size(); idx++) {
+        maxValue = fmax(maxValue, fabs(cpu[idx]));
+        maxError = fmax(maxError, fabs((double)gpu[idx] - cpu[idx]));
+    }
+    return maxError / maxValue;
+}
+
+static void benchWorkload(Bench* bench, Workload workload, int size, const std::vector<float>& a,
+                          const std::vector<float>& b, int outputCount) {
+    // 1. The CPU result and timing are shared by the precisions.
+    std::vector<float> cpuOutput(outputCount);
+    CpuWorkload cpu = { size, bench->radius, a.data(), b.data(), cpuOutput.data() };
+    double cpuMs = 0.0;
+    for (int run = 0; run <= bench->iterations; run++) {
+        double start = demoGetTime(bench->demo);
+        if (workload == WORKLOAD_GEMM) {
+            jobSystemParallelFor(bench->jobs, size, 8, gemmRows, &cpu);
+        } else {
+            jobSystemParallelFor(bench->jobs, size, 4, convRows, &cpu);
+        }
+        if (run > 0) {
+            cpuMs += (demoGetTime(bench->demo) - start) * 1000.0;
+        }
+    }
+    cpuMs /= bench->iterations;
+
+    double flops = workload == WORKLOAD_GEMM
+        ? 2.0 * size * size * size
+        : 2.0 * 16.0 * (2 * bench->radius + 1) * (2 * bench->radius + 1) * size * size;
+
+    // 2. Upload the inputs once, run every enabled precision.
+    StorageBuffer<float> gpuA = createStorageBuffer<float>((int)a.size(), a.data());
+    StorageBuffer<float> gpuB = createStorageBuffer<float>((int)b.size(), b.data());
+    StorageBuffer<float> gpuC = createStorageBuffer<float>(outputCount);
+    std::vector<float> gpuOutput(outputCount);
+
+    for (int precision = 0; precision < PRECISION_COUNT; precision++) {
+        if (!bench->enabled[workload][precision]) {
+            continue;
+        }
+
+        double gpuMs = 0.0;
+        for (int run = 0; run <= bench->iterations; run++) {
+            double start = gpuBegin(bench);
+            if (workload == WORKLOAD_GEMM) {
+                computeQueueAdd(bench->queue, &bench->kernels[workload][precision], size / 4, size / 4, 1);
+            } else {
+                computeQueueAdd(bench->queue, &bench->kernels[workload][precision], size, size, 1);
+            }
+            computeQueueBind(bench->queue, 0, gpuA.buffer);
+            computeQueueBind(bench->queue, 1, gpuB.buffer);
+            computeQueueBind(bench->queue, 2, gpuC.buffer);
+            computeQueueParams(bench->queue, size, size);
+            double elapsed = gpuEnd(bench, start);
+            if (run > 0) {
+                gpuMs += elapsed;
+            }
+        }
+        gpuMs /= bench->iterations;
+
+        readStorageBuffer(gpuC, 0, outputCount, gpuOutput.data());
+        double error = relativeError(gpuOutput, cpuOutput);
+
+        printf("%-4s %-7s %5d: GPU %9.3f ms %8.2f GFLOPS | CPU %9.3f ms %8.2f GFLOPS | error %.1e %s\n",
+               workload_names[workload], precision_names[precision], size, gpuMs, flops / (gpuMs * 1e6),
+               cpuMs, flops / (cpuMs * 1e6), error, error <= precision_tolerance[precision] ? "ok" : "MISMATCH");
+
+        int& from = bench->gpuFasterFrom[workload][precision];
+        if (gpuMs < cpuMs) {
+            from = from != 0 ? from : size;
+        } else {
+            from = 0;
+        }
+    }
+
+    destroyStorageBuffer(&gpuA);
+    destroyStorageBuffer(&gpuB);
+    destroyStorageBuffer(&gpuC);
+}
+
+// Random values in [-1, 1] (xorshift).
+static void randomValues(std::vector<float>* values, unsigned int seed) {
+    for (size_t idx = 0; idx < values->size(); idx++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        (*values)[idx] = (float)(seed >> 8) / (float)(1 << 23) - 1.0f;
+    }
+}
+
+int main(int argc, char **argv) {
+    // 0-4. Create the window (or the headless offscreen context), nothing is rendered.
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
+    demo.frameLimit = 0;
+
+    // 5. Parse the benchmark options.
+    int minSize = 64;
+    int maxSize = 1024;
+    int iterations = 5;
+    int threadCount = 0;
+    int kernelSize = 3;
+    const char* workloadName = "all";
+    const char* precisionName = "all";
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--min-size") == 0 && idx + 1 < argc) {
+            minSize = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--max-size") == 0 && idx + 1 < argc) {
+            maxSize = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--iterations") == 0 && idx + 1 < argc) {
+            iterations = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--workload") == 0 && idx + 1 < argc) {
+            workloadName = argv[++idx];
+        } else if (strcmp(argv[idx], "--precision") == 0 && idx + 1 < argc) {
+            precisionName = argv[++idx];
+        } else if (strcmp(argv[idx], "--kernel-size") == 0 && idx + 1 < argc) {
+            kernelSize = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--threads") == 0 && idx + 1 < argc) {
+            threadCount = atoi(argv[++idx]);
+        }
+    }
+    if (kernelSize < 1 || kernelSize > 7 || kernelSize % 2 == 0) {
+        printf("Unsupported kernel size: %d (1, 3, 5 or 7)\n", kernelSize);
+        destroyDemoContext(&demo);
+        return -1;
+    }
+    // The GEMM blocks are 32x32: the sizes are rounded up to multiples of 32.
+    minSize = minSize > 32 ? (minSize + 31) / 32 * 32 : 32;
+    iterations = iterations > 0 ? iterations : 1;
+
+    // 6. Build the kernel variants and start the CPU threads.
+    ComputeQueue queue;
+    initComputeQueue(&queue);
+
+    JobSystem jobs;
+    initJobSystem(&jobs, threadCount);
+
+    Bench bench;
+    memset(&bench, 0, sizeof(bench));
+    bench.demo = &demo;
+    bench.queue = &queue;
+    bench.jobs = &jobs;
+    bench.radius = kernelSize / 2;
+    bench.iterations = iterations;
+
+    const char* sources[WORKLOAD_COUNT] = { gemm_src, conv_src };
+    for (int workload = 0; workload < WORKLOAD_COUNT; workload++) {
+        for (int precision = 0; precision < PRECISION_COUNT; precision++) {
+            if ((strcmp(workloadName, "all") != 0 && strcmp(workloadName, workload_names[workload]) != 0) ||
+                (strcmp(precisionName, "all") != 0 && strcmp(precisionName, precision_names[precision]) != 0)) {
+                continue;
+            }
+
+            ComputeDefines defines;
+            computeDefine(&defines, "RADIUS", bench.radius);
+            if (precision == PRECISION_MEDIUMP) {
+                computeDefineFlag(&defines, "HALF");
+            }
+            std::string source = std::string(bench_common_src) + sources[workload];
+            bench.enabled[workload][precision] =
+                createComputeKernelSized(&bench.kernels[workload][precision], source.c_str(), 8, 8, 1, &defines);
+            if (!bench.enabled[workload][precision]) {
+                printf("%s %s: the work group exceeds the compute limits, skipped\n",
+                       workload_names[workload], precision_names[precision]);
+            }
+        }
+    }
+
+    printf("GEMM / convolution: %s | CPU: %s, %d threads | %dx%d kernel\n",
+           (const char*)glGetString(GL_RENDERER), cpuImplementation(), jobs.threadCount, kernelSize, kernelSize);
+
+    // 7. Run the workloads for every size.
+    for (int size = minSize; size > 0 && size <= maxSize; size *= 2) {
+        if (bench.enabled[WORKLOAD_GEMM][PRECISION_HIGHP] || bench.enabled[WORKLOAD_GEMM][PRECISION_MEDIUMP]) {
+            std::vector<float> a(size * size);
+            std::vector<float> b(size * size);
+            randomValues(&a, 0x12345678u);
+            randomValues(&b, 0x9abcdef0u);
+            benchWorkload(&bench, WORKLOAD_GEMM, size, a, b, size * size);
+        }
+        if (bench.enabled[WORKLOAD_CONV][PRECISION_HIGHP] || bench.enabled[WORKLOAD_CONV][PRECISION_MEDIUMP]) {
+            // The weights are scaled by the tap count: the outputs stay in the range of the inputs.
+            std::vector<float> image(size * size * 4);
+            std::vector<float> weights(kernelSize * kernelSize * 16);
+            randomValues(&image, 0x12345678u);
+            randomValues(&weights, 0x9abcdef0u);
+            for (size_t idx = 0; idx < weights.size(); idx++) {
+                weights[idx] /= (float)(kernelSize * kernelSize * 4);
+            }
+            benchWorkload(&bench, WORKLOAD_CONV, size, image, weights, size * size * 4);
+        }
+    }
+
+    // 8. The crossover sizes: where to switch from the CPU path to the GPU path.
+    for (int workload = 0; workload < WORKLOAD_COUNT; workload++) {
+        for (int precision = 0; precision < PRECISION_COUNT; precision++) {
+            if (!bench.enabled[workload][precision]) {
+                continue;
+            }
+            int from = bench.gpuFasterFrom[workload][precision];
+            if (from != 0) {
+                printf("%s %s: the GPU is faster from %d\n", workload_names[workload], precision_names[precision], from);
+            } else {
+                printf("%s %s: the CPU is faster at the largest size\n", workload_names[workload], precision_names[precision]);
+            }
+        }
+    }
+
+    // XX. Stop the CPU threads and destroy the kernels.
+    destroyJobSystem(&jobs);
+    for (int workload = 0; workload < WORKLOAD_COUNT; workload++) {
+        for (int precision = 0; precision < PRECISION_COUNT; precision++) {
+            if (bench.enabled[workload][precision]) {
+                destroyComputeKernel(&bench.kernels[workload][precision]);
+            }
+        }
+    }
+
+    destroyDemoContext(&demo);
+
+    return 0;
+}
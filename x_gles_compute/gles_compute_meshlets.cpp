@@ -0,0 +1,300 @@
+/**
+ * Meshlet culling of a high-poly model with a compute pass (see common/meshlet.h).
+ *
+ * The model is split into meshlets of up to 64 vertices and 124 triangles at
+ * startup (or loaded from an asset bundle baked by "asset_bundle --meshlets").
+ * Every frame a compute pass tests the bounding sphere of each meshlet
+ * against the frustum and its normal cone against the camera, the triangles
+ * of the visible meshlets are compacted into an index buffer and drawn with
+ * one glDrawElementsIndirect. About half of a closed model is back-facing,
+ * those meshlets never reach the vertex shader.
+ *
+ * Run (a bumpy sphere of 512x256 quads):
+ * $ ./x_gles_compute_meshlets
+ *
+ * Compare with drawing every triangle, or with the frustum test only:
+ * $ ./x_gles_compute_meshlets --headless --no-meshlet-cull
+ * $ ./x_gles_compute_meshlets --headless --no-cone-cull
+ *
+ * Options:
+ *  --detail N           Quads around the sphere (N x N/2, default: 512).
+ *  --distance D         Camera distance from the center (default: 2.2, the sphere radius is 1).
+ *  --bundle FILE NAME   Draw the mesh NAME and its meshlets from an asset bundle.
+ *  --no-meshlet-cull    Draw the whole index buffer.
+ *  --no-cone-cull       Only cull the meshlets outside the frustum.
+ *  --gpu-timer          Print the GPU time of the cull pass and the draw (see common/gpu_timer.h).
+ *
+ * Dependencies:
+ *  * C++11
+ *  * GLFW 3.0+
+ *  * Open GL ES 3.1+
+ *  * EGL
+ *  * GLM
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <GLES3/gl31.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "common/asset_bundle.h"
+#include "common/demo_context.h"
+#include "common/gpu_timer.h"
+#include "common/mesh.h"
+#include "common/mesh_lod.h"
+#include "common/meshlet.h"
+#include "common/program_cache.h"
+
+const char* vertex_src = R"(#version 300 es
+precision highp float;
+
+in vec3 aPos;
+out vec3 worldPos;
+
+uniform mat4 uModel;
+uniform mat4 uViewProjection;
+
+void main() {
+    vec4 position = uModel * vec4(aPos, 1.0);
+    worldPos = position.xyz;
+    gl_Position = uViewProjection * position;
+}
+)";
+
+// Flat shading from the screen space derivatives: the mesh needs no normals.
+const char* fragment_src = R"(#version 300 es
+precision mediump float;
+
+in highp vec3 worldPos;
+out vec4 outColor;
+
+void main() {
+    vec3 normal = normalize(cross(dFdx(worldPos), dFdy(worldPos)));
+    float light = max(dot(normal, normalize(vec3(0.4, 0.8, 0.6))), 0.0) * 0.8 + 0.2;
+    outColor = vec4(vec3(0.9, 0.6, 0.3) * light, 1.0);
+}
+)";
+
+// Sphere of radius 1 with bumps, "detail" x "detail / 2" quads (the seam and the poles are welded).
+static MeshData createBumpySphere(int detail) {
+    MeshData grid = createGridMesh(detail, detail / 2);
+    for (size_t idx = 0; idx < grid.positions.size(); idx += 3) {
+        // The grid is in -0.5 .. 0.5, the longitude runs clockwise so the triangles face outwards.
+        float theta = -2.0f * (float)M_PI * (grid.positions[idx] + 0.5f);
+        float phi = (float)M_PI * (grid.positions[idx + 1] + 0.5f);
+        float radius = 1.0f + 0.01f * sinf(theta * 24.0f) * sinf(phi * 16.0f);
+        grid.positions[idx] = radius * sinf(phi) * cosf(theta);
+        grid.positions[idx + 1] = -radius * cosf(phi);
+        grid.positions[idx + 2] = radius * sinf(phi) * sinf(theta);
+    }
+    return weldMeshPositions(grid);
+}
+
+int main(int argc, char **argv) {
+    int detail = 512;
+    float distance = 2.2f;
+    const char* bundlePath = NULL;
+    const char* bundleMesh = NULL;
+    bool meshletCulling = true;
+    bool coneCulling = true;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--detail") == 0 && idx + 1 < argc) {
+            detail = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--distance") == 0 && idx + 1 < argc) {
+            distance = (float)atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--bundle") == 0 && idx + 2 < argc) {
+            bundlePath = argv[++idx];
+            bundleMesh = argv[++idx];
+        } else if (strcmp(argv[idx], "--no-meshlet-cull") == 0) {
+            meshletCulling = false;
+        } else if (strcmp(argv[idx], "--no-cone-cull") == 0) {
+            coneCulling = false;
+        }
+    }
+
+    if (detail < 8 || detail > 4096) {
+        printf("Invalid detail: %d (valid range: 8-4096)\n", detail);
+        return -1;
+    }
+
+    // 0-4. Create the window (or the headless offscreen context).
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
+
+    int major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major < 3 || (major == 3 && minor < 1)) {
+        printf("Meshlet culling requires OpenGL ES 3.1 (compute shaders), the context is %d.%d\n", major, minor);
+        destroyDemoContext(&demo);
+        return -1;
+    }
+
+    // 6. Create the shader program.
+    unsigned int shader_program = createCachedProgram(vertex_src, fragment_src);
+    int aPosLoc = glGetAttribLocation(shader_program, "aPos");
+    int modelLoc = glGetUniformLocation(shader_program, "uModel");
+    int viewProjectionLoc = glGetUniformLocation(shader_program, "uViewProjection");
+
+    // M.1. The mesh and its meshlets: built now or baked into a bundle.
+    /* The index buffer of the mesh is in meshlet order in both cases. */
+    MeshBuffers mesh;
+    MeshletData meshlets;
+    double buildStart = demoGetTime(&demo);
+    if (bundlePath != NULL) {
+        AssetBundle bundle;
+        if (!openAssetBundle(&bundle, bundlePath)) {
+            destroyDemoContext(&demo);
+            return -1;
+        }
+        bool loaded = uploadBundleMesh(&bundle, bundleMesh, aPosLoc, -1, &mesh);
+        if (loaded && !bundleMeshlets(&bundle, bundleMesh, &meshlets)) {
+            printf("The mesh '%s' has no meshlets (bake it with \"asset_bundle --meshlets\")\n", bundleMesh);
+            destroyMeshBuffers(&mesh);
+            loaded = false;
+        }
+        closeAssetBundle(&bundle);
+        if (!loaded) {
+            destroyDemoContext(&demo);
+            return -1;
+        }
+    } else {
+        MeshData sphere = createBumpySphere(detail);
+        meshlets = buildMeshlets(sphere);
+        sphere.indices = meshlets.indices;
+        mesh = uploadMesh(sphere, false, aPosLoc, -1);
+    }
+    double buildMs = (demoGetTime(&demo) - buildStart) * 1000.0;
+
+    int meshletVertices = 0;
+    for (const Meshlet& meshlet : meshlets.meshlets) {
+        meshletVertices += meshlet.vertexCount;
+    }
+    int meshletCount = (int)meshlets.meshlets.size();
+    int triangleCount = (int)meshlets.indices.size() / 3;
+    printf("Meshlets: %d triangles in %d meshlets (%.1f triangles, %.1f vertices on average), %s in %.1f ms\n",
+           triangleCount, meshletCount, (double)triangleCount / std::max(meshletCount, 1),
+           (double)meshletVertices / std::max(meshletCount, 1), bundlePath ? "loaded" : "built", buildMs);
+
+    // M.2. The culler. The culled triangles are drawn with the position-only VAO of the mesh:
+    /* its element buffer is replaced by the culled index buffer, "mesh.vao" keeps the original one. */
+    MeshletCuller culler;
+    initMeshletCuller(&culler, meshlets);
+    glBindVertexArray(mesh.positionVao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, culler.culledIndexBuffer);
+    glBindVertexArray(0);
+
+    GpuTimer gpuTimer;
+    initGpuTimer(&gpuTimer, argc, argv);
+
+    demoSwapInterval(&demo, 0);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+
+    // X. Create a render loop.
+    while (!demoShouldClose(&demo))
+    {
+        // X. Poll and handle events (inputs, window resize, etc.)
+        demoPollEvents(&demo);
+        gpuTimerBeginFrame(&gpuTimer);
+
+        int display_w, display_h;
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
+        glBindFramebuffer(GL_FRAMEBUFFER, demoDefaultFramebuffer(&demo));
+        glViewport(0, 0, display_w, display_h);
+
+        // X. Clear the color image.
+        glClearColor(0.0, 0.3, 0.3, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // M.3. The model rotates in front of the camera, the camera position is needed in object space.
+        float time = (float)demoAnimationTime(&demo);
+        glm::mat4 model = glm::rotate(glm::mat4(1.0f), time * 0.5f, glm::vec3(0.2f, 1.0f, 0.0f));
+        glm::vec3 eye(0.0f, 0.0f, distance);
+        glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)display_w / display_h, 0.1f, 100.0f);
+        glm::mat4 viewProjection = projection * view;
+        glm::vec4 objectEye = glm::inverse(model) * glm::vec4(eye, 1.0f);
+
+        glUseProgram(shader_program);
+        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+        glUniformMatrix4fv(viewProjectionLoc, 1, GL_FALSE, glm::value_ptr(viewProjection));
+
+        if (meshletCulling) {
+            // M.4. Cull the meshlets and draw the compacted triangles, the CPU doesn't know their count.
+            {
+                GpuTimerScope scope(&gpuTimer, "meshlet cull");
+                glm::mat4 modelViewProjection = viewProjection * model;
+                meshletCull(&culler, glm::value_ptr(modelViewProjection), glm::value_ptr(objectEye), coneCulling);
+            }
+
+            GpuTimerScope scope(&gpuTimer, "draw");
+            glUseProgram(shader_program);
+            glBindVertexArray(mesh.positionVao);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culler.commandBuffer);
+            glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, NULL);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        } else {
+            GpuTimerScope scope(&gpuTimer, "draw");
+            glBindVertexArray(mesh.vao);
+            glDrawElements(GL_TRIANGLES, triangleCount * 3, mesh.indexType, NULL);
+        }
+        glBindVertexArray(0);
+
+        gpuTimerEndFrame(&gpuTimer);
+
+        // X. Swap the fron-back buffers to display the rendered image in the window.
+        demoSwapBuffers(&demo);
+    }
+
+    // M.5. The result of the last frame (reads the command back).
+    if (meshletCulling) {
+        int visibleMeshlets = 0;
+        int visibleIndices = 0;
+        meshletVisibleCount(&culler, &visibleMeshlets, &visibleIndices);
+        printf("Meshlets: %d of %d visible (%s), %d of %d triangles drawn\n", visibleMeshlets, meshletCount,
+               coneCulling ? "frustum and cone" : "frustum", visibleIndices / 3, triangleCount);
+    }
+
+    destroyGpuTimer(&gpuTimer);
+    destroyMeshletCuller(&culler);
+    destroyMeshBuffers(&mesh);
+    glDeleteProgram(shader_program);
+
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
+
+    return 0;
+}
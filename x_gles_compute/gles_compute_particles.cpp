@@ -0,0 +1,213 @@
+/**
+ * A GPU particle fountain of up to a million particles (see common/particle_system.h).
+ *
+ * The particles are emitted, simulated, depth sorted and expanded into
+ * camera-facing billboards on the GPU: compute passes for the emission and
+ * the simulation (with a dead list and an alive list sized by atomic
+ * counters), a radix sort of the alive list by the distance from the camera
+ * for the alpha blending, and one indirect instanced draw whose vertex shader
+ * builds the quads from gl_VertexID. The GPU time of every stage and the
+ * alive particle count are printed every second.
+ *
+ * Run:
+ * $ ./x_gles_compute_particles --particles 1000000
+ *
+ * Additive blending doesn't need the sorted order, compare the cost of the sort:
+ * $ ./x_gles_compute_particles --particles 1000000 --additive --no-sort
+ *
+ * Options:
+ *  --particles N   Capacity of the particle pool (default: 1000000).
+ *  --rate N        Particles emitted per second (default: the capacity divided by the average lifetime).
+ *  --no-sort       Skip the depth sort (the draw order is the order of the alive list).
+ *  --additive      Additive blending instead of the back to front alpha blending.
+ *
+ * Dependencies:
+ *  * C++11
+ *  * GLFW 3.0+
+ *  * Open GL ES 3.1+
+ *  * EGL
+ *  * GLM
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <GLES3/gl31.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "common/demo_context.h"
+#include "common/gpu_timer.h"
+#include "common/particle_system.h"
+
+int main(int argc, char **argv) {
+    int capacity = 1000000;
+    float rate = -1.0f;
+    bool sort = true;
+    bool additive = false;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--particles") == 0 && idx + 1 < argc) {
+            capacity = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--rate") == 0 && idx + 1 < argc) {
+            rate = (float)atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--no-sort") == 0) {
+            sort = false;
+        } else if (strcmp(argv[idx], "--additive") == 0) {
+            additive = true;
+        }
+    }
+
+    if (capacity < 1) {
+        printf("Invalid particle count: %d\n", capacity);
+        return -1;
+    }
+
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES context.
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
+
+    int major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major < 3 || (major == 3 && minor < 1)) {
+        printf("The particle system requires OpenGL ES 3.1 (compute shaders), the context is %d.%d\n", major, minor);
+        destroyDemoContext(&demo);
+        return -1;
+    }
+
+    // P.1. The fountain: a cone of 25 degrees upwards, the pool is full at the default rate.
+    ParticleEmitter emitter = {
+        { 0.0f, 0.1f, 0.0f }, 0.05f,
+        { 0.0f, 1.0f, 0.0f }, cosf(glm::radians(25.0f)),
+        { 4.0f, 6.5f },
+        { 2.0f, 3.0f },
+    };
+    if (rate < 0.0f) {
+        rate = capacity / ((emitter.lifetime[0] + emitter.lifetime[1]) * 0.5f);
+    }
+
+    ParticleSystem particles;
+    initParticleSystem(&particles, capacity);
+    printf("%d particles, %.0f emitted per second, %s, %s blending\n", capacity, rate,
+           sort ? "depth sorted" : "not sorted", additive ? "additive" : "alpha");
+
+    // P.2. The stages are submitted one by one, so each of them gets its own GPU time.
+    GpuTimer gpuTimer;
+    initGpuTimer(&gpuTimer, argc, argv);
+    if (!gpuTimer.enabled) {
+        gpuTimerEnableQueries(&gpuTimer);
+        gpuTimer.printStats = true;
+    }
+
+    demoSwapInterval(&demo, 0);
+
+    double lastTime = demoAnimationTime(&demo);
+    double statsStartTime = demoGetTime(&demo);
+    int statsFrames = 0;
+    float emitRemainder = 0.0f;
+
+    // X. Create a render loop.
+    while (!demoShouldClose(&demo))
+    {
+        // X. Poll and handle events (inputs, window resize, etc.)
+        demoPollEvents(&demo);
+        gpuTimerBeginFrame(&gpuTimer);
+
+        // P.3. The simulation follows the frame time, long frames are clamped (ex.: at startup).
+        double time = demoAnimationTime(&demo);
+        float deltaTime = (float)(time - lastTime);
+        deltaTime = deltaTime < 1.0f / 30.0f ? deltaTime : 1.0f / 30.0f;
+        lastTime = time;
+
+        float emitCount = rate * deltaTime + emitRemainder;
+        int emitted = (int)emitCount;
+        emitRemainder = emitCount - emitted;
+
+        // P.4. The camera orbits around the fountain.
+        int display_w, display_h;
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
+        float angle = (float)time * 0.3f;
+        glm::vec3 eye(sinf(angle) * 7.0f, 2.5f, cosf(angle) * 7.0f);
+        glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)display_w / display_h, 0.1f, 100.0f);
+
+        // P.5. Emit, move, sort: each stage is a separate submit.
+        {
+            GpuTimerScope scope(&gpuTimer, "emit");
+            particleEmit(&particles, emitter, emitted);
+        }
+        {
+            GpuTimerScope scope(&gpuTimer, "simulate");
+            particleSimulate(&particles, deltaTime);
+        }
+        if (sort && !additive) {
+            GpuTimerScope scope(&gpuTimer, "sort");
+            particleSort(&particles, glm::value_ptr(eye));
+        }
+
+        // X. Clear the color image.
+        glBindFramebuffer(GL_FRAMEBUFFER, demoDefaultFramebuffer(&demo));
+        glViewport(0, 0, display_w, display_h);
+        glClearColor(0.02f, 0.02f, 0.05f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // P.6. The billboards of the alive particles, one indirect draw.
+        {
+            GpuTimerScope scope(&gpuTimer, "draw");
+            particleDraw(&particles, glm::value_ptr(view), glm::value_ptr(projection), additive);
+        }
+
+        gpuTimerDrawOverlay(&gpuTimer, 10, 10);
+        gpuTimerEndFrame(&gpuTimer);
+
+        // X. Swap the fron-back buffers to display the rendered image in the window.
+        demoSwapBuffers(&demo);
+
+        // X. Report the frame time and the alive count (reading the count back waits for the GPU).
+        statsFrames++;
+        double statsElapsed = demoGetTime(&demo) - statsStartTime;
+        if (statsElapsed >= 1.0) {
+            printf("%d alive particles: %.3f ms/frame\n", particleAliveCount(&particles),
+                   statsElapsed * 1000.0 / statsFrames);
+            statsStartTime = demoGetTime(&demo);
+            statsFrames = 0;
+        }
+    }
+
+    printf("Alive particles at exit: %d of %d\n", particleAliveCount(&particles), capacity);
+
+    destroyGpuTimer(&gpuTimer);
+    destroyParticleSystem(&particles);
+
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
+
+    return 0;
+}
@@ -0,0 +1,535 @@
+/**
+ * Benchmark of the compute primitives (see common/compute_primitives.h):
+ * reduction, exclusive scan, stream compaction and key-value radix sort on
+ * the GPU against a multithreaded CPU implementation (see common/job_system.h).
+ *
+ * For every element count (x4 steps from 1K to 64M) the GPU results are
+ * checked against the CPU results and the throughput is printed as GB/s of
+ * the input data (4 bytes per element, 8 for compaction and sorting: the
+ * values with their flags/keys). The GPU time is measured from the recording
+ * of the dispatches to the end of a glFinish, uploads and read backs are not
+ * included. The first run of every size is a warm-up run and isn't timed.
+ *
+ * Run:
+ * $ ./x_gles_compute_primitives --surfaceless
+ * $ ./x_gles_compute_primitives --surfaceless --max-size 4M --primitive sort
+ *
+ * Options (and the options of the demo context):
+ *  --min-size N      Smallest element count (default: 1K, "K"/"M" suffixes are accepted).
+ *  --max-size N      Largest element count (default: 64M).
+ *  --iterations N    Timed runs per size (default: 10).
+ *  --primitive NAME  reduce, scan, compact, sort or all (default).
+ *  --threads N       CPU threads, including the main thread (default: one per core).
+ *
+ * Dependencies:
+ *  * C++11
+ *  * Open GL ES 3.1+
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <GLES3/gl31.h>
+
+#include "common/compute.h"
+#include "common/compute_primitives.h"
+#include "common/demo_context.h"
+#include "common/job_system.h"
+
+// CPU implementation: the arrays are split into chunks, one job per chunk.
+struct CpuPrimitives {
+    JobSystem* jobs;
+    int count;
+    int chunkSize;
+    int chunkCount;
+
+    ComputeReduceOp op;
+    const unsigned int* input;
+    const unsigned int* flags;
+    const unsigned int* values;
+    unsigned int* output;
+    unsigned int* outputValues;
+    int shift;
+
+    std::vector<unsigned int> chunkResults; // per chunk totals, or 256 digit counts per chunk when sorting
+};
+
+struct Bench {
+    DemoContext* demo;
+    ComputePrimitives* prims;
+    ComputeQueue* queue;
+    CpuPrimitives* cpu;
+    int iterations;
+};
+
+static unsigned int reduceOp(ComputeReduceOp op, unsigned int a, unsigned int b) {
+    switch (op) {
+        case COMPUTE_REDUCE_MIN: return a < b ? a : b;
+        case COMPUTE_REDUCE_MAX: return a > b ? a : b;
+        default: return a + b;
+    }
+}
+
+static int chunkEnd(const CpuPrimitives* cpu, int chunk) {
+    int end = (chunk + 1) * cpu->chunkSize;
+    return end < cpu->count ? end : cpu->count;
+}
+
+static void reduceChunks(void* data, int begin, int end) {
+    CpuPrimitives* cpu = (CpuPrimitives*)data;
+    for (int chunk = begin; chunk < end; chunk++) {
+        int first = chunk * cpu->chunkSize;
+        int last = chunkEnd(cpu, chunk);
+
+        unsigned int value = cpu->input[first];
+        for (int idx = first + 1; idx < last; idx++) {
+            value = reduceOp(cpu->op, value, cpu->input[idx]);
+        }
+        cpu->chunkResults[chunk] = value;
+    }
+}
+
+static void scanChunks(void* data, int begin, int end) {
+    CpuPrimitives* cpu = (CpuPrimitives*)data;
+    for (int chunk = begin; chunk < end; chunk++) {
+        unsigned int prefix = cpu->chunkResults[chunk];
+        for (int idx = chunk * cpu->chunkSize; idx < chunkEnd(cpu, chunk); idx++) {
+            unsigned int value = cpu->input[idx];
+            cpu->output[idx] = prefix;
+            prefix += value;
+        }
+    }
+}
+
+static void countFlagChunks(void* data, int begin, int end) {
+    CpuPrimitives* cpu = (CpuPrimitives*)data;
+    for (int chunk = begin; chunk < end; chunk++) {
+        unsigned int kept = 0;
+        for (int idx = chunk * cpu->chunkSize; idx < chunkEnd(cpu, chunk); idx++) {
+            kept += cpu->flags[idx] != 0;
+        }
+        cpu->chunkResults[chunk] = kept;
+    }
+}
+
+static void compactChunks(void* data, int begin, int end) {
+    CpuPrimitives* cpu = (CpuPrimitives*)data;
+    for (int chunk = begin; chunk < end; chunk++) {
+        unsigned int offset = cpu->chunkResults[chunk];
+        for (int idx = chunk * cpu->chunkSize; idx < chunkEnd(cpu, chunk); idx++) {
+            if (cpu->flags[idx] != 0) {
+                cpu->output[offset++] = cpu->input[idx];
+            }
+        }
+    }
+}
+
+static void histogramChunks(void* data, int begin, int end) {
+    CpuPrimitives* cpu = (CpuPrimitives*)data;
+    for (int chunk = begin; chunk < end; chunk++) {
+        unsigned int* bins = &cpu->chunkResults[chunk * 256];
+        memset(bins, 0, 256 * sizeof(unsigned int));
+        for (int idx = chunk * cpu->chunkSize; idx < chunkEnd(cpu, chunk); idx++) {
+            bins[(cpu->input[idx] >> cpu->shift) & 255]++;
+        }
+    }
+}
+
+static void scatterChunks(void* data, int begin, int end) {
+    CpuPrimitives* cpu = (CpuPrimitives*)data;
+    for (int chunk = begin; chunk < end; chunk++) {
+        unsigned int* offsets = &cpu->chunkResults[chunk * 256];
+        for (int idx = chunk * cpu->chunkSize; idx < chunkEnd(cpu, chunk); idx++) {
+            unsigned int key = cpu->input[idx];
+            unsigned int offset = offsets[(key >> cpu->shift) & 255]++;
+            cpu->output[offset] = key;
+            cpu->outputValues[offset] = cpu->values[idx];
+        }
+    }
+}
+
+static void setupChunks(CpuPrimitives* cpu, int count, int resultsPerChunk) {
+    // A few chunks per thread for the work stealing, but not too small ones.
+    int chunkSize = (count + cpu->jobs->threadCount * 4 - 1) / (cpu->jobs->threadCount * 4);
+    cpu->chunkSize = chunkSize > 16384 ? chunkSize : 16384;
+    cpu->chunkCount = (count + cpu->chunkSize - 1) / cpu->chunkSize;
+    cpu->count = count;
+    cpu->chunkResults.resize(cpu->chunkCount * resultsPerChunk);
+}
+
+// Turn the chunk totals into exclusive chunk offsets, returns the total.
+static unsigned int scanChunkResults(CpuPrimitives* cpu) {
+    unsigned int total = 0;
+    for (int chunk = 0; chunk < cpu->chunkCount; chunk++) {
+        unsigned int value = cpu->chunkResults[chunk];
+        cpu->chunkResults[chunk] = total;
+        total += value;
+    }
+    return total;
+}
+
+static unsigned int cpuReduce(CpuPrimitives* cpu, ComputeReduceOp op, const unsigned int* input, int count) {
+    setupChunks(cpu, count, 1);
+    cpu->op = op;
+    cpu->input = input;
+    jobSystemParallelFor(cpu->jobs, cpu->chunkCount, 1, reduceChunks, cpu);
+
+    unsigned int value = cpu->chunkResults[0];
+    for (int chunk = 1; chunk < cpu->chunkCount; chunk++) {
+        value = reduceOp(op, value, cpu->chunkResults[chunk]);
+    }
+    return value;
+}
+
+static void cpuExclusiveScan(CpuPrimitives* cpu, const unsigned int* input, unsigned int* output, int count) {
+    setupChunks(cpu, count, 1);
+    cpu->op = COMPUTE_REDUCE_SUM;
+    cpu->input = input;
+    cpu->output = output;
+    jobSystemParallelFor(cpu->jobs, cpu->chunkCount, 1, reduceChunks, cpu);
+    scanChunkResults(cpu);
+    jobSystemParallelFor(cpu->jobs, cpu->chunkCount, 1, scanChunks, cpu);
+}
+
+static unsigned int cpuCompact(CpuPrimitives* cpu, const unsigned int* values, const unsigned int* flags, int count,
+                               unsigned int* output) {
+    setupChunks(cpu, count, 1);
+    cpu->input = values;
+    cpu->flags = flags;
+    cpu->output = output;
+    jobSystemParallelFor(cpu->jobs, cpu->chunkCount, 1, countFlagChunks, cpu);
+    unsigned int kept = scanChunkResults(cpu);
+    jobSystemParallelFor(cpu->jobs, cpu->chunkCount, 1, compactChunks, cpu);
+    return kept;
+}
+
+// LSD radix sort with 8 bit digits: 4 passes, so the result ends up in keys/values.
+static void cpuRadixSort(CpuPrimitives* cpu, unsigned int* keys, unsigned int* values, int count,
+                         unsigned int* tmpKeys, unsigned int* tmpValues) {
+    setupChunks(cpu, count, 256);
+
+    for (int shift = 0; shift < 32; shift += 8) {
+        cpu->shift = shift;
+        cpu->input = keys;
+        cpu->values = values;
+        cpu->output = tmpKeys;
+        cpu->outputValues = tmpValues;
+        jobSystemParallelFor(cpu->jobs, cpu->chunkCount, 1, histogramChunks, cpu);
+
+        // Digit major offsets: every chunk writes after the same digits of the previous chunks (stable).
+        unsigned int offset = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            for (int chunk = 0; chunk < cpu->chunkCount; chunk++) {
+                unsigned int digitCount = cpu->chunkResults[chunk * 256 + digit];
+                cpu->chunkResults[chunk * 256 + digit] = offset;
+                offset += digitCount;
+            }
+        }
+        jobSystemParallelFor(cpu->jobs, cpu->chunkCount, 1, scatterChunks, cpu);
+
+        unsigned int* swap = keys;
+        keys = tmpKeys;
+        tmpKeys = swap;
+        swap = values;
+        values = tmpValues;
+        tmpValues = swap;
+    }
+}
+
+// Wait for the GPU, then start the clock.
+static double gpuBegin(Bench* bench) {
+    glFinish();
+    return demoGetTime(bench->demo);
+}
+
+// Submit the recorded primitives and wait for them, returns the elapsed milliseconds.
+static double gpuEnd(Bench* bench, double start) {
+    computeQueueBarrier(bench->queue, GL_BUFFER_UPDATE_BARRIER_BIT);
+    computeQueueSubmit(bench->queue);
+    glFinish();
+    return (demoGetTime(bench->demo) - start) * 1000.0;
+}
+
+static int parseCount(const char* text) {
+    char* end;
+    long value = strtol(text, &end, 10);
+    if (*end == 'K' || *end == 'k') {
+        value *= 1024;
+    } else if (*end == 'M' || *end == 'm') {
+        value *= 1024 * 1024;
+    }
+    return (int)value;
+}
+
+static void printResult(const char* name, int count, double bytes, double gpuMs, double cpuMs, bool match) {
+    char countText[32];
+    if (count >= 1024 * 1024 && count % (1024 * 1024) == 0) {
+        snprintf(countText, sizeof(countText), "%dM", count / (1024 * 1024));
+    } else if (count >= 1024 && count % 1024 == 0) {
+        snprintf(countText, sizeof(countText), "%dK", count / 1024);
+    } else {
+        snprintf(countText, sizeof(countText), "%d", count);
+    }
+
+    printf("%-10s %5s: GPU %9.3f ms %7.2f GB/s | CPU %9.3f ms %7.2f GB/s | %s\n", name, countText,
+           gpuMs, bytes / (gpuMs * 1e6), cpuMs, bytes / (cpuMs * 1e6), match ? "ok" : "MISMATCH");
+}
+
+static void benchReduce(Bench* bench, ComputeReduceOp op, const char* name,
+                        const StorageBuffer<unsigned int>& input, const std::vector<unsigned int>& cpuInput,
+                        const StorageBuffer<unsigned int>& result) {
+    int count = (int)cpuInput.size();
+    double gpuMs = 0.0;
+    double cpuMs = 0.0;
+    unsigned int cpuValue = 0;
+    unsigned int gpuValue = 0;
+
+    for (int run = 0; run <= bench->iterations; run++) {
+        double start = gpuBegin(bench);
+        computeReduce(bench->prims, bench->queue, op, input, count, result);
+        double elapsed = gpuEnd(bench, start);
+
+        start = demoGetTime(bench->demo);
+        cpuValue = cpuReduce(bench->cpu, op, cpuInput.data(), count);
+        if (run > 0) {
+            gpuMs += elapsed;
+            cpuMs += (demoGetTime(bench->demo) - start) * 1000.0;
+        }
+    }
+
+    readStorageBuffer(result, 0, 1, &gpuValue);
+    printResult(name, count, count * 4.0, gpuMs / bench->iterations, cpuMs / bench->iterations, gpuValue == cpuValue);
+}
+
+static void benchScan(Bench* bench, const StorageBuffer<unsigned int>& input, const std::vector<unsigned int>& cpuInput,
+                      const StorageBuffer<unsigned int>& output) {
+    int count = (int)cpuInput.size();
+    std::vector<unsigned int> cpuOutput(count);
+    std::vector<unsigned int> gpuOutput(count);
+    double gpuMs = 0.0;
+    double cpuMs = 0.0;
+
+    for (int run = 0; run <= bench->iterations; run++) {
+        double start = gpuBegin(bench);
+        computeExclusiveScan(bench->prims, bench->queue, input, output, count);
+        double elapsed = gpuEnd(bench, start);
+
+        start = demoGetTime(bench->demo);
+        cpuExclusiveScan(bench->cpu, cpuInput.data(), cpuOutput.data(), count);
+        if (run > 0) {
+            gpuMs += elapsed;
+            cpuMs += (demoGetTime(bench->demo) - start) * 1000.0;
+        }
+    }
+
+    readStorageBuffer(output, 0, count, gpuOutput.data());
+    printResult("scan", count, count * 4.0, gpuMs / bench->iterations, cpuMs / bench->iterations,
+                gpuOutput == cpuOutput);
+}
+
+static void benchCompact(Bench* bench, const StorageBuffer<unsigned int>& values, const std::vector<unsigned int>& cpuValues,
+                         const StorageBuffer<unsigned int>& flags, const std::vector<unsigned int>& cpuFlags,
+                         const StorageBuffer<unsigned int>& output, const StorageBuffer<unsigned int>& keptCount) {
+    int count = (int)cpuValues.size();
+    std::vector<unsigned int> cpuOutput(count);
+    unsigned int cpuKept = 0;
+    double gpuMs = 0.0;
+    double cpuMs = 0.0;
+
+    for (int run = 0; run <= bench->iterations; run++) {
+        double start = gpuBegin(bench);
+        computeCompact(bench->prims, bench->queue, values, flags, count, output, keptCount);
+        double elapsed = gpuEnd(bench, start);
+
+        start = demoGetTime(bench->demo);
+        cpuKept = cpuCompact(bench->cpu, cpuValues.data(), cpuFlags.data(), count, cpuOutput.data());
+        if (run > 0) {
+            gpuMs += elapsed;
+            cpuMs += (demoGetTime(bench->demo) - start) * 1000.0;
+        }
+    }
+
+    unsigned int gpuKept = 0;
+    readStorageBuffer(keptCount, 0, 1, &gpuKept);
+    bool match = gpuKept == cpuKept;
+    if (match && gpuKept > 0) {
+        std::vector<unsigned int> gpuOutput(gpuKept);
+        readStorageBuffer(output, 0, gpuKept, gpuOutput.data());
+        match = memcmp(gpuOutput.data(), cpuOutput.data(), gpuKept * sizeof(unsigned int)) == 0;
+    }
+    printResult("compact", count, count * 8.0, gpuMs / bench->iterations, cpuMs / bench->iterations, match);
+}
+
+static void benchSort(Bench* bench, const std::vector<unsigned int>& input) {
+    int count = (int)input.size();
+
+    // The values are the original indices of the keys.
+    std::vector<unsigned int> indices(count);
+    for (int idx = 0; idx < count; idx++) {
+        indices[idx] = idx;
+    }
+    StorageBuffer<unsigned int> keys = createStorageBuffer<unsigned int>(count);
+    StorageBuffer<unsigned int> values = createStorageBuffer<unsigned int>(count);
+
+    std::vector<unsigned int> cpuKeys(count);
+    std::vector<unsigned int> cpuValues(count);
+    std::vector<unsigned int> tmpKeys(count);
+    std::vector<unsigned int> tmpValues(count);
+    double gpuMs = 0.0;
+    double cpuMs = 0.0;
+
+    for (int run = 0; run <= bench->iterations; run++) {
+        // Every run sorts the unsorted input.
+        writeStorageBuffer(keys, 0, count, input.data());
+        writeStorageBuffer(values, 0, count, indices.data());
+        cpuKeys = input;
+        cpuValues = indices;
+
+        double start = gpuBegin(bench);
+        computeRadixSort(bench->prims, bench->queue, keys, values, count);
+        double elapsed = gpuEnd(bench, start);
+
+        start = demoGetTime(bench->demo);
+        cpuRadixSort(bench->cpu, cpuKeys.data(), cpuValues.data(), count, tmpKeys.data(), tmpValues.data());
+        if (run > 0) {
+            gpuMs += elapsed;
+            cpuMs += (demoGetTime(bench->demo) - start) * 1000.0;
+        }
+    }
+
+    // Both sorts are stable: the results must be identical.
+    std::vector<unsigned int> gpuKeys(count);
+    std::vector<unsigned int> gpuValues(count);
+    readStorageBuffer(keys, 0, count, gpuKeys.data());
+    readStorageBuffer(values, 0, count, gpuValues.data());
+    printResult("sort", count, count * 8.0, gpuMs / bench->iterations, cpuMs / bench->iterations,
+                gpuKeys == cpuKeys && gpuValues == cpuValues);
+
+    destroyStorageBuffer(&keys);
+    destroyStorageBuffer(&values);
+}
+
+int main(int argc, char **argv) {
+    // 0-4. Create the window (or the headless offscreen context), nothing is rendered.
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
+    demo.frameLimit = 0;
+
+    // 5. Parse the benchmark options.
+    int minSize = 1024;
+    int maxSize = 64 * 1024 * 1024;
+    int iterations = 10;
+    int threadCount = 0;
+    const char* primitive = "all";
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--min-size") == 0 && idx + 1 < argc) {
+            minSize = parseCount(argv[++idx]);
+        } else if (strcmp(argv[idx], "--max-size") == 0 && idx + 1 < argc) {
+            maxSize = parseCount(argv[++idx]);
+        } else if (strcmp(argv[idx], "--iterations") == 0 && idx + 1 < argc) {
+            iterations = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--primitive") == 0 && idx + 1 < argc) {
+            primitive = argv[++idx];
+        } else if (strcmp(argv[idx], "--threads") == 0 && idx + 1 < argc) {
+            threadCount = atoi(argv[++idx]);
+        }
+    }
+    minSize = minSize > 1 ? minSize : 1;
+    iterations = iterations > 0 ? iterations : 1;
+    bool runAll = strcmp(primitive, "all") == 0;
+
+    // 6. Build the kernels and start the CPU threads.
+    ComputePrimitives prims;
+    initComputePrimitives(&prims);
+
+    ComputeQueue queue;
+    initComputeQueue(&queue);
+
+    JobSystem jobs;
+    initJobSystem(&jobs, threadCount);
+    CpuPrimitives cpu;
+    cpu.jobs = &jobs;
+
+    Bench bench = { &demo, &prims, &queue, &cpu, iterations };
+
+    printf("Compute primitives: %s, %d elements per work group | CPU: %d threads\n",
+           (const char*)glGetString(GL_RENDERER), prims.tileSize, jobs.threadCount);
+
+    // 7. Run the primitives for every size.
+    for (int count = minSize; count > 0 && count <= maxSize; count *= 4) {
+        // 7.1. Random values (xorshift), half of the flags are set.
+        std::vector<unsigned int> input(count);
+        std::vector<unsigned int> flags(count);
+        unsigned int seed = 0x12345678u;
+        for (int idx = 0; idx < count; idx++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            input[idx] = seed;
+            flags[idx] = (seed >> 7) & 1;
+        }
+
+        // 7.2. Upload the inputs, the scratch buffers grow with the sizes.
+        computePrimitivesReserve(&prims, count);
+        StorageBuffer<unsigned int> gpuInput = createStorageBuffer<unsigned int>(count, input.data());
+        StorageBuffer<unsigned int> gpuFlags = createStorageBuffer<unsigned int>(count, flags.data());
+        StorageBuffer<unsigned int> gpuOutput = createStorageBuffer<unsigned int>(count);
+        StorageBuffer<unsigned int> gpuResult = createStorageBuffer<unsigned int>(1);
+
+        // 7.3. Run the selected primitives.
+        if (runAll || strcmp(primitive, "reduce") == 0) {
+            benchReduce(&bench, COMPUTE_REDUCE_SUM, "reduce-sum", gpuInput, input, gpuResult);
+            benchReduce(&bench, COMPUTE_REDUCE_MIN, "reduce-min", gpuInput, input, gpuResult);
+            benchReduce(&bench, COMPUTE_REDUCE_MAX, "reduce-max", gpuInput, input, gpuResult);
+        }
+        if (runAll || strcmp(primitive, "scan") == 0) {
+            benchScan(&bench, gpuInput, input, gpuOutput);
+        }
+        if (runAll || strcmp(primitive, "compact") == 0) {
+            benchCompact(&bench, gpuInput, input, gpuFlags, flags, gpuOutput, gpuResult);
+        }
+        if (runAll || strcmp(primitive, "sort") == 0) {
+            benchSort(&bench, input);
+        }
+
+        // XX. Delete the buffers of the size.
+        destroyStorageBuffer(&gpuInput);
+        destroyStorageBuffer(&gpuFlags);
+        destroyStorageBuffer(&gpuOutput);
+        destroyStorageBuffer(&gpuResult);
+    }
+
+    // XX. Stop the CPU threads and destroy the kernels.
+    destroyJobSystem(&jobs);
+    destroyComputePrimitives(&prims);
+
+    destroyDemoContext(&demo);
+
+    return 0;
+}
@@ -1,8 +1,12 @@
 /**
- * Single file OpenGL ES compute shader example minimal "helper" methods.
+ * OpenGL ES compute shader example without a window (EGL only) using the
+ * compute runtime of the common library (see common/compute.h): two kernels
+ * over a std430 storage buffer, recorded into a queue and submitted at once.
+ * The results of every batch are read back asynchronously (see
+ * common/compute_readback.h): several copies are in flight, the CPU polls
+ * for the first one and only waits for the rest at the end.
  *
- * Compile with shaderc:
- * $ g++ x_gles_compute_pure.cpp -o x_gles_compute_pure -lEGL -lGLESv2
+ * Built by the CMake project (links the gles_common library).
  *
  * Run:
  * $ ./x_gles_compute_pure
@@ -35,7 +39,6 @@
  */
 #include <stdio.h>
 
-#include <fstream>
 #include <vector>
 
 #include <EGL/egl.h>
@@ -44,29 +47,50 @@
 #include <GLES3/gl32.h>
 #include <GLES3/gl3ext.h>
 
+#include "common/compute.h"
+#include "common/compute_readback.h"
+#include "common/gl_debug.h"
+
 // From the EGL_KHR_create_context extension:
 #ifndef EGL_OPENGL_ES3_BIT_KHR
 #define EGL_OPENGL_ES3_BIT_KHR 0x0040
 #endif
 
-const char* compute_src = R"(#version 310 es
-
-layout (local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
+// The local size, uGridSize, uParams and GLOBAL_INDEX are inserted by the compute runtime.
+const char* fill_src = R"(#version 310 es
 
-layout(std140, binding=0) buffer wBuffer {
-    ivec2 values[10];
+layout(std430, binding=0) buffer wBuffer {
+    ivec2 values[];
 } data;
 
 void main() {
-    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
-    data.values[pos.x] = ivec2(1000 + pos.x, 2000 + pos.x);
+    int idx = GLOBAL_INDEX;
+    if (idx >= uGridSize.x) {
+        return;
+    }
+    data.values[idx] = ivec2(1000 + idx, 2000 + idx);
 }
 )";
 
-static void on_gl_error(GLenum source, GLenum type, GLuint id, GLenum severity,
-                          GLsizei length, const GLchar* message, const void *userParam) {
-    printf("-> %s\n", message);
+const char* scale_src = R"(#version 310 es
+
+layout(std430, binding=0) buffer wBuffer {
+    ivec2 values[];
+} data;
+
+void main() {
+    int idx = GLOBAL_INDEX;
+    if (idx >= uGridSize.x) {
+        return;
+    }
+    data.values[idx] *= uParams.x;
 }
+)";
+
+struct IVec2 {
+    int x;
+    int y;
+};
 
 int main(int argc, char **argv) {
 
@@ -147,106 +171,89 @@ int main(int argc, char **argv) {
     }
 
     // X. Extra: add a debug callback to have info on GL/ES errors.
-    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-    glDebugMessageCallback(on_gl_error, NULL);
-
-    // . Create the vertex shader.
-    unsigned int compute_shader;
-    {
-        // .1. Create a compute shader object.
-        compute_shader = glCreateShader(GL_COMPUTE_SHADER);
-
-        // .2. Specify the shader source.
-        glShaderSource(compute_shader, 1, &compute_src, NULL);
-
-        // .3. Compile the shader.
-        glCompileShader(compute_shader);
-
-        // .4. Check if there is any error during compilation.
-        int success;
-        glGetShaderiv(compute_shader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            char info[512];
-            glGetShaderInfoLog(compute_shader, 512, NULL, info);
-            printf("Compute shader error:\n%s\n", info);
-            return -3;
-        }
+    enableGLDebugOutput(true);
+
+    // 8. Build the kernels.
+    /* The runtime selects the local size, the kernels skip the invocations outside of uGridSize. */
+    ComputeKernel fillKernel;
+    ComputeKernel scaleKernel;
+    createComputeKernel(&fillKernel, fill_src, 1);
+    createComputeKernel(&scaleKernel, scale_src, 1);
+
+    // 9. Upload the initial buffer data.
+    /* std430: the ivec2 elements are tightly packed, no std140 padding is needed. */
+    const int itemCount = 10;
+    std::vector<IVec2> input(itemCount);
+    for (int idx = 0; idx < itemCount; idx++) {
+        input[idx].x = idx + 1;
+        input[idx].y = idx + 1;
     }
+    StorageBuffer<IVec2> values = createStorageBuffer<IVec2>(itemCount, input.data());
 
-    // . Create a shader program and attach the compute shader.
-    unsigned int compute_program;
-    {
-        compute_program = glCreateProgram();
-        glAttachShader(compute_program, compute_shader);
-        glLinkProgram(compute_program);
-
-        int success;
-        glGetProgramiv(compute_program, GL_LINK_STATUS, &success);
-        if(!success) {
-            char info[512];
-            glGetProgramInfoLog(compute_program, 512, NULL, info);
-            printf("Program error:\n%s\n", info);
-            return -3;
-        }
-    }
-
-    // . The compute shader can be removed after linking.
-    {
-        glDeleteShader(compute_shader);
-    }
+    // 10. Run a few batches into the same buffer: fill the values, then scale them by the batch's factor.
+    /* Every batch is followed by a read back request: the copy is a snapshot, so the next batch
+     * can overwrite the buffer while the earlier results are still in flight. */
+    ComputeReadbacks readbacks;
+    initComputeReadbacks(&readbacks);
 
-    // . Upload the initial buffer data.
-    int itemCount = 10 * (2 + 2); // ivec2 + (2 * int padding)
-    size_t calcBufferSize = itemCount * sizeof(int); // ivec2 * 10 in std140 layout
-    unsigned int calcBufferId;
+    const int batchCount = 3;
+    int requests[batchCount];
     {
-        glGenBuffers(1, &calcBufferId);
-        glBindBuffer(GL_ARRAY_BUFFER, calcBufferId);
-        glBufferData(GL_ARRAY_BUFFER, calcBufferSize, NULL, GL_STATIC_DRAW);
-        {
-            // . Map the buffer to CPU so a simple copy/assignment can "upload" the data to GPU.
-            void *dataPtr = glMapBufferRange(GL_ARRAY_BUFFER, 0, calcBufferSize, GL_MAP_WRITE_BIT); //| GL_MAP_FLUSH_EXPLICIT_BIT);
-            int *inputPtr = (int*)dataPtr;
-            // Generate the input data.
-            /* The input data is: 1, 2, 3, 4, ....   */
-            for (int idx = 0; idx < itemCount; idx++) {
-                inputPtr[idx] = idx + 1;
-            }
-
-            //glFlushMappedBufferRange(GL_ARRAY_BUFFER, 0, calcBufferSize);
-            glUnmapBuffer(GL_ARRAY_BUFFER);
-            }
+        ComputeQueue queue;
+        initComputeQueue(&queue);
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-    }
+        for (int batch = 0; batch < batchCount; batch++) {
+            computeQueueAdd(&queue, &fillKernel, itemCount, 1, 1);
+            computeQueueBind(&queue, 0, values.buffer);
 
+            computeQueueBarrier(&queue, GL_SHADER_STORAGE_BARRIER_BIT);
+            computeQueueAdd(&queue, &scaleKernel, itemCount, 1, 1);
+            computeQueueBind(&queue, 0, values.buffer);
+            computeQueueParams(&queue, batch + 1);
+            computeQueueSubmit(&queue);
 
-    {
-        glUseProgram(compute_program);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, calcBufferId);
+            // 10.1. Snapshot the results, the request inserts the barrier and the fence.
+            requests[batch] = computeReadbackRequest(&readbacks, values, 0, itemCount);
 
-        glDispatchCompute(10, 1, 1);
+            printf("Batch %d: %d program changes, %d buffer bindings, %d barriers\n",
+                   batch, queue.programChanges, queue.bufferBindings, queue.barriers);
 
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
-        glUseProgram(0);
+            // 10.2. The next fill overwrites the values of this batch (the copy is ordered by GL itself).
+            computeQueueBarrier(&queue, GL_SHADER_STORAGE_BARRIER_BIT);
+        }
     }
 
+    // 11. Poll the results while doing "other work", then wait for the rest.
     {
-        glBindBuffer(GL_ARRAY_BUFFER, calcBufferId);
-        {
-            void *dataPtr = glMapBufferRange(GL_ARRAY_BUFFER, 0, calcBufferSize, GL_MAP_READ_BIT);
-            int *readPtr = (int*)dataPtr;
+        int polls = 0;
+        int ready = 0;
+        while (ready == 0 && polls < 1000) {
+            ready = computeReadbackPoll(&readbacks, requests[0]) != NULL;
+            polls++;
+        }
+        printf("Read backs (%s mapping): first result after %d polls, %d in flight\n",
+               readbacks.persistent ? "persistent" : "on demand", polls, computeReadbacksInFlight(&readbacks));
+
+        for (int batch = 0; batch < batchCount; batch++) {
+            const IVec2* result = (const IVec2*)computeReadbackWait(&readbacks, requests[batch]);
+            printf("Batch %d:\n", batch);
             for (int idx = 0; idx < itemCount; idx++) {
-                printf("-> pos: %2d => %2d\n", idx + 1, readPtr[idx]);
+                printf("-> pos: %2d => %4d %4d\n", idx, result[idx].x, result[idx].y);
             }
-            glUnmapBuffer(GL_ARRAY_BUFFER);
+            computeReadbackRelease(&readbacks, requests[batch]);
         }
-
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        printf("Read back waits which stalled: %d\n", readbacks.stalls);
     }
 
-    // XX. Destroy the compute program.
-    glDeleteProgram(compute_program);
+    // XX. Destroy the read back buffers.
+    destroyComputeReadbacks(&readbacks);
+
+    // XX. Destroy the storage buffer.
+    destroyStorageBuffer(&values);
+
+    // XX. Destroy the kernels.
+    destroyComputeKernel(&fillKernel);
+    destroyComputeKernel(&scaleKernel);
 
     // XX. Terminate EGL resources.
     eglTerminate(display);
@@ -36,13 +36,17 @@
  */
 #include <stdio.h>
 
-#include <GLFW/glfw3.h>
+#include <string>
+
 #include <GLES3/gl31.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "common/compute.h"
+#include "common/demo_context.h"
+
 const char* vertex_src = R"(#version 310 es
 precision highp float;
 
@@ -69,12 +73,13 @@ void main() {
 )";
 
 
+// LOCAL_SIZE and VERTEX_COUNT are inserted as defines (see computeSpecializeSource), no size is hard-coded.
 const char* compute_src = R"(#version 310 es
 
-layout (local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
+layout (local_size_x = LOCAL_SIZE, local_size_y = 1, local_size_z = 1) in;
 
 layout(std140, binding=0) buffer destBuffer {
-  vec4 data[3];
+  vec4 data[VERTEX_COUNT];
 } outVertices;
 
 vec2 vertices[3] = vec2[](
@@ -85,44 +90,31 @@ vec2 vertices[3] = vec2[](
 
 void main() {
     ivec2 runPos = ivec2(gl_GlobalInvocationID.xy);
+    if (runPos.x >= VERTEX_COUNT) {
+        return;
+    }
 
-    outVertices.data[runPos.x] = vec4(vertices[runPos.x], 0.0f, 0.0f);
+    outVertices.data[runPos.x] = vec4(vertices[runPos.x % 3], 0.0f, 0.0f);
 }
 )";
 
-static void ErrorCallbackGLFW(int error, const char* description) {
-    printf("Glfw Error %d: %s\n", error, description);
-}
+static const int vertexCount = 3;
+static const int localSize = 64;
 
 int main(int argc, char **argv) {
-    // 0. Add a method to report any GLFW errors.
-    glfwSetErrorCallback(ErrorCallbackGLFW);
-
-    // 1. Initialize the GLFW library.
-    if (!glfwInit()) {
-        return -1;
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    /* See the "01_gles_glfw" example for the GLFW steps. This also handles the
+     * "--headless" and "--frames N" command line options. */
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
     }
 
-    // 2. Add hints to use during context creation when a GLFW window is created.
-    // Here: require a GL ES 3.0 context.
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
-    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
-
-    // 3. Create window with graphics context
-    GLFWwindow* window = glfwCreateWindow(1024, 600, "GLDEMO", NULL, NULL);
-    if (window == NULL) {
-        return -2;
-    }
-
-    // 4. Activate the window (display it).
-    glfwMakeContextCurrent(window);
-
     // 5. Set the view port to match the window size.
     {
         int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
         glViewport(0, 0, display_w, display_h);
     }
 
@@ -196,11 +188,17 @@ int main(int argc, char **argv) {
         glDeleteShader(fragment_shader);
     }
 
-    // C.1. Create the Compute shader
+    // C.1. Create the Compute shader specialized for the work group size and the vertex count.
     unsigned int compute_shader;
     {
+        ComputeDefines defines;
+        computeDefine(&defines, "LOCAL_SIZE", localSize);
+        computeDefine(&defines, "VERTEX_COUNT", vertexCount);
+        std::string computeSrc = computeSpecializeSource(compute_src, &defines);
+        const char* computeSrcPtr = computeSrc.c_str();
+
         compute_shader = glCreateShader(GL_COMPUTE_SHADER);
-        glShaderSource(compute_shader, 1, &compute_src, NULL);
+        glShaderSource(compute_shader, 1, &computeSrcPtr, NULL);
         glCompileShader(compute_shader);
         int success;
         glGetShaderiv(compute_shader, GL_COMPILE_STATUS, &success);
@@ -238,8 +236,8 @@ int main(int argc, char **argv) {
         // V.1.2. Bind the VBO to the "GL_ARRAY_BUFFER".
         glBindBuffer(GL_ARRAY_BUFFER, vertices_vbo);
 
-        // V.1.3. Allocate a size for 3 vec4.
-        glBufferData(GL_ARRAY_BUFFER, 3 * 4 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+        // V.1.3. Allocate a size for the vec4 of every vertex.
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * 4 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
 
         // V.1.4. Unbind the "GL_ARRAY_BUFFER".
         glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -280,7 +278,7 @@ int main(int argc, char **argv) {
         int outVerticesLoc = 0;
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, outVerticesLoc, vertices_vbo);
 
-        glDispatchCompute(3, 1, 1);
+        glDispatchCompute((vertexCount + localSize - 1) / localSize, 1, 1);
 
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, outVerticesLoc, 0);
         glUseProgram(0);
@@ -292,10 +290,10 @@ int main(int argc, char **argv) {
 
     static float color = 0;
     // X. Create a render loop.
-    while (!glfwWindowShouldClose(window))
+    while (!demoShouldClose(&demo))
     {
         // X. Poll and handle events (inputs, window resize, etc.)
-        glfwPollEvents();
+        demoPollEvents(&demo);
 
         // X. Clear the color image.
         glClearColor(0.0, 0.3, 0.3, 1.0f);
@@ -310,7 +308,7 @@ int main(int argc, char **argv) {
         // XX. Update the transformation matrix.
         {
             glm::mat4 transform = glm::mat4(1.0f);
-            //transform = glm::rotate(transform, (float)glfwGetTime() / 10.f, glm::vec3(0.0f, 0.0f, 1.0f));
+            //transform = glm::rotate(transform, (float)demoGetTime(&demo) / 10.f, glm::vec3(0.0f, 0.0f, 1.0f));
             //transform = glm::scale(transform, glm::vec3(0.5, 0.5, 0.5));
             glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(transform));
         }
@@ -321,16 +319,14 @@ int main(int argc, char **argv) {
         //if (color > 1.0) { color = 0.0; }
 
         // X. Draw the triangles.
-        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glDrawArrays(GL_TRIANGLES, 0, vertexCount);
 
         // X. Swap the fron-back buffers to display the rendered image in the window.
-        glfwSwapBuffers(window);
+        demoSwapBuffers(&demo);
     }
 
-    // XX. Destroy the window.
-    glfwDestroyWindow(window);
-    // XX. Destroy the GLFW.
-    glfwTerminate();
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
 
     return 0;
 }
@@ -0,0 +1,367 @@
+/**
+ * The triangle simulation of "x_gles_compute_collision" with transform
+ * feedback instead of a compute shader, for OpenGL ES 3.0 devices.
+ *
+ * The update pass draws one point per triangle with GL_RASTERIZER_DISCARD:
+ * the vertex shader reads the 3 vertices of its triangle (3 vec4 attributes
+ * of one 48 byte vertex of the state buffer), moves them and bounces them at
+ * the edges, and writes the 3 new vec4 values as transform feedback outputs
+ * into the other buffer of a ping-pong pair. The state layout is the one of
+ * the compute demo (1st vertex zw: direction, 2nd vertex zw: speed), so the
+ * written buffer is drawn as GL_TRIANGLES right after the update. A buffer
+ * can't be the transform feedback output and a vertex input at the same
+ * time: unlike the compute demo there is no in-place mode.
+ *
+ * Run with N triangles, the frame time and the simulated triangles per
+ * second are printed every second (same format as the compute demo):
+ * $ ./x_gles_feedback_collision --triangles 1000000
+ * $ ./x_gles_compute_collision --triangles 1000000 --ping-pong
+ *
+ * Options:
+ *  --triangles N   Simulated triangles (default: the single triangle of the compute demo).
+ *  --zoom S        Scale of the view.
+ *  --gpu-timer     Print the GPU time of the update and the draw (see common/gpu_timer.h).
+ *
+ * Dependencies:
+ *  * C++11
+ *  * GLFW 3.0+
+ *  * Open GL ES 3.0+
+ *  * EGL
+ *  * GLM
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <GLES3/gl3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "common/demo_context.h"
+#include "common/gpu_timer.h"
+#include "common/program_cache.h"
+
+const char* vertex_src = R"(#version 300 es
+precision highp float;
+
+in vec4 aPos;
+
+uniform mat4 transform;
+
+void main() {
+    gl_Position = transform * vec4(aPos.xy, 0.0, 1.0);
+}
+)";
+
+const char* fragment_src = R"(#version 300 es
+precision highp float;
+
+out vec4 outColor;
+
+uniform vec3 uColor;
+
+void main() {
+    outColor = vec4(uColor, 1.0f);
+}
+)";
+
+// One invocation moves one triangle, the same steps as the compute shader of "x_gles_compute_collision".
+const char* update_vertex_src = R"(#version 300 es
+precision highp float;
+
+in vec4 aVertex0; // zw: direction
+in vec4 aVertex1; // zw: speed
+in vec4 aVertex2;
+
+out vec4 outVertex0;
+out vec4 outVertex1;
+out vec4 outVertex2;
+
+void main() {
+    // direction should be 1.0 or -1.0
+    vec2 direction = clamp(aVertex0.zw, -1.0f, 1.0f);
+    vec2 speed = clamp(aVertex1.zw, 0.0001f, 0.3f);
+
+    bool haveEdge = false;
+    bvec2 foundCollision = bvec2(false, false);
+    vec2 positions[3] = vec2[3](aVertex0.xy, aVertex1.xy, aVertex2.xy);
+    for (int vIdx = 0; vIdx < 3; vIdx++) {
+        positions[vIdx] += speed * direction;
+
+        bvec2 collision = greaterThan(abs(positions[vIdx]) - abs(direction), vec2(0.0f));
+        if (any(collision)) {
+            haveEdge = true;
+            foundCollision = collision;
+        }
+    }
+
+    if (haveEdge) {
+        vec2 invertDirection = direction * vec2(-1.0f) * vec2(foundCollision);
+        vec2 unchangedDirection = direction * vec2(not(foundCollision));
+        direction = unchangedDirection + invertDirection;
+    }
+
+    outVertex0 = vec4(positions[0], direction);
+    outVertex1 = vec4(positions[1], speed);
+    outVertex2 = vec4(positions[2], 0.0f, 0.0f);
+    gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+}
+)";
+
+// The rasterizer is disabled during the update, but a program needs a fragment shader.
+const char* update_fragment_src = R"(#version 300 es
+precision mediump float;
+
+out vec4 outColor;
+
+void main() {
+    outColor = vec4(0.0);
+}
+)";
+
+static float randomRange(float min, float max) {
+    return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+int main(int argc, char **argv) {
+    int triangleCount = 1;
+    float zoom = 1.0f;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--triangles") == 0 && idx + 1 < argc) {
+            triangleCount = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--zoom") == 0 && idx + 1 < argc) {
+            zoom = (float)atof(argv[++idx]);
+        }
+    }
+
+    if (triangleCount < 1) {
+        printf("Invalid triangle count: %d\n", triangleCount);
+        return -1;
+    }
+
+    if (zoom <= 0.0f) {
+        printf("Invalid zoom: %f\n", zoom);
+        return -1;
+    }
+
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
+
+    // 4.1. In the batched mode do not wait for vsync, the frame time should show the simulation cost.
+    if (triangleCount > 1) {
+        demoSwapInterval(&demo, 0);
+    }
+
+    // 5. Set the view port to match the window size.
+    {
+        int display_w, display_h;
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
+        glViewport(0, 0, display_w, display_h);
+    }
+
+    // 6. Create the shader programs, the update program captures its three outputs.
+    unsigned int shader_program = createCachedProgram(vertex_src, fragment_src);
+    const char* varyings[] = { "outVertex0", "outVertex1", "outVertex2" };
+    unsigned int update_program = createCachedFeedbackProgram(update_vertex_src, update_fragment_src, varyings, 3);
+
+    // F.1. The initial state, generated as in the compute demo.
+    /* Each triangle is 3 vec4 values: the 1st vertex's zw stores the direction,
+     * the 2nd vertex's zw stores the speed. */
+    std::vector<float> vertices = {
+        -0.5f, 0.5f, 1.0f, 1.0f,
+        0.5f, 0.5f, 0.005f, 0.01f,
+        0.0f, -0.5f, 0.0f, 0.0f,
+    };
+
+    if (triangleCount > 1) {
+        vertices.resize(triangleCount * 3 * 4);
+
+        srand(42);
+        for (int idx = 0; idx < triangleCount; idx++) {
+            float *triangle = &vertices[idx * 3 * 4];
+
+            float centerX = randomRange(-0.9f, 0.9f);
+            float centerY = randomRange(-0.9f, 0.9f);
+            float size = 0.02f;
+
+            // positions
+            triangle[0] = centerX - size; triangle[1] = centerY + size;
+            triangle[4] = centerX + size; triangle[5] = centerY + size;
+            triangle[8] = centerX;        triangle[9] = centerY - size;
+
+            // direction
+            triangle[2] = (rand() % 2) ? 1.0f : -1.0f;
+            triangle[3] = (rand() % 2) ? 1.0f : -1.0f;
+
+            // speed
+            triangle[6] = randomRange(0.001f, 0.01f);
+            triangle[7] = randomRange(0.001f, 0.01f);
+
+            triangle[10] = 0.0f; triangle[11] = 0.0f;
+        }
+    }
+
+    // F.2. The ping-pong buffers: one is read by the update, the other is captured.
+    /* Each buffer has two VAOs: the update reads a triangle per vertex, the draw a vec4 per vertex. */
+    unsigned int vertices_vbo[2];
+    unsigned int update_vao[2];
+    unsigned int draw_vao[2];
+    glGenBuffers(2, vertices_vbo);
+    glGenVertexArrays(2, update_vao);
+    glGenVertexArrays(2, draw_vao);
+    int aPosLoc = glGetAttribLocation(shader_program, "aPos");
+    for (int idx = 0; idx < 2; idx++) {
+        glBindBuffer(GL_ARRAY_BUFFER, vertices_vbo[idx]);
+        /* Both buffers get the initial data, after the upload only the GPU writes and reads them. */
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_DYNAMIC_COPY);
+
+        glBindVertexArray(update_vao[idx]);
+        for (int corner = 0; corner < 3; corner++) {
+            char name[16];
+            snprintf(name, sizeof(name), "aVertex%d", corner);
+            int loc = glGetAttribLocation(update_program, name);
+            glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, 12 * sizeof(float), (void*)(corner * 4 * sizeof(float)));
+            glEnableVertexAttribArray(loc);
+        }
+
+        glBindVertexArray(draw_vao[idx]);
+        glVertexAttribPointer(aPosLoc, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), NULL);
+        glEnableVertexAttribArray(aPosLoc);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // F.3. A transform feedback object per output buffer: the binding is set once.
+    unsigned int feedback[2];
+    glGenTransformFeedbacks(2, feedback);
+    for (int idx = 0; idx < 2; idx++) {
+        glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, feedback[idx]);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, vertices_vbo[idx]);
+    }
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+
+    // 11. Query the uniform locations.
+    int uniformColorLoc = glGetUniformLocation(shader_program, "uColor");
+    int transformLoc = glGetUniformLocation(shader_program, "transform");
+
+    // F.X. Statistics to report the simulation throughput.
+    double statsStartTime = demoGetTime(&demo);
+    int statsFrames = 0;
+
+    // F.X. Index of the buffer holding the current simulation state.
+    int currentBuffer = 0;
+
+    // T.1. Create the GPU timer for the per-pass timing ("--gpu-timer" options).
+    GpuTimer gpuTimer;
+    initGpuTimer(&gpuTimer, argc, argv);
+
+    glm::mat4 transform = glm::mat4(1.0f);
+    transform = glm::scale(transform, glm::vec3(zoom, zoom, 1.0f));
+
+    // X. Create a render loop.
+    while (!demoShouldClose(&demo))
+    {
+        // X. Poll and handle events (inputs, window resize, etc.)
+        demoPollEvents(&demo);
+
+        // T.2. Collect the GPU times of the previous frames.
+        gpuTimerBeginFrame(&gpuTimer);
+
+        // F.4. Update pass: one point per triangle, nothing is rasterized.
+        int nextBuffer = 1 - currentBuffer;
+        {
+            GpuTimerScope timerScope(&gpuTimer, "feedback");
+
+            glUseProgram(update_program);
+            glBindVertexArray(update_vao[currentBuffer]);
+            glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, feedback[nextBuffer]);
+            glEnable(GL_RASTERIZER_DISCARD);
+
+            glBeginTransformFeedback(GL_POINTS);
+            glDrawArrays(GL_POINTS, 0, triangleCount);
+            glEndTransformFeedback();
+
+            glDisable(GL_RASTERIZER_DISCARD);
+            glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+        }
+
+        gpuTimerBegin(&gpuTimer, "draw");
+
+        // X. Clear the color image.
+        glClearColor(0.0, 0.3, 0.3, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        // F.5. Draw the captured state (the GL orders the draw after the capture).
+        glUseProgram(shader_program);
+        glBindVertexArray(draw_vao[nextBuffer]);
+        glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(transform));
+        glUniform3f(uniformColorLoc, 1.0, 0.1, 0.1);
+        glDrawArrays(GL_TRIANGLES, 0, triangleCount * 3);
+        gpuTimerEnd(&gpuTimer);
+
+        // T.3. Show the pass times (if requested).
+        gpuTimerDrawOverlay(&gpuTimer, 10, 10);
+        gpuTimerEndFrame(&gpuTimer);
+
+        // F.X. The freshly written buffer is the input of the next frame.
+        currentBuffer = nextBuffer;
+
+        // X. Swap the fron-back buffers to display the rendered image in the window.
+        demoSwapBuffers(&demo);
+
+        // X. Report the frame time and the simulated triangles per second.
+        statsFrames++;
+        double statsElapsed = demoGetTime(&demo) - statsStartTime;
+        if (statsElapsed >= 1.0) {
+            printf("%d triangles: %.3f ms/frame, %.2f M triangles/s\n",
+                   triangleCount, statsElapsed * 1000.0 / statsFrames,
+                   (double)triangleCount * statsFrames / statsElapsed / 1e6);
+            statsStartTime = demoGetTime(&demo);
+            statsFrames = 0;
+        }
+    }
+
+    // XX. Destroy the GL objects.
+    glDeleteTransformFeedbacks(2, feedback);
+    glDeleteVertexArrays(2, update_vao);
+    glDeleteVertexArrays(2, draw_vao);
+    glDeleteBuffers(2, vertices_vbo);
+    glDeleteProgram(update_program);
+    glDeleteProgram(shader_program);
+    destroyGpuTimer(&gpuTimer);
+
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
+
+    return 0;
+}
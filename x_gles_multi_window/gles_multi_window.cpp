@@ -0,0 +1,455 @@
+/**
+ * Multi-window rendering with a shared context group and per-window frame pacing.
+ *
+ * One process drives several windows (ex.: one per display). Every window is
+ * created with the first window as the GLFW "share" window: the program, the
+ * cube buffers and the texture are uploaded once and used by every context.
+ * Container objects (VAOs, FBOs) are not shared: each context builds its own
+ * VAO from the shared buffers.
+ *
+ * A single render thread draws and swaps every window. With vsync each swap
+ * would block until the vblank of its window (N windows: N vblanks per loop),
+ * so the windows swap with interval 0 and each has its own frame deadline
+ * (the refresh rate of its monitor or "--fps"): the loop sleeps until the
+ * earliest deadline, then renders the windows that are due.
+ *
+ * Compile with shaderc:
+ * $ g++ gles_multi_window.cpp -o gles_multi_window -lglfw -lGLESv2
+ *
+ * Run with 3 windows (placed on the monitors in order):
+ * $ ./gles_multi_window --windows 3
+ *
+ * Per-window frame rates (comma separated, 0: no limit):
+ * $ ./gles_multi_window --windows 2 --fps 60,30
+ *
+ * In the headless modes the extra "windows" are offscreen framebuffers of shared
+ * EGL contexts (see common/gl_workers.h), rendered without frame limit by default:
+ * $ ./gles_multi_window --surfaceless --frames 100 --windows 4
+ *
+ * Dependencies:
+ *  * C++11
+ *  * GLFW 3.0+
+ *  * GLM
+ *  * Open GL ES 3.0+
+ *  * EGL
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLFW/glfw3.h>
+#include <GLES3/gl3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "common/demo_context.h"
+#include "common/gl_workers.h"
+#include "common/program_cache.h"
+#include "common/static_mesh.h"
+
+#define MAX_WINDOWS 8
+
+const char* vertex_src = R"(#version 300 es
+precision highp float;
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec2 aTex;
+
+uniform mat4 transform;
+
+out vec2 vTex;
+
+void main() {
+    gl_Position = transform * vec4(aPos, 1.0);
+    vTex = aTex;
+}
+)";
+
+const char* fragment_src = R"(#version 300 es
+precision highp float;
+
+in vec2 vTex;
+
+uniform sampler2D checker;
+uniform vec3 tint;
+
+out vec4 outColor;
+
+void main() {
+    outColor = vec4(texture(checker, vTex).rrr * tint, 1.0);
+}
+)";
+
+// A window (or an offscreen view in the headless modes) with its own context.
+struct View {
+    GLFWwindow* window;   // window mode, NULL for the first view (the demo context's window)
+    SharedContext shared; // headless extra views: shared EGL context
+    unsigned int fbo;     // headless extra views: offscreen framebuffer
+    unsigned int colorRB;
+    unsigned int vao;     // per context: VAOs are not shared
+
+    double period;        // seconds per frame, 0: no limit
+    double nextFrame;
+    int frames;
+    int lateFrames;
+};
+
+// Parse the comma separated frame rates, the last one is used for the rest of the windows.
+static void parseFrameRates(const char* list, double* rates) {
+    double rate = 0.0;
+    for (int idx = 0; idx < MAX_WINDOWS; idx++) {
+        if (list != NULL && *list != '\0') {
+            rate = atof(list);
+            const char* comma = strchr(list, ',');
+            list = comma ? comma + 1 : NULL;
+        }
+        rates[idx] = rate;
+    }
+}
+
+// Refresh rate of the monitor (60 if unknown).
+static double monitorRefreshRate(GLFWmonitor* monitor) {
+    const GLFWvidmode* mode = monitor ? glfwGetVideoMode(monitor) : NULL;
+    return (mode && mode->refreshRate > 0) ? mode->refreshRate : 60.0;
+}
+
+static void makeViewCurrent(DemoContext* demo, const View& view) {
+    if (view.window != NULL) {
+        glfwMakeContextCurrent(view.window);
+    } else if (view.shared.context != NULL) {
+        makeSharedContextCurrent(&view.shared);
+    } else if (demo->headless) {
+        eglMakeCurrent((EGLDisplay)demo->eglDisplay, (EGLSurface)demo->eglSurface, (EGLSurface)demo->eglSurface,
+                       (EGLContext)demo->eglContext);
+    } else {
+        glfwMakeContextCurrent(demo->window);
+    }
+}
+
+// Build the VAO of the current context from the shared buffers.
+static unsigned int createViewVao(const MeshStreams& streams, unsigned int vbo, unsigned int ibo) {
+    unsigned int vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, streams.positionStride, (void*)(uintptr_t)streams.positionOffset);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, streams.texCoordStride, (void*)(uintptr_t)streams.texCoordOffset);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return vao;
+}
+
+int main(int argc, char **argv) {
+    int windowCount = 2;
+    const char* fpsList = NULL;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--windows") == 0 && idx + 1 < argc) {
+            windowCount = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--fps") == 0 && idx + 1 < argc) {
+            fpsList = argv[++idx];
+        }
+    }
+
+    if (windowCount < 1 || windowCount > MAX_WINDOWS) {
+        printf("Invalid window count (valid range: 1-%d)\n", MAX_WINDOWS);
+        return -1;
+    }
+
+    // 0-4. Create the first window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    /* See the "01_gles_glfw" example for the GLFW steps. This also handles the
+     * "--headless" and "--frames N" command line options. */
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO 0");
+    if (contextResult != 0) {
+        return contextResult;
+    }
+
+    // S.1. Upload the shared resources once: program, cube buffers, texture.
+    /* Created in the first context, every other context of the share group uses the same objects. */
+    unsigned int program = createCachedProgram(vertex_src, fragment_src);
+    if (program == 0) {
+        destroyDemoContext(&demo);
+        return -1;
+    }
+    int transformLoc = glGetUniformLocation(program, "transform");
+    int tintLoc = glGetUniformLocation(program, "tint");
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "checker"), 0);
+    glUseProgram(0);
+
+    /* The cube is generated at compile time (see common/static_mesh.h): uploaded straight from the binary. */
+    static constexpr auto cubeMesh = staticCube<StaticVertex>();
+    constexpr MeshStreams streams = staticMeshStreams(cubeMesh);
+
+    unsigned int vbo;
+    unsigned int ibo;
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, streams.vertexBufferSize, cubeMesh.vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glGenBuffers(1, &ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, streams.indexBufferSize, cubeMesh.indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    unsigned int texture;
+    {
+        std::vector<uint8_t> checker(64 * 64);
+        for (int y = 0; y < 64; y++) {
+            for (int x = 0; x < 64; x++) {
+                checker[y * 64 + x] = ((x / 8 + y / 8) % 2) ? 255 : 64;
+            }
+        }
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, 64, 64, 0, GL_RED, GL_UNSIGNED_BYTE, checker.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // S.2. The other contexts may only use the objects after their creation is done.
+    glFinish();
+
+    double frameRates[MAX_WINDOWS];
+    parseFrameRates(fpsList, frameRates);
+
+    int monitorCount = 0;
+    GLFWmonitor** monitors = demo.headless ? NULL : glfwGetMonitors(&monitorCount);
+
+    // W.1. Create the views: the first one is the demo context, the others share its objects.
+    std::vector<View> views(windowCount);
+    for (int idx = 0; idx < windowCount; idx++) {
+        View& view = views[idx];
+        memset(&view, 0, sizeof(view));
+        GLFWmonitor* monitor = monitorCount > 0 ? monitors[idx % monitorCount] : NULL;
+
+        if (idx > 0 && !demo.headless) {
+            // W.1.1. Window mode: GLFW shares the objects of the "share" window's context.
+            char title[32];
+            snprintf(title, sizeof(title), "GLDEMO %d", idx);
+            view.window = glfwCreateWindow(demo.width, demo.height, title, NULL, demo.window);
+            if (view.window == NULL) {
+                printf("Unable to create window %d\n", idx);
+                windowCount = idx;
+                views.resize(idx);
+                break;
+            }
+
+            // W.1.2. Place the window on the next monitor (offset a bit if two windows share one).
+            if (monitor != NULL) {
+                int x, y;
+                glfwGetMonitorPos(monitor, &x, &y);
+                int offset = (idx / monitorCount) * 40 + 40;
+                glfwSetWindowPos(view.window, x + offset, y + offset);
+            }
+        } else if (idx > 0) {
+            // W.1.3. Headless: a shared EGL context rendering into its own offscreen framebuffer.
+            makeViewCurrent(&demo, views[0]);
+            if (!createSharedContext(&view.shared)) {
+                printf("Unable to create shared context %d\n", idx);
+                windowCount = idx;
+                views.resize(idx);
+                break;
+            }
+            makeViewCurrent(&demo, view);
+
+            glGenRenderbuffers(1, &view.colorRB);
+            glBindRenderbuffer(GL_RENDERBUFFER, view.colorRB);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, demo.width, demo.height);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+            glGenFramebuffers(1, &view.fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, view.fbo);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, view.colorRB);
+        }
+
+        // W.1.4. The context's own VAO from the shared buffers.
+        makeViewCurrent(&demo, view);
+        view.vao = createViewVao(streams, vbo, ibo);
+
+        // W.1.5. No vsync wait in the swaps: the loop paces every window with its own deadline.
+        /* Without a "--fps" value the windows follow their monitor, the headless views are not limited. */
+        double rate = frameRates[idx];
+        if (fpsList == NULL) {
+            rate = demo.headless ? 0.0 : monitorRefreshRate(monitor);
+        }
+        if (!demo.headless) {
+            glfwSwapInterval(0);
+        }
+        view.period = rate > 0.0 ? 1.0 / rate : 0.0;
+        view.nextFrame = demoGetTime(&demo);
+
+        const char* kind = !demo.headless ? "window" : (idx == 0 ? "offscreen" : "shared EGL context, offscreen");
+        if (rate > 0.0) {
+            printf("View %d: %s, %.1f fps\n", idx, kind, rate);
+        } else {
+            printf("View %d: %s, no frame limit\n", idx, kind);
+        }
+    }
+
+    printf("Shared resources: program, %u + %u bytes of buffers, 64x64 texture for %d contexts\n",
+           streams.vertexBufferSize, streams.indexBufferSize, windowCount);
+
+    // X. Create a render loop.
+    bool closed = false;
+    while (!closed && !demoShouldClose(&demo))
+    {
+        // M.1. Sleep until the earliest deadline.
+        double now = demoGetTime(&demo);
+        double next = views[0].nextFrame;
+        for (int idx = 1; idx < windowCount; idx++) {
+            next = std::min(next, views[idx].nextFrame);
+        }
+        if (next > now) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(next - now));
+        }
+
+        // X. Poll and handle events (inputs, window resize, etc.) of every window.
+        demoPollEvents(&demo);
+        for (int idx = 1; idx < windowCount; idx++) {
+            closed |= views[idx].window != NULL && glfwWindowShouldClose(views[idx].window);
+        }
+
+        // M.2. Render and present the views which are due, the first one last (it counts the frames).
+        now = demoGetTime(&demo);
+        for (int step = 0; step < windowCount; step++) {
+            int idx = (step + 1) % windowCount;
+            View& view = views[idx];
+            if (view.nextFrame > now) {
+                continue;
+            }
+
+            makeViewCurrent(&demo, view);
+
+            int width = demo.width;
+            int height = demo.height;
+            unsigned int framebuffer = view.fbo;
+            if (view.window != NULL) {
+                glfwGetFramebufferSize(view.window, &width, &height);
+            } else if (idx == 0) {
+                demoGetFramebufferSize(&demo, &width, &height);
+                framebuffer = demoDefaultFramebuffer(&demo);
+            }
+
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glViewport(0, 0, width, height);
+            glEnable(GL_DEPTH_TEST);
+            glClearColor(0.0f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            // M.2.1. Each view shows the cube from its own angle with its own tint.
+            glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 100.0f);
+            glm::mat4 view_matrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -2.5f));
+            glm::mat4 model = glm::rotate(glm::mat4(1.0f), (float)demoAnimationTime(&demo) + idx * 0.7f, glm::vec3(0.5f, 1.0f, 0.0f));
+            glm::mat4 transform = projection * view_matrix * model;
+
+            glUseProgram(program);
+            glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(transform));
+            glUniform3f(tintLoc, 1.0f - idx * 0.1f, 0.6f + idx * 0.05f, 0.3f + idx * 0.1f);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glBindVertexArray(view.vao);
+            glDrawElements(GL_TRIANGLES, streams.indexCount, streams.indexType, NULL);
+            glBindVertexArray(0);
+
+            // M.2.2. Present: the first view through the demo context, the others directly.
+            if (idx == 0) {
+                demoSwapBuffers(&demo);
+            } else if (view.window != NULL) {
+                glfwSwapBuffers(view.window);
+            } else {
+                glFlush();
+            }
+            view.frames++;
+
+            // M.2.3. Next deadline of the view, a late frame starts a new schedule.
+            if (view.period > 0.0) {
+                view.nextFrame += view.period;
+                if (view.nextFrame < now) {
+                    view.nextFrame = now + view.period;
+                    view.lateFrames++;
+                }
+            } else {
+                view.nextFrame = now;
+            }
+        }
+    }
+
+    // XX. Print the frame rate of every view.
+    double elapsed = demoGetTime(&demo);
+    for (int idx = 0; idx < windowCount; idx++) {
+        const View& view = views[idx];
+        printf("View %d: %d frames, %.2f fps (target: %s), %d late\n", idx, view.frames,
+               elapsed > 0.0 ? view.frames / elapsed : 0.0, view.period > 0.0 ? "paced" : "no limit", view.lateFrames);
+    }
+
+    // XX. Destroy the per-context objects and the extra windows/contexts.
+    for (int idx = windowCount - 1; idx >= 0; idx--) {
+        View& view = views[idx];
+        makeViewCurrent(&demo, view);
+        glDeleteVertexArrays(1, &view.vao);
+        if (view.fbo != 0) {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glDeleteFramebuffers(1, &view.fbo);
+            glDeleteRenderbuffers(1, &view.colorRB);
+        }
+
+        if (idx == 0) {
+            continue;
+        }
+        makeViewCurrent(&demo, views[0]);
+        if (view.window != NULL) {
+            glfwDestroyWindow(view.window);
+        } else {
+            destroySharedContext(&view.shared);
+        }
+    }
+
+    // XX. Destroy the shared objects in the first context.
+    makeViewCurrent(&demo, views[0]);
+    glDeleteTextures(1, &texture);
+    glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &ibo);
+    glDeleteProgram(program);
+
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
+
+    return 0;
+}
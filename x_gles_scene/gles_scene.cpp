@@ -0,0 +1,300 @@
+/**
+ * Streaming a scene from a memory mapped scene file.
+ *
+ * The scene (nodes with transforms and mesh/material references, the meshes
+ * and the materials, see common/scene_file.h) is mapped, only its tables are
+ * read before the first frame: the world transforms and bounds and the BVH
+ * of the nodes are computed from them. Every frame the meshes which are not
+ * resident yet are uploaded in the order of the distance to the camera,
+ * within a byte budget, and the next ones are read ahead. The BVH culls the
+ * nodes against the view frustum, the nodes of the meshes which are not
+ * uploaded yet are skipped: the city is interactive from the first frame
+ * and fills in from the camera outwards.
+ *
+ * Compile with shaderc:
+ * $ g++ gles_scene.cpp -o gles_scene -lglfw -lGLESv2
+ *
+ * Generate a scene (the build generates "demo_city.scene" next to the binary) and run:
+ * $ ./scene_pack city.scene --city 32 --tile-detail 64
+ * $ ./gles_scene --scene city.scene
+ *
+ * Upload budget per frame in KiB (default: 2 ms of the calibrated upload rate with
+ * "--device-profile", 256 otherwise), "--preload" uploads every mesh before the first
+ * frame (to compare the startup time), "--no-cull" draws every node:
+ * $ ./gles_scene --budget 64
+ * $ ./gles_scene --preload --no-cull
+ *
+ * Dependencies:
+ *  * C++11
+ *  * GLFW 3.0+
+ *  * Open GL ES 3.0+
+ *  * EGL
+ *  * GLM
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <GLES3/gl3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "common/demo_context.h"
+#include "common/device_profile.h"
+#include "common/program_cache.h"
+#include "common/scene_file.h"
+
+const char* vertex_src = R"(#version 300 es
+precision highp float;
+
+layout(location = 0) in vec3 aPos;
+
+uniform mat4 viewProjection;
+uniform mat4 world;
+
+out vec3 worldPos;
+
+void main() {
+    vec4 position = world * vec4(aPos, 1.0);
+    worldPos = position.xyz;
+    gl_Position = viewProjection * position;
+}
+)";
+
+// Flat shading from the derivatives of the world position (the meshes have no normals), with distance fog.
+const char* fragment_src = R"(#version 300 es
+precision highp float;
+
+in vec3 worldPos;
+
+uniform vec4 baseColor;
+uniform vec3 cameraPos;
+uniform vec3 fogColor;
+uniform float fogDistance;
+
+out vec4 outColor;
+
+void main() {
+    vec3 normal = normalize(cross(dFdx(worldPos), dFdy(worldPos)));
+    float light = 0.35 + 0.65 * max(dot(normal, normalize(vec3(0.4, 1.0, 0.3))), 0.0);
+    float fog = clamp(length(worldPos - cameraPos) / fogDistance, 0.0, 1.0);
+    outColor = vec4(mix(baseColor.rgb * light, fogColor, fog * fog), 1.0);
+}
+)";
+
+int main(int argc, char **argv) {
+    // "--scene FILE", "--budget KIB": mesh uploads per frame, "--preload": every mesh before the first frame,
+    // "--no-cull": draw every node with a mesh.
+    std::string scenePath = argv[0];
+    scenePath = scenePath.substr(0, scenePath.find_last_of('/') + 1) + "demo_city.scene";
+    int budgetKiB = 0; // 0: from the device profile
+    bool preload = false;
+    bool cull = true;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--scene") == 0 && idx + 1 < argc) {
+            scenePath = argv[++idx];
+        } else if (strcmp(argv[idx], "--budget") == 0 && idx + 1 < argc) {
+            budgetKiB = atoi(argv[++idx]);
+            if (budgetKiB < 1) {
+                printf("Error: invalid upload budget (valid range: 1+ KiB)\n");
+                return -1;
+            }
+        } else if (strcmp(argv[idx], "--preload") == 0) {
+            preload = true;
+        } else if (strcmp(argv[idx], "--no-cull") == 0) {
+            cull = false;
+        }
+    }
+
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    /* See the "01_gles_glfw" example for the GLFW steps. This also handles the
+     * "--headless" and "--frames N" command line options. */
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
+    double startTime = demoGetTime(&demo);
+
+    // 4.1. The default upload budget: the bytes of 2 ms at the calibrated upload rate.
+    if (budgetKiB == 0) {
+        const DeviceProfile* profile = deviceProfile();
+        budgetKiB = 256;
+        if (profile != NULL && profile->uploadRate > 0.0) {
+            budgetKiB = std::max(16, std::min(16384, (int)(profile->uploadRate * 1024.0 * 0.002)));
+        }
+    }
+
+    // 5. Map the scene: the tables, the world transforms, the bounds and the BVH (the meshes are streamed).
+    Scene scene;
+    if (!openScene(&scene, scenePath.c_str())) {
+        destroyDemoContext(&demo);
+        return -2;
+    }
+    printf("Scene: %d nodes, %d meshes, %d materials, %d BVH nodes, %.1f MiB file, budget %d KiB/frame\n",
+           scene.nodeCount, scene.meshCount, scene.materialCount, (int)scene.bvh.size(), scene.size / (1024.0 * 1024.0),
+           budgetKiB);
+
+    // 6. Create the program.
+    unsigned int program = createCachedProgram(vertex_src, fragment_src);
+    int viewProjectionLoc = glGetUniformLocation(program, "viewProjection");
+    int worldLoc = glGetUniformLocation(program, "world");
+    int baseColorLoc = glGetUniformLocation(program, "baseColor");
+    int cameraPosLoc = glGetUniformLocation(program, "cameraPos");
+    int fogColorLoc = glGetUniformLocation(program, "fogColor");
+    int fogDistanceLoc = glGetUniformLocation(program, "fogDistance");
+    const float fogColor[3] = { 0.62f, 0.72f, 0.80f };
+    const float fogDistance = 140.0f;
+
+    glEnable(GL_DEPTH_TEST);
+
+    // 7. The extent of the scene for the camera path: the bounds of the BVH root.
+    glm::vec3 sceneMin(-1.0f);
+    glm::vec3 sceneMax(1.0f);
+    if (!scene.bvhItems.empty()) {
+        const SceneBvhNode& root = scene.bvh[0];
+        sceneMin = glm::vec3(root.boundsMin[0], root.boundsMin[1], root.boundsMin[2]);
+        sceneMax = glm::vec3(root.boundsMax[0], root.boundsMax[1], root.boundsMax[2]);
+    }
+    glm::vec3 sceneCenter = (sceneMin + sceneMax) * 0.5f;
+    float sceneRadius = glm::length(sceneMax - sceneMin) * 0.5f;
+
+    std::vector<int> visible;
+    std::vector<int> nearby;
+    bool reportedFirstFrame = false;
+    bool reportedResident = sceneFullyResident(&scene);
+    double statsStartTime = demoGetTime(&demo);
+    int statsFrames = 0;
+    int statsDrawn = 0;
+    int statsVisible = 0;
+
+    // X. Create a render loop.
+    while (!demoShouldClose(&demo))
+    {
+        // X. Poll and handle events (inputs, window resize, etc.)
+        demoPollEvents(&demo);
+
+        int width, height;
+        demoGetFramebufferSize(&demo, &width, &height);
+        glViewport(0, 0, width, height);
+
+        // X.1. The camera flies a loop over the city, looking ahead and down.
+        float time = (float)demoAnimationTime(&demo);
+        float angle = time * 0.15f;
+        float pathRadius = sceneRadius * 0.45f;
+        glm::vec3 camera = sceneCenter + glm::vec3(cosf(angle) * pathRadius, 12.0f + 4.0f * sinf(time * 0.3f),
+                                                   sinf(angle) * pathRadius * 0.6f);
+        glm::vec3 ahead = sceneCenter + glm::vec3(cosf(angle + 0.6f) * pathRadius, 0.0f, sinf(angle + 0.6f) * pathRadius * 0.6f);
+        glm::mat4 view = glm::lookAt(camera, ahead, glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 projection = glm::perspective(glm::radians(60.0f), (float)width / std::max(height, 1), 0.5f, fogDistance);
+        glm::mat4 viewProjection = projection * view;
+
+        // X.2. Stream the meshes nearest to the camera (everything at once with "--preload").
+        size_t budget = preload ? scene.size : (size_t)budgetKiB * 1024;
+        sceneStreamMeshes(&scene, glm::value_ptr(camera), budget, 0, -1);
+
+        // X.3. The visible nodes from the BVH (or every node with a mesh).
+        if (cull) {
+            sceneCullFrustum(&scene, glm::value_ptr(viewProjection), &visible);
+        } else {
+            visible = scene.bvhItems;
+        }
+
+        // X.4. Draw the nodes with a resident mesh.
+        glClearColor(fogColor[0], fogColor[1], fogColor[2], 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glUseProgram(program);
+        glUniformMatrix4fv(viewProjectionLoc, 1, GL_FALSE, glm::value_ptr(viewProjection));
+        glUniform3fv(cameraPosLoc, 1, glm::value_ptr(camera));
+        glUniform3fv(fogColorLoc, 1, fogColor);
+        glUniform1f(fogDistanceLoc, fogDistance);
+        int drawn = 0;
+        for (size_t idx = 0; idx < visible.size(); idx++) {
+            const SceneFileNode& node = scene.nodes[visible[idx]];
+            const MeshBuffers& mesh = scene.meshBuffers[node.mesh];
+            if (!scene.meshResident[node.mesh] || mesh.vao == 0) {
+                continue;
+            }
+
+            static const float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+            glUniformMatrix4fv(worldLoc, 1, GL_FALSE, &scene.transforms.world[visible[idx] * 16]);
+            glUniform4fv(baseColorLoc, 1, node.material >= 0 ? scene.materials[node.material].baseColor : white);
+            glBindVertexArray(mesh.vao);
+            glDrawElements(GL_TRIANGLES, mesh.indexCount, mesh.indexType, NULL);
+            drawn++;
+        }
+        glBindVertexArray(0);
+        glUseProgram(0);
+
+        // X. Swap the fron-back buffers to display the rendered image in the window.
+        demoSwapBuffers(&demo);
+
+        // X.5. The startup milestones: the first frame and the fully resident scene.
+        if (!reportedFirstFrame) {
+            printf("First frame after %.1f ms: %d/%d meshes resident\n", (demoGetTime(&demo) - startTime) * 1000.0,
+                   scene.residentMeshes, scene.meshCount);
+            reportedFirstFrame = true;
+        }
+        if (!reportedResident && sceneFullyResident(&scene)) {
+            printf("Scene fully resident after %.1f ms (%d frames, %.1f MiB)\n", (demoGetTime(&demo) - startTime) * 1000.0,
+                   demo.frameCount + 1, scene.residentBytes / (1024.0 * 1024.0));
+            reportedResident = true;
+        }
+
+        // X.6. Report the streaming and the culling once every second.
+        statsFrames++;
+        statsVisible += (int)visible.size();
+        statsDrawn += drawn;
+        double statsElapsed = demoGetTime(&demo) - statsStartTime;
+        if (statsElapsed >= 1.0) {
+            // A spatial query of the BVH: the nodes within 20 units of the camera.
+            sceneQuerySphere(&scene, glm::value_ptr(camera), 20.0f, &nearby);
+            printf("%.3f ms/frame, %d/%d meshes resident (%.1f MiB), %d visible, %d drawn nodes per frame, %d nearby\n",
+                   statsElapsed * 1000.0 / statsFrames, scene.residentMeshes, scene.meshCount,
+                   scene.residentBytes / (1024.0 * 1024.0), statsVisible / statsFrames, statsDrawn / statsFrames,
+                   (int)nearby.size());
+            statsStartTime = demoGetTime(&demo);
+            statsFrames = 0;
+            statsVisible = 0;
+            statsDrawn = 0;
+        }
+    }
+
+    // XX. Delete the meshes and unmap the scene.
+    closeScene(&scene);
+    glDeleteProgram(program);
+
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
+
+    return 0;
+}
@@ -0,0 +1,245 @@
+/**
+ * Virtual texture streaming of an image larger than the texture size limit.
+ *
+ * The image is tiled offline into a file of 128x128 pages of every mip level
+ * (see tools/virtual_texture.cpp), the demo zooms from the whole image down
+ * to one texel per pixel and pans over it. Every frame a feedback pass at a
+ * fraction of the resolution writes the tile each pixel needs, the read back
+ * (a few frames later, without waiting for the GPU) selects the tiles to
+ * stream: a thread reads them from the mapped file and at most
+ * "--upload-budget" tiles per frame are uploaded into the physical cache. A
+ * missing tile shows its parent (a blurrier level) until it arrives. See
+ * common/virtual_texture.h for the details.
+ *
+ * Compile with shaderc:
+ * $ g++ gles_virtual_texture.cpp -o gles_virtual_texture -lglfw -lGLESv2
+ *
+ * Tile an image (or a procedural test pattern) and run:
+ * $ ./virtual_texture image.vtex --procedural 16384
+ * $ ./gles_virtual_texture image.vtex
+ *
+ * Cache size ("--cache N": N x N slots of 128x128), the feedback resolution
+ * divisor and the tile uploads per frame (default: 2 ms of the calibrated upload rate with
+ * "--device-profile", 16 otherwise):
+ * $ ./gles_virtual_texture image.vtex --cache 8 --feedback-scale 16 --upload-budget 4
+ *
+ * Dependencies:
+ *  * C++11
+ *  * GLFW 3.0+
+ *  * Open GL ES 3.0+
+ *  * EGL
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+#include <GLFW/glfw3.h>
+#include <GLES3/gl3.h>
+
+#include "common/demo_context.h"
+#include "common/device_profile.h"
+#include "common/program_cache.h"
+#include "common/virtual_texture.h"
+
+const char* vertex_src = R"(#version 300 es
+precision highp float;
+
+// xy: the image coords at the center of the screen, zw: half of the screen in image coords
+uniform vec4 view;
+
+out vec2 uv;
+
+void main() {
+    // Full screen triangle.
+    vec2 position = vec2(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1));
+    uv = view.xy + position * view.zw;
+    gl_Position = vec4(position, 0.0, 1.0);
+}
+)";
+
+const char* fragment_head_src = R"(#version 300 es
+precision highp float;
+precision highp int;
+)";
+
+const char* fragment_main_src = R"(
+in vec2 uv;
+
+out vec4 outColor;
+
+void main() {
+    // The derivatives of the level selection must be computed before the discard.
+#ifdef FEEDBACK
+    vec4 color = virtualTextureFeedback(uv);
+#else
+    vec4 color = sampleVirtualTexture(uv);
+#endif
+    if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0)))) {
+        discard;
+    }
+    outColor = color;
+}
+)";
+
+static unsigned int createVirtualTextureProgram(bool feedback) {
+    std::string fragmentSrc = std::string(fragment_head_src) + (feedback ? "#define FEEDBACK\n" : "")
+                            + virtualTextureSamplingSrc + fragment_main_src;
+    return createCachedProgram(vertex_src, fragmentSrc.c_str());
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || strncmp(argv[1], "--", 2) == 0) {
+        printf("Usage: %s FILE [--cache N] [--feedback-scale N] [--upload-budget N] [--zoom-period SECONDS]\n", argv[0]);
+        printf("Create the FILE with the 'virtual_texture' tool (ex.: virtual_texture FILE --procedural 16384)\n");
+        return -1;
+    }
+
+    // "--cache N": N x N tile slots, "--feedback-scale N": 1/N resolution feedback pass,
+    // "--upload-budget N": tile uploads per frame, "--zoom-period S": seconds of a zoom in and out.
+    int cacheTiles = 16;
+    int feedbackScale = 8;
+    int uploadBudget = 0; // 0: from the device profile
+    double zoomPeriod = 20.0;
+    for (int idx = 2; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--cache") == 0 && idx + 1 < argc) {
+            cacheTiles = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--feedback-scale") == 0 && idx + 1 < argc) {
+            feedbackScale = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--upload-budget") == 0 && idx + 1 < argc) {
+            uploadBudget = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--zoom-period") == 0 && idx + 1 < argc) {
+            zoomPeriod = atof(argv[++idx]);
+        }
+    }
+
+    if (cacheTiles < 2 || cacheTiles > 64 || feedbackScale < 1 || feedbackScale > 64 || uploadBudget < 0
+        || zoomPeriod <= 0.0) {
+        printf("Error: invalid option (valid ranges: --cache 2-64, --feedback-scale 1-64, --upload-budget 0+, "
+               "--zoom-period > 0)\n");
+        return -1;
+    }
+
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    /* See the "01_gles_glfw" example for the GLFW steps. This also handles the
+     * "--headless" and "--frames N" command line options. */
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
+
+    // 4.1. The default upload budget: the tiles of 2 ms at the calibrated upload rate.
+    if (uploadBudget == 0) {
+        const DeviceProfile* profile = deviceProfile();
+        uploadBudget = 16;
+        if (profile != NULL && profile->uploadRate > 0.0) {
+            double tiles = profile->uploadRate * 1024.0 * 1024.0 * 0.002 / VT_TILE_BYTES;
+            uploadBudget = std::max(1, std::min(64, (int)tiles));
+        }
+        printf("Upload budget: %d tiles per frame\n", uploadBudget);
+    }
+
+    // 5. Map the tile file, create the cache and start the streaming thread.
+    VirtualTexture* vt = createVirtualTexture(argv[1], cacheTiles, feedbackScale, uploadBudget);
+    if (vt == NULL) {
+        destroyDemoContext(&demo);
+        return -2;
+    }
+    const VirtualTextureHeader* header = virtualTextureHeader(vt);
+    printf("Virtual texture: %ux%u texels, %u levels, %dx%d tile cache\n", header->width, header->height,
+           header->levelCount, cacheTiles, cacheTiles);
+
+    // 6. Create the programs of the feedback and of the color pass.
+    /* Both draw the same triangle, the view uniform must be the same. */
+    unsigned int feedbackProgram = createVirtualTextureProgram(true);
+    unsigned int colorProgram = createVirtualTextureProgram(false);
+    int feedbackViewLoc = glGetUniformLocation(feedbackProgram, "view");
+    int colorViewLoc = glGetUniformLocation(colorProgram, "view");
+
+    // The triangle has no vertex attributes.
+    unsigned int vao;
+    glGenVertexArrays(1, &vao);
+
+    // X. Create a render loop.
+    while (!demoShouldClose(&demo))
+    {
+        // X. Poll and handle events (inputs, window resize, etc.)
+        demoPollEvents(&demo);
+        demoRequestRedraw(&demo, 1.0 / 60.0);
+
+        int width, height;
+        demoGetFramebufferSize(&demo, &width, &height);
+
+        // X.1. View: zoom from the whole image to 1 texel per pixel and back, the center moves over the image.
+        /* The zoom is exponential: every level of the pyramid is on the screen for the same time. */
+        double time = demoAnimationTime(&demo);
+        double wholeImage = 0.55;
+        double texelPerPixel = 0.5 * height / header->height;
+        double zoom = 0.5 - 0.5 * cos(time * 2.0 * M_PI / zoomPeriod);
+        double halfHeight = wholeImage * pow(texelPerPixel / wholeImage, zoom);
+        double halfWidth = halfHeight * width / height * header->height / header->width;
+        double centerX = 0.5 + 0.35 * zoom * sin(time * 0.37);
+        double centerY = 0.5 + 0.35 * zoom * sin(time * 0.23 + 1.0);
+
+        // X.2. Feedback pass: the tiles of the view, read back later.
+        glBindVertexArray(vao);
+        virtualTextureBeginFeedback(vt, width, height);
+        glUseProgram(feedbackProgram);
+        virtualTextureBind(vt, feedbackProgram, true, 1, 2);
+        glUniform4f(feedbackViewLoc, (float)centerX, (float)centerY, (float)halfWidth, (float)halfHeight);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        virtualTextureEndFeedback(vt);
+
+        // X.3. Stream and upload the tiles of the older feedback, update the page table.
+        virtualTextureUpdate(vt);
+
+        // X.4. Draw the image with the resident tiles.
+        glViewport(0, 0, width, height);
+        glClearColor(0.0, 0.3, 0.3, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glUseProgram(colorProgram);
+        virtualTextureBind(vt, colorProgram, false, 1, 2);
+        glUniform4f(colorViewLoc, (float)centerX, (float)centerY, (float)halfWidth, (float)halfHeight);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+
+        // X. Swap the fron-back buffers to display the rendered image in the window.
+        demoSwapBuffers(&demo);
+    }
+
+    // XX. Stop the streaming and report the cache statistics.
+    destroyVirtualTexture(vt);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteProgram(feedbackProgram);
+    glDeleteProgram(colorProgram);
+
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
+
+    return 0;
+}
@@ -0,0 +1,777 @@
+/**
+ * The same triangle with an OpenGL ES and a Vulkan backend: CPU cost of the submission.
+ *
+ * Every frame draws the triangle "--draws N" times, before every draw the color changes
+ * (a uniform in GLES, a push constant in Vulkan). The GLES backend pays for the state
+ * validation inside the driver during the draw calls, the Vulkan backend validates the
+ * pipeline once and records a command buffer per frame. Both print the CPU time of the
+ * draws/recording, the submission and the whole frame at exit.
+ *
+ * The Vulkan backend renders offscreen (no swapchain): one color image, command pool and
+ * fence per frame in flight (2 frames), the CPU waits only for the fence of the frame
+ * which reuses the resources. The SPIR-V of the shaders is embedded (no shader compiler
+ * needed at build or run time).
+ *
+ * Run:
+ * $ ./x_gles_vulkan_triangle --headless --frames 300 --draws 2000
+ *
+ * Options:
+ *  --backend gles|vulkan|both
+ *                   Backends to run one after the other (default: both).
+ *  --draws N        Draws per frame (default: 1000).
+ *  The GLES backend handles the demo context options (see demo_context.h), the
+ *  Vulkan backend uses "--frames N" (default: 100) and "--size WxH".
+ *
+ * Dependencies:
+ *  * C++11
+ *  * GLFW 3.2+ (glfwGetInstanceProcAddress)
+ *  * Open GL ES 3.0+
+ *  * EGL
+ *  * Vulkan 1.0 loader and driver (optional: the Vulkan backend is skipped without them)
+ *
+ * MIT License
+ * Copyright (c) 2020 elecro
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * OFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <GLES3/gl3.h>
+
+#include <glad/vulkan.h>
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include "common/demo_context.h"
+#include "common/program_cache.h"
+
+const char* vertex_src = R"(#version 300 es
+precision highp float;
+
+in vec2 aPos;
+
+void main() {
+    gl_Position = vec4(aPos, 0.0, 1.0);
+}
+)";
+
+const char* fragment_src = R"(#version 300 es
+precision highp float;
+
+uniform vec4 uColor;
+
+out vec4 outColor;
+
+void main() {
+    outColor = uColor;
+}
+)";
+
+// SPIR-V 1.0 of the Vulkan shaders, equivalent to:
+/*  #version 450
+ *  layout(location = 0) in vec2 aPos;
+ *  void main() { gl_Position = vec4(aPos, 0.0, 1.0); }
+ *
+ *  #version 450
+ *  layout(push_constant) uniform Push { vec4 uColor; };
+ *  layout(location = 0) out vec4 outColor;
+ *  void main() { outColor = uColor; }
+ */
+static const uint32_t vertex_spirv[] = {
+    0x07230203, 0x00010000, 0x00000000, 0x00000012, 0x00000000, 0x00020011, 0x00000001, 0x0003000e,
+    0x00000000, 0x00000001, 0x0007000f, 0x00000000, 0x00000001, 0x6e69616d, 0x00000000, 0x00000008,
+    0x0000000a, 0x00040047, 0x00000008, 0x0000001e, 0x00000000, 0x00040047, 0x0000000a, 0x0000000b,
+    0x00000000, 0x00020013, 0x00000002, 0x00030021, 0x00000003, 0x00000002, 0x00030016, 0x00000004,
+    0x00000020, 0x00040017, 0x00000005, 0x00000004, 0x00000002, 0x00040017, 0x00000006, 0x00000004,
+    0x00000004, 0x00040020, 0x00000007, 0x00000001, 0x00000005, 0x0004003b, 0x00000007, 0x00000008,
+    0x00000001, 0x00040020, 0x00000009, 0x00000003, 0x00000006, 0x0004003b, 0x00000009, 0x0000000a,
+    0x00000003, 0x0004002b, 0x00000004, 0x0000000b, 0x00000000, 0x0004002b, 0x00000004, 0x0000000c,
+    0x3f800000, 0x00050036, 0x00000002, 0x00000001, 0x00000000, 0x00000003, 0x000200f8, 0x0000000d,
+    0x0004003d, 0x00000005, 0x0000000e, 0x00000008, 0x00050051, 0x00000004, 0x0000000f, 0x0000000e,
+    0x00000000, 0x00050051, 0x00000004, 0x00000010, 0x0000000e, 0x00000001, 0x00070050, 0x00000006,
+    0x00000011, 0x0000000f, 0x00000010, 0x0000000b, 0x0000000c, 0x0003003e, 0x0000000a, 0x00000011,
+    0x000100fd, 0x00010038,
+};
+
+static const uint32_t fragment_spirv[] = {
+    0x07230203, 0x00010000, 0x00000000, 0x00000011, 0x00000000, 0x00020011, 0x00000001, 0x0003000e,
+    0x00000000, 0x00000001, 0x0006000f, 0x00000004, 0x00000001, 0x6e69616d, 0x00000000, 0x00000007,
+    0x00030010, 0x00000001, 0x00000007, 0x00040047, 0x00000007, 0x0000001e, 0x00000000, 0x00030047,
+    0x00000008, 0x00000002, 0x00050048, 0x00000008, 0x00000000, 0x00000023, 0x00000000, 0x00020013,
+    0x00000002, 0x00030021, 0x00000003, 0x00000002, 0x00030016, 0x00000004, 0x00000020, 0x00040017,
+    0x00000005, 0x00000004, 0x00000004, 0x00040020, 0x00000006, 0x00000003, 0x00000005, 0x0004003b,
+    0x00000006, 0x00000007, 0x00000003, 0x0003001e, 0x00000008, 0x00000005, 0x00040020, 0x00000009,
+    0x00000009, 0x00000008, 0x0004003b, 0x00000009, 0x0000000a, 0x00000009, 0x00040015, 0x0000000b,
+    0x00000020, 0x00000001, 0x0004002b, 0x0000000b, 0x0000000c, 0x00000000, 0x00040020, 0x0000000d,
+    0x00000009, 0x00000005, 0x00050036, 0x00000002, 0x00000001, 0x00000000, 0x00000003, 0x000200f8,
+    0x0000000e, 0x00050041, 0x0000000d, 0x0000000f, 0x0000000a, 0x0000000c, 0x0004003d, 0x00000005,
+    0x00000010, 0x0000000f, 0x0003003e, 0x00000007, 0x00000010, 0x000100fd, 0x00010038,
+};
+
+static const float vertices[] = {
+    -0.5, 0.5,
+    0.5, 0.5,
+    0.0, -0.5
+};
+
+static const int VULKAN_FRAMES_IN_FLIGHT = 2;
+
+// Color of the draw "idx" out of "count": the same sequence in both backends.
+static void drawColor(int idx, int count, float* color) {
+    float t = (float)idx / (float)(count > 1 ? count - 1 : 1);
+    color[0] = t;
+    color[1] = 0.5f;
+    color[2] = 1.0f - t;
+    color[3] = 1.0f;
+}
+
+struct BackendTimes {
+    double drawSeconds;   // GLES: the draw calls, Vulkan: the command buffer recording
+    double submitSeconds; // GLES: the swap/flush, Vulkan: vkQueueSubmit
+    double waitSeconds;   // Vulkan: waiting for the fence of the frame in flight
+    double frameSeconds;
+    int frames;
+};
+
+static void printBackendTimes(const char* name, const BackendTimes& times, int draws) {
+    if (times.frames == 0) {
+        return;
+    }
+    double scale = 1000.0 / times.frames;
+    printf("%s: %d frames, %d draws/frame: draws %.3f ms, submit %.3f ms, wait %.3f ms, frame %.3f ms "
+           "(%.2f us/draw)\n",
+           name, times.frames, draws, times.drawSeconds * scale, times.submitSeconds * scale,
+           times.waitSeconds * scale, times.frameSeconds * scale,
+           times.drawSeconds * 1000000.0 / ((double)times.frames * draws));
+}
+
+static int runGles(int argc, char** argv, int draws, BackendTimes* times) {
+    // G.1. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
+
+    // G.2. Program, vertex buffer and vertex array of the triangle.
+    unsigned int shader_program = createCachedProgram(vertex_src, fragment_src);
+    int colorLoc = glGetUniformLocation(shader_program, "uColor");
+
+    unsigned int vao;
+    unsigned int vbo;
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+
+    // X. Create a render loop.
+    while (!demoShouldClose(&demo))
+    {
+        double frameStart = demoGetTime(&demo);
+
+        // X. Poll and handle events (inputs, window resize, etc.)
+        demoPollEvents(&demo);
+
+        int display_w, display_h;
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
+        glViewport(0, 0, display_w, display_h);
+
+        glClearColor(0.0, 0.3, 0.3, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        // G.3. Draw the triangle "draws" times, a new color before every draw.
+        double drawStart = demoGetTime(&demo);
+        glUseProgram(shader_program);
+        glBindVertexArray(vao);
+        for (int idx = 0; idx < draws; idx++) {
+            float color[4];
+            drawColor(idx, draws, color);
+            glUniform4fv(colorLoc, 1, color);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        glBindVertexArray(0);
+        double drawEnd = demoGetTime(&demo);
+
+        // X. Swap the front and back buffers.
+        demoSwapBuffers(&demo);
+        double frameEnd = demoGetTime(&demo);
+
+        times->drawSeconds += drawEnd - drawStart;
+        times->submitSeconds += frameEnd - drawEnd;
+        times->frameSeconds += frameEnd - frameStart;
+        times->frames++;
+    }
+
+    glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteProgram(shader_program);
+
+    destroyDemoContext(&demo);
+    return 0;
+}
+
+static GLADapiproc vulkanProcAddress(const char* name, void* user) {
+    return (GLADapiproc)glfwGetInstanceProcAddress((VkInstance)user, name);
+}
+
+static bool vulkanCheck(VkResult result, const char* what) {
+    if (result != VK_SUCCESS) {
+        printf("Vulkan: %s failed (VkResult %d)\n", what, (int)result);
+        return false;
+    }
+    return true;
+}
+
+// Memory type with the "properties" out of the "typeBits" of the requirements, -1 if none.
+static int vulkanMemoryType(VkPhysicalDevice gpu, uint32_t typeBits, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memory;
+    vkGetPhysicalDeviceMemoryProperties(gpu, &memory);
+    for (uint32_t idx = 0; idx < memory.memoryTypeCount; idx++) {
+        if ((typeBits & (1u << idx)) && (memory.memoryTypes[idx].propertyFlags & properties) == properties) {
+            return (int)idx;
+        }
+    }
+    return -1;
+}
+
+struct VulkanFrame {
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+    VkFramebuffer framebuffer;
+    VkCommandPool commandPool;
+    VkCommandBuffer commandBuffer;
+    VkFence fence;
+};
+
+struct VulkanTriangle {
+    VkInstance instance;
+    VkPhysicalDevice gpu;
+    VkDevice device;
+    VkQueue queue;
+    uint32_t queueFamily;
+
+    VkRenderPass renderPass;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipeline;
+    VkBuffer vertexBuffer;
+    VkDeviceMemory vertexMemory;
+
+    VulkanFrame frames[VULKAN_FRAMES_IN_FLIGHT];
+};
+
+static VkShaderModule createShaderModule(VkDevice device, const uint32_t* code, size_t size) {
+    VkShaderModuleCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    info.codeSize = size;
+    info.pCode = code;
+
+    VkShaderModule module = VK_NULL_HANDLE;
+    vulkanCheck(vkCreateShaderModule(device, &info, NULL, &module), "vkCreateShaderModule");
+    return module;
+}
+
+// V.1-V.3. Instance, device and queue with graphics support.
+static int initVulkanDevice(VulkanTriangle* vk) {
+    if (!glfwInit() || !glfwVulkanSupported()) {
+        printf("Vulkan: no Vulkan loader or driver found, the Vulkan backend is skipped\n");
+        return -3;
+    }
+    if (!gladLoadVulkanUserPtr(NULL, vulkanProcAddress, NULL)) {
+        printf("Vulkan: failed to load the global Vulkan functions\n");
+        return -3;
+    }
+
+    // V.1. Instance: no surface, no extension is needed for the offscreen rendering.
+    VkApplicationInfo app = {};
+    app.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    app.pApplicationName = "x_gles_vulkan_triangle";
+    app.apiVersion = VK_API_VERSION_1_0;
+
+    VkInstanceCreateInfo instanceInfo = {};
+    instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instanceInfo.pApplicationInfo = &app;
+    if (!vulkanCheck(vkCreateInstance(&instanceInfo, NULL, &vk->instance), "vkCreateInstance")) {
+        return -3;
+    }
+    gladLoadVulkanUserPtr(NULL, vulkanProcAddress, vk->instance);
+
+    // V.2. The first physical device with a graphics queue.
+    uint32_t gpuCount = 0;
+    vkEnumeratePhysicalDevices(vk->instance, &gpuCount, NULL);
+    VkPhysicalDevice gpus[8];
+    gpuCount = gpuCount > 8 ? 8 : gpuCount;
+    vkEnumeratePhysicalDevices(vk->instance, &gpuCount, gpus);
+
+    vk->gpu = VK_NULL_HANDLE;
+    for (uint32_t gpuIdx = 0; gpuIdx < gpuCount && vk->gpu == VK_NULL_HANDLE; gpuIdx++) {
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(gpus[gpuIdx], &familyCount, NULL);
+        VkQueueFamilyProperties families[16];
+        familyCount = familyCount > 16 ? 16 : familyCount;
+        vkGetPhysicalDeviceQueueFamilyProperties(gpus[gpuIdx], &familyCount, families);
+        for (uint32_t family = 0; family < familyCount; family++) {
+            if (families[family].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+                vk->gpu = gpus[gpuIdx];
+                vk->queueFamily = family;
+                break;
+            }
+        }
+    }
+    if (vk->gpu == VK_NULL_HANDLE) {
+        printf("Vulkan: no device with a graphics queue\n");
+        return -3;
+    }
+    gladLoadVulkanUserPtr(vk->gpu, vulkanProcAddress, vk->instance);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(vk->gpu, &properties);
+    printf("Vulkan: %s\n", properties.deviceName);
+
+    // V.3. Logical device with one graphics queue.
+    float priority = 1.0f;
+    VkDeviceQueueCreateInfo queueInfo = {};
+    queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueInfo.queueFamilyIndex = vk->queueFamily;
+    queueInfo.queueCount = 1;
+    queueInfo.pQueuePriorities = &priority;
+
+    VkDeviceCreateInfo deviceInfo = {};
+    deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceInfo.queueCreateInfoCount = 1;
+    deviceInfo.pQueueCreateInfos = &queueInfo;
+    if (!vulkanCheck(vkCreateDevice(vk->gpu, &deviceInfo, NULL, &vk->device), "vkCreateDevice")) {
+        return -3;
+    }
+    vkGetDeviceQueue(vk->device, vk->queueFamily, 0, &vk->queue);
+    return 0;
+}
+
+// V.4-V.6. Render pass, pipeline and vertex buffer of the triangle.
+static int initVulkanPipeline(VulkanTriangle* vk, int width, int height) {
+    // V.4. Render pass: clear the color image and store it, ready to be copied out after the pass.
+    VkAttachmentDescription attachment = {};
+    attachment.format = VK_FORMAT_R8G8B8A8_UNORM;
+    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+    VkAttachmentReference colorRef = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorRef;
+
+    VkRenderPassCreateInfo passInfo = {};
+    passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    passInfo.attachmentCount = 1;
+    passInfo.pAttachments = &attachment;
+    passInfo.subpassCount = 1;
+    passInfo.pSubpasses = &subpass;
+    if (!vulkanCheck(vkCreateRenderPass(vk->device, &passInfo, NULL, &vk->renderPass), "vkCreateRenderPass")) {
+        return -3;
+    }
+
+    // V.5. Pipeline: every state of the draw is baked in here, only the push constant changes per draw.
+    VkPushConstantRange pushRange = { VK_SHADER_STAGE_FRAGMENT_BIT, 0, 4 * sizeof(float) };
+    VkPipelineLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushRange;
+    if (!vulkanCheck(vkCreatePipelineLayout(vk->device, &layoutInfo, NULL, &vk->pipelineLayout),
+                     "vkCreatePipelineLayout")) {
+        return -3;
+    }
+
+    VkShaderModule vertexModule = createShaderModule(vk->device, vertex_spirv, sizeof(vertex_spirv));
+    VkShaderModule fragmentModule = createShaderModule(vk->device, fragment_spirv, sizeof(fragment_spirv));
+    if (vertexModule == VK_NULL_HANDLE || fragmentModule == VK_NULL_HANDLE) {
+        return -3;
+    }
+
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vertexModule;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = fragmentModule;
+    stages[1].pName = "main";
+
+    VkVertexInputBindingDescription binding = { 0, 2 * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX };
+    VkVertexInputAttributeDescription attribute = { 0, 0, VK_FORMAT_R32G32_SFLOAT, 0 };
+    VkPipelineVertexInputStateCreateInfo vertexInput = {};
+    vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInput.vertexBindingDescriptionCount = 1;
+    vertexInput.pVertexBindingDescriptions = &binding;
+    vertexInput.vertexAttributeDescriptionCount = 1;
+    vertexInput.pVertexAttributeDescriptions = &attribute;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    // The Vulkan clip space has +Y down: the image is upside down compared to the GLES framebuffer
+    // (the same as the bottom-up GLES row order in memory), it does not change the timings.
+    VkViewport viewport = { 0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f };
+    VkRect2D scissor = { { 0, 0 }, { (uint32_t)width, (uint32_t)height } };
+    VkPipelineViewportStateCreateInfo viewportState = {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.pViewports = &viewport;
+    viewportState.scissorCount = 1;
+    viewportState.pScissors = &scissor;
+
+    VkPipelineRasterizationStateCreateInfo raster = {};
+    raster.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    raster.polygonMode = VK_POLYGON_MODE_FILL;
+    raster.cullMode = VK_CULL_MODE_NONE;
+    raster.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    raster.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample = {};
+    multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState blendAttachment = {};
+    blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                     VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo blend = {};
+    blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    blend.attachmentCount = 1;
+    blend.pAttachments = &blendAttachment;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = stages;
+    pipelineInfo.pVertexInputState = &vertexInput;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &raster;
+    pipelineInfo.pMultisampleState = &multisample;
+    pipelineInfo.pColorBlendState = &blend;
+    pipelineInfo.layout = vk->pipelineLayout;
+    pipelineInfo.renderPass = vk->renderPass;
+    pipelineInfo.subpass = 0;
+    VkResult pipelineResult = vkCreateGraphicsPipelines(vk->device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL,
+                                                        &vk->pipeline);
+    vkDestroyShaderModule(vk->device, vertexModule, NULL);
+    vkDestroyShaderModule(vk->device, fragmentModule, NULL);
+    if (!vulkanCheck(pipelineResult, "vkCreateGraphicsPipelines")) {
+        return -3;
+    }
+
+    // V.6. Host visible vertex buffer: 3 vertices, written once.
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = sizeof(vertices);
+    bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (!vulkanCheck(vkCreateBuffer(vk->device, &bufferInfo, NULL, &vk->vertexBuffer), "vkCreateBuffer")) {
+        return -3;
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(vk->device, vk->vertexBuffer, &requirements);
+    int memoryType = vulkanMemoryType(vk->gpu, requirements.memoryTypeBits,
+                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (memoryType < 0) {
+        printf("Vulkan: no host visible memory for the vertex buffer\n");
+        return -3;
+    }
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = requirements.size;
+    allocInfo.memoryTypeIndex = (uint32_t)memoryType;
+    if (!vulkanCheck(vkAllocateMemory(vk->device, &allocInfo, NULL, &vk->vertexMemory), "vkAllocateMemory")) {
+        return -3;
+    }
+    vkBindBufferMemory(vk->device, vk->vertexBuffer, vk->vertexMemory, 0);
+
+    void* mapped = NULL;
+    vkMapMemory(vk->device, vk->vertexMemory, 0, sizeof(vertices), 0, &mapped);
+    memcpy(mapped, vertices, sizeof(vertices));
+    vkUnmapMemory(vk->device, vk->vertexMemory);
+    return 0;
+}
+
+// V.7. Resources of a frame in flight: color image, framebuffer, command pool/buffer and fence.
+static int initVulkanFrame(VulkanTriangle* vk, VulkanFrame* frame, int width, int height) {
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.extent.width = (uint32_t)width;
+    imageInfo.extent.height = (uint32_t)height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (!vulkanCheck(vkCreateImage(vk->device, &imageInfo, NULL, &frame->image), "vkCreateImage")) {
+        return -3;
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(vk->device, frame->image, &requirements);
+    int memoryType = vulkanMemoryType(vk->gpu, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (memoryType < 0) {
+        memoryType = vulkanMemoryType(vk->gpu, requirements.memoryTypeBits, 0);
+    }
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = requirements.size;
+    allocInfo.memoryTypeIndex = (uint32_t)memoryType;
+    if (!vulkanCheck(vkAllocateMemory(vk->device, &allocInfo, NULL, &frame->memory), "vkAllocateMemory")) {
+        return -3;
+    }
+    vkBindImageMemory(vk->device, frame->image, frame->memory, 0);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = frame->image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = 1;
+    if (!vulkanCheck(vkCreateImageView(vk->device, &viewInfo, NULL, &frame->view), "vkCreateImageView")) {
+        return -3;
+    }
+
+    VkFramebufferCreateInfo framebufferInfo = {};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = vk->renderPass;
+    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.pAttachments = &frame->view;
+    framebufferInfo.width = (uint32_t)width;
+    framebufferInfo.height = (uint32_t)height;
+    framebufferInfo.layers = 1;
+    if (!vulkanCheck(vkCreateFramebuffer(vk->device, &framebufferInfo, NULL, &frame->framebuffer),
+                     "vkCreateFramebuffer")) {
+        return -3;
+    }
+
+    // One pool per frame: the whole pool is reset once the fence of the frame signaled,
+    // cheaper than resetting the command buffers one by one.
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = vk->queueFamily;
+    if (!vulkanCheck(vkCreateCommandPool(vk->device, &poolInfo, NULL, &frame->commandPool), "vkCreateCommandPool")) {
+        return -3;
+    }
+
+    VkCommandBufferAllocateInfo commandInfo = {};
+    commandInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandInfo.commandPool = frame->commandPool;
+    commandInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandInfo.commandBufferCount = 1;
+    if (!vulkanCheck(vkAllocateCommandBuffers(vk->device, &commandInfo, &frame->commandBuffer),
+                     "vkAllocateCommandBuffers")) {
+        return -3;
+    }
+
+    // Created signaled: the first wait of the frame returns immediately.
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    if (!vulkanCheck(vkCreateFence(vk->device, &fenceInfo, NULL, &frame->fence), "vkCreateFence")) {
+        return -3;
+    }
+    return 0;
+}
+
+static void destroyVulkanTriangle(VulkanTriangle* vk) {
+    if (vk->device != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(vk->device);
+        for (int idx = 0; idx < VULKAN_FRAMES_IN_FLIGHT; idx++) {
+            VulkanFrame* frame = &vk->frames[idx];
+            vkDestroyFence(vk->device, frame->fence, NULL);
+            vkDestroyCommandPool(vk->device, frame->commandPool, NULL);
+            vkDestroyFramebuffer(vk->device, frame->framebuffer, NULL);
+            vkDestroyImageView(vk->device, frame->view, NULL);
+            vkDestroyImage(vk->device, frame->image, NULL);
+            vkFreeMemory(vk->device, frame->memory, NULL);
+        }
+        vkDestroyBuffer(vk->device, vk->vertexBuffer, NULL);
+        vkFreeMemory(vk->device, vk->vertexMemory, NULL);
+        vkDestroyPipeline(vk->device, vk->pipeline, NULL);
+        vkDestroyPipelineLayout(vk->device, vk->pipelineLayout, NULL);
+        vkDestroyRenderPass(vk->device, vk->renderPass, NULL);
+        vkDestroyDevice(vk->device, NULL);
+    }
+    if (vk->instance != VK_NULL_HANDLE) {
+        vkDestroyInstance(vk->instance, NULL);
+    }
+    glfwTerminate();
+}
+
+static int runVulkan(int width, int height, int frameCount, int draws, BackendTimes* times) {
+    VulkanTriangle vk = {};
+    int result = initVulkanDevice(&vk);
+    if (result == 0) {
+        result = initVulkanPipeline(&vk, width, height);
+    }
+    for (int idx = 0; idx < VULKAN_FRAMES_IN_FLIGHT && result == 0; idx++) {
+        result = initVulkanFrame(&vk, &vk.frames[idx], width, height);
+    }
+    if (result != 0) {
+        destroyVulkanTriangle(&vk);
+        return result;
+    }
+
+    for (int frameIdx = 0; frameIdx < frameCount; frameIdx++) {
+        VulkanFrame* frame = &vk.frames[frameIdx % VULKAN_FRAMES_IN_FLIGHT];
+        double frameStart = glfwGetTime();
+
+        // V.8. Wait until the GPU finished the previous frame which used these resources.
+        /* With 2 frames in flight the CPU records frame N while the GPU still renders frame N - 1. */
+        vkWaitForFences(vk.device, 1, &frame->fence, VK_TRUE, UINT64_MAX);
+        vkResetFences(vk.device, 1, &frame->fence);
+        vkResetCommandPool(vk.device, frame->commandPool, 0);
+        double recordStart = glfwGetTime();
+
+        // V.9. Record the frame: the pipeline is bound once, every draw only pushes its color.
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(frame->commandBuffer, &beginInfo);
+
+        VkClearValue clear;
+        clear.color.float32[0] = 0.0f;
+        clear.color.float32[1] = 0.3f;
+        clear.color.float32[2] = 0.3f;
+        clear.color.float32[3] = 1.0f;
+        VkRenderPassBeginInfo passBegin = {};
+        passBegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        passBegin.renderPass = vk.renderPass;
+        passBegin.framebuffer = frame->framebuffer;
+        passBegin.renderArea.extent.width = (uint32_t)width;
+        passBegin.renderArea.extent.height = (uint32_t)height;
+        passBegin.clearValueCount = 1;
+        passBegin.pClearValues = &clear;
+        vkCmdBeginRenderPass(frame->commandBuffer, &passBegin, VK_SUBPASS_CONTENTS_INLINE);
+
+        VkDeviceSize offset = 0;
+        vkCmdBindPipeline(frame->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk.pipeline);
+        vkCmdBindVertexBuffers(frame->commandBuffer, 0, 1, &vk.vertexBuffer, &offset);
+        for (int idx = 0; idx < draws; idx++) {
+            float color[4];
+            drawColor(idx, draws, color);
+            vkCmdPushConstants(frame->commandBuffer, vk.pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                               sizeof(color), color);
+            vkCmdDraw(frame->commandBuffer, 3, 1, 0, 0);
+        }
+
+        vkCmdEndRenderPass(frame->commandBuffer);
+        vkEndCommandBuffer(frame->commandBuffer);
+        double recordEnd = glfwGetTime();
+
+        // V.10. Submit: the fence signals when the GPU is done with the frame.
+        VkSubmitInfo submit = {};
+        submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit.commandBufferCount = 1;
+        submit.pCommandBuffers = &frame->commandBuffer;
+        if (!vulkanCheck(vkQueueSubmit(vk.queue, 1, &submit, frame->fence), "vkQueueSubmit")) {
+            result = -3;
+            break;
+        }
+        double frameEnd = glfwGetTime();
+
+        times->waitSeconds += recordStart - frameStart;
+        times->drawSeconds += recordEnd - recordStart;
+        times->submitSeconds += frameEnd - recordEnd;
+        times->frameSeconds += frameEnd - frameStart;
+        times->frames++;
+    }
+
+    destroyVulkanTriangle(&vk);
+    return result;
+}
+
+int main(int argc, char **argv) {
+    // 0. Options of the backends.
+    bool runGlesBackend = true;
+    bool runVulkanBackend = true;
+    int draws = 1000;
+    int vulkanFrames = 100;
+    int width = 1024;
+    int height = 600;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--backend") == 0 && idx + 1 < argc) {
+            const char* name = argv[++idx];
+            if (strcmp(name, "gles") == 0) {
+                runVulkanBackend = false;
+            } else if (strcmp(name, "vulkan") == 0) {
+                runGlesBackend = false;
+            } else if (strcmp(name, "both") != 0) {
+                printf("Unknown backend: %s (gles, vulkan or both)\n", name);
+                return -1;
+            }
+        } else if (strcmp(argv[idx], "--draws") == 0 && idx + 1 < argc) {
+            draws = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--frames") == 0 && idx + 1 < argc) {
+            vulkanFrames = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--size") == 0 && idx + 1 < argc) {
+            sscanf(argv[++idx], "%dx%d", &width, &height);
+        }
+    }
+    if (draws < 1 || vulkanFrames < 1 || width < 1 || height < 1) {
+        printf("Invalid --draws, --frames or --size value\n");
+        return -1;
+    }
+
+    BackendTimes glesTimes = {};
+    BackendTimes vulkanTimes = {};
+
+    // 1. The GLES backend (the demo context handles the window/headless options).
+    if (runGlesBackend) {
+        int result = runGles(argc, argv, draws, &glesTimes);
+        if (result != 0) {
+            return result;
+        }
+    }
+
+    // 2. The Vulkan backend, skipped (but not an error with "--backend both") without a driver.
+    int vulkanResult = 0;
+    if (runVulkanBackend) {
+        vulkanResult = runVulkan(width, height, vulkanFrames, draws, &vulkanTimes);
+    }
+
+    // 3. Report the CPU times of the backends side by side.
+    printBackendTimes("gles", glesTimes, draws);
+    printBackendTimes("vulkan", vulkanTimes, draws);
+    return runGlesBackend ? 0 : vulkanResult;
+}
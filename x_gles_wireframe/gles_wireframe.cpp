@@ -1,5 +1,11 @@
 /**
- * Single file OpenGL ES Poor man's "wireframe" logic.
+ * Single pass wireframe overlay for indexed meshes.
+ *
+ * The indexed mesh is expanded into unshared vertices with a barycentric
+ * attribute (see expandWireframeMesh in common/mesh.h). The fragment shader
+ * measures the distance to the closest edge in pixels with fwidth, so the
+ * lines have the same width on small and large triangles and the fill and
+ * the wireframe are drawn by the same draw call (no second GL_LINES pass).
  *
  * Compile with shaderc:
  * $ g++ x_gles_wireframe.cpp -o x_gles_wireframe -lglfw -lGLESv2
@@ -7,6 +13,25 @@
  * Run:
  * $ ./x_gles_wireframe
  *
+ * Select the mesh ("quad": 2 triangles with shared vertices, "grid": N x N
+ * quads, "cube": rotating cube, "sphere"/"torus": rotating meshes generated at
+ * compile time, see common/static_mesh.h) and the line width in pixels:
+ * $ ./x_gles_wireframe --mesh grid --grid 64 --line-width 1.5 --wireframe-mode 1
+ *
+ * Every wireframe mode has its own program: the mode is a compile time
+ * constant and the compiler removes the mode branches of the fragment
+ * shader. "--uniform-branch" draws with the single program which branches on
+ * the "wireframeToggle" uniform instead. The benchmark draws the mesh
+ * "--overdraw N" times with every variant and with the uniform branching
+ * program and prints the GPU time of each (fragment cost per variant):
+ * $ ./x_gles_wireframe --benchmark --overdraw 16
+ *
+ * Transparency of "--layers N" overlapping copies of the mesh with a
+ * "--fill-alpha A" fill in the wire-only mode: blended in the mesh order,
+ * sorted back to front on the CPU, weighted blended or per pixel linked list
+ * order independent transparency (see common/oit.h):
+ * $ ./x_gles_wireframe --mesh sphere --wireframe-mode 2 --layers 4 --fill-alpha 0.4 --transparency weighted
+ *
  * Dependencies:
  *  * C++11
  *  * GLFW 3.0+
@@ -34,45 +59,58 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  * OFTWARE.
  */
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
 
 #include <GLFW/glfw3.h>
 #include <GLES3/gl3.h>
 
-const char* vertex_src = R"(#version 310 es
-precision highp float;
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
-out vec3 fragColor;
+#include "common/demo_context.h"
+#include "common/gpu_timer.h"
+#include "common/input_queue.h"
+#include "common/mesh.h"
+#include "common/oit.h"
+#include "common/program_cache.h"
+#include "common/static_mesh.h"
+#include "common/stream_buffer.h"
 
-vec2 positions[6] = vec2[](
-    vec2(-0.5, 0.5),
-    vec2(0.5, -0.5),
-    vec2(-0.5, -0.5),
+const char* vertex_src = R"(#version 310 es
+precision highp float;
 
-    vec2(-0.5, 0.5),
-    vec2(0.5, 0.5),
-    vec2(0.5, -0.5)
-);
+// Fixed locations: the same VAO is used with every program variant.
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aBarycentric;
+layout(location = 2) in float aLayer; // the copy of "--layers" (the attribute is disabled for a single copy: 0)
 
-vec3 VBC[3] = vec3[](
-    vec3(1.0f, 0.0f, 0.0f),
-    vec3(0.0f, 1.0f, 0.0f),
-    vec3(0.0f, 0.0f, 1.0f)
-);
+uniform mat4 transform;
 
 out vec3 wireframeDistance;
+flat out vec3 fillRgb;
+
+// Every copy has its own fill color, the first one is the orange of the single mesh.
+const vec3 layerColors[4] = vec3[4](vec3(1.0, 0.5, 0.1), vec3(0.1, 0.6, 1.0), vec3(0.3, 1.0, 0.3), vec3(1.0, 0.2, 0.6));
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexID], 0.0, 1.0);
+    gl_Position = transform * vec4(aPos, 1.0);
+    fillRgb = layerColors[int(aLayer) % 4];
 
-    // Poor man's "wireframe"
-    // For each vertex assign a different vec3 value:
+    // Each vertex of a triangle has a different barycentric coord:
     // 1st vertice: vec3(1.0f, 0.0f, 0.0f)
     // 2nd vertice: vec3(0.0f, 1.0f, 0.0f)
     // 3rd vertice: vec3(0.0f, 0.0f, 1.0f)
-    // This will be used in the frament shader.
-    wireframeDistance = vec3(0.0f);
-    wireframeDistance[gl_VertexID % 3] = 1.0f;
+    // The interpolated value is the distance to the edges in the frament shader.
+    wireframeDistance = aBarycentric;
 }
 )";
 
@@ -80,10 +118,20 @@ const char* fragment_src = R"(#version 310 es
 precision highp float;
 
 in vec3 wireframeDistance;
+flat in vec3 fillRgb;
 
+#ifndef OIT
 out vec4 outColor;
+#endif
 
+#ifdef WIREFRAME_MODE
+// Program variant of one mode: the switch and the branch below are resolved at compile time.
+const int wireframeToggle = WIREFRAME_MODE;
+#else
 uniform int wireframeToggle;
+#endif
+uniform float lineWidth; // in pixels
+uniform float fillAlpha; // the fill of mode 2
 
 void main() {
     float alpha;
@@ -91,30 +139,32 @@ void main() {
     switch (wireframeToggle) {
         case 0:
         case 1: alpha = 1.0f; break;
-        case 2: alpha = 0.0f; break;
+        case 2: alpha = fillAlpha; break;
     }
 
-    // Check if one of the "wireframeDistance" vec3 values are less then the 0.0f value.
-    // If it is true, then this position is possibly at the edge of the vertice color it
-    // as a wireframe.
-    if (wireframeToggle > 0 && any(lessThan(wireframeDistance, vec3(0.01f)))) {
-        outColor = vec4(1.0f, 1.0f, 1.0f, 1.0f);
+    // fwidth is the change of the barycentric coords over one pixel: the distance to
+    // the closest edge in pixels, independent of the size of the triangle.
+    // The one pixel smoothstep antialiases the line.
+    vec3 edgePixels = wireframeDistance / fwidth(wireframeDistance);
+    float edge = 1.0f - smoothstep(lineWidth - 0.5f, lineWidth + 0.5f, min(min(edgePixels.x, edgePixels.y), edgePixels.z));
+
+    vec4 fillColor = vec4(fillRgb, alpha);
+    vec4 color;
+    if (wireframeToggle > 0) {
+        color = mix(fillColor, vec4(1.0f, 1.0f, 1.0f, 1.0f), edge);
     } else {
-        outColor = vec4(1.0f, 0.5f, 0.1f, alpha);
+        color = fillColor;
     }
 
-    /* Withtout if/switch
-    float wireframe = float(any(lessThan(bar, vec3(0.01f)))) * float(wireframeToggle > 0);
-    vec3 baseColor = vec3(1.0, 0.5f, 0.1f);
-    outColor = vec4(baseColor, float(wireframeToggle < 2)) + wireframe;
-    */
+#ifdef OIT
+    // Order independent transparency (common/oit.h): the header declares the outputs.
+    oitWrite(color);
+#else
+    outColor = color;
+#endif
 }
 )";
 
-static void ErrorCallbackGLFW(int error, const char* description) {
-    printf("Glfw Error %d: %s\n", error, description);
-}
-
 // Wireframe modes:
 /*
  0: No Wireframe, fill color
@@ -123,150 +173,470 @@ static void ErrorCallbackGLFW(int error, const char* description) {
  */
 static int wireframeToggle = 0;
 
-static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
-   if (key == GLFW_KEY_W && action == GLFW_PRESS) {
-        wireframeToggle = (wireframeToggle + 1) % 3;
-        printf("Wireframe Mode: %d\n", wireframeToggle);
+// Transparency of the draws ("--transparency"):
+/*
+ unsorted:    GL_BLEND in the mesh order (the default)
+ sorted:      GL_BLEND with the triangles sorted back to front on the CPU every frame
+ weighted:    weighted blended order independent transparency (common/oit.h)
+ linked-list: per pixel linked lists (common/oit.h), the exact reference
+ */
+enum Transparency {
+    TRANSPARENCY_UNSORTED,
+    TRANSPARENCY_SORTED,
+    TRANSPARENCY_WEIGHTED,
+    TRANSPARENCY_LINKED_LIST,
+    TRANSPARENCY_COUNT,
+};
+
+static const char* transparencyNames[TRANSPARENCY_COUNT] = { "unsorted", "sorted", "weighted", "linked-list" };
+
+struct WireframeProgram {
+    unsigned int program;
+    int toggleLoc; // -1 in the mode variants
+    int lineWidthLoc;
+    int fillAlphaLoc;
+    int transformLoc;
+};
+
+// Build the program variant of a mode (-1: the mode is selected by the "wireframeToggle" uniform).
+/* "header": the OIT shader header (see common/oit.h), NULL: the blended output. */
+static WireframeProgram createWireframeProgram(int mode, const char* header) {
+    std::string fragmentSrc = fragment_src;
+    if (mode >= 0) {
+        char define[64];
+        snprintf(define, sizeof(define), "#define WIREFRAME_MODE %d\n", mode);
+        fragmentSrc.insert(fragmentSrc.find('\n') + 1, define);
+    }
+    if (header != NULL) {
+        fragmentSrc.insert(fragmentSrc.find('\n') + 1, header);
     }
+
+    WireframeProgram result;
+    result.program = createCachedProgram(vertex_src, fragmentSrc.c_str());
+    result.toggleLoc = glGetUniformLocation(result.program, "wireframeToggle");
+    result.lineWidthLoc = glGetUniformLocation(result.program, "lineWidth");
+    result.fillAlphaLoc = glGetUniformLocation(result.program, "fillAlpha");
+    result.transformLoc = glGetUniformLocation(result.program, "transform");
+    return result;
 }
 
+// "indexOffset": the offset of the sorted indices in the element buffer of the VAO, -1: the vertices in order.
+static void drawWireframe(const WireframeProgram& program, int mode, const glm::mat4& transform, float lineWidth,
+                          float fillAlpha, unsigned int vao, int vertexCount, int indexOffset = -1) {
+    glUseProgram(program.program);
+    if (program.toggleLoc >= 0) {
+        glUniform1i(program.toggleLoc, mode);
+    }
+    glUniform1f(program.lineWidthLoc, lineWidth);
+    glUniform1f(program.fillAlphaLoc, fillAlpha);
+    glUniformMatrix4fv(program.transformLoc, 1, GL_FALSE, glm::value_ptr(transform));
 
-int main(int argc, char **argv) {
-    // 0. Add a method to report any GLFW errors.
-    glfwSetErrorCallback(ErrorCallbackGLFW);
+    glBindVertexArray(vao);
+    if (indexOffset >= 0) {
+        glDrawElements(GL_TRIANGLES, vertexCount, GL_UNSIGNED_INT, (void*)(intptr_t)indexOffset);
+    } else {
+        glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+    }
+    glBindVertexArray(0);
+}
 
-    // 1. Initialize the GLFW library.
-    if (!glfwInit()) {
-        return -1;
+struct SortKey {
+    float depth;
+    uint32_t triangle;
+};
+
+// The indices of the triangles back to front: the clip space depth of the centroids, the farthest first.
+static void sortTriangles(const std::vector<glm::vec3>& centroids, const glm::mat4& transform,
+                          std::vector<SortKey>* keys, uint32_t* indices) {
+    for (size_t idx = 0; idx < centroids.size(); idx++) {
+        glm::vec4 clip = transform * glm::vec4(centroids[idx], 1.0f);
+        (*keys)[idx].depth = clip.z / clip.w;
+        (*keys)[idx].triangle = (uint32_t)idx;
     }
+    std::sort(keys->begin(), keys->end(), [](const SortKey& a, const SortKey& b) { return a.depth > b.depth; });
 
-    // 2. Add hints to use during context creation when a GLFW window is created.
-    // Here: require a GL ES 3.0 context.
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
-    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
-
-    // 3. Create window with graphics context
-    GLFWwindow* window = glfwCreateWindow(1024, 600, "GLDEMO", NULL, NULL);
-    if (window == NULL) {
-        return -2;
+    for (size_t idx = 0; idx < keys->size(); idx++) {
+        uint32_t first = (*keys)[idx].triangle * 3;
+        indices[idx * 3] = first;
+        indices[idx * 3 + 1] = first + 1;
+        indices[idx * 3 + 2] = first + 2;
     }
+}
 
-    // 4. Activate the window (display it).
-    glfwMakeContextCurrent(window);
-    glfwSetKeyCallback(window, key_callback);
+// The key presses of the frame (the input queue of the demo context, see common/input_queue.h).
+static void handleInput(const DemoContext* demo) {
+    const InputEvent* events;
+    int count = demoInputEvents(demo, &events);
+    for (int idx = 0; idx < count; idx++) {
+        if (events[idx].type == INPUT_KEY && events[idx].code == GLFW_KEY_W && events[idx].action == GLFW_PRESS) {
+            wireframeToggle = (wireframeToggle + 1) % 3;
+            printf("Wireframe Mode: %d\n", wireframeToggle);
+        }
+    }
+}
 
+int main(int argc, char **argv) {
+    // Mesh selection: "--mesh quad|grid|cube|sphere|torus", "--grid N" quads per axis, "--line-width W" in pixels.
+    // "--wireframe-mode M" selects the initial wireframe mode (ex.: for the headless runs).
+    // "--uniform-branch" uses the uniform branching program, "--benchmark" times every variant
+    // with "--overdraw N" draws of the mesh.
+    // "--transparency MODE" (see above) with "--layers N" overlapping copies of the mesh and
+    // "--fill-alpha A" as the fill of mode 2 (default: 0, only the wires are visible).
+    const char* meshName = "quad";
+    int gridSize = 16;
+    float lineWidth = 1.0f;
+    bool uniformBranch = false;
+    bool benchmark = false;
+    int overdraw = 8;
+    Transparency transparency = TRANSPARENCY_UNSORTED;
+    int layers = 1;
+    float fillAlpha = 0.0f;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--mesh") == 0 && idx + 1 < argc) {
+            meshName = argv[++idx];
+        } else if (strcmp(argv[idx], "--grid") == 0 && idx + 1 < argc) {
+            gridSize = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--line-width") == 0 && idx + 1 < argc) {
+            lineWidth = (float)atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--wireframe-mode") == 0 && idx + 1 < argc) {
+            wireframeToggle = atoi(argv[++idx]) % 3;
+        } else if (strcmp(argv[idx], "--uniform-branch") == 0) {
+            uniformBranch = true;
+        } else if (strcmp(argv[idx], "--benchmark") == 0) {
+            benchmark = true;
+        } else if (strcmp(argv[idx], "--overdraw") == 0 && idx + 1 < argc) {
+            overdraw = atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--transparency") == 0 && idx + 1 < argc) {
+            const char* name = argv[++idx];
+            transparency = TRANSPARENCY_COUNT;
+            for (int mode = 0; mode < TRANSPARENCY_COUNT; mode++) {
+                if (strcmp(name, transparencyNames[mode]) == 0) {
+                    transparency = (Transparency)mode;
+                }
+            }
+            if (transparency == TRANSPARENCY_COUNT) {
+                printf("Unknown transparency mode: %s (unsorted, sorted, weighted or linked-list)\n", name);
+                return -1;
+            }
+        } else if (strcmp(argv[idx], "--layers") == 0 && idx + 1 < argc) {
+            layers = std::max(1, atoi(argv[++idx]));
+        } else if (strcmp(argv[idx], "--fill-alpha") == 0 && idx + 1 < argc) {
+            fillAlpha = (float)atof(argv[++idx]);
+        }
+    }
+    if (benchmark && transparency != TRANSPARENCY_UNSORTED) {
+        printf("The benchmark only supports the unsorted transparency\n");
+        return -1;
+    }
+
+    // 0-4. Create the window (or the headless offscreen context) with an OpenGL ES 3.0 context.
+    /* See the "01_gles_glfw" example for the GLFW steps. This also handles the
+     * "--headless" and "--frames N" command line options. */
+    DemoContext demo;
+    int contextResult = createDemoContext(&demo, argc, argv, "GLDEMO");
+    if (contextResult != 0) {
+        return contextResult;
+    }
     printf("Press 'W' to switch wireframe mode.\n");
 
     // 5. Set the view port to match the window size.
     {
         int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
+        demoGetFramebufferSize(&demo, &display_w, &display_h);
         glViewport(0, 0, display_w, display_h);
     }
 
-    // 6. Create the vertex shader.
-    unsigned int vertex_shader;
-    {
-        // 6.1. Create a vertex shader object.
-        vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-
-        // 6.2. Specify the shader source.
-        glShaderSource(vertex_shader, 1, &vertex_src, NULL);
-
-        // 6.3. Compile the shader.
-        glCompileShader(vertex_shader);
-
-        // 6.4. Check if there is any error during compilation.
-        int success;
-        glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            char info[512];
-            glGetShaderInfoLog(vertex_shader, 512, NULL, info);
-            printf("Vertex shader error:\n%s\n", info);
-            return -3;
+    // 6. Create the OIT targets, a program variant for every wireframe mode and the uniform branching program.
+    /* The program binaries are loaded from the program cache if they were already compiled in a previous run.
+     * With OIT the fragment shaders write through oitWrite instead of the blended output. */
+    Oit oit;
+    const char* oitHeader = NULL;
+    if (transparency == TRANSPARENCY_WEIGHTED || transparency == TRANSPARENCY_LINKED_LIST) {
+        OitMode oitMode = transparency == TRANSPARENCY_WEIGHTED ? OIT_WEIGHTED : OIT_LINKED_LIST;
+        int width, height;
+        demoGetFramebufferSize(&demo, &width, &height);
+        if (!initOit(&oit, oitMode, width, height, std::max(8, layers * 2))) {
+            destroyDemoContext(&demo);
+            return -1;
         }
+        oitHeader = oitShaderHeader(oitMode);
     }
 
-    // 7. Create the fragment shader.
-    unsigned int fragment_shader;
-    {
-        // 7.1. Create a fragment shader object.
-        fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-
-        // 7.2. Specify the shader source.
-        glShaderSource(fragment_shader, 1, &fragment_src, NULL);
-
-        // 7.3. Compile the shader.
-        glCompileShader(fragment_shader);
-
-        // 7.4. Check if there is any error during compilation.
-        int success;
-        glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            char info[512];
-            glGetShaderInfoLog(fragment_shader, 512, NULL, info);
-            printf("Fragment shader error:\n%s\n", info);
-            return -3;
+    WireframeProgram modePrograms[3];
+    for (int mode = 0; mode < 3; mode++) {
+        modePrograms[mode] = createWireframeProgram(mode, oitHeader);
+    }
+    WireframeProgram branchProgram = createWireframeProgram(-1, oitHeader);
+
+    // "Transparency":
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // 10. Build the indexed mesh and expand it into the wireframe vertices.
+    /* The sphere and the torus are generated by the compiler, only the wireframe expansion runs here. */
+    static constexpr auto sphereMesh = staticSphere<StaticVertex, 32, 16>();
+    static constexpr auto torusMesh = staticTorus<StaticVertex, 48, 24>();
+    bool rotate = strcmp(meshName, "cube") == 0 || strcmp(meshName, "sphere") == 0 || strcmp(meshName, "torus") == 0;
+    MeshData mesh;
+    if (strcmp(meshName, "cube") == 0) {
+        mesh = createCubeMesh();
+    } else if (strcmp(meshName, "sphere") == 0) {
+        mesh = staticMeshData(sphereMesh);
+    } else if (strcmp(meshName, "torus") == 0) {
+        mesh = staticMeshData(torusMesh);
+    } else if (strcmp(meshName, "grid") == 0) {
+        mesh = createGridMesh(gridSize, gridSize);
+    } else {
+        mesh = createGridMesh(1, 1);
+    }
+    if (rotate && transparency == TRANSPARENCY_UNSORTED) {
+        glEnable(GL_DEPTH_TEST);
+    }
+    std::vector<WireframeVertex> vertices = expandWireframeMesh(mesh);
+
+    // 10.1. The overlapping copies of the mesh: shifted along a diagonal through the view volume.
+    std::vector<uint8_t> layerIndices;
+    if (layers > 1) {
+        size_t meshVertices = vertices.size();
+        layerIndices.assign(meshVertices, 0);
+        for (int layer = 1; layer < layers; layer++) {
+            for (size_t idx = 0; idx < meshVertices; idx++) {
+                vertices.push_back(vertices[idx]);
+                layerIndices.push_back((uint8_t)layer);
+            }
+        }
+        for (size_t idx = 0; idx < vertices.size(); idx++) {
+            float shift = (float)layerIndices[idx] / (layers - 1) - 0.5f;
+            vertices[idx].position[0] += shift * 0.6f;
+            vertices[idx].position[1] += shift * 0.4f;
+            vertices[idx].position[2] += shift * 0.8f;
         }
     }
+    int triangleCount = (int)vertices.size() / 3;
+    printf("Mesh: %s, %d triangles\n", meshName, triangleCount);
 
-    // 8. Create a shader program and attach the vertex/fragment shaders.
-    unsigned int shader_program;
+    // 10.2. Upload the vertices and describe the position, barycentric (and layer) attributes.
+    unsigned int vbo;
+    unsigned int layerVbo = 0;
+    unsigned int vao;
     {
-        shader_program = glCreateProgram();
-        glAttachShader(shader_program, vertex_shader);
-        glAttachShader(shader_program, fragment_shader);
-        glLinkProgram(shader_program);
-
-        int success;
-        glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
-        if(!success) {
-            char info[512];
-            glGetProgramInfoLog(shader_program, 512, NULL, info);
-            printf("Program error:\n%s\n", info);
-            return -3;
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(WireframeVertex), vertices.data(), GL_STATIC_DRAW);
+
+        int aPosLoc = 0;
+        int aBarycentricLoc = 1;
+
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        glVertexAttribPointer(aPosLoc, 3, GL_FLOAT, GL_FALSE, sizeof(WireframeVertex),
+                              (void*)offsetof(WireframeVertex, position));
+        glEnableVertexAttribArray(aPosLoc);
+        glVertexAttribPointer(aBarycentricLoc, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(WireframeVertex),
+                              (void*)offsetof(WireframeVertex, barycentric));
+        glEnableVertexAttribArray(aBarycentricLoc);
+
+        if (layers > 1) {
+            int aLayerLoc = 2;
+            glGenBuffers(1, &layerVbo);
+            glBindBuffer(GL_ARRAY_BUFFER, layerVbo);
+            glBufferData(GL_ARRAY_BUFFER, layerIndices.size(), layerIndices.data(), GL_STATIC_DRAW);
+            glVertexAttribPointer(aLayerLoc, 1, GL_UNSIGNED_BYTE, GL_FALSE, 1, (void*)0);
+            glEnableVertexAttribArray(aLayerLoc);
         }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
-    // 9. The vertex and fragment shaders can be removed after linking.
-    {
-        glDeleteShader(vertex_shader);
-        glDeleteShader(fragment_shader);
+    // 10.3. Sorted transparency: the triangle centroids and the per frame indices in a stream buffer.
+    std::vector<glm::vec3> centroids;
+    std::vector<SortKey> sortKeys;
+    StreamBuffer indexStream;
+    if (transparency == TRANSPARENCY_SORTED) {
+        centroids.assign(triangleCount, glm::vec3(0.0f));
+        sortKeys.resize(triangleCount);
+        for (int idx = 0; idx < triangleCount; idx++) {
+            const WireframeVertex* triangle = &vertices[idx * 3];
+            for (int vertex = 0; vertex < 3; vertex++) {
+                const float* position = triangle[vertex].position;
+                centroids[idx] += glm::vec3(position[0], position[1], position[2]) / 3.0f;
+            }
+        }
+        initStreamBuffer(&indexStream, GL_ELEMENT_ARRAY_BUFFER, triangleCount * 3 * sizeof(uint32_t));
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexStream.buffer);
+        glBindVertexArray(0);
     }
 
-    // "Transparency":
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // 10.4. The memory of the transparency mode (besides the vertices).
+    if (transparency != TRANSPARENCY_UNSORTED) {
+        size_t bytes = 0;
+        if (transparency == TRANSPARENCY_SORTED) {
+            bytes = (size_t)indexStream.regionSize * indexStream.regionCount;
+        } else {
+            bytes = oitMemoryBytes(&oit);
+        }
+        printf("Transparency: %s, %d layers, %.1f KB\n", transparencyNames[transparency], layers, bytes / 1024.0);
+    }
+    double statsStartTime = demoGetTime(&demo);
+    double sortSeconds = 0.0;
+    int statsFrames = 0;
+
+    // T.1. Create the GPU timer ("--gpu-timer" options), the benchmark always prints the pass times.
+    GpuTimer gpuTimer;
+    initGpuTimer(&gpuTimer, argc, argv);
+    if (benchmark) {
+        if (!gpuTimerEnableQueries(&gpuTimer)) {
+            printf("Benchmark: GL_EXT_disjoint_timer_query is not supported\n");
+        }
+        gpuTimer.printStats = true;
+        demoSwapInterval(&demo, 0);
+    }
 
-    int uniformWireframeToggleLocation = glGetUniformLocation(shader_program, "wireframeToggle");
+    static const char* variantNames[3] = { "fill", "wire+fill", "wire-only" };
+    static const char* branchNames[3] = { "uniform fill", "uniform wire+fill", "uniform wire-only" };
+    double benchmarkMs[6] = { 0.0 }; // variant, uniform branching for every mode
+    int benchmarkFrames = 0;
+    double benchmarkStartTime = demoGetTime(&demo);
 
     // X. Create a render loop.
-    while (!glfwWindowShouldClose(window))
+    while (!demoShouldClose(&demo))
     {
         // X. Poll and handle events (inputs, window resize, etc.)
-        glfwPollEvents();
+        demoPollEvents(&demo);
+        handleInput(&demo);
+        gpuTimerBeginFrame(&gpuTimer);
 
         // X. Clear the color image.
         glClearColor(0.0, 0.3, 0.3, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // XX. Update the transformation matrix (the cube, sphere and torus rotate, the flat meshes fill the view).
+        {
+            glm::mat4 transform = glm::scale(glm::mat4(1.0f), glm::vec3(1.6f, 1.6f, 1.0f));
+            if (rotate) {
+                int width, height;
+                demoGetFramebufferSize(&demo, &width, &height);
+                glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / height, 0.1f, 10.0f);
+                glm::mat4 view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -2.5f));
+                glm::mat4 model = glm::rotate(glm::mat4(1.0f), (float)demoAnimationTime(&demo), glm::vec3(0.5f, 1.0f, 0.0f));
+                transform = projection * view * model;
+            }
+
+            // X. Draw the triangles, the fill and the wireframe in one pass.
+            /* The key callback only selects the program of the mode, no uniform is changed. */
+            const WireframeProgram& program = uniformBranch ? branchProgram : modePrograms[wireframeToggle];
+            if (!benchmark && transparency == TRANSPARENCY_UNSORTED) {
+                GpuTimerScope timerScope(&gpuTimer, "draw");
+                drawWireframe(program, wireframeToggle, transform, lineWidth, fillAlpha, vao, (int)vertices.size());
+            }
+
+            // X.1. Sorted: the indices back to front, written into the stream buffer of the frame.
+            if (transparency == TRANSPARENCY_SORTED) {
+                double sortStart = demoGetTime(&demo);
+                int offset = -1;
+                streamBufferBeginFrame(&indexStream);
+                uint32_t* indices = (uint32_t*)streamBufferAllocate(&indexStream, triangleCount * 3 * sizeof(uint32_t),
+                                                                   4, &offset);
+                if (indices != NULL) {
+                    sortTriangles(centroids, transform, &sortKeys, indices);
+                }
+                streamBufferEndFrame(&indexStream);
+                sortSeconds += demoGetTime(&demo) - sortStart;
+
+                GpuTimerScope timerScope(&gpuTimer, "draw");
+                drawWireframe(program, wireframeToggle, transform, lineWidth, fillAlpha, vao, (int)vertices.size(),
+                              offset);
+            }
+
+            // X.2. OIT: accumulate in any order, then composite over the framebuffer.
+            if (transparency == TRANSPARENCY_WEIGHTED || transparency == TRANSPARENCY_LINKED_LIST) {
+                {
+                    GpuTimerScope timerScope(&gpuTimer, "draw");
+                    oitBegin(&oit, demoDefaultFramebuffer(&demo));
+                    drawWireframe(program, wireframeToggle, transform, lineWidth, fillAlpha, vao, (int)vertices.size());
+                }
+                GpuTimerScope timerScope(&gpuTimer, "oit resolve");
+                oitResolve(&oit, demoDefaultFramebuffer(&demo));
+            }
+
+            // B.1. Benchmark: every mode with its variant and with the uniform branching program.
+            /* The blending is enabled and the same pixels are covered again and again: the
+             * difference of the pass times is the fragment cost of the variants. Besides the
+             * GPU timer passes each batch is bracketed with glFinish, so the wall time is also
+             * valid on drivers which defer the rasterization (ex.: tilers, software renderers). */
+            for (int idx = 0; benchmark && idx < 6; idx++) {
+                int mode = idx / 2;
+                bool branch = idx % 2 == 1;
+
+                glFinish();
+                double startTime = demoGetTime(&demo);
+                {
+                    GpuTimerScope timerScope(&gpuTimer, branch ? branchNames[mode] : variantNames[mode]);
+                    for (int draw = 0; draw < overdraw; draw++) {
+                        drawWireframe(branch ? branchProgram : modePrograms[mode], mode, transform, lineWidth,
+                                      fillAlpha, vao, (int)vertices.size());
+                    }
+                }
+                glFinish();
+                benchmarkMs[idx] += (demoGetTime(&demo) - startTime) * 1000.0;
+            }
+        }
 
-        // X. Use the shader program to draw.
-        glUseProgram(shader_program);
+        // B.2. Report the average wall time of one draw of the mesh per variant every second.
+        if (benchmark) {
+            benchmarkFrames++;
+            if (demoGetTime(&demo) - benchmarkStartTime >= 1.0) {
+                printf("Benchmark (ms/draw):");
+                for (int idx = 0; idx < 6; idx++) {
+                    printf(" %s %.3f%s", idx % 2 ? branchNames[idx / 2] : variantNames[idx / 2],
+                           benchmarkMs[idx] / (benchmarkFrames * overdraw), idx < 5 ? " |" : "\n");
+                    benchmarkMs[idx] = 0.0;
+                }
+                benchmarkFrames = 0;
+                benchmarkStartTime = demoGetTime(&demo);
+            }
+        }
+
+        // B.3. Transparency modes: the frame time and the CPU sort time every second.
+        if (transparency != TRANSPARENCY_UNSORTED) {
+            statsFrames++;
+            double elapsed = demoGetTime(&demo) - statsStartTime;
+            if (elapsed >= 1.0) {
+                printf("Transparency %s: %.3f ms/frame, sort %.3f ms/frame (CPU)\n", transparencyNames[transparency],
+                       elapsed * 1000.0 / statsFrames, sortSeconds * 1000.0 / statsFrames);
+                statsFrames = 0;
+                sortSeconds = 0.0;
+                statsStartTime = demoGetTime(&demo);
+            }
+        }
 
-        // X. Draw the triangles.
-        glUniform1i(uniformWireframeToggleLocation, wireframeToggle);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        // T.2. Show the pass times (if requested).
+        gpuTimerDrawOverlay(&gpuTimer, 10, 10);
+        gpuTimerEndFrame(&gpuTimer);
 
         // X. Swap the fron-back buffers to display the rendered image in the window.
-        glfwSwapBuffers(window);
+        demoSwapBuffers(&demo);
+    }
+
+    // XX. Destroy the programs and the mesh.
+    for (int mode = 0; mode < 3; mode++) {
+        glDeleteProgram(modePrograms[mode].program);
+    }
+    glDeleteProgram(branchProgram.program);
+    destroyGpuTimer(&gpuTimer);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &layerVbo);
+    if (transparency == TRANSPARENCY_SORTED) {
+        destroyStreamBuffer(&indexStream);
+    }
+    if (oitHeader != NULL) {
+        destroyOit(&oit);
     }
 
-    // XX. Destroy the window.
-    glfwDestroyWindow(window);
-    // XX. Destroy the GLFW.
-    glfwTerminate();
+    // XX. Destroy the window (or the headless context).
+    destroyDemoContext(&demo);
 
     return 0;
 }